@@ -0,0 +1,376 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Submit contract transactions to a node at a steady rate and report how it copes.
+
+Three kinds of transactions are sent, in a configurable mix:
+
+  transfer  a QRC20 style transfer(address,uint256) call to a token contract
+  create    the creation of such a token contract
+  spend     a call with value to a contract that sends the value back to the
+            caller, so that the block gets a condensing transaction with an
+            OP_SPEND input
+
+It reports the mempool acceptance latency (the round trip of the RPC call that
+submits a transaction), the block inclusion delay (from the submission to the
+first block seen with the transaction), the mempool size and, for a local node,
+its memory and CPU usage. See README.md.
+"""
+
+import argparse
+import base64
+from http.client import HTTPConnection
+import json
+import os
+import random
+import sys
+import threading
+import time
+
+COINBASE_MATURITY = 500
+DEFAULT_PORTS = {'main': 2189, 'test': 12189, 'regtest': 12189}
+CHAIN_DIRS = {'main': '', 'test': 'testnet3', 'regtest': 'regtest'}
+
+TRANSFER_SELECTOR = 'a9059cbb'
+TRANSFER_TOPIC = 'ddf252ad1be2c89b69c2b068fc378daa952ba7f163c4a11628f55a4df523b3ef'
+
+
+def push(data):
+    """PUSHn of data, given as hex"""
+    n = len(data) // 2
+    assert 1 <= n <= 32
+    return '%02x' % (0x5f + n) + data
+
+
+def deploy(runtime, constructor=''):
+    """Init code that runs constructor and returns runtime"""
+    size = '%02x' % (len(runtime) // 2)
+    # PUSH1 size PUSH1 offset PUSH1 0 CODECOPY PUSH1 size PUSH1 0 RETURN
+    tail_size = 12
+    offset = '%02x' % (len(constructor) // 2 + tail_size)
+    return constructor + push(size) + push(offset) + push('00') + '39' + push(size) + push('00') + 'f3' + runtime
+
+
+# transfer(to, amount): balance[to] += amount, balance[caller] -= amount and a
+# Transfer(caller, to, amount) log. Balances are not checked, so any address
+# can send, which keeps the senders independent of each other.
+TOKEN_RUNTIME = (
+    push('24') + '35' +                 # amount
+    push('04') + '35' + '80' + '54' +   # amount to balance[to]
+    '82' + '01' + '90' + '55' +         # balance[to] = balance[to] + amount
+    '33' + '80' + '54' +                # amount caller balance[caller]
+    '82' + '90' + '03' + '90' + '55' +  # balance[caller] = balance[caller] - amount
+    push('00') + '52' +                 # memory[0] = amount
+    push('04') + '35' + '33' + push(TRANSFER_TOPIC) +
+    push('20') + push('00') + 'a3' +    # LOG3(0, 32, Transfer, caller, to)
+    '00')
+TOKEN_CODE = deploy(TOKEN_RUNTIME, push('ff' * 32) + '33' + '55')  # balance[creator] = 2^256 - 1
+
+# CALL(GAS, CALLER, CALLVALUE, 0, 0, 0, 0): the value goes back to the caller
+FORWARDER_RUNTIME = push('00') * 4 + '34' + '33' + '5a' + 'f1' + '50' + '00'
+FORWARDER_CODE = deploy(FORWARDER_RUNTIME)
+
+
+class RPCError(Exception):
+    def __init__(self, error):
+        super().__init__(error.get('message'))
+        self.error = error
+
+
+class KPGRPC:
+    def __init__(self, host, port, auth):
+        self.authhdr = b'Basic ' + base64.b64encode(auth.encode('utf-8'))
+        self.conn = HTTPConnection(host, port=port, timeout=120)
+
+    def call(self, method, *params):
+        self.conn.request('POST', '/', json.dumps({'version': '1.1', 'method': method, 'params': list(params), 'id': 0}),
+                          {'Authorization': self.authhdr, 'Content-type': 'application/json'})
+        reply = json.loads(self.conn.getresponse().read().decode('utf-8'))
+        if reply.get('error') is not None:
+            raise RPCError(reply['error'])
+        return reply['result']
+
+
+def percentile(values, p):
+    if not values:
+        return 0.0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p))]
+
+
+class Stats:
+    """What the senders and the block watcher saw, shared between the threads"""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.sent = {}
+        self.errors = {}
+        self.last_error = None
+        self.accept_latency = []
+        self.pending = {}
+        self.inclusion_delay = []
+        self.blocks = 0
+
+    def submitted(self, kind, txid, start, end):
+        with self.lock:
+            self.sent[kind] = self.sent.get(kind, 0) + 1
+            self.accept_latency.append(end - start)
+            self.pending[txid] = end
+
+    def failed(self, kind, error):
+        with self.lock:
+            self.errors[kind] = self.errors.get(kind, 0) + 1
+            self.last_error = error
+
+    def included(self, txids, when):
+        with self.lock:
+            self.blocks += 1
+            for txid in txids:
+                submitted = self.pending.pop(txid, None)
+                if submitted is not None:
+                    self.inclusion_delay.append(when - submitted)
+
+    def take(self):
+        """The latencies and delays since the last call, with the totals"""
+        with self.lock:
+            accept, self.accept_latency = self.accept_latency, []
+            inclusion, self.inclusion_delay = self.inclusion_delay, []
+            return dict(self.sent), dict(self.errors), self.last_error, accept, inclusion, len(self.pending), self.blocks
+
+
+class NodeProcess:
+    """CPU and memory usage of a local node, read from /proc"""
+
+    def __init__(self, pid):
+        self.pid = pid
+        self.last = None
+
+    def usage(self):
+        try:
+            with open('/proc/%d/stat' % self.pid) as f:
+                fields = f.read().rsplit(')', 1)[1].split()
+            with open('/proc/%d/status' % self.pid) as f:
+                rss = next(int(line.split()[1]) for line in f if line.startswith('VmRSS:'))
+        except (OSError, StopIteration):
+            return None
+        cpu = (int(fields[11]) + int(fields[12])) / os.sysconf('SC_CLK_TCK')
+        now = time.time()
+        percent = None
+        if self.last is not None:
+            percent = 100.0 * (cpu - self.last[1]) / max(now - self.last[0], 1e-6)
+        self.last = (now, cpu)
+        return rss // 1024, percent
+
+
+def read_cookie(datadir, chain):
+    try:
+        with open(os.path.join(datadir, CHAIN_DIRS[chain], '.cookie')) as f:
+            return f.read().strip()
+    except OSError:
+        return None
+
+
+def read_pid(datadir, chain):
+    for path in (os.path.join(datadir, CHAIN_DIRS[chain], 'kpgd.pid'), os.path.join(datadir, 'kpgd.pid')):
+        try:
+            with open(path) as f:
+                return int(f.read().strip())
+        except (OSError, ValueError):
+            pass
+    return None
+
+
+def parse_mix(text):
+    mix = {}
+    for part in text.split(','):
+        kind, _, weight = part.partition('=')
+        if kind not in ('transfer', 'create', 'spend') or not weight.isdigit():
+            raise argparse.ArgumentTypeError('expected transfer=<n>,create=<n>,spend=<n>, got %s' % part)
+        mix[kind] = int(weight)
+    if sum(mix.values()) == 0:
+        raise argparse.ArgumentTypeError('the mix has no weight')
+    return mix
+
+
+def wait_for_confirmation(rpc, txid, args):
+    while True:
+        if args.chain == 'regtest':
+            rpc.call('generatetoaddress', 1, args.miner)
+        tx = rpc.call('gettransaction', txid)
+        if tx['confirmations'] > 0:
+            return
+        time.sleep(1)
+
+
+def setup(rpc, args):
+    """Fund the senders and deploy the contracts the calls go to"""
+    if args.chain == 'regtest':
+        args.miner = rpc.call('getnewaddress')
+        height = rpc.call('getblockcount')
+        if height < COINBASE_MATURITY + args.senders:
+            print('Generating %d blocks' % (COINBASE_MATURITY + args.senders - height))
+            rpc.call('generatetoaddress', COINBASE_MATURITY + args.senders - height, args.miner)
+
+    # Every sender gets a few outputs of its own, so that they do not wait for each other's change
+    senders = [rpc.call('getnewaddress') for _ in range(args.senders)]
+    amounts = {}
+    for address in senders:
+        amounts[address] = args.sender_funds
+    print('Funding %d senders with %s each' % (args.senders, args.sender_funds))
+    for _ in range(args.outputs_per_sender):
+        txid = rpc.call('sendmany', '', {a: round(v / args.outputs_per_sender, 8) for a, v in amounts.items()})
+    wait_for_confirmation(rpc, txid, args)
+
+    token = rpc.call('createcontract', TOKEN_CODE, 200000, args.gas_price, senders[0])
+    forwarder = rpc.call('createcontract', FORWARDER_CODE, 200000, args.gas_price, senders[0])
+    wait_for_confirmation(rpc, forwarder['txid'], args)
+    wait_for_confirmation(rpc, token['txid'], args)
+    print('Token contract %s, forwarding contract %s' % (token['address'], forwarder['address']))
+    return senders, token['address'], forwarder['address']
+
+
+def sender_thread(args, auth, senders, token, forwarder, stats, stop, rate):
+    rpc = KPGRPC(args.host, args.port, auth)
+    kinds = list(args.mix.keys())
+    weights = [args.mix[k] for k in kinds]
+    next_time = time.time()
+    while not stop.is_set():
+        kind = random.choices(kinds, weights)[0]
+        sender = random.choice(senders)
+        start = time.time()
+        try:
+            if kind == 'transfer':
+                data = TRANSFER_SELECTOR + '%064x' % random.getrandbits(160) + '%064x' % random.randint(1, 1000)
+                result = rpc.call('sendtocontract', token, data, 0, args.gas_limit, args.gas_price, sender)
+            elif kind == 'create':
+                result = rpc.call('createcontract', TOKEN_CODE, 200000, args.gas_price, sender)
+            else:
+                result = rpc.call('sendtocontract', forwarder, '', args.spend_amount, args.gas_limit, args.gas_price, sender)
+            stats.submitted(kind, result['txid'], start, time.time())
+        except (RPCError, OSError, ValueError) as e:
+            stats.failed(kind, str(e))
+            if isinstance(e, OSError):
+                rpc = KPGRPC(args.host, args.port, auth)
+        next_time += 1.0 / rate
+        delay = next_time - time.time()
+        if delay > 0:
+            stop.wait(delay)
+        else:
+            # Behind schedule: send the next one at once, but do not try to catch up more than a second
+            next_time = max(next_time, time.time() - 1.0)
+
+
+def block_thread(args, auth, stats, stop):
+    rpc = KPGRPC(args.host, args.port, auth)
+    best = rpc.call('getbestblockhash')
+    last_generate = time.time()
+    while not stop.is_set():
+        try:
+            if args.chain == 'regtest' and args.block_interval and time.time() - last_generate >= args.block_interval:
+                rpc.call('generatetoaddress', 1, args.miner)
+                last_generate = time.time()
+            tip = rpc.call('getbestblockhash')
+            # The blocks connected since the last look, oldest first
+            new_blocks = []
+            hash = tip
+            while hash != best and len(new_blocks) < 100:
+                block = rpc.call('getblock', hash)
+                new_blocks.append(block)
+                hash = block.get('previousblockhash')
+                if hash is None:
+                    break
+            now = time.time()
+            for block in reversed(new_blocks):
+                stats.included(block['tx'], now)
+            best = tip
+        except (RPCError, OSError) as e:
+            print('Block watcher: %s' % e, file=sys.stderr)
+            rpc = KPGRPC(args.host, args.port, auth)
+        stop.wait(0.2)
+
+
+def report(rpc, stats, node, elapsed, final=False):
+    sent, errors, last_error, accept, inclusion, pending, blocks = stats.take()
+    mempool = rpc.call('getmempoolinfo')
+    line = '[%5.0fs] sent %s' % (elapsed, ' '.join('%s=%d' % kv for kv in sorted(sent.items())) or '0')
+    if errors:
+        line += ' errors %s' % ' '.join('%s=%d' % kv for kv in sorted(errors.items()))
+    line += ' | accept p50 %.1fms p95 %.1fms max %.1fms' % (1000 * percentile(accept, 0.5), 1000 * percentile(accept, 0.95), 1000 * max(accept or [0]))
+    line += ' | inclusion p50 %.1fs p95 %.1fs' % (percentile(inclusion, 0.5), percentile(inclusion, 0.95))
+    line += ' | blocks %d pending %d mempool %d txs %d kB' % (blocks, pending, mempool['size'], mempool['bytes'] // 1000)
+    usage = node.usage() if node else None
+    if usage:
+        line += ' | node %d MB' % usage[0]
+        if usage[1] is not None:
+            line += ' cpu %.0f%%' % usage[1]
+    print(line)
+    if final and last_error:
+        print('Last error: %s' % last_error)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--chain', choices=['regtest', 'test'], default='regtest', help='Chain of the node (default: regtest)')
+    parser.add_argument('--host', default='127.0.0.1', help='RPC host (default: 127.0.0.1)')
+    parser.add_argument('--port', type=int, help='RPC port (default: the port of the chain)')
+    parser.add_argument('--datadir', default=os.path.expanduser('~/.kpg'), help='Data directory of the node, for the RPC cookie and the pid file (default: ~/.kpg)')
+    parser.add_argument('--rpcuser', help='RPC user, instead of the cookie')
+    parser.add_argument('--rpcpassword', help='RPC password, instead of the cookie')
+    parser.add_argument('--rate', type=float, default=10.0, help='Transactions per second (default: 10)')
+    parser.add_argument('--duration', type=float, default=60.0, help='Seconds to send for (default: 60)')
+    parser.add_argument('--threads', type=int, default=4, help='Sending threads, each with its own RPC connection (default: 4)')
+    parser.add_argument('--mix', type=parse_mix, default=parse_mix('transfer=80,create=5,spend=15'),
+                        help='Weights of the transaction kinds (default: transfer=80,create=5,spend=15)')
+    parser.add_argument('--senders', type=int, default=20, help='Sender addresses (default: 20)')
+    parser.add_argument('--outputs-per-sender', type=int, default=5, help='Outputs each sender is funded with (default: 5)')
+    parser.add_argument('--sender-funds', type=float, default=1000.0, help='Coins each sender is funded with (default: 1000)')
+    parser.add_argument('--gas-limit', type=int, default=100000, help='Gas limit of the calls (default: 100000)')
+    parser.add_argument('--gas-price', type=float, default=0.0000004, help='Gas price (default: 0.0000004)')
+    parser.add_argument('--spend-amount', type=float, default=0.01, help='Value of the calls that cause an OP_SPEND (default: 0.01)')
+    parser.add_argument('--block-interval', type=float, default=16.0, help='On regtest, seconds between the blocks generated, 0 for none (default: 16)')
+    parser.add_argument('--report-interval', type=float, default=10.0, help='Seconds between the reports (default: 10)')
+    parser.add_argument('--pid', type=int, help='Process id of a local node to report the usage of (default: read from the data directory)')
+    args = parser.parse_args()
+
+    if args.port is None:
+        args.port = DEFAULT_PORTS[args.chain]
+    if args.rpcuser is not None and args.rpcpassword is not None:
+        auth = '%s:%s' % (args.rpcuser, args.rpcpassword)
+    else:
+        auth = read_cookie(args.datadir, args.chain)
+        if auth is None:
+            parser.error('no RPC credentials: give --rpcuser and --rpcpassword or a --datadir with a cookie')
+    if args.rate <= 0 or args.threads <= 0 or args.senders <= 0 or args.outputs_per_sender <= 0:
+        parser.error('--rate, --threads, --senders and --outputs-per-sender must be positive')
+
+    rpc = KPGRPC(args.host, args.port, auth)
+    senders, token, forwarder = setup(rpc, args)
+    pid = args.pid if args.pid is not None else read_pid(args.datadir, args.chain)
+    node = NodeProcess(pid) if pid is not None and os.path.exists('/proc/%d' % pid) else None
+    if node:
+        node.usage()
+
+    stats = Stats()
+    stop = threading.Event()
+    threads = [threading.Thread(target=block_thread, args=(args, auth, stats, stop))]
+    for _ in range(args.threads):
+        threads.append(threading.Thread(target=sender_thread, args=(args, auth, senders, token, forwarder, stats, stop, args.rate / args.threads)))
+    print('Sending %.1f transactions per second for %.0f seconds' % (args.rate, args.duration))
+    start = time.time()
+    for t in threads:
+        t.start()
+    try:
+        while time.time() - start < args.duration:
+            time.sleep(min(args.report_interval, max(0.0, args.duration - (time.time() - start))))
+            report(rpc, stats, node, time.time() - start)
+    except KeyboardInterrupt:
+        pass
+    stop.set()
+    for t in threads:
+        t.join()
+    report(rpc, stats, node, time.time() - start, final=True)
+
+
+if __name__ == '__main__':
+    main()
@@ -9,6 +9,8 @@
 #include <serialize.h>
 #include <streams.h>
 
+#include <algorithm>
+
 int CAddrInfo::GetTriedBucket(const uint256& nKey) const
 {
     uint64_t hash1 = (CHashWriter(SER_GETHASH, 0) << nKey << GetKey()).GetCheapHash();
@@ -132,7 +134,7 @@ void CAddrMan::ClearNew(int nUBucket, int nUBucketPos)
         CAddrInfo& infoDelete = mapInfo[nIdDelete];
         assert(infoDelete.nRefCount > 0);
         infoDelete.nRefCount--;
-        vvNew[nUBucket][nUBucketPos] = -1;
+        SetNew(nUBucket, nUBucketPos, -1);
         if (infoDelete.nRefCount == 0) {
             Delete(nIdDelete);
         }
@@ -145,7 +147,7 @@ void CAddrMan::MakeTried(CAddrInfo& info, int nId)
     for (int bucket = 0; bucket < ADDRMAN_NEW_BUCKET_COUNT; bucket++) {
         int pos = info.GetBucketPosition(nKey, true, bucket);
         if (vvNew[bucket][pos] == nId) {
-            vvNew[bucket][pos] = -1;
+            SetNew(bucket, pos, -1);
             info.nRefCount--;
         }
     }
@@ -166,7 +168,7 @@ void CAddrMan::MakeTried(CAddrInfo& info, int nId)
 
         // Remove the to-be-evicted item from the tried set.
         infoOld.fInTried = false;
-        vvTried[nKBucket][nKBucketPos] = -1;
+        SetTried(nKBucket, nKBucketPos, -1);
         nTried--;
 
         // find which new bucket it belongs to
@@ -177,12 +179,12 @@ void CAddrMan::MakeTried(CAddrInfo& info, int nId)
 
         // Enter it into the new set again.
         infoOld.nRefCount = 1;
-        vvNew[nUBucket][nUBucketPos] = nIdEvict;
+        SetNew(nUBucket, nUBucketPos, nIdEvict);
         nNew++;
     }
     assert(vvTried[nKBucket][nKBucketPos] == -1);
 
-    vvTried[nKBucket][nKBucketPos] = nId;
+    SetTried(nKBucket, nKBucketPos, nId);
     nTried++;
     info.fInTried = true;
 }
@@ -316,7 +318,7 @@ bool CAddrMan::Add_(const CAddress& addr, const CNetAddr& source, int64_t nTimeP
         if (fInsert) {
             ClearNew(nUBucket, nUBucketPos);
             pinfo->nRefCount++;
-            vvNew[nUBucket][nUBucketPos] = nId;
+            SetNew(nUBucket, nUBucketPos, nId);
         } else {
             if (pinfo->nRefCount == 0) {
                 Delete(nId);
@@ -362,13 +364,7 @@ CAddrInfo CAddrMan::Select_(bool newOnly)
         // use a tried node
         double fChanceFactor = 1.0;
         while (1) {
-            int nKBucket = insecure_rand.randrange(ADDRMAN_TRIED_BUCKET_COUNT);
-            int nKBucketPos = insecure_rand.randrange(ADDRMAN_BUCKET_SIZE);
-            while (vvTried[nKBucket][nKBucketPos] == -1) {
-                nKBucket = (nKBucket + insecure_rand.randbits(ADDRMAN_TRIED_BUCKET_COUNT_LOG2)) % ADDRMAN_TRIED_BUCKET_COUNT;
-                nKBucketPos = (nKBucketPos + insecure_rand.randbits(ADDRMAN_BUCKET_SIZE_LOG2)) % ADDRMAN_BUCKET_SIZE;
-            }
-            int nId = vvTried[nKBucket][nKBucketPos];
+            int nId = SelectFilled(vvTried, vnTriedFilled, nTriedFilled);
             assert(mapInfo.count(nId) == 1);
             CAddrInfo& info = mapInfo[nId];
             if (insecure_rand.randbits(30) < fChanceFactor * info.GetChance() * (1 << 30))
@@ -379,13 +375,7 @@ CAddrInfo CAddrMan::Select_(bool newOnly)
         // use a new node
         double fChanceFactor = 1.0;
         while (1) {
-            int nUBucket = insecure_rand.randrange(ADDRMAN_NEW_BUCKET_COUNT);
-            int nUBucketPos = insecure_rand.randrange(ADDRMAN_BUCKET_SIZE);
-            while (vvNew[nUBucket][nUBucketPos] == -1) {
-                nUBucket = (nUBucket + insecure_rand.randbits(ADDRMAN_NEW_BUCKET_COUNT_LOG2)) % ADDRMAN_NEW_BUCKET_COUNT;
-                nUBucketPos = (nUBucketPos + insecure_rand.randbits(ADDRMAN_BUCKET_SIZE_LOG2)) % ADDRMAN_BUCKET_SIZE;
-            }
-            int nId = vvNew[nUBucket][nUBucketPos];
+            int nId = SelectFilled(vvNew, vnNewFilled, nNewFilled);
             assert(mapInfo.count(nId) == 1);
             CAddrInfo& info = mapInfo[nId];
             if (insecure_rand.randbits(30) < fChanceFactor * info.GetChance() * (1 << 30))
@@ -395,6 +385,44 @@ CAddrInfo CAddrMan::Select_(bool newOnly)
     }
 }
 
+void CAddrMan::SetTried(int nKBucket, int nKBucketPos, int nId)
+{
+    int& nSlot = vvTried[nKBucket][nKBucketPos];
+    const int nDelta = (nId != -1) - (nSlot != -1);
+    vnTriedFilled[nKBucket] += nDelta;
+    nTriedFilled += nDelta;
+    nSlot = nId;
+}
+
+void CAddrMan::SetNew(int nUBucket, int nUBucketPos, int nId)
+{
+    int& nSlot = vvNew[nUBucket][nUBucketPos];
+    const int nDelta = (nId != -1) - (nSlot != -1);
+    vnNewFilled[nUBucket] += nDelta;
+    nNewFilled += nDelta;
+    nSlot = nId;
+}
+
+template<size_t BUCKETS>
+int CAddrMan::SelectFilled(const int (&vvTable)[BUCKETS][ADDRMAN_BUCKET_SIZE], const int (&vnFilled)[BUCKETS], int nFilled)
+{
+    assert(nFilled > 0);
+    // Every filled position is equally likely: skip whole buckets by their count,
+    // then walk the bucket the drawn position falls in.
+    int n = insecure_rand.randrange(nFilled);
+    size_t nBucket = 0;
+    while (n >= vnFilled[nBucket]) {
+        n -= vnFilled[nBucket];
+        nBucket++;
+    }
+    for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
+        if (vvTable[nBucket][i] != -1 && n-- == 0)
+            return vvTable[nBucket][i];
+    }
+    assert(false);
+    return -1;
+}
+
 #ifdef DEBUG_ADDRMAN
 int CAddrMan::Check_()
 {
@@ -462,6 +490,23 @@ int CAddrMan::Check_()
         }
     }
 
+    int nFilled = 0;
+    for (int n = 0; n < ADDRMAN_TRIED_BUCKET_COUNT; n++) {
+        if (vnTriedFilled[n] != ADDRMAN_BUCKET_SIZE - std::count(vvTried[n], vvTried[n] + ADDRMAN_BUCKET_SIZE, -1))
+            return -20;
+        nFilled += vnTriedFilled[n];
+    }
+    if (nFilled != nTriedFilled)
+        return -20;
+    nFilled = 0;
+    for (int n = 0; n < ADDRMAN_NEW_BUCKET_COUNT; n++) {
+        if (vnNewFilled[n] != ADDRMAN_BUCKET_SIZE - std::count(vvNew[n], vvNew[n] + ADDRMAN_BUCKET_SIZE, -1))
+            return -21;
+        nFilled += vnNewFilled[n];
+    }
+    if (nFilled != nNewFilled)
+        return -21;
+
     if (setTried.size())
         return -13;
     if (mapNew.size())
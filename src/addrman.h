@@ -203,6 +203,12 @@ private:
     //! list of "new" buckets
     int vvNew[ADDRMAN_NEW_BUCKET_COUNT][ADDRMAN_BUCKET_SIZE] GUARDED_BY(cs);
 
+    //! number of filled positions in each "tried" and "new" bucket, and in each table
+    int vnTriedFilled[ADDRMAN_TRIED_BUCKET_COUNT] GUARDED_BY(cs);
+    int vnNewFilled[ADDRMAN_NEW_BUCKET_COUNT] GUARDED_BY(cs);
+    int nTriedFilled GUARDED_BY(cs);
+    int nNewFilled GUARDED_BY(cs);
+
     //! last time Good was called (memory only)
     int64_t nLastGood GUARDED_BY(cs);
 
@@ -235,6 +241,14 @@ protected:
     //! Clear a position in a "new" table. This is the only place where entries are actually deleted.
     void ClearNew(int nUBucket, int nUBucketPos) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
+    //! Set a position in the "tried" or "new" table, keeping the counts of filled positions.
+    void SetTried(int nKBucket, int nKBucketPos, int nId) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    void SetNew(int nUBucket, int nUBucketPos, int nId) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    //! Draw one of the filled positions of a table uniformly and return its nId.
+    template<size_t BUCKETS>
+    int SelectFilled(const int (&vvTable)[BUCKETS][ADDRMAN_BUCKET_SIZE], const int (&vnFilled)[BUCKETS], int nFilled) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
     //! Mark an entry "good", possibly moving it from "new" to "tried".
     void Good_(const CService &addr, bool test_before_evict, int64_t time) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
@@ -270,26 +284,29 @@ protected:
 public:
     /**
      * serialized format:
-     * * version byte (currently 1)
+     * * version byte (currently 2)
      * * 0x20 + nKey (serialized as if it were a vector, for backward compatibility)
      * * nNew
      * * nTried
      * * number of "new" buckets XOR 2**30
      * * all nNew addrinfos in vvNew
-     * * all nTried addrinfos in vvTried
+     * * all nTried addrinfos in vvTried, each followed by its bucket and position (version 2)
      * * for each bucket:
      *   * number of elements
-     *   * for each element: index
+     *   * for each element: index, and its position in the bucket (version 2)
      *
      * 2**30 is xorred with the number of buckets to make addrman deserializer v0 detect it
      * as incompatible. This is necessary because it did not check the version number on
      * deserialization.
      *
-     * Notice that vvTried, mapAddr and vVector are never encoded explicitly;
-     * they are instead reconstructed from the other information.
+     * Notice that mapAddr and vVector are never encoded explicitly; they are instead
+     * reconstructed from the other information.
      *
-     * vvNew is serialized, but only used if ADDRMAN_UNKNOWN_BUCKET_COUNT didn't change,
-     * otherwise it is reconstructed as well.
+     * vvNew and vvTried are serialized, but only used if ADDRMAN_NEW_BUCKET_COUNT didn't
+     * change, otherwise they are reconstructed as well. Version 1 stores only the new
+     * entries of each bucket, so that loading it hashes every address into its tried
+     * bucket and every new reference into its position; version 2 stores the positions
+     * as well and loading places each entry without hashing.
      *
      * This format is more complex, but significantly smaller (at most 1.5 MiB), and supports
      * changes to the ADDRMAN_ parameters without breaking the on-disk structure.
@@ -302,7 +319,7 @@ public:
     {
         LOCK(cs);
 
-        unsigned char nVersion = 1;
+        unsigned char nVersion = 2;
         s << nVersion;
         s << ((unsigned char)32);
         s << nKey;
@@ -322,12 +339,20 @@ public:
                 nIds++;
             }
         }
+        std::map<int, int> mapTriedPos;
+        for (int bucket = 0; bucket < ADDRMAN_TRIED_BUCKET_COUNT; bucket++) {
+            for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
+                if (vvTried[bucket][i] != -1)
+                    mapTriedPos[vvTried[bucket][i]] = bucket * ADDRMAN_BUCKET_SIZE + i;
+            }
+        }
         nIds = 0;
         for (const auto& entry : mapInfo) {
             const CAddrInfo &info = entry.second;
             if (info.fInTried) {
                 assert(nIds != nTried); // this means nTried was wrong, oh ow
                 s << info;
+                s << mapTriedPos[entry.first];
                 nIds++;
             }
         }
@@ -342,6 +367,7 @@ public:
                 if (vvNew[bucket][i] != -1) {
                     int nIndex = mapUnkIds[vvNew[bucket][i]];
                     s << nIndex;
+                    s << (unsigned char)i;
                 }
             }
         }
@@ -376,20 +402,27 @@ public:
             throw std::ios_base::failure("Corrupt CAddrMan serialization, nTried exceeds limit.");
         }
 
+        // Version 2 stores the positions of the entries in their buckets, which are
+        // only meaningful with the bucket counts they were written with.
+        const bool fStoredPositions = nVersion >= 2;
+        const bool fUseNewPositions = (nVersion == 1 || nVersion == 2) && nUBuckets == ADDRMAN_NEW_BUCKET_COUNT;
+        const bool fUseTriedPositions = nVersion == 2 && nUBuckets == ADDRMAN_NEW_BUCKET_COUNT;
+        vRandom.reserve(nNew + nTried);
+
         // Deserialize entries from the new table.
         for (int n = 0; n < nNew; n++) {
-            CAddrInfo &info = mapInfo[n];
+            CAddrInfo &info = mapInfo.emplace_hint(mapInfo.end(), n, CAddrInfo())->second;
             s >> info;
             mapAddr[info] = n;
             info.nRandomPos = vRandom.size();
             vRandom.push_back(n);
-            if (nVersion != 1 || nUBuckets != ADDRMAN_NEW_BUCKET_COUNT) {
+            if (!fUseNewPositions) {
                 // In case the new table data cannot be used (nVersion unknown, or bucket count wrong),
                 // immediately try to give them a reference based on their primary source address.
                 int nUBucket = info.GetNewBucket(nKey);
                 int nUBucketPos = info.GetBucketPosition(nKey, true, nUBucket);
                 if (vvNew[nUBucket][nUBucketPos] == -1) {
-                    vvNew[nUBucket][nUBucketPos] = n;
+                    SetNew(nUBucket, nUBucketPos, n);
                     info.nRefCount++;
                 }
             }
@@ -401,15 +434,27 @@ public:
         for (int n = 0; n < nTried; n++) {
             CAddrInfo info;
             s >> info;
-            int nKBucket = info.GetTriedBucket(nKey);
-            int nKBucketPos = info.GetBucketPosition(nKey, false, nKBucket);
+            int nKBucket = -1;
+            int nKBucketPos = -1;
+            if (fStoredPositions) {
+                int nPos = 0;
+                s >> nPos;
+                if (fUseTriedPositions && nPos >= 0 && nPos < ADDRMAN_TRIED_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE) {
+                    nKBucket = nPos / ADDRMAN_BUCKET_SIZE;
+                    nKBucketPos = nPos % ADDRMAN_BUCKET_SIZE;
+                }
+            }
+            if (nKBucket == -1) {
+                nKBucket = info.GetTriedBucket(nKey);
+                nKBucketPos = info.GetBucketPosition(nKey, false, nKBucket);
+            }
             if (vvTried[nKBucket][nKBucketPos] == -1) {
                 info.nRandomPos = vRandom.size();
                 info.fInTried = true;
                 vRandom.push_back(nIdCount);
-                mapInfo[nIdCount] = info;
+                mapInfo.emplace_hint(mapInfo.end(), nIdCount, info);
                 mapAddr[info] = nIdCount;
-                vvTried[nKBucket][nKBucketPos] = nIdCount;
+                SetTried(nKBucket, nKBucketPos, nIdCount);
                 nIdCount++;
             } else {
                 nLost++;
@@ -424,12 +469,19 @@ public:
             for (int n = 0; n < nSize; n++) {
                 int nIndex = 0;
                 s >> nIndex;
-                if (nIndex >= 0 && nIndex < nNew) {
+                int nUBucketPos = -1;
+                if (fStoredPositions) {
+                    unsigned char nPos = 0;
+                    s >> nPos;
+                    nUBucketPos = nPos;
+                }
+                if (fUseNewPositions && nIndex >= 0 && nIndex < nNew) {
                     CAddrInfo &info = mapInfo[nIndex];
-                    int nUBucketPos = info.GetBucketPosition(nKey, true, bucket);
-                    if (nVersion == 1 && nUBuckets == ADDRMAN_NEW_BUCKET_COUNT && vvNew[bucket][nUBucketPos] == -1 && info.nRefCount < ADDRMAN_NEW_BUCKETS_PER_ADDRESS) {
+                    if (!fStoredPositions || nUBucketPos >= ADDRMAN_BUCKET_SIZE)
+                        nUBucketPos = info.GetBucketPosition(nKey, true, bucket);
+                    if (vvNew[bucket][nUBucketPos] == -1 && info.nRefCount < ADDRMAN_NEW_BUCKETS_PER_ADDRESS) {
                         info.nRefCount++;
-                        vvNew[bucket][nUBucketPos] = nIndex;
+                        SetNew(bucket, nUBucketPos, nIndex);
                     }
                 }
             }
@@ -462,12 +514,16 @@ public:
             for (size_t entry = 0; entry < ADDRMAN_BUCKET_SIZE; entry++) {
                 vvNew[bucket][entry] = -1;
             }
+            vnNewFilled[bucket] = 0;
         }
         for (size_t bucket = 0; bucket < ADDRMAN_TRIED_BUCKET_COUNT; bucket++) {
             for (size_t entry = 0; entry < ADDRMAN_BUCKET_SIZE; entry++) {
                 vvTried[bucket][entry] = -1;
             }
+            vnTriedFilled[bucket] = 0;
         }
+        nNewFilled = 0;
+        nTriedFilled = 0;
 
         nIdCount = 0;
         nTried = 0;
@@ -0,0 +1,55 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <libdevcrypto/LibSnark.h>
+#include <util/strencodings.h>
+
+#include <cassert>
+
+// The generators of G1 and G2, and the negation of the G1 one, in the encoding of the
+// bn128 precompiles (EIP-196, EIP-197)
+static const std::string G1 =
+    "0000000000000000000000000000000000000000000000000000000000000001"
+    "0000000000000000000000000000000000000000000000000000000000000002";
+static const std::string G1_NEG =
+    "0000000000000000000000000000000000000000000000000000000000000001"
+    "30644e72e131a029b85045b68181585d97816a916871ca8d3c208c16d87cfd45";
+static const std::string G2 =
+    "198e9393920d483a7260bfb731fb5d25f1aa493335a9e71297e485b7aef312c2"
+    "1800deef121f1e76426a00665e5c4479674322d4f75edadd46debd5cd992f6ed"
+    "090689d0585ff075ec9e99ad690c3395bc4b313370b38ef355acdadcd122975b"
+    "12c85ea5db8c6deb4aab71808dcb408fe3d1e7690c43d37b4ce6cc0166fa7daa";
+
+static void Bn128Add(benchmark::State& state)
+{
+    const dev::bytes in = ParseHex(G1 + G1);
+    while (state.KeepRunning()) {
+        std::pair<bool, dev::bytes> result = dev::crypto::alt_bn128_G1Add(dev::bytesConstRef(&in));
+        assert(result.first);
+    }
+}
+
+static void Bn128Mul(benchmark::State& state)
+{
+    const dev::bytes in = ParseHex(G1 + "30644e72e131a029b85045b68181585d2833e84879b9709143e1f593f0000000");
+    while (state.KeepRunning()) {
+        std::pair<bool, dev::bytes> result = dev::crypto::alt_bn128_G1Mul(dev::bytesConstRef(&in));
+        assert(result.first);
+    }
+}
+
+// e(P, Q) * e(-P, Q) == 1, the two pairing check of a typical proof verification
+static void Bn128Pairing(benchmark::State& state)
+{
+    const dev::bytes in = ParseHex(G1 + G2 + G1_NEG + G2);
+    while (state.KeepRunning()) {
+        std::pair<bool, dev::bytes> result = dev::crypto::alt_bn128_pairing_product(dev::bytesConstRef(&in));
+        assert(result.first && result.second.back() == 1);
+    }
+}
+
+BENCHMARK(Bn128Add, 50 * 1000);
+BENCHMARK(Bn128Mul, 2000);
+BENCHMARK(Bn128Pairing, 50);
@@ -4,6 +4,7 @@
 
 #include <bench/bench.h>
 
+#include <crypto/keccak.h>
 #include <crypto/sha256.h>
 #include <key.h>
 #include <util/system.h>
@@ -67,6 +68,7 @@ int main(int argc, char** argv)
     gArgs.ForceSetArg("-vbparams", "segwit:-1:999999999999");
 
     SHA256AutoDetect();
+    KeccakAutoDetect();
     ECC_Start();
     SetupEnvironment();
 
@@ -8,16 +8,20 @@
 #include <consensus/merkle.h>
 #include <consensus/validation.h>
 #include <crypto/sha256.h>
+#include <key.h>
 #include <miner.h>
 #include <policy/policy.h>
 #include <pow.h>
+#include <qtum/qtumstatecache.h>
 #include <scheduler.h>
+#include <script/interpreter.h>
 #include <txdb.h>
 #include <txmempool.h>
 #include <util/time.h>
 #include <validation.h>
 #include <validationinterface.h>
 #include <util/convert.h>
+#include <util/strencodings.h>
 
 #include <boost/thread.hpp>
 
@@ -54,25 +58,15 @@ static CTxIn MineBlock(const CScript& coinbase_scriptPubKey)
 }
 
 
-static void AssembleBlock(benchmark::State& state)
+/** Start a regtest chain at the genesis block, with a fresh contract state */
+static void StartChain(boost::thread_group& thread_group, CScheduler& scheduler)
 {
-    const std::vector<unsigned char> op_true{OP_TRUE};
-    CScriptWitness witness;
-    witness.stack.push_back(op_true);
-
-    uint256 witness_program;
-    CSHA256().Write(&op_true[0], op_true.size()).Finalize(witness_program.begin());
-
-    const CScript SCRIPT_PUB{CScript(OP_0) << std::vector<unsigned char>{witness_program.begin(), witness_program.end()}};
-
     // Switch to regtest so we can mine faster
     // Also segwit is active, so we can include witness transactions
     SelectParams(CBaseChainParams::REGTEST);
 
     InitScriptExecutionCache();
 
-    boost::thread_group thread_group;
-    CScheduler scheduler;
     const CChainParams& chainparams = Params();
     {
         LOCK(cs_main);
@@ -85,11 +79,11 @@ static void AssembleBlock(benchmark::State& state)
 
         ::fRequireStandard=false;
         fs::path qtumStateDir = GetDataDir() / "stateKPG";
-        bool fStatus = fs::exists(qtumStateDir);
         const std::string dirQtum(qtumStateDir.string());
         const dev::h256 hashDB(dev::sha3(dev::rlp("")));
-        dev::eth::BaseState existsQtumstate = fStatus ? dev::eth::BaseState::PreExisting : dev::eth::BaseState::Empty;
-        ::globalState = std::unique_ptr<QtumState>(new QtumState(dev::u256(0), QtumState::openDB(dirQtum, hashDB, dev::WithExisting::Trust), dirQtum, existsQtumstate));
+        // In memory, as the block tree and the coins, so that disk writes do not weigh on the numbers
+        ::fStateInMemory = true;
+        ::globalState = std::unique_ptr<QtumState>(new QtumState(dev::u256(0), OpenCachedStateDB(dirQtum, hashDB, 0), dirQtum, dev::eth::BaseState::Empty));
         dev::eth::ChainParams cp((chainparams.EVMGenesisInfo(dev::eth::Network::qtumMainNetwork)));
         ::globalSealEngine = std::unique_ptr<dev::eth::SealEngineFace>(cp.createSealEngine());
 
@@ -116,6 +110,42 @@ static void AssembleBlock(benchmark::State& state)
         const bool witness_enabled{IsWitnessEnabled(::chainActive.Tip(), chainparams.GetConsensus())};
         assert(witness_enabled);
     }
+}
+
+static void StopChain(boost::thread_group& thread_group)
+{
+    thread_group.interrupt_all();
+    thread_group.join_all();
+    GetMainSignals().FlushBackgroundCallbacks();
+    GetMainSignals().UnregisterBackgroundSignalScheduler();
+
+    // Leave nothing behind for the next benchmark that builds a chain
+    UnloadBlockIndex();
+    QtumDGP::clearCache();
+
+    ::pblocktree.reset();
+    ::pcoinsdbview.reset();
+    ::pcoinsTip.reset();
+    ::pstorageresult.reset();
+    ::globalState.reset();
+    ::globalSealEngine.reset();
+    fs::remove_all(GetDataDir() / "stateKPG");
+}
+
+static void AssembleBlock(benchmark::State& state)
+{
+    const std::vector<unsigned char> op_true{OP_TRUE};
+    CScriptWitness witness;
+    witness.stack.push_back(op_true);
+
+    uint256 witness_program;
+    CSHA256().Write(&op_true[0], op_true.size()).Finalize(witness_program.begin());
+
+    const CScript SCRIPT_PUB{CScript(OP_0) << std::vector<unsigned char>{witness_program.begin(), witness_program.end()}};
+
+    boost::thread_group thread_group;
+    CScheduler scheduler;
+    StartChain(thread_group, scheduler);
 
     // Collect some loose transactions that spend the coinbases of our mined blocks
     constexpr size_t NUM_BLOCKS{100+2000};
@@ -142,17 +172,161 @@ static void AssembleBlock(benchmark::State& state)
         PrepareBlock(SCRIPT_PUB);
     }
 
-    thread_group.interrupt_all();
-    thread_group.join_all();
-    GetMainSignals().FlushBackgroundCallbacks();
-    GetMainSignals().UnregisterBackgroundSignalScheduler();
+    StopChain(thread_group);
+}
 
-    ::pblocktree.reset();
-    ::pcoinsdbview.reset();
-    ::pcoinsTip.reset();
-    ::pstorageresult.reset();
-    ::globalState.reset();
-    ::globalSealEngine.reset();
+/** Number of contract txs in the mempool of the contract benchmarks, they all fit in
+ *  one block, so the time per tx is the time per block divided by this */
+static constexpr int NUM_CONTRACT_TXS = 100;
+/** Gas limit of each contract tx of the contract benchmarks */
+static constexpr uint64_t CONTRACT_GAS_LIMIT = 100000;
+
+/**
+ * Token contract with the storage accesses of a QRC20 transfer: the calldata is the
+ * recipient and the amount, which is moved from the balance of the caller to the
+ * balance of the recipient, without any check. The runtime code is
+ *   PUSH1 0x20 CALLDATALOAD DUP1 CALLER SLOAD SUB CALLER SSTORE
+ *   PUSH1 0x00 CALLDATALOAD SLOAD ADD PUSH1 0x00 CALLDATALOAD SSTORE STOP
+ * after the init code that returns it.
+ */
+static const std::string TOKEN_CONTRACT_CODE = "601380600b6000396000f3" "60203580335403335560003554016000355500";
+
+enum class ContractMix {
+    CALLS,        //!< Token transfers
+    CREATES,      //!< Creations of the token contract
+    SPEND_CHAINS, //!< Chains of token transfers that send coins to the contract, so that the
+                  //!< condensing tx spends the balance of the contract with OP_SPEND
+};
+
+static void SignContractTx(const CKey& key, CMutableTransaction& tx, const CScript& prevScript, CAmount prevValue)
+{
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(prevScript, tx, 0, SIGHASH_ALL, prevValue, SigVersion::BASE);
+    bool signed_ok{key.Sign(hash, vchSig)};
+    assert(signed_ok);
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    tx.vin[0].scriptSig = CScript() << vchSig;
+}
+
+static CScript ContractScript(const std::vector<unsigned char>& data, const dev::Address* contract)
+{
+    CScript script = CScript() << CScriptNum(VersionVM::GetEVMDefault().toRaw()) << CScriptNum(CONTRACT_GAS_LIMIT) << CScriptNum(DEFAULT_GAS_PRICE) << data;
+    if (contract)
+        return script << contract->asBytes() << OP_CALL;
+    return script << OP_CREATE;
+}
+
+static void AcceptContractTx(const CTransactionRef& tx)
+{
+    LOCK(::cs_main);
+    CValidationState state;
+    bool ret{::AcceptToMemoryPool(::mempool, state, tx, nullptr /* pfMissingInputs */, nullptr /* plTxnReplaced */, false /* bypass_limits */, /* nAbsurdFee */ 0)};
+    assert(ret);
+}
+
+static void AssembleContractBlock(benchmark::State& state, ContractMix mix)
+{
+    // Contract txs need a P2PK or P2PKH sender
+    CKey key;
+    key.MakeNewKey(true);
+    const CScript SCRIPT_PUB{CScript() << ToByteVector(key.GetPubKey()) << OP_CHECKSIG};
+    const CAmount CONTRACT_FEE{(CAmount)(CONTRACT_GAS_LIMIT * DEFAULT_GAS_PRICE) + COIN / 100};
+    const CAmount CONTRACT_VALUE{1000};
+
+    boost::thread_group thread_group;
+    CScheduler scheduler;
+    StartChain(thread_group, scheduler);
+
+    // Mine until the first coinbase is mature, and split it in one output per tx of the mix
+    // and one for the creation of the token contract
+    CTxIn coinbase_in = MineBlock(SCRIPT_PUB);
+    CAmount coinbase_value;
+    {
+        LOCK(cs_main);
+        coinbase_value = ::pcoinsTip->AccessCoin(coinbase_in.prevout).out.nValue;
+    }
+    for (int b = 0; b < COINBASE_MATURITY; ++b) {
+        MineBlock(SCRIPT_PUB);
+    }
+    CMutableTransaction split;
+    split.vin.push_back(coinbase_in);
+    const CAmount split_value{(coinbase_value - COIN / 100) / (NUM_CONTRACT_TXS + 1)};
+    for (int i = 0; i <= NUM_CONTRACT_TXS; ++i) {
+        split.vout.emplace_back(split_value, SCRIPT_PUB);
+    }
+    SignContractTx(key, split, SCRIPT_PUB, coinbase_value);
+    CTransactionRef split_tx = MakeTransactionRef(split);
+    AcceptContractTx(split_tx);
+    MineBlock(SCRIPT_PUB);
+
+    // Deploy the token contract
+    CMutableTransaction create;
+    create.vin.emplace_back(COutPoint(split_tx->GetHash(), NUM_CONTRACT_TXS));
+    create.vout.emplace_back(0, ContractScript(ParseHex(TOKEN_CONTRACT_CODE), nullptr));
+    create.vout.emplace_back(split_value - CONTRACT_FEE, SCRIPT_PUB);
+    SignContractTx(key, create, SCRIPT_PUB, split_value);
+    CTransactionRef create_tx = MakeTransactionRef(create);
+    AcceptContractTx(create_tx);
+    MineBlock(SCRIPT_PUB);
+    const dev::Address token{QtumState::createQtumAddress(uintToh256(create_tx->GetHash()), 0)};
+    {
+        LOCK(cs_main);
+        assert(::globalState->addressInUse(token));
+    }
+
+    // Fill the mempool with the txs of the mix
+    constexpr int CHAIN_LENGTH{10};
+    CTransactionRef prev_tx;
+    for (int i = 0; i < NUM_CONTRACT_TXS; ++i) {
+        std::vector<unsigned char> transfer(64);
+        transfer[30] = (unsigned char)(i >> 8);
+        transfer[31] = (unsigned char)i;
+        transfer[63] = 1;
+
+        CMutableTransaction tx;
+        CAmount prev_value{split_value};
+        if (mix == ContractMix::SPEND_CHAINS && i % CHAIN_LENGTH) {
+            // Spend the change of the previous tx of the chain
+            tx.vin.emplace_back(COutPoint(prev_tx->GetHash(), 1));
+            prev_value = prev_tx->vout[1].nValue;
+        } else {
+            tx.vin.emplace_back(COutPoint(split_tx->GetHash(), i));
+        }
+        if (mix == ContractMix::CREATES) {
+            tx.vout.emplace_back(0, ContractScript(ParseHex(TOKEN_CONTRACT_CODE), nullptr));
+        } else {
+            tx.vout.emplace_back(mix == ContractMix::SPEND_CHAINS ? CONTRACT_VALUE : 0, ContractScript(transfer, &token));
+        }
+        tx.vout.emplace_back(prev_value - CONTRACT_FEE - tx.vout[0].nValue, SCRIPT_PUB);
+        SignContractTx(key, tx, SCRIPT_PUB, prev_value);
+        prev_tx = MakeTransactionRef(tx);
+        AcceptContractTx(prev_tx);
+    }
+    assert(::mempool.size() == (size_t)NUM_CONTRACT_TXS);
+
+    while (state.KeepRunning()) {
+        PrepareBlock(SCRIPT_PUB);
+    }
+
+    StopChain(thread_group);
+}
+
+static void AssembleContractCallsBlock(benchmark::State& state)
+{
+    AssembleContractBlock(state, ContractMix::CALLS);
+}
+
+static void AssembleContractCreatesBlock(benchmark::State& state)
+{
+    AssembleContractBlock(state, ContractMix::CREATES);
+}
+
+static void AssembleContractSpendChainsBlock(benchmark::State& state)
+{
+    AssembleContractBlock(state, ContractMix::SPEND_CHAINS);
 }
 
 BENCHMARK(AssembleBlock, 700);
+BENCHMARK(AssembleContractCallsBlock, 10);
+BENCHMARK(AssembleContractCreatesBlock, 10);
+BENCHMARK(AssembleContractSpendChainsBlock, 10);
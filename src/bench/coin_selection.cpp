@@ -59,6 +59,39 @@ static void CoinSelection(benchmark::State& state)
     }
 }
 
+// Coin selection in a wallet with 100k outputs of various values, as left by many stake
+// splits, for both the knapsack solver and branch and bound.
+static void CoinSelectionLargeWallet(benchmark::State& state, bool use_bnb)
+{
+    auto chain = interfaces::MakeChain();
+    const CWallet wallet(*chain, WalletLocation(), WalletDatabase::CreateDummy());
+    std::vector<std::unique_ptr<CWalletTx>> wtxs;
+    LOCK(wallet.cs_wallet);
+
+    // Add coins of 10 to 1000 KPG, spread over the value range
+    for (int i = 0; i < 100000; ++i) {
+        addCoin((10 + (i * 7919) % 991) * COIN + (i % 97) * CENT, wallet, wtxs);
+    }
+
+    std::vector<OutputGroup> groups;
+    for (const auto& wtx : wtxs) {
+        COutput output(wtx.get(), 0 /* iIn */, 6 * 24 /* nDepthIn */, true /* spendable */, true /* solvable */, true /* safe */);
+        groups.emplace_back(output.GetInputCoin(), 6, false, 0, 0);
+    }
+
+    const CoinEligibilityFilter filter_standard(1, 6, 0);
+    const CoinSelectionParams coin_selection_params(use_bnb, 34, 148, CFeeRate(0), 0);
+    while (state.KeepRunning()) {
+        std::set<CInputCoin> setCoinsRet;
+        CAmount nValueRet;
+        bool bnb_used;
+        wallet.SelectCoinsMinConf(12345 * COIN + 67 * CENT, filter_standard, groups, setCoinsRet, nValueRet, coin_selection_params, bnb_used);
+    }
+}
+
+static void CoinSelectionLargeWalletKnapsack(benchmark::State& state) { CoinSelectionLargeWallet(state, false); }
+static void CoinSelectionLargeWalletBnB(benchmark::State& state) { CoinSelectionLargeWallet(state, true); }
+
 typedef std::set<CInputCoin> CoinSet;
 static auto testChain = interfaces::MakeChain();
 static const CWallet testWallet(*testChain, WalletLocation(), WalletDatabase::CreateDummy());
@@ -108,3 +141,5 @@ static void BnBExhaustion(benchmark::State& state)
 
 BENCHMARK(CoinSelection, 650);
 BENCHMARK(BnBExhaustion, 650);
+BENCHMARK(CoinSelectionLargeWalletKnapsack, 5);
+BENCHMARK(CoinSelectionLargeWalletBnB, 5);
@@ -10,6 +10,7 @@
 #include <miner.h>
 #include <policy/policy.h>
 #include <pow.h>
+#include <qtum/qtumstatecache.h>
 #include <scheduler.h>
 #include <txdb.h>
 #include <txmempool.h>
@@ -48,11 +49,10 @@ static void DuplicateInputs(benchmark::State& state)
 
         ::fRequireStandard=false;
         fs::path qtumStateDir = GetDataDir() / "stateKPG";
-        bool fStatus = fs::exists(qtumStateDir);
         const std::string dirQtum(qtumStateDir.string());
         const dev::h256 hashDB(dev::sha3(dev::rlp("")));
-        dev::eth::BaseState existsQtumstate = fStatus ? dev::eth::BaseState::PreExisting : dev::eth::BaseState::Empty;
-        ::globalState = std::unique_ptr<QtumState>(new QtumState(dev::u256(0), QtumState::openDB(dirQtum, hashDB, dev::WithExisting::Trust), dirQtum, existsQtumstate));
+        ::fStateInMemory = true;
+        ::globalState = std::unique_ptr<QtumState>(new QtumState(dev::u256(0), OpenCachedStateDB(dirQtum, hashDB, 0), dirQtum, dev::eth::BaseState::Empty));
         dev::eth::ChainParams cp((chainparams.EVMGenesisInfo(dev::eth::Network::qtumMainNetwork)));
         ::globalSealEngine = std::unique_ptr<dev::eth::SealEngineFace>(cp.createSealEngine());
 
@@ -0,0 +1,65 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <key.h>
+#include <keystore.h>
+#include <psbt.h>
+#include <script/sign.h>
+#include <script/standard.h>
+
+#include <cassert>
+
+//! Inputs of the consolidation PSBT, each spending a P2WPKH output of the same key
+static const int PSBT_INPUTS = 500;
+
+static PartiallySignedTransaction BuildConsolidationPSBT(CBasicKeyStore& keystore)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    keystore.AddKey(key);
+    const CScript scriptPubKey = GetScriptForDestination(WitnessV0KeyHash(key.GetPubKey().GetID()));
+
+    CMutableTransaction tx;
+    tx.vin.resize(PSBT_INPUTS);
+    for (int i = 0; i < PSBT_INPUTS; i++) {
+        tx.vin[i].prevout = COutPoint(uint256S("a1"), i);
+    }
+    tx.vout.emplace_back(PSBT_INPUTS * COIN - 10000, scriptPubKey);
+
+    PartiallySignedTransaction psbtx(tx);
+    for (PSBTInput& input : psbtx.inputs) {
+        input.witness_utxo = CTxOut(COIN, scriptPubKey);
+    }
+    return psbtx;
+}
+
+static void SignConsolidationPSBT(benchmark::State& state, bool fPrecompute)
+{
+    CBasicKeyStore keystore;
+    const PartiallySignedTransaction psbtxUnsigned = BuildConsolidationPSBT(keystore);
+
+    while (state.KeepRunning()) {
+        PartiallySignedTransaction psbtx = psbtxUnsigned;
+        const PrecomputedTransactionData txdata = PrecomputePSBTData(psbtx);
+        bool complete = true;
+        for (int i = 0; i < PSBT_INPUTS; i++) {
+            complete &= SignPSBTInput(keystore, psbtx, i, SIGHASH_ALL, nullptr, false, fPrecompute ? &txdata : nullptr);
+        }
+        assert(complete);
+    }
+}
+
+static void PSBTSignPrecomputed(benchmark::State& state)
+{
+    SignConsolidationPSBT(state, true);
+}
+
+static void PSBTSignRehashed(benchmark::State& state)
+{
+    SignConsolidationPSBT(state, false);
+}
+
+BENCHMARK(PSBTSignPrecomputed, 2);
+BENCHMARK(PSBTSignRehashed, 2);
@@ -0,0 +1,262 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <arith_uint256.h>
+#include <bench/bench.h>
+#include <chainparams.h>
+#include <coins.h>
+#include <key.h>
+#include <pos.h>
+#include <qtum/qtumstate.h>
+#include <qtum/qtumstatecache.h>
+#include <qtum/storageresults.h>
+#include <util/convert.h>
+#include <util/strencodings.h>
+#include <util/system.h>
+#include <validation.h>
+
+#include <libethereum/ChainParams.h>
+
+#include <cassert>
+
+// The fixtures are built in place: a chain is not needed for any of the hot paths below
+static const uint32_t BLOCK_TIME = 1500000000;
+static const uint64_t CONTRACT_GAS_LIMIT = 100000;
+
+/** Token contract with the storage accesses of a QRC20 transfer, see block_assemble.cpp */
+static const std::string TOKEN_CONTRACT_CODE = "601380600b6000396000f3" "60203580335403335560003554016000355500";
+
+static void StakeKernelHash(benchmark::State& state)
+{
+    CBlockIndex prev;
+    prev.nTime = BLOCK_TIME;
+    prev.nStakeModifier = uint256S("7d0b6b7c4d3a2f1e0d9c8b7a695847362514f3e2d1c0b9a8f7e6d5c4b3a29180");
+    uint256 hashProofOfStake, targetProofOfStake;
+    uint32_t n = 0;
+    while (state.KeepRunning()) {
+        // One candidate coin of a staker's wallet after another
+        CheckStakeKernelHash(&prev, 0x1a0fffff, BLOCK_TIME - 4000, 100 * COIN, COutPoint(prev.nStakeModifier, n++), BLOCK_TIME + 16, hashProofOfStake, targetProofOfStake, false);
+    }
+}
+
+static void StakeModifier(benchmark::State& state)
+{
+    CBlockIndex prev;
+    prev.nStakeModifier = uint256S("7d0b6b7c4d3a2f1e0d9c8b7a695847362514f3e2d1c0b9a8f7e6d5c4b3a29180");
+    uint256 kernel = uint256S("0e1f2a3b4c5d6e7f8091a2b3c4d5e6f708192a3b4c5d6e7f8091a2b3c4d5e6f7");
+    while (state.KeepRunning()) {
+        kernel = ComputeStakeModifier(&prev, kernel);
+    }
+}
+
+/** A proof-of-stake block whose coinstake pays to a P2PK output of key, signed by key */
+static CBlock SignedStakeBlock(const CKey& key)
+{
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].prevout.SetNull();
+    coinbase.vout.resize(1);
+    coinbase.vout[0].SetEmpty();
+
+    CMutableTransaction coinstake;
+    coinstake.vin.emplace_back(COutPoint(uint256S("01"), 0));
+    coinstake.vout.resize(2);
+    coinstake.vout[0].SetEmpty();
+    coinstake.vout[1] = CTxOut(100 * COIN, CScript() << ToByteVector(key.GetPubKey()) << OP_CHECKSIG);
+
+    CBlock block;
+    block.nTime = BLOCK_TIME;
+    block.prevoutStake = coinstake.vin[0].prevout;
+    block.vtx.push_back(MakeTransactionRef(std::move(coinbase)));
+    block.vtx.push_back(MakeTransactionRef(std::move(coinstake)));
+    bool signed_ok{key.Sign(block.GetHashWithoutSign(), block.vchBlockSig)};
+    assert(signed_ok);
+    return block;
+}
+
+// Blocks are normally seen as headers first, so this is the cached path taken by CheckBlock
+static void BlockSignature(benchmark::State& state)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    const CBlock block = SignedStakeBlock(key);
+    while (state.KeepRunning()) {
+        bool valid{CheckBlockSignature(block)};
+        assert(valid);
+    }
+}
+
+/** A tx of a P2PKH sender with nCalls token transfers to contract */
+static CTransaction ContractCallTx(const CKey& key, const dev::Address& contract, int nCalls, CCoinsViewCache& view)
+{
+    CMutableTransaction tx;
+    tx.vin.emplace_back(COutPoint(uint256S("02"), 0));
+    tx.vin[0].scriptSig = CScript() << std::vector<unsigned char>(72, 0x30) << ToByteVector(key.GetPubKey());
+    const std::vector<unsigned char> data = ParseHex(std::string(64, '1') + std::string(62, '0') + "64");
+    for (int i = 0; i < nCalls; ++i)
+        tx.vout.emplace_back(0, CScript() << CScriptNum(VersionVM::GetEVMDefault().toRaw()) << CScriptNum(CONTRACT_GAS_LIMIT) << CScriptNum(DEFAULT_GAS_PRICE) << data << contract.asBytes() << OP_CALL);
+    view.AddCoin(tx.vin[0].prevout, Coin(CTxOut(10 * COIN, GetScriptForDestination(key.GetPubKey().GetID())), 1, false, false), false);
+    return CTransaction(tx);
+}
+
+static void ContractTxConversion(benchmark::State& state)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CCoinsView dummy;
+    CCoinsViewCache view(&dummy);
+    const CTransaction tx = ContractCallTx(key, dev::Address("abababababababababababababababababababab"), 10, view);
+    while (state.KeepRunning()) {
+        QtumTxConverter convert(tx, &view);
+        ExtractQtumTX extracted;
+        bool converted{convert.extractionQtumTransactions(extracted)};
+        assert(converted && extracted.first.size() == 10);
+    }
+}
+
+/** A contract state in the bench data directory, removed afterwards */
+class BenchContractState
+{
+public:
+    BenchContractState()
+    {
+        SelectParams(CBaseChainParams::REGTEST);
+        dir = GetDataDir() / "stateKPG_bench";
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+        const std::string dirQtum(dir.string());
+        const dev::h256 hashDB(dev::sha3(dev::rlp("")));
+        // In memory, so that the numbers are those of the EVM rather than of the disk
+        fStateInMemory = true;
+        contractState.reset(new QtumState(dev::u256(0), OpenCachedStateDB(dirQtum, hashDB, 0), dirQtum, dev::eth::BaseState::Empty));
+        contractState->setRootUTXO(dev::sha3(dev::rlp("")));
+        dev::eth::ChainParams cp((Params().EVMGenesisInfo(dev::eth::Network::qtumMainNetwork)));
+        sealEngine.reset(cp.createSealEngine());
+
+        tip.nHeight = 1000;
+        tip.nTime = BLOCK_TIME;
+        lastHashes.set(&tip);
+        header.setNumber(tip.nHeight + 1);
+        header.setTimestamp(BLOCK_TIME + 16);
+        header.setGasLimit(DEFAULT_BLOCK_GAS_LIMIT_DGP);
+        header.setAuthor(dev::Address("cdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcd"));
+    }
+
+    ~BenchContractState()
+    {
+        sealEngine.reset();
+        contractState.reset();
+        fs::remove_all(dir);
+    }
+
+    ResultExecute Execute(const QtumTransaction& tx)
+    {
+        dev::u256 gasUsed;
+        dev::eth::EnvInfo env(header, lastHashes, gasUsed);
+        return contractState->execute(env, *sealEngine, tx);
+    }
+
+    /** A tx of the sender 0101.. with the given hash and calldata, to contract or a creation if null */
+    static QtumTransaction Tx(const dev::bytes& data, const dev::u256& value, uint32_t nHash, const dev::Address* contract)
+    {
+        QtumTransaction tx = contract ? QtumTransaction(value, DEFAULT_GAS_PRICE, CONTRACT_GAS_LIMIT, *contract, data, dev::u256(0)) : QtumTransaction(value, DEFAULT_GAS_PRICE, CONTRACT_GAS_LIMIT, data, dev::u256(0));
+        tx.forceSender(dev::Address("0101010101010101010101010101010101010101"));
+        tx.setHashWith(dev::h256(nHash));
+        tx.setNVout(0);
+        tx.setVersion(VersionVM::GetEVMDefault());
+        return tx;
+    }
+
+    dev::Address Deploy(uint32_t nHash)
+    {
+        const QtumTransaction create = Tx(ParseHex(TOKEN_CONTRACT_CODE), 0, nHash, nullptr);
+        ResultExecute result = Execute(create);
+        assert(result.execRes.excepted == dev::eth::TransactionException::None);
+        return QtumState::createQtumAddress(create.getHashWith(), create.getNVout());
+    }
+
+    fs::path dir;
+    std::unique_ptr<QtumState> contractState;
+    std::unique_ptr<dev::eth::SealEngineFace> sealEngine;
+    CBlockIndex tip;
+    LastHashes lastHashes;
+    dev::eth::BlockHeader header;
+};
+
+static void ExecuteTokenTransfer(benchmark::State& state)
+{
+    BenchContractState contracts;
+    const dev::Address token = contracts.Deploy(1);
+    uint32_t n = 2;
+    while (state.KeepRunning()) {
+        // Each transfer goes to a new recipient, as most do
+        dev::bytes data = dev::h256(n).asBytes();
+        const dev::bytes amount = dev::h256(100).asBytes();
+        data.insert(data.end(), amount.begin(), amount.end());
+        ResultExecute result = contracts.Execute(BenchContractState::Tx(data, 0, n++, &token));
+        assert(result.execRes.excepted == dev::eth::TransactionException::None);
+    }
+}
+
+static void CreateCondensingTx(benchmark::State& state)
+{
+    // Contracts funded by calls with value, moving part of it around the ring
+    constexpr uint32_t NUM_CONTRACTS = 20;
+    BenchContractState contracts;
+    std::vector<dev::Address> addresses;
+    for (uint32_t i = 0; i < NUM_CONTRACTS; ++i) {
+        addresses.push_back(contracts.Deploy(1 + i));
+        ResultExecute result = contracts.Execute(BenchContractState::Tx(dev::bytes(64, 0), 1000 * COIN, 1000 + i, &addresses.back()));
+        assert(result.execRes.excepted == dev::eth::TransactionException::None);
+    }
+    std::vector<TransferInfo> transfers;
+    for (uint32_t i = 0; i < NUM_CONTRACTS; ++i)
+        transfers.push_back(TransferInfo{addresses[i], addresses[(i + 1) % NUM_CONTRACTS], dev::u256(10 * COIN * (i + 1))});
+    const QtumTransaction tx = BenchContractState::Tx(dev::bytes(), 0, 2000, &addresses[0]);
+
+    while (state.KeepRunning()) {
+        CondensingTX condensing(contracts.contractState.get(), transfers, tx);
+        CTransaction condensed = condensing.createCondensingTX();
+        assert(!condensed.vout.empty());
+    }
+}
+
+static void CommitStorageResults(benchmark::State& state)
+{
+    // The receipts of a block with 100 contract txs
+    constexpr uint32_t NUM_TXS = 100;
+    const fs::path dir = GetDataDir() / "resultsKPG_bench";
+    fs::remove_all(dir);
+    {
+        StorageResults results(dir.string());
+        const dev::Address contract("abababababababababababababababababababab");
+        const dev::Address sender("cdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcd");
+        const dev::h256 topic(dev::sha3(std::string("Transfer(address,address,uint256)")));
+        dev::eth::LogEntries logs;
+        logs.push_back(dev::eth::LogEntry(contract, {topic, dev::h256(sender), dev::h256(contract)}, dev::h256(100).asBytes()));
+
+        uint32_t n = 0;
+        while (state.KeepRunning()) {
+            for (uint32_t i = 0; i < NUM_TXS; ++i, ++n) {
+                const uint256 hashTx = ArithToUint256(arith_uint256(n));
+                std::vector<TransactionReceiptInfo> receipts{TransactionReceiptInfo{
+                    uint256(), 1000, hashTx, i, 0, sender, contract, 30000 * (i + 1), 30000, dev::Address(), logs,
+                    dev::eth::TransactionException::None, "", dev::h256(n), dev::h256(n + 1), {}, {}, {}}};
+                results.addResult(uintToh256(hashTx), receipts);
+            }
+            results.commitResults();
+            bool flushed{results.flushResults()};
+            assert(flushed);
+        }
+    }
+    fs::remove_all(dir);
+}
+
+BENCHMARK(StakeKernelHash, 500 * 1000);
+BENCHMARK(StakeModifier, 500 * 1000);
+BENCHMARK(BlockSignature, 500 * 1000);
+BENCHMARK(ContractTxConversion, 5000);
+BENCHMARK(ExecuteTokenTransfer, 500);
+BENCHMARK(CreateCondensingTx, 2000);
+BENCHMARK(CommitStorageResults, 50);
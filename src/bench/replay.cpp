@@ -0,0 +1,163 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#if defined(HAVE_CONFIG_H)
+#include <config/bitcoin-config.h>
+#endif
+
+#include <chainparams.h>
+#include <clientversion.h>
+#include <init.h>
+#include <interfaces/chain.h>
+#include <noui.h>
+#include <rpc/blockchain.h>
+#include <shutdown.h>
+#include <txdb.h>
+#include <util/system.h>
+#include <util/time.h>
+#include <validation.h>
+#include <validationstats.h>
+
+#include <univalue.h>
+
+#include <stdio.h>
+
+#ifndef WIN32
+#include <sys/resource.h>
+#endif
+
+const std::function<std::string(const char*)> G_TRANSLATION_FUN = nullptr;
+
+/**
+ * Replay of a segment of a real chain: the node is started on a data directory holding the
+ * chainstate and contract state at the start of the segment, connects the blocks of the
+ * -loadblock files on top of it, and stops. The options of kpgd apply, so -par and -dbcache
+ * set the script check threads and the caches of the run. The data directory is modified,
+ * replay a copy of the snapshot.
+ */
+static const char* USAGE =
+    "Usage:  bench_kpg_replay -datadir=<snapshot> -loadblock=<blk file> [-loadblock=...] [options]\n"
+    "\n"
+    "Connects the blocks of the files on top of the chain of the snapshot and prints the number of\n"
+    "blocks connected per second, the time of each validation stage and the peak memory as JSON.\n"
+    "The snapshot is modified, run on a copy of it. Options are those of kpgd.\n";
+
+/** Peak resident memory of the process in kB, 0 if not known */
+static int64_t PeakMemory()
+{
+#ifndef WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef MAC_OSX
+        return usage.ru_maxrss / 1024;
+#else
+        return usage.ru_maxrss;
+#endif
+    }
+#endif
+    return 0;
+}
+
+static UniValue ReplayReport(int64_t nElapsed)
+{
+    std::vector<StageStats> stats = validationStats.Get();
+    const StageTimes& connected = stats[static_cast<size_t>(ValidationStage::TOTAL)].total;
+
+    UniValue stages(UniValue::VOBJ);
+    for (size_t i = 0; i < stats.size(); i++) {
+        stages.pushKV(ValidationStageName(static_cast<ValidationStage>(i)), StageTimesToJSON(stats[i].total));
+    }
+
+    UniValue report(UniValue::VOBJ);
+    {
+        LOCK(cs_main);
+        report.pushKV("height", chainActive.Height());
+    }
+    report.pushKV("blocks", connected.nCount);
+    report.pushKV("elapsed_ms", nElapsed * 0.001);
+    // Over the whole run, then over ConnectTip alone, without the reads and writes of the import
+    report.pushKV("blocks_per_sec", nElapsed ? connected.nCount * 1e6 / nElapsed : 0.0);
+    report.pushKV("connect_blocks_per_sec", connected.nTotal ? connected.nCount * 1e6 / connected.nTotal : 0.0);
+    report.pushKV("par", nScriptCheckThreads);
+    report.pushKV("dbcache_mb", gArgs.GetArg("-dbcache", nDefaultDbCache));
+    report.pushKV("peak_rss_kb", PeakMemory());
+    report.pushKV("stages", stages);
+    return report;
+}
+
+static bool Replay(int argc, char* argv[])
+{
+    InitInterfaces interfaces;
+    interfaces.chain = interfaces::MakeChain();
+
+    SetupServerArgs();
+    std::string error;
+    if (!gArgs.ParseParameters(argc, argv, error)) {
+        tfm::format(std::cerr, "Error parsing command line arguments: %s\n", error.c_str());
+        return false;
+    }
+    if (HelpRequested(gArgs) || !gArgs.IsArgSet("-loadblock")) {
+        tfm::format(std::cout, "%s", USAGE);
+        return HelpRequested(gArgs);
+    }
+
+    bool fRet = false;
+    int64_t nStart = 0;
+    try {
+        if (!fs::is_directory(GetDataDir(false))) {
+            tfm::format(std::cerr, "Error: Specified data directory \"%s\" does not exist.\n", gArgs.GetArg("-datadir", "").c_str());
+            return false;
+        }
+        if (!gArgs.ReadConfigFiles(error, true)) {
+            tfm::format(std::cerr, "Error reading configuration file: %s\n", error.c_str());
+            return false;
+        }
+        try {
+            SelectParams(gArgs.GetChainName());
+        } catch (const std::exception& e) {
+            tfm::format(std::cerr, "Error: %s\n", e.what());
+            return false;
+        }
+
+        // Nothing but the blocks of the files reaches validation
+        gArgs.ForceSetArg("-stopafterblockimport", "1");
+        gArgs.SoftSetBoolArg("-listen", false);
+        gArgs.SoftSetArg("-connect", "0");
+        gArgs.SoftSetBoolArg("-dnsseed", false);
+        gArgs.SoftSetBoolArg("-server", false);
+        gArgs.SoftSetBoolArg("-disablewallet", true);
+        gArgs.SoftSetBoolArg("-persistmempool", false);
+        InitLogging();
+        InitParameterInteraction();
+        if (!AppInitBasicSetup() || !AppInitParameterInteraction() || !AppInitSanityChecks() || !AppInitLockDataDirectory()) {
+            return false;
+        }
+        nStart = GetTimeMicros();
+        fRet = AppInitMain(interfaces);
+    } catch (const std::exception& e) {
+        PrintExceptionContinue(&e, "Replay()");
+    } catch (...) {
+        PrintExceptionContinue(nullptr, "Replay()");
+    }
+
+    if (fRet) {
+        while (!ShutdownRequested()) {
+            MilliSleep(50);
+        }
+    }
+    int64_t nElapsed = GetTimeMicros() - nStart;
+    Interrupt();
+    if (fRet) {
+        tfm::format(std::cout, "%s\n", ReplayReport(nElapsed).write(2));
+    }
+    Shutdown(interfaces);
+    return fRet;
+}
+
+int main(int argc, char* argv[])
+{
+    SetupEnvironment();
+    noui_connect();
+    return Replay(argc, argv) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
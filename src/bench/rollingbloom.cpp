@@ -6,6 +6,8 @@
 
 #include <bench/bench.h>
 #include <bloom.h>
+#include <crypto/common.h>
+#include <uint256.h>
 
 static void RollingBloom(benchmark::State& state)
 {
@@ -28,4 +30,38 @@ static void RollingBloom(benchmark::State& state)
     }
 }
 
+static void BlockedRollingBloom(benchmark::State& state)
+{
+    CBlockedRollingBloomFilter filter(120000, 0.000001);
+    uint256 hash;
+    uint32_t count = 0;
+    while (state.KeepRunning()) {
+        count++;
+        WriteLE32(hash.begin(), count);
+        filter.insert(hash);
+
+        WriteBE32(hash.begin(), count);
+        filter.contains(hash);
+    }
+}
+
+static void RollingBloomReset(benchmark::State& state)
+{
+    CRollingBloomFilter filter(50000, 0.000001);
+    while (state.KeepRunning()) {
+        filter.reset();
+    }
+}
+
+static void BlockedRollingBloomReset(benchmark::State& state)
+{
+    CBlockedRollingBloomFilter filter(50000, 0.000001);
+    while (state.KeepRunning()) {
+        filter.reset();
+    }
+}
+
 BENCHMARK(RollingBloom, 1500 * 1000);
+BENCHMARK(BlockedRollingBloom, 1500 * 1000);
+BENCHMARK(RollingBloomReset, 1000);
+BENCHMARK(BlockedRollingBloomReset, 1000);
@@ -0,0 +1,55 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockcompress.h>
+#include <crypto/common.h>
+
+#include <cryptopp/filters.h>
+#include <cryptopp/zdeflate.h>
+#include <cryptopp/zinflate.h>
+
+#include <string.h>
+#include <string>
+
+bool CompressDiskRecord(const unsigned char* data, size_t size, std::vector<unsigned char>& compressed)
+{
+    std::string stream;
+    // The deflator owns the sink
+    CryptoPP::Deflator deflator(new CryptoPP::StringSink(stream), CryptoPP::Deflator::DEFAULT_DEFLATE_LEVEL);
+    deflator.Put(data, size);
+    deflator.MessageEnd();
+    if (4 + stream.size() >= size) {
+        compressed.clear();
+        return false;
+    }
+    compressed.resize(4 + stream.size());
+    WriteLE32(compressed.data(), size);
+    memcpy(compressed.data() + 4, stream.data(), stream.size());
+    return true;
+}
+
+void DecompressDiskRecord(const unsigned char* data, size_t size, std::vector<unsigned char>& raw)
+{
+    if (size < 4) {
+        throw std::ios_base::failure("DecompressDiskRecord(): truncated record");
+    }
+    const uint32_t nRawSize = ReadLE32(data);
+    if (nRawSize > MAX_SIZE) {
+        throw std::ios_base::failure("DecompressDiskRecord(): record larger than the maximum deserialization size");
+    }
+    raw.resize(nRawSize);
+    // The sink drops output past the size of the record; the hashes of blocks and the
+    // checksums of undo data catch such corruption. The inflator owns the sink.
+    CryptoPP::ArraySink* sink = new CryptoPP::ArraySink(raw.data(), raw.size());
+    CryptoPP::Inflator inflator(sink);
+    try {
+        inflator.Put(data + 4, size - 4);
+        inflator.MessageEnd();
+    } catch (const CryptoPP::Exception& e) {
+        throw std::ios_base::failure(std::string("DecompressDiskRecord(): ") + e.what());
+    }
+    if (sink->TotalPutLength() != nRawSize) {
+        throw std::ios_base::failure("DecompressDiskRecord(): size mismatch");
+    }
+}
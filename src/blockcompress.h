@@ -0,0 +1,47 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BLOCKCOMPRESS_H
+#define BLOCKCOMPRESS_H
+
+#include <serialize.h>
+
+#include <ios>
+#include <stdint.h>
+#include <vector>
+
+/** Default for -compressblocks, storing new blocks and undo data compressed */
+static const bool DEFAULT_COMPRESS_BLOCKS = false;
+
+/**
+ * Flag of the size field of a block or undo record whose data is compressed.
+ *
+ * The records of the blk and rev files are the network magic, the size of the data and
+ * the data, which the block index points to. The data of a compressed record is the
+ * size of the uncompressed data as a 32-bit integer followed by its DEFLATE stream.
+ * Blocks and undo data are limited to MAX_SIZE, so the flag can not be set in the size
+ * of an uncompressed record. Records are only stored compressed when that makes them
+ * smaller, and undo records keep their checksum of the uncompressed data.
+ */
+static const uint32_t DISK_RECORD_COMPRESSED = 0x80000000;
+
+/** Compress the serialized data of a record, false if compression does not make it smaller */
+bool CompressDiskRecord(const unsigned char* data, size_t size, std::vector<unsigned char>& compressed);
+
+/** Decompress the data of a compressed record, throwing std::ios_base::failure if it is corrupt */
+void DecompressDiskRecord(const unsigned char* data, size_t size, std::vector<unsigned char>& raw);
+
+/** Read the data of a compressed record of nSize bytes (without the flag) from filein and decompress it */
+template <typename Stream>
+void ReadCompressedDiskRecord(Stream& filein, uint32_t nSize, std::vector<unsigned char>& raw)
+{
+    if (nSize > MAX_SIZE) {
+        throw std::ios_base::failure("ReadCompressedDiskRecord(): record larger than the maximum deserialization size");
+    }
+    std::vector<unsigned char> data(nSize);
+    filein.read((char*)data.data(), nSize);
+    DecompressDiskRecord(data.data(), data.size(), raw);
+}
+
+#endif
@@ -16,15 +16,29 @@
 
 #include <unordered_map>
 
+// The coinstake and the condensing transactions the contract executions generated, which spend
+// contract outputs with OP_SPEND, are never relayed, so no peer has them in its mempool
+static bool IsBlockGeneratedTx(const CTransaction& tx) {
+    return tx.IsCoinStake() || tx.HasOpSpend();
+}
+
 CBlockHeaderAndShortTxIDs::CBlockHeaderAndShortTxIDs(const CBlock& block, bool fUseWTXID) :
         nonce(GetRand(std::numeric_limits<uint64_t>::max())),
-        shorttxids(block.vtx.size() - 1), prefilledtxn(1), header(block) {
+        prefilledtxn(1), header(block) {
     FillShortTxIDSelector();
-    //TODO: Use our mempool prior to block acceptance to predictively fill more than just the coinbase
+    //TODO: Use our mempool prior to block acceptance to predictively fill more than just the block-generated transactions
     prefilledtxn[0] = {0, block.vtx[0]};
+    shorttxids.reserve(block.vtx.size() - 1);
+    size_t last_prefilled = 0;
     for (size_t i = 1; i < block.vtx.size(); i++) {
         const CTransaction& tx = *block.vtx[i];
-        shorttxids[i - 1] = GetShortID(fUseWTXID ? tx.GetWitnessHash() : tx.GetHash());
+        if (IsBlockGeneratedTx(tx)) {
+            // Prefilled indexes are differentially encoded
+            prefilledtxn.push_back({static_cast<uint16_t>(i - last_prefilled - 1), block.vtx[i]});
+            last_prefilled = i;
+        } else {
+            shorttxids.push_back(GetShortID(fUseWTXID ? tx.GetWitnessHash() : tx.GetHash()));
+        }
     }
 }
 
@@ -0,0 +1,118 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockfilemap.h>
+#include <blockfilewriter.h>
+#include <fs.h>
+#include <util/system.h>
+#include <validation.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+
+BlockFileMapCache g_block_file_maps(DEFAULT_BLOCK_FILE_MAPS);
+
+MappedBlockFile::~MappedBlockFile()
+{
+#ifndef WIN32
+    munmap(const_cast<unsigned char*>(pData), nSize);
+#endif
+}
+
+/** Map a block file read-only, nullptr if it cannot be mapped */
+static std::shared_ptr<const MappedBlockFile> MapBlockFile(int nFile)
+{
+#ifdef WIN32
+    return nullptr;
+#else
+    // A few large mappings would exhaust the address space of a 32-bit process
+    if (sizeof(void*) < 8)
+        return nullptr;
+    // The file is finalized once the records queued for it are written
+    if (g_block_file_writer)
+        g_block_file_writer->WaitForFile(nFile);
+    const fs::path path = GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk");
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd == -1)
+        return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+    const size_t nSize = st.st_size;
+    void* addr = mmap(nullptr, nSize, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping keeps the file referenced
+    close(fd);
+    if (addr == MAP_FAILED) {
+        LogPrint(BCLog::BENCH, "%s: failed to map %s\n", __func__, path.string());
+        return nullptr;
+    }
+    return std::make_shared<const MappedBlockFile>(static_cast<const unsigned char*>(addr), nSize);
+#endif
+}
+
+std::shared_ptr<const MappedBlockFile> BlockFileMapCache::Get(int nFile)
+{
+    LOCK(cs);
+    if (nFile < 0 || nFile >= nFinalizedFiles || nMaxFiles <= 0)
+        return nullptr;
+    auto it = mapEntries.find(nFile);
+    if (it != mapEntries.end()) {
+        listEntries.splice(listEntries.begin(), listEntries, it->second);
+        return it->second->second;
+    }
+    std::shared_ptr<const MappedBlockFile> file = MapBlockFile(nFile);
+    if (!file)
+        return nullptr;
+    listEntries.emplace_front(nFile, file);
+    mapEntries.emplace(nFile, listEntries.begin());
+    Trim();
+    return file;
+}
+
+void BlockFileMapCache::SetMaxFiles(int nMaxFilesIn)
+{
+    LOCK(cs);
+    nMaxFiles = nMaxFilesIn;
+    Trim();
+}
+
+void BlockFileMapCache::SetFinalizedFiles(int nFile)
+{
+    LOCK(cs);
+    nFinalizedFiles = nFile;
+    for (auto it = mapEntries.begin(); it != mapEntries.end();) {
+        if (it->first >= nFinalizedFiles) {
+            listEntries.erase(it->second);
+            it = mapEntries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void BlockFileMapCache::Invalidate(int nFile)
+{
+    LOCK(cs);
+    auto it = mapEntries.find(nFile);
+    if (it != mapEntries.end()) {
+        listEntries.erase(it->second);
+        mapEntries.erase(it);
+    }
+}
+
+void BlockFileMapCache::Trim()
+{
+    while (!listEntries.empty() && (int)listEntries.size() > std::max(nMaxFiles, 0)) {
+        mapEntries.erase(listEntries.back().first);
+        listEntries.pop_back();
+    }
+}
@@ -0,0 +1,125 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BLOCKFILEMAP_H
+#define BLOCKFILEMAP_H
+
+#include <serialize.h>
+#include <sync.h>
+
+#include <ios>
+#include <list>
+#include <map>
+#include <memory>
+#include <string.h>
+
+/** Default for -blockfilemaps, the number of finalized block files kept mapped in memory (0 = off) */
+static const int DEFAULT_BLOCK_FILE_MAPS = 32;
+/** Maximum for -blockfilemaps */
+static const int MAX_BLOCK_FILE_MAPS = 1024;
+
+/** Read-only memory mapping of a whole block file, unmapped when the last reference goes */
+class MappedBlockFile
+{
+public:
+    MappedBlockFile(const unsigned char* dataIn, size_t sizeIn) : pData(dataIn), nSize(sizeIn) {}
+    ~MappedBlockFile();
+
+    MappedBlockFile(const MappedBlockFile&) = delete;
+    MappedBlockFile& operator=(const MappedBlockFile&) = delete;
+
+    const unsigned char* data() const { return pData; }
+    size_t size() const { return nSize; }
+
+private:
+    const unsigned char* const pData;
+    const size_t nSize;
+};
+
+/** Minimal stream reading a mapped block file from a position, like CAutoFile */
+class BlockFileReader
+{
+public:
+    BlockFileReader(int nTypeIn, int nVersionIn, const MappedBlockFile& file, size_t nPosIn)
+        : nType(nTypeIn), nVersion(nVersionIn), m_file(file), nPos(nPosIn)
+    {
+        if (nPos > m_file.size()) {
+            throw std::ios_base::failure("BlockFileReader(...): position past the end of the file");
+        }
+    }
+
+    template<typename T>
+    BlockFileReader& operator>>(T& obj)
+    {
+        ::Unserialize(*this, obj);
+        return (*this);
+    }
+
+    int GetVersion() const { return nVersion; }
+    int GetType() const { return nType; }
+
+    void read(char* dst, size_t n)
+    {
+        if (n > m_file.size() - nPos) {
+            throw std::ios_base::failure("BlockFileReader::read(): end of file");
+        }
+        memcpy(dst, m_file.data() + nPos, n);
+        nPos += n;
+    }
+
+private:
+    const int nType;
+    const int nVersion;
+    const MappedBlockFile& m_file;
+    size_t nPos;
+};
+
+/**
+ * LRU cache of the memory mappings of the finalized block files.
+ *
+ * ReadBlockFromDisk and ReadRawBlockFromDisk otherwise open, seek and read the block
+ * file through stdio for every block served to RPC, REST and peers. A mapped file is
+ * read straight from the page cache without a system call or a copy into a stdio
+ * buffer. Only the files below the one blocks are appended to are mapped: those are
+ * truncated to their final size when the node leaves them and are not written again,
+ * so a mapping never sees the file shrink under it. A mapping stays valid for the
+ * readers holding it after it is dropped from the cache or its file is pruned.
+ *
+ * Mapping is not available on Windows and 32-bit systems, where Get always returns
+ * nullptr and the callers fall back to reading the file.
+ */
+class BlockFileMapCache
+{
+public:
+    explicit BlockFileMapCache(int nMaxFilesIn) : nMaxFiles(nMaxFilesIn), nFinalizedFiles(0) {}
+
+    /** The mapping of a finalized block file, nullptr if it is not finalized or cannot be mapped */
+    std::shared_ptr<const MappedBlockFile> Get(int nFile);
+
+    /** Set the number of block files kept mapped, 0 to stop mapping them */
+    void SetMaxFiles(int nMaxFilesIn);
+
+    /** The block files below nFile are finalized, drop the mappings of the others */
+    void SetFinalizedFiles(int nFile);
+
+    /** Drop the mapping of a pruned block file */
+    void Invalidate(int nFile);
+
+private:
+    typedef std::list<std::pair<int, std::shared_ptr<const MappedBlockFile>>> EntryList;
+
+    void Trim() EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    Mutex cs;
+    int nMaxFiles GUARDED_BY(cs);
+    int nFinalizedFiles GUARDED_BY(cs);
+    //! Most recently used files at the front
+    EntryList listEntries GUARDED_BY(cs);
+    std::map<int, EntryList::iterator> mapEntries GUARDED_BY(cs);
+};
+
+/** Mappings of the block files read by ReadBlockFromDisk and ReadRawBlockFromDisk */
+extern BlockFileMapCache g_block_file_maps;
+
+#endif
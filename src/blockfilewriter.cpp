@@ -0,0 +1,142 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockfilewriter.h>
+#include <fs.h>
+#include <util/system.h>
+#include <validation.h>
+
+#include <functional>
+
+std::unique_ptr<BlockFileWriter> g_block_file_writer;
+
+BlockFileWriter::BlockFileWriter(size_t nMaxPendingBytesIn) :
+    nMaxPendingBytes(nMaxPendingBytesIn), m_pending_bytes(0), m_failed(false), m_stop(false)
+{
+    m_thread = std::thread(&TraceThread<std::function<void()>>, "blockwrite", std::function<void()>(std::bind(&BlockFileWriter::ThreadWrite, this)));
+}
+
+BlockFileWriter::~BlockFileWriter()
+{
+    {
+        LOCK(m_mutex);
+        m_stop = true;
+        m_cond.notify_all();
+    }
+    m_thread.join();
+}
+
+bool BlockFileWriter::Write(const CDiskBlockPos& pos, bool fUndo, std::vector<unsigned char>&& data)
+{
+    Task task{Task::WRITE, pos, fUndo, 0, std::move(data)};
+    return Enqueue(std::move(task));
+}
+
+bool BlockFileWriter::Allocate(const CDiskBlockPos& pos, bool fUndo, unsigned int nLength)
+{
+    Task task{Task::ALLOCATE, pos, fUndo, nLength, {}};
+    return Enqueue(std::move(task));
+}
+
+bool BlockFileWriter::Finalize(const CDiskBlockPos& pos, bool fUndo)
+{
+    Task task{Task::FINALIZE, pos, fUndo, 0, {}};
+    return Enqueue(std::move(task));
+}
+
+bool BlockFileWriter::Enqueue(Task&& task)
+{
+    WAIT_LOCK(m_mutex, lock);
+    // A record larger than the limit is queued once the queue is empty
+    while (!m_failed && m_pending_bytes > 0 && m_pending_bytes + task.data.size() > nMaxPendingBytes)
+        m_cond.wait(lock);
+    if (m_failed)
+        return false;
+    m_pending_bytes += task.data.size();
+    m_pending_files[task.pos.nFile]++;
+    m_queue.push_back(std::move(task));
+    m_cond.notify_all();
+    return true;
+}
+
+void BlockFileWriter::WaitForFile(int nFile)
+{
+    WAIT_LOCK(m_mutex, lock);
+    while (m_pending_files.count(nFile))
+        m_cond.wait(lock);
+}
+
+bool BlockFileWriter::Flush()
+{
+    WAIT_LOCK(m_mutex, lock);
+    while (!m_pending_files.empty())
+        m_cond.wait(lock);
+    return !m_failed;
+}
+
+bool BlockFileWriter::Run(const Task& task)
+{
+    fs::path path = GetBlockPosFilename(task.pos, task.fUndo ? "rev" : "blk");
+    FILE* file = fsbridge::fopen(path, "rb+");
+    if (!file)
+        file = fsbridge::fopen(path, "wb+");
+    if (!file)
+        return error("%s: unable to open file %s", __func__, path.string());
+
+    bool fOk = true;
+    switch (task.type) {
+    case Task::WRITE:
+        fOk = fseek(file, task.pos.nPos, SEEK_SET) == 0 && fwrite(task.data.data(), 1, task.data.size(), file) == task.data.size();
+        break;
+    case Task::ALLOCATE:
+        LogPrintf("Pre-allocating up to position 0x%x in %s\n", task.pos.nPos + task.nLength, path.filename().string());
+        AllocateFileRange(file, task.pos.nPos, task.nLength);
+        // AllocateFileRange does not report failures, such as a full disk: check the size
+        fOk = fseek(file, 0, SEEK_END) == 0 && ftell(file) >= (long)(task.pos.nPos + task.nLength);
+        break;
+    case Task::FINALIZE:
+        fOk = TruncateFile(file, task.pos.nPos) && FileCommit(file);
+        break;
+    }
+    if (fclose(file) != 0)
+        fOk = false;
+    if (!fOk)
+        return error("%s: failed to write %s at position %u", __func__, path.string(), task.pos.nPos);
+    return true;
+}
+
+void BlockFileWriter::ThreadWrite()
+{
+    while (true) {
+        Task task;
+        {
+            WAIT_LOCK(m_mutex, lock);
+            while (!m_stop && m_queue.empty())
+                m_cond.wait(lock);
+            if (m_queue.empty())
+                return;
+            task = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+
+        const bool fOk = Run(task);
+
+        LOCK(m_mutex);
+        m_pending_bytes -= task.data.size();
+        if (--m_pending_files[task.pos.nFile] == 0)
+            m_pending_files.erase(task.pos.nFile);
+        if (!fOk) {
+            // Later records could leave a gap in the file, drop them. The block index may
+            // already refer to the records not written, so the node cannot go on.
+            m_failed = true;
+            m_queue.clear();
+            m_pending_files.clear();
+            m_pending_bytes = 0;
+            AbortNode(strprintf("Failed to write to %s file %d", task.fUndo ? "undo" : "block", task.pos.nFile));
+            m_cond.notify_all();
+            return;
+        }
+        m_cond.notify_all();
+    }
+}
@@ -0,0 +1,97 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BLOCKFILEWRITER_H
+#define BLOCKFILEWRITER_H
+
+#include <chain.h>
+#include <sync.h>
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/** Default for -blockwritequeue, the MiB of block and undo records queued for the writer thread (0 = write synchronously) */
+static const int DEFAULT_BLOCK_WRITE_QUEUE = 64;
+/** Maximum for -blockwritequeue */
+static const int MAX_BLOCK_WRITE_QUEUE = 1024;
+
+/**
+ * Thread writing the block and undo records to the block files.
+ *
+ * WriteBlockToDisk and UndoWriteToDisk serialize a record and queue it at the position
+ * FindBlockPos or FindUndoPos reserved, so accepting and connecting a block does not
+ * wait for the disk. The preallocation of new file chunks and the truncation and fsync
+ * of a block file the node leaves go through the queue too, after the writes they
+ * follow. The queue holds up to a limit of record bytes; writing more waits for room.
+ *
+ * Opening a block or undo file for reading waits for the queued tasks of that file, so
+ * readers never see a record before it is written. FlushStateToDisk waits for the whole
+ * queue before the block files are synced and the block index refers to the records.
+ * A failed task, preallocation included, aborts the node: the queue is dropped and
+ * every call returns false until the node shuts down.
+ */
+class BlockFileWriter
+{
+public:
+    explicit BlockFileWriter(size_t nMaxPendingBytesIn);
+    //! Runs the queued tasks, then stops the thread
+    ~BlockFileWriter();
+
+    BlockFileWriter(const BlockFileWriter&) = delete;
+    BlockFileWriter& operator=(const BlockFileWriter&) = delete;
+
+    /** Queue writing data at pos of the block file, or of the undo file if fUndo */
+    bool Write(const CDiskBlockPos& pos, bool fUndo, std::vector<unsigned char>&& data);
+
+    /** Queue preallocating nLength bytes from pos */
+    bool Allocate(const CDiskBlockPos& pos, bool fUndo, unsigned int nLength);
+
+    /** Queue truncating the file to pos.nPos bytes and syncing it */
+    bool Finalize(const CDiskBlockPos& pos, bool fUndo);
+
+    /** Wait for the queued tasks of the block and undo file nFile */
+    void WaitForFile(int nFile);
+
+    /** Wait for all queued tasks, false if a task failed */
+    bool Flush();
+
+private:
+    struct Task {
+        enum Type { WRITE, ALLOCATE, FINALIZE };
+
+        Type type;
+        CDiskBlockPos pos;
+        bool fUndo;
+        //! Number of bytes to preallocate
+        unsigned int nLength;
+        std::vector<unsigned char> data;
+    };
+
+    bool Enqueue(Task&& task);
+    static bool Run(const Task& task);
+    void ThreadWrite();
+
+    const size_t nMaxPendingBytes;
+
+    Mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<Task> m_queue GUARDED_BY(m_mutex);
+    //! Queued and running tasks by file number
+    std::map<int, int> m_pending_files GUARDED_BY(m_mutex);
+    //! Record bytes queued or being written
+    size_t m_pending_bytes GUARDED_BY(m_mutex);
+    bool m_failed GUARDED_BY(m_mutex);
+    bool m_stop GUARDED_BY(m_mutex);
+
+    std::thread m_thread;
+};
+
+/** The writer of the block and undo records, null when they are written synchronously */
+extern std::unique_ptr<BlockFileWriter> g_block_file_writer;
+
+#endif
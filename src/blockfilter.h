@@ -6,6 +6,7 @@
 #define BITCOIN_BLOCKFILTER_H
 
 #include <stdint.h>
+#include <string>
 #include <unordered_set>
 #include <vector>
 
@@ -86,8 +87,23 @@ constexpr uint32_t BASIC_FILTER_M = 784931;
 enum BlockFilterType : uint8_t
 {
     BASIC = 0,
+    //! The BASIC elements, and the contract addresses and log topics of the receipts of the
+    //! block. Outside of the range of the BIP 158 types.
+    CONTRACT = 0x80,
 };
 
+/** Get the human-readable name for a filter type. Returns empty string for unknown types. */
+const std::string& BlockFilterTypeName(BlockFilterType filter_type);
+
+/** Find a filter type by its human-readable name. */
+bool BlockFilterTypeByName(const std::string& name, BlockFilterType& filter_type);
+
+/** Get a list of known filter types. */
+const std::vector<BlockFilterType>& AllBlockFilterTypes();
+
+/** Get a comma-separated list of known filter type names. */
+const std::string& ListBlockFilterTypes();
+
 /**
  * Complete block filter struct as defined in BIP 157. Serialization matches
  * payload of "cfilter" messages.
@@ -112,6 +128,11 @@ public:
     //! Construct a new BlockFilter of the specified type from a block.
     BlockFilter(BlockFilterType filter_type, const CBlock& block, const CBlockUndo& block_undo);
 
+    //! Construct a new BlockFilter of the specified type from a block and the elements of its
+    //! contract receipts, which only the CONTRACT type includes.
+    BlockFilter(BlockFilterType filter_type, const CBlock& block, const CBlockUndo& block_undo,
+                const GCSFilter::ElementSet& contract_elements);
+
     BlockFilterType GetFilterType() const { return m_filter_type; }
     const uint256& GetBlockHash() const { return m_block_hash; }
     const GCSFilter& GetFilter() const { return m_filter; }
@@ -0,0 +1,193 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockprefetch.h>
+#include <chainparams.h>
+#include <coins.h>
+#include <qtum/qtumstatewalk.h>
+#include <script/script.h>
+#include <util/convert.h>
+#include <util/system.h>
+#include <validation.h>
+
+#include <libdevcore/Address.h>
+#include <libdevcore/SHA3.h>
+
+std::unique_ptr<BlockPrefetcher> pblockprefetcher;
+
+namespace {
+
+/** Address of the contract called by an OP_CALL output, the last push before the opcode */
+bool GetCalledContract(const CScript& script, dev::Address& address)
+{
+    std::vector<unsigned char> data;
+    std::vector<unsigned char> lastPush;
+    opcodetype opcode;
+    CScript::const_iterator pc = script.begin();
+    while (script.GetOp(pc, opcode, data)) {
+        if (opcode == OP_CALL) {
+            if (lastPush.size() != dev::Address::size)
+                return false;
+            address = dev::Address(lastPush);
+            return true;
+        }
+        lastPush = std::move(data);
+        data.clear();
+    }
+    return false;
+}
+
+}
+
+BlockPrefetcher::BlockPrefetcher(int _nDepth, const CCoinsView* _coinsDB, const dev::db::DatabaseFace* _stateDB, const dev::db::DatabaseFace* _utxoDB) :
+    nDepth(_nDepth), coinsDB(_coinsDB), stateDB(_stateDB), utxoDB(_utxoDB), fStop(false)
+{
+    thread = std::thread(&TraceThread<std::function<void()>>, "prefetch", std::function<void()>(std::bind(&BlockPrefetcher::ThreadPrefetch, this)));
+}
+
+BlockPrefetcher::~BlockPrefetcher()
+{
+    {
+        LOCK(cs);
+        fStop = true;
+        cond.notify_all();
+    }
+    thread.join();
+}
+
+void BlockPrefetcher::Schedule(const CBlockIndex* pindexTip, const CBlockIndex* pindexMostWork)
+{
+    AssertLockHeld(cs_main);
+
+    int nTipHeight = pindexTip ? pindexTip->nHeight : -1;
+    int nLastHeight = std::min<int>(nTipHeight + nDepth, pindexMostWork->nHeight);
+    std::deque<Job> jobs;
+    for (const CBlockIndex* pindex = pindexMostWork->GetAncestor(nLastHeight); pindex && pindex->nHeight > nTipHeight; pindex = pindex->pprev) {
+        // ActivateBestChainStep stops at the first block it does not have
+        if (!(pindex->nStatus & BLOCK_HAVE_DATA))
+            jobs.clear();
+        else
+            jobs.push_front(Job{pindex->GetBlockHash(), pindex->GetBlockPos(),
+                                pindexTip ? pindexTip->hashStateRoot : uint256(), pindexTip ? pindexTip->hashUTXORoot : uint256()});
+    }
+
+    LOCK(cs);
+    // Forget the blocks that are no longer ahead of the tip, or were not taken after a reorg
+    std::map<uint256, std::shared_ptr<const CBlock>> mapKeep;
+    queue.clear();
+    for (Job& job : jobs) {
+        auto it = mapBlocks.find(job.hash);
+        if (it != mapBlocks.end())
+            mapKeep.insert(*it);
+        else if (job.hash != hashReading)
+            queue.push_back(std::move(job));
+    }
+    mapBlocks.swap(mapKeep);
+    cond.notify_one();
+}
+
+std::shared_ptr<const CBlock> BlockPrefetcher::Take(const uint256& hash)
+{
+    LOCK(cs);
+    auto it = mapBlocks.find(hash);
+    if (it == mapBlocks.end())
+        return nullptr;
+    std::shared_ptr<const CBlock> pblock = std::move(it->second);
+    mapBlocks.erase(it);
+    cond.notify_one();
+    return pblock;
+}
+
+void BlockPrefetcher::ThreadPrefetch()
+{
+    while (true) {
+        Job job;
+        {
+            WAIT_LOCK(cs, lock);
+            hashReading.SetNull();
+            while (!fStop && (queue.empty() || mapBlocks.size() >= nDepth))
+                cond.wait(lock);
+            if (fStop)
+                return;
+            job = std::move(queue.front());
+            queue.pop_front();
+            hashReading = job.hash;
+        }
+
+        std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+        if (!ReadBlockFromDisk(*pblock, job.pos, Params().GetConsensus()) || pblock->GetHash() != job.hash)
+            continue;
+        Prefetch(*pblock, job);
+
+        LOCK(cs);
+        mapBlocks.emplace(job.hash, std::move(pblock));
+    }
+}
+
+void BlockPrefetcher::Prefetch(const CBlock& block, const Job& job) const
+{
+    // Outputs created by the blocks in between are not in the database yet; those
+    // lookups fail fast on the bloom filters of LevelDB.
+    for (const CTransactionRef& tx : block.vtx) {
+        if (!tx->IsCoinBase()) {
+            for (const CTxIn& txin : tx->vin) {
+                Coin coin;
+                coinsDB->GetCoin(txin.prevout, coin);
+            }
+        }
+    }
+
+    if (job.hashStateRoot.IsNull() || job.hashUTXORoot.IsNull())
+        return;
+    std::set<dev::Address> setFetched;
+    const std::shared_ptr<ContractAccessHistory> accesses = GetContractAccessHistory();
+    for (const CTransactionRef& tx : block.vtx) {
+        if (!tx->HasCreateOrCall())
+            continue;
+        for (const CTxOut& txout : tx->vout) {
+            dev::Address address;
+            if (!txout.scriptPubKey.HasOpCall() || !GetCalledContract(txout.scriptPubKey, address))
+                continue;
+            ContractAccessHistory::Entry history;
+            bool fHistory = accesses && accesses->Get(address, history);
+            PrefetchContract(address, job, fHistory ? &history : nullptr, setFetched);
+            if (!fHistory)
+                continue;
+            // The contracts the previous calls went on to, with the slots they used
+            for (const dev::Address& callee : history.callees) {
+                ContractAccessHistory::Entry calleeHistory;
+                if (accesses->Get(callee, calleeHistory))
+                    PrefetchContract(callee, job, &calleeHistory, setFetched);
+            }
+        }
+    }
+}
+
+void BlockPrefetcher::PrefetchContract(const dev::Address& address, const Job& job, const ContractAccessHistory::Entry* history, std::set<dev::Address>& setFetched) const
+{
+    if (!setFetched.insert(address).second)
+        return;
+
+    // Both tries are secure tries keyed by the hash of the address
+    dev::h256 key = dev::sha3(address);
+    std::string value;
+    if (LookupStateTrie(*stateDB, uintToh256(job.hashStateRoot), key, value)) {
+        // Accounts are RLP lists of [nonce, balance, storageRoot, codeHash]
+        dev::RLP account(value);
+        if (account.isList() && account.itemCount() >= 4) {
+            dev::h256 storageRoot = account[2].toHash<dev::h256>();
+            dev::h256 codeHash = account[3].toHash<dev::h256>();
+            stateDB->lookup(dev::db::Slice(reinterpret_cast<const char*>(storageRoot.data()), storageRoot.size));
+            stateDB->lookup(dev::db::Slice(reinterpret_cast<const char*>(codeHash.data()), codeHash.size));
+            // Read the paths of the slots the recent executions used, EVM storage reads
+            // otherwise fetch them one node at a time
+            if (history) {
+                std::string slot;
+                for (const dev::h256& slotKey : history->slots)
+                    LookupStateTrie(*stateDB, storageRoot, slotKey, slot);
+            }
+        }
+    }
+    LookupStateTrie(*utxoDB, uintToh256(job.hashUTXORoot), key, value);
+}
@@ -0,0 +1,96 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BLOCKPREFETCH_H
+#define BLOCKPREFETCH_H
+
+#include <chain.h>
+#include <primitives/block.h>
+#include <qtum/qtumaccesshistory.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <thread>
+
+class CCoinsView;
+
+extern CCriticalSection cs_main;
+
+namespace dev { namespace db { class DatabaseFace; } }
+
+/** Default for -prefetchblocks, the number of blocks read ahead of the tip during IBD (0 = off) */
+static const int DEFAULT_PREFETCH_BLOCKS = 0;
+/** Maximum for -prefetchblocks */
+static const int MAX_PREFETCH_BLOCKS = 1024;
+
+/**
+ * Read-ahead of the blocks that ActivateBestChainStep is about to connect.
+ *
+ * During initial block download every ConnectBlock waits on LevelDB reads of the coins
+ * it spends and of the trie nodes of the contracts it calls, one read at a time. A
+ * background thread reads the next blocks from disk and looks up their inputs in the
+ * coins database and the accounts of their called contracts in the state tries, so that
+ * the reads of ConnectBlock hit the LevelDB block cache and the trie node caches of
+ * the state databases. The coins cache of the tip is not touched: it is only safe to
+ * use under cs_main. The deserialized blocks are handed to ConnectTip, which would
+ * otherwise read them again.
+ *
+ * Contract accounts are looked up at the state of the tip when the blocks are scheduled.
+ * Nodes changed by the blocks in between are already cached from their connection.
+ * The storage slots the recent executions of the called contracts used, and the other
+ * contracts they went on to call, are read too, from the ContractAccessHistory.
+ */
+class BlockPrefetcher
+{
+public:
+    BlockPrefetcher(int _nDepth, const CCoinsView* _coinsDB, const dev::db::DatabaseFace* _stateDB, const dev::db::DatabaseFace* _utxoDB);
+    ~BlockPrefetcher();
+
+    /** Read ahead the next blocks on the way from pindexTip to pindexMostWork */
+    void Schedule(const CBlockIndex* pindexTip, const CBlockIndex* pindexMostWork) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+    /** The block with the given hash if it was read ahead, nullptr otherwise */
+    std::shared_ptr<const CBlock> Take(const uint256& hash);
+
+private:
+    struct Job
+    {
+        uint256 hash;
+        CDiskBlockPos pos;
+        uint256 hashStateRoot;
+        uint256 hashUTXORoot;
+    };
+
+    void ThreadPrefetch();
+    void Prefetch(const CBlock& block, const Job& job) const;
+    /** Read the account, code and UTXO entry of a contract, and the slots of its history if set */
+    void PrefetchContract(const dev::Address& address, const Job& job, const ContractAccessHistory::Entry* history, std::set<dev::Address>& setFetched) const;
+
+    const size_t nDepth;
+    const CCoinsView* coinsDB;
+    const dev::db::DatabaseFace* stateDB;
+    const dev::db::DatabaseFace* utxoDB;
+
+    Mutex cs;
+    std::condition_variable cond;
+    //! Blocks to read, in connection order
+    std::deque<Job> queue GUARDED_BY(cs);
+    //! Blocks read and not yet taken, at most nDepth of them
+    std::map<uint256, std::shared_ptr<const CBlock>> mapBlocks GUARDED_BY(cs);
+    //! Block being read by the thread
+    uint256 hashReading GUARDED_BY(cs);
+    bool fStop GUARDED_BY(cs);
+
+    std::thread thread;
+};
+
+/** Read-ahead of connected blocks, if -prefetchblocks is set */
+extern std::unique_ptr<BlockPrefetcher> pblockprefetcher;
+
+#endif
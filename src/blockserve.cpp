@@ -0,0 +1,107 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockserve.h>
+#include <util/system.h>
+
+std::unique_ptr<BlockServer> g_blockserver;
+RawBlockCache g_raw_block_cache(RAW_BLOCK_CACHE_SIZE);
+
+BlockServer::BlockServer(int nThreads, std::function<void()> _notify) :
+    notify(std::move(_notify)), fStop(false)
+{
+    for (int i = 0; i < nThreads; i++)
+        threads.emplace_back(&TraceThread<std::function<void()>>, "blockserve", std::function<void()>(std::bind(&BlockServer::ThreadServe, this)));
+}
+
+BlockServer::~BlockServer()
+{
+    Stop();
+}
+
+void BlockServer::Stop()
+{
+    {
+        LOCK(cs);
+        fStop = true;
+        cond.notify_all();
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+    threads.clear();
+}
+
+void BlockServer::Submit(NodeId node, std::function<void()> reply)
+{
+    LOCK(cs);
+    setBusy.insert(node);
+    queue.emplace_back(node, std::move(reply));
+    cond.notify_one();
+}
+
+bool BlockServer::IsBusy(NodeId node)
+{
+    LOCK(cs);
+    return setBusy.count(node) > 0;
+}
+
+void BlockServer::RemoveNode(NodeId node)
+{
+    LOCK(cs);
+    setBusy.erase(node);
+}
+
+void BlockServer::ThreadServe()
+{
+    while (true) {
+        std::pair<NodeId, std::function<void()>> job;
+        {
+            WAIT_LOCK(cs, lock);
+            while (!fStop && queue.empty())
+                cond.wait(lock);
+            if (fStop)
+                return;
+            job = std::move(queue.front());
+            queue.pop_front();
+            // The peer is gone, nobody will get the reply
+            if (!setBusy.count(job.first))
+                continue;
+        }
+
+        job.second();
+
+        {
+            LOCK(cs);
+            setBusy.erase(job.first);
+        }
+        notify();
+    }
+}
+
+std::shared_ptr<const std::vector<uint8_t>> RawBlockCache::Get(const uint256& hash)
+{
+    LOCK(cs);
+    auto it = mapEntries.find(hash);
+    if (it == mapEntries.end())
+        return nullptr;
+    listEntries.splice(listEntries.begin(), listEntries, it->second);
+    return it->second->second;
+}
+
+void RawBlockCache::Add(const uint256& hash, std::shared_ptr<const std::vector<uint8_t>> data)
+{
+    if (data->size() > nMaxBytes / 4)
+        return;
+    LOCK(cs);
+    if (mapEntries.count(hash))
+        return;
+    nBytes += data->size();
+    listEntries.emplace_front(hash, std::move(data));
+    mapEntries.emplace(hash, listEntries.begin());
+    while (nBytes > nMaxBytes) {
+        nBytes -= listEntries.back().second->size();
+        mapEntries.erase(listEntries.back().first);
+        listEntries.pop_back();
+    }
+}
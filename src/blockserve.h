@@ -0,0 +1,110 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BLOCKSERVE_H
+#define BLOCKSERVE_H
+
+#include <net.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+/** Default for -blockservethreads, the number of threads reading the blocks requested by peers (0 = off) */
+static const int DEFAULT_BLOCK_SERVE_THREADS = 0;
+/** Maximum for -blockservethreads */
+static const int MAX_BLOCK_SERVE_THREADS = 16;
+/** Size of the cache of the raw blocks recently sent to peers, in bytes */
+static const size_t RAW_BLOCK_CACHE_SIZE = 32 << 20;
+
+/**
+ * Threads serving the block data requested by peers: the blocks of getdata and the
+ * transactions of getblocktxn, when they are not the most recent block.
+ *
+ * The message handler reads these blocks from disk under cs_main, so a peer syncing
+ * from us delays the messages of all the other peers, our own tx relay included. The
+ * message handler still checks each request under cs_main and hands the disk read and
+ * the sending of the reply over to the block server threads, which do not take
+ * cs_main. A peer has at most one reply queued, and its next messages wait for the
+ * reply to be sent, so that the replies keep the order of the requests.
+ */
+class BlockServer
+{
+public:
+    BlockServer(int nThreads, std::function<void()> _notify);
+    ~BlockServer();
+
+    /** Queue the reply to a request of a peer, the peer is busy until it is sent */
+    void Submit(NodeId node, std::function<void()> reply);
+
+    /** Whether a reply to the peer is queued or being sent */
+    bool IsBusy(NodeId node);
+
+    /** Forget the reply of a disconnected peer */
+    void RemoveNode(NodeId node);
+
+    /** Stop the threads, before the connection manager deletes the peers they send to */
+    void Stop();
+
+private:
+    void ThreadServe();
+
+    const std::function<void()> notify;
+
+    Mutex cs;
+    std::condition_variable cond;
+    //! Replies not yet taken by a thread, in submission order
+    std::deque<std::pair<NodeId, std::function<void()>>> queue GUARDED_BY(cs);
+    //! Peers with a reply queued or being sent
+    std::set<NodeId> setBusy GUARDED_BY(cs);
+    bool fStop GUARDED_BY(cs);
+
+    std::vector<std::thread> threads;
+};
+
+/** Block server threads, if -blockservethreads is set */
+extern std::unique_ptr<BlockServer> g_blockserver;
+
+/**
+ * LRU cache of the raw blocks recently sent to peers, as read from the block files.
+ *
+ * Peers syncing from us at the same time ask for the same blocks a moment apart, and a
+ * peer that requests a block again after a stall or a reconnection does too. The cache
+ * serves them without reading the block from disk again. Blocks larger than a quarter
+ * of the cache are not kept.
+ */
+class RawBlockCache
+{
+public:
+    explicit RawBlockCache(size_t nMaxBytesIn) : nMaxBytes(nMaxBytesIn), nBytes(0) {}
+
+    /** The raw block with the given hash if it is cached, nullptr otherwise */
+    std::shared_ptr<const std::vector<uint8_t>> Get(const uint256& hash);
+
+    /** Add a raw block, dropping the least recently used ones beyond the size of the cache */
+    void Add(const uint256& hash, std::shared_ptr<const std::vector<uint8_t>> data);
+
+private:
+    typedef std::list<std::pair<uint256, std::shared_ptr<const std::vector<uint8_t>>>> EntryList;
+
+    const size_t nMaxBytes;
+    Mutex cs;
+    //! Most recently used blocks at the front
+    EntryList listEntries GUARDED_BY(cs);
+    std::map<uint256, EntryList::iterator> mapEntries GUARDED_BY(cs);
+    size_t nBytes GUARDED_BY(cs);
+};
+
+/** Raw blocks recently sent in reply to getdata */
+extern RawBlockCache g_raw_block_cache;
+
+#endif
@@ -5,12 +5,15 @@
 #include <bloom.h>
 
 #include <primitives/transaction.h>
+#include <crypto/siphash.h>
 #include <hash.h>
 #include <script/script.h>
 #include <script/standard.h>
 #include <random.h>
 #include <streams.h>
 
+#include <algorithm>
+#include <limits>
 #include <math.h>
 #include <stdlib.h>
 
@@ -308,3 +311,111 @@ void CRollingBloomFilter::reset()
         *it = 0;
     }
 }
+
+double CBlockedRollingBloomFilter::FalsePositiveRate(uint32_t nElements, uint32_t nBlocks, int nHashFuncs)
+{
+    /* The number of entries of a block is about Poisson distributed, a block with j
+     * entries has a false positive rate of pow(1 - pow(1 - 1 / BLOCK_BITS, nHashFuncs * j), nHashFuncs). */
+    const double lambda = (double)nElements / nBlocks;
+    const double logBitUnset = log(1.0 - 1.0 / BLOCK_BITS);
+    const uint32_t nMaxEntries = (uint32_t)ceil(lambda + 12.0 * sqrt(lambda) + 20.0);
+    double logPoisson = -lambda;
+    double fpRate = 0;
+    for (uint32_t j = 0; j <= nMaxEntries; j++) {
+        if (j > 0) {
+            logPoisson += log(lambda / j);
+        }
+        fpRate += exp(logPoisson) * pow(1.0 - exp(logBitUnset * nHashFuncs * j), nHashFuncs);
+    }
+    return fpRate;
+}
+
+CBlockedRollingBloomFilter::CBlockedRollingBloomFilter(const unsigned int nElements, const double fpRate)
+{
+    /* All generations but the one being filled hold the last nElements entries, and a
+     * lookup is a false positive if it is one in any generation. */
+    nEntriesPerGeneration = std::max(1u, (nElements + GENERATIONS - 2) / (GENERATIONS - 1));
+    double logFpRate = log(fpRate / GENERATIONS);
+    nHashFuncs = std::max(1, std::min((int)round(logFpRate / log(0.5)), 50));
+    /* Start from the size of an unblocked filter, see CRollingBloomFilter, and grow it
+     * until the unevenly filled blocks give the rate. */
+    uint32_t nFilterBits = (uint32_t)ceil(-1.0 * nHashFuncs * nEntriesPerGeneration / log(1.0 - exp(logFpRate / nHashFuncs)));
+    nBlocks = std::max<uint32_t>(1, (nFilterBits + BLOCK_BITS - 1) / BLOCK_BITS);
+    while (FalsePositiveRate(nEntriesPerGeneration, nBlocks, nHashFuncs) > fpRate / GENERATIONS) {
+        nBlocks += nBlocks / 32 + 1;
+    }
+    data.clear();
+    data.resize((size_t)nBlocks * GENERATIONS * BLOCK_WORDS);
+    reset();
+}
+
+uint32_t CBlockedRollingBloomFilter::Masks(const uint256& hash, uint64_t (&masks)[BLOCK_WORDS]) const
+{
+    uint64_t h = SipHashUint256(k0, k1, hash);
+    uint32_t block = FastMod(h >> 32, nBlocks);
+    for (unsigned int w = 0; w < BLOCK_WORDS; w++) {
+        masks[w] = 0;
+    }
+    /* The positions are 9 bit chunks of a splitmix64 sequence seeded with the hash, seven per output */
+    uint64_t state = h;
+    uint64_t bits = 0;
+    int nChunks = 0;
+    for (int n = 0; n < nHashFuncs; n++) {
+        if (nChunks == 0) {
+            uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            bits = z ^ (z >> 31);
+            nChunks = 7;
+        }
+        unsigned int pos = bits & (BLOCK_BITS - 1);
+        bits >>= 9;
+        nChunks--;
+        masks[pos >> 6] |= ((uint64_t)1) << (pos & 63);
+    }
+    return block;
+}
+
+void CBlockedRollingBloomFilter::insert(const uint256& hash)
+{
+    if (nEntriesThisGeneration == nEntriesPerGeneration) {
+        /* Wipe the oldest generation and fill it next. */
+        nEntriesThisGeneration = 0;
+        nGeneration = (nGeneration + 1) % GENERATIONS;
+        for (size_t p = (size_t)nGeneration * BLOCK_WORDS; p < data.size(); p += GENERATIONS * BLOCK_WORDS) {
+            std::fill(data.begin() + p, data.begin() + p + BLOCK_WORDS, 0);
+        }
+    }
+    nEntriesThisGeneration++;
+
+    uint64_t masks[BLOCK_WORDS];
+    uint64_t* words = &data[((size_t)Masks(hash, masks) * GENERATIONS + nGeneration) * BLOCK_WORDS];
+    for (unsigned int w = 0; w < BLOCK_WORDS; w++) {
+        words[w] |= masks[w];
+    }
+}
+
+bool CBlockedRollingBloomFilter::contains(const uint256& hash) const
+{
+    uint64_t masks[BLOCK_WORDS];
+    const uint64_t* words = &data[(size_t)Masks(hash, masks) * GENERATIONS * BLOCK_WORDS];
+    for (unsigned int g = 0; g < GENERATIONS; g++, words += BLOCK_WORDS) {
+        uint64_t missing = 0;
+        for (unsigned int w = 0; w < BLOCK_WORDS; w++) {
+            missing |= masks[w] & ~words[w];
+        }
+        if (missing == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void CBlockedRollingBloomFilter::reset()
+{
+    k0 = GetRand(std::numeric_limits<uint64_t>::max());
+    k1 = GetRand(std::numeric_limits<uint64_t>::max());
+    nEntriesThisGeneration = 0;
+    nGeneration = 0;
+    std::fill(data.begin(), data.end(), 0);
+}
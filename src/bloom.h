@@ -136,4 +136,52 @@ private:
     int nHashFuncs;
 };
 
+/**
+ * A rolling bloom filter of hashes for the filters kept per peer. Instead of the two
+ * generation bits per position of CRollingBloomFilter it keeps GENERATIONS plain
+ * filters and clears the oldest one when the newest is full, which needs about a
+ * third less memory for the same false positive rate. The bits of a key are all in
+ * one block of 512 positions (64 bytes), so a key is hashed once, an insert touches
+ * one block and a lookup the adjacent blocks of the generations.
+ * The filter is sized for the false positive rate of its unevenly filled blocks.
+ *
+ * As with CRollingBloomFilter, don't create global objects of it.
+ */
+class CBlockedRollingBloomFilter
+{
+public:
+    //! Remembers at least the last nElements entries
+    CBlockedRollingBloomFilter(const unsigned int nElements, const double nFPRate);
+
+    void insert(const uint256& hash);
+    bool contains(const uint256& hash) const;
+
+    void reset();
+
+    /** Size of the filter in bytes */
+    size_t DynamicMemoryUsage() const { return data.size() * sizeof(uint64_t); }
+
+    static const unsigned int BLOCK_BITS = 512;
+    static const unsigned int BLOCK_WORDS = BLOCK_BITS / 64;
+    static const unsigned int GENERATIONS = 4;
+
+    /** Expected false positive rate of a plain filter with nElements spread over nBlocks blocks with nHashFuncs bits each */
+    static double FalsePositiveRate(uint32_t nElements, uint32_t nBlocks, int nHashFuncs);
+
+private:
+    /** The positions of hash as bit masks of the words of a block, returns the block */
+    uint32_t Masks(const uint256& hash, uint64_t (&masks)[BLOCK_WORDS]) const;
+
+    uint32_t nEntriesPerGeneration;
+    uint32_t nEntriesThisGeneration;
+    //! The generation entries are inserted in
+    unsigned int nGeneration;
+    uint32_t nBlocks;
+    //! The words of generation g of block b start at data[(b * GENERATIONS + g) * BLOCK_WORDS]
+    std::vector<uint64_t> data;
+    uint64_t k0;
+    uint64_t k1;
+    int nHashFuncs;
+};
+
 #endif // BITCOIN_BLOOM_H
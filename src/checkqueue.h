@@ -8,6 +8,9 @@
 #include <sync.h>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
 #include <vector>
 
 #include <boost/thread/condition_variable.hpp>
@@ -25,12 +28,31 @@ class CCheckQueueControl;
   * onto the queue, where they are processed by N-1 worker threads. When
   * the master is done adding work, it temporarily joins the worker pool
   * as an N'th worker, until all jobs are done.
+  *
+  * Each worker has its own queue, and steals from the others when it is
+  * empty, so the workers don't contend on one lock.
   */
 template <typename T>
 class CCheckQueue
 {
 private:
-    //! Mutex to protect the inner state
+    //! Number of per-worker queues. The master uses slot 0, workers beyond the
+    //! last slot share theirs with earlier workers.
+    static const unsigned int MAX_QUEUE_SLOTS = 64;
+
+    //! Batches are sized to take about this long, by the measured cost of a check
+    static const int64_t TARGET_BATCH_NANOS = 200000;
+
+    //! The checks queued for one worker. The owner takes them from the back
+    //! (as the order of booleans doesn't matter), idle workers steal from the front.
+    struct QueueSlot {
+        boost::mutex mutex;
+        std::deque<T> checks;
+    };
+
+    QueueSlot slots[MAX_QUEUE_SLOTS];
+
+    //! Mutex for the condition variables, the queues have their own
     boost::mutex mutex;
 
     //! Worker threads block on this when out of work
@@ -39,87 +61,118 @@ private:
     //! Master thread blocks on this when out of work
     boost::condition_variable condMaster;
 
-    //! The queue of elements to be processed.
-    //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
-    std::vector<T> queue;
-
-    //! The number of workers (including the master) that are idle.
-    int nIdle;
+    //! The number of worker threads that have started (excluding the master)
+    std::atomic<unsigned int> nWorkers;
 
-    //! The total number of workers (including the master).
-    int nTotal;
+    //! The number of elements in the queues
+    std::atomic<unsigned int> nQueued;
 
     //! The temporary evaluation result.
-    bool fAllOk;
+    std::atomic<bool> fAllOk;
 
     /**
      * Number of verifications that haven't completed yet.
      * This includes elements that are no longer queued, but still in the
      * worker's own batches.
      */
-    unsigned int nTodo;
+    std::atomic<unsigned int> nTodo;
+
+    //! Moving average of the time a check takes, 0 until measured
+    std::atomic<int64_t> nCheckNanos;
 
     //! The maximum number of elements to be processed in one batch
     unsigned int nBatchSize;
 
+    //! The slot the next batch of Add goes to, only used by the master
+    unsigned int nNextSlot;
+
+    unsigned int SlotCount() const
+    {
+        return std::min(MAX_QUEUE_SLOTS, nWorkers.load() + 1);
+    }
+
+    /**
+     * Move a batch of checks into vChecks, from the own queue of the worker or
+     * stolen from another. Returns false if all queues are empty.
+     */
+    bool Take(unsigned int nSlot, std::vector<T>& vChecks)
+    {
+        // Decide how many work units to process now.
+        // * Aim for batches of about TARGET_BATCH_NANOS; until a check is measured take one at a time.
+        // * Leave half of a queue for the workers that steal from it, so all finish approximately simultaneously.
+        // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
+        int64_t nCost = nCheckNanos.load(std::memory_order_relaxed);
+        unsigned int nTarget = nCost > 0 ? (unsigned int)std::min<int64_t>(nBatchSize, TARGET_BATCH_NANOS / nCost) : 1;
+        const unsigned int nSlots = SlotCount();
+        for (unsigned int i = 0; i < nSlots; i++) {
+            QueueSlot& slot = slots[(nSlot + i) % nSlots];
+            boost::unique_lock<boost::mutex> lock(slot.mutex);
+            if (slot.checks.empty())
+                continue;
+            unsigned int nNow = std::max(1U, std::min(nTarget, (unsigned int)slot.checks.size() / 2));
+            vChecks.resize(nNow);
+            for (unsigned int j = 0; j < nNow; j++) {
+                // We want the lock on the mutex to be as short as possible, so swap jobs from the
+                // queue to the local batch vector instead of copying.
+                if (i == 0) {
+                    vChecks[j].swap(slot.checks.back());
+                    slot.checks.pop_back();
+                } else {
+                    vChecks[j].swap(slot.checks.front());
+                    slot.checks.pop_front();
+                }
+            }
+            nQueued -= nNow;
+            return true;
+        }
+        return false;
+    }
+
     /** Internal function that does bulk of the verification work. */
     bool Loop(bool fMaster = false)
     {
+        const unsigned int nSlot = fMaster ? 0 : 1 + nWorkers++ % (MAX_QUEUE_SLOTS - 1);
         boost::condition_variable& cond = fMaster ? condMaster : condWorker;
         std::vector<T> vChecks;
         vChecks.reserve(nBatchSize);
-        unsigned int nNow = 0;
-        bool fOk = true;
         do {
-            {
-                boost::unique_lock<boost::mutex> lock(mutex);
-                // first do the clean-up of the previous loop run (allowing us to do it in the same critsect)
-                if (nNow) {
-                    fAllOk &= fOk;
-                    nTodo -= nNow;
-                    if (nTodo == 0 && !fMaster)
-                        // We processed the last element; inform the master it can exit and return the result
-                        condMaster.notify_one();
-                } else {
-                    // first iteration
-                    nTotal++;
-                }
-                // logically, the do loop starts here
-                while (queue.empty()) {
-                    if (fMaster && nTodo == 0) {
-                        nTotal--;
-                        bool fRet = fAllOk;
-                        // reset the status for new work later
-                        if (fMaster)
-                            fAllOk = true;
-                        // return the current status
-                        return fRet;
-                    }
-                    nIdle++;
-                    cond.wait(lock); // wait
-                    nIdle--;
+            if (Take(nSlot, vChecks)) {
+                const unsigned int nNow = vChecks.size();
+                // Check whether we need to do work at all
+                const bool fRun = fAllOk;
+                bool fOk = fRun;
+                const auto start = std::chrono::steady_clock::now();
+                // execute work
+                for (T& check : vChecks)
+                    if (fOk)
+                        fOk = check();
+                if (fRun && fOk) {
+                    int64_t nSample = std::max<int64_t>(1, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() / nNow);
+                    int64_t nCost = nCheckNanos.load(std::memory_order_relaxed);
+                    nCheckNanos.store(nCost > 0 ? nCost + (nSample - nCost) / 8 : nSample, std::memory_order_relaxed);
                 }
-                // Decide how many work units to process now.
-                // * Do not try to do everything at once, but aim for increasingly smaller batches so
-                //   all workers finish approximately simultaneously.
-                // * Try to account for idle jobs which will instantly start helping.
-                // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
-                nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.size() / (nTotal + nIdle + 1)));
-                vChecks.resize(nNow);
-                for (unsigned int i = 0; i < nNow; i++) {
-                    // We want the lock on the mutex to be as short as possible, so swap jobs from the global
-                    // queue to the local batch vector instead of copying.
-                    vChecks[i].swap(queue.back());
-                    queue.pop_back();
+                vChecks.clear();
+                if (!fOk)
+                    fAllOk = false;
+                if (nTodo.fetch_sub(nNow) == nNow && !fMaster) {
+                    // We processed the last element; inform the master it can exit and return the result
+                    boost::unique_lock<boost::mutex> lock(mutex);
+                    condMaster.notify_one();
                 }
-                // Check whether we need to do work at all
-                fOk = fAllOk;
+                continue;
+            }
+            boost::unique_lock<boost::mutex> lock(mutex);
+            // Add and the last worker notify under this lock, after updating the counters
+            if (nQueued != 0)
+                continue;
+            if (fMaster && nTodo == 0) {
+                bool fRet = fAllOk;
+                // reset the status for new work later
+                fAllOk = true;
+                // return the current status
+                return fRet;
             }
-            // execute work
-            for (T& check : vChecks)
-                if (fOk)
-                    fOk = check();
-            vChecks.clear();
+            cond.wait(lock); // wait
         } while (true);
     }
 
@@ -128,7 +181,7 @@ public:
     boost::mutex ControlMutex;
 
     //! Create a new check queue
-    explicit CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), nBatchSize(nBatchSizeIn) {}
+    explicit CCheckQueue(unsigned int nBatchSizeIn) : nWorkers(0), nQueued(0), fAllOk(true), nTodo(0), nCheckNanos(0), nBatchSize(nBatchSizeIn), nNextSlot(0) {}
 
     //! Worker thread
     void Thread()
@@ -145,15 +198,23 @@ public:
     //! Add a batch of checks to the queue
     void Add(std::vector<T>& vChecks)
     {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        for (T& check : vChecks) {
-            queue.push_back(T());
-            check.swap(queue.back());
-        }
+        if (vChecks.empty())
+            return;
         nTodo += vChecks.size();
+        {
+            // Spread the batches over the workers, the idle ones steal the rest
+            QueueSlot& slot = slots[nNextSlot++ % SlotCount()];
+            boost::unique_lock<boost::mutex> lock(slot.mutex);
+            for (T& check : vChecks) {
+                slot.checks.push_back(T());
+                check.swap(slot.checks.back());
+            }
+            nQueued += vChecks.size();
+        }
+        boost::unique_lock<boost::mutex> lock(mutex);
         if (vChecks.size() == 1)
             condWorker.notify_one();
-        else if (vChecks.size() > 1)
+        else
             condWorker.notify_all();
     }
 
@@ -11,6 +11,7 @@
 #include <core_memusage.h>
 #include <crypto/siphash.h>
 #include <memusage.h>
+#include <support/allocators/pool.h>
 #include <serialize.h>
 #include <uint256.h>
 
@@ -46,6 +47,10 @@ struct CSpentIndexKey {
         txid.SetNull();
         outputIndex = 0;
     }
+
+    friend bool operator==(const CSpentIndexKey& a, const CSpentIndexKey& b) {
+        return a.txid == b.txid && a.outputIndex == b.outputIndex;
+    }
 };
 
 struct CSpentIndexValue {
@@ -203,7 +208,18 @@ struct CCoinsCacheEntry
     explicit CCoinsCacheEntry(Coin&& coin_) : coin(std::move(coin_)), flags(0) {}
 };
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
+/**
+ * The nodes of the coins cache come from a PoolResource instead of one malloc each:
+ * this saves the allocator overhead of every node and keeps the nodes packed in large
+ * chunks. The largest block is sized for a node, a pair plus the next pointer and
+ * cached hash of the map, with room to spare for other standard library layouts.
+ */
+typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher, std::equal_to<COutPoint>,
+                           PoolAllocator<std::pair<const COutPoint, CCoinsCacheEntry>,
+                                         sizeof(std::pair<const COutPoint, CCoinsCacheEntry>) + sizeof(void*) * 4,
+                                         alignof(void*)>> CCoinsMap;
+
+typedef CCoinsMap::allocator_type::ResourceType CCoinsMapMemoryResource;
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
@@ -290,6 +306,8 @@ protected:
      * declared as "const".
      */
     mutable uint256 hashBlock;
+    //! Backs the nodes of cacheCoins, so it is declared first and outlives it
+    mutable CCoinsMapMemoryResource m_cache_coins_memory_resource;
     mutable CCoinsMap cacheCoins;
 
     /* Cached dynamic memory usage for the inner Coin objects. */
@@ -352,6 +370,13 @@ public:
      */
     bool Flush();
 
+    /**
+     * Push the modifications applied to this cache to its base like Flush, but keep the
+     * unspent coins in the cache, no longer marked dirty or fresh. The spent coins are
+     * removed, the base has them from now on.
+     */
+    bool Sync();
+
     /**
      * Removes the UTXO with the given outpoint from the cache, if it is
      * not modified.
@@ -383,6 +408,9 @@ public:
 
 private:
     CCoinsMap::iterator FetchCoin(const COutPoint &outpoint) const;
+
+    //! Give the memory of the empty cache back, which the pool would otherwise keep
+    void ReallocateCache();
 };
 
 //! Utility function to add all of a transaction's outputs to a cache.
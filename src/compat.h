@@ -95,6 +95,14 @@ typedef char* sockopt_arg_type;
 #define USE_POLL
 #endif
 
+// The socket handler of the connection manager waits on a persistent epoll or kqueue
+// registration of its sockets where there is one
+#if defined(__linux__)
+#define USE_EPOLL
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__DragonFly__)
+#define USE_KQUEUE
+#endif
+
 bool static inline IsSelectableSocket(const SOCKET& s) {
 #if defined(USE_POLL) || defined(WIN32)
     return true;
@@ -0,0 +1,251 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <crypto/keccak.h>
+#include <crypto/common.h>
+
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__amd64__) || defined(__i386__)
+#if defined(USE_ASM)
+#include <cpuid.h>
+#endif
+#endif
+
+namespace keccak_avx2
+{
+void Permute_4way(uint64_t* state);
+}
+
+namespace
+{
+/** Round constants of Keccak-f[1600] */
+const uint64_t RC[24] = {
+    0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL, 0x8000000080008000ULL,
+    0x000000000000808bULL, 0x0000000080000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
+    0x000000000000008aULL, 0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
+    0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL, 0x8000000000008003ULL,
+    0x8000000000008002ULL, 0x8000000000000080ULL, 0x000000000000800aULL, 0x800000008000000aULL,
+    0x8000000080008081ULL, 0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL};
+
+/** Rotation of each lane in the rho step, in the order the pi step visits them */
+const int ROTC[24] = {1, 3, 6, 10, 15, 21, 28, 36, 45, 55, 2, 14, 27, 41, 56, 8, 25, 43, 62, 18, 39, 61, 20, 44};
+const int PILN[24] = {10, 7, 11, 17, 18, 3, 5, 16, 8, 21, 24, 4, 15, 23, 19, 13, 12, 2, 20, 14, 22, 9, 6, 1};
+
+static inline uint64_t Rotl(uint64_t x, int n) { return (x << n) | (x >> (64 - n)); }
+
+void Permute(uint64_t* st)
+{
+    uint64_t bc[5];
+    for (int round = 0; round < 24; round++) {
+        // Theta
+        for (int i = 0; i < 5; i++)
+            bc[i] = st[i] ^ st[i + 5] ^ st[i + 10] ^ st[i + 15] ^ st[i + 20];
+        for (int i = 0; i < 5; i++) {
+            uint64_t t = bc[(i + 4) % 5] ^ Rotl(bc[(i + 1) % 5], 1);
+            for (int j = 0; j < 25; j += 5)
+                st[j + i] ^= t;
+        }
+
+        // Rho and pi
+        uint64_t t = st[1];
+        for (int i = 0; i < 24; i++) {
+            int j = PILN[i];
+            uint64_t tmp = st[j];
+            st[j] = Rotl(t, ROTC[i]);
+            t = tmp;
+        }
+
+        // Chi
+        for (int j = 0; j < 25; j += 5) {
+            for (int i = 0; i < 5; i++)
+                bc[i] = st[j + i];
+            for (int i = 0; i < 5; i++)
+                st[j + i] ^= (~bc[(i + 1) % 5]) & bc[(i + 2) % 5];
+        }
+
+        // Iota
+        st[0] ^= RC[round];
+    }
+}
+
+/** Permute four interleaved states, state[lane * 4 + n] is lane of the n-th state */
+void Permute_4way(uint64_t* state)
+{
+    uint64_t st[25];
+    for (int n = 0; n < 4; n++) {
+        for (int i = 0; i < 25; i++)
+            st[i] = state[i * 4 + n];
+        Permute(st);
+        for (int i = 0; i < 25; i++)
+            state[i * 4 + n] = st[i];
+    }
+}
+
+void (*PermuteWays)(uint64_t* state) = Permute_4way;
+
+/** Absorb the full block at data into st */
+inline void Absorb(uint64_t* st, const unsigned char* data)
+{
+    for (size_t i = 0; i < KECCAK256_RATE / 8; i++)
+        st[i] ^= ReadLE64(data + 8 * i);
+}
+
+/** The last, padded block of a message of len bytes, whose full blocks are absorbed */
+inline void PadBlock(unsigned char* block, const unsigned char* data, size_t len)
+{
+    size_t tail = len % KECCAK256_RATE;
+    memset(block, 0, KECCAK256_RATE);
+    if (tail)
+        memcpy(block, data + len - tail, tail);
+    block[tail] ^= 0x01;
+    block[KECCAK256_RATE - 1] ^= 0x80;
+}
+
+inline void Squeeze(const uint64_t* st, unsigned char* out)
+{
+    for (int i = 0; i < 4; i++)
+        WriteLE64(out + 8 * i, st[i]);
+}
+
+bool SelfTest()
+{
+    static const unsigned char EMPTY[32] = {
+        0xc5, 0xd2, 0x46, 0x01, 0x86, 0xf7, 0x23, 0x3c, 0x92, 0x7e, 0x7d, 0xb2, 0xdc, 0xc7, 0x03, 0xc0,
+        0xe5, 0x00, 0xb6, 0x53, 0xca, 0x82, 0x27, 0x3b, 0x7b, 0xfa, 0xd8, 0x04, 0x5d, 0x85, 0xa4, 0x70};
+
+    unsigned char out[32];
+    Keccak256(nullptr, 0, out);
+    if (memcmp(out, EMPTY, 32)) return false;
+
+    // The batch path, with messages of different numbers of blocks, against the scalar one
+    unsigned char data[KECCAK256_RATE * 3];
+    for (size_t i = 0; i < sizeof(data); i++)
+        data[i] = i;
+    std::vector<std::pair<const unsigned char*, size_t>> inputs;
+    for (size_t len : {0, 1, 135, 136, 137, 300, 408})
+        inputs.emplace_back(data, len);
+    std::vector<unsigned char> batch(inputs.size() * 32);
+    Keccak256Batch(inputs, batch.data());
+    for (size_t i = 0; i < inputs.size(); i++) {
+        Keccak256(inputs[i].first, inputs[i].second, out);
+        if (memcmp(out, batch.data() + 32 * i, 32)) return false;
+    }
+    return true;
+}
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+// We can't use cpuid.h's __get_cpuid as it does not support subleafs.
+void inline cpuid(uint32_t leaf, uint32_t subleaf, uint32_t& a, uint32_t& b, uint32_t& c, uint32_t& d)
+{
+#ifdef __GNUC__
+    __cpuid_count(leaf, subleaf, a, b, c, d);
+#else
+  __asm__ ("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "0"(leaf), "2"(subleaf));
+#endif
+}
+
+/** Check whether the OS has enabled AVX registers. */
+bool AVXEnabled()
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & 6) == 6;
+}
+#endif
+} // namespace
+
+void Keccak256(const unsigned char* data, size_t len, unsigned char out[32])
+{
+    uint64_t st[25] = {0};
+    size_t done = 0;
+    for (; len - done >= KECCAK256_RATE; done += KECCAK256_RATE) {
+        Absorb(st, data + done);
+        Permute(st);
+    }
+    unsigned char block[KECCAK256_RATE];
+    PadBlock(block, data, len);
+    Absorb(st, block);
+    Permute(st);
+    Squeeze(st, out);
+}
+
+void Keccak256Batch(const std::vector<std::pair<const unsigned char*, size_t>>& inputs, unsigned char* out)
+{
+    size_t i = 0;
+    for (; i + 4 <= inputs.size(); i += 4) {
+        uint64_t state[25 * 4] = {0};
+        size_t blocks[4];
+        size_t maxBlocks = 0;
+        for (int n = 0; n < 4; n++) {
+            blocks[n] = inputs[i + n].second / KECCAK256_RATE + 1;
+            maxBlocks = std::max(maxBlocks, blocks[n]);
+        }
+        for (size_t b = 0; b < maxBlocks; b++) {
+            // A lane past its last block permutes garbage, its output is already taken
+            for (int n = 0; n < 4; n++) {
+                if (b >= blocks[n])
+                    continue;
+                const unsigned char* data = inputs[i + n].first;
+                unsigned char block[KECCAK256_RATE];
+                if (b + 1 == blocks[n]) {
+                    PadBlock(block, data, inputs[i + n].second);
+                    data = block;
+                } else {
+                    data += b * KECCAK256_RATE;
+                }
+                for (size_t l = 0; l < KECCAK256_RATE / 8; l++)
+                    state[l * 4 + n] ^= ReadLE64(data + 8 * l);
+            }
+            PermuteWays(state);
+            for (int n = 0; n < 4; n++) {
+                if (b + 1 != blocks[n])
+                    continue;
+                for (int l = 0; l < 4; l++)
+                    WriteLE64(out + 32 * (i + n) + 8 * l, state[l * 4 + n]);
+            }
+        }
+    }
+    for (; i < inputs.size(); i++)
+        Keccak256(inputs[i].first, inputs[i].second, out + 32 * i);
+}
+
+std::string KeccakAutoDetect()
+{
+    std::string ret = "standard";
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+    bool have_xsave = false;
+    bool have_avx = false;
+    bool have_avx2 = false;
+    bool enabled_avx = false;
+
+    (void)AVXEnabled;
+    (void)have_avx;
+    (void)have_xsave;
+    (void)have_avx2;
+    (void)enabled_avx;
+
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, 0, eax, ebx, ecx, edx);
+    have_xsave = (ecx >> 27) & 1;
+    have_avx = (ecx >> 28) & 1;
+    if (have_xsave && have_avx) {
+        enabled_avx = AVXEnabled();
+        cpuid(7, 0, eax, ebx, ecx, edx);
+        have_avx2 = (ebx >> 5) & 1;
+    }
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_avx2 && have_avx && enabled_avx) {
+        PermuteWays = keccak_avx2::Permute_4way;
+        ret = "avx2(4way)";
+    }
+#endif
+#endif
+
+    assert(SelfTest());
+    return ret;
+}
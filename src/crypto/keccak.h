@@ -0,0 +1,29 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef CRYPTO_KECCAK_H
+#define CRYPTO_KECCAK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+/** Number of bytes of a Keccak-256 block */
+static const size_t KECCAK256_RATE = 136;
+
+/** Keccak-256 with the original Keccak padding, the hash Ethereum calls SHA3 */
+void Keccak256(const unsigned char* data, size_t len, unsigned char out[32]);
+
+/**
+ * Keccak-256 of each input, written one after the other to out, which holds 32 bytes
+ * per input. With AVX2 the permutations of four inputs run at once, one per 64-bit lane.
+ */
+void Keccak256Batch(const std::vector<std::pair<const unsigned char*, size_t>>& inputs, unsigned char* out);
+
+/** Autodetect the best available Keccak-f[1600] implementation. Returns its name. */
+std::string KeccakAutoDetect();
+
+#endif // CRYPTO_KECCAK_H
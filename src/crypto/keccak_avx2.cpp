@@ -0,0 +1,71 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <immintrin.h>
+
+namespace keccak_avx2 {
+namespace {
+
+const uint64_t RC[24] = {
+    0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL, 0x8000000080008000ULL,
+    0x000000000000808bULL, 0x0000000080000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
+    0x000000000000008aULL, 0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
+    0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL, 0x8000000000008003ULL,
+    0x8000000000008002ULL, 0x8000000000000080ULL, 0x000000000000800aULL, 0x800000008000000aULL,
+    0x8000000080008081ULL, 0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL};
+
+const int ROTC[24] = {1, 3, 6, 10, 15, 21, 28, 36, 45, 55, 2, 14, 27, 41, 56, 8, 25, 43, 62, 18, 39, 61, 20, 44};
+const int PILN[24] = {10, 7, 11, 17, 18, 3, 5, 16, 8, 21, 24, 4, 15, 23, 19, 13, 12, 2, 20, 14, 22, 9, 6, 1};
+
+inline __m256i Rotl(__m256i x, int n)
+{
+    return _mm256_or_si256(_mm256_sll_epi64(x, _mm_cvtsi32_si128(n)), _mm256_srl_epi64(x, _mm_cvtsi32_si128(64 - n)));
+}
+
+}
+
+/** The four states are interleaved, state[lane * 4 + n] is lane of the n-th state */
+void Permute_4way(uint64_t* state)
+{
+    __m256i st[25], bc[5];
+    for (int i = 0; i < 25; i++)
+        st[i] = _mm256_loadu_si256((const __m256i*)(state + 4 * i));
+
+    for (int round = 0; round < 24; round++) {
+        for (int i = 0; i < 5; i++)
+            bc[i] = _mm256_xor_si256(_mm256_xor_si256(_mm256_xor_si256(st[i], st[i + 5]), _mm256_xor_si256(st[i + 10], st[i + 15])), st[i + 20]);
+        for (int i = 0; i < 5; i++) {
+            __m256i t = _mm256_xor_si256(bc[(i + 4) % 5], Rotl(bc[(i + 1) % 5], 1));
+            for (int j = 0; j < 25; j += 5)
+                st[j + i] = _mm256_xor_si256(st[j + i], t);
+        }
+
+        __m256i t = st[1];
+        for (int i = 0; i < 24; i++) {
+            int j = PILN[i];
+            __m256i tmp = st[j];
+            st[j] = Rotl(t, ROTC[i]);
+            t = tmp;
+        }
+
+        for (int j = 0; j < 25; j += 5) {
+            for (int i = 0; i < 5; i++)
+                bc[i] = st[j + i];
+            for (int i = 0; i < 5; i++)
+                st[j + i] = _mm256_xor_si256(st[j + i], _mm256_andnot_si256(bc[(i + 1) % 5], bc[(i + 2) % 5]));
+        }
+
+        st[0] = _mm256_xor_si256(st[0], _mm256_set1_epi64x(RC[round]));
+    }
+
+    for (int i = 0; i < 25; i++)
+        _mm256_storeu_si256((__m256i*)(state + 4 * i), st[i]);
+}
+
+}
+
+#endif
@@ -0,0 +1,112 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <crypto/muhash.h>
+
+#include <crypto/chacha20.h>
+#include <crypto/common.h>
+#include <crypto/sha256.h>
+
+#include <string.h>
+
+namespace {
+
+/** The modulus is 2^3072 - MODULUS_DIFF */
+constexpr uint32_t MODULUS_DIFF = 1103717;
+
+/** Add v at limb i of r, returning the carry out of the top limb */
+uint32_t AddAt(uint32_t* r, int i, uint64_t v)
+{
+    for (; v && i < Num3072::LIMBS; i++) {
+        v += r[i];
+        r[i] = (uint32_t)v;
+        v >>= 32;
+    }
+    return (uint32_t)v;
+}
+
+} // namespace
+
+Num3072::Num3072()
+{
+    memset(limbs, 0, sizeof(limbs));
+    limbs[0] = 1;
+}
+
+Num3072::Num3072(const unsigned char (&data)[BYTE_SIZE])
+{
+    for (int i = 0; i < LIMBS; i++) {
+        limbs[i] = ReadLE32(data + 4 * i);
+    }
+    Reduce();
+}
+
+void Num3072::Reduce()
+{
+    // The number is at least p exactly when adding MODULUS_DIFF carries out of 2^3072,
+    // and then the sum modulo 2^3072 is the number minus p
+    uint32_t tmp[LIMBS];
+    memcpy(tmp, limbs, sizeof(limbs));
+    if (AddAt(tmp, 0, MODULUS_DIFF)) {
+        memcpy(limbs, tmp, sizeof(limbs));
+    }
+}
+
+void Num3072::Multiply(const Num3072& a)
+{
+    // Schoolbook product of 2 * LIMBS limbs; a product plus two limbs fits in 64 bits
+    uint32_t prod[2 * LIMBS] = {0};
+    for (int i = 0; i < LIMBS; i++) {
+        uint64_t carry = 0;
+        for (int j = 0; j < LIMBS; j++) {
+            uint64_t t = (uint64_t)limbs[i] * a.limbs[j] + prod[i + j] + carry;
+            prod[i + j] = (uint32_t)t;
+            carry = t >> 32;
+        }
+        prod[i + LIMBS] = (uint32_t)carry;
+    }
+
+    // 2^3072 is MODULUS_DIFF modulo p, so the high half folds into the low half
+    uint64_t carry = 0;
+    for (int i = 0; i < LIMBS; i++) {
+        uint64_t t = (uint64_t)prod[i + LIMBS] * MODULUS_DIFF + prod[i] + carry;
+        limbs[i] = (uint32_t)t;
+        carry = t >> 32;
+    }
+    // And so does what carried out of it, until nothing does
+    while (carry) {
+        carry = AddAt(limbs, 0, carry * MODULUS_DIFF);
+    }
+    Reduce();
+}
+
+void Num3072::ToBytes(unsigned char (&out)[BYTE_SIZE]) const
+{
+    for (int i = 0; i < LIMBS; i++) {
+        WriteLE32(out + 4 * i, limbs[i]);
+    }
+}
+
+MuHash3072& MuHash3072::Insert(Span<const unsigned char> in)
+{
+    unsigned char hash[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(in.data(), in.size()).Finalize(hash);
+    unsigned char data[Num3072::BYTE_SIZE];
+    ChaCha20(hash, sizeof(hash)).Output(data, sizeof(data));
+    m_product.Multiply(Num3072(data));
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator*=(const MuHash3072& mul)
+{
+    m_product.Multiply(mul.m_product);
+    return *this;
+}
+
+void MuHash3072::Finalize(uint256& out) const
+{
+    unsigned char data[Num3072::BYTE_SIZE];
+    m_product.ToBytes(data);
+    CSHA256().Write(data, sizeof(data)).Finalize(out.begin());
+}
@@ -0,0 +1,63 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_MUHASH_H
+#define BITCOIN_CRYPTO_MUHASH_H
+
+#include <span.h>
+#include <uint256.h>
+
+#include <stdint.h>
+
+/** A number modulo the prime 2^3072 - 1103717, in little-endian 32-bit limbs */
+class Num3072
+{
+public:
+    static constexpr int LIMBS = 96;
+    static constexpr size_t BYTE_SIZE = LIMBS * 4;
+
+    /** The number one */
+    Num3072();
+    /** The little-endian number in data, reduced */
+    explicit Num3072(const unsigned char (&data)[BYTE_SIZE]);
+
+    void Multiply(const Num3072& a);
+    void ToBytes(unsigned char (&out)[BYTE_SIZE]) const;
+
+private:
+    /** Bring a number below 2^3072 into [0, p) */
+    void Reduce();
+
+    uint32_t limbs[LIMBS];
+};
+
+/**
+ * A hash of a set that does not depend on the order of its elements (MuHash3072).
+ *
+ * Each element is hashed with SHA256, expanded with ChaCha20 to a 3072-bit number,
+ * and the set is the product of its elements modulo a 3072-bit prime. Sets hashed
+ * separately are combined by multiplying them, so disjoint parts of a set can be
+ * hashed in parallel. Removing elements would need a modular inverse and is not
+ * supported.
+ */
+class MuHash3072
+{
+public:
+    /** The hash of the empty set */
+    MuHash3072() {}
+
+    /** Add an element */
+    MuHash3072& Insert(Span<const unsigned char> in);
+
+    /** Add the elements of another set, which have to be different from these */
+    MuHash3072& operator*=(const MuHash3072& mul);
+
+    /** The SHA256 of the product */
+    void Finalize(uint256& out) const;
+
+private:
+    Num3072 m_product;
+};
+
+#endif // BITCOIN_CRYPTO_MUHASH_H
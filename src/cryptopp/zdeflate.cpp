@@ -10,6 +10,11 @@
 #include "stdcpp.h"
 #include "misc.h"
 
+// std::bind2nd is deprecated since C++11
+#if CRYPTOPP_GCC_DIAGNOSTIC_AVAILABLE
+# pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+
 NAMESPACE_BEGIN(CryptoPP)
 
 #if (defined(_MSC_VER) && (_MSC_VER < 1400)) && !defined(__MWERKS__)
@@ -197,6 +197,10 @@ private:
      * Should be set to log2(n)*/
     uint8_t depth_limit;
 
+    /** evictions counts the live elements aged out by epoch_check or dropped by
+     * insert for lack of room */
+    uint64_t evictions;
+
     /** hash_function is a const instance of the hash function. It cannot be
      * static or initialized at call time as it may have internal state (such as
      * a nonce).
@@ -306,8 +310,10 @@ private:
             for (uint32_t i = 0; i < size; ++i)
                 if (epoch_flags[i])
                     epoch_flags[i] = false;
-                else
+                else if (!collection_flags.bit_is_set(i)) {
                     allow_erase(i);
+                    ++evictions;
+                }
             epoch_heuristic_counter = epoch_size;
         } else
             // reset the epoch_heuristic_counter to next do a scan when worst
@@ -325,7 +331,7 @@ public:
      * call to setup or setup_bytes, otherwise operations may segfault.
      */
     cache() : table(), size(), collection_flags(0), epoch_flags(),
-    epoch_heuristic_counter(), epoch_size(), depth_limit(0), hash_function()
+    epoch_heuristic_counter(), epoch_size(), depth_limit(0), evictions(0), hash_function()
     {
     }
 
@@ -352,6 +358,40 @@ public:
         return size;
     }
 
+    /** resize moves the elements that are not discardable to a table of new_size
+     * elements, dropping those that do not fit. Epochs start over.
+     *
+     * resize requires no concurrent operation.
+     *
+     * @param new_size the desired number of elements to store
+     * @returns the maximum number of elements storable
+     */
+    uint32_t resize(uint32_t new_size)
+    {
+        std::vector<Element> old_table;
+        std::vector<bool> live(size);
+        for (uint32_t i = 0; i < size; ++i)
+            live[i] = !collection_flags.bit_is_set(i);
+        old_table.swap(table);
+        setup(new_size);
+        for (uint32_t i = 0; i < old_table.size(); ++i)
+            if (live[i])
+                insert(std::move(old_table[i]));
+        return size;
+    }
+
+    /** @returns the number of slots of the table */
+    uint32_t capacity() const
+    {
+        return size;
+    }
+
+    /** @returns the number of live elements aged out or dropped so far */
+    uint64_t evicted() const
+    {
+        return evictions;
+    }
+
     /** setup_bytes is a convenience function which accounts for internal memory
      * usage when deciding how many elements to store. It isn't perfect because
      * it doesn't account for any overhead (struct size, MallocUsage, collection
@@ -437,6 +477,7 @@ public:
             // Recompute the locs -- unfortunately happens one too many times!
             locs = compute_hashes(e);
         }
+        ++evictions;
     }
 
     /* contains iterates through the hash locations for a given element
@@ -97,10 +97,33 @@ static void SetMaxOpenFiles(leveldb::Options *options) {
              options->max_open_files, default_open_files);
 }
 
+static std::unique_ptr<leveldb::Cache> g_shared_block_cache;
+
+void CreateSharedBlockCache(size_t nCacheSize)
+{
+    assert(!g_shared_block_cache);
+    g_shared_block_cache.reset(leveldb::NewLRUCache(nCacheSize));
+}
+
+leveldb::Cache* GetSharedBlockCache()
+{
+    return g_shared_block_cache.get();
+}
+
+leveldb::Options GetSharedDBOptions(size_t nWriteBufferSize)
+{
+    leveldb::Options options;
+    options.block_cache = g_shared_block_cache.get();
+    if (nWriteBufferSize > 0)
+        options.write_buffer_size = nWriteBufferSize;
+    SetMaxOpenFiles(&options);
+    return options;
+}
+
 static leveldb::Options GetOptions(size_t nCacheSize)
 {
     leveldb::Options options;
-    options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
+    options.block_cache = g_shared_block_cache ? g_shared_block_cache.get() : leveldb::NewLRUCache(nCacheSize / 2);
     options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
     options.filter_policy = leveldb::NewBloomFilterPolicy(10);
     options.compression = leveldb::kNoCompression;
@@ -123,6 +146,7 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
     options = GetOptions(nCacheSize);
+    m_shared_block_cache = options.block_cache == GetSharedBlockCache();
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
@@ -174,7 +198,8 @@ CDBWrapper::~CDBWrapper()
     options.filter_policy = nullptr;
     delete options.info_log;
     options.info_log = nullptr;
-    delete options.block_cache;
+    if (!m_shared_block_cache)
+        delete options.block_cache;
     options.block_cache = nullptr;
     delete penv;
     options.env = nullptr;
@@ -237,6 +262,7 @@ CDBIterator::~CDBIterator() { delete piter; }
 bool CDBIterator::Valid() const { return piter->Valid(); }
 void CDBIterator::SeekToFirst() { piter->SeekToFirst(); }
 void CDBIterator::Next() { piter->Next(); }
+void CDBIterator::Prev() { piter->Prev(); }
 
 namespace dbwrapper_private {
 
@@ -43,6 +43,23 @@ const std::vector<unsigned char>& GetObfuscateKey(const CDBWrapper &w);
 
 };
 
+/**
+ * Create the LevelDB block cache shared by the databases of the node, of nCacheSize
+ * bytes. The databases opened afterwards through CDBWrapper or GetSharedDBOptions read
+ * through it instead of a block cache of their own, so that the blocks read most stay
+ * cached whichever database they belong to. The cache lives until the process exits.
+ */
+void CreateSharedBlockCache(size_t nCacheSize);
+
+/** The shared block cache, or nullptr if none was created */
+leveldb::Cache* GetSharedBlockCache();
+
+/**
+ * Options for a LevelDB database opened outside CDBWrapper: the shared block cache, if
+ * any, and a write buffer of nWriteBufferSize bytes (LevelDB's default if 0).
+ */
+leveldb::Options GetSharedDBOptions(size_t nWriteBufferSize = 0);
+
 /** Batch of changes queued to be written to a CDBWrapper */
 class CDBBatch
 {
@@ -143,6 +160,7 @@ public:
     }
 
     void Next();
+    void Prev();
 
     template<typename K> bool GetKey(K& key) {
         leveldb::Slice slKey = piter->key();
@@ -171,6 +189,14 @@ public:
         return piter->value().size();
     }
 
+    /** The value with the obfuscation removed, to be deserialized later or on another thread */
+    CDataStream GetValueStream() {
+        leveldb::Slice slValue = piter->value();
+        CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+        ssValue.Xor(dbwrapper_private::GetObfuscateKey(parent));
+        return ssValue;
+    }
+
 };
 
 class CDBWrapper
@@ -183,6 +209,9 @@ private:
     //! database options used
     leveldb::Options options;
 
+    //! whether options.block_cache is the shared block cache, which is not ours to delete
+    bool m_shared_block_cache;
+
     //! options used when reading from the database
     leveldb::ReadOptions readoptions;
 
@@ -215,7 +244,8 @@ private:
 public:
     /**
      * @param[in] path        Location in the filesystem where leveldb data will be stored.
-     * @param[in] nCacheSize  Configures various leveldb cache settings.
+     * @param[in] nCacheSize  Configures various leveldb cache settings. Half of it goes to
+     *                        the block cache, unless the shared block cache is used.
      * @param[in] fMemory     If true, use leveldb's memory environment.
      * @param[in] fWipe       If true, remove all existing data.
      * @param[in] obfuscate   If true, store data obfuscated via simple XOR. If false, XOR
@@ -310,6 +340,24 @@ public:
         return new CDBIterator(*this, pdb->NewIterator(iteroptions));
     }
 
+    /**
+     * Return a snapshot of the current state of the database. Iterators created on it
+     * at different times all see that state. Released when the last reference is gone,
+     * which has to be before the database is closed.
+     */
+    std::shared_ptr<const leveldb::Snapshot> GetSnapshot()
+    {
+        leveldb::DB* db = pdb;
+        return std::shared_ptr<const leveldb::Snapshot>(pdb->GetSnapshot(), [db](const leveldb::Snapshot* snapshot) { db->ReleaseSnapshot(snapshot); });
+    }
+
+    CDBIterator *NewIterator(const leveldb::Snapshot* snapshot)
+    {
+        leveldb::ReadOptions options = iteroptions;
+        options.snapshot = snapshot;
+        return new CDBIterator(*this, pdb->NewIterator(options));
+    }
+
     /**
      * Return true if the database managed by this class contains no entries.
      */
@@ -34,6 +34,8 @@ void DummyWalletInit::AddWalletOptions() const
         "-mintxfee=<amt>",
         "-paytxfee=<amt>",
         "-rescan",
+        "-rescanfilter",
+        "-rescanthreads=<n>",
         "-salvagewallet",
         "-spendzeroconfchange",
         "-txconfirmtarget=<n>",
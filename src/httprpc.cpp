@@ -19,6 +19,7 @@
 #include <stdio.h>
 
 #include <memory>
+#include <set>
 
 #include <boost/algorithm/string.hpp> // boost::trim
 
@@ -151,6 +152,16 @@ static bool RPCAuthorized(const std::string& strAuth, std::string& strAuthUserna
     return multiUserAuthorized(strUserPass);
 }
 
+/** Whether the reply of a call is streamed, for the methods that may return very large results */
+static bool IsStreamedReply(const JSONRPCRequest& jreq, const UniValue& result)
+{
+    static const std::set<std::string> setStreamedMethods = {
+        "getaddressdeltas", "getaddresstxids", "getblock", "getblocktransactionreceipts", "getrawmempool",
+        "listcontracts", "searchlogs",
+    };
+    return (result.isArray() || result.isObject()) && setStreamedMethods.count(jreq.strMethod);
+}
+
 static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
 {
     // JSONRPC handles only POST
@@ -202,6 +213,11 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
                 return true;
             }
 
+            if (IsStreamedReply(jreq, result)) {
+                jreq.StreamReply(result);
+                return true;
+            }
+
             // Send reply
             strReply = JSONRPCReply(result, NullUniValue, jreq.id);
 
@@ -16,6 +16,7 @@
 #include <ui_interface.h>
 
 #include <deque>
+#include <map>
 #include <memory>
 #include <stdio.h>
 #include <stdlib.h>
@@ -63,23 +64,43 @@ private:
     HTTPRequestHandler func;
 };
 
-/** Simple work queue for distributing work over multiple threads.
- * Work items are simply callable objects.
+/** Work queue for distributing work over multiple threads, fairly between clients.
+ * Work items are simply callable objects. Each client has its own queue, and the
+ * clients with work waiting are served in turn, weight items at a time, so that a
+ * client flooding the server does not hold up the others.
  */
 template <typename WorkItem>
 class WorkQueue
 {
 private:
+    struct ClientQueue
+    {
+        std::deque<std::unique_ptr<WorkItem>> items;
+        int weight;
+        //! Items left to take from this client in its current turn
+        int credit;
+    };
+
     /** Mutex protects entire object */
     Mutex cs;
     std::condition_variable cond;
-    std::deque<std::unique_ptr<WorkItem>> queue;
+    //! Queues of the clients with work waiting
+    std::map<std::string, ClientQueue> clients;
+    //! Clients with work waiting, in the order they are served
+    std::deque<std::string> rotation;
+    size_t nQueued;
     bool running;
+    //! Maximum number of items waiting per client
     size_t maxDepth;
+    size_t nBusy;
+    uint64_t nRejected;
 
 public:
-    explicit WorkQueue(size_t _maxDepth) : running(true),
-                                 maxDepth(_maxDepth)
+    explicit WorkQueue(size_t _maxDepth) : nQueued(0),
+                                 running(true),
+                                 maxDepth(_maxDepth),
+                                 nBusy(0),
+                                 nRejected(0)
     {
     }
     /** Precondition: worker threads have all stopped (they have been joined).
@@ -87,14 +108,22 @@ public:
     ~WorkQueue()
     {
     }
-    /** Enqueue a work item */
-    bool Enqueue(WorkItem* item)
+    /** Enqueue a work item of a client, served weight items per turn */
+    bool Enqueue(WorkItem* item, const std::string& client, int weight)
     {
         LOCK(cs);
-        if (queue.size() >= maxDepth) {
+        auto it = clients.find(client);
+        if (it != clients.end() && it->second.items.size() >= maxDepth) {
+            nRejected++;
             return false;
         }
-        queue.emplace_back(std::unique_ptr<WorkItem>(item));
+        if (it == clients.end()) {
+            it = clients.emplace(client, ClientQueue()).first;
+            it->second.weight = it->second.credit = std::max(weight, 1);
+            rotation.push_back(client);
+        }
+        it->second.items.emplace_back(std::unique_ptr<WorkItem>(item));
+        nQueued++;
         cond.notify_one();
         return true;
     }
@@ -105,16 +134,41 @@ public:
             std::unique_ptr<WorkItem> i;
             {
                 WAIT_LOCK(cs, lock);
-                while (running && queue.empty())
+                while (running && rotation.empty())
                     cond.wait(lock);
                 if (!running)
                     break;
-                i = std::move(queue.front());
-                queue.pop_front();
+                const std::string client = rotation.front();
+                ClientQueue& queue = clients[client];
+                i = std::move(queue.items.front());
+                queue.items.pop_front();
+                nQueued--;
+                if (queue.items.empty()) {
+                    clients.erase(client);
+                    rotation.pop_front();
+                } else if (--queue.credit == 0) {
+                    queue.credit = queue.weight;
+                    rotation.pop_front();
+                    rotation.push_back(client);
+                }
+                nBusy++;
             }
             (*i)();
+            LOCK(cs);
+            nBusy--;
         }
     }
+    HTTPWorkQueueStats GetStats()
+    {
+        LOCK(cs);
+        HTTPWorkQueueStats stats;
+        stats.nDepth = nQueued;
+        stats.nMaxDepth = maxDepth;
+        stats.nBusy = nBusy;
+        stats.nRejected = nRejected;
+        stats.nClients = clients.size();
+        return stats;
+    }
     /** Interrupt and exit loops */
     void Interrupt()
     {
@@ -143,6 +197,8 @@ static struct event_base* eventBase = nullptr;
 struct evhttp* eventHTTP = nullptr;
 //! List of subnets to allow RPC connections from
 static std::vector<CSubNet> rpc_allow_subnets;
+//! Weights of the clients in the work queue, by subnet
+static std::vector<std::pair<CSubNet, int>> rpc_client_weights;
 //! Work queue for handling longer requests off the event loop thread
 static WorkQueue<HTTPClosure>* workQueue = nullptr;
 //! Handlers for (sub)paths
@@ -189,6 +245,37 @@ static bool InitHTTPAllowList()
     return true;
 }
 
+/** Initialize the weights of the clients in the work queue */
+static bool InitHTTPClientWeights()
+{
+    rpc_client_weights.clear();
+    for (const std::string& strWeight : gArgs.GetArgs("-rpcclientweight")) {
+        const size_t pos = strWeight.find('@');
+        int32_t weight = 0;
+        CSubNet subnet;
+        if (pos != std::string::npos) {
+            LookupSubNet(strWeight.substr(pos + 1).c_str(), subnet);
+        }
+        if (pos == std::string::npos || !ParseInt32(strWeight.substr(0, pos), &weight) || weight < 1 || !subnet.IsValid()) {
+            uiInterface.ThreadSafeMessageBox(
+                strprintf("Invalid -rpcclientweight specification: %s. Valid is a weight of at least 1 followed by @ and a single IP or a subnet (e.g. 4@127.0.0.1).", strWeight),
+                "", CClientUIInterface::MSG_ERROR);
+            return false;
+        }
+        rpc_client_weights.emplace_back(subnet, weight);
+    }
+    return true;
+}
+
+/** Weight of a client in the work queue: that of the first subnet matching it, or 1 */
+static int ClientWeight(const CNetAddr& netaddr)
+{
+    for (const auto& entry : rpc_client_weights)
+        if (entry.first.Match(netaddr))
+            return entry.second;
+    return 1;
+}
+
 /** HTTP request method as string - use for logging only */
 static std::string RequestMethodString(HTTPRequest::RequestMethod m)
 {
@@ -263,12 +350,14 @@ static void http_request_cb(struct evhttp_request* req, void* arg)
 
     // Dispatch to worker thread
     if (i != iend) {
+        // The connections of a host share its queue
+        const CService peer = hreq->GetPeer();
         std::unique_ptr<HTTPWorkItem> item(new HTTPWorkItem(std::move(hreq), path, i->handler));
         assert(workQueue);
-        if (workQueue->Enqueue(item.get()))
+        if (workQueue->Enqueue(item.get(), peer.ToStringIP(), ClientWeight(peer)))
             item.release(); /* if true, queue took ownership */
         else {
-            LogPrintf("WARNING: request rejected because http work queue depth exceeded, it can be increased with the -rpcworkqueue= setting\n");
+            LogPrintf("WARNING: request from %s rejected because http work queue depth exceeded, it can be increased with the -rpcworkqueue= setting\n", peer.ToString());
             item->req->WriteReply(HTTP_INTERNAL, "Work queue depth exceeded");
         }
     } else {
@@ -360,6 +449,8 @@ bool InitHTTPServer()
 {
     if (!InitHTTPAllowList())
         return false;
+    if (!InitHTTPClientWeights())
+        return false;
 
     // Redirect libevent's logging to our own log
     event_set_log_callback(&libevent_log_cb);
@@ -398,7 +489,7 @@ bool InitHTTPServer()
 
     LogPrint(BCLog::HTTP, "Initialized HTTP server\n");
     int workQueueDepth = std::max((long)gArgs.GetArg("-rpcworkqueue", DEFAULT_HTTP_WORKQUEUE), 1L);
-    LogPrintf("HTTP: creating work queue of depth %d\n", workQueueDepth);
+    LogPrintf("HTTP: creating work queue of depth %d per client\n", workQueueDepth);
 
     workQueue = new WorkQueue<HTTPClosure>(workQueueDepth);
     // transfer ownership to eventBase/HTTP via .release()
@@ -480,6 +571,13 @@ void StopHTTPServer()
     LogPrint(BCLog::HTTP, "Stopped HTTP server\n");
 }
 
+HTTPWorkQueueStats GetHTTPWorkQueueStats()
+{
+    if (!workQueue)
+        return HTTPWorkQueueStats();
+    return workQueue->GetStats();
+}
+
 struct event_base* EventBase()
 {
     return eventBase;
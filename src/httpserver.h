@@ -48,6 +48,19 @@ void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPR
 /** Unregister handler for prefix */
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
 
+/** Occupancy of the work queue of the HTTP server */
+struct HTTPWorkQueueStats
+{
+    size_t nDepth = 0;      //!< Requests waiting for a worker
+    size_t nMaxDepth = 0;   //!< -rpcworkqueue, the requests a client may have waiting
+    size_t nClients = 0;    //!< Clients with requests waiting
+    size_t nBusy = 0;       //!< Workers handling a request
+    uint64_t nRejected = 0; //!< Requests refused because the queue was full, since startup
+};
+
+/** Get the occupancy of the work queue, all zero when the server is not running */
+HTTPWorkQueueStats GetHTTPWorkQueueStats();
+
 /** Return evhttp event base. This can be used by submodules to
  * queue timers or custom events.
  */
@@ -0,0 +1,694 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/addressindex.h>
+
+#include <chainparams.h>
+#include <script/standard.h>
+#include <undo.h>
+#include <util/system.h>
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <tuple>
+
+#include <boost/thread.hpp>
+
+#ifdef ENABLE_BITCORE_RPC
+//////////////////////////////////////////////////////// // kpg
+constexpr char DB_ADDRESSINDEX = 'a';
+constexpr char DB_ADDRESSSUMMARY = 'A';
+constexpr char DB_ADDRESSUNSPENTINDEX = 'u';
+constexpr char DB_TIMESTAMPINDEX = 'S';
+constexpr char DB_BLOCKHASHINDEX = 'z';
+constexpr char DB_SPENTINDEX = 'p';
+
+std::unique_ptr<AddressIndex> g_addressindex;
+
+/**
+ * Access to the address index database (indexes/addressindex/)
+ *
+ * Besides the block locator of BaseIndex, the database holds the address index
+ * entries and the totals of each address, the unspent outputs of each address, the
+ * spender of each spent output and the logical timestamps of the blocks.
+ */
+class AddressIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
+    bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
+    bool ReadAddressIndex(uint256 addressHash, int type,
+                          std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                          int start, int end) const;
+    bool ReadAddressIndexPage(CAddressIndexKey &cursor, size_t limit, int end,
+                              std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex) const;
+    bool ReadAddressIndexMerged(const std::vector<std::pair<uint256, int> > &addresses,
+                                std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                                int start, int end) const;
+    bool ReadAddressSummary(uint256 addressHash, int type, CAddressSummary &summary) const;
+    bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect);
+    bool ReadAddressUnspentIndex(uint256 addressHash, int type,
+                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) const;
+    bool ReadAddressUnspentIndexPage(CAddressUnspentKey &cursor, size_t limit,
+                                     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) const;
+    bool ReadSpentIndex(const CSpentIndexKey &key, CSpentIndexValue &value) const;
+    bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > &vect);
+    bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex, const CTimestampBlockIndexKey &blockhashIndex, const CTimestampBlockIndexValue &logicalts);
+    bool ReadTimestampIndex(unsigned int high, unsigned int low,
+                            std::vector<std::pair<uint256, unsigned int> > &hashes) const;
+    bool ReadTimestampBlockIndex(const uint256 &hash, unsigned int &ltimestamp) const;
+
+private:
+    /** Apply the address index entries of a block being connected, or disconnected if
+     *  fErase, to the totals of their addresses, in the batch that writes or erases them */
+    void UpdateAddressSummaries(CDBBatch &batch, const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool fErase) const;
+};
+
+AddressIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(GetDataDir() / "indexes" / "addressindex", n_cache_size, f_memory, f_wipe)
+{}
+
+bool AddressIndex::DB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect) {
+    CDBBatch batch(*this);
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
+        batch.Write(std::make_pair(DB_ADDRESSINDEX, it->first), it->second);
+    UpdateAddressSummaries(batch, vect, false);
+    return WriteBatch(batch);
+}
+
+bool AddressIndex::DB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect) {
+    CDBBatch batch(*this);
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
+        batch.Erase(std::make_pair(DB_ADDRESSINDEX, it->first));
+    UpdateAddressSummaries(batch, vect, true);
+    return WriteBatch(batch);
+}
+
+void AddressIndex::DB::UpdateAddressSummaries(CDBBatch &batch, const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool fErase) const {
+    // Sum the entries of each address, counting each tx once per address. Only the entries
+    // that the batch adds or removes count, since the blocks after the locator of the index
+    // are indexed again after an unclean shutdown
+    std::map<std::pair<unsigned int, uint256>, CAddressSummary> mapDeltas;
+    std::set<std::tuple<unsigned int, uint256, uint256> > setAddressTxs;
+    for (const std::pair<CAddressIndexKey, CAmount>& entry : vect) {
+        const CAddressIndexKey& key = entry.first;
+        if (Exists(std::make_pair(DB_ADDRESSINDEX, key)) != fErase)
+            continue;
+        CAddressSummary& delta = mapDeltas[std::make_pair(key.type, key.hashBytes)];
+        delta.balance += entry.second;
+        if (entry.second > 0)
+            delta.received += entry.second;
+        if (setAddressTxs.emplace(key.type, key.hashBytes, key.txhash).second)
+            delta.txCount++;
+        delta.lastHeight = std::max(delta.lastHeight, key.blockHeight);
+    }
+
+    for (const auto& it : mapDeltas) {
+        const CAddressIndexIteratorKey key(it.first.first, it.first.second);
+        const CAddressSummary& delta = it.second;
+        CAddressSummary summary;
+        Read(std::make_pair(DB_ADDRESSSUMMARY, key), summary);
+        if (!fErase) {
+            summary.balance += delta.balance;
+            summary.received += delta.received;
+            summary.txCount += delta.txCount;
+            summary.lastHeight = std::max(summary.lastHeight, delta.lastHeight);
+        } else {
+            summary.balance -= delta.balance;
+            summary.received -= delta.received;
+            summary.txCount -= std::min(summary.txCount, delta.txCount);
+            if (summary.txCount > 0 && summary.lastHeight <= delta.lastHeight) {
+                // The entries of the disconnected block are still in the index, the last height
+                // is the one of the entry before them. The block timestamps come after the
+                // address index and are never erased, so the seek always lands on an entry
+                summary.lastHeight = 0;
+                std::unique_ptr<CDBIterator> pcursor(NewIterator());
+                pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(key.type, key.hashBytes, delta.lastHeight)));
+                if (pcursor->Valid()) {
+                    pcursor->Prev();
+                    std::pair<char, CAddressIndexKey> prevKey;
+                    if (pcursor->Valid() && pcursor->GetKey(prevKey) && prevKey.first == DB_ADDRESSINDEX &&
+                        prevKey.second.type == key.type && prevKey.second.hashBytes == key.hashBytes) {
+                        summary.lastHeight = prevKey.second.blockHeight;
+                    }
+                }
+            }
+        }
+        if (summary.IsNull()) {
+            batch.Erase(std::make_pair(DB_ADDRESSSUMMARY, key));
+        } else {
+            batch.Write(std::make_pair(DB_ADDRESSSUMMARY, key), summary);
+        }
+    }
+}
+
+bool AddressIndex::DB::ReadAddressSummary(uint256 addressHash, int type, CAddressSummary &summary) const {
+    summary.SetNull();
+    const auto key = std::make_pair(DB_ADDRESSSUMMARY, CAddressIndexIteratorKey(type, addressHash));
+    if (!Exists(key))
+        return true;
+    return Read(key, summary);
+}
+
+bool AddressIndex::DB::ReadAddressIndex(uint256 addressHash, int type,
+                                        std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                                        int start, int end) const {
+
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+
+    if (start > 0 && end > 0) {
+        pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
+    } else {
+        pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    }
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressIndexKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX && key.second.hashBytes == addressHash) {
+            if (end > 0 && key.second.blockHeight > end) {
+                break;
+            }
+            CAmount nValue;
+            if (pcursor->GetValue(nValue)) {
+                addressIndex.push_back(std::make_pair(key.second, nValue));
+                pcursor->Next();
+            } else {
+                return error("failed to get address index value");
+            }
+        } else {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool AddressIndex::DB::ReadAddressIndexPage(CAddressIndexKey &cursor, size_t limit, int end,
+                                            std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex) const {
+
+    const unsigned int type = cursor.type;
+    const uint256 addressHash = cursor.hashBytes;
+    size_t nRead = 0;
+
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, cursor));
+    cursor.SetNull();
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressIndexKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSINDEX || key.second.type != type || key.second.hashBytes != addressHash) {
+            break;
+        }
+        if (end > 0 && key.second.blockHeight > end) {
+            break;
+        }
+        // Stop between two txs, so that a page never holds part of the entries of a tx
+        if (nRead >= limit && (key.second.blockHeight != addressIndex.back().first.blockHeight || key.second.txhash != addressIndex.back().first.txhash)) {
+            cursor = key.second;
+            break;
+        }
+        CAmount nValue;
+        if (!pcursor->GetValue(nValue)) {
+            return error("failed to get address index value");
+        }
+        addressIndex.push_back(std::make_pair(key.second, nValue));
+        nRead++;
+        pcursor->Next();
+    }
+
+    return true;
+}
+
+/** Read the key of the entry pcursor is on, if it is an address index entry of the address up to height end */
+static bool GetAddressIndexKey(CDBIterator &pcursor, unsigned int type, const uint256 &addressHash, int end, CAddressIndexKey &key)
+{
+    std::pair<char,CAddressIndexKey> entry;
+    if (!pcursor.Valid() || !pcursor.GetKey(entry) || entry.first != DB_ADDRESSINDEX ||
+        entry.second.type != type || entry.second.hashBytes != addressHash) {
+        return false;
+    }
+    if (end > 0 && entry.second.blockHeight > end) {
+        return false;
+    }
+    key = entry.second;
+    return true;
+}
+
+bool AddressIndex::DB::ReadAddressIndexMerged(const std::vector<std::pair<uint256, int> > &addresses,
+                                              std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                                              int start, int end) const {
+
+    // One cursor per address, on the next entry of the address, merged by height and position
+    // in the block. The entries of an address are in that order already, so the merge never
+    // holds more than one entry per address.
+    std::vector<std::unique_ptr<CDBIterator> > cursors;
+    std::vector<CAddressIndexKey> keys(addresses.size());
+    std::vector<size_t> heap;
+    cursors.reserve(addresses.size());
+    heap.reserve(addresses.size());
+
+    for (size_t i = 0; i < addresses.size(); i++) {
+        const uint256 &addressHash = addresses[i].first;
+        const int type = addresses[i].second;
+        cursors.emplace_back(NewIterator());
+        if (start > 0 && end > 0) {
+            cursors[i]->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
+        } else {
+            cursors[i]->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
+        }
+        if (GetAddressIndexKey(*cursors[i], type, addressHash, end, keys[i])) {
+            heap.push_back(i);
+        }
+    }
+
+    // Ties between the addresses of a tx go in the order of the addresses, so that the entries
+    // of a tx stay together
+    const auto later = [&keys](size_t a, size_t b) {
+        return std::tie(keys[a].blockHeight, keys[a].txindex, a) > std::tie(keys[b].blockHeight, keys[b].txindex, b);
+    };
+    std::make_heap(heap.begin(), heap.end(), later);
+
+    while (!heap.empty()) {
+        boost::this_thread::interruption_point();
+        std::pop_heap(heap.begin(), heap.end(), later);
+        const size_t i = heap.back();
+        CAmount nValue;
+        if (!cursors[i]->GetValue(nValue)) {
+            return error("failed to get address index value");
+        }
+        addressIndex.push_back(std::make_pair(keys[i], nValue));
+        cursors[i]->Next();
+        if (GetAddressIndexKey(*cursors[i], addresses[i].second, addresses[i].first, end, keys[i])) {
+            std::push_heap(heap.begin(), heap.end(), later);
+        } else {
+            heap.pop_back();
+        }
+    }
+
+    return true;
+}
+
+bool AddressIndex::DB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect) {
+    CDBBatch batch(*this);
+    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        if (it->second.IsNull()) {
+            batch.Erase(std::make_pair(DB_ADDRESSUNSPENTINDEX, it->first));
+        } else {
+            batch.Write(std::make_pair(DB_ADDRESSUNSPENTINDEX, it->first), it->second);
+        }
+    }
+    return WriteBatch(batch);
+}
+
+bool AddressIndex::DB::ReadAddressUnspentIndex(uint256 addressHash, int type,
+                                               std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) const {
+
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressUnspentKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
+            CAddressUnspentValue nValue;
+            if (pcursor->GetValue(nValue)) {
+                unspentOutputs.push_back(std::make_pair(key.second, nValue));
+                pcursor->Next();
+            } else {
+                return error("failed to get address unspent value");
+            }
+        } else {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool AddressIndex::DB::ReadAddressUnspentIndexPage(CAddressUnspentKey &cursor, size_t limit,
+                                                   std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) const {
+
+    const unsigned int type = cursor.type;
+    const uint256 addressHash = cursor.hashBytes;
+    size_t nRead = 0;
+
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(std::make_pair(DB_ADDRESSUNSPENTINDEX, cursor));
+    cursor.SetNull();
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressUnspentKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSUNSPENTINDEX || key.second.type != type || key.second.hashBytes != addressHash) {
+            break;
+        }
+        if (nRead >= limit) {
+            cursor = key.second;
+            break;
+        }
+        CAddressUnspentValue nValue;
+        if (!pcursor->GetValue(nValue)) {
+            return error("failed to get address unspent value");
+        }
+        unspentOutputs.push_back(std::make_pair(key.second, nValue));
+        nRead++;
+        pcursor->Next();
+    }
+
+    return true;
+}
+
+bool AddressIndex::DB::ReadSpentIndex(const CSpentIndexKey &key, CSpentIndexValue &value) const {
+    return Read(std::make_pair(DB_SPENTINDEX, key), value);
+}
+
+bool AddressIndex::DB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > &vect) {
+    CDBBatch batch(*this);
+    for (std::vector<std::pair<CSpentIndexKey,CSpentIndexValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        if (it->second.IsNull()) {
+            batch.Erase(std::make_pair(DB_SPENTINDEX, it->first));
+        } else {
+            batch.Write(std::make_pair(DB_SPENTINDEX, it->first), it->second);
+        }
+    }
+    return WriteBatch(batch);
+}
+
+bool AddressIndex::DB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex, const CTimestampBlockIndexKey &blockhashIndex, const CTimestampBlockIndexValue &logicalts) {
+    CDBBatch batch(*this);
+    batch.Write(std::make_pair(DB_TIMESTAMPINDEX, timestampIndex), 0);
+    batch.Write(std::make_pair(DB_BLOCKHASHINDEX, blockhashIndex), logicalts);
+    return WriteBatch(batch);
+}
+
+bool AddressIndex::DB::ReadTimestampIndex(unsigned int high, unsigned int low,
+                                          std::vector<std::pair<uint256, unsigned int> > &hashes) const {
+
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(std::make_pair(DB_TIMESTAMPINDEX, CTimestampIndexIteratorKey(low)));
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, CTimestampIndexKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_TIMESTAMPINDEX && key.second.timestamp < high) {
+            hashes.push_back(std::make_pair(key.second.blockHash, key.second.timestamp));
+            pcursor->Next();
+        } else {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool AddressIndex::DB::ReadTimestampBlockIndex(const uint256 &hash, unsigned int &ltimestamp) const {
+
+    CTimestampBlockIndexValue(lts);
+    if (!Read(std::make_pair(DB_BLOCKHASHINDEX, hash), lts))
+       return false;
+
+    ltimestamp = lts.ltimestamp;
+    return true;
+}
+
+/** The index entries of the transactions of a block, in the order they are applied */
+struct CBlockAddressEntries
+{
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
+};
+
+static bool GetIndexKey(const COutPoint& outpoint, const CScript& scriptPubKey, int& type, uint256& hashBytes)
+{
+    CTxDestination dest;
+    if (!ExtractDestination(outpoint, scriptPubKey, dest))
+        return false;
+    valtype bytesID(boost::apply_visitor(DataVisitor(), dest));
+    if (bytesID.empty())
+        return false;
+    valtype addressBytes(32);
+    std::copy(bytesID.begin(), bytesID.end(), addressBytes.begin());
+    type = dest.which();
+    hashBytes = uint256(addressBytes);
+    return true;
+}
+
+/** Build the entries that connecting the block adds, or that disconnecting it removes or
+ *  restores if fDisconnect. The spent outputs come from the undo data of the block */
+static bool BuildBlockAddressEntries(const CBlock& block, const CBlockUndo& blockundo, int nHeight, bool fDisconnect, CBlockAddressEntries& entries)
+{
+    if (blockundo.vtxundo.size() + 1 != block.vtx.size())
+        return error("%s: block and undo data inconsistent", __func__);
+
+    for (unsigned int n = 0; n < block.vtx.size(); n++) {
+        // Disconnecting goes through the txs and their outputs in reverse order
+        const unsigned int i = fDisconnect ? block.vtx.size() - 1 - n : n;
+        const CTransaction& tx = *block.vtx[i];
+        const uint256& hash = tx.GetHash();
+        int type;
+        uint256 hashBytes;
+
+        if (fDisconnect) {
+            for (unsigned int k = tx.vout.size(); k-- > 0;) {
+                const CTxOut &out = tx.vout[k];
+                if (!GetIndexKey({hash, k}, out.scriptPubKey, type, hashBytes))
+                    continue;
+                // undo receiving activity
+                entries.addressIndex.push_back(std::make_pair(CAddressIndexKey(type, hashBytes, nHeight, i, hash, k, false), out.nValue));
+                // undo unspent index
+                entries.addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(type, hashBytes, hash, k), CAddressUnspentValue()));
+            }
+        }
+
+        if (i > 0) {
+            const CTxUndo& txundo = blockundo.vtxundo[i-1];
+            if (txundo.vprevout.size() != tx.vin.size())
+                return error("%s: transaction and undo data inconsistent", __func__);
+            for (unsigned int m = 0; m < tx.vin.size(); m++) {
+                const unsigned int j = fDisconnect ? tx.vin.size() - 1 - m : m;
+                const CTxIn& input = tx.vin[j];
+                const Coin& coin = txundo.vprevout[j];
+                if (!GetIndexKey(input.prevout, coin.out.scriptPubKey, type, hashBytes))
+                    continue;
+                // record or undo spending activity
+                entries.addressIndex.push_back(std::make_pair(CAddressIndexKey(type, hashBytes, nHeight, i, hash, j, true), coin.out.nValue * -1));
+                if (fDisconnect) {
+                    // restore unspent index
+                    entries.addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(type, hashBytes, input.prevout.hash, input.prevout.n), CAddressUnspentValue(coin.out.nValue, coin.out.scriptPubKey, coin.nHeight, coin.fCoinStake)));
+                    entries.spentIndex.push_back(std::make_pair(CSpentIndexKey(input.prevout.hash, input.prevout.n), CSpentIndexValue()));
+                } else {
+                    // remove address from unspent index
+                    entries.addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(type, hashBytes, input.prevout.hash, input.prevout.n), CAddressUnspentValue()));
+                    entries.spentIndex.push_back(std::make_pair(CSpentIndexKey(input.prevout.hash, input.prevout.n), CSpentIndexValue(hash, j, nHeight, coin.out.nValue, type, hashBytes)));
+                }
+            }
+        }
+
+        if (!fDisconnect) {
+            const bool isTxCoinStake = tx.IsCoinStake();
+            for (unsigned int k = 0; k < tx.vout.size(); k++) {
+                const CTxOut &out = tx.vout[k];
+                if (!GetIndexKey({hash, k}, out.scriptPubKey, type, hashBytes))
+                    continue;
+                // record receiving activity
+                entries.addressIndex.push_back(std::make_pair(CAddressIndexKey(type, hashBytes, nHeight, i, hash, k, false), out.nValue));
+                // record unspent output
+                entries.addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(type, hashBytes, hash, k), CAddressUnspentValue(out.nValue, out.scriptPubKey, nHeight, isTxCoinStake)));
+            }
+        }
+    }
+    return true;
+}
+
+AddressIndex::AddressIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<AddressIndex::DB>(n_cache_size, f_memory, f_wipe))
+{}
+
+AddressIndex::~AddressIndex() {}
+
+bool AddressIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    // The outputs of the genesis block are not spendable and it has no undo data
+    if (pindex->nHeight == 0) {
+        return true;
+    }
+
+    CBlockUndo blockundo;
+    if (!UndoReadFromDisk(blockundo, pindex)) {
+        return false;
+    }
+    CBlockAddressEntries entries;
+    if (!BuildBlockAddressEntries(block, blockundo, pindex->nHeight, false, entries)) {
+        return false;
+    }
+
+    if (!m_db->WriteAddressIndex(entries.addressIndex)) {
+        return error("%s: Failed to write address index", __func__);
+    }
+    if (!m_db->UpdateAddressUnspentIndex(entries.addressUnspentIndex)) {
+        return error("%s: Failed to write address unspent index", __func__);
+    }
+    if (!m_db->UpdateSpentIndex(entries.spentIndex)) {
+        return error("%s: Failed to write spent index", __func__);
+    }
+
+    unsigned int logicalTS = pindex->nTime;
+    unsigned int prevLogicalTS = 0;
+
+    // retrieve logical timestamp of the previous block
+    if (pindex->pprev->pprev && !m_db->ReadTimestampBlockIndex(pindex->pprev->GetBlockHash(), prevLogicalTS))
+        LogPrintf("%s: Failed to read previous block's logical timestamp\n", __func__);
+
+    if (logicalTS <= prevLogicalTS) {
+        logicalTS = prevLogicalTS + 1;
+        LogPrintf("%s: Previous logical timestamp is newer Actual[%d] prevLogical[%d] Logical[%d]\n", __func__, pindex->nTime, prevLogicalTS, logicalTS);
+    }
+
+    if (!m_db->WriteTimestampIndex(CTimestampIndexKey(logicalTS, pindex->GetBlockHash()), CTimestampBlockIndexKey(pindex->GetBlockHash()), CTimestampBlockIndexValue(logicalTS))) {
+        return error("%s: Failed to write timestamp index", __func__);
+    }
+    return true;
+}
+
+bool AddressIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    const Consensus::Params& consensus_params = Params().GetConsensus();
+    for (const CBlockIndex* pindex = current_tip; pindex != new_tip; pindex = pindex->pprev) {
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, consensus_params)) {
+            return error("%s: Failed to read block %s from disk", __func__, pindex->GetBlockHash().ToString());
+        }
+        CBlockUndo blockundo;
+        if (!UndoReadFromDisk(blockundo, pindex)) {
+            return false;
+        }
+        CBlockAddressEntries entries;
+        if (!BuildBlockAddressEntries(block, blockundo, pindex->nHeight, true, entries)) {
+            return false;
+        }
+
+        if (!m_db->EraseAddressIndex(entries.addressIndex)) {
+            return error("%s: Failed to delete address index", __func__);
+        }
+        if (!m_db->UpdateAddressUnspentIndex(entries.addressUnspentIndex)) {
+            return error("%s: Failed to write address unspent index", __func__);
+        }
+        if (!m_db->UpdateSpentIndex(entries.spentIndex)) {
+            return error("%s: Failed to write spent index", __func__);
+        }
+    }
+
+    return BaseIndex::Rewind(current_tip, new_tip);
+}
+
+BaseIndex::DB& AddressIndex::GetDB() const { return *m_db; }
+
+bool AddressIndex::ReadAddressIndex(uint256 addressHash, int type,
+                                    std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                                    int start, int end) const
+{
+    return m_db->ReadAddressIndex(addressHash, type, addressIndex, start, end);
+}
+
+bool AddressIndex::ReadAddressIndexPage(CAddressIndexKey &cursor, size_t limit, int end,
+                                        std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex) const
+{
+    return m_db->ReadAddressIndexPage(cursor, limit, end, addressIndex);
+}
+
+bool AddressIndex::ReadAddressIndexMerged(const std::vector<std::pair<uint256, int> > &addresses,
+                                          std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                                          int start, int end) const
+{
+    return m_db->ReadAddressIndexMerged(addresses, addressIndex, start, end);
+}
+
+bool AddressIndex::ReadAddressSummary(uint256 addressHash, int type, CAddressSummary &summary) const
+{
+    return m_db->ReadAddressSummary(addressHash, type, summary);
+}
+
+bool AddressIndex::ReadAddressUnspentIndex(uint256 addressHash, int type,
+                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) const
+{
+    return m_db->ReadAddressUnspentIndex(addressHash, type, unspentOutputs);
+}
+
+bool AddressIndex::ReadAddressUnspentIndexPage(CAddressUnspentKey &cursor, size_t limit,
+                                               std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) const
+{
+    return m_db->ReadAddressUnspentIndexPage(cursor, limit, unspentOutputs);
+}
+
+bool AddressIndex::ReadSpentIndex(const CSpentIndexKey &key, CSpentIndexValue &value) const
+{
+    return m_db->ReadSpentIndex(key, value);
+}
+
+bool AddressIndex::ReadTimestampIndex(unsigned int high, unsigned int low, bool fActiveOnly,
+                                      std::vector<std::pair<uint256, unsigned int> > &hashes) const
+{
+    // The timestamps of the disconnected blocks stay in the index
+    if (!fActiveOnly) {
+        return m_db->ReadTimestampIndex(high, low, hashes);
+    }
+
+    // The logical timestamps increase along the active chain from height 1, so the blocks of the
+    // range are found by a binary search and the timestamps of the following blocks come from the
+    // block index, as WriteBlock derives them
+    LOCK(cs_main);
+    const CBlockIndex* best_block_index = GetBestBlockIndex();
+    if (!best_block_index || low >= high) {
+        return true;
+    }
+    // During a reorg the index may still be on blocks the active chain no longer has
+    best_block_index = chainActive.FindFork(best_block_index);
+    if (!best_block_index) {
+        return true;
+    }
+
+    unsigned int logicalTS = 0;
+    int nLow = 1;
+    int nHigh = best_block_index->nHeight + 1;
+    while (nLow < nHigh) {
+        int nMid = nLow + (nHigh - nLow) / 2;
+        if (!m_db->ReadTimestampBlockIndex(chainActive[nMid]->GetBlockHash(), logicalTS)) {
+            return error("%s: Failed to read logical timestamp of block %d", __func__, nMid);
+        }
+        if (logicalTS < low) {
+            nLow = nMid + 1;
+        } else {
+            nHigh = nMid;
+        }
+    }
+    if (nLow > best_block_index->nHeight) {
+        return true;
+    }
+
+    const CBlockIndex* pindex = chainActive[nLow];
+    if (!m_db->ReadTimestampBlockIndex(pindex->GetBlockHash(), logicalTS)) {
+        return error("%s: Failed to read logical timestamp of block %d", __func__, nLow);
+    }
+    while (logicalTS < high) {
+        hashes.push_back(std::make_pair(pindex->GetBlockHash(), logicalTS));
+        if (pindex == best_block_index) {
+            break;
+        }
+        pindex = chainActive.Next(pindex);
+        logicalTS = std::max(pindex->nTime, logicalTS + 1);
+    }
+
+    return true;
+}
+////////////////////////////////////////////////////////
+#endif
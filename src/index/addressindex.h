@@ -0,0 +1,88 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef INDEX_ADDRESSINDEX_H
+#define INDEX_ADDRESSINDEX_H
+
+#include <index/base.h>
+#include <validation.h>
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#ifdef ENABLE_BITCORE_RPC
+//////////////////////////////////////////////////////// // kpg
+/**
+ * AddressIndex is used by the explorer RPCs to look up the history, the totals and the
+ * unspent outputs of addresses, the spender of outputs and the blocks by timestamp.
+ *
+ * The index is written to its own LevelDB database in the background, from the blocks
+ * and their undo data, so that ConnectBlock does not wait for it and -addrindex can be
+ * turned on without a reindex. The entries of the blocks disconnected from the active
+ * chain are removed, except the timestamps, which lookups check against the active chain.
+ */
+class AddressIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "addressindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit AddressIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~AddressIndex() override;
+
+    bool ReadAddressIndex(uint256 addressHash, int type,
+                          std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                          int start = 0, int end = 0) const;
+
+    /** Append the address index entries of the address of cursor to addressIndex, from cursor on
+     *  and up to height end if set, until limit entries are read and the last tx is complete.
+     *  cursor is left on the next entry, or null once the address is exhausted */
+    bool ReadAddressIndexPage(CAddressIndexKey &cursor, size_t limit, int end,
+                              std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex) const;
+
+    /** Read the address index entries of several addresses, in the order of their height and
+     *  position in the block, merging the entries of the addresses as they are read */
+    bool ReadAddressIndexMerged(const std::vector<std::pair<uint256, int> > &addresses,
+                                std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                                int start = 0, int end = 0) const;
+
+    /** Read the totals of an address, null if it has no address index entries */
+    bool ReadAddressSummary(uint256 addressHash, int type, CAddressSummary &summary) const;
+
+    bool ReadAddressUnspentIndex(uint256 addressHash, int type,
+                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) const;
+
+    /** Append up to limit unspent outputs of the address of cursor to unspentOutputs, from cursor on.
+     *  cursor is left on the next output, or null once the address is exhausted */
+    bool ReadAddressUnspentIndexPage(CAddressUnspentKey &cursor, size_t limit,
+                                     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) const;
+
+    bool ReadSpentIndex(const CSpentIndexKey &key, CSpentIndexValue &value) const;
+
+    bool ReadTimestampIndex(unsigned int high, unsigned int low, bool fActiveOnly,
+                            std::vector<std::pair<uint256, unsigned int> > &hashes) const;
+};
+
+/// The global address index, used by the explorer RPCs. May be null.
+extern std::unique_ptr<AddressIndex> g_addressindex;
+////////////////////////////////////////////////////////
+#endif
+
+#endif
@@ -4,6 +4,7 @@
 
 #include <chainparams.h>
 #include <index/base.h>
+#include <primitives/blockview.h>
 #include <shutdown.h>
 #include <tinyformat.h>
 #include <ui_interface.h>
@@ -11,10 +12,18 @@
 #include <validation.h>
 #include <warnings.h>
 
+#include <limits>
+#include <set>
+
 constexpr char DB_BEST_BLOCK = 'B';
 
 constexpr int64_t SYNC_LOG_INTERVAL = 30; // seconds
 constexpr int64_t SYNC_LOCATOR_WRITE_INTERVAL = 30; // seconds
+constexpr size_t MAX_CONNECTED_RECEIPT_BLOCKS = 100;
+
+/** The started indexes, which hold back pruning */
+static Mutex g_started_indexes_mutex;
+static std::set<const BaseIndex*> g_started_indexes GUARDED_BY(g_started_indexes_mutex);
 
 template<typename... Args>
 static void FatalError(const char* fmt, const Args&... args)
@@ -66,6 +75,15 @@ bool BaseIndex::Init()
         m_best_block_index = FindForkInGlobalIndex(chainActive, locator);
     }
     m_synced = m_best_block_index.load() == chainActive.Tip();
+
+    // The blocks still to be indexed must not have been pruned; pruning deletes the
+    // lowest blocks first, so checking the next one is enough
+    if (!m_synced && fHavePruned) {
+        const CBlockIndex* pindex_next = m_best_block_index.load() ? chainActive.Next(m_best_block_index.load()) : chainActive.Genesis();
+        if (pindex_next && !((pindex_next->nStatus & BLOCK_HAVE_DATA) && (pindex_next->nStatus & BLOCK_HAVE_UNDO || pindex_next->nHeight == 0))) {
+            return error("%s: %s needs blocks that have been pruned, it has to be disabled or the node reindexed", __func__, GetName());
+        }
+    }
     return true;
 }
 
@@ -99,17 +117,23 @@ void BaseIndex::ThreadSync()
                 return;
             }
 
+            const CBlockIndex* pindex_next;
             {
                 LOCK(cs_main);
-                const CBlockIndex* pindex_next = NextSyncBlock(pindex);
+                pindex_next = NextSyncBlock(pindex);
                 if (!pindex_next) {
                     WriteBestBlock(pindex);
                     m_best_block_index = pindex;
                     m_synced = true;
                     break;
                 }
-                pindex = pindex_next;
             }
+            if (pindex_next->pprev != pindex && !Rewind(pindex, pindex_next->pprev)) {
+                FatalError("%s: Failed to rewind %s to a previous chain tip",
+                           __func__, GetName());
+                return;
+            }
+            pindex = pindex_next;
 
             int64_t current_time = GetTime();
             if (last_log_time + SYNC_LOG_INTERVAL < current_time) {
@@ -123,6 +147,30 @@ void BaseIndex::ThreadSync()
                 last_locator_write_time = current_time;
             }
 
+            if (UsesBlockViews()) {
+                // Index the block from its bytes, without deserializing the transactions
+                std::vector<uint8_t> raw;
+                std::unique_ptr<CBlockView> block;
+                if (ReadRawBlockFromDisk(raw, pindex, Params().MessageStart())) {
+                    try {
+                        block = MakeUnique<CBlockView>(Span<const unsigned char>(raw.data(), raw.size()));
+                    } catch (const std::exception& e) {
+                        LogPrintf("%s: Deserialize error - %s\n", __func__, e.what());
+                    }
+                }
+                if (!block || block->GetHash() != pindex->GetBlockHash()) {
+                    FatalError("%s: Failed to read block %s from disk",
+                               __func__, pindex->GetBlockHash().ToString());
+                    return;
+                }
+                if (!WriteBlockView(*block, pindex)) {
+                    FatalError("%s: Failed to write block %s to index database",
+                               __func__, pindex->GetBlockHash().ToString());
+                    return;
+                }
+                continue;
+            }
+
             CBlock block;
             if (!ReadBlockFromDisk(block, pindex, consensus_params)) {
                 FatalError("%s: Failed to read block %s from disk",
@@ -180,6 +228,11 @@ void BaseIndex::BlockConnected(const std::shared_ptr<const CBlock>& block, const
                       best_block_index->GetBlockHash().ToString());
             return;
         }
+        if (best_block_index != pindex->pprev && !Rewind(best_block_index, pindex->pprev)) {
+            FatalError("%s: Failed to rewind %s to a previous chain tip",
+                       __func__, GetName());
+            return;
+        }
     }
 
     if (WriteBlock(*block, pindex)) {
@@ -191,6 +244,71 @@ void BaseIndex::BlockConnected(const std::shared_ptr<const CBlock>& block, const
     }
 }
 
+void BaseIndex::BlockDisconnected(const std::shared_ptr<const CBlock>& block)
+{
+    if (!m_synced) {
+        return;
+    }
+
+    const CBlockIndex* pindex;
+    {
+        LOCK(cs_main);
+        pindex = LookupBlockIndex(block->GetHash());
+    }
+
+    // Blocks are disconnected from the tip down. The index may already be past them if it
+    // rewound when the blocks of the new chain were connected.
+    const CBlockIndex* best_block_index = m_best_block_index.load();
+    if (!pindex || best_block_index != pindex) {
+        return;
+    }
+
+    if (!Rewind(best_block_index, pindex->pprev)) {
+        FatalError("%s: Failed to rewind %s to a previous chain tip",
+                   __func__, GetName());
+    }
+}
+
+bool BaseIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    // Keep the locator on disk from pointing to the disconnected blocks
+    if (!WriteBestBlock(new_tip)) {
+        return false;
+    }
+    m_best_block_index = new_tip;
+    return true;
+}
+
+void BaseIndex::BlockReceiptsConnected(const CBlockIndex* pindex, const std::shared_ptr<const BlockReceipts>& receipts)
+{
+    if (!UsesBlockReceipts()) {
+        return;
+    }
+    LOCK(m_cs_connected_receipts);
+    // Receipts of blocks the index does not write soon, or that were disconnected before it
+    // did, are got by ReadBlockReceipts instead
+    if (m_connected_receipts.size() >= MAX_CONNECTED_RECEIPT_BLOCKS) {
+        m_connected_receipts.clear();
+    }
+    m_connected_receipts[pindex->GetBlockHash()] = receipts;
+}
+
+bool BaseIndex::GetConnectedBlockReceipts(const CBlock& block, const CBlockIndex* pindex, const CBlockUndo& blockundo, BlockReceipts& receipts)
+{
+    {
+        LOCK(m_cs_connected_receipts);
+        auto it = m_connected_receipts.find(pindex->GetBlockHash());
+        if (it != m_connected_receipts.end()) {
+            receipts = *it->second;
+            m_connected_receipts.erase(it);
+            return true;
+        }
+    }
+    return ReadBlockReceipts(block, pindex, blockundo, receipts);
+}
+
 void BaseIndex::ChainStateFlushed(const CBlockLocator& locator)
 {
     if (!m_synced) {
@@ -242,8 +360,9 @@ bool BaseIndex::BlockUntilSyncedToCurrentChain()
         // chainActive.Tip().
         LOCK(cs_main);
         const CBlockIndex* chain_tip = chainActive.Tip();
+        // An index ahead of the tip still has blocks to disconnect in the queue
         const CBlockIndex* best_block_index = m_best_block_index.load();
-        if (best_block_index->GetAncestor(chain_tip->nHeight) == chain_tip) {
+        if (best_block_index == chain_tip) {
             return true;
         }
     }
@@ -268,6 +387,11 @@ void BaseIndex::Start()
         return;
     }
 
+    {
+        LOCK(g_started_indexes_mutex);
+        g_started_indexes.insert(this);
+    }
+
     m_thread_sync = std::thread(&TraceThread<std::function<void()>>, GetName(),
                                 std::bind(&BaseIndex::ThreadSync, this));
 }
@@ -275,8 +399,23 @@ void BaseIndex::Start()
 void BaseIndex::Stop()
 {
     UnregisterValidationInterface(this);
+    {
+        LOCK(g_started_indexes_mutex);
+        g_started_indexes.erase(this);
+    }
 
     if (m_thread_sync.joinable()) {
         m_thread_sync.join();
     }
 }
+
+int BaseIndex::GetPruneLockHeight()
+{
+    LOCK(g_started_indexes_mutex);
+    int lock_height = std::numeric_limits<int>::max();
+    for (const BaseIndex* index : g_started_indexes) {
+        const CBlockIndex* best_block = index->m_best_block_index.load();
+        lock_height = std::min(lock_height, best_block ? best_block->nHeight + 1 : 0);
+    }
+    return lock_height;
+}
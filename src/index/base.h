@@ -8,11 +8,16 @@
 #include <dbwrapper.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
+#include <sync.h>
 #include <threadinterrupt.h>
 #include <uint256.h>
 #include <validationinterface.h>
 
+#include <map>
+
 class CBlockIndex;
+class CBlockUndo;
+class CBlockView;
 
 /**
  * Base class for indices of blockchain data. This implements
@@ -57,18 +62,50 @@ private:
     /// Write the current chain block locator to the DB.
     bool WriteBestBlock(const CBlockIndex* block_index);
 
+    Mutex m_cs_connected_receipts;
+    /// Receipts ConnectBlock recorded for blocks the index has not written yet, by block hash
+    std::map<uint256, std::shared_ptr<const BlockReceipts>> m_connected_receipts GUARDED_BY(m_cs_connected_receipts);
+
 protected:
     void BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex,
                         const std::vector<CTransactionRef>& txn_conflicted) override;
 
+    void BlockDisconnected(const std::shared_ptr<const CBlock>& block) override;
+
     void ChainStateFlushed(const CBlockLocator& locator) override;
 
+    void BlockReceiptsConnected(const CBlockIndex* pindex, const std::shared_ptr<const BlockReceipts>& receipts) override;
+
+    /// Whether the index reads the receipts of the blocks it writes, which are then kept from
+    /// BlockReceiptsConnected until the block is written.
+    virtual bool UsesBlockReceipts() const { return false; }
+
+    /// Get the receipts of a block. The receipts ConnectBlock handed to this index come first,
+    /// as the other subscribers, the log index among them, may not have got to the block
+    /// yet; else they are read or executed again by ReadBlockReceipts.
+    bool GetConnectedBlockReceipts(const CBlock& block, const CBlockIndex* pindex, const CBlockUndo& blockundo, BlockReceipts& receipts);
+
     /// Initialize internal state from the database and block index.
     virtual bool Init();
 
     /// Write update index entries for a newly connected block.
     virtual bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) { return true; }
 
+    /// Whether the initial sync passes the blocks it reads from disk to WriteBlockView
+    /// instead of deserializing them for WriteBlock.
+    virtual bool UsesBlockViews() const { return false; }
+
+    /// Write update index entries for a block read in place from disk by the initial sync.
+    virtual bool WriteBlockView(const CBlockView& block, const CBlockIndex* pindex) { return true; }
+
+    /// Rewind the index from current_tip back to new_tip, an ancestor of it, when the blocks
+    /// in between are disconnected. Indexes with entries that depend on the active chain
+    /// remove them here and then call this to move the best block back.
+    virtual bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip);
+
+    /// The last block the index is in sync with, null before the index has any.
+    const CBlockIndex* GetBestBlockIndex() const { return m_best_block_index.load(); }
+
     virtual DB& GetDB() const = 0;
 
     /// Get the name of the index for display in logs.
@@ -93,6 +130,11 @@ public:
 
     /// Stops the instance from staying in sync with blockchain updates.
     void Stop();
+
+    /// Height of the first block that a started index has not processed yet, or the
+    /// maximum int if there is none. Pruning keeps the files of this block and the
+    /// ones above, which the indexes read their blocks and undo data from.
+    static int GetPruneLockHeight();
 };
 
 #endif // BITCOIN_INDEX_BASE_H
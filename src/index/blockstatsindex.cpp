@@ -0,0 +1,162 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/blockstatsindex.h>
+
+#include <consensus/validation.h>
+#include <rpc/blockchain.h>
+#include <undo.h>
+#include <util/system.h>
+#include <validation.h>
+#include <version.h>
+
+constexpr char DB_BLOCKSTATS = 's';
+
+std::unique_ptr<BlockStatsIndex> g_blockstatsindex;
+
+/**
+ * Access to the block statistics index database (indexes/blockstatsindex/)
+ *
+ * Besides the block locator of BaseIndex, the database holds the statistics of each
+ * indexed block by block hash.
+ */
+class BlockStatsIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    bool ReadStats(const uint256& block_hash, BlockStats& stats) const;
+    bool WriteStats(const uint256& block_hash, const BlockStats& stats);
+};
+
+BlockStatsIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(GetDataDir() / "indexes" / "blockstatsindex", n_cache_size, f_memory, f_wipe)
+{}
+
+bool BlockStatsIndex::DB::ReadStats(const uint256& block_hash, BlockStats& stats) const
+{
+    return Read(std::make_pair(DB_BLOCKSTATS, block_hash), stats);
+}
+
+bool BlockStatsIndex::DB::WriteStats(const uint256& block_hash, const BlockStats& stats)
+{
+    return Write(std::make_pair(DB_BLOCKSTATS, block_hash), stats);
+}
+
+bool ComputeBlockStats(const CBlock& block, const CBlockIndex* pindex, const CBlockUndo& blockundo, BlockStats& stats)
+{
+    BlockReceipts receipts;
+    if (blockundo.vtxundo.size() + 1 == block.vtx.size() && !ReadBlockReceipts(block, pindex, blockundo, receipts))
+        return false;
+    return ComputeBlockStats(block, pindex, blockundo, receipts, stats);
+}
+
+bool ComputeBlockStats(const CBlock& block, const CBlockIndex* pindex, const CBlockUndo& blockundo, const BlockReceipts& receipts, BlockStats& stats)
+{
+    if (blockundo.vtxundo.size() + 1 != block.vtx.size())
+        return error("%s: block and undo data inconsistent", __func__);
+
+    stats = BlockStats();
+    for (const std::pair<uint256, std::vector<TransactionReceiptInfo>>& entry : receipts) {
+        for (const TransactionReceiptInfo& receipt : entry.second)
+            stats.gasused += receipt.gasUsed;
+    }
+
+    std::vector<CAmount> fee_array;
+    std::vector<std::pair<CAmount, int64_t>> feerate_array;
+    std::vector<int64_t> txsize_array;
+    stats.txs = block.vtx.size();
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = *block.vtx[i];
+        stats.outs += tx.vout.size();
+        if (tx.HasCreateOrCall())
+            stats.contracttxs++;
+
+        CAmount tx_total_out = 0;
+        for (const CTxOut& out : tx.vout) {
+            tx_total_out += out.nValue;
+            stats.utxo_size_inc += GetSerializeSize(out, PROTOCOL_VERSION) + PER_UTXO_OVERHEAD;
+        }
+
+        if (tx.IsCoinBase() || tx.IsCoinStake())
+            continue;
+
+        stats.ins += tx.vin.size();
+        stats.total_out += tx_total_out;
+
+        const int64_t tx_size = tx.GetTotalSize();
+        txsize_array.push_back(tx_size);
+        stats.mintxsize = txsize_array.size() == 1 ? tx_size : std::min(stats.mintxsize, tx_size);
+        stats.maxtxsize = std::max(stats.maxtxsize, tx_size);
+        stats.total_size += tx_size;
+
+        const int64_t weight = GetTransactionWeight(tx);
+        stats.total_weight += weight;
+
+        if (tx.HasWitness()) {
+            stats.swtxs++;
+            stats.swtotal_size += tx_size;
+            stats.swtotal_weight += weight;
+        }
+
+        const CTxUndo& txundo = blockundo.vtxundo[i - 1];
+        if (txundo.vprevout.size() != tx.vin.size())
+            return error("%s: transaction and undo data inconsistent", __func__);
+        CAmount tx_total_in = 0;
+        for (const Coin& coin : txundo.vprevout) {
+            tx_total_in += coin.out.nValue;
+            stats.utxo_size_inc -= GetSerializeSize(coin.out, PROTOCOL_VERSION) + PER_UTXO_OVERHEAD;
+        }
+
+        const CAmount txfee = tx_total_in - tx_total_out;
+        if (!MoneyRange(txfee))
+            return error("%s: fee of transaction %s out of range", __func__, tx.GetHash().ToString());
+        fee_array.push_back(txfee);
+        stats.minfee = fee_array.size() == 1 ? txfee : std::min(stats.minfee, txfee);
+        stats.maxfee = std::max(stats.maxfee, txfee);
+        stats.totalfee += txfee;
+
+        // Satoshis per virtual byte, as getblockstats computes them
+        const CAmount feerate = weight ? (txfee * WITNESS_SCALE_FACTOR) / weight : 0;
+        feerate_array.emplace_back(feerate, weight);
+        stats.minfeerate = feerate_array.size() == 1 ? feerate : std::min(stats.minfeerate, feerate);
+        stats.maxfeerate = std::max(stats.maxfeerate, feerate);
+    }
+
+    stats.medianfee = CalculateTruncatedMedian(fee_array);
+    stats.mediantxsize = CalculateTruncatedMedian(txsize_array);
+    CAmount feerate_percentiles[NUM_GETBLOCKSTATS_PERCENTILES] = { 0 };
+    CalculatePercentilesByWeight(feerate_percentiles, feerate_array, stats.total_weight);
+    stats.feerate_percentiles.assign(feerate_percentiles, feerate_percentiles + NUM_GETBLOCKSTATS_PERCENTILES);
+    return true;
+}
+
+BlockStatsIndex::BlockStatsIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<BlockStatsIndex::DB>(n_cache_size, f_memory, f_wipe))
+{}
+
+BlockStatsIndex::~BlockStatsIndex() {}
+
+bool BlockStatsIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    CBlockUndo blockundo;
+    if (pindex->nHeight > 0 && !UndoReadFromDisk(blockundo, pindex))
+        return false;
+
+    BlockReceipts receipts;
+    if (blockundo.vtxundo.size() + 1 == block.vtx.size() && !GetConnectedBlockReceipts(block, pindex, blockundo, receipts))
+        return error("%s: Failed to get the receipts of block %s", __func__, pindex->GetBlockHash().ToString());
+
+    BlockStats stats;
+    if (!ComputeBlockStats(block, pindex, blockundo, receipts, stats))
+        return error("%s: Failed to compute the statistics of block %s", __func__, pindex->GetBlockHash().ToString());
+    return m_db->WriteStats(pindex->GetBlockHash(), stats);
+}
+
+BaseIndex::DB& BlockStatsIndex::GetDB() const { return *m_db; }
+
+bool BlockStatsIndex::LookupStats(const CBlockIndex* pindex, BlockStats& stats) const
+{
+    return m_db->ReadStats(pindex->GetBlockHash(), stats);
+}
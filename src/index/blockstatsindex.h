@@ -0,0 +1,124 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef INDEX_BLOCKSTATSINDEX_H
+#define INDEX_BLOCKSTATSINDEX_H
+
+#include <amount.h>
+#include <chain.h>
+#include <index/base.h>
+#include <serialize.h>
+
+#include <memory>
+#include <vector>
+
+class CBlockUndo;
+
+/** Maximum size of the cache of the block statistics index database, in MiB */
+static const int64_t MAX_BLOCKSTATSINDEX_CACHE = 16;
+
+/**
+ * Statistics of the transactions of a block, as getblockstats returns them. The coinbase
+ * and the coinstake are left out of all of them but the output counts and totals.
+ */
+struct BlockStats
+{
+    CAmount totalfee{0};
+    CAmount minfee{0};
+    CAmount maxfee{0};
+    CAmount medianfee{0};
+    CAmount minfeerate{0};
+    CAmount maxfeerate{0};
+    //! Feerates at the 10th, 25th, 50th, 75th and 90th percentile weight unit
+    std::vector<CAmount> feerate_percentiles;
+    CAmount total_out{0};
+    int64_t ins{0};
+    int64_t outs{0};
+    int64_t txs{0};
+    int64_t total_size{0};
+    int64_t total_weight{0};
+    int64_t mintxsize{0};
+    int64_t maxtxsize{0};
+    int64_t mediantxsize{0};
+    int64_t swtxs{0};
+    int64_t swtotal_size{0};
+    int64_t swtotal_weight{0};
+    int64_t utxo_size_inc{0};
+    //! Transactions that create or call contracts, and the gas their executions used
+    int64_t contracttxs{0};
+    uint64_t gasused{0};
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(totalfee);
+        READWRITE(minfee);
+        READWRITE(maxfee);
+        READWRITE(medianfee);
+        READWRITE(minfeerate);
+        READWRITE(maxfeerate);
+        READWRITE(feerate_percentiles);
+        READWRITE(total_out);
+        READWRITE(ins);
+        READWRITE(outs);
+        READWRITE(txs);
+        READWRITE(total_size);
+        READWRITE(total_weight);
+        READWRITE(mintxsize);
+        READWRITE(maxtxsize);
+        READWRITE(mediantxsize);
+        READWRITE(swtxs);
+        READWRITE(swtotal_size);
+        READWRITE(swtotal_weight);
+        READWRITE(utxo_size_inc);
+        READWRITE(contracttxs);
+        READWRITE(gasused);
+    }
+};
+
+/** Compute the statistics of a connected block, with the spent outputs from its undo data */
+bool ComputeBlockStats(const CBlock& block, const CBlockIndex* pindex, const CBlockUndo& blockundo, BlockStats& stats);
+
+/** Compute the statistics of a connected block, with the receipts of its contract transactions */
+bool ComputeBlockStats(const CBlock& block, const CBlockIndex* pindex, const CBlockUndo& blockundo, const BlockReceipts& receipts, BlockStats& stats);
+
+/**
+ * BlockStatsIndex records the statistics of each block when it is connected, so that
+ * getblockstats reads them instead of the block, its spent outputs and its receipts.
+ * The records are stored by block hash, so the ones of disconnected blocks stay valid.
+ */
+class BlockStatsIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    bool UsesBlockReceipts() const override { return true; }
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "blockstatsindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit BlockStatsIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~BlockStatsIndex() override;
+
+    /// Look up the statistics of a block, false if the index has not got to it yet.
+    bool LookupStats(const CBlockIndex* pindex, BlockStats& stats) const;
+};
+
+/// The global block statistics index, used by getblockstats. May be null.
+extern std::unique_ptr<BlockStatsIndex> g_blockstatsindex;
+
+#endif
@@ -0,0 +1,409 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/contractindex.h>
+
+#include <undo.h>
+#include <util/convert.h>
+#include <util/system.h>
+#include <validation.h>
+
+#include <libdevcore/SHA3.h>
+
+#include <algorithm>
+#include <map>
+
+constexpr char DB_CONTRACT = 'c';
+constexpr char DB_CONTRACT_HEIGHT = 'h';
+constexpr char DB_CONTRACT_DESTRUCTED = 'd';
+constexpr char DB_CONTRACT_CODEHASH = 'k';
+constexpr char DB_CONTRACT_COUNT = 'n';
+constexpr char DB_CONTRACT_STATE = 's';
+constexpr char DB_CONTRACT_STATE_UNDO = 'u';
+constexpr char DB_CONTRACT_STATE_TOTAL = 't';
+
+std::unique_ptr<ContractIndex> g_contractindex;
+
+static uint160 AddressKey(const dev::h160& address)
+{
+    return uint160(address.asBytes());
+}
+
+static dev::h160 KeyAddress(const uint160& key)
+{
+    return dev::h160(std::vector<unsigned char>(key.begin(), key.end()));
+}
+
+/** Add a signed change to a count, which does not go below zero */
+static uint64_t AddDelta(uint64_t value, int64_t delta)
+{
+    if (delta < 0)
+        return value > uint64_t(-delta) ? value - uint64_t(-delta) : 0;
+    return value + uint64_t(delta);
+}
+
+ContractStateSize& ContractStateSize::operator+=(const ContractStateSize& other)
+{
+    nStorageSlots += other.nStorageSlots;
+    nCodeSize += other.nCodeSize;
+    nTrieNodes += other.nTrieNodes;
+    return *this;
+}
+
+ContractStateSize& ContractStateSize::operator-=(const ContractStateSize& other)
+{
+    nStorageSlots -= std::min(nStorageSlots, other.nStorageSlots);
+    nCodeSize -= std::min(nCodeSize, other.nCodeSize);
+    nTrieNodes -= std::min(nTrieNodes, other.nTrieNodes);
+    return *this;
+}
+
+/** Key of a contract by the transaction that created or destructed it, in block order */
+struct DBHeightKey
+{
+    int nHeight;
+    uint32_t nTxIndex;
+    uint160 address;
+
+    DBHeightKey() : nHeight(0), nTxIndex(0) {}
+    DBHeightKey(int height, uint32_t tx_index, const uint160& address_in) : nHeight(height), nTxIndex(tx_index), address(address_in) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata32be(s, nHeight);
+        ser_writedata32be(s, nTxIndex);
+        s << address;
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        nHeight = ser_readdata32be(s);
+        nTxIndex = ser_readdata32be(s);
+        s >> address;
+    }
+};
+
+/**
+ * Access to the contract index database (indexes/contractindex/)
+ *
+ * The database stores the block locator of BaseIndex, the registry entry of each
+ * contract by address, the contracts by the height and transaction that created them
+ * and that destructed them, the contracts by code hash, and the number of contracts
+ * alive at the last block indexed. The state size of each contract is kept by address
+ * with their total, and by height the sizes the contracts a block changed had before it.
+ */
+class ContractIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+};
+
+ContractIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(GetDataDir() / "indexes" / "contractindex", n_cache_size, f_memory, f_wipe)
+{}
+
+ContractIndex::ContractIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<ContractIndex::DB>(n_cache_size, f_memory, f_wipe))
+{}
+
+ContractIndex::~ContractIndex() {}
+
+bool ContractIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    // The genesis block has no contract transactions
+    if (pindex->nHeight == 0) {
+        return true;
+    }
+    bool fHasContracts = false;
+    for (const CTransactionRef& tx : block.vtx) {
+        fHasContracts |= tx->HasCreateOrCall();
+    }
+    if (!fHasContracts) {
+        return true;
+    }
+
+    CBlockUndo blockundo;
+    if (!UndoReadFromDisk(blockundo, pindex)) {
+        return false;
+    }
+    BlockReceipts receipts;
+    if (!GetConnectedBlockReceipts(block, pindex, blockundo, receipts)) {
+        return error("%s: Failed to get the receipts of block %s", __func__, pindex->GetBlockHash().ToString());
+    }
+
+    uint64_t count = 0;
+    if (m_db->Exists(DB_CONTRACT_COUNT) && !m_db->Read(DB_CONTRACT_COUNT, count)) {
+        return error("%s: Failed to read the contract count", __func__);
+    }
+
+    // Results recorded without the storage growth are executed again to measure it
+    bool fStorageGrowth = true;
+    for (const std::pair<uint256, std::vector<TransactionReceiptInfo>>& entry : receipts) {
+        for (const TransactionReceiptInfo& receipt : entry.second)
+            fStorageGrowth &= receipt.fStorageGrowth;
+    }
+    if (!fStorageGrowth) {
+        BlockReceipts replayed;
+        if (ReplayBlockReceipts(block, pindex, blockundo, replayed)) {
+            receipts = std::move(replayed);
+        } else {
+            LogPrintf("%s: The storage the contracts gained in block %s is not counted\n", __func__, pindex->GetBlockHash().ToString());
+        }
+    }
+
+    CDBBatch batch(*m_db);
+    std::map<uint160, ContractInfo> changed;
+    // State sizes changed so far, and the ones they had before the block
+    std::map<uint160, ContractStateSize> sizes;
+    std::vector<std::pair<uint160, ContractStateSize>> undo;
+    auto get_size = [&](const uint160& address) -> ContractStateSize& {
+        auto it = sizes.find(address);
+        if (it == sizes.end()) {
+            ContractStateSize size;
+            if (!m_db->Read(std::make_pair(DB_CONTRACT_STATE, address), size))
+                size = ContractStateSize();
+            undo.emplace_back(address, size);
+            it = sizes.emplace(address, size).first;
+        }
+        return it->second;
+    };
+    for (const std::pair<uint256, std::vector<TransactionReceiptInfo>>& entry : receipts) {
+        for (const TransactionReceiptInfo& receipt : entry.second) {
+            for (const std::pair<dev::Address, dev::bytes>& created : receipt.createdContracts) {
+                const uint160 address = AddressKey(created.first);
+                ContractInfo& info = changed[address];
+                info = ContractInfo();
+                info.nHeight = pindex->nHeight;
+                info.nTxIndex = receipt.transactionIndex;
+                info.hashCreatorTx = entry.first;
+                info.hashCode = h256Touint(dev::sha3(created.second));
+                batch.Write(std::make_pair(DB_CONTRACT_HEIGHT, DBHeightKey(info.nHeight, info.nTxIndex, address)), '\0');
+                batch.Write(std::make_pair(DB_CONTRACT_CODEHASH, std::make_pair(info.hashCode, address)), '\0');
+                count++;
+                ContractStateSize& size = get_size(address);
+                size = ContractStateSize();
+                size.nCodeSize = created.second.size();
+            }
+            for (const std::pair<dev::Address, StateTrieDiff>& growth : receipt.storageGrowth) {
+                ContractStateSize& size = get_size(AddressKey(growth.first));
+                size.nStorageSlots = AddDelta(size.nStorageSlots, growth.second.nLeaves);
+                size.nTrieNodes = AddDelta(size.nTrieNodes, growth.second.nNodes);
+            }
+            for (const dev::Address& destructed : receipt.destructedContracts) {
+                const uint160 address = AddressKey(destructed);
+                auto it = changed.find(address);
+                if (it == changed.end()) {
+                    ContractInfo info;
+                    if (!m_db->Read(std::make_pair(DB_CONTRACT, address), info))
+                        continue;
+                    it = changed.emplace(address, info).first;
+                }
+                if (it->second.nDestructedHeight >= 0)
+                    continue;
+                it->second.nDestructedHeight = pindex->nHeight;
+                batch.Write(std::make_pair(DB_CONTRACT_DESTRUCTED, DBHeightKey(pindex->nHeight, receipt.transactionIndex, address)), '\0');
+                count--;
+                get_size(address) = ContractStateSize();
+            }
+        }
+    }
+    if (changed.empty() && sizes.empty()) {
+        return true;
+    }
+
+    for (const std::pair<uint160, ContractInfo>& contract : changed) {
+        batch.Write(std::make_pair(DB_CONTRACT, contract.first), contract.second);
+    }
+    batch.Write(DB_CONTRACT_COUNT, count);
+
+    if (!sizes.empty()) {
+        ContractStateSize total;
+        if (m_db->Exists(DB_CONTRACT_STATE_TOTAL) && !m_db->Read(DB_CONTRACT_STATE_TOTAL, total)) {
+            return error("%s: Failed to read the total contract state size", __func__);
+        }
+        for (const std::pair<uint160, ContractStateSize>& size : undo) {
+            total -= size.second;
+        }
+        for (const std::pair<uint160, ContractStateSize>& size : sizes) {
+            total += size.second;
+            if (size.second.IsNull())
+                batch.Erase(std::make_pair(DB_CONTRACT_STATE, size.first));
+            else
+                batch.Write(std::make_pair(DB_CONTRACT_STATE, size.first), size.second);
+        }
+        batch.Write(std::make_pair(DB_CONTRACT_STATE_UNDO, DBHeightKey(pindex->nHeight, 0, uint160())), undo);
+        batch.Write(DB_CONTRACT_STATE_TOTAL, total);
+    }
+    return m_db->WriteBatch(batch);
+}
+
+bool ContractIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    uint64_t count = 0;
+    if (m_db->Exists(DB_CONTRACT_COUNT) && !m_db->Read(DB_CONTRACT_COUNT, count)) {
+        return error("%s: Failed to read the contract count", __func__);
+    }
+
+    CDBBatch batch(*m_db);
+    // Registry entries read or changed so far, null once erased
+    std::map<uint160, std::unique_ptr<ContractInfo>> changed;
+    auto get_info = [&](const uint160& address) -> ContractInfo* {
+        auto it = changed.find(address);
+        if (it == changed.end()) {
+            std::unique_ptr<ContractInfo> info = MakeUnique<ContractInfo>();
+            if (!m_db->Read(std::make_pair(DB_CONTRACT, address), *info))
+                info.reset();
+            it = changed.emplace(address, std::move(info)).first;
+        }
+        return it->second.get();
+    };
+
+    // The destructions first, so that a contract created and destructed in the rewound
+    // blocks is counted as alive when its creation is undone
+    std::unique_ptr<CDBIterator> db_it(m_db->NewIterator());
+    for (db_it->Seek(std::make_pair(DB_CONTRACT_DESTRUCTED, DBHeightKey(new_tip->nHeight + 1, 0, uint160()))); db_it->Valid(); db_it->Next()) {
+        std::pair<char, DBHeightKey> key;
+        if (!db_it->GetKey(key) || key.first != DB_CONTRACT_DESTRUCTED) break;
+        ContractInfo* info = get_info(key.second.address);
+        if (info && info->nDestructedHeight == key.second.nHeight) {
+            info->nDestructedHeight = -1;
+            count++;
+        }
+        batch.Erase(key);
+    }
+
+    for (db_it->Seek(std::make_pair(DB_CONTRACT_HEIGHT, DBHeightKey(new_tip->nHeight + 1, 0, uint160()))); db_it->Valid(); db_it->Next()) {
+        std::pair<char, DBHeightKey> key;
+        if (!db_it->GetKey(key) || key.first != DB_CONTRACT_HEIGHT) break;
+        ContractInfo* info = get_info(key.second.address);
+        if (info && info->nHeight == key.second.nHeight && info->nTxIndex == key.second.nTxIndex) {
+            batch.Erase(std::make_pair(DB_CONTRACT_CODEHASH, std::make_pair(info->hashCode, key.second.address)));
+            if (info->nDestructedHeight < 0)
+                count--;
+            changed[key.second.address].reset();
+        }
+        batch.Erase(key);
+    }
+
+    for (const auto& contract : changed) {
+        if (contract.second)
+            batch.Write(std::make_pair(DB_CONTRACT, contract.first), *contract.second);
+        else
+            batch.Erase(std::make_pair(DB_CONTRACT, contract.first));
+    }
+    batch.Write(DB_CONTRACT_COUNT, count);
+
+    // The state sizes go back to the ones before the first rewound block that changed them
+    std::map<uint160, ContractStateSize> restored;
+    for (db_it->Seek(std::make_pair(DB_CONTRACT_STATE_UNDO, DBHeightKey(new_tip->nHeight + 1, 0, uint160()))); db_it->Valid(); db_it->Next()) {
+        std::pair<char, DBHeightKey> key;
+        if (!db_it->GetKey(key) || key.first != DB_CONTRACT_STATE_UNDO) break;
+        std::vector<std::pair<uint160, ContractStateSize>> undo;
+        if (!db_it->GetValue(undo)) {
+            return error("%s: Failed to read the contract state sizes before block %d", __func__, key.second.nHeight);
+        }
+        for (const std::pair<uint160, ContractStateSize>& size : undo) {
+            restored.emplace(size.first, size.second);
+        }
+        batch.Erase(key);
+    }
+    if (!restored.empty()) {
+        ContractStateSize total;
+        if (m_db->Exists(DB_CONTRACT_STATE_TOTAL) && !m_db->Read(DB_CONTRACT_STATE_TOTAL, total)) {
+            return error("%s: Failed to read the total contract state size", __func__);
+        }
+        for (const std::pair<uint160, ContractStateSize>& size : restored) {
+            ContractStateSize current;
+            if (m_db->Read(std::make_pair(DB_CONTRACT_STATE, size.first), current))
+                total -= current;
+            total += size.second;
+            if (size.second.IsNull())
+                batch.Erase(std::make_pair(DB_CONTRACT_STATE, size.first));
+            else
+                batch.Write(std::make_pair(DB_CONTRACT_STATE, size.first), size.second);
+        }
+        batch.Write(DB_CONTRACT_STATE_TOTAL, total);
+    }
+    if (!m_db->WriteBatch(batch)) {
+        return error("%s: Failed to delete the contracts of the disconnected blocks", __func__);
+    }
+    return BaseIndex::Rewind(current_tip, new_tip);
+}
+
+BaseIndex::DB& ContractIndex::GetDB() const { return *m_db; }
+
+int ContractIndex::GetIndexedHeight() const
+{
+    const CBlockIndex* pindex = GetBestBlockIndex();
+    return pindex ? pindex->nHeight : -1;
+}
+
+bool ContractIndex::GetContractCount(uint64_t& count) const
+{
+    count = 0;
+    return !m_db->Exists(DB_CONTRACT_COUNT) || m_db->Read(DB_CONTRACT_COUNT, count);
+}
+
+bool ContractIndex::LookupContract(const dev::h160& address, ContractInfo& info) const
+{
+    return m_db->Read(std::make_pair(DB_CONTRACT, AddressKey(address)), info);
+}
+
+bool ContractIndex::LookupContractState(const dev::h160& address, ContractStateSize& size) const
+{
+    size = ContractStateSize();
+    const auto key = std::make_pair(DB_CONTRACT_STATE, AddressKey(address));
+    return !m_db->Exists(key) || m_db->Read(key, size);
+}
+
+bool ContractIndex::GetTotalContractState(ContractStateSize& size) const
+{
+    size = ContractStateSize();
+    return !m_db->Exists(DB_CONTRACT_STATE_TOTAL) || m_db->Read(DB_CONTRACT_STATE_TOTAL, size);
+}
+
+bool ContractIndex::ListContracts(int nAtHeight, size_t nSkip, size_t nCount,
+                                  std::vector<std::pair<dev::h160, ContractInfo>>& contracts) const
+{
+    std::unique_ptr<CDBIterator> db_it(m_db->NewIterator());
+    for (db_it->Seek(std::make_pair(DB_CONTRACT_HEIGHT, DBHeightKey())); db_it->Valid() && contracts.size() < nCount; db_it->Next()) {
+        std::pair<char, DBHeightKey> key;
+        if (!db_it->GetKey(key) || key.first != DB_CONTRACT_HEIGHT || key.second.nHeight > nAtHeight) break;
+        ContractInfo info;
+        if (!m_db->Read(std::make_pair(DB_CONTRACT, key.second.address), info)) {
+            return error("%s: Missing registry entry of contract %s", __func__, KeyAddress(key.second.address).hex());
+        }
+        // Left behind by a contract created again at the same address
+        if (info.nHeight != key.second.nHeight || info.nTxIndex != key.second.nTxIndex)
+            continue;
+        if (!info.IsAliveAt(nAtHeight))
+            continue;
+        if (nSkip > 0) {
+            nSkip--;
+            continue;
+        }
+        contracts.emplace_back(KeyAddress(key.second.address), info);
+    }
+    return true;
+}
+
+bool ContractIndex::FindContractsByCodeHash(const uint256& hashCode, std::vector<std::pair<dev::h160, ContractInfo>>& contracts) const
+{
+    std::unique_ptr<CDBIterator> db_it(m_db->NewIterator());
+    for (db_it->Seek(std::make_pair(DB_CONTRACT_CODEHASH, std::make_pair(hashCode, uint160()))); db_it->Valid(); db_it->Next()) {
+        std::pair<char, std::pair<uint256, uint160>> key;
+        if (!db_it->GetKey(key) || key.first != DB_CONTRACT_CODEHASH || key.second.first != hashCode) break;
+        ContractInfo info;
+        if (!m_db->Read(std::make_pair(DB_CONTRACT, key.second.second), info)) {
+            return error("%s: Missing registry entry of contract %s", __func__, KeyAddress(key.second.second).hex());
+        }
+        if (info.hashCode == hashCode)
+            contracts.emplace_back(KeyAddress(key.second.second), info);
+    }
+    return true;
+}
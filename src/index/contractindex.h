@@ -0,0 +1,135 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef INDEX_CONTRACTINDEX_H
+#define INDEX_CONTRACTINDEX_H
+
+#include <chain.h>
+#include <index/base.h>
+#include <serialize.h>
+#include <uint256.h>
+
+#include <libdevcore/FixedHash.h>
+
+#include <memory>
+#include <vector>
+
+/** Maximum size of the cache of the contract index database, in MiB */
+static const int64_t MAX_CONTRACTINDEX_CACHE = 16;
+
+/** Registry entry of a contract: where it was created, its code and whether it is still alive */
+struct ContractInfo
+{
+    //! Height of the block that created the contract
+    int nHeight{0};
+    //! Index in the block of the transaction that created it, and its hash
+    uint32_t nTxIndex{0};
+    uint256 hashCreatorTx;
+    //! Keccak-256 hash of the code of the contract
+    uint256 hashCode;
+    //! Height of the block that destructed the contract, -1 while it is alive
+    int nDestructedHeight{-1};
+
+    bool IsAliveAt(int nAtHeight) const { return nHeight <= nAtHeight && (nDestructedHeight < 0 || nDestructedHeight > nAtHeight); }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(nHeight);
+        READWRITE(nTxIndex);
+        READWRITE(hashCreatorTx);
+        READWRITE(hashCode);
+        READWRITE(nDestructedHeight);
+    }
+};
+
+/** Size of the state of a contract, in the units disk and cache sizes are planned in */
+struct ContractStateSize
+{
+    //! Storage slots with a value other than zero
+    uint64_t nStorageSlots{0};
+    //! Bytes of code
+    uint64_t nCodeSize{0};
+    //! Nodes of the storage trie stored in the state database
+    uint64_t nTrieNodes{0};
+
+    bool IsNull() const { return nStorageSlots == 0 && nCodeSize == 0 && nTrieNodes == 0; }
+
+    ContractStateSize& operator+=(const ContractStateSize& other);
+    ContractStateSize& operator-=(const ContractStateSize& other);
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(VARINT(nStorageSlots));
+        READWRITE(VARINT(nCodeSize));
+        READWRITE(VARINT(nTrieNodes));
+    }
+};
+
+/**
+ * ContractIndex is the registry of the contracts created on the active chain, built from
+ * the created and destructed contracts of the receipts of each block. It lists the
+ * contracts in creation order and by code hash, so that listcontracts and
+ * listallcontracts do not walk all the accounts of the state trie. It also keeps the
+ * size of the state of each contract, from the storage growth the executions measure.
+ */
+class ContractIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
+
+    bool UsesBlockReceipts() const override { return true; }
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "contractindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit ContractIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~ContractIndex() override;
+
+    /// Height of the last block indexed, -1 before the index has any.
+    int GetIndexedHeight() const;
+
+    /// Number of contracts alive at the last block indexed.
+    bool GetContractCount(uint64_t& count) const;
+
+    /// Look up the registry entry of a contract, false if it was never created.
+    bool LookupContract(const dev::h160& address, ContractInfo& info) const;
+
+    /// List the contracts alive at a height up to the last block indexed, in creation
+    /// order, leaving out the first nSkip of them and returning at most nCount.
+    bool ListContracts(int nAtHeight, size_t nSkip, size_t nCount,
+                       std::vector<std::pair<dev::h160, ContractInfo>>& contracts) const;
+
+    /// Look up the size of the state of a contract, null if it has none.
+    bool LookupContractState(const dev::h160& address, ContractStateSize& size) const;
+
+    /// Size of the state of all contracts at the last block indexed.
+    bool GetTotalContractState(ContractStateSize& size) const;
+
+    /// Find the contracts created with a code hash, the destructed ones included.
+    bool FindContractsByCodeHash(const uint256& hashCode, std::vector<std::pair<dev::h160, ContractInfo>>& contracts) const;
+};
+
+/// The global contract index, used by the contract listing RPCs. May be null.
+extern std::unique_ptr<ContractIndex> g_contractindex;
+
+#endif
@@ -0,0 +1,298 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/logindex.h>
+
+#include <chainparams.h>
+#include <txdb.h>
+#include <undo.h>
+#include <util/convert.h>
+#include <util/system.h>
+
+#include <set>
+
+constexpr char DB_TOPICINDEX = 'T';
+constexpr char DB_ADDRESSINDEX = 'E';
+
+/** Number of blocks whose receipts ConnectBlock hands over before the index catches up with them */
+static const size_t MAX_PENDING_RECEIPT_BLOCKS = 100;
+
+std::unique_ptr<LogIndex> g_logindex;
+
+/**
+ * Access to the log index database (indexes/logindex/)
+ *
+ * Besides the block locator of BaseIndex, the database records whether the topic index
+ * and the contract address index were built with the entries up to the locator.
+ */
+class LogIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    bool ReadTopicIndexFlag(bool& fTopicIndex) const;
+    bool WriteTopicIndexFlag(bool fTopicIndex);
+
+    bool ReadAddressIndexFlag(bool& fAddressIndex) const;
+    bool WriteAddressIndexFlag(bool fAddressIndex);
+};
+
+LogIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(GetDataDir() / "indexes" / "logindex", n_cache_size, f_memory, f_wipe)
+{}
+
+bool LogIndex::DB::ReadTopicIndexFlag(bool& fTopicIndex) const
+{
+    fTopicIndex = false;
+    return Read(DB_TOPICINDEX, fTopicIndex);
+}
+
+bool LogIndex::DB::WriteTopicIndexFlag(bool fTopicIndex)
+{
+    return Write(DB_TOPICINDEX, fTopicIndex);
+}
+
+bool LogIndex::DB::ReadAddressIndexFlag(bool& fAddressIndex) const
+{
+    fAddressIndex = false;
+    return Read(DB_ADDRESSINDEX, fAddressIndex);
+}
+
+bool LogIndex::DB::WriteAddressIndexFlag(bool fAddressIndex)
+{
+    return Write(DB_ADDRESSINDEX, fAddressIndex);
+}
+
+/** Remove all the -logevents entries, so that the index builds them again from genesis */
+static bool WipeLogEntries()
+{
+    pstorageresult->wipeResults();
+    return pblocktree->WipeHeightIndex() && pblocktree->WipeTopicIndex() && pblocktree->WipeContractAddressIndex() &&
+           pblocktree->WriteLogBloomStart(0);
+}
+
+LogIndex::LogIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<LogIndex::DB>(n_cache_size, f_memory, f_wipe))
+{}
+
+LogIndex::~LogIndex() {}
+
+bool LogIndex::Init()
+{
+    CBlockLocator locator;
+    m_db->ReadBestBlock(locator);
+    bool fTopicIndex = false;
+    m_db->ReadTopicIndexFlag(fTopicIndex);
+    bool fAddressIndex = false;
+    m_db->ReadAddressIndexFlag(fAddressIndex);
+
+    if (locator.IsNull()) {
+        // Take over the entries that ConnectBlock wrote with -logevents before the index was
+        // built in the background, they are in sync with the chain state. The contract address
+        // index did not exist then.
+        bool fLegacyLogEvents = false;
+        bool fLegacyTopicIndex = false;
+        pblocktree->ReadFlag("logevents", fLegacyLogEvents);
+        pblocktree->ReadFlag("logtopicindex", fLegacyTopicIndex);
+        if (fLegacyLogEvents && (fLegacyTopicIndex || !fLogTopicIndex) && !fLogAddressIndex) {
+            if (fLegacyTopicIndex && !fLogTopicIndex && !pblocktree->WipeTopicIndex()) {
+                return error("%s: Failed to wipe topic index", __func__);
+            }
+            LOCK(cs_main);
+            locator = chainActive.GetLocator();
+            LogPrintf("%s: taking over the log entries up to height %d\n", __func__, chainActive.Height());
+        } else if (!WipeLogEntries()) {
+            return error("%s: Failed to wipe log entries", __func__);
+        }
+        if (!pblocktree->WriteFlag("logevents", false) || !pblocktree->WriteFlag("logtopicindex", false) ||
+            !m_db->WriteBestBlock(locator)) {
+            return error("%s: Failed to write locator to disk", __func__);
+        }
+    } else if ((fLogTopicIndex && !fTopicIndex) || (fLogAddressIndex && !fAddressIndex)) {
+        // The topics or the addresses of the blocks indexed so far are missing
+        LogPrintf("%s: -logtopicindex or -logaddressindex enabled, indexing the logs again from genesis\n", __func__);
+        locator.SetNull();
+        if (!WipeLogEntries() || !m_db->WriteBestBlock(locator)) {
+            return error("%s: Failed to wipe log entries", __func__);
+        }
+    } else {
+        if (fTopicIndex && !fLogTopicIndex && !pblocktree->WipeTopicIndex()) {
+            return error("%s: Failed to wipe topic index", __func__);
+        }
+        if (fAddressIndex && !fLogAddressIndex && !pblocktree->WipeContractAddressIndex()) {
+            return error("%s: Failed to wipe contract address index", __func__);
+        }
+    }
+
+    if (!m_db->WriteTopicIndexFlag(fLogTopicIndex) || !m_db->WriteAddressIndexFlag(fLogAddressIndex)) {
+        return error("%s: Failed to write index flags", __func__);
+    }
+    return BaseIndex::Init();
+}
+
+void LogIndex::AddPendingReceipts(const CBlockIndex* pindex, const std::shared_ptr<const BlockReceipts>& receipts)
+{
+    LOCK(m_cs_pending);
+    // Receipts of blocks the index will not reach soon, or that were disconnected before it
+    // did, are executed again instead
+    if (m_pending_receipts.size() >= MAX_PENDING_RECEIPT_BLOCKS) {
+        m_pending_receipts.clear();
+    }
+    m_pending_receipts[pindex->GetBlockHash()] = receipts;
+}
+
+bool LogIndex::GetBlockReceipts(const CBlock& block, const CBlockIndex* pindex, BlockReceipts& receipts)
+{
+    {
+        LOCK(m_cs_pending);
+        auto it = m_pending_receipts.find(pindex->GetBlockHash());
+        if (it != m_pending_receipts.end()) {
+            receipts = *it->second;
+            m_pending_receipts.erase(it);
+            return true;
+        }
+    }
+
+    bool fHasContracts = false;
+    for (const CTransactionRef& tx : block.vtx) {
+        fHasContracts |= tx->HasCreateOrCall();
+    }
+    if (!fHasContracts) {
+        return true;
+    }
+
+    CBlockUndo blockundo;
+    if (!UndoReadFromDisk(blockundo, pindex)) {
+        return false;
+    }
+    // The receipts of a block indexed before a reorg are still stored, but not the value
+    // transfers the contract address index needs
+    if (fLogAddressIndex) {
+        return ReplayBlockReceipts(block, pindex, blockundo, receipts);
+    }
+    return ReadBlockReceipts(block, pindex, blockundo, receipts);
+}
+
+bool LogIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    // The genesis block has no contract transactions
+    if (pindex->nHeight == 0) {
+        return true;
+    }
+
+    BlockReceipts receipts;
+    if (!GetBlockReceipts(block, pindex, receipts)) {
+        return error("%s: Failed to get the receipts of block %s", __func__, pindex->GetBlockHash().ToString());
+    }
+
+    std::map<dev::Address, std::pair<CHeightTxIndexKey, std::vector<uint256>>> heightIndexes;
+    dev::eth::LogBloom blockLogBloom;
+    std::vector<std::pair<CTopicIndexKey, uint256>> topicIndexes;
+    std::vector<std::pair<CContractAddressIndexKey, CContractAddressIndexValue>> addressIndexes;
+    for (std::pair<uint256, std::vector<TransactionReceiptInfo>>& entry : receipts) {
+        const uint256& hash = entry.first;
+        std::set<dev::h256> txTopics;
+        std::map<dev::h160, unsigned char> txAddresses;
+        for (const TransactionReceiptInfo& receipt : entry.second) {
+            if (fLogAddressIndex) {
+                for (const std::pair<dev::Address, dev::Address>& transfer : receipt.transfers) {
+                    txAddresses[transfer.first] |= CONTRACT_ADDRESS_SENDER;
+                    txAddresses[transfer.second] |= CONTRACT_ADDRESS_RECEIVER;
+                }
+                for (const std::pair<dev::Address, dev::bytes>& created : receipt.createdContracts) {
+                    txAddresses[created.first] |= CONTRACT_ADDRESS_CREATED;
+                }
+                for (const dev::Address& destructed : receipt.destructedContracts) {
+                    txAddresses[destructed] |= CONTRACT_ADDRESS_DESTRUCTED;
+                }
+            }
+            for (const dev::eth::LogEntry& log : receipt.logs) {
+                if (!heightIndexes.count(log.address)) {
+                    heightIndexes[log.address].first = CHeightTxIndexKey(pindex->nHeight, log.address);
+                }
+                heightIndexes[log.address].second.push_back(hash);
+                blockLogBloom |= log.bloom();
+                if (fLogTopicIndex && !log.topics.empty() && txTopics.insert(log.topics[0]).second) {
+                    topicIndexes.emplace_back(CTopicIndexKey(log.topics[0], pindex->nHeight, receipt.transactionIndex), hash);
+                }
+            }
+        }
+        for (const std::pair<dev::h160, unsigned char>& address : txAddresses) {
+            addressIndexes.emplace_back(CContractAddressIndexKey(address.first, pindex->nHeight, entry.second.front().transactionIndex),
+                                        CContractAddressIndexValue(hash, address.second));
+        }
+        if (!entry.second.empty()) {
+            pstorageresult->addResult(uintToh256(hash), entry.second);
+        }
+    }
+
+    // The receipts are written first, the RPCs look them up from the other entries
+    pstorageresult->commitResults();
+    if (!pstorageresult->flushResults()) {
+        return error("%s: Failed to write receipts", __func__);
+    }
+    for (const auto& e : heightIndexes) {
+        if (!pblocktree->WriteHeightIndex(e.second.first, e.second.second)) {
+            return error("%s: Failed to write height index", __func__);
+        }
+    }
+    if (!heightIndexes.empty() && !pblocktree->WriteLogBloom(pindex->nHeight, blockLogBloom)) {
+        return error("%s: Failed to write log bloom index", __func__);
+    }
+    if (!topicIndexes.empty() && !pblocktree->WriteTopicIndex(topicIndexes)) {
+        return error("%s: Failed to write topic index", __func__);
+    }
+    if (!addressIndexes.empty() && !pblocktree->WriteContractAddressIndex(pindex->nHeight, addressIndexes)) {
+        return error("%s: Failed to write contract address index", __func__);
+    }
+    return true;
+}
+
+bool LogIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    const Consensus::Params& consensus_params = Params().GetConsensus();
+    for (const CBlockIndex* pindex = current_tip; pindex != new_tip; pindex = pindex->pprev) {
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, consensus_params)) {
+            return error("%s: Failed to read block %s from disk", __func__, pindex->GetBlockHash().ToString());
+        }
+
+        if (fLogTopicIndex) {
+            // The topics of the block are only known from its receipts, so read them before they are unmapped
+            std::set<dev::h256> topics;
+            for (const CTransactionRef& tx : block.vtx) {
+                if (!tx->HasCreateOrCall())
+                    continue;
+                for (const TransactionReceiptInfo& receipt : pstorageresult->getResult(uintToh256(tx->GetHash()))) {
+                    for (const dev::eth::LogEntry& log : receipt.logs) {
+                        if (!log.topics.empty())
+                            topics.insert(log.topics[0]);
+                    }
+                }
+            }
+            if (!pblocktree->EraseTopicIndex(pindex->nHeight, topics)) {
+                return error("%s: Failed to delete topic index", __func__);
+            }
+        }
+        if (fLogAddressIndex && !pblocktree->EraseContractAddressIndex(pindex->nHeight)) {
+            return error("%s: Failed to delete contract address index", __func__);
+        }
+        if (!pblocktree->EraseHeightIndex(pindex->nHeight) || !pblocktree->EraseLogBloom(pindex->nHeight)) {
+            return error("%s: Failed to delete height index", __func__);
+        }
+        pstorageresult->disconnectResults(uintToh256(pindex->GetBlockHash()), block.vtx);
+
+        LOCK(m_cs_pending);
+        m_pending_receipts.erase(pindex->GetBlockHash());
+    }
+
+    if (!pstorageresult->flushResults()) {
+        return error("%s: Failed to unmap receipts", __func__);
+    }
+    return BaseIndex::Rewind(current_tip, new_tip);
+}
+
+BaseIndex::DB& LogIndex::GetDB() const { return *m_db; }
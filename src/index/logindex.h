@@ -0,0 +1,71 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef INDEX_LOGINDEX_H
+#define INDEX_LOGINDEX_H
+
+#include <index/base.h>
+#include <sync.h>
+#include <validation.h>
+
+#include <map>
+#include <memory>
+
+/**
+ * LogIndex writes the -logevents entries of the blocks: the contract receipts, the
+ * height index of the contracts that emitted logs, the log blooms, with
+ * -logtopicindex, the topic index and, with -logaddressindex, the index of the EVM
+ * addresses taking part in the value transfers of contracts and of the contracts
+ * created and destructed. They are used by searchlogs, waitforlogs,
+ * gettransactionreceipt and getcontractaddresstxs.
+ *
+ * The entries are written in the background, so that ConnectBlock does not wait for
+ * them and -logevents can be turned on without a reindex. ConnectBlock hands over the
+ * receipts of the blocks it connects; the receipts of the blocks the index catches up
+ * on are got by executing their contract transactions again on the state of their
+ * parent, unless they are still stored from before a reorg. The entries stay in the block tree and results databases, the database of
+ * the index only holds its locator.
+ */
+class LogIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+    Mutex m_cs_pending;
+    /// Receipts handed over by ConnectBlock, by block hash
+    std::map<uint256, std::shared_ptr<const BlockReceipts>> m_pending_receipts GUARDED_BY(m_cs_pending);
+
+    /// Get the receipts of a block, from ConnectBlock or by executing its contracts again.
+    bool GetBlockReceipts(const CBlock& block, const CBlockIndex* pindex, BlockReceipts& receipts);
+
+protected:
+    bool Init() override;
+
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "logindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit LogIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~LogIndex() override;
+
+    /// Hand over the receipts ConnectBlock recorded for a block, so that they are not
+    /// executed again when the block is indexed.
+    void AddPendingReceipts(const CBlockIndex* pindex, const std::shared_ptr<const BlockReceipts>& receipts);
+};
+
+/// The global log index, used by the log and receipt RPCs. May be null.
+extern std::unique_ptr<LogIndex> g_logindex;
+
+#endif
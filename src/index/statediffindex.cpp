@@ -0,0 +1,161 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/statediffindex.h>
+
+#include <qtum/qtumstate.h>
+#include <qtum/qtumstatewalk.h>
+#include <util/convert.h>
+#include <util/system.h>
+#include <validation.h>
+
+#include <libdevcore/SHA3.h>
+
+#include <set>
+
+constexpr char DB_STATEDIFF = 'd';
+
+std::unique_ptr<StateDiffIndex> g_statediffindex;
+
+/**
+ * Access to the state diff index database (indexes/statediffindex/)
+ *
+ * Besides the block locator of BaseIndex, the database holds the state diff of each
+ * indexed block by block hash.
+ */
+class StateDiffIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    bool ReadDiff(const uint256& block_hash, BlockStateDiff& diff) const;
+    bool WriteDiff(const uint256& block_hash, const BlockStateDiff& diff);
+};
+
+StateDiffIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(GetDataDir() / "indexes" / "statediffindex", n_cache_size, f_memory, f_wipe)
+{}
+
+bool StateDiffIndex::DB::ReadDiff(const uint256& block_hash, BlockStateDiff& diff) const
+{
+    return Read(std::make_pair(DB_STATEDIFF, block_hash), diff);
+}
+
+bool StateDiffIndex::DB::WriteDiff(const uint256& block_hash, const BlockStateDiff& diff)
+{
+    return Write(std::make_pair(DB_STATEDIFF, block_hash), diff);
+}
+
+namespace {
+
+StateNodeLookup DiskLookup(const dev::db::DatabaseFace* db)
+{
+    return [db](const dev::h256& key) {
+        return db->lookup(dev::db::Slice(reinterpret_cast<const char*>(key.data()), key.size));
+    };
+}
+
+/** The trie root of a block, the empty trie for the blocks from before the contract state */
+dev::h256 TrieRoot(const CBlockIndex* pindex, bool fUTXO)
+{
+    const uint256& root = fUTXO ? pindex->hashUTXORoot : pindex->hashStateRoot;
+    return root.IsNull() ? dev::EmptyTrie : uintToh256(root);
+}
+
+StateDiffEntry MakeEntry(const dev::h256& key, dev::bytesConstRef value)
+{
+    StateDiffEntry entry;
+    entry.key = h256Touint(key);
+    entry.value = value.toBytes();
+    return entry;
+}
+
+} // namespace
+
+bool ComputeBlockStateDiff(const CBlockIndex* pindex, BlockStateDiff& diff)
+{
+    diff = BlockStateDiff();
+    if (!globalState || !globalState->diskDb() || !globalState->diskDbUtxo())
+        return false;
+    const StateNodeLookup stateLookup = DiskLookup(globalState->diskDb());
+    const StateNodeLookup utxoLookup = DiskLookup(globalState->diskDbUtxo());
+
+    const dev::h256 prevStateRoot = pindex->pprev ? TrieRoot(pindex->pprev, false) : dev::EmptyTrie;
+    const dev::h256 prevUTXORoot = pindex->pprev ? TrieRoot(pindex->pprev, true) : dev::EmptyTrie;
+    const dev::h256 stateRoot = TrieRoot(pindex, false);
+    const dev::h256 utxoRoot = TrieRoot(pindex, true);
+    diff.hashPrevStateRoot = h256Touint(prevStateRoot);
+    diff.hashPrevUTXORoot = h256Touint(prevUTXORoot);
+    diff.hashStateRoot = h256Touint(stateRoot);
+    diff.hashUTXORoot = h256Touint(utxoRoot);
+
+    bool fComplete = true;
+    std::set<dev::h256> setCode;
+    StateTrieDiff size;
+    try {
+        // Accounts are RLP lists of [nonce, balance, storageRoot, codeHash]
+        auto onAccount = [&](const dev::h256& key, dev::bytesConstRef oldValue, dev::bytesConstRef newValue) {
+            AccountStateDiff account;
+            account.key = h256Touint(key);
+            account.account = newValue.toBytes();
+            if (!newValue.empty()) {
+                dev::RLP newAccount(newValue);
+                dev::h256 oldStorageRoot = dev::EmptyTrie;
+                dev::h256 oldCodeHash = dev::EmptySHA3;
+                if (!oldValue.empty()) {
+                    dev::RLP oldAccount(oldValue);
+                    oldStorageRoot = oldAccount[2].toHash<dev::h256>();
+                    oldCodeHash = oldAccount[3].toHash<dev::h256>();
+                }
+                StateTrieDiff storageSize;
+                fComplete &= DiffStateTrie(stateLookup, oldStorageRoot, newAccount[2].toHash<dev::h256>(), storageSize,
+                    [&](const dev::h256& slot, dev::bytesConstRef, dev::bytesConstRef value) {
+                        account.storage.push_back(MakeEntry(slot, value));
+                    });
+                const dev::h256 codeHash = newAccount[3].toHash<dev::h256>();
+                if (codeHash != oldCodeHash && codeHash != dev::EmptySHA3 && setCode.insert(codeHash).second) {
+                    std::string code = stateLookup(codeHash);
+                    fComplete &= !code.empty();
+                    diff.code.emplace_back(code.begin(), code.end());
+                }
+            }
+            diff.accounts.push_back(std::move(account));
+        };
+        fComplete &= DiffStateTrie(stateLookup, prevStateRoot, stateRoot, size, onAccount);
+        fComplete &= DiffStateTrie(utxoLookup, prevUTXORoot, utxoRoot, size,
+            [&](const dev::h256& key, dev::bytesConstRef, dev::bytesConstRef value) {
+                diff.vins.push_back(MakeEntry(key, value));
+            });
+    } catch (const std::exception&) {
+        // An account that does not decode
+        return false;
+    }
+    return fComplete;
+}
+
+StateDiffIndex::StateDiffIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<StateDiffIndex::DB>(n_cache_size, f_memory, f_wipe))
+{}
+
+StateDiffIndex::~StateDiffIndex() {}
+
+bool StateDiffIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    BlockStateDiff diff;
+    if (!ComputeBlockStateDiff(pindex, diff)) {
+        if (!m_logged_missing) {
+            LogPrintf("%s: the state of block %s is not available, the blocks without state are left out\n", GetName(), pindex->GetBlockHash().ToString());
+            m_logged_missing = true;
+        }
+        return true;
+    }
+    return m_db->WriteDiff(pindex->GetBlockHash(), diff);
+}
+
+BaseIndex::DB& StateDiffIndex::GetDB() const { return *m_db; }
+
+bool StateDiffIndex::LookupDiff(const CBlockIndex* pindex, BlockStateDiff& diff) const
+{
+    return m_db->ReadDiff(pindex->GetBlockHash(), diff);
+}
@@ -0,0 +1,136 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef INDEX_STATEDIFFINDEX_H
+#define INDEX_STATEDIFFINDEX_H
+
+#include <chain.h>
+#include <index/base.h>
+#include <serialize.h>
+#include <uint256.h>
+
+#include <memory>
+#include <vector>
+
+/** Maximum size of the cache of the state diff index database, in MiB */
+static const int64_t MAX_STATEDIFFINDEX_CACHE = 16;
+
+/** A key of a state trie and its new value, empty if the key was removed */
+struct StateDiffEntry
+{
+    //! The trie key, in trie byte order
+    uint256 key;
+    std::vector<unsigned char> value;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(key);
+        READWRITE(value);
+    }
+};
+
+/** The changes of one account of the EVM state trie */
+struct AccountStateDiff
+{
+    //! Key of the account in the state trie, the keccak-256 hash of its address
+    uint256 key;
+    //! New RLP encoding of the account (nonce, balance, storage root, code hash), empty if it was removed
+    std::vector<unsigned char> account;
+    //! Storage slots set or cleared, by the hash of the slot, against the storage trie the account had
+    std::vector<StateDiffEntry> storage;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(key);
+        READWRITE(account);
+        READWRITE(storage);
+    }
+};
+
+/**
+ * Everything a block changed in the contract state: the accounts, with their balances
+ * and storage slots, the code of the contracts it deployed and the vins of the UTXO trie.
+ * Applied to the tries of the parent block they give the tries of the block, whose roots
+ * are checked against hashStateRoot and hashUTXORoot, so a replica can follow the contract
+ * state without running the EVM.
+ */
+struct BlockStateDiff
+{
+    uint256 hashPrevStateRoot;
+    uint256 hashPrevUTXORoot;
+    uint256 hashStateRoot;
+    uint256 hashUTXORoot;
+    std::vector<AccountStateDiff> accounts;
+    //! Bytecode the new accounts refer to by its hash
+    std::vector<std::vector<unsigned char>> code;
+    //! Entries of the UTXO trie set or removed, by the hash of the contract address
+    std::vector<StateDiffEntry> vins;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(hashPrevStateRoot);
+        READWRITE(hashPrevUTXORoot);
+        READWRITE(hashStateRoot);
+        READWRITE(hashUTXORoot);
+        READWRITE(accounts);
+        READWRITE(code);
+        READWRITE(vins);
+    }
+};
+
+/**
+ * Compute the state diff of a connected block from the tries of its parent and its own.
+ * Only the subtries that differ are read. Returns false if the state of either block is
+ * not in the state databases, for example because -prunestate deleted it.
+ */
+bool ComputeBlockStateDiff(const CBlockIndex* pindex, BlockStateDiff& diff);
+
+/**
+ * StateDiffIndex records the state diff of each block when it is connected, so that
+ * getstatediff can serve it after -prunestate deleted the state it was computed from.
+ * The diffs are stored by block hash, so the ones of disconnected blocks stay valid.
+ * Blocks whose state is gone when the index gets to them are left out.
+ */
+class StateDiffIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+    /// Whether a block without state was logged, the ones after it are not
+    bool m_logged_missing{false};
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "statediffindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit StateDiffIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~StateDiffIndex() override;
+
+    /// Look up the state diff of a block, false if the index has not got it.
+    bool LookupDiff(const CBlockIndex* pindex, BlockStateDiff& diff) const;
+};
+
+/// The global state diff index, used by getstatediff. May be null.
+extern std::unique_ptr<StateDiffIndex> g_statediffindex;
+
+#endif
@@ -2,17 +2,49 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <blockcompress.h>
 #include <index/txindex.h>
+#include <primitives/blockview.h>
 #include <shutdown.h>
 #include <ui_interface.h>
 #include <util/system.h>
 #include <validation.h>
 
+#include <crypto/common.h>
+
 #include <boost/thread.hpp>
 
 constexpr char DB_BEST_BLOCK = 'B';
 constexpr char DB_TXINDEX = 't';
 constexpr char DB_TXINDEX_BLOCK = 'T';
+constexpr char DB_TXINDEX_COMPACT = 'c';
+constexpr char DB_TXINDEX_MODE = 'M';
+
+namespace {
+/**
+ * Key of a record of the compact mode: the first 8 bytes of the txid, then the position.
+ * The records of a prefix are adjacent and have no value, so a collision of prefixes
+ * just gives more positions to try.
+ */
+struct CompactTxKey
+{
+    uint64_t prefix;
+    CDiskTxPos pos;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(prefix);
+        READWRITE(pos);
+    }
+};
+
+uint64_t CompactTxPrefix(const uint256& txid)
+{
+    return ReadLE64(txid.begin());
+}
+} // namespace
 
 std::unique_ptr<TxIndex> g_txindex;
 
@@ -30,36 +62,120 @@ class TxIndex::DB : public BaseIndex::DB
 public:
     explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
 
-    /// Read the disk location of the transaction data with the given hash. Returns false if the
-    /// transaction hash is not indexed.
-    bool ReadTxPos(const uint256& txid, CDiskTxPos& pos) const;
+    /// Read the disk locations that may hold the transaction data with the given hash: the one
+    /// location of the full mode, or those of the txids with the same prefix in the compact mode.
+    /// Returns false if the transaction hash is not indexed.
+    bool ReadTxPos(const uint256& txid, std::vector<CDiskTxPos>& v_pos) const;
 
     /// Write a batch of transaction positions to the DB.
     bool WriteTxs(const std::vector<std::pair<uint256, CDiskTxPos>>& v_pos);
 
+    /// Use the full or the compact records. When the index has the other ones, erase them and
+    /// the best block so that the index is built again.
+    bool SetMode(bool f_compact);
+
     /// Migrate txindex data from the block tree DB, where it may be for older nodes that have not
     /// been upgraded yet to the new database.
     bool MigrateData(CBlockTreeDB& block_tree_db, const CBlockLocator& best_locator);
+
+private:
+    bool m_compact = false;
+
+    template <typename K>
+    bool EraseRecords(char key_type);
 };
 
 TxIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
     BaseIndex::DB(GetDataDir() / "indexes" / "txindex", n_cache_size, f_memory, f_wipe)
 {}
 
-bool TxIndex::DB::ReadTxPos(const uint256 &txid, CDiskTxPos& pos) const
+bool TxIndex::DB::ReadTxPos(const uint256 &txid, std::vector<CDiskTxPos>& v_pos) const
 {
-    return Read(std::make_pair(DB_TXINDEX, txid), pos);
+    v_pos.clear();
+    if (!m_compact) {
+        CDiskTxPos pos;
+        if (!Read(std::make_pair(DB_TXINDEX, txid), pos)) {
+            return false;
+        }
+        v_pos.push_back(pos);
+        return true;
+    }
+
+    const uint64_t prefix = CompactTxPrefix(txid);
+    std::unique_ptr<CDBIterator> cursor(NewIterator());
+    std::pair<char, CompactTxKey> key;
+    for (cursor->Seek(std::make_pair(DB_TXINDEX_COMPACT, prefix)); cursor->Valid(); cursor->Next()) {
+        if (!cursor->GetKey(key) || key.first != DB_TXINDEX_COMPACT || key.second.prefix != prefix) {
+            break;
+        }
+        v_pos.push_back(key.second.pos);
+    }
+    return !v_pos.empty();
 }
 
 bool TxIndex::DB::WriteTxs(const std::vector<std::pair<uint256, CDiskTxPos>>& v_pos)
 {
     CDBBatch batch(*this);
     for (const auto& tuple : v_pos) {
-        batch.Write(std::make_pair(DB_TXINDEX, tuple.first), tuple.second);
+        if (m_compact) {
+            batch.Write(std::make_pair(DB_TXINDEX_COMPACT, CompactTxKey{CompactTxPrefix(tuple.first), tuple.second}), uint8_t{0});
+        } else {
+            batch.Write(std::make_pair(DB_TXINDEX, tuple.first), tuple.second);
+        }
     }
     return WriteBatch(batch);
 }
 
+template <typename K>
+bool TxIndex::DB::EraseRecords(char key_type)
+{
+    const size_t batch_size = 1 << 24; // 16 MiB
+    CDBBatch batch(*this);
+    std::pair<char, K> key;
+    std::unique_ptr<CDBIterator> cursor(NewIterator());
+    for (cursor->Seek(key_type); cursor->Valid(); cursor->Next()) {
+        boost::this_thread::interruption_point();
+        if (ShutdownRequested()) {
+            return false;
+        }
+        if (!cursor->GetKey(key) || key.first != key_type) {
+            break;
+        }
+        batch.Erase(key);
+        if (batch.SizeEstimate() > batch_size) {
+            WriteBatch(batch);
+            batch.Clear();
+        }
+    }
+    WriteBatch(batch, /*fSync=*/ true);
+    CompactRange(key_type, (char)(key_type + 1));
+    return true;
+}
+
+bool TxIndex::DB::SetMode(bool f_compact)
+{
+    // Indexes from before the compact mode have no mode record and are full
+    bool f_stored_compact = false;
+    Read(DB_TXINDEX_MODE, f_stored_compact);
+    m_compact = f_compact;
+    if (f_stored_compact == f_compact) {
+        return !f_compact || Write(DB_TXINDEX_MODE, true);
+    }
+
+    CBlockLocator locator;
+    if (Read(DB_BEST_BLOCK, locator)) {
+        LogPrintf("Switching txindex to the %s records, the index is built again\n", f_compact ? "compact" : "full");
+        // Forget the best block first, so an interrupted switch starts over
+        if (!Erase(DB_BEST_BLOCK, /*fSync=*/ true)) {
+            return error("%s: cannot erase the best block", __func__);
+        }
+    }
+    if (!(f_stored_compact ? EraseRecords<CompactTxKey>(DB_TXINDEX_COMPACT) : EraseRecords<uint256>(DB_TXINDEX))) {
+        return false;
+    }
+    return Write(DB_TXINDEX_MODE, f_compact, /*fSync=*/ true);
+}
+
 /*
  * Safely persist a transfer of data from the old txindex database to the new one, and compact the
  * range of keys updated. This is used internally by MigrateData.
@@ -198,8 +314,8 @@ bool TxIndex::DB::MigrateData(CBlockTreeDB& block_tree_db, const CBlockLocator&
     return true;
 }
 
-TxIndex::TxIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
-    : m_db(MakeUnique<TxIndex::DB>(n_cache_size, f_memory, f_wipe))
+TxIndex::TxIndex(size_t n_cache_size, bool f_memory, bool f_wipe, bool f_compact)
+    : m_db(MakeUnique<TxIndex::DB>(n_cache_size, f_memory, f_wipe)), m_compact(f_compact)
 {}
 
 TxIndex::~TxIndex() {}
@@ -215,6 +331,10 @@ bool TxIndex::Init()
         return false;
     }
 
+    if (!m_db->SetMode(m_compact)) {
+        return false;
+    }
+
     return BaseIndex::Init();
 }
 
@@ -233,32 +353,73 @@ bool TxIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
     return m_db->WriteTxs(vPos);
 }
 
-BaseIndex::DB& TxIndex::GetDB() const { return *m_db; }
-
-bool TxIndex::FindTx(const uint256& tx_hash, uint256& block_hash, CTransactionRef& tx) const
+bool TxIndex::WriteBlockView(const CBlockView& block, const CBlockIndex* pindex)
 {
-    CDiskTxPos postx;
-    if (!m_db->ReadTxPos(tx_hash, postx)) {
-        return false;
+    // Exclude genesis block transaction because outputs are not spendable.
+    if (pindex->nHeight == 0) return true;
+
+    // The hashes and offsets come from the serialized block, no transaction is built
+    const CDiskBlockPos block_pos = pindex->GetBlockPos();
+    std::vector<std::pair<uint256, CDiskTxPos>> vPos;
+    vPos.reserve(block.GetTransactions().size());
+    for (const CTransactionView& tx : block.GetTransactions()) {
+        vPos.emplace_back(tx.GetHash(), CDiskTxPos(block_pos, block.GetOffset(tx) - block.GetHeaderSize()));
     }
+    return m_db->WriteTxs(vPos);
+}
+
+BaseIndex::DB& TxIndex::GetDB() const { return *m_db; }
 
-    CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
+/** Read the transaction at pos and the header of its block */
+static bool ReadTxAtPos(const CDiskTxPos& postx, CBlockHeader& header, CTransactionRef& tx)
+{
+    // Open at the header of the block record, which tells whether it is compressed
+    CAutoFile file(OpenBlockFile(CDiskBlockPos(postx.nFile, postx.nPos - 8), true), SER_DISK, CLIENT_VERSION);
     if (file.IsNull()) {
         return error("%s: OpenBlockFile failed", __func__);
     }
-    CBlockHeader header;
     try {
-        file >> header;
-        if (fseek(file.Get(), postx.nTxOffset, SEEK_CUR)) {
-            return error("%s: fseek(...) failed", __func__);
+        CMessageHeader::MessageStartChars blk_start;
+        unsigned int blk_size;
+        file >> blk_start >> blk_size;
+        if (blk_size & DISK_RECORD_COMPRESSED) {
+            // The transaction is at its offset in the uncompressed block
+            std::vector<unsigned char> raw;
+            ReadCompressedDiskRecord(file, blk_size & ~DISK_RECORD_COMPRESSED, raw);
+            VectorReader reader(SER_DISK, CLIENT_VERSION, raw, 0);
+            reader >> header;
+            VectorReader(SER_DISK, CLIENT_VERSION, raw, raw.size() - reader.size() + postx.nTxOffset) >> tx;
+        } else {
+            file >> header;
+            if (fseek(file.Get(), postx.nTxOffset, SEEK_CUR)) {
+                return error("%s: fseek(...) failed", __func__);
+            }
+            file >> tx;
         }
-        file >> tx;
     } catch (const std::exception& e) {
         return error("%s: Deserialize or I/O error - %s", __func__, e.what());
     }
-    if (tx->GetHash() != tx_hash) {
-        return error("%s: txid mismatch", __func__);
-    }
-    block_hash = header.GetHash();
     return true;
 }
+
+bool TxIndex::FindTx(const uint256& tx_hash, uint256& block_hash, CTransactionRef& tx) const
+{
+    std::vector<CDiskTxPos> v_pos;
+    if (!m_db->ReadTxPos(tx_hash, v_pos)) {
+        return false;
+    }
+
+    CBlockHeader header;
+    for (const CDiskTxPos& postx : v_pos) {
+        if (ReadTxAtPos(postx, header, tx) && tx->GetHash() == tx_hash) {
+            block_hash = header.GetHash();
+            return true;
+        }
+    }
+    tx.reset();
+    // A compact record may be of another txid with the same prefix
+    if (m_compact) {
+        return false;
+    }
+    return error("%s: txid mismatch", __func__);
+}
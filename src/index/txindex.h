@@ -12,7 +12,9 @@
 /**
  * TxIndex is used to look up transactions included in the blockchain by hash.
  * The index is written to a LevelDB database and records the filesystem
- * location of each transaction by transaction hash.
+ * location of each transaction by transaction hash. In the compact mode it
+ * records the locations by the first 8 bytes of the hash, in less than half
+ * the space, and a lookup checks the hash of the transactions it reads.
  */
 class TxIndex final : public BaseIndex
 {
@@ -21,20 +23,25 @@ protected:
 
 private:
     const std::unique_ptr<DB> m_db;
+    const bool m_compact;
 
 protected:
-    /// Override base class init to migrate from old database.
+    /// Override base class init to migrate from old database, and to the mode of the index.
     bool Init() override;
 
     bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
 
+    bool UsesBlockViews() const override { return true; }
+
+    bool WriteBlockView(const CBlockView& block, const CBlockIndex* pindex) override;
+
     BaseIndex::DB& GetDB() const override;
 
     const char* GetName() const override { return "txindex"; }
 
 public:
     /// Constructs the index, which becomes available to be queried.
-    explicit TxIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+    explicit TxIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false, bool f_compact = false);
 
     // Destructor is declared because this class contains a unique_ptr to an incomplete type.
     virtual ~TxIndex() override;
@@ -12,15 +12,27 @@
 #include <addrman.h>
 #include <amount.h>
 #include <banman.h>
+#include <blockprefetch.h>
+#include <blockcompress.h>
+#include <blockfilemap.h>
+#include <blockfilewriter.h>
+#include <blockserve.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <checkpoints.h>
 #include <compat/sanity.h>
 #include <consensus/validation.h>
+#include <crypto/keccak.h>
 #include <fs.h>
 #include <httpserver.h>
 #include <httprpc.h>
 #include <interfaces/chain.h>
+#include <index/addressindex.h>
+#include <index/blockfilterindex.h>
+#include <index/blockstatsindex.h>
+#include <index/contractindex.h>
+#include <index/logindex.h>
+#include <index/statediffindex.h>
 #include <index/txindex.h>
 #include <key.h>
 #include <validation.h>
@@ -33,6 +45,7 @@
 #include <policy/policy.h>
 #include <rpc/server.h>
 #include <rpc/register.h>
+#include <rpc/responsecache.h>
 #include <rpc/blockchain.h>
 #include <rpc/util.h>
 #include <script/standard.h>
@@ -42,6 +55,7 @@
 #include <timedata.h>
 #include <txdb.h>
 #include <txmempool.h>
+#include <txpreverify.h>
 #include <torcontrol.h>
 #include <ui_interface.h>
 #include <util/system.h>
@@ -49,6 +63,11 @@
 #include <util/convert.h>
 #include <logging.h>
 #include <validationinterface.h>
+#include <qtum/qtumaccesshistory.h>
+#include <qtum/qtumprofile.h>
+#include <qtum/qtumutils.h>
+#include <qtum/qtumstatecache.h>
+#include <qtum/qtumstateprune.h>
 #ifdef ENABLE_WALLET
 #include <wallet/wallet.h>
 #endif
@@ -60,6 +79,7 @@
 #ifndef WIN32
 #include <attributes.h>
 #include <cerrno>
+#include <future>
 #include <signal.h>
 #include <sys/stat.h>
 #endif
@@ -178,6 +198,7 @@ static std::unique_ptr<CCoinsViewErrorCatcher> pcoinscatcher;
 static std::unique_ptr<ECCVerifyHandle> globalVerifyHandle;
 
 static boost::thread_group threadGroup;
+static std::vector<BlockFilterType> g_enabled_filter_types;
 static CScheduler scheduler;
 
 void Interrupt()
@@ -193,6 +214,24 @@ void Interrupt()
     if (g_txindex) {
         g_txindex->Interrupt();
     }
+    ForEachBlockFilterIndex([](BlockFilterIndex& index) { index.Interrupt(); });
+    if (g_blockstatsindex) {
+        g_blockstatsindex->Interrupt();
+    }
+    if (g_contractindex) {
+        g_contractindex->Interrupt();
+    }
+    if (g_statediffindex) {
+        g_statediffindex->Interrupt();
+    }
+    if (g_logindex) {
+        g_logindex->Interrupt();
+    }
+#ifdef ENABLE_BITCORE_RPC
+    if (g_addressindex) {
+        g_addressindex->Interrupt();
+    }
+#endif
 }
 
 void Shutdown(InitInterfaces& interfaces)
@@ -222,8 +261,17 @@ void Shutdown(InitInterfaces& interfaces)
     // Because these depend on each-other, we make sure that neither can be
     // using the other before destroying them.
     if (peerLogic) UnregisterValidationInterface(peerLogic.get());
+    if (g_blockserver) g_blockserver->Stop();
     if (g_connman) g_connman->Stop();
     if (g_txindex) g_txindex->Stop();
+    ForEachBlockFilterIndex([](BlockFilterIndex& index) { index.Stop(); });
+    if (g_blockstatsindex) g_blockstatsindex->Stop();
+    if (g_contractindex) g_contractindex->Stop();
+    if (g_statediffindex) g_statediffindex->Stop();
+    if (g_logindex) g_logindex->Stop();
+#ifdef ENABLE_BITCORE_RPC
+    if (g_addressindex) g_addressindex->Stop();
+#endif
 
     StopTorControl();
 
@@ -234,10 +282,20 @@ void Shutdown(InitInterfaces& interfaces)
 
     // After the threads that potentially access these pointers have been stopped,
     // destruct and reset all to nullptr.
+    g_txpreverifier.reset();
+    g_blockserver.reset();
     peerLogic.reset();
     g_connman.reset();
     g_banman.reset();
     g_txindex.reset();
+    DestroyAllBlockFilterIndexes();
+    g_blockstatsindex.reset();
+    g_contractindex.reset();
+    g_statediffindex.reset();
+    g_logindex.reset();
+#ifdef ENABLE_BITCORE_RPC
+    g_addressindex.reset();
+#endif
 
     if (g_is_mempool_loaded && gArgs.GetArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
         DumpMempool();
@@ -264,6 +322,13 @@ void Shutdown(InitInterfaces& interfaces)
     // CValidationInterface callbacks, flush them...
     GetMainSignals().FlushBackgroundCallbacks();
 
+#if ENABLE_ZMQ
+    // Publish the queued notifications while the blocks and receipts they read are still available
+    if (g_zmq_notification_interface) {
+        g_zmq_notification_interface->StopPublishing();
+    }
+#endif
+
     // Any future callbacks will be dropped. This should absolutely be safe - if
     // missing a callback results in an unrecoverable situation, unclean shutdown
     // would too. The only reason to do the above flushes is to let the wallet catch
@@ -274,12 +339,20 @@ void Shutdown(InitInterfaces& interfaces)
         LOCK(cs_main);
         if (pcoinsTip != nullptr) {
             FlushStateToDisk();
+            if (gArgs.GetBoolArg("-blockindexsnapshot", DEFAULT_BLOCK_INDEX_SNAPSHOT))
+                WriteBlockIndexSnapshot();
         }
+        // Writes the records still queued if the flush failed
+        g_block_file_writer.reset();
+        pblockprefetcher.reset();
+        SetContractAccessHistory(nullptr);
         pcoinsTip.reset();
         pcoinscatcher.reset();
+        pcoinsflusher.reset();
         pcoinsdbview.reset();
         pblocktree.reset();
         pstorageresult.reset();
+        pstatepruner.reset();
         globalState.reset();
         globalSealEngine.reset();
     }
@@ -309,6 +382,7 @@ void Shutdown(InitInterfaces& interfaces)
     globalVerifyHandle.reset();
     ECC_Stop();
     LogPrintf("%s: done\n", __func__);
+    LogInstance().StopAsync();
 }
 
 /**
@@ -380,12 +454,21 @@ void SetupServerArgs()
     gArgs.AddArg("-version", "Print version and exit", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-alertnotify=<cmd>", "Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-assumevalid=<hex>", strprintf("If this block is in the chain assume that it and its ancestors are valid and potentially skip their script verification (0 to verify all, default: %s, testnet: %s)", defaultChainParams->GetConsensus().defaultAssumeValid.GetHex(), testnetChainParams->GetConsensus().defaultAssumeValid.GetHex()), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-assumevalidstake", strprintf("Also skip the block signature and stake signature checks of the blocks -assumevalid skips the script verification of (default: %u)", DEFAULT_ASSUME_VALID_STAKE), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blocksdir=<dir>", "Specify blocks directory (default: <datadir>/blocks)", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blocknotify=<cmd>", "Execute command when the best block changes (%s in cmd is replaced by block hash)", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blockreconstructionextratxn=<n>", strprintf("Extra transactions to keep in memory for compact block reconstructions (default: %u)", DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-blockwritequeue=<n>", strprintf("Write blocks and undo data to disk on a background thread, queueing up to <n> MiB of them (0 to write them synchronously, up to %d, default: %d)", MAX_BLOCK_WRITE_QUEUE, DEFAULT_BLOCK_WRITE_QUEUE), true, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-blockfilemaps=<n>", strprintf("Keep the <n> most recently read finalized block files mapped in memory (0 to %d, default: %d)", MAX_BLOCK_FILE_MAPS, DEFAULT_BLOCK_FILE_MAPS), true, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blocksonly", strprintf("Whether to reject transactions from network peers. Transactions from the wallet or RPC are not affected. (default: %u)", DEFAULT_BLOCKSONLY), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-compressblocks", strprintf("Store new blocks and undo data compressed, when that makes them smaller. Block files written with this cannot be read by versions without it (default: %u)", DEFAULT_COMPRESS_BLOCKS), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-conf=<file>", strprintf("Specify configuration file. Relative paths will be prefixed by datadir location. (default: %s)", BITCOIN_CONF_FILENAME), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-contractcodecache=<n>", strprintf("Set the size of the contract bytecode cache in megabytes (0 to disable, default: %d)", DEFAULT_CONTRACT_CODE_CACHE), true, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-contractprofile=<n>", strprintf("Profile the contract executions of connected blocks for the getcontractprofile RPC, sampling one in <n> opcodes (0 to disable, default: %u)", DEFAULT_CONTRACT_PROFILE), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-contractprofilelog=<n>", strprintf("Log the %u most expensive contracts of the -contractprofile profile every <n> blocks (0 to disable, default: %d)", CONTRACT_PROFILE_LOG_TOP, DEFAULT_CONTRACT_PROFILE_LOG), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-datadir=<dir>", "Specify data directory", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-blockindexsnapshot", strprintf("Write a snapshot of the block index at shutdown that the next start loads instead of reading the block index database (default: %u)", DEFAULT_BLOCK_INDEX_SNAPSHOT), true, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-backgroundflush", strprintf("Write the flushed coins to the chainstate database on a background thread (default: %u)", DEFAULT_BACKGROUND_FLUSH), true, OptionsCategory::OPTIONS);
     gArgs.AddArg("-dbbatchsize", strprintf("Maximum database write batch size in bytes (default: %u)", nDefaultDbBatchSize), true, OptionsCategory::OPTIONS);
     gArgs.AddArg("-dbcache=<n>", strprintf("Maximum database cache size <n> MiB (%d to %d, default: %d). In addition, unused mempool memory is shared for this cache (see -maxmempool).", nMinDbCache, nMaxDbCache, nDefaultDbCache), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-debuglogfile=<file>", strprintf("Specify location of debug log file. Relative paths will be prefixed by a net-specific datadir location. (-nodebuglogfile to disable; default: %s)", DEFAULT_DEBUGLOGFILE), false, OptionsCategory::OPTIONS);
@@ -393,29 +476,61 @@ void SetupServerArgs()
     gArgs.AddArg("-includeconf=<file>", "Specify additional configuration file, relative to the -datadir path (only useable from configuration file, not command line)", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-loadblock=<file>", "Imports blocks from external blk000??.dat file on startup", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-maxmempool=<n>", strprintf("Keep the transaction memory pool below <n> megabytes (default: %u)", DEFAULT_MAX_MEMPOOL_SIZE), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-maxmempoolgas=<n>", strprintf("Keep the gas limits of the contract transactions in the memory pool below <n> million gas, evicting the lowest gas prices first (default: %u)", DEFAULT_MAX_MEMPOOL_GAS), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-maxorphantx=<n>", strprintf("Keep at most <n> unconnectable transactions in memory (default: %u)", DEFAULT_MAX_ORPHAN_TRANSACTIONS), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-mempoolexpiry=<n>", strprintf("Do not keep transactions in the mempool longer than <n> hours (default: %u)", DEFAULT_MEMPOOL_EXPIRY), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-mempoolpreexec", strprintf("Execute contract transactions against the tip when they enter the mempool, to time them for block assembly (default: %u)", DEFAULT_MEMPOOL_PREEXEC), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-minimumchainwork=<hex>", strprintf("Minimum work assumed to exist on a valid chain in hex (default: %s, testnet: %s)", defaultChainParams->GetConsensus().nMinimumChainWork.GetHex(), testnetChainParams->GetConsensus().nMinimumChainWork.GetHex()), true, OptionsCategory::OPTIONS);
     gArgs.AddArg("-par=<n>", strprintf("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)",
         -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-parcontract=<n>", strprintf("Set the number of threads used to speculatively pre-execute the contract transactions of a block, "
+        "which loads the contract state they use while the block is executed (0 to %d, default: %d)",
+        MAX_CONTRACT_SPECULATION_THREADS, DEFAULT_CONTRACT_SPECULATION_THREADS), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-persistmempool", strprintf("Whether to save the mempool on shutdown and load on restart (default: %u)", DEFAULT_PERSIST_MEMPOOL), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-pid=<file>", strprintf("Specify pid file. Relative paths will be prefixed by a net-specific datadir location. (default: %s)", BITCOIN_PID_FILENAME), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-prefetchblocks=<n>", strprintf("During initial block download, read up to <n> blocks ahead of the tip and prefetch the coins and contract state they use (0 to %d, default: %d)",
+        MAX_PREFETCH_BLOCKS, DEFAULT_PREFETCH_BLOCKS), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-prune=<n>", strprintf("Reduce storage requirements by enabling pruning (deleting) of old blocks. This allows the pruneblockchain RPC to be called to delete specific blocks, and enables automatic pruning of old blocks if a target size in MiB is provided. This mode is incompatible with -txindex and -rescan. "
             "Warning: Reverting this setting requires re-downloading the entire blockchain. "
             "(default: 0 = disable pruning blocks, 1 = allow manual pruning via RPC, >=%u = automatically prune block files to stay under the specified target size in MiB)", MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-prunestate=<n>", strprintf("Delete contract state trie nodes that are only used by blocks more than <n> blocks below the tip and below the last flush of the coins database, every %d blocks in the background. "
+            "Contract calls and state queries at older blocks fail afterwards, and reverting this setting requires -reindex. "
+            "Incompatible with -logevents, -blockstatsindex, -contractindex and the contract block filter index. "
+            "(default: %u = keep all contract state, >=%u = number of blocks to keep)", PRUNE_STATE_INTERVAL, DEFAULT_PRUNE_STATE, MIN_POS_BLOCKS_TO_KEEP), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-reindex", "Rebuild chain state and block index from the blk*.dat files on disk", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-reindex-chainstate", "Rebuild chain state from the currently indexed blocks. When in pruning mode or if blocks on disk might be corrupted, use full -reindex instead.", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-reindex-indexes", "Rebuild the enabled optional indexes (-txindex, -logevents, -blockfilterindex, -blockstatsindex, -contractindex, -statediffindex and -addrindex) from the blocks on disk, without validating the blocks again. Implied by -reindex.", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-record-log-opcodes", "Logs all EVM LOG opcode operations to the file vmExecLogs.json", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-statenodecache=<n>", strprintf("Set the size of the contract state trie node cache in megabytes (0 to disable, default: %d)", DEFAULT_STATE_NODE_CACHE), true, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-schedulerthreads=<n>", strprintf("Set the number of threads running the scheduled tasks and the validation callbacks of the wallets, indexes and notifications, the callbacks of each still run in order (1 to %d, default: %d)",
+        MAX_SCHEDULER_THREADS, DEFAULT_SCHEDULER_THREADS), false, OptionsCategory::OPTIONS);
 #ifndef WIN32
     gArgs.AddArg("-sysperms", "Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)", false, OptionsCategory::OPTIONS);
 #else
     hidden_args.emplace_back("-sysperms");
 #endif
+    gArgs.AddArg("-blockfilterindex=<type>",
+                 strprintf("Maintain an index of compact filters by block (default: %s, values: %s).", DEFAULT_BLOCKFILTERINDEX, ListBlockFilterTypes()) +
+                 " If <type> is not supplied or if <type> = 1, indexes for all known types are enabled." +
+                 " The contract filters also hold the contract addresses and log topics of the receipts of the block.",
+                 false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-blockstatsindex", strprintf("Maintain an index of the statistics of each block, used by the getblockstats rpc call instead of reading the block (default: %u)", DEFAULT_BLOCKSTATSINDEX), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-contractindex", strprintf("Maintain a registry of the contracts created, used by the listcontracts, listallcontracts and listcontractsbycodehash rpc calls instead of walking the state (default: %u)", DEFAULT_CONTRACTINDEX), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-statediffindex", strprintf("Maintain an index of the contract state changes of each block, used by the getstatediff rpc call after -prunestate deleted the state of the block (default: %u)", DEFAULT_STATEDIFFINDEX), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-txindex", strprintf("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)", DEFAULT_TXINDEX), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-txindex-compact", strprintf("Record the transactions of -txindex by a prefix of their hash, in less than half the space. Changing it builds the index again (default: %u)", DEFAULT_TXINDEX_COMPACT), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-txverifythreads=<n>", strprintf("Verify the scripts of the transactions received from peers on <n> threads before taking the chain lock to accept them (0 to %d, default: %d)",
+        MAX_TX_VERIFY_THREADS, DEFAULT_TX_VERIFY_THREADS), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-blockservethreads=<n>", strprintf("Read the blocks requested by peers from disk and send them on <n> threads, without holding the chain lock (0 to %d, default: %d)",
+        MAX_BLOCK_SERVE_THREADS, DEFAULT_BLOCK_SERVE_THREADS), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-logevents", strprintf("Maintain a full EVM log index, used by searchlogs and gettransactionreceipt rpc calls (default: %u)", DEFAULT_LOGEVENTS), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-logaddressindex", strprintf("Maintain an index of the EVM addresses taking part in the value transfers of contracts and of the contracts created or destructed, used by getcontractaddresstxs. Requires -logevents (default: %u)", DEFAULT_LOGADDRESSINDEX), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-logtopicindex", strprintf("Maintain an index of the first topic of EVM logs, used by searchlogs with a topic filter. Requires -logevents (default: %u)", DEFAULT_LOGTOPICINDEX), false, OptionsCategory::OPTIONS);
 #ifdef ENABLE_BITCORE_RPC
-    gArgs.AddArg("-addrindex", strprintf("Maintain a full address index (default: %u)", DEFAULT_ADDRINDEX), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-addrindex", strprintf("Maintain a full address index, used by the address, spent and timestamp rpc calls. Built in the background, so it can be enabled without reindex (default: %u)", DEFAULT_ADDRINDEX), false, OptionsCategory::OPTIONS);
 #endif
+    gArgs.AddArg("-vm=<name>", strprintf("Execute contracts on the EVM <name>: legacy, interpreter or the path of an EVMC module such as evmone (default: %s)", DEFAULT_VM), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-evmc=<option>=<value>", "Set an option of the EVMC module selected with -vm. Can be specified multiple times", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-deleteblockchaindata", "Delete the local copy of the block chain data", false, OptionsCategory::OPTIONS);
 
     gArgs.AddArg("-addnode=<ip>", "Add a node to connect to and attempt to keep the connection open (see the `addnode` RPC command help for more info). This option can be specified multiple times to add multiple nodes.", false, OptionsCategory::CONNECTION);
@@ -470,19 +585,43 @@ void SetupServerArgs()
     gArgs.AddArg("-zmqpubhashtx=<address>", "Enable publish hash transaction in <address>", false, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawblock=<address>", "Enable publish raw block in <address>", false, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawtx=<address>", "Enable publish raw transaction in <address>", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubrawlogs=<address>", "Enable publish EVM logs of connected blocks in <address> (requires -logevents)", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubrawlogstopic=<hex>", "Only publish the EVM logs with this topic in -zmqpubrawlogs, can be specified multiple times (default: publish all logs)", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubrawreceipts=<address>", "Enable publish the transaction receipts of connected blocks in <address> (requires -logevents)", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubstateroots=<address>", "Enable publish the state and UTXO roots of connected blocks in <address>", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubstatediff=<address>", "Enable publish the contract state changes of connected blocks in <address>", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubstakingevent=<address>", "Enable publish staking events (signed, accepted, rejected, orphaned and expired stakes) in <address>", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqqueuesize=<n>", strprintf("Number of notifications waiting to be published above which transaction notifications are dropped (0 = publish on the validation thread, default: %d)", DEFAULT_ZMQ_QUEUE_SIZE), false, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubhashblockhwm=<n>", strprintf("Set publish hash block outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubhashtxhwm=<n>", strprintf("Set publish hash transaction outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawblockhwm=<n>", strprintf("Set publish raw block outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawtxhwm=<n>", strprintf("Set publish raw transaction outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubrawlogshwm=<n>", strprintf("Set publish EVM logs outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubrawreceiptshwm=<n>", strprintf("Set publish transaction receipts outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubstaterootshwm=<n>", strprintf("Set publish state roots outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubstatediffhwm=<n>", strprintf("Set publish state diff outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubstakingeventhwm=<n>", strprintf("Set publish staking event outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
 #else
     hidden_args.emplace_back("-zmqpubhashblock=<address>");
     hidden_args.emplace_back("-zmqpubhashtx=<address>");
     hidden_args.emplace_back("-zmqpubrawblock=<address>");
     hidden_args.emplace_back("-zmqpubrawtx=<address>");
+    hidden_args.emplace_back("-zmqpubrawlogs=<address>");
+    hidden_args.emplace_back("-zmqpubrawlogstopic=<hex>");
+    hidden_args.emplace_back("-zmqpubrawreceipts=<address>");
+    hidden_args.emplace_back("-zmqpubstateroots=<address>");
+    hidden_args.emplace_back("-zmqpubstatediff=<address>");
+    hidden_args.emplace_back("-zmqpubstakingevent=<address>");
+    hidden_args.emplace_back("-zmqqueuesize=<n>");
     hidden_args.emplace_back("-zmqpubhashblockhwm=<n>");
     hidden_args.emplace_back("-zmqpubhashtxhwm=<n>");
     hidden_args.emplace_back("-zmqpubrawblockhwm=<n>");
     hidden_args.emplace_back("-zmqpubrawtxhwm=<n>");
+    hidden_args.emplace_back("-zmqpubrawlogshwm=<n>");
+    hidden_args.emplace_back("-zmqpubrawreceiptshwm=<n>");
+    hidden_args.emplace_back("-zmqpubstaterootshwm=<n>");
+    hidden_args.emplace_back("-zmqpubstatediffhwm=<n>");
+    hidden_args.emplace_back("-zmqpubstakingeventhwm=<n>");
 #endif
 
     gArgs.AddArg("-checkblocks=<n>", strprintf("How many blocks to check at startup (default: %u, 0 = all)", DEFAULT_CHECKBLOCKS), true, OptionsCategory::DEBUG_TEST);
@@ -494,8 +633,13 @@ void SetupServerArgs()
         "and level 4 tries to reconnect the blocks, "
         "each level includes the checks of the previous levels "
         "(0-4, default: %u)", DEFAULT_CHECKLEVEL), true, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-backgroundcheck=<mode>", strprintf("Verify only the last %d blocks at startup, at most at level 3, and the blocks of -checkblocks at -checklevel in a background thread once the node runs. "
+        "On a corruption the background check sets a warning (warn) or also shuts the node down (halt) (off, warn or halt, default: %s)", BACKGROUND_CHECK_STARTUP_BLOCKS, DEFAULT_BACKGROUND_CHECK), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-checkblockindex", strprintf("Do a full consistency check for mapBlockIndex, setBlockIndexCandidates, chainActive and mapBlocksUnlinked occasionally. (default: %u, regtest: %u)", defaultChainParams->DefaultConsistencyChecks(), regtestChainParams->DefaultConsistencyChecks()), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-checkmempool=<n>", strprintf("Run checks every <n> transactions (default: %u, regtest: %u)", defaultChainParams->DefaultConsistencyChecks(), regtestChainParams->DefaultConsistencyChecks()), true, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-memorystate", strprintf("Keep the chain state and the contract state in memory instead of on disk, for tests and benchmarks. They are not kept across restarts, "
+        "the blocks on disk are connected again at startup (default: %u)", DEFAULT_MEMORY_STATE), true, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-lockstats", strprintf("Count the locks of cs_main, the mempool, the wallets and the node list with their wait and hold times, see getlockstats (default: %u)", DEFAULT_LOCK_STATS), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-checkpoints", strprintf("Disable expensive verification for known chain history (default: %u)", DEFAULT_CHECKPOINTS_ENABLED), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-deprecatedrpc=<method>", "Allows deprecated RPC method(s) to be used", true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-dropmessagestest=<n>", "Randomly drop 1 of every <n> network messages", true, OptionsCategory::DEBUG_TEST);
@@ -512,9 +656,12 @@ void SetupServerArgs()
     gArgs.AddArg("-logips", strprintf("Include IP addresses in debug output (default: %u)", DEFAULT_LOGIPS), false, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-logtimestamps", strprintf("Prepend debug output with timestamp (default: %u)", DEFAULT_LOGTIMESTAMPS), false, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-logtimemicros", strprintf("Add microsecond precision to debug timestamps (default: %u)", DEFAULT_LOGTIMEMICROS), true, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-logasync", strprintf("Write the debug output in a separate thread, so logging doesn't wait for the disk (default: %u)", DEFAULT_LOGASYNC), false, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-showevmlogs", strprintf("Print evm logs to console (default: %u)", DEFAULT_SHOWEVMLOGS), false, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-mocktime=<n>", "Replace actual time with <n> seconds since epoch (default: 0)", true, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-ecrecovercache=<n>", strprintf("Keep the results of the last <n> btc_ecrecover calls of contracts (0 to disable, default: %u)", qtumutils::DEFAULT_ECRECOVER_CACHE_SIZE), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-maxsigcachesize=<n>", strprintf("Limit sum of signature cache and script execution cache sizes to <n> MiB (default: %u)", DEFAULT_MAX_SIG_CACHE_SIZE), true, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-maxsigcacheadaptive=<n>", strprintf("Let the signature cache and script execution cache double while they evict entries, up to <n> MiB together (0 to disable, default: %u)", DEFAULT_MAX_SIG_CACHE_ADAPTIVE), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-maxtipage=<n>", strprintf("Maximum tip age in seconds to consider node in initial block download (default: %u)", DEFAULT_MAX_TIP_AGE), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-minmempoolgaslimit=<limit>", strprintf("The minimum transaction gas limit we are willing to accept into the mempool (default: %s)",MEMPOOL_MIN_GAS_LIMIT), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-maxtxfee=<amt>", strprintf("Maximum total fees (in %s) to use in a single wallet transaction or raw transaction; setting this too low may abort large transactions (default: %s)",
@@ -555,7 +702,10 @@ void SetupServerArgs()
     gArgs.AddArg("-rest", strprintf("Accept public REST requests (default: %u)", DEFAULT_REST_ENABLE), false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcallowip=<ip>", "Allow JSON-RPC connections from specified source. Valid for <ip> are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0) or a network/CIDR (e.g. 1.2.3.4/24). This option can be specified multiple times", false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcauth=<userpw>", "Username and HMAC-SHA-256 hashed password for JSON-RPC connections. The field <userpw> comes in the format: <USERNAME>:<SALT>$<HASH>. A canonical python script is included in share/rpcauth. The client then connects normally using the rpcuser=<USERNAME>/rpcpassword=<PASSWORD> pair of arguments. This option can be specified multiple times", false, OptionsCategory::RPC);
+    gArgs.AddArg("-rpcbatchthreads=<n>", strprintf("Set the number of threads the read-only calls of a JSON-RPC batch request run on (default: %d)", DEFAULT_RPC_BATCH_THREADS), false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcbind=<addr>[:port]", "Bind to given address to listen for JSON-RPC connections. Do not expose the RPC server to untrusted networks such as the public internet! This option is ignored unless -rpcallowip is also passed. Port is optional and overrides -rpcport. Use [host]:port notation for IPv6. This option can be specified multiple times (default: 127.0.0.1 and ::1 i.e., localhost)", false, OptionsCategory::RPC);
+    gArgs.AddArg("-rpccachesize=<n>", strprintf("Cache the results of getblock, getblockstats, getblocktransactionreceipts and gettransactionreceipt about blocks with at least %d confirmations, in <n> MiB (0 to disable, default: %d)", RPC_CACHE_MIN_CONFIRMATIONS, DEFAULT_RPC_CACHE_SIZE), false, OptionsCategory::RPC);
+    gArgs.AddArg("-rpcclientweight=<weight>@<ip>", "Serve up to <weight> queued requests of the clients of the given address in a row, when the RPC work queue is shared with other clients, instead of one. <ip> can be a single IP, a network/netmask or a network/CIDR. This option can be specified multiple times, the first matching one is used", false, OptionsCategory::RPC);
     gArgs.AddArg("-rpccookiefile=<loc>", "Location of the auth cookie. Relative paths will be prefixed by a net-specific datadir location. (default: data dir)", false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcpassword=<pw>", "Password for JSON-RPC connections", false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcport=<port>", strprintf("Listen for JSON-RPC connections on <port> (default: %u, testnet: %u, regtest: %u)", defaultBaseParams->RPCPort(), testnetBaseParams->RPCPort(), regtestBaseParams->RPCPort()), false, OptionsCategory::RPC);
@@ -563,7 +713,7 @@ void SetupServerArgs()
     gArgs.AddArg("-rpcservertimeout=<n>", strprintf("Timeout during HTTP requests (default: %d)", DEFAULT_HTTP_SERVER_TIMEOUT), true, OptionsCategory::RPC);
     gArgs.AddArg("-rpcthreads=<n>", strprintf("Set the number of threads to service RPC calls (default: %d)", DEFAULT_HTTP_THREADS), false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcuser=<user>", "Username for JSON-RPC connections", false, OptionsCategory::RPC);
-    gArgs.AddArg("-rpcworkqueue=<n>", strprintf("Set the depth of the work queue to service RPC calls (default: %d)", DEFAULT_HTTP_WORKQUEUE), true, OptionsCategory::RPC);
+    gArgs.AddArg("-rpcworkqueue=<n>", strprintf("Set the number of RPC calls a client may have waiting in the work queue (default: %d)", DEFAULT_HTTP_WORKQUEUE), true, OptionsCategory::RPC);
     gArgs.AddArg("-server", "Accept command line and JSON-RPC commands", false, OptionsCategory::RPC);
 
 #if HAVE_DECL_DAEMON
@@ -699,6 +849,23 @@ void DeleteBlockChainData()
     fs::remove(GetDataDir() / "mempool.dat");
 }
 
+/** Grow the signature and script execution caches that evicted many entries since the last call, each up to nMaxBytes */
+static void AdaptSignatureCaches(size_t nMaxBytes)
+{
+    static uint64_t nLastSigEvictions = 0;
+    static uint64_t nLastScriptEvictions = 0;
+
+    const SignatureCacheStats sigStats = GetSignatureCacheStats();
+    if (SignatureCacheShouldGrow(sigStats, nLastSigEvictions) && GrowSignatureCache(nMaxBytes))
+        LogPrintf("Signature cache evicted %u entries, grown to %u entries\n", sigStats.nEvictions - nLastSigEvictions, GetSignatureCacheStats().nCapacity);
+    nLastSigEvictions = sigStats.nEvictions;
+
+    const SignatureCacheStats scriptStats = GetScriptExecutionCacheStats();
+    if (SignatureCacheShouldGrow(scriptStats, nLastScriptEvictions) && GrowScriptExecutionCache(nMaxBytes))
+        LogPrintf("Script execution cache evicted %u entries, grown to %u entries\n", scriptStats.nEvictions - nLastScriptEvictions, GetScriptExecutionCacheStats().nCapacity);
+    nLastScriptEvictions = scriptStats.nEvictions;
+}
+
 static void ThreadImport(std::vector<fs::path> vImportFiles)
 {
     const CChainParams& chainparams = Params();
@@ -802,6 +969,7 @@ static bool AppInitServers()
     RPCServer::OnStopped(&OnRPCStopped);
     if (!InitHTTPServer())
         return false;
+    g_rpc_response_cache.SetMaxSize(std::max<int64_t>(gArgs.GetArg("-rpccachesize", DEFAULT_RPC_CACHE_SIZE), 0) << 20);
     StartRPC();
     if (!StartHTTPRPC())
         return false;
@@ -932,9 +1100,98 @@ int nUserMaxConnections;
 int nFD;
 ServiceFlags nLocalServices = ServiceFlags(NODE_NETWORK | NODE_NETWORK_LIMITED);
 int64_t peer_connect_timeout;
+BackgroundCheckMode backgroundCheckMode = BackgroundCheckMode::OFF;
 
 } // namespace
 
+/**
+ * Wall time of the steps of AppInitMain, logged as the startup profile when it is done.
+ * The steps run in the background are logged with their own time, which overlaps the
+ * time of the steps they run beside.
+ */
+class StartupProfile
+{
+public:
+    /** End the current step, if any, and start the step name */
+    void Step(const std::string& name)
+    {
+        LOCK(m_cs);
+        int64_t nNow = GetTimeMillis();
+        if (!m_current.empty()) {
+            m_steps.emplace_back(m_current, nNow - m_start);
+        }
+        m_current = name;
+        m_start = nNow;
+    }
+
+    /** Record a step that ran on its own thread */
+    void Background(const std::string& name, int64_t nMillis)
+    {
+        LOCK(m_cs);
+        m_background.emplace_back(name, nMillis);
+    }
+
+    /** End the current step and log the steps */
+    void Log()
+    {
+        Step("");
+        LOCK(m_cs);
+        int64_t nTotal = 0;
+        LogPrintf("Startup profile:\n");
+        for (const auto& step : m_steps) {
+            LogPrintf("* %-36s %8dms\n", step.first, step.second);
+            nTotal += step.second;
+        }
+        for (const auto& step : m_background) {
+            LogPrintf("* %-36s %8dms (in background)\n", step.first, step.second);
+        }
+        LogPrintf("* %-36s %8dms\n", "total", nTotal);
+    }
+
+private:
+    Mutex m_cs;
+    std::vector<std::pair<std::string, int64_t>> m_steps GUARDED_BY(m_cs);
+    std::vector<std::pair<std::string, int64_t>> m_background GUARDED_BY(m_cs);
+    std::string m_current GUARDED_BY(m_cs);
+    int64_t m_start GUARDED_BY(m_cs) = 0;
+};
+
+static StartupProfile g_startup_profile;
+
+/** Run f on a thread of its own, as the background startup step name */
+template <typename F>
+static auto StartupInBackground(const std::string& name, F f) -> std::future<decltype(f())>
+{
+    return std::async(std::launch::async, [name, f] {
+        int64_t nStart = GetTimeMillis();
+        auto ret = f();
+        g_startup_profile.Background(name, GetTimeMillis() - nStart);
+        return ret;
+    });
+}
+
+/** The contract state and receipt databases, which do not depend on the block index */
+struct ContractStateDBs
+{
+    std::unique_ptr<QtumState> state;
+    std::unique_ptr<StorageResults> storageResults;
+};
+
+static ContractStateDBs OpenContractStateDBs()
+{
+    ContractStateDBs dbs;
+    fs::path qtumStateDir = GetDataDir() / "stateKPG";
+    bool fStatus = fs::exists(qtumStateDir);
+    const std::string dirQtum(qtumStateDir.string());
+    const dev::h256 hashDB(dev::sha3(dev::rlp("")));
+    dev::eth::BaseState existsQtumstate = fStatus && !fStateInMemory ? dev::eth::BaseState::PreExisting : dev::eth::BaseState::Empty;
+    dev::db::DatabaseFace* pstateDiskDB = nullptr;
+    dev::OverlayDB stateDB(OpenCachedStateDB(dirQtum, hashDB, nStateNodeCacheSize, nContractCodeCacheSize, &pstateDiskDB));
+    dbs.state.reset(new QtumState(dev::u256(0), stateDB, dirQtum, existsQtumstate, pstateDiskDB));
+    dbs.storageResults.reset(new StorageResults(dirQtum));
+    return dbs;
+}
+
 [[noreturn]] static void new_handler_terminate()
 {
     // Rather than throwing std::bad-alloc if allocation fails, terminate
@@ -1000,12 +1257,50 @@ bool AppInitParameterInteraction()
         return InitError(strprintf(_("Specified blocks directory \"%s\" does not exist."), gArgs.GetArg("-blocksdir", "").c_str()));
     }
 
-    // if using block pruning, then disallow txindex
+    // parse and validate enabled filter types
+    std::string blockfilterindex_value = gArgs.GetArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX);
+    if (blockfilterindex_value == "" || blockfilterindex_value == "1") {
+        g_enabled_filter_types = AllBlockFilterTypes();
+    } else if (blockfilterindex_value != "0") {
+        const std::vector<std::string> names = gArgs.GetArgs("-blockfilterindex");
+        g_enabled_filter_types.reserve(names.size());
+        for (const auto& name : names) {
+            BlockFilterType filter_type;
+            if (!BlockFilterTypeByName(name, filter_type)) {
+                return InitError(strprintf(_("Unknown -blockfilterindex value %s."), name));
+            }
+            g_enabled_filter_types.push_back(filter_type);
+        }
+    }
+
+    // if using block pruning, then disallow txindex, which reads the transactions from the
+    // block files. The other indexes keep what they serve in their own databases, and
+    // pruning keeps the blocks they have not processed yet.
     if (gArgs.GetArg("-prune", 0)) {
         if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX))
             return InitError(_("Prune mode is incompatible with -txindex."));
+        // The chain state is built again from the blocks at every start
+        if (gArgs.GetBoolArg("-memorystate", DEFAULT_MEMORY_STATE))
+            return InitError(_("Prune mode is incompatible with -memorystate."));
     }
 
+#ifdef ENABLE_BITCORE_RPC
+    // The mempool keeps its address entries from the start, the address index catches up in the background
+    fAddressIndex = gArgs.GetBoolArg("-addrindex", DEFAULT_ADDRINDEX);
+#endif
+
+    if (gArgs.GetBoolArg("-logtopicindex", DEFAULT_LOGTOPICINDEX) && !gArgs.GetBoolArg("-logevents", DEFAULT_LOGEVENTS))
+        return InitError(_("-logtopicindex requires -logevents."));
+    if (gArgs.GetBoolArg("-logaddressindex", DEFAULT_LOGADDRESSINDEX) && !gArgs.GetBoolArg("-logevents", DEFAULT_LOGEVENTS))
+        return InitError(_("-logaddressindex requires -logevents."));
+    fLogEvents = gArgs.GetBoolArg("-logevents", DEFAULT_LOGEVENTS);
+    fLogTopicIndex = fLogEvents && gArgs.GetBoolArg("-logtopicindex", DEFAULT_LOGTOPICINDEX);
+    fLogAddressIndex = fLogEvents && gArgs.GetBoolArg("-logaddressindex", DEFAULT_LOGADDRESSINDEX);
+    fContractStateGrowth = gArgs.GetBoolArg("-contractindex", DEFAULT_CONTRACTINDEX);
+
+    if (!ParseBackgroundCheckMode(gArgs.GetArg("-backgroundcheck", DEFAULT_BACKGROUND_CHECK), backgroundCheckMode))
+        return InitError(strprintf(_("Unknown -backgroundcheck mode: %s"), gArgs.GetArg("-backgroundcheck", DEFAULT_BACKGROUND_CHECK)));
+
     // -bind and -whitebind can't be set when not listening
     size_t nUserBind = gArgs.GetArgs("-bind").size() + gArgs.GetArgs("-whitebind").size();
     if (nUserBind != 0 && !gArgs.GetBoolArg("-listen", DEFAULT_LISTEN)) {
@@ -1061,9 +1356,15 @@ bool AppInitParameterInteraction()
         mempool.setSanityCheck(1.0 / ratio);
     }
     fCheckBlockIndex = gArgs.GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
+    if (gArgs.GetBoolArg("-lockstats", DEFAULT_LOCK_STATS)) {
+        EnableLockStats();
+        RegisterLockStats(&cs_main, "cs_main");
+        RegisterLockStats(&::mempool.cs, "mempool.cs");
+    }
     fCheckpointsEnabled = gArgs.GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
 
     hashAssumeValid = uint256S(gArgs.GetArg("-assumevalid", chainparams.GetConsensus().defaultAssumeValid.GetHex()));
+    fAssumeValidStake = gArgs.GetBoolArg("-assumevalidstake", DEFAULT_ASSUME_VALID_STAKE);
     if (!hashAssumeValid.IsNull())
         LogPrintf("Assuming ancestors of block %s have valid signatures.\n", hashAssumeValid.GetHex());
     else
@@ -1088,6 +1389,8 @@ bool AppInitParameterInteraction()
     int64_t nMempoolSizeMin = gArgs.GetArg("-limitdescendantsize", DEFAULT_DESCENDANT_SIZE_LIMIT) * 1000 * 40;
     if (nMempoolSizeMax < 0 || nMempoolSizeMax < nMempoolSizeMin)
         return InitError(strprintf(_("-maxmempool must be at least %d MB"), std::ceil(nMempoolSizeMin / 1000000.0)));
+    if (gArgs.GetArg("-maxmempoolgas", DEFAULT_MAX_MEMPOOL_GAS) < 0)
+        return InitError(_("-maxmempoolgas must not be negative"));
     // incremental relay fee sets the minimum feerate increase necessary for BIP 125 replacement in the mempool
     // and the amount the mempool min fee increases above the feerate of txs evicted due to mempool limiting.
     if (gArgs.IsArgSet("-incrementalrelayfee"))
@@ -1107,6 +1410,19 @@ bool AppInitParameterInteraction()
     else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
 
+    nStateNodeCacheSize = std::max<int64_t>(0, gArgs.GetArg("-statenodecache", DEFAULT_STATE_NODE_CACHE)) << 19;
+    nContractCodeCacheSize = std::max<int64_t>(0, gArgs.GetArg("-contractcodecache", DEFAULT_CONTRACT_CODE_CACHE)) << 20;
+    fStateInMemory = gArgs.GetBoolArg("-memorystate", DEFAULT_MEMORY_STATE);
+    if (fStateInMemory)
+        LogPrintf("The chain state and the contract state are kept in memory, the blocks are connected again at every start\n");
+    if (int64_t nProfileSample = gArgs.GetArg("-contractprofile", DEFAULT_CONTRACT_PROFILE)) {
+        if (nProfileSample < 0 || nProfileSample > std::numeric_limits<unsigned int>::max())
+            return InitError(_("Invalid -contractprofile sample interval."));
+        pcontractprofiler.reset(new ContractProfiler(nProfileSample));
+    }
+    nContractProfileLogInterval = std::max(0, (int)gArgs.GetArg("-contractprofilelog", DEFAULT_CONTRACT_PROFILE_LOG));
+    nContractSpeculationThreads = std::max(0, std::min<int>(gArgs.GetArg("-parcontract", DEFAULT_CONTRACT_SPECULATION_THREADS), MAX_CONTRACT_SPECULATION_THREADS));
+
     // block pruning; get the amount of disk space (in MiB) to allot for block & undo files
     int64_t nPruneArg = gArgs.GetArg("-prune", 0);
     if (nPruneArg < 0) {
@@ -1125,6 +1441,29 @@ bool AppInitParameterInteraction()
         fPruneMode = true;
     }
 
+    fCompressBlocks = gArgs.GetBoolArg("-compressblocks", DEFAULT_COMPRESS_BLOCKS);
+
+    // contract state pruning; number of blocks below the tip whose state tries are kept
+    int64_t nPruneStateArg = gArgs.GetArg("-prunestate", DEFAULT_PRUNE_STATE);
+    if (nPruneStateArg < 0) {
+        return InitError(_("Contract state pruning cannot be configured with a negative value."));
+    }
+    if (nPruneStateArg > 0 && nPruneStateArg < MIN_POS_BLOCKS_TO_KEEP) {
+        return InitError(strprintf(_("Contract state pruning configured below the minimum of %d blocks."), MIN_POS_BLOCKS_TO_KEEP));
+    }
+    // These indexes execute the contracts of the blocks again when they sync or catch up,
+    // which needs the state of the parent of each block
+    if (nPruneStateArg > 0) {
+        if (fLogEvents)
+            return InitError(_("Contract state pruning is incompatible with -logevents."));
+        if (std::find(g_enabled_filter_types.begin(), g_enabled_filter_types.end(), BlockFilterType::CONTRACT) != g_enabled_filter_types.end())
+            return InitError(_("Contract state pruning is incompatible with the contract block filter index."));
+        if (gArgs.GetBoolArg("-blockstatsindex", DEFAULT_BLOCKSTATSINDEX))
+            return InitError(_("Contract state pruning is incompatible with -blockstatsindex."));
+        if (fContractStateGrowth)
+            return InitError(_("Contract state pruning is incompatible with -contractindex."));
+    }
+
     nConnectTimeout = gArgs.GetArg("-timeout", DEFAULT_CONNECT_TIMEOUT);
     if (nConnectTimeout <= 0) {
         nConnectTimeout = DEFAULT_CONNECT_TIMEOUT;
@@ -1217,6 +1556,8 @@ bool AppInitParameterInteraction()
         fEnableReplacement = (std::find(vstrReplacementModes.begin(), vstrReplacementModes.end(), "fee") != vstrReplacementModes.end());
     }
 
+    fMempoolPreExec = gArgs.GetBoolArg("-mempoolpreexec", DEFAULT_MEMPOOL_PREEXEC);
+
     if (gArgs.IsArgSet("-opsenderheight")) {
         // Allow overriding opsender block for testing
         if (!chainparams.MineBlocksOnDemand()) {
@@ -1296,6 +1637,8 @@ bool AppInitSanityChecks()
     // Initialize elliptic curve code
     std::string sha256_algo = SHA256AutoDetect();
     LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+    std::string keccak_algo = KeccakAutoDetect();
+    LogPrintf("Using the '%s' Keccak implementation\n", keccak_algo);
     RandomInit();
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
@@ -1326,6 +1669,7 @@ bool AppInitMain(InitInterfaces& interfaces)
 {
     const CChainParams& chainparams = Params();
     // ********************************************************* Step 4a: application initialization
+    g_startup_profile.Step("application initialization");
     if (!CreatePidFile()) {
         // Detailed error printed inside CreatePidFile().
         return false;
@@ -1341,10 +1685,16 @@ bool AppInitMain(InitInterfaces& interfaces)
                 LogInstance().m_file_path.string()));
         }
     }
+    if (gArgs.GetBoolArg("-logasync", DEFAULT_LOGASYNC)) {
+        LogInstance().StartAsync();
+    }
 
 ////////////////////////////////////////////////////////////////////// // kpg
     dev::g_logPost = [&](std::string const& s, char const* c){ LogInstance().LogPrintStr(s + '\n', true); };
     dev::g_logPost(std::string("\n\n\n\n\n\n\n\n\n\n"), NULL);
+    std::string strVMError;
+    if (!SelectVM(gArgs.GetArg("-vm", DEFAULT_VM), gArgs.GetArgs("-evmc"), strVMError))
+        return InitError(strprintf(_("Cannot select the EVM %s: %s"), gArgs.GetArg("-vm", DEFAULT_VM), strVMError));
 //////////////////////////////////////////////////////////////////////
 
     if (!LogInstance().m_log_timestamps)
@@ -1382,20 +1732,44 @@ bool AppInitMain(InitInterfaces& interfaces)
 
     InitSignatureCache();
     InitScriptExecutionCache();
+    qtumutils::SetEcrecoverCacheSize(std::max<int64_t>(0, gArgs.GetArg("-ecrecovercache", qtumutils::DEFAULT_ECRECOVER_CACHE_SIZE)));
 
     LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
         for (int i=0; i<nScriptCheckThreads-1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
+        // The thread handling a block or headers message joins these, as the validation
+        // thread joins the script checks
+        for (int i=0; i<nScriptCheckThreads-1; i++)
+            threadGroup.create_thread(&ThreadPrecheck);
+        // Large blocks read from the network or the disk hash their transactions there too
+        g_tx_hash_parallel = ParallelForRanges;
     }
 
-    // Start the lightweight task scheduler thread
+    if (nContractSpeculationThreads) {
+        LogPrintf("Using %u threads for contract speculation\n", nContractSpeculationThreads);
+        for (int i=0; i<nContractSpeculationThreads; i++)
+            threadGroup.create_thread(&ThreadContractSpeculation);
+    }
+
+    // Start the lightweight task scheduler threads, which also run the queues of the validation interface subscribers
+    int nSchedulerThreads = std::max(1, std::min<int>(gArgs.GetArg("-schedulerthreads", DEFAULT_SCHEDULER_THREADS), MAX_SCHEDULER_THREADS));
     CScheduler::Function serviceLoop = std::bind(&CScheduler::serviceQueue, &scheduler);
-    threadGroup.create_thread(std::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
+    for (int i = 0; i < nSchedulerThreads; i++)
+        threadGroup.create_thread(std::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
 
     GetMainSignals().RegisterBackgroundSignalScheduler(scheduler);
     GetMainSignals().RegisterWithMempoolSignals(mempool);
 
+    // The bytes are split between the two caches as for -maxsigcachesize
+    const int64_t nMaxSigCacheAdaptive = std::min(gArgs.GetArg("-maxsigcacheadaptive", DEFAULT_MAX_SIG_CACHE_ADAPTIVE), MAX_MAX_SIG_CACHE_SIZE);
+    if (nMaxSigCacheAdaptive > gArgs.GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE)) {
+        const size_t nMaxBytes = (size_t)(nMaxSigCacheAdaptive / 2) << 20;
+        scheduler.scheduleEvery([nMaxBytes]{
+            AdaptSignatureCaches(nMaxBytes);
+        }, SIG_CACHE_ADAPT_INTERVAL * 1000);
+    }
+
     // Create client interfaces for wallets that are supposed to be loaded
     // according to -wallet and -disablewallet options. This only constructs
     // the interfaces, it doesn't load wallet data. Wallets actually get loaded
@@ -1427,6 +1801,7 @@ bool AppInitMain(InitInterfaces& interfaces)
     }
 
     // ********************************************************* Step 5: verify wallet database integrity
+    g_startup_profile.Step("wallet database verification");
     for (const auto& client : interfaces.chain_clients) {
         if (!client->verify()) {
             return false;
@@ -1434,6 +1809,7 @@ bool AppInitMain(InitInterfaces& interfaces)
     }
 
     // ********************************************************* Step 6: network initialization
+    g_startup_profile.Step("network initialization");
     // Note that we absolutely cannot open any actual connections
     // until the very end ("start node") as the UTXO/block state
     // is not yet setup and may end up being set up twice if we
@@ -1447,6 +1823,28 @@ bool AppInitMain(InitInterfaces& interfaces)
     peerLogic.reset(new PeerLogicValidation(g_connman.get(), g_banman.get(), scheduler, gArgs.GetBoolArg("-enablebip61", DEFAULT_ENABLE_BIP61)));
     RegisterValidationInterface(peerLogic.get());
 
+    int nTxVerifyThreads = std::max(0, std::min<int>(gArgs.GetArg("-txverifythreads", DEFAULT_TX_VERIFY_THREADS), MAX_TX_VERIFY_THREADS));
+    if (nTxVerifyThreads) {
+        LogPrintf("Using %d threads to verify the scripts of relayed transactions\n", nTxVerifyThreads);
+        CConnman* connman = g_connman.get();
+        g_txpreverifier = MakeUnique<TxPreverifier>(nTxVerifyThreads, [connman] { connman->WakeMessageHandler(); });
+    }
+
+    g_block_file_maps.SetMaxFiles(std::max(0, std::min<int>(gArgs.GetArg("-blockfilemaps", DEFAULT_BLOCK_FILE_MAPS), MAX_BLOCK_FILE_MAPS)));
+
+    int nBlockWriteQueue = std::max(0, std::min<int>(gArgs.GetArg("-blockwritequeue", DEFAULT_BLOCK_WRITE_QUEUE), MAX_BLOCK_WRITE_QUEUE));
+    if (nBlockWriteQueue) {
+        LogPrintf("Writing blocks to disk on a background thread, queueing up to %d MiB\n", nBlockWriteQueue);
+        g_block_file_writer = MakeUnique<BlockFileWriter>((size_t)nBlockWriteQueue << 20);
+    }
+
+    int nBlockServeThreads = std::max(0, std::min<int>(gArgs.GetArg("-blockservethreads", DEFAULT_BLOCK_SERVE_THREADS), MAX_BLOCK_SERVE_THREADS));
+    if (nBlockServeThreads) {
+        LogPrintf("Using %d threads to serve the blocks requested by peers\n", nBlockServeThreads);
+        CConnman* connman = g_connman.get();
+        g_blockserver = MakeUnique<BlockServer>(nBlockServeThreads, [connman] { connman->WakeMessageHandler(); });
+    }
+
 #ifdef ENABLE_WALLET
     CWallet::defaultConnman = g_connman.get();
 #endif
@@ -1537,13 +1935,6 @@ bool AppInitMain(InitInterfaces& interfaces)
             return InitError(ResolveErrMsg("externalip", strAddr));
     }
 
-#if ENABLE_ZMQ
-    g_zmq_notification_interface = CZMQNotificationInterface::Create();
-
-    if (g_zmq_notification_interface) {
-        RegisterValidationInterface(g_zmq_notification_interface);
-    }
-#endif
     uint64_t nMaxOutboundLimit = 0; //unlimited unless -maxuploadtarget is set
     uint64_t nMaxOutboundTimeframe = MAX_UPLOAD_TIMEFRAME;
 
@@ -1552,6 +1943,7 @@ bool AppInitMain(InitInterfaces& interfaces)
     }
 
     // ********************************************************* Step 7: load block chain
+    g_startup_profile.Step("cache configuration");
 
     fReindex = gArgs.GetBoolArg("-reindex", false);
     bool fReindexChainState = gArgs.GetBoolArg("-reindex-chainstate", false);
@@ -1562,29 +1954,73 @@ bool AppInitMain(InitInterfaces& interfaces)
     nTotalCache = std::min(nTotalCache, nMaxDbCache << 20); // total cache cannot be greater than nMaxDbcache
     int64_t nBlockTreeDBCache = std::min(nTotalCache / 8, nMaxBlockDBCache << 20);
 #ifdef ENABLE_BITCORE_RPC
-    if (gArgs.GetBoolArg("-addrindex", DEFAULT_ADDRINDEX)) {
-        // enable 3/4 of the cache if addressindex and/or spentindex is enabled
-        nBlockTreeDBCache = nTotalCache * 3 / 4;
-    } else {
-        if (nBlockTreeDBCache > (1 << 21) && !gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
-            nBlockTreeDBCache = (1 << 21); // block tree db cache shouldn't be larger than 2 MiB
-        }
+    if (nBlockTreeDBCache > (1 << 21) && !gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
+        nBlockTreeDBCache = (1 << 21); // block tree db cache shouldn't be larger than 2 MiB
     }
 #endif
     nTotalCache -= nBlockTreeDBCache;
+#ifdef ENABLE_BITCORE_RPC
+    // enable 3/4 of the cache if addressindex and/or spentindex is enabled
+    int64_t nAddressIndexCache = gArgs.GetBoolArg("-addrindex", DEFAULT_ADDRINDEX) ? nTotalCache * 3 / 4 : 0;
+    nTotalCache -= nAddressIndexCache;
+#endif
     int64_t nTxIndexCache = std::min(nTotalCache / 8, gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX) ? nMaxTxIndexCache << 20 : 0);
     nTotalCache -= nTxIndexCache;
+    int64_t filter_index_cache = 0;
+    if (!g_enabled_filter_types.empty()) {
+        size_t n_indexes = g_enabled_filter_types.size();
+        int64_t max_cache = std::min(nTotalCache / 8, max_filter_index_cache << 20);
+        filter_index_cache = max_cache / n_indexes;
+        nTotalCache -= filter_index_cache * n_indexes;
+    }
+    int64_t nBlockStatsIndexCache = std::min(nTotalCache / 8, gArgs.GetBoolArg("-blockstatsindex", DEFAULT_BLOCKSTATSINDEX) ? MAX_BLOCKSTATSINDEX_CACHE << 20 : 0);
+    nTotalCache -= nBlockStatsIndexCache;
+    int64_t nContractIndexCache = std::min(nTotalCache / 8, gArgs.GetBoolArg("-contractindex", DEFAULT_CONTRACTINDEX) ? MAX_CONTRACTINDEX_CACHE << 20 : 0);
+    nTotalCache -= nContractIndexCache;
+    int64_t nStateDiffIndexCache = std::min(nTotalCache / 8, gArgs.GetBoolArg("-statediffindex", DEFAULT_STATEDIFFINDEX) ? MAX_STATEDIFFINDEX_CACHE << 20 : 0);
+    nTotalCache -= nStateDiffIndexCache;
+    int64_t nStateDBCache = std::min(nTotalCache / 8, nMaxStateDBCache << 20);
+    nTotalCache -= nStateDBCache;
     int64_t nCoinDBCache = std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache
     nCoinDBCache = std::min(nCoinDBCache, nMaxCoinsDBCache << 20); // cap total coins db cache
     nTotalCache -= nCoinDBCache;
     nCoinCacheUsage = nTotalCache; // the rest goes to in-memory cache
+    // All the LevelDB databases read through one block cache, made of the block cache half
+    // of each database cache above and of the state databases' share, so that it holds
+    // the blocks read most whichever database they belong to.
+    int64_t nSharedBlockCache = (nBlockTreeDBCache + nTxIndexCache + filter_index_cache * (int64_t)g_enabled_filter_types.size() +
+                                 nBlockStatsIndexCache + nContractIndexCache + nStateDiffIndexCache + nCoinDBCache) / 2 + nStateDBCache;
+#ifdef ENABLE_BITCORE_RPC
+    nSharedBlockCache += nAddressIndexCache / 2;
+#endif
+    CreateSharedBlockCache(nSharedBlockCache);
     int64_t nMempoolSizeMax = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1f MiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
     if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
         LogPrintf("* Using %.1f MiB for transaction index database\n", nTxIndexCache * (1.0 / 1024 / 1024));
     }
+    for (BlockFilterType filter_type : g_enabled_filter_types) {
+        LogPrintf("* Using %.1f MiB for %s block filter index database\n",
+                  filter_index_cache * (1.0 / 1024 / 1024), BlockFilterTypeName(filter_type));
+    }
+    if (gArgs.GetBoolArg("-blockstatsindex", DEFAULT_BLOCKSTATSINDEX)) {
+        LogPrintf("* Using %.1f MiB for block statistics index database\n", nBlockStatsIndexCache * (1.0 / 1024 / 1024));
+    }
+    if (gArgs.GetBoolArg("-contractindex", DEFAULT_CONTRACTINDEX)) {
+        LogPrintf("* Using %.1f MiB for contract index database\n", nContractIndexCache * (1.0 / 1024 / 1024));
+    }
+    if (gArgs.GetBoolArg("-statediffindex", DEFAULT_STATEDIFFINDEX)) {
+        LogPrintf("* Using %.1f MiB for state diff index database\n", nStateDiffIndexCache * (1.0 / 1024 / 1024));
+    }
+#ifdef ENABLE_BITCORE_RPC
+    if (gArgs.GetBoolArg("-addrindex", DEFAULT_ADDRINDEX)) {
+        LogPrintf("* Using %.1f MiB for address index database\n", nAddressIndexCache * (1.0 / 1024 / 1024));
+    }
+#endif
     LogPrintf("* Using %.1f MiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
+    LogPrintf("* Using %.1f MiB for contract state and receipts databases\n", nStateDBCache * (1.0 / 1024 / 1024));
+    LogPrintf("* Using %.1f MiB of the above for the block cache shared by all databases\n", nSharedBlockCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1f MiB for in-memory UTXO set (plus up to %.1f MiB of unused mempool space)\n", nCoinCacheUsage * (1.0 / 1024 / 1024), nMempoolSizeMax * (1.0 / 1024 / 1024));
 
     bool fLoaded = false;
@@ -1593,22 +2029,35 @@ bool AppInitMain(InitInterfaces& interfaces)
         std::string strLoadError;
 
         uiInterface.InitMessage(_("Loading block index..."));
+        g_startup_profile.Step("block index");
 
         do {
             const int64_t load_block_index_start_time = GetTimeMillis();
             bool is_coinsview_empty;
+            std::future<ContractStateDBs> futureStateDBs;
             try {
                 LOCK(cs_main);
                 UnloadBlockIndex();
                 pcoinsTip.reset();
-                pcoinsdbview.reset();
                 pcoinscatcher.reset();
+                pcoinsflusher.reset();
+                pcoinsdbview.reset();
                 // new CBlockTreeDB tries to delete the existing file, which
                 // fails if it's still open from the previous loop. Close it first:
                 pblocktree.reset();
                 pstorageresult.reset();
+                pstatepruner.reset();
                 globalState.reset();
                 globalSealEngine.reset();
+
+                // The coins and contract state databases are opened while the block index loads.
+                // With -memorystate both start empty, so the chain is connected again from genesis.
+                bool fWipeCoins = fReset || fReindexChainState;
+                std::future<std::unique_ptr<CCoinsViewDB>> futureCoinsDB = StartupInBackground("open chain state database", [nCoinDBCache, fWipeCoins] {
+                    return MakeUnique<CCoinsViewDB>(nCoinDBCache, fStateInMemory, fWipeCoins);
+                });
+                futureStateDBs = StartupInBackground("open contract state databases", OpenContractStateDBs);
+
                 pblocktree.reset(new CBlockTreeDB(nBlockTreeDBCache, false, fReset));
 
                 if (fReset) {
@@ -1654,8 +2103,11 @@ bool AppInitMain(InitInterfaces& interfaces)
                 // At this point we're either in reindex or we've loaded a useful
                 // block tree into mapBlockIndex!
 
-                pcoinsdbview.reset(new CCoinsViewDB(nCoinDBCache, false, fReset || fReindexChainState));
-                pcoinscatcher.reset(new CCoinsViewErrorCatcher(pcoinsdbview.get()));
+                g_startup_profile.Step("chain state");
+                pcoinsdbview = futureCoinsDB.get();
+                if (gArgs.GetBoolArg("-backgroundflush", DEFAULT_BACKGROUND_FLUSH))
+                    pcoinsflusher.reset(new CCoinsViewBackgroundFlush(pcoinsdbview.get()));
+                pcoinscatcher.reset(new CCoinsViewErrorCatcher(pcoinsflusher ? static_cast<CCoinsView*>(pcoinsflusher.get()) : pcoinsdbview.get()));
 
                 // If necessary, upgrade from older database format.
                 // This is a no-op if we cleared the coinsviewdb with -reindex or -reindex-chainstate
@@ -1696,17 +2148,20 @@ bool AppInitMain(InitInterfaces& interfaces)
                     fGettingValuesDGP = false;
                 }
 
+                g_startup_profile.Step("contract state");
                 dev::eth::NoProof::init();
-                fs::path qtumStateDir = GetDataDir() / "stateKPG";
-                bool fStatus = fs::exists(qtumStateDir);
-                const std::string dirQtum(qtumStateDir.string());
-                const dev::h256 hashDB(dev::sha3(dev::rlp("")));
-                dev::eth::BaseState existsQtumstate = fStatus ? dev::eth::BaseState::PreExisting : dev::eth::BaseState::Empty;
-                globalState = std::unique_ptr<QtumState>(new QtumState(dev::u256(0), QtumState::openDB(dirQtum, hashDB, dev::WithExisting::Trust), dirQtum, existsQtumstate));
+                ContractStateDBs stateDBs = futureStateDBs.get();
+                globalState = std::move(stateDBs.state);
+                pstatepruner.reset();
+                if (int64_t nPruneStateBlocks = gArgs.GetArg("-prunestate", DEFAULT_PRUNE_STATE)) {
+                    LogPrintf("Contract state pruning enabled, keeping the state of the last %d blocks.\n", nPruneStateBlocks);
+                    pstatepruner.reset(new StatePruner(globalState->diskDb(), globalState->diskDbUtxo(), nPruneStateBlocks));
+                }
+                QtumDGP::clearCache();
                 dev::eth::ChainParams cp((chainparams.EVMGenesisInfo(dev::eth::Network::qtumMainNetwork)));
                 globalSealEngine = std::unique_ptr<dev::eth::SealEngineFace>(cp.createSealEngine());
 
-                pstorageresult.reset(new StorageResults(qtumStateDir.string()));
+                pstorageresult = std::move(stateDBs.storageResults);
                 if (fReset) {
                     pstorageresult->wipeResults();
                 }
@@ -1726,26 +2181,19 @@ bool AppInitMain(InitInterfaces& interfaces)
                 fIsVMlogFile = fs::exists(GetDataDir() / "vmExecLogs.json");
                 ///////////////////////////////////////////////////////////
 
-#ifdef ENABLE_BITCORE_RPC
-                /////////////////////////////////////////////////////////////// // kpg
-                if (fAddressIndex != gArgs.GetBoolArg("-addrindex", DEFAULT_ADDRINDEX)) {
-                    strLoadError = _("You need to rebuild the database using -reindex-chainstate to change -addrindex");
-                    break;
-                }
-                ///////////////////////////////////////////////////////////////
-#endif
-                // Check for changed -logevents state
-                if (fLogEvents != gArgs.GetBoolArg("-logevents", DEFAULT_LOGEVENTS) && !fLogEvents) {
-                    strLoadError = _("You need to rebuild the database using -reindex to enable -logevents");
-                    break;
-                }
-
-                if (!gArgs.GetBoolArg("-logevents", DEFAULT_LOGEVENTS))
-                {
+                // Drop the entries of an earlier -logevents, the log index builds them again when it is enabled
+                if (!fLogEvents) {
                     pstorageresult->wipeResults();
                     pblocktree->WipeHeightIndex();
-                    fLogEvents = false;
-                    pblocktree->WriteFlag("logevents", fLogEvents);
+                    pblocktree->WipeTopicIndex();
+                    pblocktree->WipeContractAddressIndex();
+                    pblocktree->WriteFlag("logevents", false);
+                    fs::remove_all(GetDataDir() / "indexes" / "logindex");
+                }
+
+                if (!pblocktree->UpgradeStakerIndex(chainActive.Height())) {
+                    strLoadError = _("Error upgrading block database");
+                    break;
                 }
 
             if (!fReset) {
@@ -1753,6 +2201,7 @@ bool AppInitMain(InitInterfaces& interfaces)
                 // It both disconnects blocks based on chainActive, and drops block data in
                 // mapBlockIndex based on lack of available witness data.
                 uiInterface.InitMessage(_("Rewinding blocks..."));
+                g_startup_profile.Step("block rewind");
                 if (!RewindBlockIndex(chainparams)) {
                     strLoadError = _("Unable to rewind the database to a pre-fork state. You will need to redownload the blockchain");
                     break;
@@ -1763,6 +2212,7 @@ bool AppInitMain(InitInterfaces& interfaces)
                 LOCK(cs_main);
                 if (!is_coinsview_empty) {
                     uiInterface.InitMessage(_("Verifying blocks..."));
+                    g_startup_profile.Step("block verification");
                     if (fHavePruned && gArgs.GetArg("-checkblocks", DEFAULT_CHECKBLOCKS) > MIN_BLOCKS_TO_KEEP) {
                         LogPrintf("Prune: pruned datadir may not have more than %d blocks; only checking available blocks\n",
                             MIN_BLOCKS_TO_KEEP);
@@ -1777,8 +2227,14 @@ bool AppInitMain(InitInterfaces& interfaces)
                         break;
                     }
 
-                    if (!CVerifyDB().VerifyDB(chainparams, pcoinsdbview.get(), gArgs.GetArg("-checklevel", DEFAULT_CHECKLEVEL),
-                                  gArgs.GetArg("-checkblocks", DEFAULT_CHECKBLOCKS))) {
+                    int nCheckLevel = gArgs.GetArg("-checklevel", DEFAULT_CHECKLEVEL);
+                    int nCheckDepth = gArgs.GetArg("-checkblocks", DEFAULT_CHECKBLOCKS);
+                    if (backgroundCheckMode != BackgroundCheckMode::OFF) {
+                        // A fast check only, the background check covers the rest
+                        nCheckLevel = std::min(nCheckLevel, 3);
+                        nCheckDepth = nCheckDepth <= 0 ? BACKGROUND_CHECK_STARTUP_BLOCKS : std::min(nCheckDepth, BACKGROUND_CHECK_STARTUP_BLOCKS);
+                    }
+                    if (!CVerifyDB().VerifyDB(chainparams, pcoinsdbview.get(), nCheckLevel, nCheckDepth)) {
                         strLoadError = _("Corrupted block database detected");
                         break;
                     }
@@ -1821,6 +2277,13 @@ bool AppInitMain(InitInterfaces& interfaces)
         return false;
     }
 
+    int nPrefetchBlocks = std::max(0, std::min<int>(gArgs.GetArg("-prefetchblocks", DEFAULT_PREFETCH_BLOCKS), MAX_PREFETCH_BLOCKS));
+    if (nPrefetchBlocks) {
+        LogPrintf("Reading up to %d blocks ahead during initial block download\n", nPrefetchBlocks);
+        SetContractAccessHistory(std::make_shared<ContractAccessHistory>());
+        pblockprefetcher.reset(new BlockPrefetcher(nPrefetchBlocks, pcoinsdbview.get(), globalState->diskDb(), globalState->diskDbUtxo()));
+    }
+
     fs::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
     CAutoFile est_filein(fsbridge::fopen(est_path, "rb"), SER_DISK, CLIENT_VERSION);
     // Allowed to fail as this file IS missing on first startup.
@@ -1829,12 +2292,63 @@ bool AppInitMain(InitInterfaces& interfaces)
     fFeeEstimatesInitialized = true;
 
     // ********************************************************* Step 8: start indexers
+    g_startup_profile.Step("indexers");
+    // The indexes build in the background from the block and undo files, each on its own thread
+    const bool fReindexIndexes = fReindex || gArgs.GetBoolArg("-reindex-indexes", false);
+    if (fReindexIndexes && !fReindex) {
+        LogPrintf("Rebuilding the optional indexes\n");
+    }
     if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
-        g_txindex = MakeUnique<TxIndex>(nTxIndexCache, false, fReindex);
+        g_txindex = MakeUnique<TxIndex>(nTxIndexCache, false, fReindexIndexes, gArgs.GetBoolArg("-txindex-compact", DEFAULT_TXINDEX_COMPACT));
         g_txindex->Start();
     }
 
+    // The log index database only holds its locator, the entries are in the block tree and results databases
+    if (fLogEvents) {
+        g_logindex = MakeUnique<LogIndex>(1 << 20, false, fReindexIndexes);
+        g_logindex->Start();
+    }
+
+    // The contract filters, the block stats and the contract index take the receipts of a new
+    // block from ConnectBlock, they don't depend on the log index having processed it
+    for (const auto& filter_type : g_enabled_filter_types) {
+        InitBlockFilterIndex(filter_type, filter_index_cache, false, fReindexIndexes);
+        GetBlockFilterIndex(filter_type)->Start();
+    }
+
+    if (gArgs.GetBoolArg("-blockstatsindex", DEFAULT_BLOCKSTATSINDEX)) {
+        g_blockstatsindex = MakeUnique<BlockStatsIndex>(nBlockStatsIndexCache, false, fReindexIndexes);
+        g_blockstatsindex->Start();
+    }
+
+    if (gArgs.GetBoolArg("-contractindex", DEFAULT_CONTRACTINDEX)) {
+        g_contractindex = MakeUnique<ContractIndex>(nContractIndexCache, false, fReindexIndexes);
+        g_contractindex->Start();
+    }
+
+    if (gArgs.GetBoolArg("-statediffindex", DEFAULT_STATEDIFFINDEX)) {
+        g_statediffindex = MakeUnique<StateDiffIndex>(nStateDiffIndexCache, false, fReindexIndexes);
+        g_statediffindex->Start();
+    }
+
+#ifdef ENABLE_BITCORE_RPC
+    if (gArgs.GetBoolArg("-addrindex", DEFAULT_ADDRINDEX)) {
+        g_addressindex = MakeUnique<AddressIndex>(nAddressIndexCache, false, fReindexIndexes);
+        g_addressindex->Start();
+    }
+#endif
+
+    // Registered after the indexers, so that the logs of a block are indexed before they are published
+#if ENABLE_ZMQ
+    g_zmq_notification_interface = CZMQNotificationInterface::Create();
+
+    if (g_zmq_notification_interface) {
+        RegisterValidationInterface(g_zmq_notification_interface);
+    }
+#endif
+
     // ********************************************************* Step 9: load wallet
+    g_startup_profile.Step("wallets");
     for (const auto& client : interfaces.chain_clients) {
         if (!client->load()) {
             return false;
@@ -1842,6 +2356,7 @@ bool AppInitMain(InitInterfaces& interfaces)
     }
 
     // ********************************************************* Step 10: data directory maintenance
+    g_startup_profile.Step("data directory maintenance");
 
     // if pruning, unset the service bit and perform the initial blockstore prune
     // after any wallet rescanning has taken place.
@@ -1864,6 +2379,7 @@ bool AppInitMain(InitInterfaces& interfaces)
     }
 
     // ********************************************************* Step 11: import blocks
+    g_startup_profile.Step("block import");
 
     if (!CheckDiskSpace(/* additional_bytes */ 0, /* blocks_dir */ false)) {
         InitError(strprintf(_("Error: Disk space is low for %s"), GetDataDir()));
@@ -1895,6 +2411,11 @@ bool AppInitMain(InitInterfaces& interfaces)
     if(gArgs.GetBoolArg("-cleanblockindex", DEFAULT_CLEANBLOCKINDEX))
         threadGroup.create_thread(std::bind(&CleanBlockIndex));
 
+    if (backgroundCheckMode != BackgroundCheckMode::OFF && !fReindex && !fReindexChainState) {
+        threadGroup.create_thread(std::bind(&ThreadBackgroundCheck, std::cref(chainparams), (int)gArgs.GetArg("-checklevel", DEFAULT_CHECKLEVEL),
+            (int)gArgs.GetArg("-checkblocks", DEFAULT_CHECKBLOCKS), backgroundCheckMode));
+    }
+
     // Wait for genesis block to be processed
     {
         WAIT_LOCK(g_genesis_wait_mutex, lock);
@@ -1912,6 +2433,7 @@ bool AppInitMain(InitInterfaces& interfaces)
     }
 
     // ********************************************************* Step 12: start node
+    g_startup_profile.Step("node start");
 
     int chain_active_height;
 
@@ -2004,6 +2526,7 @@ bool AppInitMain(InitInterfaces& interfaces)
         g_banman->DumpBanlist();
     }, DUMP_BANS_INTERVAL * 1000);
 
+    g_startup_profile.Log();
     return true;
 }
 
@@ -6,6 +6,7 @@
 
 #include <chain.h>
 #include <chainparams.h>
+#include <index/blockfilterindex.h>
 #include <primitives/block.h>
 #include <sync.h>
 #include <txmempool.h>
@@ -173,6 +174,26 @@ public:
         }
         return true;
     }
+    Optional<bool> blockFilterMatchesAny(const uint256& block_hash, const GCSFilter::ElementSet& elements) override
+    {
+        const CBlockIndex* index;
+        {
+            LOCK(cs_main);
+            index = LookupBlockIndex(block_hash);
+        }
+        if (!index) {
+            return nullopt;
+        }
+        // Both types have the scripts of the outputs and of the spent coins
+        for (BlockFilterType filter_type : {BlockFilterType::BASIC, BlockFilterType::CONTRACT}) {
+            const BlockFilterIndex* filter_index = GetBlockFilterIndex(filter_type);
+            BlockFilter filter;
+            if (filter_index && filter_index->LookupFilter(index, filter)) {
+                return filter.GetFilter().MatchAny(elements);
+            }
+        }
+        return nullopt;
+    }
     double guessVerificationProgress(const uint256& block_hash) override
     {
         LOCK(cs_main);
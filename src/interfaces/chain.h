@@ -5,6 +5,7 @@
 #ifndef BITCOIN_INTERFACES_CHAIN_H
 #define BITCOIN_INTERFACES_CHAIN_H
 
+#include <blockfilter.h>
 #include <optional.h>
 
 #include <memory>
@@ -127,6 +128,10 @@ public:
         int64_t* time = nullptr,
         int64_t* max_time = nullptr) = 0;
 
+    //! Return whether the filter of the block in a -blockfilterindex matches
+    //! any of the elements, or nothing if no index has the filter of the block.
+    virtual Optional<bool> blockFilterMatchesAny(const uint256& block_hash, const GCSFilter::ElementSet& elements) = 0;
+
     //! Estimate fraction of total transactions verified if blocks up to
     //! the specified block hash are verified.
     virtual double guessVerificationProgress(const uint256& block_hash) = 0;
@@ -9,10 +9,12 @@
 #include <banman.h>
 #include <chain.h>
 #include <chainparams.h>
+#include <index/logindex.h>
 #include <init.h>
 #include <interfaces/chain.h>
 #include <interfaces/handler.h>
 #include <interfaces/wallet.h>
+#include <key_io.h>
 #include <net.h>
 #include <net_processing.h>
 #include <netaddress.h>
@@ -27,6 +29,8 @@
 #include <sync.h>
 #include <txmempool.h>
 #include <ui_interface.h>
+#include <util/convert.h>
+#include <util/strencodings.h>
 #include <util/system.h>
 #include <validation.h>
 #include <warnings.h>
@@ -199,6 +203,111 @@ public:
         CBlockIndex* index = ::chainActive[blockNumber];
         return index ? index->GetBlockTime() : 0;
     }
+    std::vector<ContractCallResult> callContracts(const std::vector<ContractCall>& calls, int& block_number) override
+    {
+        std::vector<ContractCallResult> results(calls.size());
+        std::unique_ptr<ContractCallView> view;
+        {
+            LOCK(::cs_main);
+            block_number = ::chainActive.Height();
+            if (block_number < 0) {
+                return results;
+            }
+            view.reset(new ContractCallView(::chainActive.Tip()));
+        }
+
+        // One pinned state for all the calls, as callcontractbatch does
+        for (size_t i = 0; i < calls.size(); i++) {
+            const ContractCall& call = calls[i];
+            ContractCallResult& result = results[i];
+            if (call.address.size() != 40 || !IsHex(call.address) || !IsHex(call.data)) {
+                continue;
+            }
+            dev::Address address(call.address);
+            if (!view->addressInUse(address)) {
+                continue;
+            }
+            result.storage_root = h256Touint(view->storageRoot(address));
+            if (!call.storage_root.IsNull() && call.storage_root == result.storage_root) {
+                result.unchanged = true;
+                continue;
+            }
+
+            dev::Address sender;
+            CTxDestination dest = DecodeDestination(call.sender);
+            if (const CKeyID* keyid = boost::get<CKeyID>(&dest)) {
+                sender = dev::Address(HexStr(keyid->begin(), keyid->end()));
+            }
+            std::vector<ResultExecute> execResults = view->call(address, ParseHex(call.data), sender);
+            if (execResults.empty()) {
+                continue;
+            }
+            result.executed = true;
+            result.excepted = execResults[0].execRes.excepted != dev::eth::TransactionException::None;
+            result.output = HexStr(execResults[0].execRes.output);
+        }
+        return results;
+    }
+    bool searchLogs(int from_block, int to_block, const std::vector<std::string>& addresses, const std::vector<std::string>& topics,
+        size_t max_receipts, std::vector<ContractReceipt>& receipts, int& next_block) override
+    {
+        next_block = -1;
+        if (!fLogEvents) {
+            return false;
+        }
+        std::set<dev::h160> setAddresses;
+        for (const std::string& address : addresses) {
+            if (address.size() != 40 || !IsHex(address)) {
+                return false;
+            }
+            setAddresses.insert(dev::h160(address));
+        }
+        std::vector<boost::optional<dev::h256>> vTopics;
+        for (const std::string& topic : topics) {
+            if (topic.empty()) {
+                vTopics.emplace_back();
+                continue;
+            }
+            if (topic.size() != 64 || !IsHex(topic)) {
+                return false;
+            }
+            vTopics.emplace_back(dev::h256(topic));
+        }
+
+        if (g_logindex) g_logindex->BlockUntilSyncedToCurrentChain();
+
+        std::vector<TransactionReceiptInfo> results;
+        {
+            LOCK(::cs_main);
+            if (!SearchLogs(from_block, to_block, 0, setAddresses, vTopics, max_receipts, results, next_block)) {
+                return false;
+            }
+        }
+
+        receipts.reserve(receipts.size() + results.size());
+        for (const TransactionReceiptInfo& result : results) {
+            ContractReceipt receipt;
+            receipt.block_hash = result.blockHash;
+            receipt.block_number = result.blockNumber;
+            receipt.transaction_hash = result.transactionHash;
+            receipt.transaction_index = result.transactionIndex;
+            receipt.from = result.from.hex();
+            receipt.to = result.to.hex();
+            receipt.contract_address = result.contractAddress.hex();
+            receipt.gas_used = result.gasUsed;
+            for (const dev::eth::LogEntry& log : result.logs) {
+                ContractLogEntry entry;
+                entry.address = log.address.hex();
+                for (const dev::h256& topic : log.topics) {
+                    entry.topics.push_back(topic.hex());
+                }
+                entry.data = log.data;
+                receipt.logs.push_back(std::move(entry));
+            }
+            receipts.push_back(std::move(receipt));
+        }
+        return true;
+    }
     double getVerificationProgress() override
     {
         const CBlockIndex* tip;
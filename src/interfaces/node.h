@@ -9,6 +9,7 @@
 #include <amount.h>     // For CAmount
 #include <net.h>        // For CConnman::NumConnections
 #include <netaddress.h> // For Network
+#include <uint256.h>
 
 #include <functional>
 #include <memory>
@@ -31,6 +32,9 @@ struct CNodeStateStats;
 namespace interfaces {
 class Handler;
 class Wallet;
+struct ContractCall;
+struct ContractCallResult;
+struct ContractReceipt;
 
 //! Top-level interface for a bitcoin node (bitcoind process).
 class Node
@@ -147,6 +151,16 @@ public:
     //! Get block time.
     virtual int64_t getBlockTime(int blockNumber) = 0;
 
+    //! Run read-only contract calls together on the state of the tip, block_number is set to its height.
+    virtual std::vector<ContractCallResult> callContracts(const std::vector<ContractCall>& calls, int& block_number) = 0;
+
+    //! Get from the log index the receipts with logs of blocks from_block to to_block (the tip when <= 0)
+    //! of one of the addresses and with any of the topics, as searchlogs does (hex, empty for any).
+    //! They are added to receipts up to the end of the block where max_receipts of them are reached,
+    //! next_block is then set to the block to continue from, and else to -1.
+    virtual bool searchLogs(int from_block, int to_block, const std::vector<std::string>& addresses, const std::vector<std::string>& topics,
+        size_t max_receipts, std::vector<ContractReceipt>& receipts, int& next_block) = 0;
+
     //! Get verification progress.
     virtual double getVerificationProgress() = 0;
 
@@ -272,6 +286,56 @@ public:
     virtual std::unique_ptr<Handler> handleNotifyHeaderTip(NotifyHeaderTipFn fn) = 0;
 };
 
+//! Read-only contract call.
+struct ContractCall
+{
+    //! Contract address, hex
+    std::string address;
+    //! Call data, hex
+    std::string data;
+    //! Sender address
+    std::string sender;
+    //! Skip the call when the storage of the contract still has this root
+    uint256 storage_root;
+};
+
+//! Result of a read-only contract call.
+struct ContractCallResult
+{
+    bool executed = false;
+    //! The call was skipped as the storage of the contract did not change
+    bool unchanged = false;
+    bool excepted = false;
+    uint256 storage_root;
+    //! Call output, hex
+    std::string output;
+};
+
+//! Log of a contract receipt.
+struct ContractLogEntry
+{
+    //! Hex
+    std::string address;
+    //! Hex
+    std::vector<std::string> topics;
+    std::vector<unsigned char> data;
+};
+
+//! Receipt of a contract execution, from the log index.
+struct ContractReceipt
+{
+    uint256 block_hash;
+    int block_number;
+    uint256 transaction_hash;
+    uint32_t transaction_index;
+    //! Hex
+    std::string from;
+    std::string to;
+    std::string contract_address;
+    uint64_t gas_used;
+    std::vector<ContractLogEntry> logs;
+};
+
 //! Return implementation of Node interface.
 std::unique_ptr<Node> MakeNode();
 
@@ -10,6 +10,7 @@
 #include <init.h>
 #include <interfaces/chain.h>
 #include <interfaces/handler.h>
+#include <miner.h>
 #include <net.h>
 #include <policy/feerate.h>
 #include <policy/fees.h>
@@ -24,6 +25,7 @@
 #include <timedata.h>
 #include <ui_interface.h>
 #include <uint256.h>
+#include <util/convert.h>
 #include <util/system.h>
 #include <validation.h>
 #include <wallet/feebumper.h>
@@ -428,6 +430,17 @@ public:
         }
         return result;
     }
+    std::vector<WalletTx> getWalletTxsPage(const uint256& after, size_t max_count) override
+    {
+        auto locked_chain = m_wallet->chain().lock();
+        LOCK(m_wallet->cs_wallet);
+        std::vector<WalletTx> result;
+        auto it = after.IsNull() ? m_wallet->mapWallet.begin() : m_wallet->mapWallet.upper_bound(after);
+        for (; it != m_wallet->mapWallet.end() && result.size() < max_count; ++it) {
+            result.emplace_back(MakeWalletTx(*locked_chain, *m_wallet, it->second));
+        }
+        return result;
+    }
     bool tryGetTxStatus(const uint256& txid,
         interfaces::WalletTxStatus& tx_status,
         int& num_blocks,
@@ -740,6 +753,18 @@ public:
         }
         return result;
     }
+    std::vector<TokenTx> getTokenTxsPage(const uint256& after, size_t max_count) override
+    {
+        auto locked_chain = m_wallet->chain().lock();
+        LOCK(m_wallet->cs_wallet);
+
+        std::vector<TokenTx> result;
+        auto it = after.IsNull() ? m_wallet->mapTokenTx.begin() : m_wallet->mapTokenTx.upper_bound(after);
+        for (; it != m_wallet->mapTokenTx.end() && result.size() < max_count; ++it) {
+            result.emplace_back(MakeWalletTokenTx(it->second));
+        }
+        return result;
+    }
     TokenInfo getToken(const uint256& id) override
     {
         auto locked_chain = m_wallet->chain().lock();
@@ -790,6 +815,29 @@ public:
     {
         return m_wallet->IsTokenTxMine(MakeTokenTx(wtx));
     }
+    bool getTokenBalance(const std::string& contract_address, const std::string& sender_address, std::string& balance) override
+    {
+        uint256 value;
+        if (!m_wallet->GetTokenBalance(contract_address, sender_address, value)) {
+            return false;
+        }
+        balance = uintTou256(value).str();
+        return true;
+    }
+    void setTokenBalance(const std::string& contract_address, const std::string& sender_address, const std::string& balance, int64_t block_number) override
+    {
+        dev::u256 value;
+        try {
+            value = dev::u256(balance.c_str());
+        } catch (const std::exception&) {
+            return;
+        }
+        m_wallet->SetTokenBalance(contract_address, sender_address, u256Touint(value), block_number);
+    }
+    void setTokenScanned(const std::string& contract_address, const std::string& sender_address, int64_t from_block, int64_t to_block, bool other_events) override
+    {
+        m_wallet->SetTokenScanned(contract_address, sender_address, from_block, to_block, other_events);
+    }
     ContractBookData getContractBook(const std::string& id) override
     {
         LOCK(m_wallet->cs_wallet);
@@ -865,6 +913,8 @@ public:
     void setEnabledStaking(bool enabled) override
     {
         m_wallet->m_enabled_staking = enabled;
+        if (enabled)
+            WakeStakers();
     }
     bool getEnabledStaking() override
     {
@@ -178,6 +178,10 @@ public:
     //! Get list of all wallet transactions.
     virtual std::vector<WalletTx> getWalletTxs() = 0;
 
+    //! Get up to max_count wallet transactions in hash order, the ones following
+    //! the hash after or from the first one when it is null.
+    virtual std::vector<WalletTx> getWalletTxsPage(const uint256& after, size_t max_count) = 0;
+
     //! Try to get updated status for a particular transaction, if possible without blocking.
     virtual bool tryGetTxStatus(const uint256& txid,
         WalletTxStatus& tx_status,
@@ -283,6 +287,10 @@ public:
     //! Get list of all wallet token transactions.
     virtual std::vector<TokenTx> getTokenTxs() = 0;
 
+    //! Get up to max_count wallet token transactions in hash order, the ones following
+    //! the hash after or from the first one when it is null.
+    virtual std::vector<TokenTx> getTokenTxsPage(const uint256& after, size_t max_count) = 0;
+
     //! Get token information.
     virtual TokenInfo getToken(const uint256& id) = 0;
 
@@ -304,6 +312,15 @@ public:
     //! Check if token transaction is mine
     virtual bool isTokenTxMine(const TokenTx &wtx) = 0;
 
+    //! Get the balance of a token entry at the tip, if it is known without calling the contract.
+    virtual bool getTokenBalance(const std::string& contract_address, const std::string& sender_address, std::string& balance) = 0;
+
+    //! Set the balance of a token entry read with balanceOf at block_number.
+    virtual void setTokenBalance(const std::string& contract_address, const std::string& sender_address, const std::string& balance, int64_t block_number) = 0;
+
+    //! Carry the balance of a token entry forward with the events read from from_block to to_block.
+    virtual void setTokenScanned(const std::string& contract_address, const std::string& sender_address, int64_t from_block, int64_t to_block, bool other_events) = 0;
+
     //! Get contract book data.
     virtual ContractBookData getContractBook(const std::string& address) = 0;
 
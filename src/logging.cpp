@@ -4,8 +4,13 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <logging.h>
+#include <util/system.h>
 #include <util/time.h>
 
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+
 const char * const DEFAULT_DEBUGLOGFILE = "debug.log";
 const char * const DEFAULT_DEBUGVMLOGFILE = "vm.log";
 
@@ -228,6 +233,20 @@ std::string BCLog::Logger::LogTimestampStr(const std::string &str)
 void BCLog::Logger::LogPrintStr(const std::string &str, bool useVMLog)
 {
     std::string strTimestamped = LogTimestampStr(str);
+    if (m_async) {
+        m_async_loggers++;
+        if (m_async) {
+            Queue(std::move(strTimestamped), useVMLog);
+            m_async_loggers--;
+            return;
+        }
+        m_async_loggers--;
+    }
+    LogWrite(strTimestamped, useVMLog);
+}
+
+void BCLog::Logger::LogWrite(const std::string& strTimestamped, bool useVMLog)
+{
     bool print_to_console = m_print_to_console;
     if(print_to_console && useVMLog && !m_show_evm_logs) print_to_console = false;
 
@@ -240,10 +259,7 @@ void BCLog::Logger::LogPrintStr(const std::string &str, bool useVMLog)
         std::lock_guard<std::mutex> scoped_lock(m_file_mutex);
 
         //////////////////////////////// // kpg
-        FILE* file = m_fileout;
-        if(useVMLog){
-            file = m_fileoutVM;
-        }
+        FILE*& file = useVMLog ? m_fileoutVM : m_fileout;
         ////////////////////////////////
 
         // buffer if we haven't opened the log yet
@@ -273,6 +289,143 @@ void BCLog::Logger::LogPrintStr(const std::string &str, bool useVMLog)
     }
 }
 
+bool BCLog::Logger::TryQueue(std::string& str, bool useVMLog)
+{
+    size_t pos = m_ring_head.load(std::memory_order_relaxed);
+    while (true) {
+        RingSlot& slot = m_ring[pos % LOG_RING_SIZE];
+        size_t seq = slot.seq.load(std::memory_order_acquire);
+        if (seq == pos) {
+            if (m_ring_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                slot.msg = std::move(str);
+                slot.useVMLog = useVMLog;
+                slot.seq.store(pos + 1);
+                return true;
+            }
+        } else if (seq < pos) {
+            // The slot still holds the message of the previous round, the ring is full
+            return false;
+        } else {
+            pos = m_ring_head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void BCLog::Logger::Queue(std::string&& str, bool useVMLog)
+{
+    while (!TryQueue(str, useVMLog)) {
+        std::unique_lock<std::mutex> lock(m_writer_mutex);
+        m_writer_cond.notify_one();
+        m_ring_space_cond.wait_for(lock, std::chrono::milliseconds(10));
+    }
+    if (m_writer_sleeping) {
+        std::lock_guard<std::mutex> lock(m_writer_mutex);
+        m_writer_cond.notify_one();
+    }
+}
+
+size_t BCLog::Logger::WriteQueued()
+{
+    size_t nWritten = 0;
+    std::string msg;
+    while (true) {
+        RingSlot& slot = m_ring[m_ring_tail % LOG_RING_SIZE];
+        if (slot.seq.load() != m_ring_tail + 1)
+            break;
+        msg = std::move(slot.msg);
+        slot.msg.clear();
+        bool useVMLog = slot.useVMLog;
+        slot.seq.store(m_ring_tail + LOG_RING_SIZE, std::memory_order_release);
+        m_ring_tail++;
+        LogWrite(msg, useVMLog);
+        nWritten++;
+    }
+    return nWritten;
+}
+
+void BCLog::Logger::WriterThread()
+{
+    RenameThread("bitcoin-log");
+    while (true) {
+        if (WriteQueued() > 0) {
+            m_ring_space_cond.notify_all();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(m_writer_mutex);
+        if (m_writer_stop) {
+            // No logger queues after the stop, write what is left
+            lock.unlock();
+            WriteQueued();
+            return;
+        }
+        // The loggers notify after queueing if the writer sleeps, or else it sees the message here
+        m_writer_sleeping = true;
+        if (m_ring[m_ring_tail % LOG_RING_SIZE].seq.load() != m_ring_tail + 1)
+            m_writer_cond.wait_for(lock, std::chrono::milliseconds(100));
+        m_writer_sleeping = false;
+    }
+}
+
+static std::terminate_handler g_log_prev_terminate = nullptr;
+
+static void LogTerminate()
+{
+    LogInstance().StopAsync();
+    if (g_log_prev_terminate)
+        g_log_prev_terminate();
+    std::abort();
+}
+
+static void LogAtExit()
+{
+    LogInstance().StopAsync();
+}
+
+void BCLog::Logger::StartAsync()
+{
+    std::lock_guard<std::mutex> lock(m_writer_mutex);
+    if (m_async || m_writer.joinable())
+        return;
+    if (!m_ring) {
+        m_ring.reset(new RingSlot[LOG_RING_SIZE]);
+        for (size_t i = 0; i < LOG_RING_SIZE; i++) {
+            m_ring[i].seq = i;
+        }
+    }
+    m_writer_stop = false;
+    m_writer = std::thread(&BCLog::Logger::WriterThread, this);
+    m_async = true;
+
+    static std::once_flag once;
+    std::call_once(once, [] {
+        // Write the queued messages when the process ends without Shutdown
+        std::atexit(LogAtExit);
+        g_log_prev_terminate = std::set_terminate(LogTerminate);
+    });
+}
+
+void BCLog::Logger::StopAsync()
+{
+    if (!m_async.exchange(false))
+        return;
+    // Let the loggers that saw m_async finish queueing, new messages are written directly
+    while (m_async_loggers > 0) {
+        std::this_thread::yield();
+    }
+    if (std::this_thread::get_id() == m_writer.get_id()) {
+        // Stopped by a crash of the writer thread, write what it can
+        WriteQueued();
+        m_writer.detach();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_writer_mutex);
+        m_writer_stop = true;
+    }
+    m_writer_cond.notify_one();
+    m_writer.join();
+}
+
 void BCLog::Logger::ShrinkDebugFile()
 {
     // Amount of debug.log to save at end when shrinking (must fit in memory)
@@ -10,16 +10,20 @@
 #include <tinyformat.h>
 
 #include <atomic>
+#include <condition_variable>
 #include <cstdint>
 #include <list>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 static const bool DEFAULT_LOGTIMEMICROS = false;
 static const bool DEFAULT_LOGIPS        = false;
 static const bool DEFAULT_LOGTIMESTAMPS = true;
 static const bool DEFAULT_SHOWEVMLOGS   = false;
+static const bool DEFAULT_LOGASYNC      = false;
 extern const char * const DEFAULT_DEBUGLOGFILE;
 extern const char * const DEFAULT_DEBUGVMLOGFILE;
 
@@ -91,7 +95,44 @@ namespace BCLog {
 
         std::string LogTimestampStr(const std::string& str);
 
+        /** Write a timestamped message to the console and the log file */
+        void LogWrite(const std::string& str, bool useVMLog);
+
+        /**
+         * The messages for the writer thread, in a bounded queue where the loggers
+         * claim a slot with a compare-and-swap. A slot is free for the sequence number
+         * pos and holds the message of pos when its sequence number is pos + 1.
+         */
+        struct RingSlot {
+            std::atomic<size_t> seq{0};
+            std::string msg;
+            bool useVMLog{false};
+        };
+        std::unique_ptr<RingSlot[]> m_ring;
+        std::atomic<size_t> m_ring_head{0};
+        //! Only used by the writer thread
+        size_t m_ring_tail{0};
+
+        std::atomic<bool> m_async{false};
+        //! Loggers that may be queueing a message, StopAsync waits for them
+        std::atomic<int> m_async_loggers{0};
+        std::thread m_writer;
+        std::mutex m_writer_mutex;
+        std::condition_variable m_writer_cond;
+        std::condition_variable m_ring_space_cond;
+        std::atomic<bool> m_writer_sleeping{false};
+        bool m_writer_stop{false};
+
+        bool TryQueue(std::string& str, bool useVMLog);
+        void Queue(std::string&& str, bool useVMLog);
+        /** Write the queued messages, returns their number */
+        size_t WriteQueued();
+        void WriterThread();
+
     public:
+        //! Number of messages queued for the writer thread before the loggers wait
+        static const size_t LOG_RING_SIZE = 1 << 13;
+
         bool m_print_to_console = false;
         bool m_print_to_file = false;
 
@@ -112,6 +153,15 @@ namespace BCLog {
         bool OpenDebugLog();
         void ShrinkDebugFile();
 
+        /**
+         * Write the messages in a writer thread instead of on the thread that logs them,
+         * in the order they are logged. StopAsync writes the queued messages and goes back
+         * to writing them directly, it also runs at exit and on std::terminate.
+         */
+        void StartAsync();
+        void StopAsync();
+        bool IsAsync() const { return m_async; }
+
         uint32_t GetCategoryMask() const { return m_categories.load(); }
 
         void EnableCategory(LogFlags flag);
@@ -0,0 +1,187 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <mempooladdressindex.h>
+
+#include <crypto/siphash.h>
+#include <memusage.h>
+#include <random.h>
+
+#ifdef ENABLE_BITCORE_RPC
+//////////////////////////////////////////////////////// // kpg
+CMempoolAddressIndex::SaltedHasher::SaltedHasher() :
+    k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+size_t CMempoolAddressIndex::SaltedHasher::operator()(const AddressId& id) const
+{
+    return SipHashUint256Extra(k0, k1, id.addressBytes, id.type);
+}
+
+size_t CMempoolAddressIndex::SaltedHasher::operator()(const CSpentIndexKey& key) const
+{
+    return SipHashUint256Extra(k0, k1, key.txid, key.outputIndex);
+}
+
+size_t CMempoolAddressIndex::SaltedHasher::operator()(const uint256& txhash) const
+{
+    return SipHashUint256(k0, k1, txhash);
+}
+
+void CMempoolAddressIndex::AddAddressDeltas(const uint256& txhash, const std::vector<AddressDelta>& deltas)
+{
+    // Take each shard once for all the deltas of the tx in it
+    std::array<std::vector<const AddressDelta*>, MEMPOOL_ADDRESS_INDEX_SHARDS> byShard;
+    std::vector<CMempoolAddressDeltaKey> inserted;
+    inserted.reserve(deltas.size());
+    for (const AddressDelta& delta : deltas) {
+        byShard[ShardOf(AddressId{delta.first.type, delta.first.addressBytes})].push_back(&delta);
+        inserted.push_back(delta.first);
+    }
+    for (size_t i = 0; i < MEMPOOL_ADDRESS_INDEX_SHARDS; i++) {
+        if (byShard[i].empty())
+            continue;
+        AddressShard& shard = addressShards[i];
+        LOCK(shard.cs);
+        for (const AddressDelta* delta : byShard[i]) {
+            DeltaMap& map = shard.mapAddress[AddressId{delta->first.type, delta->first.addressBytes}];
+            if (map.insert(*delta).second)
+                shard.nInnerUsage += memusage::IncrementalDynamicUsage(map);
+        }
+    }
+
+    InsertedShard& shard = insertedShards[ShardOf(txhash)];
+    LOCK(shard.cs);
+    auto ret = shard.mapAddressInserted.emplace(txhash, std::move(inserted));
+    if (ret.second)
+        shard.nInnerUsage += memusage::DynamicUsage(ret.first->second);
+}
+
+void CMempoolAddressIndex::GetAddressDeltas(const std::vector<std::pair<uint256, int> >& addresses, std::vector<AddressDelta>& results) const
+{
+    for (const std::pair<uint256, int>& address : addresses) {
+        AddressId id{address.second, address.first};
+        const AddressShard& shard = addressShards[ShardOf(id)];
+        LOCK(shard.cs);
+        auto it = shard.mapAddress.find(id);
+        if (it != shard.mapAddress.end())
+            results.insert(results.end(), it->second.begin(), it->second.end());
+    }
+}
+
+void CMempoolAddressIndex::RemoveAddressDeltas(const uint256& txhash)
+{
+    std::vector<CMempoolAddressDeltaKey> keys;
+    {
+        InsertedShard& shard = insertedShards[ShardOf(txhash)];
+        LOCK(shard.cs);
+        auto it = shard.mapAddressInserted.find(txhash);
+        if (it == shard.mapAddressInserted.end())
+            return;
+        shard.nInnerUsage -= memusage::DynamicUsage(it->second);
+        keys = std::move(it->second);
+        shard.mapAddressInserted.erase(it);
+    }
+
+    for (const CMempoolAddressDeltaKey& key : keys) {
+        AddressId id{key.type, key.addressBytes};
+        AddressShard& shard = addressShards[ShardOf(id)];
+        LOCK(shard.cs);
+        auto it = shard.mapAddress.find(id);
+        if (it == shard.mapAddress.end())
+            continue;
+        if (it->second.erase(key))
+            shard.nInnerUsage -= memusage::IncrementalDynamicUsage(it->second);
+        if (it->second.empty())
+            shard.mapAddress.erase(it);
+    }
+}
+
+void CMempoolAddressIndex::AddSpent(const uint256& txhash, const std::vector<Spent>& spent)
+{
+    std::vector<CSpentIndexKey> inserted;
+    inserted.reserve(spent.size());
+    for (const Spent& entry : spent) {
+        SpentShard& shard = spentShards[ShardOf(entry.first)];
+        LOCK(shard.cs);
+        shard.mapSpent.insert(entry);
+        inserted.push_back(entry.first);
+    }
+
+    InsertedShard& shard = insertedShards[ShardOf(txhash)];
+    LOCK(shard.cs);
+    auto ret = shard.mapSpentInserted.emplace(txhash, std::move(inserted));
+    if (ret.second)
+        shard.nInnerUsage += memusage::DynamicUsage(ret.first->second);
+}
+
+bool CMempoolAddressIndex::GetSpent(const CSpentIndexKey& key, CSpentIndexValue& value) const
+{
+    const SpentShard& shard = spentShards[ShardOf(key)];
+    LOCK(shard.cs);
+    auto it = shard.mapSpent.find(key);
+    if (it == shard.mapSpent.end())
+        return false;
+    value = it->second;
+    return true;
+}
+
+void CMempoolAddressIndex::RemoveSpent(const uint256& txhash)
+{
+    std::vector<CSpentIndexKey> keys;
+    {
+        InsertedShard& shard = insertedShards[ShardOf(txhash)];
+        LOCK(shard.cs);
+        auto it = shard.mapSpentInserted.find(txhash);
+        if (it == shard.mapSpentInserted.end())
+            return;
+        shard.nInnerUsage -= memusage::DynamicUsage(it->second);
+        keys = std::move(it->second);
+        shard.mapSpentInserted.erase(it);
+    }
+
+    for (const CSpentIndexKey& key : keys) {
+        SpentShard& shard = spentShards[ShardOf(key)];
+        LOCK(shard.cs);
+        shard.mapSpent.erase(key);
+    }
+}
+
+size_t CMempoolAddressIndex::DynamicMemoryUsage() const
+{
+    size_t usage = 0;
+    for (const AddressShard& shard : addressShards) {
+        LOCK(shard.cs);
+        usage += memusage::DynamicUsage(shard.mapAddress) + shard.nInnerUsage;
+    }
+    for (const SpentShard& shard : spentShards) {
+        LOCK(shard.cs);
+        usage += memusage::DynamicUsage(shard.mapSpent);
+    }
+    for (const InsertedShard& shard : insertedShards) {
+        LOCK(shard.cs);
+        usage += memusage::DynamicUsage(shard.mapAddressInserted) + memusage::DynamicUsage(shard.mapSpentInserted) + shard.nInnerUsage;
+    }
+    return usage;
+}
+
+void CMempoolAddressIndex::Clear()
+{
+    for (AddressShard& shard : addressShards) {
+        LOCK(shard.cs);
+        shard.mapAddress.clear();
+        shard.nInnerUsage = 0;
+    }
+    for (SpentShard& shard : spentShards) {
+        LOCK(shard.cs);
+        shard.mapSpent.clear();
+    }
+    for (InsertedShard& shard : insertedShards) {
+        LOCK(shard.cs);
+        shard.mapAddressInserted.clear();
+        shard.mapSpentInserted.clear();
+        shard.nInnerUsage = 0;
+    }
+}
+////////////////////////////////////////////////////////
+#endif
@@ -0,0 +1,192 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MEMPOOLADDRESSINDEX_H
+#define MEMPOOLADDRESSINDEX_H
+
+#include <amount.h>
+#include <coins.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <array>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifdef ENABLE_BITCORE_RPC
+//////////////////////////////////////////////////////// // kpg
+struct CSpentIndexKeyCompare
+{
+    bool operator()(const CSpentIndexKey& a, const CSpentIndexKey& b) const {
+        if (a.txid == b.txid) {
+            return a.outputIndex < b.outputIndex;
+        } else {
+            return a.txid < b.txid;
+        }
+    }
+};
+
+struct CMempoolAddressDelta
+{
+    int64_t time;
+    CAmount amount;
+    uint256 prevhash;
+    unsigned int prevout;
+
+    CMempoolAddressDelta(int64_t t, CAmount a, uint256 hash, unsigned int out) {
+        time = t;
+        amount = a;
+        prevhash = hash;
+        prevout = out;
+    }
+
+    CMempoolAddressDelta(int64_t t, CAmount a) {
+        time = t;
+        amount = a;
+        prevhash.SetNull();
+        prevout = 0;
+    }
+};
+
+struct CMempoolAddressDeltaKey
+{
+    int type;
+    uint256 addressBytes;
+    uint256 txhash;
+    unsigned int index;
+    int spending;
+
+    CMempoolAddressDeltaKey(int addressType, uint256 addressHash, uint256 hash, unsigned int i, int s) {
+        type = addressType;
+        addressBytes = addressHash;
+        txhash = hash;
+        index = i;
+        spending = s;
+    }
+
+    CMempoolAddressDeltaKey(int addressType, uint256 addressHash) {
+        type = addressType;
+        addressBytes = addressHash;
+        txhash.SetNull();
+        index = 0;
+        spending = 0;
+    }
+};
+
+struct CMempoolAddressDeltaKeyCompare
+{
+    bool operator()(const CMempoolAddressDeltaKey& a, const CMempoolAddressDeltaKey& b) const {
+        if (a.type == b.type) {
+            if (a.addressBytes == b.addressBytes) {
+                if (a.txhash == b.txhash) {
+                    if (a.index == b.index) {
+                        return a.spending < b.spending;
+                    } else {
+                        return a.index < b.index;
+                    }
+                } else {
+                    return a.txhash < b.txhash;
+                }
+            } else {
+                return a.addressBytes < b.addressBytes;
+            }
+        } else {
+            return a.type < b.type;
+        }
+    }
+};
+
+/** Number of independently locked shards of each map of CMempoolAddressIndex */
+static const size_t MEMPOOL_ADDRESS_INDEX_SHARDS = 16;
+
+/**
+ * Address and spent indexes of the mempool txs, for the explorer RPCs.
+ *
+ * The maps are hash maps split in shards that each have their own lock, so that
+ * getaddressmempool and the spent lookups neither take the mempool lock nor wait for
+ * each other, and only contend with the txs being added or removed that touch the same
+ * shard. Address deltas are sharded by address and kept in key order per address,
+ * spent entries by outpoint and the keys inserted for each tx by txid. The updates of a
+ * tx are applied shard by shard, so a reader may see them on some addresses before
+ * others.
+ */
+class CMempoolAddressIndex
+{
+public:
+    typedef std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> AddressDelta;
+    typedef std::pair<CSpentIndexKey, CSpentIndexValue> Spent;
+
+    void AddAddressDeltas(const uint256& txhash, const std::vector<AddressDelta>& deltas);
+    /** Append the deltas of the given (address hash, type) pairs to results, address by address */
+    void GetAddressDeltas(const std::vector<std::pair<uint256, int> >& addresses, std::vector<AddressDelta>& results) const;
+    void RemoveAddressDeltas(const uint256& txhash);
+
+    void AddSpent(const uint256& txhash, const std::vector<Spent>& spent);
+    bool GetSpent(const CSpentIndexKey& key, CSpentIndexValue& value) const;
+    void RemoveSpent(const uint256& txhash);
+
+    size_t DynamicMemoryUsage() const;
+    void Clear();
+
+private:
+    struct AddressId
+    {
+        int type;
+        uint256 addressBytes;
+
+        bool operator==(const AddressId& other) const { return type == other.type && addressBytes == other.addressBytes; }
+    };
+
+    class SaltedHasher
+    {
+    public:
+        SaltedHasher();
+        size_t operator()(const AddressId& id) const;
+        size_t operator()(const CSpentIndexKey& key) const;
+        size_t operator()(const uint256& txhash) const;
+
+    private:
+        uint64_t k0, k1;
+    };
+
+    typedef std::map<CMempoolAddressDeltaKey, CMempoolAddressDelta, CMempoolAddressDeltaKeyCompare> DeltaMap;
+
+    struct AddressShard
+    {
+        mutable Mutex cs;
+        std::unordered_map<AddressId, DeltaMap, SaltedHasher> mapAddress GUARDED_BY(cs);
+        //! Dynamic memory usage of the delta maps
+        size_t nInnerUsage GUARDED_BY(cs) = 0;
+    };
+
+    struct SpentShard
+    {
+        mutable Mutex cs;
+        std::unordered_map<CSpentIndexKey, CSpentIndexValue, SaltedHasher> mapSpent GUARDED_BY(cs);
+    };
+
+    struct InsertedShard
+    {
+        mutable Mutex cs;
+        std::unordered_map<uint256, std::vector<CMempoolAddressDeltaKey>, SaltedHasher> mapAddressInserted GUARDED_BY(cs);
+        std::unordered_map<uint256, std::vector<CSpentIndexKey>, SaltedHasher> mapSpentInserted GUARDED_BY(cs);
+        //! Dynamic memory usage of the key vectors
+        size_t nInnerUsage GUARDED_BY(cs) = 0;
+    };
+
+    size_t ShardOf(const AddressId& id) const { return hasher(id) % MEMPOOL_ADDRESS_INDEX_SHARDS; }
+    size_t ShardOf(const CSpentIndexKey& key) const { return hasher(key) % MEMPOOL_ADDRESS_INDEX_SHARDS; }
+    size_t ShardOf(const uint256& txhash) const { return hasher(txhash) % MEMPOOL_ADDRESS_INDEX_SHARDS; }
+
+    const SaltedHasher hasher;
+    std::array<AddressShard, MEMPOOL_ADDRESS_INDEX_SHARDS> addressShards;
+    std::array<SpentShard, MEMPOOL_ADDRESS_INDEX_SHARDS> spentShards;
+    std::array<InsertedShard, MEMPOOL_ADDRESS_INDEX_SHARDS> insertedShards;
+};
+////////////////////////////////////////////////////////
+#endif
+
+#endif
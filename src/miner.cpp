@@ -21,8 +21,12 @@
 #include <pos.h>
 #include <primitives/transaction.h>
 #include <script/standard.h>
+#include <shutdown.h>
+#include <stakingstats.h>
 #include <timedata.h>
+#include <ui_interface.h>
 #include <util/convert.h>
+#include <util/memory.h>
 #include <util/moneystr.h>
 #include <util/system.h>
 #include <validationinterface.h>
@@ -34,6 +38,10 @@
 #include <queue>
 #include <utility>
 
+#include <boost/signals2/connection.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
 unsigned int nMinerSleep = STAKER_POLLING_PERIOD;
 
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev)
@@ -83,6 +91,9 @@ BlockAssembler::BlockAssembler(const CChainParams& params) : BlockAssembler(para
 void BlockAssembler::resetBlock()
 {
     inBlock.clear();
+    blockTxIndex.Clear();
+    skippedContracts.clear();
+    nTimeContracts = 0;
 
     // Reserve space for coinbase tx
     nBlockWeight = 4000;
@@ -114,6 +125,42 @@ void BlockAssembler::RebuildRefundTransaction(){
 
 Optional<int64_t> BlockAssembler::m_last_block_num_txs{nullopt};
 Optional<int64_t> BlockAssembler::m_last_block_weight{nullopt};
+Optional<std::vector<uint256>> BlockAssembler::m_last_block_skipped_contracts{nullopt};
+
+ContractCostEstimator contractCostEstimator;
+
+int64_t ContractCostEstimator::Estimate(const std::vector<QtumTransaction>& txs) const
+{
+    LOCK(cs);
+    int64_t nEstimate = 0;
+    for (const QtumTransaction& tx : txs) {
+        if (tx.isCreation())
+            continue;
+        auto it = mapCosts.find(tx.receiveAddress());
+        if (it != mapCosts.end())
+            nEstimate += it->second;
+    }
+    return nEstimate;
+}
+
+void ContractCostEstimator::Add(const std::vector<QtumTransaction>& txs, const std::vector<int64_t>& execTimes)
+{
+    LOCK(cs);
+    for (size_t i = 0; i < txs.size() && i < execTimes.size(); i++) {
+        if (txs[i].isCreation())
+            continue;
+        auto it = mapCosts.find(txs[i].receiveAddress());
+        if (it == mapCosts.end()) {
+            // Forget everything rather than tracking recency; estimates are relearnt in one execution
+            if (mapCosts.size() >= MAX_CONTRACT_COST_ENTRIES)
+                mapCosts.clear();
+            mapCosts.emplace(txs[i].receiveAddress(), execTimes[i]);
+        } else {
+            // Weight the last execution by 1/4, so a contract that became slow is noticed quickly
+            it->second = (3 * it->second + execTimes[i]) / 4;
+        }
+    }
+}
 
 std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn, bool fMineWitnessTx, bool fProofOfStake, int64_t* pTotalFees, int32_t txProofTime, int32_t nTimeLimit)
 {
@@ -178,6 +225,7 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
 
     m_last_block_num_txs = nBlockTx;
     m_last_block_weight = nBlockWeight;
+    m_last_block_skipped_contracts = skippedContracts;
 
     // Create coinbase transaction.
     CMutableTransaction coinbaseTx;
@@ -216,7 +264,8 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
 
     //////////////////////////////////////////////////////// kpg
     QtumDGP qtumDGP(globalState.get(), fGettingValuesDGP);
-    globalSealEngine->setQtumSchedule(qtumDGP.getGasSchedule(nHeight));
+    gasSchedule = qtumDGP.getSharedGasSchedule(nHeight);
+    globalSealEngine->setQtumSchedule(*gasSchedule);
     uint32_t blockSizeDGP = qtumDGP.getBlockSize(nHeight);
     minGasPrice = qtumDGP.getMinGasPrice(nHeight);
     if(gArgs.IsArgSet("-staker-min-tx-gas-price")) {
@@ -247,11 +296,89 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     RebuildRefundTransaction();
     ////////////////////////////////////////////////////////
 
+    LogPrintf("CreateNewBlock(): block weight: %u txs: %u fees: %ld sigops %d\n", GetBlockWeight(*pblock), nBlockTx, nFees, nBlockSigOpsCost);
+
+    FinalizeBlock(pindexPrev, fProofOfStake, pTotalFees);
+    int64_t nTime2 = GetTimeMicros();
+
+    LogPrint(BCLog::BENCH, "CreateNewBlock() packages: %.2fms (%d packages, %d updated descendants), validity: %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), nPackagesSelected, nDescendantsUpdated, 0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
+
+    return std::move(pblocktemplate);
+}
+
+std::unique_ptr<CBlockTemplate> BlockAssembler::UpdateBlock(std::unique_ptr<CBlockTemplate> pblocktemplateIn, int64_t* pTotalFees)
+{
+    int64_t nTimeStart = GetTimeMicros();
+
+    LOCK2(cs_main, mempool.cs);
+    CBlockIndex* pindexPrev = chainActive.Tip();
+    if (!pblocktemplateIn || pblocktemplateIn->block.hashPrevBlock != pindexPrev->GetBlockHash() || nHeight != pindexPrev->nHeight + 1)
+        return nullptr;
+
+    // The iterators of inBlock are only valid while their entries stay in the mempool, so
+    // they are looked up again; a tx that left it means the block has to be rebuilt
+    inBlock.clear();
+    for (const CTransactionRef& tx : pblocktemplateIn->block.vtx) {
+        if (tx->IsCoinBase() || tx->IsCoinStake() || tx->HasOpSpend())
+            continue;
+        CTxMemPool::txiter it = mempool.mapTx.find(tx->GetHash());
+        if (it == mempool.mapTx.end())
+            return nullptr;
+        inBlock.insert(it);
+    }
+
+    pblocktemplate = std::move(pblocktemplateIn);
+    pblock = &pblocktemplate->block;
+    nTimeLimit = 0;
+    bool fProofOfStake = pblock->IsProofOfStake();
+
+    // The witness commitment is generated again for the new transactions
+    int commitpos = GetWitnessCommitmentIndex(*pblock);
+    if (commitpos != -1) {
+        CMutableTransaction coinbaseTx(*pblock->vtx[0]);
+        coinbaseTx.vout.erase(coinbaseTx.vout.begin() + commitpos);
+        pblock->vtx[0] = MakeTransactionRef(std::move(coinbaseTx));
+    }
+
+    //////////////////////////////////////////////////////// kpg
+    QtumDGP qtumDGP(globalState.get(), fGettingValuesDGP);
+    gasSchedule = qtumDGP.getSharedGasSchedule(nHeight);
+    globalSealEngine->setQtumSchedule(*gasSchedule);
+
+    // Continue from the state left by the contracts already in the block
+    dev::h256 oldHashStateRoot(globalState->rootHash());
+    dev::h256 oldHashUTXORoot(globalState->rootHashUTXO());
+    globalState->setRoot(uintToh256(pblock->hashStateRoot));
+    globalState->setRootUTXO(uintToh256(pblock->hashUTXORoot));
+    int nPackagesSelected = 0;
+    int nDescendantsUpdated = 0;
+    addPackageTxs(nPackagesSelected, nDescendantsUpdated, minGasPrice);
+    pblock->hashStateRoot = uint256(h256Touint(dev::h256(globalState->rootHash())));
+    pblock->hashUTXORoot = uint256(h256Touint(dev::h256(globalState->rootHashUTXO())));
+    globalState->setRoot(oldHashStateRoot);
+    globalState->setRootUTXO(oldHashUTXORoot);
+
+    RebuildRefundTransaction();
+    ////////////////////////////////////////////////////////
+
+    m_last_block_num_txs = nBlockTx;
+    m_last_block_weight = nBlockWeight;
+    m_last_block_skipped_contracts = skippedContracts;
+
+    LogPrintf("UpdateBlock(): block weight: %u txs: %u fees: %ld sigops %d\n", GetBlockWeight(*pblock), nBlockTx, nFees, nBlockSigOpsCost);
+
+    FinalizeBlock(pindexPrev, fProofOfStake, pTotalFees);
+
+    LogPrint(BCLog::BENCH, "UpdateBlock() %d packages, %d updated descendants: %.2fms\n", nPackagesSelected, nDescendantsUpdated, 0.001 * (GetTimeMicros() - nTimeStart));
+
+    return std::move(pblocktemplate);
+}
+
+void BlockAssembler::FinalizeBlock(CBlockIndex* pindexPrev, bool fProofOfStake, int64_t* pTotalFees)
+{
     pblocktemplate->vchCoinbaseCommitment = GenerateCoinbaseCommitment(*pblock, pindexPrev, chainparams.GetConsensus(), fProofOfStake);
     pblocktemplate->vTxFees[0] = -nFees;
 
-    LogPrintf("CreateNewBlock(): block weight: %u txs: %u fees: %ld sigops %d\n", GetBlockWeight(*pblock), nBlockTx, nFees, nBlockSigOpsCost);
-
     // The total fee is the Fees minus the Refund
     if (pTotalFees)
         *pTotalFees = nFees - bceResult.refundSender;
@@ -265,11 +392,6 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     if (!fProofOfStake && !TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false)) {
         throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s", __func__, FormatStateMessage(state)));
     }
-    int64_t nTime2 = GetTimeMicros();
-
-    LogPrint(BCLog::BENCH, "CreateNewBlock() packages: %.2fms (%d packages, %d updated descendants), validity: %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), nPackagesSelected, nDescendantsUpdated, 0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
-
-    return std::move(pblocktemplate);
 }
 
 std::unique_ptr<CBlockTemplate> BlockAssembler::CreateEmptyBlock(const CScript& scriptPubKeyIn, bool fMineWitnessTx, bool fProofOfStake, int64_t* pTotalFees, int32_t nTime)
@@ -321,6 +443,7 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateEmptyBlock(const CScript&
 
     m_last_block_num_txs = nBlockTx;
     m_last_block_weight = nBlockWeight;
+    m_last_block_skipped_contracts = skippedContracts;
 
     // Create coinbase transaction.
     CMutableTransaction coinbaseTx;
@@ -387,15 +510,18 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateEmptyBlock(const CScript&
     return std::move(pblocktemplate);
 }
 
-void BlockAssembler::onlyUnconfirmed(CTxMemPool::setEntries& testSet)
+void BlockAssembler::CalculateUnconfirmedAncestors(CTxMemPool::txiter iter, std::vector<CTxMemPool::txiter>& ancestors) const
 {
-    for (CTxMemPool::setEntries::iterator iit = testSet.begin(); iit != testSet.end(); ) {
-        // Only test txs not already in the block
-        if (inBlock.count(*iit)) {
-            testSet.erase(iit++);
-        }
-        else {
-            iit++;
+    // The ancestors of a tx in the block are in the block as well, so the walk
+    // stops at the txs of the block
+    const CTxMemPool::EpochGuard epoch = mempool.GetFreshEpoch();
+    ancestors.clear();
+    mempool.visited(iter);
+    ancestors.push_back(iter);
+    for (size_t i = 0; i < ancestors.size(); i++) {
+        for (CTxMemPool::txiter parent : mempool.GetMemPoolParents(ancestors[i])) {
+            if (!mempool.visited(parent) && !inBlock.count(parent))
+                ancestors.push_back(parent);
         }
     }
 }
@@ -414,7 +540,7 @@ bool BlockAssembler::TestPackage(uint64_t packageSize, int64_t packageSigOpsCost
 // - transaction finality (locktime)
 // - premature witness (in case segwit transactions are added to mempool before
 //   segwit activation)
-bool BlockAssembler::TestPackageTransactions(const CTxMemPool::setEntries& package)
+bool BlockAssembler::TestPackageTransactions(const std::vector<CTxMemPool::txiter>& package)
 {
     for (CTxMemPool::txiter it : package) {
         if (!IsFinalTx(it->GetTx(), nHeight, nLockTimeCutoff))
@@ -433,6 +559,12 @@ bool BlockAssembler::AttemptToAddContractToBlock(CTxMemPool::txiter iter, uint64
     {
         return false;
     }
+    // With -mempoolpreexec, the gas used at the same tip predicts the gas limit check after execution
+    const ContractPreExecution& pre = iter->GetPreExecution();
+    bool fPreExecuted = pre.hashTip == chainActive.Tip()->GetBlockHash();
+    if (fPreExecuted && bceResult.usedGas + pre.nGasUsed > softBlockGasLimit) {
+        return false;
+    }
     
     dev::h256 oldHashStateRoot(globalState->rootHash());
     dev::h256 oldHashUTXORoot(globalState->rootHashUTXO());
@@ -441,15 +573,21 @@ bool BlockAssembler::AttemptToAddContractToBlock(CTxMemPool::txiter iter, uint64
     uint64_t nBlockSigOpsCost = this->nBlockSigOpsCost;
 
     unsigned int contractflags = GetContractScriptFlags(nHeight, chainparams.GetConsensus());
-    QtumTxConverter convert(iter->GetTx(), NULL, &pblock->vtx, contractflags);
-
-    ExtractQtumTX resultConverter;
-    if(!convert.extractionQtumTransactions(resultConverter)){
-        //this check already happens when accepting txs into mempool
-        //therefore, this can only be triggered by using raw transactions on the staker itself
-        return false;
+    // The contract txs parsed on mempool acceptance are reused when the flags did not change
+    std::shared_ptr<const ContractExtraction> extraction = iter->GetContractExtraction();
+    if (!extraction || extraction->nFlags != contractflags) {
+        // The in-block parents are found through blockTxIndex, everything else is confirmed and in the coins tip
+        QtumTxConverter convert(iter->GetTx(), pcoinsTip.get(), &blockTxIndex, contractflags);
+        std::shared_ptr<ContractExtraction> converted = std::make_shared<ContractExtraction>();
+        converted->nFlags = contractflags;
+        if(!convert.extractionQtumTransactions(converted->extracted)){
+            //this check already happens when accepting txs into mempool
+            //therefore, this can only be triggered by using raw transactions on the staker itself
+            return false;
+        }
+        extraction = converted;
     }
-    std::vector<QtumTransaction> qtumTransactions = resultConverter.first;
+    const std::vector<QtumTransaction>& qtumTransactions = extraction->extracted.first;
     dev::u256 txGas = 0;
     for(QtumTransaction qtumTransaction : qtumTransactions){
         txGas += qtumTransaction.gas();
@@ -467,17 +605,33 @@ bool BlockAssembler::AttemptToAddContractToBlock(CTxMemPool::txiter iter, uint64
             return false;
         }
     }
+    if (nTimeLimit != 0) {
+        // Skip contracts that are not expected to finish before new contracts must stop
+        int64_t nRemaining = (int64_t)(nTimeLimit - BYTECODE_TIME_BUFFER - GetAdjustedTime()) * 1000000;
+        int64_t nPredicted = fPreExecuted ? pre.nTime : contractCostEstimator.Estimate(qtumTransactions);
+        if (nPredicted > nRemaining) {
+            skippedContracts.push_back(iter->GetTx().GetHash());
+            return false;
+        }
+    }
+
     // We need to pass the DGP's block gas limit (not the soft limit) since it is consensus critical.
+    int64_t nTimeExecStart = GetTimeMicros();
     ByteCodeExec exec(*pblock, qtumTransactions, hardBlockGasLimit, chainActive.Tip());
-    if(!exec.performByteCode()){
+    bool fExecuted = exec.performByteCode();
+    contractCostEstimator.Add(qtumTransactions, exec.getExecTimes());
+    if(!fExecuted){
         //error, don't add contract
         globalState->setRoot(oldHashStateRoot);
         globalState->setRootUTXO(oldHashUTXORoot);
+        nTimeContracts += GetTimeMicros() - nTimeExecStart;
         return false;
     }
 
     ByteCodeExecResult testExecResult;
-    if(!exec.processingResults(testExecResult)){
+    bool fProcessed = exec.processingResults(testExecResult);
+    nTimeContracts += GetTimeMicros() - nTimeExecStart;
+    if(!fProcessed){
         globalState->setRoot(oldHashStateRoot);
         globalState->setRootUTXO(oldHashUTXORoot);
         return false;
@@ -529,6 +683,17 @@ bool BlockAssembler::AttemptToAddContractToBlock(CTxMemPool::txiter iter, uint64
 
     //block is not too big, so apply the contract execution and it's results to the actual block
 
+    // Keep the execution for when this node connects the block, see LocalContractExecution
+    std::shared_ptr<LocalContractExecution> local = std::make_shared<LocalContractExecution>();
+    local->SetEnvironment(*pblock, chainActive.Tip(), hardBlockGasLimit, contractflags, gasSchedule);
+    local->hashStateRootBefore = oldHashStateRoot;
+    local->hashUTXORootBefore = oldHashUTXORoot;
+    local->hashStateRootAfter = globalState->rootHash();
+    local->hashUTXORootAfter = globalState->rootHashUTXO();
+    local->result = exec.getResult();
+    local->bcer = testExecResult;
+    RecordLocalContractExecution(iter->GetTx().GetHash(), std::move(local));
+
     //apply local bytecode to global bytecode state
     bceResult.usedGas += testExecResult.usedGas;
     bceResult.refundSender += testExecResult.refundSender;
@@ -536,6 +701,7 @@ bool BlockAssembler::AttemptToAddContractToBlock(CTxMemPool::txiter iter, uint64
     bceResult.valueTransfers = std::move(testExecResult.valueTransfers);
 
     pblock->vtx.emplace_back(iter->GetSharedTx());
+    blockTxIndex.Add(pblock->vtx.back());
     pblocktemplate->vTxFees.push_back(iter->GetFee());
     pblocktemplate->vTxSigOpsCost.push_back(iter->GetSigOpCost());
     this->nBlockWeight += iter->GetTxWeight();
@@ -546,6 +712,7 @@ bool BlockAssembler::AttemptToAddContractToBlock(CTxMemPool::txiter iter, uint64
 
     for (CTransaction &t : bceResult.valueTransfers) {
         pblock->vtx.emplace_back(MakeTransactionRef(std::move(t)));
+        blockTxIndex.Add(pblock->vtx.back());
         this->nBlockWeight += GetTransactionWeight(t);
         this->nBlockSigOpsCost += GetLegacySigOpCount(t);
         ++nBlockTx;
@@ -564,6 +731,7 @@ bool BlockAssembler::AttemptToAddContractToBlock(CTxMemPool::txiter iter, uint64
 void BlockAssembler::AddToBlock(CTxMemPool::txiter iter)
 {
     pblock->vtx.emplace_back(iter->GetSharedTx());
+    blockTxIndex.Add(pblock->vtx.back());
     pblocktemplate->vTxFees.push_back(iter->GetFee());
     pblocktemplate->vTxSigOpsCost.push_back(iter->GetSigOpCost());
     nBlockWeight += iter->GetTxWeight();
@@ -580,16 +748,27 @@ void BlockAssembler::AddToBlock(CTxMemPool::txiter iter)
     }
 }
 
-int BlockAssembler::UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded,
+int BlockAssembler::UpdatePackagesForAdded(const std::vector<CTxMemPool::txiter>& alreadyAdded,
         indexed_modified_transaction_set &mapModifiedTx)
 {
     int nDescendantsUpdated = 0;
+    std::vector<CTxMemPool::txiter> descendants;
     for (CTxMemPool::txiter it : alreadyAdded) {
-        CTxMemPool::setEntries descendants;
-        mempool.CalculateDescendants(it, descendants);
+        // alreadyAdded is in the block by now, and a descendant of it can only be in the block if it is
+        // in alreadyAdded too, so inBlock tells which descendants to skip
+        const CTxMemPool::EpochGuard epoch = mempool.GetFreshEpoch();
+        descendants.clear();
+        mempool.visited(it);
+        descendants.push_back(it);
+        for (size_t i = 0; i < descendants.size(); i++) {
+            for (CTxMemPool::txiter child : mempool.GetMemPoolChildren(descendants[i])) {
+                if (!mempool.visited(child))
+                    descendants.push_back(child);
+            }
+        }
         // Insert all descendants (not yet in block) into the modified set
         for (CTxMemPool::txiter desc : descendants) {
-            if (alreadyAdded.count(desc))
+            if (inBlock.count(desc))
                 continue;
             ++nDescendantsUpdated;
             modtxiter mit = mapModifiedTx.find(desc);
@@ -622,15 +801,13 @@ bool BlockAssembler::SkipMapTxEntry(CTxMemPool::txiter it, indexed_modified_tran
     return mapModifiedTx.count(it) || inBlock.count(it) || failedTx.count(it);
 }
 
-void BlockAssembler::SortForBlock(const CTxMemPool::setEntries& package, std::vector<CTxMemPool::txiter>& sortedEntries)
+void BlockAssembler::SortForBlock(std::vector<CTxMemPool::txiter>& package)
 {
     // Sort package by ancestor count
     // If a transaction A depends on transaction B, then A's ancestor count
     // must be greater than B's.  So this is sufficient to validly order the
     // transactions for block inclusion.
-    sortedEntries.clear();
-    sortedEntries.insert(sortedEntries.begin(), package.begin(), package.end());
-    std::sort(sortedEntries.begin(), sortedEntries.end(), CompareTxIterByAncestorCount());
+    std::sort(package.begin(), package.end(), CompareTxIterByAncestorCount());
 }
 
 // This transaction selection algorithm orders the mempool based
@@ -653,7 +830,17 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
 
     // Start by adding all descendants of previously added txs to mapModifiedTx
     // and modifying them for their already included ancestors
-    UpdatePackagesForAdded(inBlock, mapModifiedTx);
+    UpdatePackagesForAdded(std::vector<CTxMemPool::txiter>(inBlock.begin(), inBlock.end()), mapModifiedTx);
+
+    // Contract txs whose gas price or gas limit can never pass AttemptToAddContractToBlock
+    // are failed upfront, and so are the packages that contain them
+    bool fDisableContracts = gArgs.GetBoolArg("-disablecontractstaking", false);
+    for (const CTxMemPoolEntry& entry : mempool.mapTx.get<gas_price>()) {
+        if (!entry.GetTx().HasCreateOrCall())
+            break;
+        if (fDisableContracts || (uint64_t)entry.GetMinGasPrice() < minGasPrice || entry.GetGasLimit() > txGasLimit)
+            failedTx.insert(mempool.mapTx.find(entry.GetTx().GetHash()));
+    }
 
     CTxMemPool::indexed_transaction_set::index<ancestor_score_or_gas_price>::type::iterator mi = mempool.mapTx.get<ancestor_score_or_gas_price>().begin();
     CTxMemPool::txiter iter;
@@ -664,6 +851,9 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
     const int64_t MAX_CONSECUTIVE_FAILURES = 1000;
     int64_t nConsecutiveFailed = 0;
 
+    // The package being considered, reused across the iterations
+    std::vector<CTxMemPool::txiter> ancestors;
+
     while (mi != mempool.mapTx.get<ancestor_score_or_gas_price>().end() || !mapModifiedTx.empty())
     {
         if(nTimeLimit != 0 && GetAdjustedTime() >= nTimeLimit){
@@ -740,13 +930,16 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
             continue;
         }
 
-        CTxMemPool::setEntries ancestors;
-        uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
-        std::string dummy;
-        mempool.CalculateMemPoolAncestors(*iter, ancestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
+        CalculateUnconfirmedAncestors(iter, ancestors);
 
-        onlyUnconfirmed(ancestors);
-        ancestors.insert(iter);
+        // A package with a contract that already failed would fail again
+        if (std::any_of(ancestors.begin(), ancestors.end(), [&failedTx](CTxMemPool::txiter it) { return failedTx.count(it) != 0; })) {
+            if (fUsingModified) {
+                mapModifiedTx.get<ancestor_score_or_gas_price>().erase(modit);
+            }
+            failedTx.insert(iter);
+            continue;
+        }
 
         // Test if all tx's are Final
         if (!TestPackageTransactions(ancestors)) {
@@ -761,8 +954,8 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
         nConsecutiveFailed = 0;
 
         // Package can be added. Sort the entries in a valid order.
-        std::vector<CTxMemPool::txiter> sortedEntries;
-        SortForBlock(ancestors, sortedEntries);
+        SortForBlock(ancestors);
+        const std::vector<CTxMemPool::txiter>& sortedEntries = ancestors;
 
         bool wasAdded=true;
         for (size_t i=0; i<sortedEntries.size(); ++i) {
@@ -778,6 +971,7 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
                 if (tx.HasCreateOrCall()) {
                     wasAdded = AttemptToAddContractToBlock(sortedEntries[i], minGasPrice);
                     if(!wasAdded){
+                        failedTx.insert(sortedEntries[i]);
                         if(fUsingModified) {
                             //this only needs to be done once to mark the whole package (everything in sortedEntries) as failed
                             mapModifiedTx.get<ancestor_score_or_gas_price>().erase(modit);
@@ -823,6 +1017,89 @@ void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned
     pblock->hashMerkleRoot = BlockMerkleRoot(*pblock);
 }
 
+StakeTemplateBuilder::StakeTemplateBuilder() : nTime(0), nTotalFees(0), fStop(false)
+{
+    thread = std::thread(&TraceThread<std::function<void()>>, "staketemplate", std::function<void()>(std::bind(&StakeTemplateBuilder::ThreadBuild, this)));
+}
+
+StakeTemplateBuilder::~StakeTemplateBuilder()
+{
+    {
+        LOCK(cs);
+        fStop = true;
+        cond.notify_all();
+    }
+    thread.join();
+}
+
+void StakeTemplateBuilder::SetScript(const CScript& scriptIn)
+{
+    LOCK(cs);
+    if (scriptTarget != scriptIn) {
+        scriptTarget = scriptIn;
+        cond.notify_one();
+    }
+}
+
+std::unique_ptr<CBlockTemplate> StakeTemplateBuilder::Get(const uint256& hashPrev, uint32_t nTimeIn, const CScript& scriptIn, int64_t& nTotalFeesRet)
+{
+    LOCK(cs);
+    if (!pblocktemplate || pblocktemplate->block.hashPrevBlock != hashPrev || nTime != nTimeIn || script != scriptIn)
+        return nullptr;
+    nTotalFeesRet = nTotalFees;
+    return MakeUnique<CBlockTemplate>(*pblocktemplate);
+}
+
+void StakeTemplateBuilder::ThreadBuild()
+{
+    while (true) {
+        CScript scriptBuild;
+        {
+            WAIT_LOCK(cs, lock);
+            cond.wait_for(lock, std::chrono::milliseconds(STAKE_TEMPLATE_POLLING_PERIOD));
+            if (fStop || ShutdownRequested())
+                return;
+            scriptBuild = scriptTarget;
+        }
+        if (scriptBuild.empty() || IsInitialBlockDownload())
+            continue;
+
+        uint32_t nTimeBuild = GetAdjustedTime() & ~STAKE_TIMESTAMP_MASK;
+        uint256 hashTip;
+        {
+            LOCK(cs_main);
+            hashTip = chainActive.Tip()->GetBlockHash();
+        }
+        {
+            LOCK(cs);
+            if (pblocktemplate && pblocktemplate->block.hashPrevBlock == hashTip && nTime == nTimeBuild && script == scriptBuild)
+                continue;
+        }
+
+        int64_t nFees = 0;
+        std::unique_ptr<CBlockTemplate> pblocktemplatenew;
+        BlockAssembler assembler(Params());
+        int64_t nTimeStart = GetTimeMicros();
+        try {
+            pblocktemplatenew = assembler.CreateNewBlock(scriptBuild, true, true, &nFees, nTimeBuild,
+                                                         GetAdjustedTime() + BYTECODE_TIME_BUFFER + STAKE_TEMPLATE_BUILD_TIME);
+        } catch (const std::runtime_error& e) {
+            LogPrint(BCLog::COINSTAKE, "StakeTemplateBuilder: %s\n", e.what());
+            continue;
+        }
+        if (!pblocktemplatenew)
+            continue;
+        stakingStats.Add(StakingStage::CREATE_BLOCK, GetTimeMicros() - nTimeStart);
+        stakingStats.Add(StakingStage::CONTRACTS, assembler.nTimeContracts);
+
+        LOCK(cs);
+        pblocktemplate = std::move(pblocktemplatenew);
+        nTime = nTimeBuild;
+        script = scriptBuild;
+        nTotalFees = nFees;
+    }
+}
+
 #ifdef ENABLE_WALLET
 //////////////////////////////////////////////////////////////////////////////
 //
@@ -872,19 +1149,89 @@ bool CheckStake(const std::shared_ptr<const CBlock> pblock, CWallet& wallet)
     return true;
 }
 
-void ThreadStakeMiner(CWallet *pwallet, CConnman* connman)
+// The stakers wait on a boost condition variable, as they are stopped with boost thread interruption
+static boost::mutex csStakerWakeup;
+static boost::condition_variable condStakerWakeup;
+static uint64_t nStakerWakeups = 0;
+
+void WakeStakers()
 {
-    SetThreadPriority(THREAD_PRIORITY_LOWEST);
+    {
+        boost::unique_lock<boost::mutex> lock(csStakerWakeup);
+        ++nStakerWakeups;
+    }
+    condStakerWakeup.notify_all();
+}
 
-    // Make this thread recognisable as the mining thread
-    std::string threadName = "kpgstake";
-    if(pwallet && pwallet->GetName() != "")
+/**
+ * Sleep for up to nMilliSeconds, or until WakeStakers is called. Wakeups since the last
+ * call with the same nWakeupsSeen end the sleep at once, so none are missed.
+ */
+static void StakerSleep(uint64_t& nWakeupsSeen, int64_t nMilliSeconds)
+{
+    boost::unique_lock<boost::mutex> lock(csStakerWakeup);
+    condStakerWakeup.wait_for(lock, boost::chrono::milliseconds(std::max<int64_t>(nMilliSeconds, 0)),
+                              [&nWakeupsSeen] { return nStakerWakeups != nWakeupsSeen; });
+    nWakeupsSeen = nStakerWakeups;
+}
+
+//! Wallets that staking was started for, with the connection waking the stakers on their unlock
+static Mutex cs_stakingWallets;
+static std::map<CWallet*, boost::signals2::scoped_connection> mapStakingWallets GUARDED_BY(cs_stakingWallets);
+static boost::thread_group* stakeThreadShared GUARDED_BY(cs_stakingWallets) = nullptr;
+
+/** A wallet taking part in a staking round, with the coins it selected */
+struct CStakingWallet
+{
+    std::shared_ptr<CWallet> pwallet;
+    //! The coins and stake data of the wallet at the tip of the round
+    std::shared_ptr<const CStakeSnapshot> snapshot;
+    std::set<std::pair<const CWalletTx*,unsigned int> > setCoins;
+    //! Range of its coins in the candidates of the round, and whether they are all there
+    size_t nCandidatesBegin = 0;
+    size_t nCandidatesEnd = 0;
+    bool fCandidatesComplete = false;
+};
+
+/** The wallets staking was started for, that are still loaded, unlocked and enabled */
+static std::vector<std::shared_ptr<CWallet>> GetStakingWallets()
+{
+    std::vector<std::shared_ptr<CWallet>> vStaking;
+    // Keep the lock out of the wallet calls, StopStake takes it with cs_main held
+    std::vector<std::shared_ptr<CWallet>> vWallets = GetWallets();
     {
-        threadName = threadName + "-" + pwallet->GetName();
+        LOCK(cs_stakingWallets);
+        for (const std::shared_ptr<CWallet>& pwallet : vWallets) {
+            if (mapStakingWallets.count(pwallet.get()))
+                vStaking.push_back(pwallet);
+        }
+    }
+    std::vector<std::shared_ptr<CWallet>> vReady;
+    for (const std::shared_ptr<CWallet>& pwallet : vStaking) {
+        if (pwallet->IsLocked() || !pwallet->m_enabled_staking)
+            pwallet->m_last_coin_stake_search_interval = 0;
+        else
+            vReady.push_back(pwallet);
     }
-    RenameThread(threadName.c_str());
+    return vReady;
+}
+
+void ThreadStakeMiner(CConnman* connman)
+{
+    SetThreadPriority(THREAD_PRIORITY_LOWEST);
+
+    // Make this thread recognisable as the mining thread
+    RenameThread("kpgstake");
+
+    StakeTemplateBuilder templateBuilder;
 
-    CReserveKey reservekey(pwallet);
+    // Woken up by new tips, peers and wallet unlocks instead of polling for them
+    uint64_t nWakeupsSeen = 0;
+    boost::signals2::scoped_connection connTip = uiInterface.NotifyBlockTip_connect([](bool fInitialDownload, const CBlockIndex*) {
+        if (!fInitialDownload)
+            WakeStakers();
+    });
+    boost::signals2::scoped_connection connPeers = uiInterface.NotifyNumConnectionsChanged_connect([](int) { WakeStakers(); });
 
     bool fTryToSync = true;
     bool regtestMode = Params().MineBlocksOnDemand();
@@ -894,83 +1241,183 @@ void ThreadStakeMiner(CWallet *pwallet, CConnman* connman)
 
     while (true)
     {
-        while (pwallet->IsLocked() || !pwallet->m_enabled_staking)
+        std::vector<std::shared_ptr<CWallet>> vWallets = GetStakingWallets();
+        if (vWallets.empty())
         {
-            pwallet->m_last_coin_stake_search_interval = 0;
-            MilliSleep(10000);
+            StakerSleep(nWakeupsSeen, 10000);
+            continue;
         }
         //don't disable PoS mining for no connections if in regtest mode
         if(!regtestMode && !gArgs.GetBoolArg("-emergencystaking", false)) {
-            while (connman->GetNodeCount(CConnman::CONNECTIONS_ALL) == 0 || IsInitialBlockDownload()) {
-                pwallet->m_last_coin_stake_search_interval = 0;
+            if (connman->GetNodeCount(CConnman::CONNECTIONS_ALL) == 0 || IsInitialBlockDownload()) {
+                for (const std::shared_ptr<CWallet>& pwallet : vWallets)
+                    pwallet->m_last_coin_stake_search_interval = 0;
                 fTryToSync = true;
-                MilliSleep(1000);
+                vWallets.clear();
+                StakerSleep(nWakeupsSeen, 10000);
+                continue;
             }
             if (fTryToSync) {
                 fTryToSync = false;
-                if (connman->GetNodeCount(CConnman::CONNECTIONS_ALL) < 3 ||
-                	chainActive.Tip()->GetBlockTime() < GetTime() - 10 * 60) {
-                    MilliSleep(60000);
-                    continue;
+                vWallets.clear();
+                // Give the node up to a minute to find more peers and a recent tip
+                int64_t nSyncDeadline = GetTimeMillis() + 60000;
+                bool fWaited = false;
+                while ((connman->GetNodeCount(CConnman::CONNECTIONS_ALL) < 3 ||
+                        chainActive.Tip()->GetBlockTime() < GetTime() - 10 * 60) && GetTimeMillis() < nSyncDeadline) {
+                    StakerSleep(nWakeupsSeen, nSyncDeadline - GetTimeMillis());
+                    fWaited = true;
                 }
+                if (fWaited)
+                    continue;
             }
         }
         //
         // Create new block
         //
-        CAmount nBalance = pwallet->GetBalance();
-        CAmount nTargetValue = nBalance - pwallet->m_reserve_balance;
-        CAmount nValueIn = 0;
-        std::set<std::pair<const CWalletTx*,unsigned int> > setCoins;
-        int64_t start = GetAdjustedTime();
+        // The wallets are only locked when the tip or their coins changed since the last round
+        std::vector<CStakingWallet> vStakers;
+        for (const std::shared_ptr<CWallet>& pwallet : vWallets)
         {
-            auto locked_chain = pwallet->chain().lock();
-            pwallet->SelectCoinsForStaking(*locked_chain, nTargetValue, setCoins, nValueIn);
+            CStakingWallet staker;
+            staker.pwallet = pwallet;
+            {
+                auto locked_chain = pwallet->chain().lock();
+                staker.snapshot = pwallet->GetStakeSnapshot(*locked_chain);
+            }
+            staker.setCoins = staker.snapshot->setCoins;
+            if (staker.setCoins.size() > 0)
+                vStakers.push_back(std::move(staker));
         }
-        if(setCoins.size() > 0)
+        if(vStakers.size() > 0)
         {
             int64_t nTotalFees = 0;
-            // First just create an empty block. No need to process transactions until we know we can create a block
-            std::unique_ptr<CBlockTemplate> pblocktemplate(BlockAssembler(Params()).CreateEmptyBlock(reservekey.reserveScript, true, true, &nTotalFees));
+            // First just create an empty block. No need to process transactions until we know we can create a block.
+            // The coinstake output is only a placeholder until SignBlock, so one block serves every wallet.
+            std::unique_ptr<CBlockTemplate> pblocktemplate(BlockAssembler(Params()).CreateEmptyBlock(CScript(), true, true, &nTotalFees));
             if (!pblocktemplate.get())
                 return;
             CBlockIndex* pindexPrev =  chainActive.Tip();
 
+            // Start over if a block arrived since the coins were selected, their stake data is for the previous tip
+            bool fStale = false;
+            for (const CStakingWallet& staker : vStakers)
+                fStale |= staker.snapshot->hashTip != pindexPrev->GetBlockHash();
+            if (fStale)
+                continue;
+
+            // The kernel is searched for among the coins of all the wallets, on all cores, before any block is signed
+            std::vector<CStakeCandidate> vCandidates;
+            bool fCandidatesComplete = true;
+            for (CStakingWallet& staker : vStakers)
+            {
+                staker.fCandidatesComplete = staker.snapshot->fCandidatesComplete;
+                fCandidatesComplete &= staker.fCandidatesComplete;
+                staker.nCandidatesBegin = vCandidates.size();
+                vCandidates.insert(vCandidates.end(), staker.snapshot->candidates.begin(), staker.snapshot->candidates.end());
+                staker.nCandidatesEnd = vCandidates.size();
+            }
+
+            // Outcomes of the kernels found, for getstakinginfo and -zmqpubstakingevent
+            int64_t nTimeSlotStart = 0;
+            auto addEvent = [&](StakingEventType type, const uint256& hashBlock, uint32_t nTime) {
+                stakingStats.AddEvent(StakingEvent{type, pindexPrev->GetBlockHash(), hashBlock, nTime, GetTimeMicros() - nTimeSlotStart});
+            };
+
             uint32_t beginningTime=GetAdjustedTime();
             beginningTime &= ~STAKE_TIMESTAMP_MASK;
             for(uint32_t i=beginningTime;i<beginningTime + MAX_STAKE_LOOKAHEAD;i+=STAKE_TIMESTAMP_MASK+1) {
 
-                // The information is needed for status bar to determine if the staker is trying to create block and when it will be created approximately,
-                if(pwallet->m_last_coin_stake_search_time == 0) pwallet->m_last_coin_stake_search_time = GetAdjustedTime(); // startup timestamp
-                // nLastCoinStakeSearchInterval > 0 mean that the staker is running
-                pwallet->m_last_coin_stake_search_interval = i - pwallet->m_last_coin_stake_search_time;
+                for (CStakingWallet& staker : vStakers)
+                {
+                    // The information is needed for status bar to determine if the staker is trying to create block and when it will be created approximately,
+                    if(staker.pwallet->m_last_coin_stake_search_time == 0) staker.pwallet->m_last_coin_stake_search_time = GetAdjustedTime(); // startup timestamp
+                    // nLastCoinStakeSearchInterval > 0 mean that the staker is running
+                    staker.pwallet->m_last_coin_stake_search_interval = i - staker.pwallet->m_last_coin_stake_search_time;
+                }
+
+                // Find the kernel coin, if any, then only try that one when signing, with the
+                // wallet it belongs to. Coins the search could not cover are tried by SignBlock
+                // as before, in each wallet that has some.
+                nTimeSlotStart = GetTimeMicros();
+                size_t nKernel = 0;
+                bool fKernel = FindStakeKernel(pindexPrev, pblocktemplate->block.nBits, i, vCandidates, GetNumCores(), nKernel);
+                // The search stops at the first kernel, so the candidates after it count as not evaluated
+                int64_t nTimeSearched = GetTimeMicros();
+                stakingStats.AddSlot(fKernel ? nKernel + 1 : vCandidates.size(), nTimeSearched - nTimeSlotStart);
+                if (!fKernel && fCandidatesComplete)
+                    continue;
+                const COutPoint* pprevoutKernel = nullptr;
+                CStakingWallet* pstaker = nullptr;
+                std::shared_ptr<CBlock> pblock;
 
                 // Try to sign a block (this also checks for a PoS stake)
                 pblocktemplate->block.nTime = i;
-                std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>(pblocktemplate->block);
-                if (SignBlock(pblock, *pwallet, nTotalFees, i, setCoins)) {
+                if (fKernel) {
+                    for (CStakingWallet& staker : vStakers) {
+                        if (nKernel >= staker.nCandidatesBegin && nKernel < staker.nCandidatesEnd) {
+                            pprevoutKernel = &vCandidates[nKernel].prevout;
+                            pblock = std::make_shared<CBlock>(pblocktemplate->block);
+                            if (SignBlock(pblock, *staker.pwallet, nTotalFees, i, staker.setCoins, pprevoutKernel)) {
+                                pstaker = &staker;
+                            } else {
+                                // The kernel was found with cached stake data that CheckKernel rejects, so
+                                // let it look through all the coins
+                                pprevoutKernel = nullptr;
+                                staker.fCandidatesComplete = false;
+                            }
+                            break;
+                        }
+                    }
+                }
+                for (CStakingWallet& staker : vStakers) {
+                    if (pstaker)
+                        break;
+                    if (staker.fCandidatesComplete)
+                        continue;
+                    pblock = std::make_shared<CBlock>(pblocktemplate->block);
+                    if (SignBlock(pblock, *staker.pwallet, nTotalFees, i, staker.setCoins))
+                        pstaker = &staker;
+                }
+                if (pstaker) {
+                    CWallet* pwallet = pstaker->pwallet.get();
+                    stakingStats.Add(StakingStage::SIGN, GetTimeMicros() - nTimeSearched);
+
                     // increase priority so we can build the full PoS block ASAP to ensure the timestamp doesn't expire
                     SetThreadPriority(THREAD_PRIORITY_ABOVE_NORMAL);
 
                     if (chainActive.Tip()->GetBlockHash() != pblock->hashPrevBlock) {
                         //another block was received while building ours, scrap progress
                         LogPrintf("ThreadStakeMiner(): Valid future PoS block was orphaned before becoming valid");
+                        addEvent(StakingEventType::ORPHANED, uint256(), i);
                         break;
                     }
-                    // Create a block that's properly populated with transactions
-                    std::unique_ptr<CBlockTemplate> pblocktemplatefilled(
-                            BlockAssembler(Params()).CreateNewBlock(pblock->vtx[1]->vout[1].scriptPubKey, true, true, &nTotalFees,
-                                                                    i, FutureDrift(GetAdjustedTime()) - STAKE_TIME_BUFFER));
-                    if (!pblocktemplatefilled.get())
-                        return;
+                    // Create a block that's properly populated with transactions, unless one
+                    // was already built in the background
+                    const CScript& scriptCoinStake = pblock->vtx[1]->vout[1].scriptPubKey;
+                    templateBuilder.SetScript(scriptCoinStake);
+                    std::unique_ptr<CBlockTemplate> pblocktemplatefilled = templateBuilder.Get(pblock->hashPrevBlock, i, scriptCoinStake, nTotalFees);
+                    if (!pblocktemplatefilled) {
+                        BlockAssembler assembler(Params());
+                        int64_t nTimeCreate = GetTimeMicros();
+                        pblocktemplatefilled = assembler.CreateNewBlock(scriptCoinStake, true, true, &nTotalFees,
+                                                                        i, FutureDrift(GetAdjustedTime()) - STAKE_TIME_BUFFER);
+                        if (!pblocktemplatefilled.get())
+                            return;
+                        stakingStats.Add(StakingStage::CREATE_BLOCK, GetTimeMicros() - nTimeCreate);
+                        stakingStats.Add(StakingStage::CONTRACTS, assembler.nTimeContracts);
+                    }
                     if (chainActive.Tip()->GetBlockHash() != pblock->hashPrevBlock) {
                         //another block was received while building ours, scrap progress
                         LogPrintf("ThreadStakeMiner(): Valid future PoS block was orphaned before becoming valid");
+                        addEvent(StakingEventType::ORPHANED, uint256(), i);
                         break;
                     }
                     // Sign the full block and use the timestamp from earlier for a valid stake
                     std::shared_ptr<CBlock> pblockfilled = std::make_shared<CBlock>(pblocktemplatefilled->block);
-                    if (SignBlock(pblockfilled, *pwallet, nTotalFees, i, setCoins)) {
+                    if (SignBlock(pblockfilled, *pwallet, nTotalFees, i, pstaker->setCoins, pprevoutKernel)) {
+                        stakingStats.Add(StakingStage::SLOT_TO_SIGNED, GetTimeMicros() - nTimeSlotStart);
+                        addEvent(StakingEventType::SIGNED, pblockfilled->GetHash(), i);
                         // Should always reach here unless we spent too much time processing transactions and the timestamp is now invalid
                         // CheckStake also does CheckBlock and AcceptBlock to propogate it to the network
                         bool validBlock = false;
@@ -978,12 +1425,14 @@ void ThreadStakeMiner(CWallet *pwallet, CConnman* connman)
                             if (chainActive.Tip()->GetBlockHash() != pblockfilled->hashPrevBlock) {
                                 //another block was received while building ours, scrap progress
                                 LogPrintf("ThreadStakeMiner(): Valid future PoS block was orphaned before becoming valid");
+                                addEvent(StakingEventType::ORPHANED, pblockfilled->GetHash(), i);
                                 break;
                             }
                             //check timestamps
                             if (pblockfilled->GetBlockTime() <= pindexPrev->GetBlockTime() ||
                                 FutureDrift(pblockfilled->GetBlockTime()) < pindexPrev->GetBlockTime()) {
                                 LogPrintf("ThreadStakeMiner(): Valid PoS block took too long to create and has expired");
+                                addEvent(StakingEventType::EXPIRED, pblockfilled->GetHash(), i);
                                 break; //timestamp too late, so ignore
                             }
                             if (pblockfilled->GetBlockTime() > FutureDrift(GetAdjustedTime())) {
@@ -993,15 +1442,16 @@ void ThreadStakeMiner(CWallet *pwallet, CConnman* connman)
                                     //or receiving more stale/orphan blocks than normal. Use at your own risk.
                                     MilliSleep(100);
                                 }else{
-                                    //too early, so wait 3 seconds and try again
-                                    MilliSleep(3000);
+                                    //too early, so wait until it is valid or a new tip arrives
+                                    StakerSleep(nWakeupsSeen, (pblockfilled->GetBlockTime() - FutureDrift(GetAdjustedTime())) * 1000);
                                 }
                                 continue;
                             }
                             validBlock=true;
                         }
                         if(validBlock) {
-                            CheckStake(pblockfilled, *pwallet);
+                            bool fAccepted = CheckStake(pblockfilled, *pwallet);
+                            addEvent(fAccepted ? StakingEventType::ACCEPTED : StakingEventType::REJECTED, pblockfilled->GetHash(), i);
                             // Update the search time when new valid block is created, needed for status bar icon
                             pwallet->m_last_coin_stake_search_time = pblockfilled->GetBlockTime();
                         }
@@ -1012,23 +1462,40 @@ void ThreadStakeMiner(CWallet *pwallet, CConnman* connman)
                 }
             }
         }
-        MilliSleep(nMinerSleep);
+        // Do not keep the wallets from being unloaded while sleeping
+        vStakers.clear();
+        vWallets.clear();
+        if (regtestMode) {
+            MilliSleep(nMinerSleep);
+        } else {
+            // Nothing changes for the search before the next timestamp slot, unless a new tip arrives
+            int64_t nNextSlot = (GetAdjustedTime() | STAKE_TIMESTAMP_MASK) + 1;
+            StakerSleep(nWakeupsSeen, (nNextSlot - GetAdjustedTime()) * 1000 - GetTimeMillis() % 1000);
+        }
     }
 }
 
 void StakeQtums(bool fStake, CWallet *pwallet, CConnman* connman, boost::thread_group*& stakeThread)
 {
-    if (stakeThread != nullptr)
+    // All the wallets share one staking thread, started with the first of them and stopped with the last
+    LOCK(cs_stakingWallets);
+    if(fStake)
+        mapStakingWallets[pwallet] = pwallet->NotifyStatusChanged.connect([](CCryptoKeyStore*) { WakeStakers(); });
+    else
+        mapStakingWallets.erase(pwallet);
+
+    if (mapStakingWallets.empty() && stakeThreadShared != nullptr)
     {
-        stakeThread->interrupt_all();
-        delete stakeThread;
-        stakeThread = nullptr;
+        stakeThreadShared->interrupt_all();
+        delete stakeThreadShared;
+        stakeThreadShared = nullptr;
     }
-
-    if(fStake)
+    else if (!mapStakingWallets.empty() && stakeThreadShared == nullptr)
     {
-        stakeThread = new boost::thread_group();
-        stakeThread->create_thread(boost::bind(&ThreadStakeMiner, pwallet, connman));
+        stakeThreadShared = new boost::thread_group();
+        stakeThreadShared->create_thread(boost::bind(&ThreadStakeMiner, connman));
     }
+    stakeThread = fStake ? stakeThreadShared : nullptr;
+    WakeStakers();
 }
 #endif
@@ -11,7 +11,10 @@
 #include <txmempool.h>
 #include <validation.h>
 
+#include <condition_variable>
 #include <memory>
+#include <thread>
+#include <unordered_map>
 #include <stdint.h>
 
 #include <boost/multi_index_container.hpp>
@@ -51,6 +54,41 @@ static const int32_t STAKER_POLLING_PERIOD = 5000;
 //How much time to spend trying to process transactions when using the generate RPC call
 static const int32_t POW_MINER_MAX_TIME = 60;
 
+//How often the stake template builder checks for a new tip or timestamp slot, in milliseconds
+static const int32_t STAKE_TEMPLATE_POLLING_PERIOD = 500;
+
+//How many seconds the stake template builder may spend executing contracts, as it holds cs_main
+static const int32_t STAKE_TEMPLATE_BUILD_TIME = 2;
+
+//Number of contracts whose execution time is tracked for block assembly
+static const size_t MAX_CONTRACT_COST_ENTRIES = 10000;
+
+/**
+ * Wall time estimates of contract calls, learnt from the executions of block assembly.
+ *
+ * The assembler stops adding contracts BYTECODE_TIME_BUFFER seconds before its time
+ * limit, but that check is made before an execution, so one slow contract can still
+ * overrun the window of a stake. With an estimate per called contract, candidates
+ * predicted not to finish in the remaining time are skipped instead. Contracts never
+ * seen (including creations) are estimated at zero, so they are always tried once.
+ */
+class ContractCostEstimator
+{
+public:
+    /** Estimated microseconds needed to execute txs */
+    int64_t Estimate(const std::vector<QtumTransaction>& txs) const;
+
+    /** Learn from the measured execution times of txs, as reported by ByteCodeExec */
+    void Add(const std::vector<QtumTransaction>& txs, const std::vector<int64_t>& execTimes);
+
+private:
+    mutable CCriticalSection cs;
+    //! Exponentially weighted moving average of the microseconds per call
+    std::unordered_map<dev::Address, int64_t> mapCosts GUARDED_BY(cs);
+};
+
+extern ContractCostEstimator contractCostEstimator;
+
 struct CBlockTemplate
 {
     CBlock block;
@@ -59,6 +97,45 @@ struct CBlockTemplate
     std::vector<unsigned char> vchCoinbaseCommitment;
 };
 
+/**
+ * Proof-of-stake block templates filled with transactions ahead of a won timestamp.
+ *
+ * Once a kernel is found the staker still has to fill the block, executing the contracts
+ * of the mempool, and the block can be orphaned or its timestamp missed in the meantime.
+ * A background thread keeps a filled template for the tip and the current timestamp
+ * slot, paying to the coinstake script the staker last signed with. Contract results
+ * depend on the time and author of the block, so the template is only used for that
+ * same tip, slot and script; the staker fills the block itself otherwise. Transactions
+ * that reach the mempool after the build are left for the next block.
+ */
+class StakeTemplateBuilder
+{
+public:
+    StakeTemplateBuilder();
+    ~StakeTemplateBuilder();
+
+    /** Build the next templates for coinstakes paying to script */
+    void SetScript(const CScript& script);
+
+    /** A copy of the template built on hashPrev for nTime and script, nullptr if there is none */
+    std::unique_ptr<CBlockTemplate> Get(const uint256& hashPrev, uint32_t nTime, const CScript& script, int64_t& nTotalFeesRet);
+
+private:
+    void ThreadBuild();
+
+    Mutex cs;
+    std::condition_variable cond;
+    CScript scriptTarget GUARDED_BY(cs);
+    //! The last template built, with the time and script it was built for
+    std::unique_ptr<CBlockTemplate> pblocktemplate GUARDED_BY(cs);
+    uint32_t nTime GUARDED_BY(cs);
+    CScript script GUARDED_BY(cs);
+    int64_t nTotalFees GUARDED_BY(cs);
+    bool fStop GUARDED_BY(cs);
+
+    std::thread thread;
+};
+
 // Container for tracking updates to ancestor feerate as we include (parent)
 // transactions in a block
 struct CTxMemPoolModifiedEntry {
@@ -227,6 +304,10 @@ private:
     uint64_t nBlockSigOpsCost;
     CAmount nFees;
     CTxMemPool::setEntries inBlock;
+    // Transactions already in pblock, for resolving senders of zero-confirmation spends
+    CBlockTxIndex blockTxIndex;
+    // Contract transactions skipped because they were predicted to overrun nTimeLimit
+    std::vector<uint256> skippedContracts;
 
     // Chain context for the block
     int nHeight;
@@ -249,6 +330,10 @@ public:
     uint64_t hardBlockGasLimit;
     uint64_t softBlockGasLimit;
     uint64_t txGasLimit;
+    //! Gas schedule of the block, kept with the contract executions for ConnectBlock
+    std::shared_ptr<const dev::eth::EVMSchedule> gasSchedule;
+    //! Time spent executing contracts for the block, in microseconds
+    int64_t nTimeContracts;
 /////////////////////////////////////////////
 
     // The original constructed reward tx (either coinbase or coinstake) without gas refund adjustments
@@ -259,10 +344,19 @@ public:
 
     /** Construct a new block template with coinbase to scriptPubKeyIn */
     std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn, bool fMineWitnessTx=true, bool fProofOfStake=false, int64_t* pTotalFees = 0, int32_t nTime=0, int32_t nTimeLimit=0);
+    /**
+     * Add the mempool packages that are not in the block yet to a template this assembler
+     * built with CreateNewBlock, or updated before, continuing from the contract state the
+     * block already has. Returns nullptr if the tip changed or a tx of the block left the
+     * mempool, in which case the block has to be created anew.
+     */
+    std::unique_ptr<CBlockTemplate> UpdateBlock(std::unique_ptr<CBlockTemplate> pblocktemplateIn, int64_t* pTotalFees = 0);
     std::unique_ptr<CBlockTemplate> CreateEmptyBlock(const CScript& scriptPubKeyIn, bool fMineWitnessTx=true, bool fProofOfStake=false, int64_t* pTotalFees = 0, int32_t nTime=0);
 
     static Optional<int64_t> m_last_block_num_txs;
     static Optional<int64_t> m_last_block_weight;
+    //! Contract transactions of the last assembled block skipped as too slow for the remaining time
+    static Optional<std::vector<uint256>> m_last_block_skipped_contracts;
 
 private:
     // utility functions
@@ -270,6 +364,8 @@ private:
     void resetBlock();
     /** Add a tx to the block */
     void AddToBlock(CTxMemPool::txiter iter);
+    /** Fill in the witness commitment, the reward fees and the header, and test the validity of PoW blocks */
+    void FinalizeBlock(CBlockIndex* pindexPrev, bool fProofOfStake, int64_t* pTotalFees);
 
     bool AttemptToAddContractToBlock(CTxMemPool::txiter iter, uint64_t minGasPrice);
 
@@ -282,29 +378,31 @@ private:
     /** Rebuild the coinbase/coinstake transaction to account for new gas refunds **/
     void RebuildRefundTransaction();
     // helper functions for addPackageTxs()
-    /** Remove confirmed (inBlock) entries from given set */
-    void onlyUnconfirmed(CTxMemPool::setEntries& testSet);
+    /** Set ancestors to iter and its in-mempool ancestors that are not inBlock */
+    void CalculateUnconfirmedAncestors(CTxMemPool::txiter iter, std::vector<CTxMemPool::txiter>& ancestors) const EXCLUSIVE_LOCKS_REQUIRED(mempool.cs);
     /** Test if a new package would "fit" in the block */
     bool TestPackage(uint64_t packageSize, int64_t packageSigOpsCost) const;
     /** Perform checks on each transaction in a package:
       * locktime, premature-witness, serialized size (if necessary)
       * These checks should always succeed, and they're here
       * only as an extra check in case of suboptimal node configuration */
-    bool TestPackageTransactions(const CTxMemPool::setEntries& package);
+    bool TestPackageTransactions(const std::vector<CTxMemPool::txiter>& package);
     /** Return true if given transaction from mapTx has already been evaluated,
       * or if the transaction's cached data in mapTx is incorrect. */
     bool SkipMapTxEntry(CTxMemPool::txiter it, indexed_modified_transaction_set &mapModifiedTx, CTxMemPool::setEntries &failedTx) EXCLUSIVE_LOCKS_REQUIRED(mempool.cs);
     /** Sort the package in an order that is valid to appear in a block */
-    void SortForBlock(const CTxMemPool::setEntries& package, std::vector<CTxMemPool::txiter>& sortedEntries);
+    void SortForBlock(std::vector<CTxMemPool::txiter>& package);
     /** Add descendants of given transactions to mapModifiedTx with ancestor
       * state updated assuming given transactions are inBlock. Returns number
       * of updated descendants. */
-    int UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded, indexed_modified_transaction_set &mapModifiedTx) EXCLUSIVE_LOCKS_REQUIRED(mempool.cs);
+    int UpdatePackagesForAdded(const std::vector<CTxMemPool::txiter>& alreadyAdded, indexed_modified_transaction_set &mapModifiedTx) EXCLUSIVE_LOCKS_REQUIRED(mempool.cs);
 };
 
 #ifdef ENABLE_WALLET
 /** Generate a new block, without valid proof-of-work */
 void StakeQtums(bool fStake, CWallet *pwallet, CConnman* connman, boost::thread_group*& stakeThread);
+/** Wake the stakers up, for example when staking is enabled */
+void WakeStakers();
 #endif
 
 /** Modify the extranonce in a block */
@@ -31,6 +31,13 @@
 #include <poll.h>
 #endif
 
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#elif defined(USE_KQUEUE)
+#include <sys/event.h>
+#endif
+
 #ifdef USE_UPNP
 #include <miniupnpc/miniupnpc.h>
 #include <miniupnpc/miniwget.h>
@@ -70,6 +77,11 @@ enum BindFlags {
 // The sleep time needs to be small to avoid new sockets stalling
 static const uint64_t SELECT_TIMEOUT_MILLISECONDS = 50;
 
+#if defined(USE_EPOLL) || defined(USE_KQUEUE)
+/** Most socket events taken from the queue per wait, the others are left for the next one */
+static const int MAX_SOCKET_EVENTS = 1024;
+#endif
+
 const std::string NET_MESSAGE_COMMAND_OTHER = "*other*";
 
 static const uint64_t RANDOMIZER_ID_NETGROUP = 0x6c0edd8036ef4036ULL; // SHA256("netgroup")[0:8]
@@ -526,6 +538,10 @@ void CNode::copyStats(CNodeStats &stats)
         X(mapRecvBytesPerMsgCmd);
         X(nRecvBytes);
     }
+    {
+        LOCK(cs_msgStats);
+        X(mapMsgStats);
+    }
     X(fWhitelisted);
     {
         LOCK(cs_feeFilter);
@@ -566,7 +582,7 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete
         // get current incomplete message, or create a new one
         if (vRecvMsg.empty() ||
             vRecvMsg.back().complete())
-            vRecvMsg.push_back(CNetMessage(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION));
+            vRecvMsg.emplace_back(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION);
 
         CNetMessage& msg = vRecvMsg.back();
 
@@ -632,6 +648,68 @@ int CNode::GetSendVersion() const
 }
 
 
+CNetRecvBufferPool g_net_recv_buffers;
+
+CSerializeData CNetRecvBufferPool::Acquire(size_t nSize)
+{
+    size_t nClass = 0;
+    while (nClass + 1 < CLASS_COUNT && ClassSize(nClass) < nSize)
+        nClass++;
+    CSerializeData buffer;
+    {
+        LOCK(m_mutex);
+        if (!m_free[nClass].empty()) {
+            buffer = std::move(m_free[nClass].back());
+            m_free[nClass].pop_back();
+            return buffer;
+        }
+    }
+    buffer.reserve(ClassSize(nClass));
+    return buffer;
+}
+
+void CNetRecvBufferPool::Release(CSerializeData&& buffer)
+{
+    const size_t nCapacity = buffer.capacity();
+    if (nCapacity < MIN_CLASS_SIZE || nCapacity > 2 * MAX_CLASS_SIZE)
+        return;
+    // The largest class whose size the buffer can hold
+    size_t nClass = CLASS_COUNT - 1;
+    while (nClass > 0 && ClassSize(nClass) > nCapacity)
+        nClass--;
+    buffer.clear();
+    LOCK(m_mutex);
+    if (m_free[nClass].size() < CLASS_BYTES / ClassSize(nClass))
+        m_free[nClass].push_back(std::move(buffer));
+}
+
+size_t CNetRecvBufferPool::Count() const
+{
+    LOCK(m_mutex);
+    size_t nCount = 0;
+    for (const std::vector<CSerializeData>& buffers : m_free)
+        nCount += buffers.size();
+    return nCount;
+}
+
+size_t CNetRecvBufferPool::Bytes() const
+{
+    LOCK(m_mutex);
+    size_t nBytes = 0;
+    for (const std::vector<CSerializeData>& buffers : m_free) {
+        for (const CSerializeData& buffer : buffers)
+            nBytes += buffer.capacity();
+    }
+    return nBytes;
+}
+
+CNetMessage::~CNetMessage()
+{
+    CSerializeData buffer;
+    vRecv.SwapBuffer(buffer);
+    g_net_recv_buffers.Release(std::move(buffer));
+}
+
 int CNetMessage::readHeader(const char *pch, unsigned int nBytes)
 {
     // copy data to temporary parsing buffer
@@ -657,6 +735,12 @@ int CNetMessage::readHeader(const char *pch, unsigned int nBytes)
     if (hdr.nMessageSize > MAX_SIZE)
         return -1;
 
+    // read the payload into a pooled buffer of the right size class
+    if (hdr.nMessageSize > 0) {
+        CSerializeData buffer = g_net_recv_buffers.Acquire(hdr.nMessageSize);
+        vRecv.SwapBuffer(buffer);
+    }
+
     // switch state to reading message data
     in_data = true;
 
@@ -1083,10 +1167,12 @@ void CConnman::InactivityCheck(CNode *pnode)
     }
 }
 
-bool CConnman::GenerateSelectSet(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set)
+bool CConnman::GenerateSelectSet(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set,
+                                 std::map<SOCKET, NodeId>* socket_owners)
 {
     for (const ListenSocket& hListenSocket : vhListenSocket) {
         recv_set.insert(hListenSocket.socket);
+        if (socket_owners) (*socket_owners)[hListenSocket.socket] = -1;
     }
 
     {
@@ -1116,6 +1202,7 @@ bool CConnman::GenerateSelectSet(std::set<SOCKET> &recv_set, std::set<SOCKET> &s
                 continue;
 
             error_set.insert(pnode->hSocket);
+            if (socket_owners) (*socket_owners)[pnode->hSocket] = pnode->GetId();
             if (select_send) {
                 send_set.insert(pnode->hSocket);
                 continue;
@@ -1129,7 +1216,175 @@ bool CConnman::GenerateSelectSet(std::set<SOCKET> &recv_set, std::set<SOCKET> &s
     return !recv_set.empty() || !send_set.empty() || !error_set.empty();
 }
 
-#ifdef USE_POLL
+void CConnman::WakeSocketHandler()
+{
+#if defined(USE_EPOLL)
+    if (m_socket_event_wakeup >= 0) {
+        const uint64_t one = 1;
+        if (write(m_socket_event_wakeup, &one, sizeof(one)) < 0) {
+            // The counter is already set, the socket handler wakes up anyway
+        }
+    }
+#elif defined(USE_KQUEUE)
+    if (m_socket_event_queue >= 0) {
+        struct kevent change;
+        EV_SET(&change, 0, EVFILT_USER, 0, NOTE_TRIGGER, 0, nullptr);
+        kevent(m_socket_event_queue, &change, 1, nullptr, 0, nullptr);
+    }
+#endif
+}
+
+#if defined(USE_EPOLL) || defined(USE_KQUEUE)
+bool CConnman::InitSocketEventQueue()
+{
+#ifdef USE_EPOLL
+    m_socket_event_queue = epoll_create1(EPOLL_CLOEXEC);
+    if (m_socket_event_queue < 0)
+        return false;
+    m_socket_event_wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_socket_event_wakeup < 0)
+        return false;
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = m_socket_event_wakeup;
+    return epoll_ctl(m_socket_event_queue, EPOLL_CTL_ADD, m_socket_event_wakeup, &event) == 0;
+#else
+    m_socket_event_queue = kqueue();
+    if (m_socket_event_queue < 0)
+        return false;
+    struct kevent change;
+    EV_SET(&change, 0, EVFILT_USER, EV_ADD | EV_CLEAR, 0, 0, nullptr);
+    return kevent(m_socket_event_queue, &change, 1, nullptr, 0, nullptr) == 0;
+#endif
+}
+
+void CConnman::CloseSocketEventQueue()
+{
+#ifdef USE_EPOLL
+    if (m_socket_event_wakeup >= 0)
+        close(m_socket_event_wakeup);
+    m_socket_event_wakeup = -1;
+#endif
+    if (m_socket_event_queue >= 0)
+        close(m_socket_event_queue);
+    m_socket_event_queue = -1;
+    m_socket_registrations.clear();
+}
+
+void CConnman::UpdateSocketRegistrations(const std::set<SOCKET> &recv_set, const std::set<SOCKET> &send_set,
+                                         const std::map<SOCKET, NodeId> &socket_owners)
+{
+    // Only the registrations that change are passed to the kernel. The queue drops the ones
+    // of closed sockets by itself, a descriptor reused by another node is registered again.
+    for (auto it = m_socket_registrations.begin(); it != m_socket_registrations.end();) {
+        auto owner = socket_owners.find(it->first);
+        if (owner != socket_owners.end() && owner->second == it->second.owner) {
+            ++it;
+            continue;
+        }
+        // Errors are expected here, for the sockets that were closed
+#ifdef USE_EPOLL
+        epoll_ctl(m_socket_event_queue, EPOLL_CTL_DEL, it->first, nullptr);
+#else
+        struct kevent change;
+        if (it->second.recv) {
+            EV_SET(&change, it->first, EVFILT_READ, EV_DELETE, 0, 0, nullptr);
+            kevent(m_socket_event_queue, &change, 1, nullptr, 0, nullptr);
+        }
+        if (it->second.send) {
+            EV_SET(&change, it->first, EVFILT_WRITE, EV_DELETE, 0, 0, nullptr);
+            kevent(m_socket_event_queue, &change, 1, nullptr, 0, nullptr);
+        }
+#endif
+        it = m_socket_registrations.erase(it);
+    }
+
+    for (const auto& owner : socket_owners) {
+        const SOCKET socket = owner.first;
+        const SocketRegistration wanted{owner.second, recv_set.count(socket) > 0, send_set.count(socket) > 0};
+        auto it = m_socket_registrations.find(socket);
+        if (it != m_socket_registrations.end() && it->second.recv == wanted.recv && it->second.send == wanted.send)
+            continue;
+#ifdef USE_EPOLL
+        // Sockets with no events are still registered, epoll reports their errors and hangups
+        struct epoll_event event = {};
+        event.events = (wanted.recv ? EPOLLIN : 0) | (wanted.send ? EPOLLOUT : 0);
+        event.data.fd = socket;
+        const bool ok = epoll_ctl(m_socket_event_queue, it == m_socket_registrations.end() ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, socket, &event) == 0;
+#else
+        struct kevent changes[2];
+        int nchanges = 0;
+        const bool registered_recv = it != m_socket_registrations.end() && it->second.recv;
+        const bool registered_send = it != m_socket_registrations.end() && it->second.send;
+        if (wanted.recv != registered_recv)
+            EV_SET(&changes[nchanges++], socket, EVFILT_READ, wanted.recv ? EV_ADD : EV_DELETE, 0, 0, nullptr);
+        if (wanted.send != registered_send)
+            EV_SET(&changes[nchanges++], socket, EVFILT_WRITE, wanted.send ? EV_ADD : EV_DELETE, 0, 0, nullptr);
+        const bool ok = nchanges == 0 || kevent(m_socket_event_queue, changes, nchanges, nullptr, 0, nullptr) == 0;
+#endif
+        if (!ok) {
+            LogPrint(BCLog::NET, "socket event registration error %s\n", NetworkErrorString(WSAGetLastError()));
+            if (it != m_socket_registrations.end())
+                m_socket_registrations.erase(it);
+            continue;
+        }
+        m_socket_registrations[socket] = wanted;
+    }
+}
+
+void CConnman::SocketEvents(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set)
+{
+    std::set<SOCKET> recv_select_set, send_select_set, error_select_set;
+    std::map<SOCKET, NodeId> socket_owners;
+    GenerateSelectSet(recv_select_set, send_select_set, error_select_set, &socket_owners);
+    UpdateSocketRegistrations(recv_select_set, send_select_set, socket_owners);
+
+    // The wait also ends on WakeSocketHandler, the timeout is for the periodic work of the
+    // socket handler loop
+#ifdef USE_EPOLL
+    std::vector<struct epoll_event> events(MAX_SOCKET_EVENTS);
+    int nEvents = epoll_wait(m_socket_event_queue, events.data(), events.size(), SELECT_TIMEOUT_MILLISECONDS);
+#else
+    std::vector<struct kevent> events(MAX_SOCKET_EVENTS);
+    struct timespec timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_nsec = SELECT_TIMEOUT_MILLISECONDS * 1000 * 1000;
+    int nEvents = kevent(m_socket_event_queue, nullptr, 0, events.data(), events.size(), &timeout);
+#endif
+
+    if (interruptNet) return;
+
+    if (nEvents < 0) {
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEINTR)
+            LogPrintf("socket event queue error %s\n", NetworkErrorString(nErr));
+        return;
+    }
+
+    for (int i = 0; i < nEvents; i++) {
+#ifdef USE_EPOLL
+        const SOCKET socket = events[i].data.fd;
+        if (socket == m_socket_event_wakeup) {
+            uint64_t count;
+            if (read(m_socket_event_wakeup, &count, sizeof(count)) < 0) {
+                // Reset by an earlier read
+            }
+            continue;
+        }
+        if (events[i].events & EPOLLIN)                recv_set.insert(socket);
+        if (events[i].events & EPOLLOUT)               send_set.insert(socket);
+        if (events[i].events & (EPOLLERR | EPOLLHUP))  error_set.insert(socket);
+#else
+        if (events[i].filter == EVFILT_USER)
+            continue;
+        const SOCKET socket = events[i].ident;
+        if (events[i].filter == EVFILT_READ)           recv_set.insert(socket);
+        if (events[i].filter == EVFILT_WRITE)          send_set.insert(socket);
+        if (events[i].flags & (EV_EOF | EV_ERROR))     error_set.insert(socket);
+#endif
+    }
+}
+#elif defined(USE_POLL)
 void CConnman::SocketEvents(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set)
 {
     std::set<SOCKET> recv_select_set, send_select_set, error_select_set;
@@ -1729,6 +1984,16 @@ void CConnman::ThreadOpenConnections(const std::vector<std::string> connect)
                 }
             }
         }
+        // The connections still being set up will take their slots and groups
+        std::set<CAddress> setConnecting;
+        {
+            LOCK(cs_pending_connects);
+            for (const CAddress& addr : m_connecting) {
+                setConnected.insert(addr.GetGroup());
+                setConnecting.insert(addr);
+                nOutbound++;
+            }
+        }
 
         // Feeler Connections
         //
@@ -1777,6 +2042,9 @@ void CConnman::ThreadOpenConnections(const std::vector<std::string> connect)
                 break;
             }
 
+            if (setConnecting.count(addr))
+                continue;
+
             // If we didn't find an appropriate destination after trying 100 addresses fetched from addrman,
             // stop this loop, and let the outer loop run again (which sleeps, adds seed nodes, recalculates
             // already-connected network ranges, ...) before trying new addrman addresses.
@@ -1818,11 +2086,40 @@ void CConnman::ThreadOpenConnections(const std::vector<std::string> connect)
                 LogPrint(BCLog::NET, "Making feeler connection to %s\n", addrConnect.ToString());
             }
 
-            OpenNetworkConnection(addrConnect, (int)setConnected.size() >= std::min(nMaxConnections - 1, 2), &grant, nullptr, false, fFeeler);
+            std::unique_ptr<PendingConnect> pending(new PendingConnect());
+            pending->addr = addrConnect;
+            pending->fCountFailure = (int)setConnected.size() >= std::min(nMaxConnections - 1, 2);
+            pending->fFeeler = fFeeler;
+            grant.MoveTo(pending->grant);
+            LOCK(cs_pending_connects);
+            m_connecting.push_back(addrConnect);
+            m_pending_connects.push_back(std::move(pending));
+            cond_pending_connects.notify_one();
         }
     }
 }
 
+void CConnman::ThreadConnect()
+{
+    while (true) {
+        std::unique_ptr<PendingConnect> pending;
+        {
+            WAIT_LOCK(cs_pending_connects, lock);
+            cond_pending_connects.wait(lock, [this] { return interruptNet || !m_pending_connects.empty(); });
+            if (interruptNet)
+                return;
+            pending = std::move(m_pending_connects.front());
+            m_pending_connects.pop_front();
+        }
+
+        OpenNetworkConnection(pending->addr, pending->fCountFailure, &pending->grant, nullptr, false, pending->fFeeler);
+
+        // Connected or not, the node is in vNodes or the slot is released with the grant
+        LOCK(cs_pending_connects);
+        m_connecting.erase(std::find(m_connecting.begin(), m_connecting.end(), pending->addr));
+    }
+}
+
 std::vector<AddedNodeInfo> CConnman::GetAddedNodeInfo()
 {
     std::vector<AddedNodeInfo> ret;
@@ -2133,6 +2430,7 @@ void CConnman::SetNetworkActive(bool active)
 
 CConnman::CConnman(uint64_t nSeed0In, uint64_t nSeed1In) : nSeed0(nSeed0In), nSeed1(nSeed1In)
 {
+    RegisterLockStats(&cs_vNodes, "cs_vNodes");
     SetTryNewOutboundPeer(false);
 
     Options connOptions;
@@ -2246,6 +2544,18 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
         fMsgProcWake = false;
     }
 
+#if defined(USE_EPOLL) || defined(USE_KQUEUE)
+    if (!InitSocketEventQueue()) {
+        LogPrintf("Failed to create the socket event queue: %s\n", NetworkErrorString(WSAGetLastError()));
+        if (clientInterface) {
+            clientInterface->ThreadSafeMessageBox(
+                _("Failed to create the socket event queue."),
+                "", CClientUIInterface::MSG_ERROR);
+        }
+        return false;
+    }
+#endif
+
     // Send and receive from sockets, accept connections
     threadSocketHandler = std::thread(&TraceThread<std::function<void()> >, "net", std::function<void()>(std::bind(&CConnman::ThreadSocketHandler, this)));
 
@@ -2267,6 +2577,10 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
     }
     if (connOptions.m_use_addrman_outgoing || !connOptions.m_specified_outgoing.empty())
         threadOpenConnections = std::thread(&TraceThread<std::function<void()> >, "opencon", std::function<void()>(std::bind(&CConnman::ThreadOpenConnections, this, connOptions.m_specified_outgoing)));
+    if (connOptions.m_use_addrman_outgoing) {
+        for (int i = 0; i < MAX_CONCURRENT_CONNECTS; i++)
+            threadConnect.emplace_back(&TraceThread<std::function<void()> >, "connect", std::function<void()>(std::bind(&CConnman::ThreadConnect, this)));
+    }
 
     // Process messages
     threadMessageHandler = std::thread(&TraceThread<std::function<void()> >, "msghand", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this)));
@@ -2301,6 +2615,11 @@ void CConnman::Interrupt()
     condMsgProc.notify_all();
 
     interruptNet();
+    {
+        LOCK(cs_pending_connects);
+        cond_pending_connects.notify_all();
+    }
+    WakeSocketHandler();
     InterruptSocks5(true);
 
     if (semOutbound) {
@@ -2322,6 +2641,15 @@ void CConnman::Stop()
         threadMessageHandler.join();
     if (threadOpenConnections.joinable())
         threadOpenConnections.join();
+    for (std::thread& thread : threadConnect)
+        thread.join();
+    threadConnect.clear();
+    {
+        // Release the outbound slots of the connections that were not set up
+        LOCK(cs_pending_connects);
+        m_pending_connects.clear();
+        m_connecting.clear();
+    }
     if (threadOpenAddedConnections.joinable())
         threadOpenAddedConnections.join();
     if (threadDNSAddressSeed.joinable())
@@ -2355,6 +2683,9 @@ void CConnman::Stop()
     vhListenSocket.clear();
     semOutbound.reset();
     semAddnode.reset();
+#if defined(USE_EPOLL) || defined(USE_KQUEUE)
+    CloseSocketEventQueue();
+#endif
 }
 
 void CConnman::DeleteNode(CNode* pnode)
@@ -2704,6 +3035,7 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
     CVectorWriter{SER_NETWORK, INIT_PROTO_VERSION, serializedHeader, 0, hdr};
 
     size_t nBytesSent = 0;
+    bool fSendPending = false;
     {
         LOCK(pnode->cs_vSend);
         bool optimisticSend(pnode->vSendMsg.empty());
@@ -2719,11 +3051,16 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
             pnode->vSendMsg.push_back(std::move(msg.data));
 
         // If write queue empty, attempt "optimistic write"
-        if (optimisticSend == true)
+        if (optimisticSend == true) {
             nBytesSent = SocketSendData(pnode);
+            fSendPending = !pnode->vSendMsg.empty();
+        }
     }
     if (nBytesSent)
         RecordBytesSent(nBytesSent);
+    // The rest is sent once the socket handler waits for the socket to be writable
+    if (fSendPending)
+        WakeSocketHandler();
 }
 
 bool CConnman::ForNode(NodeId id, std::function<bool(CNode* pnode)> func)
@@ -22,6 +22,7 @@
 #include <sync.h>
 #include <uint256.h>
 #include <threadinterrupt.h>
+#include <validationstats.h>
 
 #include <atomic>
 #include <deque>
@@ -59,6 +60,8 @@ static const unsigned int MAX_SUBVERSION_LENGTH = 256;
 static const int MAX_OUTBOUND_CONNECTIONS = 8;
 /** Maximum number of addnode outgoing nodes */
 static const int MAX_ADDNODE_CONNECTIONS = 8;
+/** Number of automatic outgoing connections set up at the same time */
+static const int MAX_CONCURRENT_CONNECTS = 8;
 /** -listen default */
 static const bool DEFAULT_LISTEN = true;
 /** -upnp default */
@@ -310,6 +313,10 @@ public:
 
     void WakeMessageHandler();
 
+    /** Wake the socket handler from waiting on the socket event queue, so that it picks up
+     *  a change of the events its sockets are selected for right away */
+    void WakeSocketHandler();
+
     /** Attempts to obfuscate tx time through exponentially distributed emitting.
         Works assuming that a single interval is used.
         Variable intervals will result in privacy decrease.
@@ -331,13 +338,22 @@ private:
     void AddOneShot(const std::string& strDest);
     void ProcessOneShot();
     void ThreadOpenConnections(std::vector<std::string> connect);
+    /** Set up the connections ThreadOpenConnections picked, several at a time */
+    void ThreadConnect();
     void ThreadMessageHandler();
     void AcceptConnection(const ListenSocket& hListenSocket);
     void DisconnectNodes();
     void NotifyNumConnectionsChanged();
     void InactivityCheck(CNode *pnode);
-    bool GenerateSelectSet(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set);
+    bool GenerateSelectSet(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set,
+                           std::map<SOCKET, NodeId>* socket_owners = nullptr);
     void SocketEvents(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set);
+#if defined(USE_EPOLL) || defined(USE_KQUEUE)
+    bool InitSocketEventQueue();
+    void CloseSocketEventQueue();
+    void UpdateSocketRegistrations(const std::set<SOCKET> &recv_set, const std::set<SOCKET> &send_set,
+                                   const std::map<SOCKET, NodeId> &socket_owners);
+#endif
     void SocketHandler();
     void ThreadSocketHandler();
     void ThreadDNSAddressSeed();
@@ -430,12 +446,49 @@ private:
 
     CThreadInterrupt interruptNet;
 
+#if defined(USE_EPOLL) || defined(USE_KQUEUE)
+    /** Events a socket is registered for in the socket event queue, and the node it
+     *  belongs to (-1 for the listening sockets), to tell a reused descriptor apart */
+    struct SocketRegistration {
+        NodeId owner;
+        bool recv;
+        bool send;
+    };
+    /** epoll or kqueue descriptor the socket handler waits on */
+    int m_socket_event_queue{-1};
+#ifdef USE_EPOLL
+    /** eventfd registered in the queue to wake the socket handler */
+    int m_socket_event_wakeup{-1};
+#endif
+    /** Registrations of the socket event queue, only used by the socket handler thread */
+    std::map<SOCKET, SocketRegistration> m_socket_registrations;
+#endif
+
     std::thread threadDNSAddressSeed;
     std::thread threadSocketHandler;
     std::thread threadOpenAddedConnections;
     std::thread threadOpenConnections;
+    std::vector<std::thread> threadConnect;
     std::thread threadMessageHandler;
 
+    /** An outgoing connection picked by ThreadOpenConnections, holding its outbound slot */
+    struct PendingConnect {
+        CAddress addr;
+        bool fCountFailure;
+        bool fFeeler;
+        CSemaphoreGrant grant;
+    };
+    /**
+     * Connection setup, including the SOCKS5 handshake through Tor or a proxy, blocks for up
+     * to the connect timeout. The connections are handed to the ThreadConnect threads so
+     * that one slow or dead address does not hold up filling the other outbound slots.
+     */
+    Mutex cs_pending_connects;
+    std::condition_variable cond_pending_connects;
+    std::deque<std::unique_ptr<PendingConnect>> m_pending_connects GUARDED_BY(cs_pending_connects);
+    //! Addresses queued or being connected to, counted as outbound peers by ThreadOpenConnections
+    std::vector<CAddress> m_connecting GUARDED_BY(cs_pending_connects);
+
     /** flag for deciding to connect to an extra outbound peer,
      *  in excess of nMaxOutbound
      *  This takes the place of a feeler connection */
@@ -541,6 +594,22 @@ extern std::map<CNetAddr, LocalServiceInfo> mapLocalHost GUARDED_BY(cs_mapLocalH
 extern const std::string NET_MESSAGE_COMMAND_OTHER;
 typedef std::map<std::string, uint64_t> mapMsgCmdSize; //command, total bytes
 
+/** Processing of the messages of one type by ProcessMessage */
+struct NetMsgStats
+{
+    uint64_t nBytes = 0;   //!< Size of the messages, headers included
+    StageTimes times;      //!< Time spent in ProcessMessage
+    int64_t nMainHeld = 0; //!< Time cs_main was held by ProcessMessage, in microseconds
+
+    void Add(uint64_t nMsgBytes, int64_t nMicros, int64_t nMainMicros)
+    {
+        nBytes += nMsgBytes;
+        times.Add(nMicros);
+        nMainHeld += nMainMicros;
+    }
+};
+typedef std::map<std::string, NetMsgStats> mapMsgCmdStats; //command, processing
+
 class CNodeStats
 {
 public:
@@ -561,6 +630,7 @@ public:
     mapMsgCmdSize mapSendBytesPerMsgCmd;
     uint64_t nRecvBytes;
     mapMsgCmdSize mapRecvBytesPerMsgCmd;
+    mapMsgCmdStats mapMsgStats;
     bool fWhitelisted;
     double dPingTime;
     double dPingWait;
@@ -577,6 +647,40 @@ public:
 
 
 
+/**
+ * Free buffers for the payloads of received messages, kept by size class so that the
+ * buffer of a processed message is reused by the next message of about the same size
+ * instead of going back to the allocator. Each class holds at most
+ * CLASS_BYTES worth of buffers, and buffers grown past twice the largest class
+ * are freed.
+ */
+class CNetRecvBufferPool
+{
+public:
+    //! Capacity of the smallest and of the largest size class, in bytes
+    static constexpr size_t MIN_CLASS_SIZE = 1024;
+    static constexpr size_t MAX_CLASS_SIZE = 256 * 1024;
+    static constexpr size_t CLASS_COUNT = 5;
+    static constexpr size_t CLASS_BYTES = 4 * 1024 * 1024;
+
+    /** A cleared buffer with room for at least min(nSize, MAX_CLASS_SIZE) bytes */
+    CSerializeData Acquire(size_t nSize);
+    /** Give a buffer back to the pool, or free it when its class is full */
+    void Release(CSerializeData&& buffer);
+
+    /** Number of buffers and bytes held by the pool */
+    size_t Count() const;
+    size_t Bytes() const;
+
+private:
+    static size_t ClassSize(size_t nClass) { return MIN_CLASS_SIZE << (2 * nClass); }
+
+    mutable Mutex m_mutex;
+    std::vector<CSerializeData> m_free[CLASS_COUNT] GUARDED_BY(m_mutex);
+};
+
+extern CNetRecvBufferPool g_net_recv_buffers;
+
 class CNetMessage {
 private:
     mutable CHash256 hasher;
@@ -601,6 +705,8 @@ public:
         nTime = 0;
     }
 
+    ~CNetMessage();
+
     bool complete() const
     {
         if (!in_data)
@@ -689,6 +795,10 @@ public:
     std::atomic_bool fPauseRecv{false};
     std::atomic_bool fPauseSend{false};
 
+    CCriticalSection cs_msgStats;
+    //! Processing of the messages received, recorded by the message handler
+    mapMsgCmdStats mapMsgStats GUARDED_BY(cs_msgStats);
+
 protected:
     mapMsgCmdSize mapSendBytesPerMsgCmd;
     mapMsgCmdSize mapRecvBytesPerMsgCmd GUARDED_BY(cs_vRecv);
@@ -706,7 +816,7 @@ public:
     int64_t nNextLocalAddrSend GUARDED_BY(cs_sendProcessing){0};
 
     // inventory based relay
-    CRollingBloomFilter filterInventoryKnown GUARDED_BY(cs_inventory);
+    CBlockedRollingBloomFilter filterInventoryKnown GUARDED_BY(cs_inventory);
     // Set of transaction ids we still have to announce.
     // They are sorted by the mempool before relay, so the order is not important.
     std::set<uint256> setInventoryTxToSend;
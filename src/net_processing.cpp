@@ -9,6 +9,7 @@
 #include <banman.h>
 #include <arith_uint256.h>
 #include <blockencodings.h>
+#include <blockserve.h>
 #include <chainparams.h>
 #include <consensus/validation.h>
 #include <hash.h>
@@ -25,16 +26,21 @@
 #include <scheduler.h>
 #include <tinyformat.h>
 #include <txmempool.h>
+#include <txpreverify.h>
 #include <ui_interface.h>
 #include <util/system.h>
 #include <util/moneystr.h>
 #include <util/strencodings.h>
+#include <validationtimes.h>
 #include <checkpoints.h>
 #include <clientversion.h>
 #include <consensus/merkle.h>
 #include <shutdown.h>
 
+#include <algorithm>
 #include <memory>
+#include <set>
+#include <unordered_map>
 
 #if defined(NDEBUG)
 # error "KPG cannot be compiled without assertions."
@@ -105,6 +111,14 @@ static const unsigned int INVENTORY_BROADCAST_INTERVAL = 5;
 /** Maximum number of inventory items to send per transmission.
  *  Limits the impact of low-fee transaction floods. */
 static constexpr unsigned int INVENTORY_BROADCAST_MAX = 7 * INVENTORY_BROADCAST_INTERVAL;
+/** Minimum delay between rebuilds of the mempool order shared by the inventory trickles, in microseconds.
+ *  Transactions that entered the mempool since the last rebuild are sent after the others. */
+static constexpr int64_t INVENTORY_RELAY_ORDER_INTERVAL = 1000000;
+/** Number of new proof-of-stake headers a peer can have us check at once outside of initial block
+ *  download, where each costs a signature recovery and a stake lookup. */
+static const int64_t MAX_POS_HEADER_BUDGET = 2 * MAX_HEADERS_RESULTS;
+/** Number of new proof-of-stake headers per second a peer gets back of its budget. */
+static const int64_t POS_HEADER_BUDGET_RATE = 1;
 /** Average delay between feefilter broadcasts in seconds. */
 static constexpr unsigned int AVG_FEEFILTER_BROADCAST_INTERVAL = 10 * 60;
 /** Maximum feefilter broadcast delay after significant change. */
@@ -140,9 +154,9 @@ namespace {
      * million to make it highly unlikely for users to have issues with this
      * filter.
      *
-     * Memory used: 1.3 MB
+     * Memory used: 0.9 MB
      */
-    std::unique_ptr<CRollingBloomFilter> recentRejects GUARDED_BY(cs_main);
+    std::unique_ptr<CBlockedRollingBloomFilter> recentRejects GUARDED_BY(cs_main);
     uint256 hashRecentRejectsChainTip GUARDED_BY(cs_main);
 
     /** Blocks that are in flight, and that are in the queue to be downloaded. */
@@ -327,6 +341,10 @@ struct CNodeState {
     int64_t nDownloadingSince;
     int nBlocksInFlight;
     int nBlocksInFlightValidHeaders;
+    //! Smoothed time (in microseconds) this peer takes to deliver the first entry in vBlocksInFlight, or 0.
+    int64_t m_block_delivery_time;
+    //! How many blocks may be in flight from this peer, sized from its delivery and ping times.
+    int m_blocks_in_flight_limit;
     //! Whether we consider this a preferred download peer.
     bool fPreferredDownload;
     //! Whether this peer wants invs or headers (when possible) for block announcements.
@@ -379,6 +397,10 @@ struct CNodeState {
     //! Time of last new block announcement
     int64_t m_last_block_announcement;
 
+    //! New proof-of-stake headers this peer can still have us check, and when it was last updated
+    int64_t m_pos_header_budget;
+    int64_t m_pos_header_budget_time;
+
     CNodeState(CAddress addrIn, std::string addrNameIn) : address(addrIn), name(addrNameIn) {
         fCurrentlyConnected = false;
         nMisbehavior = 0;
@@ -394,6 +416,8 @@ struct CNodeState {
         nDownloadingSince = 0;
         nBlocksInFlight = 0;
         nBlocksInFlightValidHeaders = 0;
+        m_block_delivery_time = 0;
+        m_blocks_in_flight_limit = MAX_BLOCKS_IN_TRANSIT_PER_PEER;
         fPreferredDownload = false;
         fPreferHeaders = false;
         fPreferHeaderAndIDs = false;
@@ -403,6 +427,8 @@ struct CNodeState {
         fSupportsDesiredCmpctVersion = false;
         m_chain_sync = { 0, nullptr, false, false };
         m_last_block_announcement = 0;
+        m_pos_header_budget = MAX_POS_HEADER_BUDGET;
+        m_pos_header_budget_time = 0;
     }
 };
 
@@ -544,6 +570,53 @@ static bool MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const CBlock
     return true;
 }
 
+/** Update the delivery time of a peer with a block it sent, if it is the first one in flight from it.
+ *  The others were queued behind it, so the time since they were asked for is not what they took. */
+static void UpdateBlockDeliveryTime(NodeId nodeid, const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+    std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(hash);
+    if (itInFlight == mapBlocksInFlight.end() || itInFlight->second.first != nodeid)
+        return;
+    CNodeState *state = State(nodeid);
+    assert(state != nullptr);
+    if (state->vBlocksInFlight.begin() != itInFlight->second.second)
+        return;
+    int64_t nDeliveryTime = std::max<int64_t>(GetTimeMicros() - state->nDownloadingSince, 1);
+    if (state->m_block_delivery_time == 0) {
+        state->m_block_delivery_time = nDeliveryTime;
+    } else {
+        state->m_block_delivery_time = (3 * state->m_block_delivery_time + nDeliveryTime) / 4;
+    }
+}
+
+/** Number of blocks to keep in flight from a peer: enough to cover twice its round trip at the rate it
+ *  delivers them, between MAX_BLOCKS_IN_TRANSIT_PER_PEER and MAX_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER. */
+static int GetBlocksInFlightLimit(const CNodeState& state, int64_t nPingUsecTime) {
+    if (state.m_block_delivery_time == 0 || nPingUsecTime == std::numeric_limits<int64_t>::max())
+        return MAX_BLOCKS_IN_TRANSIT_PER_PEER;
+    int64_t nLimit = 2 * nPingUsecTime / state.m_block_delivery_time + 1;
+    return std::max<int64_t>(MAX_BLOCKS_IN_TRANSIT_PER_PEER, std::min<int64_t>(nLimit, MAX_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER));
+}
+
+/** Stop waiting for the blocks queued behind the first one in flight from a stalling peer, so that
+ *  the other peers can be asked for them. Returns how many were released. */
+static int ReleaseQueuedBlocks(NodeId nodeid) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+    CNodeState *state = State(nodeid);
+    assert(state != nullptr);
+    if (state->vBlocksInFlight.size() <= 1)
+        return 0;
+
+    std::vector<uint256> vRelease;
+    for (std::list<QueuedBlock>::const_iterator it = std::next(state->vBlocksInFlight.begin()); it != state->vBlocksInFlight.end(); ++it) {
+        // Compact blocks are reconstructed with the peer that announced them
+        if (!it->partialBlock)
+            vRelease.push_back(it->hash);
+    }
+    for (const uint256& hash : vRelease) {
+        MarkBlockAsReceived(hash);
+    }
+    return vRelease.size();
+}
+
 /** Check whether the last unknown block a peer advertised is not yet known. */
 static void ProcessBlockAvailability(NodeId nodeid) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
     CNodeState *state = State(nodeid);
@@ -765,6 +838,10 @@ void PeerLogicValidation::InitializeNode(CNode *pnode) {
 
 void PeerLogicValidation::FinalizeNode(NodeId nodeid, bool& fUpdateConnectionTime) {
     fUpdateConnectionTime = false;
+    if (g_txpreverifier)
+        g_txpreverifier->RemoveNode(nodeid);
+    if (g_blockserver)
+        g_blockserver->RemoveNode(nodeid);
     LOCK(cs_main);
     CNodeState *state = State(nodeid);
     assert(state != nullptr);
@@ -806,6 +883,7 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats) {
     stats.nMisbehavior = state->nMisbehavior;
     stats.nSyncHeight = state->pindexBestKnownBlock ? state->pindexBestKnownBlock->nHeight : -1;
     stats.nCommonHeight = state->pindexLastCommonBlock ? state->pindexLastCommonBlock->nHeight : -1;
+    stats.nBlocksInFlightLimit = state->m_blocks_in_flight_limit;
     for (const QueuedBlock& queue : state->vBlocksInFlight) {
         if (queue.pindex)
             stats.vHeightInFlight.push_back(queue.pindex->nHeight);
@@ -997,7 +1075,7 @@ static bool BlockRequestAllowed(const CBlockIndex* pindex, const Consensus::Para
 PeerLogicValidation::PeerLogicValidation(CConnman* connmanIn, BanMan* banman, CScheduler &scheduler, bool enable_bip61)
     : connman(connmanIn), m_banman(banman), m_stale_tip_check_time(0), m_enable_bip61(enable_bip61) {
     // Initialize global variables that cannot be constructed at startup.
-    recentRejects.reset(new CRollingBloomFilter(120000, 0.000001));
+    recentRejects.reset(new CBlockedRollingBloomFilter(120000, 0.000001));
 
     const Consensus::Params& consensusParams = Params().GetConsensus();
     // Stale tip checking and peer eviction are on two different timers, but we
@@ -1258,6 +1336,118 @@ static void RelayAddress(const CAddress& addr, bool fReachable, CConnman* connma
     connman->ForEachNodeThen(std::move(sortfunc), std::move(pushfunc));
 }
 
+/** Push a block requested by getdata as the messages its inv type asks for */
+static void PushBlockMessages(CNode* pfrom, CConnman* connman, const CInv& inv, const CBlock& block, bool fCompact, bool fPeerWantsWitness)
+{
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    if (inv.type == MSG_BLOCK)
+        connman->PushMessage(pfrom, msgMaker.Make(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::BLOCK, block));
+    else if (inv.type == MSG_WITNESS_BLOCK)
+        connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, block));
+    else if (inv.type == MSG_FILTERED_BLOCK)
+    {
+        bool sendMerkleBlock = false;
+        CMerkleBlock merkleBlock;
+        {
+            LOCK(pfrom->cs_filter);
+            if (pfrom->pfilter) {
+                sendMerkleBlock = true;
+                merkleBlock = CMerkleBlock(block, *pfrom->pfilter);
+            }
+        }
+        if (sendMerkleBlock) {
+            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MERKLEBLOCK, merkleBlock));
+            // CMerkleBlock just contains hashes, so also push any transactions in the block the client did not see
+            // This avoids hurting performance by pointlessly requiring a round-trip
+            // Note that there is currently no way for a node to request any single transactions we didn't send here -
+            // they must either disconnect and retry or request the full block.
+            // Thus, the protocol spec specified allows for us to provide duplicate txn here,
+            // however we MUST always provide at least what the remote peer needs
+            typedef std::pair<unsigned int, uint256> PairType;
+            for (PairType& pair : merkleBlock.vMatchedTxn)
+                connman->PushMessage(pfrom, msgMaker.Make(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::TX, *block.vtx[pair.first]));
+        }
+        // else
+            // no response
+    }
+    else if (inv.type == MSG_CMPCT_BLOCK)
+    {
+        int nSendFlags = fPeerWantsWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS;
+        if (fCompact) {
+            CBlockHeaderAndShortTxIDs cmpctblock(block, fPeerWantsWitness);
+            connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, cmpctblock));
+        } else {
+            connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::BLOCK, block));
+        }
+    }
+}
+
+/** Read a block requested by a peer as raw bytes, from the cache of the blocks recently sent or from disk */
+static std::shared_ptr<const std::vector<uint8_t>> ReadRawBlockForPeer(const uint256& hash, const CDiskBlockPos& pos)
+{
+    std::shared_ptr<const std::vector<uint8_t>> block_data = g_raw_block_cache.Get(hash);
+    if (block_data)
+        return block_data;
+    std::shared_ptr<std::vector<uint8_t>> block_read = std::make_shared<std::vector<uint8_t>>();
+    if (!ReadRawBlockFromDisk(*block_read, pos, Params().MessageStart()))
+        return nullptr;
+    g_raw_block_cache.Add(hash, block_read);
+    return block_read;
+}
+
+/**
+ * Deserialize a raw block for the reply to getdata if the reply cannot be the raw bytes
+ * themselves. The on-disk format is the network format with witnesses, so a block
+ * without witnesses is also sent as is to the peers that do not want them. pblock is
+ * left null when the raw bytes are to be sent.
+ */
+static bool DecodeRawBlockForPeer(const CInv& inv, const std::vector<uint8_t>& block_data, std::shared_ptr<CBlock>& pblock)
+{
+    pblock.reset();
+    if (inv.type == MSG_WITNESS_BLOCK)
+        return true;
+    std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
+    try {
+        CDataStream ss(block_data, SER_DISK, CLIENT_VERSION);
+        ss >> *pblockRead;
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize error - %s for block %s", __func__, e.what(), inv.hash.ToString());
+    }
+    if (inv.type == MSG_BLOCK && std::none_of(pblockRead->vtx.begin(), pblockRead->vtx.end(), [](const CTransactionRef& tx) { return tx->HasWitness(); }))
+        return true;
+    pblock = std::move(pblockRead);
+    return true;
+}
+
+/** Read a block requested by getdata and send it, on a block server thread */
+static void ServeBlockFromDisk(CConnman* connman, NodeId nodeid, const CInv& inv, const CDiskBlockPos& pos, bool fCompact, bool fPeerWantsWitness, const uint256& hashContinueTip)
+{
+    std::shared_ptr<const std::vector<uint8_t>> block_data = ReadRawBlockForPeer(inv.hash, pos);
+    std::shared_ptr<CBlock> pblock;
+    const bool fRead = block_data && DecodeRawBlockForPeer(inv, *block_data, pblock);
+
+    // cs_main is not taken in ForNode, the lock order is cs_main before cs_vNodes
+    connman->ForNode(nodeid, [&](CNode* pnode) {
+        if (!fRead) {
+            // Pruned since the request was checked, disconnect the peer rather than stall it
+            LogPrint(BCLog::NET, "cannot load block %s from disk for peer=%d, disconnecting\n", inv.hash.ToString(), nodeid);
+            pnode->fDisconnect = true;
+            return true;
+        }
+        const CNetMsgMaker msgMaker(pnode->GetSendVersion());
+        if (pblock)
+            PushBlockMessages(pnode, connman, inv, *pblock, fCompact, fPeerWantsWitness);
+        else
+            connman->PushMessage(pnode, msgMaker.Make(NetMsgType::BLOCK, MakeSpan(*block_data)));
+        if (!hashContinueTip.IsNull()) {
+            std::vector<CInv> vInv;
+            vInv.push_back(CInv(MSG_BLOCK, hashContinueTip));
+            connman->PushMessage(pnode, msgMaker.Make(NetMsgType::INV, vInv));
+        }
+        return true;
+    });
+}
+
 void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, const CInv& inv, CConnman* connman)
 {
     bool send = false;
@@ -1329,73 +1519,51 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
     if (send && (pindex->nStatus & BLOCK_HAVE_DATA))
     {
         std::shared_ptr<const CBlock> pblock;
-        if (a_recent_block && a_recent_block->GetHash() == pindex->GetBlockHash()) {
-            pblock = a_recent_block;
-        } else if (inv.type == MSG_WITNESS_BLOCK) {
-            // Fast-path: in this case it is possible to serve the block directly from disk,
-            // as the network format matches the format on disk
-            std::vector<uint8_t> block_data;
-            if (!ReadRawBlockFromDisk(block_data, pindex, chainparams.MessageStart())) {
-                assert(!"cannot load block from disk");
+        const bool fRecentBlock = a_recent_block && a_recent_block->GetHash() == pindex->GetBlockHash();
+        if (g_blockserver && !fRecentBlock) {
+            // Read and send the block without cs_main, the next messages of the peer wait for it
+            uint256 hashContinueTip;
+            if (inv.hash == pfrom->hashContinue) {
+                hashContinueTip = chainActive.Tip()->GetBlockHash();
+                pfrom->hashContinue.SetNull();
             }
-            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, MakeSpan(block_data)));
-            // Don't set pblock as we've sent the block
+            const bool fCompact = CanDirectFetch(consensusParams) && pindex->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH;
+            const bool fPeerWantsWitness = State(pfrom->GetId())->fWantsCmpctWitness;
+            const CDiskBlockPos pos = pindex->GetBlockPos();
+            const NodeId nodeid = pfrom->GetId();
+            g_blockserver->Submit(nodeid, [connman, nodeid, inv, pos, fCompact, fPeerWantsWitness, hashContinueTip] {
+                ServeBlockFromDisk(connman, nodeid, inv, pos, fCompact, fPeerWantsWitness, hashContinueTip);
+            });
+            return;
+        }
+        if (fRecentBlock) {
+            pblock = a_recent_block;
         } else {
-            // Send block from disk
-            std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
-            if (!ReadBlockFromDisk(*pblockRead, pindex, consensusParams))
+            // Fast-path: the raw block is sent as read from disk when the network format of
+            // the reply matches the format on disk
+            std::shared_ptr<const std::vector<uint8_t>> block_data = ReadRawBlockForPeer(pindex->GetBlockHash(), pindex->GetBlockPos());
+            std::shared_ptr<CBlock> pblockRead;
+            if (!block_data || !DecodeRawBlockForPeer(inv, *block_data, pblockRead)) {
                 assert(!"cannot load block from disk");
-            pblock = pblockRead;
+            }
+            if (pblockRead)
+                pblock = pblockRead;
+            else
+                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, MakeSpan(*block_data)));
+            // Don't set pblock if we've sent the block
         }
         if (pblock) {
-            if (inv.type == MSG_BLOCK)
-                connman->PushMessage(pfrom, msgMaker.Make(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::BLOCK, *pblock));
-            else if (inv.type == MSG_WITNESS_BLOCK)
-                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, *pblock));
-            else if (inv.type == MSG_FILTERED_BLOCK)
-            {
-                bool sendMerkleBlock = false;
-                CMerkleBlock merkleBlock;
-                {
-                    LOCK(pfrom->cs_filter);
-                    if (pfrom->pfilter) {
-                        sendMerkleBlock = true;
-                        merkleBlock = CMerkleBlock(*pblock, *pfrom->pfilter);
-                    }
-                }
-                if (sendMerkleBlock) {
-                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MERKLEBLOCK, merkleBlock));
-                    // CMerkleBlock just contains hashes, so also push any transactions in the block the client did not see
-                    // This avoids hurting performance by pointlessly requiring a round-trip
-                    // Note that there is currently no way for a node to request any single transactions we didn't send here -
-                    // they must either disconnect and retry or request the full block.
-                    // Thus, the protocol spec specified allows for us to provide duplicate txn here,
-                    // however we MUST always provide at least what the remote peer needs
-                    typedef std::pair<unsigned int, uint256> PairType;
-                    for (PairType& pair : merkleBlock.vMatchedTxn)
-                        connman->PushMessage(pfrom, msgMaker.Make(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::TX, *pblock->vtx[pair.first]));
-                }
-                // else
-                    // no response
-            }
-            else if (inv.type == MSG_CMPCT_BLOCK)
-            {
-                // If a peer is asking for old blocks, we're almost guaranteed
-                // they won't have a useful mempool to match against a compact block,
-                // and we don't feel like constructing the object for them, so
-                // instead we respond with the full, non-compact block.
-                bool fPeerWantsWitness = State(pfrom->GetId())->fWantsCmpctWitness;
+            // If a peer is asking for old blocks, we're almost guaranteed
+            // they won't have a useful mempool to match against a compact block,
+            // and we don't feel like constructing the object for them, so
+            // instead we respond with the full, non-compact block.
+            bool fPeerWantsWitness = State(pfrom->GetId())->fWantsCmpctWitness;
+            bool fCompact = CanDirectFetch(consensusParams) && pindex->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH;
+            if (inv.type == MSG_CMPCT_BLOCK && fCompact && (fPeerWantsWitness || !fWitnessesPresentInARecentCompactBlock) && a_recent_compact_block && a_recent_compact_block->header.GetHash() == pindex->GetBlockHash()) {
                 int nSendFlags = fPeerWantsWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS;
-                if (CanDirectFetch(consensusParams) && pindex->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH) {
-                    if ((fPeerWantsWitness || !fWitnessesPresentInARecentCompactBlock) && a_recent_compact_block && a_recent_compact_block->header.GetHash() == pindex->GetBlockHash()) {
-                        connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, *a_recent_compact_block));
-                    } else {
-                        CBlockHeaderAndShortTxIDs cmpctblock(*pblock, fPeerWantsWitness);
-                        connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, cmpctblock));
-                    }
-                } else {
-                    connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::BLOCK, *pblock));
-                }
+                connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, *a_recent_compact_block));
+            } else {
+                PushBlockMessages(pfrom, connman, inv, *pblock, fCompact, fPeerWantsWitness);
             }
         }
 
@@ -1501,6 +1669,55 @@ inline void static SendBlockTransactions(const CBlock& block, const BlockTransac
     connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::BLOCKTXN, resp));
 }
 
+/** Read the block of a getblocktxn from disk and send the transactions asked for, on a block server thread */
+static void ServeBlockTransactionsFromDisk(CConnman* connman, NodeId nodeid, const BlockTransactionsRequest& req, const CDiskBlockPos& pos, int nSendFlags)
+{
+    CBlock block;
+    std::shared_ptr<const std::vector<uint8_t>> block_data = ReadRawBlockForPeer(req.blockhash, pos);
+    bool fRead = block_data != nullptr;
+    if (fRead) {
+        try {
+            CDataStream ss(*block_data, SER_DISK, CLIENT_VERSION);
+            ss >> block;
+        } catch (const std::exception& e) {
+            LogPrintf("%s: Deserialize error - %s for block %s\n", __func__, e.what(), req.blockhash.ToString());
+            fRead = false;
+        }
+    }
+    BlockTransactions resp(req);
+    for (size_t i = 0; fRead && i < req.indexes.size(); i++) {
+        if (req.indexes[i] >= block.vtx.size()) {
+            LOCK(cs_main);
+            Misbehaving(nodeid, 100, strprintf("Peer %d sent us a getblocktxn with out-of-bounds tx indices", nodeid));
+            return;
+        }
+        resp.txn[i] = block.vtx[req.indexes[i]];
+    }
+
+    connman->ForNode(nodeid, [&](CNode* pnode) {
+        if (!fRead) {
+            LogPrint(BCLog::NET, "cannot load block %s from disk for peer=%d, disconnecting\n", req.blockhash.ToString(), nodeid);
+            pnode->fDisconnect = true;
+            return true;
+        }
+        connman->PushMessage(pnode, CNetMsgMaker(pnode->GetSendVersion()).Make(nSendFlags, NetMsgType::BLOCKTXN, resp));
+        return true;
+    });
+}
+
+/** Take headers from the proof-of-stake header budget of a peer, false if it has not got enough left */
+static bool ConsumePoSHeaderBudget(CNodeState* state, int64_t nHeaders, int64_t nNow) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    if (nNow > state->m_pos_header_budget_time) {
+        state->m_pos_header_budget = std::min(MAX_POS_HEADER_BUDGET, state->m_pos_header_budget + (nNow - state->m_pos_header_budget_time) * POS_HEADER_BUDGET_RATE);
+        state->m_pos_header_budget_time = nNow;
+    }
+    if (nHeaders > state->m_pos_header_budget)
+        return false;
+    state->m_pos_header_budget -= nHeaders;
+    return true;
+}
+
 bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::vector<CBlockHeader>& headers, const CChainParams& chainparams, bool punish_duplicate_invalid)
 {
     const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
@@ -1545,12 +1762,22 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
         }
 
         uint256 hashLastBlock;
+        int64_t nNewPoSHeaders = 0;
         for (const CBlockHeader& header : headers) {
             if (!hashLastBlock.IsNull() && header.hashPrevBlock != hashLastBlock) {
                 Misbehaving(pfrom->GetId(), 20, "non-continuous headers sequence");
                 return false;
             }
             hashLastBlock = header.GetHash();
+            if (header.IsProofOfStake() && !LookupBlockIndex(hashLastBlock))
+                nNewPoSHeaders++;
+        }
+
+        // Outside of initial block download the proof of every new proof-of-stake header is
+        // checked, so a peer cannot make us do that for more than its budget of them
+        if (nNewPoSHeaders > 0 && !pfrom->fWhitelisted && !IsInitialBlockDownload() && !ConsumePoSHeaderBudget(nodestate, nNewPoSHeaders, GetTime())) {
+            LogPrint(BCLog::NET, "peer=%d: ignoring %d new proof-of-stake headers over its budget\n", pfrom->GetId(), nNewPoSHeaders);
+            return true;
         }
 
         // If we don't have the last header, then they'll have given us
@@ -1747,6 +1974,7 @@ void static ProcessOrphanTx(CConnman* connman, std::set<uint256>& orphan_work_se
         if (setMisbehaving.count(fromPeer)) continue;
         if (AcceptToMemoryPool(mempool, stateDummy, porphanTx, &fMissingInputs2, &removed_txn, false /* bypass_limits */, 0 /* nAbsurdFee */)) {
             LogPrint(BCLog::MEMPOOL, "   accepted orphan tx %s\n", orphanHash.ToString());
+            validationTimes.TxAccepted(orphanHash, GetTimeMicros());
             RelayTransaction(orphanTx, connman);
             for (unsigned int i = 0; i < orphanTx.vout.size(); i++) {
                 auto it_by_prev = mapOrphanTransactionsByPrev.find(COutPoint(orphanHash, i));
@@ -1783,6 +2011,144 @@ void static ProcessOrphanTx(CConnman* connman, std::set<uint256>& orphan_work_se
     }
 }
 
+/** Try to add a tx received from a peer to the mempool, then relay it, or keep it as an orphan, or reject it */
+void static ProcessTransaction(CNode* pfrom, const CTransactionRef& ptx, CConnman* connman, bool enable_bip61) EXCLUSIVE_LOCKS_REQUIRED(cs_main, g_cs_orphans)
+{
+    const CTransaction& tx = *ptx;
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    CInv inv(MSG_TX, tx.GetHash());
+
+    bool fMissingInputs = false;
+    CValidationState state;
+
+    pfrom->setAskFor.erase(inv.hash);
+    mapAlreadyAskedFor.erase(inv.hash);
+
+    std::list<CTransactionRef> lRemovedTxn;
+
+    if (!AlreadyHave(inv) &&
+        AcceptToMemoryPool(mempool, state, ptx, &fMissingInputs, &lRemovedTxn, false /* bypass_limits */, 0 /* nAbsurdFee */)) {
+        validationTimes.TxAccepted(inv.hash, GetTimeMicros());
+        mempool.check(pcoinsTip.get());
+        RelayTransaction(tx, connman);
+        for (unsigned int i = 0; i < tx.vout.size(); i++) {
+            auto it_by_prev = mapOrphanTransactionsByPrev.find(COutPoint(inv.hash, i));
+            if (it_by_prev != mapOrphanTransactionsByPrev.end()) {
+                for (const auto& elem : it_by_prev->second) {
+                    pfrom->orphan_work_set.insert(elem->first);
+                }
+            }
+        }
+
+        pfrom->nLastTXTime = GetTime();
+
+        LogPrint(BCLog::MEMPOOL, "AcceptToMemoryPool: peer=%d: accepted %s (poolsz %u txn, %u kB)\n",
+            pfrom->GetId(),
+            tx.GetHash().ToString(),
+            mempool.size(), mempool.DynamicMemoryUsage() / 1000);
+
+        // Recursively process any orphan transactions that depended on this one
+        ProcessOrphanTx(connman, pfrom->orphan_work_set, lRemovedTxn);
+    }
+    else if (fMissingInputs)
+    {
+        bool fRejectedParents = false; // It may be the case that the orphans parents have all been rejected
+        for (const CTxIn& txin : tx.vin) {
+            if (recentRejects->contains(txin.prevout.hash)) {
+                fRejectedParents = true;
+                break;
+            }
+        }
+        if (!fRejectedParents) {
+            uint32_t nFetchFlags = GetFetchFlags(pfrom);
+            for (const CTxIn& txin : tx.vin) {
+                CInv _inv(MSG_TX | nFetchFlags, txin.prevout.hash);
+                pfrom->AddInventoryKnown(_inv);
+                if (!AlreadyHave(_inv)) pfrom->AskFor(_inv);
+            }
+            AddOrphanTx(ptx, pfrom->GetId());
+
+            // DoS prevention: do not allow mapOrphanTransactions to grow unbounded
+            unsigned int nMaxOrphanTx = (unsigned int)std::max((int64_t)0, gArgs.GetArg("-maxorphantx", DEFAULT_MAX_ORPHAN_TRANSACTIONS));
+            unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTx);
+            if (nEvicted > 0) {
+                LogPrint(BCLog::MEMPOOL, "mapOrphan overflow, removed %u tx\n", nEvicted);
+            }
+        } else {
+            LogPrint(BCLog::MEMPOOL, "not keeping orphan with rejected parents %s\n",tx.GetHash().ToString());
+            // We will continue to reject this tx since it has rejected
+            // parents so avoid re-requesting it from other peers.
+            recentRejects->insert(tx.GetHash());
+        }
+    } else {
+        if (!tx.HasWitness() && !state.CorruptionPossible()) {
+            // Do not use rejection cache for witness transactions or
+            // witness-stripped transactions, as they can have been malleated.
+            // See https://github.com/bitcoin/bitcoin/issues/8279 for details.
+            assert(recentRejects);
+            recentRejects->insert(tx.GetHash());
+            if (RecursiveDynamicUsage(*ptx) < 100000) {
+                AddToCompactExtraTransactions(ptx);
+            }
+        } else if (tx.HasWitness() && RecursiveDynamicUsage(*ptx) < 100000) {
+            AddToCompactExtraTransactions(ptx);
+        }
+
+        if (pfrom->fWhitelisted && gArgs.GetBoolArg("-whitelistforcerelay", DEFAULT_WHITELISTFORCERELAY)) {
+            // Always relay transactions received from whitelisted peers, even
+            // if they were already in the mempool or rejected from it due
+            // to policy, allowing the node to function as a gateway for
+            // nodes hidden behind it.
+            //
+            // Never relay transactions that we would assign a non-zero DoS
+            // score for, as we expect peers to do the same with us in that
+            // case.
+            int nDoS = 0;
+            if (!state.IsInvalid(nDoS) || nDoS == 0) {
+                LogPrintf("Force relaying tx %s from whitelisted peer=%d\n", tx.GetHash().ToString(), pfrom->GetId());
+                RelayTransaction(tx, connman);
+            } else {
+                LogPrintf("Not relaying invalid transaction %s from whitelisted peer=%d (%s)\n", tx.GetHash().ToString(), pfrom->GetId(), FormatStateMessage(state));
+            }
+        }
+    }
+
+    for (const CTransactionRef& removedTx : lRemovedTxn)
+        AddToCompactExtraTransactions(removedTx);
+
+    // If a tx has been detected by recentRejects, we will have reached
+    // this point and the tx will have been ignored. Because we haven't run
+    // the tx through AcceptToMemoryPool, we won't have computed a DoS
+    // score for it or determined exactly why we consider it invalid.
+    //
+    // This means we won't penalize any peer subsequently relaying a DoSy
+    // tx (even if we penalized the first peer who gave it to us) because
+    // we have to account for recentRejects showing false positives. In
+    // other words, we shouldn't penalize a peer if we aren't *sure* they
+    // submitted a DoSy tx.
+    //
+    // Note that recentRejects doesn't just record DoSy or invalid
+    // transactions, but any tx not accepted by the mempool, which may be
+    // due to node policy (vs. consensus). So we can't blanket penalize a
+    // peer simply for relaying a tx that our recentRejects has caught,
+    // regardless of false positives.
+
+    int nDoS = 0;
+    if (state.IsInvalid(nDoS))
+    {
+        LogPrint(BCLog::MEMPOOLREJ, "%s from peer=%d was not accepted: %s\n", tx.GetHash().ToString(),
+            pfrom->GetId(),
+            FormatStateMessage(state));
+        if (enable_bip61 && state.GetRejectCode() > 0 && state.GetRejectCode() < REJECT_INTERNAL) { // Never send AcceptToMemoryPool's internal codes over P2P
+            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::REJECT, NetMsgType::TX, (unsigned char)state.GetRejectCode(),
+                               state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash));
+        }
+        if (nDoS > 0) {
+            Misbehaving(pfrom->GetId(), nDoS);
+        }
+    }
+}
+
 bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, int64_t nTimeReceived, const CChainParams& chainparams, CConnman* connman, const std::atomic<bool>& interruptMsgProc, bool enable_bip61)
 {
     LogPrint(BCLog::NET, "received: %s (%u bytes) peer=%d\n", SanitizeString(strCommand), vRecv.size(), pfrom->GetId());
@@ -2338,6 +2704,17 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             return true;
         }
 
+        if (g_blockserver) {
+            // Read the block and send the transactions without cs_main, the next messages of the peer wait for them
+            const int nSendFlags = State(pfrom->GetId())->fWantsCmpctWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS;
+            const CDiskBlockPos pos = pindex->GetBlockPos();
+            const NodeId nodeid = pfrom->GetId();
+            g_blockserver->Submit(nodeid, [connman, nodeid, req, pos, nSendFlags] {
+                ServeBlockTransactionsFromDisk(connman, nodeid, req, pos, nSendFlags);
+            });
+            return true;
+        }
+
         CBlock block;
         bool ret = ReadBlockFromDisk(block, pindex, chainparams.GetConsensus());
         assert(ret);
@@ -2428,137 +2805,17 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
 
         CInv inv(MSG_TX, tx.GetHash());
         pfrom->AddInventoryKnown(inv);
+        validationTimes.TxReceived(inv.hash, pfrom->GetId(), nTimeReceived);
 
-        LOCK2(cs_main, g_cs_orphans);
-
-        bool fMissingInputs = false;
-        CValidationState state;
-
-        pfrom->setAskFor.erase(inv.hash);
-        mapAlreadyAskedFor.erase(inv.hash);
-
-        std::list<CTransactionRef> lRemovedTxn;
-
-        if (!AlreadyHave(inv) &&
-            AcceptToMemoryPool(mempool, state, ptx, &fMissingInputs, &lRemovedTxn, false /* bypass_limits */, 0 /* nAbsurdFee */)) {
-            mempool.check(pcoinsTip.get());
-            RelayTransaction(tx, connman);
-            for (unsigned int i = 0; i < tx.vout.size(); i++) {
-                auto it_by_prev = mapOrphanTransactionsByPrev.find(COutPoint(inv.hash, i));
-                if (it_by_prev != mapOrphanTransactionsByPrev.end()) {
-                    for (const auto& elem : it_by_prev->second) {
-                        pfrom->orphan_work_set.insert(elem->first);
-                    }
-                }
-            }
-
-            pfrom->nLastTXTime = GetTime();
-
-            LogPrint(BCLog::MEMPOOL, "AcceptToMemoryPool: peer=%d: accepted %s (poolsz %u txn, %u kB)\n",
-                pfrom->GetId(),
-                tx.GetHash().ToString(),
-                mempool.size(), mempool.DynamicMemoryUsage() / 1000);
-
-            // Recursively process any orphan transactions that depended on this one
-            ProcessOrphanTx(connman, pfrom->orphan_work_set, lRemovedTxn);
-        }
-        else if (fMissingInputs)
-        {
-            bool fRejectedParents = false; // It may be the case that the orphans parents have all been rejected
-            for (const CTxIn& txin : tx.vin) {
-                if (recentRejects->contains(txin.prevout.hash)) {
-                    fRejectedParents = true;
-                    break;
-                }
-            }
-            if (!fRejectedParents) {
-                uint32_t nFetchFlags = GetFetchFlags(pfrom);
-                for (const CTxIn& txin : tx.vin) {
-                    CInv _inv(MSG_TX | nFetchFlags, txin.prevout.hash);
-                    pfrom->AddInventoryKnown(_inv);
-                    if (!AlreadyHave(_inv)) pfrom->AskFor(_inv);
-                }
-                AddOrphanTx(ptx, pfrom->GetId());
-
-                // DoS prevention: do not allow mapOrphanTransactions to grow unbounded
-                unsigned int nMaxOrphanTx = (unsigned int)std::max((int64_t)0, gArgs.GetArg("-maxorphantx", DEFAULT_MAX_ORPHAN_TRANSACTIONS));
-                unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTx);
-                if (nEvicted > 0) {
-                    LogPrint(BCLog::MEMPOOL, "mapOrphan overflow, removed %u tx\n", nEvicted);
-                }
-            } else {
-                LogPrint(BCLog::MEMPOOL, "not keeping orphan with rejected parents %s\n",tx.GetHash().ToString());
-                // We will continue to reject this tx since it has rejected
-                // parents so avoid re-requesting it from other peers.
-                recentRejects->insert(tx.GetHash());
-            }
-        } else {
-            if (!tx.HasWitness() && !state.CorruptionPossible()) {
-                // Do not use rejection cache for witness transactions or
-                // witness-stripped transactions, as they can have been malleated.
-                // See https://github.com/bitcoin/bitcoin/issues/8279 for details.
-                assert(recentRejects);
-                recentRejects->insert(tx.GetHash());
-                if (RecursiveDynamicUsage(*ptx) < 100000) {
-                    AddToCompactExtraTransactions(ptx);
-                }
-            } else if (tx.HasWitness() && RecursiveDynamicUsage(*ptx) < 100000) {
-                AddToCompactExtraTransactions(ptx);
-            }
-
-            if (pfrom->fWhitelisted && gArgs.GetBoolArg("-whitelistforcerelay", DEFAULT_WHITELISTFORCERELAY)) {
-                // Always relay transactions received from whitelisted peers, even
-                // if they were already in the mempool or rejected from it due
-                // to policy, allowing the node to function as a gateway for
-                // nodes hidden behind it.
-                //
-                // Never relay transactions that we would assign a non-zero DoS
-                // score for, as we expect peers to do the same with us in that
-                // case.
-                int nDoS = 0;
-                if (!state.IsInvalid(nDoS) || nDoS == 0) {
-                    LogPrintf("Force relaying tx %s from whitelisted peer=%d\n", tx.GetHash().ToString(), pfrom->GetId());
-                    RelayTransaction(tx, connman);
-                } else {
-                    LogPrintf("Not relaying invalid transaction %s from whitelisted peer=%d (%s)\n", tx.GetHash().ToString(), pfrom->GetId(), FormatStateMessage(state));
-                }
-            }
+        // With -txverifythreads the scripts are verified first without cs_main, and the tx is
+        // accepted from ProcessMessages once they are
+        if (g_txpreverifier && !mempool.exists(inv.hash)) {
+            g_txpreverifier->Submit(pfrom->GetId(), ptx);
+            return true;
         }
 
-        for (const CTransactionRef& removedTx : lRemovedTxn)
-            AddToCompactExtraTransactions(removedTx);
-
-        // If a tx has been detected by recentRejects, we will have reached
-        // this point and the tx will have been ignored. Because we haven't run
-        // the tx through AcceptToMemoryPool, we won't have computed a DoS
-        // score for it or determined exactly why we consider it invalid.
-        //
-        // This means we won't penalize any peer subsequently relaying a DoSy
-        // tx (even if we penalized the first peer who gave it to us) because
-        // we have to account for recentRejects showing false positives. In
-        // other words, we shouldn't penalize a peer if we aren't *sure* they
-        // submitted a DoSy tx.
-        //
-        // Note that recentRejects doesn't just record DoSy or invalid
-        // transactions, but any tx not accepted by the mempool, which may be
-        // due to node policy (vs. consensus). So we can't blanket penalize a
-        // peer simply for relaying a tx that our recentRejects has caught,
-        // regardless of false positives.
-
-        int nDoS = 0;
-        if (state.IsInvalid(nDoS))
-        {
-            LogPrint(BCLog::MEMPOOLREJ, "%s from peer=%d was not accepted: %s\n", tx.GetHash().ToString(),
-                pfrom->GetId(),
-                FormatStateMessage(state));
-            if (enable_bip61 && state.GetRejectCode() > 0 && state.GetRejectCode() < REJECT_INTERNAL) { // Never send AcceptToMemoryPool's internal codes over P2P
-                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::REJECT, strCommand, (unsigned char)state.GetRejectCode(),
-                                   state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash));
-            }
-            if (nDoS > 0) {
-                Misbehaving(pfrom->GetId(), nDoS);
-            }
-        }
+        LOCK2(cs_main, g_cs_orphans);
+        ProcessTransaction(pfrom, ptx, connman, enable_bip61);
         return true;
     }
 
@@ -2566,6 +2823,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
     {
         CBlockHeaderAndShortTxIDs cmpctblock;
         vRecv >> cmpctblock;
+        validationTimes.HeaderReceived(cmpctblock.header.GetHash(), nTimeReceived);
 
         bool received_new_header = false;
 
@@ -2764,6 +3022,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             // we have a chain with at least nMinimumChainWork), and we ignore
             // compact blocks with less work than our tip, it is safe to treat
             // reconstructed compact blocks as having been requested.
+            validationTimes.BlockReceived(pblock->GetHash(), pfrom->GetId(), nTimeReceived);
             ProcessNetBlock(chainparams, pblock, /*fForceProcessing=*/true, &fNewBlock, pfrom, *connman);
             if (fNewBlock) {
                 pfrom->nLastBlockTime = GetTime();
@@ -2847,6 +3106,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             // disk-space attacks), but this should be safe due to the
             // protections in the compact block handler -- see related comment
             // in compact block optimistic reconstruction handling.
+            validationTimes.BlockReceived(pblock->GetHash(), pfrom->GetId(), nTimeReceived);
             ProcessNetBlock(chainparams, pblock, /*fForceProcessing=*/true, &fNewBlock, pfrom, *connman);
             if (fNewBlock) {
                 pfrom->nLastBlockTime = GetTime();
@@ -2880,6 +3140,12 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         // disconnect the peer if it is using one of our outbound connection
         // slots.
         bool should_punish = !pfrom->fInbound && !pfrom->m_manual_connection;
+        // Only the announcements are timed, the batches of the header sync would push the
+        // recent blocks out of the history
+        if (headers.size() <= MAX_BLOCKS_TO_ANNOUNCE) {
+            for (const CBlockHeader& header : headers)
+                validationTimes.HeaderReceived(header.GetHash(), nTimeReceived);
+        }
         return ProcessHeadersMessage(pfrom, connman, headers, chainparams, should_punish);
     }
 
@@ -2896,11 +3162,13 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             LOCK(cs_main);
             // Also always process if we requested the block explicitly, as we may
             // need it even though it is not a candidate for a new best tip.
+            UpdateBlockDeliveryTime(pfrom->GetId(), hash);
             forceProcessing |= MarkBlockAsReceived(hash);
             // mapBlockSource is only used for sending reject messages and DoS scores,
             // so the race between here and cs_main in ProcessNewBlock is fine.
             mapBlockSource.emplace(hash, std::make_pair(pfrom->GetId(), true));
         }
+        validationTimes.BlockReceived(hash, pfrom->GetId(), nTimeReceived);
         bool fNewBlock = false;
         ProcessNetBlock(chainparams, pblock, forceProcessing, &fNewBlock, pfrom, *connman);
         if (fNewBlock) {
@@ -3152,6 +3420,28 @@ bool PeerLogicValidation::SendRejectsAndCheckIfBanned(CNode* pnode, bool enable_
     return false;
 }
 
+static Mutex g_cs_net_msg_stats;
+static mapMsgCmdStats g_net_msg_stats GUARDED_BY(g_cs_net_msg_stats);
+
+mapMsgCmdStats GetNetMsgStats()
+{
+    LOCK(g_cs_net_msg_stats);
+    return g_net_msg_stats;
+}
+
+static void RecordNetMsgStats(CNode* pfrom, const std::string& strCommand, uint64_t nBytes, int64_t nMicros, int64_t nMainMicros)
+{
+    // Unknown commands are counted together, so that peers cannot grow the maps
+    static const std::set<std::string> setKnownCommands(getAllNetMessageTypes().begin(), getAllNetMessageTypes().end());
+    const std::string& strKey = setKnownCommands.count(strCommand) ? strCommand : NET_MESSAGE_COMMAND_OTHER;
+    {
+        LOCK(pfrom->cs_msgStats);
+        pfrom->mapMsgStats[strKey].Add(nBytes, nMicros, nMainMicros);
+    }
+    LOCK(g_cs_net_msg_stats);
+    g_net_msg_stats[strKey].Add(nBytes, nMicros, nMainMicros);
+}
+
 bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& interruptMsgProc)
 {
     const CChainParams& chainparams = Params();
@@ -3165,6 +3455,9 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
     //
     bool fMoreWork = false;
 
+    // the peer is woken up again when the block data it asked for is sent
+    if (g_blockserver && g_blockserver->IsBusy(pfrom->GetId())) return false;
+
     if (!pfrom->vRecvGetData.empty())
         ProcessGetData(pfrom, chainparams, connman, interruptMsgProc);
 
@@ -3177,18 +3470,30 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
         }
     }
 
+    if (g_txpreverifier) {
+        std::vector<CTransactionRef> vReady = g_txpreverifier->TakeReady(pfrom->GetId());
+        if (!vReady.empty()) {
+            LOCK2(cs_main, g_cs_orphans);
+            for (const CTransactionRef& ptx : vReady)
+                ProcessTransaction(pfrom, ptx, connman, m_enable_bip61);
+        }
+    }
+
     if (pfrom->fDisconnect)
         return false;
 
     // this maintains the order of responses
     if (!pfrom->vRecvGetData.empty()) return true;
     if (!pfrom->orphan_work_set.empty()) return true;
+    // the peer is woken up again when its txs are verified
+    if (g_txpreverifier && g_txpreverifier->IsFull(pfrom->GetId())) return false;
 
     // Don't bother if send buffer is too full to respond anyway
     if (pfrom->fPauseSend)
         return false;
 
     std::list<CNetMessage> msgs;
+    bool fResumeRecv = false;
     {
         LOCK(pfrom->cs_vProcessMsg);
         if (pfrom->vProcessMsg.empty())
@@ -3196,9 +3501,14 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
         // Just take one message
         msgs.splice(msgs.begin(), pfrom->vProcessMsg, pfrom->vProcessMsg.begin());
         pfrom->nProcessQueueSize -= msgs.front().vRecv.size() + CMessageHeader::HEADER_SIZE;
+        fResumeRecv = pfrom->fPauseRecv;
         pfrom->fPauseRecv = pfrom->nProcessQueueSize > connman->GetReceiveFloodSize();
+        fResumeRecv &= !pfrom->fPauseRecv;
         fMoreWork = !pfrom->vProcessMsg.empty();
     }
+    // The socket handler selects the socket for receiving again
+    if (fResumeRecv)
+        connman->WakeSocketHandler();
     CNetMessage& msg(msgs.front());
 
     msg.SetVersion(pfrom->GetRecvVersion());
@@ -3235,6 +3545,9 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
 
     // Process message
     bool fRet = false;
+    SetLockHoldTimer(&cs_main);
+    const int64_t nProcessStart = GetTimeMicros();
+    const int64_t nMainHeldStart = GetLockHoldTime();
     try
     {
         fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime, chainparams, connman, interruptMsgProc, m_enable_bip61);
@@ -3272,6 +3585,7 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
     } catch (...) {
         PrintExceptionContinue(nullptr, "ProcessMessages()");
     }
+    RecordNetMsgStats(pfrom, strCommand, nMessageSize + CMessageHeader::HEADER_SIZE, GetTimeMicros() - nProcessStart, GetLockHoldTime() - nMainHeldStart);
 
     if (!fRet) {
         LogPrint(BCLog::NET, "%s(%s, %u bytes) FAILED peer=%d\n", __func__, SanitizeString(strCommand), nMessageSize, pfrom->GetId());
@@ -3417,19 +3731,54 @@ void PeerLogicValidation::CheckForStaleTipAndEvictPeers(const Consensus::Params
 }
 
 namespace {
+/** Position of the mempool transactions by depth and score, shared by all the peers whose inventory
+ *  trickles until the next rebuild. Inbound peers trickle together, so they sort with one snapshot. */
+struct InvRelayOrder
+{
+    std::unordered_map<uint256, uint32_t, SaltedTxidHasher> ranks;
+    //! Mempool transactions counter and time (in microseconds) of the last rebuild
+    unsigned int nTransactionsUpdated{0};
+    int64_t nTime{0};
+};
+InvRelayOrder g_inv_relay_order GUARDED_BY(cs_main);
+
+const InvRelayOrder& GetInvRelayOrder(int64_t nNow) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    const unsigned int nTransactionsUpdated = mempool.GetTransactionsUpdated();
+    if (nTransactionsUpdated != g_inv_relay_order.nTransactionsUpdated && nNow >= g_inv_relay_order.nTime + INVENTORY_RELAY_ORDER_INTERVAL) {
+        std::vector<uint256> vtxid;
+        mempool.queryHashes(vtxid);
+        g_inv_relay_order.ranks.clear();
+        g_inv_relay_order.ranks.reserve(vtxid.size());
+        for (uint32_t i = 0; i < vtxid.size(); i++) {
+            g_inv_relay_order.ranks.emplace(vtxid[i], i);
+        }
+        g_inv_relay_order.nTransactionsUpdated = nTransactionsUpdated;
+        g_inv_relay_order.nTime = nNow;
+    }
+    return g_inv_relay_order;
+}
+
 class CompareInvMempoolOrder
 {
     CTxMemPool *mp;
+    const InvRelayOrder& order;
 public:
-    explicit CompareInvMempoolOrder(CTxMemPool *_mempool)
-    {
-        mp = _mempool;
-    }
+    CompareInvMempoolOrder(CTxMemPool *_mempool, const InvRelayOrder& _order) : mp(_mempool), order(_order) {}
 
     bool operator()(std::set<uint256>::iterator a, std::set<uint256>::iterator b)
     {
         /* As std::make_heap produces a max-heap, we want the entries with the
-         * fewest ancestors/highest fee to sort later. */
+         * fewest ancestors/highest fee to sort later. The transactions missing
+         * from the snapshot are newer, so they cannot be ancestors of those in it. */
+        auto ita = order.ranks.find(*a);
+        auto itb = order.ranks.find(*b);
+        if (ita != order.ranks.end() && itb != order.ranks.end()) {
+            return ita->second > itb->second;
+        }
+        if (ita != order.ranks.end() || itb != order.ranks.end()) {
+            return itb != order.ranks.end();
+        }
         return mp->CompareDepthAndScore(*b, *a);
     }
 };
@@ -3519,8 +3868,10 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
         }
 
         // Start block sync
-        if (pindexBestHeader == nullptr)
+        if (pindexBestHeader == nullptr) {
             pindexBestHeader = chainActive.Tip();
+            nBestHeaderHeight = pindexBestHeader ? pindexBestHeader->nHeight : -1;
+        }
         bool fFetch = state.fPreferredDownload || (nPreferredDownload == 0 && !pto->fClient && !pto->fOneShot); // Download if this is a nice peer, or we have no nice peers and this one might do.
         if (!state.fSyncStarted && !pto->fClient && !fImporting && !fReindex) {
             // Only actively request headers from a single peer, unless we're close to today.
@@ -3774,7 +4125,7 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
                 }
                 // Topologically and fee-rate sort the inventory we send for privacy and priority reasons.
                 // A heap is used so that not all items need sorting if only a few are being sent.
-                CompareInvMempoolOrder compareInvMempoolOrder(&mempool);
+                CompareInvMempoolOrder compareInvMempoolOrder(&mempool, GetInvRelayOrder(nNow));
                 std::make_heap(vInvTx.begin(), vInvTx.end(), compareInvMempoolOrder);
                 // No reason to drain out at many times the network's capacity,
                 // especially since we have many peers and some will draw much shorter delays.
@@ -3893,10 +4244,12 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
         // Message: getdata (blocks)
         //
         std::vector<CInv> vGetData;
-        if (!pto->fClient && ((fFetch && !pto->m_limited_node) || !IsInitialBlockDownload()) && state.nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+        state.m_blocks_in_flight_limit = GetBlocksInFlightLimit(state, pto->nMinPingUsecTime);
+        // A stalling peer is not asked for more until it delivers, as its queued blocks were handed to the others
+        if (!pto->fClient && ((fFetch && !pto->m_limited_node) || !IsInitialBlockDownload()) && state.nBlocksInFlight < state.m_blocks_in_flight_limit && state.nStallingSince == 0) {
             std::vector<const CBlockIndex*> vToDownload;
             NodeId staller = -1;
-            FindNextBlocksToDownload(pto->GetId(), MAX_BLOCKS_IN_TRANSIT_PER_PEER - state.nBlocksInFlight, vToDownload, staller, consensusParams);
+            FindNextBlocksToDownload(pto->GetId(), state.m_blocks_in_flight_limit - state.nBlocksInFlight, vToDownload, staller, consensusParams);
             for (const CBlockIndex *pindex : vToDownload) {
                 uint32_t nFetchFlags = GetFetchFlags(pto);
                 vGetData.push_back(CInv(MSG_BLOCK | nFetchFlags, pindex->GetBlockHash()));
@@ -3906,8 +4259,11 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
             }
             if (state.nBlocksInFlight == 0 && staller != -1) {
                 if (State(staller)->nStallingSince == 0) {
+                    // Do not wait for the staller to get through its queue before the others can
+                    // download the rest of the window. ReleaseQueuedBlocks resets nStallingSince.
+                    int nReleased = ReleaseQueuedBlocks(staller);
                     State(staller)->nStallingSince = nNow;
-                    LogPrint(BCLog::NET, "Stall started peer=%d\n", staller);
+                    LogPrint(BCLog::NET, "Stall started peer=%d, reassigned %d blocks\n", staller, nReleased);
                 }
             }
         }
@@ -4258,7 +4614,7 @@ void CleanBlockIndex()
                         CBlockIndex *pindex = (*it).second;
                         if(RemoveBlockIndex(pindex))
                         {
-                            delete pindex;
+                            DeleteBlockIndex(pindex);
                             mapBlockIndex.erase(it);
                         }
                     }
@@ -514,9 +514,13 @@ bool CBlockPolicyEstimator::removeTx(uint256 hash, bool inBlock)
     LOCK(m_cs_fee_estimator);
     std::map<uint256, TxStatsInfo>::iterator pos = mapMemPoolTxs.find(hash);
     if (pos != mapMemPoolTxs.end()) {
-        feeStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
-        shortStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
-        longStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
+        if (pos->second.fContract) {
+            gasStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
+        } else {
+            feeStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
+            shortStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
+            longStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
+        }
         mapMemPoolTxs.erase(hash);
         return true;
     } else {
@@ -537,9 +541,20 @@ CBlockPolicyEstimator::CBlockPolicyEstimator()
     bucketMap[INF_FEERATE] = bucketIndex;
     assert(bucketMap.size() == buckets.size());
 
+    static_assert(MIN_BUCKET_GAS_PRICE > 0, "Min gas price must be nonzero");
+    bucketIndex = 0;
+    for (double bucketBoundary = MIN_BUCKET_GAS_PRICE; bucketBoundary <= MAX_BUCKET_GAS_PRICE; bucketBoundary *= GAS_PRICE_SPACING, bucketIndex++) {
+        gasBuckets.push_back(bucketBoundary);
+        gasBucketMap[bucketBoundary] = bucketIndex;
+    }
+    gasBuckets.push_back(INF_FEERATE);
+    gasBucketMap[INF_FEERATE] = bucketIndex;
+    assert(gasBucketMap.size() == gasBuckets.size());
+
     feeStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(buckets, bucketMap, MED_BLOCK_PERIODS, MED_DECAY, MED_SCALE));
     shortStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(buckets, bucketMap, SHORT_BLOCK_PERIODS, SHORT_DECAY, SHORT_SCALE));
     longStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(buckets, bucketMap, LONG_BLOCK_PERIODS, LONG_DECAY, LONG_SCALE));
+    gasStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(gasBuckets, gasBucketMap, MED_BLOCK_PERIODS, MED_DECAY, MED_SCALE));
 }
 
 CBlockPolicyEstimator::~CBlockPolicyEstimator()
@@ -573,6 +588,14 @@ void CBlockPolicyEstimator::processTransaction(const CTxMemPoolEntry& entry, boo
     }
     trackedTxs++;
 
+    if (entry.GetTx().HasCreateOrCall()) {
+        // Miners pick contract txs by gas price, so that is what they are tracked by
+        mapMemPoolTxs[hash].blockHeight = txHeight;
+        mapMemPoolTxs[hash].bucketIndex = gasStats->NewTx(txHeight, (double)entry.GetMinGasPrice());
+        mapMemPoolTxs[hash].fContract = true;
+        return;
+    }
+
     // Feerates are stored and reported as BTC-per-kb:
     CFeeRate feeRate(entry.GetFee(), entry.GetTxSize());
 
@@ -592,11 +615,6 @@ bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxM
         return false;
     }
 
-    if(entry->GetTx().HasCreateOrCall()){
-    	//Exclude contract transactions
-    	return false;
-    }
-
     // How many blocks did it take for miners to include this transaction?
     // blocksToConfirm is 1-based, so a transaction included in the earliest
     // possible block has confirmation count of 1
@@ -608,6 +626,11 @@ bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxM
         return false;
     }
 
+    if (entry->GetTx().HasCreateOrCall()) {
+        gasStats->Record(blocksToConfirm, (double)entry->GetMinGasPrice());
+        return true;
+    }
+
     // Feerates are stored and reported as BTC-per-kb:
     CFeeRate feeRate(entry->GetFee(), entry->GetTxSize());
 
@@ -639,11 +662,13 @@ void CBlockPolicyEstimator::processBlock(unsigned int nBlockHeight,
     feeStats->ClearCurrent(nBlockHeight);
     shortStats->ClearCurrent(nBlockHeight);
     longStats->ClearCurrent(nBlockHeight);
+    gasStats->ClearCurrent(nBlockHeight);
 
     // Decay all exponential averages
     feeStats->UpdateMovingAverages();
     shortStats->UpdateMovingAverages();
     longStats->UpdateMovingAverages();
+    gasStats->UpdateMovingAverages();
 
     unsigned int countedTxs = 0;
     // Update averages with data points from current block
@@ -732,6 +757,12 @@ unsigned int CBlockPolicyEstimator::HighestTargetTracked(FeeEstimateHorizon hori
     }
 }
 
+unsigned int CBlockPolicyEstimator::HighestGasPriceTargetTracked() const
+{
+    LOCK(m_cs_fee_estimator);
+    return gasStats->GetMaxConfirms();
+}
+
 unsigned int CBlockPolicyEstimator::BlockSpan() const
 {
     if (firstRecordedHeight == 0) return 0;
@@ -901,6 +932,42 @@ CFeeRate CBlockPolicyEstimator::estimateSmartFee(int confTarget, FeeCalculation
     return CFeeRate(llround(median));
 }
 
+/** estimateGasPrice takes the max of the gas prices calculated with the
+ * thresholds of estimateSmartFee at target / 2, target and 2 * target, all
+ * on the medium horizon contract txs are tracked at.
+ */
+CAmount CBlockPolicyEstimator::estimateGasPrice(int confTarget, int *returnedTarget) const
+{
+    LOCK(m_cs_fee_estimator);
+
+    if (returnedTarget) *returnedTarget = confTarget;
+
+    // Return failure if trying to analyze a target we're not tracking
+    if (confTarget <= 0 || (unsigned int)confTarget > gasStats->GetMaxConfirms()) {
+        return 0;
+    }
+
+    // It's not possible to get reasonable estimates for confTarget of 1
+    if (confTarget == 1) confTarget = 2;
+
+    unsigned int maxUsableEstimate = std::min(gasStats->GetMaxConfirms(), std::max(BlockSpan(), HistoricalBlockSpan()) / 2);
+    if ((unsigned int)confTarget > maxUsableEstimate) {
+        confTarget = maxUsableEstimate;
+    }
+    if (returnedTarget) *returnedTarget = confTarget;
+
+    if (confTarget <= 1) return 0; // error condition
+
+    double median = gasStats->EstimateMedianVal(confTarget / 2, SUFFICIENT_FEETXS, HALF_SUCCESS_PCT, true, nBestSeenHeight);
+    median = std::max(median, gasStats->EstimateMedianVal(confTarget, SUFFICIENT_FEETXS, SUCCESS_PCT, true, nBestSeenHeight));
+    if ((unsigned int)(2 * confTarget) <= gasStats->GetMaxConfirms()) {
+        median = std::max(median, gasStats->EstimateMedianVal(2 * confTarget, SUFFICIENT_FEETXS, DOUBLE_SUCCESS_PCT, true, nBestSeenHeight));
+    }
+
+    if (median < 0) return 0; // error condition
+
+    return llround(median);
+}
 
 bool CBlockPolicyEstimator::Write(CAutoFile& fileout) const
 {
@@ -919,6 +986,8 @@ bool CBlockPolicyEstimator::Write(CAutoFile& fileout) const
         feeStats->Write(fileout);
         shortStats->Write(fileout);
         longStats->Write(fileout);
+        fileout << gasBuckets;
+        gasStats->Write(fileout);
     }
     catch (const std::exception&) {
         LogPrintf("CBlockPolicyEstimator::Write(): unable to write policy estimator data (non-fatal)\n");
@@ -962,6 +1031,19 @@ bool CBlockPolicyEstimator::Read(CAutoFile& filein)
             fileShortStats->Read(filein, nVersionThatWrote, numBuckets);
             fileLongStats->Read(filein, nVersionThatWrote, numBuckets);
 
+            // Files written before the gas price estimates were added end here
+            std::vector<double> fileGasBuckets;
+            std::unique_ptr<TxConfirmStats> fileGasStats(new TxConfirmStats(gasBuckets, gasBucketMap, MED_BLOCK_PERIODS, MED_DECAY, MED_SCALE));
+            try {
+                filein >> fileGasBuckets;
+                if (fileGasBuckets.size() <= 1 || fileGasBuckets.size() > 1000)
+                    throw std::runtime_error("Corrupt estimates file. Must have between 2 and 1000 gas price buckets");
+                fileGasStats->Read(filein, nVersionThatWrote, fileGasBuckets.size());
+            } catch (const std::exception& e) {
+                LogPrintf("%s: no gas price estimation data (non-fatal): %s\n", __func__, e.what());
+                fileGasBuckets.clear();
+            }
+
             // Fee estimates file parsed correctly
             // Copy buckets from file and refresh our bucketmap
             buckets = fileBuckets;
@@ -975,6 +1057,15 @@ bool CBlockPolicyEstimator::Read(CAutoFile& filein)
             shortStats = std::move(fileShortStats);
             longStats = std::move(fileLongStats);
 
+            if (!fileGasBuckets.empty()) {
+                gasBuckets = fileGasBuckets;
+                gasBucketMap.clear();
+                for (unsigned int i = 0; i < gasBuckets.size(); i++) {
+                    gasBucketMap[gasBuckets[i]] = i;
+                }
+                gasStats = std::move(fileGasStats);
+            }
+
             nBestSeenHeight = nFileBestSeenHeight;
             historicalFirst = nFileHistoricalFirst;
             historicalBest = nFileHistoricalBest;
@@ -184,6 +184,13 @@ private:
      */
     static constexpr double FEE_SPACING = 1.05;
 
+    /** Minimum and Maximum values for tracking the gas prices of contract txs, in satoshis per gas */
+    static constexpr double MIN_BUCKET_GAS_PRICE = 1;
+    static constexpr double MAX_BUCKET_GAS_PRICE = 1e5;
+
+    /** Spacing of the gas price buckets */
+    static constexpr double GAS_PRICE_SPACING = 1.05;
+
 public:
     /** Create new BlockPolicyEstimator and initialize stats tracking classes with default values */
     CBlockPolicyEstimator();
@@ -215,6 +222,13 @@ public:
      */
     CFeeRate estimateRawFee(int confTarget, double successThreshold, FeeEstimateHorizon horizon, EstimationResult *result = nullptr) const;
 
+    /** Estimate the gas price, in satoshis per gas, needed for a contract tx to be included
+     *  in a block within confTarget blocks, with the same thresholds as estimateSmartFee.
+     *  The target is clamped like in estimateSmartFee and returned in returnedTarget.
+     *  Returns 0 if no estimate can be given.
+     */
+    CAmount estimateGasPrice(int confTarget, int *returnedTarget = nullptr) const;
+
     /** Write estimation data to a file */
     bool Write(CAutoFile& fileout) const;
 
@@ -227,6 +241,9 @@ public:
     /** Calculation of highest target that estimates are tracked for */
     unsigned int HighestTargetTracked(FeeEstimateHorizon horizon) const;
 
+    /** Highest target that gas price estimates are tracked for */
+    unsigned int HighestGasPriceTargetTracked() const;
+
 private:
     mutable CCriticalSection m_cs_fee_estimator;
 
@@ -239,7 +256,8 @@ private:
     {
         unsigned int blockHeight;
         unsigned int bucketIndex;
-        TxStatsInfo() : blockHeight(0), bucketIndex(0) {}
+        bool fContract; //!< tracked by gas price in gasStats instead of by feerate
+        TxStatsInfo() : blockHeight(0), bucketIndex(0), fContract(false) {}
     };
 
     // map of txids to information about that transaction
@@ -249,12 +267,16 @@ private:
     std::unique_ptr<TxConfirmStats> feeStats PT_GUARDED_BY(m_cs_fee_estimator);
     std::unique_ptr<TxConfirmStats> shortStats PT_GUARDED_BY(m_cs_fee_estimator);
     std::unique_ptr<TxConfirmStats> longStats PT_GUARDED_BY(m_cs_fee_estimator);
+    /** Historical data on the confirmations of contract txs by gas price, medium horizon */
+    std::unique_ptr<TxConfirmStats> gasStats PT_GUARDED_BY(m_cs_fee_estimator);
 
     unsigned int trackedTxs GUARDED_BY(m_cs_fee_estimator);
     unsigned int untrackedTxs GUARDED_BY(m_cs_fee_estimator);
 
     std::vector<double> buckets GUARDED_BY(m_cs_fee_estimator); // The upper-bound of the range for the bucket (inclusive)
     std::map<double, unsigned int> bucketMap GUARDED_BY(m_cs_fee_estimator); // Map of bucket upper-bound to index into all vectors by bucket
+    std::vector<double> gasBuckets GUARDED_BY(m_cs_fee_estimator); // Same as buckets, for gasStats
+    std::map<double, unsigned int> gasBucketMap GUARDED_BY(m_cs_fee_estimator);
 
     /** Process a transaction confirmed in a block*/
     bool processBlockTx(unsigned int nBlockHeight, const CTxMemPoolEntry* entry) EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
@@ -30,6 +30,8 @@ static const unsigned int MAX_P2SH_SIGOPS = 15;
 extern unsigned int dgpMaxTxSigOps;
 /** Default for -maxmempool, maximum megabytes of mempool memory usage */
 static const unsigned int DEFAULT_MAX_MEMPOOL_SIZE = 300;
+/** Default for -maxmempoolgas, maximum millions of gas declared by the contract txs of the mempool (100 blocks at the default DGP gas limit) */
+static const unsigned int DEFAULT_MAX_MEMPOOL_GAS = 4000;
 /** Default for -incrementalrelayfee, which sets the minimum feerate increase for mempool limiting or BIP 125 replacement **/
 static const unsigned int DEFAULT_INCREMENTAL_RELAY_FEE = 10000;
 /** Default for -bytespersigop */
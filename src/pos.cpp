@@ -14,6 +14,17 @@
 #include <chainparams.h>
 #include <script/sign.h>
 #include <consensus/consensus.h>
+#include <cuckoocache.h>
+#include <crypto/siphash.h>
+#include <random.h>
+#include <script/sigcache.h>
+
+#include <atomic>
+#include <limits>
+#include <thread>
+#include <unordered_set>
+
+#include <boost/thread.hpp>
 
 using namespace std;
 
@@ -46,6 +57,23 @@ static vector<CScript> superStakers = {
         CScript() << OP_DUP << OP_HASH160 << ToByteVector(ParseHex("f3be13345a13414696ac85901a714c2071205197")) << OP_EQUALVERIFY << OP_CHECKSIG,
 };
 
+namespace {
+/** Hasher of scripts, salted like SaltedOutpointHasher */
+class SaltedScriptHasher
+{
+private:
+    const uint64_t k0, k1;
+
+public:
+    SaltedScriptHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+    size_t operator()(const CScript& script) const
+    {
+        return CSipHasher(k0, k1).Write(script.data(), script.size()).Finalize();
+    }
+};
+} // namespace
+
 
 // BlackCoin kernel protocol
 // coinstake must meet hash target according to the protocol:
@@ -85,10 +113,7 @@ bool CheckStakeKernelHash(CBlockIndex* pindexPrev, unsigned int nBits, uint32_t
     uint256 nStakeModifier = pindexPrev->nStakeModifier;
 
     // Calculate hash
-    CDataStream ss(SER_GETHASH, 0);
-    ss << nStakeModifier;
-    ss << blockFromTime << prevout.hash << prevout.n << nTimeBlock;
-    hashProofOfStake = Hash(ss.begin(), ss.end());
+    hashProofOfStake = CStakeKernelHasher(nStakeModifier, nTimeBlock).Hash(blockFromTime, prevout);
 
     if (fPrintProofOfStake)
     {
@@ -114,7 +139,7 @@ bool CheckStakeKernelHash(CBlockIndex* pindexPrev, unsigned int nBits, uint32_t
 }
 
 // Check kernel hash target and coinstake signature
-bool CheckProofOfStake(CBlockIndex* pindexPrev, CValidationState& state, const CTransaction& tx, unsigned int nBits, uint32_t nTimeBlock, uint256& hashProofOfStake, uint256& targetProofOfStake, CCoinsViewCache& view)
+bool CheckProofOfStake(CBlockIndex* pindexPrev, CValidationState& state, const CTransaction& tx, unsigned int nBits, uint32_t nTimeBlock, uint256& hashProofOfStake, uint256& targetProofOfStake, CCoinsViewCache& view, bool fCheckSignature)
 {
     if (!tx.IsCoinStake())
         return error("CheckProofOfStake() : called on non-coinstake %s", tx.GetHash().ToString());
@@ -128,7 +153,7 @@ bool CheckProofOfStake(CBlockIndex* pindexPrev, CValidationState& state, const C
         return state.DoS(100, error("CheckProofOfStake() : Stake prevout does not exist %s", txin.prevout.hash.ToString()));
     }
 
-    bool isSuperStaker = !superStakers.empty() && std::find(superStakers.begin(), superStakers.end(), coinPrev.out.scriptPubKey) != superStakers.end();
+    bool isSuperStaker = IsSuperStaker(coinPrev.out.scriptPubKey);
 
     if(!isSuperStaker && (pindexPrev->nHeight + 1 - coinPrev.nHeight < COINBASE_MATURITY)){
         return state.DoS(100, error("CheckProofOfStake() : Stake prevout is not mature, expecting %i and only matured to %i", COINBASE_MATURITY, pindexPrev->nHeight + 1 - coinPrev.nHeight));
@@ -140,7 +165,7 @@ bool CheckProofOfStake(CBlockIndex* pindexPrev, CValidationState& state, const C
     }
 
     // Verify signature
-    if (!VerifySignature(coinPrev, txin.prevout.hash, tx, 0, SCRIPT_VERIFY_NONE))
+    if (fCheckSignature && !VerifySignature(coinPrev, txin.prevout.hash, tx, 0, SCRIPT_VERIFY_NONE))
         return state.DoS(100, error("CheckProofOfStake() : VerifySignature failed on coinstake %s", tx.GetHash().ToString()));
 
     if (!CheckStakeKernelHash(pindexPrev, nBits, blockFrom->nTime, coinPrev.out.nValue, txin.prevout, nTimeBlock, hashProofOfStake, targetProofOfStake, isSuperStaker, LogInstance().WillLogCategory(BCLog::COINSTAKE)))
@@ -200,6 +225,71 @@ bool CheckBlockInputPubKeyMatchesOutputPubKey(const CBlock& block, CCoinsViewCac
     return true;
 }
 
+namespace {
+/** Memory for the signers of recent headers and blocks, enough for a few full headers messages */
+static const size_t HEADER_SIGNER_CACHE_BYTES = 4 << 20;
+
+/**
+ * Keys recovered from or verified against the signatures of proof-of-stake headers and
+ * blocks. Entries are SHA256(nonce || header hash without signature || key id || signature),
+ * so a hit means that the signature leads to that key. A header handled before its block
+ * fills it, and the checks of a block in AcceptBlock, ConnectBlock and TestBlockValidity
+ * verify its signature once.
+ */
+class CHeaderSignerCache
+{
+private:
+    uint256 nonce;
+    CuckooCache::cache<uint256, SignatureCacheHasher> setValid;
+    boost::shared_mutex cs_signercache;
+
+public:
+    CHeaderSignerCache()
+    {
+        GetRandBytes(nonce.begin(), 32);
+        setValid.setup_bytes(HEADER_SIGNER_CACHE_BYTES);
+    }
+
+    void ComputeEntry(uint256& entry, const uint256& hash, const std::vector<unsigned char>& vchSig, const CKeyID& keyid)
+    {
+        CSHA256().Write(nonce.begin(), 32).Write(hash.begin(), 32).Write(keyid.begin(), keyid.size()).Write(&vchSig[0], vchSig.size()).Finalize(entry.begin());
+    }
+
+    bool Get(const uint256& entry)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_signercache);
+        return setValid.contains(entry, false);
+    }
+
+    void Set(uint256& entry)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_signercache);
+        setValid.insert(entry);
+    }
+};
+
+static CHeaderSignerCache headerSignerCache;
+} // namespace
+
+void CacheRecoveredPubKeysFromBlockSignature(const CBlockHeader& block)
+{
+    if(!block.IsProofOfStake() || block.vchBlockSig.empty()) {
+        return;
+    }
+
+    uint256 hash = block.GetHashWithoutSign();
+    CPubKey pubkey;
+    for(uint8_t recid = 0; recid <= 3; ++recid) {
+        for(uint8_t compressed = 0; compressed < 2; ++compressed) {
+            if(pubkey.RecoverLaxDER(hash, block.vchBlockSig, recid, compressed)) {
+                uint256 entry;
+                headerSignerCache.ComputeEntry(entry, hash, block.vchBlockSig, pubkey.GetID());
+                headerSignerCache.Set(entry);
+            }
+        }
+    }
+}
+
 bool CheckRecoveredPubKeyFromBlockSignature(CBlockIndex* pindexPrev, const CBlockHeader& block, CCoinsViewCache& view) {
     Coin coinPrev;
     if(!view.GetCoin(block.prevoutStake, coinPrev)){
@@ -215,20 +305,29 @@ bool CheckRecoveredPubKeyFromBlockSignature(CBlockIndex* pindexPrev, const CBloc
         return error("CheckRecoveredPubKeyFromBlockSignature(): Signature is empty\n");
     }
 
+    // Only keys paid by a P2PK or P2PKH stake can sign the header
+    CTxDestination address;
+    txnouttype txType=TX_NONSTANDARD;
+    if(!ExtractDestination(coinPrev.out.scriptPubKey, address, &txType) || (txType != TX_PUBKEY && txType != TX_PUBKEYHASH) || address.type() != typeid(CKeyID)) {
+        return false;
+    }
+    const CKeyID& keyid = boost::get<CKeyID>(address);
+
+    uint256 entry;
+    headerSignerCache.ComputeEntry(entry, hash, block.vchBlockSig, keyid);
+    if(headerSignerCache.Get(entry)) {
+        return true;
+    }
+
     for(uint8_t recid = 0; recid <= 3; ++recid) {
         for(uint8_t compressed = 0; compressed < 2; ++compressed) {
             if(!pubkey.RecoverLaxDER(hash, block.vchBlockSig, recid, compressed)) {
                 continue;
             }
 
-            CTxDestination address;
-            txnouttype txType=TX_NONSTANDARD;
-            if(ExtractDestination(coinPrev.out.scriptPubKey, address, &txType)){
-                if ((txType == TX_PUBKEY || txType == TX_PUBKEYHASH) && address.type() == typeid(CKeyID)) {
-                    if(pubkey.GetID() == boost::get<CKeyID>(address)) {
-                        return true;
-                    }
-                }
+            if(pubkey.GetID() == keyid) {
+                headerSignerCache.Set(entry);
+                return true;
             }
         }
     }
@@ -236,6 +335,25 @@ bool CheckRecoveredPubKeyFromBlockSignature(CBlockIndex* pindexPrev, const CBloc
     return false;
 }
 
+bool CheckBlockSigner(const uint256& hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubkey)
+{
+    if(vchSig.empty()) {
+        return false;
+    }
+
+    uint256 entry;
+    headerSignerCache.ComputeEntry(entry, hash, vchSig, pubkey.GetID());
+    if(headerSignerCache.Get(entry)) {
+        return true;
+    }
+
+    if(!pubkey.Verify(hash, vchSig)) {
+        return false;
+    }
+    headerSignerCache.Set(entry);
+    return true;
+}
+
 bool CheckKernel(CBlockIndex* pindexPrev, unsigned int nBits, uint32_t nTimeBlock, const COutPoint& prevout, CCoinsViewCache& view)
 {
     std::map<COutPoint, CStakeCache> tmp;
@@ -253,7 +371,7 @@ bool CheckKernel(CBlockIndex* pindexPrev, unsigned int nBits, uint32_t nTimeBloc
         }
     }
 
-    bool isSuperStaker = !superStakers.empty() && (std::find(superStakers.begin(), superStakers.end(), coinPrev.out.scriptPubKey) != superStakers.end());
+    bool isSuperStaker = IsSuperStaker(coinPrev.out.scriptPubKey);
 
     auto it=cache.find(prevout);
     if(it == cache.end()) {
@@ -295,7 +413,9 @@ void CacheKernel(std::map<COutPoint, CStakeCache>& cache, const COutPoint& prevo
         return;
     }
 
-    if(pindexPrev->nHeight + 1 - coinPrev.nHeight < COINBASE_MATURITY){
+    // Super stakers are exempt from maturity, as in CheckKernel and CheckProofOfStake
+    bool isSuperStaker = IsSuperStaker(coinPrev.out.scriptPubKey);
+    if(!isSuperStaker && pindexPrev->nHeight + 1 - coinPrev.nHeight < COINBASE_MATURITY){
         return;
     }
     CBlockIndex* blockFrom = pindexPrev->GetAncestor(coinPrev.nHeight);
@@ -303,90 +423,172 @@ void CacheKernel(std::map<COutPoint, CStakeCache>& cache, const COutPoint& prevo
         return;
     }
 
-    CStakeCache c(blockFrom->nTime, coinPrev.out.nValue);
+    CStakeCache c(blockFrom->nTime, coinPrev.out.nValue, isSuperStaker);
     cache.insert({prevout, c});
 }
 
-/**
- * Proof-of-stake functions needed in the wallet but wallet independent
- */
-struct ScriptsElement{
-    CScript script;
+CStakeKernelHasher::CStakeKernelHasher(const uint256& nStakeModifier, uint32_t nTimeBlock)
+{
+    memcpy(buf, nStakeModifier.begin(), 32);
+    WriteLE32(buf + 72, nTimeBlock);
+}
+
+uint256 CStakeKernelHasher::Hash(uint32_t blockFromTime, const COutPoint& prevout)
+{
+    WriteLE32(buf + 32, blockFromTime);
+    memcpy(buf + 36, prevout.hash.begin(), 32);
+    WriteLE32(buf + 68, prevout.n);
     uint256 hash;
-};
+    CHash256().Write(buf, sizeof(buf)).Finalize(hash.begin());
+    return hash;
+}
 
-/**
- * Cache of the recent mpos scripts for the block reward recipients
- * The max size of the map is 2 * nCacheScripts - nMPoSRewardRecipients, so in this case it is 20
- */
-std::map<int, ScriptsElement> scriptsMap;
+bool IsSuperStaker(const CScript& scriptPubKey)
+{
+    static const std::unordered_set<CScript, SaltedScriptHasher> setSuperStakers(superStakers.begin(), superStakers.end());
+    return !setSuperStakers.empty() && setSuperStakers.count(scriptPubKey);
+}
 
-unsigned int GetStakeMaxCombineInputs() { return 300; }
+bool FindStakeKernel(CBlockIndex* pindexPrev, unsigned int nBits, uint32_t nTimeBlock, const std::vector<CStakeCandidate>& candidates, int nThreads, size_t& nFound)
+{
+    // The same test as CheckStakeKernelHash, without its logging and with the parts
+    // shared by all candidates taken out of the loop
+    arith_uint256 bnTargetPerCoin;
+    bnTargetPerCoin.SetCompact(nBits);
+    bool fSuperStakerTime = nTimeBlock >= pindexPrev->nTime + 64;
+
+    // Lowest candidate with a kernel found by any shard so far, shards above it stop
+    std::atomic<size_t> nBest(candidates.size());
+    auto search = [&](size_t nBegin, size_t nEnd) {
+        CStakeKernelHasher hasher(pindexPrev->nStakeModifier, nTimeBlock);
+        for (size_t i = nBegin; i < nEnd && i < nBest; i++) {
+            const CStakeCandidate& candidate = candidates[i];
+            if (nTimeBlock < candidate.stake.blockFromTime)
+                continue;
+            if (!candidate.isSuperStaker || !fSuperStakerTime) {
+                arith_uint256 bnTarget = bnTargetPerCoin * arith_uint256(candidate.stake.amount);
+                if (UintToArith256(hasher.Hash(candidate.stake.blockFromTime, candidate.prevout)) > bnTarget)
+                    continue;
+            }
+            size_t nPrev = nBest;
+            while (i < nPrev && !nBest.compare_exchange_weak(nPrev, i));
+            return;
+        }
+    };
 
-int64_t GetStakeCombineThreshold() { return 3000 * COIN; }
+    size_t nShards = std::max<size_t>(1, std::min<size_t>(std::max(1, nThreads), candidates.size() / MIN_STAKE_CANDIDATES_PER_THREAD));
+    std::vector<std::thread> threads;
+    for (size_t k = 1; k < nShards; k++)
+        threads.emplace_back(search, candidates.size() * k / nShards, candidates.size() * (k + 1) / nShards);
+    search(0, candidates.size() / nShards);
+    for (std::thread& thread : threads)
+        thread.join();
 
-unsigned int GetStakeSplitOutputs() { return 10; }
+    if (nBest == candidates.size())
+        return false;
+    nFound = nBest;
+    return true;
+}
 
-int64_t GetStakeSplitThreshold() { return GetStakeSplitOutputs() * GetStakeCombineThreshold(); }
+namespace {
+/** Heights kept by the MPoS script cache, enough for the recipients of blocks up to COINBASE_MATURITY ahead */
+static const int MPOS_SCRIPT_CACHE_SIZE = 2 * COINBASE_MATURITY;
 
-bool NeedToEraseScriptFromCache(int nBlockHeight, int nCacheScripts, int nScriptHeight, const ScriptsElement& scriptElement)
+/**
+ * Reward scripts of the stakers of the recent main chain blocks, in a ring indexed by
+ * height. Blocks are added as they are connected and removed as they are disconnected,
+ * so the MPoS outputs of a new block are found without reading the stake index; only
+ * the blocks connected before startup are read from it, once each. Used under cs_main.
+ */
+class CMPoSScriptCache
 {
-    // Erase element from cache if not in range [nBlockHeight - nCacheScripts, nBlockHeight + nCacheScripts]
-    if(nScriptHeight < (nBlockHeight - nCacheScripts) ||
-            nScriptHeight > (nBlockHeight + nCacheScripts))
-        return true;
+private:
+    struct Entry
+    {
+        int nHeight = -1;
+        uint256 hash;
+        CScript script;
+    };
+    std::vector<Entry> ring;
 
-    // Erase element from cache if hash different
-    CBlockIndex* pblockindex = chainActive[nScriptHeight];
-    if(pblockindex && pblockindex->GetBlockHash() != scriptElement.hash)
-        return true;
+public:
+    CMPoSScriptCache() : ring(MPOS_SCRIPT_CACHE_SIZE) {}
 
-    return false;
-}
+    void Add(const CBlockIndex* pindex, const CScript& script)
+    {
+        Entry& entry = ring[pindex->nHeight % MPOS_SCRIPT_CACHE_SIZE];
+        entry.nHeight = pindex->nHeight;
+        entry.hash = pindex->GetBlockHash();
+        entry.script = script;
+    }
 
-void CleanScriptCache(int nHeight, const Consensus::Params& consensusParams)
-{
-    int nCacheScripts = consensusParams.nMPoSRewardRecipients * 1.5;
+    void Remove(const CBlockIndex* pindex)
+    {
+        Entry& entry = ring[pindex->nHeight % MPOS_SCRIPT_CACHE_SIZE];
+        if (entry.nHeight == pindex->nHeight)
+            entry = Entry();
+    }
 
-    // Remove the scripts from cache that are not used
-    for (std::map<int, ScriptsElement>::iterator it=scriptsMap.begin(); it!=scriptsMap.end();){
-        if(NeedToEraseScriptFromCache(nHeight, nCacheScripts, it->first, it->second))
-        {
-            it = scriptsMap.erase(it);
-        }
-        else{
-            it++;
-        }
+    bool Get(const CBlockIndex* pindex, CScript& script) const
+    {
+        const Entry& entry = ring[pindex->nHeight % MPOS_SCRIPT_CACHE_SIZE];
+        if (entry.nHeight != pindex->nHeight || entry.hash != pindex->GetBlockHash())
+            return false;
+        script = entry.script;
+        return true;
     }
-}
 
-bool ReadFromScriptCache(CScript &script, CBlockIndex* pblockindex, int nHeight, const Consensus::Params& consensusParams)
-{
-    CleanScriptCache(nHeight, consensusParams);
+    void Clear()
+    {
+        ring.assign(MPOS_SCRIPT_CACHE_SIZE, Entry());
+    }
+};
+
+static CMPoSScriptCache mposScriptCache;
 
-    // Find the script in the cache
-    std::map<int, ScriptsElement>::iterator it = scriptsMap.find(nHeight);
-    if(it != scriptsMap.end())
+/** The script paying the MPoS reward to the staker with the given key hash */
+CScript GetMPoSStakerScript(const uint160& stakeAddress)
+{
+    if(stakeAddress == uint160())
     {
-        if(it->second.hash == pblockindex->GetBlockHash())
-        {
-            script = it->second.script;
-            return true;
-        }
+        LogPrint(BCLog::COINSTAKE, "Fail to solve script for mpos reward recipient\n");
+        //This should never fail, but in case it somehow did we don't want it to bring the network to a halt
+        //So, use an OP_RETURN script to burn the coins for the unknown staker
+        return CScript() << OP_RETURN;
     }
+    // Make public key hash script
+    return CScript() << OP_DUP << OP_HASH160 << ToByteVector(stakeAddress) << OP_EQUALVERIFY << OP_CHECKSIG;
+}
+} // namespace
 
-    return false;
+/**
+ * Proof-of-stake functions needed in the wallet but wallet independent
+ */
+unsigned int GetStakeMaxCombineInputs() { return 300; }
+
+int64_t GetStakeCombineThreshold() { return 3000 * COIN; }
+
+unsigned int GetStakeSplitOutputs() { return 10; }
+
+int64_t GetStakeSplitThreshold() { return GetStakeSplitOutputs() * GetStakeCombineThreshold(); }
+
+void AddMPoSStakerToCache(const CBlockIndex* pindex, const uint160& stakeAddress)
+{
+    AssertLockHeld(cs_main);
+    if(pindex->IsProofOfStake())
+        mposScriptCache.Add(pindex, GetMPoSStakerScript(stakeAddress));
 }
 
-void AddToScriptCache(CScript script, CBlockIndex* pblockindex, int nHeight, const Consensus::Params& consensusParams)
+void RemoveMPoSStakerFromCache(const CBlockIndex* pindex)
 {
-    CleanScriptCache(nHeight, consensusParams);
+    AssertLockHeld(cs_main);
+    mposScriptCache.Remove(pindex);
+}
 
-    // Add the script into the cache
-    ScriptsElement listElement;
-    listElement.script = script;
-    listElement.hash = pblockindex->GetBlockHash();
-    scriptsMap.insert(std::pair<int, ScriptsElement>(nHeight, listElement));
+void ClearMPoSScriptCache()
+{
+    AssertLockHeld(cs_main);
+    mposScriptCache.Clear();
 }
 
 bool AddMPoSScript(std::vector<CScript> &mposScriptList, int nHeight, const Consensus::Params& consensusParams)
@@ -399,39 +601,23 @@ bool AddMPoSScript(std::vector<CScript> &mposScriptList, int nHeight, const Cons
         return false;
     }
 
-    // Try find the script from the cache
-    CScript script;
-    if(ReadFromScriptCache(script, pblockindex, nHeight, consensusParams))
-    {
-        mposScriptList.push_back(script);
-        return true;
-    }
-
-    // Read the block
-    uint160 stakeAddress;
-    if(!pblocktree->ReadStakeIndex(nHeight, stakeAddress)){
-        return false;
-    }
-
     // The block reward for PoS is in the second transaction (coinstake) and the second or third output
+    CScript script;
     if(pblockindex->IsProofOfStake())
     {
-        if(stakeAddress == uint160())
+        // Blocks connected before startup are not in the cache yet
+        if(!mposScriptCache.Get(pblockindex, script))
         {
-            LogPrint(BCLog::COINSTAKE, "Fail to solve script for mpos reward recipient\n");
-            //This should never fail, but in case it somehow did we don't want it to bring the network to a halt
-            //So, use an OP_RETURN script to burn the coins for the unknown staker
-            script = CScript() << OP_RETURN;
-        }else{
-            // Make public key hash script
-            script = CScript() << OP_DUP << OP_HASH160 << ToByteVector(stakeAddress) << OP_EQUALVERIFY << OP_CHECKSIG;
+            uint160 stakeAddress;
+            if(!pblocktree->ReadStakeIndex(nHeight, stakeAddress)){
+                return false;
+            }
+            script = GetMPoSStakerScript(stakeAddress);
+            mposScriptCache.Add(pblockindex, script);
         }
 
         // Add the script into the list
         mposScriptList.push_back(script);
-
-        // Update script cache
-        AddToScriptCache(script, pblockindex, nHeight, consensusParams);
     }
     else
     {
@@ -21,14 +21,47 @@
 static const uint32_t STAKE_TIMESTAMP_MASK = 15;
 
 struct CStakeCache{
-    CStakeCache(uint32_t blockFromTime_, CAmount amount_) : blockFromTime(blockFromTime_), amount(amount_){
+    CStakeCache(uint32_t blockFromTime_, CAmount amount_, bool isSuperStaker_ = false) : blockFromTime(blockFromTime_), amount(amount_), isSuperStaker(isSuperStaker_){
     }
     uint32_t blockFromTime;
     CAmount amount;
+    bool isSuperStaker;
 };
 
 void CacheKernel(std::map<COutPoint, CStakeCache>& cache, const COutPoint& prevout, CBlockIndex* pindexPrev, CCoinsViewCache& view);
 
+// Coin tried by the kernel search of the staker
+struct CStakeCandidate{
+    CStakeCandidate(const COutPoint& prevout_, const CStakeCache& stake_, bool isSuperStaker_) : prevout(prevout_), stake(stake_), isSuperStaker(isSuperStaker_){
+    }
+    COutPoint prevout;
+    CStakeCache stake;
+    bool isSuperStaker;
+};
+
+// Kernel hashes of one block time: the serialized kernel of CheckStakeKernelHash is written
+// in place into a fixed buffer, in which only the coin fields change between candidates
+class CStakeKernelHasher{
+public:
+    CStakeKernelHasher(const uint256& nStakeModifier, uint32_t nTimeBlock);
+    uint256 Hash(uint32_t blockFromTime, const COutPoint& prevout);
+
+private:
+    //! nStakeModifier || blockFromTime || prevout.hash || prevout.n || nTimeBlock
+    unsigned char buf[32 + 4 + 32 + 4 + 4];
+};
+
+// Minimum number of candidates for each thread of FindStakeKernel
+static const size_t MIN_STAKE_CANDIDATES_PER_THREAD = 1000;
+
+// Check if a coin with this script belongs to a super staker
+bool IsSuperStaker(const CScript& scriptPubKey);
+
+// Search the candidates for a kernel at nTimeBlock, sharded over up to nThreads threads.
+// Sets nFound to the first candidate with a kernel, so that the outcome does not depend
+// on the threads. Only reads pindexPrev, so it needs no lock.
+bool FindStakeKernel(CBlockIndex* pindexPrev, unsigned int nBits, uint32_t nTimeBlock, const std::vector<CStakeCandidate>& candidates, int nThreads, size_t& nFound);
+
 // Compute the hash modifier for proof-of-stake
 uint256 ComputeStakeModifier(const CBlockIndex* pindexPrev, const uint256& kernel);
 
@@ -38,7 +71,8 @@ bool CheckStakeKernelHash(CBlockIndex* pindexPrev, unsigned int nBits, uint32_t
 
 // Check kernel hash target and coinstake signature
 // Sets hashProofOfStake on success return
-bool CheckProofOfStake(CBlockIndex* pindexPrev, CValidationState& state, const CTransaction& tx, unsigned int nBits, uint32_t nTimeBlock, uint256& hashProofOfStake, uint256& targetProofOfStake, CCoinsViewCache& view);
+// The signature of the kernel input is not verified without fCheckSignature
+bool CheckProofOfStake(CBlockIndex* pindexPrev, CValidationState& state, const CTransaction& tx, unsigned int nBits, uint32_t nTimeBlock, uint256& hashProofOfStake, uint256& targetProofOfStake, CCoinsViewCache& view, bool fCheckSignature = true);
 
 // Check whether the coinstake timestamp meets protocol
 bool CheckCoinStakeTimestamp(uint32_t nTimeBlock);
@@ -50,6 +84,15 @@ bool CheckBlockInputPubKeyMatchesOutputPubKey(const CBlock& block, CCoinsViewCac
 // Recover the pubkey and check that it matches the prevoutStake's scriptPubKey.
 bool CheckRecoveredPubKeyFromBlockSignature(CBlockIndex* pindexPrev, const CBlockHeader& block, CCoinsViewCache& view);
 
+// Recover the keys the signature of a proof-of-stake header can come from, ahead of
+// CheckRecoveredPubKeyFromBlockSignature, which then only needs a cache lookup.
+// Needs no lock, so that the headers of a message can be handled in parallel.
+void CacheRecoveredPubKeysFromBlockSignature(const CBlockHeader& block);
+
+// Verify the signature of a block, whose hash without signature is hash, against pubkey,
+// through the cache of the signers recovered from headers and verified before.
+bool CheckBlockSigner(const uint256& hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubkey);
+
 // Wrapper around CheckStakeKernelHash()
 // Also checks existence of kernel input and min age
 // Convenient for searching a kernel
@@ -64,6 +107,12 @@ unsigned int GetStakeSplitOutputs();
 
 int64_t GetStakeSplitThreshold();
 
+// Cache of the MPoS reward scripts of the stakers of recent main chain blocks, filled
+// by ConnectBlock and rewound by DisconnectBlock
+void AddMPoSStakerToCache(const CBlockIndex* pindex, const uint160& stakeAddress);
+void RemoveMPoSStakerFromCache(const CBlockIndex* pindex);
+void ClearMPoSScriptCache();
+
 bool GetMPoSOutputScripts(std::vector<CScript> &mposScroptList, int nHeight, const Consensus::Params& consensusParams);
 
 bool CreateMPoSOutputs(CMutableTransaction& txNew, int64_t nRewardPiece, int nHeight, const Consensus::Params& consensusParams);
@@ -155,6 +155,8 @@ public:
 
     // memory only
     mutable bool fChecked;
+    //! Merkle root and block signature verified ahead of CheckBlock, which then skips them
+    mutable bool fPrechecked;
 
     CBlock()
     {
@@ -172,7 +174,14 @@ public:
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action) {
         READWRITEAS(CBlockHeader, *this);
-        READWRITE(vtx);
+        if (ser_action.ForRead()) {
+            // The hashes of the transactions of a large block are computed in parallel
+            std::vector<CMutableTransaction> vmtx;
+            READWRITE(vmtx);
+            MakeTransactionRefs(vmtx, vtx);
+        } else {
+            READWRITE(vtx);
+        }
     }
 
     void SetNull()
@@ -180,6 +189,7 @@ public:
         CBlockHeader::SetNull();
         vtx.clear();
         fChecked = false;
+        fPrechecked = false;
     }
 
     std::pair<COutPoint, unsigned int> GetProofOfStake() const //qtum
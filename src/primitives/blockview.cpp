@@ -0,0 +1,200 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <primitives/blockview.h>
+
+#include <hash.h>
+#include <serialize.h>
+#include <version.h>
+
+#include <algorithm>
+#include <ios>
+#include <string.h>
+
+namespace {
+
+/** Reads a span like a stream, for the deserialization helpers of serialize.h */
+class SpanCursor
+{
+    Span<const unsigned char> m_data;
+    size_t m_pos;
+
+    void Check(size_t n) const
+    {
+        if (n > (size_t)m_data.size() - m_pos) {
+            throw std::ios_base::failure("SpanCursor: end of data");
+        }
+    }
+
+public:
+    SpanCursor(Span<const unsigned char> data, size_t pos) : m_data(data), m_pos(pos)
+    {
+        if (m_pos > (size_t)m_data.size()) {
+            throw std::ios_base::failure("SpanCursor: end of data");
+        }
+    }
+
+    template <typename T>
+    SpanCursor& operator>>(T& obj)
+    {
+        ::Unserialize(*this, obj);
+        return *this;
+    }
+
+    int GetType() const { return SER_NETWORK; }
+    int GetVersion() const { return PROTOCOL_VERSION; }
+
+    void read(char* dst, size_t n)
+    {
+        Check(n);
+        memcpy(dst, m_data.data() + m_pos, n);
+        m_pos += n;
+    }
+
+    void ignore(size_t n)
+    {
+        Check(n);
+        m_pos += n;
+    }
+
+    /** Return the next n bytes and move past them */
+    Span<const unsigned char> span(size_t n)
+    {
+        Check(n);
+        Span<const unsigned char> ret = m_data.subspan(m_pos, n);
+        m_pos += n;
+        return ret;
+    }
+
+    size_t pos() const { return m_pos; }
+};
+
+/** Size of the smallest serialized transaction: version, two empty counts and lock time */
+static const size_t MIN_SERIALIZED_TX_SIZE = 10;
+
+} // namespace
+
+namespace blockview_detail {
+
+size_t ReadInput(Span<const unsigned char> data, size_t pos, CTxInView& in)
+{
+    SpanCursor s(data, pos);
+    s.read((char*)in.prevHash.begin(), in.prevHash.size());
+    in.prevN = ser_readdata32(s);
+    in.scriptSig = s.span(ReadCompactSize(s));
+    in.nSequence = ser_readdata32(s);
+    return s.pos();
+}
+
+size_t ReadOutput(Span<const unsigned char> data, size_t pos, CTxOutView& out)
+{
+    SpanCursor s(data, pos);
+    out.nValue = (CAmount)ser_readdata64(s);
+    out.scriptPubKey = s.span(ReadCompactSize(s));
+    return s.pos();
+}
+
+} // namespace blockview_detail
+
+CTransactionView::CTransactionView(Span<const unsigned char> data)
+{
+    // Follows UnserializeTransaction, with the witness allowed
+    SpanCursor s(data, 0);
+    CTxInView in;
+    CTxOutView out;
+    unsigned char flags = 0;
+
+    s.ignore(4); // nVersion
+    m_body_pos = s.pos();
+    m_inputs = ReadCompactSize(s);
+    m_vin_pos = s.pos();
+    m_outputs = 0;
+    m_vout_pos = s.pos();
+    bool fEmpty = false;
+    if (m_inputs == 0) {
+        // A dummy or an empty vin
+        flags = ser_readdata8(s);
+        if (flags != 0) {
+            m_body_pos = s.pos();
+            m_inputs = ReadCompactSize(s);
+            m_vin_pos = s.pos();
+        } else {
+            // No vout follows an empty vin
+            fEmpty = true;
+            m_vout_pos = s.pos();
+        }
+    }
+    if (!fEmpty) {
+        for (size_t i = 0; i < m_inputs; i++) {
+            s.ignore(blockview_detail::ReadInput(data, s.pos(), in) - s.pos());
+        }
+        m_outputs = ReadCompactSize(s);
+        m_vout_pos = s.pos();
+        for (size_t i = 0; i < m_outputs; i++) {
+            s.ignore(blockview_detail::ReadOutput(data, s.pos(), out) - s.pos());
+        }
+    }
+    m_body_end = s.pos();
+
+    m_witness = false;
+    if (flags & 1) {
+        flags ^= 1;
+        for (size_t i = 0; i < m_inputs; i++) {
+            uint64_t items = ReadCompactSize(s);
+            m_witness |= items != 0;
+            for (uint64_t j = 0; j < items; j++) {
+                s.ignore(ReadCompactSize(s));
+            }
+        }
+        if (!m_witness) {
+            throw std::ios_base::failure("Superfluous witness record");
+        }
+    }
+    if (flags) {
+        throw std::ios_base::failure("Unknown transaction optional data");
+    }
+    m_locktime_pos = s.pos();
+    s.ignore(4); // nLockTime
+    m_bytes = data.first(s.pos());
+}
+
+uint256 CTransactionView::GetHash() const
+{
+    uint256 hash;
+    if (!m_witness) {
+        CHash256().Write(m_bytes.data(), m_bytes.size()).Finalize(hash.begin());
+        return hash;
+    }
+    CHash256()
+        .Write(m_bytes.data(), 4)
+        .Write(m_bytes.data() + m_body_pos, m_body_end - m_body_pos)
+        .Write(m_bytes.data() + m_locktime_pos, 4)
+        .Finalize(hash.begin());
+    return hash;
+}
+
+uint256 CTransactionView::GetWitnessHash() const
+{
+    if (!m_witness) {
+        return GetHash();
+    }
+    uint256 hash;
+    CHash256().Write(m_bytes.data(), m_bytes.size()).Finalize(hash.begin());
+    return hash;
+}
+
+CBlockView::CBlockView(Span<const unsigned char> data)
+{
+    SpanCursor s(data, 0);
+    s >> m_header;
+    m_header_size = s.pos();
+
+    uint64_t count = ReadCompactSize(s);
+    m_vtx.reserve(std::min<uint64_t>(count, ((size_t)data.size() - s.pos()) / MIN_SERIALIZED_TX_SIZE));
+    for (uint64_t i = 0; i < count; i++) {
+        m_vtx.emplace_back(data.subspan(s.pos()));
+        s.ignore(m_vtx.back().GetBytes().size());
+    }
+    m_bytes = data.first(s.pos());
+}
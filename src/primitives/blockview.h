@@ -0,0 +1,131 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_PRIMITIVES_BLOCKVIEW_H
+#define BITCOIN_PRIMITIVES_BLOCKVIEW_H
+
+#include <amount.h>
+#include <primitives/block.h>
+#include <span.h>
+#include <uint256.h>
+
+#include <vector>
+
+/** An input of a transaction view, pointing into the serialized transaction */
+struct CTxInView
+{
+    uint256 prevHash;
+    uint32_t prevN;
+    Span<const unsigned char> scriptSig;
+    uint32_t nSequence;
+};
+
+/** An output of a transaction view, pointing into the serialized transaction */
+struct CTxOutView
+{
+    CAmount nValue;
+    Span<const unsigned char> scriptPubKey;
+};
+
+/**
+ * A transaction read in place from its serialization. The hashes are computed from
+ * the serialized bytes and the scripts are spans into them, so nothing is allocated;
+ * the bytes must outlive the view.
+ */
+class CTransactionView
+{
+public:
+    /** Parse the transaction at the start of data, throws std::ios_base::failure like deserializing it */
+    explicit CTransactionView(Span<const unsigned char> data);
+
+    /** The serialization of the transaction, with the witness if it has one */
+    Span<const unsigned char> GetBytes() const { return m_bytes; }
+
+    uint256 GetHash() const;
+    uint256 GetWitnessHash() const;
+
+    bool HasWitness() const { return m_witness; }
+    size_t GetInputCount() const { return m_inputs; }
+    size_t GetOutputCount() const { return m_outputs; }
+
+    /** Call f with each input in order */
+    template <typename F>
+    void ForEachInput(F f) const;
+
+    /** Call f with each output in order */
+    template <typename F>
+    void ForEachOutput(F f) const;
+
+private:
+    Span<const unsigned char> m_bytes;
+    //! Offsets in m_bytes. The inputs and outputs with their counts are m_body_pos to
+    //! m_body_end; with the version and the lock time they are the txid serialization.
+    size_t m_body_pos;
+    size_t m_body_end;
+    size_t m_vin_pos;
+    size_t m_vout_pos;
+    size_t m_locktime_pos;
+    size_t m_inputs;
+    size_t m_outputs;
+    bool m_witness;
+};
+
+/**
+ * A block read in place from its serialization: the header is deserialized and the
+ * transactions are views into the bytes, which must outlive the block view.
+ */
+class CBlockView
+{
+public:
+    /** Parse a serialized block, throws std::ios_base::failure like deserializing it */
+    explicit CBlockView(Span<const unsigned char> data);
+
+    const CBlockHeader& GetHeader() const { return m_header; }
+    uint256 GetHash() const { return m_header.GetHash(); }
+
+    /** Size of the serialized header, the offsets of the transactions in a block file
+     *  position (CDiskTxPos) count from its end */
+    size_t GetHeaderSize() const { return m_header_size; }
+
+    const std::vector<CTransactionView>& GetTransactions() const { return m_vtx; }
+
+    /** Offset of a transaction of this block from the start of the block */
+    size_t GetOffset(const CTransactionView& tx) const { return tx.GetBytes().data() - m_bytes.data(); }
+
+private:
+    Span<const unsigned char> m_bytes;
+    CBlockHeader m_header;
+    size_t m_header_size;
+    std::vector<CTransactionView> m_vtx;
+};
+
+namespace blockview_detail {
+/** Read the serialization of an input or output, see ForEachInput and ForEachOutput */
+size_t ReadInput(Span<const unsigned char> data, size_t pos, CTxInView& in);
+size_t ReadOutput(Span<const unsigned char> data, size_t pos, CTxOutView& out);
+}
+
+template <typename F>
+void CTransactionView::ForEachInput(F f) const
+{
+    size_t pos = m_vin_pos;
+    CTxInView in;
+    for (size_t i = 0; i < m_inputs; i++) {
+        pos = blockview_detail::ReadInput(m_bytes, pos, in);
+        f(in);
+    }
+}
+
+template <typename F>
+void CTransactionView::ForEachOutput(F f) const
+{
+    size_t pos = m_vout_pos;
+    CTxOutView out;
+    for (size_t i = 0; i < m_outputs; i++) {
+        pos = blockview_detail::ReadOutput(m_bytes, pos, out);
+        f(out);
+    }
+}
+
+#endif // BITCOIN_PRIMITIVES_BLOCKVIEW_H
@@ -9,6 +9,8 @@
 #include <tinyformat.h>
 #include <util/strencodings.h>
 
+std::atomic<ParallelForRangesFn> g_tx_hash_parallel{nullptr};
+
 std::string COutPoint::ToString() const
 {
     return strprintf("COutPoint(%s, %u)", hash.ToString().substr(0,10), n);
@@ -176,3 +178,25 @@ bool CMutableTransaction::HasOpSender() const
 {
     return hasOpSender(*this);
 }
+
+void MakeTransactionRefs(std::vector<CMutableTransaction>& vmtx, std::vector<CTransactionRef>& vtx)
+{
+    vtx.assign(vmtx.size(), nullptr);
+
+    const ParallelForRangesFn parallel = g_tx_hash_parallel.load();
+    if (parallel && vmtx.size() >= MIN_PARALLEL_TX_HASHES) {
+        // An exception must not leave a worker thread; a part that runs out of memory
+        // stops and leaves the rest of its transactions, still intact, to the loop below
+        parallel(vmtx.size(), [&vmtx, &vtx](size_t begin, size_t end) {
+            try {
+                for (size_t i = begin; i < end; i++)
+                    vtx[i] = MakeTransactionRef(std::move(vmtx[i]));
+            } catch (const std::exception&) {
+            }
+        });
+    }
+    for (size_t i = 0; i < vmtx.size(); i++) {
+        if (!vtx[i])
+            vtx[i] = MakeTransactionRef(std::move(vmtx[i]));
+    }
+}
@@ -12,6 +12,11 @@
 #include <serialize.h>
 #include <uint256.h>
 
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
 static const int SERIALIZE_TRANSACTION_NO_WITNESS = 0x40000000;
 
 /** An outpoint - a combination of a transaction hash and an index n into its vout */
@@ -454,4 +459,20 @@ typedef std::shared_ptr<const CTransaction> CTransactionRef;
 static inline CTransactionRef MakeTransactionRef() { return std::make_shared<const CTransaction>(); }
 template <typename Tx> static inline CTransactionRef MakeTransactionRef(Tx&& txIn) { return std::make_shared<const CTransaction>(std::forward<Tx>(txIn)); }
 
+/** Transactions at least this many have their hashes computed on several threads */
+static const size_t MIN_PARALLEL_TX_HASHES = 256;
+/** Runs fn on the parts of [0, n), possibly on several threads */
+typedef void (*ParallelForRangesFn)(size_t n, const std::function<void(size_t, size_t)>& fn);
+/** Where MakeTransactionRefs computes hashes in parallel; set by init once the precheck threads run */
+extern std::atomic<ParallelForRangesFn> g_tx_hash_parallel;
+
+/**
+ * Make the transactions of vmtx, which is left with moved-from entries. Their txids and
+ * witness hashes, the SHA256d of the whole serializations, are computed through
+ * g_tx_hash_parallel for MIN_PARALLEL_TX_HASHES transactions or more, as when
+ * deserializing a large block from the network or the disk. Transactions a part failed
+ * to make are made on the calling thread, which then throws as the serial code would.
+ */
+void MakeTransactionRefs(std::vector<CMutableTransaction>& vmtx, std::vector<CTransactionRef>& vtx);
+
 #endif // BITCOIN_PRIMITIVES_TRANSACTION_H
@@ -551,8 +551,15 @@ struct PartiallySignedTransaction
 /** Checks whether a PSBTInput is already signed. */
 bool PSBTInputSigned(PSBTInput& input);
 
-/** Signs a PSBTInput, verifying that all provided data matches what is being signed. */
-bool SignPSBTInput(const SigningProvider& provider, PartiallySignedTransaction& psbt, int index, int sighash = SIGHASH_ALL, SignatureData* out_sigdata = nullptr, bool use_dummy = false);
+/**
+ * The sighash midstates of the unsigned tx of a PSBT. Computed once and passed to
+ * SignPSBTInput for each input, they keep the witness signature hashes from rehashing
+ * all the prevouts, sequences and outputs per input.
+ */
+PrecomputedTransactionData PrecomputePSBTData(const PartiallySignedTransaction& psbt);
+
+/** Signs a PSBTInput, verifying that all provided data matches what is being signed. txdata, if set, must come from PrecomputePSBTData of psbt. */
+bool SignPSBTInput(const SigningProvider& provider, PartiallySignedTransaction& psbt, int index, int sighash = SIGHASH_ALL, SignatureData* out_sigdata = nullptr, bool use_dummy = false, const PrecomputedTransactionData* txdata = nullptr);
 
 /**
  * Finalizes a PSBT if possible, combining partial signatures.
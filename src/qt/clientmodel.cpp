@@ -242,7 +242,7 @@ static void BlockTipChanged(ClientModel *clientmodel, bool initialSync, int heig
     }
     // lock free async UI updates in case we have a new block tip
     // during initial sync, only update the UI if the last update
-    // was > 250ms (MODEL_UPDATE_DELAY) ago
+    // was > 250ms (MODEL_UPDATE_DELAY) ago, for blocks and headers
     int64_t now = 0;
     if (initialSync)
         now = GetTimeMillis();
@@ -254,8 +254,8 @@ static void BlockTipChanged(ClientModel *clientmodel, bool initialSync, int heig
         clientmodel->cachedBestHeaderHeight = height;
         clientmodel->cachedBestHeaderTime = blockTime;
     }
-    // if we are in-sync or if we notify a header update, update the UI regardless of last update time
-    if (fHeader || !initialSync || now - nLastUpdateNotification > MODEL_UPDATE_DELAY) {
+    // if we are in-sync, update the UI regardless of last update time
+    if (!initialSync || now - nLastUpdateNotification > MODEL_UPDATE_DELAY) {
         //pass an async signal to the UI thread
         QMetaObject::invokeMethod(clientmodel, "numBlocksChanged", Qt::QueuedConnection,
                                   Q_ARG(int, height),
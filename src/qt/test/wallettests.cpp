@@ -166,8 +166,9 @@ void TestGUI()
     transactionView.setModel(&walletModel);
 
     // Send two transactions, and verify they are added to transaction list.
+    // The transaction list is loaded in the background.
     TransactionTableModel* transactionTableModel = walletModel.getTransactionTableModel();
-    QCOMPARE(transactionTableModel->rowCount({}), 505);
+    QTRY_COMPARE(transactionTableModel->rowCount({}), 505);
     uint256 txid1 = SendCoins(*wallet.get(), sendCoinsDialog, CKeyID(), 5 * COIN, false /* rbf */);
     uint256 txid2 = SendCoins(*wallet.get(), sendCoinsDialog, CKeyID(), 10 * COIN, true /* rbf */);
     QCOMPARE(transactionTableModel->rowCount({}), 507);
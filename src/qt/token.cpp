@@ -414,6 +414,29 @@ bool Token::balanceOf(const std::string &spender, std::string &result, bool send
     return true;
 }
 
+bool Token::balanceOfInput(std::string &datahex)
+{
+    std::string spender = d->lstParams[PARAM_SENDER].toStdString();
+    if(!ToHash160(spender, spender))
+    {
+        return false;
+    }
+
+    std::vector<std::string> input;
+    input.push_back(spender);
+    return encodeInput(input, d->funcBalanceOf, datahex);
+}
+
+bool Token::balanceOfOutput(const std::string &output, std::string &result)
+{
+    std::vector<std::string> values;
+    if(!decodeOutput(output, d->funcBalanceOf, values) || values.size() == 0)
+        return false;
+
+    result = values[0];
+    return true;
+}
+
 bool Token::burnFrom(const std::string &_from, const std::string &_value, bool &success, bool sendTo)
 {
     std::vector<std::string> input;
@@ -529,16 +552,7 @@ bool Token::exec(const std::vector<std::string> &input, int func, std::vector<st
     if(func == -1 || d->model == 0)
         return false;
     std::string strData;
-    FunctionABI function = d->ABI->functions[func];
-    std::vector<std::vector<std::string>> values;
-    for(size_t i = 0; i < input.size(); i++)
-    {
-        std::vector<std::string> param;
-        param.push_back(input[i]);
-        values.push_back(param);
-    }
-    std::vector<ParameterABI::ErrorType> errors;
-    if(!function.abiIn(values, strData, errors))
+    if(!encodeInput(input, func, strData))
         return false;
     setDataHex(strData);
 
@@ -556,15 +570,8 @@ bool Token::exec(const std::vector<std::string> &input, int func, std::vector<st
         QVariantMap variantMap = result.toMap();
         QVariantMap executionResultMap = variantMap.value("executionResult").toMap();
         std::string rawData = executionResultMap.value("output").toString().toStdString();
-        std::vector<std::vector<std::string>> values;
-        std::vector<ParameterABI::ErrorType> errors;
-        if(!function.abiOut(rawData, values, errors))
+        if(!decodeOutput(rawData, func, output))
             return false;
-        for(size_t i = 0; i < values.size(); i++)
-        {
-            std::vector<std::string> param = values[i];
-            output.push_back(param.size() ? param[0] : "");
-        }
     }
     else
     {
@@ -575,6 +582,39 @@ bool Token::exec(const std::vector<std::string> &input, int func, std::vector<st
     return true;
 }
 
+bool Token::encodeInput(const std::vector<std::string> &input, int func, std::string &strData)
+{
+    if(func == -1)
+        return false;
+    FunctionABI function = d->ABI->functions[func];
+    std::vector<std::vector<std::string>> values;
+    for(size_t i = 0; i < input.size(); i++)
+    {
+        std::vector<std::string> param;
+        param.push_back(input[i]);
+        values.push_back(param);
+    }
+    std::vector<ParameterABI::ErrorType> errors;
+    return function.abiIn(values, strData, errors);
+}
+
+bool Token::decodeOutput(const std::string &rawData, int func, std::vector<std::string> &output)
+{
+    if(func == -1)
+        return false;
+    FunctionABI function = d->ABI->functions[func];
+    std::vector<std::vector<std::string>> values;
+    std::vector<ParameterABI::ErrorType> errors;
+    if(!function.abiOut(rawData, values, errors))
+        return false;
+    for(size_t i = 0; i < values.size(); i++)
+    {
+        std::vector<std::string> param = values[i];
+        output.push_back(param.size() ? param[0] : "");
+    }
+    return true;
+}
+
 void addTokenEvent(std::vector<TokenEvent> &tokenEvents, TokenEvent tokenEvent)
 {
     // Check if the event is from an existing token transaction and update the value
@@ -613,45 +653,38 @@ bool Token::execEvents(int64_t fromBlock, int64_t toBlock, int func, std::vector
     FunctionABI function = d->ABI->functions[func];
 
     // Search for events
-    QVariant result;
     std::string eventName = function.selector();
     std::string contractAddress = d->lstParams[PARAM_ADDRESS].toStdString();
     std::string senderAddress = d->lstParams[PARAM_SENDER].toStdString();
     ToHash160(senderAddress, senderAddress);
     senderAddress  = "000000000000000000000000" + senderAddress;
-    if(!(d->eventLog->searchTokenTx(d->model->node(), d->model, fromBlock, toBlock, contractAddress, senderAddress, result)))
+    std::vector<interfaces::ContractReceipt> receipts;
+    if(!(d->eventLog->searchTokenTx(d->model->node(), fromBlock, toBlock, contractAddress, senderAddress, receipts)))
         return false;
 
     // Parse the result events
-    QList<QVariant> list = result.toList();
-    for(int i = 0; i < list.size(); i++)
+    for(const interfaces::ContractReceipt& receipt : receipts)
     {
         // Search the log for events
-        QVariantMap variantMap = list[i].toMap();
-        QList<QVariant> listLog = variantMap.value("log").toList();
-        for(int i = 0; i < listLog.size(); i++)
+        for(const interfaces::ContractLogEntry& log : receipt.logs)
         {
             // Skip the not needed events
-            QVariantMap variantLog = listLog[i].toMap();
-            QList<QVariant> topicsList = variantLog.value("topics").toList();
-            if(topicsList.count() < 3) continue;
-            if(topicsList[0].toString().toStdString() != eventName) continue;
+            if(log.topics.size() < 3) continue;
+            if(log.topics[0] != eventName) continue;
 
             // Create new event
             TokenEvent tokenEvent;
-            tokenEvent.address = variantMap.value("contractAddress").toString().toStdString();
-            tokenEvent.sender = topicsList[1].toString().toStdString().substr(24);
+            tokenEvent.address = receipt.contract_address;
+            tokenEvent.sender = log.topics[1].substr(24);
             ToQtumAddress(tokenEvent.sender, tokenEvent.sender);
-            tokenEvent.receiver = topicsList[2].toString().toStdString().substr(24);
+            tokenEvent.receiver = log.topics[2].substr(24);
             ToQtumAddress(tokenEvent.receiver, tokenEvent.receiver);
-            tokenEvent.blockHash = uint256S(variantMap.value("blockHash").toString().toStdString());
-            tokenEvent.blockNumber = variantMap.value("blockNumber").toLongLong();
-            tokenEvent.transactionHash = uint256S(variantMap.value("transactionHash").toString().toStdString());
+            tokenEvent.blockHash = receipt.block_hash;
+            tokenEvent.blockNumber = receipt.block_number;
+            tokenEvent.transactionHash = receipt.transaction_hash;
 
             // Parse data
-            std::string data = variantLog.value("data").toString().toStdString();
-            dev::bytes rawData = dev::fromHex(data);
-            dev::bytesConstRef o(&rawData);
+            dev::bytesConstRef o(&log.data);
             dev::u256 outData = dev::eth::ABIDeserialiser<dev::u256>::deserialise(o);
             tokenEvent.value = u256Touint(outData);
 
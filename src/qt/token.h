@@ -66,12 +66,18 @@ public:
     bool approveAndCall(const std::string& _spender, const std::string& _value, const std::string& _extraData, bool& success, bool sendTo = false);
     bool allowance(const std::string& _from, const std::string& _to, std::string& result, bool sendTo = false);
 
+    // Encode the balanceOf call of the sender and decode its output, to run it in a batch of calls
+    bool balanceOfInput(std::string& datahex);
+    bool balanceOfOutput(const std::string& output, std::string& result);
+
     // ABI Events
     bool transferEvents(std::vector<TokenEvent>& tokenEvents, int64_t fromBlock = 0, int64_t toBlock = -1);
     bool burnEvents(std::vector<TokenEvent>& tokenEvents, int64_t fromBlock = 0, int64_t toBlock = -1);
 
 private:
     bool exec(const std::vector<std::string>& input, int func, std::vector<std::string>& output, bool sendTo);
+    bool encodeInput(const std::vector<std::string>& input, int func, std::string& strData);
+    bool decodeOutput(const std::string& rawData, int func, std::vector<std::string>& output);
     bool execEvents(int64_t fromBlock, int64_t toBlock, int func, std::vector<TokenEvent> &tokenEvents);
 
     Token(Token const&);
@@ -6,7 +6,9 @@
 #include <qt/bitcoinunits.h>
 #include <interfaces/node.h>
 #include <interfaces/handler.h>
+#include <sync.h>
 #include <algorithm>
+#include <map>
 
 #include <QDateTime>
 #include <QFont>
@@ -65,6 +67,39 @@ public:
     TokenTxWorker(WalletModel *_walletModel):
         walletModel(_walletModel), first(true) {}
 
+    struct BalanceRequest
+    {
+        std::string contractAddress;
+        std::string senderAddress;
+        // Call balanceOf even if the contract storage did not change
+        bool force;
+    };
+
+    /** Queue the refresh of the balance of a token, the refreshes queued until the worker gets
+     *  to them run together */
+    void requestBalance(const QString& hash, const QString& contractAddress, const QString& senderAddress, bool force)
+    {
+        LOCK(cs_balances);
+        auto inserted = pendingBalances.emplace(hash, BalanceRequest{contractAddress.toStdString(), senderAddress.toStdString(), force});
+        if(!inserted.second)
+        {
+            inserted.first->second.force |= force;
+        }
+        if(!balancesScheduled)
+        {
+            balancesScheduled = true;
+            QMetaObject::invokeMethod(this, "updateBalances", Qt::QueuedConnection);
+        }
+    }
+
+private:
+    Mutex cs_balances;
+    std::map<QString, BalanceRequest> pendingBalances GUARDED_BY(cs_balances);
+    bool balancesScheduled GUARDED_BY(cs_balances) = false;
+
+    // Storage root of the token contracts at their last balanceOf call
+    std::map<QString, uint256> storageRoots;
+
 private Q_SLOTS:
     void updateTokenTx(const QString &hash)
     {
@@ -88,6 +123,11 @@ private Q_SLOTS:
             // Find the token tx in the wallet
             tokenInfo = walletModel->wallet().getToken(tokenHash);
             found = tokenInfo.hash == tokenHash;
+
+            // The wallet followed the transfers of the token up to the tip from the connected blocks
+            if(found && tokenInfo.block_number == toBlock && tokenInfo.block_hash == blockHash)
+                return;
+
             if(found)
             {
                 // Get the start location for search the event log
@@ -120,7 +160,7 @@ private Q_SLOTS:
             std::vector<TokenEvent> tokenEvents;
             tokenAbi.setAddress(tokenInfo.contract_address);
             tokenAbi.setSender(tokenInfo.sender_address);
-            tokenAbi.transferEvents(tokenEvents, fromBlock, toBlock);
+            bool fEvents = tokenAbi.transferEvents(tokenEvents, fromBlock, toBlock);
             for(size_t i = 0; i < tokenEvents.size(); i++)
             {
                 TokenEvent event = tokenEvents[i];
@@ -135,6 +175,11 @@ private Q_SLOTS:
                 walletModel->wallet().addTokenTxEntry(tokenTx, false);
             }
 
+            // Carry the cached balance forward with the transfers, unless the supply changed otherwise
+            std::vector<TokenEvent> burnEvents;
+            bool fOtherEvents = !fEvents || !tokenAbi.burnEvents(burnEvents, fromBlock, toBlock) || burnEvents.size() > 0;
+            walletModel->wallet().setTokenScanned(tokenInfo.contract_address, tokenInfo.sender_address, fromBlock, toBlock, fOtherEvents);
+
             walletModel->wallet().addTokenEntry(tokenInfo);
         }
     }
@@ -144,15 +189,66 @@ private Q_SLOTS:
         if(walletModel) walletModel->wallet().cleanTokenTxEntries();
     }
 
-    void updateBalance(QString hash, QString contractAddress, QString senderAddress)
+    void updateBalances()
     {
-        tokenAbi.setAddress(contractAddress.toStdString());
-        tokenAbi.setSender(senderAddress.toStdString());
-        std::string strBalance;
-        if(tokenAbi.balanceOf(strBalance))
+        std::map<QString, BalanceRequest> requests;
         {
-            QString balance = QString::fromStdString(strBalance);
-            Q_EMIT balanceChanged(hash, balance);
+            LOCK(cs_balances);
+            requests.swap(pendingBalances);
+            balancesScheduled = false;
+        }
+
+        std::vector<QString> hashes;
+        std::vector<interfaces::ContractCall> calls;
+        for(const auto& entry : requests)
+        {
+            const BalanceRequest& request = entry.second;
+            std::string strBalance;
+
+            // Use the balance kept from the transfer events when it is known at the tip
+            if(walletModel->wallet().getTokenBalance(request.contractAddress, request.senderAddress, strBalance))
+            {
+                Q_EMIT balanceChanged(entry.first, QString::fromStdString(strBalance));
+                continue;
+            }
+
+            interfaces::ContractCall call;
+            tokenAbi.setAddress(request.contractAddress);
+            tokenAbi.setSender(request.senderAddress);
+            if(!tokenAbi.balanceOfInput(call.data))
+                continue;
+            call.address = request.contractAddress;
+            call.sender = request.senderAddress;
+            auto it = storageRoots.find(entry.first);
+            if(!request.force && it != storageRoots.end())
+            {
+                call.storage_root = it->second;
+            }
+            hashes.push_back(entry.first);
+            calls.push_back(call);
+        }
+        if(calls.empty())
+            return;
+
+        // Call balanceOf of all the tokens on the same state, the contracts whose storage
+        // did not change since their last call are skipped
+        int blockNumber = -1;
+        std::vector<interfaces::ContractCallResult> results = walletModel->node().callContracts(calls, blockNumber);
+        for(size_t i = 0; i < results.size(); i++)
+        {
+            const interfaces::ContractCallResult& result = results[i];
+            if(result.unchanged)
+                continue;
+
+            std::string strBalance;
+            if(!result.executed || result.excepted || !tokenAbi.balanceOfOutput(result.output, strBalance))
+            {
+                storageRoots.erase(hashes[i]);
+                continue;
+            }
+            storageRoots[hashes[i]] = result.storage_root;
+            walletModel->wallet().setTokenBalance(calls[i].address, calls[i].sender, strBalance, blockNumber);
+            Q_EMIT balanceChanged(hashes[i], QString::fromStdString(strBalance));
         }
     }
 
@@ -303,9 +399,6 @@ TokenItemModel::TokenItemModel(WalletModel *parent):
 {
     columns << tr("Token Name") << tr("Token Symbol") << tr("Balance");
 
-    priv = new TokenItemPriv(this);
-    priv->refreshTokenItem(walletModel->wallet());
-
     worker = new TokenTxWorker(walletModel);
     worker->tokenAbi.setModel(walletModel);
     worker->moveToThread(&(t));
@@ -313,6 +406,9 @@ TokenItemModel::TokenItemModel(WalletModel *parent):
 
     t.start();
 
+    priv = new TokenItemPriv(this);
+    priv->refreshTokenItem(walletModel->wallet());
+
     subscribeToCoreSignals();
 }
 
@@ -437,11 +533,11 @@ void TokenItemModel::checkTokenBalanceChanged()
     if(!priv)
         return;
 
-    // Update token balance
+    // Update token balance, only the tokens whose contract storage changed are called again
     for(int i = 0; i < priv->cachedTokenItem.size(); i++)
     {
         TokenItemEntry tokenEntry = priv->cachedTokenItem[i];
-        updateBalance(tokenEntry);
+        updateBalance(tokenEntry, false);
     }
 
     // Update token transactions
@@ -520,9 +616,8 @@ void TokenItemModel::balanceChanged(QString hash, QString balance)
     }
 }
 
-void TokenItemModel::updateBalance(const TokenItemEntry &entry)
+void TokenItemModel::updateBalance(const TokenItemEntry &entry, bool force)
 {
     QString hash = QString::fromStdString(entry.hash.ToString());
-    QMetaObject::invokeMethod(worker, "updateBalance", Qt::QueuedConnection,
-                              Q_ARG(QString, hash), Q_ARG(QString, entry.contractAddress), Q_ARG(QString, entry.senderAddress));
+    worker->requestBalance(hash, entry.contractAddress, entry.senderAddress, force);
 }
@@ -51,7 +51,8 @@ public:
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
     /*@}*/
     
-    void updateBalance(const TokenItemEntry& entry);
+    /** Refresh the balance of a token in the background, unless forced only if its contract storage changed */
+    void updateBalance(const TokenItemEntry& entry, bool force = true);
 
 public Q_SLOTS:
     void checkTokenBalanceChanged();
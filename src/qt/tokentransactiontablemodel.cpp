@@ -25,6 +25,11 @@
 #include <QIcon>
 #include <QList>
 
+#include <atomic>
+#include <deque>
+#include <map>
+#include <set>
+
 // Amount column is right-aligned it contains numbers
 static int column_alignments[] = {
         Qt::AlignLeft|Qt::AlignVCenter, /* status */
@@ -52,6 +57,12 @@ struct TokenTxLessThan
     }
 };
 
+/** Number of token transactions read and decomposed at a time by the background loading */
+static const size_t TOKEN_TX_LOAD_BATCH_SIZE = 1000;
+
+/** Show the notification balloons of at most this many token transactions of a batch of changes */
+static const size_t MAX_TOKEN_TX_NOTIFICATION_BALLOONS = 10;
+
 // Private implementation
 class TokenTransactionTablePriv
 {
@@ -69,27 +80,149 @@ public:
      */
     QList<TokenTransactionRecord> cachedWallet;
 
-    /* Query entire wallet anew from core.
+    /* Records of the token transactions up to a hash, decomposed in the background.
      */
-    void refreshWallet(interfaces::Node& node, interfaces::Wallet& wallet)
+    struct LoadedBatch
+    {
+        uint256 last;
+        bool done;
+        QList<TokenTransactionRecord> records;
+    };
+
+    std::atomic<bool> fStopLoading{false};
+
+    /* The model is loaded from the wallet in hash order, only the token transactions up
+     * to loadedUpTo are in it until loading is done. Changes to the ones that are not
+     * loaded yet wait in deferredUpdates for their batch.
+     */
+    bool fLoading = true;
+    bool fLoadedAny = false;
+    uint256 loadedUpTo;
+    std::set<uint256> deferredUpdates;
+
+    Mutex cs_pending;
+    std::deque<LoadedBatch> loadedBatches GUARDED_BY(cs_pending);
+    std::vector<std::pair<uint256, ChangeType>> queuedNotifications GUARDED_BY(cs_pending);
+    bool fQueueNotifications GUARDED_BY(cs_pending) = false;
+    bool fProcessScheduled GUARDED_BY(cs_pending) = false;
+
+    /* Called from the loading thread with the next batch of records.
+     */
+    void addLoadedBatch(LoadedBatch&& batch)
     {
-        qDebug() << "TokenTransactionTablePriv::refreshWallet";
-        cachedWallet.clear();
         {
-            for(interfaces::TokenTx wtokenTx : wallet.getTokenTxs())
-            {
-                // Update token transaction time if the block time is changed
-                int64_t time = node.getBlockTime(wtokenTx.block_number);
-                if(time && time != wtokenTx.time)
-                {
-                    wtokenTx.time = time;
-                    wallet.addTokenTxEntry(wtokenTx, false);
-                }
+            LOCK(cs_pending);
+            loadedBatches.push_back(std::move(batch));
+        }
+        QMetaObject::invokeMethod(parent, "loadRecords", Qt::QueuedConnection);
+    }
 
-                // Add token tx to the cache
-                cachedWallet.append(TokenTransactionRecord::decomposeTransaction(wallet, wtokenTx));
+    bool isLoaded(const uint256& hash) const
+    {
+        return !fLoading || (fLoadedAny && !(loadedUpTo < hash));
+    }
+
+    /* Append the loaded batches to the model, they follow everything in it.
+     */
+    void loadRecords(interfaces::Wallet& wallet)
+    {
+        std::deque<LoadedBatch> batches;
+        {
+            LOCK(cs_pending);
+            batches.swap(loadedBatches);
+        }
+
+        // The loaded token transactions are not new, no notification balloons for them
+        bool fProcessing = parent->processingQueuedTransactions();
+        parent->setProcessingQueuedTransactions(true);
+        for (LoadedBatch& batch : batches) {
+            if (!batch.records.isEmpty()) {
+                parent->beginInsertRows(QModelIndex(), cachedWallet.size(), cachedWallet.size() + batch.records.size() - 1);
+                cachedWallet.append(batch.records);
+                parent->endInsertRows();
+            }
+            loadedUpTo = batch.last;
+            fLoadedAny = true;
+            fLoading = !batch.done;
+
+            // Catch up with the changes reported before the token transactions got loaded
+            for (auto it = deferredUpdates.begin(); it != deferredUpdates.end() && isLoaded(*it);) {
+                updateWallet(wallet, *it, CT_UPDATED, true);
+                it = deferredUpdates.erase(it);
+            }
+        }
+        parent->setProcessingQueuedTransactions(fProcessing);
+        qDebug() << "TokenTransactionTablePriv::loadRecords: " + QString::number(cachedWallet.size()) + " records, loading=" + QString::number(fLoading);
+    }
+
+    /* Called from the wallet with a changed token transaction, the changes are applied
+       in batches by processQueuedTransactions.
+     */
+    void queueNotification(const uint256& hash, ChangeType status)
+    {
+        LOCK(cs_pending);
+        queuedNotifications.emplace_back(hash, status);
+        scheduleProcessing();
+    }
+
+    /* Hold the changes back during a rescan and apply them at once at the end.
+     */
+    void setQueueNotifications(bool fQueue)
+    {
+        LOCK(cs_pending);
+        fQueueNotifications = fQueue;
+        scheduleProcessing();
+    }
+
+    void scheduleProcessing() EXCLUSIVE_LOCKS_REQUIRED(cs_pending)
+    {
+        if (fQueueNotifications || fProcessScheduled || queuedNotifications.empty()) {
+            return;
+        }
+        fProcessScheduled = true;
+        QMetaObject::invokeMethod(parent, "processQueuedTransactions", Qt::QueuedConnection);
+    }
+
+    void processQueuedTransactions(interfaces::Wallet& wallet)
+    {
+        std::vector<std::pair<uint256, ChangeType>> notifications;
+        {
+            LOCK(cs_pending);
+            notifications.swap(queuedNotifications);
+            fProcessScheduled = false;
+        }
+
+        // Apply each token transaction once, after several changes compare the model with the wallet instead
+        std::vector<std::pair<uint256, int>> changes;
+        std::map<uint256, size_t> positions;
+        for (const auto& notification : notifications) {
+            auto inserted = positions.emplace(notification.first, changes.size());
+            if (inserted.second) {
+                changes.emplace_back(notification.first, notification.second);
+            } else {
+                changes[inserted.first->second].second = notification.second == CT_DELETED ? CT_DELETED : CT_UPDATED;
             }
         }
+
+        // prevent balloon spam, show maximum 10 balloons
+        bool fProcessing = parent->processingQueuedTransactions();
+        for (size_t i = 0; i < changes.size(); i++) {
+            parent->setProcessingQueuedTransactions(fProcessing || changes.size() - i > MAX_TOKEN_TX_NOTIFICATION_BALLOONS);
+            qDebug() << "NotifyTokenTransactionChanged: " + QString::fromStdString(changes[i].first.GetHex()) + " status= " + QString::number(changes[i].second);
+            updateTransaction(wallet, changes[i].first, changes[i].second, true);
+        }
+        parent->setProcessingQueuedTransactions(fProcessing);
+    }
+
+    /* Apply a change now, or once the token transaction is loaded.
+     */
+    void updateTransaction(interfaces::Wallet& wallet, const uint256 &hash, int status, bool showTransaction)
+    {
+        if (!isLoaded(hash)) {
+            deferredUpdates.insert(hash);
+            return;
+        }
+        updateWallet(wallet, hash, status, showTransaction);
     }
 
     /* Update our model of the wallet incrementally, to synchronize our model of the wallet
@@ -256,6 +389,49 @@ public:
     }
 };
 
+class TokenTransactionLoadWorker : public QObject
+{
+    Q_OBJECT
+public:
+    TokenTransactionTablePriv *priv;
+    interfaces::Node& node;
+    interfaces::Wallet& wallet;
+    TokenTransactionLoadWorker(TokenTransactionTablePriv *_priv, interfaces::Node& _node, interfaces::Wallet& _wallet):
+        priv(_priv), node(_node), wallet(_wallet) {}
+
+private Q_SLOTS:
+    void loadTransactions()
+    {
+        uint256 last;
+        bool done = false;
+        while (!done && !priv->fStopLoading) {
+            std::vector<interfaces::TokenTx> wtokenTxs = wallet.getTokenTxsPage(last, TOKEN_TX_LOAD_BATCH_SIZE);
+            TokenTransactionTablePriv::LoadedBatch batch;
+            for (interfaces::TokenTx& wtokenTx : wtokenTxs) {
+                // Update token transaction time if the block time is changed
+                int64_t time = node.getBlockTime(wtokenTx.block_number);
+                if(time && time != wtokenTx.time)
+                {
+                    wtokenTx.time = time;
+                    wallet.addTokenTxEntry(wtokenTx, false);
+                }
+
+                // Add token tx to the batch
+                batch.records.append(TokenTransactionRecord::decomposeTransaction(wallet, wtokenTx));
+            }
+            if (!wtokenTxs.empty()) {
+                last = wtokenTxs.back().hash;
+            }
+            done = wtokenTxs.size() < TOKEN_TX_LOAD_BATCH_SIZE;
+            batch.last = last;
+            batch.done = done;
+            priv->addLoadedBatch(std::move(batch));
+        }
+    }
+};
+
+#include <qt/tokentransactiontablemodel.moc>
+
 TokenTransactionTableModel::TokenTransactionTableModel(const PlatformStyle *_platformStyle, WalletModel *parent):
         QAbstractTableModel(parent),
         walletModel(parent),
@@ -269,23 +445,47 @@ TokenTransactionTableModel::TokenTransactionTableModel(const PlatformStyle *_pla
     color_black = GetColorStyleValue("guiconstants/color-black", COLOR_BLACK);
 
     columns << QString() << tr("Date") << tr("Type") << tr("Label") << tr("Name") << tr("Amount");
-    priv->refreshWallet(walletModel->node(), walletModel->wallet());
 
     subscribeToCoreSignals();
+
+    // Load the token transactions in the background, the changes reported meanwhile are applied once they are loaded
+    TokenTransactionLoadWorker *worker = new TokenTransactionLoadWorker(priv, walletModel->node(), walletModel->wallet());
+    worker->moveToThread(&t);
+    connect(&t, &QThread::finished, worker, &QObject::deleteLater);
+    t.start();
+    QMetaObject::invokeMethod(worker, "loadTransactions", Qt::QueuedConnection);
 }
 
 TokenTransactionTableModel::~TokenTransactionTableModel()
 {
     unsubscribeFromCoreSignals();
+    stopLoading();
     delete priv;
 }
 
+void TokenTransactionTableModel::stopLoading()
+{
+    priv->fStopLoading = true;
+    t.quit();
+    t.wait();
+}
+
 void TokenTransactionTableModel::updateTransaction(const QString &hash, int status, bool showTransaction)
 {
     uint256 updated;
     updated.SetHex(hash.toStdString());
 
-    priv->updateWallet(walletModel->wallet(), updated, status, showTransaction);
+    priv->updateTransaction(walletModel->wallet(), updated, status, showTransaction);
+}
+
+void TokenTransactionTableModel::loadRecords()
+{
+    priv->loadRecords(walletModel->wallet());
+}
+
+void TokenTransactionTableModel::processQueuedTransactions()
+{
+    priv->processQueuedTransactions(walletModel->wallet());
 }
 
 void TokenTransactionTableModel::updateConfirmations()
@@ -668,70 +868,26 @@ void TokenTransactionTableModel::emitDataChanged(int idx)
     Q_EMIT dataChanged(index(idx, 0, QModelIndex()), index(idx, columns.length()-1, QModelIndex()));
 }
 
-// queue notifications to show a non freezing progress dialog e.g. for rescan
-struct TokenTransactionNotification
-{
-public:
-    TokenTransactionNotification() {}
-    TokenTransactionNotification(uint256 _hash, ChangeType _status, bool _showTransaction):
-        hash(_hash), status(_status), showTransaction(_showTransaction) {}
-
-    void invoke(QObject *ttm)
-    {
-        QString strHash = QString::fromStdString(hash.GetHex());
-        qDebug() << "NotifyTokenTransactionChanged: " + strHash + " status= " + QString::number(status);
-        QMetaObject::invokeMethod(ttm, "updateTransaction", Qt::QueuedConnection,
-                                  Q_ARG(QString, strHash),
-                                  Q_ARG(int, status),
-                                  Q_ARG(bool, showTransaction));
-    }
-private:
-    uint256 hash;
-    ChangeType status;
-    bool showTransaction;
-};
-
-static bool fQueueNotifications = false;
-static std::vector< TokenTransactionNotification > vQueueNotifications;
-
-static void NotifyTokenTransactionChanged(TokenTransactionTableModel *ttm, const uint256 &hash, ChangeType status)
+static void NotifyTokenTransactionChanged(TokenTransactionTablePriv *priv, const uint256 &hash, ChangeType status)
 {
-    TokenTransactionNotification notification(hash, status, true);
-
-    if (fQueueNotifications)
-    {
-        vQueueNotifications.push_back(notification);
-        return;
-    }
-    notification.invoke(ttm);
+    priv->queueNotification(hash, status);
 }
 
-static void ShowProgress(TokenTransactionTableModel *ttm, const std::string &title, int nProgress)
+// queue notifications to show a non freezing progress dialog e.g. for rescan
+static void ShowProgress(TokenTransactionTablePriv *priv, const std::string &title, int nProgress)
 {
     if (nProgress == 0)
-        fQueueNotifications = true;
+        priv->setQueueNotifications(true);
 
     if (nProgress == 100)
-    {
-        fQueueNotifications = false;
-        if (vQueueNotifications.size() > 10) // prevent balloon spam, show maximum 10 balloons
-            QMetaObject::invokeMethod(ttm, "setProcessingQueuedTransactions", Qt::QueuedConnection, Q_ARG(bool, true));
-        for (unsigned int i = 0; i < vQueueNotifications.size(); ++i)
-        {
-            if (vQueueNotifications.size() - i <= 10)
-                QMetaObject::invokeMethod(ttm, "setProcessingQueuedTransactions", Qt::QueuedConnection, Q_ARG(bool, false));
-
-            vQueueNotifications[i].invoke(ttm);
-        }
-        std::vector<TokenTransactionNotification >().swap(vQueueNotifications); // clear
-    }
+        priv->setQueueNotifications(false);
 }
 
 void TokenTransactionTableModel::subscribeToCoreSignals()
 {
     // Connect signals to wallet
-    m_handler_token_transaction_changed = walletModel->wallet().handleTokenTransactionChanged(boost::bind(NotifyTokenTransactionChanged, this, _1, _2));
-    m_handler_show_progress = walletModel->wallet().handleShowProgress(boost::bind(ShowProgress, this, _1, _2));
+    m_handler_token_transaction_changed = walletModel->wallet().handleTokenTransactionChanged(boost::bind(NotifyTokenTransactionChanged, priv, _1, _2));
+    m_handler_show_progress = walletModel->wallet().handleShowProgress(boost::bind(ShowProgress, priv, _1, _2));
 }
 
 void TokenTransactionTableModel::unsubscribeFromCoreSignals()
@@ -6,6 +6,7 @@
 #include <QAbstractTableModel>
 #include <QStringList>
 #include <QColor>
+#include <QThread>
 
 #include <memory>
 
@@ -79,6 +80,8 @@ public:
     QVariant headerData(int section, Qt::Orientation orientation, int role) const;
     QModelIndex index(int row, int column, const QModelIndex & parent = QModelIndex()) const;
     bool processingQueuedTransactions() { return fProcessingQueuedTransactions; }
+    /** Stop loading the token transactions in the background, before the wallet goes away */
+    void stopLoading();
 
 private:
     WalletModel *walletModel;
@@ -92,6 +95,7 @@ private:
     QColor color_negative;
     QColor color_bareaddress;
     QColor color_black;
+    QThread t;
 
     void subscribeToCoreSignals();
     void unsubscribeFromCoreSignals();
@@ -117,6 +121,10 @@ public Q_SLOTS:
     void updateConfirmations();
     /* Needed to update fProcessingQueuedTransactions through a QueuedConnection */
     void setProcessingQueuedTransactions(bool value) { fProcessingQueuedTransactions = value; }
+    /* Add the token transactions loaded in the background to the model */
+    void loadRecords();
+    /* Apply the token transaction changes queued since the last call, coalesced */
+    void processQueuedTransactions();
 
     friend class TokenTransactionTablePriv;
 };
@@ -28,6 +28,11 @@
 #include <QIcon>
 #include <QList>
 
+#include <atomic>
+#include <deque>
+#include <map>
+#include <set>
+
 
 // Amount column is right-aligned it contains numbers
 static int column_alignments[] = {
@@ -56,6 +61,12 @@ struct TxLessThan
     }
 };
 
+/** Number of wallet transactions read and decomposed at a time by the background loading */
+static const size_t TX_LOAD_BATCH_SIZE = 1000;
+
+/** Show the notification balloons of at most this many transactions of a batch of changes */
+static const size_t MAX_TX_NOTIFICATION_BALLOONS = 10;
+
 // Private implementation
 class TransactionTablePriv
 {
@@ -73,19 +84,150 @@ public:
      */
     QList<TransactionRecord> cachedWallet;
 
-    /* Query entire wallet anew from core.
+    /* Records of the wallet transactions up to a hash, decomposed in the background.
+     */
+    struct LoadedBatch
+    {
+        uint256 last;
+        bool done;
+        QList<TransactionRecord> records;
+    };
+
+    std::atomic<bool> fStopLoading{false};
+
+    /* The model is loaded from the wallet in hash order, only the transactions up to
+     * loadedUpTo are in it until loading is done. Changes to the transactions that are
+     * not loaded yet wait in deferredUpdates for their batch.
+     */
+    bool fLoading = true;
+    bool fLoadedAny = false;
+    uint256 loadedUpTo;
+    std::set<uint256> deferredUpdates;
+
+    Mutex cs_pending;
+    std::deque<LoadedBatch> loadedBatches GUARDED_BY(cs_pending);
+    std::vector<std::pair<uint256, ChangeType>> queuedNotifications GUARDED_BY(cs_pending);
+    bool fQueueNotifications GUARDED_BY(cs_pending) = false;
+    bool fProcessScheduled GUARDED_BY(cs_pending) = false;
+
+    /* Called from the loading thread with the next batch of records.
      */
-    void refreshWallet(interfaces::Wallet& wallet)
+    void addLoadedBatch(LoadedBatch&& batch)
     {
-        qDebug() << "TransactionTablePriv::refreshWallet";
-        cachedWallet.clear();
         {
-            for (const auto& wtx : wallet.getWalletTxs()) {
-                if (TransactionRecord::showTransaction(wtx)) {
-                    cachedWallet.append(TransactionRecord::decomposeTransaction(wtx));
-                }
+            LOCK(cs_pending);
+            loadedBatches.push_back(std::move(batch));
+        }
+        QMetaObject::invokeMethod(parent, "loadRecords", Qt::QueuedConnection);
+    }
+
+    bool isLoaded(const uint256& hash) const
+    {
+        return !fLoading || (fLoadedAny && !(loadedUpTo < hash));
+    }
+
+    /* Append the loaded batches to the model, they follow everything in it.
+     */
+    void loadRecords(interfaces::Wallet& wallet)
+    {
+        std::deque<LoadedBatch> batches;
+        {
+            LOCK(cs_pending);
+            batches.swap(loadedBatches);
+        }
+
+        // The loaded transactions are not new, no notification balloons for them
+        bool fProcessing = parent->processingQueuedTransactions();
+        parent->setProcessingQueuedTransactions(true);
+        for (LoadedBatch& batch : batches) {
+            if (!batch.records.isEmpty()) {
+                parent->beginInsertRows(QModelIndex(), cachedWallet.size(), cachedWallet.size() + batch.records.size() - 1);
+                cachedWallet.append(batch.records);
+                parent->endInsertRows();
+            }
+            loadedUpTo = batch.last;
+            fLoadedAny = true;
+            fLoading = !batch.done;
+
+            // Catch up with the changes reported before the transactions got loaded
+            for (auto it = deferredUpdates.begin(); it != deferredUpdates.end() && isLoaded(*it);) {
+                updateWallet(wallet, *it, CT_UPDATED, true);
+                it = deferredUpdates.erase(it);
             }
         }
+        parent->setProcessingQueuedTransactions(fProcessing);
+        qDebug() << "TransactionTablePriv::loadRecords: " + QString::number(cachedWallet.size()) + " records, loading=" + QString::number(fLoading);
+    }
+
+    /* Called from the wallet with a changed transaction, the changes are applied in
+       batches by processQueuedTransactions.
+     */
+    void queueNotification(const uint256& hash, ChangeType status)
+    {
+        LOCK(cs_pending);
+        queuedNotifications.emplace_back(hash, status);
+        scheduleProcessing();
+    }
+
+    /* Hold the changes back during a rescan and apply them at once at the end.
+     */
+    void setQueueNotifications(bool fQueue)
+    {
+        LOCK(cs_pending);
+        fQueueNotifications = fQueue;
+        scheduleProcessing();
+    }
+
+    void scheduleProcessing() EXCLUSIVE_LOCKS_REQUIRED(cs_pending)
+    {
+        if (fQueueNotifications || fProcessScheduled || queuedNotifications.empty()) {
+            return;
+        }
+        fProcessScheduled = true;
+        QMetaObject::invokeMethod(parent, "processQueuedTransactions", Qt::QueuedConnection);
+    }
+
+    void processQueuedTransactions(interfaces::Wallet& wallet)
+    {
+        std::vector<std::pair<uint256, ChangeType>> notifications;
+        {
+            LOCK(cs_pending);
+            notifications.swap(queuedNotifications);
+            fProcessScheduled = false;
+        }
+
+        // Rescans and bursts of stakes change the same transactions several times, apply
+        // each one once. After several changes compare the model with the wallet instead.
+        std::vector<std::pair<uint256, int>> changes;
+        std::map<uint256, size_t> positions;
+        for (const auto& notification : notifications) {
+            auto inserted = positions.emplace(notification.first, changes.size());
+            if (inserted.second) {
+                changes.emplace_back(notification.first, notification.second);
+            } else {
+                changes[inserted.first->second].second = notification.second == CT_DELETED ? CT_DELETED : CT_UPDATED;
+            }
+        }
+
+        // prevent balloon spam, show maximum 10 balloons
+        bool fProcessing = parent->processingQueuedTransactions();
+        for (size_t i = 0; i < changes.size(); i++) {
+            parent->setProcessingQueuedTransactions(fProcessing || changes.size() - i > MAX_TX_NOTIFICATION_BALLOONS);
+            qDebug() << "NotifyTransactionChanged: " + QString::fromStdString(changes[i].first.GetHex()) + " status= " + QString::number(changes[i].second);
+            updateTransaction(wallet, changes[i].first, changes[i].second, true);
+        }
+        parent->setProcessingQueuedTransactions(fProcessing);
+    }
+
+    /* Apply a change now, or once the transaction is loaded.
+     */
+    void updateTransaction(interfaces::Wallet& wallet, const uint256 &hash, int status, bool showTransaction)
+    {
+        if (!isLoaded(hash)) {
+            deferredUpdates.insert(hash);
+            return;
+        }
+        updateWallet(wallet, hash, status, showTransaction);
     }
 
     /* Update our model of the wallet incrementally, to synchronize our model of the wallet
@@ -221,6 +363,43 @@ public:
     }
 };
 
+class TransactionLoadWorker : public QObject
+{
+    Q_OBJECT
+public:
+    TransactionTablePriv *priv;
+    interfaces::Wallet& wallet;
+    TransactionLoadWorker(TransactionTablePriv *_priv, interfaces::Wallet& _wallet):
+        priv(_priv), wallet(_wallet) {}
+
+private Q_SLOTS:
+    void loadTransactions()
+    {
+        // Read the wallet a batch at a time, so the wallet lock is only held briefly and
+        // the view fills up while the rest is decomposed
+        uint256 last;
+        bool done = false;
+        while (!done && !priv->fStopLoading) {
+            std::vector<interfaces::WalletTx> wtxs = wallet.getWalletTxsPage(last, TX_LOAD_BATCH_SIZE);
+            TransactionTablePriv::LoadedBatch batch;
+            for (const auto& wtx : wtxs) {
+                if (TransactionRecord::showTransaction(wtx)) {
+                    batch.records.append(TransactionRecord::decomposeTransaction(wtx));
+                }
+            }
+            if (!wtxs.empty()) {
+                last = wtxs.back().tx->GetHash();
+            }
+            done = wtxs.size() < TX_LOAD_BATCH_SIZE;
+            batch.last = last;
+            batch.done = done;
+            priv->addLoadedBatch(std::move(batch));
+        }
+    }
+};
+
+#include <qt/transactiontablemodel.moc>
+
 TransactionTableModel::TransactionTableModel(const PlatformStyle *_platformStyle, WalletModel *parent):
         QAbstractTableModel(parent),
         walletModel(parent),
@@ -236,19 +415,33 @@ TransactionTableModel::TransactionTableModel(const PlatformStyle *_platformStyle
     color_black = GetColorStyleValue("guiconstants/color-black", COLOR_BLACK);
 
     columns << QString() << QString() << tr("Date") << tr("Type") << tr("Label") << BitcoinUnits::getAmountColumnTitle(walletModel->getOptionsModel()->getDisplayUnit());
-    priv->refreshWallet(walletModel->wallet());
 
     connect(walletModel->getOptionsModel(), &OptionsModel::displayUnitChanged, this, &TransactionTableModel::updateDisplayUnit);
 
     subscribeToCoreSignals();
+
+    // Load the transactions in the background, the changes reported meanwhile are applied once they are loaded
+    TransactionLoadWorker *worker = new TransactionLoadWorker(priv, walletModel->wallet());
+    worker->moveToThread(&t);
+    connect(&t, &QThread::finished, worker, &QObject::deleteLater);
+    t.start();
+    QMetaObject::invokeMethod(worker, "loadTransactions", Qt::QueuedConnection);
 }
 
 TransactionTableModel::~TransactionTableModel()
 {
     unsubscribeFromCoreSignals();
+    stopLoading();
     delete priv;
 }
 
+void TransactionTableModel::stopLoading()
+{
+    priv->fStopLoading = true;
+    t.quit();
+    t.wait();
+}
+
 /** Updates the column title to "Amount (DisplayUnit)" and emits headerDataChanged() signal for table headers to react. */
 void TransactionTableModel::updateAmountColumnTitle()
 {
@@ -261,7 +454,17 @@ void TransactionTableModel::updateTransaction(const QString &hash, int status, b
     uint256 updated;
     updated.SetHex(hash.toStdString());
 
-    priv->updateWallet(walletModel->wallet(), updated, status, showTransaction);
+    priv->updateTransaction(walletModel->wallet(), updated, status, showTransaction);
+}
+
+void TransactionTableModel::loadRecords()
+{
+    priv->loadRecords(walletModel->wallet());
+}
+
+void TransactionTableModel::processQueuedTransactions()
+{
+    priv->processQueuedTransactions(walletModel->wallet());
 }
 
 void TransactionTableModel::updateConfirmations()
@@ -685,7 +888,7 @@ QModelIndex TransactionTableModel::index(int row, int column, const QModelIndex
     TransactionRecord *data = priv->index(walletModel->wallet(), row);
     if(data)
     {
-        return createIndex(row, column, priv->index(walletModel->wallet(), row));
+        return createIndex(row, column, data);
     }
     return QModelIndex();
 }
@@ -697,71 +900,26 @@ void TransactionTableModel::updateDisplayUnit()
     Q_EMIT dataChanged(index(0, Amount), index(priv->size()-1, Amount));
 }
 
-// queue notifications to show a non freezing progress dialog e.g. for rescan
-struct TransactionNotification
-{
-public:
-    TransactionNotification() {}
-    TransactionNotification(uint256 _hash, ChangeType _status, bool _showTransaction):
-        hash(_hash), status(_status), showTransaction(_showTransaction) {}
-
-    void invoke(QObject *ttm)
-    {
-        QString strHash = QString::fromStdString(hash.GetHex());
-        qDebug() << "NotifyTransactionChanged: " + strHash + " status= " + QString::number(status);
-        QMetaObject::invokeMethod(ttm, "updateTransaction", Qt::QueuedConnection,
-                                  Q_ARG(QString, strHash),
-                                  Q_ARG(int, status),
-                                  Q_ARG(bool, showTransaction));
-    }
-private:
-    uint256 hash;
-    ChangeType status;
-    bool showTransaction;
-};
-
-static bool fQueueNotifications = false;
-static std::vector< TransactionNotification > vQueueNotifications;
-
-static void NotifyTransactionChanged(TransactionTableModel *ttm, const uint256 &hash, ChangeType status)
+static void NotifyTransactionChanged(TransactionTablePriv *priv, const uint256 &hash, ChangeType status)
 {
-
-    TransactionNotification notification(hash, status, true);
-
-    if (fQueueNotifications)
-    {
-        vQueueNotifications.push_back(notification);
-        return;
-    }
-    notification.invoke(ttm);
+    priv->queueNotification(hash, status);
 }
 
-static void ShowProgress(TransactionTableModel *ttm, const std::string &title, int nProgress)
+// queue notifications to show a non freezing progress dialog e.g. for rescan
+static void ShowProgress(TransactionTablePriv *priv, const std::string &title, int nProgress)
 {
     if (nProgress == 0)
-        fQueueNotifications = true;
+        priv->setQueueNotifications(true);
 
     if (nProgress == 100)
-    {
-        fQueueNotifications = false;
-        if (vQueueNotifications.size() > 10) // prevent balloon spam, show maximum 10 balloons
-            QMetaObject::invokeMethod(ttm, "setProcessingQueuedTransactions", Qt::QueuedConnection, Q_ARG(bool, true));
-        for (unsigned int i = 0; i < vQueueNotifications.size(); ++i)
-        {
-            if (vQueueNotifications.size() - i <= 10)
-                QMetaObject::invokeMethod(ttm, "setProcessingQueuedTransactions", Qt::QueuedConnection, Q_ARG(bool, false));
-
-            vQueueNotifications[i].invoke(ttm);
-        }
-        std::vector<TransactionNotification >().swap(vQueueNotifications); // clear
-    }
+        priv->setQueueNotifications(false);
 }
 
 void TransactionTableModel::subscribeToCoreSignals()
 {
     // Connect signals to wallet
-    m_handler_transaction_changed = walletModel->wallet().handleTransactionChanged(std::bind(NotifyTransactionChanged, this, std::placeholders::_1, std::placeholders::_2));
-    m_handler_show_progress = walletModel->wallet().handleShowProgress(std::bind(ShowProgress, this, std::placeholders::_1, std::placeholders::_2));
+    m_handler_transaction_changed = walletModel->wallet().handleTransactionChanged(std::bind(NotifyTransactionChanged, priv, std::placeholders::_1, std::placeholders::_2));
+    m_handler_show_progress = walletModel->wallet().handleShowProgress(std::bind(ShowProgress, priv, std::placeholders::_1, std::placeholders::_2));
 }
 
 void TransactionTableModel::unsubscribeFromCoreSignals()
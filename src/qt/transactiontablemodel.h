@@ -10,6 +10,7 @@
 #include <QAbstractTableModel>
 #include <QStringList>
 #include <QColor>
+#include <QThread>
 
 #include <memory>
 
@@ -83,6 +84,8 @@ public:
     QVariant headerData(int section, Qt::Orientation orientation, int role) const;
     QModelIndex index(int row, int column, const QModelIndex & parent = QModelIndex()) const;
     bool processingQueuedTransactions() const { return fProcessingQueuedTransactions; }
+    /** Stop loading the transactions in the background, before the wallet goes away */
+    void stopLoading();
 
 private:
     WalletModel *walletModel;
@@ -98,6 +101,7 @@ private:
     QColor color_tx_status_openuntildate;
     QColor color_tx_status_danger;
     QColor color_black;
+    QThread t;
 
     void subscribeToCoreSignals();
     void unsubscribeFromCoreSignals();
@@ -123,6 +127,10 @@ public Q_SLOTS:
     void updateAmountColumnTitle();
     /* Needed to update fProcessingQueuedTransactions through a QueuedConnection */
     void setProcessingQueuedTransactions(bool value) { fProcessingQueuedTransactions = value; }
+    /* Add the transactions loaded in the background to the model */
+    void loadRecords();
+    /* Apply the transaction changes queued since the last call, coalesced */
+    void processQueuedTransactions();
 
     friend class TransactionTablePriv;
 };
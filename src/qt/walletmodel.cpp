@@ -94,6 +94,10 @@ WalletModel::~WalletModel()
 {
     unsubscribeFromCoreSignals();
 
+    // The table models are destroyed after the wallet, stop their background loading first
+    transactionTableModel->stopLoading();
+    tokenTransactionTableModel->stopLoading();
+
     t.quit();
     t.wait();
 }
@@ -518,7 +522,9 @@ static void NotifyTransactionChanged(WalletModel *walletmodel, const uint256 &ha
 {
     Q_UNUSED(hash);
     Q_UNUSED(status);
-    QMetaObject::invokeMethod(walletmodel, "updateTransaction", Qt::QueuedConnection);
+    // Only sets a flag for the next balance poll, a queued call per transaction would flood
+    // the event loop during rescans and initial sync
+    walletmodel->updateTransaction();
 }
 
 static void ShowProgress(WalletModel *walletmodel, const std::string &title, int nProgress)
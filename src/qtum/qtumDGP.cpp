@@ -1,5 +1,43 @@
 #include <qtum/qtumDGP.h>
 #include <chainparams.h>
+#include <memusage.h>
+#include <sync.h>
+
+#include <memory>
+#include <tuple>
+
+namespace {
+
+/** Governance span (the activation height of the proposal) with the storage root and code hash of its template contract */
+typedef std::tuple<unsigned int, dev::h256, dev::h256> DGPTemplateKey;
+
+/**
+ * Memoized DGP parameters of one DGP contract. The entry is only valid for the storage root
+ * of the DGP contract it was built from, so connecting or disconnecting a block that changes
+ * the governance storage invalidates it, while any other block leaves it untouched.
+ * Parsed template values are kept per governance span and state of the template contract,
+ * as a template can change without the governance storage changing.
+ */
+struct DGPCacheEntry {
+    bool fInitialized = false;
+    dev::h256 storageRoot;
+    std::vector<std::pair<unsigned int, dev::Address>> paramsInstance;
+    std::map<DGPTemplateKey, uint64_t> uint64Values;
+    //! Gas schedules by template, fork schedule they are based on and whether QIP7 is active
+    std::map<std::tuple<DGPTemplateKey, const dev::eth::EVMSchedule*, bool>, std::shared_ptr<const dev::eth::EVMSchedule>> schedules;
+};
+
+DGPTemplateKey TemplateKey(unsigned int height, const dev::h256& storageRoot, const dev::h256& codeHash)
+{
+    return std::make_tuple(height, storageRoot, codeHash);
+}
+
+CCriticalSection cs_dgpcache;
+std::map<std::pair<dev::Address, bool>, DGPCacheEntry> mapDGPCache GUARDED_BY(cs_dgpcache);
+//! The fork schedules, for the heights without a gas schedule proposal
+std::map<const dev::eth::EVMSchedule*, std::shared_ptr<const dev::eth::EVMSchedule>> mapForkSchedules GUARDED_BY(cs_dgpcache);
+
+}
 
 std::vector<uint32_t> createDataSchedule(const dev::eth::EVMSchedule& schedule)
 {
@@ -46,24 +84,84 @@ bool QtumDGP::checkLimitSchedule(const std::vector<uint32_t>& defaultData, const
 }
 
 dev::eth::EVMSchedule QtumDGP::getGasSchedule(int blockHeight){
+    return *getSharedGasSchedule(blockHeight);
+}
+
+std::shared_ptr<const dev::eth::EVMSchedule> QtumDGP::getSharedGasSchedule(int blockHeight){
     clear();
-    dataSchedule = scheduleDataForBlockNumber(blockHeight);
-    dev::eth::EVMSchedule schedule = globalSealEngine->chainParams().scheduleForBlockNumber(blockHeight);
-    if(initStorages(GasScheduleDGP, blockHeight, ParseHex("26fadbe2"))){
-        schedule = createEVMSchedule(schedule, blockHeight);
+    const dev::eth::EVMSchedule& forkSchedule = globalSealEngine->chainParams().scheduleForBlockNumber(blockHeight);
+    DGPSpan span;
+    if(!findDGPSpan(GasScheduleDGP, blockHeight, span)){
+        LOCK(cs_dgpcache);
+        std::shared_ptr<const dev::eth::EVMSchedule>& schedule = mapForkSchedules[&forkSchedule];
+        if(!schedule){
+            schedule = std::make_shared<const dev::eth::EVMSchedule>(forkSchedule);
+        }
+        return schedule;
+    }
+
+    // The proposal is checked against the fork schedule, and may have 40 values from QIP7
+    const auto key = std::make_tuple(TemplateKey(span.height, span.templateStorageRoot, span.templateCodeHash), &forkSchedule, blockHeight >= Params().GetConsensus().QIP7Height);
+    {
+        LOCK(cs_dgpcache);
+        const DGPCacheEntry& entry = mapDGPCache[std::make_pair(GasScheduleDGP, dgpevm)];
+        auto it = entry.schedules.find(key);
+        if(it != entry.schedules.end()){
+            return it->second;
+        }
+    }
+
+    std::vector<uint32_t> uint32Values;
+    getScheduleValues(span, uint32Values);
+    dataSchedule = createDataSchedule(forkSchedule);
+    std::shared_ptr<const dev::eth::EVMSchedule> schedule = std::make_shared<const dev::eth::EVMSchedule>(createEVMSchedule(forkSchedule, uint32Values, blockHeight));
+
+    LOCK(cs_dgpcache);
+    DGPCacheEntry& entry = mapDGPCache[std::make_pair(GasScheduleDGP, dgpevm)];
+    if(entry.fInitialized && entry.storageRoot == span.storageRoot){
+        entry.schedules[key] = schedule;
     }
     return schedule;
 }
 
+void QtumDGP::getScheduleValues(const DGPSpan& span, std::vector<uint32_t>& uint32Values){
+    std::vector<unsigned char> data = ParseHex("26fadbe2");
+    initTemplate(span.templateAddress, data);
+    if(!dgpevm){
+        parseStorageScheduleContract(uint32Values);
+    } else {
+        parseDataScheduleContract(uint32Values);
+    }
+}
+
 uint64_t QtumDGP::getUint64FromDGP(unsigned int blockHeight, const dev::Address& contract, std::vector<unsigned char> data){
     uint64_t value = 0;
-    if(initStorages(contract, blockHeight, data)){
-        if(!dgpevm){
-            parseStorageOneUint64(value);
-        } else {
-            parseDataOneUint64(value);
+    DGPSpan span;
+    if(!findDGPSpan(contract, blockHeight, span))
+        return value;
+
+    const DGPTemplateKey key = TemplateKey(span.height, span.templateStorageRoot, span.templateCodeHash);
+    {
+        LOCK(cs_dgpcache);
+        const DGPCacheEntry& entry = mapDGPCache[std::make_pair(contract, dgpevm)];
+        auto it = entry.uint64Values.find(key);
+        if(it != entry.uint64Values.end()){
+            return it->second;
         }
     }
+
+    initTemplate(span.templateAddress, data);
+    if(!dgpevm){
+        parseStorageOneUint64(value);
+    } else {
+        parseDataOneUint64(value);
+    }
+
+    LOCK(cs_dgpcache);
+    DGPCacheEntry& entry = mapDGPCache[std::make_pair(contract, dgpevm)];
+    if(entry.fInitialized && entry.storageRoot == span.storageRoot){
+        entry.uint64Values[key] = value;
+    }
     return value;
 }
 
@@ -97,21 +195,65 @@ uint64_t QtumDGP::getBlockGasLimit(unsigned int blockHeight){
     return result;
 }
 
-bool QtumDGP::initStorages(const dev::Address& addr, unsigned int blockHeight, std::vector<unsigned char> data){
-    initStorageDGP(addr);
-    createParamsInstance();
-    dev::Address address = getAddressForBlock(blockHeight);
-    if(address != dev::Address()){
-        if(!dgpevm){
-            initStorageTemplate(address);
+bool QtumDGP::findDGPSpan(const dev::Address& addr, unsigned int blockHeight, DGPSpan& span){
+    span.storageRoot = state->storageRoot(addr);
+    {
+        LOCK(cs_dgpcache);
+        DGPCacheEntry& entry = mapDGPCache[std::make_pair(addr, dgpevm)];
+        if(!entry.fInitialized || entry.storageRoot != span.storageRoot){
+            initStorageDGP(addr);
+            createParamsInstance();
+            entry = DGPCacheEntry();
+            entry.fInitialized = true;
+            entry.storageRoot = span.storageRoot;
+            entry.paramsInstance = paramsInstance;
         } else {
-            initDataTemplate(address, data);
+            paramsInstance = entry.paramsInstance;
+        }
+    }
+
+    for(auto i = paramsInstance.rbegin(); i != paramsInstance.rend(); i++){
+        if(i->first <= blockHeight){
+            span.height = i->first;
+            span.templateAddress = i->second;
+            if(span.templateAddress == dev::Address())
+                return false;
+            span.templateStorageRoot = state->storageRoot(span.templateAddress);
+            span.templateCodeHash = state->codeHash(span.templateAddress);
+            return true;
         }
-        return true;
     }
     return false;
 }
 
+void QtumDGP::initTemplate(const dev::Address& addr, std::vector<unsigned char>& data){
+    if(!dgpevm){
+        initStorageTemplate(addr);
+    } else {
+        initDataTemplate(addr, data);
+    }
+}
+
+void QtumDGP::clearCache(){
+    LOCK(cs_dgpcache);
+    mapDGPCache.clear();
+    mapForkSchedules.clear();
+}
+
+size_t QtumDGP::cacheMemoryUsage(){
+    // The entries are one per DGP contract, governance span and state of its template, so they need no bound
+    LOCK(cs_dgpcache);
+    size_t usage = memusage::DynamicUsage(mapDGPCache) + memusage::DynamicUsage(mapForkSchedules);
+    for (auto const& i : mapDGPCache) {
+        usage += memusage::DynamicUsage(i.second.paramsInstance) + memusage::DynamicUsage(i.second.uint64Values) + memusage::DynamicUsage(i.second.schedules);
+        for (auto const& schedule : i.second.schedules)
+            usage += memusage::DynamicUsage(schedule.second);
+    }
+    for (auto const& i : mapForkSchedules)
+        usage += memusage::DynamicUsage(i.second);
+    return usage;
+}
+
 void QtumDGP::initStorageDGP(const dev::Address& addr){
     storageDGP = state->storage(addr);
 }
@@ -121,7 +263,13 @@ void QtumDGP::initStorageTemplate(const dev::Address& addr){
 }
 
 void QtumDGP::initDataTemplate(const dev::Address& addr, std::vector<unsigned char>& data){
-    dataTemplate = CallContract(addr, data)[0].execRes.output;
+    if(pindex){
+        // The call is executed on a copy, the caller keeps executing on its state
+        QtumState stateCall(*state);
+        dataTemplate = CallContract(addr, data, pindex, dev::Address(), 0, &stateCall)[0].execRes.output;
+    } else {
+        dataTemplate = CallContract(addr, data)[0].execRes.output;
+    }
 }
 
 void QtumDGP::createParamsInstance(){
@@ -139,14 +287,6 @@ void QtumDGP::createParamsInstance(){
     }
 }
 
-dev::Address QtumDGP::getAddressForBlock(unsigned int blockHeight){
-    for(auto i = paramsInstance.rbegin(); i != paramsInstance.rend(); i++){
-        if(i->first <= blockHeight)
-            return i->second;
-    }
-    return dev::Address();
-}
-
 static inline bool sortPairs(const std::pair<dev::u256, dev::u256>& a, const std::pair<dev::u256, dev::u256>& b){
     return a.first < b.first;
 }
@@ -199,15 +339,8 @@ void QtumDGP::parseDataOneUint64(uint64_t& value){
     }
 }
 
-dev::eth::EVMSchedule QtumDGP::createEVMSchedule(const dev::eth::EVMSchedule &_schedule, int blockHeight){
+dev::eth::EVMSchedule QtumDGP::createEVMSchedule(const dev::eth::EVMSchedule &_schedule, const std::vector<uint32_t>& uint32Values, int blockHeight){
     dev::eth::EVMSchedule schedule = _schedule;
-    std::vector<uint32_t> uint32Values;
-
-    if(!dgpevm){
-        parseStorageScheduleContract(uint32Values);
-    } else {
-        parseDataScheduleContract(uint32Values);
-    }
 
     if(!checkLimitSchedule(dataSchedule, uint32Values, blockHeight))
         return schedule;
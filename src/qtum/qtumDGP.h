@@ -28,19 +28,44 @@ class QtumDGP {
     
 public:
 
-    QtumDGP(QtumState* _state, bool _dgpevm = true) : dgpevm(_dgpevm), state(_state) { initDataSchedule(); }
+    /** With pindex set, state is at the roots of pindex and the templates are called on it,
+     *  else state is globalState and the templates are called at the tip. */
+    QtumDGP(QtumState* _state, bool _dgpevm = true, CBlockIndex* _pindex = nullptr) : dgpevm(_dgpevm), state(_state), pindex(_pindex) { initDataSchedule(); }
 
     dev::eth::EVMSchedule getGasSchedule(int blockHeight);
 
+    /** The gas schedule of a height, built once per governance span and shared until the DGP storage changes. */
+    std::shared_ptr<const dev::eth::EVMSchedule> getSharedGasSchedule(int blockHeight);
+
     uint32_t getBlockSize(unsigned int blockHeight);
 
     uint64_t getMinGasPrice(unsigned int blockHeight);
 
     uint64_t getBlockGasLimit(unsigned int blockHeight);
 
+    /** Drop all memoized DGP parameters (e.g. after the state database is reloaded). */
+    static void clearCache();
+
+    /** Memory used by the memoized DGP parameters and gas schedules */
+    static size_t cacheMemoryUsage();
+
 private:
 
-    bool initStorages(const dev::Address& addr, unsigned int blockHeight, std::vector<unsigned char> data = std::vector<unsigned char>());
+    /** Governance proposal which is active for a block height, as recorded in a DGP contract. */
+    struct DGPSpan {
+        unsigned int height = 0;
+        dev::Address templateAddress;
+        dev::h256 storageRoot;
+        //! The values are read from the template contract, so they are only valid for its storage and code
+        dev::h256 templateStorageRoot;
+        dev::h256 templateCodeHash;
+    };
+
+    bool findDGPSpan(const dev::Address& addr, unsigned int blockHeight, DGPSpan& span);
+
+    void initTemplate(const dev::Address& addr, std::vector<unsigned char>& data);
+
+    void getScheduleValues(const DGPSpan& span, std::vector<uint32_t>& uint32Values);
 
     void initStorageDGP(const dev::Address& addr);
 
@@ -54,8 +79,6 @@ private:
 
     void createParamsInstance();
 
-    dev::Address getAddressForBlock(unsigned int blockHeight);
-
     uint64_t getUint64FromDGP(unsigned int blockHeight, const dev::Address& contract, std::vector<unsigned char> data);
 
     void parseStorageScheduleContract(std::vector<uint32_t>& uint32Values);
@@ -66,7 +89,7 @@ private:
 
     void parseDataOneUint64(uint64_t& value);
 
-    dev::eth::EVMSchedule createEVMSchedule(const dev::eth::EVMSchedule& schedule, int blockHeight);
+    dev::eth::EVMSchedule createEVMSchedule(const dev::eth::EVMSchedule& schedule, const std::vector<uint32_t>& uint32Values, int blockHeight);
 
     void clear();    
 
@@ -76,6 +99,8 @@ private:
 
     const QtumState* state;
 
+    CBlockIndex* pindex;
+
     dev::Address templateContract;
 
     std::map<dev::h256, std::pair<dev::u256, dev::u256>> storageDGP;
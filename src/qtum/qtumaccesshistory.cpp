@@ -0,0 +1,88 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <qtum/qtumaccesshistory.h>
+
+#include <algorithm>
+
+static std::shared_ptr<ContractAccessHistory> g_contract_accesses;
+
+std::shared_ptr<ContractAccessHistory> GetContractAccessHistory()
+{
+    return std::atomic_load(&g_contract_accesses);
+}
+
+void SetContractAccessHistory(std::shared_ptr<ContractAccessHistory> history)
+{
+    std::atomic_store(&g_contract_accesses, std::move(history));
+}
+
+namespace {
+
+/** Move the values to the front of list, keeping at most nMax values */
+template <typename T>
+void MergeRecent(std::vector<T>& list, const std::vector<T>& values, size_t nMax)
+{
+    std::vector<T> merged;
+    merged.reserve(std::min(list.size() + values.size(), nMax));
+    for (const T& value : values) {
+        if (merged.size() >= nMax)
+            break;
+        if (std::find(merged.begin(), merged.end(), value) == merged.end())
+            merged.push_back(value);
+    }
+    for (const T& value : list) {
+        if (merged.size() >= nMax)
+            break;
+        if (std::find(merged.begin(), merged.end(), value) == merged.end())
+            merged.push_back(value);
+    }
+    list.swap(merged);
+}
+
+}
+
+ContractAccessHistory::Entry& ContractAccessHistory::GetEntry(const dev::Address& address)
+{
+    auto it = mapEntries.find(address);
+    if (it != mapEntries.end()) {
+        listEntries.splice(listEntries.begin(), listEntries, it->second);
+        return it->second->second;
+    }
+
+    if (listEntries.size() >= MAX_ACCESS_HISTORY_CONTRACTS) {
+        mapEntries.erase(listEntries.back().first);
+        listEntries.pop_back();
+    }
+    listEntries.emplace_front(address, Entry());
+    mapEntries.emplace(address, listEntries.begin());
+    return listEntries.front().second;
+}
+
+void ContractAccessHistory::Record(const dev::Address& called, const ContractAccesses& accesses)
+{
+    std::vector<dev::Address> callees;
+    for (const auto& access : accesses) {
+        if (access.first != called && !access.second.empty())
+            callees.push_back(access.first);
+    }
+
+    LOCK(cs);
+    for (const auto& access : accesses) {
+        if (!access.second.empty())
+            MergeRecent(GetEntry(access.first).slots, access.second, MAX_ACCESS_HISTORY_SLOTS);
+    }
+    if (!callees.empty())
+        MergeRecent(GetEntry(called).callees, callees, MAX_ACCESS_HISTORY_CALLEES);
+}
+
+bool ContractAccessHistory::Get(const dev::Address& address, Entry& entry)
+{
+    LOCK(cs);
+    auto it = mapEntries.find(address);
+    if (it == mapEntries.end())
+        return false;
+    entry = it->second->second;
+    return true;
+}
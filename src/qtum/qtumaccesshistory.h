@@ -0,0 +1,73 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef QTUMACCESSHISTORY_H
+#define QTUMACCESSHISTORY_H
+
+#include <libdevcore/Address.h>
+#include <libdevcore/FixedHash.h>
+#include <sync.h>
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/** Number of contracts whose recent accesses are remembered */
+static const size_t MAX_ACCESS_HISTORY_CONTRACTS = 4096;
+/** Number of storage slots remembered per contract */
+static const size_t MAX_ACCESS_HISTORY_SLOTS = 64;
+/** Number of other contracts remembered per called contract */
+static const size_t MAX_ACCESS_HISTORY_CALLEES = 8;
+
+/** The accounts an execution read or wrote, with the trie keys of their storage slots */
+typedef std::vector<std::pair<dev::Address, std::vector<dev::h256>>> ContractAccesses;
+
+/**
+ * What the recent executions of each contract touched: the storage slots it used and the
+ * other contracts its calls went to. Every execution of QtumState records its accesses,
+ * including the ones of mempool acceptance and callcontract, so that BlockPrefetcher can
+ * read the trie paths of the slots a block will likely use before the block is connected.
+ *
+ * This is only a hint: the history is bounded and forgets the least recently used
+ * contracts, and a prefetched path that is not used only costs the read.
+ */
+class ContractAccessHistory
+{
+public:
+    struct Entry
+    {
+        //! Trie keys (hashes) of the storage slots, most recently used first
+        std::vector<dev::h256> slots;
+        //! Contracts the calls to this one also touched, most recently used first
+        std::vector<dev::Address> callees;
+    };
+
+    /** Record the accesses of an execution that called the contract called */
+    void Record(const dev::Address& called, const ContractAccesses& accesses);
+
+    /** The recent accesses of a contract, false if it has no history */
+    bool Get(const dev::Address& address, Entry& entry);
+
+private:
+    typedef std::list<std::pair<dev::Address, Entry>> EntryList;
+
+    Entry& GetEntry(const dev::Address& address) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    Mutex cs;
+    //! Most recently used contracts at the front
+    EntryList listEntries GUARDED_BY(cs);
+    std::unordered_map<dev::Address, EntryList::iterator> mapEntries GUARDED_BY(cs);
+};
+
+/**
+ * History of the contract accesses, null unless prefetching is enabled. Contracts are
+ * executed without cs_main (callcontract views, speculation), so the history is shared
+ * with the executions that hold it and they are not affected when it is replaced.
+ */
+std::shared_ptr<ContractAccessHistory> GetContractAccessHistory();
+void SetContractAccessHistory(std::shared_ptr<ContractAccessHistory> history);
+
+#endif
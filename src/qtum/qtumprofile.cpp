@@ -0,0 +1,73 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <qtum/qtumprofile.h>
+#include <libevm/ExtVMFace.h>
+#include <libevm/Instruction.h>
+#include <logging.h>
+
+#include <limits>
+
+std::unique_ptr<ContractProfiler> pcontractprofiler;
+
+OnOpFunc ContractProfiler::OpHook()
+{
+    return [this](uint64_t, uint64_t, dev::eth::Instruction inst, dev::bigint, dev::bigint gasCost,
+        dev::bigint, dev::eth::VMFace const*, dev::eth::ExtVMFace const* ext) {
+        if (++nSteps < nSampleInterval || !ext)
+            return;
+        nSteps = 0;
+        AddSample(ext->myAddress, inst, gasCost > std::numeric_limits<uint64_t>::max() ? std::numeric_limits<uint64_t>::max() : (uint64_t)gasCost);
+    };
+}
+
+void ContractProfiler::AddSample(const dev::Address& contract, dev::eth::Instruction inst, uint64_t gasCost)
+{
+    LOCK(cs);
+    OpcodeProfile& op = mapProfiles[contract].opcodes[inst];
+    op.nCount += nSampleInterval;
+    op.nGas += gasCost * nSampleInterval;
+}
+
+void ContractProfiler::AddExecution(const dev::Address& contract, uint64_t gasUsed, int64_t nTimeMicros)
+{
+    LOCK(cs);
+    ContractProfile& profile = mapProfiles[contract];
+    ++profile.nCalls;
+    profile.nGasUsed += gasUsed;
+    profile.nTimeMicros += nTimeMicros;
+}
+
+std::vector<std::pair<dev::Address, ContractProfile>> ContractProfiler::GetProfile(size_t nMax) const
+{
+    std::vector<std::pair<dev::Address, ContractProfile>> profiles;
+    {
+        LOCK(cs);
+        profiles.assign(mapProfiles.begin(), mapProfiles.end());
+    }
+    std::sort(profiles.begin(), profiles.end(), [](const std::pair<dev::Address, ContractProfile>& a, const std::pair<dev::Address, ContractProfile>& b) {
+        return a.second.nTimeMicros > b.second.nTimeMicros;
+    });
+    if (nMax && profiles.size() > nMax)
+        profiles.resize(nMax);
+    return profiles;
+}
+
+void ContractProfiler::Reset()
+{
+    LOCK(cs);
+    mapProfiles.clear();
+}
+
+void ContractProfiler::LogProfile(size_t nMax) const
+{
+    for (const auto& entry : GetProfile(nMax)) {
+        const ContractProfile& profile = entry.second;
+        auto hottest = std::max_element(profile.opcodes.begin(), profile.opcodes.end(), [](const std::pair<const dev::eth::Instruction, OpcodeProfile>& a, const std::pair<const dev::eth::Instruction, OpcodeProfile>& b) {
+            return a.second.nGas < b.second.nGas;
+        });
+        LogPrintf("Contract profile %s: %u calls, %u gas, %.2fms, most gas in %s\n", entry.first.hex(), profile.nCalls, profile.nGasUsed,
+            profile.nTimeMicros * 0.001, hottest == profile.opcodes.end() ? "-" : dev::eth::instructionInfo(hottest->first).name);
+    }
+}
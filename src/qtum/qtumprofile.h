@@ -0,0 +1,85 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef QTUMPROFILE_H
+#define QTUMPROFILE_H
+
+#include <qtum/qtumstate.h>
+#include <sync.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <vector>
+
+/** Default for -contractprofile, sample one in <n> opcodes (0 = profiler off) */
+static const unsigned int DEFAULT_CONTRACT_PROFILE = 0;
+/** Default for -contractprofilelog, log the profile every <n> blocks (0 = never) */
+static const int DEFAULT_CONTRACT_PROFILE_LOG = 0;
+/** Number of contracts in the periodic log dump */
+static const size_t CONTRACT_PROFILE_LOG_TOP = 10;
+
+/** Sampled executions of one opcode; counts and gas are scaled by the sample interval */
+struct OpcodeProfile
+{
+    uint64_t nCount = 0;
+    uint64_t nGas = 0;
+};
+
+/** Aggregated validation cost of one contract */
+struct ContractProfile
+{
+    //! Transactions calling the contract directly, with their gas and wall time
+    uint64_t nCalls = 0;
+    uint64_t nGasUsed = 0;
+    int64_t nTimeMicros = 0;
+    //! Opcodes run by the contract code, including when reached through calls from other contracts
+    std::map<dev::eth::Instruction, OpcodeProfile> opcodes;
+};
+
+/**
+ * Profile of the contract executions of connected blocks.
+ *
+ * Gas and wall time are taken per transaction around QtumState::execute, which costs
+ * a clock read per transaction. Opcodes are seen through the OnOpFunc hook of the VM,
+ * which runs for every step; to keep that cheap only one in nSampleInterval steps is
+ * recorded, scaled up by the interval. Only the serial pass of ConnectBlock is profiled
+ * (under cs_main), so RPC readers are the only other users of the lock.
+ */
+class ContractProfiler
+{
+public:
+    explicit ContractProfiler(unsigned int _nSampleInterval) : nSampleInterval(std::max(1u, _nSampleInterval)), nSteps(0) {}
+
+    /** Hook to pass to QtumState::execute */
+    OnOpFunc OpHook();
+
+    /** Record a transaction executed against contract */
+    void AddExecution(const dev::Address& contract, uint64_t gasUsed, int64_t nTimeMicros);
+
+    /** Profiles sorted by decreasing wall time, at most nMax of them (0 = all) */
+    std::vector<std::pair<dev::Address, ContractProfile>> GetProfile(size_t nMax = 0) const;
+
+    void Reset();
+
+    /** Log the nMax most expensive contracts */
+    void LogProfile(size_t nMax) const;
+
+    unsigned int SampleInterval() const { return nSampleInterval; }
+
+private:
+    void AddSample(const dev::Address& contract, dev::eth::Instruction inst, uint64_t gasCost);
+
+    const unsigned int nSampleInterval;
+    //! Steps since the last sample, only touched by the validation thread
+    uint64_t nSteps;
+
+    mutable CCriticalSection cs;
+    std::map<dev::Address, ContractProfile> mapProfiles GUARDED_BY(cs);
+};
+
+/** Profiler of connected blocks, if -contractprofile is set */
+extern std::unique_ptr<ContractProfiler> pcontractprofiler;
+
+#endif
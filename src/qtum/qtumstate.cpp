@@ -1,19 +1,30 @@
+#include <algorithm>
+#include <limits>
 #include <sstream>
 #include <util/system.h>
 #include <validation.h>
 #include <chainparams.h>
+#include <memusage.h>
 #include <qtum/qtumstate.h>
+#include <qtum/qtumstatecache.h>
+#include <libevm/VMFactory.h>
+
+#include <boost/program_options.hpp>
 
 using namespace std;
 using namespace dev;
 using namespace dev::eth;
 
-QtumState::QtumState(u256 const& _accountStartNonce, OverlayDB const& _db, const string& _path, BaseState _bs) :
-        State(_accountStartNonce, _db, _bs) {
-            dbUTXO = QtumState::openDB(_path + "/kpgDB", sha3(rlp("")), WithExisting::Trust);
+QtumState::QtumState(u256 const& _accountStartNonce, OverlayDB const& _db, const string& _path, BaseState _bs, db::DatabaseFace* _diskDB) :
+        State(_accountStartNonce, _db, _bs), dbDisk(_diskDB) {
+            dbUTXO = OpenCachedStateDB(_path + "/kpgDB", sha3(rlp("")), nStateNodeCacheSize, 0, &dbUTXODisk);
 	        stateUTXO = SecureTrieDB<Address, OverlayDB>(&dbUTXO);
 }
 
+QtumState::QtumState(QtumState const& _s) : State(_s), dbUTXO(_s.dbUTXO), dbDisk(_s.dbDisk), dbUTXODisk(_s.dbUTXODisk), cacheUTXO(_s.cacheUTXO) {
+    stateUTXO = SecureTrieDB<Address, OverlayDB>(&dbUTXO, _s.stateUTXO.root());
+}
+
 QtumState::QtumState() : dev::eth::State(dev::Invalid256, dev::OverlayDB(), dev::eth::BaseState::PreExisting) {
     dbUTXO = OverlayDB();
     stateUTXO = SecureTrieDB<Address, OverlayDB>(&dbUTXO);
@@ -47,7 +58,12 @@ ResultExecute QtumState::execute(EnvInfo const& _envInfo, SealEngineFace const&
 
     CTransactionRef tx;
     u256 startGasUsed;
+    std::vector<std::pair<dev::Address, dev::h256>> storageRoots;
     const Consensus::Params& consensusParams = Params().GetConsensus();
+    // The rules are those of the parent of the block the transaction is executed in, the
+    // tip when a block is connected, and not of the tip, so that older blocks can be
+    // executed again by the indexes and without cs_main
+    const int64_t nParentHeight = _envInfo.number() - 1;
     try{
         if (_t.isCreation() && _t.value())
             BOOST_THROW_EXCEPTION(CreateWithValue());
@@ -57,7 +73,7 @@ ResultExecute QtumState::execute(EnvInfo const& _envInfo, SealEngineFace const&
         startGasUsed = _envInfo.gasUsed();
         if (!e.execute()){
             e.go(onOp);
-            if(chainActive.Height() >= consensusParams.QIP7Height){
+            if(nParentHeight >= consensusParams.QIP7Height){
             	validateTransfersWithChangeLog();
             }
         } else {
@@ -65,6 +81,10 @@ ResultExecute QtumState::execute(EnvInfo const& _envInfo, SealEngineFace const&
             throw Exception();
         }
         e.finalize();
+        if (!_t.isCreation()) {
+            if (std::shared_ptr<ContractAccessHistory> accesses = GetContractAccessHistory())
+                accesses->Record(_t.receiveAddress(), contractAccesses());
+        }
         if (_p == Permanence::Reverted){
             m_cache.clear();
             cacheUTXO.clear();
@@ -86,6 +106,12 @@ ResultExecute QtumState::execute(EnvInfo const& _envInfo, SealEngineFace const&
 
             qtum::commit(cacheUTXO, stateUTXO, m_cache);
             cacheUTXO.clear();
+            if (fContractStateGrowth)
+                storageRoots = changedStorageRoots();
+            // Committed into the tries after every transaction, and not once per block: the
+            // receipt holds the roots after the transaction, and the empty accounts it touched
+            // are removed (EIP158) at its end. Only writing the nodes to the databases is left
+            // to the end of the block (performByteCode with fCommitDB unset).
             bool removeEmptyAccounts = _envInfo.number() >= _sealEngine.chainParams().EIP158ForkBlock;
             commit(removeEmptyAccounts ? State::CommitBehaviour::RemoveEmptyAccounts : State::CommitBehaviour::KeepEmptyAccounts);
         }
@@ -94,7 +120,7 @@ ResultExecute QtumState::execute(EnvInfo const& _envInfo, SealEngineFace const&
         printfErrorLog(dev::eth::toTransactionException(_e));
         res.excepted = dev::eth::toTransactionException(_e);
         res.gasUsed = _t.gas();
-        if(chainActive.Height() < consensusParams.nFixUTXOCacheHFHeight  && _p != Permanence::Reverted){
+        if(nParentHeight < consensusParams.nFixUTXOCacheHFHeight && _p != Permanence::Reverted){
             deleteAccounts(_sealEngine.deleteAddresses);
             commit(CommitBehaviour::RemoveEmptyAccounts);
         } else {
@@ -106,6 +132,9 @@ ResultExecute QtumState::execute(EnvInfo const& _envInfo, SealEngineFace const&
     if(!_t.isCreation())
         res.newAddress = _t.receiveAddress();
     newAddress = dev::Address();
+    std::vector<TransferInfo> executedTransfers;
+    if(res.excepted == dev::eth::TransactionException::None && !voutLimit)
+        executedTransfers = std::move(transfers);
     transfers.clear();
     if(voutLimit){
         //use old and empty states to create virtual Out Of Gas exception
@@ -132,7 +161,7 @@ ResultExecute QtumState::execute(EnvInfo const& _envInfo, SealEngineFace const&
         if (res.excepted == dev::eth::TransactionException::None)
             return ResultExecute{
                     res,
-                    KPGTransactionReceipt(rootHash(), rootHashUTXO(), startGasUsed + e.gasUsed(), e.logs(), std::move(m_createdContracts), std::move(m_destructedContracts)),
+                    KPGTransactionReceipt(rootHash(), rootHashUTXO(), startGasUsed + e.gasUsed(), e.logs(), std::move(m_createdContracts), std::move(m_destructedContracts), std::move(executedTransfers), storageGrowth(storageRoots)),
                     tx ? *tx : CTransaction()};
         else
             return ResultExecute{
@@ -157,6 +186,57 @@ std::unordered_map<dev::Address, Vin> QtumState::vins() const // temp
     return ret;
 }
 
+size_t QtumState::cacheMemoryUsage() const
+{
+    size_t usage = memusage::DynamicUsage(m_cache) + memusage::DynamicUsage(cacheUTXO);
+    for (auto const& i : m_cache)
+        usage += memusage::DynamicUsage(i.second.storageOverlay()) + memusage::DynamicUsage(i.second.code());
+    return usage;
+}
+
+std::vector<std::pair<dev::Address, dev::h256>> QtumState::changedStorageRoots() const
+{
+    // The storage root in the state trie is still the one before the commit
+    std::vector<std::pair<dev::Address, dev::h256>> ret;
+    for (auto const& i : m_cache) {
+        if (i.second.isDirty() && i.second.isAlive() && !i.second.storageOverlay().empty())
+            ret.emplace_back(i.first, storageRoot(i.first));
+    }
+    return ret;
+}
+
+std::vector<std::pair<dev::Address, StateTrieDiff>> QtumState::storageGrowth(std::vector<std::pair<dev::Address, dev::h256>> const& oldRoots) const
+{
+    std::vector<std::pair<dev::Address, StateTrieDiff>> ret;
+    StateNodeLookup lookup = [this](const dev::h256& key) { return db().lookup(key); };
+    for (auto const& i : oldRoots) {
+        StateTrieDiff diff;
+        if (!DiffStateTrie(lookup, i.second, storageRoot(i.first), diff)) {
+            LogPrintf("%s: storage trie of %s is incomplete\n", __func__, i.first.hex());
+            continue;
+        }
+        if (diff.nLeaves != 0 || diff.nNodes != 0)
+            ret.emplace_back(i.first, diff);
+    }
+    return ret;
+}
+
+ContractAccesses QtumState::contractAccesses() const
+{
+    // The storage overlays hold the slots read from the tries as well as the ones written
+    ContractAccesses ret;
+    for (auto const& i : m_cache) {
+        if (i.second.storageOverlay().empty())
+            continue;
+        std::vector<h256> slots;
+        slots.reserve(i.second.storageOverlay().size());
+        for (auto const& slot : i.second.storageOverlay())
+            slots.push_back(sha3(h256(slot.first)));
+        ret.emplace_back(i.first, std::move(slots));
+    }
+    return ret;
+}
+
 void QtumState::transferBalance(dev::Address const& _from, dev::Address const& _to, dev::u256 const& _value) {
     subBalance(_from, _value);
     addBalance(_to, _value);
@@ -181,7 +261,7 @@ Vin* QtumState::vin(dev::Address const& _addr)
         auto i = cacheUTXO.emplace(
             std::piecewise_construct,
             std::forward_as_tuple(_addr),
-            std::forward_as_tuple(Vin{state[0].toHash<dev::h256>(), state[1].toInt<uint32_t>(), state[2].toInt<dev::u256>(), state[3].toInt<uint8_t>()})
+            std::forward_as_tuple(state)
         );
         return &i.first->second;
     }
@@ -314,72 +394,91 @@ CTransaction CondensingTX::createCondensingTX(){
 
 std::unordered_map<dev::Address, Vin> CondensingTX::createVin(const CTransaction& tx){
     std::unordered_map<dev::Address, Vin> vins;
-    for(auto& b : balances){
-        if(b.first == transaction.sender())
+    for(const CondensingEntry& entry : entries){
+        if(!entry.hasBalance || entry.address == transaction.sender())
             continue;
 
-        if(b.second > 0){
-            vins[b.first] = Vin{uintToh256(tx.GetHash()), nVouts[b.first], b.second, 1};
+        if(entry.balance > 0){
+            vins[entry.address] = Vin{uintToh256(tx.GetHash()), entry.nVout, entry.balance, 1};
         } else {
-            vins[b.first] = Vin{uintToh256(tx.GetHash()), 0, 0, 0};
+            vins[entry.address] = Vin{uintToh256(tx.GetHash()), 0, 0, 0};
         }
     }
     return vins;
 }
 
+CondensingTX::CondensingEntry* CondensingTX::findEntry(const dev::Address& address){
+    auto it = std::lower_bound(entries.begin(), entries.end(), CondensingEntry(address));
+    return it != entries.end() && it->address == address ? &*it : nullptr;
+}
+
 void CondensingTX::selectionVin(){
+    // Every address taking part, once and in address order
+    entries.reserve(transfers.size() * 2);
     for(const TransferInfo& ti : transfers){
-        if(!vins.count(ti.from)){
-            if(auto a = state->vin(ti.from))
-                vins[ti.from] = *a;
-            if(ti.from == transaction.sender() && transaction.value() > 0){
-                vins[ti.from] = Vin{transaction.getHashWith(), transaction.getNVout(), transaction.value(), 1};
-            }
+        entries.emplace_back(ti.from);
+        entries.emplace_back(ti.to);
+    }
+    std::sort(entries.begin(), entries.end());
+    entries.erase(std::unique(entries.begin(), entries.end(), [](const CondensingEntry& a, const CondensingEntry& b) {
+        return a.address == b.address;
+    }), entries.end());
+
+    // A single lookup in the UTXO trie per address
+    for(CondensingEntry& entry : entries){
+        if(auto a = state->vin(entry.address)){
+            entry.vin = *a;
+            entry.hasVin = true;
         }
+    }
 
-        if(!vins.count(ti.to)){
-            if(auto a = state->vin(ti.to))
-                vins[ti.to] = *a;
+    // The value sent by the transaction is the vin of the sender, unless the sender was
+    // first seen as a recipient and already had a vin at that point
+    if(transaction.value() > 0){
+        size_t firstFrom = std::numeric_limits<size_t>::max();
+        size_t firstTo = std::numeric_limits<size_t>::max();
+        for(size_t i = 0; i < transfers.size(); i++){
+            if(transfers[i].from == transaction.sender() && firstFrom == std::numeric_limits<size_t>::max())
+                firstFrom = 2 * i;
+            if(transfers[i].to == transaction.sender() && firstTo == std::numeric_limits<size_t>::max())
+                firstTo = 2 * i + 1;
+        }
+        CondensingEntry* sender = findEntry(transaction.sender());
+        if(sender && firstFrom != std::numeric_limits<size_t>::max() && (firstFrom < firstTo || !sender->hasVin)){
+            sender->vin = Vin{transaction.getHashWith(), transaction.getNVout(), transaction.value(), 1};
+            sender->hasVin = true;
         }
     }
 }
 
 void CondensingTX::calculatePlusAndMinus(){
     for(const TransferInfo& ti : transfers){
-        if(!plusMinusInfo.count(ti.from)){
-            plusMinusInfo[ti.from] = std::make_pair(0, ti.value);
-        } else {
-            plusMinusInfo[ti.from] = std::make_pair(plusMinusInfo[ti.from].first, plusMinusInfo[ti.from].second + ti.value);
-        }
-
-        if(!plusMinusInfo.count(ti.to)){
-            plusMinusInfo[ti.to] = std::make_pair(ti.value, 0);
-        } else {
-            plusMinusInfo[ti.to] = std::make_pair(plusMinusInfo[ti.to].first + ti.value, plusMinusInfo[ti.to].second);
-        }
+        findEntry(ti.from)->minus += ti.value;
+        findEntry(ti.to)->plus += ti.value;
     }
 }
 
 bool CondensingTX::createNewBalances(){
-    for(auto& p : plusMinusInfo){
+    for(CondensingEntry& entry : entries){
         dev::u256 balance = 0;
-        if((vins.count(p.first) && vins[p.first].alive) || (!vins[p.first].alive && !checkDeleteAddress(p.first))){
-            balance = vins[p.first].value;
+        if(entry.hasVin && (entry.vin.alive || !checkDeleteAddress(entry.address))){
+            balance = entry.vin.value;
         }
-        balance += p.second.first;
-        if(balance < p.second.second)
+        balance += entry.plus;
+        if(balance < entry.minus)
             return false;
-        balance -= p.second.second;
-        balances[p.first] = balance;
+        balance -= entry.minus;
+        entry.balance = balance;
+        entry.hasBalance = true;
     }
     return true;
 }
 
 std::vector<CTxIn> CondensingTX::createVins(){
     std::vector<CTxIn> ins;
-    for(auto& v : vins){
-        if((v.second.value > 0 && v.second.alive) || (v.second.value > 0 && !vins[v.first].alive && !checkDeleteAddress(v.first)))
-            ins.push_back(CTxIn(h256Touint(v.second.hash), v.second.nVout, CScript() << OP_SPEND));
+    for(const CondensingEntry& entry : entries){
+        if(entry.hasVin && entry.vin.value > 0 && (entry.vin.alive || !checkDeleteAddress(entry.address)))
+            ins.push_back(CTxIn(h256Touint(entry.vin.hash), entry.vin.nVout, CScript() << OP_SPEND));
     }
     return ins;
 }
@@ -387,18 +486,18 @@ std::vector<CTxIn> CondensingTX::createVins(){
 std::vector<CTxOut> CondensingTX::createVout(){
     size_t count = 0;
     std::vector<CTxOut> outs;
-    for(auto& b : balances){
-        if(b.second > 0){
+    for(CondensingEntry& entry : entries){
+        if(entry.balance > 0){
             CScript script;
-            auto* a = state->account(b.first);
+            auto* a = state->account(entry.address);
             if(a && a->isAlive()){
                 //create a no-exec contract output
-                script = CScript() << valtype{0} << valtype{0} << valtype{0} << valtype{0} << b.first.asBytes() << OP_CALL;
+                script = CScript() << valtype{0} << valtype{0} << valtype{0} << valtype{0} << entry.address.asBytes() << OP_CALL;
             } else {
-                script = CScript() << OP_DUP << OP_HASH160 << b.first.asBytes() << OP_EQUALVERIFY << OP_CHECKSIG;
+                script = CScript() << OP_DUP << OP_HASH160 << entry.address.asBytes() << OP_EQUALVERIFY << OP_CHECKSIG;
             }
-            outs.push_back(CTxOut(CAmount(b.second), script));
-            nVouts[b.first] = count;
+            outs.push_back(CTxOut(CAmount(entry.balance), script));
+            entry.nVout = count;
             count++;
         }
         if(count > MAX_CONTRACT_VOUTS){
@@ -413,3 +512,23 @@ bool CondensingTX::checkDeleteAddress(dev::Address addr){
     return deleteAddresses.count(addr) != 0;
 }
 ///////////////////////////////////////////////////////////////////////////////////////////
+
+bool SelectVM(const std::string& name, const std::vector<std::string>& evmcOptions, std::string& error)
+{
+    // The VM factory of libevm is configured through its command line options
+    namespace po = boost::program_options;
+    std::vector<std::string> args{"--vm", name};
+    for (const std::string& option : evmcOptions) {
+        args.push_back("--evmc");
+        args.push_back(option);
+    }
+    try {
+        po::variables_map vm;
+        po::store(po::command_line_parser(args).options(dev::eth::vmProgramOptions()).run(), vm);
+        po::notify(vm);
+    } catch (const std::exception& e) {
+        error = e.what();
+        return false;
+    }
+    return true;
+}
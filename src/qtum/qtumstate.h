@@ -8,13 +8,16 @@
 #include <util/convert.h>
 #include <primitives/transaction.h>
 #include <qtum/qtumtransaction.h>
+#include <qtum/qtumaccesshistory.h>
+#include <qtum/qtumstatewalk.h>
 
 #include <libethereum/Executive.h>
 #include <libethcore/SealEngine.h>
 
+#include <limits>
+
 using OnOpFunc = std::function<void(uint64_t, uint64_t, dev::eth::Instruction, dev::bigint, dev::bigint, 
     dev::bigint, dev::eth::VMFace const*, dev::eth::ExtVMFace const*)>;
-using plusAndMinus = std::pair<dev::u256, dev::u256>;
 using valtype = std::vector<unsigned char>;
 
 struct TransferInfo{
@@ -23,11 +26,35 @@ struct TransferInfo{
     dev::u256 value;
 };
 
+/**
+ * The output holding the balance of a contract, as in its entry of the UTXO trie. The
+ * value is kept in 64 bits: balances are amounts of coins, below the money supply. The
+ * trie stores the RLP list [hash, nVout, value, alive], with the value encoded as the
+ * u256 it used to be, which gives the same bytes for the same number.
+ */
 struct Vin{
     dev::h256 hash;
+    uint64_t value;
     uint32_t nVout;
-    dev::u256 value;
     uint8_t alive;
+
+    Vin() : value(0), nVout(0), alive(0) {}
+    Vin(dev::h256 const& _hash, uint32_t _nVout, dev::u256 const& _value, uint8_t _alive) :
+        hash(_hash), value(static_cast<uint64_t>(_value)), nVout(_nVout), alive(_alive)
+    {
+        assert(_value <= std::numeric_limits<uint64_t>::max());
+    }
+
+    /** Decode the RLP of a UTXO trie entry */
+    explicit Vin(dev::RLP const& _state) :
+        hash(_state[0].toHash<dev::h256>()), value(_state[2].toInt<uint64_t>()), nVout(_state[1].toInt<uint32_t>()), alive(_state[3].toInt<uint8_t>()) {}
+
+    /** Encode the UTXO trie entry */
+    void streamRLP(dev::RLPStream& _s) const
+    {
+        // An integer of 64 bits would be appended as unsigned
+        _s.appendList(4) << hash << nVout << dev::u256(value) << alive;
+    }
 };
 
 class KPGTransactionReceipt: public dev::eth::TransactionReceipt {
@@ -35,11 +62,15 @@ public:
     KPGTransactionReceipt(dev::h256 const& state_root, dev::h256 const& utxo_root, dev::u256 const& gas_used,
             dev::eth::LogEntries const& log,
             std::vector<std::pair<dev::Address, dev::bytes>>&& createdContracts,
-            std::vector<dev::Address>&& destructedContracts)
+            std::vector<dev::Address>&& destructedContracts,
+            std::vector<TransferInfo>&& transfers = std::vector<TransferInfo>(),
+            std::vector<std::pair<dev::Address, StateTrieDiff>>&& storageGrowth = std::vector<std::pair<dev::Address, StateTrieDiff>>())
     : dev::eth::TransactionReceipt(state_root, gas_used, log),
       m_utxoRoot(utxo_root),
       m_createdContracts(std::move(createdContracts)),
-      m_destructedContracts(std::move(destructedContracts))
+      m_destructedContracts(std::move(destructedContracts)),
+      m_transfers(std::move(transfers)),
+      m_storageGrowth(std::move(storageGrowth))
     {}
 
     dev::h256 const& utxoRoot() const {
@@ -51,11 +82,21 @@ public:
     std::vector<dev::Address> const& destructedContracts() const {
         return m_destructedContracts;
     }
+    //! Value transfers of a successful execution, the ones the condensing transaction settles
+    std::vector<TransferInfo> const& transfers() const {
+        return m_transfers;
+    }
+    //! Storage slots and storage trie nodes each contract gained, when fContractStateGrowth is set
+    std::vector<std::pair<dev::Address, StateTrieDiff>> const& storageGrowth() const {
+        return m_storageGrowth;
+    }
 
 private:
     dev::h256 m_utxoRoot;
     std::vector<std::pair<dev::Address, dev::bytes>> m_createdContracts;
     std::vector<dev::Address> m_destructedContracts;
+    std::vector<TransferInfo> m_transfers;
+    std::vector<std::pair<dev::Address, StateTrieDiff>> m_storageGrowth;
 };
 
 struct ResultExecute{
@@ -73,8 +114,8 @@ namespace qtum{
             if(i.second.alive == 0){
                  _state.remove(i.first);
             } else {
-                dev::RLPStream s(4);
-                s << i.second.hash << i.second.nVout << i.second.value << i.second.alive;
+                dev::RLPStream s;
+                i.second.streamRLP(s);
                 _state.insert(i.first, &s.out());
             }
             ret.insert(i.first);
@@ -85,13 +126,20 @@ namespace qtum{
 
 class CondensingTX;
 
+/** Memory the decoded accounts and vins of globalState may use before they are dropped after a block */
+static const size_t MAX_STATE_CACHE_USAGE = 32 << 20;
+
 class QtumState : public dev::eth::State {
     
 public:
 
     QtumState();
 
-    QtumState(dev::u256 const& _accountStartNonce, dev::OverlayDB const& _db, const std::string& _path, dev::eth::BaseState _bs = dev::eth::BaseState::PreExisting);
+    /** _diskDB is the database behind _db, if the caller wants it reachable through diskDb() */
+    QtumState(dev::u256 const& _accountStartNonce, dev::OverlayDB const& _db, const std::string& _path, dev::eth::BaseState _bs = dev::eth::BaseState::PreExisting, dev::db::DatabaseFace* _diskDB = nullptr);
+
+    /** Fork of another state sharing its databases; the UTXO trie is rebound to the copied overlay. */
+    QtumState(QtumState const& _s);
 
     ResultExecute execute(dev::eth::EnvInfo const& _envInfo, dev::eth::SealEngineFace const& _sealEngine, QtumTransaction const& _t, dev::eth::Permanence _p = dev::eth::Permanence::Committed, dev::eth::OnOpFunc const& _onOp = OnOpFunc());
 
@@ -101,12 +149,23 @@ public:
 
     dev::h256 rootHashUTXO() const { return stateUTXO.root(); }
 
+    /** Memory used by the accounts, with their cached storage and code, and the vins decoded since the last commit or setRoot */
+    size_t cacheMemoryUsage() const;
+
+    /** Drop the decoded accounts and vins; they are read from the tries again when needed. Only valid without uncommitted changes. */
+    void clearCaches() { setRoot(rootHash()); setRootUTXO(rootHashUTXO()); }
+
     std::unordered_map<dev::Address, Vin> vins() const; // temp
 
     dev::OverlayDB const& dbUtxo() const { return dbUTXO; }
 
     dev::OverlayDB& dbUtxo() { return dbUTXO; }
 
+    /** Databases behind the state and UTXO overlays, shared by all copies of this state */
+    dev::db::DatabaseFace* diskDb() const { return dbDisk; }
+
+    dev::db::DatabaseFace* diskDbUtxo() const { return dbUTXODisk; }
+
     static const dev::Address createQtumAddress(dev::h256 hashTx, uint32_t voutNumber){
         uint256 hashTXid(h256Touint(hashTx));
         std::vector<unsigned char> txIdAndVout(hashTXid.begin(), hashTXid.end());
@@ -148,12 +207,25 @@ private:
 
     void printfErrorLog(const dev::eth::TransactionException er);
 
+    /** Storage roots of the live accounts whose storage the pending commit changes */
+    std::vector<std::pair<dev::Address, dev::h256>> changedStorageRoots() const;
+
+    /** Diff the storage tries of the accounts against the roots they had before the commit */
+    std::vector<std::pair<dev::Address, StateTrieDiff>> storageGrowth(std::vector<std::pair<dev::Address, dev::h256>> const& oldRoots) const;
+
+    /** The accounts the execution touched, with the storage slots it read or wrote */
+    ContractAccesses contractAccesses() const;
+
     dev::Address newAddress;
 
     std::vector<TransferInfo> transfers;
 
     dev::OverlayDB dbUTXO;
 
+    dev::db::DatabaseFace* dbDisk = nullptr;
+
+    dev::db::DatabaseFace* dbUTXODisk = nullptr;
+
 	dev::eth::SecureTrieDB<dev::Address, dev::OverlayDB> stateUTXO;
 
 	std::unordered_map<dev::Address, Vin> cacheUTXO;
@@ -217,13 +289,30 @@ private:
 
     bool checkDeleteAddress(dev::Address addr);
 
-    std::map<dev::Address, plusAndMinus> plusMinusInfo;
+    /** Everything known about one address taking part in the transfers */
+    struct CondensingEntry{
+        explicit CondensingEntry(const dev::Address& _address) : address(_address) {}
 
-    std::map<dev::Address, dev::u256> balances;
+        dev::Address address;
+        //! Current vin, from the UTXO trie or the transaction itself
+        bool hasVin = false;
+        Vin vin{};
+        //! Received and sent value
+        dev::u256 plus = 0;
+        dev::u256 minus = 0;
+        //! New balance, once computed by createNewBalances
+        bool hasBalance = false;
+        dev::u256 balance = 0;
+        //! Output of the new balance in the condensing transaction
+        uint32_t nVout = 0;
 
-    std::map<dev::Address, uint32_t> nVouts;
+        bool operator<(const CondensingEntry& other) const { return address < other.address; }
+    };
 
-    std::map<dev::Address, Vin> vins;
+    CondensingEntry* findEntry(const dev::Address& address);
+
+    //! Sorted by address, which is the order of the inputs and outputs of the condensing transaction
+    std::vector<CondensingEntry> entries;
 
     const std::vector<TransferInfo>& transfers;
 
@@ -239,3 +328,13 @@ private:
 
 };
 ///////////////////////////////////////////////////////////////////////////////////////////
+
+/** Default EVM implementation, see SelectVM */
+static const char* const DEFAULT_VM = "legacy";
+
+/**
+ * Select the EVM implementation contracts execute on: "legacy", "interpreter" or the path
+ * of an EVMC module such as evmone, with options of the module as name=value. Must be
+ * called before any contract executes.
+ */
+bool SelectVM(const std::string& name, const std::vector<std::string>& evmcOptions, std::string& error);
@@ -0,0 +1,392 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <qtum/qtumstatecache.h>
+#include <dbwrapper.h>
+#include <libdevcore/DBFactory.h>
+#include <libdevcore/CommonIO.h>
+#include <libdevcore/LevelDB.h>
+#include <libethcore/Common.h>
+#include <libethereum/State.h>
+#include <memusage.h>
+
+#include <boost/filesystem.hpp>
+
+size_t nStateNodeCacheSize = DEFAULT_STATE_NODE_CACHE << 19;
+size_t nContractCodeCacheSize = DEFAULT_CONTRACT_CODE_CACHE << 20;
+bool fStateInMemory = DEFAULT_MEMORY_STATE;
+ContractStorageCache contractStorageCache(MAX_CONTRACT_STORAGE_CACHE_BYTES);
+
+namespace {
+
+/**
+ * Trie nodes are always RLP lists, so their encoding starts with a byte of at least 0xc0.
+ * Anything else stored in the state database is contract bytecode. Code that happens to
+ * start with such a byte is cached as a node, which only affects which partition holds it.
+ */
+bool IsTrieNode(const std::string& value)
+{
+    return !value.empty() && (unsigned char)value[0] >= 0xc0;
+}
+
+/**
+ * Whether a value is bytecode keyed by its code hash. Many contracts are created with the
+ * same bytecode, which dev::eth::State writes again for each of them.
+ */
+bool IsCode(const std::string& key, const std::string& value)
+{
+    return key.size() == dev::h256::size && !IsTrieNode(value);
+}
+
+/**
+ * Write batch which remembers what it wrote, so the cache can be updated after commit.
+ * Bytecode is only added to the underlying batch on commit, if it is not stored yet.
+ */
+class CachingWriteBatch : public dev::db::WriteBatchFace
+{
+public:
+    explicit CachingWriteBatch(std::unique_ptr<dev::db::WriteBatchFace> _batch) : batch(std::move(_batch)) {}
+
+    void insert(dev::db::Slice _key, dev::db::Slice _value) override
+    {
+        std::string key(_key.toString()), value(_value.toString());
+        if (IsCode(key, value))
+            code.push_back(inserted.size());
+        else
+            batch->insert(_key, _value);
+        inserted.emplace_back(std::move(key), std::move(value));
+    }
+
+    void kill(dev::db::Slice _key) override
+    {
+        batch->kill(_key);
+        killed.push_back(_key.toString());
+    }
+
+    std::unique_ptr<dev::db::WriteBatchFace> batch;
+    std::vector<std::pair<std::string, std::string>> inserted;
+    //! Positions in inserted of the bytecode not added to batch yet
+    std::vector<size_t> code;
+    std::vector<std::string> killed;
+};
+
+/** Heap memory of a string, short strings are stored inline */
+size_t StringUsage(const std::string& s)
+{
+    return s.capacity() > 15 ? memusage::MallocUsage(s.capacity() + 1) : 0;
+}
+
+/** Heap memory of a node of a std::list */
+template <typename X>
+size_t ListNodeUsage()
+{
+    return memusage::MallocUsage(sizeof(X) + 2 * sizeof(void*));
+}
+
+}
+
+StateNodeCacheDB::StateNodeCacheDB(std::unique_ptr<dev::db::DatabaseFace> _db, size_t _maxNodeBytes, size_t _maxCodeBytes) :
+    db(std::move(_db)), fWriteLog(false), nodes(_maxNodeBytes), codes(_maxCodeBytes) {}
+
+std::string StateNodeCacheDB::lookup(dev::db::Slice _key) const
+{
+    std::string key(_key.toString());
+    {
+        LOCK(cs);
+        const std::string* value = nodes.find(key);
+        if (!value)
+            value = codes.find(key);
+        if (value)
+            return *value;
+    }
+
+    std::string value = db->lookup(_key);
+    if (!value.empty()) {
+        LOCK(cs);
+        cacheNode(key, value);
+    }
+    return value;
+}
+
+bool StateNodeCacheDB::exists(dev::db::Slice _key) const
+{
+    {
+        LOCK(cs);
+        std::string key(_key.toString());
+        if (nodes.contains(key) || codes.contains(key))
+            return true;
+    }
+    return db->exists(_key);
+}
+
+void StateNodeCacheDB::insert(dev::db::Slice _key, dev::db::Slice _value)
+{
+    std::string key(_key.toString()), value(_value.toString());
+    LOCK(csWrite);
+    // Bytecode is looked up on disk: the cache may still hold code the pruner just deleted
+    if (!IsCode(key, value) || !db->exists(_key))
+        db->insert(_key, _value);
+    if (fWriteLog)
+        setWritten.insert(key);
+    LOCK(cs);
+    cacheNode(key, value);
+}
+
+void StateNodeCacheDB::kill(dev::db::Slice _key)
+{
+    LOCK(csWrite);
+    db->kill(_key);
+    LOCK(cs);
+    uncacheNode(_key.toString());
+}
+
+std::unique_ptr<dev::db::WriteBatchFace> StateNodeCacheDB::createWriteBatch() const
+{
+    return std::unique_ptr<dev::db::WriteBatchFace>(new CachingWriteBatch(db->createWriteBatch()));
+}
+
+void StateNodeCacheDB::commit(std::unique_ptr<dev::db::WriteBatchFace> _batch)
+{
+    CachingWriteBatch* batch = dynamic_cast<CachingWriteBatch*>(_batch.get());
+    LOCK(csWrite);
+    if (!batch) {
+        // Not one of ours; we cannot tell what changed, so start over.
+        // Only the pruner writes through its own batches, see KillUnwritten.
+        db->commit(std::move(_batch));
+        LOCK(cs);
+        nodes.clear();
+        codes.clear();
+        return;
+    }
+
+    // The key of bytecode is its hash, so code already stored needs no second copy
+    for (size_t i : batch->code) {
+        const auto& code = batch->inserted[i];
+        dev::db::Slice key(code.first.data(), code.first.size());
+        if (!db->exists(key))
+            batch->batch->insert(key, dev::db::Slice(code.second.data(), code.second.size()));
+    }
+
+    db->commit(std::move(batch->batch));
+    if (fWriteLog) {
+        for (const auto& node : batch->inserted)
+            setWritten.insert(node.first);
+    }
+    LOCK(cs);
+    for (const std::string& key : batch->killed)
+        uncacheNode(key);
+    for (const auto& node : batch->inserted)
+        cacheNode(node.first, node.second);
+}
+
+void StateNodeCacheDB::BeginWriteLog()
+{
+    LOCK(csWrite);
+    fWriteLog = true;
+    setWritten.clear();
+}
+
+void StateNodeCacheDB::EndWriteLog()
+{
+    LOCK(csWrite);
+    fWriteLog = false;
+    std::unordered_set<std::string>().swap(setWritten);
+}
+
+size_t StateNodeCacheDB::KillUnwritten(const std::vector<std::string>& keys)
+{
+    LOCK(csWrite);
+    std::unique_ptr<dev::db::WriteBatchFace> batch = db->createWriteBatch();
+    std::vector<const std::string*> killed;
+    for (const std::string& key : keys) {
+        // A node written again is used by a block connected since the roots were taken
+        if (setWritten.count(key))
+            continue;
+        batch->kill(dev::db::Slice(key.data(), key.size()));
+        killed.push_back(&key);
+    }
+    db->commit(std::move(batch));
+    LOCK(cs);
+    for (const std::string* key : killed)
+        uncacheNode(*key);
+    return killed.size();
+}
+
+void StateNodeCacheDB::forEach(std::function<bool(dev::db::Slice, dev::db::Slice)> f) const
+{
+    db->forEach(f);
+}
+
+size_t StateNodeCacheDB::cachedBytes() const
+{
+    LOCK(cs);
+    return nodes.size();
+}
+
+size_t StateNodeCacheDB::cachedCodeBytes() const
+{
+    LOCK(cs);
+    return codes.size();
+}
+
+void StateNodeCacheDB::cacheNode(const std::string& key, const std::string& value) const
+{
+    if (IsTrieNode(value)) {
+        codes.erase(key);
+        nodes.insert(key, value);
+    } else {
+        nodes.erase(key);
+        codes.insert(key, value);
+    }
+}
+
+void StateNodeCacheDB::uncacheNode(const std::string& key) const
+{
+    nodes.erase(key);
+    codes.erase(key);
+}
+
+const std::string* StateNodeCacheDB::Partition::find(const std::string& key)
+{
+    auto it = mapEntries.find(key);
+    if (it == mapEntries.end())
+        return nullptr;
+    listEntries.splice(listEntries.begin(), listEntries, it->second);
+    return &it->second->second;
+}
+
+void StateNodeCacheDB::Partition::insert(const std::string& key, const std::string& value)
+{
+    erase(key);
+    if (EntryUsage(key, value) > nMaxBytes)
+        return;
+
+    listEntries.emplace_front(key, value);
+    mapEntries.emplace(key, listEntries.begin());
+    nBytes += EntryUsage(key, value);
+
+    while (nBytes > nMaxBytes) {
+        const auto& oldest = listEntries.back();
+        nBytes -= EntryUsage(oldest.first, oldest.second);
+        mapEntries.erase(oldest.first);
+        listEntries.pop_back();
+    }
+}
+
+void StateNodeCacheDB::Partition::erase(const std::string& key)
+{
+    auto it = mapEntries.find(key);
+    if (it == mapEntries.end())
+        return;
+    nBytes -= EntryUsage(it->second->first, it->second->second);
+    listEntries.erase(it->second);
+    mapEntries.erase(it);
+}
+
+size_t StateNodeCacheDB::Partition::size() const
+{
+    return nBytes + memusage::MallocUsage(sizeof(void*) * mapEntries.bucket_count());
+}
+
+size_t StateNodeCacheDB::Partition::EntryUsage(const std::string& key, const std::string& value)
+{
+    return ListNodeUsage<EntryList::value_type>() + memusage::MallocUsage(sizeof(memusage::unordered_node<std::pair<const std::string, EntryList::iterator>>)) +
+           2 * StringUsage(key) + StringUsage(value);
+}
+
+void StateNodeCacheDB::Partition::clear()
+{
+    listEntries.clear();
+    mapEntries.clear();
+    nBytes = 0;
+}
+
+static std::string StorageCacheKey(const dev::h160& address, const dev::h256& storageRoot)
+{
+    std::string key((const char*)address.data(), dev::h160::size);
+    key.append((const char*)storageRoot.data(), dev::h256::size);
+    return key;
+}
+
+std::shared_ptr<const ContractStorage> ContractStorageCache::get(const dev::h160& address, const dev::h256& storageRoot)
+{
+    LOCK(cs);
+    auto it = mapEntries.find(StorageCacheKey(address, storageRoot));
+    if (it == mapEntries.end())
+        return nullptr;
+    listEntries.splice(listEntries.begin(), listEntries, it->second);
+    return it->second->second;
+}
+
+void ContractStorageCache::put(const dev::h160& address, const dev::h256& storageRoot, std::shared_ptr<const ContractStorage> storage)
+{
+    size_t usage = EntryUsage(*storage);
+    if (usage > nMaxBytes)
+        return;
+
+    std::string key = StorageCacheKey(address, storageRoot);
+    LOCK(cs);
+    if (mapEntries.count(key))
+        return;
+    listEntries.emplace_front(key, std::move(storage));
+    mapEntries.emplace(key, listEntries.begin());
+    nBytes += usage;
+
+    while (nBytes > nMaxBytes) {
+        const auto& oldest = listEntries.back();
+        nBytes -= EntryUsage(*oldest.second);
+        mapEntries.erase(oldest.first);
+        listEntries.pop_back();
+    }
+}
+
+size_t ContractStorageCache::DynamicMemoryUsage()
+{
+    LOCK(cs);
+    return nBytes + memusage::MallocUsage(sizeof(void*) * mapEntries.bucket_count());
+}
+
+size_t ContractStorageCache::EntryUsage(const ContractStorage& storage)
+{
+    // The keys are 52 bytes, so they are on the heap, once in the list and once in the map
+    const size_t keyUsage = memusage::MallocUsage(dev::h160::size + dev::h256::size + 1);
+    return ListNodeUsage<EntryList::value_type>() + memusage::MallocUsage(sizeof(memusage::unordered_node<std::pair<const std::string, EntryList::iterator>>)) +
+           2 * keyUsage + memusage::MallocUsage(sizeof(ContractStorage)) + memusage::MallocUsage(sizeof(memusage::stl_shared_counter)) +
+           memusage::DynamicUsage(storage);
+}
+
+dev::OverlayDB OpenCachedStateDB(const std::string& basePath, dev::h256 const& genesisHash, size_t nCacheBytes, size_t nCodeCacheBytes, dev::db::DatabaseFace** ppDiskDB)
+{
+    if (fStateInMemory) {
+        // The entries are in memory already, a cache in front of them would only copy them
+        std::unique_ptr<dev::db::DatabaseFace> db = dev::db::DBFactory::create(dev::db::DatabaseKind::MemoryDB);
+        if (ppDiskDB)
+            *ppDiskDB = db.get();
+        return dev::OverlayDB(std::move(db));
+    }
+
+    leveldb::Cache* sharedBlockCache = GetSharedBlockCache();
+    if (nCacheBytes == 0 && nCodeCacheBytes == 0 && !ppDiskDB && !sharedBlockCache)
+        return dev::eth::State::openDB(basePath, genesisHash, dev::WithExisting::Trust);
+
+    // Same layout as dev::eth::State::openDB, so existing databases are picked up unchanged
+    boost::filesystem::path path(basePath);
+    path /= boost::filesystem::path(dev::toHex(genesisHash.ref().cropped(0, 4))) / boost::filesystem::path(dev::toString(dev::eth::c_databaseVersion));
+    boost::filesystem::create_directories(path);
+
+    std::unique_ptr<dev::db::DatabaseFace> db;
+    if (sharedBlockCache) {
+        // Read through the block cache of the node databases rather than a default one
+        leveldb::Options options = dev::db::LevelDB::defaultDBOptions();
+        options.block_cache = sharedBlockCache;
+        db.reset(new dev::db::LevelDB(path / boost::filesystem::path("state"), dev::db::LevelDB::defaultReadOptions(),
+                                      dev::db::LevelDB::defaultWriteOptions(), options));
+    } else {
+        db = dev::db::DBFactory::create(path / boost::filesystem::path("state"));
+    }
+    std::unique_ptr<dev::db::DatabaseFace> cachedb(new StateNodeCacheDB(std::move(db), nCacheBytes, nCodeCacheBytes));
+    if (ppDiskDB)
+        *ppDiskDB = cachedb.get();
+    return dev::OverlayDB(std::move(cachedb));
+}
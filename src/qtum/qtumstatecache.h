@@ -0,0 +1,180 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef QTUMSTATECACHE_H
+#define QTUMSTATECACHE_H
+
+#include <libdevcore/db.h>
+#include <libdevcore/OverlayDB.h>
+#include <libdevcore/FixedHash.h>
+#include <sync.h>
+
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/** Default for -statenodecache, in MiB (shared by the state and the UTXO trie) */
+static const int64_t DEFAULT_STATE_NODE_CACHE = 64;
+/** Default for -contractcodecache, in MiB */
+static const int64_t DEFAULT_CONTRACT_CODE_CACHE = 16;
+/** Default for -memorystate */
+static const bool DEFAULT_MEMORY_STATE = false;
+
+/** Size of the trie node cache of each state database, in bytes (set at startup) */
+extern size_t nStateNodeCacheSize;
+/** Size of the contract bytecode cache of the EVM state database, in bytes (set at startup) */
+extern size_t nContractCodeCacheSize;
+/** Whether the state databases are kept in memory instead of in LevelDB (set at startup) */
+extern bool fStateInMemory;
+
+/**
+ * Read-through LRU cache of trie nodes in front of a state database.
+ *
+ * setRoot() and setRootUTXO() drop the decoded account and vin caches of QtumState,
+ * so flipping between the tip and an older root (historical callcontract, short reorgs,
+ * TestBlockValidity, TemporaryState) used to re-read every trie node from LevelDB.
+ * Trie nodes are content addressed, so caching them by key keeps the node sets of all
+ * recently used roots hot at once, whichever root is currently selected.
+ *
+ * Contract bytecode lives in the same database keyed by its code hash. It is kept in a
+ * separate partition, so that the code of hot contracts is not evicted by the much more
+ * numerous trie nodes touched by each block. All copies of globalState (block connection,
+ * mempool acceptance, callcontract views) share the database and thus both caches.
+ * Contracts created with the same bytecode share its entry, which is not written again.
+ */
+class StateNodeCacheDB : public dev::db::DatabaseFace
+{
+public:
+    StateNodeCacheDB(std::unique_ptr<dev::db::DatabaseFace> _db, size_t _maxNodeBytes, size_t _maxCodeBytes = 0);
+
+    std::string lookup(dev::db::Slice _key) const override;
+    bool exists(dev::db::Slice _key) const override;
+    void insert(dev::db::Slice _key, dev::db::Slice _value) override;
+    void kill(dev::db::Slice _key) override;
+
+    std::unique_ptr<dev::db::WriteBatchFace> createWriteBatch() const override;
+    void commit(std::unique_ptr<dev::db::WriteBatchFace> _batch) override;
+
+    void forEach(std::function<bool(dev::db::Slice, dev::db::Slice)> f) const override;
+
+    /** Memory used by the trie node and the bytecode caches, including their overhead */
+    size_t cachedBytes() const;
+    size_t cachedCodeBytes() const;
+
+    /**
+     * Record the keys written from now on, until EndWriteLog. The state pruner takes
+     * the roots to keep and begins the log under cs_main, then deletes the nodes the
+     * roots do not reach through KillUnwritten while blocks are being connected.
+     */
+    void BeginWriteLog();
+    void EndWriteLog();
+    /** Delete the keys not written since BeginWriteLog; returns the number deleted */
+    size_t KillUnwritten(const std::vector<std::string>& keys);
+
+private:
+    /** LRU map from database key to value, bounded by its memory usage */
+    class Partition
+    {
+    public:
+        explicit Partition(size_t _maxBytes) : nMaxBytes(_maxBytes), nBytes(0) {}
+
+        const std::string* find(const std::string& key);
+        void insert(const std::string& key, const std::string& value);
+        void erase(const std::string& key);
+        bool contains(const std::string& key) const { return mapEntries.count(key); }
+        void clear();
+        size_t size() const;
+
+    private:
+        typedef std::list<std::pair<std::string, std::string>> EntryList;
+
+        /** Memory used by an entry: its list and map nodes and the strings, the key being in both */
+        static size_t EntryUsage(const std::string& key, const std::string& value);
+
+        const size_t nMaxBytes;
+        //! Most recently used entries at the front
+        EntryList listEntries;
+        std::unordered_map<std::string, EntryList::iterator> mapEntries;
+        //! Sum of the EntryUsage of the entries
+        size_t nBytes;
+    };
+
+    void cacheNode(const std::string& key, const std::string& value) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+    void uncacheNode(const std::string& key) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    std::unique_ptr<dev::db::DatabaseFace> db;
+
+    //! Serializes the writes with KillUnwritten, taken before cs
+    Mutex csWrite;
+    bool fWriteLog GUARDED_BY(csWrite);
+    std::unordered_set<std::string> setWritten GUARDED_BY(csWrite);
+
+    mutable CCriticalSection cs;
+    mutable Partition nodes GUARDED_BY(cs);
+    mutable Partition codes GUARDED_BY(cs);
+};
+
+/** Memory the contract storage cache may use, in bytes */
+static const size_t MAX_CONTRACT_STORAGE_CACHE_BYTES = 64 << 20;
+
+/** Decoded storage of an account, as returned by dev::eth::State::storage() */
+typedef std::map<dev::h256, std::pair<dev::u256, dev::u256>> ContractStorage;
+
+/**
+ * LRU cache of decoded contract storage keyed by (address, storage root).
+ *
+ * Walking the storage trie of a large contract for every getstorage call is expensive,
+ * although its storage rarely changes between calls. Keying by the storage root makes
+ * entries valid for any state root in which the account storage is unchanged, so they
+ * survive setRoot() and block connection, and are never stale.
+ *
+ * The SLOAD reads of executions do not go through it: dev::eth::State reads slots through
+ * its accounts and the storage trie, with no virtual hook for QtumState to serve them
+ * from here. Their trie node reads are served by StateNodeCacheDB instead.
+ */
+class ContractStorageCache
+{
+public:
+    explicit ContractStorageCache(size_t _maxBytes) : nMaxBytes(_maxBytes), nBytes(0) {}
+
+    std::shared_ptr<const ContractStorage> get(const dev::h160& address, const dev::h256& storageRoot);
+    void put(const dev::h160& address, const dev::h256& storageRoot, std::shared_ptr<const ContractStorage> storage);
+
+    size_t DynamicMemoryUsage();
+
+private:
+    typedef std::list<std::pair<std::string, std::shared_ptr<const ContractStorage>>> EntryList;
+
+    /** Memory used by an entry, including the decoded storage it holds */
+    static size_t EntryUsage(const ContractStorage& storage);
+
+    const size_t nMaxBytes;
+
+    CCriticalSection cs;
+    //! Most recently used entries at the front
+    EntryList listEntries GUARDED_BY(cs);
+    std::unordered_map<std::string, EntryList::iterator> mapEntries GUARDED_BY(cs);
+    //! Sum of the EntryUsage of the entries
+    size_t nBytes GUARDED_BY(cs);
+};
+
+extern ContractStorageCache contractStorageCache;
+
+/**
+ * Open a state database like dev::eth::State::openDB, with a trie node cache of
+ * nCacheBytes and a bytecode cache of nCodeCacheBytes in front of it (no cache if
+ * both are 0). If ppDiskDB is set, it receives the database behind the overlay, which
+ * is owned by the returned overlay and its copies; the cache layer is then always used,
+ * so that writes made through that pointer keep the caches consistent. The database
+ * reads through the shared LevelDB block cache if one was created. With fStateInMemory
+ * the database is in memory, without caches, and nothing is read from or written to
+ * basePath.
+ */
+dev::OverlayDB OpenCachedStateDB(const std::string& basePath, dev::h256 const& genesisHash, size_t nCacheBytes, size_t nCodeCacheBytes = 0, dev::db::DatabaseFace** ppDiskDB = nullptr);
+
+#endif
@@ -0,0 +1,202 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <qtum/qtumstateprune.h>
+#include <qtum/qtumstatecache.h>
+#include <qtum/qtumstatewalk.h>
+#include <logging.h>
+#include <util/system.h>
+#include <util/time.h>
+
+std::unique_ptr<StatePruner> pstatepruner;
+
+namespace {
+
+/** Number of deletions per database write batch */
+static const size_t PRUNE_STATE_BATCH_SIZE = 10000;
+
+/**
+ * Delete every entry of db that is not marked. With cacheDB, the entries are deleted
+ * through it, which leaves alone those written since the roots were taken. Stops early
+ * if fStop is set; the entries not deleted yet are deleted by the next run.
+ */
+size_t Sweep(dev::db::DatabaseFace& db, StateNodeCacheDB* cacheDB, const StateNodeSet& marked, const std::atomic<bool>& fStop)
+{
+    std::unique_ptr<dev::db::WriteBatchFace> batch = cacheDB ? nullptr : db.createWriteBatch();
+    std::vector<std::string> keys;
+    size_t nBatch = 0;
+    size_t nDeleted = 0;
+    // LevelDB iterators read from a snapshot, so writing while iterating is safe
+    db.forEach([&](dev::db::Slice key, dev::db::Slice) {
+        if (fStop)
+            return false;
+        if (key.size() != dev::h256::size)
+            return true;
+        dev::h256 hash(reinterpret_cast<const dev::byte*>(key.data()), dev::h256::ConstructFromPointer);
+        if (marked.count(hash))
+            return true;
+        if (cacheDB) {
+            keys.push_back(key.toString());
+        } else {
+            batch->kill(key);
+            ++nDeleted;
+        }
+        if (++nBatch >= PRUNE_STATE_BATCH_SIZE) {
+            if (cacheDB) {
+                nDeleted += cacheDB->KillUnwritten(keys);
+                keys.clear();
+            } else {
+                db.commit(std::move(batch));
+                batch = db.createWriteBatch();
+            }
+            nBatch = 0;
+        }
+        return true;
+    });
+    if (cacheDB)
+        nDeleted += cacheDB->KillUnwritten(keys);
+    else
+        db.commit(std::move(batch));
+    return nDeleted;
+}
+
+}
+
+StatePruner::StatePruner(dev::db::DatabaseFace* _stateDB, dev::db::DatabaseFace* _utxoDB, unsigned int _nKeepBlocks) :
+    stateDB(_stateDB), utxoDB(_utxoDB), nKeepBlocks(_nKeepBlocks), m_pending(false), m_running(false), m_next_pin(0), m_stop(false)
+{
+    stateCacheDB = dynamic_cast<StateNodeCacheDB*>(stateDB);
+    utxoCacheDB = dynamic_cast<StateNodeCacheDB*>(utxoDB);
+    if (!stateCacheDB || !utxoCacheDB)
+        stateCacheDB = utxoCacheDB = nullptr;
+    m_thread = std::thread(&TraceThread<std::function<void()>>, "statepruner", std::function<void()>(std::bind(&StatePruner::ThreadPrune, this)));
+}
+
+StatePruner::~StatePruner()
+{
+    {
+        LOCK(m_mutex);
+        m_stop = true;
+        m_cond.notify_all();
+    }
+    m_thread.join();
+    if (stateCacheDB) {
+        stateCacheDB->EndWriteLog();
+        utxoCacheDB->EndWriteLog();
+    }
+}
+
+size_t StatePruner::Prune(const std::vector<StateRoots>& roots)
+{
+    int64_t nStart = GetTimeMillis();
+
+    StateNodeSet markedState;
+    StateTrieWalker stateWalker(*stateDB, markedState);
+    StateNodeSet markedUTXO;
+    StateTrieWalker utxoWalker(*utxoDB, markedUTXO);
+    for (const StateRoots& root : roots) {
+        stateWalker.WalkState(root.first);
+        utxoWalker.Walk(root.second);
+    }
+
+    // A node missing from a kept root means the databases are already inconsistent;
+    // sweeping would not make it worse, but the operator should know.
+    if (stateWalker.Missing() || utxoWalker.Missing())
+        LogPrintf("Warning: %u contract state nodes referenced by recent blocks are missing\n", stateWalker.Missing() + utxoWalker.Missing());
+
+    size_t nDeleted = Sweep(*stateDB, stateCacheDB, markedState, m_stop) + Sweep(*utxoDB, utxoCacheDB, markedUTXO, m_stop);
+    LogPrint(BCLog::PRUNE, "Pruned %u contract state nodes (%u state and %u UTXO nodes kept) in %dms%s\n",
+        nDeleted, markedState.size(), markedUTXO.size(), GetTimeMillis() - nStart, m_stop ? ", interrupted" : "");
+    return nDeleted;
+}
+
+bool StatePruner::PruneInBackground(std::vector<StateRoots> roots)
+{
+    if (!stateCacheDB) {
+        Prune(roots);
+        return true;
+    }
+
+    LOCK(m_mutex);
+    if (m_pending || m_running)
+        return false;
+    // Writes from now on may use nodes the roots do not reach again
+    stateCacheDB->BeginWriteLog();
+    utxoCacheDB->BeginWriteLog();
+    m_roots = std::move(roots);
+    m_pending = true;
+    m_cond.notify_all();
+    return true;
+}
+
+void StatePruner::Wait()
+{
+    WAIT_LOCK(m_mutex, lock);
+    while (m_pending || m_running)
+        m_cond.wait(lock);
+}
+
+uint64_t StatePruner::Pin(const StateRoots& roots)
+{
+    LOCK(m_mutex);
+    m_pins.emplace(m_next_pin, roots);
+    return m_next_pin++;
+}
+
+void StatePruner::Unpin(uint64_t id)
+{
+    LOCK(m_mutex);
+    m_pins.erase(id);
+}
+
+std::vector<StateRoots> StatePruner::PinnedRoots() const
+{
+    LOCK(m_mutex);
+    std::vector<StateRoots> roots;
+    for (const auto& pin : m_pins)
+        roots.push_back(pin.second);
+    return roots;
+}
+
+void StatePruner::ThreadPrune()
+{
+    while (true) {
+        std::vector<StateRoots> roots;
+        {
+            WAIT_LOCK(m_mutex, lock);
+            while (!m_stop && !m_pending)
+                m_cond.wait(lock);
+            if (m_stop)
+                return;
+            roots = std::move(m_roots);
+            m_pending = false;
+            m_running = true;
+        }
+
+        try {
+            Prune(roots);
+        } catch (const std::exception& e) {
+            // Nothing reachable from the roots was deleted, the next run starts over
+            LogPrintf("%s: %s\n", __func__, e.what());
+        }
+
+        LOCK(m_mutex);
+        stateCacheDB->EndWriteLog();
+        utxoCacheDB->EndWriteLog();
+        m_running = false;
+        m_cond.notify_all();
+    }
+}
+
+StateRootsPin::StateRootsPin(const StateRoots& roots) : pruner(pstatepruner.get()), id(0)
+{
+    if (pruner)
+        id = pruner->Pin(roots);
+}
+
+StateRootsPin::~StateRootsPin()
+{
+    if (pruner)
+        pruner->Unpin(id);
+}
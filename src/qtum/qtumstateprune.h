@@ -0,0 +1,122 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef QTUMSTATEPRUNE_H
+#define QTUMSTATEPRUNE_H
+
+#include <libdevcore/db.h>
+#include <libdevcore/FixedHash.h>
+#include <sync.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+class StateNodeCacheDB;
+
+/** Default for -prunestate, in blocks (0 = keep the contract state of all blocks) */
+static const unsigned int DEFAULT_PRUNE_STATE = 0;
+/** The contract state is pruned once every this many blocks */
+static const int PRUNE_STATE_INTERVAL = 1000;
+
+/** State root and UTXO root of one block */
+typedef std::pair<dev::h256, dev::h256> StateRoots;
+
+/**
+ * Mark and sweep pruning of the EVM state (stateKPG) and UTXO (kpgDB) tries.
+ *
+ * dev::OverlayDB drops the reference count decrements of nodes that were already
+ * written, so trie nodes superseded by later blocks stay in the databases forever.
+ * Nodes are content addressed and shared between roots, so instead of tracking
+ * references the pruner walks every trie reachable from the roots that must be kept
+ * (including the storage tries and bytecode of the accounts they contain) and deletes
+ * every other node. Keys that are not 32 byte hashes (overlay aux data) are left alone.
+ *
+ * The roots to keep are taken under cs_main, with the global overlays committed. The
+ * mark and the sweep then run on the "statepruner" thread while blocks keep being
+ * connected: the databases log the keys written from the moment the roots were taken,
+ * and the sweep leaves those alone, as a new block may write a node again that was
+ * unreachable until then. Readers of the state of a block that may fall out of the
+ * kept window while they run pin its roots, see StateRootsPin.
+ */
+class StatePruner
+{
+public:
+    StatePruner(dev::db::DatabaseFace* _stateDB, dev::db::DatabaseFace* _utxoDB, unsigned int _nKeepBlocks);
+    ~StatePruner();
+
+    /** Number of blocks below the tip whose state is kept */
+    unsigned int KeepBlocks() const { return nKeepBlocks; }
+
+    /** Delete all nodes not reachable from the given roots; returns the number of deleted nodes */
+    size_t Prune(const std::vector<StateRoots>& roots);
+
+    /**
+     * Prune the nodes not reachable from the given roots on the pruner thread, which
+     * must be called with the roots taken as described above. The databases in memory
+     * (-memorystate) do not log their writes, so they are pruned before returning.
+     * Returns false without doing anything if the previous run has not completed.
+     */
+    bool PruneInBackground(std::vector<StateRoots> roots);
+
+    /** Wait for the run in progress, if any */
+    void Wait();
+
+    /** Keep the nodes of roots until Unpin; returns the id to pass to Unpin */
+    uint64_t Pin(const StateRoots& roots);
+    void Unpin(uint64_t id);
+    /** Roots pinned by readers, which the next run keeps as well */
+    std::vector<StateRoots> PinnedRoots() const;
+
+private:
+    void ThreadPrune();
+
+    dev::db::DatabaseFace* stateDB;
+    dev::db::DatabaseFace* utxoDB;
+    //! The same databases if they log their writes, so they can be pruned in the background
+    StateNodeCacheDB* stateCacheDB;
+    StateNodeCacheDB* utxoCacheDB;
+    const unsigned int nKeepBlocks;
+
+    mutable Mutex m_mutex;
+    std::condition_variable m_cond;
+    //! The roots of the run the thread has to do, or is doing while m_running
+    std::vector<StateRoots> m_roots GUARDED_BY(m_mutex);
+    bool m_pending GUARDED_BY(m_mutex);
+    bool m_running GUARDED_BY(m_mutex);
+    std::map<uint64_t, StateRoots> m_pins GUARDED_BY(m_mutex);
+    uint64_t m_next_pin GUARDED_BY(m_mutex);
+    //! Set on shutdown, the run in progress stops sweeping
+    std::atomic<bool> m_stop;
+
+    std::thread m_thread;
+};
+
+/** Pruner of the global state, if -prunestate is set */
+extern std::unique_ptr<StatePruner> pstatepruner;
+
+/**
+ * Keeps the state of a block from being pruned while it is read outside of cs_main.
+ * Construct it under cs_main, after checking that the state of the block is still
+ * available (IsContractStateAvailable): the run in progress keeps what was available
+ * when it started, and the next runs keep the pinned roots.
+ */
+class StateRootsPin
+{
+public:
+    explicit StateRootsPin(const StateRoots& roots);
+    ~StateRootsPin();
+
+    StateRootsPin(const StateRootsPin&) = delete;
+    StateRootsPin& operator=(const StateRootsPin&) = delete;
+
+private:
+    StatePruner* pruner;
+    uint64_t id;
+};
+
+#endif
@@ -0,0 +1,233 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <qtum/qtumstatesnapshot.h>
+#include <qtum/qtumstate.h>
+#include <qtum/qtumstateprune.h>
+#include <qtum/qtumstatewalk.h>
+#include <chain.h>
+#include <crypto/keccak.h>
+#include <streams.h>
+#include <tinyformat.h>
+#include <util/convert.h>
+#include <util/system.h>
+#include <validation.h>
+
+#include <set>
+#include <stdexcept>
+
+namespace {
+
+/** Record types of a snapshot file */
+enum SnapshotRecord : uint8_t
+{
+    SNAPSHOT_END = 0,
+    SNAPSHOT_STATE_ENTRY = 1,
+    SNAPSHOT_UTXO_ENTRY = 2,
+    SNAPSHOT_STATE_AUX = 3,
+    SNAPSHOT_UTXO_AUX = 4,
+};
+
+/** Number of entries per database write batch on import */
+static const size_t SNAPSHOT_BATCH_SIZE = 10000;
+/** Number of trie leaves listed at a time when writing the key preimages */
+static const size_t SNAPSHOT_LEAF_PAGE = 10000;
+
+/** Key of the aux entry of a hash in the database behind a dev::OverlayDB */
+std::string AuxKey(const unsigned char* hash)
+{
+    std::string key(reinterpret_cast<const char*>(hash), dev::h256::size);
+    key.push_back((char)255);
+    return key;
+}
+
+/** Call f with the key and the value of every leaf of the trie under root; false if a node is missing */
+bool ForEachTrieLeaf(const dev::db::DatabaseFace& db, const dev::h256& root, const std::function<void(const dev::h256&, const std::string&)>& f)
+{
+    StateNodeLookup lookup = [&db](const dev::h256& hash) {
+        return db.lookup(dev::db::Slice(reinterpret_cast<const char*>(hash.data()), hash.size));
+    };
+    dev::h256 start;
+    while (true) {
+        std::vector<std::pair<dev::h256, std::string>> entries;
+        boost::optional<dev::h256> next;
+        if (!ListStateTrie(lookup, root, start, SNAPSHOT_LEAF_PAGE, entries, next))
+            return false;
+        for (const auto& entry : entries)
+            f(entry.first, entry.second);
+        if (!next)
+            return true;
+        start = *next;
+    }
+}
+
+dev::db::DatabaseFace& DiskDB(dev::db::DatabaseFace* db)
+{
+    if (!db)
+        throw std::runtime_error("The contract state database is not available");
+    return *db;
+}
+
+/** Batched insertion of snapshot entries under the hash of their value, or of their aux entries */
+class SnapshotImporter
+{
+public:
+    SnapshotImporter(dev::db::DatabaseFace& _db, bool _fAux) : db(_db), fAux(_fAux) {}
+
+    void Insert(std::string&& value)
+    {
+        values.push_back(std::move(value));
+        if (values.size() >= SNAPSHOT_BATCH_SIZE)
+            Flush();
+    }
+
+    void Flush()
+    {
+        // The keys of a batch are hashed together, four at a time with AVX2
+        std::vector<std::pair<const unsigned char*, size_t>> inputs;
+        inputs.reserve(values.size());
+        for (const std::string& value : values)
+            inputs.emplace_back(reinterpret_cast<const unsigned char*>(value.data()), value.size());
+        std::vector<unsigned char> keys(values.size() * 32);
+        Keccak256Batch(inputs, keys.data());
+
+        std::unique_ptr<dev::db::WriteBatchFace> batch = db.createWriteBatch();
+        for (size_t i = 0; i < values.size(); i++) {
+            std::string key = fAux ? AuxKey(keys.data() + 32 * i) : std::string(reinterpret_cast<const char*>(keys.data() + 32 * i), 32);
+            batch->insert(dev::db::Slice(key.data(), key.size()), dev::db::Slice(values[i].data(), values[i].size()));
+        }
+        db.commit(std::move(batch));
+        values.clear();
+    }
+
+private:
+    dev::db::DatabaseFace& db;
+    const bool fAux;
+    std::vector<std::string> values;
+};
+
+}
+
+StateSnapshotStats WriteStateSnapshot(CAutoFile& file, const QtumState& state, const CBlockIndex* pindex)
+{
+    dev::db::DatabaseFace& stateDB = DiskDB(state.diskDb());
+    dev::db::DatabaseFace& utxoDB = DiskDB(state.diskDbUtxo());
+
+    StateSnapshotHeader header;
+    header.hashBlock = pindex->GetBlockHash();
+    header.nHeight = pindex->nHeight;
+    header.hashStateRoot = pindex->hashStateRoot;
+    header.hashUTXORoot = pindex->hashUTXORoot;
+    file << header;
+
+    // Trie nodes are immutable, so the walk needs no lock; the caller keeps -prunestate
+    // from deleting them, anything missing is reported.
+    StateSnapshotStats stats;
+    StateNodeSet visitedState;
+    StateTrieWalker stateWalker(stateDB, visitedState, [&](const dev::h256&, const std::string& value) {
+        file << (uint8_t)SNAPSHOT_STATE_ENTRY << value;
+        ++stats.nStateEntries;
+    });
+    stateWalker.WalkState(uintToh256(header.hashStateRoot));
+
+    StateNodeSet visitedUTXO;
+    StateTrieWalker utxoWalker(utxoDB, visitedUTXO, [&](const dev::h256&, const std::string& value) {
+        file << (uint8_t)SNAPSHOT_UTXO_ENTRY << value;
+        ++stats.nUTXOEntries;
+    });
+    utxoWalker.Walk(uintToh256(header.hashUTXORoot));
+
+    // The preimages of the addresses and storage slots, without which the accounts and
+    // the storage of the contracts cannot be listed
+    auto writeAux = [&](const dev::db::DatabaseFace& db, uint8_t type, const dev::h256& key) {
+        std::string auxKey = AuxKey(key.data());
+        std::string preimage = db.lookup(dev::db::Slice(auxKey.data(), auxKey.size()));
+        if (preimage.empty())
+            return;
+        file << type << preimage;
+        ++stats.nAuxEntries;
+    };
+    std::set<dev::h256> storageRoots;
+    bool fComplete = ForEachTrieLeaf(stateDB, uintToh256(header.hashStateRoot), [&](const dev::h256& key, const std::string& value) {
+        writeAux(stateDB, SNAPSHOT_STATE_AUX, key);
+        dev::RLP account(value);
+        if (account.itemCount() >= 4)
+            storageRoots.insert(account[2].toHash<dev::h256>());
+    });
+    for (const dev::h256& storageRoot : storageRoots) {
+        fComplete &= ForEachTrieLeaf(stateDB, storageRoot, [&](const dev::h256& key, const std::string&) {
+            writeAux(stateDB, SNAPSHOT_STATE_AUX, key);
+        });
+    }
+    fComplete &= ForEachTrieLeaf(utxoDB, uintToh256(header.hashUTXORoot), [&](const dev::h256& key, const std::string&) {
+        writeAux(utxoDB, SNAPSHOT_UTXO_AUX, key);
+    });
+    file << (uint8_t)SNAPSHOT_END;
+
+    if (stateWalker.Missing() || utxoWalker.Missing() || !fComplete)
+        throw std::runtime_error(strprintf("%u contract state entries of block %s are missing (pruned?)", stateWalker.Missing() + utxoWalker.Missing(), header.hashBlock.ToString()));
+    return stats;
+}
+
+StateSnapshotStats ReadStateSnapshot(CAutoFile& file, const QtumState& state, StateSnapshotHeader& header)
+{
+    dev::db::DatabaseFace& stateDB = DiskDB(state.diskDb());
+    dev::db::DatabaseFace& utxoDB = DiskDB(state.diskDbUtxo());
+
+    file >> header;
+    if (header.nVersion < 1 || header.nVersion > STATE_SNAPSHOT_VERSION)
+        throw std::runtime_error(strprintf("Unsupported snapshot version %u", header.nVersion));
+
+    // The roots are trusted only if the header chain commits to them
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pindex = LookupBlockIndex(header.hashBlock);
+        if (!pindex)
+            throw std::runtime_error(strprintf("Block %s of the snapshot is not in the block index", header.hashBlock.ToString()));
+        if (pindex->nHeight != header.nHeight || pindex->hashStateRoot != header.hashStateRoot || pindex->hashUTXORoot != header.hashUTXORoot)
+            throw std::runtime_error(strprintf("Snapshot roots do not match block %s", header.hashBlock.ToString()));
+    }
+    // A -prunestate run started from here on keeps the imported entries for the check
+    StateRootsPin pin(StateRoots(uintToh256(header.hashStateRoot), uintToh256(header.hashUTXORoot)));
+
+    StateSnapshotStats stats;
+    SnapshotImporter stateImporter(stateDB, false);
+    SnapshotImporter utxoImporter(utxoDB, false);
+    SnapshotImporter stateAuxImporter(stateDB, true);
+    SnapshotImporter utxoAuxImporter(utxoDB, true);
+    while (true) {
+        uint8_t type;
+        file >> type;
+        if (type == SNAPSHOT_END)
+            break;
+        std::string value;
+        file >> value;
+        if (type == SNAPSHOT_STATE_ENTRY) {
+            stateImporter.Insert(std::move(value));
+            ++stats.nStateEntries;
+        } else if (type == SNAPSHOT_UTXO_ENTRY) {
+            utxoImporter.Insert(std::move(value));
+            ++stats.nUTXOEntries;
+        } else if (type == SNAPSHOT_STATE_AUX) {
+            stateAuxImporter.Insert(std::move(value));
+            ++stats.nAuxEntries;
+        } else if (type == SNAPSHOT_UTXO_AUX) {
+            utxoAuxImporter.Insert(std::move(value));
+            ++stats.nAuxEntries;
+        } else {
+            throw std::runtime_error(strprintf("Unknown snapshot record type %u", type));
+        }
+    }
+    stateImporter.Flush();
+    utxoImporter.Flush();
+    stateAuxImporter.Flush();
+    utxoAuxImporter.Flush();
+
+    // Entries are keyed by their own hash, so the data is authentic; check that it is complete
+    StateTrieCheck check = CheckStateTrie(stateDB, uintToh256(header.hashStateRoot), true, GetNumCores());
+    check += CheckStateTrie(utxoDB, uintToh256(header.hashUTXORoot), false, GetNumCores());
+    if (!check.IsValid())
+        throw std::runtime_error(strprintf("Snapshot is incomplete, %u contract state entries are missing and %u corrupted", check.nMissing, check.nCorrupted));
+    return stats;
+}
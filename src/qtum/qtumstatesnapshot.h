@@ -0,0 +1,81 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef QTUMSTATESNAPSHOT_H
+#define QTUMSTATESNAPSHOT_H
+
+#include <serialize.h>
+#include <uint256.h>
+
+#include <stdint.h>
+
+class CAutoFile;
+class CBlockIndex;
+class QtumState;
+
+/** Version of the contract state snapshot format; version 1 snapshots have no key preimages */
+static const uint32_t STATE_SNAPSHOT_VERSION = 2;
+
+/**
+ * Block whose contract state a snapshot holds.
+ *
+ * A snapshot file is this header followed by records of a type byte and a database
+ * entry: the trie nodes, storage trie nodes and bytecode reachable from the state
+ * root, then the nodes of the UTXO trie, then the preimages of the keys of both tries
+ * (the addresses and the storage slots), then an end record. dev::eth::State keeps the
+ * preimages as aux entries under the hash of the key, to list the accounts and the
+ * storage of a contract. Entries and preimages are stored without their keys, which
+ * are the hashes of their values, so a snapshot cannot hold anything but the content
+ * that the roots commit to.
+ *
+ * Only the contract state is covered, not the coins: a snapshot restores the contract
+ * state of a block the node has the chain of, it does not bootstrap a node.
+ */
+struct StateSnapshotHeader
+{
+    uint32_t nVersion;
+    uint256 hashBlock;
+    int nHeight;
+    uint256 hashStateRoot;
+    uint256 hashUTXORoot;
+
+    StateSnapshotHeader() : nVersion(STATE_SNAPSHOT_VERSION), nHeight(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nVersion);
+        READWRITE(hashBlock);
+        READWRITE(nHeight);
+        READWRITE(hashStateRoot);
+        READWRITE(hashUTXORoot);
+    }
+};
+
+/** Number of entries written or read for each database */
+struct StateSnapshotStats
+{
+    uint64_t nStateEntries = 0;
+    uint64_t nUTXOEntries = 0;
+    //! Key preimages of both databases
+    uint64_t nAuxEntries = 0;
+};
+
+/**
+ * Write the contract state of pindex, which must still be present in the databases
+ * of state, to file. With -prunestate the caller keeps the roots of pindex pinned
+ * (StateRootsPin) while this runs. Throws std::runtime_error on failure.
+ */
+StateSnapshotStats WriteStateSnapshot(CAutoFile& file, const QtumState& state, const CBlockIndex* pindex);
+
+/**
+ * Read a snapshot from file into the databases of state. The block of the snapshot
+ * must be in the block index with the same roots, and all entries reachable from
+ * them must be present afterwards. Entries are only ever added, so importing is
+ * safe while the node runs. Throws std::runtime_error on failure.
+ */
+StateSnapshotStats ReadStateSnapshot(CAutoFile& file, const QtumState& state, StateSnapshotHeader& header);
+
+#endif
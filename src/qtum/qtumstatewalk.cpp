@@ -0,0 +1,559 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <qtum/qtumstatewalk.h>
+#include <libdevcore/RLP.h>
+#include <libdevcore/SHA3.h>
+
+#include <algorithm>
+#include <unordered_map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+StateTrieWalker::StateTrieWalker(const dev::db::DatabaseFace& _db, StateNodeSet& _visited, NodeFunc _onNode) :
+    db(_db), visited(_visited), onNode(std::move(_onNode)), nMissing(0)
+{
+    visited.insert(dev::sha3(dev::rlp("")));
+    visited.insert(dev::EmptySHA3);
+}
+
+bool StateTrieWalker::Visit(const dev::h256& key, std::string& value)
+{
+    if (!visited.insert(key).second)
+        return false;
+    value = db.lookup(dev::db::Slice(reinterpret_cast<const char*>(key.data()), key.size));
+    if (value.empty()) {
+        ++nMissing;
+        return false;
+    }
+    if (onNode)
+        onNode(key, value);
+    return true;
+}
+
+void StateTrieWalker::Walk(const dev::h256& root, const LeafFunc& onLeaf)
+{
+    std::string node;
+    if (Visit(root, node))
+        WalkNode(dev::RLP(node), onLeaf);
+}
+
+void StateTrieWalker::WalkState(const dev::h256& root)
+{
+    Walk(root, [this](dev::bytesConstRef value) {
+        // Accounts are RLP lists of [nonce, balance, storageRoot, codeHash]
+        dev::RLP account(value);
+        if (account.itemCount() < 4)
+            return;
+        Walk(account[2].toHash<dev::h256>());
+        std::string code;
+        Visit(account[3].toHash<dev::h256>(), code);
+    });
+}
+
+void StateTrieWalker::WalkRef(const dev::RLP& ref, const LeafFunc& onLeaf)
+{
+    // A child is either empty, the hash of a node, or a node of less than 32 bytes inlined in its parent
+    if (ref.isList()) {
+        WalkNode(ref, onLeaf);
+    } else if (ref.isData() && ref.size() == dev::h256::size) {
+        std::string node;
+        if (Visit(ref.toHash<dev::h256>(), node))
+            WalkNode(dev::RLP(node), onLeaf);
+    }
+}
+
+void StateTrieWalker::WalkNode(const dev::RLP& node, const LeafFunc& onLeaf)
+{
+    if (node.itemCount() == 17) {
+        for (unsigned i = 0; i < 16; ++i)
+            WalkRef(node[i], onLeaf);
+        if (!node[16].isEmpty() && onLeaf)
+            onLeaf(node[16].payload());
+    } else if (node.itemCount() == 2) {
+        dev::bytesConstRef path = node[0].payload();
+        // Hex prefix encoding: the 0x20 flag marks a leaf, otherwise this is an extension
+        if (!path.empty() && (path[0] & 0x20)) {
+            if (onLeaf)
+                onLeaf(node[1].payload());
+        } else {
+            WalkRef(node[1], onLeaf);
+        }
+    }
+}
+
+/** Nibbles of a trie key, most significant first */
+static dev::bytes KeyNibbles(const dev::h256& key)
+{
+    dev::bytes path(dev::h256::size * 2);
+    for (size_t i = 0; i < dev::h256::size; ++i) {
+        path[2 * i] = key[i] >> 4;
+        path[2 * i + 1] = key[i] & 0x0f;
+    }
+    return path;
+}
+
+/** Nibble i of the hex prefix encoded path of a leaf or an extension, counting the flag nibbles */
+static dev::byte PrefixNibble(dev::bytesConstRef prefix, size_t i)
+{
+    return (i & 1) ? (prefix[i / 2] & 0x0f) : (prefix[i / 2] >> 4);
+}
+
+StateTrieLookup FollowStateTrie(const StateNodeLookup& lookup, const dev::h256& root, const dev::h256& key, std::string& value, std::vector<std::string>* proof)
+{
+    if (root == dev::EmptyTrie)
+        return StateTrieLookup::ABSENT;
+    const dev::bytes path = KeyNibbles(key);
+
+    std::string node = lookup(root);
+    if (node.empty())
+        return StateTrieLookup::MISSING;
+    if (proof)
+        proof->push_back(node);
+    size_t pos = 0;
+    while (true) {
+        dev::RLP rlp(node);
+        dev::RLP next;
+        if (rlp.itemCount() == 17) {
+            if (pos == path.size()) {
+                if (rlp[16].isEmpty())
+                    return StateTrieLookup::ABSENT;
+                value = rlp[16].payload().toString();
+                return StateTrieLookup::FOUND;
+            }
+            next = rlp[path[pos++]];
+        } else if (rlp.itemCount() == 2) {
+            // Hex prefix encoding: 0x20 marks a leaf, 0x10 an odd number of nibbles
+            dev::bytesConstRef prefix = rlp[0].payload();
+            if (prefix.empty())
+                return StateTrieLookup::ABSENT;
+            bool fLeaf = prefix[0] & 0x20;
+            for (size_t i = (prefix[0] & 0x10) ? 1 : 2; i < prefix.size() * 2; ++i, ++pos) {
+                if (pos == path.size() || path[pos] != PrefixNibble(prefix, i))
+                    return StateTrieLookup::ABSENT;
+            }
+            if (fLeaf) {
+                if (pos != path.size())
+                    return StateTrieLookup::ABSENT;
+                value = rlp[1].payload().toString();
+                return StateTrieLookup::FOUND;
+            }
+            next = rlp[1];
+        } else {
+            return StateTrieLookup::ABSENT;
+        }
+
+        // The child is either the hash of a node or a node of less than 32 bytes inlined in its parent
+        if (next.isList()) {
+            node = next.data().toString();
+        } else if (next.isData() && next.size() == dev::h256::size) {
+            node = lookup(next.toHash<dev::h256>());
+            if (node.empty())
+                return StateTrieLookup::MISSING;
+            if (proof)
+                proof->push_back(node);
+        } else {
+            return StateTrieLookup::ABSENT;
+        }
+    }
+}
+
+bool LookupStateTrie(const dev::db::DatabaseFace& db, const dev::h256& root, const dev::h256& key, std::string& value)
+{
+    StateNodeLookup lookup = [&db](const dev::h256& hash) {
+        return db.lookup(dev::db::Slice(reinterpret_cast<const char*>(hash.data()), hash.size));
+    };
+    return FollowStateTrie(lookup, root, key, value) == StateTrieLookup::FOUND;
+}
+
+StateTrieLookup VerifyStateTrieProof(const dev::h256& root, const dev::h256& key, const std::vector<std::string>& proof, std::string& value)
+{
+    std::unordered_map<dev::h256, const std::string*> nodes;
+    for (const std::string& node : proof)
+        nodes.emplace(dev::sha3(node), &node);
+    StateNodeLookup lookup = [&nodes](const dev::h256& hash) {
+        auto it = nodes.find(hash);
+        return it == nodes.end() ? std::string() : *it->second;
+    };
+    return FollowStateTrie(lookup, root, key, value);
+}
+
+namespace {
+
+/** Collects the leaves of a trie in key order, see ListStateTrie */
+class StateTrieLister
+{
+public:
+    StateTrieLister(const StateNodeLookup& _lookup, const dev::h256& start, size_t _nLimit, std::vector<std::pair<dev::h256, std::string>>& _entries) :
+        lookup(_lookup), startPath(KeyNibbles(start)), nLimit(_nLimit), entries(_entries) {}
+
+    bool Done() const { return entries.size() >= nLimit; }
+
+    /** Walk a child reference. fBounded is set while path is a prefix of the start key */
+    bool Ref(const dev::RLP& ref, bool fBounded)
+    {
+        if (ref.isList())
+            return Node(ref, fBounded);
+        if (ref.isData() && ref.size() == dev::h256::size)
+            return Stored(ref.toHash<dev::h256>(), fBounded);
+        return true;
+    }
+
+    bool Stored(const dev::h256& hash, bool fBounded)
+    {
+        std::string node = lookup(hash);
+        if (node.empty())
+            return false;
+        return Node(dev::RLP(node), fBounded);
+    }
+
+private:
+    bool Node(const dev::RLP& node, bool fBounded)
+    {
+        if (node.itemCount() == 17) {
+            for (dev::byte n = fBounded ? startPath[path.size()] : 0; n < 16 && !Done(); ++n) {
+                path.push_back(n);
+                bool fOk = Ref(node[n], fBounded && n == startPath[path.size() - 1]);
+                path.pop_back();
+                if (!fOk)
+                    return false;
+            }
+            // The keys all have the same length, so no key ends at a branch
+            return true;
+        }
+        if (node.itemCount() != 2)
+            return true;
+        dev::bytesConstRef prefix = node[0].payload();
+        if (prefix.empty())
+            return true;
+        const size_t nDepth = path.size();
+        bool fOk = true;
+        bool fSkip = false;
+        for (size_t i = (prefix[0] & 0x10) ? 1 : 2; i < prefix.size() * 2 && path.size() < startPath.size(); ++i) {
+            dev::byte nibble = PrefixNibble(prefix, i);
+            if (fBounded && nibble != startPath[path.size()]) {
+                // Before the start key the whole subtrie is skipped, after it all of it is taken
+                fSkip = nibble < startPath[path.size()];
+                fBounded = false;
+            }
+            path.push_back(nibble);
+        }
+        if (!fSkip) {
+            if (prefix[0] & 0x20) {
+                if (path.size() == startPath.size())
+                    entries.emplace_back(KeyFromPath(), node[1].payload().toString());
+            } else {
+                fOk = Ref(node[1], fBounded);
+            }
+        }
+        path.resize(nDepth);
+        return fOk;
+    }
+
+    dev::h256 KeyFromPath() const
+    {
+        dev::h256 key;
+        for (size_t i = 0; i < dev::h256::size; ++i)
+            key[i] = (path[2 * i] << 4) | path[2 * i + 1];
+        return key;
+    }
+
+    const StateNodeLookup& lookup;
+    const dev::bytes startPath;
+    const size_t nLimit;
+    std::vector<std::pair<dev::h256, std::string>>& entries;
+    dev::bytes path;
+};
+
+} // namespace
+
+bool ListStateTrie(const StateNodeLookup& lookup, const dev::h256& root, const dev::h256& start, size_t nMaxEntries,
+    std::vector<std::pair<dev::h256, std::string>>& entries, boost::optional<dev::h256>& next)
+{
+    entries.clear();
+    next = boost::none;
+    if (root == dev::EmptyTrie)
+        return true;
+    // One more leaf is collected to tell where the next page starts
+    StateTrieLister lister(lookup, start, nMaxEntries + 1, entries);
+    if (!lister.Stored(root, true))
+        return false;
+    if (entries.size() > nMaxEntries) {
+        next = entries.back().first;
+        entries.pop_back();
+    }
+    return true;
+}
+
+StateTrieDiff& StateTrieDiff::operator+=(const StateTrieDiff& other)
+{
+    nLeaves += other.nLeaves;
+    nNodes += other.nNodes;
+    return *this;
+}
+
+namespace {
+
+/**
+ * A position in a trie: a node, and for a leaf or an extension the number of nibbles of
+ * its path already followed. Inlined nodes point into the encoding of their parent, which
+ * is kept alive with the stored node they came from.
+ */
+struct TrieCursor
+{
+    std::shared_ptr<const std::string> stored;
+    dev::RLP node;
+    size_t nSkip = 0;
+
+    bool IsEmpty() const { return !stored; }
+};
+
+/** Walks two tries together, see DiffStateTrie */
+class StateTrieDiffer
+{
+public:
+    StateTrieDiffer(const StateNodeLookup& _lookup, StateTrieDiff& _diff, const StateTrieChangeFunc& _onChange) :
+        lookup(_lookup), diff(_diff), onChange(_onChange) {}
+
+    bool Open(const dev::h256& root, TrieCursor& cursor, int sign)
+    {
+        if (root == dev::EmptyTrie)
+            return true;
+        return OpenStored(root, cursor, sign) && Normalize(cursor, sign);
+    }
+
+    bool Diff(const TrieCursor& oldCursor, const TrieCursor& newCursor)
+    {
+        if (oldCursor.IsEmpty() && newCursor.IsEmpty())
+            return true;
+        // A subtrie both tries share, or the same rest of a path
+        if (!oldCursor.IsEmpty() && !newCursor.IsEmpty() && oldCursor.nSkip == newCursor.nSkip &&
+            SameNode(oldCursor.node, newCursor.node))
+            return true;
+
+        diff.nLeaves += (int)HasValue(newCursor) - (int)HasValue(oldCursor);
+        if (onChange && path.size() == 2 * dev::h256::size) {
+            dev::bytesConstRef oldValue = Value(oldCursor), newValue = Value(newCursor);
+            if (oldValue.size() != newValue.size() || !std::equal(oldValue.begin(), oldValue.end(), newValue.begin()))
+                onChange(KeyFromPath(), oldValue, newValue);
+        }
+        for (unsigned n = 0; n < 16; ++n) {
+            TrieCursor oldChild, newChild;
+            path.push_back(n);
+            bool fOk = Child(oldCursor, n, oldChild, -1) && Child(newCursor, n, newChild, 1) && Diff(oldChild, newChild);
+            path.pop_back();
+            if (!fOk)
+                return false;
+        }
+        return true;
+    }
+
+private:
+    /** Nibbles of the hex prefix encoded path of a leaf or an extension */
+    static size_t PathSize(const dev::RLP& node)
+    {
+        dev::bytesConstRef prefix = node[0].payload();
+        if (prefix.empty())
+            return 0;
+        return prefix.size() * 2 - ((prefix[0] & 0x10) ? 1 : 2);
+    }
+
+    static dev::byte PathNibble(const dev::RLP& node, size_t pos)
+    {
+        dev::bytesConstRef prefix = node[0].payload();
+        size_t i = pos + ((prefix[0] & 0x10) ? 1 : 2);
+        return (i & 1) ? (prefix[i / 2] & 0x0f) : (prefix[i / 2] >> 4);
+    }
+
+    static bool IsLeaf(const dev::RLP& node)
+    {
+        dev::bytesConstRef prefix = node[0].payload();
+        return !prefix.empty() && (prefix[0] & 0x20);
+    }
+
+    static bool SameNode(const dev::RLP& a, const dev::RLP& b)
+    {
+        dev::bytesConstRef da = a.data(), db = b.data();
+        return da.size() == db.size() && std::equal(da.begin(), da.end(), db.begin());
+    }
+
+    static bool HasValue(const TrieCursor& cursor)
+    {
+        if (cursor.IsEmpty())
+            return false;
+        if (cursor.node.itemCount() == 17)
+            return !cursor.node[16].isEmpty();
+        return IsLeaf(cursor.node) && cursor.nSkip == PathSize(cursor.node);
+    }
+
+    /** The value of the key that ends at cursor, empty if there is none */
+    static dev::bytesConstRef Value(const TrieCursor& cursor)
+    {
+        if (!HasValue(cursor))
+            return dev::bytesConstRef();
+        return cursor.node[cursor.node.itemCount() == 17 ? 16 : 1].payload();
+    }
+
+    dev::h256 KeyFromPath() const
+    {
+        dev::h256 key;
+        for (size_t i = 0; i < dev::h256::size; ++i)
+            key[i] = (path[2 * i] << 4) | path[2 * i + 1];
+        return key;
+    }
+
+    bool OpenStored(const dev::h256& key, TrieCursor& cursor, int sign)
+    {
+        std::shared_ptr<std::string> value = std::make_shared<std::string>(lookup(key));
+        if (value->empty())
+            return false;
+        diff.nNodes += sign;
+        cursor.stored = value;
+        cursor.node = dev::RLP(*value);
+        cursor.nSkip = 0;
+        return true;
+    }
+
+    /** Open a child reference of the node of parent */
+    bool OpenRef(const TrieCursor& parent, const dev::RLP& ref, TrieCursor& cursor, int sign)
+    {
+        if (ref.isList()) {
+            cursor.stored = parent.stored;
+            cursor.node = ref;
+            cursor.nSkip = 0;
+        } else if (ref.isData() && ref.size() == dev::h256::size) {
+            if (!OpenStored(ref.toHash<dev::h256>(), cursor, sign))
+                return false;
+        } else {
+            return true;
+        }
+        return Normalize(cursor, sign);
+    }
+
+    /** Move past the end of the path of an extension to its child */
+    bool Normalize(TrieCursor& cursor, int sign)
+    {
+        if (cursor.node.itemCount() == 2 && !IsLeaf(cursor.node) && cursor.nSkip == PathSize(cursor.node)) {
+            TrieCursor child;
+            if (!OpenRef(cursor, cursor.node[1], child, sign))
+                return false;
+            cursor = child;
+        }
+        return true;
+    }
+
+    bool Child(const TrieCursor& cursor, unsigned n, TrieCursor& child, int sign)
+    {
+        if (cursor.IsEmpty())
+            return true;
+        if (cursor.node.itemCount() == 17)
+            return OpenRef(cursor, cursor.node[n], child, sign);
+        if (cursor.node.itemCount() == 2 && cursor.nSkip < PathSize(cursor.node) && PathNibble(cursor.node, cursor.nSkip) == n) {
+            child = cursor;
+            child.nSkip++;
+            return Normalize(child, sign);
+        }
+        return true;
+    }
+
+    const StateNodeLookup& lookup;
+    StateTrieDiff& diff;
+    const StateTrieChangeFunc& onChange;
+    //! Nibbles of the key path of the position being compared
+    dev::bytes path;
+};
+
+}
+
+bool DiffStateTrie(const StateNodeLookup& lookup, const dev::h256& oldRoot, const dev::h256& newRoot, StateTrieDiff& diff, const StateTrieChangeFunc& onChange)
+{
+    diff = StateTrieDiff();
+    if (oldRoot == newRoot)
+        return true;
+    StateTrieDiffer differ(lookup, diff, onChange);
+    TrieCursor oldCursor, newCursor;
+    try {
+        return differ.Open(oldRoot, oldCursor, -1) && differ.Open(newRoot, newCursor, 1) && differ.Diff(oldCursor, newCursor);
+    } catch (const std::exception&) {
+        // A node that does not decode
+        return false;
+    }
+}
+
+StateTrieCheck& StateTrieCheck::operator+=(const StateTrieCheck& other)
+{
+    nEntries += other.nEntries;
+    nMissing += other.nMissing;
+    nCorrupted += other.nCorrupted;
+    return *this;
+}
+
+namespace {
+
+/** Check the subtries under the given keys with one walker, so that shared subtries are checked once */
+StateTrieCheck CheckSubtries(const dev::db::DatabaseFace& db, const std::vector<dev::h256>& roots, bool fAccounts)
+{
+    StateTrieCheck check;
+    StateNodeSet visited;
+    StateTrieWalker walker(db, visited, [&](const dev::h256& key, const std::string& value) {
+        ++check.nEntries;
+        if (dev::sha3(value) != key)
+            ++check.nCorrupted;
+    });
+    try {
+        for (const dev::h256& root : roots) {
+            if (fAccounts)
+                walker.WalkState(root);
+            else
+                walker.Walk(root);
+        }
+    } catch (const std::exception&) {
+        // A node that does not even decode
+        ++check.nCorrupted;
+    }
+    check.nMissing = walker.Missing();
+    return check;
+}
+
+}
+
+StateTrieCheck CheckStateTrie(const dev::db::DatabaseFace& db, const dev::h256& root, bool fAccounts, int nThreads)
+{
+    // Split the trie if the root is a branch whose children are all stored by hash
+    std::vector<dev::h256> subtries;
+    std::string node = db.lookup(dev::db::Slice(reinterpret_cast<const char*>(root.data()), root.size));
+    bool fSplit = nThreads > 1 && !node.empty() && dev::sha3(node) == root;
+    if (fSplit) {
+        dev::RLP branch(node);
+        fSplit = branch.isList() && branch.itemCount() == 17 && branch[16].isEmpty();
+        for (unsigned i = 0; fSplit && i < 16; ++i) {
+            if (branch[i].isData() && branch[i].size() == dev::h256::size)
+                subtries.push_back(branch[i].toHash<dev::h256>());
+            else if (!branch[i].isEmpty())
+                fSplit = false;
+        }
+    }
+    if (!fSplit)
+        return CheckSubtries(db, {root}, fAccounts);
+
+    nThreads = std::min<int>(nThreads, subtries.size());
+    std::vector<StateTrieCheck> checks(nThreads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nThreads; ++t) {
+        threads.emplace_back([&, t]() {
+            std::vector<dev::h256> part;
+            for (size_t i = t; i < subtries.size(); i += nThreads)
+                part.push_back(subtries[i]);
+            checks[t] = CheckSubtries(db, part, fAccounts);
+        });
+    }
+    StateTrieCheck check;
+    check.nEntries = 1; // the root
+    for (int t = 0; t < nThreads; ++t) {
+        threads[t].join();
+        check += checks[t];
+    }
+    return check;
+}
@@ -0,0 +1,144 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef QTUMSTATEWALK_H
+#define QTUMSTATEWALK_H
+
+#include <libdevcore/db.h>
+#include <libdevcore/FixedHash.h>
+#include <libdevcore/RLP.h>
+
+#include <boost/optional.hpp>
+
+#include <functional>
+#include <stdint.h>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+/** Set of state database keys */
+typedef std::unordered_set<dev::h256> StateNodeSet;
+
+/**
+ * Depth first walk over the entries of a state database reachable from trie roots.
+ *
+ * Trie nodes are content addressed and shared between roots and between the storage
+ * tries of different accounts, so every key is visited only once per visited set, and
+ * walking many roots costs about as much as walking their union. The empty trie and
+ * the hash of empty code are treated as visited from the start: they are referenced by
+ * every account without storage or code, and the empty trie is created by every state.
+ */
+class StateTrieWalker
+{
+public:
+    /** Called with the key and the encoding of every database entry reached */
+    typedef std::function<void(const dev::h256&, const std::string&)> NodeFunc;
+    /** Called with the value of every trie leaf reached */
+    typedef std::function<void(dev::bytesConstRef)> LeafFunc;
+
+    StateTrieWalker(const dev::db::DatabaseFace& _db, StateNodeSet& _visited, NodeFunc _onNode = NodeFunc());
+
+    /** Walk the trie under root */
+    void Walk(const dev::h256& root, const LeafFunc& onLeaf = LeafFunc());
+
+    /** Walk the EVM state trie under root, with the storage tries and bytecode of its accounts */
+    void WalkState(const dev::h256& root);
+
+    /** Number of referenced entries that were not found in the database */
+    size_t Missing() const { return nMissing; }
+
+private:
+    bool Visit(const dev::h256& key, std::string& value);
+    void WalkRef(const dev::RLP& ref, const LeafFunc& onLeaf);
+    void WalkNode(const dev::RLP& node, const LeafFunc& onLeaf);
+
+    const dev::db::DatabaseFace& db;
+    StateNodeSet& visited;
+    const NodeFunc onNode;
+    size_t nMissing;
+};
+
+/**
+ * Look up key in the trie under root by reading the nodes on its path, and set value to
+ * its leaf. Returns false if the key is not in the trie or a node on the path is missing.
+ */
+bool LookupStateTrie(const dev::db::DatabaseFace& db, const dev::h256& root, const dev::h256& key, std::string& value);
+
+/** Read the encoding of the node with a hash, empty if it is missing */
+typedef std::function<std::string(const dev::h256&)> StateNodeLookup;
+
+/** Outcome of following the path of a key in a trie */
+enum class StateTrieLookup
+{
+    FOUND,
+    ABSENT,
+    //! A node on the path is not available
+    MISSING,
+};
+
+/**
+ * Follow the path of key in the trie under root, as LookupStateTrie, and add the encoding
+ * of every node stored by hash on it to proof if it is set. The nodes from the root to
+ * the leaf of the key, or to the node its path leaves the trie from, are a Merkle proof of
+ * its value or of its absence.
+ */
+StateTrieLookup FollowStateTrie(const StateNodeLookup& lookup, const dev::h256& root, const dev::h256& key, std::string& value, std::vector<std::string>* proof = nullptr);
+
+/** Check a proof of FollowStateTrie against root, MISSING if it does not lead from root to the outcome */
+StateTrieLookup VerifyStateTrieProof(const dev::h256& root, const dev::h256& key, const std::vector<std::string>& proof, std::string& value);
+
+/**
+ * Set entries to the first nMaxEntries leaves of the trie under root, as (key, value), with
+ * a key not less than start in key order, and next to the key of the leaf after them if
+ * there is one. Only the nodes on the way are read. Returns false if a node is missing.
+ */
+bool ListStateTrie(const StateNodeLookup& lookup, const dev::h256& root, const dev::h256& start, size_t nMaxEntries,
+    std::vector<std::pair<dev::h256, std::string>>& entries, boost::optional<dev::h256>& next);
+
+/** Outcome of CheckStateTrie */
+struct StateTrieCheck
+{
+    uint64_t nEntries = 0;
+    uint64_t nMissing = 0;
+    uint64_t nCorrupted = 0;
+
+    bool IsValid() const { return nMissing == 0 && nCorrupted == 0; }
+    StateTrieCheck& operator+=(const StateTrieCheck& other);
+};
+
+/** Difference in size between two versions of a trie */
+struct StateTrieDiff
+{
+    //! Leaves, which are the storage slots of a storage trie
+    int64_t nLeaves = 0;
+    //! Nodes stored by hash, the entries of the database
+    int64_t nNodes = 0;
+
+    StateTrieDiff& operator+=(const StateTrieDiff& other);
+};
+
+/** Called with the key and the old and new value of a leaf that changed, empty if there was or is none */
+typedef std::function<void(const dev::h256&, dev::bytesConstRef, dev::bytesConstRef)> StateTrieChangeFunc;
+
+/**
+ * Compute how the trie under newRoot differs in size from the one under oldRoot. Both
+ * tries are walked together along the key paths, skipping the subtries they share, so the
+ * cost is in proportion to the nodes that changed rather than to the size of the tries.
+ * If onChange is set it is called for every key of 32 bytes, as the keys of the state
+ * tries are, that was added, removed or set to another value, in key order.
+ * Returns false if a node is missing.
+ */
+bool DiffStateTrie(const StateNodeLookup& lookup, const dev::h256& oldRoot, const dev::h256& newRoot, StateTrieDiff& diff,
+    const StateTrieChangeFunc& onChange = StateTrieChangeFunc());
+
+/**
+ * Check that every entry reachable from root is present and hashes to its key. As each
+ * node commits to the hashes of its children, this is the same as recomputing the root
+ * from the leaves. If fAccounts is set the trie is the EVM state trie, and the storage
+ * tries and bytecode of its accounts are checked as well. The subtries under the first
+ * nibble of the keys are split between nThreads threads.
+ */
+StateTrieCheck CheckStateTrie(const dev::db::DatabaseFace& db, const dev::h256& root, bool fAccounts, int nThreads);
+
+#endif
@@ -1,19 +1,79 @@
 #include <qtum/qtumutils.h>
 #include <libdevcore/CommonData.h>
+#include <crypto/sha256.h>
 #include <pubkey.h>
+#include <sync.h>
 #include <util/convert.h>
 
+#include <list>
+#include <map>
+
 using namespace dev;
 
-bool qtumutils::btc_ecrecover(const dev::h256 &hash, const dev::u256 &v, const dev::h256 &r, const dev::h256 &s, dev::h256 &key)
+namespace {
+/**
+ * Results of btc_ecrecover by SHA256(hash || v || r || s), most recently used first.
+ * Contracts checking the same signatures over and over, like multisig wallets and
+ * relayers, then recover each key once. The recovery is deterministic, so failures are
+ * kept as well.
+ */
+class EcrecoverCache
 {
-    // Check input parameters
-    if(v >= 256)
+public:
+    bool Get(const uint256& entry, bool& fRecovered, dev::h256& key)
     {
-        // Does not fit into 1 byte
-        return false;
+        LOCK(cs);
+        auto it = mapEntries.find(entry);
+        if (it == mapEntries.end())
+            return false;
+        listEntries.splice(listEntries.begin(), listEntries, it->second);
+        fRecovered = it->second->fRecovered;
+        key = it->second->key;
+        return true;
     }
 
+    void Set(const uint256& entry, bool fRecovered, const dev::h256& key)
+    {
+        LOCK(cs);
+        if (nMaxEntries == 0 || mapEntries.count(entry))
+            return;
+        listEntries.push_front(Entry{entry, fRecovered, key});
+        mapEntries.emplace(entry, listEntries.begin());
+        Trim();
+    }
+
+    void SetMaxEntries(size_t nMaxEntriesIn)
+    {
+        LOCK(cs);
+        nMaxEntries = nMaxEntriesIn;
+        Trim();
+    }
+
+private:
+    struct Entry {
+        uint256 entry;
+        bool fRecovered;
+        dev::h256 key;
+    };
+
+    void Trim() EXCLUSIVE_LOCKS_REQUIRED(cs)
+    {
+        while (listEntries.size() > nMaxEntries) {
+            mapEntries.erase(listEntries.back().entry);
+            listEntries.pop_back();
+        }
+    }
+
+    Mutex cs;
+    size_t nMaxEntries GUARDED_BY(cs) = qtumutils::DEFAULT_ECRECOVER_CACHE_SIZE;
+    std::list<Entry> listEntries GUARDED_BY(cs);
+    std::map<uint256, std::list<Entry>::iterator> mapEntries GUARDED_BY(cs);
+};
+
+EcrecoverCache ecrecoverCache;
+
+bool Ecrecover(const dev::h256 &hash, const dev::u256 &v, const dev::h256 &r, const dev::h256 &s, dev::h256 &key)
+{
     // Convert the data into format usable for btc
     CPubKey pubKey;
     std::vector<unsigned char> vchSig;
@@ -37,3 +97,42 @@ bool qtumutils::btc_ecrecover(const dev::h256 &hash, const dev::u256 &v, const d
 
     return false;
 }
+} // namespace
+
+bool qtumutils::btc_ecrecover(const dev::h256 &hash, const dev::u256 &v, const dev::h256 &r, const dev::h256 &s, dev::h256 &key)
+{
+    // Check input parameters
+    if(v >= 256)
+    {
+        // Does not fit into 1 byte
+        return false;
+    }
+
+    uint256 entry;
+    unsigned char chV = (unsigned char)v;
+    CSHA256().Write(hash.data(), hash.size).Write(&chV, 1).Write(r.data(), r.size).Write(s.data(), s.size).Finalize(entry.begin());
+    bool fRecovered;
+    if(ecrecoverCache.Get(entry, fRecovered, key))
+    {
+        return fRecovered;
+    }
+
+    fRecovered = Ecrecover(hash, v, r, s, key);
+    ecrecoverCache.Set(entry, fRecovered, fRecovered ? key : dev::h256());
+    return fRecovered;
+}
+
+void qtumutils::btc_ecrecover_batch(const std::vector<EcrecoverInput>& inputs, std::vector<EcrecoverResult>& results)
+{
+    results.resize(inputs.size());
+    for(size_t i = 0; i < inputs.size(); i++)
+    {
+        const EcrecoverInput& input = inputs[i];
+        results[i].fRecovered = btc_ecrecover(input.hash, input.v, input.r, input.s, results[i].key);
+    }
+}
+
+void qtumutils::SetEcrecoverCacheSize(size_t nEntries)
+{
+    ecrecoverCache.SetMaxEntries(nEntries);
+}
@@ -4,15 +4,44 @@
 #include <libdevcore/Common.h>
 #include <libdevcore/FixedHash.h>
 
+#include <vector>
+
 /**
  * qtumutils Provides utility functions to EVM for functionalities that already exist in qtum
  */
 namespace qtumutils
 {
+/** Default for -ecrecovercache, the number of btc_ecrecover results kept (0 = off) */
+static const size_t DEFAULT_ECRECOVER_CACHE_SIZE = 16384;
+
 /**
- * @brief btc_ecrecover Wrapper to CPubKey::RecoverCompact
+ * @brief btc_ecrecover Wrapper to CPubKey::RecoverCompact, through a cache of recent results
  */
 bool btc_ecrecover(dev::h256 const& hash, dev::u256 const& v, dev::h256 const& r, dev::h256 const& s, dev::h256 & key);
+
+struct EcrecoverInput
+{
+    dev::h256 hash;
+    dev::u256 v;
+    dev::h256 r;
+    dev::h256 s;
+};
+
+struct EcrecoverResult
+{
+    bool fRecovered = false;
+    dev::h256 key;
+};
+
+/**
+ * @brief btc_ecrecover_batch btc_ecrecover of each input, for callers recovering several signatures at once
+ */
+void btc_ecrecover_batch(const std::vector<EcrecoverInput>& inputs, std::vector<EcrecoverResult>& results);
+
+/**
+ * @brief SetEcrecoverCacheSize Set the number of btc_ecrecover results kept
+ */
+void SetEcrecoverCacheSize(size_t nEntries);
 }
 
 #endif
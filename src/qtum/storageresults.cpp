@@ -1,127 +1,486 @@
 #include <qtum/storageresults.h>
+#include <clientversion.h>
+#include <dbwrapper.h>
+#include <memusage.h>
+#include <streams.h>
 #include <util/convert.h>
 
+#include <memory>
+
+namespace {
+
+/** Key prefix of the compact results of format 1, followed by the raw 32 byte txid */
+const char DB_TX_RESULT = 'r';
+/** Key prefix of the compact results, followed by the raw 32 byte block hash and txid */
+const char DB_RESULT = 'b';
+/** Key prefix of the block of the active chain a transaction is in, followed by the raw 32 byte txid */
+const char DB_RESULT_BLOCK = 'h';
+/** Single byte value holding the on-disk format of the results */
+const std::string DB_FORMAT_VERSION = "V";
+
+/** Format 0 stores RLP struct-of-vectors under hex keys, format 1 the compact records by txid,
+ *  format 2 the compact records by block and txid */
+const uint8_t RESULTS_FORMAT_VERSION = 2;
+
+std::string resultKey(dev::h256 const& hashBlock, dev::h256 const& hashTx)
+{
+    std::string key(1, DB_RESULT);
+    key.append((const char*)hashBlock.data(), dev::h256::size);
+    key.append((const char*)hashTx.data(), dev::h256::size);
+    return key;
+}
+
+std::string resultBlockKey(dev::h256 const& hashTx)
+{
+    std::string key(1, DB_RESULT_BLOCK);
+    key.append((const char*)hashTx.data(), dev::h256::size);
+    return key;
+}
+
+template <typename Stream, unsigned N>
+void writeHash(Stream& s, dev::FixedHash<N> const& h)
+{
+    s.write((const char*)h.data(), N);
+}
+
+template <typename Stream, unsigned N>
+void readHash(Stream& s, dev::FixedHash<N>& h)
+{
+    s.read((char*)h.data(), N);
+}
+
+/** Deduplicates the addresses or topics of a record, which are then referenced by index */
+template <typename T>
+class CompactTable
+{
+public:
+    uint64_t index(T const& item)
+    {
+        auto it = lookup.emplace(item, items.size());
+        if (it.second)
+            items.push_back(item);
+        return it.first->second;
+    }
+
+    std::vector<T> items;
+
+private:
+    std::unordered_map<T, uint64_t> lookup;
+};
+
+template <typename T>
+T const& lookupTable(std::vector<T> const& table, uint64_t index)
+{
+    if (index >= table.size())
+        throw std::ios_base::failure("StorageResults: table index out of range");
+    return table[index];
+}
+
+} // namespace
+
 StorageResults::StorageResults(std::string const& _path){
 	path = _path + "/resultsDB";
-    leveldb::Options options;
+    leveldb::Options options = GetSharedDBOptions();
     options.create_if_missing = true;
     leveldb::Status status = leveldb::DB::Open(options, path, &db);
     assert(status.ok());
     LogPrintf("Opened LevelDB successfully\n");
+    upgradeResults();
 }
 
 StorageResults::~StorageResults()
 {
+    {
+        LOCK(cs_results);
+        writeBatch();
+    }
     delete db;
     db = NULL;
 }
 
 void StorageResults::addResult(dev::h256 hashTx, std::vector<TransactionReceiptInfo>& result){
+    LOCK(cs_results);
 	m_cache_result.insert(std::make_pair(hashTx, result));
 }
 
+void StorageResults::addResult(dev::h256 hashTx, std::vector<TransactionReceiptInfo>& result, std::string&& serialized){
+    LOCK(cs_results);
+    if (m_cache_result.insert(std::make_pair(hashTx, result)).second)
+        m_cache_serialized.emplace(hashTx, std::move(serialized));
+}
+
+/** Heap memory of the results of a transaction */
+static size_t ResultUsage(std::vector<TransactionReceiptInfo> const& result)
+{
+    size_t usage = memusage::DynamicUsage(result);
+    for (TransactionReceiptInfo const& info : result) {
+        usage += memusage::DynamicUsage(info.logs);
+        for (dev::eth::LogEntry const& log : info.logs)
+            usage += memusage::DynamicUsage(log.topics) + memusage::DynamicUsage(log.data);
+        usage += memusage::DynamicUsage(info.createdContracts);
+        for (auto const& contract : info.createdContracts)
+            usage += memusage::DynamicUsage(contract.second);
+        usage += memusage::DynamicUsage(info.destructedContracts) + memusage::DynamicUsage(info.transfers) + memusage::DynamicUsage(info.storageGrowth);
+    }
+    return usage;
+}
+
+size_t StorageResults::DynamicMemoryUsage(){
+    LOCK(cs_results);
+    size_t usage = memusage::DynamicUsage(m_cache_result) + memusage::DynamicUsage(m_cache_serialized) +
+                   memusage::DynamicUsage(m_dirty_result) + memusage::DynamicUsage(m_deleted_result) + memusage::MallocUsage(m_batch_size) +
+                   memusage::DynamicUsage(m_disconnected_blocks) + memusage::DynamicUsage(m_disconnected_order);
+    for (auto const& i : m_cache_result)
+        usage += ResultUsage(i.second);
+    for (auto const& i : m_cache_serialized)
+        usage += memusage::MallocUsage(i.second.capacity());
+    for (auto const& i : m_dirty_result)
+        usage += ResultUsage(i.second);
+    return usage;
+}
+
 void StorageResults::clearCacheResult(){
+    LOCK(cs_results);
     m_cache_result.clear();
+    m_cache_serialized.clear();
 }
 
 void StorageResults::wipeResults(){
+    LOCK(cs_results);
     LogPrintf("Wiping LevelDB in %s\n", path);
+    m_cache_result.clear();
+    m_cache_serialized.clear();
+    m_batch.Clear();
+    m_batch_size = 0;
+    m_dirty_result.clear();
+    m_deleted_result.clear();
+    m_disconnected_blocks.clear();
+    m_disconnected_order.clear();
     bool opened = db;
     if (opened) {
         delete db;
     }
     leveldb::Status result = leveldb::DestroyDB(path, leveldb::Options());
     if (opened) {
-        leveldb::Options options;
+        leveldb::Options options = GetSharedDBOptions();
         options.create_if_missing = true;
         leveldb::Status status = leveldb::DB::Open(options, path, &db);
         assert(status.ok());
+        upgradeResults();
     }
 }
 
-void StorageResults::deleteResults(std::vector<CTransactionRef> const& txs){
-
+void StorageResults::disconnectResults(dev::h256 const& hashBlock, std::vector<CTransactionRef> const& txs){
+    LOCK(cs_results);
     for(CTransactionRef tx : txs){
         dev::h256 hashTx = uintToh256(tx->GetHash());
         m_cache_result.erase(hashTx);
+        m_cache_serialized.erase(hashTx);
+        m_dirty_result.erase(hashTx);
+        m_deleted_result.insert(hashTx);
 
-        std::string keyTemp = hashTx.hex();
-	    leveldb::Slice key(keyTemp);
-        leveldb::Status status = db->Delete(leveldb::WriteOptions(), key);
-        assert(status.ok());
+        // The receipts stay under the block, only the mapping of the transaction goes
+        std::string keyTemp = resultBlockKey(hashTx);
+        m_batch.Delete(leveldb::Slice(keyTemp));
+        m_batch_size += keyTemp.size();
+    }
+
+    if (m_disconnected_blocks.insert(hashBlock).second) {
+        m_disconnected_order.push_back(hashBlock);
+        if (m_disconnected_order.size() > MAX_DISCONNECTED_RESULT_BLOCKS) {
+            m_disconnected_blocks.erase(m_disconnected_order.front());
+            m_disconnected_order.pop_front();
+        }
     }
 }
 
 std::vector<TransactionReceiptInfo> StorageResults::getResult(dev::h256 const& hashTx){
+    LOCK(cs_results);
     std::vector<TransactionReceiptInfo> result;
 	auto it = m_cache_result.find(hashTx);
-	if (it == m_cache_result.end()){
-		if(readResult(hashTx, result))
-			m_cache_result.insert(std::make_pair(hashTx, result));
-    } else {
-		result = it->second;
-    }
+	if (it != m_cache_result.end())
+		return it->second;
+	auto itDirty = m_dirty_result.find(hashTx);
+	if (itDirty != m_dirty_result.end())
+		return itDirty->second;
+	dev::h256 hashBlock;
+	if (!m_deleted_result.count(hashTx) && readResultBlock(hashTx, hashBlock))
+		readResult(hashBlock, hashTx, result);
+	return result;
+}
+
+std::vector<TransactionReceiptInfo> StorageResults::getResult(dev::h256 const& hashBlock, dev::h256 const& hashTx){
+    LOCK(cs_results);
+    std::vector<TransactionReceiptInfo> result;
+	auto it = m_cache_result.find(hashTx);
+	if (it != m_cache_result.end() && !it->second.empty() && uintToh256(it->second.front().blockHash) == hashBlock)
+		return it->second;
+	auto itDirty = m_dirty_result.find(hashTx);
+	if (itDirty != m_dirty_result.end() && !itDirty->second.empty() && uintToh256(itDirty->second.front().blockHash) == hashBlock)
+		return itDirty->second;
+	// Receipts committed and disconnected before they were written are only found once written
+	readResult(hashBlock, hashTx, result);
 	return result;
 }
 
 void StorageResults::commitResults(){
+    LOCK(cs_results);
     if(m_cache_result.size()){
 
         for (auto const& i: m_cache_result){
-            std::string valueTemp;
-            std::string keyTemp = i.first.hex();
-            leveldb::Slice key(keyTemp);
-            leveldb::Status status = db->Get(leveldb::ReadOptions(), key, &valueTemp);
-
-            if(status.IsNotFound()){
-
-                TransactionReceiptInfoSerialized tris;
-
-                for (auto const& receipt_info: i.second) {
-                    tris.blockHashes.push_back(uintToh256(receipt_info.blockHash));
-                    tris.blockNumbers.push_back(receipt_info.blockNumber);
-                    tris.transactionHashes.push_back(uintToh256(receipt_info.transactionHash));
-                    tris.transactionIndexes.push_back(receipt_info.transactionIndex);
-                    tris.outputIndexes.push_back(receipt_info.outputIndex);
-                    tris.senders.push_back(receipt_info.from);
-                    tris.receivers.push_back(receipt_info.to);
-                    tris.cumulativeGasUsed.push_back(dev::u256(receipt_info.cumulativeGasUsed));
-                    tris.gasUsed.push_back(dev::u256(receipt_info.gasUsed));
-                    tris.contractAddresses.push_back(receipt_info.contractAddress);
-                    tris.logs.push_back(logEntriesSerialization(receipt_info.logs));
-                    tris.excepted.push_back(uint32_t(static_cast<int>(receipt_info.excepted)));
-                    tris.exceptedMessage.push_back(receipt_info.exceptedMessage);
-                    tris.stateRoots.push_back(receipt_info.stateRoot);
-                    tris.utxoRoots.push_back(receipt_info.utxoRoot);
-                    tris.createdContracts.push_back(receipt_info.createdContracts);
-                    tris.destructedContracts.push_back(receipt_info.destructedContracts);
+            if (i.second.empty())
+                continue;
+            // Results are keyed by block and txid and fully determined by them, so the
+            // ones of a block connected again after a reorg are already stored, and for
+            // the others a blind overwrite is equivalent to a read-before-write
+            dev::h256 hashBlock = uintToh256(i.second.front().blockHash);
+            if (!m_disconnected_blocks.count(hashBlock)) {
+                std::string keyTemp = resultKey(hashBlock, i.first);
+                auto itSerialized = m_cache_serialized.find(i.first);
+                std::string stringData = itSerialized != m_cache_serialized.end() ? std::move(itSerialized->second) : serializeResult(i.second);
+                m_batch.Put(leveldb::Slice(keyTemp), leveldb::Slice(stringData));
+                m_batch_size += keyTemp.size() + stringData.size();
+            }
+            std::string keyBlock = resultBlockKey(i.first);
+            m_batch.Put(leveldb::Slice(keyBlock), leveldb::Slice((const char*)hashBlock.data(), dev::h256::size));
+            m_batch_size += keyBlock.size() + dev::h256::size;
+
+            m_deleted_result.erase(i.first);
+            m_dirty_result[i.first] = i.second;
+        }
+        m_cache_result.clear();
+        m_cache_serialized.clear();
+    }
+    if (m_batch_size > MAX_RESULTS_BATCH_SIZE) {
+        bool ret = writeBatch();
+        assert(ret);
+    }
+}
+
+bool StorageResults::flushResults(){
+    LOCK(cs_results);
+    return writeBatch();
+}
+
+bool StorageResults::writeBatch(){
+    if (m_batch_size == 0)
+        return true;
+    leveldb::Status status = db->Write(leveldb::WriteOptions(), &m_batch);
+    if (!status.ok()) {
+        LogPrintf("Failed to write results to LevelDB: %s\n", status.ToString());
+        return false;
+    }
+    m_batch.Clear();
+    m_batch_size = 0;
+    m_dirty_result.clear();
+    m_deleted_result.clear();
+    return true;
+}
+
+std::string StorageResults::serializeResult(std::vector<TransactionReceiptInfo> const& _result){
+    CompactTable<dev::Address> addresses;
+    CompactTable<dev::h256> topics;
+
+    // The block and transaction fields are shared by all outputs of a transaction
+    CDataStream body(SER_DISK, CLIENT_VERSION);
+    uint64_t count = _result.size();
+    body << VARINT(count);
+    if (count) {
+        uint32_t blockNumber = _result[0].blockNumber;
+        uint32_t transactionIndex = _result[0].transactionIndex;
+        body << _result[0].blockHash << VARINT(blockNumber) << _result[0].transactionHash << VARINT(transactionIndex);
+    }
+
+    for (auto const& receipt_info: _result) {
+        uint64_t from = addresses.index(receipt_info.from);
+        uint64_t to = addresses.index(receipt_info.to);
+        uint64_t contractAddress = addresses.index(receipt_info.contractAddress);
+        uint32_t excepted = static_cast<uint32_t>(receipt_info.excepted);
+        body << VARINT(receipt_info.outputIndex) << VARINT(from) << VARINT(to);
+        body << VARINT(receipt_info.cumulativeGasUsed) << VARINT(receipt_info.gasUsed) << VARINT(contractAddress);
+        body << VARINT(excepted) << receipt_info.exceptedMessage;
+        writeHash(body, receipt_info.stateRoot);
+        writeHash(body, receipt_info.utxoRoot);
+
+        uint64_t nLogs = receipt_info.logs.size();
+        body << VARINT(nLogs);
+        for (dev::eth::LogEntry const& log : receipt_info.logs) {
+            uint64_t address = addresses.index(log.address);
+            uint64_t nTopics = log.topics.size();
+            body << VARINT(address) << VARINT(nTopics);
+            for (dev::h256 const& topic : log.topics) {
+                uint64_t index = topics.index(topic);
+                body << VARINT(index);
+            }
+            body << log.data;
+        }
+
+        uint64_t nCreated = receipt_info.createdContracts.size();
+        body << VARINT(nCreated);
+        for (auto const& created : receipt_info.createdContracts) {
+            uint64_t address = addresses.index(created.first);
+            body << VARINT(address) << created.second;
+        }
+
+        uint64_t nDestructed = receipt_info.destructedContracts.size();
+        body << VARINT(nDestructed);
+        for (dev::Address const& destructed : receipt_info.destructedContracts) {
+            uint64_t address = addresses.index(destructed);
+            body << VARINT(address);
+        }
+    }
+
+    // The storage growth follows the receipts, older records end before it
+    if (count && _result[0].fStorageGrowth) {
+        for (auto const& receipt_info: _result) {
+            uint64_t nGrowth = receipt_info.storageGrowth.size();
+            body << VARINT(nGrowth);
+            for (auto const& growth : receipt_info.storageGrowth) {
+                uint64_t address = addresses.index(growth.first);
+                body << VARINT(address) << growth.second.nLeaves << growth.second.nNodes;
+            }
+        }
+    }
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    uint64_t nAddresses = addresses.items.size();
+    ss << VARINT(nAddresses);
+    for (dev::Address const& address : addresses.items)
+        writeHash(ss, address);
+    uint64_t nTopics = topics.items.size();
+    ss << VARINT(nTopics);
+    for (dev::h256 const& topic : topics.items)
+        writeHash(ss, topic);
+    ss.write(body.data(), body.size());
+
+    return ss.str();
+}
+
+bool StorageResults::deserializeResult(std::string const& _value, std::vector<TransactionReceiptInfo>& _result){
+    try {
+        CDataStream ss(_value.data(), _value.data() + _value.size(), SER_DISK, CLIENT_VERSION);
+
+        uint64_t nAddresses = 0;
+        ss >> VARINT(nAddresses);
+        std::vector<dev::Address> addresses(std::min<uint64_t>(nAddresses, ss.size() / dev::Address::size));
+        if (addresses.size() != nAddresses)
+            return false;
+        for (dev::Address& address : addresses)
+            readHash(ss, address);
+
+        uint64_t nTopics = 0;
+        ss >> VARINT(nTopics);
+        std::vector<dev::h256> topics(std::min<uint64_t>(nTopics, ss.size() / dev::h256::size));
+        if (topics.size() != nTopics)
+            return false;
+        for (dev::h256& topic : topics)
+            readHash(ss, topic);
+
+        uint64_t count = 0;
+        uint256 blockHash, transactionHash;
+        uint32_t blockNumber = 0, transactionIndex = 0;
+        ss >> VARINT(count);
+        if (count)
+            ss >> blockHash >> VARINT(blockNumber) >> transactionHash >> VARINT(transactionIndex);
+
+        for (uint64_t i = 0; i < count; i++) {
+            TransactionReceiptInfo tri;
+            tri.blockHash = blockHash;
+            tri.blockNumber = blockNumber;
+            tri.transactionHash = transactionHash;
+            tri.transactionIndex = transactionIndex;
+
+            uint64_t from = 0, to = 0, contractAddress = 0;
+            uint32_t excepted = 0;
+            ss >> VARINT(tri.outputIndex) >> VARINT(from) >> VARINT(to);
+            ss >> VARINT(tri.cumulativeGasUsed) >> VARINT(tri.gasUsed) >> VARINT(contractAddress);
+            ss >> VARINT(excepted) >> tri.exceptedMessage;
+            tri.from = lookupTable(addresses, from);
+            tri.to = lookupTable(addresses, to);
+            tri.contractAddress = lookupTable(addresses, contractAddress);
+            tri.excepted = static_cast<dev::eth::TransactionException>(excepted);
+            readHash(ss, tri.stateRoot);
+            readHash(ss, tri.utxoRoot);
+
+            uint64_t nLogs = 0;
+            ss >> VARINT(nLogs);
+            for (uint64_t j = 0; j < nLogs; j++) {
+                uint64_t address = 0, nLogTopics = 0;
+                ss >> VARINT(address) >> VARINT(nLogTopics);
+                dev::h256s logTopics;
+                for (uint64_t k = 0; k < nLogTopics; k++) {
+                    uint64_t index = 0;
+                    ss >> VARINT(index);
+                    logTopics.push_back(lookupTable(topics, index));
                 }
+                dev::bytes data;
+                ss >> data;
+                tri.logs.push_back(dev::eth::LogEntry(lookupTable(addresses, address), logTopics, std::move(data)));
+            }
 
-                dev::RLPStream streamRLP(17);
-                streamRLP << tris.blockHashes << tris.blockNumbers << tris.transactionHashes << tris.transactionIndexes << tris.outputIndexes;
-                streamRLP << tris.senders << tris.receivers << tris.cumulativeGasUsed << tris.gasUsed << tris.contractAddresses << tris.logs << tris.excepted << tris.exceptedMessage;
-                streamRLP << tris.stateRoots << tris.utxoRoots << tris.createdContracts << tris.destructedContracts;
+            uint64_t nCreated = 0;
+            ss >> VARINT(nCreated);
+            for (uint64_t j = 0; j < nCreated; j++) {
+                uint64_t address = 0;
+                dev::bytes code;
+                ss >> VARINT(address) >> code;
+                tri.createdContracts.push_back(std::make_pair(lookupTable(addresses, address), std::move(code)));
+            }
 
-                dev::bytes data = streamRLP.out();
-                std::string stringData(data.begin(), data.end());
-                leveldb::Slice value(stringData);
-                status = db->Put(leveldb::WriteOptions(), key, value);
-                assert(status.ok());
+            uint64_t nDestructed = 0;
+            ss >> VARINT(nDestructed);
+            for (uint64_t j = 0; j < nDestructed; j++) {
+                uint64_t address = 0;
+                ss >> VARINT(address);
+                tri.destructedContracts.push_back(lookupTable(addresses, address));
             }
+
+            tri.fStorageGrowth = false;
+            _result.push_back(std::move(tri));
         }
-        m_cache_result.clear();
+
+        if (!ss.empty()) {
+            for (TransactionReceiptInfo& tri : _result) {
+                uint64_t nGrowth = 0;
+                ss >> VARINT(nGrowth);
+                for (uint64_t j = 0; j < nGrowth; j++) {
+                    uint64_t address = 0;
+                    StateTrieDiff growth;
+                    ss >> VARINT(address) >> growth.nLeaves >> growth.nNodes;
+                    tri.storageGrowth.emplace_back(lookupTable(addresses, address), growth);
+                }
+                tri.fStorageGrowth = true;
+            }
+        }
+    } catch (const std::exception& e) {
+        LogPrintf("StorageResults: failed to deserialize result: %s\n", e.what());
+        _result.clear();
+        return false;
     }
+    return true;
 }
 
-bool StorageResults::readResult(dev::h256 const& _key, std::vector<TransactionReceiptInfo>& _result){
+bool StorageResults::readResult(dev::h256 const& _hashBlock, dev::h256 const& _hashTx, std::vector<TransactionReceiptInfo>& _result){
 
     std::string value;
-    std::string keyTemp = _key.hex();;
-    leveldb::Slice key(keyTemp);
-    leveldb::Status s = db->Get(leveldb::ReadOptions(), key, &value);
+    leveldb::Status s = db->Get(leveldb::ReadOptions(), resultKey(_hashBlock, _hashTx), &value);
+    if(!s.ok())
+        return false;
+    return deserializeResult(value, _result);
+}
+
+bool StorageResults::readResultBlock(dev::h256 const& _hashTx, dev::h256& _hashBlock){
+
+    std::string value;
+    leveldb::Status s = db->Get(leveldb::ReadOptions(), resultBlockKey(_hashTx), &value);
+    if(!s.ok() || value.size() != dev::h256::size)
+        return false;
+    _hashBlock = dev::h256(reinterpret_cast<const dev::byte*>(value.data()), dev::h256::ConstructFromPointer);
+    return true;
+}
 
-	if(!s.IsNotFound() && s.ok()){
-        
+bool StorageResults::deserializeLegacyResult(std::string const& value, std::vector<TransactionReceiptInfo>& _result){
+    try {
         TransactionReceiptInfoSerialized tris;
 
 		dev::RLP state(value);
@@ -161,21 +520,75 @@ bool StorageResults::readResult(dev::h256 const& _key, std::vector<TransactionRe
                 tris.stateRoots[j],
                 tris.utxoRoots[j],
                 tris.createdContracts[j],
-                tris.destructedContracts[j]
+                tris.destructedContracts[j],
+                {},
+                {},
+                false
             };
             _result.push_back(tri);
         }
-		return true;
-	}
-	return false;
+    } catch (const std::exception& e) {
+        LogPrintf("StorageResults: failed to deserialize legacy result: %s\n", e.what());
+        _result.clear();
+        return false;
+    }
+    return true;
 }
 
-logEntriesSerialize StorageResults::logEntriesSerialization(dev::eth::LogEntries const& _logs){
-	logEntriesSerialize result;
-	for(dev::eth::LogEntry i : _logs){
-		result.push_back(std::make_pair(i.address, std::make_pair(i.topics, i.data)));
-	}
-	return result;
+void StorageResults::upgradeResults(){
+    std::string version;
+    leveldb::Status status = db->Get(leveldb::ReadOptions(), DB_FORMAT_VERSION, &version);
+    if (status.ok() && version.size() == 1 && (uint8_t)version[0] >= RESULTS_FORMAT_VERSION)
+        return;
+
+    // Rewrite the records of format 0, which are keyed by the 64 character hex txid, and
+    // those of format 1, keyed by the raw txid, under their block
+    size_t count = 0;
+    {
+        std::unique_ptr<leveldb::Iterator> it(db->NewIterator(leveldb::ReadOptions()));
+        leveldb::WriteBatch batch;
+        size_t batchSize = 0;
+        for (it->SeekToFirst(); it->Valid(); it->Next()) {
+            leveldb::Slice key = it->key();
+            bool fLegacy = key.size() == 2 * dev::h256::size;
+            if (!fLegacy && (key.size() != 1 + dev::h256::size || key[0] != DB_TX_RESULT))
+                continue;
+            if (count == 0)
+                LogPrintf("Upgrading resultsDB in %s to the format by block...\n", path);
+            dev::h256 hashTx = fLegacy ? dev::h256(key.ToString()) :
+                dev::h256(reinterpret_cast<const dev::byte*>(key.data() + 1), dev::h256::ConstructFromPointer);
+            std::vector<TransactionReceiptInfo> result;
+            bool fRead = fLegacy ? deserializeLegacyResult(it->value().ToString(), result) : deserializeResult(it->value().ToString(), result);
+            if (fRead && !result.empty()) {
+                dev::h256 hashBlock = uintToh256(result.front().blockHash);
+                std::string keyResult = resultKey(hashBlock, hashTx);
+                std::string value = fLegacy ? serializeResult(result) : it->value().ToString();
+                std::string keyBlock = resultBlockKey(hashTx);
+                batch.Put(keyResult, value);
+                batch.Put(keyBlock, leveldb::Slice((const char*)hashBlock.data(), dev::h256::size));
+                batchSize += keyResult.size() + value.size() + keyBlock.size() + dev::h256::size;
+            }
+            batch.Delete(key);
+            if (++count % 100000 == 0)
+                LogPrintf("Upgraded %u results\n", count);
+            if (batchSize > MAX_RESULTS_BATCH_SIZE) {
+                status = db->Write(leveldb::WriteOptions(), &batch);
+                assert(status.ok());
+                batch.Clear();
+                batchSize = 0;
+            }
+        }
+        assert(it->status().ok());
+        status = db->Write(leveldb::WriteOptions(), &batch);
+        assert(status.ok());
+    }
+
+    leveldb::WriteOptions syncOptions;
+    syncOptions.sync = true;
+    status = db->Put(syncOptions, DB_FORMAT_VERSION, std::string(1, (char)RESULTS_FORMAT_VERSION));
+    assert(status.ok());
+    if (count)
+        LogPrintf("Upgraded %u results in resultsDB\n", count);
 }
 
 dev::eth::LogEntries StorageResults::logEntriesDeserialize(logEntriesSerialize const& _logs){
@@ -2,9 +2,15 @@
 #include <primitives/transaction.h>
 #include <libethereum/State.h>
 #include <libethereum/Transaction.h>
+#include <qtum/qtumstatewalk.h>
 #include <leveldb/db.h>
+#include <leveldb/write_batch.h>
+#include <sync.h>
 #include <util/system.h>
 
+#include <deque>
+#include <unordered_set>
+
 using logEntriesSerialize = std::vector<std::pair<dev::Address, std::pair<dev::h256s, dev::bytes>>>;
 
 struct TransactionReceiptInfo{
@@ -25,6 +31,13 @@ struct TransactionReceiptInfo{
     dev::h256 utxoRoot;
     std::vector<std::pair<dev::Address, dev::bytes>> createdContracts;
     std::vector<dev::Address> destructedContracts;
+    //! Senders and receivers of the value transfers, only known right after the execution,
+    //! they are not kept in the results database
+    std::vector<std::pair<dev::Address, dev::Address>> transfers;
+    //! Storage slots and storage trie nodes each contract gained, measured if fStorageGrowth
+    //! is set. Results written without them do not have it set.
+    std::vector<std::pair<dev::Address, StateTrieDiff>> storageGrowth;
+    bool fStorageGrowth;
 };
 
 struct TransactionReceiptInfoSerialized{
@@ -47,6 +60,14 @@ struct TransactionReceiptInfoSerialized{
     std::vector<std::vector<dev::h160>> destructedContracts;
 };
 
+/**
+ * The receipts of the contract transactions, for the log index and the receipt RPCs.
+ *
+ * The receipts are stored by block and transaction, and a transaction of the active chain
+ * maps to the block it is in. Disconnecting a block only removes the mappings of its
+ * transactions: its receipts are kept, so that connecting it again after a reorg does not
+ * write them again, and so that they can be read instead of executing the block again.
+ */
 class StorageResults{
 
 public:
@@ -56,21 +77,50 @@ public:
 
 	void addResult(dev::h256 hashTx, std::vector<TransactionReceiptInfo>& result);
 
-    void deleteResults(std::vector<CTransactionRef> const& txs);
+	/** Add a result together with its serializeResult encoding, prepared off the validation thread */
+	void addResult(dev::h256 hashTx, std::vector<TransactionReceiptInfo>& result, std::string&& serialized);
+
+    /** Unmap the transactions of a disconnected block, whose receipts are kept */
+    void disconnectResults(dev::h256 const& hashBlock, std::vector<CTransactionRef> const& txs);
 
+    /** The receipts of a transaction in the block of the active chain it is in */
     std::vector<TransactionReceiptInfo> getResult(dev::h256 const& hashTx);
 
+    /** The receipts of a transaction in a block, also when the block was disconnected */
+    std::vector<TransactionReceiptInfo> getResult(dev::h256 const& hashBlock, dev::h256 const& hashTx);
+
+	/** Move the results of the connected block into the pending write batch */
 	void commitResults();
 
+	/** Write the pending batch to disk; called together with the chainstate flush */
+	bool flushResults();
+
     void clearCacheResult();
 
     void wipeResults();
 
+    /** Memory used by the results of the block being connected and those waiting to be written */
+    size_t DynamicMemoryUsage();
+
+	/** Encode the results of one transaction in the on-disk record format; thread safe */
+	static std::string serializeResult(std::vector<TransactionReceiptInfo> const& _result);
+
 private:
 
-	bool readResult(dev::h256 const& _key, std::vector<TransactionReceiptInfo>& _result);
+	bool writeBatch() EXCLUSIVE_LOCKS_REQUIRED(cs_results);
+
+	bool deserializeResult(std::string const& _value, std::vector<TransactionReceiptInfo>& _result);
+
+	/** Decode a record of the original RLP format, only used to migrate it */
+	bool deserializeLegacyResult(std::string const& _value, std::vector<TransactionReceiptInfo>& _result);
 
-	logEntriesSerialize logEntriesSerialization(dev::eth::LogEntries const& _logs);
+	/** Rewrite the records of an older on-disk format in the current one */
+	void upgradeResults();
+
+	bool readResult(dev::h256 const& _hashBlock, dev::h256 const& _hashTx, std::vector<TransactionReceiptInfo>& _result);
+
+	/** Read the block of the active chain a transaction is in */
+	bool readResultBlock(dev::h256 const& _hashTx, dev::h256& _hashBlock);
 
 	dev::eth::LogEntries logEntriesDeserialize(logEntriesSerialize const& _logs);
 
@@ -78,5 +128,26 @@ private:
 
     leveldb::DB* db;
 
-	std::unordered_map<dev::h256, std::vector<TransactionReceiptInfo>> m_cache_result;
+	CCriticalSection cs_results;
+
+	// Results of the block being connected, not yet committed
+	std::unordered_map<dev::h256, std::vector<TransactionReceiptInfo>> m_cache_result GUARDED_BY(cs_results);
+	// Encodings of the cached results that were serialized in advance
+	std::unordered_map<dev::h256, std::string> m_cache_serialized GUARDED_BY(cs_results);
+
+	// Committed results and deletions not yet written to db, in the order they were made
+	leveldb::WriteBatch m_batch GUARDED_BY(cs_results);
+	size_t m_batch_size GUARDED_BY(cs_results) = 0;
+	std::unordered_map<dev::h256, std::vector<TransactionReceiptInfo>> m_dirty_result GUARDED_BY(cs_results);
+	std::unordered_set<dev::h256> m_deleted_result GUARDED_BY(cs_results);
+
+	// Recently disconnected blocks, whose receipts are already stored
+	std::unordered_set<dev::h256> m_disconnected_blocks GUARDED_BY(cs_results);
+	std::deque<dev::h256> m_disconnected_order GUARDED_BY(cs_results);
 };
+
+/** Write the pending receipts even before the next chainstate flush once they exceed this size */
+static const size_t MAX_RESULTS_BATCH_SIZE = 32 << 20;
+
+/** Number of disconnected blocks remembered, so that their receipts are not written again when they are connected again */
+static const size_t MAX_DISCONNECTED_RESULT_BLOCKS = 1000;
@@ -8,6 +8,7 @@
 #include <chainparams.h>
 #include <core_io.h>
 #include <httpserver.h>
+#include <index/logindex.h>
 #include <index/txindex.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
@@ -16,6 +17,8 @@
 #include <streams.h>
 #include <sync.h>
 #include <txmempool.h>
+#include <undo.h>
+#include <util/convert.h>
 #include <util/strencodings.h>
 #include <validation.h>
 #include <version.h>
@@ -25,6 +28,8 @@
 #include <univalue.h>
 
 static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once
+static const long MAX_REST_BLOCKRANGE_COUNT = 2000; //allow a max of 2000 blocks to be streamed at once
+static const size_t REST_BLOCKRANGE_CHUNK_SIZE = 1 << 20;
 
 enum class RetFormat {
     UNDEF,
@@ -191,6 +196,108 @@ static bool rest_headers(HTTPRequest* req,
     }
 }
 
+static bool rest_blockrange(HTTPRequest* req,
+                             const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    bool fUndo = false;
+    bool fReceipts = false;
+    while (path.size() > 2) {
+        if (path[0] == "undo" && !fUndo && !fReceipts)
+            fUndo = true;
+        else if (path[0] == "receipts" && !fReceipts)
+            fReceipts = true;
+        else
+            return RESTERR(req, HTTP_BAD_REQUEST, "Invalid option: " + SanitizeString(path[0]));
+        path.erase(path.begin());
+    }
+    if (path.size() != 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "No block count specified. Use /rest/blockrange/[undo/][receipts/]<count>/<height>.bin");
+    if (rf != RetFormat::BINARY)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: .bin)");
+
+    long count = strtol(path[0].c_str(), nullptr, 10);
+    if (count < 1 || count > MAX_REST_BLOCKRANGE_COUNT)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Block count out of range: " + path[0]);
+
+    int32_t nStart;
+    if (!ParseInt32(path[1], &nStart) || nStart < 0)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid height: " + SanitizeString(path[1]));
+
+    if (fReceipts && !fLogEvents)
+        return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, "Events indexing disabled");
+
+    std::vector<const CBlockIndex*> blocks;
+    blocks.reserve(count);
+    {
+        LOCK(cs_main);
+        if (nStart > chainActive.Height())
+            return RESTERR(req, HTTP_NOT_FOUND, "Block height out of range");
+        for (const CBlockIndex* pindex = chainActive[nStart]; pindex && blocks.size() < (unsigned long)count; pindex = chainActive.Next(pindex)) {
+            if (IsBlockPruned(pindex))
+                return RESTERR(req, HTTP_NOT_FOUND, pindex->GetBlockHash().GetHex() + " not available (pruned data)");
+            blocks.push_back(pindex);
+        }
+    }
+    if (fReceipts && g_logindex)
+        g_logindex->BlockUntilSyncedToCurrentChain();
+
+    req->WriteHeader("Content-Type", "application/octet-stream");
+    req->WriteHeader("Connection", "close");
+
+    // The blocks are read in height order, which is also the order of the block and undo
+    // files, so the reads stay sequential and the readahead of the OS covers them. A block
+    // that can no longer be read ends the stream early.
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    std::vector<uint8_t> vchBlock;
+    for (const CBlockIndex* pindex : blocks) {
+        if (!ReadRawBlockFromDisk(vchBlock, pindex, Params().MessageStart()))
+            break;
+        ss << (uint32_t)pindex->nHeight << pindex->GetBlockHash() << vchBlock;
+
+        if (fUndo) {
+            CBlockUndo blockundo;
+            if (pindex->nHeight > 0 && !UndoReadFromDisk(blockundo, pindex))
+                break;
+            CDataStream ssUndo(SER_NETWORK, PROTOCOL_VERSION);
+            ssUndo << blockundo;
+            ss << ssUndo.str();
+        }
+
+        if (fReceipts) {
+            CBlock block;
+            try {
+                CDataStream ssBlock(vchBlock, SER_NETWORK, PROTOCOL_VERSION);
+                ssBlock >> block;
+            } catch (const std::exception&) {
+                break;
+            }
+            // The record of the receipts of each transaction that has any, as the node stores it
+            std::vector<std::pair<uint256, std::string>> receipts;
+            for (const CTransactionRef& tx : block.vtx) {
+                const std::vector<TransactionReceiptInfo> result = pstorageresult->getResult(uintToh256(tx->GetHash()));
+                if (!result.empty())
+                    receipts.emplace_back(tx->GetHash(), StorageResults::serializeResult(result));
+            }
+            ss << receipts;
+        }
+
+        if (ss.size() >= REST_BLOCKRANGE_CHUNK_SIZE) {
+            req->Chunk(ss.str());
+            ss.clear();
+        }
+    }
+    req->Chunk(ss.str());
+    req->ChunkEnd();
+    return true;
+}
+
 static bool rest_block(HTTPRequest* req,
                        const std::string& strURIPart,
                        bool showTxDetails)
@@ -391,6 +498,155 @@ static bool rest_tx(HTTPRequest* req, const std::string& strURIPart)
     }
 }
 
+// Contract calls of rpc/blockchain.cpp, answered without the JSON-RPC envelope
+UniValue gettransactionreceipt(const JSONRPCRequest& request);
+UniValue callcontract(const JSONRPCRequest& request);
+UniValue getstorage(const JSONRPCRequest& request);
+
+/** Run an RPC call for a REST request, replying with its error if it fails */
+static bool RESTCallRPC(HTTPRequest* req, UniValue (*actor)(const JSONRPCRequest&), const UniValue& params, UniValue& result)
+{
+    JSONRPCRequest jsonRequest(req);
+    jsonRequest.params = params;
+    try {
+        result = actor(jsonRequest);
+    } catch (const UniValue& objError) {
+        const int code = find_value(objError, "code").get_int();
+        const HTTPStatusCode status = code == RPC_INVALID_ADDRESS_OR_KEY ? HTTP_NOT_FOUND :
+                                      code == RPC_INTERNAL_ERROR ? HTTP_INTERNAL_SERVER_ERROR : HTTP_BAD_REQUEST;
+        return RESTERR(req, status, find_value(objError, "message").get_str());
+    } catch (const std::exception& e) {
+        return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, e.what());
+    }
+    return true;
+}
+
+static bool rest_receipt(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string hashStr;
+    const RetFormat rf = ParseDataFormat(hashStr, strURIPart);
+
+    uint256 hash;
+    if (!ParseHashStr(hashStr, hash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
+
+    if (!fLogEvents)
+        return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, "Events indexing disabled");
+
+    switch (rf) {
+    case RetFormat::BINARY:
+    case RetFormat::HEX: {
+        if (g_logindex) g_logindex->BlockUntilSyncedToCurrentChain();
+        // The record of the receipts of the transaction, as the node stores it
+        const std::string record = StorageResults::serializeResult(pstorageresult->getResult(uintToh256(hash)));
+        if (rf == RetFormat::BINARY) {
+            req->WriteHeader("Content-Type", "application/octet-stream");
+            req->WriteReply(HTTP_OK, record);
+        } else {
+            req->WriteHeader("Content-Type", "text/plain");
+            req->WriteReply(HTTP_OK, HexStr(record.begin(), record.end()) + "\n");
+        }
+        return true;
+    }
+
+    case RetFormat::JSON: {
+        UniValue params(UniValue::VARR);
+        params.push_back(hashStr);
+        UniValue result;
+        if (!RESTCallRPC(req, gettransactionreceipt, params, result))
+            return false;
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, result.write() + "\n");
+        return true;
+    }
+
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+}
+
+static bool rest_callcontract(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.size() != 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid URI format. Use /rest/callcontract/<address>/<data>.<ext>.");
+    if (rf == RetFormat::UNDEF)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+
+    UniValue params(UniValue::VARR);
+    params.push_back(path[0]);
+    params.push_back(path[1]);
+    UniValue result;
+    if (!RESTCallRPC(req, callcontract, params, result))
+        return false;
+
+    switch (rf) {
+    case RetFormat::BINARY: {
+        // The data returned by the call
+        const std::vector<unsigned char> output = ParseHex(find_value(find_value(result, "executionResult"), "output").get_str());
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, std::string(output.begin(), output.end()));
+        return true;
+    }
+
+    case RetFormat::HEX: {
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, find_value(find_value(result, "executionResult"), "output").get_str() + "\n");
+        return true;
+    }
+
+    default: {
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, result.write() + "\n");
+        return true;
+    }
+    }
+}
+
+static bool rest_storage(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.size() < 1 || path.size() > 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid URI format. Use /rest/storage/<address>[/<blocknum>].json.");
+
+    switch (rf) {
+    case RetFormat::JSON: {
+        UniValue params(UniValue::VARR);
+        params.push_back(path[0]);
+        if (path.size() == 2) {
+            int32_t blockNum;
+            if (!ParseInt32(path[1], &blockNum))
+                return RESTERR(req, HTTP_BAD_REQUEST, "Invalid block number: " + path[1]);
+            params.push_back(blockNum);
+        }
+        UniValue result;
+        if (!RESTCallRPC(req, getstorage, params, result))
+            return false;
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, result.write() + "\n");
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: json)");
+    }
+    }
+}
+
 static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
 {
     if (!CheckWarmup(req))
@@ -621,6 +877,55 @@ static bool rest_blockhash_by_height(HTTPRequest* req,
     }
 }
 
+/** Append the samples of a metric in the Prometheus text format */
+static void AppendMetric(std::string& out, const std::string& name, const std::string& type, const std::string& help)
+{
+    out += "# HELP " + name + " " + help + "\n";
+    out += "# TYPE " + name + " " + type + "\n";
+}
+
+static bool rest_metrics(HTTPRequest* req, const std::string& strURIPart)
+{
+    const std::map<std::string, RPCMethodStats> stats = GetRPCMethodStats();
+    std::string out;
+
+    AppendMetric(out, "kpg_rpc_call_duration_seconds", "histogram", "Duration of the completed RPC calls.");
+    for (const auto& entry : stats) {
+        const std::string label = "method=\"" + entry.first + "\"";
+        const StageTimes& times = entry.second.times;
+        uint64_t nCumulative = 0;
+        for (size_t i = 0; i < VALIDATION_STATS_NUM_BUCKETS; i++) {
+            nCumulative += times.histogram[i];
+            out += strprintf("kpg_rpc_call_duration_seconds_bucket{%s,le=\"%g\"} %u\n", label, VALIDATION_STATS_BUCKETS[i] * 1e-6, nCumulative);
+        }
+        out += strprintf("kpg_rpc_call_duration_seconds_bucket{%s,le=\"+Inf\"} %u\n", label, times.nCount);
+        out += strprintf("kpg_rpc_call_duration_seconds_sum{%s} %.6f\n", label, times.nTotal * 1e-6);
+        out += strprintf("kpg_rpc_call_duration_seconds_count{%s} %u\n", label, times.nCount);
+    }
+    AppendMetric(out, "kpg_rpc_call_errors_total", "counter", "RPC calls that returned an error.");
+    for (const auto& entry : stats)
+        out += strprintf("kpg_rpc_call_errors_total{method=\"%s\"} %u\n", entry.first, entry.second.nErrors);
+    AppendMetric(out, "kpg_rpc_calls_in_flight", "gauge", "RPC calls running.");
+    for (const auto& entry : stats)
+        out += strprintf("kpg_rpc_calls_in_flight{method=\"%s\"} %u\n", entry.first, entry.second.nInFlight);
+
+    const HTTPWorkQueueStats queue = GetHTTPWorkQueueStats();
+    AppendMetric(out, "kpg_http_workqueue_depth", "gauge", "HTTP requests waiting for a worker.");
+    out += strprintf("kpg_http_workqueue_depth %u\n", queue.nDepth);
+    AppendMetric(out, "kpg_http_workqueue_max_depth", "gauge", "Maximum number of HTTP requests a client may have waiting.");
+    out += strprintf("kpg_http_workqueue_max_depth %u\n", queue.nMaxDepth);
+    AppendMetric(out, "kpg_http_workqueue_clients", "gauge", "Clients with HTTP requests waiting for a worker.");
+    out += strprintf("kpg_http_workqueue_clients %u\n", queue.nClients);
+    AppendMetric(out, "kpg_http_workers_busy", "gauge", "HTTP workers handling a request.");
+    out += strprintf("kpg_http_workers_busy %u\n", queue.nBusy);
+    AppendMetric(out, "kpg_http_workqueue_rejected_total", "counter", "HTTP requests refused because the work queue was full.");
+    out += strprintf("kpg_http_workqueue_rejected_total %u\n", queue.nRejected);
+
+    req->WriteHeader("Content-Type", "text/plain; version=0.0.4");
+    req->WriteReply(HTTP_OK, out);
+    return true;
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(HTTPRequest* req, const std::string& strReq);
@@ -632,8 +937,13 @@ static const struct {
       {"/rest/mempool/info", rest_mempool_info},
       {"/rest/mempool/contents", rest_mempool_contents},
       {"/rest/headers/", rest_headers},
+      {"/rest/blockrange/", rest_blockrange},
       {"/rest/getutxos", rest_getutxos},
       {"/rest/blockhashbyheight/", rest_blockhash_by_height},
+      {"/rest/receipt/", rest_receipt},
+      {"/rest/callcontract/", rest_callcontract},
+      {"/rest/storage/", rest_storage},
+      {"/rest/metrics", rest_metrics},
 };
 
 void StartREST()
@@ -7,13 +7,20 @@
 
 #include <amount.h>
 #include <base58.h>
+#include <blockfilter.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <checkpoints.h>
 #include <coins.h>
 #include <consensus/validation.h>
 #include <core_io.h>
+#include <crypto/muhash.h>
 #include <hash.h>
+#include <index/blockfilterindex.h>
+#include <index/blockstatsindex.h>
+#include <index/contractindex.h>
+#include <index/logindex.h>
+#include <index/statediffindex.h>
 #include <index/txindex.h>
 #include <key_io.h>
 #include <policy/feerate.h>
@@ -23,19 +30,28 @@
 #include <rpc/server.h>
 #include <rpc/util.h>
 #include <script/descriptor.h>
+#include <shutdown.h>
 #include <streams.h>
 #include <sync.h>
 #include <txdb.h>
 #include <txmempool.h>
+#include <undo.h>
 #include <util/strencodings.h>
 #include <util/system.h>
 #include <validation.h>
 #include <validationinterface.h>
+#include <validationstats.h>
+#include <validationtimes.h>
 #include <versionbitsinfo.h>
 #include <warnings.h>
 #include <libdevcore/CommonData.h>
+#include <libevm/Instruction.h>
 #include <pow.h>
 #include <pos.h>
+#include <qtum/qtumprofile.h>
+#include <qtum/qtumstateprune.h>
+#include <qtum/qtumstatesnapshot.h>
+#include <qtum/qtumstatewalk.h>
 #include <txdb.h>
 #include <util/convert.h>
 
@@ -48,6 +64,7 @@
 
 #include <memory>
 #include <mutex>
+#include <thread>
 #include <condition_variable>
 
 /* Calculate the difficulty for a given block index.
@@ -55,10 +72,14 @@
 double GetDifficulty(const CBlockIndex* blockindex)
 {
     assert(blockindex);
+    return GetDifficulty(blockindex->nBits);
+}
 
-    int nShift = (blockindex->nBits >> 24) & 0xff;
+double GetDifficulty(uint32_t nBits)
+{
+    int nShift = (nBits >> 24) & 0xff;
     double dDiff =
-        (double)0x0000ffff / (double)(blockindex->nBits & 0x00ffffff);
+        (double)0x0000ffff / (double)(nBits & 0x00ffffff);
 
     while (nShift < 29)
     {
@@ -104,11 +125,21 @@ double GetPoWMHashPS()
 
 double GetPoSKernelPS()
 {
+    // The weight only changes with the best header, so it is computed once per header
+    static Mutex cs_kernelps;
+    static uint256 hashKernelPS;
+    static double dKernelPS = 0;
+
+    LOCK(cs_kernelps);
+    CBlockIndex* pindex = pindexBestHeader;
+    if (pindex && pindex->GetBlockHash() == hashKernelPS)
+        return dKernelPS;
+    hashKernelPS = pindex ? pindex->GetBlockHash() : uint256();
+
     int nPoSInterval = 72;
     double dStakeKernelsTriedAvg = 0;
     int nStakesHandled = 0, nStakesTime = 0;
 
-    CBlockIndex* pindex = pindexBestHeader;
     CBlockIndex* pindexPrevStake = NULL;
 
     const Consensus::Params& consensusParams = Params().GetConsensus();
@@ -148,6 +179,7 @@ double GetPoSKernelPS()
     
     result *= STAKE_TIMESTAMP_MASK + 1;
 
+    dKernelPS = result;
     return result;
 }
 
@@ -358,8 +390,7 @@ static UniValue getblockcount(const JSONRPCRequest& request)
                 },
             }.ToString());
 
-    LOCK(cs_main);
-    return chainActive.Height();
+    return GetChainTipSnapshot()->nHeight;
 }
 
 static UniValue getbestblockhash(const JSONRPCRequest& request)
@@ -378,20 +409,55 @@ static UniValue getbestblockhash(const JSONRPCRequest& request)
                 },
             }.ToString());
 
-    LOCK(cs_main);
-    return chainActive.Tip()->GetBlockHash().GetHex();
+    const std::shared_ptr<const ChainTipSnapshot> tip = GetChainTipSnapshot();
+    if (tip->nHeight < 0) {
+        throw JSONRPCError(RPC_MISC_ERROR, "No blocks in the active chain");
+    }
+    return tip->hashBlock.GetHex();
 }
 
+/** Milliseconds between the wake ups of the block change waiters during initial block download */
+static const int64_t BLOCK_CHANGE_NOTIFY_INTERVAL = 100;
+
 void RPCNotifyBlockChange(bool ibd, const CBlockIndex * pindex)
 {
-    if(pindex) {
+    static int64_t nLastNotify = 0;
+    {
         std::lock_guard<std::mutex> lock(cs_blockchange);
-        latestblock.hash = pindex->GetBlockHash();
-        latestblock.height = pindex->nHeight;
+        if(pindex) {
+            latestblock.hash = pindex->GetBlockHash();
+            latestblock.height = pindex->nHeight;
+        }
+        // Waking the waiters for each block of the initial download is wasted work, they
+        // check latestblock at this interval anyway, see WaitForBlockChange
+        int64_t nNow = GetTimeMillis();
+        if (ibd && nNow - nLastNotify < BLOCK_CHANGE_NOTIFY_INTERVAL)
+            return;
+        nLastNotify = nNow;
     }
     cond_blockchange.notify_all();
 }
 
+/**
+ * Wait until pred holds, or for timeout milliseconds if not 0. Notifications are coalesced
+ * during initial block download, so latestblock is checked at least as often as they are sent.
+ */
+template <typename Predicate>
+static void WaitForBlockChange(std::unique_lock<std::mutex>& lock, int timeout, Predicate pred)
+{
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+    while (!pred()) {
+        auto wait = std::chrono::milliseconds(BLOCK_CHANGE_NOTIFY_INTERVAL);
+        if (timeout) {
+            const auto now = std::chrono::steady_clock::now();
+            if (now >= deadline)
+                return;
+            wait = std::min(wait, std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now) + std::chrono::milliseconds(1));
+        }
+        cond_blockchange.wait_for(lock, wait);
+    }
+}
+
 static UniValue waitfornewblock(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() > 1)
@@ -421,10 +487,7 @@ static UniValue waitfornewblock(const JSONRPCRequest& request)
     {
         WAIT_LOCK(cs_blockchange, lock);
         block = latestblock;
-        if(timeout)
-            cond_blockchange.wait_for(lock, std::chrono::milliseconds(timeout), [&block]{return latestblock.height != block.height || latestblock.hash != block.hash || !IsRPCRunning(); });
-        else
-            cond_blockchange.wait(lock, [&block]{return latestblock.height != block.height || latestblock.hash != block.hash || !IsRPCRunning(); });
+        WaitForBlockChange(lock, timeout, [&block]{return latestblock.height != block.height || latestblock.hash != block.hash || !IsRPCRunning(); });
         block = latestblock;
     }
     UniValue ret(UniValue::VOBJ);
@@ -465,10 +528,7 @@ static UniValue waitforblock(const JSONRPCRequest& request)
     CUpdatedBlock block;
     {
         WAIT_LOCK(cs_blockchange, lock);
-        if(timeout)
-            cond_blockchange.wait_for(lock, std::chrono::milliseconds(timeout), [&hash]{return latestblock.hash == hash || !IsRPCRunning();});
-        else
-            cond_blockchange.wait(lock, [&hash]{return latestblock.hash == hash || !IsRPCRunning(); });
+        WaitForBlockChange(lock, timeout, [&hash]{return latestblock.hash == hash || !IsRPCRunning(); });
         block = latestblock;
     }
 
@@ -511,10 +571,7 @@ static UniValue waitforblockheight(const JSONRPCRequest& request)
     CUpdatedBlock block;
     {
         WAIT_LOCK(cs_blockchange, lock);
-        if(timeout)
-            cond_blockchange.wait_for(lock, std::chrono::milliseconds(timeout), [&height]{return latestblock.height >= height || !IsRPCRunning();});
-        else
-            cond_blockchange.wait(lock, [&height]{return latestblock.height >= height || !IsRPCRunning(); });
+        WaitForBlockChange(lock, timeout, [&height]{return latestblock.height >= height || !IsRPCRunning(); });
         block = latestblock;
     }
     UniValue ret(UniValue::VOBJ);
@@ -579,6 +636,13 @@ static std::string EntryDescriptionString()
            "    \"ancestorsize\" : n,     (numeric) virtual transaction size of in-mempool ancestors (including this one)\n"
            "    \"ancestorfees\" : n,     (numeric) modified fees (see above) of in-mempool ancestors (including this one) (DEPRECATED)\n"
            "    \"wtxid\" : hash,         (string) hash of serialized transaction, including witness data\n"
+           "    \"preexec\" : {          (json object, optional) execution of the contracts when the tx entered the pool, with -mempoolpreexec\n"
+           "        \"tip\" : hash,       (string) block the contracts were executed on\n"
+           "        \"gasused\" : n,      (numeric) gas used by the contracts\n"
+           "        \"time_ms\" : n,      (numeric) execution time in milliseconds\n"
+           "        \"excepted\" : true|false, (boolean) whether a contract threw an exception\n"
+           "        \"estimated\" : true|false, (boolean) whether the result is the one of an estimategas dry run\n"
+           "    }\n"
            "    \"fees\" : {\n"
            "        \"base\" : n,         (numeric) transaction fee in " + CURRENCY_UNIT + "\n"
            "        \"modified\" : n,     (numeric) transaction fee with fee deltas used for mining priority in " + CURRENCY_UNIT + "\n"
@@ -617,6 +681,16 @@ static void entryToJSON(UniValue &info, const CTxMemPoolEntry &e) EXCLUSIVE_LOCK
     info.pushKV("ancestorsize", e.GetSizeWithAncestors());
     info.pushKV("ancestorfees", e.GetModFeesWithAncestors());
     info.pushKV("wtxid", mempool.vTxHashes[e.vTxHashesIdx].first.ToString());
+    const ContractPreExecution& pre = e.GetPreExecution();
+    if (!pre.hashTip.IsNull()) {
+        UniValue preexec(UniValue::VOBJ);
+        preexec.pushKV("tip", pre.hashTip.GetHex());
+        preexec.pushKV("gasused", pre.nGasUsed);
+        preexec.pushKV("time_ms", pre.nTime * 0.001);
+        preexec.pushKV("excepted", pre.fExcepted);
+        preexec.pushKV("estimated", pre.fEstimated);
+        info.pushKV("preexec", preexec);
+    }
     const CTransaction& tx = e.GetTx();
     std::set<std::string> setDepends;
     for (const CTxIn& txin : tx.vin)
@@ -921,6 +995,287 @@ static UniValue getblockhash(const JSONRPCRequest& request)
     return pblockindex->GetBlockHash().GetHex();
 }
 
+static UniValue getcontractprofile(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 2)
+        throw std::runtime_error(
+            RPCHelpMan{"getcontractprofile",
+                "\nReturns the validation cost of the contracts executed by connected blocks since startup or\n"
+                "the last reset, most expensive first. Requires -contractprofile.\n"
+                "Calls, gas and time are those of transactions calling the contract directly; opcode counts\n"
+                "and gas are sampled and include the contract code reached through calls from other contracts.\n",
+                {
+                    {"count", RPCArg::Type::NUM, /* default */ "20", "The number of contracts to return (0 = all)"},
+                    {"reset", RPCArg::Type::BOOL, /* default */ "false", "Clear the profile after reading it"},
+                },
+                RPCResult{
+            "[\n"
+            "  {\n"
+            "    \"address\": \"hex\",       (string) the contract address\n"
+            "    \"calls\": n,              (numeric) number of transactions calling the contract\n"
+            "    \"gasUsed\": n,            (numeric) gas used by these transactions\n"
+            "    \"time_ms\": n,            (numeric) wall time spent executing them\n"
+            "    \"opcodes\": {             (json object) sampled opcodes of the contract code\n"
+            "      \"name\": {\"count\": n, \"gas\": n}\n"
+            "      ,...\n"
+            "    }\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getcontractprofile", "10")
+            + HelpExampleRpc("getcontractprofile", "10, true")
+                },
+            }.ToString());
+
+    if (!pcontractprofiler) {
+        throw JSONRPCError(RPC_MISC_ERROR, "The contract profiler is disabled, start with -contractprofile=<n>");
+    }
+    int count = request.params[0].isNull() ? 20 : request.params[0].get_int();
+    if (count < 0) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "count must not be negative");
+    }
+    bool fReset = request.params[1].isNull() ? false : request.params[1].get_bool();
+
+    UniValue result(UniValue::VARR);
+    for (const auto& entry : pcontractprofiler->GetProfile(count)) {
+        const ContractProfile& profile = entry.second;
+        UniValue opcodes(UniValue::VOBJ);
+        for (const auto& op : profile.opcodes) {
+            UniValue opcode(UniValue::VOBJ);
+            opcode.pushKV("count", (uint64_t)op.second.nCount);
+            opcode.pushKV("gas", (uint64_t)op.second.nGas);
+            opcodes.pushKV(dev::eth::instructionInfo(op.first).name, opcode);
+        }
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("address", entry.first.hex());
+        obj.pushKV("calls", (uint64_t)profile.nCalls);
+        obj.pushKV("gasUsed", (uint64_t)profile.nGasUsed);
+        obj.pushKV("time_ms", profile.nTimeMicros * 0.001);
+        obj.pushKV("opcodes", opcodes);
+        result.push_back(obj);
+    }
+    if (fReset) {
+        pcontractprofiler->Reset();
+    }
+    return result;
+}
+
+UniValue StageTimesToJSON(const StageTimes& times)
+{
+    UniValue histogram(UniValue::VARR);
+    for (uint64_t nCount : times.histogram)
+        histogram.push_back(nCount);
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("count", times.nCount);
+    obj.pushKV("total_ms", times.nTotal * 0.001);
+    obj.pushKV("avg_ms", times.nCount ? times.nTotal * 0.001 / times.nCount : 0.0);
+    obj.pushKV("max_ms", times.nMax * 0.001);
+    obj.pushKV("histogram", histogram);
+    return obj;
+}
+
+static UniValue getvalidationstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 1)
+        throw std::runtime_error(
+            RPCHelpMan{"getvalidationstats",
+                "\nReturns the time spent in each stage of connecting blocks to the tip, since startup or the\n"
+                "last reset and over the last " + std::to_string(VALIDATION_STATS_WINDOW) + " blocks.\n"
+                "Stages nest: sanity includes hashproof, connect includes contracts, and connectblock covers\n"
+                "all stages from sanity to receipts.\n",
+                {
+                    {"reset", RPCArg::Type::BOOL, /* default */ "false", "Clear the statistics after reading them"},
+                },
+                RPCResult{
+            "{\n"
+            "  \"buckets_ms\": [ n, ... ],    (array) upper bounds of the histogram buckets, a last one\n"
+            "                                holds the longer durations\n"
+            "  \"stages\": {\n"
+            "    \"name\": {                  (json object) one of sanity, hashproof, forks, connect, contracts,\n"
+            "                                reward, verify, statecommit, index, receipts, readblock,\n"
+            "                                connectblock, flush, chainstate, postconnect, total\n"
+            "      \"count\": n,              (numeric) number of blocks timed\n"
+            "      \"total_ms\": n,           (numeric) total time\n"
+            "      \"avg_ms\": n,             (numeric) average time per block\n"
+            "      \"max_ms\": n,             (numeric) longest time\n"
+            "      \"histogram\": [ n, ... ], (array) number of blocks per bucket\n"
+            "      \"recent\": {              (json object) the same over the most recent blocks, plus\n"
+            "        ...\n"
+            "        \"p50_ms\": n,           (numeric) median time\n"
+            "        \"p90_ms\": n,           (numeric) 90th percentile\n"
+            "        \"p99_ms\": n            (numeric) 99th percentile\n"
+            "      }\n"
+            "    }\n"
+            "    ,...\n"
+            "  }\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getvalidationstats", "")
+            + HelpExampleRpc("getvalidationstats", "true")
+                },
+            }.ToString());
+
+    bool fReset = request.params[0].isNull() ? false : request.params[0].get_bool();
+
+    UniValue buckets(UniValue::VARR);
+    for (int64_t nBound : VALIDATION_STATS_BUCKETS)
+        buckets.push_back(nBound * 0.001);
+
+    UniValue stages(UniValue::VOBJ);
+    std::vector<StageStats> stats = validationStats.Get();
+    for (size_t i = 0; i < stats.size(); i++) {
+        UniValue recent = StageTimesToJSON(stats[i].recent);
+        recent.pushKV("p50_ms", stats[i].nMedian * 0.001);
+        recent.pushKV("p90_ms", stats[i].n90th * 0.001);
+        recent.pushKV("p99_ms", stats[i].n99th * 0.001);
+        UniValue stage = StageTimesToJSON(stats[i].total);
+        stage.pushKV("recent", recent);
+        stages.pushKV(ValidationStageName(static_cast<ValidationStage>(i)), stage);
+    }
+    if (fReset) {
+        validationStats.Reset();
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("buckets_ms", buckets);
+    result.pushKV("stages", stages);
+    return result;
+}
+
+/** Add a time to obj if it is set */
+static void PushTime(UniValue& obj, const std::string& name, int64_t nTime)
+{
+    if (nTime)
+        obj.pushKV(name, nTime);
+}
+
+/** Add the milliseconds between two times to obj if both are set */
+static void PushInterval(UniValue& obj, const std::string& name, int64_t nFrom, int64_t nTo)
+{
+    if (nFrom && nTo)
+        obj.pushKV(name, (nTo - nFrom) * 0.001);
+}
+
+static UniValue getblockvalidationtimes(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 2)
+        throw std::runtime_error(
+            RPCHelpMan{"getblockvalidationtimes",
+                "\nReturns when the most recent blocks were received, connected and made the tip, and when the\n"
+                "transactions received from peers were received, accepted to the mempool and confirmed.\n"
+                "The last " + std::to_string(VALIDATION_TIMES_BLOCKS) + " blocks and " + std::to_string(VALIDATION_TIMES_TXS) + " transactions are kept. Times are in microseconds\n"
+                "since the epoch and are left out for the steps not taken; receipt times are those of the\n"
+                "messages on the socket.\n",
+                {
+                    {"count", RPCArg::Type::NUM, /* default */ "10", "Number of blocks, and of transactions if no txids are given, most recent first"},
+                    {"txids", RPCArg::Type::ARR, /* default */ "the most recent transactions", "The transactions to return, those not in the history are left out",
+                        {
+                            {"txid", RPCArg::Type::STR_HEX, RPCArg::Optional::OMITTED, "A transaction hash"},
+                        },
+                    },
+                },
+                RPCResult{
+            "{\n"
+            "  \"blocks\": [\n"
+            "    {\n"
+            "      \"hash\": \"hash\",          (string) block hash\n"
+            "      \"height\": n,             (numeric) height, once connected\n"
+            "      \"peer\": n,               (numeric) peer the block came from\n"
+            "      \"header_received\": n,    (numeric) first message with the header\n"
+            "      \"block_received\": n,     (numeric) message that completed the block\n"
+            "      \"connect_start\": n,      (numeric) start of ConnectBlock\n"
+            "      \"connect_end\": n,        (numeric) end of ConnectBlock\n"
+            "      \"tip_updated\": n,        (numeric) block connected as the tip\n"
+            "      \"download_ms\": n,        (numeric) from the header to the block\n"
+            "      \"queue_ms\": n,           (numeric) from the block to the start of ConnectBlock\n"
+            "      \"connect_ms\": n,         (numeric) ConnectBlock\n"
+            "      \"tip_ms\": n,             (numeric) from the end of ConnectBlock to the tip update\n"
+            "      \"total_ms\": n            (numeric) from the header to the tip update\n"
+            "    }\n"
+            "    ,...\n"
+            "  ],\n"
+            "  \"transactions\": [\n"
+            "    {\n"
+            "      \"txid\": \"hash\",          (string) transaction hash\n"
+            "      \"peer\": n,               (numeric) peer the transaction came from\n"
+            "      \"received\": n,           (numeric) tx message\n"
+            "      \"accepted\": n,           (numeric) acceptance to the mempool\n"
+            "      \"blockhash\": \"hash\",     (string) first block connected with the transaction\n"
+            "      \"confirmed\": n,          (numeric) tip update of that block\n"
+            "      \"accept_ms\": n,          (numeric) from the receipt to the acceptance\n"
+            "      \"confirm_ms\": n          (numeric) from the receipt to the confirmation\n"
+            "    }\n"
+            "    ,...\n"
+            "  ]\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getblockvalidationtimes", "")
+            + HelpExampleCli("getblockvalidationtimes", "1 '[\"mytxid\"]'")
+            + HelpExampleRpc("getblockvalidationtimes", "1, [\"mytxid\"]")
+                },
+            }.ToString());
+
+    int nCount = request.params[0].isNull() ? 10 : request.params[0].get_int();
+    if (nCount < 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative count");
+
+    UniValue blocks(UniValue::VARR);
+    for (const BlockValidationTimes& times : validationTimes.GetBlocks(nCount)) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("hash", times.hash.GetHex());
+        if (times.nHeight >= 0)
+            obj.pushKV("height", times.nHeight);
+        if (times.nPeer >= 0)
+            obj.pushKV("peer", times.nPeer);
+        PushTime(obj, "header_received", times.nHeaderReceived);
+        PushTime(obj, "block_received", times.nBlockReceived);
+        PushTime(obj, "connect_start", times.nConnectStart);
+        PushTime(obj, "connect_end", times.nConnectEnd);
+        PushTime(obj, "tip_updated", times.nTipUpdated);
+        PushInterval(obj, "download_ms", times.nHeaderReceived, times.nBlockReceived);
+        PushInterval(obj, "queue_ms", times.nBlockReceived, times.nConnectStart);
+        PushInterval(obj, "connect_ms", times.nConnectStart, times.nConnectEnd);
+        PushInterval(obj, "tip_ms", times.nConnectEnd, times.nTipUpdated);
+        PushInterval(obj, "total_ms", times.nHeaderReceived, times.nTipUpdated);
+        blocks.push_back(obj);
+    }
+
+    std::vector<TxValidationTimes> vTxTimes;
+    if (request.params[1].isNull()) {
+        vTxTimes = validationTimes.GetTxs(nCount);
+    } else {
+        const UniValue& txids = request.params[1].get_array();
+        for (size_t i = 0; i < txids.size(); i++) {
+            TxValidationTimes times;
+            if (validationTimes.GetTx(ParseHashV(txids[i], "txid"), times))
+                vTxTimes.push_back(times);
+        }
+    }
+    UniValue txs(UniValue::VARR);
+    for (const TxValidationTimes& times : vTxTimes) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("txid", times.hash.GetHex());
+        obj.pushKV("peer", times.nPeer);
+        PushTime(obj, "received", times.nReceived);
+        PushTime(obj, "accepted", times.nAccepted);
+        if (times.nConfirmed)
+            obj.pushKV("blockhash", times.hashBlock.GetHex());
+        PushTime(obj, "confirmed", times.nConfirmed);
+        PushInterval(obj, "accept_ms", times.nReceived, times.nAccepted);
+        PushInterval(obj, "confirm_ms", times.nReceived, times.nConfirmed);
+        txs.push_back(obj);
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("blocks", blocks);
+    result.pushKV("transactions", txs);
+    return result;
+}
+
 static UniValue getaccountinfo(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() < 1)
@@ -929,12 +1284,13 @@ static UniValue getaccountinfo(const JSONRPCRequest& request)
                 "\nGet contract details including balance, storage data and code.\n",
                 {
                     {"address", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The contract address"},
+                    {"storage", RPCArg::Type::BOOL, /* default */ "true", "Include the whole storage, see liststorage for large contracts"},
                 },
                 RPCResult{
             "{\n"
             "  \"address\": \"contract address\",    (string)  address of the contract\n"
             "  \"balance\": n,                     (numeric) balance of the contract\n"
-            "  \"storage\": {...},                 (object)  storage data of the contract\n"
+            "  \"storage\": {...},                 (object)  storage data of the contract, if requested\n"
             "  \"code\": \"bytecode\"                (string)  bytecode of the contract\n"
             "}\n"
                 },
@@ -959,17 +1315,20 @@ static UniValue getaccountinfo(const JSONRPCRequest& request)
     result.pushKV("address", strAddr);
     result.pushKV("balance", CAmount(globalState->balance(addrAccount)));
     std::vector<uint8_t> code(globalState->code(addrAccount));
-    auto storage(globalState->storage(addrAccount));
 
-    UniValue storageUV(UniValue::VOBJ);
-    for (auto j: storage)
-    {
-        UniValue e(UniValue::VOBJ);
-        e.pushKV(dev::toHex(dev::h256(j.second.first)), dev::toHex(dev::h256(j.second.second)));
-        storageUV.pushKV(j.first.hex(), e);
+    if (request.params[1].isNull() || request.params[1].get_bool()) {
+        auto storage(globalState->storage(addrAccount));
+
+        UniValue storageUV(UniValue::VOBJ);
+        for (auto j: storage)
+        {
+            UniValue e(UniValue::VOBJ);
+            e.pushKV(dev::toHex(dev::h256(j.second.first)), dev::toHex(dev::h256(j.second.second)));
+            storageUV.pushKV(j.first.hex(), e);
+        }
+
+        result.pushKV("storage", storageUV);
     }
-        
-    result.pushKV("storage", storageUV);
 
     result.pushKV("code", HexStr(code.begin(), code.end()));
 
@@ -1030,7 +1389,34 @@ static UniValue getcontractcode(const JSONRPCRequest& request)
     return HexStr(code.begin(), code.end());
 }
 
-static UniValue getstorage(const JSONRPCRequest& request)
+/** The contract view of a block, an error if -prunestate deleted its state */
+static std::unique_ptr<ContractCallView> ContractView(CBlockIndex* pindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    if (!IsContractStateAvailable(pindex))
+        throw JSONRPCError(RPC_MISC_ERROR, strprintf("The contract state of block %d was pruned (-prunestate)", pindex->nHeight));
+    return std::unique_ptr<ContractCallView>(new ContractCallView(pindex));
+}
+
+/** The contract view of the block at the height in param, of the tip if it is null or -1 */
+static std::unique_ptr<ContractCallView> ContractViewAtHeight(const UniValue& param)
+{
+    LOCK(cs_main);
+    int blockNum = chainActive.Height();
+    if (!param.isNull())
+    {
+        if (!param.isNum())
+            throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
+        blockNum = param.get_int();
+        if((blockNum < 0 && blockNum != -1) || blockNum > chainActive.Height())
+            throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
+
+        if(blockNum == -1)
+            blockNum = chainActive.Height();
+    }
+    return ContractView(chainActive[blockNum]);
+}
+
+UniValue getstorage(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() < 1)
         throw std::runtime_error(
@@ -1050,31 +1436,14 @@ static UniValue getstorage(const JSONRPCRequest& request)
                 },
             }.ToString());
 
-    LOCK(cs_main);
-
     std::string strAddr = request.params[0].get_str();
     if(strAddr.size() != 40 || !CheckHex(strAddr))
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Incorrect address"); 
 
-    TemporaryState ts(globalState);
-    if (request.params.size() > 1)
-    {
-        if (request.params[1].isNum())
-        {
-            auto blockNum = request.params[1].get_int();
-            if((blockNum < 0 && blockNum != -1) || blockNum > chainActive.Height())
-                throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
-
-            if(blockNum != -1)
-                ts.SetRoot(uintToh256(chainActive[blockNum]->hashStateRoot), uintToh256(chainActive[blockNum]->hashUTXORoot));
-                
-        } else {
-            throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
-        }
-    }
+    std::unique_ptr<ContractCallView> view = ContractViewAtHeight(request.params[1]);
 
     dev::Address addrAccount(strAddr);
-    if(!globalState->addressInUse(addrAccount))
+    if(!view->addressInUse(addrAccount))
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Address does not exist");
     
     UniValue result(UniValue::VOBJ);
@@ -1084,7 +1453,7 @@ static UniValue getstorage(const JSONRPCRequest& request)
     if (onlyIndex)
         index = request.params[2].get_int();
 
-    auto storage(globalState->storage(addrAccount));
+    auto storage(view->storage(addrAccount));
 
     if (onlyIndex)
     {
@@ -1108,81 +1477,394 @@ static UniValue getstorage(const JSONRPCRequest& request)
     return result;
 }
 
-static UniValue getblockheader(const JSONRPCRequest& request)
+/** Maximum number of storage entries returned by a liststorage call */
+static const int MAX_LIST_STORAGE_ENTRIES = 10000;
+
+static dev::Address ParseContractAddress(const UniValue& param)
 {
-    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+    std::string strAddr = param.get_str();
+    if(strAddr.size() != 40 || !CheckHex(strAddr))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Incorrect address");
+    return dev::Address(strAddr);
+}
+
+static dev::h256 ParseStorageHash(const UniValue& param, const std::string& strName)
+{
+    std::string strHex = param.get_str();
+    if(strHex.size() != 64 || !IsHex(strHex))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strName + " must be of length 64 (not " + std::to_string(strHex.size()) + ", for '" + strHex + "')");
+    return dev::h256(strHex);
+}
+
+static UniValue TrieProofToUniv(const std::vector<std::string>& proof)
+{
+    UniValue result(UniValue::VARR);
+    for (const std::string& node : proof)
+        result.push_back(HexStr(node.begin(), node.end()));
+    return result;
+}
+
+static void ThrowStateMissing(const ContractCallView& view)
+{
+    throw JSONRPCError(RPC_MISC_ERROR, strprintf("The contract state of block %d is not available", view.blockIndex()->nHeight));
+}
+
+static UniValue liststorage(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 4)
         throw std::runtime_error(
-            RPCHelpMan{"getblockheader",
-                "\nIf verbose is false, returns a string that is serialized, hex-encoded data for blockheader 'hash'.\n"
-                "If verbose is true, returns an Object with information about blockheader <hash>.\n",
+            RPCHelpMan{"liststorage",
+                "\nList the storage of a contract a page at a time, in the order of the storage trie.\n"
+                "Only the trie nodes leading to the page are read, so large contracts can be walked through\n"
+                "by passing the \"next\" key of each result as the start of the next call.\n",
                 {
-                    {"blockhash", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The block hash"},
-                    {"verbose", RPCArg::Type::BOOL, /* default */ "true", "true for a json object, false for the hex-encoded data"},
+                    {"address", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The contract address"},
+                    {"blockNum", RPCArg::Type::NUM, /* default */ "latest", "Number of block to get state from, -1 for the latest"},
+                    {"start", RPCArg::Type::STR_HEX, /* default */ "0000...0000", "Trie key (the hash of the slot) to start from"},
+                    {"count", RPCArg::Type::NUM, /* default */ "100", "Maximum number of entries, at most 10000"},
                 },
-                {
-                    RPCResult{"for verbose = true",
+                RPCResult{
             "{\n"
-            "  \"hash\" : \"hash\",     (string) the block hash (same as provided)\n"
-            "  \"confirmations\" : n,   (numeric) The number of confirmations, or -1 if the block is not on the main chain\n"
-            "  \"height\" : n,          (numeric) The block height or index\n"
-            "  \"version\" : n,         (numeric) The block version\n"
-            "  \"versionHex\" : \"00000000\", (string) The block version formatted in hexadecimal\n"
-            "  \"merkleroot\" : \"xxxx\", (string) The merkle root\n"
-            "  \"time\" : ttt,          (numeric) The block time in seconds since epoch (Jan 1 1970 GMT)\n"
-            "  \"mediantime\" : ttt,    (numeric) The median block time in seconds since epoch (Jan 1 1970 GMT)\n"
-            "  \"nonce\" : n,           (numeric) The nonce\n"
-            "  \"bits\" : \"1d00ffff\", (string) The bits\n"
-            "  \"difficulty\" : x.xxx,  (numeric) The difficulty\n"
-            "  \"chainwork\" : \"0000...1f3\"     (string) Expected number of hashes required to produce the current chain (in hex)\n"
-            "  \"nTx\" : n,             (numeric) The number of transactions in the block.\n"
-            "  \"previousblockhash\" : \"hash\",  (string) The hash of the previous block\n"
-            "  \"nextblockhash\" : \"hash\",      (string) The hash of the next block\n"
+            "  \"address\": \"contract address\",   (string)  address of the contract\n"
+            "  \"height\": n,                     (numeric) height of the block\n"
+            "  \"storageRoot\": \"hash\",           (string)  root of the storage trie of the contract\n"
+            "  \"entries\": [                      (array)   storage entries in trie key order\n"
+            "    {\n"
+            "      \"key\": \"hash\",               (string)  trie key, the hash of the slot\n"
+            "      \"slot\": \"hex\",               (string)  the slot, if it is known\n"
+            "      \"value\": \"hex\"               (string)  value of the slot\n"
+            "    }, ...\n"
+            "  ],\n"
+            "  \"next\": \"hash\"                   (string)  trie key to continue from, if there are more entries\n"
             "}\n"
-                    },
-                    RPCResult{"for verbose=false",
-            "\"data\"             (string) A string that is serialized, hex-encoded data for block 'hash'.\n"
-                    },
                 },
                 RPCExamples{
-                    HelpExampleCli("getblockheader", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\"")
-            + HelpExampleRpc("getblockheader", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\"")
+                    HelpExampleCli("liststorage", "eb23c0b3e6042821da281a2e2364feb22dd543e3")
+            + HelpExampleCli("liststorage", "eb23c0b3e6042821da281a2e2364feb22dd543e3 -1 \"8b5f0d3c8fd1d03f5e7b3f34d1a5c1e2a1a9e31f10e44d7c6c7e5c9a1f0e4d22\" 1000")
+            + HelpExampleRpc("liststorage", "\"eb23c0b3e6042821da281a2e2364feb22dd543e3\", -1, \"0000000000000000000000000000000000000000000000000000000000000000\", 1000")
                 },
             }.ToString());
 
-    uint256 hash(ParseHashV(request.params[0], "hash"));
+    dev::Address addrAccount = ParseContractAddress(request.params[0]);
+    std::unique_ptr<ContractCallView> view = ContractViewAtHeight(request.params[1]);
+    dev::h256 start;
+    if (!request.params[2].isNull())
+        start = ParseStorageHash(request.params[2], "start");
+    int count = 100;
+    if (!request.params[3].isNull()) {
+        count = request.params[3].get_int();
+        if (count < 1 || count > MAX_LIST_STORAGE_ENTRIES)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("count must be between 1 and %d", MAX_LIST_STORAGE_ENTRIES));
+    }
 
-    bool fVerbose = true;
-    if (!request.params[1].isNull())
-        fVerbose = request.params[1].get_bool();
+    if(!view->addressInUse(addrAccount))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Address does not exist");
 
-    const CBlockIndex* pblockindex;
-    const CBlockIndex* tip;
-    {
-        LOCK(cs_main);
-        pblockindex = LookupBlockIndex(hash);
-        tip = chainActive.Tip();
-    }
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("address", addrAccount.hex());
+    result.pushKV("height", view->blockIndex()->nHeight);
+    view->readState([&](const QtumState& state) {
+        dev::h256 storageRoot = state.storageRoot(addrAccount);
+        StateNodeLookup lookup = [&state](const dev::h256& hash) { return state.db().lookup(hash); };
+        std::vector<std::pair<dev::h256, std::string>> entries;
+        boost::optional<dev::h256> next;
+        if (!ListStateTrie(lookup, storageRoot, start, count, entries, next))
+            ThrowStateMissing(*view);
+
+        UniValue entriesUV(UniValue::VARR);
+        for (const auto& entry : entries) {
+            UniValue e(UniValue::VOBJ);
+            e.pushKV("key", entry.first.hex());
+            // The secure trie keeps the slots its keys are the hashes of
+            dev::bytes slot = state.db().lookupAux(entry.first);
+            if (slot.size() == dev::h256::size)
+                e.pushKV("slot", dev::toHex(slot));
+            e.pushKV("value", dev::toHex(dev::h256(dev::RLP(entry.second).toInt<dev::u256>())));
+            entriesUV.push_back(e);
+        }
+        result.pushKV("storageRoot", storageRoot.hex());
+        result.pushKV("entries", entriesUV);
+        if (next)
+            result.pushKV("next", next->hex());
+    });
+    return result;
+}
 
-    if (!pblockindex) {
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
-    }
+static UniValue getstorageproof(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 2 || request.params.size() > 3)
+        throw std::runtime_error(
+            RPCHelpMan{"getstorageproof",
+                "\nGet the value of a storage slot of a contract with Merkle-Patricia proofs against the hashStateRoot of a block.\n"
+                "The account proof is the path of the hash of the address in the state trie, and the storage proof\n"
+                "the path of the hash of the slot in the storage trie of the account. Each proof is the list of the\n"
+                "trie nodes from the root, whose keccak-256 hashes are referenced by the node before them; a proof of\n"
+                "a key that is not in a trie ends at the node its path leaves the trie from.\n",
+                {
+                    {"address", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The contract address"},
+                    {"slot", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The storage slot, 32 bytes"},
+                    {"blockNum", RPCArg::Type::NUM, /* default */ "latest", "Number of block to get state from, -1 for the latest"},
+                },
+                RPCResult{
+            "{\n"
+            "  \"height\": n,                     (numeric) height of the block\n"
+            "  \"blockhash\": \"hash\",             (string)  hash of the block\n"
+            "  \"stateRoot\": \"hash\",             (string)  root of the state trie, the hashStateRoot of the block in trie byte order\n"
+            "  \"address\": \"contract address\",   (string)  address of the contract\n"
+            "  \"accountProof\": [\"hex\", ...],    (array)   trie nodes from the state root to the account\n"
+            "  \"nonce\": n,                      (numeric) nonce of the account, if it exists\n"
+            "  \"balance\": n,                    (numeric) balance of the account, if it exists\n"
+            "  \"storageRoot\": \"hash\",           (string)  root of the storage trie of the account, if it exists\n"
+            "  \"codeHash\": \"hash\",              (string)  hash of the code of the account, if it exists\n"
+            "  \"slot\": \"hex\",                   (string)  the slot\n"
+            "  \"key\": \"hash\",                   (string)  trie key of the slot, its hash\n"
+            "  \"value\": \"hex\",                  (string)  value of the slot, zero if it is not set\n"
+            "  \"storageProof\": [\"hex\", ...]     (array)   trie nodes from the storage root to the slot\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getstorageproof", "eb23c0b3e6042821da281a2e2364feb22dd543e3 0000000000000000000000000000000000000000000000000000000000000000")
+            + HelpExampleRpc("getstorageproof", "\"eb23c0b3e6042821da281a2e2364feb22dd543e3\", \"0000000000000000000000000000000000000000000000000000000000000000\"")
+                },
+            }.ToString());
 
-    if (!fVerbose)
-    {
-        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-        ssBlock << pblockindex->GetBlockHeader();
-        std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
-        return strHex;
-    }
+    dev::Address addrAccount = ParseContractAddress(request.params[0]);
+    dev::h256 slot = ParseStorageHash(request.params[1], "slot");
+    std::unique_ptr<ContractCallView> view = ContractViewAtHeight(request.params[2]);
+    const CBlockIndex* pindex = view->blockIndex();
 
-    return blockheaderToJSON(tip, pblockindex);
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("height", pindex->nHeight);
+    result.pushKV("blockhash", pindex->GetBlockHash().GetHex());
+    result.pushKV("stateRoot", uintToh256(pindex->hashStateRoot).hex());
+    result.pushKV("address", addrAccount.hex());
+    view->readState([&](const QtumState& state) {
+        StateNodeLookup lookup = [&state](const dev::h256& hash) { return state.db().lookup(hash); };
+
+        std::string account;
+        std::vector<std::string> accountProof;
+        StateTrieLookup found = FollowStateTrie(lookup, uintToh256(pindex->hashStateRoot), dev::sha3(addrAccount), account, &accountProof);
+        if (found == StateTrieLookup::MISSING)
+            ThrowStateMissing(*view);
+        result.pushKV("accountProof", TrieProofToUniv(accountProof));
+
+        // Accounts are RLP lists of [nonce, balance, storageRoot, codeHash]
+        dev::h256 storageRoot = dev::EmptyTrie;
+        if (found == StateTrieLookup::FOUND) {
+            dev::RLP rlp(account);
+            if (rlp.itemCount() < 4)
+                throw JSONRPCError(RPC_MISC_ERROR, "Unexpected account encoding");
+            storageRoot = rlp[2].toHash<dev::h256>();
+            result.pushKV("nonce", rlp[0].toInt<uint64_t>());
+            result.pushKV("balance", CAmount(rlp[1].toInt<dev::u256>()));
+            result.pushKV("storageRoot", storageRoot.hex());
+            result.pushKV("codeHash", rlp[3].toHash<dev::h256>().hex());
+        }
+
+        const dev::h256 key = dev::sha3(slot);
+        std::string value;
+        std::vector<std::string> storageProof;
+        found = FollowStateTrie(lookup, storageRoot, key, value, &storageProof);
+        if (found == StateTrieLookup::MISSING)
+            ThrowStateMissing(*view);
+        result.pushKV("slot", slot.hex());
+        result.pushKV("key", key.hex());
+        result.pushKV("value", dev::toHex(dev::h256(found == StateTrieLookup::FOUND ? dev::RLP(value).toInt<dev::u256>() : dev::u256(0))));
+        result.pushKV("storageProof", TrieProofToUniv(storageProof));
+    });
+    return result;
 }
 
-static CBlock GetBlockChecked(const CBlockIndex* pblockindex)
+static UniValue StateDiffEntriesToUniv(const std::vector<StateDiffEntry>& entries)
 {
-    CBlock block;
-    if (IsBlockPruned(pblockindex)) {
-        throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
+    UniValue result(UniValue::VARR);
+    for (const StateDiffEntry& entry : entries) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("key", uintToh256(entry.key).hex());
+        obj.pushKV("value", HexStr(entry.value));
+        result.push_back(obj);
+    }
+    return result;
+}
+
+static UniValue getstatediff(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw std::runtime_error(
+            RPCHelpMan{"getstatediff",
+                "\nGet the changes a block made to the contract state, which applied to the state and UTXO tries of its\n"
+                "parent give the tries under its hashStateRoot and hashUTXORoot. The keys are the trie keys, the\n"
+                "keccak-256 hashes of the addresses and storage slots, and the values their RLP encoding in the trie.\n"
+                "The storage changes of an account are against the storage trie the account had before the block.\n"
+                "With -statediffindex the diff is read from the index, otherwise it is computed from the state of the\n"
+                "block and its parent, which -prunestate deletes for the blocks far enough below the tip.\n",
+                {
+                    {"blockhash", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The block hash"},
+                    {"verbose", RPCArg::Type::BOOL, /* default */ "true", "true for a json object, false for the hex encoded data"},
+                },
+                {
+                    RPCResult{"for verbose = false",
+            "\"data\"                           (string) serialized, hex-encoded state diff\n"
+                    },
+                    RPCResult{"for verbose = true",
+            "{\n"
+            "  \"hash\": \"hash\",                  (string)  hash of the block\n"
+            "  \"height\": n,                     (numeric) height of the block\n"
+            "  \"prevStateRoot\": \"hash\",         (string)  state root of the parent, in trie byte order\n"
+            "  \"prevUTXORoot\": \"hash\",          (string)  UTXO root of the parent, in trie byte order\n"
+            "  \"stateRoot\": \"hash\",             (string)  state root of the block, in trie byte order\n"
+            "  \"utxoRoot\": \"hash\",              (string)  UTXO root of the block, in trie byte order\n"
+            "  \"accounts\": [                    (array)   accounts that changed\n"
+            "    {\n"
+            "      \"key\": \"hash\",               (string)  hash of the address\n"
+            "      \"account\": \"hex\",            (string)  new account, RLP of nonce, balance, storageRoot and codeHash, empty if removed\n"
+            "      \"storage\": [                 (array)   storage slots that changed\n"
+            "        {\n"
+            "          \"key\": \"hash\",           (string)  hash of the slot\n"
+            "          \"value\": \"hex\"           (string)  new value, empty if cleared\n"
+            "        }, ...\n"
+            "      ]\n"
+            "    }, ...\n"
+            "  ],\n"
+            "  \"code\": [\"hex\", ...],            (array)   code the new accounts refer to\n"
+            "  \"vins\": [                        (array)   UTXO trie entries that changed\n"
+            "    {\n"
+            "      \"key\": \"hash\",               (string)  hash of the contract address\n"
+            "      \"value\": \"hex\"               (string)  new vin, empty if removed\n"
+            "    }, ...\n"
+            "  ]\n"
+            "}\n"
+                    },
+                },
+                RPCExamples{
+                    HelpExampleCli("getstatediff", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\"")
+            + HelpExampleRpc("getstatediff", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\"")
+                },
+            }.ToString());
+
+    uint256 hash(ParseHashV(request.params[0], "blockhash"));
+    bool fVerbose = request.params[1].isNull() || request.params[1].get_bool();
+
+    const CBlockIndex* pindex;
+    {
+        LOCK(cs_main);
+        pindex = LookupBlockIndex(hash);
+        if (!pindex)
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        if (!pindex->IsValid(BLOCK_VALID_SCRIPTS))
+            throw JSONRPCError(RPC_MISC_ERROR, "Block not connected");
+    }
+
+    BlockStateDiff diff;
+    bool fFound = g_statediffindex && g_statediffindex->BlockUntilSyncedToCurrentChain() && g_statediffindex->LookupDiff(pindex, diff);
+    if (!fFound && !ComputeBlockStateDiff(pindex, diff))
+        throw JSONRPCError(RPC_MISC_ERROR, "The contract state of the block is not available (pruned with -prunestate)");
+
+    if (!fVerbose) {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << diff;
+        return HexStr(ss.begin(), ss.end());
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("hash", pindex->GetBlockHash().GetHex());
+    result.pushKV("height", pindex->nHeight);
+    result.pushKV("prevStateRoot", uintToh256(diff.hashPrevStateRoot).hex());
+    result.pushKV("prevUTXORoot", uintToh256(diff.hashPrevUTXORoot).hex());
+    result.pushKV("stateRoot", uintToh256(diff.hashStateRoot).hex());
+    result.pushKV("utxoRoot", uintToh256(diff.hashUTXORoot).hex());
+    UniValue accounts(UniValue::VARR);
+    for (const AccountStateDiff& account : diff.accounts) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("key", uintToh256(account.key).hex());
+        obj.pushKV("account", HexStr(account.account));
+        obj.pushKV("storage", StateDiffEntriesToUniv(account.storage));
+        accounts.push_back(obj);
+    }
+    result.pushKV("accounts", accounts);
+    UniValue code(UniValue::VARR);
+    for (const std::vector<unsigned char>& bytecode : diff.code)
+        code.push_back(HexStr(bytecode));
+    result.pushKV("code", code);
+    result.pushKV("vins", StateDiffEntriesToUniv(diff.vins));
+    return result;
+}
+
+static UniValue getblockheader(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw std::runtime_error(
+            RPCHelpMan{"getblockheader",
+                "\nIf verbose is false, returns a string that is serialized, hex-encoded data for blockheader 'hash'.\n"
+                "If verbose is true, returns an Object with information about blockheader <hash>.\n",
+                {
+                    {"blockhash", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The block hash"},
+                    {"verbose", RPCArg::Type::BOOL, /* default */ "true", "true for a json object, false for the hex-encoded data"},
+                },
+                {
+                    RPCResult{"for verbose = true",
+            "{\n"
+            "  \"hash\" : \"hash\",     (string) the block hash (same as provided)\n"
+            "  \"confirmations\" : n,   (numeric) The number of confirmations, or -1 if the block is not on the main chain\n"
+            "  \"height\" : n,          (numeric) The block height or index\n"
+            "  \"version\" : n,         (numeric) The block version\n"
+            "  \"versionHex\" : \"00000000\", (string) The block version formatted in hexadecimal\n"
+            "  \"merkleroot\" : \"xxxx\", (string) The merkle root\n"
+            "  \"time\" : ttt,          (numeric) The block time in seconds since epoch (Jan 1 1970 GMT)\n"
+            "  \"mediantime\" : ttt,    (numeric) The median block time in seconds since epoch (Jan 1 1970 GMT)\n"
+            "  \"nonce\" : n,           (numeric) The nonce\n"
+            "  \"bits\" : \"1d00ffff\", (string) The bits\n"
+            "  \"difficulty\" : x.xxx,  (numeric) The difficulty\n"
+            "  \"chainwork\" : \"0000...1f3\"     (string) Expected number of hashes required to produce the current chain (in hex)\n"
+            "  \"nTx\" : n,             (numeric) The number of transactions in the block.\n"
+            "  \"previousblockhash\" : \"hash\",  (string) The hash of the previous block\n"
+            "  \"nextblockhash\" : \"hash\",      (string) The hash of the next block\n"
+            "}\n"
+                    },
+                    RPCResult{"for verbose=false",
+            "\"data\"             (string) A string that is serialized, hex-encoded data for block 'hash'.\n"
+                    },
+                },
+                RPCExamples{
+                    HelpExampleCli("getblockheader", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\"")
+            + HelpExampleRpc("getblockheader", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\"")
+                },
+            }.ToString());
+
+    uint256 hash(ParseHashV(request.params[0], "hash"));
+
+    bool fVerbose = true;
+    if (!request.params[1].isNull())
+        fVerbose = request.params[1].get_bool();
+
+    const CBlockIndex* pblockindex;
+    const CBlockIndex* tip;
+    {
+        LOCK(cs_main);
+        pblockindex = LookupBlockIndex(hash);
+        tip = chainActive.Tip();
+    }
+
+    if (!pblockindex) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+    }
+
+    if (!fVerbose)
+    {
+        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+        ssBlock << pblockindex->GetBlockHeader();
+        std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
+        return strHex;
+    }
+
+    return blockheaderToJSON(tip, pblockindex);
+}
+
+static CBlock GetBlockChecked(const CBlockIndex* pblockindex)
+{
+    CBlock block;
+    if (IsBlockPruned(pblockindex)) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
     }
 
     if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus())) {
@@ -1334,8 +2016,6 @@ UniValue callcontract(const JSONRPCRequest& request)
             }
                 .ToString());
 
-    LOCK(cs_main);
-    
     std::string strAddr = request.params[0].get_str();
     std::string data = request.params[1].get_str();
 
@@ -1361,28 +2041,31 @@ UniValue callcontract(const JSONRPCRequest& request)
         gasLimit = request.params[3].get_int64();
     }
 
-    TemporaryState ts(globalState);
-    int blockNum;
-    if (request.params.size() >= 5) {
-        if (request.params[4].isNum()) {
-            blockNum = request.params[4].get_int();
-            if (blockNum < 0 || blockNum > chainActive.Height())
+    // Only pin the state under cs_main; the call itself runs on a private fork
+    std::unique_ptr<ContractCallView> view;
+    {
+        LOCK(cs_main);
+        int blockNum = chainActive.Height();
+        if (request.params.size() >= 5) {
+            if (request.params[4].isNum()) {
+                blockNum = request.params[4].get_int();
+                if (blockNum < 0 || blockNum > chainActive.Height())
+                    throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
+            } else {
                 throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
-            ts.SetRoot(uintToh256(chainActive[blockNum]->hashStateRoot), uintToh256(chainActive[blockNum]->hashUTXORoot));
-        } else {
-            throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
+            }
         }
-    } else {
-        blockNum = latestblock.height;
+        view = ContractView(chainActive[blockNum]);
     }
 
     dev::Address addrAccount(strAddr);
-    if (!globalState->addressInUse(addrAccount))
+    if (!view->addressInUse(addrAccount))
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Address does not exist");
 
-    std::vector<ResultExecute> execResults = CallContract(addrAccount, ParseHex(data), blockNum, senderAddress, gasLimit);
+    std::vector<ResultExecute> execResults = view->call(addrAccount, ParseHex(data), senderAddress, gasLimit);
 
     if(fRecordLogOpcodes){
+        LOCK(cs_main);
         writeVMlog(execResults);
     }
 
@@ -1394,6 +2077,216 @@ UniValue callcontract(const JSONRPCRequest& request)
     return result;
 }
 
+UniValue callcontractbatch(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw std::runtime_error(
+            RPCHelpMan{
+                "callcontractbatch",
+                "\nCall several contract methods offline against the same block state.\n",
+                {
+                    {"calls", RPCArg::Type::ARR, RPCArg::Optional::NO, "The calls to execute, in order",
+                        {
+                            {"", RPCArg::Type::OBJ, RPCArg::Optional::OMITTED, "",
+                                {
+                                    {"address", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The contract address"},
+                                    {"data", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The data hex string"},
+                                    {"senderAddress", RPCArg::Type::STR, RPCArg::Optional::OMITTED, "The sender address string"},
+                                    {"gasLimit", RPCArg::Type::NUM, RPCArg::Optional::OMITTED, "The gas limit for executing the contract."},
+                                },
+                            },
+                        },
+                    },
+                    {"blockNum", RPCArg::Type::NUM, /* default */ "latest", "Number of block to get state from."},
+                },
+                RPCResult{
+                    "[                                          (array)  one entry per call, in order\n"
+                    "  {\n"
+                    "    \"address\": \"contract address\",           (string)  address of the contract\n"
+                    "    \"executionResult\": {...},                (object)  method execution result, as in callcontract\n"
+                    "    \"transactionReceipt\": {...}              (object)  transaction receipt, as in callcontract\n"
+                    "  }\n"
+                    "  ,...\n"
+                    "]\n"},
+                RPCExamples{
+                    HelpExampleCli("callcontractbatch", "\"[{\\\"address\\\":\\\"eb23c0b3e6042821da281a2e2364feb22dd543e3\\\",\\\"data\\\":\\\"06fdde03\\\"}]\"")
+                    + HelpExampleRpc("callcontractbatch", "[{\"address\":\"eb23c0b3e6042821da281a2e2364feb22dd543e3\",\"data\":\"06fdde03\"}]")},
+            }
+                .ToString());
+
+    struct ContractCall {
+        std::string strAddr;
+        dev::Address address;
+        std::vector<unsigned char> data;
+        dev::Address sender;
+        uint64_t gasLimit = 0;
+    };
+
+    const UniValue& calls = request.params[0].get_array();
+    std::vector<ContractCall> vCalls;
+    vCalls.reserve(calls.size());
+    for (size_t i = 0; i < calls.size(); i++) {
+        const UniValue& o = calls[i].get_obj();
+        RPCTypeCheckObj(o,
+            {
+                {"address", UniValueType(UniValue::VSTR)},
+                {"data", UniValueType(UniValue::VSTR)},
+                {"senderAddress", UniValueType(UniValue::VSTR)},
+                {"gasLimit", UniValueType(UniValue::VNUM)},
+            }, true, true);
+
+        ContractCall call;
+        call.strAddr = find_value(o, "address").get_str();
+        if(call.strAddr.size() != 40 || !CheckHex(call.strAddr))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, strprintf("Incorrect address in call %u", i));
+        call.address = dev::Address(call.strAddr);
+
+        std::string data = find_value(o, "data").get_str();
+        if(data.size() % 2 != 0 || !CheckHex(data))
+            throw JSONRPCError(RPC_TYPE_ERROR, strprintf("Invalid data (data not hex) in call %u", i));
+        call.data = ParseHex(data);
+
+        const UniValue& sender = find_value(o, "senderAddress");
+        if (!sender.isNull()) {
+            CTxDestination qtumSenderAddress = DecodeDestination(sender.get_str());
+            if (IsValidDestination(qtumSenderAddress)) {
+                const CKeyID *keyid = boost::get<CKeyID>(&qtumSenderAddress);
+                call.sender = dev::Address(HexStr(valtype(keyid->begin(),keyid->end())));
+            } else {
+                call.sender = dev::Address(sender.get_str());
+            }
+        }
+
+        const UniValue& gasLimit = find_value(o, "gasLimit");
+        if (!gasLimit.isNull())
+            call.gasLimit = gasLimit.get_int64();
+
+        vCalls.push_back(std::move(call));
+    }
+
+    // One pinned state for the whole batch
+    std::unique_ptr<ContractCallView> view;
+    {
+        LOCK(cs_main);
+        int blockNum = chainActive.Height();
+        if (!request.params[1].isNull()) {
+            if (request.params[1].isNum()) {
+                blockNum = request.params[1].get_int();
+                if (blockNum < 0 || blockNum > chainActive.Height())
+                    throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
+            } else {
+                throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
+            }
+        }
+        view = ContractView(chainActive[blockNum]);
+    }
+
+    UniValue results(UniValue::VARR);
+    for (size_t i = 0; i < vCalls.size(); i++) {
+        const ContractCall& call = vCalls[i];
+        if (!view->addressInUse(call.address))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, strprintf("Address does not exist in call %u", i));
+
+        std::vector<ResultExecute> execResults = view->call(call.address, call.data, call.sender, call.gasLimit);
+
+        if(fRecordLogOpcodes){
+            LOCK(cs_main);
+            writeVMlog(execResults);
+        }
+
+        UniValue result(UniValue::VOBJ);
+        result.pushKV("address", call.strAddr);
+        result.pushKV("executionResult", executionResultToJSON(execResults[0].execRes));
+        result.pushKV("transactionReceipt", transactionReceiptToJSON(execResults[0].txRec));
+        results.push_back(result);
+    }
+
+    return results;
+}
+
+UniValue estimategas(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 2 || request.params.size() > 4)
+        throw std::runtime_error(
+            RPCHelpMan{
+                "estimategas",
+                "\nExecute a contract call or creation on the state of the tip to get the gas it uses.\n"
+                "The result is kept while the state roots of the tip are unchanged, so the same estimate is answered\n"
+                "without executing again, and a transaction doing the same call that enters the mempool with enough gas\n"
+                "is not executed again for -mempoolpreexec.\n",
+                {
+                    {"address", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The contract address, or \"\" for a creation"},
+                    {"data", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The data hex string, or the bytecode of a creation"},
+                    {"senderAddress", RPCArg::Type::STR, RPCArg::Optional::OMITTED_NAMED_ARG, "The sender address string"},
+                    {"amount", RPCArg::Type::AMOUNT, /* default */ "0", "The amount in " + CURRENCY_UNIT + " sent with the call"},
+                },
+                RPCResult{
+                    "{\n"
+                    "  \"gasUsed\": n,                  (numeric) gas used, the gas limit the transaction needs\n"
+                    "  \"excepted\": \"exception\",       (string)  thrown exception\n"
+                    "  \"exceptedMessage\": \"message\",  (string)  exception message\n"
+                    "  \"output\": \"data\",              (string)  returned data\n"
+                    "  \"newAddress\": \"address\",       (string)  address the contract has in the dry run, for a creation\n"
+                    "  \"stateRoot\": \"hash\",           (string)  state root the execution ran on\n"
+                    "  \"utxoRoot\": \"hash\",            (string)  UTXO root the execution ran on\n"
+                    "  \"cached\": true|false          (boolean) whether the result was kept from an earlier estimate\n"
+                    "}\n"},
+                RPCExamples{
+                    HelpExampleCli("estimategas", "eb23c0b3e6042821da281a2e2364feb22dd543e3 06fdde03") + HelpExampleRpc("estimategas", "eb23c0b3e6042821da281a2e2364feb22dd543e3 06fdde03")},
+            }
+                .ToString());
+
+    std::string strAddr = request.params[0].get_str();
+    std::string data = request.params[1].get_str();
+
+    if(data.size() % 2 != 0 || !CheckHex(data))
+        throw JSONRPCError(RPC_TYPE_ERROR, "Invalid data (data not hex)");
+
+    dev::Address addrContract;
+    if (!strAddr.empty()) {
+        if(strAddr.size() != 40 || !CheckHex(strAddr))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Incorrect address");
+        addrContract = dev::Address(strAddr);
+    }
+
+    dev::Address senderAddress;
+    if(request.params.size() >= 3){
+        CTxDestination qtumSenderAddress = DecodeDestination(request.params[2].get_str());
+        if (IsValidDestination(qtumSenderAddress)) {
+            const CKeyID *keyid = boost::get<CKeyID>(&qtumSenderAddress);
+            if (!keyid)
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid sender address");
+            senderAddress = dev::Address(HexStr(valtype(keyid->begin(),keyid->end())));
+        }else{
+            senderAddress = dev::Address(request.params[2].get_str());
+        }
+    }
+
+    CAmount nValue = 0;
+    if (request.params.size() >= 4) {
+        nValue = AmountFromValue(request.params[3]);
+        if (nValue < 0)
+            throw JSONRPCError(RPC_TYPE_ERROR, "Amount out of range");
+    }
+
+    bool fCached = false;
+    ContractGasEstimate estimate = EstimateContractGas(senderAddress, addrContract, ParseHex(data), nValue, &fCached);
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("gasUsed", estimate.nGasUsed);
+    std::stringstream ss;
+    ss << estimate.excepted;
+    result.pushKV("excepted", ss.str());
+    result.pushKV("exceptedMessage", exceptedMessage(estimate.excepted, estimate.output));
+    result.pushKV("output", HexStr(estimate.output));
+    if (addrContract == dev::Address())
+        result.pushKV("newAddress", estimate.newAddress.hex());
+    result.pushKV("stateRoot", estimate.hashStateRoot.GetHex());
+    result.pushKV("utxoRoot", estimate.hashUTXORoot.GetHex());
+    result.pushKV("cached", fCached);
+    return result;
+}
+
 void assignJSON(UniValue& entry, const TransactionReceiptInfo& resExec) {
     entry.pushKV("blockHash", resExec.blockHash.GetHex());
     entry.pushKV("blockNumber", uint64_t(resExec.blockNumber));
@@ -1649,6 +2542,8 @@ UniValue waitforlogs(const JSONRPCRequest& request_) {
     if (!fLogEvents)
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Events indexing disabled");
 
+    if (g_logindex) g_logindex->BlockUntilSyncedToCurrentChain();
+
     if(!request.req)
         throw JSONRPCError(RPC_INTERNAL_ERROR, "HTTP connection not available");
 
@@ -1663,11 +2558,19 @@ UniValue waitforlogs(const JSONRPCRequest& request_) {
     auto& addresses = params.addresses;
     auto& filterTopics = params.topics;
 
+    // A log has to match the addresses and all given topics
+    CLogBloomFilter bloomFilter;
+    bloomFilter.addresses = addresses;
+    for (const auto& topic : filterTopics) {
+        if (topic)
+            bloomFilter.topics.push_back(topic.get());
+    }
+
     while (curheight == 0) {
         {
             LOCK(cs_main);
             curheight = pblocktree->ReadHeightIndex(params.fromBlock, params.toBlock, params.minconf,
-                    hashesToBlock, addresses);
+                    hashesToBlock, addresses, &bloomFilter);
         }
 
         // if curheight >= fromBlock. Blockchain extended with new log entries. Return next block height to client.
@@ -1860,79 +2763,28 @@ UniValue searchlogs(const JSONRPCRequest& request)
     if(!fLogEvents)
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Events indexing disabled");
 
-    int curheight = 0;
-    
+    if (g_logindex) g_logindex->BlockUntilSyncedToCurrentChain();
+
     LOCK(cs_main);
 
     SearchLogsParams params(request.params);
-    
-    std::vector<std::vector<uint256>> hashesToBlock;
-
-    curheight = pblocktree->ReadHeightIndex(params.fromBlock, params.toBlock, params.minconf, hashesToBlock, params.addresses);
 
-    if (curheight == -1) {
+    std::vector<TransactionReceiptInfo> receipts;
+    int nextBlock;
+    if (!SearchLogs(params.fromBlock, params.toBlock, params.minconf, params.addresses, params.topics,
+                    std::numeric_limits<size_t>::max(), receipts, nextBlock)) {
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Incorrect params");
     }
 
     UniValue result(UniValue::VARR);
+    for (const auto& receipt : receipts) {
+        UniValue tri(UniValue::VOBJ);
+        transactionReceiptInfoToJSON(receipt, tri);
+        result.push_back(tri);
+    }
 
-    auto topics = params.topics;
-
-    std::set<uint256> dupes;
-
-    for(const auto& hashesTx : hashesToBlock)
-    {
-        for(const auto& e : hashesTx)
-        {
-
-            if(dupes.find(e) != dupes.end()) {
-                continue;
-            }
-            dupes.insert(e);
-
-            std::vector<TransactionReceiptInfo> receipts = pstorageresult->getResult(uintToh256(e));
-
-            for(const auto& receipt : receipts) {
-                if(receipt.logs.empty()) {
-                    continue;
-                }
-
-                if (!topics.empty()) {
-                    for (size_t i = 0; i < topics.size(); i++) {
-                        const auto& tc = topics[i];
-
-                        if (!tc) {
-                            continue;
-                        }
-
-                        for (const auto& log: receipt.logs) {
-                            auto filterTopicContent = tc.get();
-
-                            if (i >= log.topics.size()) {
-                                continue;
-                            }
-
-                            if (filterTopicContent == log.topics[i]) {
-                                goto push;
-                            }
-                        }
-                    }
-
-                    // Skip the log if none of the topics are matched
-                    continue;
-                }
-
-            push:
-
-                UniValue tri(UniValue::VOBJ);
-                transactionReceiptInfoToJSON(receipt, tri);
-                result.push_back(tri);
-            }
-        }
-    }
-
-    return result;
-}
+    return result;
+}
 
 UniValue gettransactionreceipt(const JSONRPCRequest& request)
 {
@@ -1978,6 +2830,8 @@ UniValue gettransactionreceipt(const JSONRPCRequest& request)
     if(!fLogEvents)
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Events indexing disabled");
 
+    if (g_logindex) g_logindex->BlockUntilSyncedToCurrentChain();
+
     LOCK(cs_main);
 
     std::string hashTemp = request.params[0].get_str();
@@ -2041,6 +2895,8 @@ UniValue getblocktransactionreceipts(const JSONRPCRequest& request)
     if (!fLogEvents)
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Events indexing disabled");
 
+    if (g_logindex) g_logindex->BlockUntilSyncedToCurrentChain();
+
     LOCK(cs_main);
 
     std::string hashTemp = request.params[0].get_str();
@@ -2071,6 +2927,74 @@ UniValue getblocktransactionreceipts(const JSONRPCRequest& request)
     return result;
 }
 
+UniValue getcontractaddresstxs(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 3)
+        throw std::runtime_error(
+            RPCHelpMan{"getcontractaddresstxs",
+                "\nGet the contract transactions an EVM address took part in, as the sender or the receiver of a value transfer\n"
+                "of the execution, or as a contract created or destructed by it. Requires -logaddressindex to be enabled.\n",
+                {
+                    {"address", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The EVM address"},
+                    {"fromBlock", RPCArg::Type::NUM, /* default */ "0", "The number of the earliest block"},
+                    {"toBlock", RPCArg::Type::NUM, /* default */ "-1", "The number of the latest block (-1 may be given to mean the most recent block)"},
+                },
+                RPCResult{
+            "[\n"
+            "  {\n"
+            "    \"blockNumber\": n,                (numeric)  block number\n"
+            "    \"transactionHash\": \"hash\",       (string)  transaction hash\n"
+            "    \"transactionIndex\": n,           (numeric)  transaction index\n"
+            "    \"sender\": true|false,            (boolean)  whether the address sent value in the execution\n"
+            "    \"receiver\": true|false,          (boolean)  whether the address received value in the execution\n"
+            "    \"created\": true|false,           (boolean)  whether the execution created the contract\n"
+            "    \"destructed\": true|false         (boolean)  whether the execution destructed the contract\n"
+            "  }\n"
+            "]\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getcontractaddresstxs", "eb23c0b3e6042821da281a2e2364feb22dd543e3")
+            + HelpExampleCli("getcontractaddresstxs", "eb23c0b3e6042821da281a2e2364feb22dd543e3 5000 5500")
+            + HelpExampleRpc("getcontractaddresstxs", "\"eb23c0b3e6042821da281a2e2364feb22dd543e3\", 5000, 5500")
+                },
+            }.ToString());
+
+    if (!fLogAddressIndex)
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Contract address indexing disabled");
+
+    if (g_logindex) g_logindex->BlockUntilSyncedToCurrentChain();
+
+    std::string strAddr = request.params[0].get_str();
+    if (strAddr.size() != 40 || !CheckHex(strAddr))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Incorrect address");
+    dev::Address address(strAddr);
+
+    int fromBlock = request.params[1].isNull() ? 0 : request.params[1].get_int();
+    int toBlock = request.params[2].isNull() ? -1 : request.params[2].get_int();
+    if (fromBlock < 0 || toBlock < -1 || (toBlock > -1 && toBlock < fromBlock))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid block range");
+
+    std::vector<std::pair<CContractAddressIndexKey, CContractAddressIndexValue>> entries;
+    if (!pblocktree->ReadContractAddressIndex(address, fromBlock, toBlock, entries))
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read the contract address index");
+
+    UniValue result(UniValue::VARR);
+    for (const auto& entry : entries) {
+        const unsigned char roles = entry.second.second;
+        UniValue tx(UniValue::VOBJ);
+        tx.pushKV("blockNumber", (int)entry.first.height);
+        tx.pushKV("transactionHash", entry.second.first.GetHex());
+        tx.pushKV("transactionIndex", (int)entry.first.txIndex);
+        tx.pushKV("sender", (roles & CONTRACT_ADDRESS_SENDER) != 0);
+        tx.pushKV("receiver", (roles & CONTRACT_ADDRESS_RECEIVER) != 0);
+        tx.pushKV("created", (roles & CONTRACT_ADDRESS_CREATED) != 0);
+        tx.pushKV("destructed", (roles & CONTRACT_ADDRESS_DESTRUCTED) != 0);
+        result.push_back(tx);
+    }
+
+    return result;
+}
+
 //////////////////////////////////////////////////////////////////////
 
 UniValue listcontracts(const JSONRPCRequest& request)
@@ -2078,7 +3002,7 @@ UniValue listcontracts(const JSONRPCRequest& request)
 	if (request.fHelp)
         throw std::runtime_error(
             RPCHelpMan{"listcontracts",
-                "\nGet the contracts list.\n",
+                "\nGet the contracts list. With -contractindex the contracts are listed in creation order.\n",
                 {
                     {"start", RPCArg::Type::NUM, /* default */ "1", "The starting account index"},
                     {"maxDisplay", RPCArg::Type::NUM, /* default */ "20", "Max accounts to list"},
@@ -2095,8 +3019,6 @@ UniValue listcontracts(const JSONRPCRequest& request)
                 },
             }.ToString());
 
-	LOCK(cs_main);
-
 	int start=1;
 	if (request.params.size() > 0){
 		start = request.params[0].get_int();
@@ -2111,8 +3033,27 @@ UniValue listcontracts(const JSONRPCRequest& request)
 			throw JSONRPCError(RPC_TYPE_ERROR, "Invalid maxDisplay");
 	}
 
+	const bool fContractIndex = g_contractindex && g_contractindex->BlockUntilSyncedToCurrentChain();
+
+	LOCK(cs_main);
+
 	UniValue result(UniValue::VOBJ);
 
+	if (fContractIndex) {
+		uint64_t contractsCount;
+		if (!g_contractindex->GetContractCount(contractsCount))
+			throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read the contract index");
+		if (contractsCount>0 && (uint64_t)start > contractsCount)
+			throw JSONRPCError(RPC_TYPE_ERROR, "start greater than max index "+ i64tostr(contractsCount));
+
+		std::vector<std::pair<dev::h160, ContractInfo>> contracts;
+		if (!g_contractindex->ListContracts(g_contractindex->GetIndexedHeight(), start-1, maxDisplay, contracts))
+			throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read the contract index");
+		for (const auto& contract : contracts)
+			result.pushKV(contract.first.hex(),ValueFromAmount(CAmount(globalState->balance(contract.first))));
+		return result;
+	}
+
 	auto map = globalState->addresses();
 	int contractsCount=(int)map.size();
 
@@ -2137,7 +3078,7 @@ UniValue listallcontracts(const JSONRPCRequest& request)
         throw std::runtime_error(
             RPCHelpMan{
                 "listallcontracts",
-                "\nGet the contracts list.\n",
+                "\nGet the contracts list. With -contractindex the contracts are listed in creation order.\n",
                 {{"blockNum", RPCArg::Type::NUM, /* default */ "latest", "Number of block to get contracts from."}},
                 RPCResult{
                     "{\n"
@@ -2149,17 +3090,33 @@ UniValue listallcontracts(const JSONRPCRequest& request)
             }
                 .ToString());
 
+    const bool fContractIndex = g_contractindex && g_contractindex->BlockUntilSyncedToCurrentChain();
+
     LOCK(cs_main);
 
-    TemporaryState ts(globalState);
+    int blockNum = chainActive.Height();
     if (request.params.size() > 0) {
-        int blockNum = request.params[0].get_int();
+        blockNum = request.params[0].get_int();
         if (blockNum < 0 || blockNum > chainActive.Height())
             throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
-        ts.SetRoot(uintToh256(chainActive[blockNum]->hashStateRoot), uintToh256(chainActive[blockNum]->hashUTXORoot));
     }
 
     UniValue result(UniValue::VARR);
+    if (fContractIndex && blockNum <= g_contractindex->GetIndexedHeight()) {
+        std::vector<std::pair<dev::h160, ContractInfo>> contracts;
+        if (!g_contractindex->ListContracts(blockNum, 0, std::numeric_limits<size_t>::max(), contracts))
+            throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read the contract index");
+        for (const auto& contract : contracts) {
+            result.push_back(contract.first.hex());
+        }
+        return result;
+    }
+
+    TemporaryState ts(globalState);
+    if (request.params.size() > 0) {
+        ts.SetRoot(uintToh256(chainActive[blockNum]->hashStateRoot), uintToh256(chainActive[blockNum]->hashUTXORoot));
+    }
+
     auto map = globalState->addresses();
     for (const auto& item: map) {
         result.push_back(item.first.hex());
@@ -2167,6 +3124,116 @@ UniValue listallcontracts(const JSONRPCRequest& request)
     return result;
 }
 
+static UniValue ContractInfoToJSON(const dev::h160& address, const ContractInfo& info)
+{
+    UniValue contract(UniValue::VOBJ);
+    contract.pushKV("address", address.hex());
+    contract.pushKV("blockNumber", info.nHeight);
+    contract.pushKV("transactionHash", info.hashCreatorTx.GetHex());
+    contract.pushKV("transactionIndex", (int)info.nTxIndex);
+    contract.pushKV("codeHash", uintToh256(info.hashCode).hex());
+    if (info.nDestructedHeight >= 0)
+        contract.pushKV("destructedBlockNumber", info.nDestructedHeight);
+    return contract;
+}
+
+UniValue getcontractinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            RPCHelpMan{"getcontractinfo",
+                "\nGet the entry of a contract in the contract registry. Requires -contractindex to be enabled.\n",
+                {
+                    {"address", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The contract address"},
+                },
+                RPCResult{
+            "{\n"
+            "  \"address\": \"hex\",                 (string)  the contract address\n"
+            "  \"blockNumber\": n,                  (numeric) number of the block that created the contract\n"
+            "  \"transactionHash\": \"hash\",         (string)  hash of the transaction that created it\n"
+            "  \"transactionIndex\": n,             (numeric) index of the transaction in the block\n"
+            "  \"codeHash\": \"hash\",                (string)  keccak-256 hash of the code of the contract\n"
+            "  \"destructedBlockNumber\": n,        (numeric, optional) number of the block that destructed it\n"
+            "  \"storageSlots\": n,                 (numeric) storage slots with a value other than zero\n"
+            "  \"codeSize\": n,                     (numeric) size of the code in bytes\n"
+            "  \"trieNodes\": n                     (numeric) nodes of the storage trie in the state database\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getcontractinfo", "eb23c0b3e6042821da281a2e2364feb22dd543e3")
+            + HelpExampleRpc("getcontractinfo", "\"eb23c0b3e6042821da281a2e2364feb22dd543e3\"")
+                },
+            }.ToString());
+
+    if (!g_contractindex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Requires -contractindex");
+    g_contractindex->BlockUntilSyncedToCurrentChain();
+
+    std::string strAddr = request.params[0].get_str();
+    if (strAddr.size() != 40 || !CheckHex(strAddr))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Incorrect address");
+    dev::Address address(strAddr);
+
+    ContractInfo info;
+    if (!g_contractindex->LookupContract(address, info))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No contract was created at this address");
+    ContractStateSize size;
+    if (!g_contractindex->LookupContractState(address, size))
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read the contract index");
+    UniValue result = ContractInfoToJSON(address, info);
+    result.pushKV("storageSlots", size.nStorageSlots);
+    result.pushKV("codeSize", size.nCodeSize);
+    result.pushKV("trieNodes", size.nTrieNodes);
+    return result;
+}
+
+UniValue listcontractsbycodehash(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            RPCHelpMan{"listcontractsbycodehash",
+                "\nList the contracts created with a code, the destructed ones included. Requires -contractindex to be enabled.\n",
+                {
+                    {"codehash", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The keccak-256 hash of the code"},
+                },
+                RPCResult{
+            "[\n"
+            "  {                                  (json object) the registry entry of the contract, as getcontractinfo returns it\n"
+            "    ...\n"
+            "  }\n"
+            "]\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("listcontractsbycodehash", "\"c5d2460186f7233c927e7db2dcc703c0e500b653ca82273b7bfad8045d85a470\"")
+            + HelpExampleRpc("listcontractsbycodehash", "\"c5d2460186f7233c927e7db2dcc703c0e500b653ca82273b7bfad8045d85a470\"")
+                },
+            }.ToString());
+
+    if (!g_contractindex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Requires -contractindex");
+    g_contractindex->BlockUntilSyncedToCurrentChain();
+
+    std::string strHash = request.params[0].get_str();
+    if (strHash.size() != 64 || !CheckHex(strHash))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Incorrect code hash");
+
+    std::vector<std::pair<dev::h160, ContractInfo>> contracts;
+    if (!g_contractindex->FindContractsByCodeHash(h256Touint(dev::h256(strHash)), contracts))
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read the contract index");
+
+    UniValue result(UniValue::VARR);
+    for (const auto& contract : contracts) {
+        result.push_back(ContractInfoToJSON(contract.first, contract.second));
+    }
+    return result;
+}
+
+enum class CoinStatsHashType {
+    HASH_SERIALIZED,
+    MUHASH,
+    NONE,
+};
+
 struct CCoinsStats
 {
     int nHeight;
@@ -2179,48 +3246,72 @@ struct CCoinsStats
     CAmount nTotalAmount;
 
     CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nBogoSize(0), nDiskSize(0), nTotalAmount(0) {}
+
+    CCoinsStats& operator+=(const CCoinsStats& other)
+    {
+        nTransactions += other.nTransactions;
+        nTransactionOutputs += other.nTransactionOutputs;
+        nBogoSize += other.nBogoSize;
+        nTotalAmount += other.nTotalAmount;
+        return *this;
+    }
 };
 
-static void ApplyStats(CCoinsStats &stats, CHashWriter& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
+static void ApplyHash(CHashWriter& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
 {
-    assert(!outputs.empty());
     ss << hash;
     ss << VARINT((outputs.begin()->second.nHeight << 2) + (outputs.begin()->second.fCoinBase ? 1u : 0u) + (outputs.begin()->second.fCoinStake ? 2u : 0u));
-    stats.nTransactions++;
     for (const auto& output : outputs) {
         ss << VARINT(output.first + 1);
         ss << *(const CScriptBase*)(&output.second.out.scriptPubKey);
         ss << VARINT(output.second.out.nValue, VarIntMode::NONNEGATIVE_SIGNED);
+    }
+    ss << VARINT(0u);
+}
+
+//! Every output is an element of the set, so the hash does not depend on the order of the coins
+static void ApplyHash(MuHash3072& muhash, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
+{
+    for (const auto& output : outputs) {
+        CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+        ss << COutPoint(hash, output.first);
+        ss << (uint32_t)((output.second.nHeight << 2) + (output.second.fCoinBase ? 1u : 0u) + (output.second.fCoinStake ? 2u : 0u));
+        ss << output.second.out;
+        muhash.Insert(Span<const unsigned char>((const unsigned char*)ss.data(), ss.size()));
+    }
+}
+
+static void ApplyHash(std::nullptr_t, const uint256& hash, const std::map<uint32_t, Coin>& outputs) {}
+
+template <typename T>
+static void ApplyStats(CCoinsStats &stats, T& hash_obj, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
+{
+    assert(!outputs.empty());
+    ApplyHash(hash_obj, hash, outputs);
+    stats.nTransactions++;
+    for (const auto& output : outputs) {
         stats.nTransactionOutputs++;
         stats.nTotalAmount += output.second.out.nValue;
         stats.nBogoSize += 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
                            2 /* scriptPubKey len */ + output.second.out.scriptPubKey.size() /* scriptPubKey */;
     }
-    ss << VARINT(0u);
 }
 
-//! Calculate statistics about the unspent transaction output set
-static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
+//! Add the coins of a cursor to the statistics, false if one can not be read or shutdown is requested
+template <typename T>
+static bool ApplyCursor(CCoinsViewCursor& cursor, CCoinsStats& stats, T& hash_obj)
 {
-    std::unique_ptr<CCoinsViewCursor> pcursor(view->Cursor());
-    assert(pcursor);
-
-    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
-    stats.hashBlock = pcursor->GetBestBlock();
-    {
-        LOCK(cs_main);
-        stats.nHeight = LookupBlockIndex(stats.hashBlock)->nHeight;
-    }
-    ss << stats.hashBlock;
     uint256 prevkey;
     std::map<uint32_t, Coin> outputs;
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
+    while (cursor.Valid()) {
+        if (ShutdownRequested()) {
+            return false;
+        }
         COutPoint key;
         Coin coin;
-        if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
+        if (cursor.GetKey(key) && cursor.GetValue(coin)) {
             if (!outputs.empty() && key.hash != prevkey) {
-                ApplyStats(stats, ss, prevkey, outputs);
+                ApplyStats(stats, hash_obj, prevkey, outputs);
                 outputs.clear();
             }
             prevkey = key.hash;
@@ -2228,12 +3319,81 @@ static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
         } else {
             return error("%s: unable to read value", __func__);
         }
-        pcursor->Next();
+        cursor.Next();
     }
     if (!outputs.empty()) {
-        ApplyStats(stats, ss, prevkey, outputs);
+        ApplyStats(stats, hash_obj, prevkey, outputs);
+    }
+    return true;
+}
+
+//! Maximum number of threads gettxoutsetinfo splits the coins between
+static const int MAX_UTXO_STATS_THREADS = 16;
+
+//! Calculate statistics about the unspent transaction output set
+static bool GetUTXOStats(CCoinsViewDB *view, CCoinsStats &stats, CoinStatsHashType hash_type)
+{
+    // The serialized hash is a stream over the coins in order, the other statistics add
+    // up over disjoint ranges of them, which are read on several threads
+    const int nThreads = hash_type == CoinStatsHashType::HASH_SERIALIZED ? 1 : std::max(1, std::min(GetNumCores(), MAX_UTXO_STATS_THREADS));
+
+    // Take the snapshot while no flush can be in flight, the ranges are consistent
+    // with each other whatever is written to the database afterwards
+    std::vector<std::unique_ptr<CCoinsViewCursor>> cursors;
+    {
+        LOCK(cs_main);
+        if (pcoinsflusher && !pcoinsflusher->Wait()) {
+            return error("%s: unable to write the coins database", __func__);
+        }
+        cursors = view->Cursors(nThreads);
+        if (cursors.empty()) {
+            return error("%s: the coins database is in the middle of a flush", __func__);
+        }
+        stats.hashBlock = cursors[0]->GetBestBlock();
+        stats.nHeight = LookupBlockIndex(stats.hashBlock)->nHeight;
+    }
+
+    if (hash_type == CoinStatsHashType::HASH_SERIALIZED) {
+        CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+        ss << stats.hashBlock;
+        if (!ApplyCursor(*cursors[0], stats, ss)) {
+            return false;
+        }
+        stats.hashSerialized = ss.GetHash();
+    } else {
+        std::vector<CCoinsStats> parts(nThreads);
+        std::vector<MuHash3072> muhashes(nThreads);
+        std::vector<char> results(nThreads);
+        auto work = [&](int t) {
+            if (hash_type == CoinStatsHashType::MUHASH) {
+                results[t] = ApplyCursor(*cursors[t], parts[t], muhashes[t]);
+            } else {
+                std::nullptr_t none;
+                results[t] = ApplyCursor(*cursors[t], parts[t], none);
+            }
+        };
+        std::vector<std::thread> threads;
+        for (int t = 1; t < nThreads; ++t) {
+            threads.emplace_back(work, t);
+        }
+        work(0);
+        bool fOk = true;
+        MuHash3072 muhash;
+        for (int t = 0; t < nThreads; ++t) {
+            if (t > 0) threads[t - 1].join();
+            fOk &= results[t] != 0;
+            stats += parts[t];
+            if (hash_type == CoinStatsHashType::MUHASH) {
+                muhash *= muhashes[t];
+            }
+        }
+        if (!fOk) {
+            return false;
+        }
+        if (hash_type == CoinStatsHashType::MUHASH) {
+            muhash.Finalize(stats.hashSerialized);
+        }
     }
-    stats.hashSerialized = ss.GetHash();
     stats.nDiskSize = view->EstimateSize();
     return true;
 }
@@ -2296,14 +3456,30 @@ static UniValue pruneblockchain(const JSONRPCRequest& request)
     return uint64_t(block->nHeight);
 }
 
+static CoinStatsHashType ParseHashType(const UniValue& param)
+{
+    if (param.isNull()) return CoinStatsHashType::HASH_SERIALIZED;
+    const std::string& hash_type = param.get_str();
+    if (hash_type == "hash_serialized_2") return CoinStatsHashType::HASH_SERIALIZED;
+    if (hash_type == "muhash") return CoinStatsHashType::MUHASH;
+    if (hash_type == "none") return CoinStatsHashType::NONE;
+    throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("%s is not a valid hash_type", hash_type));
+}
+
+static Mutex cs_utxo_stats;
+//! The statistics of the last call for each hash type, reused while the best block is unchanged
+static std::map<CoinStatsHashType, CCoinsStats> g_utxo_stats GUARDED_BY(cs_utxo_stats);
+
 static UniValue gettxoutsetinfo(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() != 0)
+    if (request.fHelp || request.params.size() > 1)
         throw std::runtime_error(
             RPCHelpMan{"gettxoutsetinfo",
                 "\nReturns statistics about the unspent transaction output set.\n"
                 "Note this call may take some time.\n",
-                {},
+                {
+                    {"hash_type", RPCArg::Type::STR, /* default */ "hash_serialized_2", "Which UTXO set hash should be calculated. Options: 'hash_serialized_2' (the legacy algorithm, computed on one thread), 'muhash' (computed on several threads), 'none'."},
+                },
                 RPCResult{
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
@@ -2311,33 +3487,54 @@ static UniValue gettxoutsetinfo(const JSONRPCRequest& request)
             "  \"transactions\": n,      (numeric) The number of transactions with unspent outputs\n"
             "  \"txouts\": n,            (numeric) The number of unspent transaction outputs\n"
             "  \"bogosize\": n,          (numeric) A meaningless metric for UTXO set size\n"
-            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash\n"
+            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash (only present if 'hash_serialized_2' hash_type is chosen)\n"
+            "  \"muhash\": \"hash\",     (string) The MuHash of the set of outputs (only present if 'muhash' hash_type is chosen)\n"
             "  \"disk_size\": n,         (numeric) The estimated size of the chainstate on disk\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
             "}\n"
                 },
                 RPCExamples{
                     HelpExampleCli("gettxoutsetinfo", "")
+            + HelpExampleCli("gettxoutsetinfo", "\"muhash\"")
             + HelpExampleRpc("gettxoutsetinfo", "")
                 },
             }.ToString());
 
+    const CoinStatsHashType hash_type = ParseHashType(request.params[0]);
+
     UniValue ret(UniValue::VOBJ);
 
     CCoinsStats stats;
     FlushStateToDisk();
-    if (GetUTXOStats(pcoinsdbview.get(), stats)) {
-        ret.pushKV("height", (int64_t)stats.nHeight);
-        ret.pushKV("bestblock", stats.hashBlock.GetHex());
-        ret.pushKV("transactions", (int64_t)stats.nTransactions);
-        ret.pushKV("txouts", (int64_t)stats.nTransactionOutputs);
-        ret.pushKV("bogosize", (int64_t)stats.nBogoSize);
+    {
+        LOCK(cs_utxo_stats);
+        uint256 hashBestBlock;
+        {
+            LOCK(cs_main);
+            hashBestBlock = pcoinsdbview->GetBestBlock();
+        }
+        auto it = g_utxo_stats.find(hash_type);
+        if (it != g_utxo_stats.end() && it->second.hashBlock == hashBestBlock) {
+            stats = it->second;
+            stats.nDiskSize = pcoinsdbview->EstimateSize();
+        } else if (GetUTXOStats(pcoinsdbview.get(), stats, hash_type)) {
+            g_utxo_stats[hash_type] = stats;
+        } else {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+        }
+    }
+    ret.pushKV("height", (int64_t)stats.nHeight);
+    ret.pushKV("bestblock", stats.hashBlock.GetHex());
+    ret.pushKV("transactions", (int64_t)stats.nTransactions);
+    ret.pushKV("txouts", (int64_t)stats.nTransactionOutputs);
+    ret.pushKV("bogosize", (int64_t)stats.nBogoSize);
+    if (hash_type == CoinStatsHashType::HASH_SERIALIZED) {
         ret.pushKV("hash_serialized_2", stats.hashSerialized.GetHex());
-        ret.pushKV("disk_size", stats.nDiskSize);
-        ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
-    } else {
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+    } else if (hash_type == CoinStatsHashType::MUHASH) {
+        ret.pushKV("muhash", stats.hashSerialized.GetHex());
     }
+    ret.pushKV("disk_size", stats.nDiskSize);
+    ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
     return ret;
 }
 
@@ -2452,40 +3649,108 @@ static UniValue verifychain(const JSONRPCRequest& request)
     return CVerifyDB().VerifyDB(Params(), pcoinsTip.get(), nCheckLevel, nCheckDepth);
 }
 
+static UniValue verifycontractstate(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 2)
+        throw std::runtime_error(
+            RPCHelpMan{"verifycontractstate",
+                "\nChecks that the contract state of a block (EVM state with account storage and bytecode,\n"
+                "and contract UTXOs) is complete and hashes up to the roots in its header.\n",
+                {
+                    {"blockhash", RPCArg::Type::STR_HEX, /* default */ "the tip", "The block whose state is checked; with -prunestate, a block of the active chain within the kept window"},
+                    {"nthreads", RPCArg::Type::NUM, /* default */ "the number of cores", "The number of threads to split the tries between"},
+                },
+                RPCResult{
+            "{\n"
+            "  \"blockhash\": \"hex\",     (string) the block whose state was checked\n"
+            "  \"entries\": n,            (numeric) number of entries checked\n"
+            "  \"missing\": n,            (numeric) number of referenced entries not found\n"
+            "  \"corrupted\": n,          (numeric) number of entries that do not match their hash\n"
+            "  \"valid\": true|false      (boolean) whether the state matches the roots\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("verifycontractstate", "")
+            + HelpExampleRpc("verifycontractstate", "")
+                },
+            }.ToString());
+
+    uint256 hashBlock;
+    StateRoots roots;
+    std::unique_ptr<StateRootsPin> pin;
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pindex;
+        if (request.params[0].isNull()) {
+            pindex = chainActive.Tip();
+        } else {
+            pindex = LookupBlockIndex(ParseHashV(request.params[0], "blockhash"));
+            if (!pindex || !pindex->IsValid(BLOCK_VALID_SCRIPTS)) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found or not validated");
+            }
+        }
+        // A missing entry must mean a broken database, not state that -prunestate deleted
+        if (!IsContractStateAvailable(pindex))
+            throw JSONRPCError(RPC_MISC_ERROR, strprintf("The contract state of block %d was pruned (-prunestate)", pindex->nHeight));
+        hashBlock = pindex->GetBlockHash();
+        roots = StateRoots(uintToh256(pindex->hashStateRoot), uintToh256(pindex->hashUTXORoot));
+        pin.reset(new StateRootsPin(roots));
+    }
+    int nThreads = request.params[1].isNull() ? GetNumCores() : request.params[1].get_int();
+    if (nThreads < 1) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "nthreads must be positive");
+    }
+    if (!globalState->diskDb() || !globalState->diskDbUtxo()) {
+        throw JSONRPCError(RPC_MISC_ERROR, "The contract state database is not available");
+    }
+
+    // Stored nodes are never modified and the pin keeps them, so the check runs without cs_main
+    StateTrieCheck check = CheckStateTrie(*globalState->diskDb(), roots.first, true, nThreads);
+    check += CheckStateTrie(*globalState->diskDbUtxo(), roots.second, false, nThreads);
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("blockhash", hashBlock.GetHex());
+    result.pushKV("entries", (uint64_t)check.nEntries);
+    result.pushKV("missing", (uint64_t)check.nMissing);
+    result.pushKV("corrupted", (uint64_t)check.nCorrupted);
+    result.pushKV("valid", check.IsValid());
+    return result;
+}
+
 /** Implementation of IsSuperMajority with better feedback */
-static UniValue SoftForkMajorityDesc(int version, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
+static UniValue SoftForkMajorityDesc(int version, int nHeight, const Consensus::Params& consensusParams)
 {
     UniValue rv(UniValue::VOBJ);
     bool activated = false;
     switch(version)
     {
         case 2:
-            activated = pindex->nHeight >= consensusParams.BIP34Height;
+            activated = nHeight >= consensusParams.BIP34Height;
             break;
         case 3:
-            activated = pindex->nHeight >= consensusParams.BIP66Height;
+            activated = nHeight >= consensusParams.BIP66Height;
             break;
         case 4:
-            activated = pindex->nHeight >= consensusParams.BIP65Height;
+            activated = nHeight >= consensusParams.BIP65Height;
             break;
     }
     rv.pushKV("status", activated);
     return rv;
 }
 
-static UniValue SoftForkDesc(const std::string &name, int version, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
+static UniValue SoftForkDesc(const std::string &name, int version, int nHeight, const Consensus::Params& consensusParams)
 {
     UniValue rv(UniValue::VOBJ);
     rv.pushKV("id", name);
     rv.pushKV("version", version);
-    rv.pushKV("reject", SoftForkMajorityDesc(version, pindex, consensusParams));
+    rv.pushKV("reject", SoftForkMajorityDesc(version, nHeight, consensusParams));
     return rv;
 }
 
-static UniValue BIP9SoftForkDesc(const Consensus::Params& consensusParams, Consensus::DeploymentPos id)
+static UniValue BIP9SoftForkDesc(const ChainTipSnapshot& tip, const Consensus::Params& consensusParams, Consensus::DeploymentPos id)
 {
     UniValue rv(UniValue::VOBJ);
-    const ThresholdState thresholdState = VersionBitsTipState(consensusParams, id);
+    const ThresholdState thresholdState = tip.vDeployments[id].state;
     switch (thresholdState) {
     case ThresholdState::DEFINED: rv.pushKV("status", "defined"); break;
     case ThresholdState::STARTED: rv.pushKV("status", "started"); break;
@@ -2499,11 +3764,11 @@ static UniValue BIP9SoftForkDesc(const Consensus::Params& consensusParams, Conse
     }
     rv.pushKV("startTime", consensusParams.vDeployments[id].nStartTime);
     rv.pushKV("timeout", consensusParams.vDeployments[id].nTimeout);
-    rv.pushKV("since", VersionBitsTipStateSinceHeight(consensusParams, id));
+    rv.pushKV("since", tip.vDeployments[id].nSinceHeight);
     if (ThresholdState::STARTED == thresholdState)
     {
         UniValue statsUV(UniValue::VOBJ);
-        BIP9Stats statsStruct = VersionBitsTipStatistics(consensusParams, id);
+        const BIP9Stats& statsStruct = tip.vDeployments[id].stats;
         statsUV.pushKV("period", statsStruct.period);
         statsUV.pushKV("threshold", statsStruct.threshold);
         statsUV.pushKV("elapsed", statsStruct.elapsed);
@@ -2514,13 +3779,13 @@ static UniValue BIP9SoftForkDesc(const Consensus::Params& consensusParams, Conse
     return rv;
 }
 
-static void BIP9SoftForkDescPushBack(UniValue& bip9_softforks, const Consensus::Params& consensusParams, Consensus::DeploymentPos id)
+static void BIP9SoftForkDescPushBack(UniValue& bip9_softforks, const ChainTipSnapshot& tip, const Consensus::Params& consensusParams, Consensus::DeploymentPos id)
 {
     // Deployments with timeout value of 0 are hidden.
     // A timeout value of 0 guarantees a softfork will never be activated.
     // This is used when softfork codes are merged without specifying the deployment schedule.
     if (consensusParams.vDeployments[id].nTimeout > 0)
-        bip9_softforks.pushKV(VersionBitsDeploymentInfo[id].name, BIP9SoftForkDesc(consensusParams, id));
+        bip9_softforks.pushKV(VersionBitsDeploymentInfo[id].name, BIP9SoftForkDesc(tip, consensusParams, id));
 }
 
 UniValue getblockchaininfo(const JSONRPCRequest& request)
@@ -2571,6 +3836,16 @@ UniValue getblockchaininfo(const JSONRPCRequest& request)
             "        }\n"
             "     }\n"
             "  }\n"
+            "  \"contract_state\": {           (object) size of the state of all contracts (only present if -contractindex is enabled)\n"
+            "     \"height\": xxxxxx,          (numeric) the last block the contract index got to\n"
+            "     \"storage_slots\": xxxxxx,   (numeric) storage slots with a value other than zero\n"
+            "     \"code_size\": xxxxxx,       (numeric) size of the code in bytes\n"
+            "     \"trie_nodes\": xxxxxx       (numeric) nodes of the storage tries in the state database\n"
+            "  },\n"
+            "  \"backgroundcheck\": {          (object) block verification continued after startup (only present with -backgroundcheck)\n"
+            "     \"status\": \"xxxx\",          (string) running, done or failed\n"
+            "     \"height\": xxxxxx           (numeric) the lowest block verified so far\n"
+            "  },\n"
             "  \"warnings\" : \"...\",           (string) any network and blockchain warnings.\n"
             "}\n"
                 },
@@ -2580,24 +3855,27 @@ UniValue getblockchaininfo(const JSONRPCRequest& request)
                 },
             }.ToString());
 
-    LOCK(cs_main);
-
-    const CBlockIndex* tip = chainActive.Tip();
+    // The tip fields come from its snapshot, only the prune height needs cs_main
+    const std::shared_ptr<const ChainTipSnapshot> tip = GetChainTipSnapshot();
+    if (tip->nHeight < 0) {
+        throw JSONRPCError(RPC_MISC_ERROR, "No blocks in the active chain");
+    }
     UniValue obj(UniValue::VOBJ);
     obj.pushKV("chain",                 Params().NetworkIDString());
-    obj.pushKV("blocks",                (int)chainActive.Height());
-    obj.pushKV("headers",               pindexBestHeader ? pindexBestHeader->nHeight : -1);
-    obj.pushKV("bestblockhash",         tip->GetBlockHash().GetHex());
-    obj.pushKV("difficulty",            (double)GetDifficulty(tip));
-    obj.pushKV("moneysupply",           pindexBestHeader->nMoneySupply / COIN);
-    obj.pushKV("mediantime",            (int64_t)tip->GetMedianTimePast());
-    obj.pushKV("verificationprogress",  GuessVerificationProgress(Params().TxData(), tip));
+    obj.pushKV("blocks",                tip->nHeight);
+    obj.pushKV("headers",               nBestHeaderHeight.load());
+    obj.pushKV("bestblockhash",         tip->hashBlock.GetHex());
+    obj.pushKV("difficulty",            GetDifficulty(tip->nBits));
+    obj.pushKV("moneysupply",           tip->nMoneySupply / COIN);
+    obj.pushKV("mediantime",            tip->nMedianTimePast);
+    obj.pushKV("verificationprogress",  tip->dVerificationProgress);
     obj.pushKV("initialblockdownload",  IsInitialBlockDownload());
     obj.pushKV("chainwork",             tip->nChainWork.GetHex());
     obj.pushKV("size_on_disk",          CalculateCurrentUsage());
     obj.pushKV("pruned",                fPruneMode);
     if (fPruneMode) {
-        const CBlockIndex* block = tip;
+        LOCK(cs_main);
+        const CBlockIndex* block = chainActive.Tip();
         assert(block);
         while (block->pprev && (block->pprev->nStatus & BLOCK_HAVE_DATA)) {
             block = block->pprev;
@@ -2616,15 +3894,33 @@ UniValue getblockchaininfo(const JSONRPCRequest& request)
     const Consensus::Params& consensusParams = Params().GetConsensus();
     UniValue softforks(UniValue::VARR);
     UniValue bip9_softforks(UniValue::VOBJ);
-    softforks.push_back(SoftForkDesc("bip34", 2, tip, consensusParams));
-    softforks.push_back(SoftForkDesc("bip66", 3, tip, consensusParams));
-    softforks.push_back(SoftForkDesc("bip65", 4, tip, consensusParams));
+    softforks.push_back(SoftForkDesc("bip34", 2, tip->nHeight, consensusParams));
+    softforks.push_back(SoftForkDesc("bip66", 3, tip->nHeight, consensusParams));
+    softforks.push_back(SoftForkDesc("bip65", 4, tip->nHeight, consensusParams));
     for (int pos = Consensus::DEPLOYMENT_CSV; pos != Consensus::MAX_VERSION_BITS_DEPLOYMENTS; ++pos) {
-        BIP9SoftForkDescPushBack(bip9_softforks, consensusParams, static_cast<Consensus::DeploymentPos>(pos));
+        BIP9SoftForkDescPushBack(bip9_softforks, *tip, consensusParams, static_cast<Consensus::DeploymentPos>(pos));
     }
     obj.pushKV("softforks",             softforks);
     obj.pushKV("bip9_softforks", bip9_softforks);
 
+    ContractStateSize contractState;
+    if (g_contractindex && g_contractindex->GetTotalContractState(contractState)) {
+        UniValue state(UniValue::VOBJ);
+        state.pushKV("height", g_contractindex->GetIndexedHeight());
+        state.pushKV("storage_slots", contractState.nStorageSlots);
+        state.pushKV("code_size", contractState.nCodeSize);
+        state.pushKV("trie_nodes", contractState.nTrieNodes);
+        obj.pushKV("contract_state", state);
+    }
+
+    BackgroundCheckStatus checkStatus = g_background_check_status.load();
+    if (checkStatus != BackgroundCheckStatus::NONE) {
+        UniValue check(UniValue::VOBJ);
+        check.pushKV("status", checkStatus == BackgroundCheckStatus::RUNNING ? "running" : checkStatus == BackgroundCheckStatus::DONE ? "done" : "failed");
+        check.pushKV("height", g_background_check_height.load());
+        obj.pushKV("backgroundcheck", check);
+    }
+
     obj.pushKV("warnings", GetWarnings("statusbar"));
     return obj;
 }
@@ -2758,6 +4054,8 @@ UniValue mempoolInfoToJSON()
     ret.pushKV("usage", (int64_t) mempool.DynamicMemoryUsage());
     size_t maxmempool = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     ret.pushKV("maxmempool", (int64_t) maxmempool);
+    ret.pushKV("gas", (int64_t) mempool.GetTotalGas());
+    ret.pushKV("maxmempoolgas", gArgs.GetArg("-maxmempoolgas", DEFAULT_MAX_MEMPOOL_GAS) * 1000000);
     ret.pushKV("mempoolminfee", ValueFromAmount(std::max(mempool.GetMinFee(maxmempool), ::minRelayTxFee).GetFeePerK()));
     ret.pushKV("minrelaytxfee", ValueFromAmount(::minRelayTxFee.GetFeePerK()));
 
@@ -2777,6 +4075,8 @@ static UniValue getmempoolinfo(const JSONRPCRequest& request)
             "  \"bytes\": xxxxx,              (numeric) Sum of all virtual transaction sizes as defined in BIP 141. Differs from actual serialized size because witness data is discounted\n"
             "  \"usage\": xxxxx,              (numeric) Total memory usage for the mempool\n"
             "  \"maxmempool\": xxxxx,         (numeric) Maximum memory usage for the mempool\n"
+            "  \"gas\": xxxxx,                (numeric) Sum of the gas limits of the contract transactions\n"
+            "  \"maxmempoolgas\": xxxxx,      (numeric) Maximum sum of the gas limits of the contract transactions\n"
             "  \"mempoolminfee\": xxxxx       (numeric) Minimum fee rate in " + CURRENCY_UNIT + "/kB for tx to be accepted. Is the maximum of minrelaytxfee and minimum mempool fee\n"
             "  \"minrelaytxfee\": xxxxx       (numeric) Current minimum relay fee for transactions\n"
             "}\n"
@@ -2985,22 +4285,6 @@ static UniValue getchaintxstats(const JSONRPCRequest& request)
     return ret;
 }
 
-template<typename T>
-static T CalculateTruncatedMedian(std::vector<T>& scores)
-{
-    size_t size = scores.size();
-    if (size == 0) {
-        return 0;
-    }
-
-    std::sort(scores.begin(), scores.end());
-    if (size % 2 == 0) {
-        return (scores[size / 2 - 1] + scores[size / 2]) / 2;
-    } else {
-        return scores[size / 2];
-    }
-}
-
 void CalculatePercentilesByWeight(CAmount result[NUM_GETBLOCKSTATS_PERCENTILES], std::vector<std::pair<CAmount, int64_t>>& scores, int64_t total_weight)
 {
     if (scores.empty()) {
@@ -3038,108 +4322,9 @@ static inline bool SetHasKeys(const std::set<T>& set, const Tk& key, const Args&
     return (set.count(key) != 0) || SetHasKeys(set, args...);
 }
 
-// outpoint (needed for the utxo index) + nHeight + fCoinBase
-static constexpr size_t PER_UTXO_OVERHEAD = sizeof(COutPoint) + sizeof(uint32_t) + sizeof(bool);
-
-static UniValue getblockstats(const JSONRPCRequest& request)
+/** Compute the statistics of a block selected for getblockstats, from the block and the transaction index */
+static void ComputeSelectedBlockStats(const CBlockIndex* pindex, const std::set<std::string>& stats, BlockStats& blockstats) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
-    const RPCHelpMan help{"getblockstats",
-                "\nCompute per block statistics for a given window. All amounts are in satoshis.\n"
-                "It won't work for some heights with pruning.\n"
-                "It won't work without -txindex for utxo_size_inc, *fee or *feerate stats.\n",
-                {
-                    {"hash_or_height", RPCArg::Type::NUM, RPCArg::Optional::NO, "The block hash or height of the target block", "", {"", "string or numeric"}},
-                    {"stats", RPCArg::Type::ARR, /* default */ "all values", "Values to plot (see result below)",
-                        {
-                            {"height", RPCArg::Type::STR, RPCArg::Optional::OMITTED, "Selected statistic"},
-                            {"time", RPCArg::Type::STR, RPCArg::Optional::OMITTED, "Selected statistic"},
-                        },
-                        "stats"},
-                },
-                RPCResult{
-            "{                           (json object)\n"
-            "  \"avgfee\": xxxxx,          (numeric) Average fee in the block\n"
-            "  \"avgfeerate\": xxxxx,      (numeric) Average feerate (in satoshis per virtual byte)\n"
-            "  \"avgtxsize\": xxxxx,       (numeric) Average transaction size\n"
-            "  \"blockhash\": xxxxx,       (string) The block hash (to check for potential reorgs)\n"
-            "  \"feerate_percentiles\": [  (array of numeric) Feerates at the 10th, 25th, 50th, 75th, and 90th percentile weight unit (in satoshis per virtual byte)\n"
-            "      \"10th_percentile_feerate\",      (numeric) The 10th percentile feerate\n"
-            "      \"25th_percentile_feerate\",      (numeric) The 25th percentile feerate\n"
-            "      \"50th_percentile_feerate\",      (numeric) The 50th percentile feerate\n"
-            "      \"75th_percentile_feerate\",      (numeric) The 75th percentile feerate\n"
-            "      \"90th_percentile_feerate\",      (numeric) The 90th percentile feerate\n"
-            "  ],\n"
-            "  \"height\": xxxxx,          (numeric) The height of the block\n"
-            "  \"ins\": xxxxx,             (numeric) The number of inputs (excluding coinbase)\n"
-            "  \"maxfee\": xxxxx,          (numeric) Maximum fee in the block\n"
-            "  \"maxfeerate\": xxxxx,      (numeric) Maximum feerate (in satoshis per virtual byte)\n"
-            "  \"maxtxsize\": xxxxx,       (numeric) Maximum transaction size\n"
-            "  \"medianfee\": xxxxx,       (numeric) Truncated median fee in the block\n"
-            "  \"mediantime\": xxxxx,      (numeric) The block median time past\n"
-            "  \"mediantxsize\": xxxxx,    (numeric) Truncated median transaction size\n"
-            "  \"minfee\": xxxxx,          (numeric) Minimum fee in the block\n"
-            "  \"minfeerate\": xxxxx,      (numeric) Minimum feerate (in satoshis per virtual byte)\n"
-            "  \"mintxsize\": xxxxx,       (numeric) Minimum transaction size\n"
-            "  \"outs\": xxxxx,            (numeric) The number of outputs\n"
-            "  \"subsidy\": xxxxx,         (numeric) The block subsidy\n"
-            "  \"swtotal_size\": xxxxx,    (numeric) Total size of all segwit transactions\n"
-            "  \"swtotal_weight\": xxxxx,  (numeric) Total weight of all segwit transactions divided by segwit scale factor (4)\n"
-            "  \"swtxs\": xxxxx,           (numeric) The number of segwit transactions\n"
-            "  \"time\": xxxxx,            (numeric) The block time\n"
-            "  \"total_out\": xxxxx,       (numeric) Total amount in all outputs (excluding coinbase and thus reward [ie subsidy + totalfee])\n"
-            "  \"total_size\": xxxxx,      (numeric) Total size of all non-coinbase transactions\n"
-            "  \"total_weight\": xxxxx,    (numeric) Total weight of all non-coinbase transactions divided by segwit scale factor (4)\n"
-            "  \"totalfee\": xxxxx,        (numeric) The fee total\n"
-            "  \"txs\": xxxxx,             (numeric) The number of transactions (excluding coinbase)\n"
-            "  \"utxo_increase\": xxxxx,   (numeric) The increase/decrease in the number of unspent outputs\n"
-            "  \"utxo_size_inc\": xxxxx,   (numeric) The increase/decrease in size for the utxo index (not discounting op_return and similar)\n"
-            "}\n"
-                },
-                RPCExamples{
-                    HelpExampleCli("getblockstats", "1000 '[\"minfeerate\",\"avgfeerate\"]'")
-            + HelpExampleRpc("getblockstats", "1000 '[\"minfeerate\",\"avgfeerate\"]'")
-                },
-    };
-    if (request.fHelp || !help.IsValidNumArgs(request.params.size())) {
-        throw std::runtime_error(help.ToString());
-    }
-
-    LOCK(cs_main);
-
-    CBlockIndex* pindex;
-    if (request.params[0].isNum()) {
-        const int height = request.params[0].get_int();
-        const int current_tip = chainActive.Height();
-        if (height < 0) {
-            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Target block height %d is negative", height));
-        }
-        if (height > current_tip) {
-            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Target block height %d after current tip %d", height, current_tip));
-        }
-
-        pindex = chainActive[height];
-    } else {
-        const uint256 hash(ParseHashV(request.params[0], "hash_or_height"));
-        pindex = LookupBlockIndex(hash);
-        if (!pindex) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
-        }
-        if (!chainActive.Contains(pindex)) {
-            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Block is not in chain %s", Params().NetworkIDString()));
-        }
-    }
-
-    assert(pindex != nullptr);
-
-    std::set<std::string> stats;
-    if (!request.params[1].isNull()) {
-        const UniValue stats_univalue = request.params[1].get_array();
-        for (unsigned int i = 0; i < stats_univalue.size(); i++) {
-            const std::string stat = stats_univalue[i].get_str();
-            stats.insert(stat);
-        }
-    }
-
     const CBlock block = GetBlockChecked(pindex);
 
     const bool do_all = stats.size() == 0; // Calculate everything if nothing selected (default)
@@ -3178,8 +4363,13 @@ static UniValue getblockstats(const JSONRPCRequest& request)
     std::vector<std::pair<CAmount, int64_t>> feerate_array;
     std::vector<int64_t> txsize_array;
 
+    int64_t contracttxs = 0;
+
     for (const auto& tx : block.vtx) {
         outputs += tx->vout.size();
+        if (tx->HasCreateOrCall()) {
+            ++contracttxs;
+        }
 
         CAmount tx_total_out = 0;
         if (loop_outputs) {
@@ -3257,43 +4447,196 @@ static UniValue getblockstats(const JSONRPCRequest& request)
     CAmount feerate_percentiles[NUM_GETBLOCKSTATS_PERCENTILES] = { 0 };
     CalculatePercentilesByWeight(feerate_percentiles, feerate_array, total_weight);
 
+    uint64_t gasused = 0;
+    if (do_all || stats.count("gasused") != 0) {
+        CBlockUndo blockundo;
+        if (pindex->nHeight > 0 && !UndoReadFromDisk(blockundo, pindex)) {
+            throw JSONRPCError(RPC_MISC_ERROR, "Can't read undo data from disk");
+        }
+        BlockReceipts receipts;
+        if (!ReadBlockReceipts(block, pindex, blockundo, receipts)) {
+            throw JSONRPCError(RPC_MISC_ERROR, "Can't get the receipts of the block");
+        }
+        for (const auto& entry : receipts) {
+            for (const TransactionReceiptInfo& receipt : entry.second) {
+                gasused += receipt.gasUsed;
+            }
+        }
+    }
+
+    blockstats.totalfee = totalfee;
+    blockstats.minfee = (minfee == MAX_MONEY) ? 0 : minfee;
+    blockstats.maxfee = maxfee;
+    blockstats.medianfee = CalculateTruncatedMedian(fee_array);
+    blockstats.minfeerate = (minfeerate == MAX_MONEY) ? 0 : minfeerate;
+    blockstats.maxfeerate = maxfeerate;
+    blockstats.feerate_percentiles.assign(feerate_percentiles, feerate_percentiles + NUM_GETBLOCKSTATS_PERCENTILES);
+    blockstats.total_out = total_out;
+    blockstats.ins = inputs;
+    blockstats.outs = outputs;
+    blockstats.txs = block.vtx.size();
+    blockstats.total_size = total_size;
+    blockstats.total_weight = total_weight;
+    blockstats.mintxsize = mintxsize == dgpMaxBlockSerSize ? 0 : mintxsize;
+    blockstats.maxtxsize = maxtxsize;
+    blockstats.mediantxsize = CalculateTruncatedMedian(txsize_array);
+    blockstats.swtxs = swtxs;
+    blockstats.swtotal_size = swtotal_size;
+    blockstats.swtotal_weight = swtotal_weight;
+    blockstats.utxo_size_inc = utxo_size_inc;
+    blockstats.contracttxs = contracttxs;
+    blockstats.gasused = gasused;
+}
+
+static UniValue getblockstats(const JSONRPCRequest& request)
+{
+    const RPCHelpMan help{"getblockstats",
+                "\nCompute per block statistics for a given window. All amounts are in satoshis.\n"
+                "It won't work for some heights with pruning.\n"
+                "It won't work without -txindex for utxo_size_inc, *fee or *feerate stats, unless -blockstatsindex is enabled.\n"
+                "With -blockstatsindex the statistics are read from the index instead of being computed from the block.\n",
+                {
+                    {"hash_or_height", RPCArg::Type::NUM, RPCArg::Optional::NO, "The block hash or height of the target block", "", {"", "string or numeric"}},
+                    {"stats", RPCArg::Type::ARR, /* default */ "all values", "Values to plot (see result below)",
+                        {
+                            {"height", RPCArg::Type::STR, RPCArg::Optional::OMITTED, "Selected statistic"},
+                            {"time", RPCArg::Type::STR, RPCArg::Optional::OMITTED, "Selected statistic"},
+                        },
+                        "stats"},
+                },
+                RPCResult{
+            "{                           (json object)\n"
+            "  \"avgfee\": xxxxx,          (numeric) Average fee in the block\n"
+            "  \"avgfeerate\": xxxxx,      (numeric) Average feerate (in satoshis per virtual byte)\n"
+            "  \"avgtxsize\": xxxxx,       (numeric) Average transaction size\n"
+            "  \"blockhash\": xxxxx,       (string) The block hash (to check for potential reorgs)\n"
+            "  \"contracttxs\": xxxxx,     (numeric) The number of transactions that create or call contracts\n"
+            "  \"feerate_percentiles\": [  (array of numeric) Feerates at the 10th, 25th, 50th, 75th, and 90th percentile weight unit (in satoshis per virtual byte)\n"
+            "      \"10th_percentile_feerate\",      (numeric) The 10th percentile feerate\n"
+            "      \"25th_percentile_feerate\",      (numeric) The 25th percentile feerate\n"
+            "      \"50th_percentile_feerate\",      (numeric) The 50th percentile feerate\n"
+            "      \"75th_percentile_feerate\",      (numeric) The 75th percentile feerate\n"
+            "      \"90th_percentile_feerate\",      (numeric) The 90th percentile feerate\n"
+            "  ],\n"
+            "  \"gasused\": xxxxx,         (numeric) The gas used by the contract executions of the block\n"
+            "  \"height\": xxxxx,          (numeric) The height of the block\n"
+            "  \"ins\": xxxxx,             (numeric) The number of inputs (excluding coinbase)\n"
+            "  \"maxfee\": xxxxx,          (numeric) Maximum fee in the block\n"
+            "  \"maxfeerate\": xxxxx,      (numeric) Maximum feerate (in satoshis per virtual byte)\n"
+            "  \"maxtxsize\": xxxxx,       (numeric) Maximum transaction size\n"
+            "  \"medianfee\": xxxxx,       (numeric) Truncated median fee in the block\n"
+            "  \"mediantime\": xxxxx,      (numeric) The block median time past\n"
+            "  \"mediantxsize\": xxxxx,    (numeric) Truncated median transaction size\n"
+            "  \"minfee\": xxxxx,          (numeric) Minimum fee in the block\n"
+            "  \"minfeerate\": xxxxx,      (numeric) Minimum feerate (in satoshis per virtual byte)\n"
+            "  \"mintxsize\": xxxxx,       (numeric) Minimum transaction size\n"
+            "  \"outs\": xxxxx,            (numeric) The number of outputs\n"
+            "  \"subsidy\": xxxxx,         (numeric) The block subsidy\n"
+            "  \"swtotal_size\": xxxxx,    (numeric) Total size of all segwit transactions\n"
+            "  \"swtotal_weight\": xxxxx,  (numeric) Total weight of all segwit transactions divided by segwit scale factor (4)\n"
+            "  \"swtxs\": xxxxx,           (numeric) The number of segwit transactions\n"
+            "  \"time\": xxxxx,            (numeric) The block time\n"
+            "  \"total_out\": xxxxx,       (numeric) Total amount in all outputs (excluding coinbase and thus reward [ie subsidy + totalfee])\n"
+            "  \"total_size\": xxxxx,      (numeric) Total size of all non-coinbase transactions\n"
+            "  \"total_weight\": xxxxx,    (numeric) Total weight of all non-coinbase transactions divided by segwit scale factor (4)\n"
+            "  \"totalfee\": xxxxx,        (numeric) The fee total\n"
+            "  \"txs\": xxxxx,             (numeric) The number of transactions (excluding coinbase)\n"
+            "  \"utxo_increase\": xxxxx,   (numeric) The increase/decrease in the number of unspent outputs\n"
+            "  \"utxo_size_inc\": xxxxx,   (numeric) The increase/decrease in size for the utxo index (not discounting op_return and similar)\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getblockstats", "1000 '[\"minfeerate\",\"avgfeerate\"]'")
+            + HelpExampleRpc("getblockstats", "1000 '[\"minfeerate\",\"avgfeerate\"]'")
+                },
+    };
+    if (request.fHelp || !help.IsValidNumArgs(request.params.size())) {
+        throw std::runtime_error(help.ToString());
+    }
+
+    if (g_blockstatsindex) g_blockstatsindex->BlockUntilSyncedToCurrentChain();
+
+    LOCK(cs_main);
+
+    CBlockIndex* pindex;
+    if (request.params[0].isNum()) {
+        const int height = request.params[0].get_int();
+        const int current_tip = chainActive.Height();
+        if (height < 0) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Target block height %d is negative", height));
+        }
+        if (height > current_tip) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Target block height %d after current tip %d", height, current_tip));
+        }
+
+        pindex = chainActive[height];
+    } else {
+        const uint256 hash(ParseHashV(request.params[0], "hash_or_height"));
+        pindex = LookupBlockIndex(hash);
+        if (!pindex) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        }
+        if (!chainActive.Contains(pindex)) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Block is not in chain %s", Params().NetworkIDString()));
+        }
+    }
+
+    assert(pindex != nullptr);
+
+    std::set<std::string> stats;
+    if (!request.params[1].isNull()) {
+        const UniValue stats_univalue = request.params[1].get_array();
+        for (unsigned int i = 0; i < stats_univalue.size(); i++) {
+            const std::string stat = stats_univalue[i].get_str();
+            stats.insert(stat);
+        }
+    }
+
+    BlockStats blockstats;
+    if (!g_blockstatsindex || !g_blockstatsindex->LookupStats(pindex, blockstats)) {
+        ComputeSelectedBlockStats(pindex, stats, blockstats);
+    }
+
     UniValue feerates_res(UniValue::VARR);
-    for (int64_t i = 0; i < NUM_GETBLOCKSTATS_PERCENTILES; i++) {
-        feerates_res.push_back(feerate_percentiles[i]);
+    for (const CAmount feerate : blockstats.feerate_percentiles) {
+        feerates_res.push_back(feerate);
     }
 
+    const int64_t txs = blockstats.txs;
     UniValue ret_all(UniValue::VOBJ);
-    ret_all.pushKV("avgfee", (block.vtx.size() > 1) ? totalfee / (block.vtx.size() - 1) : 0);
-    ret_all.pushKV("avgfeerate", total_weight ? (totalfee * WITNESS_SCALE_FACTOR) / total_weight : 0); // Unit: sat/vbyte
-    ret_all.pushKV("avgtxsize", (block.vtx.size() > 1) ? total_size / (block.vtx.size() - 1) : 0);
+    ret_all.pushKV("avgfee", (txs > 1) ? blockstats.totalfee / (txs - 1) : 0);
+    ret_all.pushKV("avgfeerate", blockstats.total_weight ? (blockstats.totalfee * WITNESS_SCALE_FACTOR) / blockstats.total_weight : 0); // Unit: sat/vbyte
+    ret_all.pushKV("avgtxsize", (txs > 1) ? blockstats.total_size / (txs - 1) : 0);
     ret_all.pushKV("blockhash", pindex->GetBlockHash().GetHex());
+    ret_all.pushKV("contracttxs", blockstats.contracttxs);
     ret_all.pushKV("feerate_percentiles", feerates_res);
+    ret_all.pushKV("gasused", blockstats.gasused);
     ret_all.pushKV("height", (int64_t)pindex->nHeight);
-    ret_all.pushKV("ins", inputs);
-    ret_all.pushKV("maxfee", maxfee);
-    ret_all.pushKV("maxfeerate", maxfeerate);
-    ret_all.pushKV("maxtxsize", maxtxsize);
-    ret_all.pushKV("medianfee", CalculateTruncatedMedian(fee_array));
+    ret_all.pushKV("ins", blockstats.ins);
+    ret_all.pushKV("maxfee", blockstats.maxfee);
+    ret_all.pushKV("maxfeerate", blockstats.maxfeerate);
+    ret_all.pushKV("maxtxsize", blockstats.maxtxsize);
+    ret_all.pushKV("medianfee", blockstats.medianfee);
     ret_all.pushKV("mediantime", pindex->GetMedianTimePast());
-    ret_all.pushKV("mediantxsize", CalculateTruncatedMedian(txsize_array));
-    ret_all.pushKV("minfee", (minfee == MAX_MONEY) ? 0 : minfee);
-    ret_all.pushKV("minfeerate", (minfeerate == MAX_MONEY) ? 0 : minfeerate);
-    ret_all.pushKV("mintxsize", mintxsize == dgpMaxBlockSerSize ? 0 : mintxsize);
-    ret_all.pushKV("outs", outputs);
+    ret_all.pushKV("mediantxsize", blockstats.mediantxsize);
+    ret_all.pushKV("minfee", blockstats.minfee);
+    ret_all.pushKV("minfeerate", blockstats.minfeerate);
+    ret_all.pushKV("mintxsize", blockstats.mintxsize);
+    ret_all.pushKV("outs", blockstats.outs);
     ret_all.pushKV("subsidy", GetBlockSubsidy(pindex->nHeight, Params().GetConsensus()));
-    ret_all.pushKV("swtotal_size", swtotal_size);
-    ret_all.pushKV("swtotal_weight", swtotal_weight);
-    ret_all.pushKV("swtxs", swtxs);
+    ret_all.pushKV("swtotal_size", blockstats.swtotal_size);
+    ret_all.pushKV("swtotal_weight", blockstats.swtotal_weight);
+    ret_all.pushKV("swtxs", blockstats.swtxs);
     ret_all.pushKV("time", pindex->GetBlockTime());
-    ret_all.pushKV("total_out", total_out);
-    ret_all.pushKV("total_size", total_size);
-    ret_all.pushKV("total_weight", total_weight);
-    ret_all.pushKV("totalfee", totalfee);
-    ret_all.pushKV("txs", (int64_t)block.vtx.size());
-    ret_all.pushKV("utxo_increase", outputs - inputs);
-    ret_all.pushKV("utxo_size_inc", utxo_size_inc);
-
-    if (do_all) {
+    ret_all.pushKV("total_out", blockstats.total_out);
+    ret_all.pushKV("total_size", blockstats.total_size);
+    ret_all.pushKV("total_weight", blockstats.total_weight);
+    ret_all.pushKV("totalfee", blockstats.totalfee);
+    ret_all.pushKV("txs", txs);
+    ret_all.pushKV("utxo_increase", blockstats.outs - blockstats.ins);
+    ret_all.pushKV("utxo_size_inc", blockstats.utxo_size_inc);
+
+    if (stats.empty()) {
         return ret_all;
     }
 
@@ -3334,6 +4677,139 @@ static UniValue savemempool(const JSONRPCRequest& request)
     return NullUniValue;
 }
 
+static UniValue StateSnapshotToJSON(const StateSnapshotHeader& header, const StateSnapshotStats& stats)
+{
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("blockhash", header.hashBlock.GetHex());
+    result.pushKV("height", header.nHeight);
+    result.pushKV("hashStateRoot", header.hashStateRoot.GetHex());
+    result.pushKV("hashUTXORoot", header.hashUTXORoot.GetHex());
+    result.pushKV("state_entries", (uint64_t)stats.nStateEntries);
+    result.pushKV("utxo_entries", (uint64_t)stats.nUTXOEntries);
+    result.pushKV("aux_entries", (uint64_t)stats.nAuxEntries);
+    return result;
+}
+
+static const std::string STATE_SNAPSHOT_RESULT =
+            "{\n"
+            "  \"blockhash\": \"hex\",       (string) the block whose contract state the snapshot holds\n"
+            "  \"height\": n,               (numeric) the height of the block\n"
+            "  \"hashStateRoot\": \"hex\",   (string) the EVM state root of the block\n"
+            "  \"hashUTXORoot\": \"hex\",    (string) the contract UTXO root of the block\n"
+            "  \"state_entries\": n,        (numeric) number of state trie nodes, storage trie nodes and bytecodes\n"
+            "  \"utxo_entries\": n,         (numeric) number of contract UTXO trie nodes\n"
+            "  \"aux_entries\": n           (numeric) number of key preimages (addresses and storage slots) of both tries\n"
+            "}\n";
+
+static UniValue dumpcontractstate(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2) {
+        throw std::runtime_error(
+            RPCHelpMan{"dumpcontractstate",
+                "\nWrites the contract state (EVM state and contract UTXO tries, with the bytecode and the key\n"
+                "preimages) of a block to a snapshot file, which loadcontractstate can import on another node.\n"
+                "The coins and the blocks are not included: a snapshot restores the contract state of a block\n"
+                "on a node that has its chain, it does not bootstrap a node.\n",
+                {
+                    {"filename", RPCArg::Type::STR, RPCArg::Optional::NO, "The snapshot file (must not exist yet)"},
+                    {"blockhash", RPCArg::Type::STR_HEX, /* default */ "the tip", "The block whose state is dumped; with -prunestate, a block of the active chain within the kept window"},
+                },
+                RPCResult{STATE_SNAPSHOT_RESULT},
+                RPCExamples{
+                    HelpExampleCli("dumpcontractstate", "\"state.dat\"")
+            + HelpExampleRpc("dumpcontractstate", "\"state.dat\"")
+                },
+            }.ToString());
+    }
+
+    fs::path path = fs::absolute(request.params[0].get_str());
+    if (fs::exists(path)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, path.string() + " already exists");
+    }
+
+    const CBlockIndex* pindex;
+    std::unique_ptr<StateRootsPin> pin;
+    {
+        LOCK(cs_main);
+        if (request.params[1].isNull()) {
+            pindex = chainActive.Tip();
+        } else {
+            pindex = LookupBlockIndex(ParseHashV(request.params[1], "blockhash"));
+            if (!pindex || !pindex->IsValid(BLOCK_VALID_SCRIPTS)) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found or not validated");
+            }
+        }
+        // Keep -prunestate from deleting the state while it is written
+        if (!IsContractStateAvailable(pindex))
+            throw JSONRPCError(RPC_MISC_ERROR, strprintf("The contract state of block %d was pruned (-prunestate)", pindex->nHeight));
+        pin.reset(new StateRootsPin(StateRoots(uintToh256(pindex->hashStateRoot), uintToh256(pindex->hashUTXORoot))));
+    }
+
+    fs::path temppath = path.string() + ".incomplete";
+    CAutoFile file(fsbridge::fopen(temppath, "wb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Couldn't open file " + temppath.string() + " for writing");
+    }
+
+    StateSnapshotStats stats;
+    try {
+        stats = WriteStateSnapshot(file, *globalState, pindex);
+        if (!FileCommit(file.Get()))
+            throw std::runtime_error("FileCommit failed");
+        file.fclose();
+        fs::rename(temppath, path);
+    } catch (const std::exception& e) {
+        file.fclose();
+        fs::remove(temppath);
+        throw JSONRPCError(RPC_MISC_ERROR, strprintf("Unable to dump contract state: %s", e.what()));
+    }
+
+    StateSnapshotHeader header;
+    header.hashBlock = pindex->GetBlockHash();
+    header.nHeight = pindex->nHeight;
+    header.hashStateRoot = pindex->hashStateRoot;
+    header.hashUTXORoot = pindex->hashUTXORoot;
+    return StateSnapshotToJSON(header, stats);
+}
+
+static UniValue loadcontractstate(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1) {
+        throw std::runtime_error(
+            RPCHelpMan{"loadcontractstate",
+                "\nImports a snapshot written by dumpcontractstate into the contract state databases.\n"
+                "The roots of the snapshot must match the block with the same hash in the header chain,\n"
+                "and every imported entry is stored under its own hash, so the snapshot needs no trust\n"
+                "beyond the header chain. Entries are only added, existing state is never modified.\n"
+                "Only the contract state is imported, not the coins. With -prunestate, the state of a block\n"
+                "outside the kept window is deleted again by the next pruning run.\n",
+                {
+                    {"filename", RPCArg::Type::STR, RPCArg::Optional::NO, "The snapshot file"},
+                },
+                RPCResult{STATE_SNAPSHOT_RESULT},
+                RPCExamples{
+                    HelpExampleCli("loadcontractstate", "\"state.dat\"")
+            + HelpExampleRpc("loadcontractstate", "\"state.dat\"")
+                },
+            }.ToString());
+    }
+
+    fs::path path = fs::absolute(request.params[0].get_str());
+    CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Couldn't open file " + path.string() + " for reading");
+    }
+
+    StateSnapshotHeader header;
+    StateSnapshotStats stats;
+    try {
+        stats = ReadStateSnapshot(file, *globalState, header);
+    } catch (const std::exception& e) {
+        throw JSONRPCError(RPC_MISC_ERROR, strprintf("Unable to load contract state: %s", e.what()));
+    }
+    return StateSnapshotToJSON(header, stats);
+}
+
 //! Search for a given set of pubkey scripts
 bool FindScriptPubKey(std::atomic<int>& scan_progress, const std::atomic<bool>& should_abort, int64_t& count, CCoinsViewCursor* cursor, const std::set<CScript>& needles, std::map<COutPoint, Coin>& out_results) {
     scan_progress = 0;
@@ -3562,6 +5038,86 @@ UniValue scantxoutset(const JSONRPCRequest& request)
     return result;
 }
 
+static UniValue getblockfilter(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2) {
+        throw std::runtime_error(
+            RPCHelpMan{"getblockfilter",
+                "\nRetrieve a BIP 157 content filter for a particular block.\n",
+                {
+                    {"blockhash", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The hash of the block"},
+                    {"filtertype", RPCArg::Type::STR, /*default*/ "basic", "The type name of the filter (" + ListBlockFilterTypes() + ")"},
+                },
+                RPCResult{
+            "{\n"
+            "  \"filter\" : (string) the hex-encoded filter data\n"
+            "  \"header\" : (string) the hex-encoded filter header\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\" \"basic\"")
+            + HelpExampleCli("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\" \"contract\"")
+                }
+            }.ToString()
+        );
+    }
+
+    uint256 block_hash = ParseHashV(request.params[0], "blockhash");
+    std::string filtertype_name = "basic";
+    if (!request.params[1].isNull()) {
+        filtertype_name = request.params[1].get_str();
+    }
+
+    BlockFilterType filtertype;
+    if (!BlockFilterTypeByName(filtertype_name, filtertype)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown filtertype");
+    }
+
+    BlockFilterIndex* index = GetBlockFilterIndex(filtertype);
+    if (!index) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Index is not enabled for filtertype " + filtertype_name);
+    }
+
+    const CBlockIndex* block_index;
+    bool block_was_connected;
+    {
+        LOCK(cs_main);
+        block_index = LookupBlockIndex(block_hash);
+        if (!block_index) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        }
+        block_was_connected = block_index->IsValid(BLOCK_VALID_SCRIPTS);
+    }
+
+    bool index_ready = index->BlockUntilSyncedToCurrentChain();
+
+    BlockFilter filter;
+    uint256 filter_header;
+    if (!index->LookupFilter(block_index, filter) ||
+        !index->LookupFilterHeader(block_index, filter_header)) {
+        int err_code;
+        std::string errmsg = "Filter not found.";
+
+        if (!block_was_connected) {
+            err_code = RPC_INVALID_ADDRESS_OR_KEY;
+            errmsg += " Block was not connected to active chain.";
+        } else if (!index_ready) {
+            err_code = RPC_MISC_ERROR;
+            errmsg += " Block filters are still in the process of being indexed.";
+        } else {
+            err_code = RPC_INTERNAL_ERROR;
+            errmsg += " This error is unexpected and indicates index corruption.";
+        }
+
+        throw JSONRPCError(err_code, errmsg);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("filter", HexStr(filter.GetEncodedFilter()));
+    ret.pushKV("header", filter_header.GetHex());
+    return ret;
+}
+
 // clang-format off
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
@@ -3582,17 +5138,29 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         {} },
     { "blockchain",         "getrawmempool",          &getrawmempool,          {"verbose"} },
     { "blockchain",         "gettxout",               &gettxout,               {"txid","n","include_mempool"} },
-    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {} },
+    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {"hash_type"} },
     { "blockchain",         "pruneblockchain",        &pruneblockchain,        {"height"} },
     { "blockchain",         "savemempool",            &savemempool,            {} },
+    { "blockchain",         "dumpcontractstate",      &dumpcontractstate,      {"filename","blockhash"} },
+    { "blockchain",         "loadcontractstate",      &loadcontractstate,      {"filename"} },
     { "blockchain",         "verifychain",            &verifychain,            {"checklevel","nblocks"} },
-    { "blockchain",         "getaccountinfo",         &getaccountinfo,         {"contract_address"} },
+    { "blockchain",         "verifycontractstate",    &verifycontractstate,    {"blockhash","nthreads"} },
+    { "blockchain",         "getaccountinfo",         &getaccountinfo,         {"contract_address","storage"} },
+    { "blockchain",         "getcontractprofile",     &getcontractprofile,     {"count","reset"} },
+    { "blockchain",         "getvalidationstats",     &getvalidationstats,     {"reset"} },
+    { "blockchain",         "getblockvalidationtimes", &getblockvalidationtimes, {"count","txids"} },
     { "blockchain",         "getcontractcode",        &getcontractcode,        {"address", "blockNum"} },
     { "blockchain",         "getstorage",             &getstorage,             {"address, index, blockNum"} },
+    { "blockchain",         "liststorage",            &liststorage,            {"address","blockNum","start","count"} },
+    { "blockchain",         "getstorageproof",        &getstorageproof,        {"address","slot","blockNum"} },
+    { "blockchain",         "getstatediff",           &getstatediff,           {"blockhash","verbose"} },
     { "blockchain",         "preciousblock",          &preciousblock,          {"blockhash"} },
     { "blockchain",         "scantxoutset",           &scantxoutset,           {"action", "scanobjects"} },
+    { "blockchain",         "getblockfilter",         &getblockfilter,         {"blockhash", "filtertype"} },
 
     { "blockchain",         "callcontract",           &callcontract,           {"address","data", "senderAddress", "gasLimit"} },
+    { "blockchain",         "callcontractbatch",      &callcontractbatch,      {"calls","blockNum"} },
+    { "blockchain",         "estimategas",            &estimategas,            {"address","data","senderAddress","amount"} },
     /* Not shown in help */
     { "hidden",             "invalidateblock",        &invalidateblock,        {"blockhash"} },
     { "hidden",             "reconsiderblock",        &reconsiderblock,        {"blockhash"} },
@@ -3602,9 +5170,12 @@ static const CRPCCommand commands[] =
     { "hidden",             "syncwithvalidationinterfacequeue", &syncwithvalidationinterfacequeue, {} },
     { "blockchain",         "listcontracts",          &listcontracts,          {"start", "maxDisplay"} },
     { "blockchain",         "listallcontracts",       &listallcontracts,       {"height"} },
+    { "blockchain",         "getcontractinfo",        &getcontractinfo,        {"address"} },
+    { "blockchain",         "listcontractsbycodehash", &listcontractsbycodehash, {"codehash"} },
     { "blockchain",         "gettransactionreceipt",  &gettransactionreceipt,  {"hash"} },
     { "blockchain",         "searchlogs",             &searchlogs,             {"fromBlock", "toBlock", "address", "topics"} },
     { "blockchain",         "getblocktransactionreceipts",  &getblocktransactionreceipts,  {"hash"} },
+    { "blockchain",         "getcontractaddresstxs",  &getcontractaddresstxs,  {"address", "fromBlock", "toBlock"} },
 
     { "blockchain",         "waitforlogs",            &waitforlogs,            {"fromBlock", "nblocks", "address", "topics"} },
     { "blockchain",         "getestimatedannualroi",  &getestimatedannualroi,  {} },
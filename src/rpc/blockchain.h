@@ -5,16 +5,22 @@
 #ifndef BITCOIN_RPC_BLOCKCHAIN_H
 #define BITCOIN_RPC_BLOCKCHAIN_H
 
+#include <algorithm>
 #include <vector>
 #include <stdint.h>
 #include <amount.h>
+#include <primitives/transaction.h>
 
 class CBlock;
 class CBlockIndex;
 class UniValue;
+struct StageTimes;
 
 static constexpr int NUM_GETBLOCKSTATS_PERCENTILES = 5;
 
+// outpoint (needed for the utxo index) + nHeight + fCoinBase
+static constexpr size_t PER_UTXO_OVERHEAD = sizeof(COutPoint) + sizeof(uint32_t) + sizeof(bool);
+
 /**
  * Get the difficulty of the net wrt to the given block index.
  *
@@ -23,6 +29,9 @@ static constexpr int NUM_GETBLOCKSTATS_PERCENTILES = 5;
  */
 double GetDifficulty(const CBlockIndex* blockindex);
 
+/** Difficulty of a block target, as GetDifficulty computes it */
+double GetDifficulty(uint32_t nBits);
+
 /** Callback for when block tip changed. */
 void RPCNotifyBlockChange(bool ibd, const CBlockIndex *);
 
@@ -38,6 +47,26 @@ UniValue mempoolToJSON(bool fVerbose = false);
 /** Block header to JSON */
 UniValue blockheaderToJSON(const CBlockIndex* tip, const CBlockIndex* blockindex);
 
+/** Durations of a stage to JSON, in milliseconds, with the VALIDATION_STATS_BUCKETS histogram */
+UniValue StageTimesToJSON(const StageTimes& times);
+
+/** Used by getblockstats to get the median of the fees and of the transaction sizes */
+template<typename T>
+T CalculateTruncatedMedian(std::vector<T>& scores)
+{
+    size_t size = scores.size();
+    if (size == 0) {
+        return 0;
+    }
+
+    std::sort(scores.begin(), scores.end());
+    if (size % 2 == 0) {
+        return (scores[size / 2 - 1] + scores[size / 2]) / 2;
+    } else {
+        return scores[size / 2];
+    }
+}
+
 /** Used by getblockstats to get feerates at different percentiles by weight  */
 void CalculatePercentilesByWeight(CAmount result[NUM_GETBLOCKSTATS_PERCENTILES], std::vector<std::pair<CAmount, int64_t>>& scores, int64_t total_weight);
 
@@ -92,6 +92,10 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "searchlogs", 1, "toBlock"},
     { "searchlogs", 2, "address"},
     { "searchlogs", 3, "topics"},
+    { "getcontractaddresstxs", 1, "fromBlock"},
+    { "getcontractaddresstxs", 2, "toBlock"},
+    { "getstakerblocks", 1, "fromBlock"},
+    { "getstakerblocks", 2, "toBlock"},
     { "waitforlogs", 0, "fromBlock"},
     { "waitforlogs", 1, "txlimit"},
     { "waitforlogs", 2, "address"},
@@ -156,6 +160,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "importmulti", 1, "options" },
     { "verifychain", 0, "checklevel" },
     { "verifychain", 1, "nblocks" },
+    { "verifycontractstate", 1, "nthreads" },
     { "getblockstats", 0, "hash_or_height" },
     { "getblockstats", 1, "stats" },
     { "pruneblockchain", 0, "height" },
@@ -164,6 +169,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "estimatesmartfee", 0, "conf_target" },
     { "estimaterawfee", 0, "conf_target" },
     { "estimaterawfee", 1, "threshold" },
+    { "estimategasprice", 0, "conf_target" },
     { "prioritisetransaction", 1, "dummy" },
     { "prioritisetransaction", 2, "fee_delta" },
     { "setban", 2, "bantime" },
@@ -174,6 +180,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "bumpfee", 1, "options" },
     { "logging", 0, "include" },
     { "logging", 1, "exclude" },
+    { "getlockstats", 0, "reset" },
     { "disconnectnode", 1, "nodeid" },
     { "createcontract", 1, "gasLimit" },
     { "createcontract", 2, "gasPrice" },
@@ -186,14 +193,27 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "sendtocontract", 7, "changeToSender" },
     { "callcontract", 3, "gasLimit" },
     { "callcontract", 4, "blockNum" },
+    { "callcontractbatch", 0, "calls" },
+    { "callcontractbatch", 1, "blockNum" },
+    { "estimategas", 3, "amount" },
     { "reservebalance", 0, "reserve"},
     { "reservebalance", 1, "amount"},
     { "listcontracts", 0, "start" },
     { "listcontracts", 1, "maxDisplay" },
     { "listallcontracts", 0, "height" },
     { "getcontractcode", 1, "blockNum" },
+    { "getcontractprofile", 0, "count" },
+    { "getcontractprofile", 1, "reset" },
+    { "getvalidationstats", 0, "reset" },
+    { "getblockvalidationtimes", 0, "count" },
+    { "getblockvalidationtimes", 1, "txids" },
     { "getstorage", 2, "index" },
     { "getstorage", 1, "blockNum" },
+    { "liststorage", 1, "blockNum" },
+    { "liststorage", 3, "count" },
+    { "getstorageproof", 2, "blockNum" },
+    { "getstatediff", 1, "verbose" },
+    { "getaccountinfo", 1, "storage" },
     // Echo with conversion (For testing only)
     { "echojson", 0, "arg0" },
     { "echojson", 1, "arg1" },
@@ -21,7 +21,9 @@
 #include <rpc/server.h>
 #include <rpc/util.h>
 #include <shutdown.h>
+#include <stakingstats.h>
 #include <txmempool.h>
+#include <util/memory.h>
 #include <util/strencodings.h>
 #include <util/system.h>
 #include <validation.h>
@@ -226,6 +228,7 @@ static UniValue getmininginfo(const JSONRPCRequest& request)
                     "  \"blocks\": nnn,             (numeric) The current block\n"
                     "  \"currentblockweight\": nnn, (numeric, optional) The block weight of the last assembled block (only present if a block was ever assembled)\n"
                     "  \"currentblocktx\": nnn,     (numeric, optional) The number of block transactions of the last assembled block (only present if a block was ever assembled)\n"
+                    "  \"skippedcontracts\": [\"txid\",...], (array, optional) Contract transactions of the last assembled block skipped because their expected execution time exceeded the remaining time (only present if a block was ever assembled)\n"
                     "  \"difficulty\": xxx.xxxxx    (numeric) The current difficulty\n"
                     "  \"networkhashps\": nnn,      (numeric) The network hashes per second\n"
                     "  \"pooledtx\": n              (numeric) The size of the mempool\n"
@@ -249,6 +252,12 @@ static UniValue getmininginfo(const JSONRPCRequest& request)
     obj.pushKV("blocks",           (int)chainActive.Height());
     if (BlockAssembler::m_last_block_weight) obj.pushKV("currentblockweight", *BlockAssembler::m_last_block_weight);
     if (BlockAssembler::m_last_block_num_txs) obj.pushKV("currentblocktx", *BlockAssembler::m_last_block_num_txs);
+    if (BlockAssembler::m_last_block_skipped_contracts) {
+        UniValue skipped(UniValue::VARR);
+        for (const uint256& txid : *BlockAssembler::m_last_block_skipped_contracts)
+            skipped.push_back(txid.GetHex());
+        obj.pushKV("skippedcontracts", skipped);
+    }
 
     uint64_t nWeight = 0;
     uint64_t lastCoinStakeSearchInterval = 0;
@@ -305,6 +314,27 @@ static UniValue getstakinginfo(const JSONRPCRequest& request)
                            "  \"weight\": \"xxxx\",         (numeric) \n"
                            "  \"netstakeweight\": \"...\"   (numeric) \n"
                            "  \"expectedtime\": \"...\"     (numeric) Expected time to earn reward\n"
+                           "  \"stakingstats\": {            (json object) Staker activity since startup, for all wallets\n"
+                           "    \"slots\": n,                 (numeric) Timestamp slots searched for a kernel\n"
+                           "    \"kernels\": n,               (numeric) Kernel hashes evaluated\n"
+                           "    \"kernelspersec\": x.xxx,     (numeric) Kernel hashes evaluated per second of search\n"
+                           "    \"events\": {                 (json object) Outcomes of the kernels found\n"
+                           "      \"signed\": n,              (numeric) Full blocks signed\n"
+                           "      \"accepted\": n,            (numeric) Blocks accepted by the node\n"
+                           "      \"rejected\": n,            (numeric) Blocks refused by the node\n"
+                           "      \"orphaned\": n,            (numeric) Stakes dropped for a competing tip\n"
+                           "      \"expired\": n              (numeric) Blocks that took too long to create\n"
+                           "    },\n"
+                           "    \"stages\": {                 (json object) Durations by stage: search, sign, createblock, contracts, slottosigned\n"
+                           "      \"name\": {\n"
+                           "        \"count\": n,             (numeric) Number of samples\n"
+                           "        \"total_ms\": x.xxx,      (numeric) Total duration in milliseconds\n"
+                           "        \"avg_ms\": x.xxx,        (numeric) Average duration in milliseconds\n"
+                           "        \"max_ms\": x.xxx,        (numeric) Maximum duration in milliseconds\n"
+                           "        \"histogram\": [n,...]    (array) Samples per bucket, as in getvalidationstats\n"
+                           "      }, ...\n"
+                           "    }\n"
+                           "  }\n"
                            "}\n"
                        },
                 RPCExamples{
@@ -313,23 +343,31 @@ static UniValue getstakinginfo(const JSONRPCRequest& request)
                 },
             }.ToString());
 
-    LOCK(cs_main);
+    const std::shared_ptr<const ChainTipSnapshot> tip = GetChainTipSnapshot();
 
     uint64_t nWeight = 0;
     uint64_t lastCoinStakeSearchInterval = 0;
+    uint64_t nNetworkWeight = 0;
+    Optional<int64_t> nLastBlockTxs;
+    {
+        // The weights and the last assembled block are not part of the tip snapshot
+        LOCK(cs_main);
 #ifdef ENABLE_WALLET
-    std::shared_ptr<CWallet> const wallet = GetWalletForJSONRPCRequest(request);
-    CWallet* const pwallet = wallet.get();
+        std::shared_ptr<CWallet> const wallet = GetWalletForJSONRPCRequest(request);
+        CWallet* const pwallet = wallet.get();
 
-    if (pwallet)
-    {
-        auto locked_chain = pwallet->chain().lock();
-        nWeight = pwallet->GetStakeWeight(*locked_chain);
-        lastCoinStakeSearchInterval = pwallet->m_enabled_staking ? pwallet->m_last_coin_stake_search_interval : 0;
-    }
+        if (pwallet)
+        {
+            auto locked_chain = pwallet->chain().lock();
+            nWeight = pwallet->GetStakeWeight(*locked_chain);
+            lastCoinStakeSearchInterval = pwallet->m_enabled_staking ? pwallet->m_last_coin_stake_search_interval : 0;
+        }
 #endif
 
-    uint64_t nNetworkWeight = GetPoSKernelPS();
+        nNetworkWeight = GetPoSKernelPS();
+        nLastBlockTxs = BlockAssembler::m_last_block_num_txs;
+    }
+
     bool staking = lastCoinStakeSearchInterval && nWeight;
     const Consensus::Params& consensusParams = Params().GetConsensus();
     int64_t nTargetSpacing = consensusParams.nPowTargetSpacing;
@@ -341,10 +379,10 @@ static UniValue getstakinginfo(const JSONRPCRequest& request)
     obj.pushKV("staking", staking);
     obj.pushKV("errors", GetWarnings("statusbar"));
 
-    if (BlockAssembler::m_last_block_num_txs) obj.pushKV("currentblocktx", *BlockAssembler::m_last_block_num_txs);
+    if (nLastBlockTxs) obj.pushKV("currentblocktx", *nLastBlockTxs);
     obj.pushKV("pooledtx", (uint64_t)mempool.size());
 
-    obj.pushKV("difficulty", GetDifficulty(GetLastBlockIndex(pindexBestHeader, true)));
+    obj.pushKV("difficulty", GetDifficulty(tip->nPoSBits));
     obj.pushKV("search-interval", (int)lastCoinStakeSearchInterval);
 
     obj.pushKV("weight", (uint64_t)nWeight);
@@ -352,9 +390,82 @@ static UniValue getstakinginfo(const JSONRPCRequest& request)
 
     obj.pushKV("expectedtime", nExpectedTime);
 
+    StakingCounters counters = stakingStats.Get();
+    UniValue stats(UniValue::VOBJ);
+    stats.pushKV("slots", counters.nSlots);
+    stats.pushKV("kernels", counters.nKernels);
+    stats.pushKV("kernelspersec", counters.nSearchTime ? counters.nKernels * 1000000.0 / counters.nSearchTime : 0.0);
+    UniValue events(UniValue::VOBJ);
+    for (size_t i = 0; i < NUM_STAKING_EVENTS; i++)
+        events.pushKV(StakingEventName(static_cast<StakingEventType>(i)), counters.events[i]);
+    stats.pushKV("events", events);
+    UniValue stages(UniValue::VOBJ);
+    for (size_t i = 0; i < NUM_STAKING_STAGES; i++)
+        stages.pushKV(StakingStageName(static_cast<StakingStage>(i)), StageTimesToJSON(counters.stages[i]));
+    stats.pushKV("stages", stages);
+    obj.pushKV("stakingstats", stats);
+
     return obj;
 }
 
+static UniValue getstakerblocks(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 3)
+        throw std::runtime_error(
+            RPCHelpMan{"getstakerblocks",
+                "\nReturns the proof-of-stake blocks of the active chain staked by an address.\n",
+                {
+                    {"address", RPCArg::Type::STR, RPCArg::Optional::NO, "The address of the staker"},
+                    {"fromBlock", RPCArg::Type::NUM, /* default */ "0", "The number of the earliest block"},
+                    {"toBlock", RPCArg::Type::NUM, /* default */ "-1", "The number of the latest block (-1 may be given to mean the most recent block)"},
+                },
+                RPCResult{
+            "{\n"
+            "  \"address\": \"address\",   (string) The address of the staker\n"
+            "  \"blocks\": n,              (numeric) The number of blocks staked in the range\n"
+            "  \"heights\": [n,...]        (array) The heights of the blocks\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getstakerblocks", "\"QM72Sfpbz1BPpXzHh9CVHKsNaPNXbMnPhF\"")
+            + HelpExampleCli("getstakerblocks", "\"QM72Sfpbz1BPpXzHh9CVHKsNaPNXbMnPhF\" 5000 5500")
+            + HelpExampleRpc("getstakerblocks", "\"QM72Sfpbz1BPpXzHh9CVHKsNaPNXbMnPhF\", 5000, 5500")
+                },
+            }.ToString());
+
+    CTxDestination destination = DecodeDestination(request.params[0].get_str());
+    if (!IsValidDestination(destination)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
+    }
+    const CKeyID *keyID = boost::get<CKeyID>(&destination);
+    if (!keyID) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Address does not refer to key");
+    }
+
+    int fromBlock = request.params[1].isNull() ? 0 : request.params[1].get_int();
+    int toBlock = request.params[2].isNull() ? -1 : request.params[2].get_int();
+    if (fromBlock < 0 || toBlock < -1 || (toBlock > -1 && toBlock < fromBlock))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid block range");
+
+    std::vector<unsigned int> heights;
+    {
+        // Hold cs_main so that the index matches the active chain
+        LOCK(cs_main);
+        if (!pblocktree->ReadStakerIndex(uint160(*keyID), fromBlock, toBlock, heights))
+            throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read the staker index");
+    }
+
+    UniValue result(UniValue::VOBJ);
+    UniValue arr(UniValue::VARR);
+    for (unsigned int height : heights)
+        arr.push_back((int)height);
+    result.pushKV("address", EncodeDestination(destination));
+    result.pushKV("blocks", (int)heights.size());
+    result.pushKV("heights", arr);
+
+    return result;
+}
+
 // NOTE: Unlike wallet RPC (which use BTC values), mining RPCs follow GBT (BIP 22) in using satoshi amounts
 static UniValue prioritisetransaction(const JSONRPCRequest& request)
 {
@@ -636,9 +747,12 @@ static UniValue getblocktemplate(const JSONRPCRequest& request)
     static CBlockIndex* pindexPrev;
     static int64_t nStart;
     static std::unique_ptr<CBlockTemplate> pblocktemplate;
+    // Assembler of pblocktemplate, kept to add the packages that arrive while the tip stays the same
+    static std::unique_ptr<BlockAssembler> passembler;
     if (pindexPrev != chainActive.Tip() ||
         (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 5))
     {
+        bool fSameTip = pindexPrev == chainActive.Tip();
         // Clear pindexPrev so future calls make a new block, despite any failures from here on
         pindexPrev = nullptr;
 
@@ -647,11 +761,18 @@ static UniValue getblocktemplate(const JSONRPCRequest& request)
         CBlockIndex* pindexPrevNew = chainActive.Tip();
         nStart = GetTime();
 
-        // Create new block
-        CScript scriptDummy = CScript() << OP_TRUE;
-        pblocktemplate = BlockAssembler(Params()).CreateNewBlock(scriptDummy, true, chainActive.Tip()->nHeight>=Params().GetConsensus().nLastPOWBlock?true:false);
-        if (!pblocktemplate)
+        // Extend the current block, or create a new one
+        if (fSameTip && passembler && pblocktemplate)
+            pblocktemplate = passembler->UpdateBlock(std::move(pblocktemplate));
+        if (!pblocktemplate) {
+            CScript scriptDummy = CScript() << OP_TRUE;
+            passembler = MakeUnique<BlockAssembler>(Params());
+            pblocktemplate = passembler->CreateNewBlock(scriptDummy, true, chainActive.Tip()->nHeight>=Params().GetConsensus().nLastPOWBlock?true:false);
+        }
+        if (!pblocktemplate) {
+            passembler.reset();
             throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
+        }
 
         // Need to update only after we know CreateNewBlock succeeded
         pindexPrev = pindexPrevNew;
@@ -996,6 +1117,56 @@ static UniValue estimatesmartfee(const JSONRPCRequest& request)
     return result;
 }
 
+static UniValue estimategasprice(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            RPCHelpMan{"estimategasprice",
+                "\nEstimates the approximate gas price needed for a contract transaction to begin\n"
+                "confirmation within conf_target blocks if possible and return the number of blocks\n"
+                "for which the estimate is valid.\n",
+                {
+                    {"conf_target", RPCArg::Type::NUM, RPCArg::Optional::NO, "Confirmation target in blocks (1 - " + std::to_string(::feeEstimator.HighestGasPriceTargetTracked()) + ")"},
+                },
+                RPCResult{
+            "{\n"
+            "  \"gasprice\" : x.x,    (numeric, optional) estimate gas price (in KPG)\n"
+            "  \"errors\": [ str... ] (json array of strings, optional) Errors encountered during processing\n"
+            "  \"blocks\" : n         (numeric) block number where estimate was found\n"
+            "}\n"
+            "\n"
+            "The request target will be clamped between 2 and the highest target\n"
+            "gas price estimation is able to return based on how long it has been running.\n"
+            "An error is returned if not enough contract transactions and blocks\n"
+            "have been observed to make an estimate for any number of blocks.\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("estimategasprice", "6")
+                  + HelpExampleRpc("estimategasprice", "6")
+                },
+            }.ToString());
+
+    RPCTypeCheck(request.params, {UniValue::VNUM});
+    int conf_target = request.params[0].get_int();
+    unsigned int max_target = ::feeEstimator.HighestGasPriceTargetTracked();
+    if (conf_target < 1 || (unsigned int)conf_target > max_target) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Invalid conf_target, must be between %u - %u", 1, max_target));
+    }
+
+    UniValue result(UniValue::VOBJ);
+    UniValue errors(UniValue::VARR);
+    int returnedTarget;
+    CAmount nGasPrice = ::feeEstimator.estimateGasPrice(conf_target, &returnedTarget);
+    if (nGasPrice != 0) {
+        result.pushKV("gasprice", ValueFromAmount(nGasPrice));
+    } else {
+        errors.push_back("Insufficient data or no gas price found");
+        result.pushKV("errors", errors);
+    }
+    result.pushKV("blocks", returnedTarget);
+    return result;
+}
+
 static UniValue estimaterawfee(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
@@ -1114,10 +1285,12 @@ static const CRPCCommand commands[] =
 
     { "mining",             "getsubsidy",             &getsubsidy,             {"height"} },
     { "mining",             "getstakinginfo",         &getstakinginfo,         {} },
+    { "mining",             "getstakerblocks",        &getstakerblocks,        {"address", "fromBlock", "toBlock"} },
 
     { "generating",         "generatetoaddress",      &generatetoaddress,      {"nblocks","address","maxtries"} },
 
     { "util",               "estimatesmartfee",       &estimatesmartfee,       {"conf_target", "estimate_mode"} },
+    { "util",               "estimategasprice",       &estimategasprice,       {"conf_target"} },
 
     { "hidden",             "estimaterawfee",         &estimaterawfee,         {"conf_target", "threshold"} },
 };
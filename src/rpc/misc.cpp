@@ -10,13 +10,20 @@
 #include <key_io.h>
 #include <validation.h>
 #include <httpserver.h>
+#ifdef ENABLE_BITCORE_RPC
+#include <index/addressindex.h>
+#endif
 #include <net.h>
 #include <netbase.h>
 #include <outputtype.h>
+#include <qtum/qtumDGP.h>
+#include <qtum/qtumstatecache.h>
+#include <qtum/storageresults.h>
 #include <rpc/blockchain.h>
 #include <rpc/server.h>
 #include <rpc/util.h>
 #include <script/descriptor.h>
+#include <script/sigcache.h>
 #include <timedata.h>
 #ifdef ENABLE_BITCORE_RPC
 #include <txmempool.h>
@@ -157,6 +164,116 @@ bool timestampSort(std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> a,
     return a.second.time < b.second.time;
 }
 
+/** Whether the request asks for a page of results, with the limit of the page */
+static bool getPageLimitFromParams(const UniValue& params, size_t& limit)
+{
+    if (!params[0].isObject())
+        return false;
+    UniValue limitValue = find_value(params[0].get_obj(), "limit");
+    if (limitValue.isNull()) {
+        if (!find_value(params[0].get_obj(), "cursor").isNull()) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Cursor is expected with a limit");
+        }
+        return false;
+    }
+    int nLimit = limitValue.get_int();
+    if (nLimit <= 0) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Limit is expected to be greater than zero");
+    }
+    limit = nLimit;
+    return true;
+}
+
+// The cursor of a page is the position of the address in the addresses of the request and
+// the index key the next page starts from, hex encoded after a tag of the index
+template <typename Key>
+static UniValue encodeAddressCursor(char tag, uint32_t nAddress, const Key& key)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << tag << nAddress << key;
+    return HexStr(ss.begin(), ss.end());
+}
+
+/** Read the cursor of the request into nAddress and key, if any */
+template <typename Key>
+static bool decodeAddressCursor(const UniValue& params, char tag, const std::vector<std::pair<uint256, int> >& addresses, uint32_t& nAddress, Key& key)
+{
+    UniValue cursorValue = find_value(params[0].get_obj(), "cursor");
+    if (cursorValue.isNull())
+        return false;
+    const std::string& str = cursorValue.get_str();
+    if (!IsHex(str)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+    std::vector<unsigned char> data(ParseHex(str));
+    CDataStream ss(data, SER_NETWORK, PROTOCOL_VERSION);
+    char cursorTag;
+    try {
+        ss >> cursorTag >> nAddress >> key;
+    } catch (const std::exception&) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+    // A cursor only goes with the addresses of the request it was returned for
+    if (cursorTag != tag || !ss.empty() || nAddress >= addresses.size() ||
+        (int)key.type != addresses[nAddress].second || key.hashBytes != addresses[nAddress].first) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+    return true;
+}
+
+/** Read a page of the address index entries of addresses, address by address in index order,
+ *  and return the cursor of the next page, null after the last one */
+static UniValue getAddressIndexPage(const UniValue& params, const std::vector<std::pair<uint256, int> >& addresses,
+                                    size_t limit, int start, int end,
+                                    std::vector<std::pair<CAddressIndexKey, CAmount> >& addressIndex)
+{
+    uint32_t nAddress = 0;
+    CAddressIndexKey cursor;
+    if (!decodeAddressCursor(params, 'a', addresses, nAddress, cursor)) {
+        if (addresses.empty())
+            return NullUniValue;
+        cursor = CAddressIndexKey(addresses[0].second, addresses[0].first, start, 0, uint256(), 0, false);
+    }
+
+    while (addressIndex.size() < limit) {
+        if (!GetAddressIndexPage(cursor, limit - addressIndex.size(), end, addressIndex)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+        if (!cursor.hashBytes.IsNull())
+            break;
+        if (++nAddress == addresses.size())
+            return NullUniValue;
+        cursor = CAddressIndexKey(addresses[nAddress].second, addresses[nAddress].first, start, 0, uint256(), 0, false);
+    }
+    return encodeAddressCursor('a', nAddress, cursor);
+}
+
+/** Read a page of the unspent outputs of addresses, address by address in index order,
+ *  and return the cursor of the next page, null after the last one */
+static UniValue getAddressUnspentPage(const UniValue& params, const std::vector<std::pair<uint256, int> >& addresses,
+                                      size_t limit, std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& unspentOutputs)
+{
+    uint32_t nAddress = 0;
+    CAddressUnspentKey cursor;
+    if (!decodeAddressCursor(params, 'u', addresses, nAddress, cursor)) {
+        if (addresses.empty())
+            return NullUniValue;
+        cursor = CAddressUnspentKey(addresses[0].second, addresses[0].first, uint256(), 0);
+    }
+
+    while (unspentOutputs.size() < limit) {
+        if (!GetAddressUnspentPage(cursor, limit - unspentOutputs.size(), unspentOutputs)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+        if (!cursor.hashBytes.IsNull())
+            break;
+        if (++nAddress == addresses.size())
+            return NullUniValue;
+        cursor = CAddressUnspentKey(addresses[nAddress].second, addresses[nAddress].first, uint256(), 0);
+    }
+    return encodeAddressCursor('u', nAddress, cursor);
+}
+
 bool getAddressFromIndex(const int &type, const uint256 &hash, std::string &address)
 {
     if (type == 2) {
@@ -193,6 +310,8 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
                         {"start", RPCArg::Type::NUM, RPCArg::Optional::OMITTED_NAMED_ARG, "The start block height"},
                         {"end", RPCArg::Type::NUM, RPCArg::Optional::OMITTED_NAMED_ARG, "The end block height"},
                         {"chainInfo", RPCArg::Type::BOOL, RPCArg::Optional::OMITTED_NAMED_ARG, "Include chain info in results, only applies if start and end specified"},
+                        {"limit", RPCArg::Type::NUM, RPCArg::Optional::OMITTED_NAMED_ARG, "Return the results by pages of about this many index entries, address by address in index order"},
+                        {"cursor", RPCArg::Type::STR, RPCArg::Optional::OMITTED_NAMED_ARG, "The cursor returned with the previous page, for the next one"},
                     }
                 }
             },
@@ -206,15 +325,26 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
         "    \"address\"  (string) The KPG address\n"
         "  }\n"
         "]\n"
+        "\nResult, with a limit:\n"
+        "{\n"
+        "  \"deltas\"  (array) The deltas of the page, as above\n"
+        "  \"cursor\"  (string) The cursor of the next page, null after the last one\n"
+        "}\n"
             },
             RPCExamples{
                 HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"]}'")
         + HelpExampleRpc("getaddressdeltas", "{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"]}") +
                 HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"], \"start\": 5000, \"end\": 5500, \"chainInfo\": true}'")
-        + HelpExampleRpc("getaddressdeltas", "{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"], \"start\": 5000, \"end\": 5500, \"chainInfo\": true}")
+        + HelpExampleRpc("getaddressdeltas", "{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"], \"start\": 5000, \"end\": 5500, \"chainInfo\": true}") +
+                HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"], \"limit\": 1000}'")
             },
         }.ToString());
 
+    // Allow the address index to catch up before it is queried.
+    if (g_addressindex) {
+        g_addressindex->BlockUntilSyncedToCurrentChain();
+    }
+
 
     UniValue startValue = find_value(request.params[0].get_obj(), "start");
     UniValue endValue = find_value(request.params[0].get_obj(), "end");
@@ -247,15 +377,18 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
 
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
 
-    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
+    size_t limit = 0;
+    bool fPaged = getPageLimitFromParams(request.params, limit);
+    UniValue cursor;
+    if (fPaged) {
+        cursor = getAddressIndexPage(request.params, addresses, limit, start, end, addressIndex);
+    } else if (start > 0 && end > 0) {
+        if (!GetMergedAddressIndex(addresses, addressIndex, start, end)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+    } else {
+        if (!GetMergedAddressIndex(addresses, addressIndex)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
     }
 
@@ -301,7 +434,14 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
         result.pushKV("deltas", deltas);
         result.pushKV("start", startInfo);
         result.pushKV("end", endInfo);
+        if (fPaged) {
+            result.pushKV("cursor", cursor);
+        }
 
+        return result;
+    } else if (fPaged) {
+        result.pushKV("deltas", deltas);
+        result.pushKV("cursor", cursor);
         return result;
     } else {
         return deltas;
@@ -324,6 +464,9 @@ UniValue getaddressbalance(const JSONRPCRequest& request)
             "{\n"
             "  \"balance\"  (string) The current balance in satoshis\n"
             "  \"received\"  (string) The total number of satoshis received (including change)\n"
+            "  \"immature\"  (string) The number of satoshis of the stakes that are not mature yet\n"
+            "  \"txcount\"  (numeric) The number of transactions of the addresses, counted once per address\n"
+            "  \"lastheight\"  (numeric) The height of the last block with a transaction of the addresses\n"
             "}\n"
                 },
                 RPCExamples{
@@ -332,37 +475,51 @@ UniValue getaddressbalance(const JSONRPCRequest& request)
                 },
             }.ToString());
 
+    // Allow the address index to catch up before it is queried.
+    if (g_addressindex) {
+        g_addressindex->BlockUntilSyncedToCurrentChain();
+    }
+
     std::vector<std::pair<uint256, int> > addresses;
 
     if (!getAddressesFromParams(request.params, addresses)) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-        }
-    }
-
     CAmount balance = 0;
     CAmount received = 0;
     CAmount immature = 0;
+    uint64_t txCount = 0;
+    int lastHeight = 0;
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        if (it->second > 0) {
-            received += it->second;
+    // Only the entries of the last COINBASE_MATURITY blocks can be immature
+    int nHeight = chainActive.Height();
+    int nImmatureStart = std::max(1, nHeight - COINBASE_MATURITY + 1);
+
+    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+        CAddressSummary summary;
+        std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+        if (!GetAddressSummary((*it).first, (*it).second, summary) ||
+            (nHeight > 0 && !GetAddressIndex((*it).first, (*it).second, addressIndex, nImmatureStart, nHeight))) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+        balance += summary.balance;
+        received += summary.received;
+        txCount += summary.txCount;
+        lastHeight = std::max(lastHeight, summary.lastHeight);
+
+        for (const std::pair<CAddressIndexKey, CAmount>& entry : addressIndex) {
+            if (entry.first.txindex == 1)
+                immature += entry.second; //immature stake outputs
         }
-        balance += it->second;
-        if (it->first.txindex == 1 && ((chainActive.Height() - it->first.blockHeight) < COINBASE_MATURITY))
-            immature += it->second; //immature stake outputs
     }
 
     UniValue result(UniValue::VOBJ);
     result.pushKV("balance", balance);
     result.pushKV("received", received);
     result.pushKV("immature", immature);
+    result.pushKV("txcount", txCount);
+    result.pushKV("lastheight", lastHeight);
 
     return result;
 }
@@ -382,6 +539,8 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
                                 }
                             },
                             {"chainInfo", RPCArg::Type::BOOL, RPCArg::Optional::OMITTED_NAMED_ARG, "Include chain info with results"},
+                            {"limit", RPCArg::Type::NUM, RPCArg::Optional::OMITTED_NAMED_ARG, "Return the results by pages of about this many outputs, address by address in index order instead of by height"},
+                            {"cursor", RPCArg::Type::STR, RPCArg::Optional::OMITTED_NAMED_ARG, "The cursor returned with the previous page, for the next one"},
                         }
                     }
                 },
@@ -396,15 +555,26 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
             "    \"satoshis\"  (number) The number of satoshis of the output\n"
             "  }\n"
             "]\n"
+            "\nResult, with a limit:\n"
+            "{\n"
+            "  \"utxos\"  (array) The outputs of the page, as above\n"
+            "  \"cursor\"  (string) The cursor of the next page, null after the last one\n"
+            "}\n"
                 },
                 RPCExamples{
                     HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"]}'")
             + HelpExampleRpc("getaddressutxos", "{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"]}") +
                     HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"], \"chainInfo\": true}'")
-            + HelpExampleRpc("getaddressutxos", "{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"], \"chainInfo\": true}")
+            + HelpExampleRpc("getaddressutxos", "{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"], \"chainInfo\": true}") +
+                    HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"], \"limit\": 1000}'")
                 },
             }.ToString());
 
+    // Allow the address index to catch up before it is queried.
+    if (g_addressindex) {
+        g_addressindex->BlockUntilSyncedToCurrentChain();
+    }
+
     bool includeChainInfo = false;
     if (request.params[0].isObject()) {
         UniValue chainInfo = find_value(request.params[0].get_obj(), "chainInfo");
@@ -421,13 +591,20 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
 
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
 
-    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressUnspent((*it).first, (*it).second, unspentOutputs)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+    size_t limit = 0;
+    bool fPaged = getPageLimitFromParams(request.params, limit);
+    UniValue cursor;
+    if (fPaged) {
+        cursor = getAddressUnspentPage(request.params, addresses, limit, unspentOutputs);
+    } else {
+        for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+            if (!GetAddressUnspent((*it).first, (*it).second, unspentOutputs)) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            }
         }
-    }
 
-    std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
+        std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
+    }
 
     UniValue utxos(UniValue::VARR);
 
@@ -448,13 +625,17 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
         utxos.push_back(output);
     }
 
-    if (includeChainInfo) {
+    if (includeChainInfo || fPaged) {
         UniValue result(UniValue::VOBJ);
         result.pushKV("utxos", utxos);
-
-        LOCK(cs_main);
-        result.pushKV("hash", chainActive.Tip()->GetBlockHash().GetHex());
-        result.pushKV("height", (int)chainActive.Height());
+        if (fPaged) {
+            result.pushKV("cursor", cursor);
+        }
+        if (includeChainInfo) {
+            LOCK(cs_main);
+            result.pushKV("hash", chainActive.Tip()->GetBlockHash().GetHex());
+            result.pushKV("height", (int)chainActive.Height());
+        }
         return result;
     } else {
         return utxos;
@@ -566,6 +747,11 @@ UniValue getblockhashes(const JSONRPCRequest& request)
                 },
             }.ToString());
 
+    // Allow the address index to catch up before it is queried.
+    if (g_addressindex) {
+        g_addressindex->BlockUntilSyncedToCurrentChain();
+    }
+
     unsigned int high = request.params[0].get_int();
     unsigned int low = request.params[1].get_int();
     bool fActiveOnly = false;
@@ -586,9 +772,6 @@ UniValue getblockhashes(const JSONRPCRequest& request)
 
     std::vector<std::pair<uint256, unsigned int> > blockHashes;
 
-    if (fActiveOnly)
-        LOCK(cs_main);
-
     if (!GetTimestampIndex(high, low, fActiveOnly, blockHashes)) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for block hashes");
     }
@@ -636,6 +819,11 @@ UniValue getspentinfo(const JSONRPCRequest& request)
                 },
             }.ToString());
 
+    // Allow the address index to catch up before it is queried.
+    if (g_addressindex) {
+        g_addressindex->BlockUntilSyncedToCurrentChain();
+    }
+
     UniValue txidValue = find_value(request.params[0].get_obj(), "txid");
     UniValue indexValue = find_value(request.params[0].get_obj(), "index");
 
@@ -677,6 +865,8 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
                             },
                             {"start", RPCArg::Type::NUM, RPCArg::Optional::OMITTED_NAMED_ARG, "The start block height"},
                             {"end", RPCArg::Type::NUM, RPCArg::Optional::OMITTED_NAMED_ARG, "The end block height"},
+                            {"limit", RPCArg::Type::NUM, RPCArg::Optional::OMITTED_NAMED_ARG, "Return the results by pages of about this many index entries, address by address in index order"},
+                            {"cursor", RPCArg::Type::STR, RPCArg::Optional::OMITTED_NAMED_ARG, "The cursor returned with the previous page, for the next one"},
                         }
                     }
                 },
@@ -685,15 +875,26 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
             "  \"transactionid\"  (string) The transaction id\n"
             "  ,...\n"
             "]\n"
+            "\nResult, with a limit:\n"
+            "{\n"
+            "  \"txids\"  (array) The txids of the page, once per address\n"
+            "  \"cursor\"  (string) The cursor of the next page, null after the last one\n"
+            "}\n"
                 },
                 RPCExamples{
                     HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"]}'")
             + HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"]}") +
                     HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"], \"start\": 5000, \"end\": 5500}'")
-            + HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"], \"start\": 5000, \"end\": 5500}")
+            + HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"], \"start\": 5000, \"end\": 5500}") +
+                    HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"QD1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XX\"], \"limit\": 1000}'")
                 },
             }.ToString());
 
+    // Allow the address index to catch up before it is queried.
+    if (g_addressindex) {
+        g_addressindex->BlockUntilSyncedToCurrentChain();
+    }
+
     std::vector<std::pair<uint256, int> > addresses;
 
     if (!getAddressesFromParams(request.params, addresses)) {
@@ -713,38 +914,36 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
 
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
 
-    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
+    size_t limit = 0;
+    bool fPaged = getPageLimitFromParams(request.params, limit);
+    UniValue cursor;
+    if (fPaged) {
+        cursor = getAddressIndexPage(request.params, addresses, limit, start, end, addressIndex);
+    } else if (start > 0 && end > 0) {
+        if (!GetMergedAddressIndex(addresses, addressIndex, start, end)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+    } else {
+        if (!GetMergedAddressIndex(addresses, addressIndex)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
     }
 
-    std::set<std::pair<int, std::string> > txids;
+    // The entries are in height order already, the set only drops the txs of several entries
+    std::set<std::pair<int, uint256> > txids;
     UniValue result(UniValue::VARR);
 
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        int height = it->first.blockHeight;
-        std::string txid = it->first.txhash.GetHex();
-
-        if (addresses.size() > 1) {
-            txids.insert(std::make_pair(height, txid));
-        } else {
-            if (txids.insert(std::make_pair(height, txid)).second) {
-                result.push_back(txid);
-            }
+        if (txids.insert(std::make_pair(it->first.blockHeight, it->first.txhash)).second) {
+            result.push_back(it->first.txhash.GetHex());
         }
     }
 
-    if (addresses.size() > 1) {
-        for (std::set<std::pair<int, std::string> >::const_iterator it=txids.begin(); it!=txids.end(); it++) {
-            result.push_back(it->second);
-        }
+    if (fPaged) {
+        UniValue page(UniValue::VOBJ);
+        page.pushKV("txids", result);
+        page.pushKV("cursor", cursor);
+        return page;
     }
 
     return result;
@@ -1091,6 +1290,36 @@ static UniValue RPCLockedMemoryInfo()
     return obj;
 }
 
+static UniValue RPCStateMemoryInfo()
+{
+    size_t nNodeCache = 0, nCodeCache = 0, nAccounts = 0;
+    {
+        LOCK(cs_main);
+        if (globalState) {
+            for (dev::db::DatabaseFace* db : {globalState->diskDb(), globalState->diskDbUtxo()}) {
+                if (const StateNodeCacheDB* cacheDB = dynamic_cast<const StateNodeCacheDB*>(db)) {
+                    nNodeCache += cacheDB->cachedBytes();
+                    nCodeCache += cacheDB->cachedCodeBytes();
+                }
+            }
+            nAccounts = globalState->cacheMemoryUsage();
+        }
+    }
+    size_t nStorageCache = contractStorageCache.DynamicMemoryUsage();
+    size_t nReceipts = pstorageresult ? pstorageresult->DynamicMemoryUsage() : 0;
+    size_t nDGP = QtumDGP::cacheMemoryUsage();
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("nodecache", uint64_t(nNodeCache));
+    obj.pushKV("codecache", uint64_t(nCodeCache));
+    obj.pushKV("storagecache", uint64_t(nStorageCache));
+    obj.pushKV("accounts", uint64_t(nAccounts));
+    obj.pushKV("receipts", uint64_t(nReceipts));
+    obj.pushKV("dgp", uint64_t(nDGP));
+    obj.pushKV("total", uint64_t(nNodeCache + nCodeCache + nStorageCache + nAccounts + nReceipts + nDGP));
+    return obj;
+}
+
 #ifdef HAVE_MALLOC_INFO
 static std::string RPCMallocInfo()
 {
@@ -1110,6 +1339,50 @@ static std::string RPCMallocInfo()
 }
 #endif
 
+static UniValue SignatureCacheStatsToJSON(const SignatureCacheStats& stats)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("lookups", stats.nLookups);
+    obj.pushKV("hits", stats.nHits);
+    obj.pushKV("insertions", stats.nInsertions);
+    obj.pushKV("evictions", stats.nEvictions);
+    obj.pushKV("capacity", (uint64_t)stats.nCapacity);
+    return obj;
+}
+
+static UniValue getsigcacheinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            RPCHelpMan{"getsigcacheinfo",
+                "Returns the counters of the signature cache and of the script execution cache.\n",
+                {},
+                RPCResult{
+            "{\n"
+            "  \"signatures\": {           (json object) The cache of valid signatures\n"
+            "    \"lookups\": n,            (numeric) Signatures looked up\n"
+            "    \"hits\": n,               (numeric) Signatures found valid in the cache\n"
+            "    \"insertions\": n,         (numeric) Signatures added\n"
+            "    \"evictions\": n,          (numeric) Entries dropped from the cache before they were used\n"
+            "    \"capacity\": n            (numeric) Number of entries the cache holds\n"
+            "  },\n"
+            "  \"scripts\": {              (json object) The cache of transactions whose scripts are valid, same fields\n"
+            "    ...\n"
+            "  }\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getsigcacheinfo", "")
+            + HelpExampleRpc("getsigcacheinfo", "")
+                },
+            }.ToString());
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("signatures", SignatureCacheStatsToJSON(GetSignatureCacheStats()));
+    obj.pushKV("scripts", SignatureCacheStatsToJSON(GetScriptExecutionCacheStats()));
+    return obj;
+}
+
 static UniValue getmemoryinfo(const JSONRPCRequest& request)
 {
     /* Please, avoid using the word "pool" here in the RPC interface or help,
@@ -1134,6 +1407,15 @@ static UniValue getmemoryinfo(const JSONRPCRequest& request)
             "    \"locked\": xxxxxx,       (numeric) Amount of bytes that succeeded locking. If this number is smaller than total, locking pages failed at some point and key data could be swapped to disk.\n"
             "    \"chunks_used\": xxxxx,   (numeric) Number allocated chunks\n"
             "    \"chunks_free\": xxxxx,   (numeric) Number unused chunks\n"
+            "  },\n"
+            "  \"state\": {                (json object) Memory used by the contract state caches, in bytes\n"
+            "    \"nodecache\": xxxxx,     (numeric) Trie nodes of the state databases, up to -statenodecache\n"
+            "    \"codecache\": xxxxx,     (numeric) Contract bytecode, up to -contractcodecache\n"
+            "    \"storagecache\": xxxxx,  (numeric) Decoded contract storage of getstorage and callcontract\n"
+            "    \"accounts\": xxxxx,      (numeric) Accounts and vins decoded since the last contract execution\n"
+            "    \"receipts\": xxxxx,      (numeric) Transaction receipts not yet written to disk\n"
+            "    \"dgp\": xxxxx,           (numeric) Memoized governance parameters and gas schedules\n"
+            "    \"total\": xxxxx          (numeric) Sum of the above\n"
             "  }\n"
             "}\n"
                     },
@@ -1151,6 +1433,7 @@ static UniValue getmemoryinfo(const JSONRPCRequest& request)
     if (mode == "stats") {
         UniValue obj(UniValue::VOBJ);
         obj.pushKV("locked", RPCLockedMemoryInfo());
+        obj.pushKV("state", RPCStateMemoryInfo());
         return obj;
     } else if (mode == "mallocinfo") {
 #ifdef HAVE_MALLOC_INFO
@@ -1163,6 +1446,92 @@ static UniValue getmemoryinfo(const JSONRPCRequest& request)
     }
 }
 
+//! Number of call sites returned by getlockstats for each mutex
+static const size_t LOCK_STATS_RPC_SITES = 10;
+
+static UniValue LockHistogramToJSON(const uint64_t (&vHistogram)[LOCK_STATS_BUCKETS])
+{
+    UniValue obj(UniValue::VOBJ);
+    for (int i = 0; i < LOCK_STATS_BUCKETS; i++) {
+        if (vHistogram[i] == 0)
+            continue;
+        if (i < LOCK_STATS_BUCKETS - 1)
+            obj.pushKV(strprintf("<%d", (int64_t)1 << i), vHistogram[i]);
+        else
+            obj.pushKV(strprintf(">=%d", (int64_t)1 << (i - 1)), vHistogram[i]);
+    }
+    return obj;
+}
+
+static UniValue getlockstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 1)
+        throw std::runtime_error(
+            RPCHelpMan{"getlockstats",
+                "Returns the lock contention of cs_main, the mempool, the wallets and the node list, counted since the start or the last reset with -lockstats.\n"
+                "Of a recursive mutex only the outermost lock of a thread counts.\n",
+                {
+                    {"reset", RPCArg::Type::BOOL, /* default */ "false", "Reset the counters after returning them"},
+                },
+                RPCResult{
+            "{\n"
+            "  \"enabled\": true|false,     (boolean) If the locks are counted (-lockstats)\n"
+            "  \"locks\": {                 (json object) By mutex name\n"
+            "    \"name\": {\n"
+            "      \"locks\": n,            (numeric) Number of locks\n"
+            "      \"contended\": n,        (numeric) Number of locks that had to wait\n"
+            "      \"try_failed\": n,       (numeric) Number of failed TRY_LOCKs\n"
+            "      \"wait_us\": n,          (numeric) Total wait in microseconds\n"
+            "      \"hold_us\": n,          (numeric) Total time held in microseconds\n"
+            "      \"wait_histogram\": {...}, (json object) Contended locks by wait, in buckets of microseconds\n"
+            "      \"hold_histogram\": {...}, (json object) Locks by the time held, in buckets of microseconds\n"
+            "      \"sites\": [             (json array) The call sites that waited longest\n"
+            "        {\n"
+            "          \"location\": \"file:line\", (string) The LOCK of the call site\n"
+            "          \"contended\": n,    (numeric) Number of locks that had to wait\n"
+            "          \"wait_us\": n       (numeric) Total wait in microseconds\n"
+            "        }, ...\n"
+            "      ]\n"
+            "    }, ...\n"
+            "  }\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getlockstats", "")
+            + HelpExampleRpc("getlockstats", "true")
+                },
+            }.ToString());
+
+    UniValue locks(UniValue::VOBJ);
+    for (const LockStatsSnapshot& stats : GetLockStatsSnapshot(LOCK_STATS_RPC_SITES)) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("locks", stats.nLocks);
+        obj.pushKV("contended", stats.nContended);
+        obj.pushKV("try_failed", stats.nTryFailed);
+        obj.pushKV("wait_us", stats.nWaitMicros);
+        obj.pushKV("hold_us", stats.nHoldMicros);
+        obj.pushKV("wait_histogram", LockHistogramToJSON(stats.vWaitHistogram));
+        obj.pushKV("hold_histogram", LockHistogramToJSON(stats.vHoldHistogram));
+        UniValue sites(UniValue::VARR);
+        for (const LockSiteStats& site : stats.vSites) {
+            UniValue entry(UniValue::VOBJ);
+            entry.pushKV("location", site.location);
+            entry.pushKV("contended", site.nContended);
+            entry.pushKV("wait_us", site.nWaitMicros);
+            sites.push_back(entry);
+        }
+        obj.pushKV("sites", sites);
+        locks.pushKV(stats.name, obj);
+    }
+    if (!request.params[0].isNull() && request.params[0].get_bool())
+        ResetLockStats();
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("enabled", LockStatsEnabled());
+    ret.pushKV("locks", locks);
+    return ret;
+}
+
 static void EnableOrDisableLogCategories(UniValue cats, bool enable) {
     cats = cats.get_array();
     for (unsigned int i = 0; i < cats.size(); ++i) {
@@ -1274,6 +1643,8 @@ static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
     { "control",            "getmemoryinfo",          &getmemoryinfo,          {"mode"} },
+    { "control",            "getsigcacheinfo",        &getsigcacheinfo,        {} },
+    { "control",            "getlockstats",           &getlockstats,           {"reset"} },
     { "control",            "logging",                &logging,                {"include", "exclude"}},
     { "util",               "validateaddress",        &validateaddress,        {"address"} },
     { "util",               "createmultisig",         &createmultisig,         {"nrequired","keys","address_type"} },
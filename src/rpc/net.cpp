@@ -12,6 +12,7 @@
 #include <net_processing.h>
 #include <netbase.h>
 #include <policy/policy.h>
+#include <rpc/blockchain.h>
 #include <rpc/protocol.h>
 #include <rpc/util.h>
 #include <sync.h>
@@ -110,6 +111,7 @@ static UniValue getpeerinfo(const JSONRPCRequest& request)
             "       n,                        (numeric) The heights of blocks we're currently asking from this peer\n"
             "       ...\n"
             "    ],\n"
+            "    \"inflightlimit\": n,        (numeric) The number of blocks we may be asking from this peer at once\n"
             "    \"whitelisted\": true|false, (boolean) Whether the peer is whitelisted\n"
             "    \"minfeefilter\": n,         (numeric) The minimum fee rate for transactions this peer accepts\n"
             "    \"bytessent_per_msg\": {\n"
@@ -123,6 +125,15 @@ static UniValue getpeerinfo(const JSONRPCRequest& request)
             "                               When a message type is not listed in this json object, the bytes received are 0.\n"
             "                               Only known message types can appear as keys in the object and all bytes received of unknown message types are listed under '"+NET_MESSAGE_COMMAND_OTHER+"'.\n"
             "       ...\n"
+            "    },\n"
+            "    \"processing_per_msg\": {\n"
+            "       \"msg\": {                (object) The processing of the messages received of a type, keyed like bytesrecv_per_msg\n"
+            "         \"count\": n,           (numeric) Number of messages processed\n"
+            "         \"bytes\": n,           (numeric) Their total size\n"
+            "         \"total_ms\": n,        (numeric) Total time spent processing them\n"
+            "         \"max_ms\": n,          (numeric) Longest time spent processing one\n"
+            "         \"cs_main_ms\": n       (numeric) Total time cs_main was held while processing them\n"
+            "       }, ...\n"
             "    }\n"
             "  }\n"
             "  ,...\n"
@@ -183,6 +194,7 @@ static UniValue getpeerinfo(const JSONRPCRequest& request)
                 heights.push_back(height);
             }
             obj.pushKV("inflight", heights);
+            obj.pushKV("inflightlimit", statestats.nBlocksInFlightLimit);
         }
         obj.pushKV("whitelisted", stats.fWhitelisted);
         obj.pushKV("minfeefilter", ValueFromAmount(stats.minFeeFilter));
@@ -201,6 +213,18 @@ static UniValue getpeerinfo(const JSONRPCRequest& request)
         }
         obj.pushKV("bytesrecv_per_msg", recvPerMsgCmd);
 
+        UniValue processingPerMsgCmd(UniValue::VOBJ);
+        for (const auto& i : stats.mapMsgStats) {
+            UniValue msg(UniValue::VOBJ);
+            msg.pushKV("count", i.second.times.nCount);
+            msg.pushKV("bytes", i.second.nBytes);
+            msg.pushKV("total_ms", i.second.times.nTotal * 0.001);
+            msg.pushKV("max_ms", i.second.times.nMax * 0.001);
+            msg.pushKV("cs_main_ms", i.second.nMainHeld * 0.001);
+            processingPerMsgCmd.pushKV(i.first, msg);
+        }
+        obj.pushKV("processing_per_msg", processingPerMsgCmd);
+
         ret.push_back(obj);
     }
 
@@ -373,6 +397,56 @@ static UniValue getaddednodeinfo(const JSONRPCRequest& request)
     return ret;
 }
 
+static UniValue getnetmsgstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 0)
+        throw std::runtime_error(
+            RPCHelpMan{"getnetmsgstats",
+                "\nReturns the processing of the messages received from all peers since startup, by message type.\n"
+                "Use getpeerinfo for the processing of the messages of each connected peer.\n",
+                {},
+                RPCResult{
+            "{\n"
+            "  \"buckets_ms\": [ n, ... ],    (array) upper bounds of the histogram buckets, a last one\n"
+            "                                holds the longer messages\n"
+            "  \"messages\": {\n"
+            "    \"msg\": {                  (object) a message type received since startup, with the\n"
+            "                                unknown ones under '" + NET_MESSAGE_COMMAND_OTHER + "'\n"
+            "      \"count\": n,              (numeric) number of messages processed\n"
+            "      \"bytes\": n,              (numeric) their total size, headers included\n"
+            "      \"total_ms\": n,           (numeric) total time spent processing them\n"
+            "      \"avg_ms\": n,             (numeric) average time per message\n"
+            "      \"max_ms\": n,             (numeric) longest time spent processing one\n"
+            "      \"histogram\": [ n, ... ], (array) number of messages per bucket\n"
+            "      \"cs_main_ms\": n          (numeric) total time cs_main was held while processing them\n"
+            "    }, ...\n"
+            "  }\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getnetmsgstats", "")
+            + HelpExampleRpc("getnetmsgstats", "")
+                },
+            }.ToString());
+
+    UniValue buckets(UniValue::VARR);
+    for (int64_t nBound : VALIDATION_STATS_BUCKETS)
+        buckets.push_back(nBound * 0.001);
+
+    UniValue messages(UniValue::VOBJ);
+    for (const auto& entry : GetNetMsgStats()) {
+        UniValue msg = StageTimesToJSON(entry.second.times);
+        msg.pushKV("bytes", entry.second.nBytes);
+        msg.pushKV("cs_main_ms", entry.second.nMainHeld * 0.001);
+        messages.pushKV(entry.first, msg);
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("buckets_ms", buckets);
+    result.pushKV("messages", messages);
+    return result;
+}
+
 static UniValue getnettotals(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() > 0)
@@ -749,6 +823,7 @@ static const CRPCCommand commands[] =
     { "network",            "disconnectnode",         &disconnectnode,         {"address", "nodeid"} },
     { "network",            "getaddednodeinfo",       &getaddednodeinfo,       {"node"} },
     { "network",            "getnettotals",           &getnettotals,           {} },
+    { "network",            "getnetmsgstats",         &getnetmsgstats,         {} },
     { "network",            "getnetworkinfo",         &getnetworkinfo,         {} },
     { "network",            "setban",                 &setban,                 {"subnet", "command", "bantime", "absolute"} },
     { "network",            "listbanned",             &listbanned,             {} },
@@ -9,6 +9,9 @@
 #include <consensus/tx_verify.h>
 #include <consensus/validation.h>
 #include <core_io.h>
+#ifdef ENABLE_BITCORE_RPC
+#include <index/addressindex.h>
+#endif
 #include <index/txindex.h>
 #include <init.h>
 #include <key_io.h>
@@ -335,6 +338,12 @@ static UniValue getrawtransaction(const JSONRPCRequest& request)
     if (g_txindex && !blockindex) {
         f_txindex_ready = g_txindex->BlockUntilSyncedToCurrentChain();
     }
+#ifdef ENABLE_BITCORE_RPC
+    // The spent info of the verbose output comes from the address index
+    if (g_addressindex && fVerbose) {
+        g_addressindex->BlockUntilSyncedToCurrentChain();
+    }
+#endif
 
     CTransactionRef tx;
     uint256 hash_block;
@@ -2450,6 +2459,7 @@ UniValue analyzepsbt(const JSONRPCRequest& request)
     bool only_missing_sigs = true;
     bool only_missing_final = false;
     CAmount in_amt = 0;
+    const PrecomputedTransactionData txdata = PrecomputePSBTData(psbtx);
     for (unsigned int i = 0; i < psbtx.tx->vin.size(); ++i) {
         PSBTInput& input = psbtx.inputs[i];
         UniValue input_univ(UniValue::VOBJ);
@@ -2474,7 +2484,7 @@ UniValue analyzepsbt(const JSONRPCRequest& request)
 
             // Figure out what is missing
             SignatureData outdata;
-            bool complete = SignPSBTInput(DUMMY_SIGNING_PROVIDER, psbtx, i, 1, &outdata);
+            bool complete = SignPSBTInput(DUMMY_SIGNING_PROVIDER, psbtx, i, 1, &outdata, false, &txdata);
 
             // Things are missing
             if (!complete) {
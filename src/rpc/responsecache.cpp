@@ -0,0 +1,146 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <rpc/responsecache.h>
+
+#include <chain.h>
+#include <rpc/server.h>
+#include <validation.h>
+
+#include <set>
+
+RPCResponseCache g_rpc_response_cache;
+
+/** Key of a call whose result may be cached: the method and its positional parameters */
+static bool GetCacheKey(const JSONRPCRequest& request, std::string& key)
+{
+    static const std::set<std::string> setCachedMethods = {
+        "getblock", "getblockstats", "getblocktransactionreceipts", "gettransactionreceipt",
+    };
+    if (!setCachedMethods.count(request.strMethod) || !request.params.isArray() || request.params.empty())
+        return false;
+    key = request.strMethod + request.params.write();
+    return true;
+}
+
+/** Block the successful result of a cached method is about */
+static const CBlockIndex* GetResultBlock(const JSONRPCRequest& request, const UniValue& result) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    if (request.strMethod == "gettransactionreceipt") {
+        // Unknown and unconfirmed transactions have no receipts
+        if (!result.isArray() || result.empty())
+            return nullptr;
+        const UniValue& hash = find_value(result[0], "blockHash");
+        return hash.isStr() ? LookupBlockIndex(uint256S(hash.get_str())) : nullptr;
+    }
+    const UniValue& param = request.params[0];
+    if (param.isNum())
+        return chainActive[param.get_int()];
+    if (param.isStr())
+        return LookupBlockIndex(uint256S(param.get_str()));
+    return nullptr;
+}
+
+void RPCResponseCache::SetMaxSize(size_t nMaxBytesIn)
+{
+    LOCK(cs);
+    nMaxBytes = nMaxBytesIn;
+    while (nBytes > nMaxBytes)
+        Erase(listEntries.back().first);
+}
+
+void RPCResponseCache::Erase(const std::string& key)
+{
+    auto it = mapEntries.find(key);
+    if (it == mapEntries.end())
+        return;
+    const EntryList::iterator entry = it->second;
+    nBytes -= entry->second.nBytes;
+    mapEntries.erase(it);
+    listEntries.erase(entry);
+}
+
+bool RPCResponseCache::Get(const JSONRPCRequest& request, UniValue& result)
+{
+    std::string key;
+    if (!GetCacheKey(request, key))
+        return false;
+
+    uint256 hashBlock;
+    int nHeight;
+    {
+        LOCK(cs);
+        if (!nMaxBytes)
+            return false;
+        auto it = mapEntries.find(key);
+        if (it == mapEntries.end()) {
+            nMisses++;
+            return false;
+        }
+        listEntries.splice(listEntries.begin(), listEntries, it->second);
+        result = it->second->second.result;
+        hashBlock = it->second->second.hashBlock;
+        nHeight = it->second->second.nHeight;
+    }
+
+    int nConfirmations;
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pindex = chainActive[nHeight];
+        if (!pindex || pindex->GetBlockHash() != hashBlock) {
+            // Reorganized away since the result was cached
+            LOCK(cs);
+            Erase(key);
+            nMisses++;
+            return false;
+        }
+        nConfirmations = chainActive.Height() - nHeight + 1;
+    }
+
+    if (result.isObject() && result.exists("confirmations"))
+        result.pushKV("confirmations", nConfirmations);
+    LOCK(cs);
+    nHits++;
+    return true;
+}
+
+void RPCResponseCache::Add(const JSONRPCRequest& request, const UniValue& result)
+{
+    std::string key;
+    if (!GetCacheKey(request, key))
+        return;
+    {
+        LOCK(cs);
+        if (!nMaxBytes || mapEntries.count(key))
+            return;
+    }
+
+    Entry entry;
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pindex = GetResultBlock(request, result);
+        if (!pindex || !chainActive.Contains(pindex) || chainActive.Height() - pindex->nHeight + 1 < RPC_CACHE_MIN_CONFIRMATIONS)
+            return;
+        entry.hashBlock = pindex->GetBlockHash();
+        entry.nHeight = pindex->nHeight;
+    }
+    entry.nBytes = key.size() + result.write().size();
+    entry.result = result;
+
+    LOCK(cs);
+    // Keep a single result from taking over the cache
+    if (entry.nBytes > nMaxBytes / 4 || mapEntries.count(key))
+        return;
+    listEntries.emplace_front(key, std::move(entry));
+    mapEntries.emplace(key, listEntries.begin());
+    nBytes += listEntries.front().second.nBytes;
+    while (nBytes > nMaxBytes)
+        Erase(listEntries.back().first);
+}
+
+RPCResponseCache::Stats RPCResponseCache::GetStats()
+{
+    LOCK(cs);
+    return Stats{mapEntries.size(), nBytes, nHits, nMisses};
+}
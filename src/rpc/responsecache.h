@@ -0,0 +1,80 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef RPC_RESPONSECACHE_H
+#define RPC_RESPONSECACHE_H
+
+#include <sync.h>
+#include <uint256.h>
+
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include <univalue.h>
+
+class JSONRPCRequest;
+
+/** Default for -rpccachesize, in MiB */
+static const int64_t DEFAULT_RPC_CACHE_SIZE = 32;
+/** Results are cached once the block they are about has this many confirmations */
+static const int RPC_CACHE_MIN_CONFIRMATIONS = 100;
+
+/**
+ * Size bounded LRU cache of the results of RPC calls about a single block of the active
+ * chain: getblock, getblockstats and getblocktransactionreceipts of a block, and
+ * gettransactionreceipt of a confirmed transaction. A result is only added once its
+ * block is RPC_CACHE_MIN_CONFIRMATIONS deep, and a cached result is dropped when its
+ * block is no longer in the active chain at its height, so a reorganization deeper than
+ * that is noticed on the next lookup.
+ */
+class RPCResponseCache
+{
+public:
+    RPCResponseCache() : nMaxBytes(0), nBytes(0), nHits(0), nMisses(0) {}
+
+    /** Set the size of the cache in bytes; 0 disables it */
+    void SetMaxSize(size_t nMaxBytesIn);
+
+    /** Get the cached result of a call, with its confirmations updated */
+    bool Get(const JSONRPCRequest& request, UniValue& result);
+
+    /** Add the result of a call, if it is about a block deep enough in the active chain */
+    void Add(const JSONRPCRequest& request, const UniValue& result);
+
+    struct Stats
+    {
+        size_t nEntries;
+        size_t nBytes;
+        uint64_t nHits;
+        uint64_t nMisses;
+    };
+    Stats GetStats();
+
+private:
+    struct Entry
+    {
+        UniValue result;
+        //! Block the result is about, and its height
+        uint256 hashBlock;
+        int nHeight;
+        size_t nBytes;
+    };
+    typedef std::list<std::pair<std::string, Entry>> EntryList;
+
+    void Erase(const std::string& key) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    Mutex cs;
+    size_t nMaxBytes GUARDED_BY(cs);
+    //! Most recently used entries at the front
+    EntryList listEntries GUARDED_BY(cs);
+    std::unordered_map<std::string, EntryList::iterator> mapEntries GUARDED_BY(cs);
+    size_t nBytes GUARDED_BY(cs);
+    uint64_t nHits GUARDED_BY(cs);
+    uint64_t nMisses GUARDED_BY(cs);
+};
+
+extern RPCResponseCache g_rpc_response_cache;
+
+#endif // RPC_RESPONSECACHE_H
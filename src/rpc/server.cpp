@@ -8,6 +8,8 @@
 #include <fs.h>
 #include <key_io.h>
 #include <random.h>
+#include <rpc/blockchain.h>
+#include <rpc/responsecache.h>
 #include <rpc/util.h>
 #include <shutdown.h>
 #include <sync.h>
@@ -19,7 +21,11 @@
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
 
+#include <atomic>
 #include <memory> // for unique_ptr
+#include <set>
+#include <system_error>
+#include <thread>
 #include <unordered_map>
 
 static CCriticalSection cs_rpcWarmup;
@@ -41,6 +47,7 @@ struct RPCServerInfo
 {
     Mutex mutex;
     std::list<RPCCommandExecutionInfo> active_commands GUARDED_BY(mutex);
+    std::map<std::string, RPCMethodStats> method_stats GUARDED_BY(mutex);
 };
 
 static RPCServerInfo g_rpc_server_info;
@@ -48,18 +55,32 @@ static RPCServerInfo g_rpc_server_info;
 struct RPCCommandExecution
 {
     std::list<RPCCommandExecutionInfo>::iterator it;
+    //! Set when the command throws
+    bool fError = false;
     explicit RPCCommandExecution(const std::string& method)
     {
         LOCK(g_rpc_server_info.mutex);
         it = g_rpc_server_info.active_commands.insert(g_rpc_server_info.active_commands.end(), {method, GetTimeMicros()});
+        g_rpc_server_info.method_stats[method].nInFlight++;
     }
     ~RPCCommandExecution()
     {
         LOCK(g_rpc_server_info.mutex);
+        RPCMethodStats& stats = g_rpc_server_info.method_stats[it->method];
+        stats.nInFlight--;
+        stats.times.Add(GetTimeMicros() - it->start);
+        if (fError)
+            stats.nErrors++;
         g_rpc_server_info.active_commands.erase(it);
     }
 };
 
+std::map<std::string, RPCMethodStats> GetRPCMethodStats()
+{
+    LOCK(g_rpc_server_info.mutex);
+    return g_rpc_server_info.method_stats;
+}
+
 static struct CRPCSignals
 {
     boost::signals2::signal<void ()> Started;
@@ -329,12 +350,94 @@ static UniValue getrpcinfo(const JSONRPCRequest& request)
     return result;
 }
 
+static UniValue getrpcstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 0) {
+        throw std::runtime_error(
+            RPCHelpMan{"getrpcstats",
+                "\nReturns the calls, errors and durations of each RPC method since startup, the\n"
+                "occupancy of the work queue of the HTTP server and the use of the response cache.\n",
+                {},
+                RPCResult{
+            "{\n"
+            "  \"buckets_ms\": [ n, ... ],    (array) upper bounds of the histogram buckets, a last one\n"
+            "                                holds the longer calls\n"
+            "  \"methods\": {\n"
+            "    \"method\": {               (object) a method called since startup\n"
+            "      \"count\": n,              (numeric) number of calls completed\n"
+            "      \"errors\": n,             (numeric) number of calls that returned an error\n"
+            "      \"inflight\": n,           (numeric) number of calls running\n"
+            "      \"total_ms\": n,           (numeric) total time\n"
+            "      \"avg_ms\": n,             (numeric) average time per call\n"
+            "      \"max_ms\": n,             (numeric) longest call\n"
+            "      \"histogram\": [ n, ... ]  (array) number of calls per bucket\n"
+            "    }, ...\n"
+            "  },\n"
+            "  \"workqueue\": {\n"
+            "    \"depth\": n,                (numeric) requests waiting for a worker\n"
+            "    \"maxdepth\": n,             (numeric) -rpcworkqueue, the requests a client may have waiting\n"
+            "    \"clients\": n,              (numeric) clients with requests waiting\n"
+            "    \"busy\": n,                 (numeric) workers handling a request\n"
+            "    \"rejected\": n              (numeric) requests refused because the queue was full\n"
+            "  },\n"
+            "  \"cache\": {\n"
+            "    \"entries\": n,              (numeric) results in the response cache\n"
+            "    \"bytes\": n,                (numeric) size of the cached results\n"
+            "    \"hits\": n,                 (numeric) calls answered from the cache\n"
+            "    \"misses\": n                (numeric) cacheable calls that were executed\n"
+            "  }\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getrpcstats", "")
+                + HelpExampleRpc("getrpcstats", "")},
+            }.ToString()
+        );
+    }
+
+    UniValue buckets(UniValue::VARR);
+    for (int64_t nBound : VALIDATION_STATS_BUCKETS)
+        buckets.push_back(nBound * 0.001);
+
+    UniValue methods(UniValue::VOBJ);
+    for (const auto& entry : GetRPCMethodStats()) {
+        UniValue method = StageTimesToJSON(entry.second.times);
+        method.pushKV("errors", entry.second.nErrors);
+        method.pushKV("inflight", entry.second.nInFlight);
+        methods.pushKV(entry.first, method);
+    }
+
+    const HTTPWorkQueueStats queue = GetHTTPWorkQueueStats();
+    UniValue workqueue(UniValue::VOBJ);
+    workqueue.pushKV("depth", (uint64_t)queue.nDepth);
+    workqueue.pushKV("maxdepth", (uint64_t)queue.nMaxDepth);
+    workqueue.pushKV("clients", (uint64_t)queue.nClients);
+    workqueue.pushKV("busy", (uint64_t)queue.nBusy);
+    workqueue.pushKV("rejected", queue.nRejected);
+
+    const RPCResponseCache::Stats cacheStats = g_rpc_response_cache.GetStats();
+    UniValue cache(UniValue::VOBJ);
+    cache.pushKV("entries", (uint64_t)cacheStats.nEntries);
+    cache.pushKV("bytes", (uint64_t)cacheStats.nBytes);
+    cache.pushKV("hits", cacheStats.nHits);
+    cache.pushKV("misses", cacheStats.nMisses);
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("buckets_ms", buckets);
+    result.pushKV("methods", methods);
+    result.pushKV("workqueue", workqueue);
+    result.pushKV("cache", cache);
+
+    return result;
+}
+
 // clang-format off
 static const CRPCCommand vRPCCommands[] =
 { //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
     /* Overall control/query calls */
     { "control",            "getrpcinfo",             &getrpcinfo,             {}  },
+    { "control",            "getrpcstats",            &getrpcstats,            {}  },
     { "control",            "help",                   &help,                   {"command"}  },
     { "control",            "stop",                   &stop,                   {"wait"}  },
     { "control",            "uptime",                 &uptime,                 {}  },
@@ -462,6 +565,50 @@ void JSONRPCRequest::PollReply(const UniValue& result) {
     req->ChunkEnd();
 }
 
+/** Size of the chunks of a streamed reply */
+static const size_t STREAM_REPLY_CHUNK_SIZE = 1 << 16;
+/** Depth down to which the arrays and objects of a streamed result are written entry by entry */
+static const int STREAM_REPLY_DEPTH = 2;
+
+static void StreamReplyValue(HTTPRequest* req, const UniValue& value, int depth, std::string& buf)
+{
+    if (depth >= STREAM_REPLY_DEPTH || !(value.isArray() || value.isObject())) {
+        buf += value.write();
+        return;
+    }
+
+    const bool fObject = value.isObject();
+    const std::vector<std::string>& keys = value.getKeys();
+    buf += fObject ? '{' : '[';
+    for (size_t i = 0; i < value.size(); i++) {
+        if (i > 0)
+            buf += ',';
+        if (fObject) {
+            buf += UniValue(keys[i]).write();
+            buf += ':';
+        }
+        StreamReplyValue(req, value[i], depth + 1, buf);
+        if (buf.size() >= STREAM_REPLY_CHUNK_SIZE) {
+            req->Chunk(buf);
+            buf.clear();
+        }
+    }
+    buf += fObject ? '}' : ']';
+}
+
+void JSONRPCRequest::StreamReply(const UniValue& result) {
+    assert(!isLongPolling);
+    req->WriteHeader("Content-Type", "application/json");
+    req->WriteHeader("Connection", "close");
+
+    // Same layout as JSONRPCReply
+    std::string buf = "{\"result\":";
+    StreamReplyValue(req, result, 0, buf);
+    buf += ",\"error\":null,\"id\":" + id.write() + "}\n";
+    req->Chunk(buf);
+    req->ChunkEnd();
+}
+
 void JSONRPCRequest::parse(const UniValue& valRequest)
 {
     // Parse request
@@ -525,11 +672,71 @@ static UniValue JSONRPCExecOne(JSONRPCRequest jreq, const UniValue& req)
     return rpc_result;
 }
 
+/** Whether a batch entry calls a read-only method, that may run concurrently with its neighbours */
+static bool IsParallelBatchCall(const UniValue& req)
+{
+    static const std::set<std::string> setParallelMethods = {
+        "getbestblockhash", "getblock", "getblockcount", "getblockfilter", "getblockhash", "getblockheader",
+        "getblocktransactionreceipts", "getcontractaddresstxs", "getrawtransaction", "decoderawtransaction",
+        "getstakerblocks", "gettransactionreceipt", "gettxout", "searchlogs",
+        "getaddressbalance", "getaddressdeltas", "getaddressmempool", "getaddresstxids", "getaddressutxos",
+        "getspentinfo",
+    };
+    if (!req.isObject())
+        return false;
+    const UniValue& method = find_value(req.get_obj(), "method");
+    return method.isStr() && setParallelMethods.count(method.get_str());
+}
+
+/** Execute the entries [begin, end) of a batch on up to -rpcbatchthreads threads */
+static void JSONRPCExecParallel(const JSONRPCRequest& jreq, const UniValue& vReq, size_t begin, size_t end,
+                                std::vector<UniValue>& results)
+{
+    const size_t nThreads = std::min<size_t>(std::max<int64_t>(gArgs.GetArg("-rpcbatchthreads", DEFAULT_RPC_BATCH_THREADS), 1), end - begin);
+    std::atomic<size_t> next(begin);
+    auto work = [&]() {
+        for (size_t reqIdx = next++; reqIdx < end; reqIdx = next++)
+            results[reqIdx] = JSONRPCExecOne(jreq, vReq[reqIdx]);
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < nThreads; i++) {
+        try {
+            threads.emplace_back([&]() {
+                RenameThread("bitcoin-rpcbatch");
+                work();
+            });
+        } catch (const std::system_error& e) {
+            // The calling thread takes the entries the missing threads would have
+            LogPrintf("%s: unable to start a thread: %s\n", __func__, e.what());
+            break;
+        }
+    }
+    work();
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
 std::string JSONRPCExecBatch(JSONRPCRequest jreq, const UniValue& vReq)
 {
+    std::vector<UniValue> results(vReq.size());
+    size_t reqIdx = 0;
+    while (reqIdx < vReq.size()) {
+        size_t runEnd = reqIdx;
+        while (runEnd < vReq.size() && IsParallelBatchCall(vReq[runEnd]))
+            runEnd++;
+        if (runEnd - reqIdx > 1) {
+            JSONRPCExecParallel(jreq, vReq, reqIdx, runEnd, results);
+            reqIdx = runEnd;
+        } else {
+            results[reqIdx] = JSONRPCExecOne(jreq, vReq[reqIdx]);
+            reqIdx++;
+        }
+    }
+
     UniValue ret(UniValue::VARR);
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(jreq, vReq[reqIdx]));
+    for (UniValue& result : results)
+        ret.push_back(std::move(result));
 
     return ret.write() + "\n";
 }
@@ -601,11 +808,21 @@ UniValue CRPCTable::execute(const JSONRPCRequest &request) const
     try
     {
         RPCCommandExecution execution(request.strMethod);
-        // Execute, convert arguments to array if necessary
-        if (request.params.isObject()) {
-            return pcmd->actor(transformNamedArguments(request, pcmd->argNames));
-        } else {
-            return pcmd->actor(request);
+        try {
+            UniValue result;
+            if (g_rpc_response_cache.Get(request, result))
+                return result;
+            // Execute, convert arguments to array if necessary
+            if (request.params.isObject()) {
+                result = pcmd->actor(transformNamedArguments(request, pcmd->argNames));
+            } else {
+                result = pcmd->actor(request);
+            }
+            g_rpc_response_cache.Add(request, result);
+            return result;
+        } catch (...) {
+            execution.fError = true;
+            throw;
         }
     }
     catch (const std::exception& e)
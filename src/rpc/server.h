@@ -17,11 +17,14 @@
 
 #include <univalue.h>
 #include <httpserver.h>
+#include <validationstats.h>
 #include <mutex>
 #include <condition_variable>
 #include <util/system.h>
 
 static const unsigned int DEFAULT_RPC_SERIALIZE_VERSION = 1;
+/** Maximum number of threads the read-only calls of a batch request run on */
+static const int DEFAULT_RPC_BATCH_THREADS = 4;
 
 struct CUpdatedBlock
 {
@@ -101,6 +104,12 @@ public:
      */
     void PollReply(const UniValue& result);
 
+    /**
+     * Send the reply of a large result in chunks, as it is serialized, instead of building
+     * the whole reply first. The connection is closed afterwards.
+     */
+    void StreamReply(const UniValue& result);
+
     void parse(const UniValue& valRequest);
 
 
@@ -261,6 +270,22 @@ extern std::string HelpExampleRpc(const std::string& methodname, const std::stri
 void StartRPC();
 void InterruptRPC();
 void StopRPC();
+/** Calls of an RPC method since startup */
+struct RPCMethodStats
+{
+    StageTimes times;       //!< Durations of the completed calls
+    uint64_t nErrors = 0;   //!< Completed calls that threw
+    uint64_t nInFlight = 0; //!< Calls running
+};
+
+/** Get the statistics of the methods called since startup, by name */
+std::map<std::string, RPCMethodStats> GetRPCMethodStats();
+
+/**
+ * Execute the requests of a batch. Runs of consecutive read-only calls are spread over up to
+ * -rpcbatchthreads threads, the other calls run alone and in order. The replies keep the order
+ * of the requests.
+ */
 std::string JSONRPCExecBatch(JSONRPCRequest jreq, const UniValue& vReq);
 
 // Retrieves any serialization flags requested in command line argument
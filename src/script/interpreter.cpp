@@ -1282,10 +1282,10 @@ uint256 GetOutputsOpSenderHash(const T& txTo)
 } // namespace
 
 template <class T>
-PrecomputedTransactionData::PrecomputedTransactionData(const T& txTo)
+PrecomputedTransactionData::PrecomputedTransactionData(const T& txTo, bool force)
 {
     // Cache is calculated only for transactions with witness or those that have op sender output signature
-    if (txTo.HasWitness() || txTo.HasOpSender()) {
+    if (force || txTo.HasWitness() || txTo.HasOpSender()) {
         hashPrevouts = GetPrevoutHash(txTo);
         hashSequence = GetSequenceHash(txTo);
         hashOutputs = GetOutputsHash(txTo);
@@ -1298,8 +1298,8 @@ PrecomputedTransactionData::PrecomputedTransactionData(const T& txTo)
 }
 
 // explicit instantiation
-template PrecomputedTransactionData::PrecomputedTransactionData(const CTransaction& txTo);
-template PrecomputedTransactionData::PrecomputedTransactionData(const CMutableTransaction& txTo);
+template PrecomputedTransactionData::PrecomputedTransactionData(const CTransaction& txTo, bool force);
+template PrecomputedTransactionData::PrecomputedTransactionData(const CMutableTransaction& txTo, bool force);
 
 template <class T>
 uint256 SignatureHashOutput(const CScript& scriptCode, const T& txTo, unsigned int nOut, int nHashType, const CAmount& amount, SigVersion sigversion, const PrecomputedTransactionData* cache)
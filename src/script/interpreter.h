@@ -134,8 +134,10 @@ struct PrecomputedTransactionData
     uint256 hashPrevouts, hashSequence, hashOutputs, hashOutputsOpSender;
     bool ready = false;
 
+    /** With force, the hashes are also computed for a tx without witness, such as
+     *  the unsigned tx of a PSBT whose witness inputs are yet to be signed */
     template <class T>
-    explicit PrecomputedTransactionData(const T& tx);
+    explicit PrecomputedTransactionData(const T& tx, bool force = false);
 };
 
 enum class SigVersion
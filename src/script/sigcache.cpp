@@ -12,6 +12,10 @@
 #include <util/system.h>
 
 #include <cuckoocache.h>
+
+#include <atomic>
+#include <limits>
+
 #include <boost/thread.hpp>
 
 namespace {
@@ -28,6 +32,9 @@ private:
     typedef CuckooCache::cache<uint256, SignatureCacheHasher> map_type;
     map_type setValid;
     boost::shared_mutex cs_sigcache;
+    std::atomic<uint64_t> nLookups{0};
+    std::atomic<uint64_t> nHits{0};
+    std::atomic<uint64_t> nInsertions{0};
 
 public:
     CSignatureCache()
@@ -45,18 +52,45 @@ public:
     Get(const uint256& entry, const bool erase)
     {
         boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
-        return setValid.contains(entry, erase);
+        ++nLookups;
+        if (!setValid.contains(entry, erase))
+            return false;
+        ++nHits;
+        return true;
     }
 
     void Set(uint256& entry)
     {
         boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        ++nInsertions;
         setValid.insert(entry);
     }
     uint32_t setup_bytes(size_t n)
     {
         return setValid.setup_bytes(n);
     }
+
+    SignatureCacheStats GetStats()
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        SignatureCacheStats stats;
+        stats.nLookups = nLookups;
+        stats.nHits = nHits;
+        stats.nInsertions = nInsertions;
+        stats.nEvictions = setValid.evicted();
+        stats.nCapacity = setValid.capacity();
+        return stats;
+    }
+
+    bool Grow(size_t nMaxBytes)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        const size_t nElems = std::min<size_t>(nMaxBytes / sizeof(uint256), std::numeric_limits<uint32_t>::max() / 2);
+        if (nElems <= setValid.capacity())
+            return false;
+        setValid.resize(std::min<size_t>(nElems, (size_t)setValid.capacity() * 2));
+        return true;
+    }
 };
 
 /* In previous versions of this code, signatureCache was a local static variable
@@ -80,6 +114,16 @@ void InitSignatureCache()
             (nElems*sizeof(uint256)) >>20, (nMaxCacheSize*2)>>20, nElems);
 }
 
+SignatureCacheStats GetSignatureCacheStats()
+{
+    return signatureCache.GetStats();
+}
+
+bool GrowSignatureCache(size_t nMaxBytes)
+{
+    return signatureCache.Grow(nMaxBytes);
+}
+
 bool CachingTransactionSignatureChecker::VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
 {
     uint256 entry;
@@ -16,6 +16,11 @@
 static const unsigned int DEFAULT_MAX_SIG_CACHE_SIZE = 32;
 // Maximum sig cache size allowed
 static const int64_t MAX_MAX_SIG_CACHE_SIZE = 16384;
+// Default for -maxsigcacheadaptive, the MiB the signature and script execution
+// caches may grow to together while they evict entries (0 = fixed size)
+static const int64_t DEFAULT_MAX_SIG_CACHE_ADAPTIVE = 0;
+// Seconds between the checks of the cache evictions with -maxsigcacheadaptive
+static const int64_t SIG_CACHE_ADAPT_INTERVAL = 60;
 
 class CPubKey;
 
@@ -62,6 +67,32 @@ public:
     bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const override;
 };
 
+/** Counters of the signature cache or of the script execution cache */
+struct SignatureCacheStats
+{
+    uint64_t nLookups = 0;
+    uint64_t nHits = 0;
+    uint64_t nInsertions = 0;
+    //! Live entries aged out or dropped for lack of room
+    uint64_t nEvictions = 0;
+    //! Number of entries the cache holds
+    uint32_t nCapacity = 0;
+};
+
+/**
+ * Whether a cache should grow, if it evicted more than a sixteenth of its
+ * capacity since nLastEvictions, at every check.
+ */
+inline bool SignatureCacheShouldGrow(const SignatureCacheStats& stats, uint64_t nLastEvictions)
+{
+    return stats.nEvictions - nLastEvictions > stats.nCapacity / 16;
+}
+
 void InitSignatureCache();
 
+SignatureCacheStats GetSignatureCacheStats();
+
+/** Double the signature cache, up to nMaxBytes, keeping its entries. Returns whether it grew. */
+bool GrowSignatureCache(size_t nMaxBytes);
+
 #endif // BITCOIN_SCRIPT_SIGCACHE_H
@@ -0,0 +1,64 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <stakingstats.h>
+
+#include <validationinterface.h>
+
+StakingStats stakingStats;
+
+const char* StakingStageName(StakingStage stage)
+{
+    switch (stage) {
+    case StakingStage::SEARCH: return "search";
+    case StakingStage::SIGN: return "sign";
+    case StakingStage::CREATE_BLOCK: return "createblock";
+    case StakingStage::CONTRACTS: return "contracts";
+    case StakingStage::SLOT_TO_SIGNED: return "slottosigned";
+    case StakingStage::COUNT: break;
+    }
+    return "unknown";
+}
+
+const char* StakingEventName(StakingEventType type)
+{
+    switch (type) {
+    case StakingEventType::SIGNED: return "signed";
+    case StakingEventType::ACCEPTED: return "accepted";
+    case StakingEventType::REJECTED: return "rejected";
+    case StakingEventType::ORPHANED: return "orphaned";
+    case StakingEventType::EXPIRED: return "expired";
+    }
+    return "unknown";
+}
+
+void StakingStats::AddSlot(uint64_t nKernels, int64_t nMicros)
+{
+    LOCK(cs);
+    ++counters.nSlots;
+    counters.nKernels += nKernels;
+    counters.nSearchTime += nMicros;
+    counters.stages[static_cast<size_t>(StakingStage::SEARCH)].Add(nMicros);
+}
+
+void StakingStats::Add(StakingStage stage, int64_t nMicros)
+{
+    LOCK(cs);
+    counters.stages[static_cast<size_t>(stage)].Add(nMicros);
+}
+
+void StakingStats::AddEvent(const StakingEvent& event)
+{
+    {
+        LOCK(cs);
+        ++counters.events[static_cast<size_t>(event.type)];
+    }
+    GetMainSignals().NewStakingEvent(event);
+}
+
+StakingCounters StakingStats::Get() const
+{
+    LOCK(cs);
+    return counters;
+}
@@ -0,0 +1,88 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef STAKINGSTATS_H
+#define STAKINGSTATS_H
+
+#include <sync.h>
+#include <uint256.h>
+#include <validationstats.h>
+
+#include <array>
+#include <stdint.h>
+
+/** Stages of staking timed by the staker */
+enum class StakingStage
+{
+    SEARCH,         //!< Kernel search over the candidates of all wallets for one slot
+    SIGN,           //!< SignBlock of the empty block once a kernel is found
+    CREATE_BLOCK,   //!< CreateNewBlock of the block to stake, in the staker or the template builder
+    CONTRACTS,      //!< Contract execution within CREATE_BLOCK
+    SLOT_TO_SIGNED, //!< From the start of the search of a slot to the signing of its full block
+    COUNT
+};
+
+/** Name of a stage in getstakinginfo */
+const char* StakingStageName(StakingStage stage);
+
+/** Outcomes of a found kernel, published by -zmqpubstakingevent */
+enum class StakingEventType : uint8_t
+{
+    SIGNED = 0,     //!< The full block was signed
+    ACCEPTED = 1,   //!< CheckStake accepted the block
+    REJECTED = 2,   //!< CheckStake refused the block
+    ORPHANED = 3,   //!< A competing tip arrived before the block was submitted
+    EXPIRED = 4,    //!< The block took too long to create and its timestamp is too early
+};
+
+/** Name of an event type in getstakinginfo */
+const char* StakingEventName(StakingEventType type);
+
+struct StakingEvent
+{
+    StakingEventType type;
+    uint256 hashPrevBlock;
+    //! Null when the full block was not signed yet
+    uint256 hashBlock;
+    //! Timestamp of the slot
+    uint32_t nTime;
+    //! Microseconds since the start of the search of the slot
+    int64_t nElapsed;
+};
+
+static const size_t NUM_STAKING_STAGES = static_cast<size_t>(StakingStage::COUNT);
+static const size_t NUM_STAKING_EVENTS = 5;
+
+struct StakingCounters
+{
+    uint64_t nSlots = 0;
+    uint64_t nKernels = 0;
+    //! Time spent in the kernel searches of the slots, in microseconds
+    int64_t nSearchTime = 0;
+    std::array<uint64_t, NUM_STAKING_EVENTS> events{};
+    std::array<StageTimes, NUM_STAKING_STAGES> stages;
+};
+
+/**
+ * Counters and timings of the staker since startup: the slots searched and the kernels
+ * evaluated in them, what became of the kernels found, and the duration of each stage.
+ * Events are also handed to the validation interface queue for -zmqpubstakingevent.
+ */
+class StakingStats
+{
+public:
+    void AddSlot(uint64_t nKernels, int64_t nMicros);
+    void Add(StakingStage stage, int64_t nMicros);
+    void AddEvent(const StakingEvent& event);
+
+    StakingCounters Get() const;
+
+private:
+    mutable Mutex cs;
+    StakingCounters counters GUARDED_BY(cs);
+};
+
+extern StakingStats stakingStats;
+
+#endif
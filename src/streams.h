@@ -468,6 +468,12 @@ public:
         clear();
     }
 
+    /** Exchange the underlying buffer with d and rewind, so that its allocation can be reused */
+    void SwapBuffer(CSerializeData &d) {
+        vch.swap(d);
+        nReadPos = 0;
+    }
+
     /**
      * XOR the contents of this stream with a certain key.
      *
@@ -0,0 +1,213 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef SUPPORT_ALLOCATORS_POOL_H
+#define SUPPORT_ALLOCATORS_POOL_H
+
+#include <cassert>
+#include <cstddef>
+#include <list>
+#include <new>
+#include <vector>
+
+/**
+ * A memory resource for the nodes of node-based containers like std::unordered_map.
+ *
+ * Memory is taken from the system in large chunks and cut into blocks. Each block size,
+ * a multiple of ELEM_ALIGN_BYTES up to MAX_BLOCK_SIZE_BYTES, has a free list that
+ * deallocated blocks are pushed on and allocations are popped from, so allocating and
+ * freeing a node is a few pointer operations instead of a malloc call, and nodes do not
+ * carry the per-allocation overhead of malloc. Larger requests (such as the bucket array
+ * of an unordered_map) go to ::operator new.
+ *
+ * Chunks are only given back when the resource is destroyed: a container that shrinks
+ * keeps its memory for the next insertions. Not thread safe.
+ */
+template <std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+class PoolResource final
+{
+    static_assert(ALIGN_BYTES > 0, "ALIGN_BYTES must be nonzero");
+    static_assert((ALIGN_BYTES & (ALIGN_BYTES - 1)) == 0, "ALIGN_BYTES must be a power of two");
+
+    /** In-place linked list of the free blocks of one size */
+    struct ListNode {
+        ListNode* m_next;
+        explicit ListNode(ListNode* next) : m_next(next) {}
+    };
+
+    static constexpr std::size_t ELEM_ALIGN_BYTES = alignof(ListNode) > ALIGN_BYTES ? alignof(ListNode) : ALIGN_BYTES;
+    static_assert(ELEM_ALIGN_BYTES <= alignof(std::max_align_t), "::operator new only guarantees the alignment of max_align_t");
+    static_assert(sizeof(ListNode) <= ELEM_ALIGN_BYTES, "Each block needs to be able to hold a ListNode");
+    static_assert((MAX_BLOCK_SIZE_BYTES & (ELEM_ALIGN_BYTES - 1)) == 0, "MAX_BLOCK_SIZE_BYTES needs to be a multiple of the alignment");
+
+    const std::size_t m_chunk_size_bytes;
+    std::list<char*> m_allocated_chunks;
+    //! Free lists by block size in units of ELEM_ALIGN_BYTES
+    std::vector<ListNode*> m_free_lists;
+    //! The part of the last chunk not cut into blocks yet
+    char* m_available_memory_it = nullptr;
+    char* m_available_memory_end = nullptr;
+
+    static constexpr std::size_t NumElemAlignBytes(std::size_t bytes)
+    {
+        return (bytes + ELEM_ALIGN_BYTES - 1) / ELEM_ALIGN_BYTES + (bytes == 0);
+    }
+
+    static constexpr bool IsFreeListUsable(std::size_t bytes, std::size_t alignment)
+    {
+        return alignment <= ELEM_ALIGN_BYTES && bytes <= MAX_BLOCK_SIZE_BYTES;
+    }
+
+    void PlacementAddToList(void* p, ListNode*& node)
+    {
+        node = new (p) ListNode(node);
+    }
+
+    void AllocateChunk()
+    {
+        // The rest of the current chunk becomes a free block of its size
+        const std::size_t remaining_available_bytes = m_available_memory_end - m_available_memory_it;
+        if (remaining_available_bytes != 0) {
+            PlacementAddToList(m_available_memory_it, m_free_lists[remaining_available_bytes / ELEM_ALIGN_BYTES]);
+        }
+
+        m_available_memory_it = static_cast<char*>(::operator new(m_chunk_size_bytes));
+        m_available_memory_end = m_available_memory_it + m_chunk_size_bytes;
+        m_allocated_chunks.push_back(m_available_memory_it);
+    }
+
+public:
+    /** Chunks of chunk_size_bytes, rounded up to the alignment */
+    explicit PoolResource(std::size_t chunk_size_bytes)
+        : m_chunk_size_bytes(NumElemAlignBytes(chunk_size_bytes) * ELEM_ALIGN_BYTES),
+          m_free_lists(MAX_BLOCK_SIZE_BYTES / ELEM_ALIGN_BYTES + 1, nullptr)
+    {
+        assert(m_chunk_size_bytes >= MAX_BLOCK_SIZE_BYTES);
+        AllocateChunk();
+    }
+
+    /** Chunks of 256 KiB */
+    PoolResource() : PoolResource(262144) {}
+
+    PoolResource(const PoolResource&) = delete;
+    PoolResource& operator=(const PoolResource&) = delete;
+
+    ~PoolResource()
+    {
+        for (char* chunk : m_allocated_chunks) {
+            ::operator delete(chunk);
+        }
+    }
+
+    void* Allocate(std::size_t bytes, std::size_t alignment)
+    {
+        if (IsFreeListUsable(bytes, alignment)) {
+            const std::size_t num_alignments = NumElemAlignBytes(bytes);
+            ListNode*& free_list = m_free_lists[num_alignments];
+            if (free_list != nullptr) {
+                // Reuse a freed block; ListNode is trivially destructible, so its memory
+                // can be handed out as is
+                ListNode* node = free_list;
+                free_list = node->m_next;
+                return node;
+            }
+
+            // Cut a new block from the chunk, taking a new chunk if this one is used up
+            const std::ptrdiff_t round_bytes = static_cast<std::ptrdiff_t>(num_alignments * ELEM_ALIGN_BYTES);
+            if (round_bytes > m_available_memory_end - m_available_memory_it) {
+                AllocateChunk();
+            }
+            void* p = m_available_memory_it;
+            m_available_memory_it += round_bytes;
+            return p;
+        }
+
+        return ::operator new(bytes);
+    }
+
+    void Deallocate(void* p, std::size_t bytes, std::size_t alignment) noexcept
+    {
+        if (IsFreeListUsable(bytes, alignment)) {
+            PlacementAddToList(p, m_free_lists[NumElemAlignBytes(bytes)]);
+        } else {
+            ::operator delete(p);
+        }
+    }
+
+    /** Number of chunks taken from the system */
+    std::size_t NumAllocatedChunks() const
+    {
+        return m_allocated_chunks.size();
+    }
+
+    /** Size of each chunk */
+    std::size_t ChunkSizeBytes() const
+    {
+        return m_chunk_size_bytes;
+    }
+};
+
+/**
+ * Allocator of a container backed by a PoolResource, which must outlive the container.
+ * Copies and rebound copies share the resource.
+ */
+template <class T, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES = alignof(T)>
+class PoolAllocator
+{
+    PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>* m_resource;
+
+    template <typename U, std::size_t M, std::size_t A>
+    friend class PoolAllocator;
+
+public:
+    typedef T value_type;
+    typedef PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> ResourceType;
+
+    /** Not explicit, so that containers can be constructed from the resource directly */
+    PoolAllocator(ResourceType* resource) noexcept : m_resource(resource) {}
+
+    PoolAllocator(const PoolAllocator& other) noexcept = default;
+    PoolAllocator& operator=(const PoolAllocator& other) noexcept = default;
+
+    template <class U>
+    PoolAllocator(const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& other) noexcept : m_resource(other.resource())
+    {
+    }
+
+    template <typename U>
+    struct rebind {
+        typedef PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> other;
+    };
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(m_resource->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        m_resource->Deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    ResourceType* resource() const noexcept
+    {
+        return m_resource;
+    }
+};
+
+template <class T1, class T2, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+bool operator==(const PoolAllocator<T1, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& a,
+                const PoolAllocator<T2, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& b) noexcept
+{
+    return a.resource() == b.resource();
+}
+
+template <class T1, class T2, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+bool operator!=(const PoolAllocator<T1, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& a,
+                const PoolAllocator<T2, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& b) noexcept
+{
+    return !(a == b);
+}
+
+#endif // SUPPORT_ALLOCATORS_POOL_H
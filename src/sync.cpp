@@ -5,10 +5,14 @@
 #include <sync.h>
 
 #include <logging.h>
+#include <util/memory.h>
 #include <util/strencodings.h>
+#include <util/time.h>
 
 #include <stdio.h>
 
+#include <algorithm>
+#include <atomic>
 #include <map>
 #include <memory>
 #include <set>
@@ -24,6 +28,240 @@ void PrintLockContention(const char* pszName, const char* pszFile, int nLine)
 }
 #endif /* DEBUG_LOCKCONTENTION */
 
+namespace {
+struct LockHoldTimer {
+    void* cs{nullptr};
+    int nDepth{0};
+    int64_t nStart{0};
+    int64_t nTotal{0};
+};
+thread_local LockHoldTimer g_lock_hold_timer;
+} // namespace
+
+void SetLockHoldTimer(void* cs)
+{
+    if (g_lock_hold_timer.cs != cs) {
+        g_lock_hold_timer = LockHoldTimer();
+        g_lock_hold_timer.cs = cs;
+    }
+}
+
+int64_t GetLockHoldTime()
+{
+    return g_lock_hold_timer.nTotal;
+}
+
+void LockHoldTimerEnter(void* cs)
+{
+    if (cs == g_lock_hold_timer.cs && g_lock_hold_timer.nDepth++ == 0)
+        g_lock_hold_timer.nStart = GetTimeMicros();
+}
+
+void LockHoldTimerLeave(void* cs)
+{
+    if (cs == g_lock_hold_timer.cs && g_lock_hold_timer.nDepth > 0 && --g_lock_hold_timer.nDepth == 0)
+        g_lock_hold_timer.nTotal += GetTimeMicros() - g_lock_hold_timer.nStart;
+}
+
+struct LockStats {
+    std::string name;
+    int id;
+    std::atomic<uint64_t> nLocks;
+    std::atomic<uint64_t> nContended;
+    std::atomic<uint64_t> nTryFailed;
+    std::atomic<int64_t> nWaitMicros;
+    std::atomic<int64_t> nHoldMicros;
+    std::atomic<uint64_t> vWaitHistogram[LOCK_STATS_BUCKETS];
+    std::atomic<uint64_t> vHoldHistogram[LOCK_STATS_BUCKETS];
+
+    //! Contended locks and total wait by call site, only touched after waiting anyway
+    std::mutex cs_sites;
+    std::map<std::pair<const char*, int>, std::pair<uint64_t, int64_t>> mapSites;
+
+    LockStats(const std::string& nameIn, int idIn) : name(nameIn), id(idIn) { Reset(); }
+
+    void Reset()
+    {
+        nLocks = 0;
+        nContended = 0;
+        nTryFailed = 0;
+        nWaitMicros = 0;
+        nHoldMicros = 0;
+        for (int i = 0; i < LOCK_STATS_BUCKETS; i++) {
+            vWaitHistogram[i] = 0;
+            vHoldHistogram[i] = 0;
+        }
+        std::lock_guard<std::mutex> lock(cs_sites);
+        mapSites.clear();
+    }
+};
+
+namespace {
+//! Registered mutexes, and distinct names
+const int MAX_LOCK_STATS = 32;
+
+struct LockStatsEntry {
+    std::atomic<void*> cs{nullptr};
+    std::atomic<LockStats*> stats{nullptr};
+};
+
+std::atomic<bool> g_lock_stats_enabled{false};
+//! Number of used entries of g_lock_stats_registry, a lock scans them without locking
+std::atomic<int> g_lock_stats_count{0};
+LockStatsEntry g_lock_stats_registry[MAX_LOCK_STATS];
+
+std::mutex g_lock_stats_mutex;
+std::map<std::string, std::unique_ptr<LockStats>> g_lock_stats_by_name;
+
+//! Depth of the locks of each name held by the thread: of a recursive mutex, or of
+//! mutexes counted under the same name, only the outermost lock counts
+thread_local int g_lock_stats_depth[MAX_LOCK_STATS];
+
+int LockStatsBucket(int64_t nMicros)
+{
+    int nBucket = 0;
+    while (nMicros > 0 && nBucket < LOCK_STATS_BUCKETS - 1) {
+        nMicros >>= 1;
+        nBucket++;
+    }
+    return nBucket;
+}
+} // namespace
+
+void EnableLockStats()
+{
+    g_lock_stats_enabled = true;
+}
+
+bool LockStatsEnabled()
+{
+    return g_lock_stats_enabled;
+}
+
+void RegisterLockStats(void* cs, const char* pszName)
+{
+    if (!g_lock_stats_enabled)
+        return;
+    std::lock_guard<std::mutex> lock(g_lock_stats_mutex);
+    std::unique_ptr<LockStats>& stats = g_lock_stats_by_name[pszName];
+    if (!stats) {
+        if (g_lock_stats_by_name.size() > MAX_LOCK_STATS) {
+            g_lock_stats_by_name.erase(pszName);
+            LogPrintf("Too many mutex names to count the locks of %s\n", pszName);
+            return;
+        }
+        stats = MakeUnique<LockStats>(pszName, g_lock_stats_by_name.size() - 1);
+    }
+    int nCount = g_lock_stats_count.load();
+    int nEntry = 0;
+    while (nEntry < nCount && g_lock_stats_registry[nEntry].cs.load() != nullptr)
+        nEntry++;
+    if (nEntry == MAX_LOCK_STATS) {
+        LogPrintf("Too many mutexes to count the locks of %s\n", pszName);
+        return;
+    }
+    g_lock_stats_registry[nEntry].stats = stats.get();
+    g_lock_stats_registry[nEntry].cs = cs;
+    if (nEntry == nCount)
+        g_lock_stats_count = nCount + 1;
+}
+
+void UnregisterLockStats(void* cs)
+{
+    // Called by every mutex destructor, also of globals at exit, so it only touches atomics
+    int nCount = g_lock_stats_count.load(std::memory_order_acquire);
+    for (int i = 0; i < nCount; i++) {
+        void* expected = cs;
+        g_lock_stats_registry[i].cs.compare_exchange_strong(expected, nullptr);
+    }
+}
+
+LockStats* GetLockStats(void* cs)
+{
+    int nCount = g_lock_stats_count.load(std::memory_order_acquire);
+    for (int i = 0; i < nCount; i++) {
+        if (g_lock_stats_registry[i].cs.load(std::memory_order_acquire) == cs)
+            return g_lock_stats_registry[i].stats.load(std::memory_order_relaxed);
+    }
+    return nullptr;
+}
+
+void LockStatsWaited(LockStats* stats, const char* pszFile, int nLine, int64_t nWaitMicros)
+{
+    nWaitMicros = std::max<int64_t>(0, nWaitMicros);
+    stats->nContended.fetch_add(1, std::memory_order_relaxed);
+    stats->nWaitMicros.fetch_add(nWaitMicros, std::memory_order_relaxed);
+    stats->vWaitHistogram[LockStatsBucket(nWaitMicros)].fetch_add(1, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(stats->cs_sites);
+    std::pair<uint64_t, int64_t>& site = stats->mapSites[std::make_pair(pszFile, nLine)];
+    site.first++;
+    site.second += nWaitMicros;
+}
+
+void LockStatsTryFailed(LockStats* stats)
+{
+    stats->nTryFailed.fetch_add(1, std::memory_order_relaxed);
+}
+
+int64_t LockStatsEnter(LockStats* stats)
+{
+    if (g_lock_stats_depth[stats->id]++ > 0)
+        return -1;
+    stats->nLocks.fetch_add(1, std::memory_order_relaxed);
+    return GetTimeMicros();
+}
+
+void LockStatsLeave(LockStats* stats, int64_t nStart)
+{
+    g_lock_stats_depth[stats->id]--;
+    if (nStart < 0)
+        return;
+    int64_t nHoldMicros = std::max<int64_t>(0, GetTimeMicros() - nStart);
+    stats->nHoldMicros.fetch_add(nHoldMicros, std::memory_order_relaxed);
+    stats->vHoldHistogram[LockStatsBucket(nHoldMicros)].fetch_add(1, std::memory_order_relaxed);
+}
+
+std::vector<LockStatsSnapshot> GetLockStatsSnapshot(size_t nMaxSites)
+{
+    std::vector<LockStatsSnapshot> ret;
+    std::lock_guard<std::mutex> lock(g_lock_stats_mutex);
+    for (const auto& entry : g_lock_stats_by_name) {
+        const LockStats& stats = *entry.second;
+        LockStatsSnapshot snapshot;
+        snapshot.name = stats.name;
+        snapshot.nLocks = stats.nLocks;
+        snapshot.nContended = stats.nContended;
+        snapshot.nTryFailed = stats.nTryFailed;
+        snapshot.nWaitMicros = stats.nWaitMicros;
+        snapshot.nHoldMicros = stats.nHoldMicros;
+        for (int i = 0; i < LOCK_STATS_BUCKETS; i++) {
+            snapshot.vWaitHistogram[i] = stats.vWaitHistogram[i];
+            snapshot.vHoldHistogram[i] = stats.vHoldHistogram[i];
+        }
+        {
+            std::lock_guard<std::mutex> lock_sites(entry.second->cs_sites);
+            for (const auto& site : stats.mapSites) {
+                snapshot.vSites.push_back({strprintf("%s:%d", site.first.first, site.first.second), site.second.first, site.second.second});
+            }
+        }
+        std::sort(snapshot.vSites.begin(), snapshot.vSites.end(), [](const LockSiteStats& a, const LockSiteStats& b) {
+            return a.nWaitMicros > b.nWaitMicros;
+        });
+        if (snapshot.vSites.size() > nMaxSites)
+            snapshot.vSites.resize(nMaxSites);
+        ret.push_back(std::move(snapshot));
+    }
+    return ret;
+}
+
+void ResetLockStats()
+{
+    std::lock_guard<std::mutex> lock(g_lock_stats_mutex);
+    for (const auto& entry : g_lock_stats_by_name) {
+        entry.second->Reset();
+    }
+}
+
 #ifdef DEBUG_LOCKORDER
 //
 // Early deadlock detection.
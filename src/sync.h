@@ -7,10 +7,14 @@
 #define BITCOIN_SYNC_H
 
 #include <threadsafety.h>
+#include <util/time.h>
 
 #include <condition_variable>
+#include <string>
 #include <thread>
 #include <mutex>
+#include <stdint.h>
+#include <vector>
 
 
 ////////////////////////////////////////////////
@@ -70,6 +74,53 @@ void static inline DeleteLock(void* cs) {}
 #define AssertLockHeld(cs) AssertLockHeldInternal(#cs, __FILE__, __LINE__, &cs)
 #define AssertLockNotHeld(cs) AssertLockNotHeldInternal(#cs, __FILE__, __LINE__, &cs)
 
+static const bool DEFAULT_LOCK_STATS = false;
+//! Wait and hold times are counted in histograms of buckets doubling from 1 microsecond
+static const int LOCK_STATS_BUCKETS = 24;
+
+struct LockStats;
+
+/**
+ * Contention statistics of the mutexes registered by name: how often the LOCK macros
+ * take them, how long they wait for and hold them, and the call sites that waited.
+ * Off unless enabled with EnableLockStats; a lock of an unregistered mutex then only
+ * costs a check of the registry.
+ */
+void EnableLockStats();
+bool LockStatsEnabled();
+/** Count the locks of cs under name, mutexes with the same name are counted together. Does nothing unless enabled. */
+void RegisterLockStats(void* cs, const char* pszName);
+void UnregisterLockStats(void* cs);
+/** The statistics of a registered mutex, nullptr if it is not registered */
+LockStats* GetLockStats(void* cs);
+/** Count a lock after waiting nWaitMicros for it at the call site */
+void LockStatsWaited(LockStats* stats, const char* pszFile, int nLine, int64_t nWaitMicros);
+void LockStatsTryFailed(LockStats* stats);
+/** Count an acquisition, returns the start of the hold time or -1 for a recursive lock */
+int64_t LockStatsEnter(LockStats* stats);
+void LockStatsLeave(LockStats* stats, int64_t nStart);
+
+struct LockSiteStats {
+    std::string location;
+    uint64_t nContended;
+    int64_t nWaitMicros;
+};
+
+struct LockStatsSnapshot {
+    std::string name;
+    uint64_t nLocks;
+    uint64_t nContended;
+    uint64_t nTryFailed;
+    int64_t nWaitMicros;
+    int64_t nHoldMicros;
+    uint64_t vWaitHistogram[LOCK_STATS_BUCKETS];
+    uint64_t vHoldHistogram[LOCK_STATS_BUCKETS];
+    //! The call sites that waited, longest total wait first
+    std::vector<LockSiteStats> vSites;
+};
+std::vector<LockStatsSnapshot> GetLockStatsSnapshot(size_t nMaxSites);
+void ResetLockStats();
+
 /**
  * Template mixin that adds -Wthread-safety locking annotations and lock order
  * checking to a subset of the mutex API.
@@ -80,6 +131,7 @@ class LOCKABLE AnnotatedMixin : public PARENT
 public:
     ~AnnotatedMixin() {
         DeleteLock((void*)this);
+        UnregisterLockStats((void*)this);
     }
 
     void lock() EXCLUSIVE_LOCK_FUNCTION()
@@ -114,30 +166,58 @@ typedef AnnotatedMixin<std::mutex> Mutex;
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine);
 #endif
 
+/**
+ * Time how long the calling thread holds a mutex, for profiling. Only the locks taken with
+ * the LOCK macros count, and of a recursive mutex only the outermost one.
+ */
+void SetLockHoldTimer(void* cs);
+/** Time in microseconds the calling thread held the mutex of SetLockHoldTimer, until its last unlock */
+int64_t GetLockHoldTime();
+void LockHoldTimerEnter(void* cs);
+void LockHoldTimerLeave(void* cs);
+
 /** Wrapper around std::unique_lock style lock for Mutex. */
 template <typename Mutex, typename Base = typename Mutex::UniqueLock>
 class SCOPED_LOCKABLE UniqueLock : public Base
 {
 private:
+    LockStats* m_stats{nullptr};
+    int64_t m_stats_start{-1};
+
     void Enter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(Base::mutex()));
+        m_stats = GetLockStats((void*)(Base::mutex()));
 #ifdef DEBUG_LOCKCONTENTION
         if (!Base::try_lock()) {
             PrintLockContention(pszName, pszFile, nLine);
+#else
+        if (!m_stats || !Base::try_lock()) {
 #endif
+            int64_t nWaitStart = m_stats ? GetTimeMicros() : 0;
             Base::lock();
-#ifdef DEBUG_LOCKCONTENTION
+            if (m_stats)
+                LockStatsWaited(m_stats, pszFile, nLine, GetTimeMicros() - nWaitStart);
         }
-#endif
+        if (m_stats)
+            m_stats_start = LockStatsEnter(m_stats);
+        LockHoldTimerEnter((void*)(Base::mutex()));
     }
 
     bool TryEnter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(Base::mutex()), true);
+        m_stats = GetLockStats((void*)(Base::mutex()));
         Base::try_lock();
-        if (!Base::owns_lock())
+        if (!Base::owns_lock()) {
             LeaveCritical();
+            if (m_stats)
+                LockStatsTryFailed(m_stats);
+        } else {
+            if (m_stats)
+                m_stats_start = LockStatsEnter(m_stats);
+            LockHoldTimerEnter((void*)(Base::mutex()));
+        }
         return Base::owns_lock();
     }
 
@@ -163,8 +243,12 @@ public:
 
     ~UniqueLock() UNLOCK_FUNCTION()
     {
-        if (Base::owns_lock())
+        if (Base::owns_lock()) {
+            LockHoldTimerLeave((void*)(Base::mutex()));
+            if (m_stats)
+                LockStatsLeave(m_stats, m_stats_start);
             LeaveCritical();
+        }
     }
 
     operator bool()
@@ -0,0 +1,133 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <consensus/validation.h>
+#include <index/addressindex.h>
+#include <key_io.h>
+#include <script/standard.h>
+#include <test/test_bitcoin.h>
+#include <util/system.h>
+#include <util/time.h>
+#include <validation.h>
+
+#include <limits>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(addressindex_tests)
+
+#ifdef ENABLE_BITCORE_RPC
+BOOST_FIXTURE_TEST_CASE(addressindex_initial_sync, TestChain100Setup)
+{
+    AddressIndex addressindex(1 << 20, true);
+
+    uint256 hashBytes;
+    int type = 0;
+    BOOST_REQUIRE(DecodeIndexKey(EncodeDestination(coinbaseKey.GetPubKey().GetID()), hashBytes, type));
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+
+    // The address should have no entries before the index is started.
+    BOOST_CHECK(addressindex.ReadAddressIndex(hashBytes, type, addressIndex));
+    BOOST_CHECK(addressIndex.empty());
+
+    // BlockUntilSyncedToCurrentChain should return false before the index is started.
+    BOOST_CHECK(!addressindex.BlockUntilSyncedToCurrentChain());
+
+    addressindex.Start();
+
+    // Allow the address index to catch up with the block index.
+    constexpr int64_t timeout_ms = 10 * 1000;
+    int64_t time_start = GetTimeMillis();
+    while (!addressindex.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        MilliSleep(100);
+    }
+
+    // Check that the index has all the coinbase outputs that were in the chain before it started.
+    BOOST_CHECK(addressindex.ReadAddressIndex(hashBytes, type, addressIndex));
+    BOOST_CHECK_EQUAL(addressIndex.size(), m_coinbase_txns.size());
+    BOOST_CHECK(addressindex.ReadAddressUnspentIndex(hashBytes, type, unspentOutputs));
+    BOOST_CHECK_EQUAL(unspentOutputs.size(), m_coinbase_txns.size());
+
+    // A merged read of the address, listed twice, has each entry twice, in height order.
+    std::vector<std::pair<CAddressIndexKey, CAmount> > mergedIndex;
+    std::vector<std::pair<uint256, int> > addresses{{hashBytes, type}, {hashBytes, type}};
+    BOOST_CHECK(addressindex.ReadAddressIndexMerged(addresses, mergedIndex));
+    BOOST_REQUIRE_EQUAL(mergedIndex.size(), 2 * addressIndex.size());
+    for (size_t i = 0; i < addressIndex.size(); i++) {
+        BOOST_CHECK(mergedIndex[2 * i].first.txhash == addressIndex[i].first.txhash);
+        BOOST_CHECK(mergedIndex[2 * i + 1].first.txhash == addressIndex[i].first.txhash);
+    }
+
+    CAddressSummary summary;
+    BOOST_CHECK(addressindex.ReadAddressSummary(hashBytes, type, summary));
+    BOOST_CHECK_EQUAL(summary.txCount, m_coinbase_txns.size());
+    BOOST_CHECK_EQUAL(summary.balance, summary.received);
+
+    // The coinbase outputs are not spent.
+    CSpentIndexValue spentValue;
+    BOOST_CHECK(!addressindex.ReadSpentIndex(CSpentIndexKey(m_coinbase_txns[0]->GetHash(), 0), spentValue));
+
+    // Check that the outputs of new blocks make it into the index.
+    CScript coinbase_script_pub_key = GetScriptForDestination(coinbaseKey.GetPubKey().GetID());
+    std::vector<CMutableTransaction> no_txns;
+    const CBlock& block = CreateAndProcessBlock(no_txns, coinbase_script_pub_key);
+    BOOST_CHECK(addressindex.BlockUntilSyncedToCurrentChain());
+
+    addressIndex.clear();
+    BOOST_CHECK(addressindex.ReadAddressIndex(hashBytes, type, addressIndex));
+    BOOST_CHECK_EQUAL(addressIndex.size(), m_coinbase_txns.size() + 1);
+    BOOST_CHECK(addressIndex.back().first.txhash == block.vtx[0]->GetHash());
+
+    // Check that the entries of a disconnected block are removed from the index.
+    {
+        CValidationState state;
+        CBlockIndex* pindex;
+        {
+            LOCK(cs_main);
+            pindex = LookupBlockIndex(block.GetHash());
+        }
+        BOOST_REQUIRE(InvalidateBlock(state, Params(), pindex));
+    }
+    BOOST_CHECK(addressindex.BlockUntilSyncedToCurrentChain());
+
+    addressIndex.clear();
+    unspentOutputs.clear();
+    BOOST_CHECK(addressindex.ReadAddressIndex(hashBytes, type, addressIndex));
+    BOOST_CHECK_EQUAL(addressIndex.size(), m_coinbase_txns.size());
+    BOOST_CHECK(addressindex.ReadAddressUnspentIndex(hashBytes, type, unspentOutputs));
+    BOOST_CHECK_EQUAL(unspentOutputs.size(), m_coinbase_txns.size());
+    BOOST_CHECK(addressindex.ReadAddressSummary(hashBytes, type, summary));
+    BOOST_CHECK_EQUAL(summary.txCount, m_coinbase_txns.size());
+
+    // The timestamp of the disconnected block stays in the index, but only the active chain is
+    // returned with fActiveOnly, in height order.
+    std::vector<std::pair<uint256, unsigned int> > hashes;
+    BOOST_CHECK(addressindex.ReadTimestampIndex(std::numeric_limits<unsigned int>::max(), 0, false, hashes));
+    BOOST_CHECK_EQUAL(hashes.size(), m_coinbase_txns.size() + 1);
+    hashes.clear();
+    BOOST_CHECK(addressindex.ReadTimestampIndex(std::numeric_limits<unsigned int>::max(), 0, true, hashes));
+    {
+        LOCK(cs_main);
+        BOOST_REQUIRE_EQUAL(hashes.size(), (size_t)chainActive.Height());
+        for (size_t i = 0; i < hashes.size(); i++) {
+            BOOST_CHECK(hashes[i].first == chainActive[i + 1]->GetBlockHash());
+            BOOST_CHECK(i == 0 || hashes[i].second > hashes[i - 1].second);
+        }
+    }
+
+    // shutdown sequence (c.f. Shutdown() in init.cpp)
+    addressindex.Stop();
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+
+    // Rest of shutdown sequence and destructors happen in ~TestingSetup()
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -2,6 +2,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 #include <addrman.h>
+#include <clientversion.h>
 #include <test/test_bitcoin.h>
 #include <string>
 #include <boost/test/unit_test.hpp>
@@ -9,6 +10,7 @@
 #include <hash.h>
 #include <netbase.h>
 #include <random.h>
+#include <streams.h>
 
 class CAddrManTest : public CAddrMan
 {
@@ -681,4 +683,33 @@ BOOST_AUTO_TEST_CASE(addrman_evictionworks)
 }
 
 
+BOOST_AUTO_TEST_CASE(addrman_serialize_positions)
+{
+    CAddrManTest addrman;
+    CNetAddr source = ResolveIP("252.2.2.2");
+    for (unsigned int i = 1; i < 64; i++) {
+        CService addr = ResolveService("250." + std::to_string(i) + ".1.1");
+        BOOST_CHECK(addrman.Add(CAddress(addr, NODE_NONE), source));
+        if (i % 4 == 0)
+            addrman.Good(CAddress(addr, NODE_NONE));
+    }
+
+    CDataStream ssPeers(SER_DISK, CLIENT_VERSION);
+    ssPeers << addrman;
+    const std::string strPeers = ssPeers.str();
+
+    // Loading the stored positions rebuilds the same tables
+    CAddrManTest addrman2(false);
+    ssPeers >> addrman2;
+    BOOST_CHECK_EQUAL(addrman2.size(), addrman.size());
+    CDataStream ssPeers2(SER_DISK, CLIENT_VERSION);
+    ssPeers2 << addrman2;
+    BOOST_CHECK(ssPeers2.str() == strPeers);
+
+    // Both tables can be selected from after loading
+    for (int i = 0; i < 20; i++)
+        BOOST_CHECK(addrman2.Select().IsValid());
+    BOOST_CHECK(addrman2.Select(true).IsValid());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -4,10 +4,13 @@
 
 #include <util/system.h>
 
+#include <memusage.h>
+#include <support/allocators/pool.h>
 #include <support/allocators/secure.h>
 #include <test/test_bitcoin.h>
 
 #include <memory>
+#include <unordered_map>
 
 #include <boost/test/unit_test.hpp>
 
@@ -233,4 +236,60 @@ BOOST_AUTO_TEST_CASE(lockedpool_tests_live)
     BOOST_CHECK(pool.stats().used == initial.used);
 }
 
+BOOST_AUTO_TEST_CASE(pool_resource_tests)
+{
+    PoolResource<64, 8> resource(1024);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+    BOOST_CHECK_EQUAL(resource.ChunkSizeBytes(), 1024U);
+
+    // Freed blocks are handed out again for the same rounded size
+    void* a = resource.Allocate(20, 8);
+    void* b = resource.Allocate(24, 8);
+    BOOST_CHECK(a != b);
+    BOOST_CHECK_EQUAL(static_cast<char*>(b) - static_cast<char*>(a), 24);
+    resource.Deallocate(a, 20, 8);
+    BOOST_CHECK(resource.Allocate(17, 8) == a);
+
+    // Larger blocks bypass the pool
+    void* large = resource.Allocate(65, 8);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+    resource.Deallocate(large, 65, 8);
+
+    // A used up chunk makes room for another
+    std::vector<void*> blocks;
+    for (int i = 0; i < 20; i++)
+        blocks.push_back(resource.Allocate(64, 8));
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 2U);
+    for (void* p : blocks)
+        resource.Deallocate(p, 64, 8);
+    resource.Deallocate(b, 24, 8);
+    resource.Deallocate(a, 17, 8);
+}
+
+BOOST_AUTO_TEST_CASE(pool_allocator_map_tests)
+{
+    typedef std::unordered_map<int, int64_t, std::hash<int>, std::equal_to<int>,
+                               PoolAllocator<std::pair<const int, int64_t>, sizeof(std::pair<const int, int64_t>) + sizeof(void*) * 4, alignof(void*)>> Map;
+    Map::allocator_type::ResourceType resource(4096);
+    {
+        Map map(0, Map::hasher(), Map::key_equal(), &resource);
+        for (int i = 0; i < 1000; i++)
+            map[i] = i;
+        for (int i = 0; i < 1000; i += 2)
+            map.erase(i);
+        for (int i = 0; i < 1000; i++)
+            BOOST_CHECK_EQUAL(map.count(i), size_t(i % 2));
+
+        // The usage is that of the chunks, which the erased nodes do not give back
+        const size_t chunks = resource.NumAllocatedChunks();
+        BOOST_CHECK(chunks > 1);
+        BOOST_CHECK(memusage::DynamicUsage(map) >= chunks * resource.ChunkSizeBytes());
+
+        // Reinserting reuses the erased nodes
+        for (int i = 0; i < 1000; i += 2)
+            map[i] = i;
+        BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), chunks);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
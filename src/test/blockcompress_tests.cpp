@@ -0,0 +1,52 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockcompress.h>
+#include <clientversion.h>
+#include <crypto/common.h>
+#include <streams.h>
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockcompress_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(compressed_disk_record)
+{
+    // Repetitive data, like contract bytecode, gets smaller
+    std::vector<unsigned char> data;
+    for (int i = 0; i < 4096; i++)
+        data.push_back(i % 7);
+    std::vector<unsigned char> compressed;
+    BOOST_REQUIRE(CompressDiskRecord(data.data(), data.size(), compressed));
+    BOOST_CHECK(compressed.size() < data.size());
+
+    std::vector<unsigned char> raw;
+    DecompressDiskRecord(compressed.data(), compressed.size(), raw);
+    BOOST_CHECK(raw == data);
+
+    // Read through a stream as the readers of the block files do
+    CDataStream stream(SER_DISK, CLIENT_VERSION);
+    stream.write((const char*)compressed.data(), compressed.size());
+    raw.clear();
+    ReadCompressedDiskRecord(stream, compressed.size(), raw);
+    BOOST_CHECK(raw == data);
+    BOOST_CHECK(stream.empty());
+
+    // A stream that does not match the recorded size is rejected
+    std::vector<unsigned char> bad = compressed;
+    WriteLE32(bad.data(), data.size() + 1);
+    BOOST_CHECK_THROW(DecompressDiskRecord(bad.data(), bad.size(), raw), std::ios_base::failure);
+    BOOST_CHECK_THROW(DecompressDiskRecord(compressed.data(), 3, raw), std::ios_base::failure);
+    bad = compressed;
+    bad.resize(bad.size() / 2);
+    BOOST_CHECK_THROW(DecompressDiskRecord(bad.data(), bad.size(), raw), std::ios_base::failure);
+
+    // Random data is left uncompressed
+    data = g_insecure_rand_ctx.randbytes(4096);
+    BOOST_CHECK(!CompressDiskRecord(data.data(), data.size(), compressed));
+    BOOST_CHECK(compressed.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -321,6 +321,59 @@ BOOST_AUTO_TEST_CASE(EmptyBlockRoundTripTest)
     }
 }
 
+BOOST_AUTO_TEST_CASE(BlockGeneratedTxPrefillTest)
+{
+    CTxMemPool pool;
+    TestMemPoolEntryHelper entry;
+    CBlock block(BuildBlockTestCase());
+
+    // A coinstake in place of vtx[1] and a condensing transaction after vtx[2]
+    CMutableTransaction coinstake;
+    coinstake.vin.resize(1);
+    coinstake.vin[0].prevout.hash = InsecureRand256();
+    coinstake.vin[0].prevout.n = 0;
+    coinstake.vout.resize(2);
+    coinstake.vout[0].SetEmpty();
+    coinstake.vout[1].nValue = 42;
+    block.vtx[1] = MakeTransactionRef(coinstake);
+
+    CMutableTransaction condensing;
+    condensing.vin.resize(1);
+    condensing.vin[0].prevout.hash = InsecureRand256();
+    condensing.vin[0].prevout.n = 0;
+    condensing.vin[0].scriptSig = CScript() << OP_SPEND;
+    condensing.vout.resize(1);
+    condensing.vout[0].nValue = 42;
+    block.vtx.push_back(MakeTransactionRef(condensing));
+
+    bool mutated;
+    block.hashMerkleRoot = BlockMerkleRoot(block, &mutated);
+    assert(!mutated);
+    while (!CheckProofOfWork(block.GetHash(), block.nBits, Params().GetConsensus())) ++block.nNonce;
+
+    LOCK2(cs_main, pool.cs);
+    pool.addUnchecked(entry.FromTx(block.vtx[2]));
+
+    {
+        CBlockHeaderAndShortTxIDs shortIDs(block, true);
+        BOOST_CHECK_EQUAL(shortIDs.prefilledtxn.size(), 3U);
+        BOOST_CHECK_EQUAL(shortIDs.shorttxids.size(), 1U);
+
+        CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+        stream << shortIDs;
+
+        CBlockHeaderAndShortTxIDs shortIDs2;
+        stream >> shortIDs2;
+
+        // Only the transaction from the mempool is looked up, so no getblocktxn is needed
+        PartiallyDownloadedBlock partialBlock(&pool);
+        BOOST_CHECK(partialBlock.InitData(shortIDs2, extra_txn) == READ_STATUS_OK);
+        for (size_t i = 0; i < block.vtx.size(); i++) {
+            BOOST_CHECK(partialBlock.IsTxAvailable(i));
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(TransactionsRequestSerializationTest) {
     BlockTransactionsRequest req1;
     req1.blockhash = InsecureRand256();
@@ -0,0 +1,70 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockfilemap.h>
+#include <clientversion.h>
+#include <fs.h>
+#include <streams.h>
+#include <test/test_bitcoin.h>
+#include <util/system.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockfilemap_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(block_file_map_cache)
+{
+    // Two block files holding a number each
+    for (int nFile = 0; nFile < 2; nFile++) {
+        CAutoFile file(fsbridge::fopen(GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk"), "wb"), SER_DISK, CLIENT_VERSION);
+        BOOST_CHECK(!file.IsNull());
+        file << (uint32_t)0 << (uint32_t)(1000 + nFile);
+    }
+
+    BlockFileMapCache cache(1);
+    // Nothing is mapped before the files are finalized
+    BOOST_CHECK(!cache.Get(0));
+    cache.SetFinalizedFiles(2);
+
+    std::shared_ptr<const MappedBlockFile> mapped = cache.Get(0);
+#if defined(WIN32)
+    BOOST_CHECK(!mapped);
+#else
+    if (sizeof(void*) < 8) {
+        BOOST_CHECK(!mapped);
+        return;
+    }
+    BOOST_REQUIRE(mapped);
+    BOOST_CHECK_EQUAL(mapped->size(), 8U);
+    BOOST_CHECK(cache.Get(0) == mapped);
+
+    uint32_t value;
+    BlockFileReader reader(SER_DISK, CLIENT_VERSION, *mapped, 4);
+    reader >> value;
+    BOOST_CHECK_EQUAL(value, 1000U);
+    BOOST_CHECK_THROW(reader >> value, std::ios_base::failure);
+    BOOST_CHECK_THROW(BlockFileReader(SER_DISK, CLIENT_VERSION, *mapped, 9), std::ios_base::failure);
+
+    // Mapping the second file drops the first, which stays readable through its reference
+    std::shared_ptr<const MappedBlockFile> mapped1 = cache.Get(1);
+    BOOST_REQUIRE(mapped1);
+    BOOST_CHECK(cache.Get(0) != mapped);
+    BlockFileReader reader0(SER_DISK, CLIENT_VERSION, *mapped, 4);
+    reader0 >> value;
+    BOOST_CHECK_EQUAL(value, 1000U);
+
+    // Files that are no longer finalized and pruned files are mapped again
+    cache.SetFinalizedFiles(1);
+    BOOST_CHECK(!cache.Get(1));
+    mapped = cache.Get(0);
+    cache.Invalidate(0);
+    BOOST_CHECK(cache.Get(0) != mapped);
+
+    cache.SetMaxFiles(0);
+    BOOST_CHECK(!cache.Get(0));
+#endif
+}
+
+BOOST_AUTO_TEST_SUITE_END()
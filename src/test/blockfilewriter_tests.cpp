@@ -0,0 +1,81 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockfilewriter.h>
+#include <clientversion.h>
+#include <fs.h>
+#include <shutdown.h>
+#include <streams.h>
+#include <test/test_bitcoin.h>
+#include <util/system.h>
+#include <validation.h>
+
+#include <algorithm>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockfilewriter_tests, BasicTestingSetup)
+
+static std::vector<unsigned char> ReadWholeFile(const CDiskBlockPos& pos, const char* prefix)
+{
+    CAutoFile file(fsbridge::fopen(GetBlockPosFilename(pos, prefix), "rb"), SER_DISK, CLIENT_VERSION);
+    BOOST_REQUIRE(!file.IsNull());
+    std::vector<unsigned char> data;
+    unsigned char c;
+    while (fread(&c, 1, 1, file.Get()) == 1)
+        data.push_back(c);
+    return data;
+}
+
+BOOST_AUTO_TEST_CASE(block_file_writer)
+{
+    const std::vector<unsigned char> first{1, 2, 3, 4};
+    const std::vector<unsigned char> second{5, 6};
+    {
+        // A limit below the record size still lets the records through one at a time
+        BlockFileWriter writer(3);
+        BOOST_CHECK(writer.Allocate(CDiskBlockPos(0, 0), false, 64));
+        BOOST_CHECK(writer.Write(CDiskBlockPos(0, 0), false, std::vector<unsigned char>(first)));
+        BOOST_CHECK(writer.Write(CDiskBlockPos(0, 4), false, std::vector<unsigned char>(second)));
+        BOOST_CHECK(writer.Write(CDiskBlockPos(0, 2), true, std::vector<unsigned char>(second)));
+        writer.WaitForFile(0);
+
+        std::vector<unsigned char> data = ReadWholeFile(CDiskBlockPos(0, 0), "blk");
+        BOOST_REQUIRE(data.size() >= 6);
+        BOOST_CHECK(std::equal(first.begin(), first.end(), data.begin()));
+        BOOST_CHECK(std::equal(second.begin(), second.end(), data.begin() + 4));
+
+        // Finalizing truncates the preallocated space
+        BOOST_CHECK(writer.Finalize(CDiskBlockPos(0, 6), false));
+        BOOST_CHECK(writer.Flush());
+        BOOST_CHECK_EQUAL(ReadWholeFile(CDiskBlockPos(0, 0), "blk").size(), 6U);
+
+        // The destructor writes what is still queued
+        BOOST_CHECK(writer.Write(CDiskBlockPos(1, 0), false, std::vector<unsigned char>(first)));
+    }
+    BOOST_CHECK(ReadWholeFile(CDiskBlockPos(1, 0), "blk") == first);
+
+    std::vector<unsigned char> undo = ReadWholeFile(CDiskBlockPos(0, 0), "rev");
+    BOOST_REQUIRE_EQUAL(undo.size(), 4U);
+    BOOST_CHECK(std::equal(second.begin(), second.end(), undo.begin() + 2));
+}
+
+BOOST_AUTO_TEST_CASE(block_file_writer_failure)
+{
+    // A directory in place of the block file cannot be written
+    fs::create_directories(GetBlockPosFilename(CDiskBlockPos(2, 0), "blk"));
+    BlockFileWriter writer(1 << 20);
+    BOOST_CHECK(writer.Write(CDiskBlockPos(2, 0), false, std::vector<unsigned char>{1, 2, 3}));
+    BOOST_CHECK(!writer.Flush());
+
+    // The node is stopped, and nothing is queued anymore
+    BOOST_CHECK(ShutdownRequested());
+    BOOST_CHECK(!writer.Write(CDiskBlockPos(3, 0), false, std::vector<unsigned char>{1, 2, 3}));
+    BOOST_CHECK(!writer.Allocate(CDiskBlockPos(3, 0), false, 64));
+    writer.WaitForFile(3);
+    BOOST_CHECK(!fs::exists(GetBlockPosFilename(CDiskBlockPos(3, 0), "blk")));
+    AbortShutdown();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
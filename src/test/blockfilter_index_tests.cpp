@@ -0,0 +1,168 @@
+// Copyright (c) 2017-2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockfilter.h>
+#include <chainparams.h>
+#include <consensus/validation.h>
+#include <index/blockfilterindex.h>
+#include <script/standard.h>
+#include <test/test_bitcoin.h>
+#include <util/time.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(blockfilter_index_tests)
+
+static bool CheckFilterLookups(BlockFilterIndex& filter_index, const CBlockIndex* block_index,
+                               uint256& last_header)
+{
+    BlockFilter expected_filter;
+    {
+        CBlock block;
+        CBlockUndo block_undo;
+        if (!ReadBlockFromDisk(block, block_index, Params().GetConsensus())) {
+            BOOST_ERROR("ReadBlockFromDisk failed");
+            return false;
+        }
+        if (block_index->nHeight > 0 && !UndoReadFromDisk(block_undo, block_index)) {
+            BOOST_ERROR("UndoReadFromDisk failed");
+            return false;
+        }
+        expected_filter = BlockFilter(filter_index.GetFilterType(), block, block_undo);
+    }
+
+    BlockFilter filter;
+    uint256 filter_header;
+    std::vector<BlockFilter> filters;
+    std::vector<uint256> filter_hashes;
+
+    BOOST_CHECK(filter_index.LookupFilter(block_index, filter));
+    BOOST_CHECK(filter_index.LookupFilterHeader(block_index, filter_header));
+    BOOST_CHECK(filter_index.LookupFilterRange(block_index->nHeight, block_index, filters));
+    BOOST_CHECK(filter_index.LookupFilterHashRange(block_index->nHeight, block_index,
+                                                   filter_hashes));
+
+    BOOST_CHECK_EQUAL(filters.size(), 1);
+    BOOST_CHECK_EQUAL(filter_hashes.size(), 1);
+
+    BOOST_CHECK_EQUAL(filter.GetHash(), expected_filter.GetHash());
+    BOOST_CHECK_EQUAL(filter_header, expected_filter.ComputeHeader(last_header));
+    BOOST_CHECK_EQUAL(filters[0].GetHash(), expected_filter.GetHash());
+    BOOST_CHECK_EQUAL(filter_hashes[0], expected_filter.GetHash());
+
+    filters.clear();
+    filter_hashes.clear();
+    last_header = filter_header;
+    return true;
+}
+
+BOOST_FIXTURE_TEST_CASE(blockfilter_index_initial_sync, TestChain100Setup)
+{
+    BlockFilterIndex filter_index(BlockFilterType::BASIC, 1 << 20, true);
+
+    uint256 last_header;
+
+    // Filter should not be found in the index before it is started.
+    {
+        LOCK(cs_main);
+
+        BlockFilter filter;
+        uint256 filter_header;
+        std::vector<BlockFilter> filters;
+        std::vector<uint256> filter_hashes;
+
+        for (const CBlockIndex* block_index = chainActive.Genesis();
+             block_index != nullptr;
+             block_index = chainActive.Next(block_index)) {
+            BOOST_CHECK(!filter_index.LookupFilter(block_index, filter));
+            BOOST_CHECK(!filter_index.LookupFilterHeader(block_index, filter_header));
+            BOOST_CHECK(!filter_index.LookupFilterRange(block_index->nHeight, block_index, filters));
+            BOOST_CHECK(!filter_index.LookupFilterHashRange(block_index->nHeight, block_index,
+                                                            filter_hashes));
+        }
+    }
+
+    // BlockUntilSyncedToCurrentChain should return false before index is started.
+    BOOST_CHECK(!filter_index.BlockUntilSyncedToCurrentChain());
+
+    filter_index.Start();
+
+    // Allow filter index to catch up with the block index.
+    constexpr int64_t timeout_ms = 10 * 1000;
+    int64_t time_start = GetTimeMillis();
+    while (!filter_index.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        MilliSleep(100);
+    }
+
+    // Check that filter index has all blocks that were in the chain before it started.
+    {
+        LOCK(cs_main);
+        const CBlockIndex* block_index;
+        for (block_index = chainActive.Genesis();
+             block_index != nullptr;
+             block_index = chainActive.Next(block_index)) {
+            CheckFilterLookups(filter_index, block_index, last_header);
+        }
+    }
+
+    // Check that a new block makes it into the index.
+    CScript coinbase_script_pub_key = GetScriptForDestination(coinbaseKey.GetPubKey().GetID());
+    std::vector<CMutableTransaction> no_txns;
+    const CBlock& block = CreateAndProcessBlock(no_txns, coinbase_script_pub_key);
+    BOOST_CHECK(filter_index.BlockUntilSyncedToCurrentChain());
+
+    const CBlockIndex* new_block_index;
+    {
+        LOCK(cs_main);
+        new_block_index = LookupBlockIndex(block.GetHash());
+    }
+    BOOST_REQUIRE(new_block_index);
+    CheckFilterLookups(filter_index, new_block_index, last_header);
+
+    // A disconnected block can still be looked up by hash, while the index moves back to its parent.
+    {
+        CValidationState state;
+        BOOST_REQUIRE(InvalidateBlock(state, Params(), const_cast<CBlockIndex*>(new_block_index)));
+    }
+    BOOST_CHECK(filter_index.BlockUntilSyncedToCurrentChain());
+
+    BlockFilter filter;
+    BOOST_CHECK(filter_index.LookupFilter(new_block_index, filter));
+
+    const CBlockIndex* tip;
+    {
+        LOCK(cs_main);
+        tip = chainActive.Tip();
+    }
+    std::vector<uint256> filter_hashes;
+    BOOST_CHECK(filter_index.LookupFilterHashRange(0, tip, filter_hashes));
+    BOOST_CHECK_EQUAL(filter_hashes.size(), tip->nHeight + 1);
+
+    // The contract filter of a chain without contracts holds the basic elements only.
+    BlockFilterIndex contract_index(BlockFilterType::CONTRACT, 1 << 20, true);
+    contract_index.Start();
+    time_start = GetTimeMillis();
+    while (!contract_index.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        MilliSleep(100);
+    }
+    BlockFilter basic_filter;
+    BlockFilter contract_filter;
+    BOOST_CHECK(filter_index.LookupFilter(tip, basic_filter));
+    BOOST_CHECK(contract_index.LookupFilter(tip, contract_filter));
+    BOOST_CHECK(basic_filter.GetEncodedFilter() == contract_filter.GetEncodedFilter());
+
+    // shutdown sequence (c.f. Shutdown() in init.cpp)
+    filter_index.Stop();
+    contract_index.Stop();
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+
+    // Rest of shutdown sequence and destructors happen in ~TestingSetup()
+}
+
+BOOST_AUTO_TEST_SUITE_END()
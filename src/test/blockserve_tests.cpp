@@ -0,0 +1,57 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockserve.h>
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockserve_tests, BasicTestingSetup)
+
+static std::shared_ptr<const std::vector<uint8_t>> RawBlock(size_t nSize, uint8_t fill)
+{
+    return std::make_shared<const std::vector<uint8_t>>(nSize, fill);
+}
+
+BOOST_AUTO_TEST_CASE(raw_block_cache_lru)
+{
+    RawBlockCache cache(1000);
+    const uint256 a = InsecureRand256(), b = InsecureRand256(), c = InsecureRand256(), d = InsecureRand256(), e = InsecureRand256();
+    BOOST_CHECK(!cache.Get(a));
+
+    const auto dataA = RawBlock(200, 1);
+    cache.Add(a, dataA);
+    cache.Add(b, RawBlock(200, 2));
+    cache.Add(c, RawBlock(200, 3));
+    cache.Add(d, RawBlock(200, 4));
+    // The cached bytes are shared, not copied
+    BOOST_CHECK(cache.Get(a) == dataA);
+
+    // Adding a block again keeps the first copy
+    cache.Add(a, RawBlock(200, 9));
+    BOOST_CHECK(cache.Get(a) == dataA);
+
+    // Going over the size drops the least recently used block, b since a was read
+    cache.Add(e, RawBlock(250, 5));
+    BOOST_CHECK(!cache.Get(b));
+    BOOST_CHECK(cache.Get(a) == dataA);
+    BOOST_CHECK_EQUAL(cache.Get(c)->at(0), 3);
+    BOOST_CHECK_EQUAL(cache.Get(d)->at(0), 4);
+    BOOST_CHECK_EQUAL(cache.Get(e)->size(), 250U);
+
+    // A block over a quarter of the cache is not kept and does not evict anything
+    const uint256 big = InsecureRand256();
+    cache.Add(big, RawBlock(251, 6));
+    BOOST_CHECK(!cache.Get(big));
+    BOOST_CHECK(cache.Get(a) && cache.Get(c) && cache.Get(d) && cache.Get(e));
+
+    // The blocks read least recently are the next dropped, here a and then c
+    cache.Add(b, RawBlock(250, 2));
+    cache.Add(big, RawBlock(250, 6));
+    BOOST_CHECK(!cache.Get(a));
+    BOOST_CHECK(!cache.Get(c));
+    BOOST_CHECK(cache.Get(d) && cache.Get(e) && cache.Get(b) && cache.Get(big));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
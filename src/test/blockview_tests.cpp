@@ -0,0 +1,95 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <clientversion.h>
+#include <primitives/blockview.h>
+#include <script/script.h>
+#include <streams.h>
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockview_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(block_view_matches_deserialization)
+{
+    CBlock block;
+    block.nVersion = 4;
+    block.nBits = 0x207fffff;
+    block.vchBlockSig = {1, 2, 3};
+
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].prevout.SetNull();
+    coinbase.vin[0].scriptSig = CScript() << OP_1 << OP_0;
+    coinbase.vout.resize(1);
+    coinbase.vout[0].nValue = 50;
+    coinbase.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+
+    // A witness spend with a script longer than the inline size of CScript
+    CMutableTransaction spend;
+    spend.nVersion = 2;
+    spend.nLockTime = 17;
+    spend.vin.resize(2);
+    spend.vin[0].prevout = COutPoint(InsecureRand256(), 3);
+    spend.vin[0].nSequence = 5;
+    spend.vin[0].scriptWitness.stack = {{1, 2}, std::vector<unsigned char>(80, 7)};
+    spend.vin[1].prevout = COutPoint(InsecureRand256(), 0);
+    spend.vin[1].scriptSig = CScript() << std::vector<unsigned char>(72, 1) << std::vector<unsigned char>(33, 2);
+    spend.vout.resize(2);
+    spend.vout[0].nValue = 20;
+    spend.vout[0].scriptPubKey = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 3) << OP_EQUALVERIFY << OP_CHECKSIG;
+    spend.vout[1].nValue = 29;
+    block.vtx.push_back(MakeTransactionRef(spend));
+
+    // The legacy empty transaction has no vout after the empty vin
+    block.vtx.push_back(MakeTransactionRef(CMutableTransaction()));
+
+    CDataStream stream(SER_DISK, CLIENT_VERSION);
+    stream << block;
+    std::vector<unsigned char> raw(stream.begin(), stream.end());
+    CBlockView view(Span<const unsigned char>(raw.data(), raw.size()));
+
+    BOOST_CHECK(view.GetHash() == block.GetHash());
+    BOOST_CHECK_EQUAL(view.GetHeaderSize(), ::GetSerializeSize(block.GetBlockHeader(), CLIENT_VERSION));
+    BOOST_REQUIRE_EQUAL(view.GetTransactions().size(), block.vtx.size());
+
+    size_t offset = view.GetHeaderSize() + GetSizeOfCompactSize(block.vtx.size());
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = *block.vtx[i];
+        const CTransactionView& tx_view = view.GetTransactions()[i];
+        BOOST_CHECK(tx_view.GetHash() == tx.GetHash());
+        BOOST_CHECK(tx_view.GetWitnessHash() == tx.GetWitnessHash());
+        BOOST_CHECK_EQUAL(tx_view.HasWitness(), tx.HasWitness());
+        BOOST_CHECK_EQUAL(view.GetOffset(tx_view), offset);
+        BOOST_CHECK_EQUAL((size_t)tx_view.GetBytes().size(), ::GetSerializeSize(tx, CLIENT_VERSION));
+        offset += tx_view.GetBytes().size();
+
+        BOOST_REQUIRE_EQUAL(tx_view.GetInputCount(), tx.vin.size());
+        size_t n = 0;
+        tx_view.ForEachInput([&](const CTxInView& in) {
+            BOOST_CHECK(in.prevHash == tx.vin[n].prevout.hash);
+            BOOST_CHECK_EQUAL(in.prevN, tx.vin[n].prevout.n);
+            BOOST_CHECK(std::equal(in.scriptSig.begin(), in.scriptSig.end(), tx.vin[n].scriptSig.begin(), tx.vin[n].scriptSig.end()));
+            BOOST_CHECK_EQUAL(in.nSequence, tx.vin[n].nSequence);
+            n++;
+        });
+        BOOST_REQUIRE_EQUAL(tx_view.GetOutputCount(), tx.vout.size());
+        n = 0;
+        tx_view.ForEachOutput([&](const CTxOutView& out) {
+            BOOST_CHECK_EQUAL(out.nValue, tx.vout[n].nValue);
+            BOOST_CHECK(std::equal(out.scriptPubKey.begin(), out.scriptPubKey.end(), tx.vout[n].scriptPubKey.begin(), tx.vout[n].scriptPubKey.end()));
+            n++;
+        });
+    }
+    BOOST_CHECK_EQUAL(offset, raw.size());
+
+    // Truncated data is rejected like it is by deserialization
+    for (size_t size : {raw.size() - 1, view.GetHeaderSize() + 5, (size_t)10}) {
+        BOOST_CHECK_THROW(CBlockView(Span<const unsigned char>(raw.data(), size)), std::ios_base::failure);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
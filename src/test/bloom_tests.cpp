@@ -531,4 +531,63 @@ BOOST_AUTO_TEST_CASE(rolling_bloom)
     g_mock_deterministic_tests = false;
 }
 
+BOOST_AUTO_TEST_CASE(blocked_rolling_bloom)
+{
+    SeedInsecureRand(/* deterministic */ true);
+
+    // last-100-entry, 1% false positive:
+    CBlockedRollingBloomFilter rb1(100, 0.01);
+
+    // Overfill, ending with every generation full:
+    static const int DATASIZE=408;
+    std::vector<uint256> data(DATASIZE);
+    for (int i = 0; i < DATASIZE; i++) {
+        data[i] = InsecureRand256();
+        rb1.insert(data[i]);
+    }
+    // Last 100 guaranteed to be remembered:
+    for (int i = DATASIZE - 100; i < DATASIZE; i++) {
+        BOOST_CHECK(rb1.contains(data[i]));
+    }
+
+    // Expect less than 100 hits when testing 10,000 random keys
+    unsigned int nHits = 0;
+    for (int i = 0; i < 10000; i++) {
+        if (rb1.contains(InsecureRand256()))
+            ++nHits;
+    }
+    BOOST_CHECK(nHits < 150);
+
+    BOOST_CHECK(rb1.contains(data[DATASIZE-1]));
+    rb1.reset();
+    BOOST_CHECK(!rb1.contains(data[DATASIZE-1]));
+
+    // Now roll through data, make sure last 100 entries
+    // are always remembered:
+    for (int i = 0; i < DATASIZE; i++) {
+        if (i >= 100)
+            BOOST_CHECK(rb1.contains(data[i-100]));
+        rb1.insert(data[i]);
+        BOOST_CHECK(rb1.contains(data[i]));
+    }
+
+    // Insert 999 more random entries, the old ones are forgotten:
+    for (int i = 0; i < 999; i++) {
+        uint256 d = InsecureRand256();
+        rb1.insert(d);
+        BOOST_CHECK(rb1.contains(d));
+    }
+    nHits = 0;
+    for (int i = 0; i < DATASIZE; i++) {
+        if (rb1.contains(data[i]))
+            ++nHits;
+    }
+    BOOST_CHECK(nHits < 20);
+
+    // The blocks are filled unevenly, the filter is sized for it
+    BOOST_CHECK(CBlockedRollingBloomFilter::FalsePositiveRate(1000, 100, 5) > CBlockedRollingBloomFilter::FalsePositiveRate(1000, 200, 5));
+    CBlockedRollingBloomFilter rb2(50000, 0.000001);
+    BOOST_CHECK(rb2.DynamicMemoryUsage() < 400000);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
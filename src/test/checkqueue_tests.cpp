@@ -125,7 +125,33 @@ struct FrozenCleanupCheck {
     void swap(FrozenCleanupCheck& x){std::swap(should_freeze, x.should_freeze);};
 };
 
+struct BlockingCheck {
+    static std::atomic<size_t> n_calls;
+    static std::atomic<bool> fBlocked;
+    static std::condition_variable cv;
+    static std::mutex m;
+    static bool fRelease;
+    bool should_block {false};
+    bool operator()()
+    {
+        if (should_block) {
+            std::unique_lock<std::mutex> l(m);
+            fBlocked = true;
+            cv.wait(l, []{ return fRelease; });
+        } else {
+            n_calls.fetch_add(1, std::memory_order_relaxed);
+        }
+        return true;
+    }
+    void swap(BlockingCheck& x){std::swap(should_block, x.should_block);};
+};
+
 // Static Allocations
+std::atomic<size_t> BlockingCheck::n_calls{0};
+std::atomic<bool> BlockingCheck::fBlocked{false};
+std::condition_variable BlockingCheck::cv{};
+std::mutex BlockingCheck::m{};
+bool BlockingCheck::fRelease{false};
 std::mutex FrozenCleanupCheck::m{};
 std::atomic<uint64_t> FrozenCleanupCheck::nFrozen{0};
 std::condition_variable FrozenCleanupCheck::cv{};
@@ -141,6 +167,7 @@ typedef CCheckQueue<FailingCheck> Failing_Queue;
 typedef CCheckQueue<UniqueCheck> Unique_Queue;
 typedef CCheckQueue<MemoryCheck> Memory_Queue;
 typedef CCheckQueue<FrozenCleanupCheck> FrozenCleanup_Queue;
+typedef CCheckQueue<BlockingCheck> Blocking_Queue;
 
 
 /** This test case checks that the CCheckQueue works properly
@@ -381,6 +408,44 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_FrozenCleanup)
     BOOST_REQUIRE(!fails);
 }
 
+// Test that the checks queued for a busy worker are stolen by the others
+BOOST_AUTO_TEST_CASE(test_CheckQueue_Steals)
+{
+    auto queue = MakeUnique<Blocking_Queue>(QUEUE_BATCH_SIZE);
+    boost::thread_group tg;
+    for (auto x = 0; x < nScriptCheckThreads; ++x) {
+        tg.create_thread([&]{queue->Thread();});
+    }
+    const size_t nChecks = 1000;
+    std::thread t0([&]() {
+        CCheckQueueControl<BlockingCheck> control(queue.get());
+        std::vector<BlockingCheck> vChecks(1);
+        vChecks[0].should_block = true;
+        control.Add(vChecks);
+        // Let a worker take the blocking check alone
+        while (!BlockingCheck::fBlocked)
+            MilliSleep(1);
+        for (size_t i = 0; i < nChecks / 10; i++) {
+            vChecks.resize(10);
+            control.Add(vChecks);
+        }
+        bool waitResult = control.Wait();
+        assert(waitResult);
+    });
+    // Every check but the blocked one is done while its worker is busy
+    for (auto x = 0; x < 10000 && BlockingCheck::n_calls < nChecks; ++x) {
+        MilliSleep(1);
+    }
+    BOOST_CHECK_EQUAL(BlockingCheck::n_calls, nChecks);
+    {
+        std::unique_lock<std::mutex> l(BlockingCheck::m);
+        BlockingCheck::fRelease = true;
+    }
+    BlockingCheck::cv.notify_all();
+    t0.join();
+    tg.interrupt_all();
+    tg.join_all();
+}
 
 /** Test that CCheckQueueControl is threadsafe */
 BOOST_AUTO_TEST_CASE(test_CheckQueueControl_Locks)
@@ -7,6 +7,7 @@
 #include <consensus/validation.h>
 #include <script/standard.h>
 #include <test/test_bitcoin.h>
+#include <txdb.h>
 #include <uint256.h>
 #include <undo.h>
 #include <util/strencodings.h>
@@ -589,7 +590,8 @@ void GetCoinsMapEntry(const CCoinsMap& map, CAmount& value, char& flags)
 
 void WriteCoinsViewEntry(CCoinsView& view, CAmount value, char flags)
 {
-    CCoinsMap map;
+    CCoinsMapMemoryResource resource;
+    CCoinsMap map(0, CCoinsMap::hasher(), CCoinsMap::key_equal(), &resource);
     InsertCoinsMapEntry(map, value, flags);
     BOOST_CHECK(view.BatchWrite(map, {}));
 }
@@ -858,4 +860,74 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+BOOST_AUTO_TEST_CASE(ccoins_sync_background_flush)
+{
+    CCoinsViewDB db(1 << 20, true);
+    CCoinsViewBackgroundFlush flusher(&db);
+    CCoinsViewCache cache(&flusher);
+
+    COutPoint outpoint1(InsecureRand256(), 0);
+    COutPoint outpoint2(InsecureRand256(), 1);
+    Coin coin(CTxOut(1000, CScript() << OP_TRUE), 1, false, false);
+    cache.AddCoin(outpoint1, Coin(coin), false);
+    cache.AddCoin(outpoint2, Coin(coin), false);
+    uint256 block1 = InsecureRand256();
+    cache.SetBestBlock(block1);
+
+    // Sync keeps the coins cached, and they are on disk once the flush is written
+    BOOST_CHECK(cache.Sync());
+    BOOST_CHECK(cache.HaveCoinInCache(outpoint1));
+    BOOST_CHECK(cache.HaveCoinInCache(outpoint2));
+    BOOST_CHECK(flusher.GetBestBlock() == block1);
+    BOOST_CHECK(flusher.HaveCoin(outpoint1));
+    BOOST_CHECK(flusher.Wait());
+    BOOST_CHECK(db.GetBestBlock() == block1);
+    BOOST_CHECK(db.HaveCoin(outpoint1));
+    BOOST_CHECK(db.HaveCoin(outpoint2));
+
+    // A spent coin leaves the cache on Sync, and the database after the flush
+    BOOST_CHECK(cache.SpendCoin(outpoint1));
+    uint256 block2 = InsecureRand256();
+    cache.SetBestBlock(block2);
+    BOOST_CHECK(cache.Sync());
+    BOOST_CHECK(!cache.HaveCoinInCache(outpoint1));
+    BOOST_CHECK(!cache.HaveCoin(outpoint1));
+    BOOST_CHECK(cache.HaveCoinInCache(outpoint2));
+
+    // Flush empties the cache; the coins are read back through the flusher
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+    BOOST_CHECK(cache.HaveCoin(outpoint2));
+    BOOST_CHECK(flusher.Wait());
+    BOOST_CHECK(db.GetBestBlock() == block2);
+    BOOST_CHECK(!db.HaveCoin(outpoint1));
+    BOOST_CHECK(db.HaveCoin(outpoint2));
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_background_flush_written)
+{
+    CCoinsViewDB db(1 << 20, true);
+    CCoinsViewBackgroundFlush flusher(&db);
+    CCoinsViewCache cache(&flusher);
+
+    // Without a flush in flight, the callback runs at once
+    int nWritten = 0;
+    flusher.WhenWritten([&nWritten] { nWritten++; });
+    BOOST_CHECK_EQUAL(nWritten, 1);
+
+    // Otherwise once the coins are on disk, at the best block of the flush
+    COutPoint outpoint(InsecureRand256(), 0);
+    cache.AddCoin(outpoint, Coin(CTxOut(1000, CScript() << OP_TRUE), 1, false, false), false);
+    uint256 block = InsecureRand256();
+    cache.SetBestBlock(block);
+    BOOST_CHECK(cache.Flush());
+    uint256 blockWritten;
+    bool fHaveCoin = false;
+    flusher.WhenWritten([&] { nWritten++; blockWritten = db.GetBestBlock(); fHaveCoin = db.HaveCoin(outpoint); });
+    BOOST_CHECK(flusher.Wait());
+    BOOST_CHECK_EQUAL(nWritten, 2);
+    BOOST_CHECK(blockWritten == block);
+    BOOST_CHECK(fHaveCoin);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -4,6 +4,8 @@
 
 #include <crypto/aes.h>
 #include <crypto/chacha20.h>
+#include <crypto/keccak.h>
+#include <crypto/muhash.h>
 #include <crypto/ripemd160.h>
 #include <crypto/sha1.h>
 #include <crypto/sha256.h>
@@ -562,4 +564,70 @@ BOOST_AUTO_TEST_CASE(sha256d64)
     }
 }
 
+BOOST_AUTO_TEST_CASE(keccak256)
+{
+    unsigned char out[32];
+    Keccak256(nullptr, 0, out);
+    BOOST_CHECK_EQUAL(HexStr(out, out + 32), "c5d2460186f7233c927e7db2dcc703c0e500b653ca82273b7bfad8045d85a470");
+    Keccak256((const unsigned char*)"abc", 3, out);
+    BOOST_CHECK_EQUAL(HexStr(out, out + 32), "4e03657aea45a94fc7d47ba826c8d667c0d1e6e33a64a036ec44f58fa12d6c45");
+
+    // The batch path agrees with the scalar one over lengths around the block size
+    std::vector<unsigned char> in(KECCAK256_RATE * 4);
+    for (unsigned char& c : in)
+        c = InsecureRandBits(8);
+    std::vector<std::pair<const unsigned char*, size_t>> inputs;
+    for (size_t len = 0; len <= in.size(); len += 17)
+        inputs.emplace_back(in.data() + in.size() - len, len);
+    std::vector<unsigned char> batch(inputs.size() * 32);
+    Keccak256Batch(inputs, batch.data());
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        Keccak256(inputs[i].first, inputs[i].second, out);
+        BOOST_CHECK(memcmp(out, batch.data() + 32 * i, 32) == 0);
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE(muhash3072)
+{
+    // The empty set is the number one
+    unsigned char one[Num3072::BYTE_SIZE] = {1};
+    uint256 expected, out;
+    CSHA256().Write(one, sizeof(one)).Finalize(expected.begin());
+    MuHash3072().Finalize(out);
+    BOOST_CHECK(out == expected);
+
+    std::vector<std::vector<unsigned char>> elements;
+    for (int i = 0; i < 16; ++i) {
+        std::vector<unsigned char> element(InsecureRandRange(100));
+        for (unsigned char& c : element)
+            c = InsecureRandBits(8);
+        element.push_back(i);
+        elements.push_back(element);
+    }
+    auto insert = [&](MuHash3072& muhash, size_t i) {
+        const std::vector<unsigned char>& element = elements[i];
+        muhash.Insert(MakeSpan(element));
+    };
+
+    // The hash does not depend on the order of the elements or how they are split up
+    MuHash3072 forward, backward, first, second, fewer;
+    for (size_t i = 0; i < elements.size(); ++i) {
+        insert(forward, i);
+        insert(backward, elements.size() - 1 - i);
+        insert(i % 3 ? first : second, i);
+        if (i > 0) insert(fewer, i);
+    }
+    first *= second;
+    uint256 hash_forward, hash_backward, hash_split, hash_fewer;
+    forward.Finalize(hash_forward);
+    backward.Finalize(hash_backward);
+    first.Finalize(hash_split);
+    fewer.Finalize(hash_fewer);
+    BOOST_CHECK(hash_forward == hash_backward);
+    BOOST_CHECK(hash_forward == hash_split);
+    BOOST_CHECK(hash_forward != hash_fewer);
+    BOOST_CHECK(hash_forward != out);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
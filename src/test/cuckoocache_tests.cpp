@@ -362,4 +362,28 @@ BOOST_AUTO_TEST_CASE(cuckoocache_generations)
     test_cache_generations<CuckooCache::cache<uint256, SignatureCacheHasher>>();
 }
 
+/** Test that resize keeps the recent entries and that overfilling counts evictions
+ */
+BOOST_AUTO_TEST_CASE(cuckoocache_resize)
+{
+    SeedInsecureRand(true);
+    CuckooCache::cache<uint256, SignatureCacheHasher> cc{};
+    BOOST_CHECK_EQUAL(cc.setup(1 << 10), 1U << 10);
+    std::vector<uint256> hashes(1 << 12);
+    for (uint256& hash : hashes) {
+        hash = InsecureRand256();
+        cc.insert(hash);
+    }
+    // Four times the capacity was inserted
+    BOOST_CHECK(cc.evicted() >= (1 << 11));
+
+    BOOST_CHECK_EQUAL(cc.resize(1 << 11), 1U << 11);
+    BOOST_CHECK_EQUAL(cc.capacity(), 1U << 11);
+    uint32_t count = 0;
+    for (size_t i = hashes.size() - 256; i < hashes.size(); ++i)
+        count += cc.contains(hashes[i], false);
+    BOOST_CHECK(count > 250);
+    BOOST_CHECK(!cc.contains(InsecureRand256(), false));
+}
+
 BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,65 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <logging.h>
+#include <test/test_bitcoin.h>
+
+#include <thread>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(logging_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(logging_async_order)
+{
+    fs::path tmpfolder = SetDataDir("logging_async_order");
+    BCLog::Logger logger;
+    logger.m_log_timestamps = false;
+    logger.m_print_to_file = true;
+    logger.m_file_path = tmpfolder / "debug.log";
+    logger.m_file_pathVM = tmpfolder / "vm.log";
+    BOOST_REQUIRE(logger.OpenDebugLog());
+
+    // More messages than the ring holds, so the loggers also wait for the writer
+    const int nThreads = 4;
+    const int nMessages = BCLog::Logger::LOG_RING_SIZE;
+    logger.StartAsync();
+    BOOST_CHECK(logger.IsAsync());
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nThreads; t++) {
+        threads.emplace_back([&logger, t, nMessages] {
+            for (int i = 0; i < nMessages; i++) {
+                logger.LogPrintStr(strprintf("%d %d\n", t, i));
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    logger.LogPrintStr("vm\n", true);
+    logger.StopAsync();
+    BOOST_CHECK(!logger.IsAsync());
+    logger.LogPrintStr("done\n");
+
+    // Every message is written once, in the order of each thread
+    std::vector<int> vNext(nThreads, 0);
+    fsbridge::ifstream file(logger.m_file_path);
+    std::string line;
+    int nLines = 0;
+    while (std::getline(file, line) && line != "done") {
+        int t, i;
+        BOOST_REQUIRE(sscanf(line.c_str(), "%d %d", &t, &i) == 2);
+        BOOST_REQUIRE(t >= 0 && t < nThreads);
+        BOOST_CHECK_EQUAL(i, vNext[t]++);
+        nLines++;
+    }
+    BOOST_CHECK_EQUAL(line, "done");
+    BOOST_CHECK_EQUAL(nLines, nThreads * nMessages);
+
+    fsbridge::ifstream fileVM(logger.m_file_pathVM);
+    BOOST_CHECK(std::getline(fileVM, line));
+    BOOST_CHECK_EQUAL(line, "vm");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
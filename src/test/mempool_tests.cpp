@@ -5,6 +5,7 @@
 #include <policy/policy.h>
 #include <txmempool.h>
 #include <util/system.h>
+#include <util/strencodings.h>
 
 #include <test/test_bitcoin.h>
 
@@ -418,6 +419,112 @@ BOOST_AUTO_TEST_CASE(MempoolAncestorIndexingTest)
     CheckSort<ancestor_score>(pool, sortedOrder);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolGasPriceIndexingTest)
+{
+    CTxMemPool pool;
+    LOCK2(cs_main, pool.cs);
+    TestMemPoolEntryHelper entry;
+    CScript scriptCall = CScript() << CScriptNum(4) << CScriptNum(250000) << CScriptNum(40) << ParseHex("00") << ParseHex("0000000000000000000000000000000000000001") << OP_CALL;
+
+    /* not a contract tx, with the highest fee */
+    CMutableTransaction tx1 = CMutableTransaction();
+    tx1.vout.resize(1);
+    tx1.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx1.vout[0].nValue = 10 * COIN;
+    pool.addUnchecked(entry.Fee(100000LL).FromTx(tx1));
+
+    /* lowest gas price */
+    CMutableTransaction tx2 = CMutableTransaction();
+    tx2.vout.resize(1);
+    tx2.vout[0].scriptPubKey = scriptCall;
+    tx2.vout[0].nValue = 1 * COIN;
+    pool.addUnchecked(entry.Fee(10000LL).GasPrice(40).GasLimit(100000).FromTx(tx2));
+
+    /* same gas price, lower gas limit */
+    CMutableTransaction tx3 = CMutableTransaction();
+    tx3.vout.resize(1);
+    tx3.vout[0].scriptPubKey = scriptCall;
+    tx3.vout[0].nValue = 2 * COIN;
+    pool.addUnchecked(entry.Fee(10000LL).GasPrice(40).GasLimit(50000).FromTx(tx3));
+
+    /* highest gas price */
+    CMutableTransaction tx4 = CMutableTransaction();
+    tx4.vout.resize(1);
+    tx4.vout[0].scriptPubKey = scriptCall;
+    tx4.vout[0].nValue = 3 * COIN;
+    pool.addUnchecked(entry.Fee(10000LL).GasPrice(100).GasLimit(250000).FromTx(tx4));
+
+    std::vector<std::string> sortedOrder;
+    sortedOrder.push_back(tx4.GetHash().ToString());
+    sortedOrder.push_back(tx3.GetHash().ToString());
+    sortedOrder.push_back(tx2.GetHash().ToString());
+    sortedOrder.push_back(tx1.GetHash().ToString());
+    CheckSort<gas_price>(pool, sortedOrder);
+}
+
+BOOST_AUTO_TEST_CASE(MempoolGasLimitTest)
+{
+    CTxMemPool pool;
+    LOCK2(cs_main, pool.cs);
+    TestMemPoolEntryHelper entry;
+    CScript scriptCall = CScript() << CScriptNum(4) << CScriptNum(250000) << CScriptNum(40) << ParseHex("00") << ParseHex("0000000000000000000000000000000000000001") << OP_CALL;
+
+    CMutableTransaction tx1 = CMutableTransaction();
+    tx1.vout.resize(1);
+    tx1.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx1.vout[0].nValue = 10 * COIN;
+    pool.addUnchecked(entry.Fee(10000LL).FromTx(tx1));
+
+    CMutableTransaction tx2 = CMutableTransaction();
+    tx2.vout.resize(2);
+    tx2.vout[0].scriptPubKey = scriptCall;
+    tx2.vout[0].nValue = 0;
+    tx2.vout[1].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx2.vout[1].nValue = 1 * COIN;
+    pool.addUnchecked(entry.Fee(100000LL).GasPrice(40).GasLimit(100000).FromTx(tx2));
+
+    CMutableTransaction tx3 = CMutableTransaction();
+    tx3.vout.resize(1);
+    tx3.vout[0].scriptPubKey = scriptCall;
+    tx3.vout[0].nValue = 2 * COIN;
+    pool.addUnchecked(entry.Fee(100000LL).GasPrice(40).GasLimit(50000).FromTx(tx3));
+
+    CMutableTransaction tx4 = CMutableTransaction();
+    tx4.vout.resize(1);
+    tx4.vout[0].scriptPubKey = scriptCall;
+    tx4.vout[0].nValue = 3 * COIN;
+    pool.addUnchecked(entry.Fee(100000LL).GasPrice(100).GasLimit(250000).FromTx(tx4));
+
+    /* child of tx2 without contracts */
+    CMutableTransaction tx5 = CMutableTransaction();
+    tx5.vin.resize(1);
+    tx5.vin[0].prevout = COutPoint(tx2.GetHash(), 1);
+    tx5.vin[0].scriptSig = CScript() << OP_11;
+    tx5.vout.resize(1);
+    tx5.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx5.vout[0].nValue = 1 * COIN;
+    pool.addUnchecked(entry.Fee(10000LL).FromTx(tx5));
+
+    BOOST_CHECK_EQUAL(pool.GetTotalGas(), 400000U);
+    pool.TrimToGas(400000); // should do nothing
+    BOOST_CHECK_EQUAL(pool.size(), 5U);
+
+    pool.TrimToGas(350000); // should remove the lowest gas price with the highest gas limit, and its child
+    BOOST_CHECK_EQUAL(pool.GetTotalGas(), 300000U);
+    BOOST_CHECK(!pool.exists(tx2.GetHash()));
+    BOOST_CHECK(!pool.exists(tx5.GetHash()));
+    BOOST_CHECK(pool.exists(tx3.GetHash()));
+    BOOST_CHECK(pool.exists(tx4.GetHash()));
+
+    pool.TrimToGas(100000); // even the highest gas price does not fit
+    BOOST_CHECK_EQUAL(pool.GetTotalGas(), 0U);
+    BOOST_CHECK_EQUAL(pool.size(), 1U);
+    BOOST_CHECK(pool.exists(tx1.GetHash()));
+
+    pool.TrimToGas(0); // txs without contracts are never removed
+    BOOST_CHECK_EQUAL(pool.size(), 1U);
+}
+
 
 BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
 {
@@ -749,4 +856,39 @@ BOOST_AUTO_TEST_CASE(MempoolAncestryTests)
     BOOST_CHECK_EQUAL(descendants, 6ULL);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolEpochVisited)
+{
+    // Marks of a traversal count only under its own guard
+    TestMemPoolEntryHelper entry;
+    CTxMemPool pool;
+    LOCK2(cs_main, pool.cs);
+    std::vector<CTxMemPool::txiter> entries;
+    for (int i = 0; i < 3; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].scriptSig = CScript() << i;
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        tx.vout[0].nValue = 10000LL;
+        pool.addUnchecked(entry.FromTx(tx));
+        entries.push_back(pool.mapTx.find(tx.GetHash()));
+    }
+
+    {
+        const CTxMemPool::EpochGuard epoch = pool.GetFreshEpoch();
+        BOOST_CHECK(!pool.visited(entries[0]));
+        BOOST_CHECK(!pool.visited(entries[1]));
+        BOOST_CHECK(pool.visited(entries[0]));
+        BOOST_CHECK(pool.visited(entries[1]));
+        BOOST_CHECK(pool.visited(entries[0]));
+    }
+    {
+        const CTxMemPool::EpochGuard epoch = pool.GetFreshEpoch();
+        for (const CTxMemPool::txiter& it : entries)
+            BOOST_CHECK(!pool.visited(it));
+        for (const CTxMemPool::txiter& it : entries)
+            BOOST_CHECK(pool.visited(it));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,174 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <mempooladdressindex.h>
+#include <key.h>
+#include <script/standard.h>
+#include <test/test_bitcoin.h>
+#include <txmempool.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(mempooladdressindex_tests, TestingSetup)
+
+#ifdef ENABLE_BITCORE_RPC
+namespace {
+
+typedef CMempoolAddressIndex::AddressDelta AddressDelta;
+
+AddressDelta Delta(const uint256& address, const uint256& txhash, unsigned int index, CAmount amount)
+{
+    return AddressDelta(CMempoolAddressDeltaKey(1, address, txhash, index, 0), CMempoolAddressDelta(0, amount));
+}
+
+std::vector<AddressDelta> GetDeltas(const CMempoolAddressIndex& index, const std::vector<uint256>& addresses)
+{
+    std::vector<std::pair<uint256, int> > ids;
+    for (const uint256& address : addresses)
+        ids.emplace_back(address, 1);
+    std::vector<AddressDelta> results;
+    index.GetAddressDeltas(ids, results);
+    return results;
+}
+
+/** The address index key of a P2PKH destination */
+uint256 AddressKey(const CKeyID& id)
+{
+    std::vector<unsigned char> addressBytes(32);
+    std::copy(id.begin(), id.end(), addressBytes.begin());
+    return uint256(addressBytes);
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(address_index_add_remove)
+{
+    CMempoolAddressIndex index;
+    uint256 addressA = InsecureRand256(), addressB = InsecureRand256();
+    uint256 tx1 = InsecureRand256(), tx2 = InsecureRand256();
+    index.AddAddressDeltas(tx1, {Delta(addressA, tx1, 0, 10), Delta(addressB, tx1, 1, 20), Delta(addressA, tx1, 2, 30)});
+    index.AddAddressDeltas(tx2, {Delta(addressA, tx2, 0, 40)});
+
+    // The deltas of an address are in key order, whatever the order they were added in
+    std::vector<AddressDelta> deltas = GetDeltas(index, {addressA});
+    BOOST_REQUIRE_EQUAL(deltas.size(), 3U);
+    CMempoolAddressDeltaKeyCompare less;
+    for (size_t i = 1; i < deltas.size(); i++)
+        BOOST_CHECK(less(deltas[i - 1].first, deltas[i].first));
+    BOOST_CHECK_EQUAL(GetDeltas(index, {addressB}).size(), 1U);
+
+    // Removing a tx only removes its own deltas, on every address it touched
+    index.RemoveAddressDeltas(tx1);
+    deltas = GetDeltas(index, {addressA, addressB});
+    BOOST_REQUIRE_EQUAL(deltas.size(), 1U);
+    BOOST_CHECK(deltas[0].first.txhash == tx2);
+    BOOST_CHECK_EQUAL(deltas[0].second.amount, 40);
+
+    // Removing it again, or a tx never added, does nothing
+    index.RemoveAddressDeltas(tx1);
+    index.RemoveAddressDeltas(InsecureRand256());
+    BOOST_CHECK_EQUAL(GetDeltas(index, {addressA}).size(), 1U);
+
+    index.RemoveAddressDeltas(tx2);
+    BOOST_CHECK(GetDeltas(index, {addressA, addressB}).empty());
+}
+
+BOOST_AUTO_TEST_CASE(address_index_cross_shard)
+{
+    // Enough addresses to land in every shard
+    const size_t nAddresses = MEMPOOL_ADDRESS_INDEX_SHARDS * 8;
+    CMempoolAddressIndex index;
+    uint256 txhash = InsecureRand256();
+    std::vector<uint256> addresses;
+    std::vector<AddressDelta> added;
+    for (size_t i = 0; i < nAddresses; i++) {
+        addresses.push_back(InsecureRand256());
+        added.push_back(Delta(addresses.back(), txhash, i, i + 1));
+    }
+    index.AddAddressDeltas(txhash, added);
+
+    // A lookup over many shards returns the deltas address by address, in the order asked
+    std::vector<uint256> reversed(addresses.rbegin(), addresses.rend());
+    std::vector<AddressDelta> deltas = GetDeltas(index, reversed);
+    BOOST_REQUIRE_EQUAL(deltas.size(), nAddresses);
+    for (size_t i = 0; i < nAddresses; i++) {
+        BOOST_CHECK(deltas[i].first.addressBytes == reversed[i]);
+        BOOST_CHECK_EQUAL(deltas[i].second.amount, (CAmount)(nAddresses - i));
+    }
+
+    // The spent entries of a tx are found whatever shard holds them
+    std::vector<CMempoolAddressIndex::Spent> spent;
+    for (size_t i = 0; i < nAddresses; i++)
+        spent.emplace_back(CSpentIndexKey(InsecureRand256(), i), CSpentIndexValue(txhash, i, -1, i, 1, addresses[i]));
+    index.AddSpent(txhash, spent);
+    for (const auto& entry : spent) {
+        CSpentIndexValue value;
+        BOOST_REQUIRE(index.GetSpent(entry.first, value));
+        BOOST_CHECK(value.addressHash == entry.second.addressHash);
+    }
+
+    index.RemoveAddressDeltas(txhash);
+    index.RemoveSpent(txhash);
+    BOOST_CHECK(GetDeltas(index, addresses).empty());
+    for (const auto& entry : spent) {
+        CSpentIndexValue value;
+        BOOST_CHECK(!index.GetSpent(entry.first, value));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(address_index_reorg_removal)
+{
+    CTxMemPool pool;
+    TestMemPoolEntryHelper entry;
+    CCoinsView dummy;
+    CCoinsViewCache view(&dummy);
+
+    CKey key;
+    key.MakeNewKey(true);
+    CKeyID id = key.GetPubKey().GetID();
+    CScript script = GetScriptForDestination(id);
+
+    // A tx spending a confirmed coin of the address, and a child spending it in turn
+    COutPoint prevout(InsecureRand256(), 0);
+    view.AddCoin(prevout, Coin(CTxOut(10 * COIN, script), 1, false), false);
+    CMutableTransaction parent;
+    parent.vin.emplace_back(prevout);
+    parent.vout.emplace_back(9 * COIN, script);
+    view.AddCoin(COutPoint(parent.GetHash(), 0), Coin(parent.vout[0], MEMPOOL_HEIGHT, false), false);
+    CMutableTransaction child;
+    child.vin.emplace_back(COutPoint(parent.GetHash(), 0));
+    child.vout.emplace_back(8 * COIN, script);
+
+    {
+        LOCK2(cs_main, pool.cs);
+        for (const CMutableTransaction& tx : {parent, child}) {
+            CTxMemPoolEntry poolEntry = entry.FromTx(tx);
+            pool.addUnchecked(poolEntry);
+            pool.addAddressIndex(poolEntry, view);
+            pool.addSpentIndex(poolEntry, view);
+        }
+    }
+
+    std::vector<std::pair<uint256, int> > addresses{{AddressKey(id), 1}};
+    std::vector<AddressDelta> deltas;
+    pool.getAddressIndex(addresses, deltas);
+    // Spending and receiving by both txs
+    BOOST_CHECK_EQUAL(deltas.size(), 4U);
+    CSpentIndexKey spentKey(prevout.hash, prevout.n);
+    CSpentIndexValue spentValue;
+    BOOST_CHECK(pool.getSpentIndex(spentKey, spentValue));
+    BOOST_CHECK(spentValue.txid == parent.GetHash());
+
+    // A reorg that conflicts with the parent takes both txs out of the indexes
+    pool.removeRecursive(CTransaction(parent), MemPoolRemovalReason::REORG);
+    BOOST_CHECK_EQUAL(pool.size(), 0U);
+    deltas.clear();
+    pool.getAddressIndex(addresses, deltas);
+    BOOST_CHECK(deltas.empty());
+    BOOST_CHECK(!pool.getSpentIndex(spentKey, spentValue));
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
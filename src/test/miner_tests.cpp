@@ -16,6 +16,7 @@
 #include <txmempool.h>
 #include <uint256.h>
 #include <util/system.h>
+#include <util/time.h>
 #include <util/strencodings.h>
 
 #include <test/test_bitcoin.h>
@@ -642,4 +643,88 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     fCheckpointsEnabled = true;
 }
 
+BOOST_AUTO_TEST_CASE(contract_cost_estimator)
+{
+    ContractCostEstimator estimator;
+    dev::Address contract1("0101010101010101010101010101010101010101");
+    dev::Address contract2("0202020202020202020202020202020202020202");
+    QtumTransaction call1(0, 1, 100000, contract1, dev::bytes(), 0);
+    QtumTransaction call2(0, 1, 100000, contract2, dev::bytes(), 0);
+    QtumTransaction create(0, 1, 100000, dev::bytes(), 0);
+
+    // Contracts never executed and creations are estimated at zero
+    BOOST_CHECK_EQUAL(estimator.Estimate({call1, call2, create}), 0);
+
+    estimator.Add({call1, create}, {4000, 9000});
+    BOOST_CHECK_EQUAL(estimator.Estimate({call1}), 4000);
+    BOOST_CHECK_EQUAL(estimator.Estimate({create}), 0);
+
+    // Later executions move the estimate by a quarter of the difference
+    estimator.Add({call1}, {8000});
+    BOOST_CHECK_EQUAL(estimator.Estimate({call1}), 5000);
+    estimator.Add({call2}, {1000});
+    BOOST_CHECK_EQUAL(estimator.Estimate({call1, call2, call1}), 11000);
+}
+
+// Waits for the builder to have a template for that tip, slot and script
+static std::unique_ptr<CBlockTemplate> WaitStakeTemplate(StakeTemplateBuilder& builder, const uint256& hashPrev, uint32_t nTime, const CScript& script)
+{
+    int64_t nFees = 0;
+    std::unique_ptr<CBlockTemplate> pblocktemplate;
+    for (int i = 0; i < 100 && !pblocktemplate; i++) {
+        MilliSleep(STAKE_TEMPLATE_POLLING_PERIOD / 5);
+        pblocktemplate = builder.Get(hashPrev, nTime, script, nFees);
+    }
+    return pblocktemplate;
+}
+
+BOOST_FIXTURE_TEST_CASE(stake_template_builder, TestChain100Setup)
+{
+    // The slot does not move while the time is mocked
+    SetMockTime(GetTime());
+    uint32_t nTime = GetAdjustedTime() & ~STAKE_TIMESTAMP_MASK;
+    CScript script = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    uint256 hashTip;
+    {
+        LOCK(cs_main);
+        hashTip = chainActive.Tip()->GetBlockHash();
+    }
+
+    StakeTemplateBuilder builder;
+    int64_t nFees = 0;
+    MilliSleep(STAKE_TEMPLATE_POLLING_PERIOD * 2);
+    BOOST_CHECK(!builder.Get(hashTip, nTime, script, nFees));
+
+    builder.SetScript(script);
+    std::unique_ptr<CBlockTemplate> pblocktemplate = WaitStakeTemplate(builder, hashTip, nTime, script);
+    BOOST_REQUIRE(pblocktemplate);
+    BOOST_CHECK(pblocktemplate->block.IsProofOfStake());
+    BOOST_CHECK_EQUAL(pblocktemplate->block.nTime, nTime);
+    BOOST_CHECK(pblocktemplate->block.vtx[1]->vout[1].scriptPubKey == script);
+
+    // Contract results depend on the block, so another tip, slot or script gets nothing
+    BOOST_CHECK(!builder.Get(hashTip, nTime + STAKE_TIMESTAMP_MASK + 1, script, nFees));
+    BOOST_CHECK(!builder.Get(hashTip, nTime, CScript() << OP_TRUE, nFees));
+    BOOST_CHECK(!builder.Get(uint256(), nTime, script, nFees));
+
+    // The copy handed out is the staker's own
+    pblocktemplate->block.vtx.clear();
+    BOOST_CHECK(builder.Get(hashTip, nTime, script, nFees)->block.vtx.size() >= 2);
+
+    // A new tip gets a new template
+    CreateAndProcessBlock({}, script);
+    uint256 hashNewTip;
+    {
+        LOCK(cs_main);
+        hashNewTip = chainActive.Tip()->GetBlockHash();
+    }
+    BOOST_CHECK(hashNewTip != hashTip);
+    pblocktemplate = WaitStakeTemplate(builder, hashNewTip, nTime, script);
+    BOOST_REQUIRE(pblocktemplate);
+    BOOST_CHECK(pblocktemplate->block.hashPrevBlock == hashNewTip);
+    BOOST_CHECK(!builder.Get(hashTip, nTime, script, nFees));
+
+    SetMockTime(0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
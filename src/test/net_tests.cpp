@@ -302,5 +302,41 @@ BOOST_AUTO_TEST_CASE(LocalAddress_BasicLifecycle)
     BOOST_CHECK_EQUAL(IsLocal(addr), false);
 }
 
+BOOST_AUTO_TEST_CASE(recv_buffer_pool)
+{
+    CNetRecvBufferPool pool;
+
+    // A fresh buffer has room for the whole class
+    CSerializeData buffer = pool.Acquire(3000);
+    BOOST_CHECK(buffer.empty());
+    BOOST_CHECK(buffer.capacity() >= 4096);
+    const char* data = buffer.data();
+    buffer.resize(3000);
+
+    // Released buffers are cleared and handed out again for the same class
+    pool.Release(std::move(buffer));
+    BOOST_CHECK_EQUAL(pool.Count(), 1U);
+    CSerializeData reused = pool.Acquire(2000);
+    BOOST_CHECK(reused.empty());
+    BOOST_CHECK(reused.data() == data);
+    BOOST_CHECK_EQUAL(pool.Count(), 0U);
+
+    // Requests past the largest class are served by it, and buffers grown far past it are freed
+    CSerializeData large = pool.Acquire(4 * CNetRecvBufferPool::MAX_CLASS_SIZE);
+    BOOST_CHECK(large.capacity() >= CNetRecvBufferPool::MAX_CLASS_SIZE);
+    large.reserve(4 * CNetRecvBufferPool::MAX_CLASS_SIZE);
+    pool.Release(std::move(large));
+    BOOST_CHECK_EQUAL(pool.Count(), 0U);
+
+    // Each class holds a bounded number of bytes
+    std::vector<CSerializeData> buffers;
+    for (size_t i = 0; i <= CNetRecvBufferPool::CLASS_BYTES / CNetRecvBufferPool::MAX_CLASS_SIZE; i++)
+        buffers.push_back(pool.Acquire(CNetRecvBufferPool::MAX_CLASS_SIZE));
+    for (CSerializeData& b : buffers)
+        pool.Release(std::move(b));
+    BOOST_CHECK_EQUAL(pool.Count(), CNetRecvBufferPool::CLASS_BYTES / CNetRecvBufferPool::MAX_CLASS_SIZE);
+    BOOST_CHECK(pool.Bytes() <= 2 * CNetRecvBufferPool::CLASS_BYTES);
+}
+
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -6,6 +6,7 @@
 #include <policy/fees.h>
 #include <txmempool.h>
 #include <uint256.h>
+#include <util/strencodings.h>
 #include <util/system.h>
 
 #include <test/test_bitcoin.h>
@@ -180,4 +181,45 @@ BOOST_AUTO_TEST_CASE(BlockPolicyEstimates)
     }
 }
 
+BOOST_AUTO_TEST_CASE(GasPriceEstimates)
+{
+    CBlockPolicyEstimator feeEst;
+    CTxMemPool mpool(&feeEst);
+    LOCK2(cs_main, mpool.cs);
+    TestMemPoolEntryHelper entry;
+    BOOST_CHECK(feeEst.estimateGasPrice(2) == 0);
+
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey = CScript() << CScriptNum(4) << CScriptNum(250000) << CScriptNum(40) << ParseHex("00") << ParseHex("0000000000000000000000000000000000000001") << OP_CALL;
+    tx.vout[0].nValue = 0LL;
+
+    // Contract txs with a gas price of 40 * (j+1), where only the 2 highest
+    // gas prices are mined, in the next block, whatever their fee
+    std::vector<CTransactionRef> block;
+    int blocknum = 0;
+    while (blocknum < 40) {
+        for (int j = 0; j < 5; j++) {
+            for (int k = 0; k < 4; k++) {
+                tx.vin[0].prevout.n = 10000*blocknum+100*j+k;
+                uint256 hash = tx.GetHash();
+                mpool.addUnchecked(entry.Fee(100000LL * (5-j)).GasPrice(40 * (j+1)).GasLimit(250000).Height(blocknum).FromTx(tx));
+                if (j >= 3)
+                    block.push_back(mpool.get(hash));
+            }
+        }
+        mpool.removeForBlock(block, ++blocknum);
+        block.clear();
+    }
+
+    int returnedTarget;
+    CAmount gasPrice = feeEst.estimateGasPrice(2, &returnedTarget);
+    BOOST_CHECK_EQUAL(returnedTarget, 2);
+    BOOST_CHECK(gasPrice > 120 && gasPrice <= 200);
+    // Contract txs are not counted in the feerate estimates
+    BOOST_CHECK(feeEst.estimateFee(2) == CFeeRate(0));
+    BOOST_CHECK(feeEst.estimateGasPrice((int)feeEst.HighestGasPriceTargetTracked() + 1) == 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,432 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <arith_uint256.h>
+#include <consensus/merkle.h>
+#include <consensus/validation.h>
+#include <chainparams.h>
+#include <coins.h>
+#include <hash.h>
+#include <pos.h>
+#include <key.h>
+#include <script/interpreter.h>
+#include <script/standard.h>
+#include <txdb.h>
+#include <util/strencodings.h>
+#include <validation.h>
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(pos_tests, BasicTestingSetup)
+
+static CBlockHeader SignedPoSHeader(const COutPoint& prevoutStake, const CKey& key, uint32_t nTime = 1000)
+{
+    CBlockHeader header;
+    header.nTime = nTime;
+    header.prevoutStake = prevoutStake;
+    BOOST_CHECK(key.Sign(header.GetHashWithoutSign(), header.vchBlockSig));
+    return header;
+}
+
+BOOST_AUTO_TEST_CASE(header_signer_recovery)
+{
+    CKey key, otherKey;
+    key.MakeNewKey(true);
+    otherKey.MakeNewKey(true);
+    CCoinsView coinsDummy;
+    CCoinsViewCache view(&coinsDummy);
+    COutPoint prevoutStake(InsecureRand256(), 1);
+    view.AddCoin(prevoutStake, Coin(CTxOut(COIN, GetScriptForDestination(key.GetPubKey().GetID())), 1, false), false);
+
+    // The signer is recovered inline, or found in the cache filled by the headers pre-pass
+    CBlockHeader header = SignedPoSHeader(prevoutStake, key);
+    BOOST_CHECK(CheckRecoveredPubKeyFromBlockSignature(nullptr, header, view));
+    CBlockHeader header2 = SignedPoSHeader(prevoutStake, key, 1016);
+    CacheRecoveredPubKeysFromBlockSignature(header2);
+    BOOST_CHECK(CheckRecoveredPubKeyFromBlockSignature(nullptr, header2, view));
+
+    // Caching the signers of a header signed by another key does not make it pass
+    CBlockHeader forged = SignedPoSHeader(prevoutStake, otherKey);
+    CacheRecoveredPubKeysFromBlockSignature(forged);
+    BOOST_CHECK(!CheckRecoveredPubKeyFromBlockSignature(nullptr, forged, view));
+
+    // Nor does a signature of another header
+    CBlockHeader moved = header;
+    moved.nTime += 16;
+    BOOST_CHECK(!CheckRecoveredPubKeyFromBlockSignature(nullptr, moved, view));
+}
+
+BOOST_AUTO_TEST_CASE(block_signer_cache)
+{
+    CKey key, otherKey;
+    key.MakeNewKey(true);
+    otherKey.MakeNewKey(true);
+    const uint256 hash = InsecureRand256();
+    std::vector<unsigned char> vchSig;
+    BOOST_CHECK(key.Sign(hash, vchSig));
+
+    // Verified, then found in the cache
+    BOOST_CHECK(CheckBlockSigner(hash, vchSig, key.GetPubKey()));
+    BOOST_CHECK(CheckBlockSigner(hash, vchSig, key.GetPubKey()));
+
+    // A verified signature does not pass for another key, another hash or once altered
+    BOOST_CHECK(!CheckBlockSigner(hash, vchSig, otherKey.GetPubKey()));
+    BOOST_CHECK(!CheckBlockSigner(InsecureRand256(), vchSig, key.GetPubKey()));
+    std::vector<unsigned char> vchAltered = vchSig;
+    vchAltered[vchAltered.size() - 1] ^= 1;
+    BOOST_CHECK(!CheckBlockSigner(hash, vchAltered, key.GetPubKey()));
+    BOOST_CHECK(!CheckBlockSigner(hash, std::vector<unsigned char>(), key.GetPubKey()));
+
+    // The signer recovered from a header passes for its block
+    CBlockHeader header = SignedPoSHeader(COutPoint(InsecureRand256(), 0), key);
+    CacheRecoveredPubKeysFromBlockSignature(header);
+    BOOST_CHECK(CheckBlockSigner(header.GetHashWithoutSign(), header.vchBlockSig, key.GetPubKey()));
+    BOOST_CHECK(!CheckBlockSigner(header.GetHashWithoutSign(), header.vchBlockSig, otherKey.GetPubKey()));
+}
+
+BOOST_FIXTURE_TEST_CASE(spent_coin_from_main_chain, TestChain100Setup)
+{
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CMutableTransaction spend;
+    spend.vin.resize(1);
+    spend.vin[0].prevout = COutPoint(m_coinbase_txns[0]->GetHash(), 0);
+    spend.vout.emplace_back(11 * CENT, scriptPubKey);
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptPubKey, spend, 0, SIGHASH_ALL, 0, SigVersion::BASE);
+    BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    spend.vin[0].scriptSig << vchSig;
+
+    const CBlockIndex* pforkBase = chainActive.Tip();
+    CreateAndProcessBlock({spend}, scriptPubKey);
+    BOOST_REQUIRE(chainActive.Tip()->pprev == pforkBase);
+    CreateAndProcessBlock({}, scriptPubKey);
+    CBlockIndex* pindexSpend = chainActive.Tip()->pprev;
+
+    // A fork from below the spending block can still stake the coin, one from above it cannot
+    LOCK(cs_main);
+    Coin coin;
+    BOOST_CHECK(GetSpentCoinFromMainChain(pforkBase, spend.vin[0].prevout, &coin));
+    BOOST_CHECK(coin.out == m_coinbase_txns[0]->vout[0]);
+    BOOST_CHECK(!GetSpentCoinFromMainChain(pindexSpend, spend.vin[0].prevout, &coin));
+    BOOST_CHECK(!GetSpentCoinFromMainChain(pforkBase, COutPoint(m_coinbase_txns[1]->GetHash(), 0), &coin));
+
+    // Disconnected, the block no longer spends it
+    CValidationState state;
+    BOOST_CHECK(InvalidateBlock(state, Params(), pindexSpend));
+    BOOST_CHECK(chainActive.Tip() == pforkBase);
+    BOOST_CHECK(!GetSpentCoinFromMainChain(pforkBase, spend.vin[0].prevout, &coin));
+}
+
+// Index of the first candidate CheckStakeKernelHash accepts, or the number of candidates
+static size_t FirstKernel(CBlockIndex* pindexPrev, unsigned int nBits, uint32_t nTimeBlock, const std::vector<CStakeCandidate>& candidates)
+{
+    for (size_t i = 0; i < candidates.size(); i++) {
+        const CStakeCandidate& candidate = candidates[i];
+        uint256 hashProofOfStake, targetProofOfStake;
+        if (nTimeBlock >= candidate.stake.blockFromTime &&
+            CheckStakeKernelHash(pindexPrev, nBits, candidate.stake.blockFromTime, candidate.stake.amount, candidate.prevout, nTimeBlock, hashProofOfStake, targetProofOfStake, candidate.isSuperStaker))
+            return i;
+    }
+    return candidates.size();
+}
+
+BOOST_AUTO_TEST_CASE(find_stake_kernel)
+{
+    CBlockIndex indexPrev;
+    indexPrev.nStakeModifier = InsecureRand256();
+    indexPrev.nTime = 100000;
+    uint32_t nTimeBlock = indexPrev.nTime + 16;
+
+    // About one coin in 500 has a kernel, some are too recent to stake at all
+    std::vector<CStakeCandidate> candidates;
+    for (size_t i = 0; i < 8 * MIN_STAKE_CANDIDATES_PER_THREAD; i++) {
+        uint32_t blockFromTime = indexPrev.nTime - 1000 + InsecureRandRange(1100);
+        candidates.emplace_back(COutPoint(InsecureRand256(), InsecureRandRange(4)), CStakeCache(blockFromTime, 1), false);
+    }
+    unsigned int nBits = (~arith_uint256(0) / 500).GetCompact();
+
+    // Whatever the number of threads, the first kernel in candidate order is found
+    size_t nExpected = FirstKernel(&indexPrev, nBits, nTimeBlock, candidates);
+    BOOST_REQUIRE(nExpected < candidates.size());
+    for (int nThreads : {1, 2, 3, 8, 16}) {
+        size_t nFound = candidates.size();
+        BOOST_CHECK(FindStakeKernel(&indexPrev, nBits, nTimeBlock, candidates, nThreads, nFound));
+        BOOST_CHECK_EQUAL(nFound, nExpected);
+    }
+
+    // Without the first kernel, the next one is found
+    size_t nFirst = nExpected;
+    candidates.erase(candidates.begin() + nFirst);
+    nExpected = FirstKernel(&indexPrev, nBits, nTimeBlock, candidates);
+    if (nExpected < candidates.size()) {
+        size_t nFound = candidates.size();
+        BOOST_CHECK(FindStakeKernel(&indexPrev, nBits, nTimeBlock, candidates, 8, nFound));
+        BOOST_CHECK_EQUAL(nFound, nExpected);
+        BOOST_CHECK(nFound >= nFirst);
+    }
+
+    // No coin meets a tiny target, except a super staker once 64 seconds have passed
+    unsigned int nBitsTiny = arith_uint256(1).GetCompact();
+    size_t nFound = candidates.size();
+    BOOST_CHECK(!FindStakeKernel(&indexPrev, nBitsTiny, nTimeBlock, candidates, 8, nFound));
+    BOOST_CHECK_EQUAL(nFound, candidates.size());
+    candidates[5000].isSuperStaker = true;
+    candidates[5000].stake.blockFromTime = indexPrev.nTime - 1000;
+    BOOST_CHECK(!FindStakeKernel(&indexPrev, nBitsTiny, nTimeBlock, candidates, 8, nFound));
+    BOOST_CHECK(FindStakeKernel(&indexPrev, nBitsTiny, indexPrev.nTime + 64, candidates, 8, nFound));
+    BOOST_CHECK_EQUAL(nFound, 5000U);
+    BOOST_CHECK_EQUAL(FirstKernel(&indexPrev, nBitsTiny, indexPrev.nTime + 64, candidates), 5000U);
+}
+
+BOOST_AUTO_TEST_CASE(stake_kernel_hasher)
+{
+    uint256 nStakeModifier = InsecureRand256();
+    uint32_t nTimeBlock = InsecureRand32();
+    CStakeKernelHasher hasher(nStakeModifier, nTimeBlock);
+
+    // Reusing the hasher for other coins gives the hash of the serialized kernel of each
+    for (int i = 0; i < 100; i++) {
+        uint32_t blockFromTime = InsecureRand32();
+        COutPoint prevout(InsecureRand256(), InsecureRand32());
+        CDataStream ss(SER_GETHASH, 0);
+        ss << nStakeModifier << blockFromTime << prevout.hash << prevout.n << nTimeBlock;
+        BOOST_CHECK(hasher.Hash(blockFromTime, prevout) == Hash(ss.begin(), ss.end()));
+    }
+}
+
+static uint160 NewStakeAddress()
+{
+    CKey key;
+    key.MakeNewKey(true);
+    return key.GetPubKey().GetID();
+}
+
+BOOST_FIXTURE_TEST_CASE(mpos_script_cache, TestChain100Setup)
+{
+    // The recipients of a block are the stakers of the blocks COINBASE_MATURITY below it
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    const int nBase = 20;
+    const int nHeight = COINBASE_MATURITY + nBase;
+    LOCK(cs_main);
+    std::vector<CScript> expected;
+    for (int i = 0; i < consensusParams.nMPoSRewardRecipients - 1; i++) {
+        CBlockIndex* pindex = chainActive[nBase - i];
+        pindex->prevoutStake = COutPoint(InsecureRand256(), 0);
+        uint160 stakeAddress = NewStakeAddress();
+        BOOST_CHECK(pblocktree->WriteStakeIndex(pindex->nHeight, stakeAddress));
+        expected.push_back(GetScriptForDestination(CKeyID(stakeAddress)));
+    }
+    CBlockIndex* pindex = chainActive[nBase];
+    std::vector<CScript> scripts;
+
+    // Blocks connected before startup are read from the stake index, then kept
+    ClearMPoSScriptCache();
+    BOOST_CHECK(GetMPoSOutputScripts(scripts, nHeight, consensusParams));
+    BOOST_CHECK(scripts == expected);
+    uint160 stakeAddressDisk = NewStakeAddress();
+    BOOST_CHECK(pblocktree->WriteStakeIndex(nBase, stakeAddressDisk));
+    scripts.clear();
+    BOOST_CHECK(GetMPoSOutputScripts(scripts, nHeight, consensusParams));
+    BOOST_CHECK(scripts == expected);
+
+    // A disconnected block is read again
+    RemoveMPoSStakerFromCache(pindex);
+    expected[0] = GetScriptForDestination(CKeyID(stakeAddressDisk));
+    scripts.clear();
+    BOOST_CHECK(GetMPoSOutputScripts(scripts, nHeight, consensusParams));
+    BOOST_CHECK(scripts == expected);
+
+    // A connected block is used without reading the stake index, an unknown staker burns the reward
+    AddMPoSStakerToCache(pindex, uint160());
+    scripts.clear();
+    BOOST_CHECK(GetMPoSOutputScripts(scripts, nHeight, consensusParams));
+    BOOST_CHECK(scripts[0] == CScript() << OP_RETURN);
+
+    // A block of another chain at the same height is not taken for the main chain one
+    uint256 hashFork = InsecureRand256();
+    CBlockIndex indexFork;
+    indexFork.phashBlock = &hashFork;
+    indexFork.nHeight = nBase;
+    indexFork.prevoutStake = COutPoint(InsecureRand256(), 0);
+    AddMPoSStakerToCache(&indexFork, NewStakeAddress());
+    scripts.clear();
+    BOOST_CHECK(GetMPoSOutputScripts(scripts, nHeight, consensusParams));
+    BOOST_CHECK(scripts == expected);
+
+    for (int i = 0; i < consensusParams.nMPoSRewardRecipients - 1; i++)
+        chainActive[nBase - i]->prevoutStake.SetNull();
+    ClearMPoSScriptCache();
+}
+
+BOOST_AUTO_TEST_CASE(super_staker_cache_kernel)
+{
+    CScript scriptSuper = CScript() << OP_DUP << OP_HASH160 << ToByteVector(ParseHex("06156ffdfc890bfc411002385644c15b5e90a749")) << OP_EQUALVERIFY << OP_CHECKSIG;
+    CScript scriptSuperPubKey = GetScriptForRawPubKey(CPubKey(ParseHex("0306ccf3e23ab1102cf06d736e7efe8e9b76c1448aee3c532e799007e2a7bcb5e0")));
+    CScript scriptOther = GetScriptForDestination(CKeyID(NewStakeAddress()));
+    BOOST_CHECK(IsSuperStaker(scriptSuper));
+    BOOST_CHECK(IsSuperStaker(scriptSuperPubKey));
+    BOOST_CHECK(!IsSuperStaker(scriptOther));
+    BOOST_CHECK(!IsSuperStaker(CScript()));
+
+    std::vector<CBlockIndex> blocks(COINBASE_MATURITY + 10);
+    for (size_t i = 0; i < blocks.size(); i++) {
+        blocks[i].nHeight = i;
+        blocks[i].nTime = 1000 + 16 * i;
+        blocks[i].pprev = i ? &blocks[i - 1] : nullptr;
+        blocks[i].BuildSkip();
+    }
+    CBlockIndex* pindexPrev = &blocks.back();
+
+    CCoinsView viewDummy;
+    CCoinsViewCache view(&viewDummy);
+    COutPoint prevoutMature(InsecureRand256(), 0), prevoutImmature(InsecureRand256(), 0), prevoutSuper(InsecureRand256(), 0);
+    view.AddCoin(prevoutMature, Coin(CTxOut(COIN, scriptOther), 5, false), false);
+    view.AddCoin(prevoutImmature, Coin(CTxOut(COIN, scriptOther), pindexPrev->nHeight - 5, false), false);
+    view.AddCoin(prevoutSuper, Coin(CTxOut(2 * COIN, scriptSuper), pindexPrev->nHeight - 5, false), false);
+
+    // Super stakers are exempt from maturity, as when their blocks are checked
+    std::map<COutPoint, CStakeCache> cache;
+    for (const COutPoint& prevout : {prevoutMature, prevoutImmature, prevoutSuper, COutPoint(InsecureRand256(), 0)})
+        CacheKernel(cache, prevout, pindexPrev, view);
+    BOOST_CHECK_EQUAL(cache.size(), 2U);
+    BOOST_CHECK(cache.count(prevoutImmature) == 0);
+    BOOST_CHECK(!cache.at(prevoutMature).isSuperStaker);
+    BOOST_CHECK_EQUAL(cache.at(prevoutMature).blockFromTime, blocks[5].nTime);
+    BOOST_CHECK(cache.at(prevoutSuper).isSuperStaker);
+    BOOST_CHECK_EQUAL(cache.at(prevoutSuper).amount, 2 * COIN);
+    BOOST_CHECK_EQUAL(cache.at(prevoutSuper).blockFromTime, blocks[pindexPrev->nHeight - 5].nTime);
+}
+
+// Defined in validation.cpp
+bool CheckHeaderPoS(const CBlockHeader& block, const Consensus::Params& consensusParams);
+
+BOOST_FIXTURE_TEST_CASE(pos_header_prechecks, TestChain100Setup)
+{
+    const Consensus::Params& params = Params().GetConsensus();
+    uint256 hashTip;
+    uint32_t nTime;
+    {
+        LOCK(cs_main);
+        hashTip = chainActive.Tip()->GetBlockHash();
+        nTime = (chainActive.Tip()->nTime | STAKE_TIMESTAMP_MASK) + 1;
+    }
+
+    // The stake timestamp is checked before the parent is looked up
+    CBlockHeader misaligned = SignedPoSHeader(COutPoint(InsecureRand256(), 0), coinbaseKey, nTime + 1);
+    misaligned.hashPrevBlock = InsecureRand256();
+    misaligned.vchBlockSig.clear();
+    BOOST_CHECK(coinbaseKey.Sign(misaligned.GetHashWithoutSign(), misaligned.vchBlockSig));
+    CValidationState state;
+    BOOST_CHECK(!ProcessNewBlockHeaders({misaligned}, state, Params()));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "timestamp-invalid");
+
+    // A header staking a coin that does not exist is rejected, and so is the next one reusing it
+    const COutPoint missing(InsecureRand256(), 0);
+    CBlockHeader header = SignedPoSHeader(missing, coinbaseKey, nTime);
+    header.hashPrevBlock = hashTip;
+    CBlockHeader again = SignedPoSHeader(missing, coinbaseKey, nTime + STAKE_TIMESTAMP_MASK + 1);
+    again.hashPrevBlock = hashTip;
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(!CheckHeaderPoS(header, params));
+        BOOST_CHECK(!CheckHeaderPoS(again, params));
+    }
+
+    // Still after a new tip, which starts over the stakes found missing
+    CreateAndProcessBlock({}, CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG);
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(!CheckHeaderPoS(header, params));
+    }
+}
+
+// Coinstake of a P2PK coin of key, its input signed by signer
+static CMutableTransaction SignedCoinStake(const COutPoint& prevout, const CKey& key, const CKey& signer)
+{
+    CScript scriptPubKey = GetScriptForRawPubKey(key.GetPubKey());
+    CMutableTransaction coinstake;
+    coinstake.vin.emplace_back(prevout);
+    coinstake.vout.resize(2);
+    coinstake.vout[0].SetEmpty();
+    coinstake.vout[1] = CTxOut(COIN, scriptPubKey);
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptPubKey, coinstake, 0, SIGHASH_ALL, 0, SigVersion::BASE);
+    BOOST_CHECK(signer.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    coinstake.vin[0].scriptSig << vchSig;
+    return coinstake;
+}
+
+BOOST_AUTO_TEST_CASE(assumed_valid_stake_checks)
+{
+    CKey key, otherKey;
+    key.MakeNewKey(true);
+    otherKey.MakeNewKey(true);
+
+    std::vector<CBlockIndex> blocks(COINBASE_MATURITY + 10);
+    for (size_t i = 0; i < blocks.size(); i++) {
+        blocks[i].nHeight = i;
+        blocks[i].nTime = 1000 + 16 * i;
+        blocks[i].nStakeModifier = InsecureRand256();
+        blocks[i].pprev = i ? &blocks[i - 1] : nullptr;
+        blocks[i].BuildSkip();
+    }
+    CBlockIndex* pindexPrev = &blocks.back();
+    uint32_t nTimeBlock = pindexPrev->nTime + 16;
+    unsigned int nBits = (~arith_uint256(0) / COIN).GetCompact();
+
+    CCoinsView viewDummy;
+    CCoinsViewCache view(&viewDummy);
+    COutPoint prevoutStake(InsecureRand256(), 0);
+    view.AddCoin(prevoutStake, Coin(CTxOut(COIN, GetScriptForRawPubKey(key.GetPubKey())), 5, false), false);
+
+    // The kernel input signature is only verified with fCheckSignature
+    CTransaction coinstake(SignedCoinStake(prevoutStake, key, key));
+    CTransaction forged(SignedCoinStake(prevoutStake, key, otherKey));
+    uint256 hashProofOfStake, targetProofOfStake, hashProofForged, targetProofForged;
+    CValidationState state;
+    BOOST_CHECK(CheckProofOfStake(pindexPrev, state, coinstake, nBits, nTimeBlock, hashProofOfStake, targetProofOfStake, view));
+    BOOST_CHECK(!CheckProofOfStake(pindexPrev, state, forged, nBits, nTimeBlock, hashProofForged, targetProofForged, view));
+    CValidationState stateSkipped;
+    BOOST_CHECK(CheckProofOfStake(pindexPrev, stateSkipped, forged, nBits, nTimeBlock, hashProofForged, targetProofForged, view, false));
+
+    // The kernel is still checked, and gives the same proof
+    BOOST_CHECK(hashProofForged == hashProofOfStake);
+    BOOST_CHECK(targetProofForged == targetProofOfStake);
+    unsigned int nBitsTiny = arith_uint256(1).GetCompact();
+    BOOST_CHECK(!CheckProofOfStake(pindexPrev, stateSkipped, forged, nBitsTiny, nTimeBlock, hashProofForged, targetProofForged, view, false));
+    COutPoint prevoutMissing(InsecureRand256(), 0);
+    CTransaction missing(SignedCoinStake(prevoutMissing, key, key));
+    BOOST_CHECK(!CheckProofOfStake(pindexPrev, stateSkipped, missing, nBits, nTimeBlock, hashProofForged, targetProofForged, view, false));
+
+    // The block signature is only checked with fCheckSig
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].prevout.SetNull();
+    coinbase.vin[0].scriptSig = CScript() << (int)(pindexPrev->nHeight + 1) << OP_0;
+    coinbase.vout.resize(1);
+    coinbase.vout[0].SetEmpty();
+    CBlock block;
+    block.nTime = nTimeBlock;
+    block.hashPrevBlock = InsecureRand256();
+    block.prevoutStake = prevoutStake;
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+    block.vtx.push_back(MakeTransactionRef(coinstake));
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    BOOST_CHECK(otherKey.Sign(block.GetHashWithoutSign(), block.vchBlockSig));
+    CValidationState stateBlock;
+    BOOST_CHECK(CheckBlock(block, stateBlock, Params().GetConsensus(), false, true, false));
+    BOOST_CHECK(!CheckBlock(block, stateBlock, Params().GetConsensus(), false, true, true));
+    BOOST_CHECK_EQUAL(stateBlock.GetRejectReason(), "bad-blk-signature");
+
+    // Signed by the staker, it passes both ways
+    block.vchBlockSig.clear();
+    BOOST_CHECK(key.Sign(block.GetHashWithoutSign(), block.vchBlockSig));
+    CValidationState stateSigned;
+    BOOST_CHECK(CheckBlock(block, stateSigned, Params().GetConsensus(), false, true, true));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
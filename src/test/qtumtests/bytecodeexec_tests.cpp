@@ -374,4 +374,90 @@ BOOST_AUTO_TEST_CASE(bytecodeexec_contract_create_contracts){
     BOOST_CHECK(result.second.valueTransfers.size() == 0);
 }
 
+static void CheckLastHashes(const CBlockIndex* tip){
+    LastHashes lastHashes;
+    lastHashes.set(tip);
+    dev::h256s hashes = lastHashes.precedingHashes(dev::h256());
+    BOOST_REQUIRE(hashes.size() == (size_t)LAST_HASHES_COUNT);
+    for(const dev::h256& hash : hashes){
+        BOOST_CHECK(hash == (tip ? uintToh256(tip->GetBlockHash()) : dev::h256()));
+        tip = tip ? tip->pprev : nullptr;
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(bytecodeexec_last_hashes_follow_tip, TestChain100Setup){
+    CBlockIndex* pindex;
+    {
+        LOCK(cs_main);
+        pindex = chainActive.Tip();
+        // Shared with the tip snapshot, and read from the block index for another block
+        CheckLastHashes(pindex);
+        CheckLastHashes(pindex->pprev);
+        CheckLastHashes(chainActive[100]);
+    }
+
+    CreateAndProcessBlock({}, GetScriptForRawPubKey(coinbaseKey.GetPubKey()));
+    {
+        LOCK(cs_main);
+        CheckLastHashes(chainActive.Tip());
+    }
+
+    CValidationState state;
+    BOOST_REQUIRE(InvalidateBlock(state, Params(), pindex));
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(chainActive.Tip() == pindex->pprev);
+        CheckLastHashes(chainActive.Tip());
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(bytecodeexec_local_execution_environment, TestChain100Setup){
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vout.resize(1);
+    coinbase.vout[0].scriptPubKey = GetScriptForRawPubKey(coinbaseKey.GetPubKey());
+    CBlock block;
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+    block.nTime = 1000;
+    block.nBits = 0x207fffff;
+    const std::shared_ptr<const dev::eth::EVMSchedule> schedule = std::make_shared<const dev::eth::EVMSchedule>();
+    const uint256 txid = uint256S("01");
+    CBlockIndex* pindex;
+    {
+        LOCK(cs_main);
+        pindex = chainActive.Tip();
+        std::shared_ptr<LocalContractExecution> local = std::make_shared<LocalContractExecution>();
+        local->SetEnvironment(block, pindex, 40000000, SCRIPT_EXEC_BYTE_CODE, schedule);
+        RecordLocalContractExecution(txid, local);
+        block.hashPrevBlock = pindex->GetBlockHash();
+        BOOST_CHECK(FindLocalContractExecution(txid, block, 40000000, SCRIPT_EXEC_BYTE_CODE, schedule) == local);
+        BOOST_CHECK(!FindLocalContractExecution(uint256S("02"), block, 40000000, SCRIPT_EXEC_BYTE_CODE, schedule));
+        BOOST_CHECK(!FindLocalContractExecution(txid, block, 30000000, SCRIPT_EXEC_BYTE_CODE, schedule));
+        BOOST_CHECK(!FindLocalContractExecution(txid, block, 40000000, SCRIPT_EXEC_BYTE_CODE, std::make_shared<const dev::eth::EVMSchedule>()));
+
+        // Another time or author is another environment
+        CBlock other(block);
+        other.nTime++;
+        BOOST_CHECK(!FindLocalContractExecution(txid, other, 40000000, SCRIPT_EXEC_BYTE_CODE, schedule));
+        other = block;
+        coinbase.vout[0].scriptPubKey = CScript() << OP_TRUE;
+        other.vtx[0] = MakeTransactionRef(coinbase);
+        BOOST_CHECK(!FindLocalContractExecution(txid, other, 40000000, SCRIPT_EXEC_BYTE_CODE, schedule));
+    }
+
+    // Dropped once the tip changes, even if it comes back
+    CValidationState state;
+    BOOST_REQUIRE(InvalidateBlock(state, Params(), pindex));
+    {
+        LOCK(cs_main);
+        ResetBlockFailureFlags(pindex);
+    }
+    BOOST_REQUIRE(ActivateBestChain(state, Params()));
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(chainActive.Tip() == pindex);
+        BOOST_CHECK(!FindLocalContractExecution(txid, block, 40000000, SCRIPT_EXEC_BYTE_CODE, schedule));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -187,7 +187,7 @@ void checkRes(ByteCodeExecResult& res, std::vector<dev::Address>& addresses, std
         BOOST_CHECK(globalState->balance(addresses[i]) == balances[i]);
         if(balances[i] > 0){
             BOOST_CHECK(vins.count(addresses[i]));
-            BOOST_CHECK(vins[addresses[i]].value = balances[i]);
+            BOOST_CHECK(vins[addresses[i]].value == balances[i]);
         } else {
             BOOST_CHECK(!vins.count(addresses[i]));
         }
@@ -342,4 +342,35 @@ BOOST_AUTO_TEST_CASE(condensingtransactionpaytopubkeyhash_tests){
     BOOST_CHECK(result.second.valueTransfers[0].vout[1].scriptPubKey.HasOpCall());
 }
 
+BOOST_AUTO_TEST_CASE(condensingtransactionorder_tests){
+    initState();
+    dev::Address sender("0101010101010101010101010101010101010101");
+    dev::Address addressY("0202020202020202020202020202020202020202");
+    dev::Address addressX("0303030303030303030303030303030303030303");
+    dev::h256 hashY(ParseHex("bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb"));
+    globalState->setCacheUTXO(addressY, Vin(hashY, 5, 1000, 1));
+    QtumTransaction transaction = createQtumTransaction(valtype(), 3000, dev::u256(500000), dev::u256(1), hash, addressX);
+
+    // Inputs and outputs follow the order of the addresses, not of the transfers
+    std::vector<TransferInfo> transfers = {{sender, addressX, 2000}, {sender, addressY, 1000}, {addressY, addressX, 500}};
+    CondensingTX ctx(globalState.get(), transfers, transaction);
+    CTransaction tx = ctx.createCondensingTX();
+    BOOST_REQUIRE(tx.vin.size() == 2);
+    BOOST_CHECK(tx.vin[0].prevout == COutPoint(h256Touint(hash), 0));
+    BOOST_CHECK(tx.vin[1].prevout == COutPoint(h256Touint(hashY), 5));
+    checkTx(tx, 2, 2, {1500, 2500});
+    BOOST_CHECK(tx.vout[0].scriptPubKey == CScript() << OP_DUP << OP_HASH160 << addressY.asBytes() << OP_EQUALVERIFY << OP_CHECKSIG);
+    BOOST_CHECK(tx.vout[1].scriptPubKey == CScript() << OP_DUP << OP_HASH160 << addressX.asBytes() << OP_EQUALVERIFY << OP_CHECKSIG);
+
+    std::unordered_map<dev::Address, Vin> vins = ctx.createVin(tx);
+    BOOST_CHECK(vins.size() == 2 && !vins.count(sender));
+    BOOST_CHECK(vins[addressY].nVout == 0 && vins[addressY].value == 1500);
+    BOOST_CHECK(vins[addressX].nVout == 1 && vins[addressX].value == 2500);
+
+    // Spending more than an address has fails
+    transfers.push_back({addressX, addressY, 3000});
+    CondensingTX overspent(globalState.get(), transfers, transaction);
+    BOOST_CHECK(overspent.createCondensingTX().vin.empty());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -105,6 +105,7 @@ void genesisLoading(){
     const CChainParams& chainparams = Params();
     dev::eth::ChainParams cp((chainparams.EVMGenesisInfo(dev::eth::Network::qtumMainNetwork, 999)));
     globalState->populateFrom(cp.genesisState);
+    QtumDGP::clearCache();
     globalSealEngine = std::unique_ptr<dev::eth::SealEngineFace>(cp.createSealEngine());
     globalState->db().commit();
 }
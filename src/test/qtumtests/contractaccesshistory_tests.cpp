@@ -0,0 +1,85 @@
+#include <boost/test/unit_test.hpp>
+#include <libdevcore/SHA3.h>
+#include <qtum/qtumaccesshistory.h>
+#include <test/test_bitcoin.h>
+
+namespace {
+
+dev::h256 Slot(uint64_t n)
+{
+    return dev::sha3(dev::h256(n));
+}
+
+dev::Address Contract(unsigned n)
+{
+    return dev::Address(n);
+}
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(contractaccesshistory_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(access_history_record)
+{
+    ContractAccessHistory history;
+    dev::Address called(1), callee(2), other(3);
+    ContractAccessHistory::Entry entry;
+    BOOST_CHECK(!history.Get(called, entry));
+
+    // The slots of every account are kept, the accounts other than the called one are its callees
+    history.Record(called, {{called, {Slot(1), Slot(2)}}, {callee, {Slot(3)}}, {other, {}}});
+    BOOST_CHECK(history.Get(called, entry));
+    BOOST_CHECK(entry.slots == std::vector<dev::h256>({Slot(1), Slot(2)}));
+    BOOST_CHECK(entry.callees == std::vector<dev::Address>({callee}));
+    BOOST_CHECK(history.Get(callee, entry));
+    BOOST_CHECK(entry.slots == std::vector<dev::h256>({Slot(3)}));
+    BOOST_CHECK(entry.callees.empty());
+    BOOST_CHECK(!history.Get(other, entry));
+
+    // The slots used again move to the front, once
+    history.Record(called, {{called, {Slot(2), Slot(4)}}});
+    BOOST_CHECK(history.Get(called, entry));
+    BOOST_CHECK(entry.slots == std::vector<dev::h256>({Slot(2), Slot(4), Slot(1)}));
+    BOOST_CHECK(entry.callees == std::vector<dev::Address>({callee}));
+    history.Record(called, {{called, {}}, {other, {Slot(5)}}});
+    BOOST_CHECK(history.Get(called, entry));
+    BOOST_CHECK(entry.callees == std::vector<dev::Address>({other, callee}));
+}
+
+BOOST_AUTO_TEST_CASE(access_history_bounds)
+{
+    ContractAccessHistory history;
+    dev::Address called(1);
+
+    // The most recently used slots and callees are kept
+    std::vector<dev::h256> slots;
+    for (uint64_t i = 0; i < 2 * MAX_ACCESS_HISTORY_SLOTS; i++)
+        slots.push_back(Slot(i));
+    ContractAccesses accesses{{called, slots}};
+    for (uint64_t i = 0; i < 2 * MAX_ACCESS_HISTORY_CALLEES; i++)
+        accesses.emplace_back(Contract(100 + i), std::vector<dev::h256>{Slot(i)});
+    history.Record(called, accesses);
+    ContractAccessHistory::Entry entry;
+    BOOST_CHECK(history.Get(called, entry));
+    BOOST_CHECK(entry.slots == std::vector<dev::h256>(slots.begin(), slots.begin() + MAX_ACCESS_HISTORY_SLOTS));
+    BOOST_CHECK_EQUAL(entry.callees.size(), MAX_ACCESS_HISTORY_CALLEES);
+    BOOST_CHECK(entry.callees.front() == Contract(100));
+    history.Record(called, {{called, {slots.back()}}});
+    BOOST_CHECK(history.Get(called, entry));
+    BOOST_CHECK_EQUAL(entry.slots.size(), MAX_ACCESS_HISTORY_SLOTS);
+    BOOST_CHECK(entry.slots.front() == slots.back());
+
+    // The least recently used contracts are forgotten, the ones recorded again are kept
+    for (uint64_t i = 0; i < MAX_ACCESS_HISTORY_CONTRACTS; i++) {
+        dev::Address address(Contract(1000 + i));
+        history.Record(address, {{address, {Slot(i)}}});
+        if (i == MAX_ACCESS_HISTORY_CONTRACTS / 2)
+            history.Record(called, {{called, {Slot(0)}}});
+    }
+    BOOST_CHECK(history.Get(called, entry));
+    BOOST_CHECK(!history.Get(Contract(100), entry));
+    BOOST_CHECK(!history.Get(Contract(1000), entry));
+    BOOST_CHECK(history.Get(Contract(1000 + MAX_ACCESS_HISTORY_CONTRACTS - 1), entry));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
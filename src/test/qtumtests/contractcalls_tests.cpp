@@ -0,0 +1,326 @@
+#include <boost/test/unit_test.hpp>
+#include <core_memusage.h>
+#include <index/logindex.h>
+#include <interfaces/node.h>
+#include <keystore.h>
+#include <miner.h>
+#include <pow.h>
+#include <qtum/qtumaccesshistory.h>
+#include <script/sign.h>
+#include <test/qtumtests/test_utils.h>
+#include <util/time.h>
+
+namespace {
+
+// Adds its argument to a storage slot and returns the sum when called with 5b9af12b
+const std::string ADDER_CODE = "6060604052600d600055341561001457600080fd5b61017e806100236000396000f30060606040526004361061004c576000357c0100000000000000000000000000000000000000000000000000000000900463ffffffff168063027c1aaf1461004e5780635b9af12b14610058575b005b61005661008f565b005b341561006357600080fd5b61007960048080359060200190919050506100a1565b6040518082815260200191505060405180910390f35b60026000808282540292505081905550565b60007fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a17fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a1816000540160008190555060005490509190505600a165627a7a7230582015732bfa66bdede47ecc05446bf4c1e8ed047efac25478cb13b795887df70f290029";
+const std::string ADD = "5b9af12b";
+const std::string ADD_TOPIC = "c5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f2";
+const uint64_t GAS_LIMIT = 500000;
+const uint64_t GAS_PRICE = 40;
+
+std::string Uint(uint64_t n)
+{
+    return dev::toHex(dev::h256(dev::u256(n)).asBytes());
+}
+
+int TipHeight()
+{
+    LOCK(cs_main);
+    return chainActive.Height();
+}
+
+/** -logevents with the log index, for the lifetime of the object */
+struct LogEventsScope
+{
+    LogEventsScope()
+    {
+        fLogEvents = true;
+        g_logindex = MakeUnique<LogIndex>(1 << 20, true);
+        g_logindex->Start();
+    }
+    ~LogEventsScope()
+    {
+        g_logindex->Stop();
+        g_logindex.reset();
+        fLogEvents = false;
+    }
+    void Sync()
+    {
+        constexpr int64_t timeout_ms = 10 * 1000;
+        int64_t time_start = GetTimeMillis();
+        while (!g_logindex->BlockUntilSyncedToCurrentChain()) {
+            BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+            MilliSleep(100);
+        }
+    }
+};
+
+struct ContractCallsSetup : public TestChain100Setup
+{
+    CScript scriptPubKey;
+    CBasicKeyStore keystore;
+
+    ContractCallsSetup()
+    {
+        scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+        keystore.AddKey(coinbaseKey);
+    }
+
+    /** Send an output, with the change of a coinbase, through the mempool */
+    CMutableTransaction SendTx(const CTransactionRef& coinbase, const CScript& outputScript)
+    {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(coinbase->GetHash(), 0);
+        tx.vout.emplace_back(0, outputScript);
+        tx.vout.emplace_back(coinbase->vout[0].nValue - COIN, scriptPubKey);
+        SignatureData sigdata;
+        BOOST_CHECK(ProduceSignature(keystore, MutableTransactionSignatureCreator(&tx, 0, coinbase->vout[0].nValue, SIGHASH_ALL), scriptPubKey, sigdata));
+        UpdateInput(tx.vin[0], sigdata);
+
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_CHECK(AcceptToMemoryPool(mempool, state, MakeTransactionRef(tx), nullptr /* pfMissingInputs */,
+                                       nullptr /* plTxnReplaced */, true /* bypass_limits */, 0 /* nAbsurdFee */));
+        return tx;
+    }
+
+    /** Mine the mempool, with the contract state roots of the template */
+    void MineMempool()
+    {
+        std::unique_ptr<CBlockTemplate> pblocktemplate = BlockAssembler(Params()).CreateNewBlock(scriptPubKey);
+        CBlock& block = pblocktemplate->block;
+        {
+            LOCK(cs_main);
+            unsigned int extraNonce = 0;
+            IncrementExtraNonce(&block, chainActive.Tip(), extraNonce);
+        }
+        while (!CheckProofOfWork(block.GetHash(), block.nBits, Params().GetConsensus())) ++block.nNonce;
+        BOOST_CHECK(ProcessNewBlock(Params(), std::make_shared<const CBlock>(block), true, nullptr));
+        LOCK(cs_main);
+        BOOST_CHECK(chainActive.Tip()->GetBlockHash() == block.GetHash());
+        BOOST_CHECK_EQUAL(mempool.size(), 0U);
+    }
+};
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(contractcalls_tests, ContractCallsSetup)
+
+BOOST_AUTO_TEST_CASE(node_call_contracts)
+{
+    CScript createScript = CScript() << CScriptNum(VersionVM::GetEVMDefault().toRaw()) << CScriptNum(GAS_LIMIT) << CScriptNum(GAS_PRICE) << ParseHex(ADDER_CODE) << OP_CREATE;
+    CMutableTransaction createTx = SendTx(m_coinbase_txns[0], createScript);
+    MineMempool();
+    dev::Address contract = createQtumAddress(uintToh256(createTx.GetHash()), 0);
+
+    std::unique_ptr<interfaces::Node> node = interfaces::MakeNode();
+    std::vector<interfaces::ContractCall> calls(3);
+    calls[0].address = contract.hex();
+    calls[0].data = ADD + Uint(0);
+    calls[1].address = "not a contract";
+    calls[1].data = ADD + Uint(0);
+    calls[2].address = dev::Address(1).hex();
+    calls[2].data = ADD + Uint(0);
+
+    // All the calls on the state of the tip, the invalid and unknown contracts are not called
+    int block_number = -1;
+    std::vector<interfaces::ContractCallResult> results = node->callContracts(calls, block_number);
+    BOOST_CHECK_EQUAL(block_number, TipHeight());
+    BOOST_REQUIRE_EQUAL(results.size(), calls.size());
+    BOOST_CHECK(results[0].executed);
+    BOOST_CHECK(!results[0].excepted);
+    BOOST_CHECK(!results[0].unchanged);
+    BOOST_CHECK_EQUAL(results[0].output, Uint(13));
+    BOOST_CHECK(!results[0].storage_root.IsNull());
+    for (size_t i = 1; i < results.size(); i++) {
+        BOOST_CHECK(!results[i].executed);
+        BOOST_CHECK(!results[i].unchanged);
+        BOOST_CHECK(results[i].output.empty());
+    }
+
+    // A contract whose storage still has the root of the last call is skipped
+    uint256 storage_root = results[0].storage_root;
+    calls.resize(1);
+    calls[0].storage_root = storage_root;
+    CreateAndProcessBlock({}, scriptPubKey);
+    results = node->callContracts(calls, block_number);
+    BOOST_REQUIRE_EQUAL(results.size(), 1U);
+    BOOST_CHECK(results[0].unchanged);
+    BOOST_CHECK(!results[0].executed);
+    BOOST_CHECK(results[0].storage_root == storage_root);
+
+    // Once the storage changed the contract is called again
+    CScript callScript = CScript() << CScriptNum(VersionVM::GetEVMDefault().toRaw()) << CScriptNum(GAS_LIMIT) << CScriptNum(GAS_PRICE) << ParseHex(ADD + Uint(5)) << contract.asBytes() << OP_CALL;
+    SendTx(m_coinbase_txns[1], callScript);
+    MineMempool();
+    results = node->callContracts(calls, block_number);
+    BOOST_CHECK_EQUAL(block_number, TipHeight());
+    BOOST_REQUIRE_EQUAL(results.size(), 1U);
+    BOOST_CHECK(!results[0].unchanged);
+    BOOST_CHECK(results[0].executed);
+    BOOST_CHECK_EQUAL(results[0].output, Uint(18));
+    BOOST_CHECK(results[0].storage_root != storage_root);
+}
+
+BOOST_AUTO_TEST_CASE(mempool_contract_extraction)
+{
+    CScript createScript = CScript() << CScriptNum(VersionVM::GetEVMDefault().toRaw()) << CScriptNum(GAS_LIMIT) << CScriptNum(GAS_PRICE) << ParseHex(ADDER_CODE) << OP_CREATE;
+    CMutableTransaction createTx = SendTx(m_coinbase_txns[0], createScript);
+    CMutableTransaction plainTx = SendTx(m_coinbase_txns[1], scriptPubKey);
+
+    // The contract outputs are parsed once on acceptance and kept with the flags they were parsed with
+    {
+        LOCK2(cs_main, mempool.cs);
+        auto it = mempool.mapTx.find(createTx.GetHash());
+        BOOST_REQUIRE(it != mempool.mapTx.end());
+        const std::shared_ptr<const ContractExtraction>& extraction = it->GetContractExtraction();
+        BOOST_REQUIRE(extraction);
+        BOOST_CHECK_EQUAL(extraction->nFlags, GetContractScriptFlags(chainActive.Height() + 1, Params().GetConsensus()));
+        BOOST_REQUIRE_EQUAL(extraction->extracted.first.size(), 1U);
+        BOOST_REQUIRE_EQUAL(extraction->extracted.second.size(), 1U);
+        BOOST_CHECK(extraction->extracted.first[0].gas() == GAS_LIMIT);
+        BOOST_CHECK(extraction->extracted.first[0].gasPrice() == GAS_PRICE);
+        BOOST_CHECK(extraction->extracted.first[0].isCreation());
+        BOOST_CHECK(extraction->extracted.second[0].code == ParseHex(ADDER_CODE));
+
+        // and counted in the memory used by the entry
+        auto plain = mempool.mapTx.find(plainTx.GetHash());
+        BOOST_REQUIRE(plain != mempool.mapTx.end());
+        BOOST_CHECK(!plain->GetContractExtraction());
+        BOOST_CHECK(it->DynamicMemoryUsage() > RecursiveDynamicUsage(it->GetTx()) + ADDER_CODE.size() / 2);
+    }
+
+    // A block of the mempool txs executes the kept contract txs
+    MineMempool();
+    dev::Address contract = createQtumAddress(uintToh256(createTx.GetHash()), 0);
+    std::vector<interfaces::ContractCall> calls(1);
+    calls[0].address = contract.hex();
+    calls[0].data = ADD + Uint(0);
+    int block_number;
+    std::vector<interfaces::ContractCallResult> results = interfaces::MakeNode()->callContracts(calls, block_number);
+    BOOST_REQUIRE_EQUAL(results.size(), 1U);
+    BOOST_CHECK(results[0].executed);
+    BOOST_CHECK_EQUAL(results[0].output, Uint(13));
+}
+
+BOOST_AUTO_TEST_CASE(node_search_logs)
+{
+    std::unique_ptr<interfaces::Node> node = interfaces::MakeNode();
+    std::vector<interfaces::ContractReceipt> receipts;
+    int next_block = 0;
+    BOOST_CHECK(!node->searchLogs(0, 0, {}, {}, 10, receipts, next_block));
+
+    LogEventsScope logEvents;
+    CScript createScript = CScript() << CScriptNum(VersionVM::GetEVMDefault().toRaw()) << CScriptNum(GAS_LIMIT) << CScriptNum(GAS_PRICE) << ParseHex(ADDER_CODE) << OP_CREATE;
+    CMutableTransaction createTx = SendTx(m_coinbase_txns[0], createScript);
+    MineMempool();
+    dev::Address contract = createQtumAddress(uintToh256(createTx.GetHash()), 0);
+
+    // One call with two logs in each of three blocks
+    std::vector<uint256> callTxs;
+    std::vector<int> heights;
+    for (int i = 0; i < 3; i++) {
+        CScript callScript = CScript() << CScriptNum(VersionVM::GetEVMDefault().toRaw()) << CScriptNum(GAS_LIMIT) << CScriptNum(GAS_PRICE) << ParseHex(ADD + Uint(i + 1)) << contract.asBytes() << OP_CALL;
+        callTxs.push_back(SendTx(m_coinbase_txns[i + 1], callScript).GetHash());
+        MineMempool();
+        heights.push_back(TipHeight());
+    }
+    logEvents.Sync();
+
+    // All of them up to the tip
+    BOOST_CHECK(node->searchLogs(0, 0, {contract.hex()}, {}, std::numeric_limits<size_t>::max(), receipts, next_block));
+    BOOST_CHECK_EQUAL(next_block, -1);
+    BOOST_REQUIRE_EQUAL(receipts.size(), 3U);
+    for (size_t i = 0; i < receipts.size(); i++) {
+        const interfaces::ContractReceipt& receipt = receipts[i];
+        BOOST_CHECK(receipt.transaction_hash == callTxs[i]);
+        BOOST_CHECK_EQUAL(receipt.block_number, heights[i]);
+        BOOST_CHECK_EQUAL(receipt.transaction_index, 1U);
+        BOOST_CHECK_EQUAL(receipt.to, contract.hex());
+        BOOST_CHECK(receipt.gas_used > 0);
+        BOOST_REQUIRE_EQUAL(receipt.logs.size(), 2U);
+        BOOST_CHECK_EQUAL(receipt.logs[0].address, contract.hex());
+        BOOST_REQUIRE_EQUAL(receipt.logs[0].topics.size(), 1U);
+        BOOST_CHECK_EQUAL(receipt.logs[0].topics[0], ADD_TOPIC);
+        BOOST_CHECK(!receipt.logs[0].data.empty());
+    }
+
+    // Filtered by topic or by nothing
+    receipts.clear();
+    BOOST_CHECK(node->searchLogs(heights[0], heights[2], {contract.hex()}, {ADD_TOPIC}, 10, receipts, next_block));
+    BOOST_CHECK_EQUAL(receipts.size(), 3U);
+    receipts.clear();
+    BOOST_CHECK(node->searchLogs(heights[0], heights[2], {}, {}, 10, receipts, next_block));
+    BOOST_CHECK_EQUAL(receipts.size(), 3U);
+    receipts.clear();
+    BOOST_CHECK(node->searchLogs(heights[0], heights[2], {contract.hex()}, {dev::h256(1).hex()}, 10, receipts, next_block));
+    BOOST_CHECK(receipts.empty());
+    BOOST_CHECK(node->searchLogs(heights[0], heights[2], {dev::Address(1).hex()}, {}, 10, receipts, next_block));
+    BOOST_CHECK(receipts.empty());
+
+    // Paged one block at a time
+    int from_block = heights[0];
+    for (size_t i = 0; i < heights.size(); i++) {
+        BOOST_CHECK(node->searchLogs(from_block, 0, {contract.hex()}, {}, 1, receipts, next_block));
+        BOOST_REQUIRE_EQUAL(receipts.size(), i + 1);
+        BOOST_CHECK(receipts.back().transaction_hash == callTxs[i]);
+        BOOST_CHECK_EQUAL(next_block, i + 1 < heights.size() ? heights[i + 1] : -1);
+        from_block = next_block;
+    }
+
+    // Malformed addresses and topics
+    receipts.clear();
+    BOOST_CHECK(!node->searchLogs(0, 0, {"not an address"}, {}, 10, receipts, next_block));
+    BOOST_CHECK(!node->searchLogs(0, 0, {}, {ADD_TOPIC.substr(2)}, 10, receipts, next_block));
+    BOOST_CHECK(receipts.empty());
+}
+
+BOOST_AUTO_TEST_CASE(contract_access_history)
+{
+    std::shared_ptr<ContractAccessHistory> history = std::make_shared<ContractAccessHistory>();
+    SetContractAccessHistory(history);
+    CScript createScript = CScript() << CScriptNum(VersionVM::GetEVMDefault().toRaw()) << CScriptNum(GAS_LIMIT) << CScriptNum(GAS_PRICE) << ParseHex(ADDER_CODE) << OP_CREATE;
+    CMutableTransaction createTx = SendTx(m_coinbase_txns[0], createScript);
+    MineMempool();
+    dev::Address contract = createQtumAddress(uintToh256(createTx.GetHash()), 0);
+    const std::vector<dev::h256> slots{dev::sha3(dev::h256())};
+
+    // Creations are not recorded, calls are, reverted ones included
+    ContractAccessHistory::Entry entry;
+    BOOST_CHECK(!history->Get(contract, entry));
+    std::unique_ptr<interfaces::Node> node = interfaces::MakeNode();
+    std::vector<interfaces::ContractCall> calls(1);
+    calls[0].address = contract.hex();
+    calls[0].data = ADD + Uint(5);
+    int block_number = -1;
+    std::vector<interfaces::ContractCallResult> results = node->callContracts(calls, block_number);
+    BOOST_REQUIRE_EQUAL(results.size(), 1U);
+    BOOST_CHECK(results[0].executed);
+    BOOST_CHECK(history->Get(contract, entry));
+    BOOST_CHECK(entry.slots == slots);
+    BOOST_CHECK(entry.callees.empty());
+
+    // And so are the calls of the mempool and the blocks
+    history = std::make_shared<ContractAccessHistory>();
+    SetContractAccessHistory(history);
+    CScript callScript = CScript() << CScriptNum(VersionVM::GetEVMDefault().toRaw()) << CScriptNum(GAS_LIMIT) << CScriptNum(GAS_PRICE) << ParseHex(ADD + Uint(5)) << contract.asBytes() << OP_CALL;
+    SendTx(m_coinbase_txns[1], callScript);
+    BOOST_CHECK(history->Get(contract, entry));
+    BOOST_CHECK(entry.slots == slots);
+    history = std::make_shared<ContractAccessHistory>();
+    SetContractAccessHistory(history);
+    MineMempool();
+    BOOST_CHECK(history->Get(contract, entry));
+    BOOST_CHECK(entry.slots == slots);
+
+    // Without a history nothing is recorded
+    SetContractAccessHistory(nullptr);
+    history = std::make_shared<ContractAccessHistory>();
+    results = node->callContracts(calls, block_number);
+    BOOST_CHECK(results[0].executed);
+    BOOST_CHECK(!history->Get(contract, entry));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,85 @@
+#include <boost/test/unit_test.hpp>
+#include <libdevcore/SHA3.h>
+#include <qtum/qtumstatecache.h>
+#include <test/test_bitcoin.h>
+
+#include <limits>
+
+namespace {
+
+std::shared_ptr<const ContractStorage> MakeStorage(size_t nSlots, uint64_t seed)
+{
+    std::shared_ptr<ContractStorage> storage = std::make_shared<ContractStorage>();
+    for (size_t i = 0; i < nSlots; i++)
+        (*storage)[dev::sha3(dev::h256(dev::u256(seed * nSlots + i)))] = std::make_pair(dev::u256(i), dev::u256(seed));
+    return storage;
+}
+
+/** Memory an entry of nSlots slots uses in a cache */
+size_t EntryUsage(size_t nSlots)
+{
+    ContractStorageCache cache(std::numeric_limits<size_t>::max());
+    size_t nEmpty = cache.DynamicMemoryUsage();
+    cache.put(dev::h160(1), dev::h256(1), MakeStorage(nSlots, 0));
+    return cache.DynamicMemoryUsage() - nEmpty;
+}
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(contractstoragecache_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(contract_storage_cache_key)
+{
+    ContractStorageCache cache(MAX_CONTRACT_STORAGE_CACHE_BYTES);
+    dev::h160 address(1);
+    std::shared_ptr<const ContractStorage> storage = MakeStorage(10, 1);
+    cache.put(address, dev::h256(1), storage);
+
+    // Valid for any state with the same storage root of the account, and only for it
+    BOOST_CHECK(cache.get(address, dev::h256(1)) == storage);
+    BOOST_CHECK(!cache.get(address, dev::h256(2)));
+    BOOST_CHECK(!cache.get(dev::h160(2), dev::h256(1)));
+
+    // An entry is never replaced, the storage of a root does not change
+    cache.put(address, dev::h256(1), MakeStorage(10, 2));
+    BOOST_CHECK(cache.get(address, dev::h256(1)) == storage);
+}
+
+BOOST_AUTO_TEST_CASE(contract_storage_cache_bound)
+{
+    const size_t nSlots = 1000;
+    const size_t nEntryUsage = EntryUsage(nSlots);
+    std::shared_ptr<const ContractStorage> a = MakeStorage(nSlots, 1);
+    std::shared_ptr<const ContractStorage> b = MakeStorage(nSlots, 2);
+    std::shared_ptr<const ContractStorage> c = MakeStorage(nSlots, 3);
+
+    // Room for one entry: the older one is evicted
+    {
+        ContractStorageCache cache(nEntryUsage * 3 / 2);
+        cache.put(dev::h160(1), dev::h256(1), a);
+        cache.put(dev::h160(2), dev::h256(2), b);
+        BOOST_CHECK(!cache.get(dev::h160(1), dev::h256(1)));
+        BOOST_CHECK(cache.get(dev::h160(2), dev::h256(2)) == b);
+    }
+
+    // Room for two entries: the least recently used one is evicted
+    {
+        ContractStorageCache cache(nEntryUsage * 5 / 2);
+        cache.put(dev::h160(1), dev::h256(1), a);
+        cache.put(dev::h160(2), dev::h256(2), b);
+        BOOST_CHECK(cache.get(dev::h160(1), dev::h256(1)) == a);
+        cache.put(dev::h160(3), dev::h256(3), c);
+        BOOST_CHECK(cache.get(dev::h160(1), dev::h256(1)) == a);
+        BOOST_CHECK(!cache.get(dev::h160(2), dev::h256(2)));
+        BOOST_CHECK(cache.get(dev::h160(3), dev::h256(3)) == c);
+    }
+
+    // An entry larger than the cache is not kept
+    {
+        ContractStorageCache cache(nEntryUsage / 2);
+        cache.put(dev::h160(1), dev::h256(1), a);
+        BOOST_CHECK(!cache.get(dev::h160(1), dev::h256(1)));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -287,6 +287,7 @@ void contractLoading(){
     const CChainParams& chainparams = Params();
     dev::eth::ChainParams cp((chainparams.EVMGenesisInfo(dev::eth::Network::qtumMainNetwork, 1400)));
     globalState->populateFrom(cp.genesisState);
+    QtumDGP::clearCache();
     globalSealEngine = std::unique_ptr<dev::eth::SealEngineFace>(cp.createSealEngine());
     globalState->db().commit();
 }
@@ -444,6 +445,21 @@ BOOST_AUTO_TEST_CASE(gas_schedule_passage_from_130_to_0_three_paramsInstance_tes
     }
 }
 
+BOOST_AUTO_TEST_CASE(gas_schedule_shared_test){
+    initState();
+    contractLoading();
+    createTestContractsAndBlocks(this, code[1], code[3], code[5], GasScheduleDGP);
+    QtumDGP qtumDGP(globalState.get());
+    // The heights of a span share the schedule built for it
+    std::shared_ptr<const dev::eth::EVMSchedule> schedule = qtumDGP.getSharedGasSchedule(0);
+    BOOST_CHECK(schedule == qtumDGP.getSharedGasSchedule(1));
+    for(size_t i = 0; i < 1300; i++){
+        std::shared_ptr<const dev::eth::EVMSchedule> next = qtumDGP.getSharedGasSchedule(i);
+        BOOST_CHECK(next == qtumDGP.getSharedGasSchedule(i));
+        BOOST_CHECK(compareEVMSchedule(*next, qtumDGP.getGasSchedule(i)));
+    }
+}
+
 BOOST_AUTO_TEST_CASE(block_size_default_state_test1){
     initState();
     contractLoading();
@@ -492,6 +508,35 @@ BOOST_AUTO_TEST_CASE(block_size_one_paramsInstance_introductory_block_1_test2){
     BOOST_CHECK(blockSize == 1000000);
 }
 
+BOOST_AUTO_TEST_CASE(block_size_template_storage_change_test){
+    initState();
+    contractLoading();
+
+    dev::h256 hashTemp(hash);
+    std::vector<QtumTransaction> txs;
+    txs.push_back(createQtumTransaction(code[0], 0, dev::u256(500000), dev::u256(1), hashTemp, BlockSizeDGP, 0));
+    txs.push_back(createQtumTransaction(code[7], 0, dev::u256(500000), dev::u256(1), ++hashTemp, dev::Address(), 0));
+    dev::Address templateAddress = createQtumAddress(hashTemp, 0);
+    txs.push_back(createQtumTransaction(code[2], 0, dev::u256(500000), dev::u256(1), ++hashTemp, BlockSizeDGP, 0));
+    auto result = executeBC(txs);
+
+    QtumDGP qtumDGP(globalState.get());
+    BOOST_CHECK(qtumDGP.getBlockSize(502) == 1000000);
+
+    // The template changes while the governance storage does not
+    dev::h256 dgpStorageRoot = globalState->storageRoot(BlockSizeDGP);
+    dev::h256 oldRoot = globalState->rootHash();
+    globalState->setStorage(templateAddress, dev::u256(0), dev::u256(2000000));
+    globalState->commit(dev::eth::State::CommitBehaviour::KeepEmptyAccounts);
+    globalState->db().commit();
+    BOOST_CHECK(globalState->storageRoot(BlockSizeDGP) == dgpStorageRoot);
+    BOOST_CHECK(qtumDGP.getBlockSize(502) == 2000000);
+
+    // And back
+    globalState->setRoot(oldRoot);
+    BOOST_CHECK(qtumDGP.getBlockSize(502) == 1000000);
+}
+
 BOOST_AUTO_TEST_CASE(block_size_passage_from_0_to_130_three_paramsInstance_test){
     initState();
     contractLoading();
@@ -167,4 +167,30 @@ BOOST_AUTO_TEST_CASE(parse_incorrect_txcall_overflow){
     runFailingTest(false, 120, script1, script2);
 }
 
+BOOST_AUTO_TEST_CASE(block_tx_index){
+    CTransactionRef tx1 = MakeTransactionRef(createTX({CTxOut(value, CScript() << OP_1)}));
+    CTransactionRef tx2 = MakeTransactionRef(createTX({CTxOut(value, CScript() << OP_2)}, tx1->GetHash()));
+    CBlockTxIndex blockTxIndex(std::vector<CTransactionRef>{tx1});
+    BOOST_CHECK(blockTxIndex.Find(tx1->GetHash()) == tx1.get());
+    BOOST_CHECK(blockTxIndex.Find(tx2->GetHash()) == nullptr);
+    blockTxIndex.Add(tx2);
+    BOOST_CHECK(blockTxIndex.Find(tx2->GetHash()) == tx2.get());
+    blockTxIndex.Clear();
+    BOOST_CHECK(blockTxIndex.Find(tx1->GetHash()) == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(parse_txcall_block_sender){
+    // The parent is only in the block, the sender must be resolved through the block index
+    mempool.clear();
+    CTransactionRef tx1 = MakeTransactionRef(createTX({CTxOut(value, CScript() << OP_DUP << OP_HASH160 << address << OP_EQUALVERIFY << OP_CHECKSIG)}));
+    CScript script = CScript() << CScriptNum(VersionVM::GetEVMDefault().toRaw()) << CScriptNum(int64_t(gasLimit)) << CScriptNum(int64_t(gasPrice)) << data << address << OP_CALL;
+    CMutableTransaction tx2 = createTX({CTxOut(value, script)}, tx1->GetHash());
+    CBlockTxIndex blockTxIndex(std::vector<CTransactionRef>{tx1});
+    QtumTxConverter converter(CTransaction(tx2), NULL, &blockTxIndex);
+    ExtractQtumTX qtumTx;
+    BOOST_CHECK(converter.extractionQtumTransactions(qtumTx));
+    BOOST_CHECK(qtumTx.first.size() == 1);
+    checkResult(false, qtumTx.first, tx2.GetHash());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,49 @@
+#include <boost/test/unit_test.hpp>
+#include <key.h>
+#include <qtum/qtumutils.h>
+#include <test/test_bitcoin.h>
+#include <util/convert.h>
+
+BOOST_FIXTURE_TEST_SUITE(qtumutils_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(btc_ecrecover_cached)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    uint256 hash = GetRandHash();
+    std::vector<unsigned char> vchSig;
+    BOOST_REQUIRE(key.SignCompact(hash, vchSig));
+    BOOST_REQUIRE_EQUAL(vchSig.size(), 65U);
+
+    qtumutils::EcrecoverInput input;
+    input.hash = uintToh256(hash);
+    input.v = vchSig[0];
+    input.r = dev::h256(std::vector<unsigned char>(vchSig.begin() + 1, vchSig.begin() + 33));
+    input.s = dev::h256(std::vector<unsigned char>(vchSig.begin() + 33, vchSig.end()));
+
+    CKeyID id = key.GetPubKey().GetID();
+    dev::h256 expected;
+    memcpy(expected.data() + expected.size - sizeof(id), id.begin(), sizeof(id));
+
+    // The second call is served from the cache
+    for (int i = 0; i < 2; i++) {
+        dev::h256 recovered;
+        BOOST_CHECK(qtumutils::btc_ecrecover(input.hash, input.v, input.r, input.s, recovered));
+        BOOST_CHECK(recovered == expected);
+    }
+
+    // Failures are the same with and without the cache
+    qtumutils::EcrecoverInput invalid = input;
+    invalid.v = 0;
+    std::vector<qtumutils::EcrecoverResult> results;
+    for (size_t nCache : {(size_t)0, qtumutils::DEFAULT_ECRECOVER_CACHE_SIZE}) {
+        qtumutils::SetEcrecoverCacheSize(nCache);
+        qtumutils::btc_ecrecover_batch({input, invalid, input}, results);
+        BOOST_REQUIRE_EQUAL(results.size(), 3U);
+        BOOST_CHECK(results[0].fRecovered && results[0].key == expected);
+        BOOST_CHECK(!results[1].fRecovered);
+        BOOST_CHECK(results[2].fRecovered && results[2].key == expected);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
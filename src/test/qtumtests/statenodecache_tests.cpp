@@ -0,0 +1,232 @@
+#include <boost/test/unit_test.hpp>
+#include <libdevcore/DBFactory.h>
+#include <libdevcore/SHA3.h>
+#include <qtum/qtumstatecache.h>
+#include <test/test_bitcoin.h>
+
+namespace {
+
+/** Trie nodes are RLP lists, so they start with a byte of at least 0xc0 */
+std::string TrieNode(uint64_t n)
+{
+    return std::string(1, (char)0xe1) + dev::h256(n).hex();
+}
+
+std::string NodeKey(const std::string& value)
+{
+    dev::h256 hash = dev::sha3(value);
+    return std::string((const char*)hash.data(), hash.size);
+}
+
+dev::db::Slice ToSlice(const std::string& s)
+{
+    return dev::db::Slice(s.data(), s.size());
+}
+
+/** Database which counts the values written to each key */
+class CountingDB : public dev::db::DatabaseFace
+{
+public:
+    explicit CountingDB(std::unique_ptr<dev::db::DatabaseFace> _db) : db(std::move(_db)) {}
+
+    std::string lookup(dev::db::Slice _key) const override { return db->lookup(_key); }
+    bool exists(dev::db::Slice _key) const override { return db->exists(_key); }
+    void insert(dev::db::Slice _key, dev::db::Slice _value) override
+    {
+        writes[_key.toString()]++;
+        db->insert(_key, _value);
+    }
+    void kill(dev::db::Slice _key) override { db->kill(_key); }
+
+    std::unique_ptr<dev::db::WriteBatchFace> createWriteBatch() const override
+    {
+        return std::unique_ptr<dev::db::WriteBatchFace>(new Batch(db->createWriteBatch()));
+    }
+    void commit(std::unique_ptr<dev::db::WriteBatchFace> _batch) override
+    {
+        Batch* batch = dynamic_cast<Batch*>(_batch.get());
+        for (const std::string& key : batch->inserted)
+            writes[key]++;
+        db->commit(std::move(batch->batch));
+    }
+
+    void forEach(std::function<bool(dev::db::Slice, dev::db::Slice)> f) const override { db->forEach(f); }
+
+    std::map<std::string, int> writes;
+
+private:
+    class Batch : public dev::db::WriteBatchFace
+    {
+    public:
+        explicit Batch(std::unique_ptr<dev::db::WriteBatchFace> _batch) : batch(std::move(_batch)) {}
+
+        void insert(dev::db::Slice _key, dev::db::Slice _value) override
+        {
+            batch->insert(_key, _value);
+            inserted.push_back(_key.toString());
+        }
+        void kill(dev::db::Slice _key) override { batch->kill(_key); }
+
+        std::unique_ptr<dev::db::WriteBatchFace> batch;
+        std::vector<std::string> inserted;
+    };
+
+    std::unique_ptr<dev::db::DatabaseFace> db;
+};
+
+struct CachedDB
+{
+    CountingDB* disk;
+    std::unique_ptr<StateNodeCacheDB> cache;
+
+    CachedDB(size_t nNodeBytes, size_t nCodeBytes)
+    {
+        std::unique_ptr<CountingDB> db(new CountingDB(dev::db::DBFactory::create(dev::db::DatabaseKind::MemoryDB)));
+        disk = db.get();
+        cache.reset(new StateNodeCacheDB(std::move(db), nNodeBytes, nCodeBytes));
+    }
+
+    void Write(const std::vector<std::string>& inserted, const std::vector<std::string>& killed = {})
+    {
+        std::unique_ptr<dev::db::WriteBatchFace> batch = cache->createWriteBatch();
+        for (const std::string& value : inserted)
+            batch->insert(ToSlice(NodeKey(value)), ToSlice(value));
+        for (const std::string& key : killed)
+            batch->kill(ToSlice(key));
+        cache->commit(std::move(batch));
+    }
+};
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(statenodecache_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(state_node_cache_read_through)
+{
+    CachedDB db(1 << 20, 0);
+    std::string node = TrieNode(1);
+    std::string key = NodeKey(node);
+    db.disk->insert(ToSlice(key), ToSlice(node));
+    BOOST_CHECK_EQUAL(db.cache->cachedBytes(), 0U);
+
+    // The first lookup reads the database and keeps the node, later ones are served from memory
+    BOOST_CHECK(db.cache->lookup(ToSlice(key)) == node);
+    BOOST_CHECK(db.cache->cachedBytes() > 0);
+    db.disk->kill(ToSlice(key));
+    BOOST_CHECK(db.cache->lookup(ToSlice(key)) == node);
+    BOOST_CHECK(db.cache->exists(ToSlice(key)));
+
+    // Missing keys are not cached
+    std::string missing = NodeKey(TrieNode(2));
+    BOOST_CHECK(db.cache->lookup(ToSlice(missing)).empty());
+    BOOST_CHECK(!db.cache->exists(ToSlice(missing)));
+}
+
+BOOST_AUTO_TEST_CASE(state_node_cache_writes)
+{
+    CachedDB db(1 << 20, 0);
+    std::string node1 = TrieNode(1), node2 = TrieNode(2);
+
+    // Nodes committed through the cache are on disk and cached
+    db.Write({node1, node2});
+    BOOST_CHECK(db.disk->lookup(ToSlice(NodeKey(node1))) == node1);
+    db.disk->kill(ToSlice(NodeKey(node2)));
+    BOOST_CHECK(db.cache->lookup(ToSlice(NodeKey(node2))) == node2);
+
+    // Killed nodes are gone from both, so the cache never serves a deleted node
+    db.Write({}, {NodeKey(node1)});
+    BOOST_CHECK(db.disk->lookup(ToSlice(NodeKey(node1))).empty());
+    BOOST_CHECK(db.cache->lookup(ToSlice(NodeKey(node1))).empty());
+
+    // The same for single writes
+    db.cache->insert(ToSlice(NodeKey(node1)), ToSlice(node1));
+    BOOST_CHECK(db.disk->lookup(ToSlice(NodeKey(node1))) == node1);
+    db.cache->kill(ToSlice(NodeKey(node1)));
+    BOOST_CHECK(db.cache->lookup(ToSlice(NodeKey(node1))).empty());
+}
+
+BOOST_AUTO_TEST_CASE(state_node_cache_bound)
+{
+    const size_t nMaxBytes = 16 << 10;
+    CachedDB db(nMaxBytes, 0);
+    std::vector<std::string> nodes;
+    for (uint64_t i = 0; i < 1000; i++)
+        nodes.push_back(TrieNode(i));
+    db.Write(nodes);
+    BOOST_CHECK(db.cache->cachedBytes() <= nMaxBytes);
+
+    // The most recently used nodes stay, the oldest ones are read from disk again
+    for (const std::string& node : nodes)
+        db.disk->kill(ToSlice(NodeKey(node)));
+    BOOST_CHECK(db.cache->lookup(ToSlice(NodeKey(nodes.back()))) == nodes.back());
+    BOOST_CHECK(db.cache->lookup(ToSlice(NodeKey(nodes.front()))).empty());
+}
+
+BOOST_AUTO_TEST_CASE(state_node_cache_code_partition)
+{
+    const size_t nMaxCodeBytes = 16 << 10;
+    CachedDB db(1 << 20, nMaxCodeBytes);
+    std::string code(200, (char)0x60);
+    std::string node = TrieNode(1);
+
+    // Bytecode is cached apart from the trie nodes
+    db.Write({code, node});
+    size_t nNodeBytes = db.cache->cachedBytes();
+    BOOST_CHECK(db.cache->cachedCodeBytes() > 0);
+    db.disk->kill(ToSlice(NodeKey(code)));
+    BOOST_CHECK(db.cache->lookup(ToSlice(NodeKey(code))) == code);
+
+    // Large bytecode does not evict the trie nodes
+    for (int i = 0; i < 200; i++)
+        db.Write({std::string(500, (char)(i % 0x80))});
+    BOOST_CHECK(db.cache->cachedCodeBytes() <= nMaxCodeBytes);
+    BOOST_CHECK_EQUAL(db.cache->cachedBytes(), nNodeBytes);
+    db.disk->kill(ToSlice(NodeKey(node)));
+    BOOST_CHECK(db.cache->lookup(ToSlice(NodeKey(node))) == node);
+}
+
+BOOST_AUTO_TEST_CASE(state_node_cache_no_code_partition)
+{
+    CachedDB db(1 << 20, 0);
+    std::string code(200, (char)0x60);
+    db.Write({code});
+    BOOST_CHECK_EQUAL(db.cache->cachedCodeBytes(), 0U);
+    BOOST_CHECK(db.cache->lookup(ToSlice(NodeKey(code))) == code);
+}
+
+BOOST_AUTO_TEST_CASE(state_node_cache_code_written_once)
+{
+    CachedDB db(1 << 20, 1 << 20);
+    std::string code(200, (char)0x60);
+    std::string node = TrieNode(1);
+    std::string codeKey = NodeKey(code), nodeKey = NodeKey(node);
+
+    // Bytecode already stored is not written again by later creations, trie nodes always are
+    db.Write({code, node});
+    BOOST_CHECK_EQUAL(db.disk->writes[codeKey], 1);
+    db.Write({code, node});
+    db.cache->insert(ToSlice(codeKey), ToSlice(code));
+    BOOST_CHECK_EQUAL(db.disk->writes[codeKey], 1);
+    BOOST_CHECK_EQUAL(db.disk->writes[nodeKey], 2);
+    BOOST_CHECK(db.cache->lookup(ToSlice(codeKey)) == code);
+
+    // Other bytecode is written, once
+    std::string other(300, (char)0x61);
+    db.Write({other});
+    db.Write({other});
+    BOOST_CHECK_EQUAL(db.disk->writes[NodeKey(other)], 1);
+    BOOST_CHECK(db.disk->lookup(ToSlice(NodeKey(other))) == other);
+
+    // Bytecode deleted from disk is written again, even while the cache still holds it
+    db.disk->kill(ToSlice(codeKey));
+    BOOST_CHECK(db.cache->lookup(ToSlice(codeKey)) == code);
+    db.Write({code});
+    BOOST_CHECK_EQUAL(db.disk->writes[codeKey], 2);
+    BOOST_CHECK(db.disk->lookup(ToSlice(codeKey)) == code);
+    db.disk->kill(ToSlice(codeKey));
+    db.cache->insert(ToSlice(codeKey), ToSlice(code));
+    BOOST_CHECK_EQUAL(db.disk->writes[codeKey], 3);
+    BOOST_CHECK(db.disk->lookup(ToSlice(codeKey)) == code);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,166 @@
+#include <boost/test/unit_test.hpp>
+#include <test/test_bitcoin.h>
+#include <validation.h>
+#include <util/convert.h>
+
+namespace storageresultstest{
+
+std::vector<TransactionReceiptInfo> createReceipts(const uint256& hashTx){
+    dev::Address contract("abababababababababababababababababababab");
+    dev::Address sender("cdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcd");
+    dev::h256 topic(dev::sha3(std::string("Transfer(address,address,uint256)")));
+    dev::eth::LogEntries logs;
+    logs.push_back(dev::eth::LogEntry(contract, {topic, dev::h256(sender)}, dev::bytes{1, 2, 3}));
+    logs.push_back(dev::eth::LogEntry(contract, {topic}, dev::bytes()));
+
+    std::vector<TransactionReceiptInfo> receipts;
+    for(uint32_t i = 0; i < 2; i++){
+        receipts.push_back(TransactionReceiptInfo{
+            uint256S("0x00000000000000000000000000000000000000000000000000000000000000aa"),
+            1234,
+            hashTx,
+            2,
+            i,
+            sender,
+            contract,
+            100000 + i,
+            21000 + i,
+            i ? dev::Address() : contract,
+            logs,
+            i ? dev::eth::TransactionException::OutOfGas : dev::eth::TransactionException::None,
+            i ? "out of gas" : "",
+            dev::h256(i + 1),
+            dev::h256(i + 2),
+            {std::make_pair(contract, dev::bytes{0x60, 0x60})},
+            {sender}
+        });
+    }
+    return receipts;
+}
+
+void checkReceipts(const std::vector<TransactionReceiptInfo>& a, const std::vector<TransactionReceiptInfo>& b){
+    BOOST_REQUIRE_EQUAL(a.size(), b.size());
+    for(size_t i = 0; i < a.size(); i++){
+        BOOST_CHECK(a[i].blockHash == b[i].blockHash);
+        BOOST_CHECK_EQUAL(a[i].blockNumber, b[i].blockNumber);
+        BOOST_CHECK(a[i].transactionHash == b[i].transactionHash);
+        BOOST_CHECK_EQUAL(a[i].transactionIndex, b[i].transactionIndex);
+        BOOST_CHECK_EQUAL(a[i].outputIndex, b[i].outputIndex);
+        BOOST_CHECK(a[i].from == b[i].from);
+        BOOST_CHECK(a[i].to == b[i].to);
+        BOOST_CHECK_EQUAL(a[i].cumulativeGasUsed, b[i].cumulativeGasUsed);
+        BOOST_CHECK_EQUAL(a[i].gasUsed, b[i].gasUsed);
+        BOOST_CHECK(a[i].contractAddress == b[i].contractAddress);
+        BOOST_REQUIRE_EQUAL(a[i].logs.size(), b[i].logs.size());
+        for(size_t j = 0; j < a[i].logs.size(); j++){
+            BOOST_CHECK(a[i].logs[j].address == b[i].logs[j].address);
+            BOOST_CHECK(a[i].logs[j].topics == b[i].logs[j].topics);
+            BOOST_CHECK(a[i].logs[j].data == b[i].logs[j].data);
+        }
+        BOOST_CHECK(a[i].excepted == b[i].excepted);
+        BOOST_CHECK_EQUAL(a[i].exceptedMessage, b[i].exceptedMessage);
+        BOOST_CHECK(a[i].stateRoot == b[i].stateRoot);
+        BOOST_CHECK(a[i].utxoRoot == b[i].utxoRoot);
+        BOOST_CHECK(a[i].createdContracts == b[i].createdContracts);
+        BOOST_CHECK(a[i].destructedContracts == b[i].destructedContracts);
+        BOOST_CHECK_EQUAL(a[i].fStorageGrowth, b[i].fStorageGrowth);
+        BOOST_REQUIRE_EQUAL(a[i].storageGrowth.size(), b[i].storageGrowth.size());
+        for(size_t j = 0; j < a[i].storageGrowth.size(); j++){
+            BOOST_CHECK(a[i].storageGrowth[j].first == b[i].storageGrowth[j].first);
+            BOOST_CHECK_EQUAL(a[i].storageGrowth[j].second.nLeaves, b[i].storageGrowth[j].second.nLeaves);
+            BOOST_CHECK_EQUAL(a[i].storageGrowth[j].second.nNodes, b[i].storageGrowth[j].second.nNodes);
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_SUITE(storageresults_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(storageresults_roundtrip){
+    uint256 hashTx = uint256S("0x0000000000000000000000000000000000000000000000000000000000000bcd");
+    std::vector<TransactionReceiptInfo> receipts = createReceipts(hashTx);
+    pstorageresult->addResult(uintToh256(hashTx), receipts);
+    pstorageresult->commitResults();
+
+    // Committed results are visible before and after they are flushed
+    checkReceipts(receipts, pstorageresult->getResult(uintToh256(hashTx)));
+    BOOST_CHECK(pstorageresult->flushResults());
+    checkReceipts(receipts, pstorageresult->getResult(uintToh256(hashTx)));
+}
+
+BOOST_AUTO_TEST_CASE(storageresults_storagegrowth){
+    uint256 hashTx = uint256S("0x0000000000000000000000000000000000000000000000000000000000000bce");
+    std::vector<TransactionReceiptInfo> receipts = createReceipts(hashTx);
+    StateTrieDiff growth;
+    growth.nLeaves = 3;
+    growth.nNodes = -2;
+    receipts[0].storageGrowth.emplace_back(receipts[0].to, growth);
+    for(TransactionReceiptInfo& receipt : receipts)
+        receipt.fStorageGrowth = true;
+    pstorageresult->addResult(uintToh256(hashTx), receipts);
+    pstorageresult->commitResults();
+    BOOST_CHECK(pstorageresult->flushResults());
+    checkReceipts(receipts, pstorageresult->getResult(uintToh256(hashTx)));
+}
+
+BOOST_AUTO_TEST_CASE(storageresults_disconnect){
+    CMutableTransaction mtx;
+    mtx.vout.resize(1);
+    CTransactionRef tx = MakeTransactionRef(mtx);
+    std::vector<TransactionReceiptInfo> receipts = createReceipts(tx->GetHash());
+    dev::h256 hashBlock = uintToh256(receipts[0].blockHash);
+    pstorageresult->addResult(uintToh256(tx->GetHash()), receipts);
+    pstorageresult->commitResults();
+    BOOST_CHECK(pstorageresult->flushResults());
+
+    // The transaction is unmapped, its receipts stay under the block
+    pstorageresult->disconnectResults(hashBlock, {tx});
+    BOOST_CHECK(pstorageresult->getResult(uintToh256(tx->GetHash())).empty());
+    BOOST_CHECK(pstorageresult->flushResults());
+    BOOST_CHECK(pstorageresult->getResult(uintToh256(tx->GetHash())).empty());
+    checkReceipts(receipts, pstorageresult->getResult(hashBlock, uintToh256(tx->GetHash())));
+
+    // Connecting the block again maps the transaction to the stored receipts
+    pstorageresult->addResult(uintToh256(tx->GetHash()), receipts);
+    pstorageresult->commitResults();
+    BOOST_CHECK(pstorageresult->flushResults());
+    checkReceipts(receipts, pstorageresult->getResult(uintToh256(tx->GetHash())));
+
+    // Connected in another block, the transaction maps to the receipts of that block
+    std::vector<TransactionReceiptInfo> otherReceipts = createReceipts(tx->GetHash());
+    for(TransactionReceiptInfo& receipt : otherReceipts)
+        receipt.blockHash = uint256S("0x00000000000000000000000000000000000000000000000000000000000000bb");
+    pstorageresult->disconnectResults(hashBlock, {tx});
+    pstorageresult->addResult(uintToh256(tx->GetHash()), otherReceipts);
+    pstorageresult->commitResults();
+    BOOST_CHECK(pstorageresult->flushResults());
+    checkReceipts(otherReceipts, pstorageresult->getResult(uintToh256(tx->GetHash())));
+    checkReceipts(receipts, pstorageresult->getResult(hashBlock, uintToh256(tx->GetHash())));
+}
+
+BOOST_AUTO_TEST_CASE(storageresults_batch){
+    fs::path path = GetDataDir() / "results_batch";
+    fs::create_directories(path);
+    std::unique_ptr<StorageResults> results(new StorageResults(path.string()));
+    uint256 hashTx1 = uint256S("0x0000000000000000000000000000000000000000000000000000000000000bd1");
+    uint256 hashTx2 = uint256S("0x0000000000000000000000000000000000000000000000000000000000000bd2");
+    std::vector<TransactionReceiptInfo> receipts1 = createReceipts(hashTx1);
+    std::vector<TransactionReceiptInfo> receipts2 = createReceipts(hashTx2);
+
+    // The results of several blocks wait in one batch and are read from it until it is written
+    results->addResult(uintToh256(hashTx1), receipts1);
+    results->commitResults();
+    results->addResult(uintToh256(hashTx2), receipts2);
+    results->commitResults();
+    checkReceipts(receipts1, results->getResult(uintToh256(hashTx1)));
+    checkReceipts(receipts2, results->getResult(uintToh256(hashTx2)));
+
+    // The pending batch is written when the database is closed
+    results.reset();
+    results.reset(new StorageResults(path.string()));
+    checkReceipts(receipts1, results->getResult(uintToh256(hashTx1)));
+    checkReceipts(receipts2, results->getResult(uintToh256(hashTx2)));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
@@ -1,4 +1,5 @@
 #include <util/system.h>
+#include <qtum/qtumstatecache.h>
 #include <validation.h>
 #include <util/strencodings.h>
 #include <util/convert.h>
@@ -14,9 +15,11 @@ inline void initState(){
     boost::filesystem::create_directories(pathTemp);
     const std::string dirQtum = pathTemp.string();
     const dev::h256 hashDB(dev::sha3(dev::rlp("")));
-    globalState = std::unique_ptr<QtumState>(new QtumState(dev::u256(0), QtumState::openDB(dirQtum, hashDB, dev::WithExisting::Trust), dirQtum + "/qtumDB", dev::eth::BaseState::Empty));
+    fStateInMemory = true;
+    globalState = std::unique_ptr<QtumState>(new QtumState(dev::u256(0), OpenCachedStateDB(dirQtum, hashDB, 0), dirQtum + "/qtumDB", dev::eth::BaseState::Empty));
 
     globalState->setRootUTXO(dev::sha3(dev::rlp(""))); // temp
+    QtumDGP::clearCache();
 }
 
 inline CBlock generateBlock(){
@@ -161,6 +161,27 @@ BOOST_AUTO_TEST_CASE(sighash_test)
     #endif
 }
 
+// Goal: check that the forced precomputed data of a tx without witness gives the same witness sighashes
+BOOST_AUTO_TEST_CASE(sighash_precomputed_forced)
+{
+    SeedInsecureRand(false);
+
+    for (int i=0; i<1000; i++) {
+        int nHashType = InsecureRand32();
+        CMutableTransaction txTo;
+        RandomTransaction(txTo, (nHashType & 0x1f) == SIGHASH_SINGLE);
+        CScript scriptCode;
+        RandomScript(scriptCode);
+        int nIn = InsecureRandRange(txTo.vin.size());
+        CAmount amount = InsecureRandRange(MAX_MONEY);
+
+        const PrecomputedTransactionData txdata(txTo, true);
+        BOOST_CHECK(txdata.ready);
+        BOOST_CHECK(SignatureHash(scriptCode, txTo, nIn, nHashType, amount, SigVersion::WITNESS_V0, &txdata) ==
+                    SignatureHash(scriptCode, txTo, nIn, nHashType, amount, SigVersion::WITNESS_V0));
+    }
+}
+
 // Goal: check that SignatureHash generates correct hash
 BOOST_AUTO_TEST_CASE(sighash_from_data)
 {
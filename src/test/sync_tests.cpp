@@ -7,6 +7,8 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <thread>
+
 namespace {
 template <typename MutexType>
 void TestPotentialDeadLockDetected(MutexType& mutex1, MutexType& mutex2)
@@ -49,4 +51,72 @@ BOOST_AUTO_TEST_CASE(potential_deadlock_detected)
     #endif
 }
 
+static const LockStatsSnapshot* FindLockStats(const std::vector<LockStatsSnapshot>& vStats, const std::string& name)
+{
+    for (const LockStatsSnapshot& stats : vStats) {
+        if (stats.name == name)
+            return &stats;
+    }
+    return nullptr;
+}
+
+BOOST_AUTO_TEST_CASE(lock_stats)
+{
+    EnableLockStats();
+    CCriticalSection rmutex;
+    std::unique_ptr<Mutex> mutex = MakeUnique<Mutex>();
+    RegisterLockStats(&rmutex, "sync_tests_rmutex");
+    RegisterLockStats(mutex.get(), "sync_tests_mutex");
+
+    // A recursive lock counts once
+    {
+        LOCK(rmutex);
+        LOCK(rmutex);
+    }
+    {
+        WAIT_LOCK(*mutex, lock);
+        std::thread t([&] {
+            TRY_LOCK(*mutex, lockTry);
+            BOOST_CHECK(!lockTry);
+        });
+        t.join();
+    }
+    std::vector<LockStatsSnapshot> vStats = GetLockStatsSnapshot(10);
+    const LockStatsSnapshot* rstats = FindLockStats(vStats, "sync_tests_rmutex");
+    BOOST_REQUIRE(rstats);
+    BOOST_CHECK_EQUAL(rstats->nLocks, 1U);
+    BOOST_CHECK_EQUAL(rstats->nContended, 0U);
+    const LockStatsSnapshot* stats = FindLockStats(vStats, "sync_tests_mutex");
+    BOOST_REQUIRE(stats);
+    BOOST_CHECK_EQUAL(stats->nLocks, 1U);
+    BOOST_CHECK_EQUAL(stats->nTryFailed, 1U);
+
+    // A lock that waits is counted with its call site
+    std::thread t;
+    {
+        LOCK(*mutex);
+        t = std::thread([&] {
+            LOCK(*mutex);
+        });
+        MilliSleep(10);
+    }
+    t.join();
+    stats = FindLockStats(vStats = GetLockStatsSnapshot(10), "sync_tests_mutex");
+    BOOST_REQUIRE(stats);
+    BOOST_CHECK_EQUAL(stats->nLocks, 3U);
+    BOOST_CHECK_EQUAL(stats->nContended, 1U);
+    BOOST_REQUIRE_EQUAL(stats->vSites.size(), 1U);
+    BOOST_CHECK_EQUAL(stats->vSites[0].nContended, 1U);
+
+    // A destroyed mutex is no longer counted
+    Mutex* pmutex = mutex.get();
+    mutex.reset();
+    BOOST_CHECK(GetLockStats(pmutex) == nullptr);
+
+    ResetLockStats();
+    rstats = FindLockStats(vStats = GetLockStatsSnapshot(10), "sync_tests_rmutex");
+    BOOST_REQUIRE(rstats);
+    BOOST_CHECK_EQUAL(rstats->nLocks, 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -9,6 +9,7 @@
 #include <consensus/consensus.h>
 #include <consensus/params.h>
 #include <consensus/validation.h>
+#include <crypto/keccak.h>
 #include <crypto/sha256.h>
 #include <miner.h>
 #include <net_processing.h>
@@ -20,6 +21,7 @@
 #include <streams.h>
 #include <util/convert.h>
 #include <ui_interface.h>
+#include <qtum/qtumstatecache.h>
 #include <validation.h>
 
 const std::function<std::string(const char*)> G_TRANSLATION_FUN = nullptr;
@@ -36,6 +38,7 @@ BasicTestingSetup::BasicTestingSetup(const std::string& chainName)
     : m_path_root(fs::temp_directory_path() / "test_kpg" / strprintf("%lu_%i", (unsigned long)GetTime(), (int)(InsecureRandRange(1 << 30))))
 {
     SHA256AutoDetect();
+    KeccakAutoDetect();
     ECC_Start();
     SetupEnvironment();
     SetupNetworking();
@@ -88,8 +91,11 @@ TestingSetup::TestingSetup(const std::string& chainName) : BasicTestingSetup(cha
         boost::filesystem::path pathTemp = fs::temp_directory_path() / strprintf("test_kpg_%lu_%i", (unsigned long)GetTime(), (int)(GetRand(100000)));
         boost::filesystem::create_directories(pathTemp);
         const dev::h256 hashDB(dev::sha3(dev::rlp("")));
-        globalState = std::unique_ptr<QtumState>(new QtumState(dev::u256(0), QtumState::openDB(pathTemp.string(), hashDB, dev::WithExisting::Trust), pathTemp.string(), dev::eth::BaseState::Empty));
+        // In memory, as the block tree and the coins
+        fStateInMemory = true;
+        globalState = std::unique_ptr<QtumState>(new QtumState(dev::u256(0), OpenCachedStateDB(pathTemp.string(), hashDB, 0), pathTemp.string(), dev::eth::BaseState::Empty));
         dev::eth::ChainParams cp((chainparams.EVMGenesisInfo(dev::eth::Network::qtumTestNetwork)));
+        QtumDGP::clearCache();
         globalSealEngine = std::unique_ptr<dev::eth::SealEngineFace>(cp.createSealEngine());
         globalState->populateFrom(cp.genesisState);
         globalState->setRootUTXO(uintToh256(chainparams.GenesisBlock().hashUTXORoot));
@@ -190,7 +196,7 @@ CTxMemPoolEntry TestMemPoolEntryHelper::FromTx(const CMutableTransaction &tx) {
 CTxMemPoolEntry TestMemPoolEntryHelper::FromTx(const CTransactionRef& tx)
 {
     return CTxMemPoolEntry(tx, nFee, nTime, nHeight,
-                           spendsCoinbase, sigOpCost, lp);
+                           spendsCoinbase, sigOpCost, lp, nMinGasPrice, nGasLimit);
 }
 
 /**
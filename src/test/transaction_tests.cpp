@@ -768,4 +768,42 @@ BOOST_AUTO_TEST_CASE(test_IsStandard)
     BOOST_CHECK(!IsStandardTx(CTransaction(t), reason));
 }
 
+BOOST_AUTO_TEST_CASE(make_transaction_refs)
+{
+    // A block of transactions with and without witnesses, deserialized with the hashes
+    // computed on the calling thread, on the precheck queue, and by parts that give up
+    CBlock block;
+    for (size_t i = 0; i < MIN_PARALLEL_TX_HASHES * 2 + 1; i++) {
+        CMutableTransaction mtx;
+        mtx.vin.resize(1);
+        mtx.vin[0].prevout = COutPoint(InsecureRand256(), i);
+        if (i % 3 == 0)
+            mtx.vin[0].scriptWitness.stack.push_back(std::vector<unsigned char>(i % 50, 1));
+        mtx.vout.resize(1);
+        mtx.vout[0].nValue = i;
+        block.vtx.push_back(MakeTransactionRef(std::move(mtx)));
+    }
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << block;
+
+    // Skips every other part, as parts that failed to make their transactions do
+    auto halfParallel = [](size_t n, const std::function<void(size_t, size_t)>& fn) {
+        for (size_t begin = 0; begin < n; begin += 2 * MIN_PARALLEL_TX_HASHES)
+            fn(begin, std::min(n, begin + MIN_PARALLEL_TX_HASHES));
+    };
+    const ParallelForRangesFn parallel = g_tx_hash_parallel;
+    for (ParallelForRangesFn fn : {(ParallelForRangesFn)nullptr, (ParallelForRangesFn)ParallelForRanges, (ParallelForRangesFn)halfParallel}) {
+        g_tx_hash_parallel = fn;
+        CDataStream ssCopy(ss);
+        CBlock decoded;
+        ssCopy >> decoded;
+        BOOST_REQUIRE_EQUAL(decoded.vtx.size(), block.vtx.size());
+        for (size_t i = 0; i < block.vtx.size(); i++) {
+            BOOST_CHECK(decoded.vtx[i]->GetHash() == block.vtx[i]->GetHash());
+            BOOST_CHECK(decoded.vtx[i]->GetWitnessHash() == block.vtx[i]->GetWitnessHash());
+        }
+    }
+    g_tx_hash_parallel = parallel;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,175 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <test/test_bitcoin.h>
+#include <txdb.h>
+#include <arith_uint256.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(txdb_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(stake_index_batch)
+{
+    CBlockTreeDB db(1 << 20, true);
+    const uint160 staker1(std::vector<unsigned char>(20, 1));
+    const uint160 staker2(std::vector<unsigned char>(20, 2));
+    const std::vector<std::pair<int, const CBlockFileInfo*>> noFiles;
+    const std::vector<const CBlockIndex*> noBlocks;
+
+    BOOST_CHECK(db.WriteStakeIndex(10, staker1));
+    BOOST_CHECK(db.WriteStakeIndex(11, staker1));
+    BOOST_CHECK(db.WriteStakeIndex(12, uint160()));
+
+    // Staged entries are read back before they are flushed
+    uint160 address;
+    BOOST_CHECK(db.ReadStakeIndex(10, address) && address == staker1);
+    std::vector<unsigned int> heights;
+    BOOST_CHECK(db.ReadStakerIndex(staker1, 0, -1, heights));
+    BOOST_CHECK(heights == std::vector<unsigned int>({10, 11}));
+
+    BOOST_CHECK(db.WriteBatchSync(noFiles, 0, noBlocks));
+    BOOST_CHECK(db.ReadStakeIndex(12, address) && address.IsNull());
+
+    // A block at 11 disconnected and another connected, and 10 disconnected
+    BOOST_CHECK(db.EraseStakeIndex(11));
+    BOOST_CHECK(db.WriteStakeIndex(11, staker2));
+    BOOST_CHECK(db.EraseStakeIndex(10));
+    BOOST_CHECK(!db.ReadStakeIndex(10, address));
+    for (int flushed = 0; flushed < 2; flushed++) {
+        heights.clear();
+        BOOST_CHECK(db.ReadStakerIndex(staker1, 0, -1, heights));
+        BOOST_CHECK(heights.empty());
+        heights.clear();
+        BOOST_CHECK(db.ReadStakerIndex(staker2, 11, 11, heights));
+        BOOST_CHECK(heights == std::vector<unsigned int>({11}));
+        BOOST_CHECK(db.WriteBatchSync(noFiles, 0, noBlocks));
+    }
+    BOOST_CHECK(!db.ReadStakeIndex(10, address));
+}
+
+BOOST_AUTO_TEST_CASE(staker_index_upgrade)
+{
+    CBlockTreeDB db(1 << 20, true);
+    const uint160 staker1(std::vector<unsigned char>(20, 1));
+    const uint160 staker2(std::vector<unsigned char>(20, 2));
+
+    // Stake entries written before the staker index, including some above the tip
+    for (unsigned int height = 250; height < 270; height++)
+        BOOST_CHECK(db.Write(std::make_pair('s', height), height % 2 ? staker1 : staker2));
+    BOOST_CHECK(db.Write(std::make_pair('s', 270U), uint160()));
+    BOOST_CHECK(db.Write(std::make_pair('s', 300U), staker1));
+    std::vector<unsigned int> heights;
+    BOOST_CHECK(db.ReadStakerIndex(staker1, 0, -1, heights));
+    BOOST_CHECK(heights.empty());
+
+    BOOST_CHECK(db.UpgradeStakerIndex(280));
+    BOOST_CHECK(db.ReadStakerIndex(staker1, 0, -1, heights));
+    BOOST_CHECK(heights == std::vector<unsigned int>({251, 253, 255, 257, 259, 261, 263, 265, 267, 269}));
+
+    // Windows are in height order across the bytes of the height
+    heights.clear();
+    BOOST_CHECK(db.ReadStakerIndex(staker2, 254, 258, heights));
+    BOOST_CHECK(heights == std::vector<unsigned int>({254, 256, 258}));
+    heights.clear();
+    BOOST_CHECK(db.ReadStakerIndex(staker2, 269, -1, heights));
+    BOOST_CHECK(heights.empty());
+
+    // The point read is exact, and the upgrade only runs once
+    uint160 address;
+    BOOST_CHECK(db.ReadStakeIndex(255, address) && address == staker1);
+    BOOST_CHECK(!db.ReadStakeIndex(271, address));
+    BOOST_CHECK(db.Write(std::make_pair('s', 275U), staker1));
+    BOOST_CHECK(db.UpgradeStakerIndex(280));
+    heights.clear();
+    BOOST_CHECK(db.ReadStakerIndex(staker1, 270, -1, heights));
+    BOOST_CHECK(heights.empty());
+}
+
+BOOST_AUTO_TEST_CASE(log_bloom_skip)
+{
+    CBlockTreeDB db(1 << 20, true);
+    const dev::h160 addressA(std::vector<unsigned char>(20, 0xaa));
+    const dev::h160 addressB(std::vector<unsigned char>(20, 0xbb));
+    const dev::h256 topic1(1), topic2(2);
+    const std::vector<std::pair<dev::h160, dev::h256>> logs = {{addressA, topic1}, {addressB, topic2}, {addressA, topic2}};
+
+    BOOST_CHECK(db.WriteLogBloomStart(0));
+    for (unsigned int height = 1; height <= logs.size(); height++) {
+        const std::pair<dev::h160, dev::h256>& log = logs[height - 1];
+        BOOST_CHECK(db.WriteHeightIndex(CHeightTxIndexKey(height, log.first), {ArithToUint256(height)}));
+        BOOST_CHECK(db.WriteLogBloom(height, dev::eth::LogEntry(log.first, {log.second}, dev::bytes()).bloom()));
+    }
+
+    auto read = [&db](const CLogBloomFilter* filter) {
+        std::vector<std::vector<uint256>> blocksOfHashes;
+        BOOST_CHECK_EQUAL(db.ReadHeightIndex(1, -1, 0, blocksOfHashes, std::set<dev::h160>(), filter), 3);
+        std::vector<uint256> hashes;
+        for (const std::vector<uint256>& blockHashes : blocksOfHashes)
+            hashes.insert(hashes.end(), blockHashes.begin(), blockHashes.end());
+        return hashes;
+    };
+
+    // Without a filter every block is returned, with one only the blocks whose bloom matches
+    BOOST_CHECK(read(nullptr) == std::vector<uint256>({ArithToUint256(1), ArithToUint256(2), ArithToUint256(3)}));
+    CLogBloomFilter filter;
+    filter.topics.push_back(topic2);
+    BOOST_CHECK(read(&filter) == std::vector<uint256>({ArithToUint256(2), ArithToUint256(3)}));
+    filter.addresses.insert(addressA);
+    BOOST_CHECK(read(&filter) == std::vector<uint256>({ArithToUint256(3)}));
+
+    // All topics have to be present, or any of them for a receipt filter
+    filter.addresses.clear();
+    filter.topics.push_back(topic1);
+    BOOST_CHECK(read(&filter).empty());
+    filter.fMatchAllTopics = false;
+    BOOST_CHECK(read(&filter).size() == 3);
+
+    // A block disconnected and another one connected at its height
+    BOOST_CHECK(db.EraseHeightIndex(3));
+    BOOST_CHECK(db.EraseLogBloom(3));
+    BOOST_CHECK(db.WriteHeightIndex(CHeightTxIndexKey(3, addressB), {ArithToUint256(4)}));
+    BOOST_CHECK(db.WriteLogBloom(3, dev::eth::LogEntry(addressB, {topic1}, dev::bytes()).bloom()));
+    CLogBloomFilter filterA;
+    filterA.addresses.insert(addressA);
+    filterA.topics.push_back(topic2);
+    BOOST_CHECK(read(&filterA).empty());
+}
+
+BOOST_AUTO_TEST_CASE(topic_index)
+{
+    CBlockTreeDB db(1 << 20, true);
+    const dev::h256 topic1(1), topic2(2);
+    const uint256 tx1 = ArithToUint256(1), tx2 = ArithToUint256(2), tx3 = ArithToUint256(3), tx4 = ArithToUint256(4);
+
+    // Entries are ordered by height and position in the block, not by write order
+    BOOST_CHECK(db.WriteTopicIndex({{CTopicIndexKey(topic1, 10, 2), tx2}, {CTopicIndexKey(topic1, 10, 1), tx1}, {CTopicIndexKey(topic2, 10, 3), tx3}}));
+    BOOST_CHECK(db.WriteTopicIndex({{CTopicIndexKey(topic1, 11, 1), tx4}}));
+
+    std::vector<uint256> hashes;
+    BOOST_CHECK_EQUAL(db.ReadTopicIndex(0, -1, 0, topic1, hashes), 11);
+    BOOST_CHECK(hashes == std::vector<uint256>({tx1, tx2, tx4}));
+    hashes.clear();
+    BOOST_CHECK_EQUAL(db.ReadTopicIndex(11, 11, 0, topic1, hashes), 11);
+    BOOST_CHECK(hashes == std::vector<uint256>({tx4}));
+    hashes.clear();
+    BOOST_CHECK_EQUAL(db.ReadTopicIndex(0, -1, 0, topic2, hashes), 10);
+    BOOST_CHECK(hashes == std::vector<uint256>({tx3}));
+
+    // Disconnecting a block removes its entries of the given topics only
+    BOOST_CHECK(db.EraseTopicIndex(10, {topic1}));
+    hashes.clear();
+    db.ReadTopicIndex(0, -1, 0, topic1, hashes);
+    BOOST_CHECK(hashes == std::vector<uint256>({tx4}));
+    hashes.clear();
+    db.ReadTopicIndex(0, -1, 0, topic2, hashes);
+    BOOST_CHECK(hashes == std::vector<uint256>({tx3}));
+
+    BOOST_CHECK(db.WipeTopicIndex());
+    hashes.clear();
+    BOOST_CHECK_EQUAL(db.ReadTopicIndex(0, -1, 0, topic1, hashes), 0);
+    BOOST_CHECK(hashes.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
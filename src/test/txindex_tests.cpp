@@ -5,6 +5,7 @@
 #include <chainparams.h>
 #include <index/txindex.h>
 #include <script/standard.h>
+#include <shutdown.h>
 #include <test/test_bitcoin.h>
 #include <util/system.h>
 #include <util/time.h>
@@ -12,11 +13,14 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <limits>
+
 BOOST_AUTO_TEST_SUITE(txindex_tests)
 
-BOOST_FIXTURE_TEST_CASE(txindex_initial_sync, TestChain100Setup)
+static void TestInitialSync(TestChain100Setup& setup, bool f_compact)
 {
-    TxIndex txindex(1 << 20, true);
+    TxIndex txindex(1 << 20, true, false, f_compact);
+    const std::vector<CTransactionRef>& m_coinbase_txns = setup.m_coinbase_txns;
 
     CTransactionRef tx_disk;
     uint256 block_hash;
@@ -54,11 +58,16 @@ BOOST_FIXTURE_TEST_CASE(txindex_initial_sync, TestChain100Setup)
         }
     }
 
+    // A txid of the same prefix as an indexed one is not found.
+    uint256 other_hash = m_coinbase_txns[0]->GetHash();
+    *(other_hash.end() - 1) ^= 1;
+    BOOST_CHECK(!txindex.FindTx(other_hash, block_hash, tx_disk));
+
     // Check that new transactions in new blocks make it into the index.
     for (int i = 0; i < 10; i++) {
-        CScript coinbase_script_pub_key = GetScriptForDestination(coinbaseKey.GetPubKey().GetID());
+        CScript coinbase_script_pub_key = GetScriptForDestination(setup.coinbaseKey.GetPubKey().GetID());
         std::vector<CMutableTransaction> no_txns;
-        const CBlock& block = CreateAndProcessBlock(no_txns, coinbase_script_pub_key);
+        const CBlock& block = setup.CreateAndProcessBlock(no_txns, coinbase_script_pub_key);
         const CTransaction& txn = *block.vtx[0];
 
         BOOST_CHECK(txindex.BlockUntilSyncedToCurrentChain());
@@ -72,10 +81,65 @@ BOOST_FIXTURE_TEST_CASE(txindex_initial_sync, TestChain100Setup)
     // shutdown sequence (c.f. Shutdown() in init.cpp)
     txindex.Stop();
 
-    threadGroup.interrupt_all();
-    threadGroup.join_all();
+    setup.threadGroup.interrupt_all();
+    setup.threadGroup.join_all();
 
     // Rest of shutdown sequence and destructors happen in ~TestingSetup()
 }
 
+BOOST_FIXTURE_TEST_CASE(txindex_initial_sync, TestChain100Setup)
+{
+    TestInitialSync(*this, false);
+}
+
+BOOST_FIXTURE_TEST_CASE(txindex_compact_initial_sync, TestChain100Setup)
+{
+    TestInitialSync(*this, true);
+}
+
+BOOST_FIXTURE_TEST_CASE(txindex_prune_lock, TestChain100Setup)
+{
+    const int no_lock = std::numeric_limits<int>::max();
+    BOOST_CHECK_EQUAL(BaseIndex::GetPruneLockHeight(), no_lock);
+
+    // A started index holds back pruning above the last block it processed
+    TxIndex txindex(1 << 20, true);
+    txindex.Start();
+    constexpr int64_t timeout_ms = 10 * 1000;
+    int64_t time_start = GetTimeMillis();
+    while (!txindex.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        MilliSleep(100);
+    }
+    BOOST_CHECK_EQUAL(BaseIndex::GetPruneLockHeight(), chainActive.Height() + 1);
+    CreateAndProcessBlock({}, GetScriptForDestination(coinbaseKey.GetPubKey().GetID()));
+    BOOST_CHECK(txindex.BlockUntilSyncedToCurrentChain());
+    BOOST_CHECK_EQUAL(BaseIndex::GetPruneLockHeight(), chainActive.Height() + 1);
+    txindex.Stop();
+    BOOST_CHECK_EQUAL(BaseIndex::GetPruneLockHeight(), no_lock);
+
+    // A new index whose first block was pruned fails to start and holds back nothing
+    CBlockIndex* pindex_first;
+    {
+        LOCK(cs_main);
+        pindex_first = chainActive[1];
+        pindex_first->nStatus &= ~BLOCK_HAVE_DATA;
+    }
+    fHavePruned = true;
+    TxIndex pruned_txindex(1 << 20, true);
+    pruned_txindex.Start();
+    BOOST_CHECK(ShutdownRequested());
+    BOOST_CHECK_EQUAL(BaseIndex::GetPruneLockHeight(), no_lock);
+    pruned_txindex.Stop();
+    {
+        LOCK(cs_main);
+        pindex_first->nStatus |= BLOCK_HAVE_DATA;
+    }
+    fHavePruned = false;
+    AbortShutdown();
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
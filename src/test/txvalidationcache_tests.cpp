@@ -16,10 +16,14 @@
 #include <core_io.h>
 #include <keystore.h>
 #include <policy/policy.h>
+#include <pow.h>
 
 #include <boost/test/unit_test.hpp>
 
+#include <limits>
+
 bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks);
+unsigned int GetBlockScriptFlags(const CBlockIndex* pindex, const Consensus::Params& consensusparams);
 
 BOOST_AUTO_TEST_SUITE(tx_validationcache_tests)
 
@@ -367,4 +371,119 @@ BOOST_FIXTURE_TEST_CASE(checkinputs_test, TestChain100Setup)
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(mempool_precomputed_txdata, TestChain100Setup)
+{
+    CScript p2pk_scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CScript p2wpkh_scriptPubKey = GetScriptForWitness(GetScriptForDestination(coinbaseKey.GetPubKey().GetID()));
+    CBasicKeyStore keystore;
+    BOOST_CHECK(keystore.AddKey(coinbaseKey));
+
+    // Fund a witness output
+    CMutableTransaction fund_tx;
+    fund_tx.nVersion = 1;
+    fund_tx.vin.resize(1);
+    fund_tx.vin[0].prevout = COutPoint(m_coinbase_txns[0]->GetHash(), 0);
+    fund_tx.vout.resize(1);
+    fund_tx.vout[0].nValue = 11*CENT;
+    fund_tx.vout[0].scriptPubKey = p2wpkh_scriptPubKey;
+    SignatureData sigdata;
+    BOOST_CHECK(ProduceSignature(keystore, MutableTransactionSignatureCreator(&fund_tx, 0, m_coinbase_txns[0]->vout[0].nValue, SIGHASH_ALL), p2pk_scriptPubKey, sigdata));
+    UpdateInput(fund_tx.vin[0], sigdata);
+    CreateAndProcessBlock({fund_tx}, p2pk_scriptPubKey);
+
+    CMutableTransaction witness_tx;
+    witness_tx.nVersion = 1;
+    witness_tx.vin.resize(1);
+    witness_tx.vin[0].prevout = COutPoint(fund_tx.GetHash(), 0);
+    witness_tx.vout.resize(1);
+    witness_tx.vout[0].nValue = 10*CENT;
+    witness_tx.vout[0].scriptPubKey = p2pk_scriptPubKey;
+    sigdata = SignatureData();
+    BOOST_CHECK(ProduceSignature(keystore, MutableTransactionSignatureCreator(&witness_tx, 0, 11*CENT, SIGHASH_ALL), p2wpkh_scriptPubKey, sigdata));
+    UpdateInput(witness_tx.vin[0], sigdata);
+
+    CMutableTransaction plain_tx;
+    plain_tx.nVersion = 1;
+    plain_tx.vin.resize(1);
+    plain_tx.vin[0].prevout = COutPoint(m_coinbase_txns[1]->GetHash(), 0);
+    plain_tx.vout.resize(1);
+    plain_tx.vout[0].nValue = 11*CENT;
+    plain_tx.vout[0].scriptPubKey = p2pk_scriptPubKey;
+    sigdata = SignatureData();
+    BOOST_CHECK(ProduceSignature(keystore, MutableTransactionSignatureCreator(&plain_tx, 0, m_coinbase_txns[1]->vout[0].nValue, SIGHASH_ALL), p2pk_scriptPubKey, sigdata));
+    UpdateInput(plain_tx.vin[0], sigdata);
+
+    // The mempool keeps the sighash data of the witness tx only
+    BOOST_CHECK(ToMemPool(witness_tx));
+    BOOST_CHECK(ToMemPool(plain_tx));
+    {
+        LOCK(mempool.cs);
+        auto it = mempool.mapTx.find(witness_tx.GetHash());
+        BOOST_REQUIRE(it != mempool.mapTx.end());
+        BOOST_REQUIRE(it->GetPrecomputedData());
+        BOOST_CHECK(it->GetPrecomputedData()->ready);
+        it = mempool.mapTx.find(plain_tx.GetHash());
+        BOOST_REQUIRE(it != mempool.mapTx.end());
+        BOOST_CHECK(!it->GetPrecomputedData());
+    }
+
+    // A block of the mempool txs connects with the data kept on their entries
+    std::unique_ptr<CBlockTemplate> pblocktemplate = BlockAssembler(Params()).CreateNewBlock(p2pk_scriptPubKey);
+    CBlock& block = pblocktemplate->block;
+    BOOST_CHECK_EQUAL(block.vtx.size(), 3U);
+    {
+        LOCK(cs_main);
+        unsigned int extraNonce = 0;
+        IncrementExtraNonce(&block, chainActive.Tip(), extraNonce);
+    }
+    while (!CheckProofOfWork(block.GetHash(), block.nBits, Params().GetConsensus())) ++block.nNonce;
+    BOOST_CHECK(ProcessNewBlock(Params(), std::make_shared<const CBlock>(block), true, nullptr));
+    LOCK(cs_main);
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == block.GetHash());
+    BOOST_CHECK_EQUAL(mempool.size(), 0U);
+    BOOST_CHECK(!pcoinsTip->HaveCoin(witness_tx.vin[0].prevout));
+    BOOST_CHECK(pcoinsTip->HaveCoin(COutPoint(witness_tx.GetHash(), 0)));
+}
+
+BOOST_FIXTURE_TEST_CASE(block_script_flags_cache, TestChain100Setup)
+{
+    LOCK(cs_main);
+    const Consensus::Params& params = Params().GetConsensus();
+    CBlockIndex* tip = chainActive.Tip();
+    unsigned int flags = GetBlockScriptFlags(tip, params);
+    BOOST_CHECK(flags & SCRIPT_VERIFY_P2SH);
+    BOOST_CHECK_EQUAL(bool(flags & SCRIPT_VERIFY_DERSIG), tip->nHeight >= params.BIP66Height);
+    BOOST_CHECK_EQUAL(GetBlockScriptFlags(tip, params), flags);
+
+    // Other params get the flags of their own
+    Consensus::Params withDersig = params;
+    withDersig.BIP66Height = 0;
+    Consensus::Params withoutDersig = params;
+    withoutDersig.BIP66Height = std::numeric_limits<int>::max();
+    unsigned int flagsWith = GetBlockScriptFlags(tip, withDersig);
+    unsigned int flagsWithout = GetBlockScriptFlags(tip, withoutDersig);
+    BOOST_CHECK(flagsWith & SCRIPT_VERIFY_DERSIG);
+    BOOST_CHECK(!(flagsWithout & SCRIPT_VERIFY_DERSIG));
+    BOOST_CHECK_EQUAL(flagsWith & ~SCRIPT_VERIFY_DERSIG, flags & ~SCRIPT_VERIFY_DERSIG);
+    BOOST_CHECK_EQUAL(flagsWithout & ~SCRIPT_VERIFY_DERSIG, flags & ~SCRIPT_VERIFY_DERSIG);
+    BOOST_CHECK_EQUAL(GetBlockScriptFlags(tip, withDersig), flagsWith);
+    BOOST_CHECK_EQUAL(GetBlockScriptFlags(tip, params), flags);
+
+    // Other blocks too, and a candidate block without a hash is not kept
+    withoutDersig.BIP66Height = tip->nHeight;
+    BOOST_CHECK(GetBlockScriptFlags(tip, withoutDersig) & SCRIPT_VERIFY_DERSIG);
+    BOOST_CHECK(!(GetBlockScriptFlags(tip->pprev, withoutDersig) & SCRIPT_VERIFY_DERSIG));
+    BOOST_CHECK(GetBlockScriptFlags(tip, withoutDersig) & SCRIPT_VERIFY_DERSIG);
+    CBlockIndex candidate;
+    candidate.pprev = tip;
+    candidate.nHeight = tip->nHeight + 1;
+    withoutDersig.BIP66Height = candidate.nHeight;
+    BOOST_CHECK(GetBlockScriptFlags(&candidate, withoutDersig) & SCRIPT_VERIFY_DERSIG);
+    withoutDersig.BIP66Height = std::numeric_limits<int>::max();
+    BOOST_CHECK(!(GetBlockScriptFlags(&candidate, withoutDersig) & SCRIPT_VERIFY_DERSIG));
+
+    // Leave the flags of the tip with the chain params, not of the local params above
+    BOOST_CHECK_EQUAL(GetBlockScriptFlags(tip, params), flags);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
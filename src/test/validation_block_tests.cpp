@@ -14,6 +14,9 @@
 #include <validation.h>
 #include <validationinterface.h>
 
+#include <atomic>
+#include <future>
+
 struct RegtestingSetup : public TestingSetup {
     RegtestingSetup() : TestingSetup(CBaseChainParams::UNITTEST) {}
 };
@@ -184,4 +187,205 @@ BOOST_AUTO_TEST_CASE(processnewblock_signals_ordering)
     BOOST_CHECK_EQUAL(sub.m_expected_tip, chainActive.Tip()->GetBlockHash());
 }
 
+struct CountingSubscriber : public CValidationInterface {
+    std::atomic<int> m_calls{0};
+    //! If set, the first callback waits for it
+    std::shared_future<void> m_release;
+    std::promise<void> m_started;
+
+    void TransactionAddedToMempool(const CTransactionRef& ptx) override
+    {
+        if (m_calls++ == 0 && m_release.valid()) {
+            m_started.set_value();
+            m_release.wait();
+        }
+    }
+};
+
+BOOST_AUTO_TEST_CASE(subscriber_queues)
+{
+    // A second thread for the subscriber that isn't blocked
+    threadGroup.create_thread(std::bind(&CScheduler::serviceQueue, &scheduler));
+
+    std::promise<void> release;
+    CountingSubscriber blocked;
+    blocked.m_release = release.get_future().share();
+    CountingSubscriber sub;
+    RegisterValidationInterface(&blocked);
+    RegisterValidationInterface(&sub);
+
+    CTransactionRef tx = MakeTransactionRef(CMutableTransaction());
+    GetMainSignals().TransactionAddedToMempool(tx);
+    GetMainSignals().TransactionAddedToMempool(tx);
+    blocked.m_started.get_future().wait();
+
+    // The callbacks of the other subscriber run while the first one is blocked
+    for (int i = 0; i < 500 && sub.m_calls < 2; i++) {
+        MilliSleep(10);
+    }
+    BOOST_CHECK_EQUAL(sub.m_calls, 2);
+    BOOST_CHECK_EQUAL(blocked.m_calls, 1);
+    BOOST_CHECK_EQUAL(GetMainSignals().CallbacksPending(), 1U);
+
+    // Syncing waits for the callbacks of every subscriber
+    release.set_value();
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(blocked.m_calls, 2);
+    BOOST_CHECK_EQUAL(GetMainSignals().CallbacksPending(), 0U);
+
+    // Callbacks are no longer delivered once unregistered
+    UnregisterValidationInterface(&blocked);
+    GetMainSignals().TransactionAddedToMempool(tx);
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(blocked.m_calls, 2);
+    BOOST_CHECK_EQUAL(sub.m_calls, 3);
+
+    UnregisterValidationInterface(&sub);
+}
+
+BOOST_AUTO_TEST_CASE(subscriber_unregister_drains)
+{
+    std::promise<void> release;
+    CountingSubscriber blocked;
+    blocked.m_release = release.get_future().share();
+    RegisterValidationInterface(&blocked);
+
+    CTransactionRef tx = MakeTransactionRef(CMutableTransaction());
+    GetMainSignals().TransactionAddedToMempool(tx);
+    GetMainSignals().TransactionAddedToMempool(tx);
+    blocked.m_started.get_future().wait();
+
+    // Unregistering waits for the running callback
+    std::future<void> unregistered = std::async(std::launch::async, [&blocked] { UnregisterValidationInterface(&blocked); });
+    BOOST_CHECK(unregistered.wait_for(std::chrono::milliseconds(200)) == std::future_status::timeout);
+    release.set_value();
+    unregistered.wait();
+    BOOST_CHECK_EQUAL(blocked.m_calls, 1);
+
+    // A new subscriber may take the queue of the old one, without its remaining callbacks
+    CountingSubscriber sub;
+    RegisterValidationInterface(&sub);
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(blocked.m_calls, 1);
+    BOOST_CHECK_EQUAL(sub.m_calls, 0);
+    GetMainSignals().TransactionAddedToMempool(tx);
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(blocked.m_calls, 1);
+    BOOST_CHECK_EQUAL(sub.m_calls, 1);
+
+    UnregisterValidationInterface(&sub);
+}
+
+static CBlock BlockWithTransactions(size_t nTxs, const std::map<size_t, CMutableTransaction>& invalidTxs)
+{
+    CBlock block;
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].scriptSig = CScript() << OP_1 << OP_1;
+    coinbase.vout.emplace_back(COIN, CScript() << OP_TRUE);
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+    for (size_t i = 1; i < nTxs; i++) {
+        auto it = invalidTxs.find(i);
+        if (it != invalidTxs.end()) {
+            block.vtx.push_back(MakeTransactionRef(it->second));
+            continue;
+        }
+        CMutableTransaction tx;
+        tx.vin.emplace_back(COutPoint(InsecureRand256(), 0));
+        tx.vout.emplace_back(COIN, CScript() << OP_TRUE);
+        block.vtx.push_back(MakeTransactionRef(tx));
+    }
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    return block;
+}
+
+BOOST_AUTO_TEST_CASE(checkblock_parallel_tx_checks)
+{
+    CMutableTransaction negativeOutput;
+    negativeOutput.vin.emplace_back(COutPoint(InsecureRand256(), 0));
+    negativeOutput.vout.emplace_back(-1, CScript() << OP_TRUE);
+    CMutableTransaction noInputs;
+    noInputs.vout.emplace_back(COIN, CScript() << OP_TRUE);
+
+    const Consensus::Params& params = Params().GetConsensus();
+    int nScriptCheckThreadsOld = nScriptCheckThreads;
+    for (nScriptCheckThreads = 0; nScriptCheckThreads < 2; nScriptCheckThreads++) {
+        // Large blocks are checked on the precheck queue, which this thread works on alone
+        CValidationState state;
+        BOOST_CHECK(CheckBlock(BlockWithTransactions(200, {}), state, params, false, true, false));
+
+        // The first invalid transaction gives the reason, whichever check finished first
+        state = CValidationState();
+        BOOST_CHECK(!CheckBlock(BlockWithTransactions(200, {{150, negativeOutput}, {170, noInputs}}), state, params, false, true, false));
+        BOOST_CHECK_EQUAL(state.GetRejectReason(), "bad-txns-vout-negative");
+        state = CValidationState();
+        BOOST_CHECK(!CheckBlock(BlockWithTransactions(200, {{150, noInputs}, {170, negativeOutput}}), state, params, false, true, false));
+        BOOST_CHECK_EQUAL(state.GetRejectReason(), "bad-txns-vin-empty");
+
+        // A wrong merkle root is still reported before the transactions
+        CBlock block = BlockWithTransactions(200, {{150, negativeOutput}});
+        block.hashMerkleRoot = uint256();
+        state = CValidationState();
+        BOOST_CHECK(!CheckBlock(block, state, params, false, true, false));
+        BOOST_CHECK_EQUAL(state.GetRejectReason(), "bad-txnmrklroot");
+    }
+    nScriptCheckThreads = nScriptCheckThreadsOld;
+}
+
+/** Check a tip snapshot against the block index it was taken of */
+static void CheckChainTipSnapshot(const ChainTipSnapshot& snapshot, const CBlockIndex* pindex)
+{
+    BOOST_CHECK_EQUAL(snapshot.nHeight, pindex->nHeight);
+    BOOST_CHECK(snapshot.hashBlock == pindex->GetBlockHash());
+    BOOST_CHECK_EQUAL(snapshot.nTime, pindex->GetBlockTime());
+    BOOST_CHECK_EQUAL(snapshot.nMedianTimePast, pindex->GetMedianTimePast());
+    BOOST_CHECK_EQUAL(snapshot.nBits, pindex->nBits);
+    BOOST_CHECK_EQUAL(snapshot.nPoSBits, GetLastBlockIndex(pindex, true)->nBits);
+    BOOST_CHECK(snapshot.nChainWork == pindex->nChainWork);
+    BOOST_CHECK_EQUAL(snapshot.nMoneySupply, pindex->nMoneySupply);
+    BOOST_CHECK(snapshot.hashStateRoot == pindex->hashStateRoot);
+    BOOST_CHECK(snapshot.hashUTXORoot == pindex->hashUTXORoot);
+}
+
+BOOST_FIXTURE_TEST_CASE(chain_tip_snapshot, TestChain100Setup)
+{
+    const CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    const std::shared_ptr<const ChainTipSnapshot> first = GetChainTipSnapshot();
+    CBlockIndex* pindexFirst;
+    {
+        LOCK(cs_main);
+        pindexFirst = chainActive.Tip();
+        CheckChainTipSnapshot(*first, pindexFirst);
+        BOOST_CHECK_EQUAL(nBestHeaderHeight.load(), pindexBestHeader->nHeight);
+    }
+
+    // A new tip publishes a new snapshot and leaves the one already held alone
+    CreateAndProcessBlock({}, scriptPubKey);
+    const std::shared_ptr<const ChainTipSnapshot> second = GetChainTipSnapshot();
+    BOOST_CHECK(second != first);
+    BOOST_CHECK_EQUAL(second->nHeight, first->nHeight + 1);
+    CheckChainTipSnapshot(*first, pindexFirst);
+    CBlockIndex* pindexSecond;
+    {
+        LOCK(cs_main);
+        pindexSecond = chainActive.Tip();
+        CheckChainTipSnapshot(*second, pindexSecond);
+        BOOST_CHECK_EQUAL(nBestHeaderHeight.load(), second->nHeight);
+    }
+
+    // Disconnecting the tip publishes the snapshot of the block below it
+    CValidationState state;
+    BOOST_CHECK(InvalidateBlock(state, Params(), pindexSecond));
+    BOOST_CHECK(GetChainTipSnapshot()->hashBlock == first->hashBlock);
+    CheckChainTipSnapshot(*GetChainTipSnapshot(), pindexFirst);
+
+    {
+        LOCK(cs_main);
+        ResetBlockFailureFlags(pindexSecond);
+    }
+    BOOST_CHECK(ActivateBestChain(state, Params()));
+    BOOST_CHECK(GetChainTipSnapshot()->hashBlock == second->hashBlock);
+    CheckChainTipSnapshot(*GetChainTipSnapshot(), pindexSecond);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -14,7 +14,10 @@
 #include <util/system.h>
 #include <ui_interface.h>
 
+#include <algorithm>
+#include <functional>
 #include <stdint.h>
+#include <thread>
 
 #include <boost/thread.hpp>
 
@@ -26,6 +29,13 @@ static const char DB_BLOCK_INDEX = 'b';
 ////////////////////////////////////////// // kpg
 static const char DB_HEIGHTINDEX = 'h';
 static const char DB_STAKEINDEX = 's';
+static const char DB_STAKERINDEX = 'k';
+static const char DB_LOGBLOOM = 'L';
+static const char DB_LOGBLOOMRANGE = 'G';
+static const char DB_LOGBLOOMSTART = 'Q';
+static const char DB_TOPICINDEX = 'T';
+static const char DB_CONTRACTADDRINDEX = 'E';
+static const char DB_CONTRACTADDRHEIGHT = 'e';
 //////////////////////////////////////////
 
 static const char DB_BEST_BLOCK = 'B';
@@ -33,16 +43,7 @@ static const char DB_HEAD_BLOCKS = 'H';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
-
-#ifdef ENABLE_BITCORE_RPC
-////////////////////////////////////////// // kpg
-static const char DB_ADDRESSINDEX = 'a';
-static const char DB_ADDRESSUNSPENTINDEX = 'u';
-static const char DB_TIMESTAMPINDEX = 'S';
-static const char DB_BLOCKHASHINDEX = 'z';
-static const char DB_SPENTINDEX = 'p';
-//////////////////////////////////////////
-#endif
+static const char DB_BLOCK_INDEX_SNAPSHOT = 'Z';
 
 namespace {
 
@@ -96,6 +97,10 @@ std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
 }
 
 bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+    return WriteCoins(mapCoins, hashBlock, true, true);
+}
+
+bool CCoinsViewDB::WriteCoins(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fFirst, bool fLast) {
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
@@ -103,22 +108,24 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     int crash_simulate = gArgs.GetArg("-dbcrashratio", 0);
     assert(!hashBlock.IsNull());
 
-    uint256 old_tip = GetBestBlock();
-    if (old_tip.IsNull()) {
-        // We may be in the middle of replaying.
-        std::vector<uint256> old_heads = GetHeadBlocks();
-        if (old_heads.size() == 2) {
-            assert(old_heads[0] == hashBlock);
-            old_tip = old_heads[1];
+    if (fFirst) {
+        uint256 old_tip = GetBestBlock();
+        if (old_tip.IsNull()) {
+            // We may be in the middle of replaying.
+            std::vector<uint256> old_heads = GetHeadBlocks();
+            if (old_heads.size() == 2) {
+                assert(old_heads[0] == hashBlock);
+                old_tip = old_heads[1];
+            }
         }
-    }
 
-    // In the first batch, mark the database as being in the middle of a
-    // transition from old_tip to hashBlock.
-    // A vector is used for future extensibility, as we may want to support
-    // interrupting after partial writes from multiple independent reorgs.
-    batch.Erase(DB_BEST_BLOCK);
-    batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, old_tip});
+        // In the first batch, mark the database as being in the middle of a
+        // transition from old_tip to hashBlock.
+        // A vector is used for future extensibility, as we may want to support
+        // interrupting after partial writes from multiple independent reorgs.
+        batch.Erase(DB_BEST_BLOCK);
+        batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, old_tip});
+    }
 
     for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
@@ -146,6 +153,13 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
         }
     }
 
+    if (!fLast) {
+        LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
+        bool ret = db.WriteBatch(batch);
+        LogPrint(BCLog::COINDB, "Committed %u changed transaction outputs (out of %u) to coin database, more to come...\n", (unsigned int)changed, (unsigned int)count);
+        return ret;
+    }
+
     // In the last batch, mark the database as consistent with hashBlock again.
     batch.Erase(DB_HEAD_BLOCKS);
     batch.Write(DB_BEST_BLOCK, hashBlock);
@@ -156,12 +170,210 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     return ret;
 }
 
+CCoinsViewBackgroundFlush::CCoinsViewBackgroundFlush(CCoinsViewDB* db) :
+    CCoinsViewBacked(db), m_db(db), m_pending_usage(0), m_failed(false), m_stop(false)
+{
+    {
+        LOCK(m_mutex);
+        ResetPending();
+    }
+    m_thread = std::thread(&TraceThread<std::function<void()>>, "coinsflush", std::function<void()>(std::bind(&CCoinsViewBackgroundFlush::ThreadWrite, this)));
+}
+
+CCoinsViewBackgroundFlush::~CCoinsViewBackgroundFlush()
+{
+    {
+        LOCK(m_mutex);
+        m_stop = true;
+        m_cond.notify_all();
+    }
+    // The thread writes the flush in flight before it stops
+    m_thread.join();
+}
+
+void CCoinsViewBackgroundFlush::ResetPending()
+{
+    m_pending.reset();
+    m_pending_resource.reset(new CCoinsMapMemoryResource());
+    m_pending.reset(new CCoinsMap(0, SaltedOutpointHasher(), CCoinsMap::key_equal(), m_pending_resource.get()));
+    m_pending_usage = 0;
+}
+
+bool CCoinsViewBackgroundFlush::GetCoin(const COutPoint &outpoint, Coin &coin) const
+{
+    {
+        LOCK(m_mutex);
+        CCoinsMap::const_iterator it = m_pending->find(outpoint);
+        if (it != m_pending->end()) {
+            coin = it->second.coin;
+            return !coin.IsSpent();
+        }
+    }
+    // Not pending, or already written
+    return base->GetCoin(outpoint, coin);
+}
+
+bool CCoinsViewBackgroundFlush::HaveCoin(const COutPoint &outpoint) const
+{
+    {
+        LOCK(m_mutex);
+        CCoinsMap::const_iterator it = m_pending->find(outpoint);
+        if (it != m_pending->end())
+            return !it->second.coin.IsSpent();
+    }
+    return base->HaveCoin(outpoint);
+}
+
+uint256 CCoinsViewBackgroundFlush::GetBestBlock() const
+{
+    {
+        LOCK(m_mutex);
+        if (!m_pending_block.IsNull())
+            return m_pending_block;
+    }
+    return base->GetBestBlock();
+}
+
+bool CCoinsViewBackgroundFlush::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock)
+{
+    WAIT_LOCK(m_mutex, lock);
+    while (!m_failed && !m_pending_block.IsNull())
+        m_cond.wait(lock);
+    if (m_failed)
+        return false;
+
+    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+        if (it->second.flags & CCoinsCacheEntry::DIRTY) {
+            m_pending_usage += it->second.coin.DynamicMemoryUsage();
+            m_pending->emplace(it->first, std::move(it->second));
+        }
+        it = mapCoins.erase(it);
+    }
+    m_pending_block = hashBlock;
+    m_cond.notify_all();
+    return true;
+}
+
+CCoinsViewCursor *CCoinsViewBackgroundFlush::Cursor() const
+{
+    // The cursor iterates over the database, which has to be written first
+    const_cast<CCoinsViewBackgroundFlush*>(this)->Wait();
+    return base->Cursor();
+}
+
+bool CCoinsViewBackgroundFlush::Wait()
+{
+    WAIT_LOCK(m_mutex, lock);
+    while (!m_failed && !m_pending_block.IsNull())
+        m_cond.wait(lock);
+    return !m_failed;
+}
+
+void CCoinsViewBackgroundFlush::WhenWritten(std::function<void()> f)
+{
+    {
+        LOCK(m_mutex);
+        if (m_failed)
+            return;
+        if (!m_pending_block.IsNull()) {
+            m_written = std::move(f);
+            return;
+        }
+    }
+    f();
+}
+
+size_t CCoinsViewBackgroundFlush::PendingMemoryUsage() const
+{
+    LOCK(m_mutex);
+    return memusage::DynamicUsage(*m_pending) + m_pending_usage;
+}
+
+void CCoinsViewBackgroundFlush::ThreadWrite()
+{
+    while (true) {
+        uint256 hashBlock;
+        size_t nCoins;
+        {
+            WAIT_LOCK(m_mutex, lock);
+            while (!m_stop && m_pending_block.IsNull())
+                m_cond.wait(lock);
+            if (m_pending_block.IsNull())
+                return;
+            hashBlock = m_pending_block;
+            nCoins = m_pending->size();
+        }
+
+        // Write the pending coins a batch at a time. They stay readable from m_pending
+        // until their batch is in the database; nothing else changes m_pending meanwhile,
+        // as BatchWrite waits for this flush to complete.
+        const int64_t nStart = GetTimeMicros();
+        bool fFirst = true;
+        bool fLast = false;
+        bool fOk = true;
+        while (fOk && !fLast) {
+            CCoinsMapMemoryResource resource;
+            CCoinsMap batch(0, SaltedOutpointHasher(), CCoinsMap::key_equal(), &resource);
+            CCoinsMap::iterator it;
+            {
+                LOCK(m_mutex);
+                it = m_pending->begin();
+                for (size_t n = 0; it != m_pending->end() && n < BACKGROUND_FLUSH_BATCH_COINS; ++it, ++n)
+                    batch.emplace(it->first, it->second);
+                fLast = it == m_pending->end();
+            }
+            try {
+                fOk = m_db->WriteCoins(batch, hashBlock, fFirst, fLast);
+            } catch (const std::exception& e) {
+                LogPrintf("%s: %s\n", __func__, e.what());
+                fOk = false;
+            }
+            fFirst = false;
+            if (!fOk)
+                break;
+            LOCK(m_mutex);
+            for (CCoinsMap::iterator itDone = m_pending->begin(); itDone != it;) {
+                m_pending_usage -= itDone->second.coin.DynamicMemoryUsage();
+                itDone = m_pending->erase(itDone);
+            }
+        }
+
+        if (!fOk) {
+            // pcoinsTip dropped these coins as written. The ones not written stay readable
+            // from m_pending and nothing is flushed anymore, so the database is never read
+            // in their place while the node shuts down.
+            {
+                LOCK(m_mutex);
+                m_failed = true;
+                m_written = nullptr;
+                m_cond.notify_all();
+            }
+            AbortNode(strprintf("Failed to write the coins up to block %s to the coin database", hashBlock.ToString()));
+            return;
+        }
+
+        LogPrint(BCLog::COINDB, "Wrote %u coins up to block %s in the background in %.2fms\n", (unsigned int)nCoins, hashBlock.ToString(), (GetTimeMicros() - nStart) * 0.001);
+        LOCK(m_mutex);
+        // Before Wait returns, so that whoever waits for the flush sees it done
+        if (m_written) {
+            m_written();
+            m_written = nullptr;
+        }
+        ResetPending();
+        m_pending_block.SetNull();
+        m_cond.notify_all();
+    }
+}
+
 size_t CCoinsViewDB::EstimateSize() const
 {
     return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(gArgs.IsArgSet("-blocksdir") ? GetDataDir() / "blocks" / "index" : GetBlocksDir() / "index", nCacheSize, fMemory, fWipe) {
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(gArgs.IsArgSet("-blocksdir") ? GetDataDir() / "blocks" / "index" : GetBlocksDir() / "index", nCacheSize, fMemory, fWipe),
+    m_snapshot_path(fMemory ? fs::path() : (gArgs.IsArgSet("-blocksdir") ? GetDataDir() / "blocks" : GetBlocksDir()) / "index-snapshot.dat") {
+    if (fWipe && !m_snapshot_path.empty())
+        fs::remove(m_snapshot_path);
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
@@ -191,16 +403,37 @@ CCoinsViewCursor *CCoinsViewDB::Cursor() const
        that restriction.  */
     i->pcursor->Seek(DB_COIN);
     // Cache key of first record
-    if (i->pcursor->Valid()) {
-        CoinEntry entry(&i->keyTmp.second);
-        i->pcursor->GetKey(entry);
-        i->keyTmp.first = entry.key;
-    } else {
-        i->keyTmp.first = 0; // Make sure Valid() and GetKey() return false
-    }
+    i->CacheKey();
     return i;
 }
 
+std::vector<std::unique_ptr<CCoinsViewCursor>> CCoinsViewDB::Cursors(int n) const
+{
+    assert(n >= 1 && n <= 256);
+    CDBWrapper& dbw = const_cast<CDBWrapper&>(db);
+    std::shared_ptr<const leveldb::Snapshot> snapshot = dbw.GetSnapshot();
+
+    // The best block of the snapshot, which is erased while a flush is written
+    uint256 hashBlock;
+    {
+        std::unique_ptr<CDBIterator> pcursor(dbw.NewIterator(snapshot.get()));
+        pcursor->Seek(DB_BEST_BLOCK);
+        char key;
+        if (!pcursor->Valid() || !pcursor->GetKey(key) || key != DB_BEST_BLOCK || !pcursor->GetValue(hashBlock))
+            return {};
+    }
+
+    std::vector<std::unique_ptr<CCoinsViewCursor>> cursors;
+    for (int r = 0; r < n; r++) {
+        const int nBegin = r * 256 / n;
+        std::unique_ptr<CCoinsViewDBCursor> i(new CCoinsViewDBCursor(snapshot, dbw.NewIterator(snapshot.get()), hashBlock, (r + 1) * 256 / n));
+        i->pcursor->Seek(std::make_pair(DB_COIN, (unsigned char)nBegin));
+        i->CacheKey();
+        cursors.push_back(std::move(i));
+    }
+    return cursors;
+}
+
 bool CCoinsViewDBCursor::GetKey(COutPoint &key) const
 {
     // Return cached key
@@ -229,8 +462,13 @@ bool CCoinsViewDBCursor::Valid() const
 void CCoinsViewDBCursor::Next()
 {
     pcursor->Next();
+    CacheKey();
+}
+
+void CCoinsViewDBCursor::CacheKey()
+{
     CoinEntry entry(&keyTmp.second);
-    if (!pcursor->Valid() || !pcursor->GetKey(entry)) {
+    if (!pcursor->Valid() || !pcursor->GetKey(entry) || (entry.key == DB_COIN && *keyTmp.second.hash.begin() >= nEnd)) {
         keyTmp.first = 0; // Invalidate cached key after last record so that Valid() and GetKey() return false
     } else {
         keyTmp.first = entry.key;
@@ -246,7 +484,27 @@ bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockF
     for (std::vector<const CBlockIndex*>::const_iterator it=blockinfo.begin(); it != blockinfo.end(); it++) {
         batch.Write(std::make_pair(DB_BLOCK_INDEX, (*it)->GetBlockHash()), CDiskBlockIndex(*it));
     }
-    return WriteBatch(batch, true);
+
+    LOCK(m_index_batch_mutex);
+    for (const auto& entry : m_index_batch.GetStakeEntries()) {
+        // Drop the staker entry of the block the database has at this height
+        uint160 oldAddress;
+        if (Read(std::make_pair(DB_STAKEINDEX, entry.first), oldAddress) && !oldAddress.IsNull()) {
+            batch.Erase(std::make_pair(DB_STAKERINDEX, CStakerIndexKey(oldAddress, entry.first)));
+        }
+        if (entry.second.first) {
+            batch.Write(std::make_pair(DB_STAKEINDEX, entry.first), entry.second.second);
+            if (!entry.second.second.IsNull()) {
+                batch.Write(std::make_pair(DB_STAKERINDEX, CStakerIndexKey(entry.second.second, entry.first)), '\0');
+            }
+        } else {
+            batch.Erase(std::make_pair(DB_STAKEINDEX, entry.first));
+        }
+    }
+    if (!WriteBatch(batch, true))
+        return false;
+    m_index_batch.Clear();
+    return true;
 }
 
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
@@ -268,21 +526,42 @@ bool CBlockTreeDB::WriteHeightIndex(const CHeightTxIndexKey &heightIndex, const
     return WriteBatch(batch);
 }
 
+bool CLogBloomFilter::Match(const dev::eth::LogBloom& bloom) const {
+    if (!addresses.empty() && std::none_of(addresses.begin(), addresses.end(),
+            [&bloom](const dev::h160& address) { return bloom.containsBloom<3>(dev::sha3(address.ref())); })) {
+        return false;
+    }
+    if (topics.empty()) {
+        return true;
+    }
+    auto contains = [&bloom](const dev::h256& topic) { return bloom.containsBloom<3>(dev::sha3(topic.ref())); };
+    if (fMatchAllTopics) {
+        return std::all_of(topics.begin(), topics.end(), contains);
+    }
+    return std::any_of(topics.begin(), topics.end(), contains);
+}
+
 int CBlockTreeDB::ReadHeightIndex(int low, int high, int minconf,
         std::vector<std::vector<uint256>> &blocksOfHashes,
-        std::set<dev::h160> const &addresses) {
+        std::set<dev::h160> const &addresses,
+        const CLogBloomFilter* filter) {
 
     if ((high < low && high > -1) || (high == 0 && low == 0) || (high < -1 || low < 0)) {
        return -1;
     }
 
+    unsigned int bloomStart = 0;
+    bool fBloom = filter && ReadLogBloomStart(bloomStart);
+    int checkedHeight = -1;
+    int checkedRange = -1;
+
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
     pcursor->Seek(std::make_pair(DB_HEIGHTINDEX, CHeightTxIndexIteratorKey(low)));
 
     int curheight = 0;
 
-    for (size_t count = 0; pcursor->Valid(); pcursor->Next()) {
+    for (size_t count = 0; pcursor->Valid(); ) {
 
         std::pair<char, CHeightTxIndexKey> key;
         if (!pcursor->GetKey(key) || key.first != DB_HEIGHTINDEX) {
@@ -302,10 +581,37 @@ int CBlockTreeDB::ReadHeightIndex(int low, int high, int minconf,
             }
         }
 
+        if (fBloom && key.second.height >= bloomStart && nextHeight != checkedHeight) {
+            // Skip the whole range when its bloom rules it out and its last block is iterated anyway
+            int range = nextHeight / LOG_BLOOM_RANGE;
+            if (range != checkedRange && (unsigned int)range * LOG_BLOOM_RANGE >= bloomStart) {
+                checkedRange = range;
+                CLogBloomIndexValue rangeBloom;
+                if (Read(std::make_pair(DB_LOGBLOOMRANGE, CHeightTxIndexIteratorKey(range)), rangeBloom) &&
+                        (high == -1 || (int)rangeBloom.height <= high) &&
+                        (minconf <= 0 || chainActive.Height() - (int)rangeBloom.height >= minconf) &&
+                        !filter->Match(rangeBloom.bloom)) {
+                    curheight = std::max(curheight, (int)rangeBloom.height);
+                    pcursor->Seek(std::make_pair(DB_HEIGHTINDEX, CHeightTxIndexIteratorKey((range + 1) * LOG_BLOOM_RANGE)));
+                    continue;
+                }
+            }
+
+            checkedHeight = nextHeight;
+            CLogBloomIndexValue blockBloom;
+            if (Read(std::make_pair(DB_LOGBLOOM, CHeightTxIndexIteratorKey(nextHeight)), blockBloom) &&
+                    !filter->Match(blockBloom.bloom)) {
+                curheight = nextHeight;
+                pcursor->Seek(std::make_pair(DB_HEIGHTINDEX, CHeightTxIndexIteratorKey(nextHeight + 1)));
+                continue;
+            }
+        }
+
         curheight = nextHeight;
 
         auto address = key.second.address;
         if (!addresses.empty() && addresses.find(address) == addresses.end()) {
+            pcursor->Next();
             continue;
         }
 
@@ -318,6 +624,7 @@ int CBlockTreeDB::ReadHeightIndex(int low, int high, int minconf,
         count += hashesTx.size();
 
         blocksOfHashes.push_back(hashesTx);
+        pcursor->Next();
     }
 
     return curheight;
@@ -362,67 +669,111 @@ bool CBlockTreeDB::WipeHeightIndex() {
         }
     }
 
+    for (char prefix : {DB_LOGBLOOM, DB_LOGBLOOMRANGE}) {
+        pcursor->Seek(prefix);
+        while (pcursor->Valid()) {
+            boost::this_thread::interruption_point();
+            std::pair<char, CHeightTxIndexIteratorKey> key;
+            if (pcursor->GetKey(key) && key.first == prefix) {
+                batch.Erase(key);
+                pcursor->Next();
+            } else {
+                break;
+            }
+        }
+    }
+    batch.Erase(DB_LOGBLOOMSTART);
+
     return WriteBatch(batch);
 }
 
 
-bool CBlockTreeDB::WriteStakeIndex(unsigned int height, uint160 address) {
+bool CBlockTreeDB::WriteTopicIndex(const std::vector<std::pair<CTopicIndexKey, uint256>>& entries) {
     CDBBatch batch(*this);
-    batch.Write(std::make_pair(DB_STAKEINDEX, height), address);
+    for (const auto& e : entries)
+        batch.Write(std::make_pair(DB_TOPICINDEX, e.first), e.second);
     return WriteBatch(batch);
 }
 
-bool CBlockTreeDB::ReadStakeIndex(unsigned int height, uint160& address){
+int CBlockTreeDB::ReadTopicIndex(int low, int high, int minconf, const dev::h256& topic,
+        std::vector<uint256>& hashes) {
+
+    if ((high < low && high > -1) || (high == 0 && low == 0) || (high < -1 || low < 0)) {
+       return -1;
+    }
+
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
-    pcursor->Seek(std::make_pair(DB_STAKEINDEX, height));
+    pcursor->Seek(std::make_pair(DB_TOPICINDEX, CTopicIndexIteratorKey(topic, low)));
 
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char, CHeightTxIndexKey> key;
-        pcursor->GetKey(key); //note: it's apparently ok if this returns an error https://github.com/bitcoin/bitcoin/issues/7890
-        if (key.first == DB_STAKEINDEX) {
-            pcursor->GetValue(address);
-            return true;
-        }else{
-            return false;
+    int curheight = 0;
+
+    for (; pcursor->Valid(); pcursor->Next()) {
+
+        std::pair<char, CTopicIndexKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_TOPICINDEX || key.second.topic != topic) {
+            break;
         }
+
+        int nextHeight = key.second.height;
+
+        if (high > -1 && nextHeight > high) {
+            break;
+        }
+
+        if (minconf > 0) {
+            int conf = chainActive.Height() - nextHeight;
+            if (conf < minconf) {
+                break;
+            }
+        }
+
+        curheight = nextHeight;
+
+        uint256 hashTx;
+        if (!pcursor->GetValue(hashTx)) {
+            break;
+        }
+        hashes.push_back(hashTx);
     }
-    return false;
+
+    return curheight;
 }
-bool CBlockTreeDB::ReadStakeIndex(unsigned int high, unsigned int low, std::vector<uint160> addresses){
+
+bool CBlockTreeDB::EraseTopicIndex(unsigned int height, const std::set<dev::h256>& topics) {
+
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    CDBBatch batch(*this);
 
-    pcursor->Seek(std::make_pair(DB_STAKEINDEX, low));
+    for (const dev::h256& topic : topics) {
+        pcursor->Seek(std::make_pair(DB_TOPICINDEX, CTopicIndexIteratorKey(topic, height)));
 
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char, CHeightTxIndexKey> key;
-        pcursor->GetKey(key); //note: it's apparently ok if this returns an error https://github.com/bitcoin/bitcoin/issues/7890
-        if (key.first == DB_STAKEINDEX && key.second.height < high) {
-            uint160 value;
-            pcursor->GetValue(value);
-            addresses.push_back(value);
-            pcursor->Next();
-        } else {
-            break;
+        while (pcursor->Valid()) {
+            boost::this_thread::interruption_point();
+            std::pair<char, CTopicIndexKey> key;
+            if (pcursor->GetKey(key) && key.first == DB_TOPICINDEX && key.second.topic == topic && key.second.height == height) {
+                batch.Erase(key);
+                pcursor->Next();
+            } else {
+                break;
+            }
         }
     }
 
-    return true;
+    return WriteBatch(batch);
 }
 
-bool CBlockTreeDB::EraseStakeIndex(unsigned int height) {
+bool CBlockTreeDB::WipeTopicIndex() {
 
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
     CDBBatch batch(*this);
 
-    pcursor->Seek(std::make_pair(DB_STAKEINDEX, height));
+    pcursor->Seek(DB_TOPICINDEX);
 
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
-        std::pair<char, CHeightTxIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_HEIGHTINDEX && key.second.height == height) {
+        std::pair<char, CTopicIndexKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_TOPICINDEX) {
             batch.Erase(key);
             pcursor->Next();
         } else {
@@ -433,221 +784,446 @@ bool CBlockTreeDB::EraseStakeIndex(unsigned int height) {
     return WriteBatch(batch);
 }
 
-#ifdef ENABLE_BITCORE_RPC
-bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
+bool CBlockTreeDB::WriteContractAddressIndex(unsigned int height, const std::vector<std::pair<CContractAddressIndexKey, CContractAddressIndexValue>>& entries) {
     CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Write(std::make_pair(DB_ADDRESSINDEX, it->first), it->second);
-    return WriteBatch(batch);
-}
-
-bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Erase(std::make_pair(DB_ADDRESSINDEX, it->first));
+    // The addresses of the height, to find the entries again when the block is disconnected
+    std::set<dev::h160> addresses;
+    for (const auto& e : entries) {
+        batch.Write(std::make_pair(DB_CONTRACTADDRINDEX, e.first), e.second);
+        addresses.insert(e.first.address);
+    }
+    std::vector<valtype> vAddresses;
+    for (const dev::h160& address : addresses)
+        vAddresses.push_back(address.asBytes());
+    batch.Write(std::make_pair(DB_CONTRACTADDRHEIGHT, CHeightTxIndexIteratorKey(height)), vAddresses);
     return WriteBatch(batch);
 }
 
-bool CBlockTreeDB::ReadAddressIndex(uint256 addressHash, int type,
-                                    std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                                    int start, int end) {
+bool CBlockTreeDB::ReadContractAddressIndex(const dev::h160& address, int low, int high,
+        std::vector<std::pair<CContractAddressIndexKey, CContractAddressIndexValue>>& entries) {
 
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
-    if (start > 0 && end > 0) {
-        pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
-    } else {
-        pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
-    }
+    pcursor->Seek(std::make_pair(DB_CONTRACTADDRINDEX, CContractAddressIndexIteratorKey(address, std::max(low, 0))));
 
-    while (pcursor->Valid()) {
+    for (; pcursor->Valid(); pcursor->Next()) {
         boost::this_thread::interruption_point();
-        std::pair<char,CAddressIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX && key.second.hashBytes == addressHash) {
-            if (end > 0 && key.second.blockHeight > end) {
-                break;
-            }
-            CAmount nValue;
-            if (pcursor->GetValue(nValue)) {
-                addressIndex.push_back(std::make_pair(key.second, nValue));
-                pcursor->Next();
-            } else {
-                return error("failed to get address index value");
-            }
-        } else {
+        std::pair<char, CContractAddressIndexKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_CONTRACTADDRINDEX || key.second.address != address) {
+            break;
+        }
+        if (high > -1 && (int)key.second.height > high) {
             break;
         }
+        CContractAddressIndexValue value;
+        if (!pcursor->GetValue(value)) {
+            return error("failed to get contract address index value");
+        }
+        entries.emplace_back(key.second, value);
     }
 
     return true;
 }
 
-bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect) {
+bool CBlockTreeDB::EraseContractAddressIndex(unsigned int height) {
+
+    const auto heightKey = std::make_pair(DB_CONTRACTADDRHEIGHT, CHeightTxIndexIteratorKey(height));
+    std::vector<valtype> vAddresses;
+    if (!Read(heightKey, vAddresses))
+        return true;
+
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
     CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
-        if (it->second.IsNull()) {
-            batch.Erase(std::make_pair(DB_ADDRESSUNSPENTINDEX, it->first));
-        } else {
-            batch.Write(std::make_pair(DB_ADDRESSUNSPENTINDEX, it->first), it->second);
+
+    for (const valtype& vAddress : vAddresses) {
+        const dev::h160 address(vAddress);
+        pcursor->Seek(std::make_pair(DB_CONTRACTADDRINDEX, CContractAddressIndexIteratorKey(address, height)));
+
+        while (pcursor->Valid()) {
+            boost::this_thread::interruption_point();
+            std::pair<char, CContractAddressIndexKey> key;
+            if (pcursor->GetKey(key) && key.first == DB_CONTRACTADDRINDEX && key.second.address == address && key.second.height == height) {
+                batch.Erase(key);
+                pcursor->Next();
+            } else {
+                break;
+            }
         }
     }
+    batch.Erase(heightKey);
+
     return WriteBatch(batch);
 }
 
-bool CBlockTreeDB::ReadAddressUnspentIndex(uint256 addressHash, int type,
-                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) {
+bool CBlockTreeDB::WipeContractAddressIndex() {
 
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
-    pcursor->Seek(std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    CDBBatch batch(*this);
+
+    pcursor->Seek(DB_CONTRACTADDRINDEX);
 
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
-        std::pair<char,CAddressUnspentKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
-            CAddressUnspentValue nValue;
-            if (pcursor->GetValue(nValue)) {
-                unspentOutputs.push_back(std::make_pair(key.second, nValue));
-                pcursor->Next();
-            } else {
-                return error("failed to get address unspent value");
-            }
+        std::pair<char, CContractAddressIndexKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_CONTRACTADDRINDEX) {
+            batch.Erase(key);
+            pcursor->Next();
         } else {
             break;
         }
     }
 
-    return true;
+    pcursor->Seek(DB_CONTRACTADDRHEIGHT);
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, CHeightTxIndexIteratorKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_CONTRACTADDRHEIGHT) {
+            batch.Erase(key);
+            pcursor->Next();
+        } else {
+            break;
+        }
+    }
+
+    return WriteBatch(batch);
 }
 
-bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex) {
+bool CBlockTreeDB::WriteLogBloom(unsigned int height, const dev::eth::LogBloom& bloom) {
     CDBBatch batch(*this);
-    batch.Write(std::make_pair(DB_TIMESTAMPINDEX, timestampIndex), 0);
+    CLogBloomIndexValue blockBloom;
+    blockBloom.bloom = bloom;
+    blockBloom.height = height;
+    batch.Write(std::make_pair(DB_LOGBLOOM, CHeightTxIndexIteratorKey(height)), blockBloom);
+
+    unsigned int range = height / LOG_BLOOM_RANGE;
+    CLogBloomIndexValue rangeBloom;
+    Read(std::make_pair(DB_LOGBLOOMRANGE, CHeightTxIndexIteratorKey(range)), rangeBloom);
+    rangeBloom.bloom |= bloom;
+    rangeBloom.height = std::max(rangeBloom.height, height);
+    batch.Write(std::make_pair(DB_LOGBLOOMRANGE, CHeightTxIndexIteratorKey(range)), rangeBloom);
     return WriteBatch(batch);
 }
 
-bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned int &low, const bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &hashes) {
+bool CBlockTreeDB::EraseLogBloom(unsigned int height) {
+    CDBBatch batch(*this);
+    batch.Erase(std::make_pair(DB_LOGBLOOM, CHeightTxIndexIteratorKey(height)));
 
+    // Blooms cannot be subtracted, so combine the blooms of the remaining blocks of the range again
+    unsigned int range = height / LOG_BLOOM_RANGE;
+    CLogBloomIndexValue rangeBloom;
+    bool fEmpty = true;
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
-
-    pcursor->Seek(std::make_pair(DB_TIMESTAMPINDEX, CTimestampIndexIteratorKey(low)));
-
+    pcursor->Seek(std::make_pair(DB_LOGBLOOM, CHeightTxIndexIteratorKey(range * LOG_BLOOM_RANGE)));
     while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char, CTimestampIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_TIMESTAMPINDEX && key.second.timestamp < high) {
-            if (fActiveOnly) {
-                if (blockOnchainActive(key.second.blockHash)) {
-                    hashes.push_back(std::make_pair(key.second.blockHash, key.second.timestamp));
-                }
-            } else {
-                hashes.push_back(std::make_pair(key.second.blockHash, key.second.timestamp));
-            }
-
-            pcursor->Next();
-        } else {
+        std::pair<char, CHeightTxIndexIteratorKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_LOGBLOOM || key.second.height >= (range + 1) * LOG_BLOOM_RANGE) {
             break;
         }
+        CLogBloomIndexValue blockBloom;
+        if (key.second.height != height && pcursor->GetValue(blockBloom)) {
+            rangeBloom.bloom |= blockBloom.bloom;
+            rangeBloom.height = std::max(rangeBloom.height, blockBloom.height);
+            fEmpty = false;
+        }
+        pcursor->Next();
     }
+    if (fEmpty) {
+        batch.Erase(std::make_pair(DB_LOGBLOOMRANGE, CHeightTxIndexIteratorKey(range)));
+    } else {
+        batch.Write(std::make_pair(DB_LOGBLOOMRANGE, CHeightTxIndexIteratorKey(range)), rangeBloom);
+    }
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::WriteLogBloomStart(unsigned int height) {
+    return Write(DB_LOGBLOOMSTART, height);
+}
 
+bool CBlockTreeDB::ReadLogBloomStart(unsigned int& height) {
+    return Read(DB_LOGBLOOMSTART, height);
+}
+
+bool CBlockTreeDB::WriteStakeIndex(unsigned int height, const uint160& address) {
+    // WriteBatchSync also drops the staker entry of a block at this height that was
+    // disconnected without being erased
+    LOCK(m_index_batch_mutex);
+    m_index_batch.WriteStakeIndex(height, address);
     return true;
 }
 
-bool CBlockTreeDB::WriteTimestampBlockIndex(const CTimestampBlockIndexKey &blockhashIndex, const CTimestampBlockIndexValue &logicalts) {
-    CDBBatch batch(*this);
-    batch.Write(std::make_pair(DB_BLOCKHASHINDEX, blockhashIndex), logicalts);
-    return WriteBatch(batch);
+bool CBlockTreeDB::ReadStakeIndex(unsigned int height, uint160& address){
+    {
+        LOCK(m_index_batch_mutex);
+        const CBlockTreeIndexBatch::StakeEntries& entries = m_index_batch.GetStakeEntries();
+        auto it = entries.find(height);
+        if (it != entries.end()) {
+            address = it->second.second;
+            return it->second.first;
+        }
+    }
+    return Read(std::make_pair(DB_STAKEINDEX, height), address);
 }
 
-bool CBlockTreeDB::ReadTimestampBlockIndex(const uint256 &hash, unsigned int &ltimestamp) {
+bool CBlockTreeDB::ReadStakerIndex(const uint160& staker, int low, int high, std::vector<unsigned int>& heights){
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(std::make_pair(DB_STAKERINDEX, CStakerIndexKey(staker, low)));
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, CStakerIndexKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_STAKERINDEX && key.second.staker == staker &&
+                (high < 0 || key.second.height <= (unsigned int)high)) {
+            heights.push_back(key.second.height);
+            pcursor->Next();
+        } else {
+            break;
+        }
+    }
 
-    CTimestampBlockIndexValue(lts);
-    if (!Read(std::make_pair(DB_BLOCKHASHINDEX, hash), lts))
-       return false;
+    // The staged entries replace the ones of the database at their heights
+    LOCK(m_index_batch_mutex);
+    const CBlockTreeIndexBatch::StakeEntries& entries = m_index_batch.GetStakeEntries();
+    if (!entries.empty()) {
+        heights.erase(std::remove_if(heights.begin(), heights.end(), [&entries](unsigned int height) { return entries.count(height) != 0; }), heights.end());
+        for (auto it = entries.lower_bound((unsigned int)std::max(low, 0)); it != entries.end() && (high < 0 || it->first <= (unsigned int)high); ++it) {
+            if (it->second.first && it->second.second == staker)
+                heights.push_back(it->first);
+        }
+        std::sort(heights.begin(), heights.end());
+    }
 
-    ltimestamp = lts.ltimestamp;
     return true;
 }
 
-bool CBlockTreeDB::ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value) {
-    return Read(std::make_pair(DB_SPENTINDEX, key), value);
+bool CBlockTreeDB::EraseStakeIndex(unsigned int height) {
+    LOCK(m_index_batch_mutex);
+    m_index_batch.EraseStakeIndex(height);
+    return true;
 }
 
-bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect) {
+bool CBlockTreeDB::UpgradeStakerIndex(int nTipHeight) {
+    bool fStakerIndex = false;
+    if (ReadFlag("stakerindex", fStakerIndex) && fStakerIndex) {
+        return true;
+    }
+
+    LogPrintf("Building the staker index from the stake index...\n");
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
     CDBBatch batch(*this);
-    for (std::vector<std::pair<CSpentIndexKey,CSpentIndexValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
-        if (it->second.IsNull()) {
-            batch.Erase(std::make_pair(DB_SPENTINDEX, it->first));
-        } else {
-            batch.Write(std::make_pair(DB_SPENTINDEX, it->first), it->second);
+
+    // The stake index keys are not ordered by height, so all of them are read; the entries
+    // above the tip are of blocks disconnected without being erased
+    pcursor->Seek(DB_STAKEINDEX);
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, unsigned int> key;
+        if (!pcursor->GetKey(key) || key.first != DB_STAKEINDEX) {
+            break;
+        }
+        uint160 address;
+        if (pcursor->GetValue(address) && !address.IsNull() && (int)key.second <= nTipHeight) {
+            batch.Write(std::make_pair(DB_STAKERINDEX, CStakerIndexKey(address, key.second)), '\0');
+            if (batch.SizeEstimate() > 1 << 24) {
+                if (!WriteBatch(batch)) return false;
+                batch.Clear();
+            }
         }
+        pcursor->Next();
     }
-    return WriteBatch(batch);
+
+    batch.Write(std::make_pair(DB_FLAG, std::string("stakerindex")), '1');
+    return WriteBatch(batch, true);
 }
 
-bool CBlockTreeDB::blockOnchainActive(const uint256 &hash) {
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
+///////////////////////////////////////////////////////
 
-    if (!chainActive.Contains(pblockindex)) {
-       return false;
-    }
+/** Version of the block index snapshot file */
+static const uint32_t BLOCK_INDEX_SNAPSHOT_VERSION = 1;
+/** Number of block index entries read from the database and deserialized in parallel at a time */
+static const size_t BLOCK_INDEX_LOAD_BATCH = 16384;
 
+/** Construct the block index object of an entry */
+static bool InsertDiskBlockIndex(const uint256& hash, const CDiskBlockIndex& diskindex, std::function<CBlockIndex*(const uint256&)>& insertBlockIndex)
+{
+    CBlockIndex* pindexNew = insertBlockIndex(hash);
+    pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
+    pindexNew->nHeight        = diskindex.nHeight;
+    pindexNew->nFile          = diskindex.nFile;
+    pindexNew->nDataPos       = diskindex.nDataPos;
+    pindexNew->nUndoPos       = diskindex.nUndoPos;
+    pindexNew->nVersion       = diskindex.nVersion;
+    pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+    pindexNew->nTime          = diskindex.nTime;
+    pindexNew->nBits          = diskindex.nBits;
+    pindexNew->nNonce         = diskindex.nNonce;
+    pindexNew->nMoneySupply   = diskindex.nMoneySupply;
+    pindexNew->nStatus        = diskindex.nStatus;
+    pindexNew->nTx            = diskindex.nTx;
+    pindexNew->hashStateRoot  = diskindex.hashStateRoot; // kpg
+    pindexNew->hashUTXORoot   = diskindex.hashUTXORoot; // kpg
+    pindexNew->nStakeModifier = diskindex.nStakeModifier;
+    pindexNew->prevoutStake   = diskindex.prevoutStake;
+    pindexNew->vchBlockSig    = diskindex.vchBlockSig; // kpg
+
+    if (!CheckIndexProof(*pindexNew, Params().GetConsensus()))
+        return error("%s: CheckIndexProof failed: %s", __func__, pindexNew->ToString());
+
+    // NovaCoin: build setStakeSeen
+    if (pindexNew->IsProofOfStake())
+        setStakeSeen.insert(std::make_pair(pindexNew->prevoutStake, pindexNew->nTime));
     return true;
 }
-#endif
-///////////////////////////////////////////////////////
 
 bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
 {
+    if (LoadBlockIndexSnapshot(consensusParams, insertBlockIndex))
+        return true;
+
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
     pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, uint256()));
 
-    // Load mapBlockIndex
-    while (pcursor->Valid()) {
+    // Load mapBlockIndex. The cursor is read in batches, whose entries are deserialized and
+    // hashed in parallel and then inserted in order.
+    struct Entry {
+        CDataStream value{SER_DISK, CLIENT_VERSION};
+        CDiskBlockIndex diskindex;
+        uint256 hash;
+        bool fValid = false;
+    };
+    std::vector<Entry> entries;
+    bool fEnd = false;
+    while (!fEnd) {
         boost::this_thread::interruption_point();
-        std::pair<char, uint256> key;
-        if (pcursor->GetKey(key) && key.first == DB_BLOCK_INDEX) {
-            CDiskBlockIndex diskindex;
-            if (pcursor->GetValue(diskindex)) {
-                // Construct block index object
-                CBlockIndex* pindexNew = insertBlockIndex(diskindex.GetBlockHash());
-                pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
-                pindexNew->nHeight        = diskindex.nHeight;
-                pindexNew->nFile          = diskindex.nFile;
-                pindexNew->nDataPos       = diskindex.nDataPos;
-                pindexNew->nUndoPos       = diskindex.nUndoPos;
-                pindexNew->nVersion       = diskindex.nVersion;
-                pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
-                pindexNew->nTime          = diskindex.nTime;
-                pindexNew->nBits          = diskindex.nBits;
-                pindexNew->nNonce         = diskindex.nNonce;
-                pindexNew->nMoneySupply   = diskindex.nMoneySupply;
-                pindexNew->nStatus        = diskindex.nStatus;
-                pindexNew->nTx            = diskindex.nTx;
-                pindexNew->hashStateRoot  = diskindex.hashStateRoot; // kpg
-                pindexNew->hashUTXORoot   = diskindex.hashUTXORoot; // kpg
-                pindexNew->nStakeModifier = diskindex.nStakeModifier;
-                pindexNew->prevoutStake   = diskindex.prevoutStake;
-                pindexNew->vchBlockSig    = diskindex.vchBlockSig; // kpg
-
-                if (!CheckIndexProof(*pindexNew, Params().GetConsensus()))
-                    return error("%s: CheckIndexProof failed: %s", __func__, pindexNew->ToString());
-
-                // NovaCoin: build setStakeSeen
-                if (pindexNew->IsProofOfStake())
-                    setStakeSeen.insert(std::make_pair(pindexNew->prevoutStake, pindexNew->nTime));
-                pcursor->Next();
-            } else {
-                return error("%s: failed to read value", __func__);
+        entries.clear();
+        while (entries.size() < BLOCK_INDEX_LOAD_BATCH) {
+            std::pair<char, uint256> key;
+            if (!pcursor->Valid() || !pcursor->GetKey(key) || key.first != DB_BLOCK_INDEX) {
+                fEnd = true;
+                break;
             }
-        } else {
-            break;
+            entries.emplace_back();
+            entries.back().value = pcursor->GetValueStream();
+            pcursor->Next();
+        }
+
+        ParallelForRanges(entries.size(), [&entries](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                Entry& entry = entries[i];
+                try {
+                    entry.value >> entry.diskindex;
+                    entry.hash = entry.diskindex.GetBlockHash();
+                    entry.fValid = true;
+                } catch (const std::exception&) {
+                }
+            }
+        });
+
+        for (const Entry& entry : entries) {
+            if (!entry.fValid)
+                return error("%s: failed to read value", __func__);
+            // Construct block index object
+            if (!InsertDiskBlockIndex(entry.hash, entry.diskindex, insertBlockIndex))
+                return false;
         }
     }
 
     return true;
 }
 
+bool CBlockTreeDB::LoadBlockIndexSnapshot(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)>& insertBlockIndex)
+{
+    uint256 nonce;
+    if (m_snapshot_path.empty() || !Read(DB_BLOCK_INDEX_SNAPSHOT, nonce))
+        return false;
+    // The snapshot matches the database until the block index changes, which it may from now on
+    if (!Erase(DB_BLOCK_INDEX_SNAPSHOT, true))
+        return false;
+
+    CAutoFile filein(fsbridge::fopen(m_snapshot_path, "rb"), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return false;
+
+    // Entries inserted before a failure are ones the database has too, and loading the
+    // database afterwards overwrites them
+    int64_t nStart = GetTimeMillis();
+    uint64_t nCount = 0;
+    try {
+        uint32_t nVersion;
+        filein >> nVersion;
+        if (nVersion != BLOCK_INDEX_SNAPSHOT_VERSION)
+            return false;
+
+        // The last block file as recorded by the database, which a node that does not know
+        // about the snapshot would have changed in the meantime
+        uint256 nonceFile;
+        int nLastFile, nLastFileDB = 0;
+        CBlockFileInfo info, infoDB;
+        filein >> nonceFile >> nLastFile >> info;
+        ReadLastBlockFile(nLastFileDB);
+        ReadBlockFileInfo(nLastFileDB, infoDB);
+        if (nonceFile != nonce || nLastFile != nLastFileDB || SerializeHash(info) != SerializeHash(infoDB)) {
+            LogPrintf("%s: ignoring the stale block index snapshot\n", __func__);
+            return false;
+        }
+
+        filein >> nCount;
+        for (uint64_t i = 0; i < nCount; i++) {
+            if (i % BLOCK_INDEX_LOAD_BATCH == 0)
+                boost::this_thread::interruption_point();
+            uint256 hash;
+            CDiskBlockIndex diskindex;
+            filein >> hash >> diskindex;
+            if (!InsertDiskBlockIndex(hash, diskindex, insertBlockIndex))
+                return false;
+        }
+    } catch (const boost::thread_interrupted&) {
+        throw;
+    } catch (const std::exception& e) {
+        LogPrintf("%s: failed to read the block index snapshot: %s\n", __func__, e.what());
+        return false;
+    }
+
+    LogPrintf("%s: loaded %u block index entries from the snapshot in %dms\n", __func__, nCount, GetTimeMillis() - nStart);
+    return true;
+}
+
+bool CBlockTreeDB::WriteBlockIndexSnapshot(const std::vector<const CBlockIndex*>& vIndex)
+{
+    if (m_snapshot_path.empty())
+        return false;
+
+    int nLastFile = 0;
+    CBlockFileInfo info;
+    ReadLastBlockFile(nLastFile);
+    ReadBlockFileInfo(nLastFile, info);
+    const uint256 nonce = GetRandHash();
+
+    fs::path pathTmp = m_snapshot_path;
+    pathTmp += ".new";
+    CAutoFile fileout(fsbridge::fopen(pathTmp, "wb"), SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull())
+        return error("%s: failed to open %s", __func__, pathTmp.string());
+    try {
+        fileout << BLOCK_INDEX_SNAPSHOT_VERSION << nonce << nLastFile << info << (uint64_t)vIndex.size();
+        for (const CBlockIndex* pindex : vIndex)
+            fileout << pindex->GetBlockHash() << CDiskBlockIndex(pindex);
+    } catch (const std::exception& e) {
+        return error("%s: failed to write the block index snapshot: %s", __func__, e.what());
+    }
+    if (!FileCommit(fileout.Get()))
+        return error("%s: failed to commit the block index snapshot", __func__);
+    fileout.fclose();
+    if (!RenameOver(pathTmp, m_snapshot_path))
+        return error("%s: failed to rename the block index snapshot", __func__);
+
+    // The snapshot is only used once the database refers to it
+    return Write(DB_BLOCK_INDEX_SNAPSHOT, nonce, true);
+}
+
 namespace {
 
 //! Legacy class to deserialize pre-pertxout database entries without reindex.
@@ -10,10 +10,14 @@
 #include <dbwrapper.h>
 #include <chain.h>
 #include <primitives/block.h>
+#include <sync.h>
 
+#include <condition_variable>
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -22,17 +26,6 @@
 class CBlockIndex;
 class CCoinsViewDBCursor;
 class uint256;
-#ifdef ENABLE_BITCORE_RPC
-//////////////////////////////////// //qtum
-struct CAddressIndexKey;
-struct CAddressUnspentKey;
-struct CAddressUnspentValue;
-struct CMempoolAddressDeltaKey;
-struct CTimestampIndexKey;
-struct CTimestampBlockIndexKey;
-struct CTimestampBlockIndexValue;
-////////////////////////////////////
-#endif
 
 //! Compensate for extra memory peak (x1.5-x1.9) at flush time.
 static constexpr int DB_PEAK_USAGE_FACTOR = 2;
@@ -52,8 +45,12 @@ static const int64_t nMaxBlockDBCache = 2;
 // Unlike for the UTXO database, for the txindex scenario the leveldb cache make
 // a meaningful difference: https://github.com/bitcoin/bitcoin/pull/8273#issuecomment-229601991
 static const int64_t nMaxTxIndexCache = 1024;
+//! Max memory allocated to all block filter index caches combined in MiB.
+static const int64_t max_filter_index_cache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+//! Max memory allocated to the contract state, UTXO trie and receipts databases (MiB)
+static const int64_t nMaxStateDBCache = 64;
 
 struct CDiskTxPos : public CDiskBlockPos
 {
@@ -95,11 +92,90 @@ public:
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
     CCoinsViewCursor *Cursor() const override;
 
+    /**
+     * Return cursors over n disjoint ranges of the coins, split by the first byte of
+     * the txid, which in order iterate over all coins in the order of Cursor(). They
+     * read one snapshot of the database and return its best block. Nothing is
+     * returned if the snapshot is in the middle of a flush.
+     */
+    std::vector<std::unique_ptr<CCoinsViewCursor>> Cursors(int n) const;
+
+    /**
+     * Write a part of the coins of a flush to hashBlock, like BatchWrite does all of
+     * them. The first part marks the database as moving to hashBlock and the last part
+     * marks it as consistent with hashBlock again, so that a flush interrupted between
+     * parts is replayed at startup.
+     */
+    bool WriteCoins(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fFirst, bool fLast);
+
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
 };
 
+/** Default for -blockindexsnapshot */
+static const bool DEFAULT_BLOCK_INDEX_SNAPSHOT = true;
+
+/** Default for -backgroundflush */
+static const bool DEFAULT_BACKGROUND_FLUSH = true;
+/** Number of coins the background flush writes to the coin database at a time */
+static const size_t BACKGROUND_FLUSH_BATCH_COINS = 50000;
+
+/**
+ * CCoinsView in front of the coin database which writes the flushed coins on a
+ * background thread, so that flushing the coins cache hands them over under cs_main
+ * and returns instead of waiting for LevelDB.
+ *
+ * Until they are written, the flushed coins are read from the handed over entries and
+ * GetBestBlock returns the block they were flushed at. They are written in batches of
+ * BACKGROUND_FLUSH_BATCH_COINS through CCoinsViewDB::WriteCoins. Only one flush is in
+ * flight: the next one waits for it to be written. A failed write aborts the node.
+ */
+class CCoinsViewBackgroundFlush final : public CCoinsViewBacked
+{
+public:
+    explicit CCoinsViewBackgroundFlush(CCoinsViewDB* db);
+    ~CCoinsViewBackgroundFlush();
+
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
+    bool HaveCoin(const COutPoint &outpoint) const override;
+    uint256 GetBestBlock() const override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    CCoinsViewCursor *Cursor() const override;
+
+    //! Wait for the flush in flight to be written, false if writing a flush failed.
+    bool Wait();
+
+    //! Call f once the flush in flight is written, now if none is, never if writing fails.
+    //! f may run on the writing thread, with this view locked.
+    void WhenWritten(std::function<void()> f);
+
+    //! Memory used by the coins not written yet
+    size_t PendingMemoryUsage() const;
+
+private:
+    void ThreadWrite();
+    void ResetPending() EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+
+    CCoinsViewDB* const m_db;
+
+    mutable Mutex m_mutex;
+    std::condition_variable m_cond;
+    //! The coins of the flush in flight not written yet, and their dynamic memory usage
+    std::unique_ptr<CCoinsMapMemoryResource> m_pending_resource GUARDED_BY(m_mutex);
+    std::unique_ptr<CCoinsMap> m_pending GUARDED_BY(m_mutex);
+    size_t m_pending_usage GUARDED_BY(m_mutex);
+    //! The block of the flush in flight, null if none
+    uint256 m_pending_block GUARDED_BY(m_mutex);
+    //! Called once the flush in flight is written
+    std::function<void()> m_written GUARDED_BY(m_mutex);
+    //! Set when a write failed: the coins not written are kept, and nothing is flushed anymore
+    bool m_failed GUARDED_BY(m_mutex);
+    bool m_stop GUARDED_BY(m_mutex);
+
+    std::thread m_thread;
+};
+
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
 class CCoinsViewDBCursor: public CCoinsViewCursor
 {
@@ -116,18 +192,65 @@ public:
 private:
     CCoinsViewDBCursor(CDBIterator* pcursorIn, const uint256 &hashBlockIn):
         CCoinsViewCursor(hashBlockIn), pcursor(pcursorIn) {}
+    CCoinsViewDBCursor(const std::shared_ptr<const leveldb::Snapshot>& snapshotIn, CDBIterator* pcursorIn, const uint256 &hashBlockIn, int nEndIn):
+        CCoinsViewCursor(hashBlockIn), snapshot(snapshotIn), pcursor(pcursorIn), nEnd(nEndIn) {}
+    //! Read the key at the iterator, invalidating the cached key at the end of the range
+    void CacheKey();
+
+    std::shared_ptr<const leveldb::Snapshot> snapshot;
     std::unique_ptr<CDBIterator> pcursor;
     std::pair<char, COutPoint> keyTmp;
+    //! The range ends before the txids starting with this byte
+    int nEnd = 256;
 
     friend class CCoinsViewDB;
 };
 
+/** Number of consecutive blocks whose log blooms are also combined into one range bloom */
+static const unsigned int LOG_BLOOM_RANGE = 1024;
+
+/** Conditions tested against log blooms to skip blocks that cannot contain a matching log */
+struct CLogBloomFilter
+{
+    // Any of these addresses has to be present (no condition if empty)
+    std::set<dev::h160> addresses;
+    // All (or, if !fMatchAllTopics, any) of these topics have to be present (no condition if empty)
+    std::vector<dev::h256> topics;
+    bool fMatchAllTopics = true;
+
+    bool Match(const dev::eth::LogBloom& bloom) const;
+};
+
+/**
+ * Writes to the per-block indexes of the block database, staged as blocks are connected
+ * and disconnected and written with the block index at the next flush instead of in a
+ * batch of their own for every block. A block connected after the flush is connected
+ * again after a crash, which writes its entries again.
+ */
+class CBlockTreeIndexBatch
+{
+public:
+    //! Staged stake index entries by height: whether the entry is written, and the staker
+    typedef std::map<unsigned int, std::pair<bool, uint160>> StakeEntries;
+
+    void WriteStakeIndex(unsigned int height, const uint160& address) { m_stake[height] = std::make_pair(true, address); }
+    void EraseStakeIndex(unsigned int height) { m_stake[height] = std::make_pair(false, uint160()); }
+    const StakeEntries& GetStakeEntries() const { return m_stake; }
+
+    bool IsEmpty() const { return m_stake.empty(); }
+    void Clear() { m_stake.clear(); }
+
+private:
+    StakeEntries m_stake;
+};
+
 /** Access to the block database (blocks/index/) */
 class CBlockTreeDB : public CDBWrapper
 {
 public:
     explicit CBlockTreeDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
+    /** Write the block file info, the block index entries and the staged index writes */
     bool WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo);
     bool ReadBlockFileInfo(int nFile, CBlockFileInfo &info);
     bool ReadLastBlockFile(int &nFile);
@@ -135,7 +258,12 @@ public:
     void ReadReindexing(bool &fReindexing);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
+    /** Load the block index entries, from the snapshot written at the last shutdown if the
+     *  index has not changed since, or from the database, deserializing and hashing the
+     *  entries on the precheck threads */
     bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+    /** Write a snapshot of the block index, which has to be flushed, for the next start to load */
+    bool WriteBlockIndexSnapshot(const std::vector<const CBlockIndex*>& vIndex);
 
     ////////////////////////////////////////////////////////////////////////////// // kpg
     bool WriteHeightIndex(const CHeightTxIndexKey &heightIndex, const std::vector<uint256>& hash);
@@ -148,42 +276,72 @@ public:
      * @param minconf stop iterating of the block height does not have enough confirmations (ignored if <= 0)
      * @param blocksOfHashes transaction hashes in blocks iterated are collected into this vector.
      * @param addresses filter out a block unless it matches one of the addresses in this set.
+     * @param filter if set, blocks and ranges of blocks whose log bloom does not match it are skipped without being iterated.
      *
      * @return the height of the latest block iterated. 0 if no block is iterated.
      */
     int ReadHeightIndex(int low, int high, int minconf,
             std::vector<std::vector<uint256>> &blocksOfHashes,
-            std::set<dev::h160> const &addresses);
+            std::set<dev::h160> const &addresses,
+            const CLogBloomFilter* filter = nullptr);
     bool EraseHeightIndex(const unsigned int &height);
     bool WipeHeightIndex();
 
+    bool WriteTopicIndex(const std::vector<std::pair<CTopicIndexKey, uint256>>& entries);
+    /**
+     * Collects the transactions with a log whose first topic is the given one, by height.
+     * Same parameters and return value as ReadHeightIndex.
+     */
+    int ReadTopicIndex(int low, int high, int minconf, const dev::h256& topic,
+            std::vector<uint256>& hashes);
+    bool EraseTopicIndex(unsigned int height, const std::set<dev::h256>& topics);
+    bool WipeTopicIndex();
 
-    bool WriteStakeIndex(unsigned int height, uint160 address);
+    /** Store the contract address index entries of a block, with the list of their addresses by height */
+    bool WriteContractAddressIndex(unsigned int height, const std::vector<std::pair<CContractAddressIndexKey, CContractAddressIndexValue>>& entries);
+    /**
+     * Collects the contract transactions an EVM address took part in, by height.
+     * @param low start iterating from this block height
+     * @param high end iterating at this block height (ignored if < 0)
+     */
+    bool ReadContractAddressIndex(const dev::h160& address, int low, int high,
+            std::vector<std::pair<CContractAddressIndexKey, CContractAddressIndexValue>>& entries);
+    bool EraseContractAddressIndex(unsigned int height);
+    bool WipeContractAddressIndex();
+
+    /** Store the log bloom of a block and fold it into the bloom of its range */
+    bool WriteLogBloom(unsigned int height, const dev::eth::LogBloom& bloom);
+    /** Remove the log bloom of a disconnected block and rebuild the bloom of its range */
+    bool EraseLogBloom(unsigned int height);
+    /** Log blooms exist for every block with log entries starting from this height */
+    bool WriteLogBloomStart(unsigned int height);
+    bool ReadLogBloomStart(unsigned int& height);
+
+
+    /** Store the staker of a proof-of-stake block, with its entry in the staker index, at the next flush */
+    bool WriteStakeIndex(unsigned int height, const uint160& address);
     bool ReadStakeIndex(unsigned int height, uint160& address);
-    bool ReadStakeIndex(unsigned int high, unsigned int low, std::vector<uint160> addresses);
+    /**
+     * Collects the heights of the blocks staked by an address.
+     * @param low start iterating from this block height
+     * @param high end iterating at this block height (ignored if < 0)
+     */
+    bool ReadStakerIndex(const uint160& staker, int low, int high, std::vector<unsigned int>& heights);
     bool EraseStakeIndex(unsigned int height);
-
-#ifdef ENABLE_BITCORE_RPC
-    // Block explorer database functions
-    bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
-    bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
-    bool ReadAddressIndex(uint256 addressHash, int type,
-                        std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                        int start = 0, int end = 0);
-    bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect);
-    bool ReadAddressUnspentIndex(uint256 addressHash, int type,
-                                std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect);
-    bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
-    bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, const bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &vect);
-    bool WriteTimestampBlockIndex(const CTimestampBlockIndexKey &blockhashIndex, const CTimestampBlockIndexValue &logicalts);
-    bool ReadTimestampBlockIndex(const uint256 &hash, unsigned int &logicalTS);
-    bool ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
-    bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect);
-    bool blockOnchainActive(const uint256 &hash);
-#endif
+    /** Build the staker index from the stake index of the blocks up to the tip, once */
+    bool UpgradeStakerIndex(int nTipHeight);
 
     //////////////////////////////////////////////////////////////////////////////
 
+private:
+    //! Block index snapshot file, empty for a database in memory
+    const fs::path m_snapshot_path;
+
+    Mutex m_index_batch_mutex;
+    CBlockTreeIndexBatch m_index_batch GUARDED_BY(m_index_batch_mutex);
+
+    /** Insert the block index entries of the snapshot, false if it is missing or stale */
+    bool LoadBlockIndexSnapshot(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)>& insertBlockIndex);
 };
 
 #endif // BITCOIN_TXDB_H
@@ -24,10 +24,10 @@
 
 CTxMemPoolEntry::CTxMemPoolEntry(const CTransactionRef& _tx, const CAmount& _nFee,
                                  int64_t _nTime, unsigned int _entryHeight,
-                                 bool _spendsCoinbase, int64_t _sigOpsCost, LockPoints lp, CAmount _nMinGasPrice)
+                                 bool _spendsCoinbase, int64_t _sigOpsCost, LockPoints lp, CAmount _nMinGasPrice, uint64_t _nGasLimit)
     : tx(_tx), nFee(_nFee), nTxWeight(GetTransactionWeight(*tx)), nUsageSize(RecursiveDynamicUsage(tx)), nTime(_nTime), entryHeight(_entryHeight),
     spendsCoinbase(_spendsCoinbase), sigOpCost(_sigOpsCost), lockPoints(lp),
-    nMinGasPrice(_nMinGasPrice)
+    nMinGasPrice(_nMinGasPrice), nGasLimit(_nGasLimit)
 {
     nCountWithDescendants = 1;
     nSizeWithDescendants = GetTxSize();
@@ -329,7 +329,7 @@ void CTxMemPoolEntry::UpdateAncestorState(int64_t modifySize, CAmount modifyFee,
 }
 
 CTxMemPool::CTxMemPool(CBlockPolicyEstimator* estimator) :
-    nTransactionsUpdated(0), minerPolicyEstimator(estimator)
+    nTransactionsUpdated(0), minerPolicyEstimator(estimator), m_epoch(0), m_has_epoch_guard(false)
 {
     _clear(); //lock free clear
 
@@ -402,6 +402,7 @@ void CTxMemPool::addUnchecked(const CTxMemPoolEntry &entry, setEntries &setAnces
 
     nTransactionsUpdated++;
     totalTxSize += entry.GetTxSize();
+    totalGas += entry.GetGasLimit();
     if (minerPolicyEstimator) {minerPolicyEstimator->processTransaction(entry, validFeeEstimate);}
 
     vTxHashes.emplace_back(tx.GetWitnessHash(), newit);
@@ -424,7 +425,14 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
     } else
         vTxHashes.clear();
 
+#ifdef ENABLE_BITCORE_RPC
+    // Evicted, expired, replaced and conflicted txs are removed from the indexes too
+    removeAddressIndex(hash);
+    removeSpentIndex(hash);
+#endif
+
     totalTxSize -= it->GetTxSize();
+    totalGas -= it->GetGasLimit();
     cachedInnerUsage -= it->DynamicMemoryUsage();
     cachedInnerUsage -= memusage::DynamicUsage(mapLinks[it].parents) + memusage::DynamicUsage(mapLinks[it].children);
     mapLinks.erase(it);
@@ -462,6 +470,25 @@ void CTxMemPool::CalculateDescendants(txiter entryit, setEntries& setDescendants
     }
 }
 
+CTxMemPool::EpochGuard CTxMemPool::GetFreshEpoch() const
+{
+    return EpochGuard(*this);
+}
+
+CTxMemPool::EpochGuard::EpochGuard(const CTxMemPool& in) : pool(in)
+{
+    assert(!pool.m_has_epoch_guard);
+    ++pool.m_epoch;
+    pool.m_has_epoch_guard = true;
+}
+
+CTxMemPool::EpochGuard::~EpochGuard()
+{
+    // Nothing marked under this guard counts as visited any more
+    ++pool.m_epoch;
+    pool.m_has_epoch_guard = false;
+}
+
 void CTxMemPool::removeRecursive(const CTransaction &origTx, MemPoolRemovalReason reason)
 {
     // Remove transaction from memory pool
@@ -575,10 +602,6 @@ void CTxMemPool::removeForBlock(const std::vector<CTransactionRef>& vtx, unsigne
         }
         removeConflicts(*tx);
         ClearPrioritisation(tx->GetHash());
-#ifdef ENABLE_BITCORE_RPC
-        removeAddressIndex(tx->GetHash());
-        removeSpentIndex(tx->GetHash());
-#endif
     }
     lastRollingFeeUpdate = GetTime();
     blockSinceLastRollingFeeBump = true;
@@ -591,6 +614,10 @@ void CTxMemPool::_clear()
     mapNextTx.clear();
     totalTxSize = 0;
     cachedInnerUsage = 0;
+    totalGas = 0;
+#ifdef ENABLE_BITCORE_RPC
+    addressIndex.Clear();
+#endif
     lastRollingFeeUpdate = GetTime();
     blockSinceLastRollingFeeBump = false;
     rollingMinimumFeeRate = 0;
@@ -624,6 +651,7 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
     LogPrint(BCLog::MEMPOOL, "Checking mempool with %u transactions and %u inputs\n", (unsigned int)mapTx.size(), (unsigned int)mapNextTx.size());
 
     uint64_t checkTotal = 0;
+    uint64_t checkGas = 0;
     uint64_t innerUsage = 0;
 
     CCoinsViewCache mempoolDuplicate(const_cast<CCoinsViewCache*>(pcoins));
@@ -633,6 +661,7 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
     for (indexed_transaction_set::const_iterator it = mapTx.begin(); it != mapTx.end(); it++) {
         unsigned int i = 0;
         checkTotal += it->GetTxSize();
+        checkGas += it->GetGasLimit();
         innerUsage += it->DynamicMemoryUsage();
         const CTransaction& tx = it->GetTx();
         txlinksMap::const_iterator linksiter = mapLinks.find(it);
@@ -725,6 +754,7 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
     }
 
     assert(totalTxSize == checkTotal);
+    assert(totalGas == checkGas);
     assert(innerUsage == cachedInnerUsage);
 }
 
@@ -924,7 +954,11 @@ bool CCoinsViewMemPool::HaveCoin(const COutPoint &outpoint) const {
 size_t CTxMemPool::DynamicMemoryUsage() const {
     LOCK(cs);
     // Estimate the overhead of mapTx to be 12 pointers + an allocation, as no exact formula for boost::multi_index_contained is implemented.
-    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 12 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks) + memusage::DynamicUsage(vTxHashes) + cachedInnerUsage;
+    size_t usage = memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 12 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks) + memusage::DynamicUsage(vTxHashes) + cachedInnerUsage;
+#ifdef ENABLE_BITCORE_RPC
+    usage += addressIndex.DynamicMemoryUsage();
+#endif
+    return usage;
 }
 
 void CTxMemPool::RemoveStaged(setEntries &stage, bool updateDescendants, MemPoolRemovalReason reason) {
@@ -1048,24 +1082,7 @@ void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpends
         setEntries stage;
         CalculateDescendants(mapTx.project<0>(it), stage);
         nTxnRemoved += stage.size();
-
-        std::vector<CTransaction> txn;
-        if (pvNoSpendsRemaining) {
-            txn.reserve(stage.size());
-            for (txiter iter : stage)
-                txn.push_back(iter->GetTx());
-        }
-        RemoveStaged(stage, false, MemPoolRemovalReason::SIZELIMIT);
-        if (pvNoSpendsRemaining) {
-            for (const CTransaction& tx : txn) {
-                for (const CTxIn& txin : tx.vin) {
-                    if (exists(txin.prevout.hash)) continue;
-                    if (!mapNextTx.count(txin.prevout)) {
-                        pvNoSpendsRemaining->push_back(txin.prevout);
-                    }
-                }
-            }
-        }
+        RemoveStagedForLimit(stage, pvNoSpendsRemaining);
     }
 
     if (maxFeeRateRemoved > CFeeRate(0)) {
@@ -1073,6 +1090,63 @@ void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpends
     }
 }
 
+namespace {
+/** Key of the gas_price index sorted right after the last contract tx */
+struct EndOfContractTxs {};
+
+struct CompareEndOfContractTxs
+{
+    bool operator()(const CTxMemPoolEntry& a, const EndOfContractTxs&) const { return a.GetTx().HasCreateOrCall(); }
+    bool operator()(const EndOfContractTxs&, const CTxMemPoolEntry& b) const { return !b.GetTx().HasCreateOrCall(); }
+};
+}
+
+void CTxMemPool::TrimToGas(uint64_t gaslimit, std::vector<COutPoint>* pvNoSpendsRemaining) {
+    LOCK(cs);
+
+    unsigned nTxnRemoved = 0;
+    CAmount nMaxGasPriceRemoved = 0;
+    indexed_transaction_set::index<gas_price>::type& index = mapTx.get<gas_price>();
+    while (totalGas > gaslimit) {
+        // The contract tx with the lowest gas price, and the highest gas limit among those
+        indexed_transaction_set::index<gas_price>::type::iterator it = index.lower_bound(EndOfContractTxs(), CompareEndOfContractTxs());
+        if (it == index.begin())
+            break;
+        --it;
+        nMaxGasPriceRemoved = std::max(nMaxGasPriceRemoved, it->GetMinGasPrice());
+
+        setEntries stage;
+        CalculateDescendants(mapTx.project<0>(it), stage);
+        nTxnRemoved += stage.size();
+        RemoveStagedForLimit(stage, pvNoSpendsRemaining);
+    }
+
+    if (nTxnRemoved) {
+        LogPrint(BCLog::MEMPOOL, "Removed %u txn over the gas limit, up to a gas price of %d\n", nTxnRemoved, nMaxGasPriceRemoved);
+    }
+}
+
+void CTxMemPool::RemoveStagedForLimit(setEntries& stage, std::vector<COutPoint>* pvNoSpendsRemaining) {
+    AssertLockHeld(cs);
+    std::vector<CTransaction> txn;
+    if (pvNoSpendsRemaining) {
+        txn.reserve(stage.size());
+        for (txiter iter : stage)
+            txn.push_back(iter->GetTx());
+    }
+    RemoveStaged(stage, false, MemPoolRemovalReason::SIZELIMIT);
+    if (pvNoSpendsRemaining) {
+        for (const CTransaction& tx : txn) {
+            for (const CTxIn& txin : tx.vin) {
+                if (exists(txin.prevout.hash)) continue;
+                if (!mapNextTx.count(txin.prevout)) {
+                    pvNoSpendsRemaining->push_back(txin.prevout);
+                }
+            }
+        }
+    }
+}
+
 uint64_t CTxMemPool::CalculateDescendantMaximum(txiter entry) const {
     // find parent with highest descendant count
     std::vector<txiter> candidates;
@@ -1111,9 +1185,8 @@ SaltedTxidHasher::SaltedTxidHasher() : k0(GetRand(std::numeric_limits<uint64_t>:
 /////////////////////////////////////////////////////// // kpg
 void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewCache &view)
 {
-    LOCK(cs);
     const CTransaction& tx = entry.GetTx();
-    std::vector<CMempoolAddressDeltaKey> inserted;
+    std::vector<CMempoolAddressIndex::AddressDelta> deltas;
 
     uint256 txhash = tx.GetHash();
     for (unsigned int j = 0; j < tx.vin.size(); j++) {
@@ -1130,8 +1203,7 @@ void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewC
             std::copy(bytesID.begin(), bytesID.end(), addressBytes.begin());
             CMempoolAddressDeltaKey key(dest.which(), uint256(addressBytes), txhash, j, 1);
             CMempoolAddressDelta delta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n);
-            mapAddress.insert(std::make_pair(key, delta));
-            inserted.push_back(key);
+            deltas.push_back(std::make_pair(key, delta));
         }
     }
 
@@ -1147,49 +1219,29 @@ void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewC
             valtype addressBytes(32);
             std::copy(bytesID.begin(), bytesID.end(), addressBytes.begin());
             CMempoolAddressDeltaKey key(dest.which(), uint256(addressBytes), txhash, k, 0);
-            mapAddress.insert(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
-            inserted.push_back(key);
+            deltas.push_back(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
         }
     }
 
-    mapAddressInserted.insert(std::make_pair(txhash, inserted));
+    addressIndex.AddAddressDeltas(txhash, deltas);
 }
 
 bool CTxMemPool::getAddressIndex(std::vector<std::pair<uint256, int> > &addresses, std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > &results)
 {
-    LOCK(cs);
-    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        addressDeltaMap::iterator ait = mapAddress.lower_bound(CMempoolAddressDeltaKey((*it).second, (*it).first));
-        while (ait != mapAddress.end() && (*ait).first.addressBytes == (*it).first && (*ait).first.type == (*it).second) {
-            results.push_back(*ait);
-            ait++;
-        }
-    }
+    addressIndex.GetAddressDeltas(addresses, results);
     return true;
 }
 
 bool CTxMemPool::removeAddressIndex(const uint256 txhash)
 {
-    LOCK(cs);
-    addressDeltaMapInserted::iterator it = mapAddressInserted.find(txhash);
-
-    if (it != mapAddressInserted.end()) {
-        std::vector<CMempoolAddressDeltaKey> keys = (*it).second;
-        for (std::vector<CMempoolAddressDeltaKey>::iterator mit = keys.begin(); mit != keys.end(); mit++) {
-            mapAddress.erase(*mit);
-        }
-        mapAddressInserted.erase(it);
-    }
-
+    addressIndex.RemoveAddressDeltas(txhash);
     return true;
 }
 
 void CTxMemPool::addSpentIndex(const CTxMemPoolEntry &entry, const CCoinsViewCache &view)
 {
-    LOCK(cs);
-
     const CTransaction& tx = entry.GetTx();
-    std::vector<CSpentIndexKey> inserted;
+    std::vector<CMempoolAddressIndex::Spent> spent;
 
     uint256 txhash = tx.GetHash();
     for (unsigned int j = 0; j < tx.vin.size(); j++) {
@@ -1229,39 +1281,20 @@ void CTxMemPool::addSpentIndex(const CTxMemPoolEntry &entry, const CCoinsViewCac
         CSpentIndexKey key = CSpentIndexKey(input.prevout.hash, input.prevout.n);
         CSpentIndexValue value = CSpentIndexValue(txhash, j, -1, prevout.nValue, addressType, addressHash);
 
-        mapSpent.insert(std::make_pair(key, value));
-        inserted.push_back(key);
+        spent.push_back(std::make_pair(key, value));
     }
 
-    mapSpentInserted.insert(std::make_pair(txhash, inserted));
+    addressIndex.AddSpent(txhash, spent);
 }
 
 bool CTxMemPool::getSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
 {
-    LOCK(cs);
-    mapSpentIndex::iterator it;
-
-    it = mapSpent.find(key);
-    if (it != mapSpent.end()) {
-        value = it->second;
-        return true;
-    }
-    return false;
+    return addressIndex.GetSpent(key, value);
 }
 
 bool CTxMemPool::removeSpentIndex(const uint256 txhash)
 {
-    LOCK(cs);
-    mapSpentIndexInserted::iterator it = mapSpentInserted.find(txhash);
-
-    if (it != mapSpentInserted.end()) {
-        std::vector<CSpentIndexKey> keys = (*it).second;
-        for (std::vector<CSpentIndexKey>::iterator mit = keys.begin(); mit != keys.end(); mit++) {
-            mapSpent.erase(*mit);
-        }
-        mapSpentInserted.erase(it);
-    }
-
+    addressIndex.RemoveSpent(txhash);
     return true;
 }
 ///////////////////////////////////////////////////////
@@ -17,6 +17,7 @@
 #include <coins.h>
 #include <crypto/siphash.h>
 #include <indirectmap.h>
+#include <mempooladdressindex.h>
 #include <policy/feerate.h>
 #include <primitives/transaction.h>
 #include <sync.h>
@@ -29,6 +30,8 @@
 #include <boost/signals2/signal.hpp>
 
 class CBlockIndex;
+struct PrecomputedTransactionData;
+struct ContractExtraction;
 extern CCriticalSection cs_main;
 
 /** Fake height value used in Coin to signify they are only in the memory pool (since 0.8) */
@@ -51,91 +54,6 @@ struct LockPoints
 
 class CTxMemPool;
 
-#ifdef ENABLE_BITCORE_RPC
-//////////////////////////////////////////////////////// // kpg
-struct CSpentIndexKeyCompare
-{
-    bool operator()(const CSpentIndexKey& a, const CSpentIndexKey& b) const {
-        if (a.txid == b.txid) {
-            return a.outputIndex < b.outputIndex;
-        } else {
-            return a.txid < b.txid;
-        }
-    }
-};
-
-struct CMempoolAddressDelta
-{
-    int64_t time;
-    CAmount amount;
-    uint256 prevhash;
-    unsigned int prevout;
-
-    CMempoolAddressDelta(int64_t t, CAmount a, uint256 hash, unsigned int out) {
-        time = t;
-        amount = a;
-        prevhash = hash;
-        prevout = out;
-    }
-
-    CMempoolAddressDelta(int64_t t, CAmount a) {
-        time = t;
-        amount = a;
-        prevhash.SetNull();
-        prevout = 0;
-    }
-};
-
-struct CMempoolAddressDeltaKey
-{
-    int type;
-    uint256 addressBytes;
-    uint256 txhash;
-    unsigned int index;
-    int spending;
-
-    CMempoolAddressDeltaKey(int addressType, uint256 addressHash, uint256 hash, unsigned int i, int s) {
-        type = addressType;
-        addressBytes = addressHash;
-        txhash = hash;
-        index = i;
-        spending = s;
-    }
-
-    CMempoolAddressDeltaKey(int addressType, uint256 addressHash) {
-        type = addressType;
-        addressBytes = addressHash;
-        txhash.SetNull();
-        index = 0;
-        spending = 0;
-    }
-};
-
-struct CMempoolAddressDeltaKeyCompare
-{
-    bool operator()(const CMempoolAddressDeltaKey& a, const CMempoolAddressDeltaKey& b) const {
-        if (a.type == b.type) {
-            if (a.addressBytes == b.addressBytes) {
-                if (a.txhash == b.txhash) {
-                    if (a.index == b.index) {
-                        return a.spending < b.spending;
-                    } else {
-                        return a.index < b.index;
-                    }
-                } else {
-                    return a.txhash < b.txhash;
-                }
-            } else {
-                return a.addressBytes < b.addressBytes;
-            }
-        } else {
-            return a.type < b.type;
-        }
-    }
-};
-////////////////////////////////////////////////////////
-#endif
-
 /** \class CTxMemPoolEntry
  *
  * CTxMemPoolEntry stores data about the corresponding transaction, as well
@@ -148,13 +66,27 @@ struct CMempoolAddressDeltaKeyCompare
  *
  */
 
+/** Result of executing the contracts of a tx against the tip when it entered the mempool */
+struct ContractPreExecution
+{
+    //! Tip the contracts were executed on, null if they were not executed
+    uint256 hashTip;
+    uint64_t nGasUsed = 0;
+    //! Wall time of the execution in microseconds
+    int64_t nTime = 0;
+    //! Whether any of the contracts threw an exception
+    bool fExcepted = false;
+    //! Whether the result is the one of an EstimateContractGas dry run
+    bool fEstimated = false;
+};
+
 class CTxMemPoolEntry
 {
 private:
     const CTransactionRef tx;
     const CAmount nFee;             //!< Cached to avoid expensive parent-transaction lookups
     const size_t nTxWeight;         //!< ... and avoid recomputing tx weight (also used for GetTxSize())
-    const size_t nUsageSize;        //!< ... and total memory usage
+    size_t nUsageSize;              //!< ... and total memory usage
     const int64_t nTime;            //!< Local time when entering the mempool
     const unsigned int entryHeight; //!< Chain height when entering the mempool
     const bool spendsCoinbase;      //!< keep track of transactions that spend a coinbase
@@ -162,6 +94,10 @@ private:
     int64_t feeDelta;          //!< Used for determining the priority of the transaction for mining in a block
     LockPoints lockPoints;     //!< Track the height and time at which tx was final
     CAmount nMinGasPrice;      //!< The minimum gas price among the contract outputs of the tx
+    uint64_t nGasLimit;        //!< The total gas limit of the contract outputs of the tx
+    ContractPreExecution preExecution; //!< Set before the entry is added with -mempoolpreexec
+    std::shared_ptr<PrecomputedTransactionData> txdata; //!< Sighash midstates computed on acceptance, reused by ConnectBlock
+    std::shared_ptr<const ContractExtraction> contractExtraction; //!< Contract txs parsed on acceptance, reused by the miner and ConnectBlock
 
     // Information about descendants of this transaction that are in the
     // mempool; if we remove this transaction we must remove all of these
@@ -180,7 +116,7 @@ public:
     CTxMemPoolEntry(const CTransactionRef& _tx, const CAmount& _nFee,
                     int64_t _nTime, unsigned int _entryHeight,
                     bool spendsCoinbase,
-                    int64_t nSigOpsCost, LockPoints lp, CAmount _nMinGasPrice = 0);
+                    int64_t nSigOpsCost, LockPoints lp, CAmount _nMinGasPrice = 0, uint64_t _nGasLimit = 0);
 
     const CTransaction& GetTx() const { return *this->tx; }
     CTransactionRef GetSharedTx() const { return this->tx; }
@@ -194,6 +130,14 @@ public:
     size_t DynamicMemoryUsage() const { return nUsageSize; }
     const LockPoints& GetLockPoints() const { return lockPoints; }
     const CAmount& GetMinGasPrice() const { return nMinGasPrice; }
+    uint64_t GetGasLimit() const { return nGasLimit; }
+    const ContractPreExecution& GetPreExecution() const { return preExecution; }
+    void SetPreExecution(const ContractPreExecution& pre) { preExecution = pre; }
+    const std::shared_ptr<PrecomputedTransactionData>& GetPrecomputedData() const { return txdata; }
+    void SetPrecomputedData(const std::shared_ptr<PrecomputedTransactionData>& data) { txdata = data; }
+    const std::shared_ptr<const ContractExtraction>& GetContractExtraction() const { return contractExtraction; }
+    //! Only before the entry is added to the mempool, usage is what the extraction adds to the entry's memory usage
+    void SetContractExtraction(const std::shared_ptr<const ContractExtraction>& extraction, size_t usage) { contractExtraction = extraction; nUsageSize += usage; }
 
     // Adjusts the descendant state.
     void UpdateDescendantState(int64_t modifySize, CAmount modifyFee, int64_t modifyCount);
@@ -217,6 +161,7 @@ public:
     int64_t GetSigOpCostWithAncestors() const { return nSigOpCostWithAncestors; }
 
     mutable size_t vTxHashesIdx; //!< Index in mempool's vTxHashes
+    mutable uint64_t m_epoch = 0; //!< epoch when last touched, see CTxMemPool::visited
 };
 
 // Helpers for modifying CTxMemPool::mapTx, which is a boost multi_index.
@@ -271,6 +216,16 @@ private:
     const LockPoints& lp;
 };
 
+struct update_pre_execution
+{
+    explicit update_pre_execution(const ContractPreExecution& _pre) : pre(_pre) { }
+
+    void operator() (CTxMemPoolEntry &e) { e.SetPreExecution(pre); }
+
+private:
+    const ContractPreExecution& pre;
+};
+
 // extracts a transaction hash from CTxMempoolEntry or CTransactionRef
 struct mempoolentry_txid
 {
@@ -454,11 +409,34 @@ public:
     }
 };
 
+/** \class CompareTxMemPoolEntryByGasPrice
+ *
+ *  Sort contract txs by their minimum gas price, highest first, then by their gas
+ *  limit, lowest first. Txs without contracts come after all contract txs.
+ */
+class CompareTxMemPoolEntryByGasPrice
+{
+public:
+    bool operator()(const CTxMemPoolEntry& a, const CTxMemPoolEntry& b) const
+    {
+        bool fAHasCreateOrCall = a.GetTx().HasCreateOrCall();
+        bool fBHasCreateOrCall = b.GetTx().HasCreateOrCall();
+        if (fAHasCreateOrCall != fBHasCreateOrCall)
+            return fAHasCreateOrCall;
+        if (a.GetMinGasPrice() != b.GetMinGasPrice())
+            return a.GetMinGasPrice() > b.GetMinGasPrice();
+        if (a.GetGasLimit() != b.GetGasLimit())
+            return a.GetGasLimit() < b.GetGasLimit();
+        return a.GetTx().GetHash() < b.GetTx().GetHash();
+    }
+};
+
 // Multi_index tag names
 struct descendant_score {};
 struct entry_time {};
 struct ancestor_score {};
 struct ancestor_score_or_gas_price {};
+struct gas_price {};
 
 class CBlockPolicyEstimator;
 
@@ -588,10 +566,13 @@ private:
 
     uint64_t totalTxSize;      //!< sum of all mempool tx's virtual sizes. Differs from serialized tx size since witness data is discounted. Defined in BIP 141.
     uint64_t cachedInnerUsage; //!< sum of dynamic memory usage of all the map elements (NOT the maps themselves)
+    uint64_t totalGas;         //!< sum of the gas limits of all mempool contract txs
 
     mutable int64_t lastRollingFeeUpdate;
     mutable bool blockSinceLastRollingFeeBump;
     mutable double rollingMinimumFeeRate; //!< minimum fee to get into the pool, decreases exponentially
+    mutable uint64_t m_epoch;         //!< current epoch of the graph traversals, see visited()
+    mutable bool m_has_epoch_guard;   //!< whether a traversal holds an EpochGuard
 
     void trackPackageRemoved(const CFeeRate& rate) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
@@ -627,6 +608,12 @@ public:
                 boost::multi_index::tag<ancestor_score_or_gas_price>,
                 boost::multi_index::identity<CTxMemPoolEntry>,
                 CompareTxMemPoolEntryByAncestorFeeOrGasPrice
+            >,
+            // sorted by gas price and gas limit, contract txs first
+            boost::multi_index::ordered_non_unique<
+                boost::multi_index::tag<gas_price>,
+                boost::multi_index::identity<CTxMemPoolEntry>,
+                CompareTxMemPoolEntryByGasPrice
             >
         >
     > indexed_transaction_set;
@@ -696,20 +683,14 @@ private:
 
 #ifdef ENABLE_BITCORE_RPC
     //////////////////////////////////////////////////////////////// // kpg
-    typedef std::map<CMempoolAddressDeltaKey, CMempoolAddressDelta, CMempoolAddressDeltaKeyCompare> addressDeltaMap;
-    addressDeltaMap mapAddress;
-
-    typedef std::map<uint256, std::vector<CMempoolAddressDeltaKey> > addressDeltaMapInserted;
-    addressDeltaMapInserted mapAddressInserted;
-
-    typedef std::map<CSpentIndexKey, CSpentIndexValue, CSpentIndexKeyCompare> mapSpentIndex;
-    mapSpentIndex mapSpent;
-
-    typedef std::map<uint256, std::vector<CSpentIndexKey> > mapSpentIndexInserted;
-    mapSpentIndexInserted mapSpentInserted;
+    //! Address and spent indexes, with their own locks instead of cs
+    CMempoolAddressIndex addressIndex;
     ////////////////////////////////////////////////////////////////
 #endif
 
+    /** Remove the txs evicted by TrimToSize or TrimToGas, and list the outpoints no longer spent in the mempool */
+    void RemoveStagedForLimit(setEntries& stage, std::vector<COutPoint>* pvNoSpendsRemaining) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
     void UpdateParent(txiter entry, txiter parent, bool add);
     void UpdateChild(txiter entry, txiter child, bool add);
 
@@ -744,6 +725,7 @@ public:
 
 #ifdef ENABLE_BITCORE_RPC
     ///////////////////////////////////////////////////////// // kpg
+    // The index takes its own locks: readers do not need cs
     void addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewCache &view);
     bool getAddressIndex(std::vector<std::pair<uint256, int> > &addresses,
                          std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > &results);
@@ -824,6 +806,27 @@ public:
      *  already in it.  */
     void CalculateDescendants(txiter it, setEntries& setDescendants) const EXCLUSIVE_LOCKS_REQUIRED(cs);
 
+    /** RAII guard of a graph traversal that marks the entries it has reached with
+     *  visited() instead of collecting them in a setEntries. Only one guard can be
+     *  alive at a time, and all the marks are stale once it is destroyed.
+     */
+    class EpochGuard {
+        const CTxMemPool& pool;
+    public:
+        EpochGuard(const CTxMemPool& in);
+        ~EpochGuard();
+    };
+    EpochGuard GetFreshEpoch() const EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    /** Mark the entry as visited in the current epoch and return whether it
+     *  already was. Requires an EpochGuard. */
+    bool visited(txiter it) const EXCLUSIVE_LOCKS_REQUIRED(cs) {
+        assert(m_has_epoch_guard);
+        bool ret = it->m_epoch >= m_epoch;
+        it->m_epoch = std::max(it->m_epoch, m_epoch);
+        return ret;
+    }
+
     /** The minimum fee to get into the mempool, which may itself not be enough
       *  for larger-sized transactions.
       *  The incrementalRelayFee policy variable is used to bound the time it
@@ -838,6 +841,13 @@ public:
       */
     void TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpendsRemaining=nullptr);
 
+    /** Remove contract transactions, lowest gas price first, and their descendants until the
+      *  gas limits of the contract transactions add up to <= gaslimit. Unlike TrimToSize this
+      *  does not bump the rolling minimum fee: a new contract tx that does not outbid the
+      *  others is the one removed.
+      */
+    void TrimToGas(uint64_t gaslimit, std::vector<COutPoint>* pvNoSpendsRemaining=nullptr);
+
     /** Expire all transaction (and their dependencies) in the mempool older than time. Return the number of removed transactions. */
     int Expire(int64_t time);
 
@@ -859,6 +869,12 @@ public:
         return totalTxSize;
     }
 
+    uint64_t GetTotalGas() const
+    {
+        LOCK(cs);
+        return totalGas;
+    }
+
     bool exists(const uint256& hash) const
     {
         LOCK(cs);
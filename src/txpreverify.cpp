@@ -0,0 +1,131 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <txpreverify.h>
+#include <coins.h>
+#include <policy/policy.h>
+#include <script/interpreter.h>
+#include <txmempool.h>
+#include <util/system.h>
+#include <validation.h>
+
+std::unique_ptr<TxPreverifier> g_txpreverifier;
+
+TxPreverifier::TxPreverifier(int nThreads, std::function<void()> _notify) :
+    notify(std::move(_notify)), fStop(false)
+{
+    for (int i = 0; i < nThreads; i++)
+        threads.emplace_back(&TraceThread<std::function<void()>>, "txverify", std::function<void()>(std::bind(&TxPreverifier::ThreadVerify, this)));
+}
+
+TxPreverifier::~TxPreverifier()
+{
+    {
+        LOCK(cs);
+        fStop = true;
+        cond.notify_all();
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+void TxPreverifier::Submit(NodeId node, const CTransactionRef& tx)
+{
+    std::shared_ptr<Job> job = std::make_shared<Job>();
+    job->tx = tx;
+    LOCK(cs);
+    mapNodeJobs[node].push_back(job);
+    queue.push_back(std::move(job));
+    cond.notify_one();
+}
+
+std::vector<CTransactionRef> TxPreverifier::TakeReady(NodeId node)
+{
+    std::vector<CTransactionRef> vReady;
+    LOCK(cs);
+    auto it = mapNodeJobs.find(node);
+    if (it == mapNodeJobs.end())
+        return vReady;
+    std::deque<std::shared_ptr<Job>>& jobs = it->second;
+    while (!jobs.empty() && jobs.front()->fDone) {
+        vReady.push_back(std::move(jobs.front()->tx));
+        jobs.pop_front();
+    }
+    if (jobs.empty())
+        mapNodeJobs.erase(it);
+    return vReady;
+}
+
+bool TxPreverifier::IsFull(NodeId node)
+{
+    LOCK(cs);
+    auto it = mapNodeJobs.find(node);
+    return it != mapNodeJobs.end() && it->second.size() >= MAX_TX_VERIFY_PEER_QUEUE;
+}
+
+void TxPreverifier::RemoveNode(NodeId node)
+{
+    LOCK(cs);
+    mapNodeJobs.erase(node);
+}
+
+void TxPreverifier::ThreadVerify()
+{
+    while (true) {
+        std::shared_ptr<Job> job;
+        {
+            WAIT_LOCK(cs, lock);
+            while (!fStop && queue.empty())
+                cond.wait(lock);
+            if (fStop)
+                return;
+            job = std::move(queue.front());
+            queue.pop_front();
+            // The peer is gone, nobody will take the tx
+            if (job.use_count() == 1)
+                continue;
+        }
+
+        Verify(*job->tx);
+
+        {
+            LOCK(cs);
+            job->fDone = true;
+        }
+        notify();
+    }
+}
+
+void TxPreverifier::Verify(const CTransaction& tx) const
+{
+    if (tx.IsCoinBase() || tx.IsCoinStake())
+        return;
+
+    // Copy the spent coins, from the mempool or the tip, and leave the coins cache of the tip
+    // as it was: AcceptToMemoryPool takes care of keeping the coins of the txs it accepts
+    std::vector<Coin> coins(tx.vin.size());
+    {
+        LOCK2(cs_main, mempool.cs);
+        CCoinsViewMemPool viewMemPool(pcoinsTip.get(), mempool);
+        for (size_t i = 0; i < tx.vin.size(); i++) {
+            const COutPoint& prevout = tx.vin[i].prevout;
+            bool fCached = pcoinsTip->HaveCoinInCache(prevout);
+            bool fFound = viewMemPool.GetCoin(prevout, coins[i]);
+            if (!fCached)
+                pcoinsTip->Uncache(prevout);
+            // Orphans and double spends are for AcceptToMemoryPool to sort out
+            if (!fFound)
+                return;
+        }
+    }
+
+    // Valid signatures are stored in the signature cache whatever the flags, so the standard
+    // flags are as good as the ones AcceptToMemoryPool uses
+    PrecomputedTransactionData txdata(tx);
+    for (size_t i = 0; i < tx.vin.size(); i++) {
+        CScriptCheck check(coins[i].out, tx, i, STANDARD_SCRIPT_VERIFY_FLAGS, true, &txdata);
+        if (!check())
+            return;
+    }
+}
@@ -0,0 +1,85 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef TXPREVERIFY_H
+#define TXPREVERIFY_H
+
+#include <net.h>
+#include <primitives/transaction.h>
+#include <sync.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/** Default for -txverifythreads, the number of threads verifying the scripts of relayed txs (0 = off) */
+static const int DEFAULT_TX_VERIFY_THREADS = 0;
+/** Maximum for -txverifythreads */
+static const int MAX_TX_VERIFY_THREADS = 16;
+/** Number of queued txs of a peer from which its next messages wait for them to be verified */
+static const size_t MAX_TX_VERIFY_PEER_QUEUE = 100;
+
+/**
+ * Verification of the scripts of the txs received from peers before they go through
+ * AcceptToMemoryPool.
+ *
+ * AcceptToMemoryPool verifies the scripts under cs_main, so a burst of unrelated txs is
+ * verified one at a time by the message handler. The threads of the pre-verifier look
+ * up the coins spent by each submitted tx under cs_main, verify its scripts without the
+ * lock and store the valid signatures in the signature cache. AcceptToMemoryPool
+ * still runs all of its checks, but finds the signatures in the cache. A tx that fails
+ * here is left for AcceptToMemoryPool to reject, with the usual penalties.
+ *
+ * The txs of a peer are taken back in the order they were submitted, so that a child
+ * never overtakes its parent.
+ */
+class TxPreverifier
+{
+public:
+    TxPreverifier(int nThreads, std::function<void()> _notify);
+    ~TxPreverifier();
+
+    /** Queue a tx of a peer for verification */
+    void Submit(NodeId node, const CTransactionRef& tx);
+
+    /** The verified txs at the front of the queue of a peer, in submission order */
+    std::vector<CTransactionRef> TakeReady(NodeId node);
+
+    /** Whether the peer has MAX_TX_VERIFY_PEER_QUEUE txs queued */
+    bool IsFull(NodeId node);
+
+    /** Forget the txs of a disconnected peer */
+    void RemoveNode(NodeId node);
+
+private:
+    struct Job
+    {
+        CTransactionRef tx;
+        bool fDone = false;
+    };
+
+    void ThreadVerify();
+    void Verify(const CTransaction& tx) const;
+
+    const std::function<void()> notify;
+
+    Mutex cs;
+    std::condition_variable cond;
+    //! Txs of each peer in submission order, verified or not
+    std::map<NodeId, std::deque<std::shared_ptr<Job>>> mapNodeJobs GUARDED_BY(cs);
+    //! Txs not yet verified
+    std::deque<std::shared_ptr<Job>> queue GUARDED_BY(cs);
+    bool fStop GUARDED_BY(cs);
+
+    std::vector<std::thread> threads;
+};
+
+/** Pre-verifier of relayed txs, if -txverifythreads is set */
+extern std::unique_ptr<TxPreverifier> g_txpreverifier;
+
+#endif
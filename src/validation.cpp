@@ -6,6 +6,10 @@
 #include <validation.h>
 
 #include <arith_uint256.h>
+#include <blockcompress.h>
+#include <blockfilemap.h>
+#include <blockfilewriter.h>
+#include <blockprefetch.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <checkpoints.h>
@@ -16,7 +20,11 @@
 #include <consensus/validation.h>
 #include <cuckoocache.h>
 #include <hash.h>
+#include <index/addressindex.h>
+#include <index/base.h>
+#include <index/logindex.h>
 #include <index/txindex.h>
+#include <memusage.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
 #include <policy/rbf.h>
@@ -28,6 +36,7 @@
 #include <reverse_iterator.h>
 #include <script/script.h>
 #include <script/sigcache.h>
+#include <support/allocators/pool.h>
 #include <script/standard.h>
 #include <shutdown.h>
 #include <timedata.h>
@@ -40,6 +49,8 @@
 #include <util/moneystr.h>
 #include <util/strencodings.h>
 #include <validationinterface.h>
+#include <validationstats.h>
+#include <validationtimes.h>
 #include <warnings.h>
 #include <libethcore/ABI.h>
 #include <net_processing.h>
@@ -49,10 +60,21 @@
 #include <key.h>
 #include <wallet/wallet.h>
 #include <util/convert.h>
+#include <qtum/qtumstatecache.h>
+#include <qtum/qtumprofile.h>
+#include <qtum/qtumstateprune.h>
+#include <qtum/qtumstatewalk.h>
 
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <future>
+#include <limits>
+#include <list>
 #include <sstream>
+#include <thread>
+#include <unordered_map>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/thread.hpp>
@@ -193,13 +215,16 @@ public:
     bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     // Block (dis)connection on a given view:
-    DisconnectResult DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view, bool* pfClean);
+    DisconnectResult DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view, bool* pfClean, const CBlockUndo* pblockundo = nullptr);
     bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex,
-                      CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck = false) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
-    bool UpdateHashProof(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, CBlockIndex* pindex, CCoinsViewCache& view);
+                      CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck = false, CBlockUndo* pblockundo = nullptr,
+                      bool fReuseHashProof = false) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    bool UpdateHashProof(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, CBlockIndex* pindex, CCoinsViewCache& view,
+                         bool fCheckStakeSignature = true, bool fReuseHashProof = false);
 
     // Block disconnection on our pcoinsTip:
-    bool DisconnectTip(CValidationState& state, const CChainParams& chainparams, DisconnectedBlockTransactions* disconnectpool) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    //! pindexKeep is the block the caller disconnects down to, the data of the blocks above it is read ahead
+    bool DisconnectTip(CValidationState& state, const CChainParams& chainparams, DisconnectedBlockTransactions* disconnectpool, const CBlockIndex* pindexKeep = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     // Manual block validity manipulation:
     bool PreciousBlock(CValidationState& state, const CChainParams& params, CBlockIndex* pindex) LOCKS_EXCLUDED(cs_main);
@@ -253,21 +278,35 @@ private:
 RecursiveMutex cs_main;
 
 BlockMap& mapBlockIndex = g_chainstate.mapBlockIndex;
+/**
+ * Storage of the entries of mapBlockIndex. Entries are cut from large chunks instead of
+ * being allocated one by one, which saves the malloc overhead of each and keeps the
+ * entries created together, like the chain loaded at startup, next to each other for
+ * the pprev/pskip walks of GetAncestor and the stake checks. Guarded by cs_main.
+ */
+static PoolResource<sizeof(CBlockIndex), alignof(CBlockIndex)> g_block_index_resource(sizeof(CBlockIndex) * BLOCK_INDEX_CHUNK_ENTRIES);
 std::set<std::pair<COutPoint, unsigned int>>& setStakeSeen = g_chainstate.setStakeSeen;
 CChain& chainActive = g_chainstate.chainActive;
 CBlockIndex *pindexBestHeader = nullptr;
+std::atomic<int> nBestHeaderHeight{-1};
 Mutex g_best_block_mutex;
 std::condition_variable g_best_block_cv;
 uint256 g_best_block;
 int nScriptCheckThreads = 0;
+int nContractSpeculationThreads = 0;
+int nContractProfileLogInterval = DEFAULT_CONTRACT_PROFILE_LOG;
 std::atomic_bool fImporting(false);
 std::atomic_bool fReindex(false);
 #ifdef ENABLE_BITCORE_RPC
 bool fAddressIndex = false; // kpg
 #endif
 bool fLogEvents = false;
+bool fLogTopicIndex = false;
+bool fLogAddressIndex = false;
+bool fContractStateGrowth = false;
 bool fHavePruned = false;
 bool fPruneMode = false;
+bool fCompressBlocks = DEFAULT_COMPRESS_BLOCKS;
 bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
 bool fRequireStandard = true;
 bool fCheckBlockIndex = false;
@@ -276,8 +315,10 @@ size_t nCoinCacheUsage = 5000 * 300;
 uint64_t nPruneTarget = 0;
 int64_t nMaxTipAge = DEFAULT_MAX_TIP_AGE;
 bool fEnableReplacement = DEFAULT_ENABLE_REPLACEMENT;
+bool fMempoolPreExec = DEFAULT_MEMPOOL_PREEXEC;
 
 uint256 hashAssumeValid;
+bool fAssumeValidStake = DEFAULT_ASSUME_VALID_STAKE;
 arith_uint256 nMinimumChainWork;
 
 CFeeRate minRelayTxFee = CFeeRate(DEFAULT_MIN_RELAY_TX_FEE);
@@ -337,6 +378,7 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 }
 
 std::unique_ptr<CCoinsViewDB> pcoinsdbview;
+std::unique_ptr<CCoinsViewBackgroundFlush> pcoinsflusher;
 std::unique_ptr<CCoinsViewCache> pcoinsTip;
 std::unique_ptr<CBlockTreeDB> pblocktree;
 std::unique_ptr<StorageResults> pstorageresult;
@@ -349,11 +391,12 @@ enum class FlushStateMode {
 };
 
 // See definition for documentation
-static int GetWitnessCommitmentIndex(const CBlock& block);
 static bool FlushStateToDisk(const CChainParams& chainParams, CValidationState &state, FlushStateMode mode, int nManualPruneHeight=0);
 static void FindFilesToPruneManual(std::set<int>& setFilesToPrune, int nManualPruneHeight);
 static void FindFilesToPrune(std::set<int>& setFilesToPrune, uint64_t nPruneAfterHeight);
 bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks = nullptr);
+static void AddSenderCheckCache(const CTransaction& tx) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+static bool IsSenderCheckCached(const CTransaction& tx, bool erase) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 static FILE* OpenUndoFile(const CDiskBlockPos &pos, bool fReadOnly = false);
 
 bool CheckFinalTx(const CTransaction &tx, int flags)
@@ -479,9 +522,9 @@ bool CheckSequenceLocks(const CTxMemPool& pool, const CTransaction& tx, int flag
 }
 
 // Returns the script flags which should be checked for a given block
-static unsigned int GetBlockScriptFlags(const CBlockIndex* pindex, const Consensus::Params& chainparams);
+unsigned int GetBlockScriptFlags(const CBlockIndex* pindex, const Consensus::Params& chainparams);
 
-static void LimitMempoolSize(CTxMemPool& pool, size_t limit, unsigned long age) {
+static void LimitMempoolSize(CTxMemPool& pool, size_t limit, uint64_t gaslimit, unsigned long age) {
     int expired = pool.Expire(GetTime() - age);
     if (expired != 0) {
         LogPrint(BCLog::MEMPOOL, "Expired %i transactions from the memory pool\n", expired);
@@ -489,6 +532,7 @@ static void LimitMempoolSize(CTxMemPool& pool, size_t limit, unsigned long age)
 
     std::vector<COutPoint> vNoSpendsRemaining;
     pool.TrimToSize(limit, &vNoSpendsRemaining);
+    pool.TrimToGas(gaslimit, &vNoSpendsRemaining);
     for (const COutPoint& removed : vNoSpendsRemaining)
         pcoinsTip->Uncache(removed);
 }
@@ -514,6 +558,39 @@ static bool IsCurrentForFeeEstimation() EXCLUSIVE_LOCKS_REQUIRED(cs_main)
     return true;
 }
 
+/**
+ * With pvDeferredPreExec set, the contracts of the tx are not executed for -mempoolpreexec
+ * before it is added; its hash is appended to pvDeferredPreExec instead.
+ */
+static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool& pool, CValidationState& state, const CTransactionRef& ptx,
+                              bool* pfMissingInputs, int64_t nAcceptTime, std::list<CTransactionRef>* plTxnReplaced,
+                              bool bypass_limits, const CAmount& nAbsurdFee, std::vector<COutPoint>& coins_to_uncache, bool test_accept, bool rawTx,
+                              std::vector<uint256>* pvDeferredPreExec) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+static ContractPreExecution PreExecuteContracts(const std::vector<QtumTransaction>& txs) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+//! Contract txs put back into the mempool by a reorg that are still to be executed for -mempoolpreexec
+static std::vector<uint256> g_deferred_preexec GUARDED_BY(cs_main);
+
+/** Execute the contracts of the txs of g_deferred_preexec still in the mempool, one tx per cs_main hold */
+static void PreExecuteDeferredContracts()
+{
+    std::vector<uint256> vHashes;
+    {
+        LOCK(cs_main);
+        vHashes.swap(g_deferred_preexec);
+    }
+    for (const uint256& hash : vHashes) {
+        LOCK2(cs_main, mempool.cs);
+        CTxMemPool::txiter it = mempool.mapTx.find(hash);
+        if (it == mempool.mapTx.end() || !it->GetPreExecution().hashTip.IsNull())
+            continue;
+        const std::shared_ptr<const ContractExtraction>& extraction = it->GetContractExtraction();
+        if (!extraction || extraction->extracted.first.empty())
+            continue;
+        mempool.mapTx.modify(it, update_pre_execution(PreExecuteContracts(extraction->extracted.first)));
+    }
+}
+
 /* Make mempool consistent after a reorg, by re-adding or recursively erasing
  * disconnected block transactions from the mempool, and also removing any
  * other transactions from the mempool that are no longer valid given the new
@@ -530,29 +607,44 @@ static bool IsCurrentForFeeEstimation() EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 static void UpdateMempoolForReorg(DisconnectedBlockTransactions &disconnectpool, bool fAddToMempool) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     AssertLockHeld(cs_main);
+    const CChainParams& chainparams = Params();
     std::vector<uint256> vHashUpdate;
+    // The contract executions for -mempoolpreexec are left to a background pass, so
+    // that they do not hold up the new tip
+    std::vector<uint256> vDeferredPreExec;
+    const int64_t nAcceptTime = GetTime();
     // disconnectpool's insertion_order index sorts the entries from
     // oldest to newest, but the oldest entry will be the last tx from the
     // latest mined block that was disconnected.
     // Iterate disconnectpool in reverse, so that we add transactions
     // back to the mempool starting with the earliest transaction that had
     // been previously seen in a block.
-    auto it = disconnectpool.queuedTx.get<insertion_order>().rbegin();
-    while (it != disconnectpool.queuedTx.get<insertion_order>().rend()) {
-        // ignore validation errors in resurrected transactions
-        CValidationState stateDummy;
-        if (!fAddToMempool || (*it)->IsCoinBase() || (*it)->IsCoinStake() ||
-            !AcceptToMemoryPool(mempool, stateDummy, *it, nullptr /* pfMissingInputs */,
-                                nullptr /* plTxnReplaced */, true /* bypass_limits */, 0 /* nAbsurdFee */)) {
-            // If the transaction doesn't make it in to the mempool, remove any
-            // transactions that depend on it (which would now be orphans).
-            mempool.removeRecursive(**it, MemPoolRemovalReason::REORG);
-        } else if (mempool.exists((*it)->GetHash())) {
-            vHashUpdate.push_back((*it)->GetHash());
+    {
+        LOCK(mempool.cs);
+        auto it = disconnectpool.queuedTx.get<insertion_order>().rbegin();
+        while (it != disconnectpool.queuedTx.get<insertion_order>().rend()) {
+            // ignore validation errors in resurrected transactions
+            CValidationState stateDummy;
+            std::vector<COutPoint> coins_to_uncache;
+            if (!fAddToMempool || (*it)->IsCoinBase() || (*it)->IsCoinStake() ||
+                !AcceptToMemoryPoolWorker(chainparams, mempool, stateDummy, *it, nullptr /* pfMissingInputs */, nAcceptTime,
+                                          nullptr /* plTxnReplaced */, true /* bypass_limits */, 0 /* nAbsurdFee */,
+                                          coins_to_uncache, false /* test_accept */, false /* rawTx */, &vDeferredPreExec)) {
+                for (const COutPoint& hashTx : coins_to_uncache)
+                    pcoinsTip->Uncache(hashTx);
+                // If the transaction doesn't make it in to the mempool, remove any
+                // transactions that depend on it (which would now be orphans).
+                mempool.removeRecursive(**it, MemPoolRemovalReason::REORG);
+            } else if (mempool.exists((*it)->GetHash())) {
+                vHashUpdate.push_back((*it)->GetHash());
+            }
+            ++it;
         }
-        ++it;
     }
     disconnectpool.queuedTx.clear();
+    // The coins cache is checked once for the batch instead of after each tx
+    CValidationState stateDummy;
+    FlushStateToDisk(chainparams, stateDummy, FlushStateMode::PERIODIC);
     // AcceptToMemoryPool/addUnchecked all assume that new mempool entries have
     // no in-mempool children, which is generally not true when adding
     // previously-confirmed transactions back to the mempool.
@@ -563,7 +655,12 @@ static void UpdateMempoolForReorg(DisconnectedBlockTransactions &disconnectpool,
     // We also need to remove any now-immature transactions
     mempool.removeForReorg(pcoinsTip.get(), chainActive.Tip()->nHeight + 1, STANDARD_LOCKTIME_VERIFY_FLAGS);
     // Re-limit mempool size, in case we added any transactions
-    LimitMempoolSize(mempool, gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
+    LimitMempoolSize(mempool, gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, gArgs.GetArg("-maxmempoolgas", DEFAULT_MAX_MEMPOOL_GAS) * 1000000, gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
+
+    if (!vDeferredPreExec.empty()) {
+        g_deferred_preexec.insert(g_deferred_preexec.end(), vDeferredPreExec.begin(), vDeferredPreExec.end());
+        CallFunctionInValidationInterfaceQueue(PreExecuteDeferredContracts);
+    }
 }
 
 // Used to avoid mempool polluting consensus critical paths if CCoinsViewMempool
@@ -602,9 +699,12 @@ static bool CheckInputsFromMempoolAndCache(const CTransaction& tx, CValidationSt
     return CheckInputs(tx, state, view, true, flags, cacheSigStore, true, txdata);
 }
 
+static size_t ContractExtractionUsage(const ContractExtraction& extraction);
+
 static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool& pool, CValidationState& state, const CTransactionRef& ptx,
                               bool* pfMissingInputs, int64_t nAcceptTime, std::list<CTransactionRef>* plTxnReplaced,
-                              bool bypass_limits, const CAmount& nAbsurdFee, std::vector<COutPoint>& coins_to_uncache, bool test_accept, bool rawTx) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+                              bool bypass_limits, const CAmount& nAbsurdFee, std::vector<COutPoint>& coins_to_uncache, bool test_accept, bool rawTx,
+                              std::vector<uint256>* pvDeferredPreExec)
 {
     const CTransaction& tx = *ptx;
     const uint256 hash = tx.GetHash();
@@ -759,6 +859,9 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
         int64_t nSigOpsCost = GetTransactionSigOpCost(tx, view, STANDARD_SCRIPT_VERIFY_FLAGS);
 
         dev::u256 txMinGasPrice = 0;
+        dev::u256 txGasLimit = 0;
+        std::vector<QtumTransaction> contractTxs;
+        std::shared_ptr<const ContractExtraction> contractExtraction;
 
         //////////////////////////////////////////////////////////// // kpg
         if(!CheckOpSender(tx, chainparams, GetSpendHeight(view))){
@@ -777,13 +880,15 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
             for(const CTxOut& o : tx.vout)
                 count += o.scriptPubKey.HasOpCreate() || o.scriptPubKey.HasOpCall() ? 1 : 0;
             unsigned int contractflags = GetContractScriptFlags(GetSpendHeight(view), chainparams.GetConsensus());
-            QtumTxConverter converter(tx, NULL, NULL, contractflags);
-            ExtractQtumTX resultConverter;
-            if(!converter.extractionQtumTransactions(resultConverter)){
+            QtumTxConverter converter(tx, &view, NULL, contractflags);
+            std::shared_ptr<ContractExtraction> extraction = std::make_shared<ContractExtraction>();
+            extraction->nFlags = contractflags;
+            if(!converter.extractionQtumTransactions(extraction->extracted)){
                 return state.DoS(100, error("AcceptToMempool(): Contract transaction of the wrong format"), REJECT_INVALID, "bad-tx-bad-contract-format");
             }
-            std::vector<QtumTransaction> qtumTransactions = resultConverter.first;
-            std::vector<EthTransactionParams> qtumETP = resultConverter.second;
+            contractExtraction = extraction;
+            const std::vector<QtumTransaction>& qtumTransactions = extraction->extracted.first;
+            const std::vector<EthTransactionParams>& qtumETP = extraction->extracted.second;
 
             dev::u256 sumGas = dev::u256(0);
             dev::u256 gasAllTxs = dev::u256(0);
@@ -827,6 +932,7 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
                 gasAllTxs += qtumTransaction.gas();
                 if(gasAllTxs > dev::u256(blockGasLimit))
                     return state.DoS(1, false, REJECT_INVALID, "bad-txns-gas-exceeds-blockgaslimit");
+                txGasLimit = gasAllTxs;
 
                 //don't allow less than DGP set minimum gas price to prevent MPoS greedy mining/spammers
                 if(v.rootVM!=0 && (uint64_t)qtumTransaction.gasPrice() < minGasPrice)
@@ -839,6 +945,9 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
             if(count > qtumTransactions.size())
                 return state.DoS(100, false, REJECT_INVALID, "bad-txns-incorrect-format");
 
+            if(fMempoolPreExec)
+                contractTxs = qtumTransactions;
+
             if (rawTx && nAbsurdFee && dev::u256(nFees) > dev::u256(nAbsurdFee) + sumGas)
                 return state.Invalid(false,
                     REJECT_HIGHFEE, "absurdly-high-fee",
@@ -862,7 +971,7 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
         }
 
         CTxMemPoolEntry entry(ptx, nFees, nAcceptTime, chainActive.Height(),
-                              fSpendsCoinbase, nSigOpsCost, lp, CAmount(txMinGasPrice));
+                              fSpendsCoinbase, nSigOpsCost, lp, CAmount(txMinGasPrice), uint64_t(txGasLimit));
         unsigned int nSize = entry.GetTxSize();
 
         // Check that the transaction doesn't have an excessive number of
@@ -1038,7 +1147,8 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
 
         // Check against previous transactions
         // This is done last to help prevent CPU exhaustion denial-of-service attacks.
-        PrecomputedTransactionData txdata(tx);
+        std::shared_ptr<PrecomputedTransactionData> ptxdata = std::make_shared<PrecomputedTransactionData>(tx);
+        PrecomputedTransactionData& txdata = *ptxdata;
         if (!CheckInputs(tx, state, view, true, scriptVerifyFlags, true, false, txdata)) {
             // SCRIPT_VERIFY_CLEANSTACK requires SCRIPT_VERIFY_WITNESS, so we
             // need to turn both off, and compare against just turning off CLEANSTACK
@@ -1073,11 +1183,26 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
                     __func__, hash.ToString(), FormatStateMessage(state));
         }
 
+        // The sender checks of a contract tx passed above, so ConnectBlock can skip them
+        if (tx.HasCreateOrCall() || tx.HasOpSender())
+            AddSenderCheckCache(tx);
+
         if (test_accept) {
             // Tx was accepted, but not added
             return true;
         }
 
+        if (!contractTxs.empty()) {
+            if (pvDeferredPreExec)
+                pvDeferredPreExec->push_back(hash);
+            else
+                entry.SetPreExecution(PreExecuteContracts(contractTxs));
+        }
+        if (txdata.ready)
+            entry.SetPrecomputedData(ptxdata);
+        if (contractExtraction)
+            entry.SetContractExtraction(contractExtraction, ContractExtractionUsage(*contractExtraction));
+
         // Remove conflicting transactions from the mempool
         for (CTxMemPool::txiter it : allConflicting)
         {
@@ -1113,7 +1238,7 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
 
         // trim mempool and check if tx was trimmed
         if (!bypass_limits) {
-            LimitMempoolSize(pool, gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
+            LimitMempoolSize(pool, gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, gArgs.GetArg("-maxmempoolgas", DEFAULT_MAX_MEMPOOL_GAS) * 1000000, gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
             if (!pool.exists(hash))
                 return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool full");
         }
@@ -1130,7 +1255,7 @@ static bool AcceptToMemoryPoolWithTime(const CChainParams& chainparams, CTxMemPo
                         bool bypass_limits, const CAmount nAbsurdFee, bool test_accept, bool rawTx = false) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     std::vector<COutPoint> coins_to_uncache;
-    bool res = AcceptToMemoryPoolWorker(chainparams, pool, state, tx, pfMissingInputs, nAcceptTime, plTxnReplaced, bypass_limits, nAbsurdFee, coins_to_uncache, test_accept, rawTx);
+    bool res = AcceptToMemoryPoolWorker(chainparams, pool, state, tx, pfMissingInputs, nAcceptTime, plTxnReplaced, bypass_limits, nAbsurdFee, coins_to_uncache, test_accept, rawTx, nullptr);
     if (!res) {
         for (const COutPoint& hashTx : coins_to_uncache)
             pcoinsTip->Uncache(hashTx);
@@ -1205,6 +1330,49 @@ bool GetTransaction(const uint256& hash, CTransactionRef& txOut, const Consensus
     return false;
 }
 
+/**
+ * Stakes of proof-of-stake headers found neither in the UTXO set nor spent by the main chain
+ * above a block of it, so that the headers reusing them are rejected before their signature is
+ * recovered or their stake is looked up again. Each stake keeps the lowest fork base it was
+ * missing above: the forks from higher up search fewer blocks for it. The entries only hold for
+ * the tip they were found at, and fake stakes cannot grow the map past MAX_MISSING_STAKES.
+ */
+class CMissingStakes
+{
+public:
+    bool Contains(const COutPoint& prevout, const CBlockIndex* pforkBase) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+    {
+        Update();
+        auto it = mapMissing.find(prevout);
+        return it != mapMissing.end() && pforkBase->nHeight >= it->second;
+    }
+
+    void Add(const COutPoint& prevout, const CBlockIndex* pforkBase) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+    {
+        Update();
+        if (mapMissing.size() >= MAX_MISSING_STAKES)
+            mapMissing.clear();
+        auto it = mapMissing.emplace(prevout, pforkBase->nHeight).first;
+        it->second = std::min(it->second, pforkBase->nHeight);
+    }
+
+private:
+    static const size_t MAX_MISSING_STAKES = 100000;
+
+    void Update() EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+    {
+        if (pindexTip != chainActive.Tip()) {
+            mapMissing.clear();
+            pindexTip = chainActive.Tip();
+        }
+    }
+
+    std::unordered_map<COutPoint, int, SaltedOutpointHasher> mapMissing GUARDED_BY(cs_main);
+    const CBlockIndex* pindexTip GUARDED_BY(cs_main) = nullptr;
+};
+
+static CMissingStakes missingStakes;
+
 bool CheckHeaderPoW(const CBlockHeader& block, const Consensus::Params& consensusParams)
 {
     // Check for proof of work block header
@@ -1222,6 +1390,20 @@ bool CheckHeaderPoS(const CBlockHeader& block, const Consensus::Params& consensu
     // Check the kernel hash
     CBlockIndex* pindexPrev = (*mi).second;
 
+    // The signature check and the kernel both need the stake, so make sure it exists first
+    const CBlockIndex* pforkBase = chainActive.FindFork(pindexPrev);
+    if (missingStakes.Contains(block.prevoutStake, pforkBase))
+        return error("%s: stake %s was not found before", __func__, block.prevoutStake.ToString());
+    {
+        Coin coinStake;
+        if (!pcoinsTip->GetCoin(block.prevoutStake, coinStake) && !GetSpentCoinFromMainChain(pindexPrev, block.prevoutStake, &coinStake)) {
+            // Only when the main chain was searched down to the parent, which it contains
+            if (pforkBase == pindexPrev && chainActive.Height() - pforkBase->nHeight <= COINBASE_MATURITY)
+                missingStakes.Add(block.prevoutStake, pforkBase);
+            return error("%s: stake %s not found", __func__, block.prevoutStake.ToString());
+        }
+    }
+
     if(pindexPrev->nHeight >= consensusParams.nEnableHeaderSignatureHeight && !CheckRecoveredPubKeyFromBlockSignature(pindexPrev, block, *pcoinsTip)) {
         return error("Failed signature check");
     }
@@ -1258,15 +1440,39 @@ bool CheckIndexProof(const CBlockIndex& block, const Consensus::Params& consensu
 // CBlock and CBlockIndex
 //
 
-static bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
+/** Serialize and compress data for a compressed record, false if it is not worth it */
+template <typename T>
+static bool CompressForDisk(const T& data, std::vector<unsigned char>& compressed)
+{
+    std::vector<unsigned char> raw;
+    CVectorWriter(SER_DISK, CLIENT_VERSION, raw, 0, data);
+    return CompressDiskRecord(raw.data(), raw.size(), compressed);
+}
+
+/** Write block to disk, or its record data if it is compressed (see DISK_RECORD_COMPRESSED) */
+static bool WriteBlockToDisk(const CBlock& block, const std::vector<unsigned char>& compressed, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
 {
+    unsigned int nSize = compressed.empty() ? GetSerializeSize(block, CLIENT_VERSION) : (compressed.size() | DISK_RECORD_COMPRESSED);
+
+    if (g_block_file_writer) {
+        // Queue the record at the position FindBlockPos reserved
+        std::vector<unsigned char> record;
+        CVectorWriter writer(SER_DISK, CLIENT_VERSION, record, 0, messageStart, nSize);
+        if (compressed.empty())
+            writer << block;
+        else
+            writer.write((const char*)compressed.data(), compressed.size());
+        CDiskBlockPos posRecord = pos;
+        pos.nPos += sizeof(messageStart) + sizeof(nSize);
+        return g_block_file_writer->Write(posRecord, false, std::move(record));
+    }
+
     // Open history file to append
     CAutoFile fileout(OpenBlockFile(pos), SER_DISK, CLIENT_VERSION);
     if (fileout.IsNull())
         return error("WriteBlockToDisk: OpenBlockFile failed");
 
     // Write index header
-    unsigned int nSize = GetSerializeSize(block, fileout.GetVersion());
     fileout << messageStart << nSize;
 
     // Write block
@@ -1274,24 +1480,51 @@ static bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMes
     if (fileOutPos < 0)
         return error("WriteBlockToDisk: ftell failed");
     pos.nPos = (unsigned int)fileOutPos;
-    fileout << block;
+    if (compressed.empty())
+        fileout << block;
+    else
+        fileout.write((const char*)compressed.data(), compressed.size());
 
     return true;
 }
 
+/** Read the block of the record filein is positioned at */
+template <typename Stream, typename Block>
+static void ReadBlockRecord(Stream& filein, Block& block)
+{
+    CMessageHeader::MessageStartChars blk_start;
+    unsigned int blk_size;
+    filein >> blk_start >> blk_size;
+    if (blk_size & DISK_RECORD_COMPRESSED) {
+        std::vector<unsigned char> raw;
+        ReadCompressedDiskRecord(filein, blk_size & ~DISK_RECORD_COMPRESSED, raw);
+        VectorReader(SER_DISK, CLIENT_VERSION, raw, 0) >> block;
+    } else {
+        filein >> block;
+    }
+}
+
 template <typename Block>
 bool ReadBlockFromDisk(Block& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
 {
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
-
-    // Read block
+    // Read block with its record header, which tells whether it is compressed, from the
+    // mapping of the file when it is finalized
+    CDiskBlockPos hpos = pos;
+    hpos.nPos -= 8;
+    std::shared_ptr<const MappedBlockFile> mapped = g_block_file_maps.Get(pos.nFile);
     try {
-        filein >> block;
+        if (mapped) {
+            BlockFileReader filein(SER_DISK, CLIENT_VERSION, *mapped, hpos.nPos);
+            ReadBlockRecord(filein, block);
+        } else {
+            // Open history file to read
+            CAutoFile filein(OpenBlockFile(hpos, true), SER_DISK, CLIENT_VERSION);
+            if (filein.IsNull())
+                return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+            ReadBlockRecord(filein, block);
+        }
     }
     catch (const std::exception& e) {
         return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
@@ -1323,39 +1556,56 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
     return true;
 }
 
+template <typename Stream>
+static bool ReadRawBlock(Stream& filein, std::vector<uint8_t>& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& message_start)
+{
+    CMessageHeader::MessageStartChars blk_start;
+    unsigned int blk_size;
+
+    filein >> blk_start >> blk_size;
+
+    if (memcmp(blk_start, message_start, CMessageHeader::MESSAGE_START_SIZE)) {
+        return error("%s: Block magic mismatch for %s: %s versus expected %s", __func__, pos.ToString(),
+                HexStr(blk_start, blk_start + CMessageHeader::MESSAGE_START_SIZE),
+                HexStr(message_start, message_start + CMessageHeader::MESSAGE_START_SIZE));
+    }
+
+    const bool fCompressed = blk_size & DISK_RECORD_COMPRESSED;
+    blk_size &= ~DISK_RECORD_COMPRESSED;
+    if (blk_size > MAX_SIZE) {
+        return error("%s: Block data is larger than maximum deserialization size for %s: %s versus %s", __func__, pos.ToString(),
+                blk_size, MAX_SIZE);
+    }
+
+    if (fCompressed) {
+        ReadCompressedDiskRecord(filein, blk_size, block);
+        return true;
+    }
+    block.resize(blk_size); // Zeroing of memory is intentional here
+    filein.read((char*)block.data(), blk_size);
+    return true;
+}
+
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& message_start)
 {
     CDiskBlockPos hpos = pos;
     hpos.nPos -= 8; // Seek back 8 bytes for meta header
-    CAutoFile filein(OpenBlockFile(hpos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull()) {
-        return error("%s: OpenBlockFile failed for %s", __func__, pos.ToString());
-    }
 
     try {
-        CMessageHeader::MessageStartChars blk_start;
-        unsigned int blk_size;
-
-        filein >> blk_start >> blk_size;
-
-        if (memcmp(blk_start, message_start, CMessageHeader::MESSAGE_START_SIZE)) {
-            return error("%s: Block magic mismatch for %s: %s versus expected %s", __func__, pos.ToString(),
-                    HexStr(blk_start, blk_start + CMessageHeader::MESSAGE_START_SIZE),
-                    HexStr(message_start, message_start + CMessageHeader::MESSAGE_START_SIZE));
+        std::shared_ptr<const MappedBlockFile> mapped = g_block_file_maps.Get(hpos.nFile);
+        if (mapped) {
+            BlockFileReader filein(SER_DISK, CLIENT_VERSION, *mapped, hpos.nPos);
+            return ReadRawBlock(filein, block, pos, message_start);
         }
 
-        if (blk_size > MAX_SIZE) {
-            return error("%s: Block data is larger than maximum deserialization size for %s: %s versus %s", __func__, pos.ToString(),
-                    blk_size, MAX_SIZE);
+        CAutoFile filein(OpenBlockFile(hpos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull()) {
+            return error("%s: OpenBlockFile failed for %s", __func__, pos.ToString());
         }
-
-        block.resize(blk_size); // Zeroing of memory is intentional here
-        filein.read((char*)block.data(), blk_size);
+        return ReadRawBlock(filein, block, pos, message_start);
     } catch(const std::exception& e) {
         return error("%s: Read from block file failed: %s for %s", __func__, e.what(), pos.ToString());
     }
-
-    return true;
 }
 
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start)
@@ -1576,6 +1826,7 @@ int GetSpendHeight(const CCoinsViewCache& inputs)
 
 static CuckooCache::cache<uint256, SignatureCacheHasher> scriptExecutionCache;
 static uint256 scriptExecutionCacheNonce(GetRandHash());
+static SignatureCacheStats scriptExecutionCacheStats GUARDED_BY(cs_main);
 
 void InitScriptExecutionCache() {
     // nMaxCacheSize is unsigned. If -maxsigcachesize is set to zero,
@@ -1586,6 +1837,55 @@ void InitScriptExecutionCache() {
             (nElems*sizeof(uint256)) >>20, (nMaxCacheSize*2)>>20, nElems);
 }
 
+SignatureCacheStats GetScriptExecutionCacheStats()
+{
+    LOCK(cs_main);
+    SignatureCacheStats stats = scriptExecutionCacheStats;
+    stats.nEvictions = scriptExecutionCache.evicted();
+    stats.nCapacity = scriptExecutionCache.capacity();
+    return stats;
+}
+
+bool GrowScriptExecutionCache(size_t nMaxBytes)
+{
+    LOCK(cs_main);
+    const size_t nElems = std::min<size_t>(nMaxBytes / sizeof(uint256), std::numeric_limits<uint32_t>::max() / 2);
+    if (nElems <= scriptExecutionCache.capacity())
+        return false;
+    scriptExecutionCache.resize(std::min<size_t>(nElems, (size_t)scriptExecutionCache.capacity() * 2));
+    return true;
+}
+
+/**
+ * The script execution cache also records the transactions whose CheckOpSender and
+ * CheckSenderScript passed on mempool entry. Like the script entries these rely on the
+ * prevouts committing to the sender's scriptPubKey; the 64 byte preimage keeps them
+ * apart from the 55 byte script entries.
+ */
+static uint256 SenderCheckCacheEntry(const CTransaction& tx)
+{
+    uint256 hashCacheEntry;
+    CSHA256().Write(scriptExecutionCacheNonce.begin(), 32).Write(tx.GetWitnessHash().begin(), 32).Finalize(hashCacheEntry.begin());
+    return hashCacheEntry;
+}
+
+static void AddSenderCheckCache(const CTransaction& tx)
+{
+    AssertLockHeld(cs_main);
+    ++scriptExecutionCacheStats.nInsertions;
+    scriptExecutionCache.insert(SenderCheckCacheEntry(tx));
+}
+
+static bool IsSenderCheckCached(const CTransaction& tx, bool erase)
+{
+    AssertLockHeld(cs_main);
+    ++scriptExecutionCacheStats.nLookups;
+    if (!scriptExecutionCache.contains(SenderCheckCacheEntry(tx), erase))
+        return false;
+    ++scriptExecutionCacheStats.nHits;
+    return true;
+}
+
 /**
  * Check whether all inputs of this transaction are valid (no double spends, scripts & sigs, amounts)
  * This does not modify the UTXO set.
@@ -1628,7 +1928,9 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
             static_assert(55 - sizeof(flags) - 32 >= 128/8, "Want at least 128 bits of nonce for script execution cache");
             CSHA256().Write(scriptExecutionCacheNonce.begin(), 55 - sizeof(flags) - 32).Write(tx.GetWitnessHash().begin(), 32).Write((unsigned char*)&flags, sizeof(flags)).Finalize(hashCacheEntry.begin());
             AssertLockHeld(cs_main); //TODO: Remove this requirement by making CuckooCache not require external locks
+            ++scriptExecutionCacheStats.nLookups;
             if (scriptExecutionCache.contains(hashCacheEntry, !cacheFullScriptStore)) {
+                ++scriptExecutionCacheStats.nHits;
                 return true;
             }
 
@@ -1689,6 +1991,7 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
             if (cacheFullScriptStore && !pvChecks) {
                 // We executed all of the provided scripts, and were told to
                 // cache the result. Do so now.
+                ++scriptExecutionCacheStats.nInsertions;
                 scriptExecutionCache.insert(hashCacheEntry);
             }
         }
@@ -1699,15 +2002,35 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
 
 namespace {
 
-bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint256& hashBlock, const CMessageHeader::MessageStartChars& messageStart)
+bool UndoWriteToDisk(const CBlockUndo& blockundo, const std::vector<unsigned char>& compressed, CDiskBlockPos& pos, const uint256& hashBlock, const CMessageHeader::MessageStartChars& messageStart)
 {
+    unsigned int nSize = compressed.empty() ? GetSerializeSize(blockundo, CLIENT_VERSION) : (compressed.size() | DISK_RECORD_COMPRESSED);
+
+    // calculate checksum
+    CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
+    hasher << hashBlock;
+    hasher << blockundo;
+
+    if (g_block_file_writer) {
+        // Queue the record at the position FindUndoPos reserved
+        std::vector<unsigned char> record;
+        CVectorWriter writer(SER_DISK, CLIENT_VERSION, record, 0, messageStart, nSize);
+        if (compressed.empty())
+            writer << blockundo;
+        else
+            writer.write((const char*)compressed.data(), compressed.size());
+        writer << hasher.GetHash();
+        CDiskBlockPos posRecord = pos;
+        pos.nPos += sizeof(messageStart) + sizeof(nSize);
+        return g_block_file_writer->Write(posRecord, true, std::move(record));
+    }
+
     // Open history file to append
     CAutoFile fileout(OpenUndoFile(pos), SER_DISK, CLIENT_VERSION);
     if (fileout.IsNull())
         return error("%s: OpenUndoFile failed", __func__);
 
     // Write index header
-    unsigned int nSize = GetSerializeSize(blockundo, fileout.GetVersion());
     fileout << messageStart << nSize;
 
     // Write undo data
@@ -1715,35 +2038,53 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
     if (fileOutPos < 0)
         return error("%s: ftell failed", __func__);
     pos.nPos = (unsigned int)fileOutPos;
-    fileout << blockundo;
+    if (compressed.empty())
+        fileout << blockundo;
+    else
+        fileout.write((const char*)compressed.data(), compressed.size());
 
-    // calculate & write checksum
-    CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
-    hasher << hashBlock;
-    hasher << blockundo;
+    // write checksum
     fileout << hasher.GetHash();
 
     return true;
 }
 
-static bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
 {
     CDiskBlockPos pos = pindex->GetUndoPos();
     if (pos.IsNull()) {
         return error("%s: no undo data available", __func__);
     }
 
-    // Open history file to read
-    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
+    // Open history file to read, at the record header
+    CDiskBlockPos hpos = pos;
+    hpos.nPos -= 8;
+    CAutoFile filein(OpenUndoFile(hpos, true), SER_DISK, CLIENT_VERSION);
     if (filein.IsNull())
         return error("%s: OpenUndoFile failed", __func__);
 
     // Read block
     uint256 hashChecksum;
+    uint256 hashData;
     CHashVerifier<CAutoFile> verifier(&filein); // We need a CHashVerifier as reserializing may lose data
     try {
-        verifier << pindex->pprev->GetBlockHash();
-        verifier >> blockundo;
+        CMessageHeader::MessageStartChars undo_start;
+        unsigned int undo_size;
+        filein >> undo_start >> undo_size;
+        if (undo_size & DISK_RECORD_COMPRESSED) {
+            // The checksum is of the uncompressed data
+            std::vector<unsigned char> raw;
+            ReadCompressedDiskRecord(filein, undo_size & ~DISK_RECORD_COMPRESSED, raw);
+            CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
+            hasher << pindex->pprev->GetBlockHash();
+            hasher.write((const char*)raw.data(), raw.size());
+            hashData = hasher.GetHash();
+            VectorReader(SER_DISK, CLIENT_VERSION, raw, 0) >> blockundo;
+        } else {
+            verifier << pindex->pprev->GetBlockHash();
+            verifier >> blockundo;
+            hashData = verifier.GetHash();
+        }
         filein >> hashChecksum;
     }
     catch (const std::exception& e) {
@@ -1751,14 +2092,15 @@ static bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
     }
 
     // Verify checksum
-    if (hashChecksum != verifier.GetHash())
+    if (hashChecksum != hashData)
         return error("%s: Checksum mismatch", __func__);
 
     return true;
 }
 
-/** Abort with a message */
-static bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
+} // namespace
+
+bool AbortNode(const std::string& strMessage, const std::string& userMessage)
 {
     SetMiscWarning(strMessage);
     LogPrintf("*** %s\n", strMessage);
@@ -1769,6 +2111,8 @@ static bool AbortNode(const std::string& strMessage, const std::string& userMess
     return false;
 }
 
+namespace {
+
 static bool AbortNode(CValidationState& state, const std::string& strMessage, const std::string& userMessage="")
 {
     AbortNode(strMessage, userMessage);
@@ -1813,31 +2157,28 @@ int ApplyTxInUndo(Coin&& undo, CCoinsViewCache& view, const COutPoint& out)
 
 /** Undo the effects of this block (with given index) on the UTXO set represented by coins.
  *  When FAILED is returned, view is left in an indeterminate state. */
-DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view, bool* pfClean)
+DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view, bool* pfClean, const CBlockUndo* pblockundo)
 {
     assert(pindex->GetBlockHash() == view.GetBestBlock());
     if (pfClean)
         *pfClean = false;
     bool fClean = true;
 
-    CBlockUndo blockUndo;
-    if (!UndoReadFromDisk(blockUndo, pindex)) {
-        error("DisconnectBlock(): failure reading undo data");
-        return DISCONNECT_FAILED;
+    CBlockUndo blockUndoRead;
+    if (!pblockundo) {
+        if (!UndoReadFromDisk(blockUndoRead, pindex)) {
+            error("DisconnectBlock(): failure reading undo data");
+            return DISCONNECT_FAILED;
+        }
+        pblockundo = &blockUndoRead;
     }
+    const CBlockUndo& blockUndo = *pblockundo;
 
     if (blockUndo.vtxundo.size() + 1 != block.vtx.size()) {
         error("DisconnectBlock(): block and undo data inconsistent");
         return DISCONNECT_FAILED;
     }
 
-#ifdef ENABLE_BITCORE_RPC
-    /////////////////////////////////////////////////////////// // kpg
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
-    ///////////////////////////////////////////////////////////
-#endif
-
     // undo transactions in reverse order
     for (int i = block.vtx.size() - 1; i >= 0; i--) {
         const CTransaction &tx = *(block.vtx[i]);
@@ -1858,34 +2199,9 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
             }
         }
 
-#ifdef ENABLE_BITCORE_RPC
-        /////////////////////////////////////////////////////////// // kpg
-        if (pfClean == NULL && fAddressIndex) {
-
-            for (unsigned int k = tx.vout.size(); k-- > 0;) {
-                const CTxOut &out = tx.vout[k];
-
-                CTxDestination dest;
-                if (ExtractDestination({hash, k}, out.scriptPubKey, dest)) {
-                    valtype bytesID(boost::apply_visitor(DataVisitor(), dest));
-                    if(bytesID.empty()) {
-                        continue;
-                    }
-                    valtype addressBytes(32);
-                    std::copy(bytesID.begin(), bytesID.end(), addressBytes.begin());
-                    // undo receiving activity
-                    addressIndex.push_back(std::make_pair(CAddressIndexKey(dest.which(), uint256(addressBytes), pindex->nHeight, i, hash, k, false), out.nValue));
-                    // undo unspent index
-                    addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(dest.which(), uint256(addressBytes), hash, k), CAddressUnspentValue()));
-                }
-            }
-        }
-        ///////////////////////////////////////////////////////////
-#endif
-
         // restore inputs
         if (i > 0) { // not coinbases
-            CTxUndo &txundo = blockUndo.vtxundo[i-1];
+            const CTxUndo &txundo = blockUndo.vtxundo[i-1];
             if (txundo.vprevout.size() != tx.vin.size()) {
                 error("DisconnectBlock(): transaction and undo data inconsistent");
                 return DISCONNECT_FAILED;
@@ -1895,29 +2211,6 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
                 int res = ApplyTxInUndo(std::move(txundo.vprevout[j]), view, out);
                 if (res == DISCONNECT_FAILED) return DISCONNECT_FAILED;
                 fClean = fClean && res != DISCONNECT_UNCLEAN;
-
-#ifdef ENABLE_BITCORE_RPC
-                const auto &undo = txundo.vprevout[j];
-                const bool isTxCoinStake = tx.IsCoinStake();
-                const CTxIn input = tx.vin[j];
-                if (pfClean == NULL && fAddressIndex) {
-                    const CTxOut &prevout = view.GetOutputFor(input);
-
-                    CTxDestination dest;
-                    if (ExtractDestination(input.prevout, prevout.scriptPubKey, dest)) {
-                        valtype bytesID(boost::apply_visitor(DataVisitor(), dest));
-                        if(bytesID.empty()) {
-                            continue;
-                        }
-                        valtype addressBytes(32);
-                        std::copy(bytesID.begin(), bytesID.end(), addressBytes.begin());
-                        // undo spending activity
-                        addressIndex.push_back(std::make_pair(CAddressIndexKey(dest.which(), uint256(addressBytes), pindex->nHeight, i, hash, j, true), prevout.nValue * -1));
-                        // restore unspent index
-                        addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(dest.which(), uint256(addressBytes), input.prevout.hash, input.prevout.n), CAddressUnspentValue(prevout.nValue, prevout.scriptPubKey, undo.nHeight, isTxCoinStake)));
-                    }
-                }
-#endif
             }
             // At this point, all of txundo.vprevout should have been moved out.
         }
@@ -1929,26 +2222,8 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
     globalState->setRoot(uintToh256(pindex->pprev->hashStateRoot)); // kpg
     globalState->setRootUTXO(uintToh256(pindex->pprev->hashUTXORoot)); // kpg
 
-    if(pfClean == NULL && fLogEvents){
-        pstorageresult->deleteResults(block.vtx);
-        pblocktree->EraseHeightIndex(pindex->nHeight);
-    }
     pblocktree->EraseStakeIndex(pindex->nHeight);
-
-#ifdef ENABLE_BITCORE_RPC
-    //////////////////////////////////////////////////// // kpg
-    if (pfClean == NULL && fAddressIndex) {
-        if (!pblocktree->EraseAddressIndex(addressIndex)) {
-            error("Failed to delete address index");
-            return DISCONNECT_FAILED;
-        }
-        if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
-            error("Failed to write address unspent index");
-            return DISCONNECT_FAILED;
-        }
-    }
-    ////////////////////////////////////////////////////
-#endif
+    RemoveMPoSStakerFromCache(pindex);
 
     return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
 }
@@ -1957,6 +2232,21 @@ void static FlushBlockFile(bool fFinalize = false)
 {
     LOCK(cs_LastBlockFile);
 
+    if (g_block_file_writer) {
+        if (fFinalize) {
+            // The writer thread truncates and syncs the file after its queued records
+            if (!g_block_file_writer->Finalize(CDiskBlockPos(nLastBlockFile, vinfoBlockFile[nLastBlockFile].nSize), false) ||
+                !g_block_file_writer->Finalize(CDiskBlockPos(nLastBlockFile, vinfoBlockFile[nLastBlockFile].nUndoSize), true)) {
+                AbortNode("Writing block file to disk failed. This is likely the result of an I/O error.");
+            }
+            return;
+        }
+        if (!g_block_file_writer->Flush()) {
+            AbortNode("Writing block file to disk failed. This is likely the result of an I/O error.");
+            return;
+        }
+    }
+
     CDiskBlockPos posOld(nLastBlockFile, 0);
     bool status = true;
 
@@ -1988,9 +2278,13 @@ static bool WriteUndoDataForBlock(const CBlockUndo& blockundo, CValidationState&
     // Write undo information to disk
     if (pindex->GetUndoPos().IsNull()) {
         CDiskBlockPos _pos;
-        if (!FindUndoPos(state, pindex->nFile, _pos, ::GetSerializeSize(blockundo, CLIENT_VERSION) + 40))
+        std::vector<unsigned char> compressed;
+        if (fCompressBlocks)
+            CompressForDisk(blockundo, compressed);
+        unsigned int nUndoSize = compressed.empty() ? ::GetSerializeSize(blockundo, CLIENT_VERSION) : compressed.size();
+        if (!FindUndoPos(state, pindex->nFile, _pos, nUndoSize + 40))
             return error("ConnectBlock(): FindUndoPos failed");
-        if (!UndoWriteToDisk(blockundo, _pos, pindex->pprev->GetBlockHash(), chainparams.MessageStart()))
+        if (!UndoWriteToDisk(blockundo, compressed, _pos, pindex->pprev->GetBlockHash(), chainparams.MessageStart()))
             return AbortNode(state, "Failed to write undo data");
 
         // update nUndoPos in block index
@@ -2009,79 +2303,366 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
-VersionBitsCache versionbitscache GUARDED_BY(cs_main);
-
-int32_t ComputeBlockVersion(const CBlockIndex* pindexPrev, const Consensus::Params& params)
+/** How the contract speculations of one block fared, reported with -debug=bench */
+struct CContractSpeculationStats
 {
-    LOCK(cs_main);
-    int32_t nVersion = VERSIONBITS_TOP_BITS;
-
-    for (int i = 0; i < (int)Consensus::MAX_VERSION_BITS_DEPLOYMENTS; i++) {
-        ThresholdState state = VersionBitsState(pindexPrev, params, static_cast<Consensus::DeploymentPos>(i), versionbitscache);
-        if (state == ThresholdState::LOCKED_IN || state == ThresholdState::STARTED) {
-            nVersion |= VersionBitsMask(params, static_cast<Consensus::DeploymentPos>(i));
-        }
-    }
-
-    return nVersion;
-}
+    //! Speculations that finished before the serial pass reached their transaction
+    std::atomic<unsigned int> nAhead{0};
+    //! Speculations that executed, whether or not they finished in time
+    std::atomic<unsigned int> nRun{0};
+    //! Time spent executing them, in microseconds
+    std::atomic<int64_t> nTime{0};
+};
 
 /**
- * Threshold condition checker that triggers when unknown versionbits are seen on the network.
+ * Speculative execution of the contract outputs of one block transaction.
+ *
+ * The transaction is executed with Permanence::Reverted on a private fork of the
+ * pre-block state while ConnectBlock executes the block serially. Transactions
+ * that do not depend on earlier contract transactions of the block read exactly the
+ * accounts, storage slots and UTXO vins the serial pass will read, so by the time
+ * the serial pass reaches them the trie nodes are hot in the state database caches.
+ * The serial pass stays authoritative: speculative results are never committed, and
+ * a speculation is skipped once the serial pass has already passed its transaction.
+ *
+ * This is a prefetch, not optimistic concurrency control. Validating and applying a
+ * speculation instead of executing the transaction again would need its read and write
+ * sets and a way to merge account changes into the global state, neither of which
+ * dev::eth::State provides. Nothing a speculation does is written to the databases, and
+ * it reads the block index only through pindexPrev and its ancestors, which do not change,
+ * so it runs without cs_main.
  */
-class WarningBitsConditionChecker : public AbstractThresholdConditionChecker
+class CContractSpeculation
 {
 private:
-    int bit;
+    const CBlock* block;
+    CBlockIndex* pindexPrev;
+    std::vector<QtumTransaction> txs;
+    uint64_t blockGasLimit;
+    std::shared_ptr<const dev::eth::EVMSchedule> schedule;
+    std::shared_ptr<const QtumState> stateBase;
+    const std::atomic<unsigned int>* pnSerialPos;
+    unsigned int nTx;
+    CContractSpeculationStats* pstats;
 
 public:
-    explicit WarningBitsConditionChecker(int bitIn) : bit(bitIn) {}
+    CContractSpeculation() : block(nullptr), pindexPrev(nullptr), blockGasLimit(0), pnSerialPos(nullptr), nTx(0), pstats(nullptr) {}
+    CContractSpeculation(const CBlock& blockIn, CBlockIndex* pindexPrevIn, std::vector<QtumTransaction>&& txsIn, uint64_t blockGasLimitIn,
+                         const std::shared_ptr<const dev::eth::EVMSchedule>& scheduleIn, const std::shared_ptr<const QtumState>& stateBaseIn,
+                         const std::atomic<unsigned int>* pnSerialPosIn, unsigned int nTxIn, CContractSpeculationStats* pstatsIn) :
+        block(&blockIn), pindexPrev(pindexPrevIn), txs(std::move(txsIn)), blockGasLimit(blockGasLimitIn), schedule(scheduleIn),
+        stateBase(stateBaseIn), pnSerialPos(pnSerialPosIn), nTx(nTxIn), pstats(pstatsIn) {}
+
+    bool operator()();
+
+    void swap(CContractSpeculation& check) {
+        std::swap(block, check.block);
+        std::swap(pindexPrev, check.pindexPrev);
+        txs.swap(check.txs);
+        std::swap(blockGasLimit, check.blockGasLimit);
+        schedule.swap(check.schedule);
+        stateBase.swap(check.stateBase);
+        std::swap(pnSerialPos, check.pnSerialPos);
+        std::swap(nTx, check.nTx);
+        std::swap(pstats, check.pstats);
+    }
+};
 
-    int64_t BeginTime(const Consensus::Params& params) const override { return 0; }
-    int64_t EndTime(const Consensus::Params& params) const override { return std::numeric_limits<int64_t>::max(); }
-    int Period(const Consensus::Params& params) const override { return params.nMinerConfirmationWindow; }
-    int Threshold(const Consensus::Params& params) const override { return params.nRuleChangeActivationThreshold; }
+/**
+ * Seal engine of the calling thread with the gas schedule set; the global one is not safe
+ * to share during execution. The schedule is only copied into the engine when it changes,
+ * the held reference keeps its address from being reused by another schedule.
+ */
+static dev::eth::SealEngineFace* GetThreadSealEngine(const std::shared_ptr<const dev::eth::EVMSchedule>& schedule)
+{
+    static thread_local std::unique_ptr<dev::eth::SealEngineFace> sealEngine;
+    static thread_local std::shared_ptr<const dev::eth::EVMSchedule> sealSchedule;
+    if (!sealEngine) {
+        dev::eth::ChainParams cp((Params().EVMGenesisInfo(dev::eth::Network::qtumMainNetwork)));
+        sealEngine.reset(cp.createSealEngine());
+    }
+    if (sealSchedule != schedule) {
+        sealEngine->setQtumSchedule(*schedule);
+        sealSchedule = schedule;
+    }
+    return sealEngine.get();
+}
 
-    bool Condition(const CBlockIndex* pindex, const Consensus::Params& params) const override
-    {
-        return ((pindex->nVersion & VERSIONBITS_TOP_MASK) == VERSIONBITS_TOP_BITS) &&
-               ((pindex->nVersion >> bit) & 1) != 0 &&
-               ((ComputeBlockVersion(pindex->pprev, params) >> bit) & 1) == 0;
+bool CContractSpeculation::operator()()
+{
+    if (pnSerialPos->load(std::memory_order_relaxed) >= nTx)
+        return true;
+
+    int64_t nTimeStart = GetTimeMicros();
+    dev::eth::SealEngineFace* sealEngine = GetThreadSealEngine(schedule);
+    QtumState stateFork(*stateBase);
+    try {
+        ByteCodeExec exec(*block, txs, blockGasLimit, pindexPrev, &stateFork, sealEngine);
+        // The fork shares the databases of the global state, which the serial pass writes
+        exec.performByteCode(dev::eth::Permanence::Reverted, false);
+    } catch (const std::exception& e) {
+        LogPrint(BCLog::BENCH, "%s: speculative execution of tx %u failed: %s\n", __func__, nTx, e.what());
     }
-};
+    pstats->nTime += GetTimeMicros() - nTimeStart;
+    pstats->nRun++;
+    if (pnSerialPos->load(std::memory_order_relaxed) < nTx)
+        pstats->nAhead++;
+    return true;
+}
 
-static ThresholdConditionCache warningcache[VERSIONBITS_NUM_BITS] GUARDED_BY(cs_main);
+//! Dry runs of EstimateContractGas, most recently used at the front
+static std::list<std::pair<std::string, ContractGasEstimate>> g_gas_estimates GUARDED_BY(cs_main);
+static std::unordered_map<std::string, std::list<std::pair<std::string, ContractGasEstimate>>::iterator> g_gas_estimate_map GUARDED_BY(cs_main);
 
-// 0.13.0 was shipped with a segwit deployment defined for testnet, but not for
-// mainnet. We no longer need to support disabling the segwit deployment
-// except for testing purposes, due to limitations of the functional test
-// environment. See test/functional/p2p-segwit.py.
-static bool IsScriptWitnessEnabled(const Consensus::Params& params)
+/** Key of a dry run in g_gas_estimates, a null contract for a creation */
+static std::string GasEstimateKey(const dev::Address& sender, const dev::Address& addrContract, const std::vector<unsigned char>& data,
+    const dev::u256& value, const uint256& hashStateRoot, const uint256& hashUTXORoot)
 {
-    return params.vDeployments[Consensus::DEPLOYMENT_SEGWIT].nTimeout != 0;
+    dev::h256 valueBytes(value);
+    std::string key;
+    key.reserve(sender.size + addrContract.size + valueBytes.size + 2 * hashStateRoot.size() + data.size());
+    key.append((const char*)sender.data(), sender.size);
+    key.append((const char*)addrContract.data(), addrContract.size);
+    key.append((const char*)valueBytes.data(), valueBytes.size);
+    key.append((const char*)hashStateRoot.begin(), hashStateRoot.size());
+    key.append((const char*)hashUTXORoot.begin(), hashUTXORoot.size());
+    key.append(data.begin(), data.end());
+    return key;
+}
+
+static bool LookupGasEstimate(const std::string& key, ContractGasEstimate& estimate) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    auto it = g_gas_estimate_map.find(key);
+    if (it == g_gas_estimate_map.end())
+        return false;
+    g_gas_estimates.splice(g_gas_estimates.begin(), g_gas_estimates, it->second);
+    estimate = it->second->second;
+    return true;
+}
+
+static void AddGasEstimate(const std::string& key, const ContractGasEstimate& estimate) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    if (g_gas_estimate_map.count(key))
+        return;
+    g_gas_estimates.emplace_front(key, estimate);
+    g_gas_estimate_map.emplace(key, g_gas_estimates.begin());
+    if (g_gas_estimates.size() > MAX_GAS_ESTIMATE_CACHE_ENTRIES) {
+        g_gas_estimate_map.erase(g_gas_estimates.back().first);
+        g_gas_estimates.pop_back();
+    }
 }
 
-static unsigned int GetBlockScriptFlags(const CBlockIndex* pindex, const Consensus::Params& consensusparams) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+/** Execute the contracts of a tx entering the mempool on a fork of the tip state, for -mempoolpreexec */
+static ContractPreExecution PreExecuteContracts(const std::vector<QtumTransaction>& txs)
+{
     AssertLockHeld(cs_main);
 
-    unsigned int flags = SCRIPT_VERIFY_NONE;
+    CBlockIndex* pindexTip = chainActive.Tip();
 
-    // BIP16 didn't become active until Apr 1 2012 (on mainnet, and
-    // retroactively applied to testnet)
-    // However, only one historical block violated the P2SH rules (on both
-    // mainnet and testnet), so for simplicity, always leave P2SH
-    // on except for the one violating block.
-    if (consensusparams.BIP16Exception.IsNull() || // no bip16 exception on this chain
-        pindex->phashBlock == nullptr || // this is a new candidate block, eg from TestBlockValidity()
-        *pindex->phashBlock != consensusparams.BIP16Exception) // this block isn't the historical exception
-    {
-        flags |= SCRIPT_VERIFY_P2SH;
+    // The dry run of the same call on the same state, if one was made, stands for the
+    // execution when it did not need more gas than the tx has
+    if (txs.size() == 1) {
+        const QtumTransaction& tx = txs[0];
+        ContractGasEstimate estimate;
+        if (LookupGasEstimate(GasEstimateKey(tx.sender(), tx.isCreation() ? dev::Address() : tx.receiveAddress(), tx.data(), tx.value(),
+                pindexTip->hashStateRoot, pindexTip->hashUTXORoot), estimate) && estimate.nGasUsed < tx.gas()) {
+            ContractPreExecution pre;
+            pre.hashTip = pindexTip->GetBlockHash();
+            pre.nGasUsed = estimate.nGasUsed;
+            pre.nTime = estimate.nTime;
+            pre.fExcepted = estimate.excepted != dev::eth::TransactionException::None;
+            pre.fEstimated = true;
+            return pre;
+        }
     }
 
-    // Enforce WITNESS rules whenever P2SH is in effect (and the segwit
-    // deployment is defined).
-    if (flags & SCRIPT_VERIFY_P2SH && IsScriptWitnessEnabled(consensusparams)) {
-        flags |= SCRIPT_VERIFY_WITNESS;
+    QtumDGP qtumDGP(globalState.get(), fGettingValuesDGP);
+    uint64_t blockGasLimit = qtumDGP.getBlockGasLimit(pindexTip->nHeight + 1);
+    dev::eth::SealEngineFace* sealEngine = GetThreadSealEngine(qtumDGP.getSharedGasSchedule(pindexTip->nHeight + 1));
+
+    // The block only provides the environment of the execution: time, bits and an empty author
+    CBlock block;
+    CMutableTransaction coinbase;
+    coinbase.vout.resize(1);
+    block.vtx.push_back(MakeTransactionRef(std::move(coinbase)));
+    block.nTime = GetAdjustedTime();
+    block.nBits = pindexTip->nBits;
+
+    ContractPreExecution pre;
+    QtumState stateFork(*globalState);
+    int64_t nTimeStart = GetTimeMicros();
+    try {
+        ByteCodeExec exec(block, txs, blockGasLimit, pindexTip, &stateFork, sealEngine);
+        // The fork shares the databases of the global state, which ConnectBlock writes
+        exec.performByteCode(dev::eth::Permanence::Reverted, false);
+        for (const ResultExecute& result : exec.getResult()) {
+            pre.nGasUsed += (uint64_t)result.execRes.gasUsed;
+            pre.fExcepted |= result.execRes.excepted != dev::eth::TransactionException::None;
+        }
+    } catch (const std::exception& e) {
+        LogPrint(BCLog::MEMPOOL, "%s: %s\n", __func__, e.what());
+        return ContractPreExecution();
+    }
+    pre.nTime = GetTimeMicros() - nTimeStart;
+    pre.hashTip = pindexTip->GetBlockHash();
+    return pre;
+}
+
+/** Memory a contract extraction adds to the mempool entry that keeps it */
+static size_t ContractExtractionUsage(const ContractExtraction& extraction)
+{
+    size_t usage = memusage::MallocUsage(sizeof(ContractExtraction)) +
+        memusage::DynamicUsage(extraction.extracted.first) + memusage::DynamicUsage(extraction.extracted.second);
+    for (const QtumTransaction& qtx : extraction.extracted.first)
+        usage += memusage::MallocUsage(qtx.data().size());
+    for (const EthTransactionParams& etp : extraction.extracted.second)
+        usage += memusage::DynamicUsage(etp.code);
+    return usage;
+}
+
+/** Marks all speculations of a block as obsolete when ConnectBlock leaves the serial pass */
+class CContractSpeculationGuard
+{
+    std::atomic<unsigned int>& nSerialPos;
+public:
+    explicit CContractSpeculationGuard(std::atomic<unsigned int>& nSerialPosIn) : nSerialPos(nSerialPosIn) {}
+    ~CContractSpeculationGuard() { nSerialPos.store(std::numeric_limits<unsigned int>::max(), std::memory_order_relaxed); }
+};
+
+static CCheckQueue<CContractSpeculation> contractspeculationqueue(1);
+
+void ThreadContractSpeculation() {
+    RenameThread("bitcoin-contractspec");
+    contractspeculationqueue.Thread();
+}
+
+
+/**
+ * Context-free work spread over the precheck threads by the threads handling
+ * blocks and headers from the network: the signer recovery of the proof-of-stake
+ * headers of a headers message, and the transaction checks of large blocks in
+ * CheckBlock. Each check writes its result to a slot of its caller and never fails,
+ * so that the caller can report errors in the order of the serial checks.
+ */
+class CPrecheck
+{
+private:
+    std::function<void()> func;
+
+public:
+    CPrecheck() {}
+    explicit CPrecheck(std::function<void()>&& funcIn) : func(std::move(funcIn)) {}
+
+    bool operator()() {
+        func();
+        return true;
+    }
+
+    void swap(CPrecheck& check) {
+        func.swap(check.func);
+    }
+};
+
+static CCheckQueue<CPrecheck> precheckqueue(8);
+
+void ThreadPrecheck() {
+    RenameThread("bitcoin-precheck");
+    precheckqueue.Thread();
+}
+
+/** Number of items of a part of ParallelForRanges */
+static const size_t PARALLEL_RANGE_SIZE = 256;
+
+void ParallelForRanges(size_t n, const std::function<void(size_t, size_t)>& fn)
+{
+    if (!nScriptCheckThreads || n <= PARALLEL_RANGE_SIZE) {
+        fn(0, n);
+        return;
+    }
+    std::vector<CPrecheck> vChecks;
+    vChecks.reserve((n + PARALLEL_RANGE_SIZE - 1) / PARALLEL_RANGE_SIZE);
+    for (size_t begin = 0; begin < n; begin += PARALLEL_RANGE_SIZE) {
+        size_t end = std::min(n, begin + PARALLEL_RANGE_SIZE);
+        vChecks.emplace_back([&fn, begin, end] { fn(begin, end); });
+    }
+    CCheckQueueControl<CPrecheck> control(&precheckqueue);
+    control.Add(vChecks);
+    control.Wait();
+}
+
+VersionBitsCache versionbitscache GUARDED_BY(cs_main);
+
+int32_t ComputeBlockVersion(const CBlockIndex* pindexPrev, const Consensus::Params& params)
+{
+    LOCK(cs_main);
+    int32_t nVersion = VERSIONBITS_TOP_BITS;
+
+    for (int i = 0; i < (int)Consensus::MAX_VERSION_BITS_DEPLOYMENTS; i++) {
+        ThresholdState state = VersionBitsState(pindexPrev, params, static_cast<Consensus::DeploymentPos>(i), versionbitscache);
+        if (state == ThresholdState::LOCKED_IN || state == ThresholdState::STARTED) {
+            nVersion |= VersionBitsMask(params, static_cast<Consensus::DeploymentPos>(i));
+        }
+    }
+
+    return nVersion;
+}
+
+/**
+ * Threshold condition checker that triggers when unknown versionbits are seen on the network.
+ */
+class WarningBitsConditionChecker : public AbstractThresholdConditionChecker
+{
+private:
+    int bit;
+
+public:
+    explicit WarningBitsConditionChecker(int bitIn) : bit(bitIn) {}
+
+    int64_t BeginTime(const Consensus::Params& params) const override { return 0; }
+    int64_t EndTime(const Consensus::Params& params) const override { return std::numeric_limits<int64_t>::max(); }
+    int Period(const Consensus::Params& params) const override { return params.nMinerConfirmationWindow; }
+    int Threshold(const Consensus::Params& params) const override { return params.nRuleChangeActivationThreshold; }
+
+    bool Condition(const CBlockIndex* pindex, const Consensus::Params& params) const override
+    {
+        return ((pindex->nVersion & VERSIONBITS_TOP_MASK) == VERSIONBITS_TOP_BITS) &&
+               ((pindex->nVersion >> bit) & 1) != 0 &&
+               ((ComputeBlockVersion(pindex->pprev, params) >> bit) & 1) == 0;
+    }
+};
+
+static ThresholdConditionCache warningcache[VERSIONBITS_NUM_BITS] GUARDED_BY(cs_main);
+
+// 0.13.0 was shipped with a segwit deployment defined for testnet, but not for
+// mainnet. We no longer need to support disabling the segwit deployment
+// except for testing purposes, due to limitations of the functional test
+// environment. See test/functional/p2p-segwit.py.
+static bool IsScriptWitnessEnabled(const Consensus::Params& params)
+{
+    return params.vDeployments[Consensus::DEPLOYMENT_SEGWIT].nTimeout != 0;
+}
+
+static unsigned int ComputeBlockScriptFlags(const CBlockIndex* pindex, const Consensus::Params& consensusparams) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+    AssertLockHeld(cs_main);
+
+    unsigned int flags = SCRIPT_VERIFY_NONE;
+
+    // BIP16 didn't become active until Apr 1 2012 (on mainnet, and
+    // retroactively applied to testnet)
+    // However, only one historical block violated the P2SH rules (on both
+    // mainnet and testnet), so for simplicity, always leave P2SH
+    // on except for the one violating block.
+    if (consensusparams.BIP16Exception.IsNull() || // no bip16 exception on this chain
+        pindex->phashBlock == nullptr || // this is a new candidate block, eg from TestBlockValidity()
+        *pindex->phashBlock != consensusparams.BIP16Exception) // this block isn't the historical exception
+    {
+        flags |= SCRIPT_VERIFY_P2SH;
+    }
+
+    // Enforce WITNESS rules whenever P2SH is in effect (and the segwit
+    // deployment is defined).
+    if (flags & SCRIPT_VERIFY_P2SH && IsScriptWitnessEnabled(consensusparams)) {
+        flags |= SCRIPT_VERIFY_WITNESS;
     }
 
     // Start enforcing the DERSIG (BIP66) rule
@@ -2111,6 +2692,34 @@ static unsigned int GetBlockScriptFlags(const CBlockIndex* pindex, const Consens
     return flags;
 }
 
+/** The script flags of the block index they were last computed for */
+struct BlockScriptFlagsCache
+{
+    const CBlockIndex* pindex = nullptr;
+    uint256 hashBlock;
+    const Consensus::Params* consensusparams = nullptr;
+    unsigned int flags = 0;
+};
+
+static BlockScriptFlagsCache g_block_script_flags GUARDED_BY(cs_main);
+
+unsigned int GetBlockScriptFlags(const CBlockIndex* pindex, const Consensus::Params& consensusparams) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+    AssertLockHeld(cs_main);
+
+    // The flags of the tip are asked for every tx entering the mempool, after ConnectBlock
+    // computed them for the same block. Candidate blocks have no hash and are not cached.
+    if (pindex->phashBlock == nullptr)
+        return ComputeBlockScriptFlags(pindex, consensusparams);
+    BlockScriptFlagsCache& cache = g_block_script_flags;
+    if (cache.pindex != pindex || cache.hashBlock != *pindex->phashBlock || cache.consensusparams != &consensusparams) {
+        cache.flags = ComputeBlockScriptFlags(pindex, consensusparams);
+        cache.pindex = pindex;
+        cache.hashBlock = *pindex->phashBlock;
+        cache.consensusparams = &consensusparams;
+    }
+    return cache.flags;
+}
+
 unsigned int GetContractScriptFlags(int nHeight, const Consensus::Params& consensusparams) {
     unsigned int flags = SCRIPT_EXEC_BYTE_CODE;
 
@@ -2122,6 +2731,39 @@ unsigned int GetContractScriptFlags(int nHeight, const Consensus::Params& consen
     return flags;
 }
 
+/**
+ * Whether a block is an ancestor of the -assumevalid block, so the checks of the
+ * signatures of its history can be skipped.
+ */
+static bool IsAssumedValid(const CBlockIndex* pindex, const Consensus::Params& consensusParams) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    if (hashAssumeValid.IsNull())
+        return false;
+
+    // We've been configured with the hash of a block which has been externally verified to have a valid history.
+    // A suitable default value is included with the software and updated from time to time.  Because validity
+    //  relative to a piece of software is an objective fact these defaults can be easily reviewed.
+    // This setting doesn't force the selection of any particular chain but makes validating some faster by
+    //  effectively caching the result of part of the verification.
+    BlockMap::const_iterator  it = mapBlockIndex.find(hashAssumeValid);
+    if (it == mapBlockIndex.end() || pindexBestHeader == nullptr)
+        return false;
+    if (it->second->GetAncestor(pindex->nHeight) == pindex &&
+        pindexBestHeader->GetAncestor(pindex->nHeight) == pindex &&
+        pindexBestHeader->nChainWork >= nMinimumChainWork) {
+        // This block is a member of the assumed verified chain and an ancestor of the best header.
+        // The equivalent time check discourages hash power from extorting the network via DOS attack
+        //  into accepting an invalid block through telling users they must manually set assumevalid.
+        //  Requiring a software change or burying the invalid block, regardless of the setting, makes
+        //  it hard to hide the implication of the demand.  This also avoids having release candidates
+        //  that are hardly doing any signature verification at all in testing without having to
+        //  artificially set the default assumed verified block further back.
+        // The test against nMinimumChainWork prevents the skipping when denied access to any chain at
+        //  least as good as the expected chain.
+        return GetBlockProofEquivalentTime(*pindexBestHeader, *pindex, *pindexBestHeader, consensusParams) > 60 * 60 * 24 * 7 * 2;
+    }
+    return false;
+}
 
 static int64_t nTimeCheck = 0;
 static int64_t nTimeForks = 0;
@@ -2169,6 +2811,96 @@ bool GetSpentCoinFromBlock(const CBlockIndex* pindex, COutPoint prevout, Coin* c
     return false;
 }
 
+/**
+ * Coins spent by the last COINBASE_MATURITY blocks of the main chain, the deepest a fork
+ * can go back for GetSpentCoinFromMainChain, with the block spending them.
+ *
+ * GetSpentCoinFromMainChain looks up the stakes of fork headers and blocks that the main
+ * chain spent since the fork. Without the index it reads every main chain block and its
+ * undo data back to the fork, for every lookup, which a peer can trigger with cheap
+ * competing headers. ConnectTip and DisconnectTip keep the index in step with the tip;
+ * it only covers blocks connected since startup, so lookups that go deeper than the
+ * oldest indexed block still read the blocks below it from disk. The staker uses it
+ * without cs_main, so it has its own lock.
+ */
+class CRecentSpentCoins
+{
+public:
+    void ConnectBlock(const CBlockIndex* pindex, const CBlock& block, const CBlockUndo& blockundo)
+    {
+        LOCK(cs);
+        if (!blocks.empty() && blocks.back().first != pindex->pprev)
+            ClearLocked();
+        std::vector<COutPoint> vSpent;
+        for (size_t j = 1; j < block.vtx.size() && j - 1 < blockundo.vtxundo.size(); ++j) {
+            const CTransaction& tx = *block.vtx[j];
+            const CTxUndo& txundo = blockundo.vtxundo[j - 1];
+            for (size_t k = 0; k < tx.vin.size() && k < txundo.vprevout.size(); ++k) {
+                mapSpent[tx.vin[k].prevout] = std::make_pair(pindex, txundo.vprevout[k]);
+                vSpent.push_back(tx.vin[k].prevout);
+            }
+        }
+        blocks.emplace_back(pindex, std::move(vSpent));
+        if (blocks.size() > (size_t)COINBASE_MATURITY) {
+            for (const COutPoint& prevout : blocks.front().second)
+                mapSpent.erase(prevout);
+            blocks.pop_front();
+        }
+    }
+
+    void DisconnectBlock(const CBlockIndex* pindex)
+    {
+        LOCK(cs);
+        if (blocks.empty() || blocks.back().first != pindex) {
+            ClearLocked();
+            return;
+        }
+        for (const COutPoint& prevout : blocks.back().second)
+            mapSpent.erase(prevout);
+        blocks.pop_back();
+    }
+
+    /**
+     * Find the coin prevout spent in the main chain above pforkBase. Returns false if
+     * the indexed blocks, which must end at pindexTip, do not spend it; pindexOldest is
+     * then the lowest of them, or nullptr if none is indexed.
+     */
+    bool Lookup(const COutPoint& prevout, const CBlockIndex* pindexTip, const CBlockIndex* pforkBase, Coin& coin, const CBlockIndex*& pindexOldest)
+    {
+        LOCK(cs);
+        pindexOldest = nullptr;
+        if (blocks.empty() || blocks.back().first != pindexTip)
+            return false;
+        auto it = mapSpent.find(prevout);
+        if (it != mapSpent.end() && it->second.first->nHeight > pforkBase->nHeight) {
+            coin = it->second.second;
+            return true;
+        }
+        pindexOldest = blocks.front().first;
+        return false;
+    }
+
+    void Clear()
+    {
+        LOCK(cs);
+        ClearLocked();
+    }
+
+private:
+    void ClearLocked() EXCLUSIVE_LOCKS_REQUIRED(cs)
+    {
+        mapSpent.clear();
+        blocks.clear();
+    }
+
+    Mutex cs;
+    std::unordered_map<COutPoint, std::pair<const CBlockIndex*, Coin>, SaltedOutpointHasher> mapSpent GUARDED_BY(cs);
+    //! Indexed blocks from the oldest to the tip, with the outpoints they spend
+    std::deque<std::pair<const CBlockIndex*, std::vector<COutPoint>>> blocks GUARDED_BY(cs);
+};
+
+static CRecentSpentCoins recentSpentCoins;
+
 bool GetSpentCoinFromMainChain(const CBlockIndex* pforkPrev, COutPoint prevoutStake, Coin* coin) {
     const CBlockIndex* pforkBase = chainActive.FindFork(pforkPrev);
 
@@ -2190,11 +2922,17 @@ bool GetSpentCoinFromMainChain(const CBlockIndex* pforkPrev, COutPoint prevoutSt
         }
     }
 
+    // Look in the recent blocks in memory first, then on disk below them
+    const CBlockIndex* pindexOldest = nullptr;
+    if(recentSpentCoins.Lookup(prevoutStake, chainActive.Tip(), pforkBase, *coin, pindexOldest)) {
+        return true;
+    }
+
     // Scan through blocks until we reach the forkbase to check if the prevoutStake has been spent in one of those blocks
     // If it not in any of those blocks, and not in the utxo set, it can't be spendable in the orphan chain.
     {
-        CBlockIndex* pindex = chainActive.Tip();
-        while(pindex && pindex != pforkBase) {
+        const CBlockIndex* pindex = pindexOldest ? pindexOldest->pprev : chainActive.Tip();
+        while(pindex && pindex != pforkBase && pindex->nHeight > pforkBase->nHeight) {
             if(GetSpentCoinFromBlock(pindex, prevoutStake, coin)) {
                 return true;
             }
@@ -2287,40 +3025,415 @@ std::vector<ResultExecute> CallContract(const dev::Address& addrContract, std::v
     return CallContract(addrContract, opcode, pblockindex, sender, gasLimit);
 }
 
-std::vector<ResultExecute> CallContract(const dev::Address& addrContract, std::vector<unsigned char> opcode, CBlockIndex* pblockindex, const dev::Address& sender, uint64_t gasLimit) {
-    CBlock block;
-    CMutableTransaction tx;
+std::vector<ResultExecute> CallContract(const dev::Address& addrContract, std::vector<unsigned char> opcode, CBlockIndex* pblockindex, const dev::Address& sender, uint64_t gasLimit, QtumState* state) {
+    CBlock block;
+    CMutableTransaction tx;
+
+    ReadBlockFromDisk(block, pblockindex, Params().GetConsensus());
+    block.nTime = GetAdjustedTime();
+
+    if (block.IsProofOfStake())
+        block.vtx.erase(block.vtx.begin() + 2, block.vtx.end());
+    else
+        block.vtx.erase(block.vtx.begin() + 1, block.vtx.end());
+
+    QtumDGP qtumDGP(state ? state : globalState.get(), fGettingValuesDGP, state ? pblockindex : nullptr);
+    uint64_t blockGasLimit = qtumDGP.getBlockGasLimit(pblockindex->nHeight + 1);
+
+    if (gasLimit == 0) {
+        gasLimit = blockGasLimit - 1;
+    }
+    dev::Address senderAddress = sender == dev::Address() ? dev::Address("ffffffffffffffffffffffffffffffffffffffff") : sender;
+    tx.vout.push_back(CTxOut(0, CScript() << OP_DUP << OP_HASH160 << senderAddress.asBytes() << OP_EQUALVERIFY << OP_CHECKSIG));
+    block.vtx.push_back(MakeTransactionRef(CTransaction(tx)));
+
+    QtumTransaction callTransaction(0, 1, dev::u256(gasLimit), addrContract, opcode, dev::u256(0));
+    callTransaction.forceSender(senderAddress);
+    callTransaction.setVersion(VersionVM::GetEVMDefault());
+
+
+    ByteCodeExec exec(block, std::vector<QtumTransaction>(1, callTransaction), blockGasLimit, pblockindex, state);
+    exec.performByteCode(dev::eth::Permanence::Reverted, !state);
+    return exec.getResult();
+}
+
+ContractCallView::ContractCallView(CBlockIndex* pblockindex) : pindex(pblockindex)
+{
+    AssertLockHeld(cs_main);
+    assert(IsContractStateAvailable(pindex));
+    pin.reset(new StateRootsPin(StateRoots(uintToh256(pindex->hashStateRoot), uintToh256(pindex->hashUTXORoot))));
+
+    ReadBlockFromDisk(block, pindex, Params().GetConsensus());
+    block.nTime = GetAdjustedTime();
+    if (block.IsProofOfStake())
+        block.vtx.erase(block.vtx.begin() + 2, block.vtx.end());
+    else
+        block.vtx.erase(block.vtx.begin() + 1, block.vtx.end());
+
+    std::shared_ptr<QtumState> statePinned = std::make_shared<QtumState>(*globalState);
+    statePinned->setRoot(uintToh256(pindex->hashStateRoot));
+    statePinned->setRootUTXO(uintToh256(pindex->hashUTXORoot));
+    state = statePinned;
+
+    // Same values the global seal engine held after connecting pindex, read from its state
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    QtumState stateDGP(*state);
+    QtumDGP qtumDGP(&stateDGP, fGettingValuesDGP, pindex);
+    schedule = qtumDGP.getSharedGasSchedule(pindex->nHeight + (pindex->nHeight+1 >= consensusParams.QIP7Height ? 0 : 1));
+    blockGasLimit = qtumDGP.getBlockGasLimit(pindex->nHeight + 1);
+}
+
+ContractCallView::~ContractCallView() {}
+
+bool ContractCallView::addressInUse(const dev::Address& addr) const
+{
+    QtumState stateFork(*state);
+    return stateFork.addressInUse(addr);
+}
+
+std::map<dev::h256, std::pair<dev::u256, dev::u256>> ContractCallView::storage(const dev::Address& addr) const
+{
+    QtumState stateFork(*state);
+    dev::h256 storageRoot = stateFork.storageRoot(addr);
+    std::shared_ptr<const ContractStorage> cached = contractStorageCache.get(addr, storageRoot);
+    if (!cached) {
+        cached = std::make_shared<const ContractStorage>(stateFork.storage(addr));
+        contractStorageCache.put(addr, storageRoot, cached);
+    }
+    return *cached;
+}
+
+dev::h256 ContractCallView::storageRoot(const dev::Address& addr) const
+{
+    QtumState stateFork(*state);
+    return stateFork.storageRoot(addr);
+}
+
+void ContractCallView::readState(const std::function<void(const QtumState&)>& f) const
+{
+    QtumState stateFork(*state);
+    f(stateFork);
+}
+
+std::vector<ResultExecute> ContractCallView::call(const dev::Address& addrContract, const std::vector<unsigned char>& opcode, const dev::Address& sender, uint64_t gasLimit) const
+{
+    if (gasLimit == 0) {
+        gasLimit = defaultGasLimit();
+    }
+    return execute(QtumTransaction(0, 1, dev::u256(gasLimit), addrContract, opcode, dev::u256(0)), sender);
+}
+
+std::vector<ResultExecute> ContractCallView::execute(QtumTransaction tx, const dev::Address& sender) const
+{
+    CBlock blockCall(block);
+    CMutableTransaction txSender;
+
+    dev::Address senderAddress = sender == dev::Address() ? dev::Address("ffffffffffffffffffffffffffffffffffffffff") : sender;
+    txSender.vout.push_back(CTxOut(0, CScript() << OP_DUP << OP_HASH160 << senderAddress.asBytes() << OP_EQUALVERIFY << OP_CHECKSIG));
+    blockCall.vtx.push_back(MakeTransactionRef(CTransaction(txSender)));
+
+    tx.forceSender(senderAddress);
+    tx.setVersion(VersionVM::GetEVMDefault());
+
+    dev::eth::SealEngineFace* sealEngine = GetThreadSealEngine(schedule);
+    QtumState stateFork(*state);
+    ByteCodeExec exec(blockCall, std::vector<QtumTransaction>(1, tx), blockGasLimit, pindex, &stateFork, sealEngine);
+    exec.performByteCode(dev::eth::Permanence::Reverted, false);
+    return exec.getResult();
+}
+
+ContractGasEstimate EstimateContractGas(const dev::Address& sender, const dev::Address& addrContract, const std::vector<unsigned char>& data, CAmount nValue, bool* pfCached)
+{
+    dev::Address senderAddress = sender == dev::Address() ? dev::Address("ffffffffffffffffffffffffffffffffffffffff") : sender;
+    ContractGasEstimate estimate;
+    std::string key;
+    // Only pin the state under cs_main; the dry run itself runs on a private fork
+    std::unique_ptr<ContractCallView> view;
+    {
+        LOCK(cs_main);
+        CBlockIndex* pindexTip = chainActive.Tip();
+        key = GasEstimateKey(senderAddress, addrContract, data, dev::u256(nValue), pindexTip->hashStateRoot, pindexTip->hashUTXORoot);
+        bool fCached = LookupGasEstimate(key, estimate);
+        if (pfCached)
+            *pfCached = fCached;
+        if (fCached)
+            return estimate;
+        view.reset(new ContractCallView(pindexTip));
+        estimate.hashStateRoot = pindexTip->hashStateRoot;
+        estimate.hashUTXORoot = pindexTip->hashUTXORoot;
+    }
+
+    dev::u256 gasLimit(view->defaultGasLimit());
+    QtumTransaction tx = addrContract == dev::Address() ?
+        QtumTransaction(dev::u256(nValue), 1, gasLimit, data, dev::u256(0)) :
+        QtumTransaction(dev::u256(nValue), 1, gasLimit, addrContract, data, dev::u256(0));
+    int64_t nTimeStart = GetTimeMicros();
+    std::vector<ResultExecute> results = view->execute(tx, senderAddress);
+    estimate.nTime = GetTimeMicros() - nTimeStart;
+    if (!results.empty()) {
+        const dev::eth::ExecutionResult& execRes = results[0].execRes;
+        estimate.nGasUsed = (uint64_t)execRes.gasUsed;
+        estimate.excepted = execRes.excepted;
+        estimate.output = execRes.output;
+        estimate.newAddress = execRes.newAddress;
+    }
+
+    LOCK(cs_main);
+    AddGasEstimate(key, estimate);
+    return estimate;
+}
+
+/** Add the QRC20 Transfer logs of the contract executions of tx to transfers */
+static void AppendTokenTransfers(const CTransaction& tx, const std::vector<ResultExecute>& resultExec, std::vector<TokenTransferLog>& transfers)
+{
+    static const dev::h256 transferTopic = dev::sha3(std::string("Transfer(address,address,uint256)"));
+    for (const ResultExecute& result : resultExec) {
+        for (const dev::eth::LogEntry& log : result.txRec.log()) {
+            if (log.topics.size() != 3 || log.topics[0] != transferTopic || log.data.size() != 32)
+                continue;
+            dev::bytesConstRef data(&log.data);
+            transfers.push_back(TokenTransferLog{
+                tx.GetHash(),
+                uint160(log.address.asBytes()),
+                uint160(dev::right160(log.topics[1]).asBytes()),
+                uint160(dev::right160(log.topics[2]).asBytes()),
+                u256Touint(dev::eth::ABIDeserialiser<dev::u256>::deserialise(data))
+            });
+        }
+    }
+}
+
+/** The -logevents receipts of the contract executions of the block transaction at nTx */
+static std::vector<TransactionReceiptInfo> BuildTransactionReceipts(const CBlock& block, const CBlockIndex* pindex, unsigned int nTx,
+    const std::vector<QtumTransaction>& txs, const std::vector<ResultExecute>& resultExec, uint64_t countCumulativeGasUsed)
+{
+    std::vector<TransactionReceiptInfo> tri;
+    for(size_t k = 0; k < txs.size(); k ++){
+        tri.push_back(TransactionReceiptInfo{
+            block.GetHash(),
+            uint32_t(pindex->nHeight),
+            block.vtx[nTx]->GetHash(),
+            uint32_t(nTx),
+            txs[k].getNVout(),
+            txs[k].from(),
+            txs[k].to(),
+            countCumulativeGasUsed,
+            uint64_t(resultExec[k].execRes.gasUsed),
+            resultExec[k].execRes.newAddress,
+            resultExec[k].txRec.log(),
+            resultExec[k].execRes.excepted,
+            exceptedMessage(resultExec[k].execRes.excepted, resultExec[k].execRes.output),
+            resultExec[k].txRec.stateRoot(),
+            resultExec[k].txRec.utxoRoot(),
+            resultExec[k].txRec.createdContracts(),
+            resultExec[k].txRec.destructedContracts(),
+            {}
+        });
+        for (const TransferInfo& transfer : resultExec[k].txRec.transfers())
+            tri.back().transfers.emplace_back(transfer.from, transfer.to);
+        tri.back().storageGrowth = resultExec[k].txRec.storageGrowth();
+        tri.back().fStorageGrowth = fContractStateGrowth;
+    }
+    return tri;
+}
+
+bool ReplayBlockReceipts(const CBlock& block, const CBlockIndex* pindex, const CBlockUndo& blockundo, BlockReceipts& receipts)
+{
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    if (blockundo.vtxundo.size() + 1 != block.vtx.size())
+        return error("%s: block and undo data inconsistent", __func__);
+
+    // The senders of the contract transactions are the owners of the outputs they spend
+    CCoinsView viewDummy;
+    CCoinsViewCache view(&viewDummy);
+    for (size_t i = 1; i < block.vtx.size(); i++) {
+        const CTransaction& tx = *block.vtx[i];
+        const CTxUndo& txundo = blockundo.vtxundo[i - 1];
+        if (txundo.vprevout.size() != tx.vin.size())
+            return error("%s: transaction and undo data inconsistent", __func__);
+        for (size_t j = 0; j < tx.vin.size(); j++)
+            view.AddCoin(tx.vin[j].prevout, Coin(txundo.vprevout[j]), true);
+    }
+
+    // Same values the global seal engine held when the block was connected
+    const int nDGPHeight = pindex->nHeight + (pindex->nHeight+1 >= consensusParams.QIP7Height ? 0 : 1);
+    std::unique_ptr<QtumState> stateFork;
+    {
+        LOCK(cs_main);
+        stateFork.reset(new QtumState(*globalState));
+    }
+    stateFork->setRoot(uintToh256(pindex->pprev->hashStateRoot));
+    stateFork->setRootUTXO(uintToh256(pindex->pprev->hashUTXORoot));
+
+    std::shared_ptr<const dev::eth::EVMSchedule> schedule;
+    uint64_t blockGasLimit;
+    try {
+        // The DGP parameters are read from the state of the parent, not from the tip
+        QtumDGP qtumDGP(stateFork.get(), fGettingValuesDGP, pindex->pprev);
+        schedule = qtumDGP.getSharedGasSchedule(nDGPHeight);
+        blockGasLimit = qtumDGP.getBlockGasLimit(nDGPHeight);
+    } catch (const std::exception& e) {
+        return error("%s: state of block %s not available: %s", __func__, pindex->pprev->GetBlockHash().ToString(), e.what());
+    }
+
+    dev::eth::SealEngineFace* sealEngine = GetThreadSealEngine(schedule);
+    const CBlockTxIndex blockTxIndex(block.vtx);
+    const unsigned int contractflags = GetContractScriptFlags(pindex->nHeight, consensusParams);
+    uint64_t countCumulativeGasUsed = 0;
+    try {
+        for (unsigned int i = 0; i < block.vtx.size(); i++) {
+            const CTransaction& tx = *block.vtx[i];
+            if (!tx.HasCreateOrCall() || tx.HasOpSpend())
+                continue;
+
+            QtumTxConverter convert(tx, &view, &blockTxIndex, contractflags);
+            ExtractQtumTX resultConvertQtumTX;
+            if (!convert.extractionQtumTransactions(resultConvertQtumTX))
+                return error("%s: contract transaction %s of the wrong format", __func__, tx.GetHash().ToString());
+
+            // The trie nodes stay in the overlays of the fork, they are on disk already
+            ByteCodeExec exec(block, resultConvertQtumTX.first, blockGasLimit, pindex->pprev, stateFork.get(), sealEngine);
+            ByteCodeExecResult bcer;
+            if (!exec.performByteCode(dev::eth::Permanence::Committed, false) || !exec.processingResults(bcer))
+                return error("%s: failed to execute contract transaction %s", __func__, tx.GetHash().ToString());
+
+            countCumulativeGasUsed += bcer.usedGas;
+            receipts.emplace_back(tx.GetHash(), BuildTransactionReceipts(block, pindex, i, resultConvertQtumTX.first, exec.getResult(), countCumulativeGasUsed));
+        }
+    } catch (const std::exception& e) {
+        // The state of blocks older than -prunestate is gone
+        return error("%s: state of block %s not available: %s", __func__, pindex->GetBlockHash().ToString(), e.what());
+    }
+
+    // Receipts of an execution that didn't end in the state of the block are not those of the block
+    if (stateFork->rootHash() != uintToh256(pindex->hashStateRoot) || stateFork->rootHashUTXO() != uintToh256(pindex->hashUTXORoot))
+        return error("%s: execution of block %s does not match its state root", __func__, pindex->GetBlockHash().ToString());
+    return true;
+}
+
+bool ReadBlockReceipts(const CBlock& block, const CBlockIndex* pindex, const CBlockUndo& blockundo, BlockReceipts& receipts)
+{
+    // The results database has the receipts of this block if the log index got to it, also
+    // when the block was disconnected since
+    bool fHasContracts = false;
+    bool fRecorded = true;
+    const dev::h256 hashBlock = uintToh256(pindex->GetBlockHash());
+    for (const CTransactionRef& tx : block.vtx) {
+        if (!tx->HasCreateOrCall())
+            continue;
+        fHasContracts = true;
+        std::vector<TransactionReceiptInfo> txReceipts = pstorageresult->getResult(hashBlock, uintToh256(tx->GetHash()));
+        if (txReceipts.empty()) {
+            fRecorded = false;
+            break;
+        }
+        receipts.emplace_back(tx->GetHash(), std::move(txReceipts));
+    }
+    if (!fHasContracts || fRecorded)
+        return true;
+    receipts.clear();
+    return ReplayBlockReceipts(block, pindex, blockundo, receipts);
+}
+
+bool SearchLogs(int fromBlock, int toBlock, int minconf, const std::set<dev::h160>& addresses, const std::vector<boost::optional<dev::h256>>& topics,
+                size_t maxReceipts, std::vector<TransactionReceiptInfo>& receipts, int& nextBlock)
+{
+    AssertLockHeld(cs_main);
+    nextBlock = -1;
+
+    std::vector<std::vector<uint256>> hashesToBlock;
+
+    // A receipt has to match the addresses and any of the given topics
+    CLogBloomFilter bloomFilter;
+    bloomFilter.addresses = addresses;
+    bloomFilter.fMatchAllTopics = false;
+    for (const auto& topic : topics) {
+        if (topic)
+            bloomFilter.topics.push_back(topic.get());
+    }
+
+    // A filter on the first topic alone is resolved through the topic index, which yields
+    // exactly the transactions with such a log. The addresses are then checked on the receipts.
+    bool fTopicIndex = fLogTopicIndex && !topics.empty() && topics[0] &&
+        std::none_of(topics.begin() + 1, topics.end(), [](const boost::optional<dev::h256>& topic) { return bool(topic); });
+    int curheight;
+    if (fTopicIndex) {
+        hashesToBlock.emplace_back();
+        curheight = pblocktree->ReadTopicIndex(fromBlock, toBlock, minconf, topics[0].get(), hashesToBlock.back());
+    } else {
+        curheight = pblocktree->ReadHeightIndex(fromBlock, toBlock, minconf, hashesToBlock, addresses, &bloomFilter);
+    }
+
+    if (curheight == -1) {
+        return false;
+    }
+
+    std::set<uint256> dupes;
+    size_t nReceipts = 0;
+    for (const auto& hashesTx : hashesToBlock) {
+        for (const auto& e : hashesTx) {
+            if (!dupes.insert(e).second) {
+                continue;
+            }
 
-    ReadBlockFromDisk(block, pblockindex, Params().GetConsensus());
-    block.nTime = GetAdjustedTime();
+            std::vector<TransactionReceiptInfo> txReceipts = pstorageresult->getResult(uintToh256(e));
+            if (txReceipts.empty()) {
+                continue;
+            }
 
-    if (block.IsProofOfStake())
-        block.vtx.erase(block.vtx.begin() + 2, block.vtx.end());
-    else
-        block.vtx.erase(block.vtx.begin() + 1, block.vtx.end());
+            // The transactions come by height, stop at the first one of a block past the limit
+            if (nReceipts > 0 && nReceipts >= maxReceipts && txReceipts.front().blockNumber != receipts.back().blockNumber) {
+                nextBlock = txReceipts.front().blockNumber;
+                return true;
+            }
 
-    QtumDGP qtumDGP(globalState.get(), fGettingValuesDGP);
-    uint64_t blockGasLimit = qtumDGP.getBlockGasLimit(pblockindex->nHeight + 1);
+            if (fTopicIndex && !addresses.empty()) {
+                bool fAddress = false;
+                for (const auto& receipt : txReceipts) {
+                    for (const auto& log : receipt.logs) {
+                        fAddress |= addresses.count(log.address) > 0;
+                    }
+                }
+                if (!fAddress) {
+                    continue;
+                }
+            }
 
-    if (gasLimit == 0) {
-        gasLimit = blockGasLimit - 1;
-    }
-    dev::Address senderAddress = sender == dev::Address() ? dev::Address("ffffffffffffffffffffffffffffffffffffffff") : sender;
-    tx.vout.push_back(CTxOut(0, CScript() << OP_DUP << OP_HASH160 << senderAddress.asBytes() << OP_EQUALVERIFY << OP_CHECKSIG));
-    block.vtx.push_back(MakeTransactionRef(CTransaction(tx)));
+            for (auto& receipt : txReceipts) {
+                if (receipt.logs.empty()) {
+                    continue;
+                }
 
-    QtumTransaction callTransaction(0, 1, dev::u256(gasLimit), addrContract, opcode, dev::u256(0));
-    callTransaction.forceSender(senderAddress);
-    callTransaction.setVersion(VersionVM::GetEVMDefault());
+                bool fMatch = topics.empty();
+                for (size_t i = 0; i < topics.size() && !fMatch; i++) {
+                    const auto& tc = topics[i];
+                    if (!tc) {
+                        continue;
+                    }
+                    for (const auto& log : receipt.logs) {
+                        if (i < log.topics.size() && tc.get() == log.topics[i]) {
+                            fMatch = true;
+                            break;
+                        }
+                    }
+                }
 
+                // Skip the receipt if none of the topics are matched
+                if (!fMatch) {
+                    continue;
+                }
 
-    ByteCodeExec exec(block, std::vector<QtumTransaction>(1, callTransaction), blockGasLimit, pblockindex);
-    exec.performByteCode(dev::eth::Permanence::Reverted);
-    return exec.getResult();
+                receipts.push_back(std::move(receipt));
+                nReceipts++;
+            }
+        }
+    }
+
+    return true;
 }
 
-bool CheckMinGasPrice(std::vector<EthTransactionParams>& etps, const uint64_t& minGasPrice){
-    for(EthTransactionParams& etp : etps){
+bool CheckMinGasPrice(const std::vector<EthTransactionParams>& etps, const uint64_t& minGasPrice){
+    for(const EthTransactionParams& etp : etps){
         if(etp.gasPrice < dev::u256(minGasPrice))
             return false;
     }
@@ -2405,7 +3518,26 @@ bool CheckReward(const CBlock& block, CValidationState& state, int nHeight, cons
     return true;
 }
 
-valtype GetSenderAddress(const CTransaction& tx, const CCoinsViewCache* coinsView, const std::vector<CTransactionRef>* blockTxs, int nOut = -1){
+CBlockTxIndex::CBlockTxIndex(const std::vector<CTransactionRef>& vtx)
+{
+    mapTx.reserve(vtx.size());
+    for (const CTransactionRef& tx : vtx)
+        Add(tx);
+}
+
+void CBlockTxIndex::Add(const CTransactionRef& tx)
+{
+    // Keep the first occurrence, matching the order of a linear scan of the block
+    mapTx.emplace(tx->GetHash(), tx);
+}
+
+const CTransaction* CBlockTxIndex::Find(const uint256& txid) const
+{
+    auto it = mapTx.find(txid);
+    return it == mapTx.end() ? nullptr : it->second.get();
+}
+
+valtype GetSenderAddress(const CTransaction& tx, const CCoinsViewCache* coinsView, const CBlockTxIndex* blockTxs, int nOut = -1){
     CScript script;
     bool scriptFilled=false; //can't use script.empty() because an empty script is technically valid
 
@@ -2415,12 +3547,10 @@ valtype GetSenderAddress(const CTransaction& tx, const CCoinsViewCache* coinsVie
 
     // Check the current (or in-progress) block for zero-confirmation change spending that won't yet be in txindex
     if(!scriptFilled && blockTxs){
-        for(auto btx : *blockTxs){
-            if(btx->GetHash() == tx.vin[0].prevout.hash){
-                script = btx->vout[tx.vin[0].prevout.n].scriptPubKey;
-                scriptFilled=true;
-                break;
-            }
+        const CTransaction* btx = blockTxs->Find(tx.vin[0].prevout.hash);
+        if(btx){
+            script = btx->vout[tx.vin[0].prevout.n].scriptPubKey;
+            scriptFilled=true;
         }
     }
     if(!scriptFilled && coinsView){
@@ -2514,52 +3644,75 @@ void writeVMlog(const std::vector<ResultExecute>& res, const CTransaction& tx, c
     fIsVMlogFile = true;
 }
 
+/** The hashes of tip and its ancestors, zero past the genesis block */
+static std::shared_ptr<const dev::h256s> ReadLastHashes(const CBlockIndex *tip)
+{
+    std::shared_ptr<dev::h256s> lastHashes = std::make_shared<dev::h256s>(LAST_HASHES_COUNT);
+    for(int i=0;i<LAST_HASHES_COUNT;i++){
+        if(!tip)
+            break;
+        (*lastHashes)[i]= uintToh256(*tip->phashBlock);
+        tip = tip->pprev;
+    }
+    return lastHashes;
+}
+
 LastHashes::LastHashes()
 {}
 
 void LastHashes::set(const CBlockIndex *tip)
 {
-    clear();
-
-    m_lastHashes.resize(256);
-    for(int i=0;i<256;i++){
-        if(!tip)
-            break;
-        m_lastHashes[i]= uintToh256(*tip->phashBlock);
-        tip = tip->pprev;
+    const std::shared_ptr<const ChainTipSnapshot> snapshot = GetChainTipSnapshot();
+    if(tip && snapshot->lastHashes && snapshot->hashBlock == *tip->phashBlock){
+        m_lastHashes = snapshot->lastHashes;
+    } else {
+        m_lastHashes = ReadLastHashes(tip);
     }
 }
 
 dev::h256s LastHashes::precedingHashes(const dev::h256 &) const
 {
-    return m_lastHashes;
+    return m_lastHashes ? *m_lastHashes : dev::h256s();
 }
 
 void LastHashes::clear()
 {
-    m_lastHashes.clear();
+    m_lastHashes.reset();
 }
 
-bool ByteCodeExec::performByteCode(dev::eth::Permanence type){
+ByteCodeExec::ByteCodeExec(const CBlock& _block, std::vector<QtumTransaction> _txs, const uint64_t _blockGasLimit, CBlockIndex* _pindex, QtumState* _state, dev::eth::SealEngineFace* _sealEngine) :
+    txs(_txs), block(_block), blockGasLimit(_blockGasLimit), pindex(_pindex),
+    state(_state ? _state : globalState.get()), sealEngine(_sealEngine ? _sealEngine : globalSealEngine.get()) {}
+
+bool ByteCodeExec::performByteCode(dev::eth::Permanence type, bool fCommitDB, ContractProfiler* profiler){
     for(QtumTransaction& tx : txs){
         //validate VM version
         if(tx.getVersion().toRaw() != VersionVM::GetEVMDefault().toRaw()){
             return false;
         }
         dev::eth::EnvInfo envInfo(BuildEVMEnvironment());
-        if(!tx.isCreation() && !globalState->addressInUse(tx.receiveAddress())){
+        if(!tx.isCreation() && !state->addressInUse(tx.receiveAddress())){
             dev::eth::ExecutionResult execRes;
             execRes.excepted = dev::eth::TransactionException::Unknown;
             result.push_back(ResultExecute{
                 execRes,
                 KPGTransactionReceipt(dev::h256(), dev::h256(), dev::u256(), dev::eth::LogEntries(), {}, {}), CTransaction()});
+            execTimes.push_back(0);
             continue;
         }
-        result.push_back(globalState->execute(envInfo, *globalSealEngine.get(), tx, type, OnOpFunc()));
+        int64_t nTimeStart = GetTimeMicros();
+        result.push_back(state->execute(envInfo, *sealEngine, tx, type, profiler ? profiler->OpHook() : OnOpFunc()));
+        execTimes.push_back(GetTimeMicros() - nTimeStart);
+        if(profiler){
+            dev::Address contract(tx.isCreation() ? QtumState::createQtumAddress(tx.getHashWith(), tx.getNVout()) : tx.receiveAddress());
+            profiler->AddExecution(contract, (uint64_t)result.back().execRes.gasUsed, execTimes.back());
+        }
     }
-    globalState->db().commit();
-    globalState->dbUtxo().commit();
-    globalSealEngine.get()->deleteAddresses.clear();
+    if(fCommitDB){
+        state->db().commit();
+        state->dbUtxo().commit();
+    }
+    sealEngine->deleteAddresses.clear();
     return true;
 }
 
@@ -2577,12 +3730,12 @@ bool ByteCodeExec::processingResults(ByteCodeExecResult& resultBCE){
         		tx.vout.push_back(CTxOut(CAmount(txs[i].value()), script));
         		resultBCE.valueTransfers.push_back(CTransaction(tx));
         	}
-        	if(!(chainActive.Height() >= consensusParams.QIP7Height && result[i].execRes.excepted == dev::eth::TransactionException::RevertInstruction)){
+        	if(!(pindex->nHeight >= consensusParams.QIP7Height && result[i].execRes.excepted == dev::eth::TransactionException::RevertInstruction)){
         	resultBCE.usedGas += gasUsed;
         	}
         }
 
-        if(result[i].execRes.excepted == dev::eth::TransactionException::None || (chainActive.Height() >= consensusParams.QIP7Height && result[i].execRes.excepted == dev::eth::TransactionException::RevertInstruction)){
+        if(result[i].execRes.excepted == dev::eth::TransactionException::None || (pindex->nHeight >= consensusParams.QIP7Height && result[i].execRes.excepted == dev::eth::TransactionException::RevertInstruction)){
         	if(txs[i].gas() > UINT64_MAX ||
         			result[i].execRes.gasUsed > UINT64_MAX ||
 					txs[i].gasPrice() > UINT64_MAX){
@@ -2646,6 +3799,58 @@ dev::Address ByteCodeExec::EthAddrFromScript(const CScript& script){
     return dev::Address();
 }
 
+/** The script the author of the EVM environment of block is taken from */
+static const CScript& BlockAuthorScript(const CBlock& block)
+{
+    return block.IsProofOfStake() ? block.vtx[1]->vout[1].scriptPubKey : block.vtx[0]->vout[0].scriptPubKey;
+}
+
+void LocalContractExecution::SetEnvironment(const CBlock& block, const CBlockIndex* pindexPrev, uint64_t _blockGasLimit, unsigned int _nContractFlags, const std::shared_ptr<const dev::eth::EVMSchedule>& _schedule)
+{
+    // The assembler fills in hashPrevBlock once the transactions are selected
+    hashPrevBlock = pindexPrev->GetBlockHash();
+    nTime = block.nTime;
+    nBits = block.nBits;
+    scriptAuthor = BlockAuthorScript(block);
+    blockGasLimit = _blockGasLimit;
+    nContractFlags = _nContractFlags;
+    schedule = _schedule;
+}
+
+bool LocalContractExecution::MatchesEnvironment(const CBlock& block, uint64_t _blockGasLimit, unsigned int _nContractFlags, const std::shared_ptr<const dev::eth::EVMSchedule>& _schedule) const
+{
+    // The schedules are shared per governance span, see QtumDGP::getSharedGasSchedule
+    return hashPrevBlock == block.hashPrevBlock && nTime == block.nTime && nBits == block.nBits &&
+        blockGasLimit == _blockGasLimit && nContractFlags == _nContractFlags && schedule == _schedule &&
+        scriptAuthor == BlockAuthorScript(block);
+}
+
+static std::unordered_map<uint256, std::shared_ptr<const LocalContractExecution>, BlockHasher> g_local_contract_executions GUARDED_BY(cs_main);
+
+void RecordLocalContractExecution(const uint256& txid, std::shared_ptr<const LocalContractExecution> execution)
+{
+    AssertLockHeld(cs_main);
+    if (g_local_contract_executions.size() >= MAX_LOCAL_CONTRACT_EXECUTIONS && !g_local_contract_executions.count(txid))
+        return;
+    g_local_contract_executions[txid] = std::move(execution);
+}
+
+std::shared_ptr<const LocalContractExecution> FindLocalContractExecution(const uint256& txid, const CBlock& block, uint64_t blockGasLimit,
+    unsigned int nContractFlags, const std::shared_ptr<const dev::eth::EVMSchedule>& schedule)
+{
+    AssertLockHeld(cs_main);
+    auto it = g_local_contract_executions.find(txid);
+    if (it == g_local_contract_executions.end() || !it->second->MatchesEnvironment(block, blockGasLimit, nContractFlags, schedule))
+        return nullptr;
+    return it->second;
+}
+
+void ClearLocalContractExecutions()
+{
+    AssertLockHeld(cs_main);
+    g_local_contract_executions.clear();
+}
+
 bool QtumTxConverter::extractionQtumTransactions(ExtractQtumTX& qtumtx){
     // Get the address of the sender that pay the coins for the contract transactions
     refundSender = dev::Address(GetSenderAddress(txBit, view, blockTransactions));
@@ -2766,9 +3971,12 @@ size_t QtumTxConverter::correctedStackSize(size_t size){
 
 /** Apply the effects of this block (with given index) on the UTXO set represented by coins.
  *  Validity checks that depend on the UTXO set are also done; ConnectBlock()
- *  can fail if those validity checks fail (among other reasons). */
+ *  can fail if those validity checks fail (among other reasons).
+ *  fReuseHashProof lets a proof-of-stake block connected before to the main chain keep
+ *  its stored proof hash instead of checking its stake again, see UpdateHashProof(). */
 bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex,
-                  CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck)
+                  CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck, CBlockUndo* pblockundo,
+                  bool fReuseHashProof)
 {
     AssertLockHeld(cs_main);
     assert(pindex);
@@ -2777,7 +3985,8 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
 
     ///////////////////////////////////////////////// // kpg
     QtumDGP qtumDGP(globalState.get(), fGettingValuesDGP);
-    globalSealEngine->setQtumSchedule(qtumDGP.getGasSchedule(pindex->nHeight + (pindex->nHeight+1 >= chainparams.GetConsensus().QIP7Height ? 0 : 1) ));
+    std::shared_ptr<const dev::eth::EVMSchedule> schedule = qtumDGP.getSharedGasSchedule(pindex->nHeight + (pindex->nHeight+1 >= chainparams.GetConsensus().QIP7Height ? 0 : 1));
+    globalSealEngine->setQtumSchedule(*schedule);
     uint32_t sizeBlockDGP = qtumDGP.getBlockSize(pindex->nHeight + (pindex->nHeight+1 >= chainparams.GetConsensus().QIP7Height ? 0 : 1));
     uint64_t minGasPrice = qtumDGP.getMinGasPrice(pindex->nHeight + (pindex->nHeight+1 >= chainparams.GetConsensus().QIP7Height ? 0 : 1));
     uint64_t blockGasLimit = qtumDGP.getBlockGasLimit(pindex->nHeight + (pindex->nHeight+1 >= chainparams.GetConsensus().QIP7Height ? 0 : 1));
@@ -2843,41 +4052,23 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         return true;
     }
 
-    // State is filled in by UpdateHashProof
-    if (!UpdateHashProof(block, state, chainparams.GetConsensus(), pindex, view)) {
+    bool fScriptChecks = !IsAssumedValid(pindex, chainparams.GetConsensus());
+
+    // State is filled in by UpdateHashProof. The coinstake input is one of the scripts
+    // -assumevalid skips, so with -assumevalidstake its signature is not checked there either.
+    int64_t nTimeHashProof = GetTimeMicros();
+    if (!UpdateHashProof(block, state, chainparams.GetConsensus(), pindex, view, fScriptChecks || !fAssumeValidStake, fReuseHashProof && !fJustCheck)) {
         return error("%s: ConnectBlock(): %s", __func__, state.GetRejectReason().c_str());
     }
+    if (!fJustCheck)
+        validationStats.Add(ValidationStage::HASH_PROOF, GetTimeMicros() - nTimeHashProof);
 
     nBlocksTotal++;
 
-    bool fScriptChecks = true;
-    if (!hashAssumeValid.IsNull()) {
-        // We've been configured with the hash of a block which has been externally verified to have a valid history.
-        // A suitable default value is included with the software and updated from time to time.  Because validity
-        //  relative to a piece of software is an objective fact these defaults can be easily reviewed.
-        // This setting doesn't force the selection of any particular chain but makes validating some faster by
-        //  effectively caching the result of part of the verification.
-        BlockMap::const_iterator  it = mapBlockIndex.find(hashAssumeValid);
-        if (it != mapBlockIndex.end()) {
-            if (it->second->GetAncestor(pindex->nHeight) == pindex &&
-                pindexBestHeader->GetAncestor(pindex->nHeight) == pindex &&
-                pindexBestHeader->nChainWork >= nMinimumChainWork) {
-                // This block is a member of the assumed verified chain and an ancestor of the best header.
-                // The equivalent time check discourages hash power from extorting the network via DOS attack
-                //  into accepting an invalid block through telling users they must manually set assumevalid.
-                //  Requiring a software change or burying the invalid block, regardless of the setting, makes
-                //  it hard to hide the implication of the demand.  This also avoids having release candidates
-                //  that are hardly doing any signature verification at all in testing without having to
-                //  artificially set the default assumed verified block further back.
-                // The test against nMinimumChainWork prevents the skipping when denied access to any chain at
-                //  least as good as the expected chain.
-                fScriptChecks = (GetBlockProofEquivalentTime(*pindexBestHeader, *pindex, *pindexBestHeader, chainparams.GetConsensus()) <= 60 * 60 * 24 * 7 * 2);
-            }
-        }
-    }
-
     int64_t nTime1 = GetTimeMicros(); nTimeCheck += nTime1 - nTimeStart;
     LogPrint(BCLog::BENCH, "    - Sanity checks: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime1 - nTimeStart), nTimeCheck * MICRO, nTimeCheck * MILLI / nBlocksTotal);
+    if (!fJustCheck)
+        validationStats.Add(ValidationStage::SANITY, nTime1 - nTimeStart);
 
     // Do not allow blocks that contain transactions which 'overwrite' older transactions,
     // unless those are already completely spent.
@@ -2979,6 +4170,8 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
 
     int64_t nTime2 = GetTimeMicros(); nTimeForks += nTime2 - nTime1;
     LogPrint(BCLog::BENCH, "    - Fork checks: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime2 - nTime1), nTimeForks * MICRO, nTimeForks * MILLI / nBlocksTotal);
+    if (!fJustCheck)
+        validationStats.Add(ValidationStage::FORKS, nTime2 - nTime1);
 
     CBlockUndo blockundo;
 
@@ -2991,26 +4184,91 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     int64_t nSigOpsCost = 0;
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
 
-    ///////////////////////////////////////////////////////// // kpg
-#ifdef ENABLE_BITCORE_RPC
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
-    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
-#endif
-    std::map<dev::Address, std::pair<CHeightTxIndexKey, std::vector<uint256>>> heightIndexes;
-    /////////////////////////////////////////////////////////
 
-    std::vector<PrecomputedTransactionData> txdata;
-    txdata.reserve(block.vtx.size()); // Required so that pointers to individual PrecomputedTransactionData don't get invalidated
+    // The sighash midstates and the contract transactions of the transactions that were
+    // accepted to the mempool are reused
+    std::vector<std::shared_ptr<PrecomputedTransactionData>> txdata(block.vtx.size());
+    std::vector<std::shared_ptr<const ContractExtraction>> contractExtractions(block.vtx.size());
+    {
+        LOCK(mempool.cs);
+        for (size_t i = 0; i < block.vtx.size(); i++) {
+            if (!block.vtx[i]->HasWitness() && !block.vtx[i]->HasOpSender() && !block.vtx[i]->HasCreateOrCall())
+                continue;
+            CTxMemPool::txiter it = mempool.mapTx.find(block.vtx[i]->GetHash());
+            if (it == mempool.mapTx.end() || it->GetTx().GetWitnessHash() != block.vtx[i]->GetWitnessHash())
+                continue;
+            txdata[i] = it->GetPrecomputedData();
+            // Extracted with the same flags, the senders come from the same prevouts
+            const std::shared_ptr<const ContractExtraction>& extraction = it->GetContractExtraction();
+            if (extraction && extraction->nFlags == contractflags)
+                contractExtractions[i] = extraction;
+        }
+    }
     uint64_t blockGasUsed = 0;
     CAmount gasRefunds=0;
 
     uint64_t nValueOut=0;
     uint64_t nValueIn=0;
+    int64_t nTimeContracts = 0;
+
+    // Built once so that sender resolution of zero-confirmation spends is O(1) per transaction
+    const CBlockTxIndex blockTxIndex(block.vtx);
+
+    // Extracts the contract transactions of the transactions that were not taken from the
+    // mempool once, for both the speculation and the serial pass
+    auto extractContractTxs = [&](unsigned int i) -> const ContractExtraction* {
+        if (!contractExtractions[i]) {
+            QtumTxConverter convert(*block.vtx[i], &view, &blockTxIndex, contractflags);
+            std::shared_ptr<ContractExtraction> extraction = std::make_shared<ContractExtraction>();
+            extraction->nFlags = contractflags;
+            if (!convert.extractionQtumTransactions(extraction->extracted))
+                return nullptr;
+            contractExtractions[i] = extraction;
+        }
+        return contractExtractions[i].get();
+    };
+
+    // The receipts are handed to the log index, which writes them in the background
+    const bool fRecordReceipts = !fJustCheck && fLogEvents && g_logindex;
+    BlockReceipts blockReceipts;
+    // The token transfers are matched by the wallets against their tokens
+    std::vector<TokenTransferLog> tokenTransfers;
+
+    // Speculatively execute the contract transactions on forks of the pre-block state
+    // while the serial pass below runs; see CContractSpeculation.
+    std::atomic<unsigned int> nSerialPos{0};
+    CContractSpeculationStats speculationStats;
+    unsigned int nSpeculations = 0;
+    CCheckQueueControl<CContractSpeculation> speculation(nContractSpeculationThreads ? &contractspeculationqueue : nullptr);
+    CContractSpeculationGuard speculationGuard(nSerialPos);
+    if (nContractSpeculationThreads) {
+        std::shared_ptr<const QtumState> stateBase;
+        std::vector<CContractSpeculation> vSpeculations;
+        for (unsigned int i = 0; i < block.vtx.size(); i++) {
+            const CTransaction &tx = *(block.vtx[i]);
+            if (!tx.HasCreateOrCall() || tx.HasOpSpend())
+                continue;
+            // The executions of a locally assembled block are taken over instead
+            if (FindLocalContractExecution(tx.GetHash(), block, blockGasLimit, contractflags, schedule))
+                continue;
+            const ContractExtraction* extraction = extractContractTxs(i);
+            if (!extraction)
+                continue;
+            if (!stateBase)
+                stateBase = std::make_shared<const QtumState>(*globalState);
+            vSpeculations.emplace_back(block, pindex->pprev, std::vector<QtumTransaction>(extraction->extracted.first), blockGasLimit, schedule, stateBase, &nSerialPos, i, &speculationStats);
+        }
+        nSpeculations = vSpeculations.size();
+        // The queue hands out its most recently added checks first, so enqueue in reverse
+        // to speculate on the earliest transactions of the block first.
+        std::reverse(vSpeculations.begin(), vSpeculations.end());
+        speculation.Add(vSpeculations);
+    }
 
     for (unsigned int i = 0; i < block.vtx.size(); i++)
     {
         const CTransaction &tx = *(block.vtx[i]);
+        nSerialPos.store(i, std::memory_order_relaxed);
 
         nInputs += tx.vin.size();
 
@@ -3038,33 +4296,6 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
                 return state.DoS(100, error("%s: contains a non-BIP68-final transaction", __func__),
                                  REJECT_INVALID, "bad-txns-nonfinal");
             }
-
-#ifdef ENABLE_BITCORE_RPC
-            ////////////////////////////////////////////////////////////////// // kpg
-            if (fAddressIndex)
-            {
-                for (size_t j = 0; j < tx.vin.size(); j++) {
-                    const CTxIn input = tx.vin[j];
-                    const CTxOut &prevout = view.GetOutputFor(tx.vin[j]);
-
-                    CTxDestination dest;
-                    if (ExtractDestination(input.prevout, prevout.scriptPubKey, dest)) {
-                        valtype bytesID(boost::apply_visitor(DataVisitor(), dest));
-                        if(bytesID.empty()) {
-                            continue;
-                        }
-                        valtype addressBytes(32);
-                        std::copy(bytesID.begin(), bytesID.end(), addressBytes.begin());
-                        addressIndex.push_back(std::make_pair(CAddressIndexKey(dest.which(), uint256(addressBytes), pindex->nHeight, i, tx.GetHash(), j, true), prevout.nValue * -1));
-
-                        // remove address from unspent index
-                        addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(dest.which(), uint256(addressBytes), input.prevout.hash, input.prevout.n), CAddressUnspentValue()));
-                        spentIndex.push_back(std::make_pair(CSpentIndexKey(input.prevout.hash, input.prevout.n), CSpentIndexValue(tx.GetHash(), j, pindex->nHeight, prevout.nValue, dest.which(), uint256(addressBytes))));
-                    }
-                }
-            }
-            //////////////////////////////////////////////////////////////////
-#endif
         }
 
         // GetTransactionSigOpCost counts 3 types of sigops:
@@ -3076,7 +4307,8 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
             return state.DoS(100, error("ConnectBlock(): too many sigops"),
                              REJECT_INVALID, "bad-blk-sigops");
 
-        txdata.emplace_back(tx);
+        if (!txdata[i])
+            txdata[i] = std::make_shared<PrecomputedTransactionData>(tx);
 
         bool hasOpSpend = tx.HasOpSpend();
 
@@ -3088,7 +4320,10 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
             std::vector<CScriptCheck> vChecks;
             bool fCacheResults = fJustCheck; /* Don't cache results if we're actually connecting blocks (still consult the cache, though) */
             //note that coinbase and coinstake can not contain any contract opcodes, this is checked in CheckBlock
-            if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, fCacheResults, txdata[i], (hasOpSpend || tx.HasCreateOrCall()) ? nullptr : (nScriptCheckThreads ? &vChecks : nullptr)))//nScriptCheckThreads ? &vChecks : nullptr))
+            //contract txs are queued like any other; the EVM runs concurrently with their checks, which is
+            //safe as a bad signature fails the block at control.Wait() before its receipts are committed,
+            //and callers reset the state roots of failed blocks
+            if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, fCacheResults, *txdata[i], nScriptCheckThreads ? &vChecks : nullptr))
                 return error("ConnectBlock(): CheckInputs on %s failed with %s",
                     tx.GetHash().ToString(), FormatStateMessage(state));
             control.Add(vChecks);
@@ -3114,7 +4349,10 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         }
 
 ///////////////////////////////////////////////////////////////////////////////////////// KPG
-        if(!CheckOpSender(tx, chainparams, pindex->nHeight)){
+        // The sender checks are cached on mempool entry past QIP5, where CheckOpSender no longer depends on the height
+        const bool fSenderCached = (tx.HasOpSender() || (tx.HasCreateOrCall() && !hasOpSpend)) &&
+            pindex->nHeight >= chainparams.GetConsensus().QIP5Height && IsSenderCheckCached(tx, !fJustCheck);
+        if(!fSenderCached && !CheckOpSender(tx, chainparams, pindex->nHeight)){
             return state.DoS(100, false, REJECT_INVALID, "bad-txns-invalid-sender");
         }
         if(!tx.HasOpSpend()){
@@ -3122,16 +4360,15 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         }
         if(tx.HasCreateOrCall() && !hasOpSpend){
 
-            if(!CheckSenderScript(view, tx)){
+            if(!fSenderCached && !CheckSenderScript(view, tx)){
                 return state.DoS(100, false, REJECT_INVALID, "bad-txns-invalid-sender-script");
             }
 
-            QtumTxConverter convert(tx, &view, &block.vtx, contractflags);
-
-            ExtractQtumTX resultConvertQtumTX;
-            if(!convert.extractionQtumTransactions(resultConvertQtumTX)){
+            const ContractExtraction* extraction = extractContractTxs(i);
+            if(!extraction){
                 return state.DoS(100, error("ConnectBlock(): Contract transaction of the wrong format"), REJECT_INVALID, "bad-tx-bad-contract-format");
             }
+            const ExtractQtumTX& resultConvertQtumTX = extraction->extracted;
             if(!CheckMinGasPrice(resultConvertQtumTX.second, minGasPrice))
                 return state.DoS(100, error("ConnectBlock(): Contract execution has lower gas price than allowed"), REJECT_INVALID, "bad-tx-low-gas-price");
 
@@ -3144,7 +4381,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
             bool nonZeroVersion=false;
             dev::u256 sumGas = dev::u256(0);
             CAmount nTxFee = view.GetValueIn(tx)-tx.GetValueOut();
-            for(QtumTransaction& qtx : resultConvertQtumTX.first){
+            for(const QtumTransaction& qtx : resultConvertQtumTX.first){
                 sumGas += qtx.gas() * qtx.gasPrice();
 
                 if(sumGas > dev::u256(INT64_MAX)) {
@@ -3196,50 +4433,34 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
                 }
             }
 
-            if(!exec.performByteCode()){
-                return state.DoS(100, error("ConnectBlock(): Unknown error during contract execution"), REJECT_INVALID, "bad-tx-unknown-error");
-            }
-
-            std::vector<ResultExecute> resultExec(exec.getResult());
+            int64_t nTimeExec = GetTimeMicros();
+            std::vector<ResultExecute> resultExec;
             ByteCodeExecResult bcer;
-            if(!exec.processingResults(bcer)){
-                return state.DoS(100, error("ConnectBlock(): Error processing VM execution results"), REJECT_INVALID, "bad-vm-exec-processing");
-            }
-
-            countCumulativeGasUsed += bcer.usedGas;
-            std::vector<TransactionReceiptInfo> tri;
-            if (fLogEvents && !fJustCheck)
-            {
-                for(size_t k = 0; k < resultConvertQtumTX.first.size(); k ++){
-                    for(auto& log : resultExec[k].txRec.log()) {
-                        if(!heightIndexes.count(log.address)){
-                            heightIndexes[log.address].first = CHeightTxIndexKey(pindex->nHeight, log.address);
-                        }
-                        heightIndexes[log.address].second.push_back(tx.GetHash());
-                    }
-                    tri.push_back(TransactionReceiptInfo{
-                        block.GetHash(),
-                        uint32_t(pindex->nHeight),
-                        tx.GetHash(),
-                        uint32_t(i),
-                        resultConvertQtumTX.first[k].getNVout(),
-                        resultConvertQtumTX.first[k].from(),
-                        resultConvertQtumTX.first[k].to(),
-                        countCumulativeGasUsed,
-                        uint64_t(resultExec[k].execRes.gasUsed),
-                        resultExec[k].execRes.newAddress,
-                        resultExec[k].txRec.log(),
-                        resultExec[k].execRes.excepted,
-                        exceptedMessage(resultExec[k].execRes.excepted, resultExec[k].execRes.output),
-                        resultExec[k].txRec.stateRoot(),
-                        resultExec[k].txRec.utxoRoot(),
-                        resultExec[k].txRec.createdContracts(),
-                        resultExec[k].txRec.destructedContracts()
-                    });
+            // A block assembled by this node gets the results of the assembler, which ran the
+            // transaction in the same environment from the same state roots
+            std::shared_ptr<const LocalContractExecution> local = FindLocalContractExecution(tx.GetHash(), block, blockGasLimit, contractflags, schedule);
+            if(local && local->hashStateRootBefore == globalState->rootHash() && local->hashUTXORootBefore == globalState->rootHashUTXO()){
+                globalState->setRoot(local->hashStateRootAfter);
+                globalState->setRootUTXO(local->hashUTXORootAfter);
+                resultExec = local->result;
+                bcer = local->bcer;
+            }else{
+                if(!exec.performByteCode(dev::eth::Permanence::Committed, false, fJustCheck ? nullptr : pcontractprofiler.get())){
+                    return state.DoS(100, error("ConnectBlock(): Unknown error during contract execution"), REJECT_INVALID, "bad-tx-unknown-error");
                 }
 
-                pstorageresult->addResult(uintToh256(tx.GetHash()), tri);
+                resultExec = exec.getResult();
+                if(!exec.processingResults(bcer)){
+                    return state.DoS(100, error("ConnectBlock(): Error processing VM execution results"), REJECT_INVALID, "bad-vm-exec-processing");
+                }
             }
+            nTimeContracts += GetTimeMicros() - nTimeExec;
+
+            countCumulativeGasUsed += bcer.usedGas;
+            if (fRecordReceipts)
+                blockReceipts.emplace_back(tx.GetHash(), BuildTransactionReceipts(block, pindex, i, resultConvertQtumTX.first, resultExec, countCumulativeGasUsed));
+            if (!fJustCheck)
+                AppendTokenTransfers(tx, resultExec, tokenTransfers);
 
             blockGasUsed += bcer.usedGas;
             if(blockGasUsed > blockGasLimit){
@@ -3263,56 +4484,52 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         }
 /////////////////////////////////////////////////////////////////////////////////////////
 
-#ifdef ENABLE_BITCORE_RPC
-        /////////////////////////////////////////////////////////////////////////////////// // kpg
-        if (fAddressIndex) {
-
-            for (unsigned int k = 0; k < tx.vout.size(); k++) {
-                const CTxOut &out = tx.vout[k];
-                const bool isTxCoinStake = tx.IsCoinStake();
-
-                CTxDestination dest;
-                if (ExtractDestination({tx.GetHash(), k}, out.scriptPubKey, dest)) {
-                    valtype bytesID(boost::apply_visitor(DataVisitor(), dest));
-                    if(bytesID.empty()) {
-                        continue;
-                    }
-                    valtype addressBytes(32);
-                    std::copy(bytesID.begin(), bytesID.end(), addressBytes.begin());
-                    // record receiving activity
-                    addressIndex.push_back(std::make_pair(CAddressIndexKey(dest.which(), uint256(addressBytes), pindex->nHeight, i, tx.GetHash(), k, false), out.nValue));
-                    // record unspent output
-                    addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(dest.which(), uint256(addressBytes), tx.GetHash(), k), CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight, isTxCoinStake)));
-                }
-            }
-        }
-        ///////////////////////////////////////////////////////////////////////////////////
-#endif
-
         CTxUndo undoDummy;
         if (i > 0) {
             blockundo.vtxundo.push_back(CTxUndo());
         }
         UpdateCoins(tx, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight);
     }
+    nSerialPos.store(std::numeric_limits<unsigned int>::max(), std::memory_order_relaxed);
     int64_t nTime3 = GetTimeMicros(); nTimeConnect += nTime3 - nTime2;
     LogPrint(BCLog::BENCH, "      - Connect %u transactions: %.2fms (%.3fms/tx, %.3fms/txin) [%.2fs (%.2fms/blk)]\n", (unsigned)block.vtx.size(), MILLI * (nTime3 - nTime2), MILLI * (nTime3 - nTime2) / block.vtx.size(), nInputs <= 1 ? 0 : MILLI * (nTime3 - nTime2) / (nInputs-1), nTimeConnect * MICRO, nTimeConnect * MILLI / nBlocksTotal);
+    if (nSpeculations) {
+        // Speculations still running are left out; they finish too late to help
+        LogPrint(BCLog::BENCH, "      - Contract prefetch: %u/%u txs ahead of the serial pass, %u executed, %.2fms on prefetch threads\n",
+                 speculationStats.nAhead.load(), nSpeculations, speculationStats.nRun.load(), MILLI * speculationStats.nTime.load());
+    }
+
+    if (!fJustCheck) {
+        validationStats.Add(ValidationStage::CONNECT, nTime3 - nTime2);
+        validationStats.Add(ValidationStage::CONTRACTS, nTimeContracts);
+    }
 
     if(nFees < gasRefunds) { //make sure it won't overflow
         return state.DoS(1000, error("ConnectBlock(): Less total fees than gas refund fees"), REJECT_INVALID, "bad-blk-fees-greater-gasrefund");
     }
     if(!CheckReward(block, state, pindex->nHeight, chainparams.GetConsensus(), nFees, gasRefunds, nActualStakeReward, checkVouts))
         return state.DoS(100,error("ConnectBlock(): Reward check failed"), REJECT_INVALID, "block-reward-invalid");
+    int64_t nTimeReward = GetTimeMicros();
     if (!control.Wait())
         return state.DoS(100, error("%s: CheckQueue failed", __func__), REJECT_INVALID, "block-validation-failed");
     int64_t nTime4 = GetTimeMicros(); nTimeVerify += nTime4 - nTime2;
     LogPrint(BCLog::BENCH, "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs (%.2fms/blk)]\n", nInputs - 1, MILLI * (nTime4 - nTime2), nInputs <= 1 ? 0 : MILLI * (nTime4 - nTime2) / (nInputs-1), nTimeVerify * MICRO, nTimeVerify * MILLI / nBlocksTotal);
+    if (!fJustCheck) {
+        validationStats.Add(ValidationStage::REWARD, nTimeReward - nTime3);
+        validationStats.Add(ValidationStage::VERIFY, nTime4 - nTimeReward);
+    }
 
 ////////////////////////////////////////////////////////////////// // kpg
     checkBlock.hashMerkleRoot = BlockMerkleRoot(checkBlock);
     checkBlock.hashStateRoot = h256Touint(globalState->rootHash());
     checkBlock.hashUTXORoot = h256Touint(globalState->rootHashUTXO());
 
+    // Write the trie nodes of all the contract executions of the block in one batch;
+    // nodes created and superseded inside the block never reach the database.
+    globalState->db().commit();
+    globalState->dbUtxo().commit();
+    int64_t nTimeStateCommit = GetTimeMicros();
+
     //If this error happens, it probably means that something with AAL created transactions didn't match up to what is expected
     if((checkBlock.GetHash() != block.GetHash()) && !fJustCheck)
     {
@@ -3380,6 +4597,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         globalState->setRootUTXO(prevHashUTXORoot);
         return true;
     }
+    validationStats.Add(ValidationStage::STATE_COMMIT, nTimeStateCommit - nTime4);
 //////////////////////////////////////////////////////////////////
 
     pindex->nMoneySupply = (pindex->pprev? pindex->pprev->nMoneySupply : 0) + nValueOut - nValueIn;
@@ -3399,14 +4617,6 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         pindex->RaiseValidity(BLOCK_VALID_SCRIPTS);
         setDirtyBlockIndex.insert(pindex);
     }
-    if (fLogEvents)
-    {
-        for (const auto& e: heightIndexes)
-        {
-            if (!pblocktree->WriteHeightIndex(e.second.first, e.second.second))
-                return AbortNode(state, "Failed to write height index");
-        }
-    }    
     if(block.IsProofOfStake()){
         // Read the public key from the second output
         std::vector<unsigned char> vchPubKey;
@@ -3414,59 +4624,36 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         {
             uint160 pkh = uint160(ToByteVector(CPubKey(vchPubKey).GetID()));
             pblocktree->WriteStakeIndex(pindex->nHeight, pkh);
+            AddMPoSStakerToCache(pindex, pkh);
         }else{
             pblocktree->WriteStakeIndex(pindex->nHeight, uint160());
+            AddMPoSStakerToCache(pindex, uint160());
         }
-    }else{
-        pblocktree->WriteStakeIndex(pindex->nHeight, uint160());
     }
 
     assert(pindex->phashBlock);
-#ifdef ENABLE_BITCORE_RPC
-    ///////////////////////////////////////////////////////////// // kpg
-    if (fAddressIndex) {
-        if (!pblocktree->WriteAddressIndex(addressIndex)) {
-            return AbortNode(state, "Failed to write address index");
-        }
-        if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
-            return AbortNode(state, "Failed to write address unspent index");
-        }
-
-        if (!pblocktree->UpdateSpentIndex(spentIndex))
-            return AbortNode(state, "Failed to write transaction index");
-
-        unsigned int logicalTS = pindex->nTime;
-        unsigned int prevLogicalTS = 0;
-
-        // retrieve logical timestamp of the previous block
-        if (pindex->pprev)
-            if (!pblocktree->ReadTimestampBlockIndex(pindex->pprev->GetBlockHash(), prevLogicalTS))
-                LogPrintf("%s: Failed to read previous block's logical timestamp\n", __func__);
-
-        if (logicalTS <= prevLogicalTS) {
-            logicalTS = prevLogicalTS + 1;
-            LogPrintf("%s: Previous logical timestamp is newer Actual[%d] prevLogical[%d] Logical[%d]\n", __func__, pindex->nTime, prevLogicalTS, logicalTS);
-        }
-
-        if (!pblocktree->WriteTimestampIndex(CTimestampIndexKey(logicalTS, pindex->GetBlockHash())))
-            return AbortNode(state, "Failed to write timestamp index");
-
-        if (!pblocktree->WriteTimestampBlockIndex(CTimestampBlockIndexKey(pindex->GetBlockHash()), CTimestampBlockIndexValue(logicalTS)))
-            return AbortNode(state, "Failed to write blockhash index");
-    }
-    /////////////////////////////////////////////////////////////
-#endif
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
     int64_t nTime5 = GetTimeMicros(); nTimeIndex += nTime5 - nTime4;
     LogPrint(BCLog::BENCH, "    - Index writing: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime5 - nTime4), nTimeIndex * MICRO, nTimeIndex * MILLI / nBlocksTotal);
+    validationStats.Add(ValidationStage::INDEX, nTime5 - nTimeStateCommit);
 
     int64_t nTime6 = GetTimeMicros(); nTimeCallbacks += nTime6 - nTime5;
     LogPrint(BCLog::BENCH, "    - Callbacks: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime6 - nTime5), nTimeCallbacks * MICRO, nTimeCallbacks * MILLI / nBlocksTotal);
 
-    if (fLogEvents)
-        pstorageresult->commitResults();
+    if (fRecordReceipts) {
+        std::shared_ptr<const BlockReceipts> preceipts = std::make_shared<const BlockReceipts>(std::move(blockReceipts));
+        g_logindex->AddPendingReceipts(pindex, preceipts);
+        GetMainSignals().BlockReceiptsConnected(pindex, preceipts);
+        validationStats.Add(ValidationStage::RECEIPTS, GetTimeMicros() - nTime6);
+    }
+
+    if (!tokenTransfers.empty())
+        GetMainSignals().TokenTransfersConnected(pindex, std::make_shared<const std::vector<TokenTransferLog>>(std::move(tokenTransfers)));
+
+    if (pblockundo)
+        *pblockundo = std::move(blockundo);
 
     return true;
 }
@@ -3516,7 +4703,8 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             nLastFlush = nNow;
         }
         int64_t nMempoolSizeMax = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
-        int64_t cacheSize = pcoinsTip->DynamicMemoryUsage() * DB_PEAK_USAGE_FACTOR;
+        // The coins of a background flush still being written count as well
+        int64_t cacheSize = (pcoinsTip->DynamicMemoryUsage() + (pcoinsflusher ? pcoinsflusher->PendingMemoryUsage() : 0)) * DB_PEAK_USAGE_FACTOR;
         int64_t nTotalSpace = nCoinCacheUsage + std::max<int64_t>(nMempoolSizeMax - nMempoolUsage, 0);
         // The cache is large and we're within 10% and 10 MiB of the limit, but we have time now (not in the middle of a block processing).
         bool fCacheLarge = mode == FlushStateMode::PERIODIC && cacheSize > std::max((9 * nTotalSpace) / 10, nTotalSpace - MAX_BLOCK_COINSDB_USAGE * 1024 * 1024);
@@ -3567,16 +4755,27 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             // overwrite one. Still, use a conservative safety factor of 2.
             if (!CheckDiskSpace(48 * 2 * 2 * pcoinsTip->GetCacheSize()))
                 return state.Error("out of disk space");
-            // Flush the chainstate (which may refer to block index entries).
-            if (!pcoinsTip->Flush())
+            // Flush the chainstate (which may refer to block index entries). When the
+            // flush is only due to time, keep the coins cached and write the changed ones.
+            const bool fSyncOnly = fPeriodicFlush && !fCacheLarge && !fFlushForPrune;
+            if (!(fSyncOnly ? pcoinsTip->Sync() : pcoinsTip->Flush()))
+                return AbortNode(state, "Failed to write to coin database");
+            // A background flush is written after we return, unless the caller needs the
+            // coins on disk (or block files are about to be deleted)
+            if (pcoinsflusher && (mode == FlushStateMode::ALWAYS || fFlushForPrune) && !pcoinsflusher->Wait())
                 return AbortNode(state, "Failed to write to coin database");
             nLastFlush = nNow;
             full_flush_completed = true;
         }
     }
     if (full_flush_completed) {
-        // Update best block in wallet (so we can detect restored wallets).
-        GetMainSignals().ChainStateFlushed(chainActive.GetLocator());
+        // Update best block in wallet (so we can detect restored wallets), once the
+        // chainstate on disk has it
+        CBlockLocator locator = chainActive.GetLocator();
+        if (pcoinsflusher)
+            pcoinsflusher->WhenWritten([locator] { GetMainSignals().ChainStateFlushed(locator); });
+        else
+            GetMainSignals().ChainStateFlushed(locator);
     }
     } catch (const std::runtime_error& e) {
         return AbortNode(state, std::string("System error while flushing: ") + e.what());
@@ -3592,6 +4791,36 @@ void FlushStateToDisk() {
     }
 }
 
+bool WriteBlockIndexSnapshot() {
+    AssertLockHeld(cs_main);
+    // The snapshot has to match the block index in the database
+    if (!pblocktree || !setDirtyBlockIndex.empty() || !setDirtyFileInfo.empty())
+        return false;
+    std::vector<const CBlockIndex*> vIndex;
+    vIndex.reserve(mapBlockIndex.size());
+    for (const std::pair<const uint256, CBlockIndex*>& item : mapBlockIndex)
+        vIndex.push_back(item.second);
+    return pblocktree->WriteBlockIndexSnapshot(vIndex);
+}
+
+CBlockIndex* NewBlockIndex()
+{
+    AssertLockHeld(cs_main);
+    return new (g_block_index_resource.Allocate(sizeof(CBlockIndex), alignof(CBlockIndex))) CBlockIndex();
+}
+
+CBlockIndex* NewBlockIndex(const CBlockHeader& block)
+{
+    AssertLockHeld(cs_main);
+    return new (g_block_index_resource.Allocate(sizeof(CBlockIndex), alignof(CBlockIndex))) CBlockIndex(block);
+}
+
+void DeleteBlockIndex(CBlockIndex* pindex)
+{
+    pindex->~CBlockIndex();
+    g_block_index_resource.Deallocate(pindex, sizeof(CBlockIndex), alignof(CBlockIndex));
+}
+
 void PruneAndFlush() {
     CValidationState state;
     fCheckForPruning = true;
@@ -3618,11 +4847,73 @@ static void AppendWarning(std::string& res, const std::string& warn)
     res += warn;
 }
 
+static std::shared_ptr<const ChainTipSnapshot> g_chain_tip_snapshot = std::make_shared<const ChainTipSnapshot>();
+
+std::shared_ptr<const ChainTipSnapshot> GetChainTipSnapshot()
+{
+    return std::atomic_load(&g_chain_tip_snapshot);
+}
+
+/** Publish the snapshot of the current tip of chainActive */
+static void PublishChainTipSnapshot(const CChainParams& chainParams) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    const std::shared_ptr<const ChainTipSnapshot> prev = GetChainTipSnapshot();
+    std::shared_ptr<ChainTipSnapshot> snapshot = std::make_shared<ChainTipSnapshot>();
+    const CBlockIndex* pindex = chainActive.Tip();
+    if (pindex) {
+        snapshot->nHeight = pindex->nHeight;
+        snapshot->hashBlock = pindex->GetBlockHash();
+        snapshot->nTime = pindex->GetBlockTime();
+        snapshot->nMedianTimePast = pindex->GetMedianTimePast();
+        snapshot->nBits = pindex->nBits;
+        // A tip extending the previous one only needs looking at itself
+        if (pindex->IsProofOfStake() || !pindex->pprev || pindex->pprev->GetBlockHash() != prev->hashBlock)
+            snapshot->nPoSBits = GetLastBlockIndex(pindex, true)->nBits;
+        else
+            snapshot->nPoSBits = prev->nPoSBits;
+        snapshot->nChainWork = pindex->nChainWork;
+        snapshot->nMoneySupply = pindex->nMoneySupply;
+        snapshot->hashStateRoot = pindex->hashStateRoot;
+        snapshot->hashUTXORoot = pindex->hashUTXORoot;
+        snapshot->dVerificationProgress = GuessVerificationProgress(chainParams.TxData(), pindex);
+        // Connecting or disconnecting a block shifts the hashes of the previous tip by one
+        if (prev->lastHashes && pindex->pprev && pindex->pprev->GetBlockHash() == prev->hashBlock) {
+            std::shared_ptr<dev::h256s> lastHashes = std::make_shared<dev::h256s>(LAST_HASHES_COUNT);
+            (*lastHashes)[0] = uintToh256(pindex->GetBlockHash());
+            std::copy(prev->lastHashes->begin(), prev->lastHashes->end() - 1, lastHashes->begin() + 1);
+            snapshot->lastHashes = std::move(lastHashes);
+        } else if (prev->lastHashes && prev->nHeight == pindex->nHeight + 1 && (*prev->lastHashes)[1] == uintToh256(pindex->GetBlockHash())) {
+            std::shared_ptr<dev::h256s> lastHashes = std::make_shared<dev::h256s>(LAST_HASHES_COUNT);
+            std::copy(prev->lastHashes->begin() + 1, prev->lastHashes->end(), lastHashes->begin());
+            const CBlockIndex* pindexLast = pindex->GetAncestor(pindex->nHeight - (LAST_HASHES_COUNT - 1));
+            if (pindexLast)
+                lastHashes->back() = uintToh256(pindexLast->GetBlockHash());
+            snapshot->lastHashes = std::move(lastHashes);
+        } else {
+            snapshot->lastHashes = ReadLastHashes(pindex);
+        }
+
+        const Consensus::Params& consensusParams = chainParams.GetConsensus();
+        for (int i = 0; i < Consensus::MAX_VERSION_BITS_DEPLOYMENTS; i++) {
+            const Consensus::DeploymentPos pos = static_cast<Consensus::DeploymentPos>(i);
+            ChainTipSnapshot::Deployment& deployment = snapshot->vDeployments[i];
+            deployment.state = VersionBitsTipState(consensusParams, pos);
+            deployment.nSinceHeight = VersionBitsTipStateSinceHeight(consensusParams, pos);
+            if (deployment.state == ThresholdState::STARTED)
+                deployment.stats = VersionBitsTipStatistics(consensusParams, pos);
+        }
+    }
+    std::atomic_store(&g_chain_tip_snapshot, std::shared_ptr<const ChainTipSnapshot>(std::move(snapshot)));
+}
+
 /** Check warning conditions and do some notifications on new chain tip set. */
 void static UpdateTip(const CBlockIndex *pindexNew, const CChainParams& chainParams) {
     // New best block
     mempool.AddTransactionsUpdated(1);
 
+    PublishChainTipSnapshot(chainParams);
+    ClearLocalContractExecutions();
+
     {
         LOCK(g_best_block_mutex);
         g_best_block = pindexNew->GetBlockHash();
@@ -3678,21 +4969,78 @@ void static UpdateTip(const CBlockIndex *pindexNew, const CChainParams& chainPar
   * disconnectpool (note that the caller is responsible for mempool consistency
   * in any case).
   */
-bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& chainparams, DisconnectedBlockTransactions *disconnectpool)
+/** Number of the last connected blocks whose block and undo data DisconnectTip keeps in memory */
+static const size_t DISCONNECT_CACHE_BLOCKS = 10;
+
+/** Block and undo data of a block to disconnect, null where they could not be read */
+struct CDisconnectData
+{
+    std::shared_ptr<const CBlock> pblock;
+    std::shared_ptr<const CBlockUndo> pundo;
+};
+
+/**
+ * Data of the blocks DisconnectTip is likely to need: the last blocks connected by
+ * ConnectTip, with the undo data it just wrote, so that the short reorgs common with
+ * many stakers read nothing from disk, and the next block of a longer disconnection,
+ * read on another thread while the current one is disconnected.
+ */
+static std::deque<std::pair<const CBlockIndex*, CDisconnectData>> dequeDisconnectData GUARDED_BY(cs_main);
+static std::pair<const CBlockIndex*, std::future<CDisconnectData>> futureDisconnectData GUARDED_BY(cs_main);
+
+static CDisconnectData ReadDisconnectData(const CBlockIndex* pindex, const Consensus::Params& consensusParams)
+{
+    CDisconnectData data;
+    std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+    if (ReadBlockFromDisk(*pblock, pindex, consensusParams))
+        data.pblock = std::move(pblock);
+    std::shared_ptr<CBlockUndo> pundo = std::make_shared<CBlockUndo>();
+    if (UndoReadFromDisk(*pundo, pindex))
+        data.pundo = std::move(pundo);
+    return data;
+}
+
+static void ClearDisconnectData() EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    dequeDisconnectData.clear();
+    futureDisconnectData = std::make_pair(nullptr, std::future<CDisconnectData>());
+}
+
+bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& chainparams, DisconnectedBlockTransactions *disconnectpool, const CBlockIndex* pindexKeep)
 {
     CBlockIndex *pindexDelete = chainActive.Tip();
     assert(pindexDelete);
+    CDisconnectData data;
+    if (!dequeDisconnectData.empty() && dequeDisconnectData.back().first == pindexDelete) {
+        data = std::move(dequeDisconnectData.back().second);
+        dequeDisconnectData.pop_back();
+    } else {
+        dequeDisconnectData.clear();
+        if (futureDisconnectData.first == pindexDelete)
+            data = futureDisconnectData.second.get();
+    }
+    futureDisconnectData = std::make_pair(nullptr, std::future<CDisconnectData>());
+
+    // Read the next block to disconnect while this one is
+    const CBlockIndex* pindexNext = pindexDelete->pprev;
+    if (pindexKeep && pindexNext && pindexNext != pindexKeep && pindexNext->nHeight > pindexKeep->nHeight && dequeDisconnectData.empty())
+        futureDisconnectData = std::make_pair(pindexNext, std::async(std::launch::async, ReadDisconnectData, pindexNext, std::cref(chainparams.GetConsensus())));
+
     // Read block from disk.
-    std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-    CBlock& block = *pblock;
-    if (!ReadBlockFromDisk(block, pindexDelete, chainparams.GetConsensus()))
-        return AbortNode(state, "Failed to read block");
+    if (!data.pblock) {
+        std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
+        if (!ReadBlockFromDisk(*pblockRead, pindexDelete, chainparams.GetConsensus()))
+            return AbortNode(state, "Failed to read block");
+        data.pblock = std::move(pblockRead);
+    }
+    std::shared_ptr<const CBlock> pblock = data.pblock;
+    const CBlock& block = *pblock;
     // Apply the block atomically to the chain state.
     int64_t nStart = GetTimeMicros();
     {
         CCoinsViewCache view(pcoinsTip.get());
         assert(view.GetBestBlock() == pindexDelete->GetBlockHash());
-        if (DisconnectBlock(block, pindexDelete, view, nullptr) != DISCONNECT_OK)
+        if (DisconnectBlock(block, pindexDelete, view, nullptr, data.pundo.get()) != DISCONNECT_OK)
             return error("DisconnectTip(): DisconnectBlock %s failed", pindexDelete->GetBlockHash().ToString());
         bool flushed = view.Flush();
         assert(flushed);
@@ -3716,6 +5064,7 @@ bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& cha
     }
 
     chainActive.SetTip(pindexDelete->pprev);
+    recentSpentCoins.DisconnectBlock(pindexDelete);
 
     UpdateTip(pindexDelete->pprev, chainparams);
     // Let wallets know transactions went from 1-confirmed to
@@ -3792,6 +5141,58 @@ public:
     }
 };
 
+/**
+ * Roots of the contract state that pruning keeps: the -prunestate blocks below pindexTip,
+ * and the blocks a restart may need. After a crash, or with the coins flush lagging,
+ * the coins database is at an older block (or between two blocks of an interrupted
+ * flush), and the blocks from there to the tip are connected again from its state.
+ */
+static std::vector<StateRoots> ContractStateRootsToKeep(const CBlockIndex* pindexTip) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    int nLowest = pindexTip->nHeight - (int)pstatepruner->KeepBlocks();
+    std::set<const CBlockIndex*> setKeep;
+    auto keepBranch = [&](const uint256& hash) {
+        const CBlockIndex* pindex = LookupBlockIndex(hash);
+        // The blocks of another branch are disconnected first
+        for (; pindex && !chainActive.Contains(pindex); pindex = pindex->pprev)
+            setKeep.insert(pindex);
+        if (pindex)
+            nLowest = std::min(nLowest, pindex->nHeight);
+    };
+    keepBranch(pcoinsdbview->GetBestBlock());
+    for (const uint256& hash : pcoinsdbview->GetHeadBlocks())
+        keepBranch(hash);
+    if (pcoinsflusher)
+        keepBranch(pcoinsflusher->GetBestBlock());
+    for (const CBlockIndex* pindex = pindexTip; pindex && pindex->nHeight >= nLowest; pindex = pindex->pprev)
+        setKeep.insert(pindex);
+
+    std::vector<StateRoots> roots = pstatepruner->PinnedRoots();
+    for (const CBlockIndex* pindex : setKeep)
+        roots.emplace_back(uintToh256(pindex->hashStateRoot), uintToh256(pindex->hashUTXORoot));
+    return roots;
+}
+
+/** Start deleting the contract state trie nodes that are not used by the blocks whose state is kept */
+static void PruneContractState(const CBlockIndex* pindexTip) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    // Nothing may stay in the overlays only, or nodes they reference could be swept
+    globalState->db().commit();
+    globalState->dbUtxo().commit();
+
+    if (!pstatepruner->PruneInBackground(ContractStateRootsToKeep(pindexTip)))
+        LogPrint(BCLog::PRUNE, "Contract state pruning at height %d skipped, the previous run is still in progress\n", pindexTip->nHeight);
+}
+
+bool IsContractStateAvailable(const CBlockIndex* pindex)
+{
+    AssertLockHeld(cs_main);
+    if (!pstatepruner)
+        return true;
+    // Another branch may have been kept for a restart, but it is not kept for long
+    return chainActive.Contains(pindex) && pindex->nHeight >= chainActive.Height() - (int)pstatepruner->KeepBlocks();
+}
+
 /**
  * Connect a new block to chainActive. pblock is either nullptr or a pointer to a CBlock
  * corresponding to pindexNew, to bypass loading it again from disk.
@@ -3805,10 +5206,15 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     int64_t nTime1 = GetTimeMicros();
     std::shared_ptr<const CBlock> pthisBlock;
     if (!pblock) {
-        std::shared_ptr<CBlock> pblockNew = std::make_shared<CBlock>();
-        if (!ReadBlockFromDisk(*pblockNew, pindexNew, chainparams.GetConsensus()))
-            return AbortNode(state, "Failed to read block");
-        pthisBlock = pblockNew;
+        // During IBD the block may have been read ahead already
+        if (pblockprefetcher)
+            pthisBlock = pblockprefetcher->Take(pindexNew->GetBlockHash());
+        if (!pthisBlock) {
+            std::shared_ptr<CBlock> pblockNew = std::make_shared<CBlock>();
+            if (!ReadBlockFromDisk(*pblockNew, pindexNew, chainparams.GetConsensus()))
+                return AbortNode(state, "Failed to read block");
+            pthisBlock = pblockNew;
+        }
     } else {
         pthisBlock = pblock;
     }
@@ -3817,13 +5223,14 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     int64_t nTime2 = GetTimeMicros(); nTimeReadFromDisk += nTime2 - nTime1;
     int64_t nTime3;
     LogPrint(BCLog::BENCH, "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * MILLI, nTimeReadFromDisk * MICRO);
+    CBlockUndo blockundo;
     {
         CCoinsViewCache view(pcoinsTip.get());
 
         dev::h256 oldHashStateRoot(globalState->rootHash()); // kpg
         dev::h256 oldHashUTXORoot(globalState->rootHashUTXO()); // kpg
 
-        bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams);
+        bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams, false, &blockundo, true);
         GetMainSignals().BlockChecked(blockConnecting, state);
         if (!rv) {
             if (state.IsInvalid())
@@ -3831,7 +5238,6 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
 
             globalState->setRoot(oldHashStateRoot); // kpg
             globalState->setRootUTXO(oldHashUTXORoot); // kpg
-            pstorageresult->clearCacheResult();
             return error("%s: ConnectBlock %s failed, %s", __func__, pindexNew->GetBlockHash().ToString(), FormatStateMessage(state));
         }
         nTime3 = GetTimeMicros(); nTimeConnectTotal += nTime3 - nTime2;
@@ -3852,10 +5258,30 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     // Update chainActive & related variables.
     chainActive.SetTip(pindexNew);
     UpdateTip(pindexNew, chainparams);
+    recentSpentCoins.ConnectBlock(pindexNew, blockConnecting, blockundo);
+    if (!dequeDisconnectData.empty() && dequeDisconnectData.back().first != pindexNew->pprev)
+        dequeDisconnectData.clear();
+    dequeDisconnectData.emplace_back(pindexNew, CDisconnectData{pthisBlock, std::make_shared<const CBlockUndo>(std::move(blockundo))});
+    if (dequeDisconnectData.size() > DISCONNECT_CACHE_BLOCKS)
+        dequeDisconnectData.pop_front();
+    if (pstatepruner && pindexNew->nHeight % PRUNE_STATE_INTERVAL == 0)
+        PruneContractState(pindexNew); // kpg
+    // Accounts read outside of contract executions, as the DGP parameters, stay decoded until the next commit
+    if (globalState->cacheMemoryUsage() > MAX_STATE_CACHE_USAGE)
+        globalState->clearCaches(); // kpg
+    if (pcontractprofiler && nContractProfileLogInterval && pindexNew->nHeight % nContractProfileLogInterval == 0)
+        pcontractprofiler->LogProfile(CONTRACT_PROFILE_LOG_TOP); // kpg
 
     int64_t nTime6 = GetTimeMicros(); nTimePostConnect += nTime6 - nTime5; nTimeTotal += nTime6 - nTime1;
     LogPrint(BCLog::BENCH, "  - Connect postprocess: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime5) * MILLI, nTimePostConnect * MICRO, nTimePostConnect * MILLI / nBlocksTotal);
     LogPrint(BCLog::BENCH, "- Connect block: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime1) * MILLI, nTimeTotal * MICRO, nTimeTotal * MILLI / nBlocksTotal);
+    validationStats.Add(ValidationStage::READ_BLOCK, nTime2 - nTime1);
+    validationStats.Add(ValidationStage::CONNECT_BLOCK, nTime3 - nTime2);
+    validationStats.Add(ValidationStage::FLUSH, nTime4 - nTime3);
+    validationStats.Add(ValidationStage::CHAINSTATE, nTime5 - nTime4);
+    validationStats.Add(ValidationStage::POST_CONNECT, nTime6 - nTime5);
+    validationStats.Add(ValidationStage::TOTAL, nTime6 - nTime1);
+    validationTimes.BlockConnected(blockConnecting, pindexNew, nTime2, nTime3, nTime6);
 
     connectTrace.BlockConnected(pindexNew, std::move(pthisBlock));
     return true;
@@ -3946,7 +5372,7 @@ bool CChainState::ActivateBestChainStep(CValidationState& state, const CChainPar
     bool fBlocksDisconnected = false;
     DisconnectedBlockTransactions disconnectpool;
     while (chainActive.Tip() && chainActive.Tip() != pindexFork) {
-        if (!DisconnectTip(state, chainparams, &disconnectpool)) {
+        if (!DisconnectTip(state, chainparams, &disconnectpool, pindexFork)) {
             // This is likely a fatal error, but keep the mempool consistent,
             // just in case. Only remove from the mempool in this case.
             UpdateMempoolForReorg(disconnectpool, false);
@@ -3974,6 +5400,8 @@ bool CChainState::ActivateBestChainStep(CValidationState& state, const CChainPar
 
         // Connect new blocks.
         for (CBlockIndex *pindexConnect : reverse_iterate(vpindexToConnect)) {
+            if (pblockprefetcher && IsInitialBlockDownload())
+                pblockprefetcher->Schedule(chainActive.Tip(), pindexMostWork);
             if (!ConnectTip(state, chainparams, pindexConnect, pindexConnect == pindexMostWork ? pblock : std::shared_ptr<const CBlock>(), connectTrace, disconnectpool)) {
                 if (state.IsInvalid()) {
                     // The block violates a consensus rule.
@@ -4042,7 +5470,7 @@ static void NotifyHeaderTip() LOCKS_EXCLUDED(cs_main) {
 static void LimitValidationInterfaceQueue() {
     AssertLockNotHeld(cs_main);
 
-    if (GetMainSignals().CallbacksPending() > 10) {
+    if (GetMainSignals().CallbacksPending() > MAX_VALIDATION_INTERFACE_CALLBACKS_PENDING) {
         SyncWithValidationInterfaceQueue();
     }
 }
@@ -4211,7 +5639,7 @@ bool CChainState::InvalidateBlock(CValidationState& state, const CChainParams& c
         // ActivateBestChain considers blocks already in chainActive
         // unconditionally valid already, so force disconnect away from it.
         DisconnectedBlockTransactions disconnectpool;
-        bool ret = DisconnectTip(state, chainparams, &disconnectpool);
+        bool ret = DisconnectTip(state, chainparams, &disconnectpool, pindex->pprev);
         // DisconnectTip will add transactions to disconnectpool.
         // Adjust the mempool to be consistent with the new tip, adding
         // transactions back to the mempool if disconnecting was succesful,
@@ -4328,7 +5756,7 @@ CBlockIndex* CChainState::AddToBlockIndex(const CBlockHeader& block)
         return it->second;
 
     // Construct new block index object
-    CBlockIndex* pindexNew = new CBlockIndex(block);
+    CBlockIndex* pindexNew = NewBlockIndex(block);
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
@@ -4348,8 +5776,10 @@ CBlockIndex* CChainState::AddToBlockIndex(const CBlockHeader& block)
     pindexNew->nChainWork = (pindexNew->pprev ? pindexNew->pprev->nChainWork : 0) + GetBlockProof(*pindexNew);
     pindexNew->nStakeModifier = ComputeStakeModifier(pindexNew->pprev, block.IsProofOfWork() ? hash : block.prevoutStake.hash);
     pindexNew->RaiseValidity(BLOCK_VALID_TREE);
-    if (pindexBestHeader == nullptr || pindexBestHeader->nChainWork < pindexNew->nChainWork)
+    if (pindexBestHeader == nullptr || pindexBestHeader->nChainWork < pindexNew->nChainWork) {
         pindexBestHeader = pindexNew;
+        nBestHeaderHeight = pindexNew->nHeight;
+    }
 
     setDirtyBlockIndex.insert(pindexNew);
 
@@ -4429,6 +5859,7 @@ static bool FindBlockPos(CDiskBlockPos &pos, unsigned int nAddSize, unsigned int
         }
         FlushBlockFile(!fKnown);
         nLastBlockFile = nFile;
+        g_block_file_maps.SetFinalizedFiles(nLastBlockFile);
     }
 
     vinfoBlockFile[nFile].AddBlock(nHeight, nTime);
@@ -4444,8 +5875,10 @@ static bool FindBlockPos(CDiskBlockPos &pos, unsigned int nAddSize, unsigned int
             if (fPruneMode)
                 fCheckForPruning = true;
             if (CheckDiskSpace(nNewChunks * BLOCKFILE_CHUNK_SIZE - pos.nPos, true)) {
-                FILE *file = OpenBlockFile(pos);
-                if (file) {
+                if (g_block_file_writer) {
+                    if (!g_block_file_writer->Allocate(pos, false, nNewChunks * BLOCKFILE_CHUNK_SIZE - pos.nPos))
+                        return error("%s: writing block file failed", __func__);
+                } else if (FILE *file = OpenBlockFile(pos)) {
                     LogPrintf("Pre-allocating up to position 0x%x in blk%05u.dat\n", nNewChunks * BLOCKFILE_CHUNK_SIZE, pos.nFile);
                     AllocateFileRange(file, pos.nPos, nNewChunks * BLOCKFILE_CHUNK_SIZE - pos.nPos);
                     fclose(file);
@@ -4477,8 +5910,10 @@ static bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos,
         if (fPruneMode)
             fCheckForPruning = true;
         if (CheckDiskSpace(nNewChunks * UNDOFILE_CHUNK_SIZE - pos.nPos, true)) {
-            FILE *file = OpenUndoFile(pos);
-            if (file) {
+            if (g_block_file_writer) {
+                if (!g_block_file_writer->Allocate(pos, true, nNewChunks * UNDOFILE_CHUNK_SIZE - pos.nPos))
+                    return state.Error("writing undo file failed");
+            } else if (FILE *file = OpenUndoFile(pos)) {
                 LogPrintf("Pre-allocating up to position 0x%x in rev%05u.dat\n", nNewChunks * UNDOFILE_CHUNK_SIZE, pos.nFile);
                 AllocateFileRange(file, pos.nPos, nNewChunks * UNDOFILE_CHUNK_SIZE - pos.nPos);
                 fclose(file);
@@ -4511,7 +5946,7 @@ bool CheckFirstCoinstakeOutput(const CBlock& block)
 
 #ifdef ENABLE_WALLET
 // novacoin: attempt to generate suitable proof-of-stake
-bool SignBlock(std::shared_ptr<CBlock> pblock, CWallet& wallet, const CAmount& nTotalFees, uint32_t nTime, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoins)
+bool SignBlock(std::shared_ptr<CBlock> pblock, CWallet& wallet, const CAmount& nTotalFees, uint32_t nTime, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoins, const COutPoint* pprevoutKernel)
 {
     // if we are trying to sign
     //    something except proof-of-stake block template
@@ -4532,7 +5967,7 @@ bool SignBlock(std::shared_ptr<CBlock> pblock, CWallet& wallet, const CAmount& n
     //IsProtocolV2 mean POS 2 or higher, so the modified line is:
     auto locked_chain = wallet.chain().lock();
     LOCK(wallet.cs_wallet);
-    if (wallet.CreateCoinStake(*locked_chain, wallet, pblock->nBits, nTotalFees, nTimeBlock, txCoinStake, key, setCoins))
+    if (wallet.CreateCoinStake(*locked_chain, wallet, pblock->nBits, nTotalFees, nTimeBlock, txCoinStake, key, setCoins, pprevoutKernel))
     {
         if (nTimeBlock >= chainActive.Tip()->GetMedianTimePast()+1)
         {
@@ -4615,9 +6050,20 @@ bool CheckBlockSignature(const CBlock& block)
         return false;
     }
 
-    return CPubKey(vchPubKey).Verify(block.GetHashWithoutSign(), block.vchBlockSig);
+    return CheckBlockSigner(block.GetHashWithoutSign(), block.vchBlockSig, CPubKey(vchPubKey));
 }
 
+/** Blocks with at least this many transactions have them checked on the precheck threads */
+static const size_t MIN_PARALLEL_CHECKBLOCK_TXS = 128;
+
+/** Outcome of the context-free checks of one transaction of a block */
+struct CTxCheckResult
+{
+    CValidationState state;
+    bool fValid = true;
+    unsigned int nSigOps = 0;
+};
+
 static bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, bool fCheckPOS = true)
 {
     // Check proof of work matches claimed amount
@@ -4647,8 +6093,28 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
     if (block.IsProofOfStake() &&  block.GetBlockTime() > FutureDrift(GetAdjustedTime()))
         return error("CheckBlock() : block timestamp too far in the future");
 
+    // The transaction checks of large blocks run on the precheck threads while this thread
+    // checks the merkle root and the block layout; their results are looked at last, in
+    // transaction order, so that the first error reported stays the same
+    bool fParallelTxChecks = nScriptCheckThreads && block.vtx.size() >= MIN_PARALLEL_CHECKBLOCK_TXS;
+    std::vector<CTxCheckResult> vTxResults(fParallelTxChecks ? block.vtx.size() : 0);
+    CCheckQueueControl<CPrecheck> txcontrol(fParallelTxChecks ? &precheckqueue : nullptr);
+    if (fParallelTxChecks) {
+        std::vector<CPrecheck> vChecks;
+        vChecks.reserve(block.vtx.size());
+        for (size_t i = 0; i < block.vtx.size(); i++) {
+            const CTransaction& tx = *block.vtx[i];
+            CTxCheckResult& result = vTxResults[i];
+            vChecks.emplace_back([&tx, &result] {
+                result.fValid = CheckTransaction(tx, result.state, true);
+                result.nSigOps = GetLegacySigOpCount(tx);
+            });
+        }
+        txcontrol.Add(vChecks);
+    }
+
     // Check the merkle root.
-    if (fCheckMerkleRoot) {
+    if (fCheckMerkleRoot && !block.fPrechecked) {
         bool mutated;
         uint256 hashMerkleRoot2 = BlockMerkleRoot(block, &mutated);
         if (block.hashMerkleRoot != hashMerkleRoot2)
@@ -4707,13 +6173,24 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
     }
 
     // Check proof-of-stake block signature
-    if (fCheckSig && !CheckBlockSignature(block))
+    if (fCheckSig && !block.fPrechecked && !CheckBlockSignature(block))
         return state.DoS(100, false, REJECT_INVALID, "bad-blk-signature", false, "bad proof-of-stake block signature");
 
+    txcontrol.Wait();
+
     bool lastWasContract=false;
     // Check transactions
-    for (const auto& tx : block.vtx) {
-        if (!CheckTransaction(*tx, state, true))
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const CTransactionRef& tx = block.vtx[i];
+        bool fValid;
+        if (fParallelTxChecks) {
+            fValid = vTxResults[i].fValid;
+            if (!fValid)
+                state = vTxResults[i].state;
+        } else {
+            fValid = CheckTransaction(*tx, state, true);
+        }
+        if (!fValid)
             return state.Invalid(false, state.GetRejectCode(), state.GetRejectReason(),
                                  strprintf("Transaction check failed (tx hash %s) %s", tx->GetHash().ToString(), state.GetDebugMessage()));
         //OP_SPEND can only exist immediately after a contract tx in a block, or after another OP_SPEND
@@ -4727,9 +6204,9 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
     }
 
     unsigned int nSigOps = 0;
-    for (const auto& tx : block.vtx)
+    for (size_t i = 0; i < block.vtx.size(); i++)
     {
-        nSigOps += GetLegacySigOpCount(*tx);
+        nSigOps += fParallelTxChecks ? vTxResults[i].nSigOps : GetLegacySigOpCount(*block.vtx[i]);
     }
     if (nSigOps * WITNESS_SCALE_FACTOR > dgpMaxBlockSigOps)
         return state.DoS(100, false, REJECT_INVALID, "bad-blk-sigops", false, "out-of-bounds SigOpCount");
@@ -4754,7 +6231,7 @@ bool IsNullDummyEnabled(const CBlockIndex* pindexPrev, const Consensus::Params&
 
 // Compute at which vout of the block's coinbase transaction the witness
 // commitment occurs, or -1 if not found.
-static int GetWitnessCommitmentIndex(const CBlock& block)
+int GetWitnessCommitmentIndex(const CBlock& block)
 {
     int commitpos = -1;
     if (!block.vtx.empty()) {
@@ -4942,7 +6419,8 @@ static bool ContextualCheckBlock(const CBlock& block, CValidationState& state, c
     return true;
 }
 
-bool CChainState::UpdateHashProof(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, CBlockIndex* pindex, CCoinsViewCache& view)
+bool CChainState::UpdateHashProof(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, CBlockIndex* pindex, CCoinsViewCache& view,
+                                  bool fCheckStakeSignature, bool fReuseHashProof)
 {
     int nHeight = pindex->nHeight;
     uint256 hash = block.GetHash();
@@ -4963,10 +6441,18 @@ bool CChainState::UpdateHashProof(const CBlock& block, CValidationState& state,
     // Verify hash target and signature of coinstake tx
     if (block.IsProofOfStake())
     {
-        uint256 targetProofOfStake;
-        if (!CheckProofOfStake(pindex->pprev, state, *block.vtx[1], block.nBits, block.nTime, hashProof, targetProofOfStake, view))
-        {
-            return error("UpdateHashProof() : check proof-of-stake failed for block %s", hash.ToString());
+        // A block connected before had its kernel and coinstake signature checked against
+        // the same parent, and its index kept the proof hash; reconsidered blocks and blocks
+        // reconnected after a reorg reuse it instead of looking up the stake again. Only
+        // ConnectTip asks for this: -checklevel replays and TestBlockValidity check in full.
+        if (fReuseHashProof && pindex->IsValid(BLOCK_VALID_SCRIPTS) && !pindex->hashProof.IsNull()) {
+            hashProof = pindex->hashProof;
+        } else {
+            uint256 targetProofOfStake;
+            if (!CheckProofOfStake(pindex->pprev, state, *block.vtx[1], block.nBits, block.nTime, hashProof, targetProofOfStake, view, fCheckStakeSignature))
+            {
+                return error("UpdateHashProof() : check proof-of-stake failed for block %s", hash.ToString());
+            }
         }
     }
     
@@ -5044,6 +6530,11 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
         {
             return state.DoS(100, false, REJECT_INVALID, "bad-signature-encoding", false,"AcceptBlockHeader(): bad block signature encoding");
         }
+
+        // Check coin stake timestamp before any contextual check, it needs nothing but the header
+        if (block.IsProofOfStake() && !CheckCoinStakeTimestamp(block.nTime))
+            return state.DoS(100, false, REJECT_INVALID, "timestamp-invalid", false, "proof of stake failed due to invalid timestamp");
+
         // Get prev block index
         CBlockIndex* pindexPrev = nullptr;
         BlockMap::iterator mi = mapBlockIndex.find(block.hashPrevBlock);
@@ -5103,10 +6594,6 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
             // Reject proof of stake before height COINBASE_MATURITY
             if (nHeight < COINBASE_MATURITY)
                 return state.DoS(100, false, REJECT_INVALID, "reject-pos", false, strprintf("reject proof-of-stake at height %d", nHeight));
-
-            // Check coin stake timestamp
-            if(!CheckCoinStakeTimestamp(block.nTime))
-                return state.DoS(100, false, REJECT_INVALID, "timestamp-invalid", false, "proof of stake failed due to invalid timestamp");
         }
 
         // Check block header
@@ -5137,6 +6624,29 @@ bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidatio
         }
     }
 
+    // Outside of initial block download CheckBlockHeader verifies the signature of every
+    // new proof-of-stake header, so recover their signers on all cores first
+    if (nScriptCheckThreads && !IsInitialBlockDownload()) {
+        std::vector<CPrecheck> vChecks;
+        {
+            LOCK(cs_main);
+            for (const CBlockHeader& header : headers) {
+                if (!header.IsProofOfStake() || mapBlockIndex.count(header.GetHash()))
+                    continue;
+                // AcceptBlockHeader stops at the first invalid header, so do not recover the
+                // signers of the headers after one that fails the checks of the header alone
+                if (!CheckCoinStakeTimestamp(header.nTime) || !CheckCanonicalBlockSignature(&header))
+                    break;
+                vChecks.emplace_back([&header] { CacheRecoveredPubKeysFromBlockSignature(header); });
+            }
+        }
+        if (vChecks.size() > 1) {
+            CCheckQueueControl<CPrecheck> control(&precheckqueue);
+            control.Add(vChecks);
+            control.Wait();
+        }
+    }
+
     {
         LOCK(cs_main);
         bool bFirst = true;
@@ -5185,18 +6695,42 @@ bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidatio
     return true;
 }
 
+/** Size of the data of the block record at pos as stored on disk, the maximum if it cannot be read */
+static unsigned int GetBlockRecordSize(const CDiskBlockPos& pos)
+{
+    CDiskBlockPos hpos = pos;
+    hpos.nPos -= 8;
+    CAutoFile filein(OpenBlockFile(hpos, true), SER_DISK, CLIENT_VERSION);
+    try {
+        CMessageHeader::MessageStartChars blk_start;
+        unsigned int blk_size;
+        if (!filein.IsNull()) {
+            filein >> blk_start >> blk_size;
+            return blk_size & ~DISK_RECORD_COMPRESSED;
+        }
+    } catch (const std::exception&) {
+    }
+    return std::numeric_limits<unsigned int>::max();
+}
+
 /** Store block on disk. If dbp is non-nullptr, the file is known to already reside on disk */
 static CDiskBlockPos SaveBlockToDisk(const CBlock& block, int nHeight, const CChainParams& chainparams, const CDiskBlockPos* dbp) {
-    unsigned int nBlockSize = ::GetSerializeSize(block, CLIENT_VERSION);
+    std::vector<unsigned char> compressed;
+    if (dbp == nullptr && fCompressBlocks)
+        CompressForDisk(block, compressed);
+    unsigned int nBlockSize = compressed.empty() ? ::GetSerializeSize(block, CLIENT_VERSION) : compressed.size();
     CDiskBlockPos blockPos;
-    if (dbp != nullptr)
+    if (dbp != nullptr) {
         blockPos = *dbp;
+        // The record on disk may be compressed
+        nBlockSize = std::min(nBlockSize, GetBlockRecordSize(blockPos));
+    }
     if (!FindBlockPos(blockPos, nBlockSize+8, nHeight, block.GetBlockTime(), dbp != nullptr)) {
         error("%s: FindBlockPos failed", __func__);
         return CDiskBlockPos();
     }
     if (dbp == nullptr) {
-        if (!WriteBlockToDisk(block, blockPos, chainparams.MessageStart())) {
+        if (!WriteBlockToDisk(block, compressed, blockPos, chainparams.MessageStart())) {
             AbortNode("Failed to write block");
             return CDiskBlockPos();
         }
@@ -5361,9 +6895,16 @@ bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<cons
         // Therefore, the following critical section must include the CheckBlock() call as well.
         LOCK(cs_main);
 
+        // The hash of an assumed valid block commits to its signature, which is not checked again
+        bool fCheckSig = true;
+        if (fAssumeValidStake) {
+            const CBlockIndex* pindexKnown = LookupBlockIndex(pblock->GetHash());
+            fCheckSig = !pindexKnown || !IsAssumedValid(pindexKnown, chainparams.GetConsensus());
+        }
+
         // Ensure that CheckBlock() passes before calling AcceptBlock, as
         // belt-and-suspenders.
-        bool ret = CheckBlock(*pblock, state, chainparams.GetConsensus());
+        bool ret = CheckBlock(*pblock, state, chainparams.GetConsensus(), true, true, fCheckSig);
         if (ret) {
             // Store to disk
             ret = g_chainstate.AcceptBlock(pblock, state, chainparams, &pindex, fForceProcessing, nullptr, fNewBlock);
@@ -5409,7 +6950,6 @@ bool TestBlockValidity(CValidationState& state, const CChainParams& chainparams,
         
         globalState->setRoot(oldHashStateRoot); // kpg
         globalState->setRootUTXO(oldHashUTXORoot); // kpg
-        pstorageresult->clearCacheResult();
         return false;
     }
     assert(state.IsValid());
@@ -5472,12 +7012,29 @@ void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune)
 {
     for (std::set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         CDiskBlockPos pos(*it, 0);
+        if (g_block_file_writer)
+            g_block_file_writer->WaitForFile(*it);
+        g_block_file_maps.Invalidate(*it);
         fs::remove(GetBlockPosFilename(pos, "blk"));
         fs::remove(GetBlockPosFilename(pos, "rev"));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
     }
 }
 
+/**
+ * Height of the last block whose files may be pruned. The blocks within MIN_BLOCKS_TO_KEEP of the
+ * tip are kept, or MIN_POS_BLOCKS_TO_KEEP once the chain is past the last PoW block, as are the
+ * blocks the running indexes have not processed yet. Negative if none may be pruned.
+ */
+static int GetLastPrunableHeight(const Consensus::Params& consensusParams) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    const int nTipHeight = chainActive.Height();
+    int nBlocksToKeep = MIN_BLOCKS_TO_KEEP;
+    if (nTipHeight > consensusParams.nLastPOWBlock)
+        nBlocksToKeep = std::max<int>(nBlocksToKeep, MIN_POS_BLOCKS_TO_KEEP);
+    return std::min(nTipHeight - nBlocksToKeep, BaseIndex::GetPruneLockHeight() - 1);
+}
+
 /* Calculate the block/rev files to delete based on height specified by user with RPC command pruneblockchain */
 static void FindFilesToPruneManual(std::set<int>& setFilesToPrune, int nManualPruneHeight)
 {
@@ -5487,11 +7044,11 @@ static void FindFilesToPruneManual(std::set<int>& setFilesToPrune, int nManualPr
     if (chainActive.Tip() == nullptr)
         return;
 
-    // last block to prune is the lesser of (user-specified height, MIN_BLOCKS_TO_KEEP from the tip)
-    unsigned int nLastBlockWeCanPrune = std::min((unsigned)nManualPruneHeight, chainActive.Tip()->nHeight - MIN_BLOCKS_TO_KEEP);
+    // last block to prune is the lesser of (user-specified height, the last block pruning may delete)
+    int nLastBlockWeCanPrune = std::min(nManualPruneHeight, GetLastPrunableHeight(Params().GetConsensus()));
     int count=0;
-    for (int fileNumber = 0; fileNumber < nLastBlockFile; fileNumber++) {
-        if (vinfoBlockFile[fileNumber].nSize == 0 || vinfoBlockFile[fileNumber].nHeightLast > nLastBlockWeCanPrune)
+    for (int fileNumber = 0; fileNumber < nLastBlockFile && nLastBlockWeCanPrune >= 0; fileNumber++) {
+        if (vinfoBlockFile[fileNumber].nSize == 0 || (int)vinfoBlockFile[fileNumber].nHeightLast > nLastBlockWeCanPrune)
             continue;
         PruneOneBlockFile(fileNumber);
         setFilesToPrune.insert(fileNumber);
@@ -5519,7 +7076,8 @@ void PruneBlockFilesManual(int nManualPruneHeight)
  * Pruning functions are called from FlushStateToDisk when the global fCheckForPruning flag has been set.
  * Block and undo files are deleted in lock-step (when blk00003.dat is deleted, so is rev00003.dat.)
  * Pruning cannot take place until the longest chain is at least a certain length (100000 on mainnet, 1000 on testnet, 1000 on regtest).
- * Pruning will never delete a block within a defined distance (currently 288) from the active chain's tip.
+ * Pruning will never delete a block within a defined distance (currently 288, or 2000 once the chain is past the
+ * last PoW block) from the active chain's tip, nor a block that a running index has not processed yet.
  * The block index is updated by unsetting HAVE_DATA and HAVE_UNDO for any blocks that were stored in the deleted files.
  * A db flag records the fact that at least some block files have been pruned.
  *
@@ -5535,7 +7093,7 @@ static void FindFilesToPrune(std::set<int>& setFilesToPrune, uint64_t nPruneAfte
         return;
     }
 
-    unsigned int nLastBlockWeCanPrune = chainActive.Tip()->nHeight - MIN_BLOCKS_TO_KEEP;
+    int nLastBlockWeCanPrune = GetLastPrunableHeight(Params().GetConsensus());
     uint64_t nCurrentUsage = CalculateCurrentUsage();
     // We don't check to prune until after we've allocated new space for files
     // So we should leave a buffer under our target to account for another allocation
@@ -5544,7 +7102,7 @@ static void FindFilesToPrune(std::set<int>& setFilesToPrune, uint64_t nPruneAfte
     uint64_t nBytesToPrune;
     int count=0;
 
-    if (nCurrentUsage + nBuffer >= nPruneTarget) {
+    if (nCurrentUsage + nBuffer >= nPruneTarget && nLastBlockWeCanPrune >= 0) {
         // On a prune event, the chainstate DB is flushed.
         // To avoid excessive prune events negating the benefit of high dbcache
         // values, we should not prune too rapidly.
@@ -5563,8 +7121,8 @@ static void FindFilesToPrune(std::set<int>& setFilesToPrune, uint64_t nPruneAfte
             if (nCurrentUsage + nBuffer < nPruneTarget)  // are we below our target?
                 break;
 
-            // don't prune files that could have a block within MIN_BLOCKS_TO_KEEP of the main chain's tip but keep scanning
-            if (vinfoBlockFile[fileNumber].nHeightLast > nLastBlockWeCanPrune)
+            // don't prune files that could have a block the chain or the indexes still need but keep scanning
+            if ((int)vinfoBlockFile[fileNumber].nHeightLast > nLastBlockWeCanPrune)
                 continue;
 
             PruneOneBlockFile(fileNumber);
@@ -5596,6 +7154,9 @@ static FILE* OpenDiskFile(const CDiskBlockPos &pos, const char *prefix, bool fRe
 {
     if (pos.IsNull())
         return nullptr;
+    // Records queued for the file are written first
+    if (fReadOnly && g_block_file_writer)
+        g_block_file_writer->WaitForFile(pos.nFile);
     fs::path path = GetBlockPosFilename(pos, prefix);
     fs::create_directories(path.parent_path());
     FILE* file = fsbridge::fopen(path, fReadOnly ? "rb": "rb+");
@@ -5642,7 +7203,7 @@ CBlockIndex * CChainState::InsertBlockIndex(const uint256& hash)
         return (*mi).second;
 
     // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
+    CBlockIndex* pindexNew = NewBlockIndex();
     mi = mapBlockIndex.insert(std::make_pair(hash, pindexNew)).first;
     pindexNew->phashBlock = &((*mi).first);
 
@@ -5695,6 +7256,7 @@ bool CChainState::LoadBlockIndex(const Consensus::Params& consensus_params, CBlo
         if (pindex->IsValid(BLOCK_VALID_TREE) && (pindexBestHeader == nullptr || CBlockIndexWorkComparator()(pindexBestHeader, pindex)))
             pindexBestHeader = pindex;
     }
+    nBestHeaderHeight = pindexBestHeader ? pindexBestHeader->nHeight : -1;
 
     return true;
 }
@@ -5712,6 +7274,7 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams) EXCLUSIVE_LOCKS_RE
         pblocktree->ReadBlockFileInfo(nFile, vinfoBlockFile[nFile]);
     }
     LogPrintf("%s: last block file info: %s\n", __func__, vinfoBlockFile[nLastBlockFile].ToString());
+    g_block_file_maps.SetFinalizedFiles(nLastBlockFile);
     for (int nFile = nLastBlockFile + 1; true; nFile++) {
         CBlockFileInfo info;
         if (pblocktree->ReadBlockFileInfo(nFile, info)) {
@@ -5749,16 +7312,6 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams) EXCLUSIVE_LOCKS_RE
     pblocktree->ReadReindexing(fReindexing);
     if(fReindexing) fReindex = true;
 
-#ifdef ENABLE_BITCORE_RPC
-    ///////////////////////////////////////////////////////////// // kpg
-    pblocktree->ReadFlag("addrindex", fAddressIndex);
-    LogPrintf("LoadBlockIndexDB(): address index %s\n", fAddressIndex ? "enabled" : "disabled");
-    /////////////////////////////////////////////////////////////
-#endif
-    // Check whether we have a transaction index
-    pblocktree->ReadFlag("logevents", fLogEvents);
-    LogPrintf("%s: log events index %s\n", __func__, fLogEvents ? "enabled" : "disabled");
-
     return true;
 }
 
@@ -5785,6 +7338,7 @@ bool LoadChainTip(const CChainParams& chainparams)
         return false;
     }
     chainActive.SetTip(pindex);
+    PublishChainTipSnapshot(chainparams);
 
     g_chainstate.PruneBlockIndexCandidates();
 
@@ -5917,7 +7471,6 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
 
                 globalState->setRoot(oldHashStateRoot); // kpg
                 globalState->setRootUTXO(oldHashUTXORoot); // kpg
-                pstorageresult->clearCacheResult();
                 return error("VerifyDB(): *** found unconnectable block at %d, hash=%s (%s)", pindex->nHeight, pindex->GetBlockHash().ToString(), FormatStateMessage(state));
             }
         }
@@ -5925,12 +7478,132 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
         globalState->setRoot(oldHashStateRoot); // kpg
         globalState->setRootUTXO(oldHashUTXORoot); // kpg
     }
+
+    // check level 4: the contract state of the tip must hash up to its roots // kpg
+    if (nCheckLevel >= 4 && globalState->diskDb() && globalState->diskDbUtxo()) {
+        StateTrieCheck check = CheckStateTrie(*globalState->diskDb(), uintToh256(chainActive.Tip()->hashStateRoot), true, GetNumCores());
+        check += CheckStateTrie(*globalState->diskDbUtxo(), uintToh256(chainActive.Tip()->hashUTXORoot), false, GetNumCores());
+        if (!check.IsValid())
+            return error("VerifyDB(): *** contract state inconsistencies found (%u of %u entries missing, %u corrupted)", check.nMissing, check.nEntries + check.nMissing, check.nCorrupted);
+    }
     LogPrintf("[DONE].\n");
     LogPrintf("No coin database inconsistencies in last %i blocks (%i transactions)\n", block_count, nGoodTransactions);
 
     return true;
 }
 
+std::atomic<BackgroundCheckStatus> g_background_check_status{BackgroundCheckStatus::NONE};
+std::atomic<int> g_background_check_height{-1};
+
+bool ParseBackgroundCheckMode(const std::string& str, BackgroundCheckMode& mode)
+{
+    if (str == "off" || str == "0") {
+        mode = BackgroundCheckMode::OFF;
+    } else if (str == "warn") {
+        mode = BackgroundCheckMode::WARN;
+    } else if (str == "halt") {
+        mode = BackgroundCheckMode::HALT;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool BackgroundCheck(const CChainParams& chainparams, int nCheckLevel, int nCheckDepth)
+{
+    int nHeight;
+    int nStopHeight;
+    dev::h256 hashStateRoot;
+    dev::h256 hashUTXORoot;
+    {
+        LOCK(cs_main);
+        if (chainActive.Tip() == nullptr || chainActive.Tip()->pprev == nullptr)
+            return true;
+        if (nCheckDepth <= 0 || nCheckDepth > chainActive.Height())
+            nCheckDepth = chainActive.Height();
+        nHeight = chainActive.Height();
+        nStopHeight = nHeight - nCheckDepth;
+        hashStateRoot = uintToh256(chainActive.Tip()->hashStateRoot);
+        hashUTXORoot = uintToh256(chainActive.Tip()->hashUTXORoot);
+    }
+    nCheckLevel = std::max(0, std::min(4, nCheckLevel));
+    LogPrintf("Verifying last %i blocks at level %i in the background\n", nCheckDepth, nCheckLevel);
+
+    // The blocks are taken by height from the active chain, which may be reorganized meanwhile
+    for (; nHeight > nStopHeight && nHeight > 0; nHeight--) {
+        boost::this_thread::interruption_point();
+        if (ShutdownRequested())
+            return true;
+
+        LOCK(cs_main);
+        CBlockIndex* pindex = chainActive[nHeight];
+        if (pindex == nullptr)
+            continue;
+        if (fPruneMode && !(pindex->nStatus & BLOCK_HAVE_DATA)) {
+            LogPrintf("%s: block verification stopping at height %d (pruning, no data)\n", __func__, nHeight);
+            break;
+        }
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
+            return error("%s: *** ReadBlockFromDisk failed at %d, hash=%s", __func__, nHeight, pindex->GetBlockHash().ToString());
+        if (nCheckLevel >= 1) {
+            // CheckBlock applies the block size of the tip; unlike the startup check this
+            // one must not change it, so blocks of another DGP block size are not checked
+            QtumDGP qtumDGP(globalState.get(), fGettingValuesDGP);
+            uint32_t sizeBlockDGP = qtumDGP.getBlockSize(nHeight);
+            CValidationState state;
+            if ((sizeBlockDGP == 0 || sizeBlockDGP == dgpMaxBlockSize) && !CheckBlock(block, state, chainparams.GetConsensus(), false))
+                return error("%s: *** found bad block at %d, hash=%s (%s)", __func__, nHeight, pindex->GetBlockHash().ToString(), FormatStateMessage(state));
+        }
+        if (nCheckLevel >= 2 && !pindex->GetUndoPos().IsNull()) {
+            CBlockUndo undo;
+            if (!UndoReadFromDisk(undo, pindex))
+                return error("%s: *** found bad undo data at %d, hash=%s", __func__, nHeight, pindex->GetBlockHash().ToString());
+        }
+        g_background_check_height = nHeight;
+    }
+
+    if (nCheckLevel >= 4 && globalState->diskDb() && globalState->diskDbUtxo()) {
+        if (pstatepruner) {
+            LogPrintf("%s: contract state check skipped, the state of the tip may be pruned meanwhile with -prunestate\n", __func__);
+        } else {
+            // One thread, so that the check leaves the cores to the node
+            StateTrieCheck check = CheckStateTrie(*globalState->diskDb(), hashStateRoot, true, 1);
+            check += CheckStateTrie(*globalState->diskDbUtxo(), hashUTXORoot, false, 1);
+            if (!check.IsValid())
+                return error("%s: *** contract state inconsistencies found (%u of %u entries missing, %u corrupted)", __func__, check.nMissing, check.nEntries + check.nMissing, check.nCorrupted);
+        }
+    }
+    LogPrintf("No block database inconsistencies in last %i blocks found in the background\n", nCheckDepth);
+    return true;
+}
+
+void ThreadBackgroundCheck(const CChainParams& chainparams, int nCheckLevel, int nCheckDepth, BackgroundCheckMode mode)
+{
+    RenameThread("bitcoin-blockcheck");
+    g_background_check_status = BackgroundCheckStatus::RUNNING;
+    bool fValid = true;
+    try {
+        fValid = BackgroundCheck(chainparams, nCheckLevel, nCheckDepth);
+    } catch (const boost::thread_interrupted&) {
+        throw;
+    } catch (const std::exception& e) {
+        fValid = error("%s: %s", __func__, e.what());
+    }
+    if (fValid) {
+        g_background_check_status = BackgroundCheckStatus::DONE;
+        return;
+    }
+    g_background_check_status = BackgroundCheckStatus::FAILED;
+    const std::string strMessage = _("Corrupted block database detected by the background check");
+    if (mode == BackgroundCheckMode::HALT) {
+        AbortNode(strMessage, strMessage + ". " + _("Please restart with -reindex or -reindex-chainstate to recover."));
+    } else {
+        SetMiscWarning(strMessage);
+        uiInterface.ThreadSafeMessageBox(strMessage + ". " + _("Please restart with -reindex or -reindex-chainstate to recover."), "", CClientUIInterface::MSG_WARNING);
+    }
+}
+
 /** Apply the effects of a block on the utxo cache, ignoring that it may already have been applied. */
 bool CChainState::RollforwardBlock(const CBlockIndex* pindex, CCoinsViewCache& inputs, const CChainParams& params)
 {
@@ -6112,7 +7785,7 @@ bool CChainState::RewindBlockIndex(const CChainParams& params)
             }
 
             // Disconnect block
-            if (!DisconnectTip(state, params, nullptr)) {
+            if (!DisconnectTip(state, params, nullptr, nHeight > 0 ? chainActive[nHeight - 1] : nullptr)) {
                 return error("RewindBlockIndex: unable to disconnect block at height %i (%s)", tip->nHeight, FormatStateMessage(state));
             }
 
@@ -6184,21 +7857,29 @@ void UnloadBlockIndex()
 {
     LOCK(cs_main);
     chainActive.SetTip(nullptr);
+    PublishChainTipSnapshot(Params());
     pindexBestInvalid = nullptr;
     pindexBestHeader = nullptr;
+    nBestHeaderHeight = -1;
     mempool.clear();
     mapBlocksUnlinked.clear();
     vinfoBlockFile.clear();
     nLastBlockFile = 0;
+    g_block_file_maps.SetFinalizedFiles(0);
     setDirtyBlockIndex.clear();
     setDirtyFileInfo.clear();
     versionbitscache.Clear();
+    g_block_script_flags = BlockScriptFlagsCache();
+    ClearLocalContractExecutions();
     for (int b = 0; b < VERSIONBITS_NUM_BITS; b++) {
         warningcache[b].clear();
     }
+    recentSpentCoins.Clear();
+    ClearDisconnectData();
+    ClearMPoSScriptCache();
 
     for (const BlockMap::value_type& entry : mapBlockIndex) {
-        delete entry.second;
+        DeleteBlockIndex(entry.second);
     }
     mapBlockIndex.clear();
     fHavePruned = false;
@@ -6224,15 +7905,6 @@ bool LoadBlockIndex(const CChainParams& chainparams)
         // needs_init.
 
         LogPrintf("Initializing databases...\n");
-        // Use the provided setting for -logevents in the new database
-        fLogEvents = gArgs.GetBoolArg("-logevents", DEFAULT_LOGEVENTS);
-        pblocktree->WriteFlag("logevents", fLogEvents);
-#ifdef ENABLE_BITCORE_RPC
-        /////////////////////////////////////////////////////////////// // kpg
-        fAddressIndex = gArgs.GetBoolArg("-addrindex", DEFAULT_ADDRINDEX);
-        pblocktree->WriteFlag("addrindex", fAddressIndex);
-        ///////////////////////////////////////////////////////////////
-#endif
     }
     return true;
 }
@@ -6268,51 +7940,231 @@ bool LoadGenesisBlock(const CChainParams& chainparams)
     return g_chainstate.LoadGenesisBlock(chainparams);
 }
 
+namespace {
+
+/** A block record of a block file, decoded by BlockFileDecoder */
+struct BlockFileRecord
+{
+    //! Position of the block in the file, and where to resume scanning if it does not decode
+    uint64_t nBlockPos = 0;
+    uint64_t nRewind = 0;
+    uint64_t nSize = 0;
+    //! Whether data is a compressed record (see DISK_RECORD_COMPRESSED)
+    bool fCompressed = false;
+    std::vector<char> data;
+
+    std::shared_ptr<CBlock> pblock;
+    //! Bytes consumed by the block, set once it is decoded
+    uint64_t nDecodedSize = 0;
+    std::string strError;
+    bool fDone = false;
+};
+
+/**
+ * Pool deserializing the blocks of LoadExternalBlockFile ahead of their acceptance.
+ *
+ * Besides deserialization, which hashes every transaction, the threads verify the
+ * merkle root and the block signature, which depend on nothing but the block; such
+ * blocks are marked fPrechecked so that CheckBlock does not verify them again. All
+ * other checks depend on the chain (or on DGP parameters) and stay in AcceptBlock.
+ */
+class BlockFileDecoder
+{
+public:
+    explicit BlockFileDecoder(int nThreads) : fStop(false)
+    {
+        for (int i = 0; i < nThreads; i++)
+            threads.emplace_back(&BlockFileDecoder::Thread, this);
+    }
+
+    ~BlockFileDecoder()
+    {
+        {
+            LOCK(cs);
+            fStop = true;
+            cond.notify_all();
+        }
+        for (std::thread& thread : threads)
+            thread.join();
+    }
+
+    /** Decode record, on a pool thread if there are any */
+    void Add(const std::shared_ptr<BlockFileRecord>& record)
+    {
+        if (threads.empty()) {
+            Decode(*record);
+            record->fDone = true;
+            return;
+        }
+        LOCK(cs);
+        queue.push_back(record);
+        cond.notify_one();
+    }
+
+    /** Wait until record is decoded */
+    void Wait(const BlockFileRecord& record)
+    {
+        WAIT_LOCK(cs, lock);
+        while (!record.fDone)
+            condDone.wait(lock);
+    }
+
+private:
+    static void Decode(BlockFileRecord& record)
+    {
+        try {
+            std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+            if (record.fCompressed) {
+                // The record holds nothing but the block
+                std::vector<unsigned char> raw;
+                DecompressDiskRecord((const unsigned char*)record.data.data(), record.data.size(), raw);
+                VectorReader(SER_DISK, CLIENT_VERSION, raw, 0) >> *pblock;
+                record.nDecodedSize = record.data.size();
+            } else {
+                CDataStream stream(record.data, SER_DISK, CLIENT_VERSION);
+                stream >> *pblock;
+                record.nDecodedSize = record.data.size() - stream.size();
+            }
+
+            bool mutated;
+            pblock->fPrechecked = BlockMerkleRoot(*pblock, &mutated) == pblock->hashMerkleRoot && !mutated && CheckBlockSignature(*pblock);
+            record.pblock = std::move(pblock);
+        } catch (const std::exception& e) {
+            record.strError = e.what();
+        }
+        // The raw data is no longer needed
+        std::vector<char>().swap(record.data);
+    }
+
+    void Thread()
+    {
+        RenameThread("bitcoin-loadblk");
+        while (true) {
+            std::shared_ptr<BlockFileRecord> record;
+            {
+                WAIT_LOCK(cs, lock);
+                while (!fStop && queue.empty())
+                    cond.wait(lock);
+                if (fStop)
+                    return;
+                record = std::move(queue.front());
+                queue.pop_front();
+            }
+            Decode(*record);
+            LOCK(cs);
+            record->fDone = true;
+            condDone.notify_all();
+        }
+    }
+
+    Mutex cs;
+    std::condition_variable cond;
+    std::condition_variable condDone;
+    std::deque<std::shared_ptr<BlockFileRecord>> queue GUARDED_BY(cs);
+    bool fStop GUARDED_BY(cs);
+    std::vector<std::thread> threads;
+};
+
+}
+
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp)
 {
     // Map of disk positions for blocks with unknown parent (only used for reindex)
     static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
     int64_t nStart = GetTimeMillis();
 
+    // Blocks are read in order by this thread and decoded by the pool, up to nWindow ahead
+    // of the block being accepted. The records read ahead must fit in the rewind limit of
+    // blkdat, which has to scan again from the first of them if it does not decode.
+    int nDecodeThreads = std::min(nScriptCheckThreads, MAX_SCRIPTCHECK_THREADS);
+    size_t nWindow = std::max(1, 2 * nDecodeThreads);
+    BlockFileDecoder decoder(nDecodeThreads);
+    std::deque<std::shared_ptr<BlockFileRecord>> pending;
+
     int nLoaded = 0;
     try {
         // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
         CBufferedFile blkdat(fileIn, 2*dgpMaxBlockSerSize, dgpMaxBlockSerSize+8, SER_DISK, CLIENT_VERSION);
         uint64_t nRewind = blkdat.GetPos();
-        while (!blkdat.eof()) {
+        bool fEnd = false;
+        while (true) {
             boost::this_thread::interruption_point();
 
-            blkdat.SetPos(nRewind);
-            nRewind++; // start one byte further next time, in case of failure
-            blkdat.SetLimit(); // remove former limit
-            unsigned int nSize = 0;
-            try {
-                // locate a header
-                unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
-                blkdat.FindByte(chainparams.MessageStart()[0]);
-                nRewind = blkdat.GetPos()+1;
-                blkdat >> buf;
-                if (memcmp(buf, chainparams.MessageStart(), CMessageHeader::MESSAGE_START_SIZE))
-                    continue;
-                // read size
-                blkdat >> nSize;
-                if (nSize < 80 || nSize > dgpMaxBlockSerSize)
+            // Read ahead the next block records
+            while (pending.size() < nWindow && !fEnd && !blkdat.eof()) {
+                blkdat.SetPos(nRewind);
+                nRewind++; // start one byte further next time, in case of failure
+                blkdat.SetLimit(); // remove former limit
+                unsigned int nSize = 0;
+                bool fCompressed = false;
+                try {
+                    // locate a header
+                    unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
+                    blkdat.FindByte(chainparams.MessageStart()[0]);
+                    nRewind = blkdat.GetPos()+1;
+                    blkdat >> buf;
+                    if (memcmp(buf, chainparams.MessageStart(), CMessageHeader::MESSAGE_START_SIZE))
+                        continue;
+                    // read size
+                    blkdat >> nSize;
+                    fCompressed = nSize & DISK_RECORD_COMPRESSED;
+                    nSize &= ~DISK_RECORD_COMPRESSED;
+                    if (nSize < 80 || nSize > dgpMaxBlockSerSize)
+                        continue;
+                } catch (const std::exception&) {
+                    // no valid block header found; don't complain
+                    fEnd = true;
+                    break;
+                }
+                if (!pending.empty() && blkdat.GetPos() + nSize - pending.front()->nRewind > dgpMaxBlockSerSize) {
+                    // Read it once the records before it are done
+                    nRewind -= 1;
+                    break;
+                }
+                std::shared_ptr<BlockFileRecord> record = std::make_shared<BlockFileRecord>();
+                try {
+                    // read block
+                    record->nBlockPos = blkdat.GetPos();
+                    record->nRewind = nRewind;
+                    record->nSize = nSize;
+                    record->fCompressed = fCompressed;
+                    blkdat.SetLimit(record->nBlockPos + nSize);
+                    blkdat.SetPos(record->nBlockPos);
+                    record->data.resize(nSize);
+                    blkdat.read(record->data.data(), nSize);
+                    nRewind = blkdat.GetPos();
+                } catch (const std::exception& e) {
+                    LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
                     continue;
-            } catch (const std::exception&) {
-                // no valid block header found; don't complain
+                }
+                decoder.Add(record);
+                pending.push_back(std::move(record));
+            }
+            if (pending.empty())
                 break;
+
+            std::shared_ptr<BlockFileRecord> record = std::move(pending.front());
+            pending.pop_front();
+            decoder.Wait(*record);
+            if (!record->pblock || record->nDecodedSize < record->nSize) {
+                // Not a block, or a block shorter than its record: scan again from within the
+                // record, as reading it inline did, and drop the records read after it
+                if (!record->pblock)
+                    LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, record->strError);
+                nRewind = record->pblock ? record->nBlockPos + record->nDecodedSize : record->nRewind;
+                fEnd = false;
+                for (const std::shared_ptr<BlockFileRecord>& dropped : pending)
+                    decoder.Wait(*dropped);
+                pending.clear();
+                if (!record->pblock)
+                    continue;
             }
+            if (dbp)
+                dbp->nPos = record->nBlockPos;
+
             try {
-                // read block
-                uint64_t nBlockPos = blkdat.GetPos();
-                if (dbp)
-                    dbp->nPos = nBlockPos;
-                blkdat.SetLimit(nBlockPos + nSize);
-                blkdat.SetPos(nBlockPos);
-                std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+                std::shared_ptr<CBlock> pblock = std::move(record->pblock);
                 CBlock& block = *pblock;
-                blkdat >> block;
-                nRewind = blkdat.GetPos();
 
                 uint256 hash = block.GetHash();
                 {
@@ -6582,8 +8434,10 @@ bool CChainState::RemoveBlockIndex(CBlockIndex *pindex)
     if(pindexBestInvalid == pindex)
         pindexBestInvalid = nullptr;
 
-    if(pindexBestHeader == pindex)
+    if(pindexBestHeader == pindex) {
         pindexBestHeader = nullptr;
+        nBestHeaderHeight = -1;
+    }
 
     if(pindexBestForkTip == pindex)
         pindexBestForkTip = nullptr;
@@ -6650,7 +8504,123 @@ int VersionBitsTipStateSinceHeight(const Consensus::Params& params, Consensus::D
     return VersionBitsStateSinceHeight(chainActive.Tip(), params, pos, versionbitscache);
 }
 
-static const uint64_t MEMPOOL_DUMP_VERSION = 1;
+static const uint64_t MEMPOOL_DUMP_VERSION = 2;
+//! Version of mempool.dat without the tip and the validated state of the txs, still loaded
+static const uint64_t MEMPOOL_DUMP_VERSION_NO_STATE = 1;
+//! Number of txs of mempool.dat read ahead to verify their signatures in parallel
+static const size_t MEMPOOL_LOAD_BATCH = 1000;
+
+namespace {
+/** Tx of mempool.dat, with the results of its validation when it was dumped */
+struct MempoolDumpEntry
+{
+    CTransactionRef tx;
+    int64_t nTime = 0;
+    int64_t nFeeDelta = 0;
+    CAmount nFee = 0;
+    int64_t nSigOpCost = 0;
+    unsigned int nHeight = 0;
+    bool fSpendsCoinbase = false;
+    CAmount nMinGasPrice = 0;
+    uint64_t nGasLimit = 0;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(tx);
+        READWRITE(nTime);
+        READWRITE(nFeeDelta);
+        READWRITE(nFee);
+        READWRITE(nSigOpCost);
+        READWRITE(nHeight);
+        READWRITE(fSpendsCoinbase);
+        READWRITE(nMinGasPrice);
+        READWRITE(nGasLimit);
+    }
+};
+}
+
+/**
+ * Verify the signatures of a batch of txs of mempool.dat on the script check threads, to
+ * have AcceptToMemoryPool find them in the signature cache. The txs that spend outputs of
+ * txs of the same batch are left to AcceptToMemoryPool.
+ */
+static void PreverifyMempoolBatch(const std::vector<MempoolDumpEntry>& batch)
+{
+    if (!nScriptCheckThreads)
+        return;
+
+    std::vector<PrecomputedTransactionData> txdata;
+    txdata.reserve(batch.size());
+    std::vector<CScriptCheck> vChecks;
+    {
+        LOCK2(cs_main, mempool.cs);
+        CCoinsViewMemPool viewMemPool(pcoinsTip.get(), mempool);
+        for (const MempoolDumpEntry& dump : batch) {
+            const CTransaction& tx = *dump.tx;
+            txdata.emplace_back(tx);
+            std::vector<CScriptCheck> vTxChecks;
+            for (unsigned int i = 0; i < tx.vin.size(); i++) {
+                Coin coin;
+                if (!viewMemPool.GetCoin(tx.vin[i].prevout, coin)) {
+                    vTxChecks.clear();
+                    break;
+                }
+                vTxChecks.emplace_back(coin.out, tx, i, STANDARD_SCRIPT_VERIFY_FLAGS, true, &txdata.back());
+            }
+            for (CScriptCheck& check : vTxChecks) {
+                vChecks.emplace_back();
+                check.swap(vChecks.back());
+            }
+        }
+    }
+
+    CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+    control.Add(vChecks);
+    control.Wait();
+}
+
+/**
+ * Add a tx of mempool.dat dumped at the current tip with the fees, sigops and gas it was
+ * validated with, skipping the script, contract and DGP checks of AcceptToMemoryPool.
+ * Returns false if it has to go through AcceptToMemoryPool instead.
+ */
+static bool AddMempoolEntryFromDump(const MempoolDumpEntry& dump) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    const CTransaction& tx = *dump.tx;
+    LOCK(mempool.cs);
+    if (mempool.exists(tx.GetHash()))
+        return false;
+    // Txs added in the meantime, by the wallets for instance, may conflict
+    for (const CTxIn& txin : tx.vin) {
+        if (mempool.mapNextTx.count(txin.prevout))
+            return false;
+    }
+
+    CCoinsView dummy;
+    CCoinsViewCache view(&dummy);
+    CCoinsViewMemPool viewMemPool(pcoinsTip.get(), mempool);
+    view.SetBackend(viewMemPool);
+    if (!view.HaveInputs(tx))
+        return false;
+    // The relay fee may have been raised since
+    if (dump.nFee < ::minRelayTxFee.GetFee(GetVirtualTransactionSize(tx, dump.nSigOpCost)))
+        return false;
+    LockPoints lp;
+    if (!CheckSequenceLocks(mempool, tx, STANDARD_LOCKTIME_VERIFY_FLAGS, &lp))
+        return false;
+
+    CTxMemPoolEntry entry(dump.tx, dump.nFee, dump.nTime, dump.nHeight, dump.fSpendsCoinbase, dump.nSigOpCost, lp, dump.nMinGasPrice, dump.nGasLimit);
+#ifdef ENABLE_BITCORE_RPC
+    if (fAddressIndex) {
+        mempool.addAddressIndex(entry, view);
+        mempool.addSpentIndex(entry, view);
+    }
+#endif
+    mempool.addUnchecked(entry, false);
+    return true;
+}
 
 bool LoadMempool()
 {
@@ -6664,6 +8634,7 @@ bool LoadMempool()
     }
 
     int64_t count = 0;
+    int64_t trusted = 0;
     int64_t expired = 0;
     int64_t failed = 0;
     int64_t already_there = 0;
@@ -6672,27 +8643,59 @@ bool LoadMempool()
     try {
         uint64_t version;
         file >> version;
-        if (version != MEMPOOL_DUMP_VERSION) {
+        if (version != MEMPOOL_DUMP_VERSION && version != MEMPOOL_DUMP_VERSION_NO_STATE) {
             return false;
         }
+        // The validated state of the txs is only trusted at the tip it was dumped at
+        bool fTrusted = false;
+        if (version == MEMPOOL_DUMP_VERSION) {
+            uint256 hashTip;
+            file >> hashTip;
+            LOCK(cs_main);
+            fTrusted = chainActive.Tip() && chainActive.Tip()->GetBlockHash() == hashTip;
+        }
         uint64_t num;
         file >> num;
-        while (num--) {
-            CTransactionRef tx;
-            int64_t nTime;
-            int64_t nFeeDelta;
-            file >> tx;
-            file >> nTime;
-            file >> nFeeDelta;
-
-            CAmount amountdelta = nFeeDelta;
-            if (amountdelta) {
-                mempool.PrioritiseTransaction(tx->GetHash(), amountdelta);
+        std::vector<MempoolDumpEntry> batch;
+        while (num) {
+            batch.clear();
+            while (num && batch.size() < MEMPOOL_LOAD_BATCH) {
+                MempoolDumpEntry dump;
+                if (version == MEMPOOL_DUMP_VERSION) {
+                    file >> dump;
+                } else {
+                    file >> dump.tx;
+                    file >> dump.nTime;
+                    file >> dump.nFeeDelta;
+                }
+                num--;
+                if (dump.nTime + nExpiryTimeout > nNow) {
+                    batch.push_back(std::move(dump));
+                } else {
+                    if (dump.nFeeDelta) {
+                        mempool.PrioritiseTransaction(dump.tx->GetHash(), dump.nFeeDelta);
+                    }
+                    ++expired;
+                }
             }
-            CValidationState state;
-            if (nTime + nExpiryTimeout > nNow) {
+            if (!fTrusted)
+                PreverifyMempoolBatch(batch);
+
+            for (const MempoolDumpEntry& dump : batch) {
+                const CTransactionRef& tx = dump.tx;
+                CAmount amountdelta = dump.nFeeDelta;
+                if (amountdelta) {
+                    mempool.PrioritiseTransaction(tx->GetHash(), amountdelta);
+                }
                 LOCK(cs_main);
-                AcceptToMemoryPoolWithTime(chainparams, mempool, state, tx, nullptr /* pfMissingInputs */, nTime,
+                if (fTrusted && AddMempoolEntryFromDump(dump)) {
+                    GetMainSignals().TransactionAddedToMempool(tx);
+                    ++count;
+                    ++trusted;
+                    continue;
+                }
+                CValidationState state;
+                AcceptToMemoryPoolWithTime(chainparams, mempool, state, tx, nullptr /* pfMissingInputs */, dump.nTime,
                                            nullptr /* plTxnReplaced */, false /* bypass_limits */, 0 /* nAbsurdFee */,
                                            false /* test_accept */);
                 if (state.IsValid()) {
@@ -6708,8 +8711,6 @@ bool LoadMempool()
                         ++failed;
                     }
                 }
-            } else {
-                ++expired;
             }
             if (ShutdownRequested())
                 return false;
@@ -6725,7 +8726,13 @@ bool LoadMempool()
         return false;
     }
 
-    LogPrintf("Imported mempool transactions from disk: %i succeeded, %i failed, %i expired, %i already there\n", count, failed, expired, already_there);
+    // The txs added without AcceptToMemoryPool were not checked against the limits
+    if (trusted) {
+        LOCK(cs_main);
+        LimitMempoolSize(mempool, gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, gArgs.GetArg("-maxmempoolgas", DEFAULT_MAX_MEMPOOL_GAS) * 1000000, gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
+    }
+
+    LogPrintf("Imported mempool transactions from disk: %i succeeded (%i at the same tip), %i failed, %i expired, %i already there\n", count, trusted, failed, expired, already_there);
     return true;
 }
 
@@ -6734,17 +8741,36 @@ bool DumpMempool()
     int64_t start = GetTimeMicros();
 
     std::map<uint256, CAmount> mapDeltas;
-    std::vector<TxMempoolInfo> vinfo;
+    std::vector<MempoolDumpEntry> vdump;
+    uint256 hashTip;
 
     static Mutex dump_mutex;
     LOCK(dump_mutex);
 
     {
-        LOCK(mempool.cs);
+        // cs_main keeps the mempool consistent with the tip
+        LOCK2(cs_main, mempool.cs);
+        if (chainActive.Tip())
+            hashTip = chainActive.Tip()->GetBlockHash();
         for (const auto &i : mempool.mapDeltas) {
             mapDeltas[i.first] = i.second;
         }
-        vinfo = mempool.infoAll();
+        std::vector<TxMempoolInfo> vinfo = mempool.infoAll();
+        vdump.reserve(vinfo.size());
+        for (const TxMempoolInfo& info : vinfo) {
+            CTxMemPool::txiter it = mempool.mapTx.find(info.tx->GetHash());
+            MempoolDumpEntry dump;
+            dump.tx = info.tx;
+            dump.nTime = info.nTime;
+            dump.nFeeDelta = info.nFeeDelta;
+            dump.nFee = it->GetFee();
+            dump.nSigOpCost = it->GetSigOpCost();
+            dump.nHeight = it->GetHeight();
+            dump.fSpendsCoinbase = it->GetSpendsCoinbase();
+            dump.nMinGasPrice = it->GetMinGasPrice();
+            dump.nGasLimit = it->GetGasLimit();
+            vdump.push_back(std::move(dump));
+        }
     }
 
     int64_t mid = GetTimeMicros();
@@ -6759,13 +8785,12 @@ bool DumpMempool()
 
         uint64_t version = MEMPOOL_DUMP_VERSION;
         file << version;
+        file << hashTip;
 
-        file << (uint64_t)vinfo.size();
-        for (const auto& i : vinfo) {
-            file << *(i.tx);
-            file << (int64_t)i.nTime;
-            file << (int64_t)i.nFeeDelta;
-            mapDeltas.erase(i.tx->GetHash());
+        file << (uint64_t)vdump.size();
+        for (const MempoolDumpEntry& dump : vdump) {
+            file << dump;
+            mapDeltas.erase(dump.tx->GetHash());
         }
 
         file << mapDeltas;
@@ -6838,7 +8863,7 @@ public:
         // block headers
         BlockMap::iterator it1 = mapBlockIndex.begin();
         for (; it1 != mapBlockIndex.end(); it1++)
-            delete (*it1).second;
+            DeleteBlockIndex((*it1).second);
         mapBlockIndex.clear();
     }
 } instance_of_cmaincleanup;
@@ -6847,24 +8872,60 @@ public:
 ////////////////////////////////////////////////////////////////////////////////// // kpg
 bool GetAddressIndex(uint256 addressHash, int type, std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, int start, int end)
 {
-    if (!fAddressIndex)
+    if (!g_addressindex)
+        return error("address index not enabled");
+
+    if (!g_addressindex->ReadAddressIndex(addressHash, type, addressIndex, start, end))
+        return error("unable to get txids for address");
+
+    return true;
+}
+
+bool GetAddressIndexPage(CAddressIndexKey &cursor, size_t limit, int end,
+                         std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex)
+{
+    if (!g_addressindex)
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end))
+    if (!g_addressindex->ReadAddressIndexPage(cursor, limit, end, addressIndex))
         return error("unable to get txids for address");
 
     return true;
 }
 
+bool GetMergedAddressIndex(const std::vector<std::pair<uint256, int> > &addresses,
+                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                           int start, int end)
+{
+    if (!g_addressindex)
+        return error("address index not enabled");
+
+    if (!g_addressindex->ReadAddressIndexMerged(addresses, addressIndex, start, end))
+        return error("unable to get txids for addresses");
+
+    return true;
+}
+
+bool GetAddressSummary(uint256 addressHash, int type, CAddressSummary &summary)
+{
+    if (!g_addressindex)
+        return error("address index not enabled");
+
+    if (!g_addressindex->ReadAddressSummary(addressHash, type, summary))
+        return error("unable to get summary for address");
+
+    return true;
+}
+
 bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
 {
-    if (!fAddressIndex)
+    if (!g_addressindex)
         return false;
 
     if (mempool.getSpentIndex(key, value))
         return true;
 
-    if (!pblocktree->ReadSpentIndex(key, value))
+    if (!g_addressindex->ReadSpentIndex(key, value))
         return false;
 
     return true;
@@ -6872,10 +8933,22 @@ bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
 
 bool GetAddressUnspent(uint256 addressHash, int type, std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs)
 {
-    if (!fAddressIndex)
+    if (!g_addressindex)
+        return error("address index not enabled");
+
+    if (!g_addressindex->ReadAddressUnspentIndex(addressHash, type, unspentOutputs))
+        return error("unable to get txids for address");
+
+    return true;
+}
+
+bool GetAddressUnspentPage(CAddressUnspentKey &cursor, size_t limit,
+                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs)
+{
+    if (!g_addressindex)
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs))
+    if (!g_addressindex->ReadAddressUnspentIndexPage(cursor, limit, unspentOutputs))
         return error("unable to get txids for address");
 
     return true;
@@ -6883,10 +8956,10 @@ bool GetAddressUnspent(uint256 addressHash, int type, std::vector<std::pair<CAdd
 
 bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, const bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &hashes)
 {
-    if (!fAddressIndex)
+    if (!g_addressindex)
         return error("Timestamp index not enabled");
 
-    if (!pblocktree->ReadTimestampIndex(high, low, fActiveOnly, hashes))
+    if (!g_addressindex->ReadTimestampIndex(high, low, fActiveOnly, hashes))
         return error("Unable to get hashes for timestamps");
 
     return true;
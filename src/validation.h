@@ -18,6 +18,7 @@
 #include <protocol.h> // For CMessageHeader::MessageStartChars
 #include <script/script_error.h>
 #include <sync.h>
+#include <validationinterface.h>
 #include <versionbits.h>
 
 #include <algorithm>
@@ -46,6 +47,8 @@ class CWalletTx;
 #include <script/standard.h>
 #include <qtum/storageresults.h>
 
+#include <boost/optional.hpp>
+
 
 extern std::unique_ptr<QtumState> globalState;
 extern std::shared_ptr<dev::eth::SealEngineFace> globalSealEngine;
@@ -57,10 +60,11 @@ struct EthTransactionParams;
 using valtype = std::vector<unsigned char>;
 using ExtractQtumTX = std::pair<std::vector<QtumTransaction>, std::vector<EthTransactionParams>>;
 ///////////////////////////////////////////
-
 class CBlockIndex;
 class CBlockTreeDB;
+class CBlockUndo;
 class CChainParams;
+class CCoinsViewBackgroundFlush;
 class CCoinsViewDB;
 class CInv;
 class CConnman;
@@ -74,6 +78,7 @@ struct ChainTxData;
 
 struct PrecomputedTransactionData;
 struct LockPoints;
+class StateRootsPin;
 
 /** Minimum gas limit that is allowed in a transaction within a block - prevent various types of tx and mempool spam **/
 static const uint64_t MINIMUM_GAS_LIMIT = 10000;
@@ -102,6 +107,8 @@ static const unsigned int DEFAULT_DESCENDANT_LIMIT = 25;
 static const unsigned int DEFAULT_DESCENDANT_SIZE_LIMIT = 101;
 /** Default for -mempoolexpiry, expiration time for mempool transactions in hours */
 static const unsigned int DEFAULT_MEMPOOL_EXPIRY = 336;
+/** Default for -mempoolpreexec, execute contract txs against the tip when they enter the mempool */
+static const bool DEFAULT_MEMPOOL_PREEXEC = false;
 /** Maximum kilobytes for transactions to store for processing during reorg */
 static const unsigned int MAX_DISCONNECTED_TX_POOL_SIZE = 20000;
 /** The maximum size of a blk?????.dat file (since 0.8) */
@@ -113,10 +120,20 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 
 /** Maximum number of script-checking threads allowed */
 static const int MAX_SCRIPTCHECK_THREADS = 16;
+/** Number of block index entries in each chunk of the block index storage */
+static const size_t BLOCK_INDEX_CHUNK_ENTRIES = 4096;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Maximum number of contract speculation threads allowed */
+static const int MAX_CONTRACT_SPECULATION_THREADS = 16;
+/** -parcontract default (number of contract speculation threads, 0 = disabled) */
+static const int DEFAULT_CONTRACT_SPECULATION_THREADS = 0;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
+/** Upper bound of the number of blocks in flight from a single peer during block download. The limit
+ *  of each peer grows from MAX_BLOCKS_IN_TRANSIT_PER_PEER with its ping time over the time it takes to
+ *  deliver a block, so that high-latency peers are kept busy with the short PoS blocks. */
+static const int MAX_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER = 128;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
 static const unsigned int BLOCK_STALLING_TIMEOUT = 2;
 /** Number of headers sent in one getheaders result. We rely on the assumption that if a peer sends
@@ -150,11 +167,19 @@ static const int64_t MAX_FEE_ESTIMATION_TIP_AGE = 3 * 60 * 60;
 /** Default for -permitbaremultisig */
 static const bool DEFAULT_PERMIT_BAREMULTISIG = true;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
+static const bool DEFAULT_ASSUME_VALID_STAKE = true;
 static const bool DEFAULT_TXINDEX = false;
+static const bool DEFAULT_TXINDEX_COMPACT = false;
+static const bool DEFAULT_BLOCKSTATSINDEX = false;
+static const bool DEFAULT_CONTRACTINDEX = false;
+static const bool DEFAULT_STATEDIFFINDEX = false;
+static const char* const DEFAULT_BLOCKFILTERINDEX = "0";
 #ifdef ENABLE_BITCORE_RPC
 static const bool DEFAULT_ADDRINDEX = false;
 #endif
 static const bool DEFAULT_LOGEVENTS = false;
+static const bool DEFAULT_LOGTOPICINDEX = false;
+static const bool DEFAULT_LOGADDRESSINDEX = false;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 /** Default for -persistmempool */
 static const bool DEFAULT_PERSIST_MEMPOOL = true;
@@ -204,10 +229,17 @@ extern uint256 g_best_block;
 extern std::atomic_bool fImporting;
 extern std::atomic_bool fReindex;
 extern int nScriptCheckThreads;
+extern int nContractSpeculationThreads;
+/** Log the contract profile every this many blocks (-contractprofilelog, 0 = never) */
+extern int nContractProfileLogInterval;
 #ifdef ENABLE_BITCORE_RPC
 extern bool fAddressIndex;
 #endif
 extern bool fLogEvents;
+extern bool fLogTopicIndex;
+extern bool fLogAddressIndex;
+/** Whether contract executions measure the storage they add, for the state sizes of -contractindex */
+extern bool fContractStateGrowth;
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern bool fCheckBlockIndex;
@@ -220,15 +252,57 @@ extern CAmount maxTxFee;
 /** If the tip is older than this (in seconds), the node is considered to be in initial block download. */
 extern int64_t nMaxTipAge;
 extern bool fEnableReplacement;
+extern bool fMempoolPreExec;
 
 /** Block hash whose ancestors we will assume to have valid scripts without checking them. */
 extern uint256 hashAssumeValid;
+/** Whether the block signatures and coinstake signatures of the ancestors of hashAssumeValid are assumed valid too */
+extern bool fAssumeValidStake;
 
 /** Minimum work we will assume exists on some valid chain. */
 extern arith_uint256 nMinimumChainWork;
 
 /** Best header we've seen so far (used for getheaders queries' starting points). */
 extern CBlockIndex *pindexBestHeader;
+/** Height of pindexBestHeader, readable without cs_main; -1 while there is none. */
+extern std::atomic<int> nBestHeaderHeight;
+
+/**
+ * Fields of the tip of chainActive, published as an immutable snapshot whenever the tip
+ * changes, so that the read-only RPCs about the tip do not wait for cs_main while a block
+ * is connected.
+ */
+struct ChainTipSnapshot
+{
+    //! -1 while chainActive is empty
+    int nHeight{-1};
+    uint256 hashBlock;
+    int64_t nTime{0};
+    int64_t nMedianTimePast{0};
+    uint32_t nBits{0};
+    //! Target of the last proof-of-stake block of the chain, or of the genesis block while there is none
+    uint32_t nPoSBits{0};
+    arith_uint256 nChainWork;
+    CAmount nMoneySupply{0};
+    uint256 hashStateRoot;
+    uint256 hashUTXORoot;
+    double dVerificationProgress{0};
+    //! Hashes of the tip and its ancestors seen by BLOCKHASH, newest first, see LastHashes
+    std::shared_ptr<const dev::h256s> lastHashes;
+
+    //! State of a versionbits deployment at the tip
+    struct Deployment
+    {
+        ThresholdState state{ThresholdState::DEFINED};
+        int nSinceHeight{0};
+        //! Signalling statistics, only filled in the STARTED state
+        BIP9Stats stats{};
+    };
+    Deployment vDeployments[Consensus::MAX_VERSION_BITS_DEPLOYMENTS];
+};
+
+/** The latest snapshot of the tip of chainActive, never null. Does not take cs_main. */
+std::shared_ptr<const ChainTipSnapshot> GetChainTipSnapshot();
 
 /** Minimum disk space required - used in CheckDiskSpace() */
 static const uint64_t nMinDiskSpace = 52428800;
@@ -238,10 +312,17 @@ static const uint64_t nMinDiskSpace = 52428800;
 extern bool fHavePruned;
 /** True if we're running in -prune mode. */
 extern bool fPruneMode;
+/** True if new blocks and undo data are stored compressed (-compressblocks). */
+extern bool fCompressBlocks;
 /** Number of MiB of block files that we're trying to stay below. */
 extern uint64_t nPruneTarget;
 /** Block files containing a block-height within MIN_BLOCKS_TO_KEEP of chainActive.Tip() will not be pruned. */
 static const unsigned int MIN_BLOCKS_TO_KEEP = 288;
+/** Once the chain is past the last PoW block, block files containing a block-height within
+ *  MIN_POS_BLOCKS_TO_KEEP of the tip are not pruned either: the PoS checks of a block on a fork
+ *  read the blocks and undo data of the active chain down to the fork, which may be up to
+ *  COINBASE_MATURITY blocks deep, and reorganizing to it disconnects as many. */
+static const unsigned int MIN_POS_BLOCKS_TO_KEEP = COINBASE_MATURITY;
 /** Minimum blocks required to signal NODE_NETWORK_LIMITED */
 static const unsigned int NODE_NETWORK_LIMITED_MIN_BLOCKS = 288;
 
@@ -315,6 +396,12 @@ bool LoadChainTip(const CChainParams& chainparams) EXCLUSIVE_LOCKS_REQUIRED(cs_m
 void UnloadBlockIndex();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the contract speculation thread */
+void ThreadContractSpeculation();
+/** Run an instance of the thread of the context-free header and block checks */
+void ThreadPrecheck();
+/** Run fn on the parts of [0, n) on the precheck threads and the calling one, or on the calling one alone with -par=1 */
+void ParallelForRanges(size_t n, const std::function<void(size_t, size_t)>& fn);
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
@@ -346,6 +433,15 @@ void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune);
 
 /** Flush all state, indexes and buffers to disk. */
 void FlushStateToDisk();
+/** Warn about a fatal error, such as a failed write, and shut down; returns false */
+bool AbortNode(const std::string& strMessage, const std::string& userMessage = "");
+/** Construct an entry for mapBlockIndex in the storage of the block index */
+CBlockIndex* NewBlockIndex() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+CBlockIndex* NewBlockIndex(const CBlockHeader& block) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+/** Destroy an entry made by NewBlockIndex, once it is out of mapBlockIndex or the index is unloaded */
+void DeleteBlockIndex(CBlockIndex* pindex);
+/** Write the flushed block index to a snapshot that the next start loads instead of the database */
+bool WriteBlockIndexSnapshot() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 /** Prune block files and flush state to disk. */
 void PruneAndFlush();
 /** Prune block files up to a given height */
@@ -430,6 +526,222 @@ struct CHeightTxIndexKey {
     }
 };
 
+struct CTopicIndexIteratorKey {
+    dev::h256 topic;
+    unsigned int height;
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 36;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        s.write((const char*)topic.data(), dev::h256::size);
+        ser_writedata32be(s, height);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        s.read((char*)topic.data(), dev::h256::size);
+        height = ser_readdata32be(s);
+    }
+
+    CTopicIndexIteratorKey(const dev::h256& _topic, unsigned int _height) {
+        topic = _topic;
+        height = _height;
+    }
+
+    CTopicIndexIteratorKey() {
+        SetNull();
+    }
+
+    void SetNull() {
+        topic.clear();
+        height = 0;
+    }
+};
+
+/** Key of the first topic of the logs of a transaction; the value is the txid */
+struct CTopicIndexKey {
+    dev::h256 topic;
+    unsigned int height;
+    unsigned int txIndex;
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 40;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        s.write((const char*)topic.data(), dev::h256::size);
+        ser_writedata32be(s, height);
+        ser_writedata32be(s, txIndex);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        s.read((char*)topic.data(), dev::h256::size);
+        height = ser_readdata32be(s);
+        txIndex = ser_readdata32be(s);
+    }
+
+    CTopicIndexKey(const dev::h256& _topic, unsigned int _height, unsigned int _txIndex) {
+        topic = _topic;
+        height = _height;
+        txIndex = _txIndex;
+    }
+
+    CTopicIndexKey() {
+        SetNull();
+    }
+
+    void SetNull() {
+        topic.clear();
+        height = 0;
+        txIndex = 0;
+    }
+};
+
+/** Roles of an EVM address in a contract transaction, in the contract address index */
+enum ContractAddressRole : unsigned char {
+    CONTRACT_ADDRESS_SENDER = 1,        //!< Sent value in a transfer of the execution
+    CONTRACT_ADDRESS_RECEIVER = 2,      //!< Received value in a transfer of the execution
+    CONTRACT_ADDRESS_CREATED = 4,       //!< Contract created by the execution
+    CONTRACT_ADDRESS_DESTRUCTED = 8,    //!< Contract destructed by the execution
+};
+
+struct CContractAddressIndexIteratorKey {
+    dev::h160 address;
+    unsigned int height;
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 24;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        s.write((const char*)address.data(), dev::h160::size);
+        ser_writedata32be(s, height);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        s.read((char*)address.data(), dev::h160::size);
+        height = ser_readdata32be(s);
+    }
+
+    CContractAddressIndexIteratorKey(const dev::h160& _address, unsigned int _height) {
+        address = _address;
+        height = _height;
+    }
+
+    CContractAddressIndexIteratorKey() {
+        SetNull();
+    }
+
+    void SetNull() {
+        address.clear();
+        height = 0;
+    }
+};
+
+/** Key of an EVM address taking part in a contract transaction; the value is the txid and the roles of the address */
+struct CContractAddressIndexKey {
+    dev::h160 address;
+    unsigned int height;
+    unsigned int txIndex;
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 28;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        s.write((const char*)address.data(), dev::h160::size);
+        ser_writedata32be(s, height);
+        ser_writedata32be(s, txIndex);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        s.read((char*)address.data(), dev::h160::size);
+        height = ser_readdata32be(s);
+        txIndex = ser_readdata32be(s);
+    }
+
+    CContractAddressIndexKey(const dev::h160& _address, unsigned int _height, unsigned int _txIndex) {
+        address = _address;
+        height = _height;
+        txIndex = _txIndex;
+    }
+
+    CContractAddressIndexKey() {
+        SetNull();
+    }
+
+    void SetNull() {
+        address.clear();
+        height = 0;
+        txIndex = 0;
+    }
+};
+
+/** Key of a block staked by an address in the staker index; the entries have no value */
+struct CStakerIndexKey {
+    uint160 staker;
+    unsigned int height;
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 24;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        s << staker;
+        ser_writedata32be(s, height);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        s >> staker;
+        height = ser_readdata32be(s);
+    }
+
+    CStakerIndexKey(const uint160& _staker, unsigned int _height) {
+        staker = _staker;
+        height = _height;
+    }
+
+    CStakerIndexKey() {
+        SetNull();
+    }
+
+    void SetNull() {
+        staker.SetNull();
+        height = 0;
+    }
+};
+
+/** The txid of a contract transaction and the ContractAddressRole flags of the address in it */
+typedef std::pair<uint256, unsigned char> CContractAddressIndexValue;
+
+/** Log bloom over the contract addresses and topics of a block, or of a range of blocks */
+struct CLogBloomIndexValue {
+    dev::eth::LogBloom bloom;
+    // Height of the (latest) block with log entries folded into the bloom
+    unsigned int height;
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        s.write((const char*)bloom.data(), dev::eth::LogBloom::size);
+        ser_writedata32(s, height);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        s.read((char*)bloom.data(), dev::eth::LogBloom::size);
+        height = ser_readdata32(s);
+    }
+
+    CLogBloomIndexValue() {
+        SetNull();
+    }
+
+    void SetNull() {
+        bloom.clear();
+        height = 0;
+    }
+};
+
 #ifdef ENABLE_BITCORE_RPC
 struct CTimestampIndexIteratorKey {
     unsigned int timestamp;
@@ -766,6 +1078,39 @@ struct CAddressIndexIteratorKey {
         hashBytes.SetNull();
     }
 };
+
+/** Totals of the address index entries of an address, kept up to date as blocks are connected and disconnected */
+struct CAddressSummary {
+    CAmount balance;
+    CAmount received;
+    uint64_t txCount;
+    int lastHeight;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(balance);
+        READWRITE(received);
+        READWRITE(txCount);
+        READWRITE(lastHeight);
+    }
+
+    CAddressSummary() {
+        SetNull();
+    }
+
+    void SetNull() {
+        balance = 0;
+        received = 0;
+        txCount = 0;
+        lastHeight = 0;
+    }
+
+    bool IsNull() const {
+        return (txCount == 0);
+    }
+};
 #endif
 ////////////////////////////////////////////////////////////
 
@@ -852,17 +1197,40 @@ public:
 /** Initializes the script-execution cache */
 void InitScriptExecutionCache();
 
+struct SignatureCacheStats;
+
+/** Counters of the script-execution cache */
+SignatureCacheStats GetScriptExecutionCacheStats();
+
+/** Double the script-execution cache, up to nMaxBytes, keeping its entries. Returns whether it grew. */
+bool GrowScriptExecutionCache(size_t nMaxBytes);
+
 #ifdef ENABLE_BITCORE_RPC
 ///////////////////////////////////////////////////////////////// // kpg
 bool GetAddressIndex(uint256 addressHash, int type,
                      std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                      int start = 0, int end = 0);
 
+/** One page of the address index of the address of cursor, see AddressIndex::ReadAddressIndexPage */
+bool GetAddressIndexPage(CAddressIndexKey &cursor, size_t limit, int end,
+                         std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex);
+
+/** The address index of several addresses in height order, see AddressIndex::ReadAddressIndexMerged */
+bool GetMergedAddressIndex(const std::vector<std::pair<uint256, int> > &addresses,
+                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                           int start = 0, int end = 0);
+
+bool GetAddressSummary(uint256 addressHash, int type, CAddressSummary &summary);
+
 bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
 
 bool GetAddressUnspent(uint256 addressHash, int type,
                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs);
 
+/** One page of the unspent outputs of the address of cursor, see AddressIndex::ReadAddressUnspentIndexPage */
+bool GetAddressUnspentPage(CAddressUnspentKey &cursor, size_t limit,
+                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs);
+
 bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, const bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &hashes);
 /////////////////////////////////////////////////////////////////
 #endif
@@ -874,6 +1242,7 @@ bool ReadBlockFromDisk(Block& block, const CDiskBlockPos& pos, const Consensus::
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& message_start);
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start);
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex);
 bool CheckIndexProof(const CBlockIndex& block, const Consensus::Params& consensusParams);
 
 /** Functions for validating blocks and updating the block tree */
@@ -881,7 +1250,7 @@ bool CheckIndexProof(const CBlockIndex& block, const Consensus::Params& consensu
 /** Context-independent validity checks */
 bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, bool fCheckMerkleRoot = true, bool fCheckSig=true);
 bool GetBlockPublicKey(const CBlock& block, std::vector<unsigned char>& vchPubKey);
-bool SignBlock(std::shared_ptr<CBlock> pblock, CWallet& wallet, const CAmount& nTotalFees, uint32_t nTime, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoins);
+bool SignBlock(std::shared_ptr<CBlock> pblock, CWallet& wallet, const CAmount& nTotalFees, uint32_t nTime, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoins, const COutPoint* pprevoutKernel = nullptr);
 bool CheckCanonicalBlockSignature(const CBlockHeader* pblock);
 
 /** Check a block is completely valid from start to finish (only works on top of our current best block) */
@@ -896,6 +1265,9 @@ bool IsNullDummyEnabled(const CBlockIndex* pindexPrev, const Consensus::Params&
 /** When there are blocks in the active chain with missing data, rewind the chainstate and remove them from the block index */
 bool RewindBlockIndex(const CChainParams& params);
 
+/** Index of the witness commitment among the coinbase outputs of a block, -1 if it has none */
+int GetWitnessCommitmentIndex(const CBlock& block);
+
 /** Update uncommitted block structures (currently: only the witness reserved value). This is safe for submitted blocks. */
 void UpdateUncommittedBlockStructures(CBlock& block, const CBlockIndex* pindexPrev, const Consensus::Params& consensusParams);
 
@@ -910,6 +1282,46 @@ public:
     bool VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview, int nCheckLevel, int nCheckDepth);
 };
 
+/** What the background block check does on a corruption, see -backgroundcheck */
+enum class BackgroundCheckMode
+{
+    OFF,
+    //! Set a warning and keep running
+    WARN,
+    //! Set a warning and shut the node down
+    HALT,
+};
+
+/** Default for -backgroundcheck */
+static const char* const DEFAULT_BACKGROUND_CHECK = "off";
+/** Blocks verified at startup, at most at level 3, when the check continues in the background */
+static const int BACKGROUND_CHECK_STARTUP_BLOCKS = 2;
+
+enum class BackgroundCheckStatus
+{
+    NONE,
+    RUNNING,
+    DONE,
+    FAILED,
+};
+
+/** Progress of the background block check */
+extern std::atomic<BackgroundCheckStatus> g_background_check_status;
+/** Lowest height the background block check verified so far */
+extern std::atomic<int> g_background_check_height;
+
+/** Parse a -backgroundcheck mode: off, warn or halt */
+bool ParseBackgroundCheckMode(const std::string& str, BackgroundCheckMode& mode);
+
+/**
+ * Verify the last nCheckDepth blocks of the active chain while the node runs, holding
+ * cs_main for one block at a time: their data (level 0), their validity (level 1) and
+ * their undo data (level 2), and at level 4 the contract state of the tip, which is
+ * walked without cs_main. The disconnection and reconnection of blocks of levels 3 and
+ * 4 change the chain state and stay in the startup check.
+ */
+void ThreadBackgroundCheck(const CChainParams& chainparams, int nCheckLevel, int nCheckDepth, BackgroundCheckMode mode);
+
 /** Replay blocks that aren't fully applied to the database. */
 bool ReplayBlocks(const CChainParams& params, CCoinsView* view);
 
@@ -942,6 +1354,9 @@ extern CChain& chainActive;
 /** Global variable that points to the coins database (protected by cs_main) */
 extern std::unique_ptr<CCoinsViewDB> pcoinsdbview;
 
+/** Global variable that points to the background writer in front of the coins database, if -backgroundflush */
+extern std::unique_ptr<CCoinsViewBackgroundFlush> pcoinsflusher;
+
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern std::unique_ptr<CCoinsViewCache> pcoinsTip;
 
@@ -997,17 +1412,122 @@ bool GetSpentCoinFromMainChain(const CBlockIndex* pforkPrev, COutPoint prevoutSt
 
 unsigned int GetContractScriptFlags(int nHeight, const Consensus::Params& consensusparams);
 
+/** Whether -prunestate keeps the contract state at pindex; the run in progress, if any, does
+ *  not delete it. Readers using it outside of cs_main pin its roots with StateRootsPin */
+bool IsContractStateAvailable(const CBlockIndex* pindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
 std::vector<ResultExecute> CallContract(const dev::Address& addrContract, std::vector<unsigned char> opcode, const dev::Address& sender = dev::Address(), uint64_t gasLimit=0);
 
 std::vector<ResultExecute> CallContract(const dev::Address& addrContract, std::vector<unsigned char> opcode, int blockHeight, const dev::Address& sender = dev::Address(), uint64_t gasLimit = 0);
 
-std::vector<ResultExecute> CallContract(const dev::Address& addrContract, std::vector<unsigned char> opcode, CBlockIndex* pblockindex, const dev::Address& sender = dev::Address(), uint64_t gasLimit = 0);
+/** Call a contract at pblockindex. With state set the call is executed on it, which the caller
+ *  has at the roots of pblockindex, and the DGP parameters are read from it too */
+std::vector<ResultExecute> CallContract(const dev::Address& addrContract, std::vector<unsigned char> opcode, CBlockIndex* pblockindex, const dev::Address& sender = dev::Address(), uint64_t gasLimit = 0, QtumState* state = nullptr);
+
+/**
+ * Read-only view of the contract state at one block.
+ *
+ * The view pins the state roots, the DGP values and the call environment of the block
+ * while cs_main is held; afterwards calls and state reads run on private forks of the
+ * pinned state without cs_main, so RPC worker threads can use views concurrently with
+ * each other and with block validation. The DGP values are read from the state of the
+ * block, and its roots are kept from -prunestate until the view is destroyed.
+ */
+class ContractCallView
+{
+public:
+    /** The contract state of pblockindex must be available, see IsContractStateAvailable */
+    explicit ContractCallView(CBlockIndex* pblockindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    ~ContractCallView();
+
+    bool addressInUse(const dev::Address& addr) const;
+
+    std::map<dev::h256, std::pair<dev::u256, dev::u256>> storage(const dev::Address& addr) const;
+
+    /** Root of the storage trie of a contract, it changes with any of its storage */
+    dev::h256 storageRoot(const dev::Address& addr) const;
+
+    /** Call f with a fork of the state of the view, which is not shared with other threads */
+    void readState(const std::function<void(const QtumState&)>& f) const;
+
+    std::vector<ResultExecute> call(const dev::Address& addrContract, const std::vector<unsigned char>& opcode, const dev::Address& sender = dev::Address(), uint64_t gasLimit = 0) const;
+
+    /** Execute a call, or a creation if tx is one, sent by sender with the gas limit and value of tx */
+    std::vector<ResultExecute> execute(QtumTransaction tx, const dev::Address& sender) const;
+
+    /** Gas limit of the calls made with no gas limit */
+    uint64_t defaultGasLimit() const { return blockGasLimit - 1; }
+
+    const CBlockIndex* blockIndex() const { return pindex; }
+
+private:
+    CBlock block;
+    CBlockIndex* pindex;
+    uint64_t blockGasLimit;
+    std::shared_ptr<const dev::eth::EVMSchedule> schedule;
+    std::shared_ptr<const QtumState> state;
+    std::unique_ptr<StateRootsPin> pin;
+};
+
+/** Result of a dry run of a contract call or creation at the tip, see EstimateContractGas */
+struct ContractGasEstimate
+{
+    uint64_t nGasUsed = 0;
+    dev::eth::TransactionException excepted = dev::eth::TransactionException::None;
+    dev::bytes output;
+    //! Address of the contract a creation would have in the dry run
+    dev::Address newAddress;
+    //! Roots of the tip the dry run executed on
+    uint256 hashStateRoot;
+    uint256 hashUTXORoot;
+    //! Wall time of the execution in microseconds
+    int64_t nTime = 0;
+};
+
+/** Number of dry runs kept by EstimateContractGas */
+static const size_t MAX_GAS_ESTIMATE_CACHE_ENTRIES = 4096;
+
+/**
+ * Execute a call of addrContract, or a creation if it is null, from sender with nValue
+ * on the state of the tip, with the block gas limit. The result is recorded by (sender,
+ * contract, data, value, state roots), so the same dry run is answered from the record
+ * while the roots of the tip are unchanged, and a transaction doing it that enters the
+ * mempool with enough gas does not execute it again for -mempoolpreexec.
+ */
+ContractGasEstimate EstimateContractGas(const dev::Address& sender, const dev::Address& addrContract, const std::vector<unsigned char>& data, CAmount nValue, bool* pfCached = nullptr) LOCKS_EXCLUDED(cs_main);
+
+/** A QRC20 Transfer log emitted by a contract transaction of a connected block */
+struct TokenTransferLog
+{
+    uint256 hashTx;
+    uint160 contract;
+    uint160 from;
+    uint160 to;
+    //! Big endian, as the value of the token transactions of the wallet
+    uint256 value;
+};
+
+/** Execute again the contract transactions of a connected block, on a fork of the state of
+ *  its parent, for the receipts that ConnectBlock records with -logevents */
+bool ReplayBlockReceipts(const CBlock& block, const CBlockIndex* pindex, const CBlockUndo& blockundo, BlockReceipts& receipts);
+
+/** Get the receipts of the contract transactions of a block from the results database
+ *  when the log index recorded them for this block, or else by ReplayBlockReceipts */
+bool ReadBlockReceipts(const CBlock& block, const CBlockIndex* pindex, const CBlockUndo& blockundo, BlockReceipts& receipts);
+
+/** Collect from the log index the receipts with logs of blocks fromBlock to toBlock (the tip when <= 0),
+ *  of one of the addresses (any when empty) and with any of the topics at its position (a missing topic
+ *  matches anything), as searchlogs does. Once maxReceipts are collected the search stops at the end of
+ *  the block, nextBlock is then set to the block to continue from, and else to -1.
+ *  Returns false if the parameters are incorrect. */
+bool SearchLogs(int fromBlock, int toBlock, int minconf, const std::set<dev::h160>& addresses, const std::vector<boost::optional<dev::h256>>& topics,
+                size_t maxReceipts, std::vector<TransactionReceiptInfo>& receipts, int& nextBlock) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
 bool CheckOpSender(const CTransaction& tx, const CChainParams& chainparams, int nHeight);
 
 bool CheckSenderScript(const CCoinsViewCache& view, const CTransaction& tx);
 
-bool CheckMinGasPrice(std::vector<EthTransactionParams>& etps, const uint64_t& minGasPrice);
+bool CheckMinGasPrice(const std::vector<EthTransactionParams>& etps, const uint64_t& minGasPrice);
 
 struct ByteCodeExecResult;
 
@@ -1041,11 +1561,38 @@ struct ByteCodeExecResult{
     std::vector<CTransaction> valueTransfers;
 };
 
+/**
+ * Transactions of a block (or of a block template under construction) indexed by txid.
+ * Used to resolve the sender of a contract transaction spending a zero-confirmation
+ * output of the same block without scanning the whole block for every transaction.
+ */
+class CBlockTxIndex
+{
+public:
+    CBlockTxIndex() {}
+    explicit CBlockTxIndex(const std::vector<CTransactionRef>& vtx);
+
+    void Add(const CTransactionRef& tx);
+    /** Return the transaction with the given txid, or nullptr if it is not in the block */
+    const CTransaction* Find(const uint256& txid) const;
+    void Clear() { mapTx.clear(); }
+
+private:
+    std::unordered_map<uint256, CTransactionRef, BlockHasher> mapTx;
+};
+
+/** The contract transactions of a transaction, with the contract script flags they were extracted with */
+struct ContractExtraction
+{
+    unsigned int nFlags;
+    ExtractQtumTX extracted;
+};
+
 class QtumTxConverter{
 
 public:
 
-    QtumTxConverter(CTransaction tx, CCoinsViewCache* v = NULL, const std::vector<CTransactionRef>* blockTxs = NULL, unsigned int flags = SCRIPT_EXEC_BYTE_CODE) : txBit(tx), view(v), blockTransactions(blockTxs), sender(false), nFlags(flags){}
+    QtumTxConverter(CTransaction tx, const CCoinsViewCache* v = NULL, const CBlockTxIndex* blockTxs = NULL, unsigned int flags = SCRIPT_EXEC_BYTE_CODE) : txBit(tx), view(v), blockTransactions(blockTxs), sender(false), nFlags(flags){}
 
     bool extractionQtumTransactions(ExtractQtumTX& qtumTx);
 
@@ -1063,17 +1610,21 @@ private:
     const CCoinsViewCache* view;
     std::vector<valtype> stack;
     opcodetype opcode;
-    const std::vector<CTransactionRef> *blockTransactions;
+    const CBlockTxIndex *blockTransactions;
     bool sender;
     dev::Address refundSender;
     unsigned int nFlags;
 };
 
+/** Number of block hashes the EVM can look up with BLOCKHASH */
+static const int LAST_HASHES_COUNT = 256;
+
 class LastHashes: public dev::eth::LastBlockHashesFace
 {
 public:
     explicit LastHashes();
 
+    /** Set the hashes of tip and its ancestors, shared with the chain tip snapshot when tip is the tip of chainActive */
     void set(CBlockIndex const* tip);
 
     dev::h256s precedingHashes(dev::h256 const&) const;
@@ -1081,21 +1632,29 @@ public:
     void clear();
 
 private:
-    dev::h256s m_lastHashes;
+    std::shared_ptr<const dev::h256s> m_lastHashes;
 };
 
+class ContractProfiler;
+
 class ByteCodeExec {
 
 public:
 
-    ByteCodeExec(const CBlock& _block, std::vector<QtumTransaction> _txs, const uint64_t _blockGasLimit, CBlockIndex* _pindex) : txs(_txs), block(_block), blockGasLimit(_blockGasLimit), pindex(_pindex) {}
+    ByteCodeExec(const CBlock& _block, std::vector<QtumTransaction> _txs, const uint64_t _blockGasLimit, CBlockIndex* _pindex, QtumState* _state = nullptr, dev::eth::SealEngineFace* _sealEngine = nullptr);
 
-    bool performByteCode(dev::eth::Permanence type = dev::eth::Permanence::Committed);
+    /** Execute the transactions. With fCommitDB false the trie nodes stay in the
+     *  state overlays and the caller writes them to disk (once per block). If profiler
+     *  is set, the executions are recorded in it. */
+    bool performByteCode(dev::eth::Permanence type = dev::eth::Permanence::Committed, bool fCommitDB = true, ContractProfiler* profiler = nullptr);
 
     bool processingResults(ByteCodeExecResult& result);
 
     std::vector<ResultExecute>& getResult(){ return result; }
 
+    /** Wall time of each transaction in microseconds, aligned with getResult() */
+    const std::vector<int64_t>& getExecTimes() const { return execTimes; }
+
 private:
 
     dev::eth::EnvInfo BuildEVMEnvironment();
@@ -1106,6 +1665,8 @@ private:
 
     std::vector<ResultExecute> result;
 
+    std::vector<int64_t> execTimes;
+
     const CBlock& block;
 
     const uint64_t blockGasLimit;
@@ -1113,7 +1674,53 @@ private:
     CBlockIndex* pindex;
 
     LastHashes lastHashes;
+
+    //! State the transactions are executed against (globalState unless a fork is given)
+    QtumState* state;
+
+    dev::eth::SealEngineFace* sealEngine;
+};
+
+/** Number of contract transactions whose local execution is kept for the current tip */
+static const size_t MAX_LOCAL_CONTRACT_EXECUTIONS = 5000;
+
+/**
+ * The execution of a contract transaction by the block assembler, with the environment it
+ * ran in and the state roots around it. ConnectBlock takes the results and the roots after
+ * it from here instead of executing the transaction again when a locally assembled block
+ * is connected, if the environment matches and the state is at the roots before it.
+ */
+struct LocalContractExecution
+{
+    uint256 hashPrevBlock;
+    uint32_t nTime;
+    uint32_t nBits;
+    //! Script of the block author, see ByteCodeExec::BuildEVMEnvironment
+    CScript scriptAuthor;
+    uint64_t blockGasLimit;
+    unsigned int nContractFlags;
+    std::shared_ptr<const dev::eth::EVMSchedule> schedule;
+    dev::h256 hashStateRootBefore;
+    dev::h256 hashUTXORootBefore;
+    dev::h256 hashStateRootAfter;
+    dev::h256 hashUTXORootAfter;
+    std::vector<ResultExecute> result;
+    ByteCodeExecResult bcer;
+
+    /** Set the environment fields from a block being assembled on pindexPrev */
+    void SetEnvironment(const CBlock& block, const CBlockIndex* pindexPrev, uint64_t blockGasLimit, unsigned int nContractFlags, const std::shared_ptr<const dev::eth::EVMSchedule>& schedule);
+    bool MatchesEnvironment(const CBlock& block, uint64_t blockGasLimit, unsigned int nContractFlags, const std::shared_ptr<const dev::eth::EVMSchedule>& schedule) const;
 };
+
+/** Keep the execution of a contract transaction by the block assembler, until the tip changes */
+void RecordLocalContractExecution(const uint256& txid, std::shared_ptr<const LocalContractExecution> execution) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+/** The local execution of txid that ran in the environment of block, or nullptr */
+std::shared_ptr<const LocalContractExecution> FindLocalContractExecution(const uint256& txid, const CBlock& block, uint64_t blockGasLimit,
+    unsigned int nContractFlags, const std::shared_ptr<const dev::eth::EVMSchedule>& schedule) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+/** Forget the local executions, their roots are not kept by the state pruning once the tip changes */
+void ClearLocalContractExecutions() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 ////////////////////////////////////////////////////////
 
 #endif // BITCOIN_VALIDATION_H
@@ -7,10 +7,12 @@
 
 #include <primitives/block.h>
 #include <scheduler.h>
+#include <stakingstats.h>
 #include <txmempool.h>
 #include <util/system.h>
 #include <validation.h>
 
+#include <algorithm>
 #include <list>
 #include <atomic>
 #include <future>
@@ -19,35 +21,138 @@
 #include <boost/signals2/signal.hpp>
 
 struct ValidationInterfaceConnections {
-    boost::signals2::scoped_connection UpdatedBlockTip;
-    boost::signals2::scoped_connection TransactionAddedToMempool;
-    boost::signals2::scoped_connection BlockConnected;
-    boost::signals2::scoped_connection BlockDisconnected;
-    boost::signals2::scoped_connection TransactionRemovedFromMempool;
-    boost::signals2::scoped_connection ChainStateFlushed;
     boost::signals2::scoped_connection Broadcast;
     boost::signals2::scoped_connection BlockChecked;
     boost::signals2::scoped_connection NewPoWValidBlock;
 };
 
+/**
+ * A subscriber with the queue of its background callbacks. The queues of the subscribers
+ * are serviced by all the scheduler threads, each one in order, so a slow subscriber only
+ * delays its own callbacks.
+ *
+ * The queue may still hold callbacks when the subscriber is unregistered, so the entry is
+ * not freed but used again by a later registration. The callbacks carry the registration
+ * they were queued for and are skipped once it is over.
+ */
+struct ValidationInterfaceSubscriber {
+    //! Held while a callback runs, so that unregistering waits for it
+    CCriticalSection m_cs_callbacks;
+    CValidationInterface* pcallbacks GUARDED_BY(m_cs_callbacks);
+    //! Counts the registrations of the entry, the current one if pcallbacks is set
+    uint64_t nRegistration GUARDED_BY(m_cs_callbacks){0};
+    SingleThreadedSchedulerClient m_schedulerClient;
+
+    explicit ValidationInterfaceSubscriber(CScheduler* pscheduler) : pcallbacks(nullptr), m_schedulerClient(pscheduler) {}
+};
+
 struct MainSignalsInstance {
-    boost::signals2::signal<void (const CBlockIndex *, const CBlockIndex *, bool fInitialDownload)> UpdatedBlockTip;
-    boost::signals2::signal<void (const CTransactionRef &)> TransactionAddedToMempool;
-    boost::signals2::signal<void (const std::shared_ptr<const CBlock> &, const CBlockIndex *pindex, const std::vector<CTransactionRef>&)> BlockConnected;
-    boost::signals2::signal<void (const std::shared_ptr<const CBlock> &)> BlockDisconnected;
-    boost::signals2::signal<void (const CTransactionRef &)> TransactionRemovedFromMempool;
-    boost::signals2::signal<void (const CBlockLocator &)> ChainStateFlushed;
     boost::signals2::signal<void (int64_t nBestBlockTime, CConnman* connman)> Broadcast;
     boost::signals2::signal<void (const CBlock&, const CValidationState&)> BlockChecked;
     boost::signals2::signal<void (const CBlockIndex *, const std::shared_ptr<const CBlock>&)> NewPoWValidBlock;
 
+    CScheduler* m_pscheduler;
     // We are not allowed to assume the scheduler only runs in one thread,
     // but must ensure all callbacks happen in-order, so we end up creating
     // our own queue here :(
+    // Runs the functions of CallFunctionInValidationInterfaceQueue while there are no subscribers
     SingleThreadedSchedulerClient m_schedulerClient;
     std::unordered_map<CValidationInterface*, ValidationInterfaceConnections> m_connMainSignals;
 
-    explicit MainSignalsInstance(CScheduler *pscheduler) : m_schedulerClient(pscheduler) {}
+    CCriticalSection m_cs_subscribers;
+    //! The registered subscribers with their entry and registration
+    std::unordered_map<CValidationInterface*, std::pair<ValidationInterfaceSubscriber*, uint64_t>> m_subscribers GUARDED_BY(m_cs_subscribers);
+    //! All the entries, kept until shutdown as their queues may still be scheduled. There are as
+    //! many as subscribers were ever registered at the same time.
+    std::vector<std::unique_ptr<ValidationInterfaceSubscriber>> m_all_subscribers GUARDED_BY(m_cs_subscribers);
+    //! The entries of m_all_subscribers not used by a registration
+    std::vector<ValidationInterfaceSubscriber*> m_free_subscribers GUARDED_BY(m_cs_subscribers);
+
+    explicit MainSignalsInstance(CScheduler *pscheduler) : m_pscheduler(pscheduler), m_schedulerClient(pscheduler) {}
+
+    /** Queue a callback for each registered subscriber, in its own queue */
+    void Enqueue(const std::function<void (CValidationInterface&)>& callback) {
+        LOCK(m_cs_subscribers);
+        for (const auto& entry : m_subscribers) {
+            ValidationInterfaceSubscriber* subscriber = entry.second.first;
+            const uint64_t nRegistration = entry.second.second;
+            subscriber->m_schedulerClient.AddToProcessQueue([subscriber, nRegistration, callback] {
+                LOCK(subscriber->m_cs_callbacks);
+                if (subscriber->pcallbacks && subscriber->nRegistration == nRegistration) {
+                    callback(*subscriber->pcallbacks);
+                }
+            });
+        }
+    }
+
+    /**
+     * Take an entry for a new registration of pcallbacks. The locks are taken one at a time,
+     * as a callback holding m_cs_callbacks may take m_cs_subscribers.
+     */
+    void Register(CValidationInterface* pcallbacks) LOCKS_EXCLUDED(m_cs_subscribers) {
+        ValidationInterfaceSubscriber* subscriber;
+        {
+            LOCK(m_cs_subscribers);
+            if (m_subscribers.count(pcallbacks)) {
+                return;
+            }
+            if (m_free_subscribers.empty()) {
+                m_all_subscribers.emplace_back(new ValidationInterfaceSubscriber(m_pscheduler));
+                subscriber = m_all_subscribers.back().get();
+            } else {
+                subscriber = m_free_subscribers.back();
+                m_free_subscribers.pop_back();
+            }
+        }
+        uint64_t nRegistration;
+        {
+            LOCK(subscriber->m_cs_callbacks);
+            subscriber->pcallbacks = pcallbacks;
+            nRegistration = ++subscriber->nRegistration;
+        }
+        {
+            LOCK(m_cs_subscribers);
+            if (m_subscribers.emplace(pcallbacks, std::make_pair(subscriber, nRegistration)).second) {
+                return;
+            }
+        }
+        // Registered by another thread in the meantime
+        Drain(subscriber);
+    }
+
+    /** End a registration, the callbacks still queued for it are skipped */
+    ValidationInterfaceSubscriber* Unregister(CValidationInterface* pcallbacks) EXCLUSIVE_LOCKS_REQUIRED(m_cs_subscribers) {
+        auto it = m_subscribers.find(pcallbacks);
+        if (it == m_subscribers.end()) {
+            return nullptr;
+        }
+        ValidationInterfaceSubscriber* subscriber = it->second.first;
+        m_subscribers.erase(it);
+        return subscriber;
+    }
+
+    /**
+     * Wait for the callback of an unregistered subscriber that may be running, then free
+     * its entry. Called without m_cs_subscribers, which callbacks may take to register or
+     * unregister subscribers.
+     */
+    void Drain(ValidationInterfaceSubscriber* subscriber) LOCKS_EXCLUDED(m_cs_subscribers) {
+        {
+            LOCK(subscriber->m_cs_callbacks);
+            subscriber->pcallbacks = nullptr;
+        }
+        LOCK(m_cs_subscribers);
+        m_free_subscribers.push_back(subscriber);
+    }
+
+    std::vector<SingleThreadedSchedulerClient*> GetSchedulerClients() {
+        LOCK(m_cs_subscribers);
+        std::vector<SingleThreadedSchedulerClient*> clients{&m_schedulerClient};
+        for (const auto& subscriber : m_all_subscribers) {
+            clients.push_back(&subscriber->m_schedulerClient);
+        }
+        return clients;
+    }
 };
 
 static CMainSignals g_signals;
@@ -68,13 +173,27 @@ void CMainSignals::UnregisterBackgroundSignalScheduler() {
 
 void CMainSignals::FlushBackgroundCallbacks() {
     if (m_internals) {
-        m_internals->m_schedulerClient.EmptyQueue();
+        // Callbacks may queue more callbacks, for other subscribers too
+        bool fPending = true;
+        while (fPending) {
+            fPending = false;
+            for (SingleThreadedSchedulerClient* client : m_internals->GetSchedulerClients()) {
+                client->EmptyQueue();
+            }
+            for (SingleThreadedSchedulerClient* client : m_internals->GetSchedulerClients()) {
+                fPending |= client->CallbacksPending() > 0;
+            }
+        }
     }
 }
 
 size_t CMainSignals::CallbacksPending() {
     if (!m_internals) return 0;
-    return m_internals->m_schedulerClient.CallbacksPending();
+    size_t nPending = 0;
+    for (SingleThreadedSchedulerClient* client : m_internals->GetSchedulerClients()) {
+        nPending = std::max(nPending, client->CallbacksPending());
+    }
+    return nPending;
 }
 
 void CMainSignals::RegisterWithMempoolSignals(CTxMemPool& pool) {
@@ -95,20 +214,24 @@ CMainSignals& GetMainSignals()
 
 void RegisterValidationInterface(CValidationInterface* pwalletIn) {
     ValidationInterfaceConnections& conns = g_signals.m_internals->m_connMainSignals[pwalletIn];
-    conns.UpdatedBlockTip = g_signals.m_internals->UpdatedBlockTip.connect(std::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
-    conns.TransactionAddedToMempool = g_signals.m_internals->TransactionAddedToMempool.connect(std::bind(&CValidationInterface::TransactionAddedToMempool, pwalletIn, std::placeholders::_1));
-    conns.BlockConnected = g_signals.m_internals->BlockConnected.connect(std::bind(&CValidationInterface::BlockConnected, pwalletIn, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
-    conns.BlockDisconnected = g_signals.m_internals->BlockDisconnected.connect(std::bind(&CValidationInterface::BlockDisconnected, pwalletIn, std::placeholders::_1));
-    conns.TransactionRemovedFromMempool = g_signals.m_internals->TransactionRemovedFromMempool.connect(std::bind(&CValidationInterface::TransactionRemovedFromMempool, pwalletIn, std::placeholders::_1));
-    conns.ChainStateFlushed = g_signals.m_internals->ChainStateFlushed.connect(std::bind(&CValidationInterface::ChainStateFlushed, pwalletIn, std::placeholders::_1));
     conns.Broadcast = g_signals.m_internals->Broadcast.connect(std::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, std::placeholders::_1, std::placeholders::_2));
     conns.BlockChecked = g_signals.m_internals->BlockChecked.connect(std::bind(&CValidationInterface::BlockChecked, pwalletIn, std::placeholders::_1, std::placeholders::_2));
     conns.NewPoWValidBlock = g_signals.m_internals->NewPoWValidBlock.connect(std::bind(&CValidationInterface::NewPoWValidBlock, pwalletIn, std::placeholders::_1, std::placeholders::_2));
+
+    g_signals.m_internals->Register(pwalletIn);
 }
 
 void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
     if (g_signals.m_internals) {
         g_signals.m_internals->m_connMainSignals.erase(pwalletIn);
+        ValidationInterfaceSubscriber* subscriber;
+        {
+            LOCK(g_signals.m_internals->m_cs_subscribers);
+            subscriber = g_signals.m_internals->Unregister(pwalletIn);
+        }
+        if (subscriber) {
+            g_signals.m_internals->Drain(subscriber);
+        }
     }
 }
 
@@ -117,10 +240,36 @@ void UnregisterAllValidationInterfaces() {
         return;
     }
     g_signals.m_internals->m_connMainSignals.clear();
+    std::vector<ValidationInterfaceSubscriber*> subscribers;
+    {
+        LOCK(g_signals.m_internals->m_cs_subscribers);
+        for (const auto& entry : g_signals.m_internals->m_subscribers) {
+            subscribers.push_back(entry.second.first);
+        }
+        g_signals.m_internals->m_subscribers.clear();
+    }
+    for (ValidationInterfaceSubscriber* subscriber : subscribers) {
+        g_signals.m_internals->Drain(subscriber);
+    }
 }
 
 void CallFunctionInValidationInterfaceQueue(std::function<void ()> func) {
-    g_signals.m_internals->m_schedulerClient.AddToProcessQueue(std::move(func));
+    MainSignalsInstance& internals = *g_signals.m_internals;
+    LOCK(internals.m_cs_subscribers);
+    if (internals.m_subscribers.empty()) {
+        internals.m_schedulerClient.AddToProcessQueue(std::move(func));
+        return;
+    }
+    // Called once the callbacks queued so far for every subscriber have run, by the last queue to get there
+    auto remaining = std::make_shared<std::atomic<size_t>>(internals.m_subscribers.size());
+    auto shared_func = std::make_shared<std::function<void ()>>(std::move(func));
+    for (const auto& entry : internals.m_subscribers) {
+        entry.second.first->m_schedulerClient.AddToProcessQueue([remaining, shared_func] {
+            if (--*remaining == 0) {
+                (*shared_func)();
+            }
+        });
+    }
 }
 
 void SyncWithValidationInterfaceQueue() {
@@ -135,8 +284,8 @@ void SyncWithValidationInterfaceQueue() {
 
 void CMainSignals::MempoolEntryRemoved(CTransactionRef ptx, MemPoolRemovalReason reason) {
     if (reason != MemPoolRemovalReason::BLOCK && reason != MemPoolRemovalReason::CONFLICT) {
-        m_internals->m_schedulerClient.AddToProcessQueue([ptx, this] {
-            m_internals->TransactionRemovedFromMempool(ptx);
+        m_internals->Enqueue([ptx](CValidationInterface& callbacks) {
+            callbacks.TransactionRemovedFromMempool(ptx);
         });
     }
 }
@@ -146,32 +295,32 @@ void CMainSignals::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockInd
     // the chain actually updates. One way to ensure this is for the caller to invoke this signal
     // in the same critical section where the chain is updated
 
-    m_internals->m_schedulerClient.AddToProcessQueue([pindexNew, pindexFork, fInitialDownload, this] {
-        m_internals->UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload);
+    m_internals->Enqueue([pindexNew, pindexFork, fInitialDownload](CValidationInterface& callbacks) {
+        callbacks.UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload);
     });
 }
 
 void CMainSignals::TransactionAddedToMempool(const CTransactionRef &ptx) {
-    m_internals->m_schedulerClient.AddToProcessQueue([ptx, this] {
-        m_internals->TransactionAddedToMempool(ptx);
+    m_internals->Enqueue([ptx](CValidationInterface& callbacks) {
+        callbacks.TransactionAddedToMempool(ptx);
     });
 }
 
 void CMainSignals::BlockConnected(const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindex, const std::shared_ptr<const std::vector<CTransactionRef>>& pvtxConflicted) {
-    m_internals->m_schedulerClient.AddToProcessQueue([pblock, pindex, pvtxConflicted, this] {
-        m_internals->BlockConnected(pblock, pindex, *pvtxConflicted);
+    m_internals->Enqueue([pblock, pindex, pvtxConflicted](CValidationInterface& callbacks) {
+        callbacks.BlockConnected(pblock, pindex, *pvtxConflicted);
     });
 }
 
 void CMainSignals::BlockDisconnected(const std::shared_ptr<const CBlock> &pblock) {
-    m_internals->m_schedulerClient.AddToProcessQueue([pblock, this] {
-        m_internals->BlockDisconnected(pblock);
+    m_internals->Enqueue([pblock](CValidationInterface& callbacks) {
+        callbacks.BlockDisconnected(pblock);
     });
 }
 
 void CMainSignals::ChainStateFlushed(const CBlockLocator &locator) {
-    m_internals->m_schedulerClient.AddToProcessQueue([locator, this] {
-        m_internals->ChainStateFlushed(locator);
+    m_internals->Enqueue([locator](CValidationInterface& callbacks) {
+        callbacks.ChainStateFlushed(locator);
     });
 }
 
@@ -186,3 +335,21 @@ void CMainSignals::BlockChecked(const CBlock& block, const CValidationState& sta
 void CMainSignals::NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock> &block) {
     m_internals->NewPoWValidBlock(pindex, block);
 }
+
+void CMainSignals::NewStakingEvent(const StakingEvent& event) {
+    m_internals->Enqueue([event](CValidationInterface& callbacks) {
+        callbacks.NewStakingEvent(event);
+    });
+}
+
+void CMainSignals::TokenTransfersConnected(const CBlockIndex *pindex, const std::shared_ptr<const std::vector<TokenTransferLog>>& ptransfers) {
+    m_internals->Enqueue([pindex, ptransfers](CValidationInterface& callbacks) {
+        callbacks.TokenTransfersConnected(pindex, *ptransfers);
+    });
+}
+
+void CMainSignals::BlockReceiptsConnected(const CBlockIndex *pindex, const std::shared_ptr<const BlockReceipts>& preceipts) {
+    m_internals->Enqueue([pindex, preceipts](CValidationInterface& callbacks) {
+        callbacks.BlockReceiptsConnected(pindex, preceipts);
+    });
+}
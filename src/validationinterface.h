@@ -11,6 +11,8 @@
 
 #include <functional>
 #include <memory>
+#include <utility>
+#include <vector>
 
 extern CCriticalSection cs_main;
 class CBlock;
@@ -24,15 +26,32 @@ class CValidationState;
 class uint256;
 class CScheduler;
 class CTxMemPool;
+struct StakingEvent;
+struct TokenTransferLog;
+struct TransactionReceiptInfo;
 enum class MemPoolRemovalReason;
 
+/** Receipts of the contract transactions of a block, in block order */
+typedef std::vector<std::pair<uint256, std::vector<TransactionReceiptInfo>>> BlockReceipts;
+
+/** Default for -schedulerthreads, the threads running the scheduled tasks and the background callbacks */
+static const int DEFAULT_SCHEDULER_THREADS = 4;
+/** Maximum for -schedulerthreads */
+static const int MAX_SCHEDULER_THREADS = 16;
+/** Callbacks queued for a subscriber above which block validation waits for the subscribers to catch up */
+static const size_t MAX_VALIDATION_INTERFACE_CALLBACKS_PENDING = 100;
+
 // These functions dispatch to one or all registered wallets
 
 /** Register a wallet to receive updates from core */
 void RegisterValidationInterface(CValidationInterface* pwalletIn);
-/** Unregister a wallet from core */
+/**
+ * Unregister a wallet from core. The callbacks still queued for it are skipped, and the one
+ * that may be running has completed on return, so the subscriber can be deleted. Must not be
+ * called holding a lock the callbacks take, such as cs_main.
+ */
 void UnregisterValidationInterface(CValidationInterface* pwalletIn);
-/** Unregister all wallets from core */
+/** Unregister all wallets from core, as UnregisterValidationInterface */
 void UnregisterAllValidationInterfaces();
 /**
  * Pushes a function to callback onto the notification queue, guaranteeing any
@@ -68,7 +87,13 @@ void SyncWithValidationInterfaceQueue() LOCKS_EXCLUDED(cs_main);
  * UpdatedBlockTip() callback may depend on an operation performed in
  * the BlockConnected() callback without worrying about explicit
  * synchronization. No ordering should be assumed across
- * ValidationInterface() subscribers.
+ * ValidationInterface() subscribers: each one has a queue of its own,
+ * serviced by the scheduler threads, so a slow subscriber only delays
+ * its own callbacks. A subscriber that needs what another one writes
+ * for a block (e.g. the receipts the log index stores) gets it from a
+ * callback of its own (BlockReceiptsConnected) or waits for the other
+ * one (BlockUntilSyncedToCurrentChain), and only
+ * CallFunctionInValidationInterfaceQueue orders across all of them.
  */
 class CValidationInterface {
 protected:
@@ -147,6 +172,28 @@ protected:
      * Notifies listeners that a block which builds directly on our current tip
      * has been received and connected to the headers tree, though not validated yet */
     virtual void NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& block) {};
+    /**
+     * Notifies listeners of what became of a kernel found by the staker.
+     *
+     * Called on a background thread.
+     */
+    virtual void NewStakingEvent(const StakingEvent& event) {}
+    /**
+     * Notifies listeners of the QRC20 Transfer logs of a block being connected, before
+     * its BlockConnected. Only blocks with transfers are notified.
+     *
+     * Called on a background thread.
+     */
+    virtual void TokenTransfersConnected(const CBlockIndex *pindex, const std::vector<TokenTransferLog>& transfers) {}
+    /**
+     * Notifies listeners of the receipts recorded by ConnectBlock with -logevents, for a
+     * block being connected, before its BlockConnected. The receipts are those of the
+     * execution, they don't depend on the log index having reached the block.
+     *
+     * Called on a background thread.
+     */
+    virtual void BlockReceiptsConnected(const CBlockIndex *pindex, const std::shared_ptr<const BlockReceipts>& receipts) {}
+    friend class CMainSignals;
     friend void ::RegisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
@@ -172,6 +219,7 @@ public:
     /** Call any remaining callbacks on the calling thread */
     void FlushBackgroundCallbacks();
 
+    /** Most callbacks waiting in the queue of a subscriber */
     size_t CallbacksPending();
 
     /** Register with mempool to call TransactionRemovedFromMempool callbacks */
@@ -187,6 +235,9 @@ public:
     void Broadcast(int64_t nBestBlockTime, CConnman* connman);
     void BlockChecked(const CBlock&, const CValidationState&);
     void NewPoWValidBlock(const CBlockIndex *, const std::shared_ptr<const CBlock>&);
+    void NewStakingEvent(const StakingEvent&);
+    void TokenTransfersConnected(const CBlockIndex *, const std::shared_ptr<const std::vector<TokenTransferLog>> &);
+    void BlockReceiptsConnected(const CBlockIndex *, const std::shared_ptr<const BlockReceipts> &);
 };
 
 CMainSignals& GetMainSignals();
@@ -0,0 +1,94 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <validationstats.h>
+
+#include <algorithm>
+
+ValidationStats validationStats;
+
+const char* ValidationStageName(ValidationStage stage)
+{
+    switch (stage) {
+    case ValidationStage::SANITY: return "sanity";
+    case ValidationStage::HASH_PROOF: return "hashproof";
+    case ValidationStage::FORKS: return "forks";
+    case ValidationStage::CONNECT: return "connect";
+    case ValidationStage::CONTRACTS: return "contracts";
+    case ValidationStage::REWARD: return "reward";
+    case ValidationStage::VERIFY: return "verify";
+    case ValidationStage::STATE_COMMIT: return "statecommit";
+    case ValidationStage::INDEX: return "index";
+    case ValidationStage::RECEIPTS: return "receipts";
+    case ValidationStage::READ_BLOCK: return "readblock";
+    case ValidationStage::CONNECT_BLOCK: return "connectblock";
+    case ValidationStage::FLUSH: return "flush";
+    case ValidationStage::CHAINSTATE: return "chainstate";
+    case ValidationStage::POST_CONNECT: return "postconnect";
+    case ValidationStage::TOTAL: return "total";
+    case ValidationStage::COUNT: break;
+    }
+    return "unknown";
+}
+
+void StageTimes::Add(int64_t nMicros)
+{
+    ++nCount;
+    nTotal += nMicros;
+    nMax = std::max(nMax, nMicros);
+    size_t nBucket = std::lower_bound(VALIDATION_STATS_BUCKETS.begin(), VALIDATION_STATS_BUCKETS.end(), nMicros) - VALIDATION_STATS_BUCKETS.begin();
+    ++histogram[nBucket];
+}
+
+ValidationStats::ValidationStats()
+{
+    nNext.fill(0);
+}
+
+void ValidationStats::Add(ValidationStage stage, int64_t nMicros)
+{
+    size_t i = static_cast<size_t>(stage);
+    LOCK(cs);
+    totals[i].Add(nMicros);
+    if (recent[i].size() < VALIDATION_STATS_WINDOW) {
+        recent[i].push_back(nMicros);
+    } else {
+        recent[i][nNext[i]] = nMicros;
+    }
+    nNext[i] = (nNext[i] + 1) % VALIDATION_STATS_WINDOW;
+}
+
+std::vector<StageStats> ValidationStats::Get() const
+{
+    std::vector<StageStats> stats(NUM_STAGES);
+    std::array<std::vector<int64_t>, NUM_STAGES> samples;
+    {
+        LOCK(cs);
+        for (size_t i = 0; i < NUM_STAGES; i++) {
+            stats[i].total = totals[i];
+            samples[i] = recent[i];
+        }
+    }
+    for (size_t i = 0; i < NUM_STAGES; i++) {
+        std::vector<int64_t>& sorted = samples[i];
+        if (sorted.empty())
+            continue;
+        for (int64_t nMicros : sorted)
+            stats[i].recent.Add(nMicros);
+        std::sort(sorted.begin(), sorted.end());
+        stats[i].nMedian = sorted[(sorted.size() - 1) / 2];
+        stats[i].n90th = sorted[(sorted.size() - 1) * 90 / 100];
+        stats[i].n99th = sorted[(sorted.size() - 1) * 99 / 100];
+    }
+    return stats;
+}
+
+void ValidationStats::Reset()
+{
+    LOCK(cs);
+    totals.fill(StageTimes());
+    for (std::vector<int64_t>& samples : recent)
+        samples.clear();
+    nNext.fill(0);
+}
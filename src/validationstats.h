@@ -0,0 +1,97 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef VALIDATIONSTATS_H
+#define VALIDATIONSTATS_H
+
+#include <sync.h>
+
+#include <array>
+#include <stdint.h>
+#include <vector>
+
+/** Stages of the connection of a block to the tip, timed by ConnectTip and ConnectBlock */
+enum class ValidationStage
+{
+    SANITY,         //!< ConnectBlock checks before the transactions, including HASH_PROOF
+    HASH_PROOF,     //!< UpdateHashProof
+    FORKS,          //!< BIP30 and soft fork flags
+    CONNECT,        //!< Serial pass over the transactions, including CONTRACTS
+    CONTRACTS,      //!< EVM execution and processing of its results
+    REWARD,         //!< CheckReward
+    VERIFY,         //!< Wait for the script checks still queued after the serial pass
+    STATE_COMMIT,   //!< Merkle and state roots, and the write of the trie nodes of the block
+    INDEX,          //!< Undo data and index writes
+    RECEIPTS,       //!< Hand-off of the transaction receipts to the log index
+    READ_BLOCK,     //!< Load of the block from disk in ConnectTip
+    CONNECT_BLOCK,  //!< All of ConnectBlock
+    FLUSH,          //!< Flush of the block's coins view into the tip
+    CHAINSTATE,     //!< FlushStateToDisk
+    POST_CONNECT,   //!< Mempool and chain tip updates
+    TOTAL,          //!< All of ConnectTip
+    COUNT
+};
+
+/** Name of a stage in getvalidationstats */
+const char* ValidationStageName(ValidationStage stage);
+
+/** Upper bounds of the histogram buckets in microseconds; a last bucket holds the longer samples */
+static const size_t VALIDATION_STATS_NUM_BUCKETS = 15;
+static const std::array<int64_t, VALIDATION_STATS_NUM_BUCKETS> VALIDATION_STATS_BUCKETS = {{
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000}};
+/** Number of recent blocks covered by the rolling statistics of each stage */
+static const size_t VALIDATION_STATS_WINDOW = 1000;
+
+/** Durations of one stage */
+struct StageTimes
+{
+    uint64_t nCount = 0;
+    int64_t nTotal = 0;
+    int64_t nMax = 0;
+    std::array<uint64_t, VALIDATION_STATS_NUM_BUCKETS + 1> histogram{};
+
+    void Add(int64_t nMicros);
+};
+
+/** Cumulative and recent durations of one stage, with percentiles of the recent ones */
+struct StageStats
+{
+    StageTimes total;
+    StageTimes recent;
+    int64_t nMedian = 0;
+    int64_t n90th = 0;
+    int64_t n99th = 0;
+};
+
+/**
+ * Timing of block connection by stage, since startup and over the last
+ * VALIDATION_STATS_WINDOW blocks. The ConnectBlock stages are recorded for every block
+ * it connects, including those replayed by -checklevel=4 at startup, but not for the
+ * block templates checked by TestBlockValidity.
+ */
+class ValidationStats
+{
+public:
+    ValidationStats();
+
+    void Add(ValidationStage stage, int64_t nMicros);
+
+    /** Statistics of all stages, indexed by stage */
+    std::vector<StageStats> Get() const;
+
+    void Reset();
+
+private:
+    static const size_t NUM_STAGES = static_cast<size_t>(ValidationStage::COUNT);
+
+    mutable Mutex cs;
+    std::array<StageTimes, NUM_STAGES> totals GUARDED_BY(cs);
+    //! Ring buffers of the most recent durations, and the position of the next one
+    std::array<std::vector<int64_t>, NUM_STAGES> recent GUARDED_BY(cs);
+    std::array<size_t, NUM_STAGES> nNext GUARDED_BY(cs);
+};
+
+extern ValidationStats validationStats;
+
+#endif
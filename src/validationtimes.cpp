@@ -0,0 +1,118 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <validationtimes.h>
+
+#include <chain.h>
+#include <primitives/block.h>
+
+ValidationTimes validationTimes;
+
+BlockValidationTimes& ValidationTimes::Block(const uint256& hash)
+{
+    auto it = mapBlocks.find(hash);
+    if (it != mapBlocks.end())
+        return it->second;
+    if (vBlockOrder.size() >= VALIDATION_TIMES_BLOCKS) {
+        mapBlocks.erase(vBlockOrder.front());
+        vBlockOrder.pop_front();
+    }
+    vBlockOrder.push_back(hash);
+    BlockValidationTimes& times = mapBlocks[hash];
+    times.hash = hash;
+    return times;
+}
+
+void ValidationTimes::HeaderReceived(const uint256& hash, int64_t nTime)
+{
+    LOCK(cs);
+    BlockValidationTimes& times = Block(hash);
+    if (!times.nHeaderReceived)
+        times.nHeaderReceived = nTime;
+}
+
+void ValidationTimes::BlockReceived(const uint256& hash, int64_t nPeer, int64_t nTime)
+{
+    LOCK(cs);
+    BlockValidationTimes& times = Block(hash);
+    if (!times.nHeaderReceived)
+        times.nHeaderReceived = nTime;
+    if (!times.nBlockReceived) {
+        times.nBlockReceived = nTime;
+        times.nPeer = nPeer;
+    }
+}
+
+void ValidationTimes::BlockConnected(const CBlock& block, const CBlockIndex* pindex, int64_t nConnectStart, int64_t nConnectEnd, int64_t nTipUpdated)
+{
+    const uint256 hash = pindex->GetBlockHash();
+    LOCK(cs);
+    // A block connected again after a reorg keeps the times of its last connection
+    BlockValidationTimes& times = Block(hash);
+    times.nHeight = pindex->nHeight;
+    times.nConnectStart = nConnectStart;
+    times.nConnectEnd = nConnectEnd;
+    times.nTipUpdated = nTipUpdated;
+    if (mapTxs.empty())
+        return;
+    for (const auto& tx : block.vtx) {
+        auto it = mapTxs.find(tx->GetHash());
+        if (it != mapTxs.end() && !it->second.nConfirmed) {
+            it->second.hashBlock = hash;
+            it->second.nConfirmed = nTipUpdated;
+        }
+    }
+}
+
+void ValidationTimes::TxReceived(const uint256& hash, int64_t nPeer, int64_t nTime)
+{
+    LOCK(cs);
+    if (mapTxs.count(hash))
+        return;
+    if (vTxOrder.size() >= VALIDATION_TIMES_TXS) {
+        mapTxs.erase(vTxOrder.front());
+        vTxOrder.pop_front();
+    }
+    vTxOrder.push_back(hash);
+    TxValidationTimes& times = mapTxs[hash];
+    times.hash = hash;
+    times.nPeer = nPeer;
+    times.nReceived = nTime;
+}
+
+void ValidationTimes::TxAccepted(const uint256& hash, int64_t nTime)
+{
+    LOCK(cs);
+    auto it = mapTxs.find(hash);
+    if (it != mapTxs.end() && !it->second.nAccepted)
+        it->second.nAccepted = nTime;
+}
+
+std::vector<BlockValidationTimes> ValidationTimes::GetBlocks(size_t nCount) const
+{
+    std::vector<BlockValidationTimes> blocks;
+    LOCK(cs);
+    for (auto it = vBlockOrder.rbegin(); it != vBlockOrder.rend() && blocks.size() < nCount; ++it)
+        blocks.push_back(mapBlocks.at(*it));
+    return blocks;
+}
+
+std::vector<TxValidationTimes> ValidationTimes::GetTxs(size_t nCount) const
+{
+    std::vector<TxValidationTimes> txs;
+    LOCK(cs);
+    for (auto it = vTxOrder.rbegin(); it != vTxOrder.rend() && txs.size() < nCount; ++it)
+        txs.push_back(mapTxs.at(*it));
+    return txs;
+}
+
+bool ValidationTimes::GetTx(const uint256& hash, TxValidationTimes& times) const
+{
+    LOCK(cs);
+    auto it = mapTxs.find(hash);
+    if (it == mapTxs.end())
+        return false;
+    times = it->second;
+    return true;
+}
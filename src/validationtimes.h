@@ -0,0 +1,97 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef VALIDATIONTIMES_H
+#define VALIDATIONTIMES_H
+
+#include <sync.h>
+#include <uint256.h>
+
+#include <deque>
+#include <map>
+#include <stdint.h>
+#include <vector>
+
+class CBlock;
+class CBlockIndex;
+
+/** Number of recent blocks whose validation times are kept */
+static const size_t VALIDATION_TIMES_BLOCKS = 1000;
+/** Number of recent transactions whose validation times are kept */
+static const size_t VALIDATION_TIMES_TXS = 20000;
+
+/**
+ * When a block got through each step from the network to the tip, in microseconds since
+ * the epoch, 0 for the steps it has not been through. Blocks that were not received from
+ * a peer, such as staked or submitted ones, only have the connection times.
+ */
+struct BlockValidationTimes
+{
+    uint256 hash;
+    int nHeight = -1;
+    //! Peer the block was received from, -1 if none
+    int64_t nPeer = -1;
+    //! The first headers, cmpctblock or block message with the header
+    int64_t nHeaderReceived = 0;
+    //! The block or blocktxn message that completed the block
+    int64_t nBlockReceived = 0;
+    int64_t nConnectStart = 0;
+    int64_t nConnectEnd = 0;
+    //! End of ConnectTip, with the block as the tip
+    int64_t nTipUpdated = 0;
+};
+
+/**
+ * When a transaction received from a peer was received, accepted to the mempool and
+ * connected in a block, in microseconds since the epoch, 0 if not yet.
+ */
+struct TxValidationTimes
+{
+    uint256 hash;
+    int64_t nPeer = -1;
+    int64_t nReceived = 0;
+    int64_t nAccepted = 0;
+    //! First block connected with the transaction
+    uint256 hashBlock;
+    //! Tip update time of that block
+    int64_t nConfirmed = 0;
+};
+
+/**
+ * A bounded history of the validation times of the most recent blocks and of the
+ * transactions received from peers, for getblockvalidationtimes. The receipt times are
+ * those of the messages on the socket, so they include the wait for the message handler.
+ */
+class ValidationTimes
+{
+public:
+    void HeaderReceived(const uint256& hash, int64_t nTime);
+    void BlockReceived(const uint256& hash, int64_t nPeer, int64_t nTime);
+    /** Record the connection of a block to the tip, and its transactions as confirmed */
+    void BlockConnected(const CBlock& block, const CBlockIndex* pindex, int64_t nConnectStart, int64_t nConnectEnd, int64_t nTipUpdated);
+
+    void TxReceived(const uint256& hash, int64_t nPeer, int64_t nTime);
+    void TxAccepted(const uint256& hash, int64_t nTime);
+
+    /** The times of the last nCount blocks seen, most recent first */
+    std::vector<BlockValidationTimes> GetBlocks(size_t nCount) const;
+    /** The times of the last nCount transactions received, most recent first */
+    std::vector<TxValidationTimes> GetTxs(size_t nCount) const;
+    /** The times of a transaction, false if it is not in the history */
+    bool GetTx(const uint256& hash, TxValidationTimes& times) const;
+
+private:
+    BlockValidationTimes& Block(const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    mutable Mutex cs;
+    std::map<uint256, BlockValidationTimes> mapBlocks GUARDED_BY(cs);
+    //! Hashes of mapBlocks in the order they were added, to evict the oldest
+    std::deque<uint256> vBlockOrder GUARDED_BY(cs);
+    std::map<uint256, TxValidationTimes> mapTxs GUARDED_BY(cs);
+    std::deque<uint256> vTxOrder GUARDED_BY(cs);
+};
+
+extern ValidationTimes validationTimes;
+
+#endif
@@ -4,11 +4,10 @@
 
 #include <wallet/coinselection.h>
 
+#include <crypto/common.h>
 #include <util/system.h>
 #include <util/moneystr.h>
 
-#include <boost/optional.hpp>
-
 // Descending order comparator
 struct {
     bool operator()(const OutputGroup& a, const OutputGroup& b) const
@@ -85,6 +84,22 @@ bool SelectCoinsBnB(std::vector<OutputGroup>& utxo_pool, const CAmount& target_v
     // Sort the utxo_pool
     std::sort(utxo_pool.begin(), utxo_pool.end(), descending);
 
+    // A utxo worth more than the upper bound of the range cannot be in any selection, as the
+    // effective values are positive. Drop them so that the search does not walk over them
+    // again on each backtrack to the top of the tree.
+    auto in_range = std::find_if(utxo_pool.begin(), utxo_pool.end(), [&](const OutputGroup& utxo) {
+        return utxo.effective_value <= actual_target + cost_of_change;
+    });
+    if (in_range != utxo_pool.begin()) {
+        for (auto it = utxo_pool.begin(); it != in_range; ++it) {
+            curr_available_value -= it->effective_value;
+        }
+        utxo_pool.erase(utxo_pool.begin(), in_range);
+        if (curr_available_value < actual_target) {
+            return false;
+        }
+    }
+
     CAmount curr_waste = 0;
     std::vector<bool> best_selection;
     CAmount best_waste = MAX_MONEY;
@@ -167,7 +182,13 @@ bool SelectCoinsBnB(std::vector<OutputGroup>& utxo_pool, const CAmount& target_v
     return true;
 }
 
-static void ApproximateBestSubset(const std::vector<OutputGroup>& groups, const CAmount& nTotalLower, const CAmount& nTargetValue,
+// Descending order comparator for the groups the knapsack solver works on
+static bool DescendingGroupPtr(const OutputGroup* a, const OutputGroup* b)
+{
+    return a->m_value > b->m_value;
+}
+
+static void ApproximateBestSubset(const std::vector<const OutputGroup*>& groups, const CAmount& nTotalLower, const CAmount& nTargetValue,
                                   std::vector<char>& vfBest, CAmount& nBest, int iterations = 1000)
 {
     std::vector<char> vfIncluded;
@@ -194,7 +215,7 @@ static void ApproximateBestSubset(const std::vector<OutputGroup>& groups, const
                 //the selection random.
                 if (nPass == 0 ? insecure_rand.randbool() : !vfIncluded[i])
                 {
-                    nTotal += groups[i].m_value;
+                    nTotal += groups[i]->m_value;
                     vfIncluded[i] = true;
                     if (nTotal >= nTargetValue)
                     {
@@ -204,7 +225,7 @@ static void ApproximateBestSubset(const std::vector<OutputGroup>& groups, const
                             nBest = nTotal;
                             vfBest = vfIncluded;
                         }
-                        nTotal -= groups[i].m_value;
+                        nTotal -= groups[i]->m_value;
                         vfIncluded[i] = false;
                     }
                 }
@@ -213,14 +234,62 @@ static void ApproximateBestSubset(const std::vector<OutputGroup>& groups, const
     }
 }
 
+/*
+ * Reduce the groups below the target to at most KNAPSACK_MAX_CANDIDATES for the stochastic
+ * approximation, which makes 1000 passes over the groups it is given. The groups are put in
+ * buckets by value range, the powers of two. The largest groups are taken first until they
+ * cover nTargetValue + MIN_CHANGE, or nTargetValue when all of them do not, so that a
+ * solution remains. Then the buckets give a group each in turn, so that smaller groups
+ * remain to get close to the target. groups is expected in random order, which makes the
+ * groups taken from a bucket random.
+ *
+ * Returns false when more than KNAPSACK_MAX_CANDIDATES of the largest groups are needed to
+ * cover the target. candidates then holds these groups, which are a selection on their own.
+ */
+static bool KnapsackCandidates(const std::vector<const OutputGroup*>& groups, const CAmount& nTotalLower, const CAmount& nTargetValue,
+                               std::vector<const OutputGroup*>& candidates, CAmount& nTotal)
+{
+    const CAmount nCover = nTotalLower >= nTargetValue + MIN_CHANGE ? nTargetValue + MIN_CHANGE : nTargetValue;
+    std::vector<std::vector<const OutputGroup*>> buckets(65);
+    for (const OutputGroup* group : groups) {
+        buckets[CountBits(group->m_value)].push_back(group);
+    }
+
+    candidates.clear();
+    nTotal = 0;
+    std::vector<size_t> taken(buckets.size(), 0);
+    for (size_t b = buckets.size(); b-- > 0 && nTotal < nCover; ) {
+        for (; taken[b] < buckets[b].size() && nTotal < nCover; ++taken[b]) {
+            candidates.push_back(buckets[b][taken[b]]);
+            nTotal += buckets[b][taken[b]]->m_value;
+        }
+    }
+    if (candidates.size() > KNAPSACK_MAX_CANDIDATES) {
+        return false;
+    }
+
+    bool fTaken = true;
+    while (fTaken && candidates.size() < KNAPSACK_MAX_CANDIDATES) {
+        fTaken = false;
+        for (size_t b = buckets.size(); b-- > 0 && candidates.size() < KNAPSACK_MAX_CANDIDATES; ) {
+            if (taken[b] == buckets[b].size()) continue;
+            candidates.push_back(buckets[b][taken[b]]);
+            nTotal += buckets[b][taken[b]]->m_value;
+            ++taken[b];
+            fTaken = true;
+        }
+    }
+    return true;
+}
+
 bool KnapsackSolver(const CAmount& nTargetValue, std::vector<OutputGroup>& groups, std::set<CInputCoin>& setCoinsRet, CAmount& nValueRet)
 {
     setCoinsRet.clear();
     nValueRet = 0;
 
     // List of values less than target
-    boost::optional<OutputGroup> lowest_larger;
-    std::vector<OutputGroup> applicable_groups;
+    const OutputGroup* lowest_larger = nullptr;
+    std::vector<const OutputGroup*> applicable_groups;
     CAmount nTotalLower = 0;
 
     Shuffle(groups.begin(), groups.end(), FastRandomContext());
@@ -231,17 +300,17 @@ bool KnapsackSolver(const CAmount& nTargetValue, std::vector<OutputGroup>& group
             nValueRet += group.m_value;
             return true;
         } else if (group.m_value < nTargetValue + MIN_CHANGE) {
-            applicable_groups.push_back(group);
+            applicable_groups.push_back(&group);
             nTotalLower += group.m_value;
         } else if (!lowest_larger || group.m_value < lowest_larger->m_value) {
-            lowest_larger = group;
+            lowest_larger = &group;
         }
     }
 
     if (nTotalLower == nTargetValue) {
-        for (const auto& group : applicable_groups) {
-            util::insert(setCoinsRet, group.m_outputs);
-            nValueRet += group.m_value;
+        for (const OutputGroup* group : applicable_groups) {
+            util::insert(setCoinsRet, group->m_outputs);
+            nValueRet += group->m_value;
         }
         return true;
     }
@@ -253,8 +322,27 @@ bool KnapsackSolver(const CAmount& nTargetValue, std::vector<OutputGroup>& group
         return true;
     }
 
+    // Large wallets, as after many stake splits, keep a subset of the groups below the target
+    if (applicable_groups.size() > KNAPSACK_MAX_CANDIDATES) {
+        std::vector<const OutputGroup*> candidates;
+        if (!KnapsackCandidates(applicable_groups, nTotalLower, nTargetValue, candidates, nTotalLower)) {
+            // The largest groups covering the target are the fewest inputs, unless a bigger coin does it alone
+            if (lowest_larger) {
+                util::insert(setCoinsRet, lowest_larger->m_outputs);
+                nValueRet += lowest_larger->m_value;
+            } else {
+                for (const OutputGroup* group : candidates) {
+                    util::insert(setCoinsRet, group->m_outputs);
+                    nValueRet += group->m_value;
+                }
+            }
+            return true;
+        }
+        applicable_groups.swap(candidates);
+    }
+
     // Solve subset sum by stochastic approximation
-    std::sort(applicable_groups.begin(), applicable_groups.end(), descending);
+    std::sort(applicable_groups.begin(), applicable_groups.end(), DescendingGroupPtr);
     std::vector<char> vfBest;
     CAmount nBest;
 
@@ -272,8 +360,8 @@ bool KnapsackSolver(const CAmount& nTargetValue, std::vector<OutputGroup>& group
     } else {
         for (unsigned int i = 0; i < applicable_groups.size(); i++) {
             if (vfBest[i]) {
-                util::insert(setCoinsRet, applicable_groups[i].m_outputs);
-                nValueRet += applicable_groups[i].m_value;
+                util::insert(setCoinsRet, applicable_groups[i]->m_outputs);
+                nValueRet += applicable_groups[i]->m_value;
             }
         }
 
@@ -281,7 +369,7 @@ bool KnapsackSolver(const CAmount& nTargetValue, std::vector<OutputGroup>& group
             LogPrint(BCLog::SELECTCOINS, "SelectCoins() best subset: "); /* Continued */
             for (unsigned int i = 0; i < applicable_groups.size(); i++) {
                 if (vfBest[i]) {
-                    LogPrint(BCLog::SELECTCOINS, "%s ", FormatMoney(applicable_groups[i].m_value)); /* Continued */
+                    LogPrint(BCLog::SELECTCOINS, "%s ", FormatMoney(applicable_groups[i]->m_value)); /* Continued */
                 }
             }
             LogPrint(BCLog::SELECTCOINS, "total %s\n", FormatMoney(nBest));
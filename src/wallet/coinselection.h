@@ -13,6 +13,8 @@
 static constexpr CAmount MIN_CHANGE{COIN / 100};
 //! final minimum change amount after paying for fees
 static const CAmount MIN_FINAL_CHANGE = MIN_CHANGE/2;
+//! groups below the target the knapsack solver approximates the best subset of, see KnapsackCandidates
+static const size_t KNAPSACK_MAX_CANDIDATES = 1000;
 
 class CInputCoin {
 public:
@@ -9,10 +9,12 @@
 #include <net.h>
 #include <scheduler.h>
 #include <outputtype.h>
+#include <pos.h>
 #include <util/system.h>
 #include <util/moneystr.h>
 #include <validation.h>
 #include <walletinitinterface.h>
+#include <wallet/rescan.h>
 #include <wallet/rpcwallet.h>
 #include <wallet/wallet.h>
 #include <wallet/walletutil.h>
@@ -53,6 +55,8 @@ void WalletInit::AddWalletOptions() const
     gArgs.AddArg("-paytxfee=<amt>", strprintf("Fee (in %s/kB) to add to transactions you send (default: %s)",
                                                             CURRENCY_UNIT, FormatMoney(CFeeRate{DEFAULT_PAY_TX_FEE}.GetFeePerK())), false, OptionsCategory::WALLET);
     gArgs.AddArg("-rescan", "Rescan the block chain for missing wallet transactions on startup", false, OptionsCategory::WALLET);
+    gArgs.AddArg("-rescanfilter", strprintf("Skip the blocks whose -blockfilterindex filter matches none of the scripts of the wallet during rescans, with at least one thread reading ahead. Bare multisig outputs are not found then (default: %u)", DEFAULT_RESCAN_FILTER), false, OptionsCategory::WALLET);
+    gArgs.AddArg("-rescanthreads=<n>", strprintf("Number of threads reading and testing blocks ahead of rescans (0 = off, max: %d, default: %d)", MAX_RESCAN_THREADS, DEFAULT_RESCAN_THREADS), false, OptionsCategory::WALLET);
     gArgs.AddArg("-salvagewallet", "Attempt to recover private keys from a corrupt wallet on startup", false, OptionsCategory::WALLET);
     gArgs.AddArg("-spendzeroconfchange", strprintf("Spend unconfirmed change when sending transactions (default: %u)", DEFAULT_SPEND_ZEROCONF_CHANGE), false, OptionsCategory::WALLET);
     gArgs.AddArg("-txconfirmtarget=<n>", strprintf("If paytxfee is not set, include enough fee so transactions begin confirmation on average within n blocks (default: %u)", DEFAULT_TX_CONFIRM_TARGET), false, OptionsCategory::WALLET);
@@ -68,6 +72,9 @@ void WalletInit::AddWalletOptions() const
     gArgs.AddArg("-stakecache=<true/false>", "Enables or disables the staking cache; significantly improves staking performance, but can use a lot of memory (enabled by default)", false, OptionsCategory::WALLET);
     gArgs.AddArg("-rpcmaxgasprice", strprintf("The max value (in satoshis) for gas price allowed through RPC (default: %u)", MAX_RPC_GAS_PRICE), false, OptionsCategory::WALLET);
     gArgs.AddArg("-reservebalance", strprintf("Reserved balance not used for staking (default: %u)", DEFAULT_RESERVE_BALANCE), false, OptionsCategory::WALLET);
+    gArgs.AddArg("-stakeconsolidate", strprintf("Merge the mature outputs below -consolidatetarget into outputs of that size in the background, when the fee rate is at most -consolidatemaxfee (default: %u)", DEFAULT_STAKE_CONSOLIDATE), false, OptionsCategory::WALLET);
+    gArgs.AddArg("-consolidatetarget=<amt>", strprintf("Size of the outputs -stakeconsolidate merges to (default: %s)", FormatMoney(GetStakeCombineThreshold())), false, OptionsCategory::WALLET);
+    gArgs.AddArg("-consolidatemaxfee=<amt>", strprintf("Highest fee rate (in %s/kB) -stakeconsolidate pays (default: %s)", CURRENCY_UNIT, FormatMoney(DEFAULT_CONSOLIDATE_MAX_FEE)), false, OptionsCategory::WALLET);
     gArgs.AddArg("-usechangeaddress", strprintf("Use change address (default: %u)", DEFAULT_USE_CHANGE_ADDRESS), false, OptionsCategory::WALLET);
 
     gArgs.AddArg("-dblogsize=<n>", strprintf("Flush wallet database activity from memory to disk log every <n> megabytes (default: %u)", DEFAULT_WALLET_DBLOGSIZE), true, OptionsCategory::WALLET_DEBUG_TEST);
@@ -215,6 +222,13 @@ void StartWallets(CScheduler& scheduler)
 
     // Run a thread to flush wallet periodically
     scheduler.scheduleEvery(MaybeCompactWalletDB, 500);
+
+    // Refill the keypools off the threads that use them
+    scheduler.scheduleEvery(MaybeTopUpKeyPools, KEYPOOL_TOPUP_INTERVAL);
+
+    if (gArgs.GetBoolArg("-stakeconsolidate", DEFAULT_STAKE_CONSOLIDATE)) {
+        scheduler.scheduleEvery(MaybeConsolidateStakeOutputs, CONSOLIDATE_INTERVAL);
+    }
 }
 
 void FlushWallets()
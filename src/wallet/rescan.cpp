@@ -0,0 +1,99 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <wallet/rescan.h>
+
+#include <interfaces/chain.h>
+#include <util/system.h>
+#include <wallet/wallet.h>
+
+#include <algorithm>
+
+RescanPrefetcher::RescanPrefetcher(CWallet& _wallet, int nThreads, int nStartHeight, bool fFilter) :
+    wallet(_wallet), nDepth(nThreads * RESCAN_BLOCKS_PER_THREAD), nGeneration(_wallet.GetKeyStoreGeneration()),
+    nNextRead(nStartHeight), nNextTake(nStartHeight), fStop(false)
+{
+    if (fFilter)
+        filterElements.reset(new GCSFilter::ElementSet(wallet.GetFilterElements()));
+    for (int i = 0; i < nThreads; i++)
+        threads.emplace_back(&TraceThread<std::function<void()>>, "rescan", std::function<void()>(std::bind(&RescanPrefetcher::ThreadRead, this)));
+}
+
+RescanPrefetcher::~RescanPrefetcher()
+{
+    {
+        LOCK(cs);
+        fStop = true;
+        cond.notify_all();
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+std::unique_ptr<RescanPrefetcher::Block> RescanPrefetcher::Take(int nHeight, const uint256& hash)
+{
+    LOCK(cs);
+    std::unique_ptr<Block> result;
+    auto it = mapBlocks.find(nHeight);
+    if (it != mapBlocks.end())
+        result = std::move(it->second);
+    mapBlocks.erase(mapBlocks.begin(), mapBlocks.upper_bound(nHeight));
+    // A block still being read is read by the scan instead
+    nNextTake = nHeight + 1;
+    nNextRead = std::max(nNextRead, nNextTake);
+    cond.notify_all();
+    if (!result || result->hash != hash)
+        return nullptr;
+    return result;
+}
+
+void RescanPrefetcher::ThreadRead()
+{
+    while (true) {
+        int nHeight;
+        {
+            WAIT_LOCK(cs, lock);
+            while (!fStop && nNextRead >= nNextTake + nDepth)
+                cond.wait(lock);
+            if (fStop)
+                return;
+            nHeight = nNextRead++;
+        }
+
+        std::unique_ptr<Block> result = MakeUnique<Block>();
+        Read(nHeight, *result);
+
+        LOCK(cs);
+        if (nHeight >= nNextTake)
+            mapBlocks.emplace(nHeight, std::move(result));
+    }
+}
+
+void RescanPrefetcher::Read(int nHeight, Block& result) const
+{
+    {
+        auto locked_chain = wallet.chain().lock();
+        Optional<int> tip_height = locked_chain->getHeight();
+        // Past the tip the hash stays null and the scan reads the block itself
+        if (!tip_height || *tip_height < nHeight)
+            return;
+        result.hash = locked_chain->getBlockHash(nHeight);
+    }
+
+    if (filterElements) {
+        Optional<bool> match = wallet.chain().blockFilterMatchesAny(result.hash, *filterElements);
+        if (match && !*match) {
+            result.fSkipped = true;
+            return;
+        }
+    }
+
+    if (!wallet.chain().findBlock(result.hash, &result.block) || result.block.IsNull()) {
+        result.block.SetNull();
+        return;
+    }
+    result.vOutputsMine.reserve(result.block.vtx.size());
+    for (const CTransactionRef& tx : result.block.vtx)
+        result.vOutputsMine.push_back(wallet.IsMine(*tx));
+}
@@ -0,0 +1,91 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef WALLET_RESCAN_H
+#define WALLET_RESCAN_H
+
+#include <blockfilter.h>
+#include <primitives/block.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+class CWallet;
+
+/** Default for -rescanthreads, the number of threads reading and testing blocks ahead of a rescan (0 = off) */
+static const int DEFAULT_RESCAN_THREADS = 0;
+/** Maximum for -rescanthreads */
+static const int MAX_RESCAN_THREADS = 16;
+/** Default for -rescanfilter, skip the blocks whose -blockfilterindex filter matches no script of the wallet */
+static const bool DEFAULT_RESCAN_FILTER = false;
+/** Number of blocks each thread reads ahead of the rescan */
+static const int RESCAN_BLOCKS_PER_THREAD = 8;
+
+/**
+ * Read-ahead of the blocks of ScanForWalletTransactions.
+ *
+ * A rescan reads and deserializes one block after the other and tests every transaction
+ * against the wallet under cs_wallet. The threads of the prefetcher read the next blocks
+ * and test their outputs with IsMine, which only takes the lock of the key store, so that
+ * the scan only has to look up the inputs of the transactions in the wallet, and only
+ * calls SyncTransaction on those that involve it. With a filter, blocks whose filter
+ * matches none of the scripts of the wallet are not read at all.
+ *
+ * The results are only valid for the keys and scripts the wallet had when the prefetcher
+ * was created, see CWallet::GetKeyStoreGeneration. Blocks are taken without waiting, as the
+ * scan may hold cs_main, which the threads need to read blocks: a block that is not
+ * read yet is read by the scan itself.
+ */
+class RescanPrefetcher
+{
+public:
+    struct Block
+    {
+        uint256 hash;
+        //! Whether the filter of the block matches no script of the wallet; the block is not read then
+        bool fSkipped = false;
+        //! Null if the block could not be read
+        CBlock block;
+        //! Whether a transaction of the block has an output of the wallet, by position
+        std::vector<bool> vOutputsMine;
+    };
+
+    /** Read ahead from nStartHeight, skipping blocks on their filter if fFilter is set */
+    RescanPrefetcher(CWallet& _wallet, int nThreads, int nStartHeight, bool fFilter);
+    ~RescanPrefetcher();
+
+    /** Key store generation of the wallet the blocks are tested against */
+    uint64_t GetGeneration() const { return nGeneration; }
+
+    /** The block at nHeight if it was read ahead as hash, nullptr otherwise. Blocks below nHeight are dropped. */
+    std::unique_ptr<Block> Take(int nHeight, const uint256& hash);
+
+private:
+    void ThreadRead();
+    void Read(int nHeight, Block& result) const;
+
+    CWallet& wallet;
+    const int nDepth;
+    const uint64_t nGeneration;
+    //! Scripts of the wallet, if blocks are skipped on their filter
+    std::unique_ptr<GCSFilter::ElementSet> filterElements;
+
+    Mutex cs;
+    std::condition_variable cond;
+    //! Next height to read, and height of the next block the scan takes
+    int nNextRead GUARDED_BY(cs);
+    int nNextTake GUARDED_BY(cs);
+    //! Blocks read and not yet taken, by height
+    std::map<int, std::unique_ptr<Block>> mapBlocks GUARDED_BY(cs);
+    bool fStop GUARDED_BY(cs);
+
+    std::vector<std::thread> threads;
+};
+
+#endif // WALLET_RESCAN_H
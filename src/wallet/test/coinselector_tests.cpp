@@ -574,6 +574,35 @@ BOOST_AUTO_TEST_CASE(ApproximateBestSubset)
     empty_wallet();
 }
 
+// Tests the knapsack solver over more groups below the target than KNAPSACK_MAX_CANDIDATES
+BOOST_AUTO_TEST_CASE(knapsack_large_wallet)
+{
+    CoinSet setCoinsRet;
+    CAmount nValueRet;
+    bool bnb_used;
+
+    LOCK(testWallet.cs_wallet);
+
+    // The small coin that makes an exact match is kept among the candidates
+    empty_wallet();
+    for (size_t i = 0; i < KNAPSACK_MAX_CANDIDATES + 500; i++)
+        add_coin(1 * COIN);
+    add_coin(COIN / 2);
+    BOOST_CHECK(testWallet.SelectCoinsMinConf(100 * COIN + COIN / 2, filter_standard, GroupCoins(vCoins), setCoinsRet, nValueRet, coin_selection_params, bnb_used));
+    BOOST_CHECK_EQUAL(nValueRet, 100 * COIN + COIN / 2);
+    BOOST_CHECK_EQUAL(setCoinsRet.size(), 101U);
+
+    // More than KNAPSACK_MAX_CANDIDATES coins are needed: the largest ones covering the target are selected
+    empty_wallet();
+    for (size_t i = 0; i < 3 * KNAPSACK_MAX_CANDIDATES; i++)
+        add_coin(COIN / 10);
+    BOOST_CHECK(testWallet.SelectCoinsMinConf(200 * COIN, filter_standard, GroupCoins(vCoins), setCoinsRet, nValueRet, coin_selection_params, bnb_used));
+    BOOST_CHECK_GE(nValueRet, 200 * COIN + MIN_CHANGE);
+    BOOST_CHECK_EQUAL(setCoinsRet.size(), 2001U);
+
+    empty_wallet();
+}
+
 // Tests that with the ideal conditions, the coin selector will always be able to find a solution that can pay the target value
 BOOST_AUTO_TEST_CASE(SelectCoins_test)
 {
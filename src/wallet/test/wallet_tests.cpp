@@ -12,6 +12,7 @@
 
 #include <consensus/validation.h>
 #include <interfaces/chain.h>
+#include <key_io.h>
 #include <rpc/server.h>
 #include <test/test_bitcoin.h>
 #include <validation.h>
@@ -23,6 +24,7 @@
 #include <univalue.h>
 
 #include <util/time.h>
+#include <util/convert.h>
 #include <random.h>
 
 extern UniValue importmulti(const JSONRPCRequest& request);
@@ -117,6 +119,38 @@ BOOST_FIXTURE_TEST_CASE(scan_for_wallet_transactions, TestChain100Setup)
     }
 }
 
+// The threads of the rescan need cs_main, which the scan must not hold
+BOOST_FIXTURE_TEST_CASE(scan_for_wallet_transactions_threads, TestChain100Setup)
+{
+    auto chain = interfaces::MakeChain();
+    uint256 genesis, tip;
+    {
+        LOCK(cs_main);
+        genesis = chainActive.Genesis()->GetBlockHash();
+        tip = chainActive.Tip()->GetBlockHash();
+    }
+
+    std::vector<CAmount> balances;
+    std::vector<size_t> txs;
+    for (const char* threads : {"0", "4"}) {
+        gArgs.ForceSetArg("-rescanthreads", threads);
+        CWallet wallet(*chain, WalletLocation(), WalletDatabase::CreateDummy());
+        AddKey(wallet, coinbaseKey);
+        WalletRescanReserver reserver(&wallet);
+        reserver.reserve();
+        CWallet::ScanResult result = wallet.ScanForWalletTransactions(genesis, {} /* stop_block */, reserver, false /* update */);
+        BOOST_CHECK_EQUAL(result.status, CWallet::ScanResult::SUCCESS);
+        BOOST_CHECK_EQUAL(result.last_scanned_block, tip);
+        balances.push_back(wallet.GetImmatureBalance() + wallet.GetBalance());
+        LOCK(wallet.cs_wallet);
+        txs.push_back(wallet.mapWallet.size());
+    }
+    gArgs.ForceSetArg("-rescanthreads", "0");
+    BOOST_CHECK(balances[0] > 0);
+    BOOST_CHECK_EQUAL(balances[0], balances[1]);
+    BOOST_CHECK_EQUAL(txs[0], txs[1]);
+}
+
 BOOST_FIXTURE_TEST_CASE(importmulti_rescan, TestChain100Setup)
 {
     auto chain = interfaces::MakeChain();
@@ -266,6 +300,26 @@ BOOST_FIXTURE_TEST_CASE(coin_mark_dirty_immature_credit, TestChain100Setup)
     BOOST_CHECK_EQUAL(wtx.GetImmatureCredit(*locked_chain), 20000*COIN);
 }
 
+BOOST_FIXTURE_TEST_CASE(cached_balances, TestChain100Setup)
+{
+    auto chain = interfaces::MakeChain();
+    CWallet wallet(*chain, WalletLocation(), WalletDatabase::CreateDummy());
+    AddKey(wallet, coinbaseKey);
+    BOOST_CHECK_EQUAL(wallet.GetImmatureBalance(), 0);
+    BOOST_CHECK_EQUAL(wallet.GetBalance(), 0);
+
+    // The totals cached above are stale once the wallet has the coinbase
+    CWalletTx wtx(&wallet, m_coinbase_txns.back());
+    {
+        LOCK(cs_main);
+        wtx.SetMerkleBranch(chainActive.Tip()->GetBlockHash(), 0);
+        wallet.AddToWallet(wtx);
+    }
+    BOOST_CHECK_EQUAL(wallet.GetImmatureBalance(), 20000 * COIN);
+    BOOST_CHECK_EQUAL(wallet.GetImmatureBalance(), 20000 * COIN);
+    BOOST_CHECK_EQUAL(wallet.GetBalance(), 0);
+}
+
 static int64_t AddTx(CWallet& wallet, uint32_t lockTime, int64_t mockTime, int64_t blockTime)
 {
     CMutableTransaction tx;
@@ -275,7 +329,7 @@ static int64_t AddTx(CWallet& wallet, uint32_t lockTime, int64_t mockTime, int64
     if (blockTime > 0) {
         LockAnnotation lock(::cs_main);
         auto locked_chain = wallet.chain().lock();
-        auto inserted = mapBlockIndex.emplace(GetRandHash(), new CBlockIndex);
+        auto inserted = mapBlockIndex.emplace(GetRandHash(), NewBlockIndex());
         assert(inserted.second);
         const uint256& hash = inserted.first->first;
         block = inserted.first->second;
@@ -451,6 +505,346 @@ BOOST_FIXTURE_TEST_CASE(ListCoins, ListCoinsTestingSetup)
     BOOST_CHECK_EQUAL(list.begin()->second.size(), 2U);
 }
 
+// The outputs of the wallet are indexed on the keys of the wallet: an output of a wallet tx
+// paying to a key added later must become available with the key.
+BOOST_FIXTURE_TEST_CASE(AvailableCoinsKeyAdded, ListCoinsTestingSetup)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    AddTx(CRecipient{GetScriptForDestination(key.GetPubKey().GetID()), 1 * COIN, false /* subtract fee */});
+
+    std::vector<COutput> available;
+    {
+        LOCK2(cs_main, wallet->cs_wallet);
+        wallet->AvailableCoins(*m_locked_chain, available);
+    }
+    const size_t nAvailable = available.size();
+
+    AddKey(*wallet, key);
+    {
+        LOCK2(cs_main, wallet->cs_wallet);
+        wallet->AvailableCoins(*m_locked_chain, available);
+    }
+    BOOST_CHECK_EQUAL(available.size(), nAvailable + 1);
+}
+
+// The staking coins come from the index of the wallet's outputs: they must be those a scan of
+// every output of mapWallet selects, as spends and locks change.
+static std::set<COutPoint> StakingCoins(CWallet& wallet, interfaces::Chain::Lock& locked_chain, bool fScan)
+{
+    LOCK2(cs_main, wallet.cs_wallet);
+    std::set<COutPoint> coins;
+    if (!fScan) {
+        std::vector<COutput> available;
+        wallet.AvailableCoinsForStaking(locked_chain, available);
+        for (const COutput& output : available)
+            coins.emplace(output.tx->GetHash(), output.i);
+        return coins;
+    }
+    for (const auto& entry : wallet.mapWallet) {
+        const CWalletTx& wtx = entry.second;
+        if (wtx.GetDepthInMainChain(locked_chain) < COINBASE_MATURITY || wtx.GetBlocksToMaturity(locked_chain) > 0)
+            continue;
+        for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
+            const CTxOut& txout = wtx.tx->vout[i];
+            if (txout.nValue > 0 && !txout.scriptPubKey.HasOpCall() && !txout.scriptPubKey.HasOpCreate() &&
+                wallet.IsMine(txout) != ISMINE_NO && !wallet.IsSpent(locked_chain, entry.first, i) && !wallet.IsLockedCoin(entry.first, i))
+                coins.emplace(entry.first, i);
+        }
+    }
+    return coins;
+}
+
+BOOST_FIXTURE_TEST_CASE(AvailableCoinsForStakingIndexed, ListCoinsTestingSetup)
+{
+    std::set<COutPoint> coins = StakingCoins(*wallet, *m_locked_chain, false);
+    BOOST_CHECK(!coins.empty());
+    BOOST_CHECK(coins == StakingCoins(*wallet, *m_locked_chain, true));
+
+    // Locked coins do not stake until they are unlocked
+    {
+        LOCK(wallet->cs_wallet);
+        wallet->LockCoin(*coins.begin());
+    }
+    BOOST_CHECK(StakingCoins(*wallet, *m_locked_chain, false).count(*coins.begin()) == 0);
+    BOOST_CHECK(StakingCoins(*wallet, *m_locked_chain, false) == StakingCoins(*wallet, *m_locked_chain, true));
+    {
+        LOCK(wallet->cs_wallet);
+        wallet->UnlockCoin(*coins.begin());
+    }
+    BOOST_CHECK(StakingCoins(*wallet, *m_locked_chain, false) == coins);
+
+    // Spent coins are dropped, the new outputs are not mature yet
+    AddTx(CRecipient{GetScriptForRawPubKey({}), 1 * COIN, false /* subtract fee */});
+    std::set<COutPoint> spent = StakingCoins(*wallet, *m_locked_chain, false);
+    BOOST_CHECK(spent.size() < coins.size());
+    BOOST_CHECK(spent == StakingCoins(*wallet, *m_locked_chain, true));
+}
+
+static uint64_t StakeWeight(CWallet& wallet, interfaces::Chain::Lock& locked_chain)
+{
+    LOCK2(cs_main, wallet.cs_wallet);
+    return wallet.GetStakeWeight(locked_chain);
+}
+
+// The stake weight is kept between polls, but every change to the coins it selects is seen
+BOOST_FIXTURE_TEST_CASE(StakeWeightCache, ListCoinsTestingSetup)
+{
+    std::set<COutPoint> coins = StakingCoins(*wallet, *m_locked_chain, false);
+    uint64_t nWeight = StakeWeight(*wallet, *m_locked_chain);
+    BOOST_CHECK(nWeight > 0);
+    BOOST_CHECK_EQUAL(StakeWeight(*wallet, *m_locked_chain), nWeight);
+
+    {
+        LOCK(wallet->cs_wallet);
+        for (const COutPoint& coin : coins)
+            wallet->LockCoin(coin);
+    }
+    BOOST_CHECK_EQUAL(StakeWeight(*wallet, *m_locked_chain), 0U);
+    {
+        LOCK(wallet->cs_wallet);
+        wallet->UnlockAllCoins();
+    }
+    BOOST_CHECK_EQUAL(StakeWeight(*wallet, *m_locked_chain), nWeight);
+
+    // All of the balance held in reserve
+    CAmount nReserveBalance = wallet->m_reserve_balance;
+    wallet->m_reserve_balance = wallet->GetBalance();
+    BOOST_CHECK_EQUAL(StakeWeight(*wallet, *m_locked_chain), 0U);
+    wallet->m_reserve_balance = nReserveBalance;
+    BOOST_CHECK_EQUAL(StakeWeight(*wallet, *m_locked_chain), nWeight);
+
+    // Spending the coins leaves only immature outputs
+    AddTx(CRecipient{GetScriptForRawPubKey({}), 1 * COIN, false /* subtract fee */});
+    BOOST_CHECK(StakeWeight(*wallet, *m_locked_chain) < nWeight);
+}
+
+static std::shared_ptr<const CStakeSnapshot> GetSnapshot(CWallet& wallet, interfaces::Chain::Lock& locked_chain)
+{
+    LOCK(cs_main);
+    return wallet.GetStakeSnapshot(locked_chain);
+}
+
+// The staker reuses its snapshot on the same tip and wallet, and gets a new one once either changed
+BOOST_FIXTURE_TEST_CASE(StakeSnapshot, ListCoinsTestingSetup)
+{
+    std::shared_ptr<const CStakeSnapshot> snapshot = GetSnapshot(*wallet, *m_locked_chain);
+    std::set<COutPoint> coins;
+    for (const auto& coin : snapshot->setCoins)
+        coins.emplace(coin.first->GetHash(), coin.second);
+    BOOST_CHECK(!coins.empty());
+    BOOST_CHECK(coins == StakingCoins(*wallet, *m_locked_chain, false));
+    BOOST_CHECK_EQUAL(snapshot->candidates.size(), snapshot->setCoins.size());
+    BOOST_CHECK(snapshot->fCandidatesComplete);
+    BOOST_CHECK(snapshot->hashTip == chainActive.Tip()->GetBlockHash());
+    BOOST_CHECK(GetSnapshot(*wallet, *m_locked_chain) == snapshot);
+
+    // Locked coins
+    {
+        LOCK(wallet->cs_wallet);
+        wallet->LockCoin(*coins.begin());
+    }
+    std::shared_ptr<const CStakeSnapshot> locked = GetSnapshot(*wallet, *m_locked_chain);
+    BOOST_CHECK(locked != snapshot);
+    BOOST_CHECK_EQUAL(locked->setCoins.size(), snapshot->setCoins.size() - 1);
+    {
+        LOCK(wallet->cs_wallet);
+        wallet->UnlockAllCoins();
+    }
+    snapshot = GetSnapshot(*wallet, *m_locked_chain);
+    BOOST_CHECK_EQUAL(snapshot->setCoins.size(), coins.size());
+    // The old snapshot is left as it was for whoever still holds it
+    BOOST_CHECK_EQUAL(locked->setCoins.size(), coins.size() - 1);
+
+    // Reserve balance
+    CAmount nReserveBalance = wallet->m_reserve_balance;
+    wallet->m_reserve_balance = wallet->GetBalance();
+    BOOST_CHECK(GetSnapshot(*wallet, *m_locked_chain)->setCoins.empty());
+    wallet->m_reserve_balance = nReserveBalance;
+    snapshot = GetSnapshot(*wallet, *m_locked_chain);
+    BOOST_CHECK_EQUAL(snapshot->setCoins.size(), coins.size());
+
+    // New key
+    {
+        LOCK(wallet->cs_wallet);
+        CKey key;
+        key.MakeNewKey(true);
+        BOOST_CHECK(wallet->AddKeyPubKey(key, key.GetPubKey()));
+    }
+    std::shared_ptr<const CStakeSnapshot> rekeyed = GetSnapshot(*wallet, *m_locked_chain);
+    BOOST_CHECK(rekeyed != snapshot);
+    BOOST_CHECK(GetSnapshot(*wallet, *m_locked_chain) == rekeyed);
+
+    // New tip
+    CreateAndProcessBlock({}, GetScriptForRawPubKey(coinbaseKey.GetPubKey()));
+    snapshot = GetSnapshot(*wallet, *m_locked_chain);
+    BOOST_CHECK(snapshot != rekeyed);
+    BOOST_CHECK(snapshot->hashTip == chainActive.Tip()->GetBlockHash());
+    BOOST_CHECK(rekeyed->hashTip == chainActive.Tip()->pprev->GetBlockHash());
+}
+
+BOOST_FIXTURE_TEST_CASE(ConsolidateStakeOutputs, ListCoinsTestingSetup)
+{
+    // Deepen the chain so that a dozen of the first coinbases are COINBASE_MATURITY deep
+    for (int i = 0; i < 12; i++)
+        CreateAndProcessBlock({}, GetScriptForRawPubKey(coinbaseKey.GetPubKey()));
+    wallet->SetBroadcastTransactions(true);
+    const CAmount nCoinbase = m_coinbase_txns[0]->vout[0].nValue;
+    std::string strFailReason;
+
+    // Off unless there is a target
+    BOOST_CHECK(!wallet->ConsolidateStakeOutputs(strFailReason));
+    BOOST_CHECK(strFailReason.empty());
+
+    // Not while the fee rate is above the maximum
+    wallet->m_consolidate_target = 100 * nCoinbase;
+    wallet->m_consolidate_max_fee = CFeeRate(0);
+    BOOST_CHECK(!wallet->ConsolidateStakeOutputs(strFailReason));
+    BOOST_CHECK(strFailReason.find("-consolidatemaxfee") != std::string::npos);
+
+    // The deep outputs below the target are merged into one paying the script of the largest
+    strFailReason.clear();
+    wallet->m_consolidate_max_fee = CFeeRate(COIN);
+    BOOST_CHECK(wallet->ConsolidateStakeOutputs(strFailReason));
+    BOOST_CHECK_EQUAL(mempool.size(), 1U);
+    std::set<uint256> coinbases;
+    for (const CTransactionRef& tx : m_coinbase_txns)
+        coinbases.insert(tx->GetHash());
+    {
+        LOCK(mempool.cs);
+        const CTransaction& tx = mempool.mapTx.begin()->GetTx();
+        BOOST_CHECK(tx.vin.size() >= CONSOLIDATE_MIN_INPUTS);
+        BOOST_REQUIRE_EQUAL(tx.vout.size(), 1U);
+        BOOST_CHECK(tx.vout[0].scriptPubKey == m_coinbase_txns[0]->vout[0].scriptPubKey);
+        BOOST_CHECK(tx.vout[0].nValue < (CAmount)tx.vin.size() * nCoinbase);
+        BOOST_CHECK(tx.vout[0].nValue > (CAmount)tx.vin.size() * nCoinbase - COIN);
+        for (const CTxIn& txin : tx.vin)
+            BOOST_CHECK(coinbases.count(txin.prevout.hash));
+    }
+
+    // The merged outputs are spent, so there are too few left to merge
+    strFailReason.clear();
+    BOOST_CHECK(!wallet->ConsolidateStakeOutputs(strFailReason));
+    BOOST_CHECK(strFailReason.empty());
+    BOOST_CHECK_EQUAL(mempool.size(), 1U);
+}
+
+// A token balance read with balanceOf is carried forward with the transfers of the blocks
+// after it, and forgotten when its block is no longer on the chain.
+BOOST_AUTO_TEST_CASE(TokenLedgerBalance)
+{
+    std::vector<uint256> hashes(4);
+    std::vector<CBlockIndex> blocks(4);
+    for (size_t i = 0; i < blocks.size(); i++) {
+        hashes[i] = InsecureRand256();
+        blocks[i].nHeight = i;
+        blocks[i].phashBlock = &hashes[i];
+        blocks[i].pprev = i > 0 ? &blocks[i - 1] : nullptr;
+        blocks[i].BuildSkip();
+    }
+
+    CTokenInfo token;
+    token.strContractAddress = "contract";
+    token.strSenderAddress = "mine";
+    uint256 hash = InsecureRand256();
+
+    CTokenLedger ledger;
+    ledger.AddToken(hash, token);
+    BOOST_CHECK(ledger.FindToken("contract", "mine") == hash);
+    BOOST_CHECK(ledger.FindToken("contract", "other").IsNull());
+
+    CTokenLedger::TokenAddress key("contract", "mine");
+    uint256 balance;
+    BOOST_CHECK(!ledger.GetBalance(key, &blocks[1], balance));
+    ledger.SetBalance(key, u256Touint(100), &blocks[1]);
+    BOOST_CHECK(ledger.GetBalance(key, &blocks[1], balance));
+    BOOST_CHECK(balance == u256Touint(100));
+
+    // Transfers of the blocks up to the balance are already in it
+    CTokenTx tokenTx;
+    tokenTx.strContractAddress = "contract";
+    tokenTx.strSenderAddress = "mine";
+    tokenTx.strReceiverAddress = "other";
+    tokenTx.nValue = u256Touint(30);
+    tokenTx.blockNumber = 1;
+    ledger.ApplyTransfer(tokenTx);
+    tokenTx.blockNumber = 3;
+    ledger.ApplyTransfer(tokenTx);
+    BOOST_CHECK(!ledger.GetBalance(key, &blocks[3], balance));
+    ledger.SetScanned(key, 1, &blocks[3]);
+    BOOST_CHECK(ledger.GetBalance(key, &blocks[3], balance));
+    BOOST_CHECK(balance == u256Touint(70));
+
+    // The block of the balance was reorganized away
+    uint256 hashFork = InsecureRand256();
+    CBlockIndex fork;
+    fork.nHeight = 3;
+    fork.phashBlock = &hashFork;
+    fork.pprev = &blocks[2];
+    fork.BuildSkip();
+    BOOST_CHECK(!ledger.GetBalance(key, &fork, balance));
+    ledger.SetScanned(key, 3, &fork);
+    BOOST_CHECK(!ledger.GetBalance(key, &blocks[3], balance));
+
+    ledger.RemoveToken(hash, token);
+    BOOST_CHECK(ledger.FindToken("contract", "mine").IsNull());
+}
+
+// The Transfer logs of a connected block are added as token txs when they involve a token
+// entry of the wallet, merged per transaction and addresses as the token tx worker does.
+BOOST_AUTO_TEST_CASE(TokenTransfersConnected)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    const uint160 mine = key.GetPubKey().GetID();
+    const uint160 contract = uint160S("0102030405060708090a0b0c0d0e0f1011121314");
+    const uint160 other = uint160S("1111111111111111111111111111111111111111");
+
+    CTokenInfo token;
+    token.strContractAddress = HexStr(contract.begin(), contract.end());
+    token.strSenderAddress = EncodeDestination(CKeyID(mine));
+    LOCK2(cs_main, m_wallet.cs_wallet);
+    m_wallet.LoadToken(token);
+
+    const uint256 hashTx = InsecureRand256();
+    std::vector<TokenTransferLog> transfers;
+    transfers.push_back(TokenTransferLog{hashTx, contract, other, mine, u256Touint(2)});
+    transfers.push_back(TokenTransferLog{hashTx, contract, other, mine, u256Touint(3)});
+    transfers.push_back(TokenTransferLog{hashTx, contract, other, other, u256Touint(5)});
+    m_wallet.TokenTransfersConnected(chainActive.Tip(), transfers);
+
+    BOOST_CHECK_EQUAL(m_wallet.mapTokenTx.size(), 1U);
+    const CTokenTx& tokenTx = m_wallet.mapTokenTx.begin()->second;
+    BOOST_CHECK(tokenTx.nValue == u256Touint(5));
+    BOOST_CHECK(tokenTx.transactionHash == hashTx);
+    BOOST_CHECK(m_wallet.IsTokenTxMine(tokenTx));
+}
+
+// The writes of a WalletBatchScope are kept in memory and written when the outermost
+// scope closes.
+BOOST_AUTO_TEST_CASE(WalletBatchScopeDefersWrites)
+{
+    CTokenTx tokenTx;
+    tokenTx.strContractAddress = "contract";
+    tokenTx.transactionHash = InsecureRand256();
+
+    LOCK2(cs_main, m_wallet.cs_wallet);
+    WalletDatabase& database = m_wallet.GetDBHandle();
+    const unsigned int nUpdates = database.nUpdateCounter;
+    {
+        WalletBatchScope batch_scope(m_wallet);
+        BOOST_CHECK(m_wallet.AddTokenTxEntry(tokenTx, false));
+        {
+            WalletBatchScope nested_scope(m_wallet);
+            tokenTx.nValue = u256Touint(1);
+            BOOST_CHECK(m_wallet.AddTokenTxEntry(tokenTx, false));
+        }
+        BOOST_CHECK_EQUAL(database.nUpdateCounter, nUpdates);
+        BOOST_CHECK_EQUAL(m_wallet.mapTokenTx.size(), 2U);
+    }
+    BOOST_CHECK_EQUAL(database.nUpdateCounter, nUpdates + 1);
+}
+
 BOOST_FIXTURE_TEST_CASE(wallet_disableprivkeys, TestChain100Setup)
 {
     auto chain = interfaces::MakeChain();
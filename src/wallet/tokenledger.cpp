@@ -0,0 +1,107 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <wallet/tokenledger.h>
+
+#include <chain.h>
+#include <util/convert.h>
+#include <wallet/wallet.h>
+
+void CTokenLedger::AddToken(const uint256& hash, const CTokenInfo& token)
+{
+    const TokenAddress key(token.strContractAddress, token.strSenderAddress);
+    auto range = mapTokens.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == hash)
+            return;
+    }
+    mapTokens.emplace(key, hash);
+}
+
+void CTokenLedger::RemoveToken(const uint256& hash, const CTokenInfo& token)
+{
+    const TokenAddress key(token.strContractAddress, token.strSenderAddress);
+    auto range = mapTokens.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == hash) {
+            mapTokens.erase(it);
+            break;
+        }
+    }
+    if (!mapTokens.count(key))
+        mapBalances.erase(key);
+}
+
+uint256 CTokenLedger::FindToken(const std::string& contract, const std::string& address) const
+{
+    auto it = mapTokens.find(TokenAddress(contract, address));
+    return it != mapTokens.end() ? it->second : uint256();
+}
+
+bool CTokenLedger::OnChain(const Balance& balance, const CBlockIndex* pindex)
+{
+    if (!pindex || balance.nHeight > pindex->nHeight)
+        return false;
+    const CBlockIndex* pindexBalance = pindex->GetAncestor(balance.nHeight);
+    return pindexBalance && pindexBalance->GetBlockHash() == balance.hashBlock;
+}
+
+bool CTokenLedger::GetBalance(const TokenAddress& key, const CBlockIndex* pindexTip, uint256& balance) const
+{
+    auto it = mapBalances.find(key);
+    if (it == mapBalances.end() || !pindexTip)
+        return false;
+    const Balance& entry = it->second;
+    if (entry.nHeight != pindexTip->nHeight || entry.hashBlock != pindexTip->GetBlockHash())
+        return false;
+    if (entry.nHeight - entry.nReadHeight >= TOKEN_BALANCE_REFRESH_BLOCKS)
+        return false;
+    balance = entry.nValue;
+    return true;
+}
+
+void CTokenLedger::SetBalance(const TokenAddress& key, const uint256& balance, const CBlockIndex* pindex)
+{
+    if (!pindex || !mapTokens.count(key))
+        return;
+    Balance& entry = mapBalances[key];
+    entry.nValue = balance;
+    entry.nHeight = pindex->nHeight;
+    entry.hashBlock = pindex->GetBlockHash();
+    entry.nReadHeight = pindex->nHeight;
+}
+
+void CTokenLedger::SetScanned(const TokenAddress& key, int64_t nFromBlock, const CBlockIndex* pindexTo)
+{
+    auto it = mapBalances.find(key);
+    if (it == mapBalances.end())
+        return;
+    Balance& entry = it->second;
+    // The transfers of blocks that were disconnected are in the balance, or some were missed
+    if (!OnChain(entry, pindexTo) || nFromBlock > entry.nHeight + 1) {
+        mapBalances.erase(it);
+        return;
+    }
+    entry.nHeight = pindexTo->nHeight;
+    entry.hashBlock = pindexTo->GetBlockHash();
+}
+
+void CTokenLedger::ApplyTransfer(const CTokenTx& tokenTx)
+{
+    const dev::u256 value = uintTou256(tokenTx.nValue);
+    auto apply = [&](const std::string& address, bool fCredit) {
+        auto it = mapBalances.find(TokenAddress(tokenTx.strContractAddress, address));
+        // Transfers of blocks up to the balance are already in it
+        if (it == mapBalances.end() || tokenTx.blockNumber <= it->second.nHeight)
+            return;
+        const dev::u256 balance = uintTou256(it->second.nValue);
+        if (fCredit ? balance + value < balance : balance < value) {
+            mapBalances.erase(it);
+            return;
+        }
+        it->second.nValue = u256Touint(fCredit ? balance + value : balance - value);
+    };
+    apply(tokenTx.strSenderAddress, false);
+    apply(tokenTx.strReceiverAddress, true);
+}
@@ -0,0 +1,70 @@
+// Copyright (c) 2026 The KPG Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef WALLET_TOKENLEDGER_H
+#define WALLET_TOKENLEDGER_H
+
+#include <uint256.h>
+
+#include <map>
+#include <string>
+#include <utility>
+
+class CBlockIndex;
+class CTokenInfo;
+class CTokenTx;
+
+/** Blocks a balance is carried forward from the transfer events before balanceOf is called again */
+static const int64_t TOKEN_BALANCE_REFRESH_BLOCKS = 500;
+
+/**
+ * Tokens of the wallet and their balances, by contract and address.
+ *
+ * The balance of an address is read once with balanceOf, then carried forward with the
+ * Transfer events of the blocks after it, so that the balances of the tokens of a wallet
+ * are refreshed without calling each contract on every block. A balance is forgotten on
+ * a reorg of its block, when an event other than Transfer of the address is seen, or
+ * when a transfer does not add up; it is read again with balanceOf then, and every
+ * TOKEN_BALANCE_REFRESH_BLOCKS for the tokens that change balances without events.
+ */
+class CTokenLedger
+{
+public:
+    //! Contract and address of a token entry of the wallet
+    typedef std::pair<std::string, std::string> TokenAddress;
+
+    void AddToken(const uint256& hash, const CTokenInfo& token);
+    void RemoveToken(const uint256& hash, const CTokenInfo& token);
+    /** Hash of a token entry of address for contract, null if the wallet has none */
+    uint256 FindToken(const std::string& contract, const std::string& address) const;
+
+    /** Balance of the token entry at pindexTip, if it is known */
+    bool GetBalance(const TokenAddress& key, const CBlockIndex* pindexTip, uint256& balance) const;
+    /** Balance read with balanceOf at pindex */
+    void SetBalance(const TokenAddress& key, const uint256& balance, const CBlockIndex* pindex);
+    /** The events of the token entry were read from nFromBlock to pindexTo */
+    void SetScanned(const TokenAddress& key, int64_t nFromBlock, const CBlockIndex* pindexTo);
+    /** Carry the balances of the sender and receiver of a new token tx forward */
+    void ApplyTransfer(const CTokenTx& tokenTx);
+    void ForgetBalance(const TokenAddress& key) { mapBalances.erase(key); }
+
+private:
+    struct Balance
+    {
+        uint256 nValue;
+        //! Block up to which the events are accounted for
+        int64_t nHeight;
+        uint256 hashBlock;
+        //! Height of the last balanceOf call
+        int64_t nReadHeight;
+    };
+
+    //! Whether the block of balance is still an ancestor of pindex
+    static bool OnChain(const Balance& balance, const CBlockIndex* pindex);
+
+    std::multimap<TokenAddress, uint256> mapTokens;
+    std::map<TokenAddress, Balance> mapBalances;
+};
+
+#endif // WALLET_TOKENLEDGER_H
@@ -32,6 +32,7 @@
 #include <util/convert.h>
 #include <txdb.h>
 #include <wallet/fees.h>
+#include <wallet/rescan.h>
 #include <pos.h>
 #include <miner.h>
 #include <pos.h>
@@ -306,6 +307,7 @@ bool CWallet::AddKeyPubKeyWithDB(WalletBatch &batch, const CKey& secret, const C
         return false;
     }
     if (needsDB) encrypted_batch = nullptr;
+    ++m_keystore_generation;
 
     // check if we need to remove from watch-only
     CScript script;
@@ -338,6 +340,7 @@ bool CWallet::AddCryptedKey(const CPubKey &vchPubKey,
 {
     if (!CCryptoKeyStore::AddCryptedKey(vchPubKey, vchCryptedSecret))
         return false;
+    ++m_keystore_generation;
     {
         LOCK(cs_wallet);
         if (encrypted_batch)
@@ -438,6 +441,7 @@ bool CWallet::AddCScript(const CScript& redeemScript)
 {
     if (!CCryptoKeyStore::AddCScript(redeemScript))
         return false;
+    ++m_keystore_generation;
     if (WalletBatch(*database).WriteCScript(Hash160(redeemScript), redeemScript)) {
         UnsetWalletFlag(WALLET_FLAG_BLANK_WALLET);
         return true;
@@ -464,6 +468,7 @@ bool CWallet::AddWatchOnly(const CScript& dest)
 {
     if (!CCryptoKeyStore::AddWatchOnly(dest))
         return false;
+    ++m_keystore_generation;
     const CKeyMetadata& meta = m_script_metadata[CScriptID(dest)];
     UpdateTimeFirstKey(meta.nCreateTime);
     NotifyWatchonlyChanged(true);
@@ -498,6 +503,42 @@ bool CWallet::LoadWatchOnly(const CScript &dest)
     return CCryptoKeyStore::AddWatchOnly(dest);
 }
 
+GCSFilter::ElementSet CWallet::GetFilterElements() const
+{
+    GCSFilter::ElementSet elements;
+    auto add = [&elements](const CScript& script) { elements.emplace(script.begin(), script.end()); };
+    auto add_pubkey = [&add](const CPubKey& pubkey) {
+        add(GetScriptForRawPubKey(pubkey));
+        add(GetScriptForDestination(pubkey.GetID()));
+        if (pubkey.IsCompressed()) {
+            CScript witness = GetScriptForDestination(WitnessV0KeyHash(pubkey.GetID()));
+            add(witness);
+            add(GetScriptForDestination(CScriptID(witness)));
+        }
+    };
+
+    LOCK(cs_KeyStore);
+    for (const CKeyID& keyid : GetKeys()) {
+        CPubKey pubkey;
+        if (GetPubKey(keyid, pubkey)) {
+            add_pubkey(pubkey);
+        }
+    }
+    for (const auto& entry : mapWatchKeys) {
+        add_pubkey(entry.second);
+    }
+    for (const CScript& script : setWatchOnly) {
+        add(script);
+    }
+    // Redeem and witness scripts, also at the top level for P2PK and multisig
+    for (const auto& entry : mapScripts) {
+        add(entry.second);
+        add(GetScriptForDestination(CScriptID(entry.second)));
+        add(GetScriptForDestination(WitnessV0ScriptHash(entry.second)));
+    }
+    return elements;
+}
+
 bool CWallet::Unlock(const SecureString& strWalletPassphrase, bool accept_no_keys)
 {
     CCrypter crypter;
@@ -571,6 +612,14 @@ void CWallet::ChainStateFlushed(const CBlockLocator& loc)
 {
     WalletBatch batch(*database);
     batch.WriteBestBlock(loc);
+
+    // Keep the blocks the token entries were followed up to, so that the token tx worker
+    // only searches the logs of the blocks after them on startup
+    LOCK(cs_wallet);
+    for(const auto& item : mapToken)
+    {
+        batch.WriteToken(item.second);
+    }
 }
 
 void CWallet::SetMinVersion(enum WalletFeature nVersion, WalletBatch* batch_in, bool fExplicit)
@@ -920,6 +969,8 @@ int64_t CWallet::IncOrderPosNext(WalletBatch *batch)
     int64_t nRet = nOrderPosNext++;
     if (batch) {
         batch->WriteOrderPosNext(nOrderPosNext);
+    } else if (m_deferred_batch) {
+        m_deferred_batch->WriteOrderPosNext(nOrderPosNext);
     } else {
         WalletBatch(*database).WriteOrderPosNext(nOrderPosNext);
     }
@@ -932,6 +983,7 @@ void CWallet::MarkDirty()
         LOCK(cs_wallet);
         for (std::pair<const uint256, CWalletTx>& item : mapWallet)
             item.second.MarkDirty();
+        ++nStakingChanges;
     }
 }
 
@@ -964,11 +1016,46 @@ bool CWallet::MarkReplaced(const uint256& originalHash, const uint256& newHash)
     return success;
 }
 
+WalletBatch& CWallet::GetWriteBatch(std::unique_ptr<WalletBatch>& batch_own, bool fFlushOnClose)
+{
+    AssertLockHeld(cs_wallet);
+    if (m_deferred_batch) {
+        return *m_deferred_batch;
+    }
+    batch_own.reset(new WalletBatch(*database, "r+", fFlushOnClose));
+    return *batch_own;
+}
+
+WalletBatchScope::WalletBatchScope(CWallet& wallet) : m_wallet(wallet)
+{
+    AssertLockHeld(m_wallet.cs_wallet);
+    if (m_wallet.m_deferred_batch) {
+        return;
+    }
+    // Flushed once when the scope closes instead of on the close of each batch
+    m_batch.reset(new WalletBatch(*m_wallet.database, "r+", true));
+    m_batch->DeferWrites();
+    m_wallet.m_deferred_batch = m_batch.get();
+}
+
+WalletBatchScope::~WalletBatchScope()
+{
+    if (!m_batch) {
+        return;
+    }
+    AssertLockHeld(m_wallet.cs_wallet);
+    m_wallet.m_deferred_batch = nullptr;
+    if (!m_batch->WriteDeferred()) {
+        m_wallet.WalletLogPrintf("%s: Writing the deferred wallet updates failed\n", __func__);
+    }
+}
+
 bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
 {
     LOCK(cs_wallet);
 
-    WalletBatch batch(*database, "r+", fFlushOnClose);
+    std::unique_ptr<WalletBatch> batch_own;
+    WalletBatch& batch = GetWriteBatch(batch_own, fFlushOnClose);
 
     uint256 hash = wtxIn.GetHash();
 
@@ -1025,6 +1112,10 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
         }
     }
 
+    // Keys may have been added since the transaction was first seen
+    AddWalletOutputs(wtx);
+    ++nStakingChanges;
+
     //// debug print
     WalletLogPrintf("AddToWallet %s  %s%s\n", wtxIn.GetHash().ToString(), (fInsertedNew ? "new" : ""), (fUpdated ? "update" : ""));
 
@@ -1052,6 +1143,51 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
     return true;
 }
 
+void CWallet::AddWalletOutputs(const CWalletTx& wtx) const
+{
+    const uint256& hash = wtx.GetHash();
+    for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
+        if (IsMine(wtx.tx->vout[i]) != ISMINE_NO)
+            setWalletOutputs.insert(COutPoint(hash, i));
+        else
+            setWalletOutputs.erase(COutPoint(hash, i));
+    }
+}
+
+void CWallet::RemoveWalletOutputs(const uint256& hash)
+{
+    auto it = setWalletOutputs.lower_bound(COutPoint(hash, 0));
+    while (it != setWalletOutputs.end() && it->hash == hash)
+        it = setWalletOutputs.erase(it);
+}
+
+void CWallet::PruneWalletOutputs(interfaces::Chain::Lock& locked_chain)
+{
+    for (auto it = setWalletOutputs.begin(); it != setWalletOutputs.end();) {
+        bool fPrune = !mapWallet.count(it->hash);
+        auto range = mapTxSpends.equal_range(*it);
+        for (TxSpends::const_iterator spend = range.first; spend != range.second && !fPrune; ++spend) {
+            auto mit = mapWallet.find(spend->second);
+            fPrune = mit != mapWallet.end() && mit->second.GetDepthInMainChain(locked_chain) >= COINBASE_MATURITY;
+        }
+        if (fPrune)
+            it = setWalletOutputs.erase(it);
+        else
+            ++it;
+    }
+}
+
+const std::set<COutPoint>& CWallet::GetWalletOutputs() const
+{
+    AssertLockHeld(cs_wallet);
+    if (nWalletOutputsGeneration != m_keystore_generation) {
+        nWalletOutputsGeneration = m_keystore_generation;
+        for (const auto& entry : mapWallet)
+            AddWalletOutputs(entry.second);
+    }
+    return setWalletOutputs;
+}
+
 void CWallet::LoadToWallet(const CWalletTx& wtxIn)
 {
     uint256 hash = wtxIn.GetHash();
@@ -1152,6 +1288,7 @@ bool CWallet::AbandonTransaction(interfaces::Chain::Lock& locked_chain, const ui
 {
     auto locked_chain_recursive = chain().lock();  // Temporary. Removed in upcoming lock cleanup
     LOCK(cs_wallet);
+    ++nStakingChanges;
 
     WalletBatch batch(*database, "r+");
 
@@ -1208,6 +1345,7 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
 {
     auto locked_chain = chain().lock();
     LOCK(cs_wallet);
+    ++nStakingChanges;
 
     int conflictconfirms = -locked_chain->getBlockDepth(hashBlock);
     // If number of conflict confirms cannot be determined, this means
@@ -1218,7 +1356,8 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
         return;
 
     // Do not flush the wallet here for performance reasons
-    WalletBatch batch(*database, "r+", false);
+    std::unique_ptr<WalletBatch> batch_own;
+    WalletBatch& batch = GetWriteBatch(batch_own, false);
 
     std::set<uint256> todo;
     std::set<uint256> done;
@@ -1286,6 +1425,7 @@ void CWallet::TransactionAddedToMempool(const CTransactionRef& ptx) {
     auto it = mapWallet.find(ptx->GetHash());
     if (it != mapWallet.end()) {
         it->second.fInMempool = true;
+        ++nStakingChanges;
     }
 }
 
@@ -1294,12 +1434,14 @@ void CWallet::TransactionRemovedFromMempool(const CTransactionRef &ptx) {
     auto it = mapWallet.find(ptx->GetHash());
     if (it != mapWallet.end()) {
         it->second.fInMempool = false;
+        ++nStakingChanges;
     }
 }
 
 void CWallet::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex *pindex, const std::vector<CTransactionRef>& vtxConflicted) {
     auto locked_chain = chain().lock();
     LOCK(cs_wallet);
+    WalletBatchScope batch_scope(*this);
     // TODO: Temporarily ensure that mempool removals are notified before
     // connected transactions.  This shouldn't matter, but the abandoned
     // state of transactions in our wallet is currently cleared when we
@@ -1316,6 +1458,22 @@ void CWallet::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const
         SyncTransaction(pblock->vtx[i], pindex->GetBlockHash(), i);
         TransactionRemovedFromMempool(pblock->vtx[i]);
     }
+    PruneWalletOutputs(*locked_chain);
+
+    // The Transfer logs of the block were notified before it, so the token entries
+    // that were up to date with its parent are up to date with it
+    if(pindex->pprev)
+    {
+        for(auto& item : mapToken)
+        {
+            CTokenInfo& token = item.second;
+            if(token.blockNumber != pindex->pprev->nHeight || token.blockHash != pindex->pprev->GetBlockHash())
+                continue;
+            token.blockNumber = pindex->nHeight;
+            token.blockHash = pindex->GetBlockHash();
+            tokenLedger.SetScanned(CTokenLedger::TokenAddress(token.strContractAddress, token.strSenderAddress), pindex->nHeight, pindex);
+        }
+    }
 
     m_last_block_processed = pindex->GetBlockHash();
 }
@@ -1323,11 +1481,65 @@ void CWallet::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const
 void CWallet::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock) {
     auto locked_chain = chain().lock();
     LOCK(cs_wallet);
+    WalletBatchScope batch_scope(*this);
 
     for (const CTransactionRef& ptx : pblock->vtx) {
         int posInBlock = ptx->IsCoinStake() ? -1 : 0;
         SyncTransaction(ptx, {} /* block hash */, posInBlock /* position in block */);
     }
+
+    // Step the token entries back, so that the events of the new branch are searched
+    const uint256 hashBlock = pblock->GetHash();
+    for(auto& item : mapToken)
+    {
+        CTokenInfo& token = item.second;
+        if(token.blockHash != hashBlock)
+            continue;
+        token.blockNumber--;
+        token.blockHash = pblock->hashPrevBlock;
+    }
+}
+
+void CWallet::TokenTransfersConnected(const CBlockIndex *pindex, const std::vector<TokenTransferLog>& transfers)
+{
+    LOCK(cs_wallet);
+    if(mapToken.empty())
+        return;
+    WalletBatchScope batch_scope(*this);
+
+    // Transfers of a transaction between the same addresses are merged, as searchlogs does for the token tx worker
+    std::vector<CTokenTx> tokenTxs;
+    for(const TokenTransferLog& transfer : transfers)
+    {
+        CTokenTx tokenTx;
+        tokenTx.strContractAddress = HexStr(transfer.contract.begin(), transfer.contract.end());
+        tokenTx.strSenderAddress = EncodeDestination(CKeyID(transfer.from));
+        tokenTx.strReceiverAddress = EncodeDestination(CKeyID(transfer.to));
+        if(tokenLedger.FindToken(tokenTx.strContractAddress, tokenTx.strSenderAddress).IsNull() &&
+            tokenLedger.FindToken(tokenTx.strContractAddress, tokenTx.strReceiverAddress).IsNull())
+            continue;
+
+        tokenTx.nValue = transfer.value;
+        tokenTx.transactionHash = transfer.hashTx;
+        tokenTx.blockHash = pindex->GetBlockHash();
+        tokenTx.blockNumber = pindex->nHeight;
+
+        auto it = std::find_if(tokenTxs.begin(), tokenTxs.end(), [&tokenTx](const CTokenTx& other) {
+            return other.transactionHash == tokenTx.transactionHash && other.strContractAddress == tokenTx.strContractAddress &&
+                other.strSenderAddress == tokenTx.strSenderAddress && other.strReceiverAddress == tokenTx.strReceiverAddress;
+        });
+        if(it != tokenTxs.end())
+        {
+            it->nValue = u256Touint(uintTou256(it->nValue) + uintTou256(tokenTx.nValue));
+            continue;
+        }
+        tokenTxs.push_back(tokenTx);
+    }
+
+    for(const CTokenTx& tokenTx : tokenTxs)
+    {
+        AddTokenTxEntry(tokenTx, false);
+    }
 }
 
 
@@ -1816,6 +2028,20 @@ int64_t CWallet::RescanFromTime(int64_t startTime, const WalletRescanReserver& r
  * the main chain after to the addition of any new keys you want to detect
  * transactions for.
  */
+bool CWallet::IsKnownOrSpendsKnown(const CTransaction& tx) const
+{
+    AssertLockHeld(cs_wallet);
+    if (mapWallet.count(tx.GetHash())) {
+        return true;
+    }
+    for (const CTxIn& txin : tx.vin) {
+        if (mapWallet.count(txin.prevout.hash) || mapTxSpends.count(txin.prevout)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_block, const uint256& stop_block, const WalletRescanReserver& reserver, bool fUpdate)
 {
     int64_t nNow = GetTime();
@@ -1845,6 +2071,17 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
             progress_end = chain().guessVerificationProgress(stop_block.IsNull() ? tip_hash : stop_block);
         }
         double progress_current = progress_begin;
+
+        const bool fFilter = gArgs.GetBoolArg("-rescanfilter", DEFAULT_RESCAN_FILTER);
+        int nThreads = std::max(0, std::min<int>(gArgs.GetArg("-rescanthreads", DEFAULT_RESCAN_THREADS), MAX_RESCAN_THREADS));
+        if (fFilter) {
+            nThreads = std::max(nThreads, 1);
+        }
+        std::unique_ptr<RescanPrefetcher> prefetcher;
+        if (nThreads && block_height) {
+            prefetcher = MakeUnique<RescanPrefetcher>(*this, nThreads, *block_height + 1, fFilter);
+        }
+
         while (block_height && !fAbortRescan && !ShutdownRequested()) {
             if (*block_height % 100 == 0 && progress_end - progress_begin > 0.0) {
                 ShowProgress(strprintf("%s " + _("Rescanning..."), GetDisplayName()), std::max(1, std::min(99, (int)((progress_current - progress_begin) / (progress_end - progress_begin) * 100))));
@@ -1854,8 +2091,29 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
                 WalletLogPrintf("Still rescanning. At block %d. Progress=%f\n", *block_height, progress_current);
             }
 
+            std::unique_ptr<RescanPrefetcher::Block> fetched;
+            if (prefetcher) {
+                fetched = prefetcher->Take(*block_height, block_hash);
+                if (prefetcher->GetGeneration() != m_keystore_generation) {
+                    // Keys were added, test the blocks ahead against them
+                    fetched.reset();
+                    prefetcher = MakeUnique<RescanPrefetcher>(*this, nThreads, *block_height + 1, fFilter);
+                }
+            }
+
             CBlock block;
-            if (chain().findBlock(block_hash, &block) && !block.IsNull()) {
+            bool fRead = false;
+            if (fetched && !fetched->fSkipped && !fetched->block.IsNull()) {
+                block = std::move(fetched->block);
+                fRead = true;
+            } else if (!fetched || !fetched->fSkipped) {
+                fRead = chain().findBlock(block_hash, &block) && !block.IsNull();
+            }
+            if (fetched && fetched->fSkipped) {
+                // The filter of the block matches no script of the wallet
+                result.last_scanned_block = block_hash;
+                result.last_scanned_height = *block_height;
+            } else if (fRead) {
                 auto locked_chain = chain().lock();
                 LOCK(cs_wallet);
                 if (!locked_chain->getBlockHeight(block_hash)) {
@@ -1868,6 +2126,12 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
                     break;
                 }
                 for (size_t posInBlock = 0; posInBlock < block.vtx.size(); ++posInBlock) {
+                    // Without an output of the wallet, only a tx known to the wallet or spending
+                    // an output of its txs may involve it, see AddToWalletIfInvolvingMe
+                    if (fetched && !fetched->vOutputsMine.empty() && !fetched->vOutputsMine[posInBlock] &&
+                        prefetcher->GetGeneration() == m_keystore_generation && !IsKnownOrSpendsKnown(*block.vtx[posInBlock])) {
+                        continue;
+                    }
                     SyncTransaction(block.vtx[posInBlock], block_hash, posInBlock, fUpdate);
                 }
                 // scan succeeded, record block as most recent successfully scanned
@@ -2229,12 +2493,42 @@ void CWallet::ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman
  */
 
 
+bool CWallet::GetCachedBalance(interfaces::Chain::Lock& locked_chain, BalanceKind kind, const isminefilter& filter, int min_depth, CAmount& nTotal) const
+{
+    AssertLockHeld(cs_wallet);
+
+    Optional<int> tip_height = locked_chain.getHeight();
+    uint256 hashTip = tip_height ? locked_chain.getBlockHash(*tip_height) : uint256();
+    if (balanceCache.hashTip != hashTip || balanceCache.nChanges != nStakingChanges || balanceCache.nKeyStoreGeneration != m_keystore_generation) {
+        balanceCache.hashTip = hashTip;
+        balanceCache.nChanges = nStakingChanges;
+        balanceCache.nKeyStoreGeneration = m_keystore_generation;
+        balanceCache.mapTotals.clear();
+        return false;
+    }
+
+    auto it = balanceCache.mapTotals.find(std::make_tuple(kind, filter, min_depth));
+    if (it == balanceCache.mapTotals.end())
+        return false;
+    nTotal = it->second;
+    return true;
+}
+
+CAmount CWallet::CacheBalance(BalanceKind kind, const isminefilter& filter, int min_depth, CAmount nTotal) const
+{
+    AssertLockHeld(cs_wallet);
+    balanceCache.mapTotals[std::make_tuple(kind, filter, min_depth)] = nTotal;
+    return nTotal;
+}
+
 CAmount CWallet::GetBalance(const isminefilter& filter, const int min_depth) const
 {
     CAmount nTotal = 0;
     {
         auto locked_chain = chain().lock();
         LOCK(cs_wallet);
+        if (GetCachedBalance(*locked_chain, BalanceKind::TRUSTED, filter, min_depth, nTotal))
+            return nTotal;
         for (const auto& entry : mapWallet)
         {
             const CWalletTx* pcoin = &entry.second;
@@ -2242,6 +2536,7 @@ CAmount CWallet::GetBalance(const isminefilter& filter, const int min_depth) con
                 nTotal += pcoin->GetAvailableCredit(*locked_chain, true, filter);
             }
         }
+        CacheBalance(BalanceKind::TRUSTED, filter, min_depth, nTotal);
     }
 
     return nTotal;
@@ -2253,12 +2548,15 @@ CAmount CWallet::GetUnconfirmedBalance() const
     {
         auto locked_chain = chain().lock();
         LOCK(cs_wallet);
+        if (GetCachedBalance(*locked_chain, BalanceKind::UNCONFIRMED, ISMINE_SPENDABLE, 0, nTotal))
+            return nTotal;
         for (const auto& entry : mapWallet)
         {
             const CWalletTx* pcoin = &entry.second;
             if (!pcoin->IsTrusted(*locked_chain) && pcoin->GetDepthInMainChain(*locked_chain) == 0 && pcoin->InMempool())
                 nTotal += pcoin->GetAvailableCredit(*locked_chain);
         }
+        CacheBalance(BalanceKind::UNCONFIRMED, ISMINE_SPENDABLE, 0, nTotal);
     }
     return nTotal;
 }
@@ -2269,11 +2567,14 @@ CAmount CWallet::GetImmatureBalance() const
     {
         auto locked_chain = chain().lock();
         LOCK(cs_wallet);
+        if (GetCachedBalance(*locked_chain, BalanceKind::IMMATURE, ISMINE_SPENDABLE, 0, nTotal))
+            return nTotal;
         for (const auto& entry : mapWallet)
         {
             const CWalletTx* pcoin = &entry.second;
             nTotal += pcoin->GetImmatureCredit(*locked_chain);
         }
+        CacheBalance(BalanceKind::IMMATURE, ISMINE_SPENDABLE, 0, nTotal);
     }
     return nTotal;
 }
@@ -2284,12 +2585,15 @@ CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
     {
         auto locked_chain = chain().lock();
         LOCK(cs_wallet);
+        if (GetCachedBalance(*locked_chain, BalanceKind::UNCONFIRMED_WATCH_ONLY, ISMINE_WATCH_ONLY, 0, nTotal))
+            return nTotal;
         for (const auto& entry : mapWallet)
         {
             const CWalletTx* pcoin = &entry.second;
             if (!pcoin->IsTrusted(*locked_chain) && pcoin->GetDepthInMainChain(*locked_chain) == 0 && pcoin->InMempool())
                 nTotal += pcoin->GetAvailableCredit(*locked_chain, true, ISMINE_WATCH_ONLY);
         }
+        CacheBalance(BalanceKind::UNCONFIRMED_WATCH_ONLY, ISMINE_WATCH_ONLY, 0, nTotal);
     }
     return nTotal;
 }
@@ -2300,11 +2604,14 @@ CAmount CWallet::GetImmatureWatchOnlyBalance() const
     {
         auto locked_chain = chain().lock();
         LOCK(cs_wallet);
+        if (GetCachedBalance(*locked_chain, BalanceKind::IMMATURE_WATCH_ONLY, ISMINE_WATCH_ONLY, 0, nTotal))
+            return nTotal;
         for (const auto& entry : mapWallet)
         {
             const CWalletTx* pcoin = &entry.second;
             nTotal += pcoin->GetImmatureWatchOnlyCredit(*locked_chain);
         }
+        CacheBalance(BalanceKind::IMMATURE_WATCH_ONLY, ISMINE_WATCH_ONLY, 0, nTotal);
     }
     return nTotal;
 }
@@ -2374,104 +2681,119 @@ void CWallet::AvailableCoins(interfaces::Chain::Lock& locked_chain, std::vector<
     vCoins.clear();
     CAmount nTotal = 0;
 
-    for (const auto& entry : mapWallet)
+    // The tx checks are made on the first output of each tx, and hold for the next ones
+    const CWalletTx* pcoin = nullptr;
+    bool fSkipTx = true;
+    int nDepth = 0;
+    bool safeTx = false;
+    for (const COutPoint& output : GetWalletOutputs())
     {
-        const uint256& wtxid = entry.first;
-        const CWalletTx* pcoin = &entry.second;
-
-        if (!CheckFinalTx(*pcoin->tx))
-            continue;
+        const uint256& wtxid = output.hash;
+        const unsigned int i = output.n;
+        if (!pcoin || pcoin->GetHash() != wtxid) {
+            fSkipTx = true;
+            auto it = mapWallet.find(wtxid);
+            pcoin = it != mapWallet.end() ? &it->second : nullptr;
+            if (!pcoin)
+                continue;
 
-        if (pcoin->IsImmature(locked_chain))
-            continue;
+            if (!CheckFinalTx(*pcoin->tx))
+                continue;
 
-        int nDepth = pcoin->GetDepthInMainChain(locked_chain);
-        if (nDepth < 0)
-            continue;
+            if (pcoin->IsImmature(locked_chain))
+                continue;
 
-        // We should not consider coins which aren't at least in our mempool
-        // It's possible for these to be conflicted via ancestors which we may never be able to detect
-        if (nDepth == 0 && !pcoin->InMempool())
-            continue;
+            nDepth = pcoin->GetDepthInMainChain(locked_chain);
+            if (nDepth < 0)
+                continue;
 
-        bool safeTx = pcoin->IsTrusted(locked_chain);
+            // We should not consider coins which aren't at least in our mempool
+            // It's possible for these to be conflicted via ancestors which we may never be able to detect
+            if (nDepth == 0 && !pcoin->InMempool())
+                continue;
 
-        // We should not consider coins from transactions that are replacing
-        // other transactions.
-        //
-        // Example: There is a transaction A which is replaced by bumpfee
-        // transaction B. In this case, we want to prevent creation of
-        // a transaction B' which spends an output of B.
-        //
-        // Reason: If transaction A were initially confirmed, transactions B
-        // and B' would no longer be valid, so the user would have to create
-        // a new transaction C to replace B'. However, in the case of a
-        // one-block reorg, transactions B' and C might BOTH be accepted,
-        // when the user only wanted one of them. Specifically, there could
-        // be a 1-block reorg away from the chain where transactions A and C
-        // were accepted to another chain where B, B', and C were all
-        // accepted.
-        if (nDepth == 0 && pcoin->mapValue.count("replaces_txid")) {
-            safeTx = false;
-        }
-
-        // Similarly, we should not consider coins from transactions that
-        // have been replaced. In the example above, we would want to prevent
-        // creation of a transaction A' spending an output of A, because if
-        // transaction B were initially confirmed, conflicting with A and
-        // A', we wouldn't want to the user to create a transaction D
-        // intending to replace A', but potentially resulting in a scenario
-        // where A, A', and D could all be accepted (instead of just B and
-        // D, or just A and A' like the user would want).
-        if (nDepth == 0 && pcoin->mapValue.count("replaced_by_txid")) {
-            safeTx = false;
-        }
-
-        if (fOnlySafe && !safeTx) {
-            continue;
-        }
+            safeTx = pcoin->IsTrusted(locked_chain);
+
+            // We should not consider coins from transactions that are replacing
+            // other transactions.
+            //
+            // Example: There is a transaction A which is replaced by bumpfee
+            // transaction B. In this case, we want to prevent creation of
+            // a transaction B' which spends an output of B.
+            //
+            // Reason: If transaction A were initially confirmed, transactions B
+            // and B' would no longer be valid, so the user would have to create
+            // a new transaction C to replace B'. However, in the case of a
+            // one-block reorg, transactions B' and C might BOTH be accepted,
+            // when the user only wanted one of them. Specifically, there could
+            // be a 1-block reorg away from the chain where transactions A and C
+            // were accepted to another chain where B, B', and C were all
+            // accepted.
+            if (nDepth == 0 && pcoin->mapValue.count("replaces_txid")) {
+                safeTx = false;
+            }
 
-        if (nDepth < nMinDepth || nDepth > nMaxDepth)
-            continue;
+            // Similarly, we should not consider coins from transactions that
+            // have been replaced. In the example above, we would want to prevent
+            // creation of a transaction A' spending an output of A, because if
+            // transaction B were initially confirmed, conflicting with A and
+            // A', we wouldn't want to the user to create a transaction D
+            // intending to replace A', but potentially resulting in a scenario
+            // where A, A', and D could all be accepted (instead of just B and
+            // D, or just A and A' like the user would want).
+            if (nDepth == 0 && pcoin->mapValue.count("replaced_by_txid")) {
+                safeTx = false;
+            }
 
-        for (unsigned int i = 0; i < pcoin->tx->vout.size(); i++) {
-            if (pcoin->tx->vout[i].nValue < nMinimumAmount || pcoin->tx->vout[i].nValue > nMaximumAmount)
+            if (fOnlySafe && !safeTx) {
                 continue;
+            }
 
-            if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(COutPoint(entry.first, i)))
+            if (nDepth < nMinDepth || nDepth > nMaxDepth)
                 continue;
 
-            if (IsLockedCoin(entry.first, i))
-                continue;
+            fSkipTx = false;
+        }
 
-            if (IsSpent(locked_chain, wtxid, i))
-                continue;
+        if (fSkipTx || i >= pcoin->tx->vout.size())
+            continue;
 
-            isminetype mine = IsMine(pcoin->tx->vout[i]);
+        if (pcoin->tx->vout[i].nValue < nMinimumAmount || pcoin->tx->vout[i].nValue > nMaximumAmount)
+            continue;
 
-            if (mine == ISMINE_NO) {
-                continue;
-            }
+        if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(output))
+            continue;
 
-            bool solvable = IsSolvable(*this, pcoin->tx->vout[i].scriptPubKey);
-            bool spendable = ((mine & ISMINE_SPENDABLE) != ISMINE_NO) || (((mine & ISMINE_WATCH_ONLY) != ISMINE_NO) && (coinControl && coinControl->fAllowWatchOnly && solvable));
+        if (IsLockedCoin(wtxid, i))
+            continue;
 
-            vCoins.push_back(COutput(pcoin, i, nDepth, spendable, solvable, safeTx, (coinControl && coinControl->fAllowWatchOnly)));
+        if (IsSpent(locked_chain, wtxid, i))
+            continue;
 
-            // Checks the sum amount of all UTXO's.
-            if (nMinimumSumAmount != MAX_MONEY) {
-                nTotal += pcoin->tx->vout[i].nValue;
+        isminetype mine = IsMine(pcoin->tx->vout[i]);
 
-                if (nTotal >= nMinimumSumAmount) {
-                    return;
-                }
-            }
+        if (mine == ISMINE_NO) {
+            continue;
+        }
+
+        bool solvable = IsSolvable(*this, pcoin->tx->vout[i].scriptPubKey);
+        bool spendable = ((mine & ISMINE_SPENDABLE) != ISMINE_NO) || (((mine & ISMINE_WATCH_ONLY) != ISMINE_NO) && (coinControl && coinControl->fAllowWatchOnly && solvable));
+
+        vCoins.push_back(COutput(pcoin, i, nDepth, spendable, solvable, safeTx, (coinControl && coinControl->fAllowWatchOnly)));
 
-            // Checks the maximum number of UTXO's.
-            if (nMaximumCount > 0 && vCoins.size() >= nMaximumCount) {
+        // Checks the sum amount of all UTXO's.
+        if (nMinimumSumAmount != MAX_MONEY) {
+            nTotal += pcoin->tx->vout[i].nValue;
+
+            if (nTotal >= nMinimumSumAmount) {
                 return;
             }
         }
+
+        // Checks the maximum number of UTXO's.
+        if (nMaximumCount > 0 && vCoins.size() >= nMaximumCount) {
+            return;
+        }
     }
 }
 
@@ -2482,30 +2804,38 @@ void CWallet::AvailableCoinsForStaking(interfaces::Chain::Lock& locked_chain, st
 
     vCoins.clear();
 
-    for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+    // The outputs of a transaction are next to each other in the set, in the order of mapWallet
+    const CWalletTx* pcoin = nullptr;
+    int nDepth = 0;
+    bool fMature = false;
+    for (const COutPoint& prevout : GetWalletOutputs())
     {
-        const uint256& wtxid = it->first;
-        const CWalletTx* pcoin = &(*it).second;
-        int nDepth = pcoin->GetDepthInMainChain(locked_chain);
-
-        if (nDepth < 1)
-            continue;
+        const uint256& wtxid = prevout.hash;
+        unsigned int i = prevout.n;
+        if (!pcoin || pcoin->GetHash() != wtxid) {
+            std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(wtxid);
+            if (it == mapWallet.end()) {
+                pcoin = nullptr;
+                continue;
+            }
+            pcoin = &(*it).second;
+            nDepth = pcoin->GetDepthInMainChain(locked_chain);
+            fMature = nDepth >= COINBASE_MATURITY && pcoin->GetBlocksToMaturity(locked_chain) == 0;
+        }
 
-        if (nDepth < COINBASE_MATURITY)
+        if (!fMature || i >= pcoin->tx->vout.size())
             continue;
 
-        if (pcoin->GetBlocksToMaturity(locked_chain) > 0)
+        // Neither contract creations and calls nor outputs without value can stake
+        const CTxOut& txout = pcoin->tx->vout[i];
+        if (txout.nValue <= 0 || txout.scriptPubKey.HasOpCall() || txout.scriptPubKey.HasOpCreate())
             continue;
 
-        for (unsigned int i = 0; i < pcoin->tx->vout.size(); i++) {
-            isminetype mine = IsMine(pcoin->tx->vout[i]);
-            bool solvable = IsSolvable(*this, pcoin->tx->vout[i].scriptPubKey);
-            bool spendable = ((mine & ISMINE_SPENDABLE) != ISMINE_NO) || (((mine & ISMINE_WATCH_ONLY) != ISMINE_NO) && solvable);
-            if (!(IsSpent(locked_chain, wtxid, i)) && mine != ISMINE_NO &&
-                !IsLockedCoin((*it).first, i) && (pcoin->tx->vout[i].nValue > 0) &&
-                !pcoin->tx->vout[i].scriptPubKey.HasOpCall() && !pcoin->tx->vout[i].scriptPubKey.HasOpCreate())
-                    vCoins.push_back(COutput(pcoin, i, nDepth, spendable, solvable, pcoin->IsTrusted(locked_chain)));
-        }
+        isminetype mine = IsMine(pcoin->tx->vout[i]);
+        bool solvable = IsSolvable(*this, pcoin->tx->vout[i].scriptPubKey);
+        bool spendable = ((mine & ISMINE_SPENDABLE) != ISMINE_NO) || (((mine & ISMINE_WATCH_ONLY) != ISMINE_NO) && solvable);
+        if (!(IsSpent(locked_chain, wtxid, i)) && mine != ISMINE_NO && !IsLockedCoin(wtxid, i))
+            vCoins.push_back(COutput(pcoin, i, nDepth, spendable, solvable, pcoin->IsTrusted(locked_chain)));
     }
 }
 
@@ -2580,13 +2910,15 @@ CAmount CWallet::GetStake() const
     CAmount nTotal = 0;
     auto locked_chain = chain().lock();
     LOCK(cs_wallet);
+    if (GetCachedBalance(*locked_chain, BalanceKind::STAKE, ISMINE_SPENDABLE, 0, nTotal))
+        return nTotal;
     for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
     {
         const CWalletTx* pcoin = &(*it).second;
         if (pcoin->IsImmatureCoinStake(*locked_chain) && pcoin->GetDepthInMainChain(*locked_chain) > 0)
             nTotal += CWallet::GetCredit(*(pcoin->tx), ISMINE_SPENDABLE);
     }
-    return nTotal;
+    return CacheBalance(BalanceKind::STAKE, ISMINE_SPENDABLE, 0, nTotal);
 }
 
 CAmount CWallet::GetWatchOnlyStake() const
@@ -2594,13 +2926,15 @@ CAmount CWallet::GetWatchOnlyStake() const
     CAmount nTotal = 0;
     auto locked_chain = chain().lock();
     LOCK(cs_wallet);
+    if (GetCachedBalance(*locked_chain, BalanceKind::WATCH_ONLY_STAKE, ISMINE_WATCH_ONLY, 0, nTotal))
+        return nTotal;
     for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
     {
         const CWalletTx* pcoin = &(*it).second;
         if (pcoin->IsImmatureCoinStake(*locked_chain) && pcoin->GetDepthInMainChain(*locked_chain) > 0)
             nTotal += CWallet::GetCredit(*(pcoin->tx), ISMINE_WATCH_ONLY);
     }
-    return nTotal;
+    return CacheBalance(BalanceKind::WATCH_ONLY_STAKE, ISMINE_WATCH_ONLY, 0, nTotal);
 }
 
 bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const CoinEligibilityFilter& eligibility_filter, std::vector<OutputGroup> groups,
@@ -3387,6 +3721,20 @@ bool CWallet::CreateTransaction(interfaces::Chain::Lock& locked_chain, const std
 
 uint64_t CWallet::GetStakeWeight(interfaces::Chain::Lock& locked_chain) const
 {
+    LOCK(cs_wallet);
+
+    // The coins selected only change with the tip, the wallet and the reserve balance
+    const CBlockIndex* pindexTip = chainActive.Tip();
+    uint256 hashTip = pindexTip ? pindexTip->GetBlockHash() : uint256();
+    if (stakeWeightCache.fValid && stakeWeightCache.hashTip == hashTip &&
+        stakeWeightCache.nChanges == nStakingChanges && stakeWeightCache.nReserveBalance == m_reserve_balance)
+        return stakeWeightCache.nWeight;
+    stakeWeightCache.fValid = true;
+    stakeWeightCache.hashTip = hashTip;
+    stakeWeightCache.nChanges = nStakingChanges;
+    stakeWeightCache.nReserveBalance = m_reserve_balance;
+    stakeWeightCache.nWeight = 0;
+
     // Choose coins to use
     CAmount nBalance = GetBalance();
 
@@ -3413,10 +3761,66 @@ uint64_t CWallet::GetStakeWeight(interfaces::Chain::Lock& locked_chain) const
             nWeight += pcoin.first->tx->vout[pcoin.second].nValue;
     }
 
+    stakeWeightCache.nWeight = nWeight;
     return nWeight;
 }
 
-bool CWallet::CreateCoinStake(interfaces::Chain::Lock& locked_chain, const CKeyStore& keystore, unsigned int nBits, const CAmount& nTotalFees, uint32_t nTimeBlock, CMutableTransaction& tx, CKey& key, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoins)
+std::shared_ptr<const CStakeSnapshot> CWallet::GetStakeSnapshot(interfaces::Chain::Lock& locked_chain)
+{
+    const CBlockIndex* pindexTip = chainActive.Tip();
+    uint256 hashTip = pindexTip ? pindexTip->GetBlockHash() : uint256();
+    auto isCurrent = [&](const CStakeSnapshot& snapshot) {
+        return snapshot.hashTip == hashTip && snapshot.nChanges == nStakingChanges &&
+            snapshot.nKeyStoreGeneration == m_keystore_generation && snapshot.nReserveBalance == m_reserve_balance;
+    };
+    {
+        LOCK(cs_stake_snapshot);
+        if (m_stake_snapshot && isCurrent(*m_stake_snapshot))
+            return m_stake_snapshot;
+    }
+
+    LOCK(cs_wallet);
+    std::shared_ptr<CStakeSnapshot> snapshot = std::make_shared<CStakeSnapshot>();
+    snapshot->hashTip = hashTip;
+    snapshot->nChanges = nStakingChanges;
+    snapshot->nKeyStoreGeneration = m_keystore_generation;
+    snapshot->nReserveBalance = m_reserve_balance;
+
+    CAmount nTargetValue = GetBalance() - snapshot->nReserveBalance;
+    CAmount nValueIn = 0;
+    SelectCoinsForStaking(locked_chain, nTargetValue, snapshot->setCoins, nValueIn);
+    snapshot->fCandidatesComplete = GetStakeCandidates(locked_chain, snapshot->setCoins, snapshot->candidates);
+
+    LOCK(cs_stake_snapshot);
+    m_stake_snapshot = snapshot;
+    return m_stake_snapshot;
+}
+
+bool CWallet::GetStakeCandidates(interfaces::Chain::Lock& locked_chain, const std::set<std::pair<const CWalletTx*,unsigned int> >& setCoins, std::vector<CStakeCandidate>& candidates)
+{
+    CBlockIndex* pindexPrev = chainActive.Tip();
+    std::map<COutPoint, CStakeCache> tmpCache;
+    std::map<COutPoint, CStakeCache>& cache = gArgs.GetBoolArg("-stakecache", DEFAULT_STAKE_CACHE) ? stakeCache : tmpCache;
+
+    // Coins CacheKernel leaves out can only stake if they belong to super stakers
+    bool fComplete = true;
+    candidates.clear();
+    candidates.reserve(setCoins.size());
+    for(const std::pair<const CWalletTx*,unsigned int> &pcoin : setCoins)
+    {
+        boost::this_thread::interruption_point();
+        COutPoint prevoutStake = COutPoint(pcoin.first->GetHash(), pcoin.second);
+        CacheKernel(cache, prevoutStake, pindexPrev, *pcoinsTip);
+        auto it = cache.find(prevoutStake);
+        if(it != cache.end())
+            candidates.emplace_back(prevoutStake, it->second, it->second.isSuperStaker);
+        else if(IsSuperStaker(pcoin.first->tx->vout[pcoin.second].scriptPubKey))
+            fComplete = false;
+    }
+    return fComplete;
+}
+
+bool CWallet::CreateCoinStake(interfaces::Chain::Lock& locked_chain, const CKeyStore& keystore, unsigned int nBits, const CAmount& nTotalFees, uint32_t nTimeBlock, CMutableTransaction& tx, CKey& key, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoins, const COutPoint* pprevoutKernel)
 {
     CBlockIndex* pindexPrev = chainActive.Tip();
     arith_uint256 bnTargetPerCoinDay;
@@ -3467,6 +3871,8 @@ bool CWallet::CreateCoinStake(interfaces::Chain::Lock& locked_chain, const CKeyS
         // Search backward in time from the given txNew timestamp
         // Search nSearchInterval seconds back up to nMaxStakeSearchInterval
         COutPoint prevoutStake = COutPoint(pcoin.first->GetHash(), pcoin.second);
+        if (pprevoutKernel && prevoutStake != *pprevoutKernel)
+            continue;
         if (CheckKernel(pindexPrev, nBits, nTimeBlock, prevoutStake, *pcoinsTip, stakeCache))
         {
             // Found a kernel
@@ -3641,6 +4047,8 @@ bool CWallet::CommitTransaction(CTransactionRef tx, mapValue_t mapValue, std::ve
 
         WalletLogPrintf("CommitTransaction:\n%s", wtxNew.tx->ToString()); /* Continued */
         {
+            WalletBatchScope batch_scope(*this);
+
             // Take key pair from key pool so it won't be used again
             reservekey.KeepKey();
 
@@ -3705,6 +4113,13 @@ DBErrors CWallet::LoadWallet(bool& fFirstRunRet)
     if (nLoadWalletRet != DBErrors::LOAD_OK)
         return nLoadWalletRet;
 
+    // Only now are all the keys and watch-only scripts loaded
+    setWalletOutputs.clear();
+    for (const auto& entry : mapWallet)
+        AddWalletOutputs(entry.second);
+    nWalletOutputsGeneration = m_keystore_generation;
+    ++nStakingChanges;
+
     return DBErrors::LOAD_OK;
 }
 
@@ -3715,8 +4130,10 @@ DBErrors CWallet::ZapSelectTx(std::vector<uint256>& vHashIn, std::vector<uint256
     for (uint256 hash : vHashOut) {
         const auto& it = mapWallet.find(hash);
         wtxOrdered.erase(it->second.m_it_wtxOrdered);
+        RemoveWalletOutputs(hash);
         mapWallet.erase(it);
     }
+    ++nStakingChanges;
 
     if (nZapSelectTxRet == DBErrors::NEED_REWRITE)
     {
@@ -3882,7 +4299,7 @@ void CWallet::LoadKeyPool(int64_t nIndex, const CKeyPool &keypool)
         mapKeyMetadata[keyid] = CKeyMetadata(keypool.nTime);
 }
 
-bool CWallet::TopUpKeyPool(unsigned int kpSize)
+bool CWallet::TopUpKeyPool(unsigned int kpSize, unsigned int nMaxKeys)
 {
     if (!CanGenerateKeys()) {
         return false;
@@ -3910,6 +4327,10 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
             // don't create extra internal keys
             missingInternal = 0;
         }
+        if (nMaxKeys > 0) {
+            missingExternal = std::min(missingExternal, (int64_t) nMaxKeys);
+            missingInternal = std::min(missingInternal, (int64_t) nMaxKeys);
+        }
         bool internal = false;
         WalletBatch batch(*database);
         for (int64_t i = missingInternal + missingExternal; i--;)
@@ -3929,6 +4350,26 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
     return true;
 }
 
+void CWallet::TopUpKeyPoolInBackground()
+{
+    if (!CanGenerateKeys()) {
+        return;
+    }
+    {
+        LOCK(cs_wallet);
+
+        if (IsLocked())
+            return;
+
+        size_t nTargetSize = std::max(gArgs.GetArg("-keypool", DEFAULT_KEYPOOL_SIZE), (int64_t) 1);
+        bool fSplit = IsHDEnabled() && CanSupportFeature(FEATURE_HD_SPLIT);
+        if (setExternalKeyPool.size() >= nTargetSize && (!fSplit || setInternalKeyPool.size() >= nTargetSize))
+            return;
+    }
+    // cs_wallet is released between the batches, so a large keypool does not hold up the wallet
+    TopUpKeyPool(0, KEYPOOL_TOPUP_BATCH);
+}
+
 void CWallet::AddKeypoolPubkey(const CPubKey& pubkey, const bool internal)
 {
     WalletBatch batch(*database);
@@ -3959,14 +4400,15 @@ bool CWallet::ReserveKeyFromKeyPool(int64_t& nIndex, CKeyPool& keypool, bool fRe
     {
         LOCK(cs_wallet);
 
-        if (!IsLocked())
-            TopUpKeyPool();
-
         bool fReturningInternal = fRequestedInternal;
         fReturningInternal &= (IsHDEnabled() && CanSupportFeature(FEATURE_HD_SPLIT)) || IsWalletFlagSet(WALLET_FLAG_DISABLE_PRIVATE_KEYS);
         bool use_split_keypool = set_pre_split_keypool.empty();
         std::set<int64_t>& setKeyPool = use_split_keypool ? (fReturningInternal ? setInternalKeyPool : setExternalKeyPool) : set_pre_split_keypool;
 
+        // Only the key needed now is generated here, TopUpKeyPoolInBackground refills the rest
+        if (setKeyPool.empty() && !IsLocked())
+            TopUpKeyPool(1);
+
         // Get the oldest key
         if (setKeyPool.empty()) {
             return false;
@@ -4237,6 +4679,7 @@ void CWallet::DisableTransaction(interfaces::Chain::Lock& locked_chain, const CT
     {
         LOCK(cs_wallet);
         RemoveFromSpends(hash);
+        ++nStakingChanges;
         std::set<CWalletTx*> setCoins;
         for(const CTxIn& txin : tx.vin)
         {
@@ -4326,18 +4769,21 @@ void CWallet::LockCoin(const COutPoint& output)
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.insert(output);
+    ++nStakingChanges;
 }
 
 void CWallet::UnlockCoin(const COutPoint& output)
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.erase(output);
+    ++nStakingChanges;
 }
 
 void CWallet::UnlockAllCoins()
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.clear();
+    ++nStakingChanges;
 }
 
 bool CWallet::IsLockedCoin(uint256 hash, unsigned int n) const
@@ -4807,6 +5253,19 @@ std::shared_ptr<CWallet> CWallet::CreateWalletFromFile(interfaces::Chain& chain,
     walletInstance->m_signal_rbf = gArgs.GetBoolArg("-walletrbf", DEFAULT_WALLET_RBF);
     if(!ParseMoney(gArgs.GetArg("-reservebalance", FormatMoney(DEFAULT_RESERVE_BALANCE)), walletInstance->m_reserve_balance))
         walletInstance->m_reserve_balance = DEFAULT_RESERVE_BALANCE;
+
+    if (gArgs.GetBoolArg("-stakeconsolidate", DEFAULT_STAKE_CONSOLIDATE)) {
+        if (!ParseMoney(gArgs.GetArg("-consolidatetarget", FormatMoney(GetStakeCombineThreshold())), walletInstance->m_consolidate_target) || walletInstance->m_consolidate_target <= 0) {
+            InitError(AmountErrMsg("consolidatetarget", gArgs.GetArg("-consolidatetarget", "")));
+            return nullptr;
+        }
+        CAmount nMaxFee = 0;
+        if (!ParseMoney(gArgs.GetArg("-consolidatemaxfee", FormatMoney(DEFAULT_CONSOLIDATE_MAX_FEE)), nMaxFee)) {
+            InitError(AmountErrMsg("consolidatemaxfee", gArgs.GetArg("-consolidatemaxfee", "")));
+            return nullptr;
+        }
+        walletInstance->m_consolidate_max_fee = CFeeRate(nMaxFee);
+    }
     walletInstance->m_use_change_address = gArgs.GetBoolArg("-usechangeaddress", DEFAULT_USE_CHANGE_ADDRESS);
 
     walletInstance->WalletLogPrintf("Wallet completed loading in %15dms\n", GetTimeMillis() - nStart);
@@ -4945,6 +5404,7 @@ bool CWallet::LoadToken(const CTokenInfo &token)
 {
     uint256 hash = token.GetHash();
     mapToken[hash] = token;
+    tokenLedger.AddToken(hash, token);
 
     return true;
 }
@@ -4961,7 +5421,8 @@ bool CWallet::AddTokenEntry(const CTokenInfo &token, bool fFlushOnClose)
 {
     LOCK(cs_wallet);
 
-    WalletBatch batch(*database, "r+", fFlushOnClose);
+    std::unique_ptr<WalletBatch> batch_own;
+    WalletBatch& batch = GetWriteBatch(batch_own, fFlushOnClose);
 
     uint256 hash = token.GetHash();
 
@@ -4988,6 +5449,7 @@ bool CWallet::AddTokenEntry(const CTokenInfo &token, bool fFlushOnClose)
         return false;
 
     mapToken[hash] = wtoken;
+    tokenLedger.AddToken(hash, wtoken);
 
     NotifyTokenChanged(this, hash, fInsertedNew ? CT_NEW : CT_UPDATED);
 
@@ -5010,7 +5472,8 @@ bool CWallet::AddTokenTxEntry(const CTokenTx &tokenTx, bool fFlushOnClose)
 {
     LOCK(cs_wallet);
 
-    WalletBatch batch(*database, "r+", fFlushOnClose);
+    std::unique_ptr<WalletBatch> batch_own;
+    WalletBatch& batch = GetWriteBatch(batch_own, fFlushOnClose);
 
     uint256 hash = tokenTx.GetHash();
 
@@ -5035,6 +5498,10 @@ bool CWallet::AddTokenTxEntry(const CTokenTx &tokenTx, bool fFlushOnClose)
         return false;
 
     mapTokenTx[hash] = wtokenTx;
+    if(fInsertedNew)
+    {
+        tokenLedger.ApplyTransfer(wtokenTx);
+    }
 
     NotifyTokenTransactionChanged(this, hash, fInsertedNew ? CT_NEW : CT_UPDATED);
 
@@ -5215,27 +5682,22 @@ bool CWallet::GetTokenTxDetails(const CTokenTx &wtx, uint256 &credit, uint256 &d
     LOCK(cs_wallet);
     bool ret = false;
 
-    for(auto it = mapToken.begin(); it != mapToken.end(); it++)
+    auto itSender = mapToken.find(tokenLedger.FindToken(wtx.strContractAddress, wtx.strSenderAddress));
+    if(itSender != mapToken.end())
     {
-        CTokenInfo info = it->second;
-        if(wtx.strContractAddress == info.strContractAddress)
-        {
-            if(wtx.strSenderAddress == info.strSenderAddress)
-            {
-                debit = wtx.nValue;
-                tokenSymbol = info.strTokenSymbol;
-                decimals = info.nDecimals;
-                ret = true;
-            }
+        debit = wtx.nValue;
+        tokenSymbol = itSender->second.strTokenSymbol;
+        decimals = itSender->second.nDecimals;
+        ret = true;
+    }
 
-            if(wtx.strReceiverAddress == info.strSenderAddress)
-            {
-                credit = wtx.nValue;
-                tokenSymbol = info.strTokenSymbol;
-                decimals = info.nDecimals;
-                ret = true;
-            }
-        }
+    auto itReceiver = mapToken.find(tokenLedger.FindToken(wtx.strContractAddress, wtx.strReceiverAddress));
+    if(itReceiver != mapToken.end())
+    {
+        credit = wtx.nValue;
+        tokenSymbol = itReceiver->second.strTokenSymbol;
+        decimals = itReceiver->second.nDecimals;
+        ret = true;
     }
 
     return ret;
@@ -5244,22 +5706,9 @@ bool CWallet::GetTokenTxDetails(const CTokenTx &wtx, uint256 &credit, uint256 &d
 bool CWallet::IsTokenTxMine(const CTokenTx &wtx) const
 {
     LOCK(cs_wallet);
-    bool ret = false;
 
-    for(auto it = mapToken.begin(); it != mapToken.end(); it++)
-    {
-        CTokenInfo info = it->second;
-        if(wtx.strContractAddress == info.strContractAddress)
-        {
-            if(wtx.strSenderAddress == info.strSenderAddress || 
-                wtx.strReceiverAddress == info.strSenderAddress)
-            {
-                ret = true;
-            }
-        }
-    }
-
-    return ret;
+    return !tokenLedger.FindToken(wtx.strContractAddress, wtx.strSenderAddress).IsNull() ||
+        !tokenLedger.FindToken(wtx.strContractAddress, wtx.strReceiverAddress).IsNull();
 }
 
 bool CWallet::RemoveTokenEntry(const uint256 &tokenHash, bool fFlushOnClose)
@@ -5282,6 +5731,7 @@ bool CWallet::RemoveTokenEntry(const uint256 &tokenHash, bool fFlushOnClose)
         if (!batch.EraseToken(tokenHash))
             return false;
 
+        tokenLedger.RemoveToken(tokenHash, it->second);
         mapToken.erase(it);
 
         NotifyTokenChanged(this, tokenHash, CT_DELETED);
@@ -5299,6 +5749,40 @@ bool CWallet::RemoveTokenEntry(const uint256 &tokenHash, bool fFlushOnClose)
     return true;
 }
 
+bool CWallet::GetTokenBalance(const std::string &contractAddress, const std::string &senderAddress, uint256 &balance)
+{
+    LOCK2(cs_main, cs_wallet);
+
+    return tokenLedger.GetBalance(CTokenLedger::TokenAddress(contractAddress, senderAddress), chainActive.Tip(), balance);
+}
+
+void CWallet::SetTokenBalance(const std::string &contractAddress, const std::string &senderAddress, const uint256 &balance, int64_t nHeight)
+{
+    LOCK2(cs_main, cs_wallet);
+
+    // The contract was called on the tip, which may have moved since nHeight was read
+    if(nHeight != chainActive.Height())
+        return;
+
+    tokenLedger.SetBalance(CTokenLedger::TokenAddress(contractAddress, senderAddress), balance, chainActive.Tip());
+}
+
+void CWallet::SetTokenScanned(const std::string &contractAddress, const std::string &senderAddress, int64_t nFromBlock, int64_t nToBlock, bool fOtherEvents)
+{
+    LOCK2(cs_main, cs_wallet);
+
+    CTokenLedger::TokenAddress key(contractAddress, senderAddress);
+    const CBlockIndex *pIndex = chainActive[nToBlock];
+    // Events other than transfers, such as burns, change the balance in ways the ledger does not follow
+    if(fOtherEvents || !pIndex)
+    {
+        tokenLedger.ForgetBalance(key);
+        return;
+    }
+
+    tokenLedger.SetScanned(key, nFromBlock, pIndex);
+}
+
 bool CWallet::CleanTokenTxEntries(bool fFlushOnClose)
 {
     LOCK(cs_wallet);
@@ -5434,3 +5918,92 @@ void CWallet::StopStake()
     }
     stakeThread = 0;
 }
+
+bool CWallet::ConsolidateStakeOutputs(std::string& strFailReason)
+{
+    if (m_consolidate_target <= 0 || !fBroadcastTransactions || IsInitialBlockDownload())
+        return false;
+
+    auto locked_chain = chain().lock();
+    LOCK(cs_wallet);
+
+    if (IsLocked() || m_wallet_unlock_staking_only) {
+        strFailReason = "Wallet is locked";
+        return false;
+    }
+
+    // Consolidate during low fee periods only
+    CCoinControl coin_control;
+    FeeCalculation feeCalc;
+    CFeeRate feeRate = GetMinimumFeeRate(*this, coin_control, ::mempool, ::feeEstimator, &feeCalc);
+    if (feeRate > m_consolidate_max_fee) {
+        strFailReason = strprintf("Fee rate %s is above -consolidatemaxfee", feeRate.ToString());
+        return false;
+    }
+
+    // The mature outputs below the target that are worth more than the fee to spend them
+    std::vector<COutput> vCoins;
+    AvailableCoins(*locked_chain, vCoins, true, nullptr, 1, m_consolidate_target - 1, MAX_MONEY, 0, COINBASE_MATURITY);
+    std::vector<COutput> vSelected;
+    for (const COutput& out : vCoins) {
+        if (out.fSpendable && out.nInputBytes > 0 && out.tx->tx->vout[out.i].nValue > feeRate.GetFee(out.nInputBytes))
+            vSelected.push_back(out);
+    }
+    if (vSelected.size() < CONSOLIDATE_MIN_INPUTS)
+        return false;
+
+    std::sort(vSelected.begin(), vSelected.end(), [](const COutput& a, const COutput& b) {
+        return a.tx->tx->vout[a.i].nValue < b.tx->tx->vout[b.i].nValue;
+    });
+    if (vSelected.size() > GetStakeMaxCombineInputs())
+        vSelected.resize(GetStakeMaxCombineInputs());
+
+    CAmount nTotal = 0;
+    coin_control.fAllowOtherInputs = false;
+    coin_control.m_feerate = feeRate;
+    for (const COutput& out : vSelected) {
+        coin_control.Select(COutPoint(out.tx->GetHash(), out.i));
+        nTotal += out.tx->tx->vout[out.i].nValue;
+    }
+
+    // Outputs of about the target to the script of the largest input, the fee is taken from them
+    const CScript& scriptPubKey = vSelected.back().tx->tx->vout[vSelected.back().i].scriptPubKey;
+    const CAmount nOutputs = std::max<CAmount>(1, nTotal / m_consolidate_target);
+    std::vector<CRecipient> vecSend;
+    for (CAmount i = 0; i < nOutputs; i++) {
+        CAmount nValue = i + 1 < nOutputs ? nTotal / nOutputs : nTotal - (nTotal / nOutputs) * (nOutputs - 1);
+        vecSend.push_back(CRecipient{scriptPubKey, nValue, true});
+    }
+
+    CReserveKey reservekey(this);
+    CAmount nFeeRequired;
+    int nChangePosRet = -1;
+    CTransactionRef tx;
+    if (!CreateTransaction(*locked_chain, vecSend, tx, reservekey, nFeeRequired, nChangePosRet, strFailReason, coin_control))
+        return false;
+
+    CValidationState state;
+    if (!CommitTransaction(tx, {}, {}, reservekey, defaultConnman, state)) {
+        strFailReason = FormatStateMessage(state);
+        return false;
+    }
+    WalletLogPrintf("%s: merged %u outputs of %s into %u, fee %s\n", __func__, vSelected.size(), FormatMoney(nTotal), nOutputs, FormatMoney(nFeeRequired));
+    return true;
+}
+
+void MaybeTopUpKeyPools()
+{
+    for (const std::shared_ptr<CWallet>& pwallet : GetWallets()) {
+        pwallet->TopUpKeyPoolInBackground();
+    }
+}
+
+void MaybeConsolidateStakeOutputs()
+{
+    for (const std::shared_ptr<CWallet>& pwallet : GetWallets()) {
+        std::string strFailReason;
+        if (!pwallet->ConsolidateStakeOutputs(strFailReason) && !strFailReason.empty()) {
+            LogPrint(BCLog::COINSTAKE, "%s: %s\n", pwallet->GetDisplayName(), strFailReason);
+        }
+    }
+}
@@ -7,6 +7,7 @@
 #define BITCOIN_WALLET_WALLET_H
 
 #include <amount.h>
+#include <blockfilter.h>
 #include <interfaces/chain.h>
 #include <outputtype.h>
 #include <policy/feerate.h>
@@ -20,6 +21,7 @@
 #include <util/system.h>
 #include <wallet/crypter.h>
 #include <wallet/coinselection.h>
+#include <wallet/tokenledger.h>
 #include <wallet/walletdb.h>
 #include <wallet/walletutil.h>
 #include <consensus/params.h>
@@ -33,6 +35,7 @@
 #include <stdexcept>
 #include <stdint.h>
 #include <string>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -63,6 +66,12 @@ void UnloadWallets();
 //! by the shared pointer deleter.
 void UnloadWallet(std::shared_ptr<CWallet>&& wallet);
 
+//! Consolidate the outputs of the wallets with -stakeconsolidate, run by the scheduler
+void MaybeConsolidateStakeOutputs();
+
+//! Refill the keypools of the wallets a batch at a time, run by the scheduler
+void MaybeTopUpKeyPools();
+
 bool AddWallet(const std::shared_ptr<CWallet>& wallet);
 bool RemoveWallet(const std::shared_ptr<CWallet>& wallet);
 bool HasWallets();
@@ -72,6 +81,10 @@ std::shared_ptr<CWallet> LoadWallet(interfaces::Chain& chain, const WalletLocati
 
 //! Default for -keypool
 static const unsigned int DEFAULT_KEYPOOL_SIZE = 1000;
+//! Most keys of each kind generated by a run of the background keypool top-up
+static const unsigned int KEYPOOL_TOPUP_BATCH = 100;
+//! Milliseconds between the runs of the background keypool top-up
+static const int64_t KEYPOOL_TOPUP_INTERVAL = 250;
 //! -paytxfee default
 constexpr CAmount DEFAULT_PAY_TX_FEE = 0;
 //! -fallbackfee default
@@ -98,6 +111,14 @@ static const bool DEFAULT_WALLETBROADCAST = true;
 static const bool DEFAULT_DISABLE_WALLET = false;
 static const bool DEFAULT_USE_CHANGE_ADDRESS = true;
 static const CAmount DEFAULT_RESERVE_BALANCE = 0;
+//! Default for -stakeconsolidate
+static const bool DEFAULT_STAKE_CONSOLIDATE = false;
+//! -consolidatemaxfee default, consolidate only when the fee is at the minimum
+static const CAmount DEFAULT_CONSOLIDATE_MAX_FEE = DEFAULT_TRANSACTION_MINFEE;
+//! Fewest outputs below -consolidatetarget merged by a consolidation
+static const unsigned int CONSOLIDATE_MIN_INPUTS = 10;
+//! Milliseconds between the consolidation runs
+static const int64_t CONSOLIDATE_INTERVAL = 10 * 60 * 1000;
 
 //! Pre-calculated constants for input size estimation in *virtual size*
 static constexpr size_t DUMMY_NESTED_P2WPKH_INPUT_SIZE = 91;
@@ -647,6 +668,23 @@ struct CoinSelectionParams
 };
 
 class WalletRescanReserver; //forward declarations for ScanForWalletTransactions/RescanFromTime
+
+/**
+ * The coins of a wallet selected for staking with their stake data, and the tip, wallet
+ * changes, key store generation and reserve balance they were selected for.
+ */
+struct CStakeSnapshot
+{
+    uint256 hashTip;
+    uint64_t nChanges = 0;
+    uint64_t nKeyStoreGeneration = 0;
+    CAmount nReserveBalance = 0;
+    std::set<std::pair<const CWalletTx*,unsigned int> > setCoins;
+    std::vector<CStakeCandidate> candidates;
+    //! Whether every coin of setCoins is in candidates, see CWallet::GetStakeCandidates
+    bool fCandidatesComplete = true;
+};
+
 /**
  * A CWallet is an extension of a keystore, which also maintains a set of transactions and balances,
  * and provides the ability to create new transactions.
@@ -656,10 +694,17 @@ class CWallet final : public CCryptoKeyStore, public CValidationInterface
 private:
     std::atomic<bool> fAbortRescan{false};
     std::atomic<bool> fScanningWallet{false}; // controlled by WalletRescanReserver
+    //! Number of keys and scripts added to the key store, see GetKeyStoreGeneration
+    std::atomic<uint64_t> m_keystore_generation{0};
     std::mutex mutexScanning;
     friend class WalletRescanReserver;
 
     WalletBatch *encrypted_batch GUARDED_BY(cs_wallet) = nullptr;
+    //! Batch the writes are deferred to while a WalletBatchScope is open
+    WalletBatch *m_deferred_batch GUARDED_BY(cs_wallet) = nullptr;
+    friend class WalletBatchScope;
+    //! The deferred batch if a WalletBatchScope is open, else a new batch owned by batch_own
+    WalletBatch& GetWriteBatch(std::unique_ptr<WalletBatch>& batch_own, bool fFlushOnClose) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
     //! the current wallet version: clients below this version are not able to load the wallet
     int nWalletVersion = FEATURE_BASE;
@@ -673,6 +718,64 @@ private:
 
     std::map<COutPoint, CStakeCache> stakeCache;
 
+    /**
+     * Outputs of the wallet txs that are mine and not spent deeper than COINBASE_MATURITY.
+     * Kept up to date as transactions are added so that coin selection and each staking
+     * round only look at these instead of every output of mapWallet; depth, spent and
+     * locked state are checked when coins are selected. The outputs of a transaction are
+     * next to each other, in the order of mapWallet.
+     */
+    mutable std::set<COutPoint> setWalletOutputs GUARDED_BY(cs_wallet);
+    //! Key store generation setWalletOutputs was built for, see GetWalletOutputs
+    mutable uint64_t nWalletOutputsGeneration GUARDED_BY(cs_wallet) = 0;
+    void AddWalletOutputs(const CWalletTx& wtx) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void RemoveWalletOutputs(const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    //! Drop the outputs spent deeper than COINBASE_MATURITY or no longer in mapWallet
+    void PruneWalletOutputs(interfaces::Chain::Lock& locked_chain) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    //! setWalletOutputs, rebuilt first if keys or scripts were added since, which can make outputs of known txs mine
+    const std::set<COutPoint>& GetWalletOutputs() const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
+    //! Bumped by the changes to the wallet that can change the coins selected for staking and the balances,
+    //! under cs_wallet; atomic so the staker can tell whether its snapshot is current without the lock
+    std::atomic<uint64_t> nStakingChanges{0};
+
+    //! Result of GetStakeWeight, with the tip, wallet changes and reserve balance it was computed for
+    struct StakeWeightCache
+    {
+        bool fValid = false;
+        uint256 hashTip;
+        uint64_t nChanges = 0;
+        CAmount nReserveBalance = 0;
+        uint64_t nWeight = 0;
+    };
+    mutable StakeWeightCache stakeWeightCache GUARDED_BY(cs_wallet);
+
+    //! Last CStakeSnapshot built, replaced rather than modified so the staker can keep using it without locks
+    Mutex cs_stake_snapshot;
+    std::shared_ptr<const CStakeSnapshot> m_stake_snapshot GUARDED_BY(cs_stake_snapshot);
+
+    //! Kinds of balance totals kept in the balance cache
+    enum class BalanceKind { TRUSTED, UNCONFIRMED, IMMATURE, UNCONFIRMED_WATCH_ONLY, IMMATURE_WATCH_ONLY, STAKE, WATCH_ONLY_STAKE };
+
+    /**
+     * Balance totals by kind, filter and minimum depth, with the tip, wallet changes and key
+     * store generation they were computed for. Depths change the totals with every block, as
+     * coins mature and become trusted, so they are summed once per block or wallet change
+     * rather than on each call, of which the staker makes several per round.
+     */
+    struct BalanceCache
+    {
+        uint256 hashTip;
+        uint64_t nChanges = 0;
+        uint64_t nKeyStoreGeneration = 0;
+        std::map<std::tuple<BalanceKind, isminefilter, int>, CAmount> mapTotals;
+    };
+    mutable BalanceCache balanceCache GUARDED_BY(cs_wallet);
+    //! The cached total, if it is still valid
+    bool GetCachedBalance(interfaces::Chain::Lock& locked_chain, BalanceKind kind, const isminefilter& filter, int min_depth, CAmount& nTotal) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    //! Cache a total computed after GetCachedBalance found none, and return it
+    CAmount CacheBalance(BalanceKind kind, const isminefilter& filter, int min_depth, CAmount nTotal) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
     /**
      * Used to keep track of spent outpoints, and
      * detect and report conflicts (double-spends or
@@ -708,6 +811,9 @@ private:
 
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
+    /* Whether the tx is in the wallet or spends an output of a wallet tx, the checks of AddToWalletIfInvolvingMe besides its outputs */
+    bool IsKnownOrSpendsKnown(const CTransaction& tx) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
     /* Used by TransactionAddedToMemorypool/BlockConnected/Disconnected/ScanForWalletTransactions.
      * Should be called with non-zero block_hash and posInBlock if this is for a transaction that is included in a block. */
     void SyncTransaction(const CTransactionRef& tx, const uint256& block_hash, int posInBlock = 0, bool update_tx = true) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
@@ -810,6 +916,7 @@ public:
     /** Construct wallet with specified name and database implementation. */
     CWallet(interfaces::Chain& chain, const WalletLocation& location, std::unique_ptr<WalletDatabase> database) : m_chain(chain), m_location(location), database(std::move(database))
     {
+        RegisterLockStats(&cs_wallet, "cs_wallet");
     }
 
     ~CWallet()
@@ -844,6 +951,9 @@ public:
 
     std::map<uint256, CTokenTx> mapTokenTx;
 
+    //! mapToken by contract and address, with the balances of the entries
+    CTokenLedger tokenLedger;
+
     const CWalletTx* GetWalletTx(const uint256& hash) const;
 
     //! check whether we are allowed to upgrade (or already support) to the named feature
@@ -894,6 +1004,14 @@ public:
     bool IsAbortingRescan() { return fAbortRescan; }
     bool IsScanning() { return fScanningWallet; }
 
+    /**
+     * Changes whenever a key or script is added, so that IsMine results computed without
+     * cs_wallet, as by the threads of a rescan, can be checked for keys added since.
+     */
+    uint64_t GetKeyStoreGeneration() const { return m_keystore_generation; }
+    /** Every output script IsMine may be true for, to match block filters against. Bare multisig outputs are not included. */
+    GCSFilter::ElementSet GetFilterElements() const;
+
     /**
      * keystore implementation
      * Generate a new key
@@ -967,6 +1085,7 @@ public:
     void TransactionAddedToMempool(const CTransactionRef& tx) override;
     void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex *pindex, const std::vector<CTransactionRef>& vtxConflicted) override;
     void BlockDisconnected(const std::shared_ptr<const CBlock>& pblock) override;
+    void TokenTransfersConnected(const CBlockIndex *pindex, const std::vector<TokenTransferLog>& transfers) override;
     int64_t RescanFromTime(int64_t startTime, const WalletRescanReserver& reserver, bool update);
 
     struct ScanResult {
@@ -1019,7 +1138,16 @@ public:
     bool CommitTransaction(CTransactionRef tx, mapValue_t mapValue, std::vector<std::pair<std::string, std::string>> orderForm, CReserveKey& reservekey, CConnman* connman, CValidationState& state);
 
     uint64_t GetStakeWeight(interfaces::Chain::Lock& locked_chain) const;
-    bool CreateCoinStake(interfaces::Chain::Lock& locked_chain, const CKeyStore &keystore, unsigned int nBits, const CAmount& nTotalFees, uint32_t nTimeBlock, CMutableTransaction& tx, CKey& key, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoins);
+    /**
+     * The staking coins of the wallet at the tip. cs_wallet is only taken to select them again
+     * after the tip or the wallet changed, so the staking rounds on the same tip don't hold it
+     * and don't wait for the RPCs and the GUI reading the wallet, nor make them wait.
+     */
+    std::shared_ptr<const CStakeSnapshot> GetStakeSnapshot(interfaces::Chain::Lock& locked_chain);
+    //! Stake data of setCoins for FindStakeKernel, returns false if some super staker coins could not be included
+    bool GetStakeCandidates(interfaces::Chain::Lock& locked_chain, const std::set<std::pair<const CWalletTx*,unsigned int> >& setCoins, std::vector<CStakeCandidate>& candidates);
+    //! pprevoutKernel, if set, is the only coin of setCoins tried as the kernel, as found by FindStakeKernel
+    bool CreateCoinStake(interfaces::Chain::Lock& locked_chain, const CKeyStore &keystore, unsigned int nBits, const CAmount& nTotalFees, uint32_t nTimeBlock, CMutableTransaction& tx, CKey& key, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoins, const COutPoint* pprevoutKernel = nullptr);
     bool DummySignTx(CMutableTransaction &txNew, const std::set<CTxOut> &txouts, bool use_max_sig = false) const
     {
         std::vector<CTxOut> v_txouts(txouts.size());
@@ -1050,13 +1178,24 @@ public:
     std::atomic<bool> m_wallet_unlock_staking_only{false};
     bool m_use_change_address{DEFAULT_USE_CHANGE_ADDRESS};
     CAmount m_reserve_balance{DEFAULT_RESERVE_BALANCE};
+    //! Size outputs are merged to by ConsolidateStakeOutputs, 0 when -stakeconsolidate is off
+    CAmount m_consolidate_target{0};
+    //! Highest fee rate ConsolidateStakeOutputs pays, see -consolidatemaxfee
+    CFeeRate m_consolidate_max_fee{DEFAULT_CONSOLIDATE_MAX_FEE};
     int64_t m_last_coin_stake_search_time{0};
     int64_t m_last_coin_stake_search_interval{0};
     std::atomic<bool> m_enabled_staking{false};
 
     bool NewKeyPool();
     size_t KeypoolCountExternalKeys() EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
-    bool TopUpKeyPool(unsigned int kpSize = 0);
+    /** Fill the keypool up to kpSize keys (-keypool if 0), generating at most nMaxKeys keys of each kind if not 0 */
+    bool TopUpKeyPool(unsigned int kpSize = 0, unsigned int nMaxKeys = 0);
+    /**
+     * Generate the next batch of the keys missing from the keypool, if any. Reserving a key
+     * only generates one when the keypool is empty, so that sends, staking and getnewaddress
+     * do not wait for a large keypool to be derived and written; this refills it instead.
+     */
+    void TopUpKeyPoolInBackground();
     void AddKeypoolPubkey(const CPubKey& pubkey, const bool internal);
     void AddKeypoolPubkeyWithDB(const CPubKey& pubkey, const bool internal, WalletBatch& batch);
 
@@ -1319,12 +1458,30 @@ public:
     /* Remove token entry from the wallet */
     bool RemoveTokenEntry(const uint256& tokenHash, bool fFlushOnClose=true);
 
+    /* Get the balance of a token entry at the tip, if it is known without calling the contract */
+    bool GetTokenBalance(const std::string& contractAddress, const std::string& senderAddress, uint256& balance);
+
+    /* Set the balance of a token entry read with balanceOf at nHeight */
+    void SetTokenBalance(const std::string& contractAddress, const std::string& senderAddress, const uint256& balance, int64_t nHeight);
+
+    /* Carry the balance of a token entry forward once its events were read from nFromBlock to nToBlock */
+    void SetTokenScanned(const std::string& contractAddress, const std::string& senderAddress, int64_t nFromBlock, int64_t nToBlock, bool fOtherEvents);
+
     /* Start staking KPGs */
     void StartStake(CConnman* connman = CWallet::defaultConnman);
 
     /* Stop staking KPGs */
     void StopStake();
 
+    /**
+     * Merge the mature outputs below m_consolidate_target, smallest first and at most
+     * GetStakeMaxCombineInputs() of them, into outputs of about m_consolidate_target, so
+     * that staking, the kernel search and coin selection have fewer outputs to go through.
+     * Does nothing unless there are CONSOLIDATE_MIN_INPUTS such outputs and the fee rate is
+     * at most m_consolidate_max_fee. Returns whether a transaction was sent.
+     */
+    bool ConsolidateStakeOutputs(std::string& strFailReason);
+
     /* Clean token transaction entries in the wallet */
     bool CleanTokenTxEntries(bool fFlushOnClose=true);
 
@@ -1360,6 +1517,24 @@ public:
     void KeepScript() override { KeepKey(); }
 };
 
+/**
+ * RAII object grouping the wallet writes of a connected block or a send into one database
+ * transaction: the writes of the wallet txs and token entries are kept in memory while it is
+ * open and written together when it closes, instead of one by one. Nested scopes share the
+ * outermost one. cs_wallet must be held for the life of the scope.
+ */
+class WalletBatchScope
+{
+private:
+    CWallet& m_wallet;
+    std::unique_ptr<WalletBatch> m_batch;
+public:
+    explicit WalletBatchScope(CWallet& wallet) EXCLUSIVE_LOCKS_REQUIRED(wallet.cs_wallet);
+    ~WalletBatchScope();
+    WalletBatchScope(const WalletBatchScope&) = delete;
+    WalletBatchScope& operator=(const WalletBatchScope&) = delete;
+};
+
 /** RAII object to check and reserve a wallet rescan */
 class WalletRescanReserver
 {
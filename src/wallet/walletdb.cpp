@@ -18,6 +18,7 @@
 
 #include <atomic>
 #include <string>
+#include <thread>
 
 #include <boost/thread.hpp>
 
@@ -172,6 +173,75 @@ public:
     }
 };
 
+static bool ReadTxRecord(CDataStream& ssKey, CDataStream& ssValue, CWalletTx& wtx, bool& fUpgrade, std::string& strErr)
+{
+    uint256 hash;
+    ssKey >> hash;
+    ssValue >> wtx;
+    CValidationState state;
+    if (!(CheckTransaction(*wtx.tx, state) && (wtx.GetHash() == hash) && state.IsValid()))
+        return false;
+
+    // Undo serialize changes in 31600
+    if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703)
+    {
+        if (!ssValue.empty())
+        {
+            char fTmp;
+            char fUnused;
+            std::string unused_string;
+            ssValue >> fTmp >> fUnused >> unused_string;
+            strErr = strprintf("LoadWallet() upgrading tx ver=%d %d %s",
+                               wtx.fTimeReceivedIsTxTime, fTmp, hash.ToString());
+            wtx.fTimeReceivedIsTxTime = fTmp;
+        }
+        else
+        {
+            strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString());
+            wtx.fTimeReceivedIsTxTime = 0;
+        }
+        fUpgrade = true;
+    }
+    return true;
+}
+
+static void LoadTxRecord(CWallet* pwallet, const CWalletTx& wtx, bool fUpgrade, CWalletScanState& wss) EXCLUSIVE_LOCKS_REQUIRED(pwallet->cs_wallet)
+{
+    if (fUpgrade)
+        wss.vWalletUpgrade.push_back(wtx.GetHash());
+
+    if (wtx.nOrderPos == -1)
+        wss.fAnyUnordered = true;
+
+    pwallet->LoadToWallet(wtx);
+}
+
+static bool ReadTokenRecord(CDataStream& ssKey, CDataStream& ssValue, CTokenInfo& wtoken, std::string& strErr)
+{
+    uint256 hash;
+    ssKey >> hash;
+    ssValue >> wtoken;
+    if (wtoken.GetHash() != hash)
+    {
+        strErr = "Error reading wallet database: CTokenInfo corrupt";
+        return false;
+    }
+    return true;
+}
+
+static bool ReadTokenTxRecord(CDataStream& ssKey, CDataStream& ssValue, CTokenTx& wTokenTx, std::string& strErr)
+{
+    uint256 hash;
+    ssKey >> hash;
+    ssValue >> wTokenTx;
+    if (wTokenTx.GetHash() != hash)
+    {
+        strErr = "Error reading wallet database: CTokenTx corrupt";
+        return false;
+    }
+    return true;
+}
+
 static bool
 ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
              CWalletScanState &wss, std::string& strType, std::string& strErr) EXCLUSIVE_LOCKS_REQUIRED(pwallet->cs_wallet)
@@ -195,39 +265,11 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
         }
         else if (strType == "tx")
         {
-            uint256 hash;
-            ssKey >> hash;
             CWalletTx wtx(nullptr /* pwallet */, MakeTransactionRef());
-            ssValue >> wtx;
-            CValidationState state;
-            if (!(CheckTransaction(*wtx.tx, state) && (wtx.GetHash() == hash) && state.IsValid()))
+            bool fUpgrade = false;
+            if (!ReadTxRecord(ssKey, ssValue, wtx, fUpgrade, strErr))
                 return false;
-
-            // Undo serialize changes in 31600
-            if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703)
-            {
-                if (!ssValue.empty())
-                {
-                    char fTmp;
-                    char fUnused;
-                    std::string unused_string;
-                    ssValue >> fTmp >> fUnused >> unused_string;
-                    strErr = strprintf("LoadWallet() upgrading tx ver=%d %d %s",
-                                       wtx.fTimeReceivedIsTxTime, fTmp, hash.ToString());
-                    wtx.fTimeReceivedIsTxTime = fTmp;
-                }
-                else
-                {
-                    strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString());
-                    wtx.fTimeReceivedIsTxTime = 0;
-                }
-                wss.vWalletUpgrade.push_back(hash);
-            }
-
-            if (wtx.nOrderPos == -1)
-                wss.fAnyUnordered = true;
-
-            pwallet->LoadToWallet(wtx);
+            LoadTxRecord(pwallet, wtx, fUpgrade, wss);
         }
         else if (strType == "watchs")
         {
@@ -414,30 +456,16 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
         }
         else if (strType == "token")
         {
-            uint256 hash;
-            ssKey >> hash;
             CTokenInfo wtoken;
-            ssValue >> wtoken;
-            if (wtoken.GetHash() != hash)
-            {
-                strErr = "Error reading wallet database: CTokenInfo corrupt";
+            if (!ReadTokenRecord(ssKey, ssValue, wtoken, strErr))
                 return false;
-            }
-
             pwallet->LoadToken(wtoken);
         }
         else if (strType == "tokentx")
         {
-            uint256 hash;
-            ssKey >> hash;
             CTokenTx wTokenTx;
-            ssValue >> wTokenTx;
-            if (wTokenTx.GetHash() != hash)
-            {
-                strErr = "Error reading wallet database: CTokenTx corrupt";
+            if (!ReadTokenTxRecord(ssKey, ssValue, wTokenTx, strErr))
                 return false;
-            }
-
             pwallet->LoadTokenTx(wTokenTx);
         }
         else if (strType == "contractdata")
@@ -475,6 +503,72 @@ bool WalletBatch::IsKeyType(const std::string& strType)
             strType == "mkey" || strType == "ckey");
 }
 
+/** Number of transaction and token records decoded together while loading the wallet */
+static const size_t WALLET_LOAD_BATCH = 16384;
+/** Fewest records worth handing to a decoding thread */
+static const size_t WALLET_LOAD_MIN_RECORDS_PER_THREAD = 256;
+
+/**
+ * A record of the wallet database that doesn't depend on the rest of the wallet,
+ * so it is unserialized and checked off the loading thread and applied afterwards
+ * in the order it was read.
+ */
+struct WalletLoadRecord
+{
+    std::string strType;
+    CDataStream ssKey;
+    CDataStream ssValue;
+
+    bool fOk{false};
+    bool fUpgrade{false};
+    std::string strErr;
+    CWalletTx wtx{nullptr /* pwallet */, MakeTransactionRef()};
+    CTokenInfo token;
+    CTokenTx tokenTx;
+
+    WalletLoadRecord(CDataStream&& ssKeyIn, CDataStream&& ssValueIn) :
+        ssKey(std::move(ssKeyIn)), ssValue(std::move(ssValueIn)) {}
+
+    void Decode()
+    {
+        try {
+            ssKey >> strType;
+            if (strType == "tx")
+                fOk = ReadTxRecord(ssKey, ssValue, wtx, fUpgrade, strErr);
+            else if (strType == "token")
+                fOk = ReadTokenRecord(ssKey, ssValue, token, strErr);
+            else if (strType == "tokentx")
+                fOk = ReadTokenTxRecord(ssKey, ssValue, tokenTx, strErr);
+        } catch (...) {
+            fOk = false;
+        }
+        // The raw record isn't needed any more
+        ssKey.clear();
+        ssValue.clear();
+    }
+};
+
+static bool IsParallelLoadType(const std::string& strType)
+{
+    return strType == "tx" || strType == "token" || strType == "tokentx";
+}
+
+/** Decode the records on up to all cores, the calling thread included */
+static void DecodeWalletRecords(std::vector<WalletLoadRecord>& records)
+{
+    const size_t nParts = std::max<size_t>(1, std::min<size_t>(std::max(GetNumCores(), 1), records.size() / WALLET_LOAD_MIN_RECORDS_PER_THREAD));
+    auto decode = [&records](size_t nBegin, size_t nEnd) {
+        for (size_t i = nBegin; i < nEnd; i++)
+            records[i].Decode();
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < nParts; i++)
+        threads.emplace_back(decode, records.size() * i / nParts, records.size() * (i + 1) / nParts);
+    decode(0, records.size() / nParts);
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
 DBErrors WalletBatch::LoadWallet(CWallet* pwallet)
 {
     CWalletScanState wss;
@@ -499,6 +593,41 @@ DBErrors WalletBatch::LoadWallet(CWallet* pwallet)
             return DBErrors::CORRUPT;
         }
 
+        auto onError = [&](const std::string& strType) {
+            // losing keys is considered a catastrophic error, anything else
+            // we assume the user can live with:
+            if (IsKeyType(strType) || strType == "defaultkey") {
+                result = DBErrors::CORRUPT;
+            } else if(strType == "flags") {
+                // reading the wallet flags can only fail if unknown flags are present
+                result = DBErrors::TOO_NEW;
+            } else {
+                // Leave other errors alone, if we try to fix them we might make things worse.
+                fNoncriticalErrors = true; // ... but do warn the user there is something wrong.
+                if (strType == "tx")
+                    // Rescan if there is a bad transaction record:
+                    gArgs.SoftSetBoolArg("-rescan", true);
+            }
+        };
+
+        std::vector<WalletLoadRecord> deferred;
+        auto loadDeferred = [&]() EXCLUSIVE_LOCKS_REQUIRED(pwallet->cs_wallet) {
+            DecodeWalletRecords(deferred);
+            for (const WalletLoadRecord& record : deferred) {
+                if (!record.fOk)
+                    onError(record.strType);
+                else if (record.strType == "tx")
+                    LoadTxRecord(pwallet, record.wtx, record.fUpgrade, wss);
+                else if (record.strType == "token")
+                    pwallet->LoadToken(record.token);
+                else if (record.strType == "tokentx")
+                    pwallet->LoadTokenTx(record.tokenTx);
+                if (!record.strErr.empty())
+                    pwallet->WalletLogPrintf("%s\n", record.strErr);
+            }
+            deferred.clear();
+        };
+
         while (true)
         {
             // Read next record
@@ -513,29 +642,30 @@ DBErrors WalletBatch::LoadWallet(CWallet* pwallet)
                 return DBErrors::CORRUPT;
             }
 
+            // Transactions and tokens are decoded in parallel, in batches
+            std::string strType;
+            try {
+                CDataStream ssType(ssKey);
+                ssType >> strType;
+            } catch (...) {
+                strType.clear();
+            }
+            if (IsParallelLoadType(strType)) {
+                deferred.emplace_back(std::move(ssKey), std::move(ssValue));
+                if (deferred.size() >= WALLET_LOAD_BATCH)
+                    loadDeferred();
+                continue;
+            }
+
             // Try to be tolerant of single corrupt records:
-            std::string strType, strErr;
+            std::string strErr;
             if (!ReadKeyValue(pwallet, ssKey, ssValue, wss, strType, strErr))
-            {
-                // losing keys is considered a catastrophic error, anything else
-                // we assume the user can live with:
-                if (IsKeyType(strType) || strType == "defaultkey") {
-                    result = DBErrors::CORRUPT;
-                } else if(strType == "flags") {
-                    // reading the wallet flags can only fail if unknown flags are present
-                    result = DBErrors::TOO_NEW;
-                } else {
-                    // Leave other errors alone, if we try to fix them we might make things worse.
-                    fNoncriticalErrors = true; // ... but do warn the user there is something wrong.
-                    if (strType == "tx")
-                        // Rescan if there is a bad transaction record:
-                        gArgs.SoftSetBoolArg("-rescan", true);
-                }
-            }
+                onError(strType);
             if (!strErr.empty())
                 pwallet->WalletLogPrintf("%s\n", strErr);
         }
         pcursor->close();
+        loadDeferred();
     }
     catch (const boost::thread_interrupted&) {
         throw;
@@ -798,6 +928,36 @@ bool WalletBatch::WriteWalletFlags(const uint64_t flags)
     return WriteIC(std::string("flags"), flags);
 }
 
+void WalletBatch::DeferWrites()
+{
+    if (!m_deferred) {
+        m_deferred.reset(new std::map<CSerializeData, CSerializeData>());
+    }
+}
+
+bool WalletBatch::WriteDeferred()
+{
+    if (!m_deferred || m_deferred->empty()) {
+        return true;
+    }
+    // Without a transaction, as for a dummy database, the writes are still done one by one
+    const bool fTxn = m_batch.TxnBegin();
+    for (const auto& write : *m_deferred) {
+        CDataStream ssKey(write.first.begin(), write.first.end(), SER_DISK, CLIENT_VERSION);
+        CDataStream ssValue(write.second.begin(), write.second.end(), SER_DISK, CLIENT_VERSION);
+        if (!m_batch.Write(ssKey, ssValue)) {
+            if (fTxn) m_batch.TxnAbort();
+            return false;
+        }
+    }
+    if (fTxn && !m_batch.TxnCommit()) {
+        return false;
+    }
+    m_database.IncrementUpdateCounter();
+    m_deferred->clear();
+    return true;
+}
+
 bool WalletBatch::TxnBegin()
 {
     return m_batch.TxnBegin();
@@ -13,6 +13,8 @@
 #include <key.h>
 
 #include <list>
+#include <map>
+#include <memory>
 #include <stdint.h>
 #include <string>
 #include <utility>
@@ -155,6 +157,14 @@ private:
     template <typename K, typename T>
     bool WriteIC(const K& key, const T& value, bool fOverwrite = true)
     {
+        if (m_deferred && fOverwrite) {
+            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+            ssKey << key;
+            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+            ssValue << value;
+            (*m_deferred)[CSerializeData(ssKey.begin(), ssKey.end())] = CSerializeData(ssValue.begin(), ssValue.end());
+            return true;
+        }
         if (!m_batch.Write(key, value, fOverwrite)) {
             return false;
         }
@@ -247,6 +257,10 @@ public:
     bool WriteHDChain(const CHDChain& chain);
 
     bool WriteWalletFlags(const uint64_t flags);
+    //! Keep the overwriting writes in memory until WriteDeferred, which writes them in one transaction
+    void DeferWrites();
+    //! Write the deferred writes in one transaction, the last write of a key wins
+    bool WriteDeferred();
     //! Begin a new transaction
     bool TxnBegin();
     //! Commit current transaction
@@ -260,6 +274,8 @@ public:
 private:
     BerkeleyBatch m_batch;
     WalletDatabase& m_database;
+    //! Serialized values of the deferred writes by serialized key, null when writes are not deferred
+    std::unique_ptr<std::map<CSerializeData, CSerializeData>> m_deferred;
 };
 
 //! Compacts BDB state so that wallet.dat is self-contained (if there are changes)
@@ -12,7 +12,7 @@ CZMQAbstractNotifier::~CZMQAbstractNotifier()
     assert(!psocket);
 }
 
-bool CZMQAbstractNotifier::NotifyBlock(const CBlockIndex * /*CBlockIndex*/)
+bool CZMQAbstractNotifier::NotifyBlock(const CBlockIndex * /*CBlockIndex*/, const CBlock * /*pblock*/)
 {
     return true;
 }
@@ -21,3 +21,27 @@ bool CZMQAbstractNotifier::NotifyTransaction(const CTransaction &/*transaction*/
 {
     return true;
 }
+
+bool CZMQAbstractNotifier::NotifyBlockConnected(const CBlock &/*block*/, const CBlockIndex * /*pindex*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyStakingEvent(const StakingEvent &/*event*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyBlockReceipts(const CBlockIndex * /*pindex*/, const BlockReceipts &/*receipts*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyBlockStateDiff(const CBlockIndex * /*pindex*/, const BlockStateDiff &/*diff*/)
+{
+    return true;
+}
+
+void CZMQAbstractNotifier::SkipTransactions(uint64_t /*n*/)
+{
+}
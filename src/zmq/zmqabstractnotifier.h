@@ -5,10 +5,14 @@
 #ifndef BITCOIN_ZMQ_ZMQABSTRACTNOTIFIER_H
 #define BITCOIN_ZMQ_ZMQABSTRACTNOTIFIER_H
 
+#include <validationinterface.h>
 #include <zmq/zmqconfig.h>
 
+class CBlock;
 class CBlockIndex;
 class CZMQAbstractNotifier;
+struct BlockStateDiff;
+struct StakingEvent;
 
 typedef CZMQAbstractNotifier* (*CZMQNotifierFactory)();
 
@@ -40,8 +44,15 @@ public:
     virtual bool Initialize(void *pcontext) = 0;
     virtual void Shutdown() = 0;
 
-    virtual bool NotifyBlock(const CBlockIndex *pindex);
+    //! pblock is the block of pindex, read when the notification was queued, if a notifier publishes it
+    virtual bool NotifyBlock(const CBlockIndex *pindex, const CBlock *pblock);
     virtual bool NotifyTransaction(const CTransaction &transaction);
+    virtual bool NotifyBlockConnected(const CBlock &block, const CBlockIndex *pindex);
+    virtual bool NotifyStakingEvent(const StakingEvent &event);
+    virtual bool NotifyBlockReceipts(const CBlockIndex *pindex, const BlockReceipts &receipts);
+    virtual bool NotifyBlockStateDiff(const CBlockIndex *pindex, const BlockStateDiff &diff);
+    //! Called in place of NotifyTransaction for n transactions dropped from a full publish queue
+    virtual void SkipTransactions(uint64_t n);
 
 protected:
     void *psocket;
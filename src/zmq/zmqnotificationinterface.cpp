@@ -5,11 +5,16 @@
 #include <zmq/zmqnotificationinterface.h>
 #include <zmq/zmqpublishnotifier.h>
 
+#include <chainparams.h>
+#include <index/statediffindex.h>
 #include <version.h>
 #include <validation.h>
+#include <stakingstats.h>
 #include <streams.h>
 #include <util/system.h>
 
+#include <algorithm>
+
 void zmqError(const char *str)
 {
     LogPrint(BCLog::ZMQ, "zmq: Error: %s, errno=%s\n", str, zmq_strerror(errno));
@@ -21,8 +26,10 @@ CZMQNotificationInterface::CZMQNotificationInterface() : pcontext(nullptr)
 
 CZMQNotificationInterface::~CZMQNotificationInterface()
 {
+    StopPublishing();
     Shutdown();
 
+    LOCK(m_notifiers_mutex);
     for (std::list<CZMQAbstractNotifier*>::iterator i=notifiers.begin(); i!=notifiers.end(); ++i)
     {
         delete *i;
@@ -31,6 +38,7 @@ CZMQNotificationInterface::~CZMQNotificationInterface()
 
 std::list<const CZMQAbstractNotifier*> CZMQNotificationInterface::GetActiveNotifiers() const
 {
+    LOCK(m_notifiers_mutex);
     std::list<const CZMQAbstractNotifier*> result;
     for (const auto* n : notifiers) {
         result.push_back(n);
@@ -48,6 +56,11 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
     factories["pubhashtx"] = CZMQAbstractNotifier::Create<CZMQPublishHashTransactionNotifier>;
     factories["pubrawblock"] = CZMQAbstractNotifier::Create<CZMQPublishRawBlockNotifier>;
     factories["pubrawtx"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionNotifier>;
+    factories["pubrawlogs"] = CZMQAbstractNotifier::Create<CZMQPublishRawLogsNotifier>;
+    factories["pubrawreceipts"] = CZMQAbstractNotifier::Create<CZMQPublishRawReceiptsNotifier>;
+    factories["pubstateroots"] = CZMQAbstractNotifier::Create<CZMQPublishStateRootsNotifier>;
+    factories["pubstatediff"] = CZMQAbstractNotifier::Create<CZMQPublishStateDiffNotifier>;
+    factories["pubstakingevent"] = CZMQAbstractNotifier::Create<CZMQPublishStakingEventNotifier>;
 
     for (const auto& entry : factories)
     {
@@ -67,13 +80,25 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
     if (!notifiers.empty())
     {
         notificationInterface = new CZMQNotificationInterface();
-        notificationInterface->notifiers = notifiers;
+        for (const CZMQAbstractNotifier* notifier : notifiers) {
+            notificationInterface->m_publish_blocks |= notifier->GetType() == "pubrawblock";
+            notificationInterface->m_publish_state_diffs |= notifier->GetType() == "pubstatediff";
+        }
+        {
+            LOCK(notificationInterface->m_notifiers_mutex);
+            notificationInterface->notifiers = notifiers;
+        }
 
         if (!notificationInterface->Initialize())
         {
             delete notificationInterface;
             notificationInterface = nullptr;
         }
+        else if (gArgs.GetArg("-zmqqueuesize", DEFAULT_ZMQ_QUEUE_SIZE) > 0)
+        {
+            notificationInterface->m_max_queued = gArgs.GetArg("-zmqqueuesize", DEFAULT_ZMQ_QUEUE_SIZE);
+            notificationInterface->m_thread = std::thread(&TraceThread<std::function<void()>>, "zmqpub", std::function<void()>(std::bind(&CZMQNotificationInterface::ThreadPublish, notificationInterface)));
+        }
     }
 
     return notificationInterface;
@@ -89,6 +114,8 @@ bool CZMQNotificationInterface::Initialize()
     LogPrint(BCLog::ZMQ, "zmq: Initialize notification interface\n");
     assert(!pcontext);
 
+    LOCK(m_notifiers_mutex);
+
     pcontext = zmq_ctx_new();
 
     if (!pcontext)
@@ -126,6 +153,7 @@ void CZMQNotificationInterface::Shutdown()
     LogPrint(BCLog::ZMQ, "zmq: Shutdown notification interface\n");
     if (pcontext)
     {
+        LOCK(m_notifiers_mutex);
         for (std::list<CZMQAbstractNotifier*>::iterator i=notifiers.begin(); i!=notifiers.end(); ++i)
         {
             CZMQAbstractNotifier *notifier = *i;
@@ -138,15 +166,63 @@ void CZMQNotificationInterface::Shutdown()
     }
 }
 
-void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+CZMQNotificationInterface::QueueStats CZMQNotificationInterface::GetQueueStats() const
 {
-    if (fInitialDownload || pindexNew == pindexFork) // In IBD or blocks were disconnected without any new ones
-        return;
+    LOCK(m_mutex);
+    QueueStats stats;
+    stats.nQueued = m_queue.size();
+    stats.nMaxQueued = m_max_queued;
+    stats.nHighWater = m_high_water;
+    stats.nDropped = m_dropped;
+    return stats;
+}
+
+void CZMQNotificationInterface::StopPublishing()
+{
+    {
+        LOCK(m_mutex);
+        m_stop = true;
+        m_cond.notify_all();
+    }
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+void CZMQNotificationInterface::Enqueue(Notification&& notification, bool fTransaction)
+{
+    {
+        LOCK(m_mutex);
+        if (m_stop)
+            return;
+        if (m_thread.joinable())
+        {
+            if (fTransaction && m_queue.size() >= m_max_queued)
+            {
+                // Dropped transactions in a row are counted by one task, which keeps their place in the order
+                m_dropped++;
+                if (m_queue.empty() || m_queue.back().notification)
+                    m_queue.push_back(Task{Notification(), 0});
+                m_queue.back().nSkipped++;
+            }
+            else
+            {
+                m_queue.push_back(Task{std::move(notification), 0});
+                m_high_water = std::max(m_high_water, m_queue.size());
+            }
+            m_cond.notify_all();
+            return;
+        }
+    }
+    Notify(notification);
+}
 
+void CZMQNotificationInterface::Notify(const Notification& notification)
+{
+    LOCK(m_notifiers_mutex);
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
         CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyBlock(pindexNew))
+        if (notification(notifier))
         {
             i++;
         }
@@ -158,41 +234,112 @@ void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, co
     }
 }
 
-void CZMQNotificationInterface::TransactionAddedToMempool(const CTransactionRef& ptx)
+void CZMQNotificationInterface::ThreadPublish()
 {
-    // Used by BlockConnected and BlockDisconnected as well, because they're
-    // all the same external callback.
-    const CTransaction& tx = *ptx;
-
-    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+    while (true)
     {
-        CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyTransaction(tx))
+        Task task;
         {
-            i++;
+            WAIT_LOCK(m_mutex, lock);
+            while (!m_stop && m_queue.empty())
+                m_cond.wait(lock);
+            if (m_queue.empty())
+                return;
+            task = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+        if (task.notification)
+        {
+            Notify(task.notification);
         }
         else
         {
-            notifier->Shutdown();
-            i = notifiers.erase(i);
+            uint64_t nSkipped = task.nSkipped;
+            Notify([nSkipped](CZMQAbstractNotifier* notifier) {
+                notifier->SkipTransactions(nSkipped);
+                return true;
+            });
         }
     }
 }
 
+void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    if (fInitialDownload || pindexNew == pindexFork) // In IBD or blocks were disconnected without any new ones
+        return;
+
+    std::shared_ptr<const CBlock> pblock;
+    if (m_publish_blocks) {
+        if (m_last_connected_block && m_last_connected_block->GetHash() == pindexNew->GetBlockHash()) {
+            pblock = m_last_connected_block;
+        } else {
+            std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
+            if (ReadBlockFromDisk(*pblockRead, pindexNew, Params().GetConsensus()))
+                pblock = pblockRead;
+        }
+    }
+
+    Enqueue([pindexNew, pblock](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyBlock(pindexNew, pblock.get());
+    }, false);
+}
+
+void CZMQNotificationInterface::NotifyTransaction(const CTransactionRef& ptx)
+{
+    Enqueue([ptx](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyTransaction(*ptx);
+    }, true);
+}
+
+void CZMQNotificationInterface::TransactionAddedToMempool(const CTransactionRef& ptx)
+{
+    NotifyTransaction(ptx);
+}
+
 void CZMQNotificationInterface::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexConnected, const std::vector<CTransactionRef>& vtxConflicted)
 {
     for (const CTransactionRef& ptx : pblock->vtx) {
         // Do a normal notify for each transaction added in the block
-        TransactionAddedToMempool(ptx);
+        NotifyTransaction(ptx);
     }
+
+    Enqueue([pblock, pindexConnected](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyBlockConnected(*pblock, pindexConnected);
+    }, false);
+
+    if (m_publish_state_diffs) {
+        std::shared_ptr<BlockStateDiff> pdiff = std::make_shared<BlockStateDiff>();
+        if (ComputeBlockStateDiff(pindexConnected, *pdiff)) {
+            Enqueue([pindexConnected, pdiff](CZMQAbstractNotifier* notifier) {
+                return notifier->NotifyBlockStateDiff(pindexConnected, *pdiff);
+            }, false);
+        } else {
+            LogPrint(BCLog::ZMQ, "zmq: The state of block %s is not available, no statediff published\n", pindexConnected->GetBlockHash().GetHex());
+        }
+    }
+    m_last_connected_block = pblock;
 }
 
 void CZMQNotificationInterface::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock)
 {
     for (const CTransactionRef& ptx : pblock->vtx) {
         // Do a normal notify for each transaction removed in block disconnection
-        TransactionAddedToMempool(ptx);
+        NotifyTransaction(ptx);
     }
 }
 
+void CZMQNotificationInterface::NewStakingEvent(const StakingEvent& event)
+{
+    Enqueue([event](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyStakingEvent(event);
+    }, false);
+}
+
+void CZMQNotificationInterface::BlockReceiptsConnected(const CBlockIndex *pindex, const std::shared_ptr<const BlockReceipts>& preceipts)
+{
+    Enqueue([pindex, preceipts](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyBlockReceipts(pindex, *preceipts);
+    }, false);
+}
+
 CZMQNotificationInterface* g_zmq_notification_interface = nullptr;
@@ -5,14 +5,36 @@
 #ifndef BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
 #define BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
 
+#include <sync.h>
 #include <validationinterface.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <string>
 #include <map>
 #include <list>
+#include <thread>
 
 class CBlockIndex;
 class CZMQAbstractNotifier;
 
+/** Default for -zmqqueuesize, the notifications waiting for the publisher thread (0 = publish synchronously) */
+static const int DEFAULT_ZMQ_QUEUE_SIZE = 10000;
+
+/**
+ * Publishes the notifications of the validation interface to the ZMQ notifiers.
+ *
+ * The callbacks only queue the notifications, a thread of its own serializes and sends
+ * them in order, so large blocks and slow sockets don't hold up the wallet and the
+ * indexes on the validation interface thread. When -zmqqueuesize notifications are
+ * waiting, further transaction notifications are dropped; the hashtx and rawtx
+ * sequence numbers still advance for them, so subscribers can tell. Block and staking
+ * notifications are always queued.
+ *
+ * What a notification publishes is taken when it is queued: the raw block and the state
+ * diff of a block are got by the callback, so the publisher never reads the block files
+ * or the state, which pruning may have changed in between.
+ */
 class CZMQNotificationInterface final : public CValidationInterface
 {
 public:
@@ -20,6 +42,21 @@ public:
 
     std::list<const CZMQAbstractNotifier*> GetActiveNotifiers() const;
 
+    struct QueueStats
+    {
+        //! Notifications waiting for the publisher and the limit above which transactions are dropped
+        size_t nQueued = 0;
+        size_t nMaxQueued = 0;
+        //! Most notifications ever waiting at once
+        size_t nHighWater = 0;
+        //! Transaction notifications dropped because the queue was full
+        uint64_t nDropped = 0;
+    };
+    QueueStats GetQueueStats() const;
+
+    /** Publish the queued notifications and stop; later ones are dropped */
+    void StopPublishing();
+
     static CZMQNotificationInterface* Create();
 
 protected:
@@ -31,12 +68,45 @@ protected:
     void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexConnected, const std::vector<CTransactionRef>& vtxConflicted) override;
     void BlockDisconnected(const std::shared_ptr<const CBlock>& pblock) override;
     void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+    void NewStakingEvent(const StakingEvent& event) override;
+    void BlockReceiptsConnected(const CBlockIndex *pindex, const std::shared_ptr<const BlockReceipts>& receipts) override;
 
 private:
     CZMQNotificationInterface();
 
+    //! Given each notifier in turn, returns false for a notifier that failed and is shut down
+    typedef std::function<bool(CZMQAbstractNotifier*)> Notification;
+
+    struct Task
+    {
+        //! Null for a run of dropped transactions
+        Notification notification;
+        uint64_t nSkipped;
+    };
+
+    void Enqueue(Notification&& notification, bool fTransaction);
+    void Notify(const Notification& notification);
+    void NotifyTransaction(const CTransactionRef& ptx);
+    void ThreadPublish();
+
     void *pcontext;
-    std::list<CZMQAbstractNotifier*> notifiers;
+    //! Whether a notifier publishes the raw blocks and the state diffs, set up by Create
+    bool m_publish_blocks{false};
+    bool m_publish_state_diffs{false};
+    //! Last block of BlockConnected, the one UpdatedBlockTip usually notifies. The callbacks
+    //! of a subscriber are called one at a time and in order, no lock is needed.
+    std::shared_ptr<const CBlock> m_last_connected_block;
+    mutable Mutex m_notifiers_mutex;
+    std::list<CZMQAbstractNotifier*> notifiers GUARDED_BY(m_notifiers_mutex);
+
+    size_t m_max_queued{0};
+    mutable Mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<Task> m_queue GUARDED_BY(m_mutex);
+    size_t m_high_water GUARDED_BY(m_mutex){0};
+    uint64_t m_dropped GUARDED_BY(m_mutex){0};
+    bool m_stop GUARDED_BY(m_mutex){false};
+    std::thread m_thread;
 };
 
 extern CZMQNotificationInterface* g_zmq_notification_interface;
@@ -4,11 +4,17 @@
 
 #include <chain.h>
 #include <chainparams.h>
+#include <index/statediffindex.h>
 #include <streams.h>
 #include <zmq/zmqpublishnotifier.h>
 #include <validation.h>
 #include <util/system.h>
 #include <rpc/server.h>
+#include <util/convert.h>
+#include <stakingstats.h>
+#include <util/strencodings.h>
+
+#include <algorithm>
 
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
@@ -16,6 +22,11 @@ static const char *MSG_HASHBLOCK = "hashblock";
 static const char *MSG_HASHTX    = "hashtx";
 static const char *MSG_RAWBLOCK  = "rawblock";
 static const char *MSG_RAWTX     = "rawtx";
+static const char *MSG_RAWLOGS   = "rawlogs";
+static const char *MSG_RAWRECEIPTS = "rawreceipts";
+static const char *MSG_STATEROOTS = "stateroots";
+static const char *MSG_STATEDIFF = "statediff";
+static const char *MSG_STAKINGEVENT = "stakingevent";
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -157,7 +168,12 @@ bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* d
     return true;
 }
 
-bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
+void CZMQAbstractPublishNotifier::SkipMessages(uint64_t n)
+{
+    nSequence += n;
+}
+
+bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex, const CBlock * /*pblock*/)
 {
     uint256 hash = pindex->GetBlockHash();
     LogPrint(BCLog::ZMQ, "zmq: Publish hashblock %s\n", hash.GetHex());
@@ -177,24 +193,23 @@ bool CZMQPublishHashTransactionNotifier::NotifyTransaction(const CTransaction &t
     return SendMessage(MSG_HASHTX, data, 32);
 }
 
-bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
+void CZMQPublishHashTransactionNotifier::SkipTransactions(uint64_t n)
+{
+    SkipMessages(n);
+}
+
+bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex, const CBlock *pblock)
 {
     LogPrint(BCLog::ZMQ, "zmq: Publish rawblock %s\n", pindex->GetBlockHash().GetHex());
 
-    const Consensus::Params& consensusParams = Params().GetConsensus();
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+    if (!pblock)
     {
-        LOCK(cs_main);
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex, consensusParams))
-        {
-            zmqError("Can't read block from disk");
-            return false;
-        }
-
-        ss << block;
+        zmqError("Can't read block from disk");
+        return false;
     }
 
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+    ss << *pblock;
     return SendMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
 }
 
@@ -206,3 +221,105 @@ bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &tr
     ss << transaction;
     return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
 }
+
+void CZMQPublishRawTransactionNotifier::SkipTransactions(uint64_t n)
+{
+    SkipMessages(n);
+}
+
+/** Append an EVM log as published by rawlogs and rawreceipts: address, topics and data */
+static void SerializeLogEntry(CDataStream& ss, const dev::eth::LogEntry& log)
+{
+    ss.write((const char*)log.address.data(), log.address.size);
+    WriteCompactSize(ss, log.topics.size());
+    for (const dev::h256& topic : log.topics)
+        ss.write((const char*)topic.data(), topic.size);
+    ss << log.data;
+}
+
+bool CZMQPublishRawLogsNotifier::Initialize(void *pcontext)
+{
+    for (const std::string& strTopic : gArgs.GetArgs("-zmqpubrawlogstopic")) {
+        if (strTopic.size() != 64 || !IsHex(strTopic)) {
+            LogPrint(BCLog::ZMQ, "zmq: Invalid -zmqpubrawlogstopic %s, 32 bytes hex expected\n", strTopic);
+            return false;
+        }
+        setTopics.insert(uint256(ParseHex(strTopic)));
+    }
+    return CZMQAbstractPublishNotifier::Initialize(pcontext);
+}
+
+bool CZMQPublishRawLogsNotifier::NotifyBlockReceipts(const CBlockIndex *pindex, const BlockReceipts &receipts)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish rawlogs %s\n", pindex->GetBlockHash().GetHex());
+    for (const auto& txReceipts : receipts) {
+        for (const TransactionReceiptInfo& receipt : txReceipts.second) {
+            for (const dev::eth::LogEntry& log : receipt.logs) {
+                if (!setTopics.empty() && std::none_of(log.topics.begin(), log.topics.end(), [&](const dev::h256& topic) {
+                        return setTopics.count(h256Touint(topic)) != 0;
+                    }))
+                    continue;
+                // The contract address is part of the topic, so subscribers filtering on
+                // "rawlogs<address>" only receive that contract's logs.
+                std::string command = MSG_RAWLOGS + log.address.hex();
+                CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                ss << receipt.blockHash << receipt.blockNumber << receipt.transactionHash << receipt.transactionIndex << receipt.outputIndex;
+                SerializeLogEntry(ss, log);
+                if (!SendMessage(command.c_str(), &(*ss.begin()), ss.size()))
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool CZMQPublishRawReceiptsNotifier::NotifyBlockReceipts(const CBlockIndex *pindex, const BlockReceipts &blockReceipts)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish rawreceipts %s\n", pindex->GetBlockHash().GetHex());
+    std::vector<TransactionReceiptInfo> receipts;
+    for (const auto& txReceipts : blockReceipts)
+        receipts.insert(receipts.end(), txReceipts.second.begin(), txReceipts.second.end());
+
+    // One message per block, sent even without receipts so subscribers can tell the block was processed
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << pindex->GetBlockHash() << (uint32_t)pindex->nHeight;
+    WriteCompactSize(ss, receipts.size());
+    for (const TransactionReceiptInfo& receipt : receipts) {
+        ss << receipt.transactionHash << receipt.transactionIndex << receipt.outputIndex;
+        ss.write((const char*)receipt.from.data(), receipt.from.size);
+        ss.write((const char*)receipt.to.data(), receipt.to.size);
+        ss << receipt.cumulativeGasUsed << receipt.gasUsed;
+        ss.write((const char*)receipt.contractAddress.data(), receipt.contractAddress.size);
+        ss << static_cast<uint32_t>(receipt.excepted);
+        ss.write((const char*)receipt.stateRoot.data(), receipt.stateRoot.size);
+        ss.write((const char*)receipt.utxoRoot.data(), receipt.utxoRoot.size);
+        WriteCompactSize(ss, receipt.logs.size());
+        for (const dev::eth::LogEntry& log : receipt.logs)
+            SerializeLogEntry(ss, log);
+    }
+    return SendMessage(MSG_RAWRECEIPTS, &(*ss.begin()), ss.size());
+}
+
+bool CZMQPublishStateRootsNotifier::NotifyBlockConnected(const CBlock &block, const CBlockIndex *pindex)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish stateroots %s\n", pindex->GetBlockHash().GetHex());
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << pindex->GetBlockHash() << (uint32_t)pindex->nHeight << pindex->hashStateRoot << pindex->hashUTXORoot;
+    return SendMessage(MSG_STATEROOTS, &(*ss.begin()), ss.size());
+}
+
+bool CZMQPublishStateDiffNotifier::NotifyBlockStateDiff(const CBlockIndex *pindex, const BlockStateDiff &diff)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish statediff %s\n", pindex->GetBlockHash().GetHex());
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << pindex->GetBlockHash() << (uint32_t)pindex->nHeight << diff;
+    return SendMessage(MSG_STATEDIFF, &(*ss.begin()), ss.size());
+}
+
+bool CZMQPublishStakingEventNotifier::NotifyStakingEvent(const StakingEvent &event)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish stakingevent %s %s\n", StakingEventName(event.type), event.hashPrevBlock.GetHex());
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << static_cast<uint8_t>(event.type) << event.hashPrevBlock << event.hashBlock << event.nTime << event.nElapsed;
+    return SendMessage(MSG_STAKINGEVENT, &(*ss.begin()), ss.size());
+}
@@ -5,8 +5,11 @@
 #ifndef BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
 #define BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
 
+#include <uint256.h>
 #include <zmq/zmqabstractnotifier.h>
 
+#include <set>
+
 class CBlockIndex;
 
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier
@@ -24,6 +27,10 @@ public:
     */
     bool SendMessage(const char *command, const void* data, size_t size);
 
+    /* advance the sequence number past n messages that were not sent, so
+       subscribers see the gap */
+    void SkipMessages(uint64_t n);
+
     bool Initialize(void *pcontext) override;
     void Shutdown() override;
 };
@@ -31,25 +38,62 @@ public:
 class CZMQPublishHashBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
-    bool NotifyBlock(const CBlockIndex *pindex) override;
+    bool NotifyBlock(const CBlockIndex *pindex, const CBlock *pblock) override;
 };
 
 class CZMQPublishHashTransactionNotifier : public CZMQAbstractPublishNotifier
 {
 public:
     bool NotifyTransaction(const CTransaction &transaction) override;
+    void SkipTransactions(uint64_t n) override;
 };
 
 class CZMQPublishRawBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
-    bool NotifyBlock(const CBlockIndex *pindex) override;
+    bool NotifyBlock(const CBlockIndex *pindex, const CBlock *pblock) override;
 };
 
 class CZMQPublishRawTransactionNotifier : public CZMQAbstractPublishNotifier
 {
 public:
     bool NotifyTransaction(const CTransaction &transaction) override;
+    void SkipTransactions(uint64_t n) override;
+};
+
+class CZMQPublishRawLogsNotifier : public CZMQAbstractPublishNotifier
+{
+private:
+    //! Topics of -zmqpubrawlogstopic, logs with none of them aren't published; empty to publish all
+    std::set<uint256> setTopics;
+
+public:
+    bool Initialize(void *pcontext) override;
+    bool NotifyBlockReceipts(const CBlockIndex *pindex, const BlockReceipts &receipts) override;
+};
+
+class CZMQPublishRawReceiptsNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyBlockReceipts(const CBlockIndex *pindex, const BlockReceipts &receipts) override;
+};
+
+class CZMQPublishStateRootsNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyBlockConnected(const CBlock &block, const CBlockIndex *pindex) override;
+};
+
+class CZMQPublishStateDiffNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyBlockStateDiff(const CBlockIndex *pindex, const BlockStateDiff &diff) override;
+};
+
+class CZMQPublishStakingEventNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyStakingEvent(const StakingEvent &event) override;
 };
 
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
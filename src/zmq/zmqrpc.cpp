@@ -51,10 +51,46 @@ UniValue getzmqnotifications(const JSONRPCRequest& request)
     return result;
 }
 
+UniValue getzmqqueueinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0) {
+        throw std::runtime_error(
+            RPCHelpMan{"getzmqqueueinfo",
+                "\nReturns information about the queue of the ZeroMQ notifications waiting to be published.\n",
+                {},
+                RPCResult{
+            "{\n"
+            "  \"queued\": n,       (numeric) Notifications waiting to be published\n"
+            "  \"maxqueued\": n,    (numeric) Queued notifications above which transaction notifications are dropped, 0 if they are published synchronously\n"
+            "  \"highwater\": n,    (numeric) Most notifications waiting at once since startup\n"
+            "  \"dropped\": n       (numeric) Transaction notifications dropped because the queue was full\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getzmqqueueinfo", "")
+            + HelpExampleRpc("getzmqqueueinfo", "")
+                },
+            }.ToString());
+    }
+
+    CZMQNotificationInterface::QueueStats stats;
+    if (g_zmq_notification_interface != nullptr) {
+        stats = g_zmq_notification_interface->GetQueueStats();
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("queued", (uint64_t)stats.nQueued);
+    result.pushKV("maxqueued", (uint64_t)stats.nMaxQueued);
+    result.pushKV("highwater", (uint64_t)stats.nHighWater);
+    result.pushKV("dropped", stats.nDropped);
+    return result;
+}
+
 const CRPCCommand commands[] =
 { //  category              name                                actor (function)                argNames
   //  -----------------     ------------------------            -----------------------         ----------
     { "zmq",                "getzmqnotifications",              &getzmqnotifications,           {} },
+    { "zmq",                "getzmqqueueinfo",                  &getzmqqueueinfo,               {} },
 };
 
 } // anonymous namespace
@@ -2,15 +2,17 @@
 # Copyright (c) 2014-2018 The Bitcoin Core developers
 # Distributed under the MIT software license, see the accompanying
 # file COPYING or http://www.opensource.org/licenses/mit-license.php.
-"""Test running bitcoind with -reindex and -reindex-chainstate options.
+"""Test running bitcoind with -reindex, -reindex-chainstate and -reindex-indexes options.
 
 - Start a single node and generate 3 blocks.
 - Stop the node and restart it with -reindex. Verify that the node has reindexed up to block 3.
 - Stop the node and restart it with -reindex-chainstate. Verify that the node has reindexed up to block 3.
+- Stop the node and restart it with -txindex and -reindex-indexes. Verify that the transaction index
+  is built again without the chain changing.
 """
 
 from test_framework.test_framework import BitcoinTestFramework
-from test_framework.util import wait_until
+from test_framework.util import assert_equal, wait_until
 
 class ReindexTest(BitcoinTestFramework):
 
@@ -27,11 +29,22 @@ class ReindexTest(BitcoinTestFramework):
         wait_until(lambda: self.nodes[0].getblockcount() == blockcount)
         self.log.info("Success")
 
+    def reindex_indexes(self):
+        self.nodes[0].generatetoaddress(3, self.nodes[0].get_deterministic_priv_key().address)
+        blockcount = self.nodes[0].getblockcount()
+        coinbase = self.nodes[0].getblock(self.nodes[0].getbestblockhash())['tx'][0]
+        self.stop_nodes()
+        self.start_nodes([["-txindex", "-reindex-indexes"]])
+        assert_equal(self.nodes[0].getblockcount(), blockcount)
+        assert_equal(self.nodes[0].getrawtransaction(coinbase, True)['txid'], coinbase)
+        self.log.info("Success")
+
     def run_test(self):
         self.reindex(False)
         self.reindex(True)
         self.reindex(False)
         self.reindex(True)
+        self.reindex_indexes()
 
 if __name__ == '__main__':
     ReindexTest().main()
@@ -24,7 +24,7 @@ from test_framework.util import (
     hex_str_to_bytes,
 )
 
-from test_framework.messages import CBlockHeader
+from test_framework.messages import CBlockHeader, deser_string
 
 BLOCK_HEADER_SIZE = len(CBlockHeader().serialize())
 
@@ -284,6 +284,21 @@ class RESTTest (BitcoinTestFramework):
         json_obj = self.test_rest_request("/headers/5/{}".format(bb_hash))
         assert_equal(len(json_obj), 5)  # now we should have 5 header objects
 
+        self.log.info("Test the /blockrange URI")
+        height = json_obj[0]['height']
+        stream = BytesIO(self.test_rest_request("/blockrange/undo/3/{}".format(height), req_type=ReqType.BIN, ret_type=RetType.BYTES))
+        for i in range(3):
+            assert_equal(unpack("<I", stream.read(4))[0], height + i)
+            block_hash = binascii.hexlify(stream.read(32)[::-1]).decode('utf-8')
+            assert_equal(block_hash, json_obj[i]['hash'])
+            raw_block = deser_string(stream)
+            assert_equal(raw_block, self.test_rest_request("/block/{}".format(block_hash), req_type=ReqType.BIN, ret_type=RetType.BYTES))
+            deser_string(stream)  # undo data
+        assert_equal(stream.read(), b'')
+        self.test_rest_request("/blockrange/0/{}".format(height), req_type=ReqType.BIN, status=400, ret_type=RetType.OBJ)
+        self.test_rest_request("/blockrange/1/1000000", req_type=ReqType.BIN, status=404, ret_type=RetType.OBJ)
+        self.test_rest_request("/blockrange/1/{}".format(height), status=404, ret_type=RetType.OBJ)
+
         self.log.info("Test tx inclusion in the /mempool and /block URIs")
 
         # Make 3 tx and mine them on node 1
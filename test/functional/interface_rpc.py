@@ -5,7 +5,7 @@
 """Tests some generic aspects of the RPC interface."""
 
 from test_framework.test_framework import BitcoinTestFramework
-from test_framework.util import assert_equal, assert_greater_than_or_equal
+from test_framework.util import assert_equal, assert_greater_than_or_equal, assert_raises_rpc_error
 
 class RPCInterfaceTest(BitcoinTestFramework):
     def set_test_params(self):
@@ -48,9 +48,68 @@ class RPCInterfaceTest(BitcoinTestFramework):
         assert_equal(result_by_id[3]['error'], None)
         assert result_by_id[3]['result'] is not None
 
+        self.log.info("Testing the order of the replies of a batch run on several threads...")
+        genesis = self.nodes[0].getblockhash(0)
+        requests = [{"method": "getblockhash", "params": [0], "id": i} for i in range(50)]
+        requests.insert(25, {"method": "invalidmethod", "id": "invalid"})
+        results = self.nodes[0].batch(requests)
+        assert_equal([res["id"] for res in results], [req["id"] for req in requests])
+        for res in results:
+            if res["id"] == "invalid":
+                assert_equal(res['error']['code'], -32601)
+            else:
+                assert_equal(res['result'], genesis)
+
+    def test_streamed_reply(self):
+        self.log.info("Testing streamed replies...")
+        node = self.nodes[0]
+        node.generatetoaddress(2, node.get_deterministic_priv_key().address)
+        blockhash = node.getbestblockhash()
+        # getblock is streamed, getblockheader is not; the connection is opened again after a streamed reply
+        block = node.getblock(blockhash, 2)
+        assert_equal(block['hash'], blockhash)
+        assert_equal(block['tx'][0]['txid'], node.getblock(blockhash)['tx'][0])
+        assert_equal(node.getblockheader(blockhash)['hash'], blockhash)
+        assert_equal(node.getrawmempool(True), {})
+
+    def test_getrpcstats(self):
+        self.log.info("Testing getrpcstats...")
+        node = self.nodes[0]
+        node.getblockcount()
+        assert_raises_rpc_error(-8, None, node.getblockhash, -1)
+        stats = node.getrpcstats()
+        assert_equal(len(stats['buckets_ms']) + 1, len(stats['methods']['getblockcount']['histogram']))
+        assert_greater_than_or_equal(stats['methods']['getblockcount']['count'], 1)
+        assert_equal(stats['methods']['getblockcount']['errors'], 0)
+        assert_greater_than_or_equal(stats['methods']['getblockhash']['errors'], 1)
+        assert_equal(stats['methods']['getrpcstats']['inflight'], 1)
+        assert_equal(stats['workqueue']['rejected'], 0)
+        assert_greater_than_or_equal(stats['workqueue']['busy'], 1)
+
+    def test_response_cache(self):
+        self.log.info("Testing the response cache...")
+        node = self.nodes[0]
+        node.generatetoaddress(101, node.get_deterministic_priv_key().address)
+        blockhash = node.getblockhash(1)
+        block = node.getblock(blockhash)
+        hits = node.getrpcstats()['cache']['hits']
+        assert_equal(node.getblock(blockhash), block)
+        assert_equal(node.getrpcstats()['cache']['hits'], hits + 1)
+        # The confirmations of a cached block follow the tip
+        node.generatetoaddress(1, node.get_deterministic_priv_key().address)
+        assert_equal(node.getblock(blockhash)['confirmations'], block['confirmations'] + 1)
+        # Results about recent blocks are not cached
+        tiphash = node.getbestblockhash()
+        entries = node.getrpcstats()['cache']['entries']
+        node.getblock(tiphash)
+        assert_equal(node.getrpcstats()['cache']['entries'], entries)
+
     def run_test(self):
         self.test_getrpcinfo()
         self.test_batch_request()
+        self.test_streamed_reply()
+        self.test_getrpcstats()
+        self.test_response_cache()
 
 
 if __name__ == '__main__':
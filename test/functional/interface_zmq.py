@@ -135,5 +135,11 @@ class ZMQTest (BitcoinTestFramework):
 
         assert_equal(self.nodes[1].getzmqnotifications(), [])
 
+        self.log.info("Test the getzmqqueueinfo RPC")
+        queueinfo = self.nodes[0].getzmqqueueinfo()
+        assert_equal(queueinfo["maxqueued"], 10000)
+        assert_equal(queueinfo["dropped"], 0)
+        assert queueinfo["highwater"] > 0
+
 if __name__ == '__main__':
     ZMQTest().main()
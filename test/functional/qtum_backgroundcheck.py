@@ -0,0 +1,40 @@
+#!/usr/bin/env python3
+# Copyright (c) 2016-2019 The KPG Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the block verification continued in the background with -backgroundcheck."""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.test_node import ErrorMatch
+from test_framework.util import *
+from test_framework.qtumconfig import *
+
+
+class QtumBackgroundCheckTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 20)
+        height = node.getblockcount()
+        assert('backgroundcheck' not in node.getblockchaininfo())
+
+        # Only the last blocks are verified at startup, the rest once the node runs
+        with node.assert_debug_log(['Verifying last 2 blocks at level 3', 'Verifying last %d blocks at level 4 in the background' % height]):
+            self.restart_node(0, ['-backgroundcheck=warn', '-checkblocks=0', '-checklevel=4'])
+            wait_until(lambda: node.getblockchaininfo()['backgroundcheck']['status'] == 'done')
+        check = node.getblockchaininfo()['backgroundcheck']
+        assert_equal(check['height'], 1)
+        assert_equal(node.getblockchaininfo()['warnings'], '')
+
+        self.restart_node(0, ['-backgroundcheck=halt', '-checkblocks=10'])
+        wait_until(lambda: node.getblockchaininfo()['backgroundcheck']['status'] == 'done')
+        assert_equal(node.getblockchaininfo()['backgroundcheck']['height'], height - 9)
+
+        self.stop_node(0)
+        node.assert_start_raises_init_error(['-backgroundcheck=sometimes'], 'Unknown -backgroundcheck mode: sometimes', match=ErrorMatch.PARTIAL_REGEX)
+
+if __name__ == '__main__':
+    QtumBackgroundCheckTest().main()
@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the block change waiters during initial block download.
+
+During initial block download the waiters of waitfornewblock, waitforblock and
+waitforblockheight are only woken once per 100ms. Check that they still see the
+tip the sync ends on, and that their timeouts hold while the node syncs.
+"""
+import threading
+import time
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, connect_nodes_bi, get_rpc_proxy, sync_blocks
+
+BLOCKS = 1000
+TIMEOUT = 120000
+
+
+class Waiter(threading.Thread):
+    def __init__(self, node, method, *args):
+        threading.Thread.__init__(self)
+        self.rpc = get_rpc_proxy(node.url, 1, timeout=600, coveragedir=node.coverage_dir)
+        self.method = method
+        self.args = args
+        self.result = None
+
+    def run(self):
+        self.result = getattr(self.rpc, self.method)(*self.args)
+
+
+class QtumBlockChangeWaitersTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+
+    def setup_network(self):
+        self.setup_nodes()
+
+    def run_test(self):
+        # Blocks a day old keep the syncing node in initial block download
+        self.nodes[0].setmocktime(int(time.time()) - 24 * 60 * 60)
+        self.nodes[0].generate(BLOCKS)
+        tip = self.nodes[0].getbestblockhash()
+        assert self.nodes[1].getblockchaininfo()['initialblockdownload']
+
+        # A timeout expires although no notification comes
+        start = time.time()
+        ret = self.nodes[1].waitfornewblock(500)
+        assert time.time() - start >= 0.5
+        assert_equal(ret['height'], 0)
+
+        waiters = [
+            Waiter(self.nodes[1], 'waitforblockheight', BLOCKS, TIMEOUT),
+            Waiter(self.nodes[1], 'waitforblock', tip, TIMEOUT),
+            Waiter(self.nodes[1], 'waitfornewblock', TIMEOUT),
+        ]
+        for waiter in waiters:
+            waiter.start()
+        time.sleep(1)
+        connect_nodes_bi(self.nodes, 0, 1)
+        sync_blocks(self.nodes)
+        assert self.nodes[1].getblockchaininfo()['initialblockdownload']
+
+        # The waiters for the last block see it, whether its notification was coalesced or not
+        for waiter in waiters:
+            waiter.join(TIMEOUT / 1000)
+            assert not waiter.is_alive()
+        assert_equal(waiters[0].result, {'hash': tip, 'height': BLOCKS})
+        assert_equal(waiters[1].result, {'hash': tip, 'height': BLOCKS})
+        new_block = waiters[2].result
+        assert new_block['height'] >= 1
+        assert_equal(new_block['hash'], self.nodes[1].getblockhash(new_block['height']))
+
+        # Waiting for a height not reached returns the tip once the timeout expires
+        start = time.time()
+        ret = self.nodes[1].waitforblockheight(BLOCKS + 1, 300)
+        assert time.time() - start >= 0.3
+        assert_equal(ret, {'hash': tip, 'height': BLOCKS})
+
+        # A block connected after the sync wakes a waiter with no timeout as well
+        waiter = Waiter(self.nodes[1], 'waitforblockheight', BLOCKS + 1)
+        waiter.start()
+        tip = self.nodes[0].generate(1)[0]
+        waiter.join(TIMEOUT / 1000)
+        assert not waiter.is_alive()
+        assert_equal(waiter.result, {'hash': tip, 'height': BLOCKS + 1})
+
+
+if __name__ == '__main__':
+    QtumBlockChangeWaitersTest().main()
@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test that the contract state written once per block keeps the roots of each transaction."""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal
+from test_framework.qtumconfig import COINBASE_MATURITY
+
+# Adds its argument to a storage slot and returns the sum when called with 5b9af12b
+CONTRACT = "6060604052600d600055341561001457600080fd5b61017e806100236000396000f30060606040526004361061004c576000357c0100000000000000000000000000000000000000000000000000000000900463ffffffff168063027c1aaf1461004e5780635b9af12b14610058575b005b61005661008f565b005b341561006357600080fd5b61007960048080359060200190919050506100a1565b6040518082815260200191505060405180910390f35b60026000808282540292505081905550565b60007fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a17fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a1816000540160008190555060005490509190505600a165627a7a7230582015732bfa66bdede47ecc05446bf4c1e8ed047efac25478cb13b795887df70f290029"
+ADD = "5b9af12b"
+
+def trie_root(block_root):
+    return bytes.fromhex(block_root)[::-1].hex()
+
+class QtumBlockCommitTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+        self.extra_args = [['-logevents']]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def value(self, contract):
+        return int(self.nodes[0].callcontract(contract, ADD + "0" * 64)['executionResult']['output'], 16)
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 10)
+        contract = node.createcontract(CONTRACT)['address']
+        node.generate(1)
+        prev = node.getblock(node.getbestblockhash())
+
+        self.log.info("Calls of the same contract in one block")
+        for i in range(1, 6):
+            node.sendtocontract(contract, ADD + hex(i)[2:].zfill(64))
+        block = node.getblock(node.generate(1)[0])
+        assert_equal(self.value(contract), 13 + 15)
+
+        # Every receipt has the roots after its own transaction, the last one those of the block
+        roots = [trie_root(prev['hashStateRoot'])]
+        for txid in block['tx']:
+            for receipt in node.gettransactionreceipt(txid):
+                roots.append(receipt['stateRoot'])
+        assert_equal(len(roots), 6)
+        assert_equal(len(set(roots)), 6)
+        assert_equal(roots[-1], trie_root(block['hashStateRoot']))
+
+        self.log.info("The state of the block is on disk after a restart")
+        self.restart_node(0, ['-logevents', '-checklevel=4', '-checkblocks=5'])
+        assert_equal(self.value(contract), 13 + 15)
+        assert(node.verifycontractstate(block['hash'])['valid'])
+        assert(node.verifycontractstate(prev['hash'])['valid'])
+
+if __name__ == '__main__':
+    QtumBlockCommitTest().main()
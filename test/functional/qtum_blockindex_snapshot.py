@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test loading the block index from the snapshot written at shutdown.
+
+The block index read back must be the same whether it comes from the snapshot or
+from the database, and a stale, damaged or missing snapshot falls back to the
+database.
+"""
+import os
+import shutil
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal
+
+class QtumBlockIndexSnapshotTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+        self.extra_args = [['-par=3']]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def snapshot_path(self):
+        return os.path.join(self.nodes[0].datadir, 'regtest', 'blocks', 'index-snapshot.dat')
+
+    def block_index(self):
+        node = self.nodes[0]
+        tips = sorted(node.getchaintips(), key=lambda tip: tip['hash'])
+        headers = [node.getblockheader(node.getblockhash(h)) for h in range(0, node.getblockcount() + 1, 7)]
+        for h in headers:
+            h.pop('confirmations')
+        return {'tips': tips, 'headers': headers, 'best': node.getbestblockhash()}
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(150)
+        # A fork that stays marked invalid
+        invalid = node.getblockhash(140)
+        node.invalidateblock(invalid)
+        node.generate(20)
+        expected = self.block_index()
+
+        self.log.info("The block index is loaded from the snapshot written at shutdown")
+        self.stop_node(0)
+        assert os.path.isfile(self.snapshot_path())
+        with node.assert_debug_log(["block index entries from the snapshot"]):
+            self.start_node(0)
+        assert_equal(self.block_index(), expected)
+        assert_equal(node.getblockheader(invalid)['confirmations'], -1)
+
+        self.log.info("A stale snapshot is ignored")
+        self.stop_node(0)
+        stale = self.snapshot_path() + '.stale'
+        shutil.copyfile(self.snapshot_path(), stale)
+        self.start_node(0)
+        node.generate(5)
+        expected = self.block_index()
+        self.stop_node(0)
+        shutil.copyfile(stale, self.snapshot_path())
+        with node.assert_debug_log(["ignoring the stale block index snapshot"]):
+            self.start_node(0)
+        assert_equal(self.block_index(), expected)
+
+        self.log.info("A damaged snapshot is ignored")
+        self.stop_node(0)
+        size = os.path.getsize(self.snapshot_path())
+        with open(self.snapshot_path(), 'r+b') as f:
+            f.truncate(size // 2)
+        with node.assert_debug_log(["failed to read the block index snapshot"]):
+            self.start_node(0)
+        assert_equal(self.block_index(), expected)
+
+        self.log.info("The block index is loaded from the database on several threads")
+        self.stop_node(0)
+        os.remove(self.snapshot_path())
+        self.start_node(0, ['-par=4', '-blockindexsnapshot=0'])
+        assert_equal(self.block_index(), expected)
+        self.stop_node(0)
+        assert not os.path.exists(self.snapshot_path())
+
+if __name__ == '__main__':
+    QtumBlockIndexSnapshotTest().main()
@@ -0,0 +1,63 @@
+#!/usr/bin/env python3
+# Copyright (c) 2015-2016 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import *
+from test_framework.qtum import *
+from test_framework.qtumconfig import *
+from test_framework.messages import CInv, MSG_BLOCK, MSG_WITNESS_FLAG, msg_getdata
+from test_framework.mininode import P2PInterface, mininode_lock
+
+
+class BlockServeTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 3
+        self.extra_args = [['-blockservethreads=2'], [], []]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def setup_network(self):
+        self.setup_nodes()
+
+    def run_test(self):
+        self.nodes[0].generate(COINBASE_MATURITY+10)
+
+        # Two peers syncing the chain at the same time, each served by the block server threads
+        connect_nodes_bi(self.nodes, 0, 1)
+        connect_nodes_bi(self.nodes, 0, 2)
+        self.sync_blocks()
+
+        # New blocks and txs are still relayed in order
+        txid = self.nodes[0].sendtoaddress(self.nodes[1].getnewaddress(), 1)
+        self.sync_mempools()
+        assert_equal(self.nodes[2].getrawmempool(), [txid])
+        self.nodes[1].generate(1)
+        self.sync_all()
+        assert_equal(self.nodes[0].getrawmempool(), [])
+        assert_equal(self.nodes[0].getbestblockhash(), self.nodes[2].getbestblockhash())
+
+        # Blocks sent from their raw bytes, and again from the cache, match the blocks on disk
+        tip = self.nodes[0].getbestblockhash()
+        raw = self.nodes[0].getblock(tip, 0)
+        peer = self.nodes[0].add_p2p_connection(P2PInterface())
+        for i in range(2):
+            for inv_type in [MSG_BLOCK | MSG_WITNESS_FLAG, MSG_BLOCK]:
+                with mininode_lock:
+                    peer.last_message.pop('block', None)
+                peer.send_message(msg_getdata([CInv(inv_type, int(tip, 16))]))
+                peer.wait_for_block(int(tip, 16))
+                with mininode_lock:
+                    block = peer.last_message['block'].block
+                if inv_type == MSG_BLOCK:
+                    # A plain block request gets the block stripped of its witness data
+                    assert all(tx.wit.is_null() for tx in block.vtx)
+                    assert_equal(block.serialize(with_witness=False).hex(), block.serialize(with_witness=True).hex())
+                else:
+                    assert_equal(block.serialize(with_witness=True).hex(), raw)
+
+if __name__ == '__main__':
+    BlockServeTest().main()
@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test that contract calls and storage reads at a past block use the state and DGP parameters of that block."""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, assert_raises_rpc_error
+from test_framework.qtum import DGPState
+from test_framework.qtumconfig import COINBASE_MATURITY
+
+# Adds its argument to a storage slot, emitting two logs, and returns the sum when called with 5b9af12b
+CONTRACT = "6060604052600d600055341561001457600080fd5b61017e806100236000396000f30060606040526004361061004c576000357c0100000000000000000000000000000000000000000000000000000000900463ffffffff168063027c1aaf1461004e5780635b9af12b14610058575b005b61005661008f565b005b341561006357600080fd5b61007960048080359060200190919050506100a1565b6040518082815260200191505060405180910390f35b60026000808282540292505081905550565b60007fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a17fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a1816000540160008190555060005490509190505600a165627a7a7230582015732bfa66bdede47ecc05446bf4c1e8ed047efac25478cb13b795887df70f290029"
+ADD = "5b9af12b"
+# The gas schedule of qtum_dgp_gas_schedule.py, with a log costing 374000 gas
+GAS_SCHEDULE_CONTRACT = "60806040526104e060405190810160405280600a62ffffff168152602001600a62ffffff168152602001600a62ffffff168152602001600a62ffffff168152602001600a62ffffff168152602001600a62ffffff168152602001600a62ffffff168152602001600a62ffffff168152602001600a62ffffff168152602001603262ffffff168152602001601e62ffffff168152602001600662ffffff16815260200160c862ffffff16815260200160c962ffffff16815260200161138862ffffff168152602001613a9862ffffff168152602001600162ffffff1681526020016205b4f062ffffff168152602001600862ffffff16815260200161017762ffffff168152602001617d0062ffffff1681526020016102bc62ffffff1681526020016108fc62ffffff16815260200161232862ffffff1681526020016161a862ffffff168152602001615dc062ffffff168152602001600362ffffff16815260200161020062ffffff16815260200160c862ffffff16815260200161520862ffffff16815260200161cf0862ffffff168152602001600462ffffff168152602001604462ffffff168152602001600362ffffff1681526020016102bc62ffffff1681526020016102bc62ffffff16815260200161019062ffffff16815260200161138862ffffff16815260200161600062ffffff168152506000906027610206929190610219565b5034801561021357600080fd5b506102ee565b8260276007016008900481019282156102aa5791602002820160005b8382111561027857835183826101000a81548163ffffffff021916908362ffffff1602179055509260200192600401602081600301049283019260010302610235565b80156102a85782816101000a81549063ffffffff0219169055600401602081600301049283019260010302610278565b505b5090506102b791906102bb565b5090565b6102eb91905b808211156102e757600081816101000a81549063ffffffff0219169055506001016102c1565b5090565b90565b610160806102fd6000396000f300608060405260043610610041576000357c0100000000000000000000000000000000000000000000000000000000900463ffffffff16806326fadbe214610046575b600080fd5b34801561005257600080fd5b5061005b610099565b6040518082602760200280838360005b8381101561008657808201518184015260208101905061006b565b5050505090500191505060405180910390f35b6100a1610110565b6000602780602002604051908101604052809291908260278015610106576020028201916000905b82829054906101000a900463ffffffff1663ffffffff16815260200190600401906020826003010492830192600103820291508084116100c95790505b5050505050905090565b6104e0604051908101604052806027906020820280388339808201915050905050905600a165627a7a723058205e249731b14c9492ca6a161a7342bd0796c89a7eea6a30255be7fe5c0ee8995a0029"
+PRUNE_STATE_INTERVAL = 1000
+
+class QtumCallContractViewTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [[], ['-prunestate=%d' % COINBASE_MATURITY]]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def call(self, node, height=-1):
+        result = node.callcontract(self.contract, ADD + "0" * 64, "", 0, height)['executionResult']
+        return int(result['output'], 16), result['gasUsed']
+
+    def run_test(self):
+        node0, node1 = self.nodes
+        node0.generate(1 + COINBASE_MATURITY)
+        node0.generate(COINBASE_MATURITY)
+        self.sync_all()
+
+        self.contract = node0.createcontract(CONTRACT)['address']
+        node0.generate(1)
+        node0.sendtocontract(self.contract, ADD + hex(5)[2:].zfill(64))
+        node0.generate(1)
+        self.sync_all()
+        old_height = node0.getblockcount()
+        old_value, old_gas = self.call(node0)
+        assert_equal(old_value, 13 + 5)
+        old_storage = node0.getstorage(self.contract)
+
+        self.log.info("Make logs expensive with a new DGP gas schedule")
+        dgp = DGPState(node0, "0000000000000000000000000000000000000080")
+        admin_address = node0.getnewaddress()
+        dgp.send_set_initial_admin(admin_address)
+        node0.generate(1)
+        proposal = node0.createcontract(GAS_SCHEDULE_CONTRACT, 10000000)['address']
+        node0.generate(1)
+        dgp.send_add_address_proposal(proposal, 2, admin_address)
+        node0.generate(2)
+        node0.sendtocontract(self.contract, ADD + hex(7)[2:].zfill(64), 0, 2000000)
+        node0.generate(1)
+        self.sync_all()
+
+        new_value, new_gas = self.call(node0)
+        assert_equal(new_value, old_value + 7)
+        assert new_gas > old_gas + 2 * 370000
+
+        self.log.info("A call at the earlier block executes on its state with its gas schedule")
+        for node in self.nodes:
+            assert_equal(self.call(node, old_height), (old_value, old_gas))
+            assert_equal(node.getstorage(self.contract, old_height), old_storage)
+            assert node.getstorage(self.contract) != old_storage
+
+        self.log.info("The state of a block below the -prunestate window is refused")
+        node1.gettxoutsetinfo()
+        node0.generate(2 * PRUNE_STATE_INTERVAL - node0.getblockcount())
+        self.sync_all()
+        assert_equal(self.call(node0, old_height), (old_value, old_gas))
+        assert_raises_rpc_error(-1, "The contract state of block %d was pruned" % old_height, self.call, node1, old_height)
+        assert_raises_rpc_error(-1, "The contract state of block %d was pruned" % old_height, node1.getstorage, self.contract, old_height)
+        assert_equal(self.call(node1), (new_value, new_gas))
+
+if __name__ == '__main__':
+    QtumCallContractViewTest().main()
@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test setting up the automatic outbound connections concurrently.
+
+The node connects through a SOCKS5 proxy which accepts the connections and
+never answers, so every attempt blocks in the handshake until it times out.
+Check that the outbound slots are still filled at once rather than one attempt
+at a time, that the attempts stay within the outbound limits, and that the
+node shuts down without waiting for them.
+"""
+import os
+import socket
+import threading
+import time
+
+from test_framework.messages import CAddress, msg_addr, NODE_NETWORK, NODE_WITNESS
+from test_framework.mininode import P2PInterface
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import PORT_MIN, PORT_RANGE, wait_until
+
+REGTEST_PORT = 22188
+MAX_OUTBOUND_CONNECTIONS = 8
+MAX_FEELER_CONNECTIONS = 1
+# The handshake of netbase gives up after 20 seconds
+SOCKS5_RECV_TIMEOUT = 20
+
+
+class StallingProxy:
+    """Accepts connections and reads the SOCKS5 greeting, but never answers it"""
+    def __init__(self, addr):
+        self.s = socket.socket(socket.AF_INET)
+        self.s.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.s.bind(addr)
+        self.s.listen(32)
+        self.lock = threading.Lock()
+        self.conns = []
+        self.greetings = []
+        self.running = True
+        self.thread = threading.Thread(target=self.run)
+        self.thread.daemon = True
+        self.thread.start()
+
+    def run(self):
+        while self.running:
+            try:
+                conn, _ = self.s.accept()
+            except OSError:
+                return
+            with self.lock:
+                self.conns.append(conn)
+            threading.Thread(target=self.read_greeting, args=(conn,), daemon=True).start()
+
+    def read_greeting(self, conn):
+        data = conn.recv(3)
+        with self.lock:
+            self.greetings.append(data)
+
+    def count(self):
+        with self.lock:
+            return len(self.conns)
+
+    def stop(self):
+        self.running = False
+        self.s.close()
+        with self.lock:
+            for conn in self.conns:
+                conn.close()
+
+
+class QtumConcurrentConnectsTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+
+    def setup_network(self):
+        self.proxy_addr = ('127.0.0.1', PORT_MIN + 2 * PORT_RANGE + (os.getpid() % 1000))
+        self.proxy = StallingProxy(self.proxy_addr)
+        self.extra_args = [['-proxy=%s:%d' % self.proxy_addr]]
+        self.setup_nodes()
+
+    def run_test(self):
+        node = self.nodes[0]
+        start = time.time()
+
+        # Addresses of as many network groups as the node could ever connect to at once
+        addr_msg = msg_addr()
+        for i in range(2 * MAX_OUTBOUND_CONNECTIONS):
+            addr = CAddress()
+            addr.time = int(time.time())
+            addr.nServices = NODE_NETWORK | NODE_WITNESS
+            addr.ip = "20.%d.1.1" % (i + 1)
+            addr.port = REGTEST_PORT
+            addr_msg.addrs.append(addr)
+        peer = node.add_p2p_connection(P2PInterface())
+        peer.send_and_ping(addr_msg)
+
+        # The outbound slots fill up well before the first attempt times out
+        wait_until(lambda: self.proxy.count() >= MAX_OUTBOUND_CONNECTIONS, timeout=SOCKS5_RECV_TIMEOUT / 2)
+        self.log.info("%d connections set up at once after %.1fs" % (self.proxy.count(), time.time() - start))
+        wait_until(lambda: len(self.proxy.greetings) >= MAX_OUTBOUND_CONNECTIONS, timeout=10)
+        assert all(greeting[0] == 0x05 for greeting in self.proxy.greetings)
+
+        # The attempts in progress hold their slots: none are added until they time out
+        time.sleep(3)
+        assert self.proxy.count() <= MAX_OUTBOUND_CONNECTIONS + MAX_FEELER_CONNECTIONS
+        assert time.time() - start < SOCKS5_RECV_TIMEOUT
+        assert node.getconnectioncount() == 1
+
+        # Shutdown aborts the handshakes in progress
+        start = time.time()
+        self.stop_node(0)
+        assert time.time() - start < SOCKS5_RECV_TIMEOUT / 2
+        self.proxy.stop()
+
+
+if __name__ == '__main__':
+    QtumConcurrentConnectsTest().main()
@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test that a contract transaction with a bad signature fails its block when the script checks run in parallel."""
+from io import BytesIO
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.blocktools import get_witness_script
+from test_framework.messages import CBlock, CTransaction
+from test_framework.script import CScript
+from test_framework.util import assert_equal, bytes_to_hex_str, hex_str_to_bytes
+from test_framework.qtumconfig import COINBASE_MATURITY
+
+# Adds its argument to a storage slot and returns the sum when called with 5b9af12b
+CONTRACT = "6060604052600d600055341561001457600080fd5b61017e806100236000396000f30060606040526004361061004c576000357c0100000000000000000000000000000000000000000000000000000000900463ffffffff168063027c1aaf1461004e5780635b9af12b14610058575b005b61005661008f565b005b341561006357600080fd5b61007960048080359060200190919050506100a1565b6040518082815260200191505060405180910390f35b60026000808282540292505081905550565b60007fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a17fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a1816000540160008190555060005490509190505600a165627a7a7230582015732bfa66bdede47ecc05446bf4c1e8ed047efac25478cb13b795887df70f290029"
+ADD = "5b9af12b"
+
+class QtumContractScriptCheckTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+        self.extra_args = [['-par=4']]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def value(self, contract):
+        return int(self.nodes[0].callcontract(contract, ADD + "0" * 64)['executionResult']['output'], 16)
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 10)
+        contract = node.createcontract(CONTRACT)['address']
+        node.generate(1)
+        assert_equal(self.value(contract), 13)
+
+        txid = node.sendtocontract(contract, ADD + "0" * 63 + "1")['txid']
+        block_hash = node.generate(1)[0]
+        assert_equal(self.value(contract), 14)
+        block = CBlock()
+        block.deserialize(BytesIO(hex_str_to_bytes(node.getblock(block_hash, False))))
+        node.invalidateblock(block_hash)
+        height = node.getblockcount()
+        assert_equal(self.value(contract), 13)
+
+        self.log.info("Submit the block with the signature of its contract transaction altered")
+        tx = next(tx for tx in block.vtx if tx.rehash() == txid)
+        script_sig = bytearray(tx.vin[0].scriptSig)
+        script_sig[10] ^= 1
+        tx.vin[0].scriptSig = CScript(bytes(script_sig))
+        tx.rehash()
+        coinbase = block.vtx[0]
+        for out in coinbase.vout:
+            if bytes(out.scriptPubKey).startswith(bytes.fromhex("6a24aa21a9ed")):
+                out.scriptPubKey = get_witness_script(block.calc_witness_merkle_root(), 0)
+        coinbase.rehash()
+        block.hashMerkleRoot = block.calc_merkle_root()
+        block.solve()
+        assert node.submitblock(bytes_to_hex_str(block.serialize())) is not None
+        assert_equal(node.getblockcount(), height)
+        assert_equal(self.value(contract), 13)
+
+        self.log.info("The transaction is mined with its original signature")
+        node.generate(1)
+        assert_equal(node.getblockcount(), height + 1)
+        assert_equal(self.value(contract), 14)
+        assert_equal(node.gettransaction(txid)['confirmations'], 1)
+
+if __name__ == '__main__':
+    QtumContractScriptCheckTest().main()
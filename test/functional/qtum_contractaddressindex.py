@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the index of the EVM addresses taking part in contract executions."""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, assert_raises_rpc_error
+from test_framework.qtumconfig import COINBASE_MATURITY, QTUM_MIN_GAS_PRICE_STR
+
+# Payable fallback, and withdraw() (3ccfd60b) sends the balance of the contract to the caller
+CONTRACT = "6060604052341561000c57fe5b5b5b5b6104a88061001e6000396000f3006060604052361561006b576000357c0100000000000000000000000000000000000000000000000000000000900463ffffffff1680633ccfd60b146100745780635579818d14610086578063622836a3146100db578063a8d5fd651461012d578063f34e0e7b14610137575b6100725b5b565b005b341561007c57fe5b610084610189565b005b341561008e57fe5b6100d9600480803573ffffffffffffffffffffffffffffffffffffffff1690602001909190803573ffffffffffffffffffffffffffffffffffffffff169060200190919050506101dc565b005b34156100e357fe5b6100eb610263565b604051808273ffffffffffffffffffffffffffffffffffffffff1673ffffffffffffffffffffffffffffffffffffffff16815260200191505060405180910390f35b610135610289565b005b341561013f57fe5b610147610456565b604051808273ffffffffffffffffffffffffffffffffffffffff1673ffffffffffffffffffffffffffffffffffffffff16815260200191505060405180910390f35b3373ffffffffffffffffffffffffffffffffffffffff166108fc3073ffffffffffffffffffffffffffffffffffffffff16319081150290604051809050600060405180830381858888f19350505050505b565b81600060006101000a81548173ffffffffffffffffffffffffffffffffffffffff021916908373ffffffffffffffffffffffffffffffffffffffff16021790555080600160006101000a81548173ffffffffffffffffffffffffffffffffffffffff021916908373ffffffffffffffffffffffffffffffffffffffff1602179055505b5050565b600160009054906101000a900473ffffffffffffffffffffffffffffffffffffffff1681565b600060009054906101000a900473ffffffffffffffffffffffffffffffffffffffff1673ffffffffffffffffffffffffffffffffffffffff166002348115156102ce57fe5b0460405180807f7368617265282900000000000000000000000000000000000000000000000000815250600701905060405180910390207c01000000000000000000000000000000000000000000000000000000009004906040518263ffffffff167c010000000000000000000000000000000000000000000000000000000002815260040180905060006040518083038185886187965a03f1935050505050600160009054906101000a900473ffffffffffffffffffffffffffffffffffffffff1673ffffffffffffffffffffffffffffffffffffffff166004348115156103b357fe5b0460405180807f6b65657028290000000000000000000000000000000000000000000000000000815250600601905060405180910390207c01000000000000000000000000000000000000000000000000000000009004906040518263ffffffff167c010000000000000000000000000000000000000000000000000000000002815260040180905060006040518083038185886187965a03f19350505050505b565b600060009054906101000a900473ffffffffffffffffffffffffffffffffffffffff16815600a165627a7a72305820cb1b06b481990e1e218f7d0b51a3ffdf5b7439cfdd9bb2dccc1476cb84dfc95b0029"
+WITHDRAW = "3ccfd60b"
+
+def roles(entry):
+    return [role for role in ('sender', 'receiver', 'created', 'destructed') if entry[role]]
+
+class QtumContractAddressIndexTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+        self.extra_args = [['-logevents', '-logaddressindex']]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def summary(self, address, *args):
+        return [(entry['transactionHash'], roles(entry)) for entry in self.nodes[0].getcontractaddresstxs(address, *args)]
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 10)
+        sender = node.getnewaddress()
+        node.sendtoaddress(sender, 100)
+        node.generate(1)
+        hexsender = node.gethexaddress(sender)
+
+        self.log.info("Creation, value sent to the contract and value sent back")
+        create = node.createcontract(CONTRACT, 1000000, QTUM_MIN_GAS_PRICE_STR, sender)
+        contract = create['address']
+        create_height = node.getblockcount() + 1
+        node.generate(1)
+        deposit = node.sendtocontract(contract, "00000000", 5, 1000000, QTUM_MIN_GAS_PRICE_STR, sender)['txid']
+        node.generate(1)
+        withdraw = node.sendtocontract(contract, WITHDRAW, 0, 1000000, QTUM_MIN_GAS_PRICE_STR, sender)['txid']
+        withdraw_block = node.generate(1)[0]
+
+        assert_equal(self.summary(contract), [
+            (create['txid'], ['created']),
+            (deposit, ['receiver']),
+            (withdraw, ['sender']),
+        ])
+        assert_equal(self.summary(hexsender), [
+            (deposit, ['sender']),
+            (withdraw, ['receiver']),
+        ])
+        entry = node.getcontractaddresstxs(contract)[0]
+        assert_equal(entry['blockNumber'], create_height)
+        assert_equal(entry['transactionIndex'], node.getblock(node.getblockhash(create_height))['tx'].index(create['txid']))
+
+        self.log.info("Block ranges")
+        assert_equal(self.summary(contract, create_height + 1), [(deposit, ['receiver']), (withdraw, ['sender'])])
+        assert_equal(self.summary(contract, create_height, create_height + 1), [(create['txid'], ['created']), (deposit, ['receiver'])])
+        assert_equal(self.summary(contract, 0, create_height - 1), [])
+        assert_raises_rpc_error(-8, "Invalid block range", node.getcontractaddresstxs, contract, 10, 5)
+        assert_raises_rpc_error(-5, "Incorrect address", node.getcontractaddresstxs, "00")
+
+        self.log.info("A disconnected block leaves the index")
+        node.invalidateblock(withdraw_block)
+        assert_equal(self.summary(contract), [(create['txid'], ['created']), (deposit, ['receiver'])])
+        assert_equal(self.summary(hexsender), [(deposit, ['sender'])])
+        node.reconsiderblock(withdraw_block)
+        assert_equal(self.summary(hexsender), [(deposit, ['sender']), (withdraw, ['receiver'])])
+
+if __name__ == '__main__':
+    QtumContractAddressIndexTest().main()
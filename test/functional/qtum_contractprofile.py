@@ -0,0 +1,46 @@
+#!/usr/bin/env python3
+# Copyright (c) 2015-2016 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import *
+from test_framework.qtum import *
+from test_framework.qtumconfig import *
+
+
+class ContractProfileTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [['-contractprofile=1'], []]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def run_test(self):
+        self.node = self.nodes[0]
+        self.node.generate(COINBASE_MATURITY+50)
+        # contract test { uint a; function test() payable { a = 13; } function add() payable returns (uint) { a += 13; return a; } }
+        contract_data = self.node.createcontract("60606040525b600d6000819055505b5b60a98061001d6000396000f30060606040523615603d576000357c0100000000000000000000000000000000000000000000000000000000900463ffffffff1680634f2be91f146045575b60435b5b565b005b604b6061565b6040518082815260200191505060405180910390f35b6000600d60006000828254019250508190555060005490505b905600a165627a7a72305820fd0deb11ff6c6a06f612b5fb04e7312f22eacec75d677c0fbc0194d86772d2d70029", 1000000, QTUM_MIN_GAS_PRICE_STR)
+        contract_address = contract_data['address']
+        self.node.generate(1)
+        self.node.sendtocontract(contract_address, "4f2be91f", 0, 1000000, QTUM_MIN_GAS_PRICE_STR)
+        self.node.generate(1)
+
+        profile = self.node.getcontractprofile(0)
+        entry = [p for p in profile if p['address'] == contract_address]
+        assert_equal(len(entry), 1)
+        # The creation and the call of add()
+        assert_equal(entry[0]['calls'], 2)
+        assert(entry[0]['gasUsed'] > 0)
+        assert('SSTORE' in entry[0]['opcodes'])
+        assert(entry[0]['opcodes']['SSTORE']['count'] >= 2)
+
+        assert_equal(len(self.node.getcontractprofile(1, True)), 1)
+        assert_equal(self.node.getcontractprofile(), [])
+        assert_raises_rpc_error(-8, "count must not be negative", self.node.getcontractprofile, -1)
+        assert_raises_rpc_error(-1, "The contract profiler is disabled", self.nodes[1].getcontractprofile)
+
+if __name__ == '__main__':
+    ContractProfileTest().main()
@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+# Copyright (c) 2015-2016 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+import os
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import *
+from test_framework.qtum import *
+from test_framework.qtumconfig import *
+
+
+class ContractStateSnapshotTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [[], ['-prunestate=500']]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def run_test(self):
+        self.node = self.nodes[0]
+        self.node.generate(COINBASE_MATURITY+50)
+        # contract test { uint a; function test() payable { a = 13; } ... }
+        contract_data = self.node.createcontract("60606040525b600d6000819055505b5b60a98061001d6000396000f30060606040523615603d576000357c0100000000000000000000000000000000000000000000000000000000900463ffffffff1680634f2be91f146045575b60435b5b565b005b604b6061565b6040518082815260200191505060405180910390f35b6000600d60006000828254019250508190555060005490505b905600a165627a7a72305820fd0deb11ff6c6a06f612b5fb04e7312f22eacec75d677c0fbc0194d86772d2d70029", 1000000, QTUM_MIN_GAS_PRICE_STR)
+        self.node.generate(1)
+        self.sync_all()
+        tip = self.node.getblock(self.node.getbestblockhash())
+
+        path = os.path.join(self.node.datadir, 'state.dat')
+        ret = self.node.dumpcontractstate(path)
+        assert_equal(ret['blockhash'], tip['hash'])
+        assert_equal(ret['height'], tip['height'])
+        assert_equal(ret['hashStateRoot'], tip['hashStateRoot'])
+        assert_equal(ret['hashUTXORoot'], tip['hashUTXORoot'])
+        # The account trie, the contract storage and its bytecode at least
+        assert(ret['state_entries'] >= 3)
+        # The preimages of the contract address and of its storage slot
+        assert(ret['aux_entries'] >= 2)
+        assert_raises_rpc_error(-8, "already exists", self.node.dumpcontractstate, path)
+
+        # Importing is idempotent and verified against the header chain
+        assert_equal(self.node.loadcontractstate(path), ret)
+        assert_equal(self.node.callcontract(contract_data['address'], "4f2be91f")['executionResult']['excepted'], "None")
+        # The storage of the contract can still be listed by slot
+        assert_equal(self.node.getstorage(contract_data['address']), self.nodes[1].getstorage(contract_data['address']))
+
+        # The imported state hashes up to the roots of the tip, split over threads or not
+        for nthreads in [1, 4]:
+            check = self.node.verifycontractstate(tip['hash'], nthreads)
+            assert_equal(check['blockhash'], tip['hash'])
+            assert_equal(check['missing'], 0)
+            assert_equal(check['corrupted'], 0)
+            assert(check['valid'])
+            assert(check['entries'] >= ret['state_entries'])
+
+        # A snapshot of an older block
+        older = self.node.getblockhash(10)
+        older_path = os.path.join(self.node.datadir, 'state_older.dat')
+        assert_equal(self.node.dumpcontractstate(older_path, older)['blockhash'], older)
+        assert_raises_rpc_error(-5, "Block not found", self.node.dumpcontractstate, os.path.join(self.node.datadir, 'none.dat'), "00" * 32)
+
+        # A node pruning its state refuses blocks below the kept window, and dumps the same tip state
+        pruned = self.nodes[1]
+        assert_raises_rpc_error(-1, "was pruned", pruned.dumpcontractstate, os.path.join(pruned.datadir, 'state_older.dat'), older)
+        assert_raises_rpc_error(-1, "was pruned", pruned.verifycontractstate, older)
+        assert(pruned.verifycontractstate(tip['hash'])['valid'])
+        pruned_ret = pruned.dumpcontractstate(os.path.join(pruned.datadir, 'state.dat'))
+        assert_equal(pruned_ret, ret)
+
+        # Roots that the header chain does not commit to are rejected
+        with open(path, 'rb') as f:
+            data = bytearray(f.read())
+        data[4 + 32 + 4] ^= 0xff
+        bad_path = os.path.join(self.node.datadir, 'state_bad.dat')
+        with open(bad_path, 'wb') as f:
+            f.write(data)
+        assert_raises_rpc_error(-1, "Snapshot roots do not match", self.node.loadcontractstate, bad_path)
+
+if __name__ == '__main__':
+    ContractStateSnapshotTest().main()
@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test that disconnecting blocks restores the coins and contract state, for recent and deeper blocks."""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal
+from test_framework.qtumconfig import COINBASE_MATURITY
+
+# Adds its argument to a storage slot and returns the sum when called with 5b9af12b
+CONTRACT = "6060604052600d600055341561001457600080fd5b61017e806100236000396000f30060606040526004361061004c576000357c0100000000000000000000000000000000000000000000000000000000900463ffffffff168063027c1aaf1461004e5780635b9af12b14610058575b005b61005661008f565b005b341561006357600080fd5b61007960048080359060200190919050506100a1565b6040518082815260200191505060405180910390f35b60026000808282540292505081905550565b60007fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a17fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a1816000540160008190555060005490509190505600a165627a7a7230582015732bfa66bdede47ecc05446bf4c1e8ed047efac25478cb13b795887df70f290029"
+ADD = "5b9af12b"
+
+class QtumDeepDisconnectTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+        self.extra_args = [['-logevents']]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def value(self, contract):
+        return int(self.nodes[0].callcontract(contract, ADD + "0" * 64)['executionResult']['output'], 16)
+
+    def snapshot(self, contract):
+        node = self.nodes[0]
+        return (node.getbestblockhash(), node.gettxoutsetinfo()['hash_serialized_2'], self.value(contract))
+
+    def disconnect_to(self, height, contract):
+        node = self.nodes[0]
+        tip = node.getbestblockhash()
+        node.invalidateblock(node.getblockhash(height + 1))
+        assert_equal(self.snapshot(contract), self.snapshots[height])
+        node.reconsiderblock(node.getblockhash(height + 1))
+        assert_equal(node.getbestblockhash(), tip)
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 10)
+        contract = node.createcontract(CONTRACT)['address']
+        node.generate(1)
+
+        # Each block calls the contract, so every one changes both the coins and the state
+        self.snapshots = {node.getblockcount(): self.snapshot(contract)}
+        for i in range(1, 25):
+            node.sendtocontract(contract, ADD + hex(i)[2:].zfill(64))
+            node.generate(1)
+            self.snapshots[node.getblockcount()] = self.snapshot(contract)
+        tip = node.getblockcount()
+        assert_equal(self.value(contract), 13 + 24 * 25 // 2)
+
+        self.log.info("Disconnect the most recent blocks")
+        self.disconnect_to(tip - 3, contract)
+
+        self.log.info("Disconnect more blocks than are kept in memory")
+        self.disconnect_to(tip - 20, contract)
+        assert_equal(self.snapshot(contract), self.snapshots[tip])
+
+        self.log.info("Disconnect again after a restart, with nothing kept in memory")
+        self.restart_node(0, ['-logevents'])
+        self.disconnect_to(tip - 12, contract)
+        assert_equal(self.snapshot(contract), self.snapshots[tip])
+
+if __name__ == '__main__':
+    QtumDeepDisconnectTest().main()
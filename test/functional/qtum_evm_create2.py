@@ -17,8 +17,9 @@ import pprint
 class QtumEVMCreate2Test(BitcoinTestFramework):
     def set_test_params(self):
         self.setup_clean_chain = True
-        self.num_nodes = 1
-        self.extra_args = [['-logevents', '-minmempoolgaslimit=21000', '-constantinopleheight=704']]
+        self.num_nodes = 2
+        self.extra_args = [['-logevents', '-minmempoolgaslimit=21000', '-constantinopleheight=704'],
+                           ['-contractindex', '-minmempoolgaslimit=21000', '-constantinopleheight=704']]
 
     def skip_test_if_missing_module(self):
         self.skip_if_no_wallet()
@@ -217,6 +218,33 @@ class QtumEVMCreate2Test(BitcoinTestFramework):
         # balance of self.contract_address should be 30 so far
         assert_equal(self.node.listcontracts()[self.contract_address], 30)
 
+        # the contract registry of -contractindex lists the same contracts as the state
+        self.sync_blocks()
+        indexed = self.nodes[1]
+        assert_equal(indexed.listcontracts(1, 1000), self.node.listcontracts(1, 1000))
+        assert_equal(sorted(indexed.listallcontracts()), sorted(self.node.listallcontracts()))
+        height = self.node.getblockcount() - 10
+        assert_equal(sorted(indexed.listallcontracts(height)), sorted(self.node.listallcontracts(height)))
+        info = indexed.getcontractinfo(create2_address)
+        assert_equal(info['address'], create2_address)
+        assert_equal(info['blockNumber'], indexed.getblockcount())
+        assert('destructedBlockNumber' not in info)
+        for field in ('storageSlots', 'codeSize', 'trieNodes'):
+            del info[field]
+        assert(info in indexed.listcontractsbycodehash(info['codeHash']))
+
+        # the factory keeps the created address in its storage, which the state sizes count
+        factory = indexed.getcontractinfo(self.contract_address)
+        assert(factory['storageSlots'] >= 1)
+        assert(factory['trieNodes'] >= 1)
+        assert(factory['codeSize'] > 0)
+        total = indexed.getblockchaininfo()['contract_state']
+        assert_equal(total['height'], indexed.getblockcount())
+        assert(total['storage_slots'] >= factory['storageSlots'])
+        assert(total['code_size'] >= factory['codeSize'])
+        assert('contract_state' not in self.node.getblockchaininfo())
+        assert_raises_rpc_error(-5, "No contract was created at this address", indexed.getcontractinfo, "00" * 20)
+
 
 if __name__ == '__main__':
     QtumEVMCreate2Test().main()
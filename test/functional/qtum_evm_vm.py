@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+# Copyright (c) 2016-2019 The KPG Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test that the EVM implementations selected with -vm reach the same states.
+
+A chain of contract transactions built on the legacy VM is validated and
+extended by a node on another VM, then replayed from the blocks on disk."""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.test_node import ErrorMatch
+from test_framework.util import *
+from test_framework.qtum import *
+from test_framework.qtumconfig import *
+
+
+class QtumEVMVMTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [['-vm=legacy'], ['-vm=interpreter']]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def assert_same_calls(self, address, data):
+        results = [node.callcontract(address, data)['executionResult'] for node in self.nodes]
+        assert_equal(results[0], results[1])
+        return results[0]
+
+    def run_test(self):
+        node0, node1 = self.nodes
+        node1.generate(10)
+        self.sync_all()
+        node0.generate(COINBASE_MATURITY+50)
+        self.sync_all()
+
+        # contract test { uint a; function test() payable { a = 13; } function add() returns (uint) { a += 13; return a; } }
+        contract = node0.createcontract("60606040525b600d6000819055505b5b60a98061001d6000396000f30060606040523615603d576000357c0100000000000000000000000000000000000000000000000000000000900463ffffffff1680634f2be91f146045575b60435b5b565b005b604b6061565b6040518082815260200191505060405180910390f35b6000600d60006000828254019250508190555060005490505b905600a165627a7a72305820fd0deb11ff6c6a06f612b5fb04e7312f22eacec75d677c0fbc0194d86772d2d70029", 1000000, QTUM_MIN_GAS_PRICE_STR)
+        node0.generate(1)
+        self.sync_all()
+        address = contract['address']
+
+        # Blocks of each VM connect on the other, so their state roots agree
+        for i in range(3):
+            node0.sendtocontract(address, "4f2be91f", 0, 1000000, QTUM_MIN_GAS_PRICE_STR)
+            node0.generate(1)
+            self.sync_all()
+            node1.sendtocontract(address, "4f2be91f", 0, 1000000, QTUM_MIN_GAS_PRICE_STR)
+            node1.generate(1)
+            self.sync_all()
+        tip = node0.getblock(node0.getbestblockhash())
+        assert_equal(node1.getblock(tip['hash'])['hashStateRoot'], tip['hashStateRoot'])
+        assert_equal(node0.getaccountinfo(address), node1.getaccountinfo(address))
+
+        result = self.assert_same_calls(address, "4f2be91f")
+        assert_equal(result['excepted'], "None")
+        assert_equal(int(result['output'], 16), 13 * 8)
+
+        # Replaying the chain from disk on the other VM ends at the same tip
+        self.restart_node(0, ['-vm=interpreter', '-reindex-chainstate'])
+        wait_until(lambda: node0.getblockcount() == tip['height'])
+        assert_equal(node0.getbestblockhash(), tip['hash'])
+        self.restart_node(1, ['-vm=legacy', '-reindex-chainstate'])
+        wait_until(lambda: node1.getblockcount() == tip['height'])
+        assert_equal(node1.getbestblockhash(), tip['hash'])
+        self.assert_same_calls(address, "4f2be91f")
+
+        self.stop_node(0)
+        self.nodes[0].assert_start_raises_init_error(['-vm=nosuchvm'], 'Cannot select the EVM nosuchvm', match=ErrorMatch.PARTIAL_REGEX)
+
+if __name__ == '__main__':
+    QtumEVMVMTest().main()
@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test that getblocktemplate extends its block with new mempool transactions while the tip stays the same."""
+import time
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal
+from test_framework.qtumconfig import COINBASE_MATURITY
+
+# Adds its argument to a storage slot and returns the sum when called with 5b9af12b
+CONTRACT = "6060604052600d600055341561001457600080fd5b61017e806100236000396000f30060606040526004361061004c576000357c0100000000000000000000000000000000000000000000000000000000900463ffffffff168063027c1aaf1461004e5780635b9af12b14610058575b005b61005661008f565b005b341561006357600080fd5b61007960048080359060200190919050506100a1565b6040518082815260200191505060405180910390f35b60026000808282540292505081905550565b60007fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a17fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a1816000540160008190555060005490509190505600a165627a7a7230582015732bfa66bdede47ecc05446bf4c1e8ed047efac25478cb13b795887df70f290029"
+ADD = "5b9af12b"
+
+class QtumGBTUpdateTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def template(self):
+        # The template is only refreshed for mempool changes after 5 seconds
+        self.mocktime += 10
+        self.nodes[0].setmocktime(self.mocktime)
+        return self.nodes[0].getblocktemplate({'rules': ['segwit']})
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 10)
+        contract = node.createcontract(CONTRACT)['address']
+        node.generate(1)
+        self.mocktime = int(time.time())
+
+        self.log.info("New transactions are added after those of the block")
+        first = [node.sendtocontract(contract, ADD + hex(1)[2:].zfill(64))['txid']]
+        tmpl = self.template()
+        assert_equal([tx['txid'] for tx in tmpl['transactions']], first)
+        second = [node.sendtocontract(contract, ADD + hex(i)[2:].zfill(64))['txid'] for i in range(2, 4)]
+        second.append(node.sendtoaddress(node.getnewaddress(), 1))
+        tmpl2 = self.template()
+        assert_equal(tmpl2['previousblockhash'], tmpl['previousblockhash'])
+        txids = [tx['txid'] for tx in tmpl2['transactions']]
+        assert_equal(txids[0], first[0])
+        assert_equal(sorted(txids), sorted(first + second))
+        assert(tmpl2['coinbasevalue'] > tmpl['coinbasevalue'])
+        assert(tmpl2['default_witness_commitment'] != tmpl['default_witness_commitment'])
+
+        self.log.info("The extended block has what a new block would")
+        block = node.getblock(node.generate(1)[0])
+        assert_equal(sorted(block['tx'][1:]), sorted(txids))
+        assert_equal(int(node.callcontract(contract, ADD + "0" * 64)['executionResult']['output'], 16), 13 + 1 + 2 + 3)
+
+        self.log.info("A new tip gets a new block")
+        tmpl3 = self.template()
+        assert_equal(tmpl3['previousblockhash'], block['hash'])
+        assert_equal(tmpl3['transactions'], [])
+
+if __name__ == '__main__':
+    QtumGBTUpdateTest().main()
@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test that the index entries and receipts built on worker threads match those built inline."""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, assert_greater_than
+from test_framework.qtumconfig import COINBASE_MATURITY
+
+# Adds its argument to a storage slot and returns the sum when called with 5b9af12b
+CONTRACT = "6060604052600d600055341561001457600080fd5b61017e806100236000396000f30060606040526004361061004c576000357c0100000000000000000000000000000000000000000000000000000000900463ffffffff168063027c1aaf1461004e5780635b9af12b14610058575b005b61005661008f565b005b341561006357600080fd5b61007960048080359060200190919050506100a1565b6040518082815260200191505060405180910390f35b60026000808282540292505081905550565b60007fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a17fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a1816000540160008190555060005490509190505600a165627a7a7230582015732bfa66bdede47ecc05446bf4c1e8ed047efac25478cb13b795887df70f290029"
+ADD = "5b9af12b"
+
+class QtumIndexBuildTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        # Node 0 builds the entries on the index threads, node 1 without script check threads builds them inline
+        self.extra_args = [['-addrindex', '-logevents', '-par=4'], ['-addrindex', '-logevents', '-par=1']]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_bitcore()
+        self.skip_if_no_wallet()
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 10)
+        contract = node.createcontract(CONTRACT)['address']
+        node.generate(1)
+
+        self.log.info("A block with payments and contract calls")
+        addresses = [node.getnewaddress() for _ in range(5)]
+        txids = []
+        for i, address in enumerate(addresses):
+            txids.append(node.sendtoaddress(address, i + 1))
+        calls = []
+        for i in range(3):
+            calls.append(node.sendtocontract(contract, ADD + hex(i + 1)[2:].zfill(64))['txid'])
+        node.generate(1)
+        self.sync_all()
+
+        for address in addresses:
+            query = {'addresses': [address]}
+            deltas = node.getaddressdeltas(query)
+            assert_greater_than(len(deltas), 0)
+            assert_equal(deltas, self.nodes[1].getaddressdeltas(query))
+            assert_equal(node.getaddressutxos(query), self.nodes[1].getaddressutxos(query))
+            assert_equal(node.getaddressbalance(query), self.nodes[1].getaddressbalance(query))
+        # The outputs spent by the block
+        for txid in txids + calls:
+            for vin in node.decoderawtransaction(node.gettransaction(txid)['hex'])['vin']:
+                query = {'txid': vin['txid'], 'index': vin['vout']}
+                info = node.getspentinfo(query)
+                assert_equal(info['txid'], txid)
+                assert_equal(info, self.nodes[1].getspentinfo(query))
+        for txid in calls:
+            receipt = node.gettransactionreceipt(txid)
+            assert_equal(len(receipt), 1)
+            assert_equal(len(receipt[0]['log']), 2)
+            assert_equal(receipt, self.nodes[1].gettransactionreceipt(txid))
+
+if __name__ == '__main__':
+    QtumIndexBuildTest().main()
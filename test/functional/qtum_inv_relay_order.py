@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test that trickled transaction announcements stay in topological order.
+
+The inventory of each peer is sorted with a snapshot of the mempool order that is
+rebuilt at most once a second. Chains of transactions are created across several
+rebuilds, so that parents are ranked in the snapshot while their children are not
+yet, and every transaction must still be announced after its parents.
+"""
+from decimal import Decimal
+import time
+
+from test_framework.messages import MSG_TX
+from test_framework.mininode import P2PInterface, mininode_lock
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import wait_until
+from test_framework.qtumconfig import COINBASE_MATURITY
+
+class InvRecorder(P2PInterface):
+    def __init__(self):
+        super().__init__()
+        self.announced = []
+
+    def on_inv(self, message):
+        for inv in message.inv:
+            if inv.type == MSG_TX:
+                self.announced.append('%064x' % inv.hash)
+
+class QtumInvRelayOrderTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def spend(self, txid, vout, amount, fee):
+        node = self.nodes[0]
+        value = amount - fee
+        raw = node.createrawtransaction([{'txid': txid, 'vout': vout}], {node.getnewaddress(): value})
+        return node.sendrawtransaction(node.signrawtransactionwithwallet(raw)['hex']), value
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 10)
+        peer = node.add_p2p_connection(InvRecorder())
+
+        # Several chains, each extended over a few snapshot rebuilds with varying fees
+        parents = {}
+        tips = []
+        for utxo in node.listunspent()[:6]:
+            tips.append((utxo['txid'], utxo['vout'], utxo['amount']))
+        for round in range(4):
+            for i, (txid, vout, amount) in enumerate(tips):
+                fee = Decimal('0.001') * (1 + (i * 7 + round * 3) % 5)
+                child, value = self.spend(txid, vout, amount, fee)
+                parents[child] = txid
+                tips[i] = (child, 0, value)
+            time.sleep(1.2)
+
+        wait_until(lambda: set(parents) <= set(peer.announced), timeout=120, lock=mininode_lock)
+        with mininode_lock:
+            position = {txid: i for i, txid in enumerate(peer.announced)}
+        for child, parent in parents.items():
+            if parent in parents:
+                assert position[parent] < position[child], "%s announced before its parent %s" % (child, parent)
+
+if __name__ == '__main__':
+    QtumInvRelayOrderTest().main()
@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test -reindex and -loadblock with the block records decoded by the script check threads."""
+import os
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, wait_until
+from test_framework.qtumconfig import COINBASE_MATURITY
+
+# Adds its argument to a storage slot and returns the sum when called with 5b9af12b
+CONTRACT = "6060604052600d600055341561001457600080fd5b61017e806100236000396000f30060606040526004361061004c576000357c0100000000000000000000000000000000000000000000000000000000900463ffffffff168063027c1aaf1461004e5780635b9af12b14610058575b005b61005661008f565b005b341561006357600080fd5b61007960048080359060200190919050506100a1565b6040518082815260200191505060405180910390f35b60026000808282540292505081905550565b60007fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a17fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a1816000540160008190555060005490509190505600a165627a7a7230582015732bfa66bdede47ecc05446bf4c1e8ed047efac25478cb13b795887df70f290029"
+ADD = "5b9af12b"
+
+class QtumLoadBlockTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [['-par=4'], ['-par=4']]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def setup_network(self):
+        self.setup_nodes()
+
+    def value(self, node, contract):
+        return int(node.callcontract(contract, ADD + "0" * 64)['executionResult']['output'], 16)
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 10)
+        contract = node.createcontract(CONTRACT)['address']
+        node.generate(1)
+        for i in range(10):
+            node.sendtocontract(contract, ADD + "0" * 63 + "1")
+            node.sendtoaddress(node.getnewaddress(), 1)
+            node.generate(1)
+        height = node.getblockcount()
+        tip = node.getbestblockhash()
+        assert_equal(self.value(node, contract), 23)
+
+        self.log.info("Reindex")
+        self.restart_node(0, ['-par=4', '-reindex'])
+        wait_until(lambda: self.nodes[0].getblockcount() == height)
+        assert_equal(self.nodes[0].getbestblockhash(), tip)
+        assert_equal(self.value(self.nodes[0], contract), 23)
+        self.stop_node(0)
+
+        self.log.info("Load the blocks from a file with garbage between the records")
+        blocks = os.path.join(self.nodes[0].datadir, 'regtest', 'blocks', 'blk00000.dat')
+        bootstrap = os.path.join(self.options.tmpdir, 'bootstrap.dat')
+        with open(blocks, 'rb') as f:
+            data = f.read()
+        with open(bootstrap, 'wb') as f:
+            f.write(b'\x00' * 100 + data[:8] + b'\xff' * 10 + data)
+        self.start_node(0, ['-par=4'])
+        self.restart_node(1, ['-par=4', '-loadblock=%s' % bootstrap])
+        wait_until(lambda: self.nodes[1].getblockcount() == height)
+        assert_equal(self.nodes[1].getbestblockhash(), tip)
+        assert_equal(self.value(self.nodes[1], contract), 23)
+
+if __name__ == '__main__':
+    QtumLoadBlockTest().main()
@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the contract transaction load generator of contrib/loadgen.
+
+Run it for a few seconds against a node and check that it reported no errors,
+and that its token transfers, contract creations and value calls made it into
+blocks with the logs and balances they should have.
+"""
+import os
+import re
+import subprocess
+import sys
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, get_auth_cookie, rpc_port
+
+TRANSFER_TOPIC = 'ddf252ad1be2c89b69c2b068fc378daa952ba7f163c4a11628f55a4df523b3ef'
+
+class QtumLoadgenTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+        self.extra_args = [['-logevents']]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def run_test(self):
+        node = self.nodes[0]
+        user, password = get_auth_cookie(node.datadir)
+        script = os.path.join(self.config["environment"]["SRCDIR"], 'contrib', 'loadgen', 'kpg-loadgen.py')
+        contracts_before = node.listcontracts(1, 10000)
+
+        self.log.info("Run the load generator")
+        output = subprocess.run([sys.executable, script,
+                                 '--port', str(rpc_port(0)), '--rpcuser', user, '--rpcpassword', password,
+                                 '--datadir', node.datadir, '--pid', str(node.process.pid),
+                                 '--rate', '10', '--duration', '10', '--threads', '2', '--mix', 'transfer=5,create=1,spend=2',
+                                 '--senders', '3', '--outputs-per-sender', '4', '--sender-funds', '100',
+                                 '--block-interval', '2', '--report-interval', '5'],
+                                stdout=subprocess.PIPE, stderr=subprocess.PIPE, universal_newlines=True, timeout=300)
+        self.log.debug(output.stdout)
+        assert_equal(output.returncode, 0)
+        assert_equal(output.stderr, "")
+        token, forwarder = re.search(r"Token contract (\w+), forwarding contract (\w+)", output.stdout).groups()
+
+        # The final report counts every kind and no errors
+        reports = [line for line in output.stdout.splitlines() if line.startswith('[')]
+        assert len(reports) >= 2
+        final = reports[-1]
+        assert "errors" not in final, final
+        assert "Last error" not in output.stdout
+        sent = dict((kind, int(n)) for kind, n in re.findall(r"(transfer|create|spend)=(\d+)", final))
+        assert_equal(sorted(sent.keys()), ['create', 'spend', 'transfer'])
+        assert re.search(r"\| node \d+ MB", final), final
+
+        self.log.info("Check what the transactions did")
+        node.generate(1)
+        assert_equal(node.getmempoolinfo()['size'], 0)
+        contracts = node.listcontracts(1, 10000)
+        assert token in contracts
+        assert forwarder in contracts
+        assert_equal(len(contracts) - len(contracts_before), 2 + sent['create'])
+        # The value calls sent everything back to the callers
+        assert_equal(contracts[forwarder], 0)
+        logs = node.searchlogs(0, -1, {"addresses": [token]}, {"topics": [TRANSFER_TOPIC]})
+        assert_equal(len(logs), sent['transfer'])
+
+if __name__ == '__main__':
+    QtumLoadgenTest().main()
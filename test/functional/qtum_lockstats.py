@@ -0,0 +1,45 @@
+#!/usr/bin/env python3
+# Copyright (c) 2016-2019 The KPG Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the lock contention counted with -lockstats and returned by getlockstats."""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import *
+
+
+class QtumLockStatsTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [['-lockstats'], []]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def run_test(self):
+        node0, node1 = self.nodes
+        node0.generate(10)
+        self.sync_all()
+
+        stats = node0.getlockstats()
+        assert stats['enabled']
+        for name in ['cs_main', 'mempool.cs', 'cs_vNodes', 'cs_wallet']:
+            lock = stats['locks'][name]
+            assert_greater_than(lock['locks'], 0)
+            assert_greater_than_or_equal(lock['locks'], sum(lock['hold_histogram'].values()))
+            assert_equal(lock['contended'], sum(lock['wait_histogram'].values()))
+            assert_greater_than_or_equal(lock['contended'], sum(site['contended'] for site in lock['sites']))
+            assert_greater_than_or_equal(10, len(lock['sites']))
+
+        # The counters are returned before the reset
+        stats = node0.getlockstats(True)
+        assert_greater_than(stats['locks']['cs_main']['locks'], 0)
+        assert_greater_than(stats['locks']['cs_main']['locks'], node0.getlockstats()['locks']['cs_main']['locks'])
+
+        # Without -lockstats nothing is counted
+        assert_equal(node1.getlockstats(), {'enabled': False, 'locks': {}})
+
+
+if __name__ == '__main__':
+    QtumLockStatsTest().main()
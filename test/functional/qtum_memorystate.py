@@ -0,0 +1,45 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test -memorystate, which keeps the chain state and the contract state in memory."""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, wait_until
+from test_framework.qtumconfig import COINBASE_MATURITY
+
+class QtumMemoryStateTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [['-memorystate'], []]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 10)
+
+        # The constructor stores i + 1 in slot i for i < 40, the runtime code is a single STOP
+        bytecode = "60005b80600101815560010180602811600257" + "60016000f3"
+        contract = node.createcontract(bytecode)['address']
+        node.generate(1)
+        self.sync_all()
+
+        self.log.info("The contract state is the same as on disk")
+        tip = node.getblock(node.getbestblockhash())
+        assert_equal(self.nodes[1].getbestblockhash(), tip['hash'])
+        storage = node.getstorage(contract)
+        assert_equal(len(storage), 40)
+        assert_equal(self.nodes[1].getstorage(contract), storage)
+
+        self.log.info("The chain is connected again at restart")
+        self.restart_node(0)
+        node = self.nodes[0]
+        wait_until(lambda: node.getbestblockhash() == tip['hash'])
+        assert_equal(node.getstorage(contract), storage)
+        assert_equal(node.getblock(node.getbestblockhash())['hashStateRoot'], tip['hashStateRoot'])
+
+if __name__ == '__main__':
+    QtumMemoryStateTest().main()
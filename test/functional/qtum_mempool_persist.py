@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test reloading mempool.dat with contract transactions, at the tip it was saved at and at another one."""
+import os
+import shutil
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, wait_until
+from test_framework.qtumconfig import COINBASE_MATURITY
+
+# Adds its argument to a storage slot and returns the sum when called with 5b9af12b
+CONTRACT = "6060604052600d600055341561001457600080fd5b61017e806100236000396000f30060606040526004361061004c576000357c0100000000000000000000000000000000000000000000000000000000900463ffffffff168063027c1aaf1461004e5780635b9af12b14610058575b005b61005661008f565b005b341561006357600080fd5b61007960048080359060200190919050506100a1565b6040518082815260200191505060405180910390f35b60026000808282540292505081905550565b60007fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a17fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a1816000540160008190555060005490509190505600a165627a7a7230582015732bfa66bdede47ecc05446bf4c1e8ed047efac25478cb13b795887df70f290029"
+ADD = "5b9af12b"
+
+class QtumMempoolPersistTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def entries(self):
+        mempool = self.nodes[0].getrawmempool(True)
+        return {txid: (entry['fees']['base'], entry['fees']['modified']) for txid, entry in mempool.items()}
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 100)
+        contract = node.createcontract(CONTRACT)['address']
+        # The tip is left empty, so invalidating it later only changes the tip
+        node.generate(2)
+
+        for i in range(1, 6):
+            node.sendtocontract(contract, ADD + hex(i)[2:].zfill(64))
+        for _ in range(5):
+            node.sendtoaddress(node.getnewaddress(), 1)
+        node.prioritisetransaction(node.getrawmempool()[0], 0, 1000)
+        entries = self.entries()
+        assert_equal(len(entries), 10)
+
+        self.log.info("Reload at the tip the mempool was saved at")
+        self.restart_node(0)
+        wait_until(lambda: len(self.nodes[0].getrawmempool()) == 10, timeout=10)
+        assert_equal(self.entries(), entries)
+
+        self.log.info("Reload after the tip changed")
+        node = self.nodes[0]
+        mempooldat = os.path.join(node.datadir, 'regtest', 'mempool.dat')
+        node.savemempool()
+        shutil.copyfile(mempooldat, mempooldat + '.saved')
+        node.invalidateblock(node.getbestblockhash())
+        entries = self.entries()
+        self.stop_node(0)
+        shutil.move(mempooldat + '.saved', mempooldat)
+        self.start_node(0)
+        wait_until(lambda: len(self.nodes[0].getrawmempool()) == len(entries), timeout=10)
+        assert_equal(self.entries(), entries)
+
+        self.log.info("The reloaded transactions are mined")
+        self.nodes[0].generate(1)
+        assert_equal(self.nodes[0].getrawmempool(), [])
+        assert_equal(int(self.nodes[0].callcontract(contract, ADD + "0" * 64)['executionResult']['output'], 16), 13 + 15)
+
+if __name__ == '__main__':
+    QtumMempoolPersistTest().main()
@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+# Copyright (c) 2015-2016 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import *
+from test_framework.qtum import *
+from test_framework.qtumconfig import *
+
+
+class MempoolPreExecTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [['-mempoolpreexec'], []]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def run_test(self):
+        self.nodes[0].generate(COINBASE_MATURITY+10)
+        self.sync_all()
+
+        txid = self.nodes[0].createcontract("00")['txid']
+        self.sync_mempools()
+        preexec = self.nodes[0].getmempoolentry(txid)['preexec']
+        assert_equal(preexec['tip'], self.nodes[0].getbestblockhash())
+        assert(preexec['gasused'] > 0)
+        assert(preexec['time_ms'] >= 0)
+        assert_equal(preexec['excepted'], False)
+        assert_equal(preexec['estimated'], False)
+        # Only executed by the nodes that ask for it
+        assert('preexec' not in self.nodes[1].getmempoolentry(txid))
+
+        self.nodes[0].generate(1)
+        self.sync_all()
+        assert_equal(self.nodes[0].getrawmempool(), [])
+        assert(txid in self.nodes[0].getblock(self.nodes[0].getbestblockhash())['tx'])
+
+        # A dry run of the same creation on the same state stands for the execution
+        sender = self.nodes[0].getnewaddress()
+        self.nodes[0].sendtoaddress(sender, 100)
+        self.nodes[0].generate(1)
+        self.sync_all()
+        estimate = self.nodes[0].estimategas("", "00", sender)
+        assert_equal(estimate['cached'], False)
+        assert_equal(estimate['excepted'], "None")
+        assert(estimate['gasUsed'] > 0)
+        tip = self.nodes[0].getblock(self.nodes[0].getbestblockhash())
+        assert_equal(estimate['stateRoot'], tip['hashStateRoot'])
+        assert_equal(estimate['utxoRoot'], tip['hashUTXORoot'])
+        again = self.nodes[0].estimategas("", "00", sender)
+        assert_equal(again['cached'], True)
+        assert_equal(again['gasUsed'], estimate['gasUsed'])
+        # A different call is executed
+        assert_equal(self.nodes[0].estimategas("", "0000", sender)['cached'], False)
+
+        txid = self.nodes[0].createcontract("00", 1000000, QTUM_MIN_GAS_PRICE_STR, sender)['txid']
+        preexec = self.nodes[0].getmempoolentry(txid)['preexec']
+        assert_equal(preexec['estimated'], True)
+        assert_equal(preexec['gasused'], estimate['gasUsed'])
+        self.nodes[0].generate(1)
+        assert(txid in self.nodes[0].getblock(self.nodes[0].getbestblockhash())['tx'])
+
+        # A reorg puts the tx back into the mempool and executes it in a background pass
+        self.nodes[0].invalidateblock(self.nodes[0].getbestblockhash())
+        assert(txid in self.nodes[0].getrawmempool())
+        self.nodes[0].syncwithvalidationinterfacequeue()
+        preexec = self.nodes[0].getmempoolentry(txid)['preexec']
+        assert_equal(preexec['tip'], self.nodes[0].getbestblockhash())
+        assert_equal(preexec['gasused'], estimate['gasUsed'])
+
+if __name__ == '__main__':
+    MempoolPreExecTest().main()
@@ -0,0 +1,45 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test that the shared staking thread stakes with whichever loaded wallet owns the kernel."""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, assert_raises_rpc_error, wait_until
+from test_framework.qtumconfig import COINBASE_MATURITY
+
+class QtumMultiWalletStakingTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+        self.extra_args = [['-staking=1', '-wallet=w1', '-wallet=w2']]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def run_test(self):
+        node = self.nodes[0]
+        w1 = node.get_wallet_rpc('w1')
+        w2 = node.get_wallet_rpc('w2')
+
+        # Only the second wallet has coins to stake
+        node.generatetoaddress(COINBASE_MATURITY + 100, w2.getnewaddress())
+        height = node.getblockcount()
+
+        self.log.info("The wallet with the coins stakes the next block")
+        wait_until(lambda: node.getblockcount() > height, timeout=120)
+        block = node.getblock(node.getblockhash(height + 1))
+        assert_equal(block['flags'], 'proof-of-stake')
+        coinstake = block['tx'][1]
+        assert_equal(w2.gettransaction(coinstake)['txid'], coinstake)
+        assert_raises_rpc_error(-5, "Invalid or non-wallet transaction id", w1.gettransaction, coinstake)
+        assert(w2.getstakinginfo()['staking'])
+        assert_equal(w1.getstakinginfo()['staking'], False)
+
+        self.log.info("A staking wallet unloads while the thread keeps running for the others")
+        node.unloadwallet('w2')
+        assert_equal(node.listwallets(), ['w1'])
+        assert_equal(w1.getstakinginfo()['staking'], False)
+
+if __name__ == '__main__':
+    QtumMultiWalletStakingTest().main()
@@ -197,6 +197,36 @@ class QtumOpSenderTest(BitcoinTestFramework):
         self.nodes[0].generate(10)
         assert_equal(self.nodes[0].listcontracts()[contract_address], old_balance+len(outputs))
 
+    """
+        Blocks connect the same whether the sender checks of their txs were cached on mempool entry or not
+    """
+    def cached_sender_check_tx_test(self):
+        contract_address = sorted(self.nodes[0].listcontracts().keys())[-1]
+        old_balance = self.nodes[0].listcontracts()[contract_address]
+        key = ECKey()
+        key.set(hash256(b'\x01'), True)
+        output = CTxOut(COIN, CScript([CScriptNum(1), hash160(key.get_pubkey().get_bytes()), b'', OP_SENDER,
+                b'\x04', CScriptNum(1000000), CScriptNum(40), hex_str_to_bytes("00"), hex_str_to_bytes(contract_address), OP_CALL]))
+
+        # Accepted to the mempools of both nodes, which find its sender checks cached when it is mined
+        self.create_op_sender_tx([key], [output], [SIGHASH_ALL], 40000000)
+        self.nodes[1].generate(1)
+        self.sync_all()
+        assert_equal(self.nodes[0].listcontracts()[contract_address], old_balance+1)
+        assert_equal(self.nodes[1].listcontracts()[contract_address], old_balance+1)
+
+        # Only in the mempool of node 1, so node 0 runs the sender checks when it connects the block
+        tx, input_txout = self.create_op_sender_tx([key], [output], [SIGHASH_ALL], 40000000, False)
+        disconnect_nodes(self.nodes[0], 1)
+        disconnect_nodes(self.nodes[1], 0)
+        txid = self.nodes[1].sendrawtransaction(bytes_to_hex_str(tx.serialize()))
+        self.nodes[1].generate(1)
+        connect_nodes_bi(self.nodes, 0, 1)
+        self.sync_blocks()
+        assert(txid in self.nodes[0].getblock(self.nodes[0].getbestblockhash())['tx'])
+        assert_equal(self.nodes[0].listcontracts()[contract_address], old_balance+2)
+        assert_equal(self.nodes[1].listcontracts()[contract_address], old_balance+2)
+
     """
         Make sure that signed outputs cannot be reused in different transactions
     """
@@ -477,6 +507,7 @@ class QtumOpSenderTest(BitcoinTestFramework):
         self.single_op_sender_op_create_tx_test()
         self.single_op_sender_op_call_tx_test()
         self.all_sigtypes_outputs_in_single_tx_test()
+        self.cached_sender_check_tx_test()
         self.replay_sighash_op_sender_output_test()
         self.mixed_opsender_and_non_op_sender_tx_and_refund_verification_test()
         self.large_contract_deployment_tx_test()
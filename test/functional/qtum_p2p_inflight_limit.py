@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the number of blocks in flight from a peer adapting to its ping and delivery times.
+
+A peer that answers pings slowly but delivers blocks at once is allowed more than
+MAX_BLOCKS_IN_TRANSIT_PER_PEER blocks in flight, up to 128. A peer answering pings
+at once stays at a lower limit.
+"""
+import threading
+
+from test_framework.messages import CBlock, CBlockHeader, FromHex, MSG_BLOCK, MSG_TYPE_MASK, msg_headers, msg_pong, msg_witness_block
+from test_framework.mininode import P2PInterface, mininode_lock
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, wait_until
+
+MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16
+MAX_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER = 128
+
+class BlockSource(P2PInterface):
+    def __init__(self, blocks, ping_delay):
+        super().__init__()
+        self.blocks = {b.sha256: b for b in blocks}
+        self.ping_delay = ping_delay
+        self.max_getdata = 0
+
+    def on_ping(self, message):
+        if self.ping_delay:
+            threading.Timer(self.ping_delay, self.send_message, [msg_pong(message.nonce)]).start()
+        else:
+            super().on_ping(message)
+
+    def on_getdata(self, message):
+        self.max_getdata = max(self.max_getdata, len(message.inv))
+        for inv in message.inv:
+            if (inv.type & MSG_TYPE_MASK) == MSG_BLOCK and inv.hash in self.blocks:
+                self.send_message(msg_witness_block(self.blocks[inv.hash]))
+
+class QtumP2PInflightLimitTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 3
+
+    def setup_network(self):
+        self.setup_nodes()
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def sync_from_peer(self, node, blocks, ping_delay):
+        peer = node.add_p2p_connection(BlockSource(blocks, ping_delay))
+        # Let the first ping be answered before the blocks are announced
+        wait_until(lambda: node.getpeerinfo()[0].get('minping', 0) > 0, timeout=30)
+        for i in range(0, len(blocks), 2000):
+            peer.send_message(msg_headers([CBlockHeader(b) for b in blocks[i:i + 2000]]))
+        wait_until(lambda: node.getblockcount() == len(blocks), timeout=120)
+        info = node.getpeerinfo()[0]
+        with mininode_lock:
+            return info, peer.max_getdata
+
+    def run_test(self):
+        hashes = self.nodes[2].generate(400)
+        blocks = [FromHex(CBlock(), self.nodes[2].getblock(h, 0)) for h in hashes]
+        for b in blocks:
+            b.rehash()
+
+        self.log.info("A high-latency peer delivering blocks quickly gets more blocks in flight")
+        slow, max_getdata = self.sync_from_peer(self.nodes[0], blocks, 1)
+        assert slow['minping'] >= 1
+        assert slow['inflightlimit'] > MAX_BLOCKS_IN_TRANSIT_PER_PEER
+        assert slow['inflightlimit'] <= MAX_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER
+        assert max_getdata > MAX_BLOCKS_IN_TRANSIT_PER_PEER
+        assert_equal(self.nodes[0].getbestblockhash(), hashes[-1])
+
+        self.log.info("A peer answering pings at once gets fewer blocks in flight")
+        fast, _ = self.sync_from_peer(self.nodes[1], blocks, 0)
+        assert fast['inflightlimit'] >= MAX_BLOCKS_IN_TRANSIT_PER_PEER
+        assert fast['inflightlimit'] < slow['inflightlimit']
+        assert_equal(self.nodes[1].getbestblockhash(), hashes[-1])
+
+if __name__ == '__main__':
+    QtumP2PInflightLimitTest().main()
@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the socket handler across peers coming and going, paused peers and queued sends.
+
+The sockets stay registered with the event queue of the socket handler between
+passes, so peers reconnecting on a reused descriptor, a peer whose receiving was
+paused and a peer with a long send queue must all keep being served.
+"""
+from test_framework.messages import CInv, MSG_BLOCK, msg_getdata, msg_ping
+from test_framework.mininode import P2PInterface, mininode_lock
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, connect_nodes_bi, wait_until
+
+class BlockCounter(P2PInterface):
+    def __init__(self):
+        super().__init__()
+        self.blocks = set()
+
+    def on_block(self, message):
+        message.block.calc_sha256()
+        self.blocks.add(message.block.sha256)
+
+class QtumP2PSocketEventsTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        # A small receive buffer lets a burst of messages pause the peer
+        self.extra_args = [['-maxreceivebuffer=1'], []]
+
+    def run_test(self):
+        node = self.nodes[0]
+
+        self.log.info("Peers connecting and disconnecting are served on reused descriptors")
+        peers = [node.add_p2p_connection(P2PInterface()) for i in range(10)]
+        for peer in peers:
+            peer.sync_with_ping()
+        for peer in peers[:5]:
+            peer.peer_disconnect()
+        wait_until(lambda: len(node.getpeerinfo()) == 6, timeout=10)
+        node.p2ps = peers[5:]
+        peers = peers[5:] + [node.add_p2p_connection(P2PInterface()) for i in range(5)]
+        for peer in peers:
+            peer.sync_with_ping()
+        assert_equal(len(node.getpeerinfo()), 11)
+        node.disconnect_p2ps()
+        wait_until(lambda: len(node.getpeerinfo()) == 1, timeout=10)
+
+        self.log.info("A peer paused by a burst of messages is read from again")
+        peer = node.add_p2p_connection(P2PInterface())
+        for i in range(500):
+            peer.send_message(msg_ping(nonce=i + 1000))
+        peer.sync_with_ping()
+        wait_until(lambda: peer.message_count['pong'] >= 501, timeout=30, lock=mininode_lock)
+
+        self.log.info("A long send queue is flushed")
+        hashes = node.generate(100)
+        self.sync_all()
+        peer = node.add_p2p_connection(BlockCounter())
+        peer.send_message(msg_getdata([CInv(MSG_BLOCK, int(h, 16)) for h in hashes]))
+        wait_until(lambda: len(peer.blocks) == len(hashes), timeout=30, lock=mininode_lock)
+        peer.sync_with_ping()
+
+        self.log.info("Nodes keep relaying blocks after reconnecting")
+        self.stop_node(1)
+        self.start_node(1)
+        connect_nodes_bi(self.nodes, 0, 1)
+        self.nodes[1].generate(5)
+        self.sync_all()
+        assert_equal(node.getbestblockhash(), self.nodes[1].getbestblockhash())
+
+if __name__ == '__main__':
+    QtumP2PSocketEventsTest().main()
@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test that blocks connect to the same state with the contract speculation of -parcontract."""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, connect_nodes_bi
+from test_framework.qtumconfig import COINBASE_MATURITY
+
+# Adds its argument to a storage slot and returns the sum when called with 5b9af12b
+CONTRACT = "6060604052600d600055341561001457600080fd5b61017e806100236000396000f30060606040526004361061004c576000357c0100000000000000000000000000000000000000000000000000000000900463ffffffff168063027c1aaf1461004e5780635b9af12b14610058575b005b61005661008f565b005b341561006357600080fd5b61007960048080359060200190919050506100a1565b6040518082815260200191505060405180910390f35b60026000808282540292505081905550565b60007fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a17fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a1816000540160008190555060005490509190505600a165627a7a7230582015732bfa66bdede47ecc05446bf4c1e8ed047efac25478cb13b795887df70f290029"
+ADD = "5b9af12b"
+
+class QtumParContractTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        # node0 speculates on the contract transactions of the blocks it connects
+        self.extra_args = [['-parcontract=4'], []]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def value(self, node, contract):
+        return int(node.callcontract(contract, ADD + "0" * 64)['executionResult']['output'], 16)
+
+    def fill_block(self, node, contracts):
+        """Independent calls to each contract, and calls depending on the earlier ones of the block."""
+        for i in range(3):
+            for contract in contracts:
+                node.sendtocontract(contract, ADD + hex(i + 1)[2:].zfill(64))
+        node.createcontract(CONTRACT)
+
+    def check_same_state(self, contracts):
+        self.sync_all()
+        node0, node1 = self.nodes
+        tip0 = node0.getblock(node0.getbestblockhash())
+        tip1 = node1.getblock(node1.getbestblockhash())
+        assert_equal(tip0['hashStateRoot'], tip1['hashStateRoot'])
+        assert_equal(tip0['hashUTXORoot'], tip1['hashUTXORoot'])
+        for contract in contracts:
+            assert_equal(self.value(node0, contract), self.value(node1, contract))
+
+    def run_test(self):
+        node0, node1 = self.nodes
+        node0.generate(COINBASE_MATURITY + 20)
+        node1.generate(20)
+        self.sync_all()
+        node0.generate(COINBASE_MATURITY)
+        self.sync_all()
+
+        contracts = [node0.createcontract(CONTRACT)['address'] for i in range(4)]
+        node0.generate(1)
+        self.check_same_state(contracts)
+
+        self.log.info("node0 speculates on the calls of a block mined by node1")
+        self.fill_block(node1, contracts)
+        node1.generate(1)
+        self.check_same_state(contracts)
+        # Every contract was called with 1, 2 and 3 on top of its initial 13
+        for contract in contracts:
+            assert_equal(self.value(node0, contract), 13 + 6)
+
+        self.log.info("node1 accepts the blocks node0 mined with speculation")
+        self.fill_block(node0, contracts)
+        node0.generate(1)
+        self.check_same_state(contracts)
+
+        self.log.info("The speculations left the state databases of node0 consistent")
+        self.restart_node(0, ['-parcontract=4', '-checklevel=4', '-checkblocks=5'])
+        connect_nodes_bi(self.nodes, 0, 1)
+        self.check_same_state(contracts)
+
+if __name__ == '__main__':
+    QtumParContractTest().main()
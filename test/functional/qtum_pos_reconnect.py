@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test that proof-of-stake blocks connect again after invalidateblock, reconsiderblock and a -checklevel=4 restart."""
+import struct
+import time
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, bytes_to_hex_str, hash256
+from test_framework.address import byte_to_base58
+from test_framework.qtum import collect_prevouts, create_unsigned_pos_block
+
+class QtumPoSReconnectTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def stake_block(self):
+        node = self.nodes[0]
+        tip = node.getblock(node.getbestblockhash())
+        block, block_sig_key = create_unsigned_pos_block(node, self.staking_prevouts, nTime=(tip['time'] + 0x10) & 0xfffffff0)
+        block.sign_block(block_sig_key)
+        block.rehash()
+        assert_equal(node.submitblock(bytes_to_hex_str(block.serialize())), None)
+        assert_equal(node.getbestblockhash(), block.hash)
+        self.staking_prevouts = [prevout for prevout in self.staking_prevouts if prevout[0].serialize() != block.prevoutStake.serialize()]
+        return block.hash
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.importprivkey(byte_to_base58(hash256(struct.pack('<I', 0)), 239))
+        node.setmocktime(int(time.time() - 100*24*60*60))
+        node.generatetoaddress(550, "qSrM9K6FMhZ29Vkp8Rdk8Jp66bbfpjFETq")
+        self.staking_prevouts = collect_prevouts(node)
+        node.setmocktime(0)
+
+        pos_blocks = [self.stake_block() for _ in range(3)]
+        proofs = [node.getblock(block)['proofhash'] for block in pos_blocks]
+
+        self.log.info("Reconnect the stakes with reconsiderblock")
+        node.invalidateblock(pos_blocks[0])
+        assert_equal(node.getblockcount(), 550)
+        node.reconsiderblock(pos_blocks[0])
+        assert_equal(node.getbestblockhash(), pos_blocks[-1])
+        assert_equal([node.getblock(block)['proofhash'] for block in pos_blocks], proofs)
+
+        self.log.info("Replay the stakes when restarting with -checklevel=4")
+        self.restart_node(0, ['-checklevel=4', '-checkblocks=10'])
+        assert_equal(self.nodes[0].getbestblockhash(), pos_blocks[-1])
+        assert_equal([self.nodes[0].getblock(block)['proofhash'] for block in pos_blocks], proofs)
+        self.stake_block()
+
+if __name__ == '__main__':
+    QtumPoSReconnectTest().main()
@@ -0,0 +1,41 @@
+#!/usr/bin/env python3
+# Copyright (c) 2015-2016 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import *
+from test_framework.qtum import *
+from test_framework.qtumconfig import *
+
+
+class PrefetchBlocksTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def run_test(self):
+        self.node = self.nodes[0]
+        self.node.generate(COINBASE_MATURITY+50)
+        # contract test { uint a; function test() payable { a = 13; } function add() payable returns (uint) { a += 13; return a; } }
+        contract_data = self.node.createcontract("60606040525b600d6000819055505b5b60a98061001d6000396000f30060606040523615603d576000357c0100000000000000000000000000000000000000000000000000000000900463ffffffff1680634f2be91f146045575b60435b5b565b005b604b6061565b6040518082815260200191505060405180910390f35b6000600d60006000828254019250508190555060005490505b905600a165627a7a72305820fd0deb11ff6c6a06f612b5fb04e7312f22eacec75d677c0fbc0194d86772d2d70029", 1000000, QTUM_MIN_GAS_PRICE_STR)
+        contract_address = contract_data['address']
+        self.node.generate(1)
+        for i in range(5):
+            self.node.sendtocontract(contract_address, "4f2be91f", 0, 1000000, QTUM_MIN_GAS_PRICE_STR)
+            self.node.generate(1)
+        self.sync_all()
+        tip = self.node.getbestblockhash()
+        result = self.node.callcontract(contract_address, "4f2be91f")['executionResult']['output']
+
+        # Reconnect the whole chain from disk with the read-ahead enabled
+        self.restart_node(1, ['-reindex', '-prefetchblocks=8'])
+        wait_until(lambda: self.nodes[1].getbestblockhash() == tip)
+        assert_equal(self.nodes[1].getblock(tip)['hashStateRoot'], self.node.getblock(tip)['hashStateRoot'])
+        assert_equal(self.nodes[1].callcontract(contract_address, "4f2be91f")['executionResult']['output'], result)
+
+if __name__ == '__main__':
+    PrefetchBlocksTest().main()
@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test that -prunestate keeps the contract state needed after a restart, a crash and a reorg."""
+
+import os
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, wait_until
+from test_framework.qtumconfig import COINBASE_MATURITY
+
+# Adds its argument to a storage slot and returns the sum when called with 5b9af12b
+CONTRACT = "6060604052600d600055341561001457600080fd5b61017e806100236000396000f30060606040526004361061004c576000357c0100000000000000000000000000000000000000000000000000000000900463ffffffff168063027c1aaf1461004e5780635b9af12b14610058575b005b61005661008f565b005b341561006357600080fd5b61007960048080359060200190919050506100a1565b6040518082815260200191505060405180910390f35b60026000808282540292505081905550565b60007fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a17fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a1816000540160008190555060005490509190505600a165627a7a7230582015732bfa66bdede47ecc05446bf4c1e8ed047efac25478cb13b795887df70f290029"
+PRUNE_STATE_INTERVAL = 1000
+ARGS = ['-prunestate=%d' % COINBASE_MATURITY, '-debug=prune']
+
+class QtumPruneStateTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+        self.extra_args = [ARGS]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def add(self, value):
+        self.node.sendtocontract(self.contract, "5b9af12b" + hex(value)[2:].zfill(64))
+        self.node.generate(1)
+
+    def value(self):
+        return int(self.node.callcontract(self.contract, "5b9af12b" + "0" * 64)['executionResult']['output'], 16)
+
+    def prune_runs(self):
+        with open(os.path.join(self.node.datadir, 'regtest', 'debug.log'), encoding='utf-8') as debug_log:
+            return debug_log.read().count('Pruned ')
+
+    def generate_to_prune(self):
+        """Connect blocks up to the next pruning height and wait for the run to complete."""
+        runs = self.prune_runs()
+        height = self.node.getblockcount()
+        self.node.generate(PRUNE_STATE_INTERVAL - height % PRUNE_STATE_INTERVAL)
+        wait_until(lambda: self.prune_runs() > runs)
+
+    def run_test(self):
+        self.node = self.nodes[0]
+        self.node.generate(COINBASE_MATURITY + 10)
+        self.contract = self.node.createcontract(CONTRACT)['address']
+        self.node.generate(1)
+        self.add(1)
+
+        self.log.info("The state of the last flush of the coins is kept while the flush lags")
+        self.node.gettxoutsetinfo()
+        flushed_height = self.node.getblockcount()
+        flushed_value = self.value()
+        self.add(2)
+        self.generate_to_prune()
+        self.add(3)
+        self.generate_to_prune()
+        # The blocks since the flush are far below the kept window by now
+        assert self.node.getblockcount() - flushed_height > COINBASE_MATURITY
+        tip_value = self.value()
+
+        self.log.info("The node resumes from the flushed coins after a crash")
+        self.node.kill_process()
+        self.start_node(0, ARGS)
+        # The block index may have been lost with the coins, or connected again from them
+        height = self.node.getblockcount()
+        assert height in (flushed_height, PRUNE_STATE_INTERVAL * 2)
+        assert_equal(self.value(), flushed_value if height == flushed_height else tip_value)
+        self.add(4)
+        value = self.value()
+
+        self.log.info("The state within the window survives a restart and a reorg")
+        self.node.gettxoutsetinfo()
+        self.generate_to_prune()
+        self.restart_node(0, ARGS)
+        assert_equal(self.value(), value)
+        self.add(5)
+        self.node.generate(50)
+        tip = self.node.getbestblockhash()
+        fork = self.node.getblockhash(self.node.getblockcount() - COINBASE_MATURITY + 10)
+        self.node.invalidateblock(fork)
+        assert_equal(self.value(), value)
+        self.node.reconsiderblock(fork)
+        assert_equal(self.node.getbestblockhash(), tip)
+        assert_equal(self.value(), value + 5)
+
+if __name__ == '__main__':
+    QtumPruneStateTest().main()
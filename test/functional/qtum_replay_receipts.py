@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test that the receipts the log index replays match those recorded when the blocks were connected."""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, connect_nodes_bi, disconnect_nodes, wait_until
+from test_framework.qtumconfig import COINBASE_MATURITY
+
+# Emits two logs and adds its argument to a storage slot when called with 5b9af12b
+CONTRACT = "6060604052600d600055341561001457600080fd5b61017e806100236000396000f30060606040526004361061004c576000357c0100000000000000000000000000000000000000000000000000000000900463ffffffff168063027c1aaf1461004e5780635b9af12b14610058575b005b61005661008f565b005b341561006357600080fd5b61007960048080359060200190919050506100a1565b6040518082815260200191505060405180910390f35b60026000808282540292505081905550565b60007fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a17fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a1816000540160008190555060005490509190505600a165627a7a7230582015732bfa66bdede47ecc05446bf4c1e8ed047efac25478cb13b795887df70f290029"
+
+class QtumReplayReceiptsTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        # The receipts of node0 come from ConnectBlock, node1 replays them when it enables the log index
+        self.extra_args = [['-logevents'], []]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def call(self, node, contract, value):
+        node.sendtocontract(contract, "5b9af12b" + hex(value)[2:].zfill(64))
+
+    def run_test(self):
+        node0, node1 = self.nodes
+        node0.generate(COINBASE_MATURITY + 10)
+        node0.sendtoaddress(node1.getnewaddress(), 1000)
+        node0.generate(1)
+        self.sync_all()
+
+        contract = node0.createcontract(CONTRACT)['address']
+        node0.generate(1)
+        self.sync_all()
+
+        self.log.info("Contract calls on two branches")
+        disconnect_nodes(node0, 1)
+        disconnect_nodes(node1, 0)
+        self.call(node0, contract, 1)
+        node0.generate(1)
+        self.call(node1, contract, 2)
+        node1.generate(1)
+        self.call(node1, contract, 3)
+        node1.generate(1)
+
+        self.log.info("node0 reorgs to the longer branch and includes its call again")
+        connect_nodes_bi(self.nodes, 0, 1)
+        self.sync_blocks()
+        assert_equal(node0.getbestblockhash(), node1.getbestblockhash())
+        node0.generate(1)
+        self.sync_all()
+
+        self.log.info("The state pruning can't delete the state the log index replays")
+        self.stop_node(1)
+        node1.assert_start_raises_init_error(['-logevents', '-prunestate=%d' % COINBASE_MATURITY],
+            'Error: Contract state pruning is incompatible with -logevents.')
+
+        self.log.info("node1 replays the receipts of the whole chain")
+        self.start_node(1, ['-logevents'])
+        connect_nodes_bi(self.nodes, 0, 1)
+        tip = node0.getbestblockhash()
+        wait_until(lambda: node1.getblocktransactionreceipts(tip) != [])
+        height = node0.getblockcount()
+        for h in range(height - 5, height + 1):
+            blockhash = node0.getblockhash(h)
+            receipts = node0.getblocktransactionreceipts(blockhash)
+            assert_equal(node1.getblocktransactionreceipts(blockhash), receipts)
+        # Every branch block had a call with two logs
+        for h in range(height - 2, height + 1):
+            receipts = node0.getblocktransactionreceipts(node0.getblockhash(h))
+            assert_equal(len(receipts), 1)
+            assert_equal(len(receipts[0]['log']), 2)
+
+if __name__ == '__main__':
+    QtumReplayReceiptsTest().main()
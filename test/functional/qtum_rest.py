@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the contract endpoints of the REST interface against their RPCs."""
+from decimal import Decimal
+import http.client
+import json
+import urllib.parse
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal
+from test_framework.qtumconfig import COINBASE_MATURITY
+
+# Adds its argument to a storage slot and returns the sum when called with 5b9af12b
+CONTRACT = "6060604052600d600055341561001457600080fd5b61017e806100236000396000f30060606040526004361061004c576000357c0100000000000000000000000000000000000000000000000000000000900463ffffffff168063027c1aaf1461004e5780635b9af12b14610058575b005b61005661008f565b005b341561006357600080fd5b61007960048080359060200190919050506100a1565b6040518082815260200191505060405180910390f35b60026000808282540292505081905550565b60007fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a17fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a1816000540160008190555060005490509190505600a165627a7a7230582015732bfa66bdede47ecc05446bf4c1e8ed047efac25478cb13b795887df70f290029"
+ADD = "5b9af12b"
+
+class QtumRESTTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+        self.extra_args = [['-rest', '-logevents']]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def rest(self, uri, status=200):
+        conn = http.client.HTTPConnection(self.url.hostname, self.url.port)
+        conn.request('GET', '/rest' + uri)
+        resp = conn.getresponse()
+        assert_equal(resp.status, status)
+        return resp.read()
+
+    def rest_json(self, uri):
+        return json.loads(self.rest(uri + '.json').decode('utf-8'), parse_float=Decimal)
+
+    def run_test(self):
+        node = self.nodes[0]
+        self.url = urllib.parse.urlparse(node.url)
+        node.generate(COINBASE_MATURITY + 10)
+        contract = node.createcontract(CONTRACT)['address']
+        node.generate(1)
+        txid = node.sendtocontract(contract, ADD + hex(5)[2:].zfill(64))['txid']
+        node.generate(1)
+
+        self.log.info("Receipts")
+        assert_equal(self.rest_json('/receipt/' + txid), node.gettransactionreceipt(txid))
+        record = self.rest('/receipt/%s.bin' % txid)
+        assert(len(record) > 0)
+        assert_equal(self.rest('/receipt/%s.hex' % txid).decode().strip(), record.hex())
+        self.rest('/receipt/nothex.json', 400)
+
+        self.log.info("Contract calls")
+        data = ADD + hex(1)[2:].zfill(64)
+        call = node.callcontract(contract, data)
+        assert_equal(self.rest_json('/callcontract/%s/%s' % (contract, data)), call)
+        output = call['executionResult']['output']
+        assert_equal(int(output, 16), 13 + 5 + 1)
+        assert_equal(self.rest('/callcontract/%s/%s.bin' % (contract, data)).hex(), output)
+        assert_equal(self.rest('/callcontract/%s/%s.hex' % (contract, data)).decode().strip(), output)
+        self.rest('/callcontract/%s.json' % contract, 400)
+        self.rest('/callcontract/%s/%s.json' % ('00' * 20, data), 404)
+
+        self.log.info("Storage")
+        height = node.getblockcount()
+        assert_equal(self.rest_json('/storage/' + contract), node.getstorage(contract))
+        assert_equal(self.rest_json('/storage/%s/%d' % (contract, height - 1)), node.getstorage(contract, height - 1))
+        assert(self.rest_json('/storage/' + contract) != self.rest_json('/storage/%s/%d' % (contract, height - 1)))
+        self.rest('/storage/%s/nan.json' % contract, 400)
+        self.rest('/storage/%s.bin' % contract, 404)
+
+if __name__ == '__main__':
+    QtumRESTTest().main()
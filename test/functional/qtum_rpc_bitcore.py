@@ -68,6 +68,7 @@ class QtumBitcoreTest(BitcoinTestFramework):
             expected_address_txids.append(node.sendtoaddress(confirmed_address, 10))
         time.sleep(0.1)
         node.generate(1)
+        confirmed_height = node.getblockcount()
         mempool_txid = node.sendtoaddress(mempool_address, 19999)
 
         # check dgp info
@@ -82,9 +83,29 @@ class QtumBitcoreTest(BitcoinTestFramework):
 
         ret = node.getaddressbalance({'addresses': [confirmed_address]})
         assert_equal(ret['balance'], 10000000000)
+        assert_equal(ret['received'], 10000000000)
+        assert_equal(ret['txcount'], 10)
+        assert_equal(ret['lastheight'], confirmed_height)
 
         ret = node.getaddressutxos({'addresses': [confirmed_address]})
 
+        # The same results by pages, with the cursor of each page
+        for method, key in [(node.getaddresstxids, 'txids'), (node.getaddressdeltas, 'deltas'), (node.getaddressutxos, 'utxos')]:
+            items = []
+            params = {'addresses': [confirmed_address, mempool_address], 'limit': 3}
+            while True:
+                page = method(params)
+                assert(len(page[key]) <= 3)
+                items += page[key]
+                if page['cursor'] is None:
+                    break
+                params['cursor'] = page['cursor']
+            assert_equal(len(items), 10)
+            if key == 'txids':
+                assert_equal(set(items), set(expected_address_txids))
+        assert_raises_rpc_error(-8, "Invalid cursor", node.getaddresstxids, {'addresses': [confirmed_address], 'limit': 3, 'cursor': '00'})
+        assert_raises_rpc_error(-8, "Cursor is expected with a limit", node.getaddressutxos, {'addresses': [confirmed_address], 'cursor': '00'})
+
         ret = node.getaddressmempool({'addresses': [mempool_address]})
         assert_equal(ret[0]['txid'], mempool_txid)
         assert_equal(len(ret), 1)
@@ -101,6 +122,19 @@ class QtumBitcoreTest(BitcoinTestFramework):
         assert_equal(ret, {"txid": expected_address_txids[0], "index": 0, "height": 1002})
         self.sync_all()
 
+        # The address totals follow the block being disconnected and connected again
+        confirmed_block = node.getblockhash(confirmed_height)
+        node.invalidateblock(confirmed_block)
+        ret = node.getaddressbalance({'addresses': [confirmed_address]})
+        assert_equal(ret['balance'], 0)
+        assert_equal(ret['txcount'], 0)
+        assert_equal(ret['lastheight'], 0)
+        node.reconsiderblock(confirmed_block)
+        ret = node.getaddressbalance({'addresses': [confirmed_address]})
+        assert_equal(ret['balance'], 10000000000)
+        assert_equal(ret['txcount'], 10)
+        assert_equal(ret['lastheight'], confirmed_height)
+
 
 if __name__ == '__main__':
     QtumBitcoreTest().main()
\ No newline at end of file
@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test that the RPC work queue serves its clients fairly.
+
+The node runs with a single RPC thread, which a waitfornewblock call keeps busy
+while the other requests queue up. The clients are told apart by connecting from
+different loopback addresses.
+"""
+import http.client
+import json
+import threading
+import time
+import urllib.parse
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.test_node import ErrorMatch
+from test_framework.util import assert_equal, str_to_b64str
+
+class QtumRPCFairnessTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+        self.extra_args = [['-rpcthreads=1', '-rpcworkqueue=1']]
+
+    def send(self, source, method, params=[]):
+        url = urllib.parse.urlparse(self.nodes[0].url)
+        headers = {"Authorization": "Basic " + str_to_b64str(url.username + ':' + url.password)}
+        conn = http.client.HTTPConnection(url.hostname, url.port, timeout=60, source_address=(source, 0))
+        conn.request('POST', '/', json.dumps({"method": method, "params": params, "id": 1}), headers)
+        # Give the event loop time to queue the request before the next one is sent
+        time.sleep(0.2)
+        return conn
+
+    def wait_replies(self, conns):
+        """Collect the replies in the order the node sends them."""
+        order = []
+        statuses = {}
+        lock = threading.Lock()
+        def reply(name, conn):
+            status = conn.getresponse().status
+            with lock:
+                order.append(name)
+                statuses[name] = status
+        threads = [threading.Thread(target=reply, args=item) for item in conns]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        return order, statuses
+
+    def run_test(self):
+        node = self.nodes[0]
+
+        self.log.info("A flooding client is refused while the others still get in")
+        blocker = self.send('127.0.0.1', 'waitfornewblock', [2000])
+        a1 = self.send('127.0.0.1', 'getblockcount')
+        a2 = self.send('127.0.0.1', 'getblockcount')
+        b1 = self.send('127.0.0.2', 'getblockcount')
+        order, statuses = self.wait_replies([('blocker', blocker), ('a1', a1), ('a2', a2), ('b1', b1)])
+        assert_equal(statuses, {'blocker': 200, 'a1': 200, 'a2': 500, 'b1': 200})
+        # The refused request is answered at once, without waiting for a worker
+        assert_equal(order[0], 'a2')
+        workqueue = node.getrpcstats()['workqueue']
+        assert_equal(workqueue['maxdepth'], 1)
+        assert_equal(workqueue['rejected'], 1)
+        assert_equal(workqueue['depth'], 0)
+        assert_equal(workqueue['clients'], 0)
+
+        self.log.info("Clients are served in turn, weight requests per turn")
+        self.restart_node(0, ['-rpcthreads=1', '-rpcworkqueue=4', '-rpcclientweight=2@127.0.0.2'])
+        # Each served request keeps the worker busy long enough to order the replies
+        conns = [('blocker', self.send('127.0.0.3', 'waitfornewblock', [2000]))]
+        for name, source in [('a1', '127.0.0.1'), ('b1', '127.0.0.2'), ('a2', '127.0.0.1'), ('b2', '127.0.0.2'), ('b3', '127.0.0.2'), ('a3', '127.0.0.1')]:
+            conns.append((name, self.send(source, 'waitfornewblock', [300])))
+        order, statuses = self.wait_replies(conns)
+        assert_equal(set(statuses.values()), {200})
+        assert_equal(order, ['blocker', 'a1', 'b1', 'b2', 'a2', 'b3', 'a3'])
+        assert_equal(node.getrpcstats()['workqueue']['rejected'], 0)
+
+        self.log.info("Invalid client weights are refused at startup")
+        self.stop_node(0)
+        for spec in ['0@127.0.0.1', '2', 'x@127.0.0.1', '2@not/an/ip']:
+            node.assert_start_raises_init_error(['-rpcclientweight=' + spec], 'Invalid -rpcclientweight specification: ' + spec, match=ErrorMatch.PARTIAL_REGEX)
+
+if __name__ == '__main__':
+    QtumRPCFairnessTest().main()
@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the databases of the node reading through one shared block cache.
+
+The chainstate, the block index, the indexes, the contract state tries and the
+receipts database all read through the same LevelDB block cache. Run with a tiny
+-dbcache so they evict each other's blocks, and check that everything reads back
+the same across restarts and cache sizes.
+"""
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal
+from test_framework.qtumconfig import COINBASE_MATURITY
+
+# Adds its argument to a storage slot and returns the sum when called with 5b9af12b
+CONTRACT = "6060604052600d600055341561001457600080fd5b61017e806100236000396000f30060606040526004361061004c576000357c0100000000000000000000000000000000000000000000000000000000900463ffffffff168063027c1aaf1461004e5780635b9af12b14610058575b005b61005661008f565b005b341561006357600080fd5b61007960048080359060200190919050506100a1565b6040518082815260200191505060405180910390f35b60026000808282540292505081905550565b60007fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a17fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a1816000540160008190555060005490509190505600a165627a7a7230582015732bfa66bdede47ecc05446bf4c1e8ed047efac25478cb13b795887df70f290029"
+ADD = "5b9af12b"
+
+class QtumSharedBlockCacheTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+        self.extra_args = [['-dbcache=4', '-txindex', '-logevents']]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def snapshot(self):
+        node = self.nodes[0]
+        return {
+            'tip': node.getbestblockhash(),
+            'utxos': node.gettxoutsetinfo()['hash_serialized_2'],
+            'storage': [node.getstorage(c) for c in self.contracts],
+            'value': [node.callcontract(c, ADD + "0" * 64)['executionResult']['output'] for c in self.contracts],
+            'receipts': [node.gettransactionreceipt(txid) for txid in self.txids],
+            'txs': [node.getrawtransaction(txid) for txid in self.txids],
+        }
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 10)
+        self.contracts = []
+        for i in range(3):
+            self.contracts.append(node.createcontract(CONTRACT)['address'])
+        node.generate(1)
+        self.txids = []
+        for i in range(20):
+            contract = self.contracts[i % len(self.contracts)]
+            self.txids.append(node.sendtocontract(contract, ADD + hex(i + 1)[2:].zfill(64))['txid'])
+            if i % 5 == 4:
+                node.generate(1)
+        before = self.snapshot()
+        assert_equal(int(before['value'][0], 16), 13 + sum(i + 1 for i in range(0, 20, 3)))
+
+        self.log.info("Restart with the shared block cache")
+        with node.assert_debug_log(["of the above for the block cache shared by all databases"]):
+            self.restart_node(0, self.extra_args[0])
+        assert_equal(self.snapshot(), before)
+
+        self.log.info("Keep connecting blocks after the restart")
+        node.sendtocontract(self.contracts[0], ADD + hex(100)[2:].zfill(64))
+        node.generate(1)
+        value = int(node.callcontract(self.contracts[0], ADD + "0" * 64)['executionResult']['output'], 16)
+        assert_equal(value, int(before['value'][0], 16) + 100)
+        after = self.snapshot()
+
+        self.log.info("Restart with a larger cache")
+        self.restart_node(0, ['-dbcache=64', '-txindex', '-logevents'])
+        assert_equal(self.snapshot(), after)
+
+if __name__ == '__main__':
+    QtumSharedBlockCacheTest().main()
@@ -0,0 +1,38 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test that unlocking the wallet wakes the staker up instead of waiting for its next poll."""
+import time
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, wait_until
+from test_framework.qtumconfig import COINBASE_MATURITY
+
+class QtumStakerWakeupTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+        self.extra_args = [['-staking=1']]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 50)
+        node.encryptwallet("test")
+
+        self.log.info("A locked wallet does not stake")
+        # Long enough for the staker to be asleep on the locked wallet
+        time.sleep(2)
+        assert_equal(node.getstakinginfo()['staking'], False)
+
+        self.log.info("Unlocking the wallet starts staking well within the 10 second poll")
+        start = time.time()
+        node.walletpassphrase("test", 100000, True)
+        wait_until(lambda: node.getstakinginfo()['staking'], timeout=5)
+        assert(time.time() - start < 5)
+
+if __name__ == '__main__':
+    QtumStakerWakeupTest().main()
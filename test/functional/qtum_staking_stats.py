@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the staking telemetry of getstakinginfo and the stakingevent ZMQ notification."""
+import struct
+from io import BytesIO
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, p2p_port
+from test_framework.qtumconfig import COINBASE_MATURITY
+
+SIGNED, ACCEPTED = 0, 1
+
+def deser_hash(f):
+    return f.read(32)[::-1].hex()
+
+class QtumStakingStatsTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_py3_zmq()
+        self.skip_if_no_bitcoind_zmq()
+        self.skip_if_no_wallet()
+
+    def setup_network(self):
+        import zmq
+        self.zmq_context = zmq.Context()
+        self.address = "tcp://127.0.0.1:%d" % p2p_port(self.num_nodes)
+        self.extra_args = [['-staking=1', '-zmqpubstakingevent=%s' % self.address]]
+        self.add_nodes(self.num_nodes, self.extra_args)
+        self.start_nodes()
+
+    def run_test(self):
+        try:
+            self._staking_stats_test()
+        finally:
+            self.zmq_context.destroy(linger=None)
+
+    def receive_event(self):
+        topic, body, seq = self.socket.recv_multipart()
+        assert_equal(topic, b"stakingevent")
+        assert_equal(len(body), 1 + 32 + 32 + 4 + 8)
+        f = BytesIO(body)
+        event = {'type': f.read(1)[0], 'prevblock': deser_hash(f), 'block': deser_hash(f)}
+        event['time'], event['elapsed'] = struct.unpack("<IQ", f.read(12))
+        return event
+
+    def _staking_stats_test(self):
+        import zmq
+        node = self.nodes[0]
+        self.socket = self.zmq_context.socket(zmq.SUB)
+        self.socket.set(zmq.RCVTIMEO, 120000)
+        self.socket.setsockopt(zmq.SUBSCRIBE, b"stakingevent")
+        self.socket.connect(self.address)
+
+        node.generate(COINBASE_MATURITY + 100)
+        stats = node.getstakinginfo()['stakingstats']
+        assert_equal(sorted(stats['events'].keys()), ['accepted', 'expired', 'orphaned', 'rejected', 'signed'])
+        assert_equal(sorted(stats['stages'].keys()), ['contracts', 'createblock', 'search', 'sign', 'slottosigned'])
+
+        self.log.info("The staked block is signed then accepted")
+        events = []
+        while not events or events[-1]['type'] != ACCEPTED:
+            events.append(self.receive_event())
+        block = node.getblock(events[-1]['block'])
+        assert_equal(block['flags'], 'proof-of-stake')
+        signed = [event for event in events if event['type'] == SIGNED]
+        assert(signed)
+        for event in (signed[-1], events[-1]):
+            assert_equal(event['block'], block['hash'])
+            assert_equal(event['prevblock'], block['previousblockhash'])
+            assert_equal(event['time'], block['time'])
+        assert(events[-1]['elapsed'] >= signed[-1]['elapsed'])
+
+        self.log.info("getstakinginfo counts the search and the outcome")
+        stats = node.getstakinginfo()['stakingstats']
+        assert(stats['slots'] > 0)
+        assert(stats['kernels'] > 0)
+        assert(stats['events']['signed'] >= 1)
+        assert(stats['events']['accepted'] >= 1)
+        assert(stats['stages']['search']['count'] > 0)
+        assert(stats['stages']['sign']['count'] >= 1)
+        assert(stats['stages']['slottosigned']['count'] >= 1)
+
+if __name__ == '__main__':
+    QtumStakingStatsTest().main()
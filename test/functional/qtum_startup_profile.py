@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the startup profile and the databases opened beside the block index.
+
+The chain state and contract state databases are opened on threads of their
+own while the block index loads. Check that the startup profile logs every
+step, and that the chain and contract state read back the same after restarts,
+a reindex of the chain state included.
+"""
+import os
+import re
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, wait_until
+from test_framework.qtumconfig import COINBASE_MATURITY
+
+# Adds its argument to a storage slot and returns the sum when called with 5b9af12b
+CONTRACT = "6060604052600d600055341561001457600080fd5b61017e806100236000396000f30060606040526004361061004c576000357c0100000000000000000000000000000000000000000000000000000000900463ffffffff168063027c1aaf1461004e5780635b9af12b14610058575b005b61005661008f565b005b341561006357600080fd5b61007960048080359060200190919050506100a1565b6040518082815260200191505060405180910390f35b60026000808282540292505081905550565b60007fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a17fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a1816000540160008190555060005490509190505600a165627a7a7230582015732bfa66bdede47ecc05446bf4c1e8ed047efac25478cb13b795887df70f290029"
+ADD = "5b9af12b"
+
+STEPS = [
+    "application initialization",
+    "network initialization",
+    "cache configuration",
+    "block index",
+    "chain state",
+    "contract state",
+    "block rewind",
+    "block verification",
+    "indexers",
+    "wallets",
+    "block import",
+    "node start",
+]
+BACKGROUND_STEPS = [
+    "open chain state database",
+    "open contract state databases",
+]
+
+class QtumStartupProfileTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+        self.extra_args = [['-logevents']]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def snapshot(self):
+        node = self.nodes[0]
+        return {
+            'tip': node.getbestblockhash(),
+            'utxos': node.gettxoutsetinfo()['hash_serialized_2'],
+            'storage': node.getstorage(self.contract),
+            'value': node.callcontract(self.contract, ADD + "0" * 64)['executionResult']['output'],
+            'receipt': node.gettransactionreceipt(self.txid),
+            'balance': node.getbalance(),
+        }
+
+    def restart(self, extra_args=[], steps=STEPS):
+        debug_log = os.path.join(self.nodes[0].datadir, 'regtest', 'debug.log')
+        with open(debug_log, encoding='utf-8') as dl:
+            dl.seek(0, 2)
+            prev_size = dl.tell()
+        self.restart_node(0, self.extra_args[0] + extra_args)
+
+        # The profile is logged once the RPC server is out of warmup
+        def read_log():
+            with open(debug_log, encoding='utf-8') as dl:
+                dl.seek(prev_size)
+                return dl.read()
+        wait_until(lambda: "* total" in read_log())
+        profile = read_log().split("Startup profile:")[1]
+        for step in steps:
+            assert "* %s " % step in profile, step
+        for step in BACKGROUND_STEPS:
+            assert re.search(r"\* %s +\d+ms \(in background\)" % step, profile), step
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 10)
+        self.contract = node.createcontract(CONTRACT)['address']
+        node.generate(1)
+        self.txid = node.sendtocontract(self.contract, ADD + "0" * 63 + "5")['txid']
+        node.generate(1)
+        before = self.snapshot()
+        assert_equal(int(before['value'], 16), 18)
+
+        self.log.info("Restart with the databases opened in the background")
+        self.restart()
+        assert_equal(self.snapshot(), before)
+
+        self.log.info("Restart with a reindex of the chain state")
+        # The chain state is empty, so there are no blocks to verify
+        self.restart(['-reindex-chainstate'], [step for step in STEPS if step != "block verification"])
+        wait_until(lambda: node.getbestblockhash() == before['tip'])
+        assert_equal(self.snapshot(), before)
+
+        self.log.info("Keep going on the reopened databases")
+        node.sendtocontract(self.contract, ADD + "0" * 63 + "1")
+        node.generate(1)
+        before = self.snapshot()
+        assert_equal(int(before['value'], 16), 19)
+        self.restart()
+        assert_equal(self.snapshot(), before)
+
+if __name__ == '__main__':
+    QtumStartupProfileTest().main()
@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the state diffs of blocks, from the state diff index and computed from the state."""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, assert_raises_rpc_error
+from test_framework.qtumconfig import COINBASE_MATURITY
+
+SLOTS = 40
+
+def trie_root(block_root):
+    # The roots of the block header are shown reversed, the diff has them in trie byte order
+    return bytes.fromhex(block_root)[::-1].hex()
+
+class QtumStateDiffTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [['-statediffindex'], []]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 10)
+        self.sync_all()
+
+        self.log.info("A block without contracts changes nothing")
+        diff = node.getstatediff(node.getbestblockhash())
+        assert_equal(diff['prevStateRoot'], diff['stateRoot'])
+        assert_equal(diff['prevUTXORoot'], diff['utxoRoot'])
+        assert_equal(diff['accounts'], [])
+        assert_equal(diff['code'], [])
+        assert_equal(diff['vins'], [])
+
+        self.log.info("A contract deployment")
+        # The constructor stores i + 1 in slot i for i < SLOTS, the runtime code is a single STOP
+        bytecode = "60005b80600101815560010180602811600257" + "60016000f3"
+        contract = node.createcontract(bytecode)['address']
+        blockhash = node.generate(1)[0]
+        self.sync_all()
+
+        block = node.getblock(blockhash)
+        parent = node.getblock(block['previousblockhash'])
+        diff = node.getstatediff(blockhash)
+        assert_equal(diff['hash'], blockhash)
+        assert_equal(diff['height'], block['height'])
+        assert_equal(diff['prevStateRoot'], trie_root(parent['hashStateRoot']))
+        assert_equal(diff['stateRoot'], trie_root(block['hashStateRoot']))
+        assert_equal(diff['prevUTXORoot'], trie_root(parent['hashUTXORoot']))
+        assert_equal(diff['utxoRoot'], trie_root(block['hashUTXORoot']))
+        assert_equal(diff['code'], ["00"])
+        assert_equal(diff['vins'], [])
+
+        # The slots of the contract, by the hash of the slot, with their RLP encoded values
+        storage = node.getstorage(contract)
+        accounts = [a for a in diff['accounts'] if a['storage']]
+        assert_equal(len(accounts), 1)
+        assert all(a['account'] != "" for a in diff['accounts'])
+        entries = accounts[0]['storage']
+        assert_equal(len(entries), SLOTS)
+        assert_equal([e['key'] for e in entries], sorted(storage.keys()))
+        for e in entries:
+            # Values below 0x80 are their own RLP encoding
+            value = list(storage[e['key']].values())[0]
+            assert_equal(int(e['value'], 16), int(value, 16))
+
+        self.log.info("The index and the state give the same diff")
+        assert_equal(self.nodes[1].getstatediff(blockhash), diff)
+        raw = node.getstatediff(blockhash, False)
+        assert_equal(raw, self.nodes[1].getstatediff(blockhash, False))
+        # Starts with the roots of the parent
+        assert raw.startswith(diff['prevStateRoot'] + diff['prevUTXORoot'])
+
+        assert_raises_rpc_error(-5, "Block not found", node.getstatediff, "00" * 32)
+
+if __name__ == '__main__':
+    QtumStateDiffTest().main()
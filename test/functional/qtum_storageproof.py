@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the paginated storage listing and the storage proofs of contracts."""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, assert_raises_rpc_error
+from test_framework.qtumconfig import COINBASE_MATURITY
+
+SLOTS = 40
+
+def slot_hex(n):
+    return "%064x" % n
+
+class QtumStorageProofTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 10)
+        height_before = node.getblockcount()
+
+        # The constructor stores i + 1 in slot i for i < SLOTS, the runtime code is a single STOP
+        bytecode = "60005b80600101815560010180602811600257" + "60016000f3"
+        contract = node.createcontract(bytecode)['address']
+        node.generate(1)
+
+        storage = node.getstorage(contract)
+        assert_equal(len(storage), SLOTS)
+        assert 'storage' not in node.getaccountinfo(contract, False)
+        assert_equal(node.getaccountinfo(contract)['storage'], storage)
+
+        self.log.info("Page through the storage")
+        entries = []
+        start = "0" * 64
+        pages = 0
+        while True:
+            page = node.liststorage(contract, -1, start, 7)
+            assert len(page['entries']) <= 7
+            entries += page['entries']
+            pages += 1
+            if 'next' not in page:
+                break
+            start = page['next']
+            assert page['entries'][-1]['key'] < start
+        assert_equal(pages, (SLOTS + 6) // 7)
+        assert_equal([e['key'] for e in entries], sorted(storage.keys()))
+        for e in entries:
+            assert_equal(storage[e['key']], {e['slot']: e['value']})
+
+        # A page starts at its start key
+        middle = entries[SLOTS // 2]['key']
+        page = node.liststorage(contract, -1, middle, 1)
+        assert_equal(page['entries'][0]['key'], middle)
+        assert_equal(page['next'], entries[SLOTS // 2 + 1]['key'])
+        assert_equal(node.liststorage(contract, -1, "f" * 64)['entries'], [])
+
+        self.log.info("Prove a slot and an unset slot")
+        tip = node.getblock(node.getbestblockhash())
+        proof = node.getstorageproof(contract, slot_hex(5))
+        assert_equal(proof['stateRoot'], bytes.fromhex(tip['hashStateRoot'])[::-1].hex())
+        assert_equal(proof['height'], tip['height'])
+        assert_equal(proof['value'], slot_hex(6))
+        assert_equal(proof['storageRoot'], page['storageRoot'])
+        assert len(proof['accountProof']) > 0
+        assert len(proof['storageProof']) > 0
+        # The nodes of a proof are RLP lists
+        for node_hex in proof['accountProof'] + proof['storageProof']:
+            assert int(node_hex[:2], 16) >= 0xc0
+
+        proof = node.getstorageproof(contract, slot_hex(SLOTS))
+        assert_equal(proof['value'], slot_hex(0))
+        assert len(proof['storageProof']) > 0
+
+        # An account that does not exist has a proof of its absence and no storage
+        proof = node.getstorageproof("00" * 20, slot_hex(0))
+        assert 'storageRoot' not in proof
+        assert_equal(proof['storageProof'], [])
+        assert_equal(proof['value'], slot_hex(0))
+
+        self.log.info("Check the parameters")
+        assert_raises_rpc_error(-5, "Address does not exist", node.liststorage, contract, height_before)
+        assert_raises_rpc_error(-8, "count must be between 1 and 10000", node.liststorage, contract, -1, "0" * 64, 0)
+        assert_raises_rpc_error(-8, "start must be of length 64", node.liststorage, contract, -1, "00")
+        assert_raises_rpc_error(-32602, "Incorrect block number", node.getstorageproof, contract, slot_hex(0), node.getblockcount() + 1)
+
+if __name__ == '__main__':
+    QtumStorageProofTest().main()
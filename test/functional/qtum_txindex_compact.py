@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+# Copyright (c) 2016-2019 The KPG Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test -txindex-compact, and switching the txindex between the full and compact records."""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.authproxy import JSONRPCException
+from test_framework.util import *
+from test_framework.qtumconfig import *
+
+
+class QtumTxIndexCompactTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+        self.extra_args = [['-txindex']]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def wait_indexed(self, node, txid):
+        def indexed():
+            try:
+                return node.getrawtransaction(txid) is not None
+            except JSONRPCException:
+                return False
+        wait_until(indexed)
+
+    def check_txs(self, node, txids):
+        for txid in txids:
+            assert_equal(node.getrawtransaction(txid, True)['txid'], txid)
+        # A txid that shares its first bytes with an indexed one is not found
+        other = txids[0][:-1] + ('0' if txids[0][-1] != '0' else '1')
+        assert_raises_rpc_error(-5, "No such mempool or blockchain transaction", node.getrawtransaction, other)
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(20)
+        address = node.getnewaddress()
+        node.generate(COINBASE_MATURITY)
+        txids = [node.sendtoaddress(address, 1) for i in range(5)]
+        node.generate(1)
+        txids += [node.getblock(node.getblockhash(h))['tx'][0] for h in range(1, 20)]
+        self.check_txs(node, txids)
+
+        self.log.info("Switch to the compact records")
+        self.restart_node(0, ['-txindex', '-txindex-compact'])
+        self.wait_indexed(self.nodes[0], txids[0])
+        self.check_txs(self.nodes[0], txids)
+
+        self.log.info("New blocks are indexed compactly")
+        node = self.nodes[0]
+        txid = node.sendtoaddress(address, 1)
+        node.generate(1)
+        self.check_txs(node, [txid])
+
+        self.log.info("Switch back to the full records")
+        self.restart_node(0, ['-txindex'])
+        self.wait_indexed(self.nodes[0], txid)
+        self.check_txs(self.nodes[0], txids + [txid])
+
+
+if __name__ == '__main__':
+    QtumTxIndexCompactTest().main()
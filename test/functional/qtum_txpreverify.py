@@ -0,0 +1,40 @@
+#!/usr/bin/env python3
+# Copyright (c) 2015-2016 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import *
+from test_framework.qtum import *
+from test_framework.qtumconfig import *
+
+
+class TxPreverifyTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [[], ['-txverifythreads=2']]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def run_test(self):
+        self.nodes[0].generate(COINBASE_MATURITY+10)
+        self.sync_all()
+
+        # Unrelated txs, and a chain of txs whose children must not overtake their parents
+        address = self.nodes[0].getnewaddress()
+        txids = [self.nodes[0].sendtoaddress(self.nodes[1].getnewaddress(), 1) for i in range(10)]
+        for i in range(5):
+            unspent = [u for u in self.nodes[0].listunspent(0) if u['confirmations'] == 0 and u['amount'] > 2]
+            rawtx = self.nodes[0].createrawtransaction([{'txid': unspent[0]['txid'], 'vout': unspent[0]['vout']}], {address: unspent[0]['amount'] - Decimal('0.01')})
+            txids.append(self.nodes[0].sendrawtransaction(self.nodes[0].signrawtransactionwithwallet(rawtx)['hex']))
+        self.sync_mempools()
+        assert_equal(sorted(self.nodes[1].getrawmempool()), sorted(txids))
+
+        self.nodes[1].generate(1)
+        self.sync_all()
+        assert_equal(self.nodes[0].getrawmempool(), [])
+
+if __name__ == '__main__':
+    TxPreverifyTest().main()
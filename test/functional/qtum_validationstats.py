@@ -0,0 +1,48 @@
+#!/usr/bin/env python3
+# Copyright (c) 2015-2016 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import *
+from test_framework.qtum import *
+from test_framework.qtumconfig import *
+
+
+class ValidationStatsTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def run_test(self):
+        self.node = self.nodes[0]
+        # Leave out the genesis block, which skips most of ConnectBlock
+        self.node.getvalidationstats(True)
+        self.node.generate(COINBASE_MATURITY+10)
+
+        stats = self.node.getvalidationstats()
+        buckets = stats['buckets_ms']
+        assert_equal(buckets, sorted(buckets))
+        for name in ['sanity', 'hashproof', 'forks', 'connect', 'contracts', 'reward', 'verify', 'statecommit',
+                     'index', 'readblock', 'connectblock', 'flush', 'chainstate', 'postconnect', 'total']:
+            stage = stats['stages'][name]
+            assert_equal(stage['count'], COINBASE_MATURITY+10)
+            assert_equal(len(stage['histogram']), len(buckets) + 1)
+            assert_equal(sum(stage['histogram']), stage['count'])
+            assert(stage['max_ms'] <= stage['total_ms'])
+            recent = stage['recent']
+            assert_equal(recent['count'], min(stage['count'], 1000))
+            assert(recent['p50_ms'] <= recent['p90_ms'] <= recent['p99_ms'] <= recent['max_ms'])
+        # Receipts are only committed with -logevents
+        assert_equal(stats['stages']['receipts']['count'], 0)
+
+        self.node.getvalidationstats(True)
+        assert_equal(self.node.getvalidationstats()['stages']['total']['count'], 0)
+        self.node.generate(1)
+        assert_equal(self.node.getvalidationstats()['stages']['total']['count'], 1)
+
+if __name__ == '__main__':
+    ValidationStatsTest().main()
@@ -0,0 +1,61 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import *
+from test_framework.qtum import *
+from test_framework.qtumconfig import *
+
+
+class ValidationTimesTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def run_test(self):
+        self.nodes[0].generate(COINBASE_MATURITY+1)
+        self.sync_all()
+
+        # A transaction received from a peer is timed until it is confirmed
+        txid = self.nodes[0].sendtoaddress(self.nodes[1].getnewaddress(), 1)
+        self.sync_mempools()
+        tx = self.nodes[1].getblockvalidationtimes(0, [txid])['transactions'][0]
+        assert_equal(tx['txid'], txid)
+        assert(tx['received'] <= tx['accepted'])
+        assert(tx['accept_ms'] >= 0)
+        assert('confirmed' not in tx)
+        # The sender did not receive it
+        assert_equal(self.nodes[0].getblockvalidationtimes(0, [txid])['transactions'], [])
+
+        blockhash = self.nodes[0].generate(1)[0]
+        self.sync_all()
+        times = self.nodes[1].getblockvalidationtimes(1)
+        block = times['blocks'][0]
+        assert_equal(block['hash'], blockhash)
+        assert_equal(block['height'], COINBASE_MATURITY+2)
+        assert(block['header_received'] <= block['block_received'] <= block['connect_start'] <= block['connect_end'] <= block['tip_updated'])
+        for name in ['download_ms', 'queue_ms', 'connect_ms', 'tip_ms', 'total_ms']:
+            assert(block[name] >= 0)
+        assert_equal(times['transactions'][0]['txid'], txid)
+        tx = times['transactions'][0]
+        assert_equal(tx['blockhash'], blockhash)
+        assert(tx['accepted'] <= tx['confirmed'])
+        assert(tx['confirm_ms'] >= tx['accept_ms'])
+
+        # A block of the node itself is only timed from its connection
+        block = self.nodes[0].getblockvalidationtimes(1)['blocks'][0]
+        assert_equal(block['hash'], blockhash)
+        assert('block_received' not in block)
+        assert('peer' not in block)
+        assert(block['connect_start'] <= block['connect_end'] <= block['tip_updated'])
+
+        assert_equal(len(self.nodes[1].getblockvalidationtimes(5)['blocks']), 5)
+        assert_raises_rpc_error(-8, "Negative count", self.nodes[1].getblockvalidationtimes, -1)
+
+if __name__ == '__main__':
+    ValidationTimesTest().main()
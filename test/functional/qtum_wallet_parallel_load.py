@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test loading a wallet with many transaction records.
+
+The transaction records of the wallet are decoded on several threads in
+batches and applied in the order they were read. Load a wallet with enough
+records to be split across threads and check that the transactions, their
+order and the balances read back the same after a restart.
+"""
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal
+from test_framework.qtumconfig import COINBASE_MATURITY
+
+class QtumWalletParallelLoadTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def snapshot(self):
+        node = self.nodes[0]
+        info = node.getwalletinfo()
+        return {
+            'txcount': info['txcount'],
+            'balance': info['balance'],
+            'immature': info['immature_balance'],
+            'unconfirmed': info['unconfirmed_balance'],
+            'txs': node.listtransactions("*", 100000, 0, True),
+            'unspent': sorted((u['txid'], u['vout'], u['amount']) for u in node.listunspent(0)),
+            'sent': [node.gettransaction(txid)['hex'] for txid in self.txids],
+        }
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 200)
+        self.txids = []
+        for i in range(100):
+            self.txids.append(node.sendtoaddress(node.getnewaddress(), 1 + i / 100))
+            if i % 25 == 24:
+                node.generate(1)
+        # Leave a few in the mempool so that unconfirmed records are loaded too
+        for i in range(5):
+            self.txids.append(node.sendtoaddress(node.getnewaddress(), 2))
+        before = self.snapshot()
+        assert before['txcount'] > 512
+
+        self.log.info("Restart and reload the wallet")
+        self.restart_node(0)
+        assert_equal(self.snapshot(), before)
+
+        self.log.info("Keep using the reloaded wallet")
+        self.txids.append(node.sendtoaddress(node.getnewaddress(), 3))
+        node.generate(1)
+        before = self.snapshot()
+        self.restart_node(0)
+        assert_equal(self.snapshot(), before)
+        assert_equal(node.getrawmempool(), [])
+
+if __name__ == '__main__':
+    QtumWalletParallelLoadTest().main()
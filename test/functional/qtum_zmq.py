@@ -0,0 +1,181 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Qtum Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the contract notifications of the ZMQ interface.
+
+- rawlogs, filtered by contract address and by -zmqpubrawlogstopic
+- rawreceipts, one message per block with all of its receipts
+- stateroots, the state and UTXO roots of each block
+"""
+import struct
+from io import BytesIO
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.messages import deser_compact_size, deser_string
+from test_framework.util import assert_equal, p2p_port
+from test_framework.qtumconfig import COINBASE_MATURITY
+
+# Emits two logs with the topic below when called with 5b9af12b
+CONTRACT = "6060604052600d600055341561001457600080fd5b61017e806100236000396000f30060606040526004361061004c576000357c0100000000000000000000000000000000000000000000000000000000900463ffffffff168063027c1aaf1461004e5780635b9af12b14610058575b005b61005661008f565b005b341561006357600080fd5b61007960048080359060200190919050506100a1565b6040518082815260200191505060405180910390f35b60026000808282540292505081905550565b60007fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a17fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a1816000540160008190555060005490509190505600a165627a7a7230582015732bfa66bdede47ecc05446bf4c1e8ed047efac25478cb13b795887df70f290029"
+ADD = "5b9af12b"
+ADD_TOPIC = "c5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f2"
+# Emits one log with four topics when called with d3b57be9
+OTHER_CONTRACT = "6060604052341561000f57600080fd5b61029b8061001e6000396000f300606060405260043610610062576000357c0100000000000000000000000000000000000000000000000000000000900463ffffffff16806394e8767d14610067578063b717cfe6146100a6578063d3b57be9146100bb578063f7e52d58146100d0575b600080fd5b341561007257600080fd5b61008860048080359060200190919050506100e5565b60405180826000191660001916815260200191505060405180910390f35b34156100b157600080fd5b6100b961018e565b005b34156100c657600080fd5b6100ce6101a9565b005b34156100db57600080fd5b6100e36101b3565b005b600080821415610117577f30000000000000000000000000000000000000000000000000000000000000009050610186565b5b600082111561018557610100816001900481151561013257fe5b0460010290507f01000000000000000000000000000000000000000000000000000000000000006030600a8481151561016757fe5b06010260010281179050600a8281151561017d57fe5b049150610118565b5b809050919050565b60008081548092919060010191905055506101a76101b3565b565b6101b161018e565b565b7f746f7069632034000000000000000000000000000000000000000000000000007f746f7069632033000000000000000000000000000000000000000000000000007f746f7069632032000000000000000000000000000000000000000000000000007f746f70696320310000000000000000000000000000000000000000000000000060405180807f3700000000000000000000000000000000000000000000000000000000000000815250600101905060405180910390a45600a165627a7a72305820262764914338437fc49c9f752503904820534b24092308961bc10cd851985ae50029"
+EMIT = "d3b57be9"
+EMIT_TOPIC = "746f706963203300000000000000000000000000000000000000000000000000"
+
+def deser_hash(f):
+    return f.read(32)[::-1].hex()
+
+def deser_log(f):
+    address = f.read(20).hex()
+    topics = [f.read(32).hex() for _ in range(deser_compact_size(f))]
+    return {'address': address, 'topics': topics, 'data': deser_string(f).hex()}
+
+def deser_receipt(f):
+    receipt = {}
+    receipt['transactionHash'] = deser_hash(f)
+    receipt['transactionIndex'], receipt['outputIndex'] = struct.unpack('<II', f.read(8))
+    receipt['from'] = f.read(20).hex()
+    receipt['to'] = f.read(20).hex()
+    receipt['cumulativeGasUsed'], receipt['gasUsed'] = struct.unpack('<QQ', f.read(16))
+    receipt['contractAddress'] = f.read(20).hex()
+    receipt['excepted'] = struct.unpack('<I', f.read(4))[0]
+    receipt['stateRoot'] = f.read(32).hex()
+    receipt['utxoRoot'] = f.read(32).hex()
+    receipt['log'] = [deser_log(f) for _ in range(deser_compact_size(f))]
+    return receipt
+
+class ZMQSubscriber:
+    def __init__(self, socket, topic):
+        import zmq
+        self.socket = socket
+        self.socket.setsockopt(zmq.SUBSCRIBE, topic)
+
+    def receive(self):
+        # The sequence numbers count the messages of all subscribers, filtered ones have gaps
+        topic, body, seq = self.socket.recv_multipart()
+        return topic.decode(), BytesIO(body)
+
+    def receive_block(self, block_hash):
+        # The blocks connected before subscribing may still be queued for publishing
+        while True:
+            topic, body = self.receive()
+            if deser_hash(body) == block_hash:
+                return topic, body
+
+class QtumZMQTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_py3_zmq()
+        self.skip_if_no_bitcoind_zmq()
+        self.skip_if_no_wallet()
+
+    def setup_network(self):
+        import zmq
+        self.zmq_context = zmq.Context()
+        self.address = "tcp://127.0.0.1:%d" % p2p_port(self.num_nodes)
+        self.extra_args = [['-logevents'] + ['-zmqpub%s=%s' % (topic, self.address) for topic in ['rawlogs', 'rawreceipts', 'stateroots']]]
+        self.add_nodes(self.num_nodes, self.extra_args)
+        self.start_nodes()
+
+    def subscribe(self, topic):
+        import zmq
+        socket = self.zmq_context.socket(zmq.SUB)
+        socket.set(zmq.RCVTIMEO, 60000)
+        socket.connect(self.address)
+        return ZMQSubscriber(socket, topic.encode())
+
+    def run_test(self):
+        try:
+            self._zmq_test()
+        finally:
+            self.zmq_context.destroy(linger=None)
+
+    def _zmq_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 10)
+        contract = node.createcontract(CONTRACT)['address']
+        other_contract = node.createcontract(OTHER_CONTRACT)['address']
+        node.generate(1)
+
+        self.log.info("rawlogs filtered by contract address")
+        logs = self.subscribe("rawlogs" + contract)
+        all_logs = self.subscribe("rawlogs")
+        receipts = self.subscribe("rawreceipts")
+        roots = self.subscribe("stateroots")
+        node.sendtocontract(other_contract, EMIT)
+        other_hash = node.generate(1)[0]
+        txid = node.sendtocontract(contract, ADD + "0" * 63 + "1")['txid']
+        block_hash = node.generate(1)[0]
+        height = node.getblockcount()
+
+        # The logs of the other contract only reach the unfiltered subscriber
+        topic, body = all_logs.receive()
+        assert_equal(topic, "rawlogs" + other_contract)
+        assert_equal(deser_hash(body), other_hash)
+        for sub in [logs, all_logs]:
+            for _ in range(2):
+                topic, body = sub.receive()
+                assert_equal(topic, "rawlogs" + contract)
+                assert_equal(deser_hash(body), block_hash)
+                assert_equal(struct.unpack('<I', body.read(4))[0], height)
+                assert_equal(deser_hash(body), txid)
+                body.read(8)
+                log = deser_log(body)
+                assert_equal(log['address'], contract)
+                assert_equal(log['topics'], [ADD_TOPIC])
+                assert_equal(log, node.gettransactionreceipt(txid)[0]['log'][0])
+
+        self.log.info("rawreceipts")
+        for hash in [other_hash, block_hash]:
+            topic, body = receipts.receive_block(hash)
+            assert_equal(topic, "rawreceipts")
+            assert_equal(struct.unpack('<I', body.read(4))[0], node.getblock(hash)['height'])
+            published = [deser_receipt(body) for _ in range(deser_compact_size(body))]
+            assert_equal(body.read(), b"")
+            expected = []
+            for tx in node.getblock(hash)['tx']:
+                expected += node.gettransactionreceipt(tx)
+            assert_equal(len(published), 1)
+            assert_equal(len(published), len(expected))
+            for receipt, rpc_receipt in zip(published, expected):
+                for key in ['transactionHash', 'transactionIndex', 'outputIndex', 'from', 'to', 'cumulativeGasUsed', 'gasUsed', 'contractAddress', 'stateRoot', 'utxoRoot', 'log']:
+                    assert_equal(receipt[key], rpc_receipt[key])
+                assert_equal(receipt['excepted'], 0)
+                assert_equal(rpc_receipt['excepted'], "None")
+        # Also sent for the blocks without receipts
+        empty_hash = node.generate(1)[0]
+        topic, body = receipts.receive_block(empty_hash)
+        body.read(4)
+        assert_equal(deser_compact_size(body), 0)
+
+        self.log.info("stateroots")
+        for hash in [other_hash, block_hash, empty_hash]:
+            topic, body = roots.receive_block(hash)
+            assert_equal(topic, "stateroots")
+            block = node.getblock(hash)
+            assert_equal(struct.unpack('<I', body.read(4))[0], block['height'])
+            assert_equal(deser_hash(body), block['hashStateRoot'])
+            assert_equal(deser_hash(body), block['hashUTXORoot'])
+
+        self.log.info("rawlogs filtered by topic")
+        self.restart_node(0, self.extra_args[0] + ['-zmqpubrawlogstopic=%s' % EMIT_TOPIC])
+        all_logs = self.subscribe("rawlogs")
+        node.sendtocontract(contract, ADD + "0" * 63 + "1")
+        node.generate(1)
+        node.sendtocontract(other_contract, EMIT)
+        other_hash = node.generate(1)[0]
+        # The logs of the first block have none of the topics
+        topic, body = all_logs.receive()
+        assert_equal(topic, "rawlogs" + other_contract)
+        assert_equal(deser_hash(body), other_hash)
+        body.read(4 + 32 + 8)
+        assert EMIT_TOPIC in deser_log(body)['topics']
+
+if __name__ == '__main__':
+    QtumZMQTest().main()
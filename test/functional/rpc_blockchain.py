@@ -216,6 +216,17 @@ class BlockchainTest(BitcoinTestFramework):
         del res['disk_size'], res3['disk_size']
         assert_equal(res, res3)
 
+        self.log.info("Test that gettxoutsetinfo() computes the same statistics with the other hash types")
+        res4 = node.gettxoutsetinfo("muhash")
+        assert_equal(len(res4['muhash']), 64)
+        assert 'hash_serialized_2' not in res4
+        res5 = node.gettxoutsetinfo("none")
+        assert 'muhash' not in res5 and 'hash_serialized_2' not in res5
+        del res['hash_serialized_2'], res4['muhash'], res4['disk_size'], res5['disk_size']
+        assert_equal(res, res4)
+        assert_equal(res, res5)
+        assert_raises_rpc_error(-8, "foo is not a valid hash_type", node.gettxoutsetinfo, "foo")
+
     def _test_getblockheader(self):
         node = self.nodes[0]
 
@@ -6,10 +6,12 @@
 #
 # Test getblockstats rpc call
 #
+from test_framework.authproxy import JSONRPCException
 from test_framework.test_framework import BitcoinTestFramework
 from test_framework.util import (
     assert_equal,
     assert_raises_rpc_error,
+    wait_until,
 )
 from test_framework.qtumconfig import *
 import json
@@ -45,8 +47,8 @@ class GetblockstatsTest(BitcoinTestFramework):
                             help='Test data file')
 
     def set_test_params(self):
-        self.num_nodes = 2
-        self.extra_args = [['-txindex'], ['-paytxfee=0.004']]
+        self.num_nodes = 3
+        self.extra_args = [['-txindex'], ['-paytxfee=0.004'], ['-blockstatsindex']]
         self.setup_clean_chain = True
 
     def get_stats(self):
@@ -85,6 +87,13 @@ class GetblockstatsTest(BitcoinTestFramework):
         with open(filename, 'w', encoding="utf8") as f:
             json.dump(to_dump, f, sort_keys=True, indent=2)
 
+    def stats_index_has(self, blockhash):
+        try:
+            self.nodes[2].getblockstats(hash_or_height=blockhash)
+            return True
+        except JSONRPCException:
+            return False
+
     def load_test_data(self, filename):
         with open(filename, 'r', encoding="utf8") as f:
             d = json.load(f)
@@ -93,8 +102,8 @@ class GetblockstatsTest(BitcoinTestFramework):
             self.expected_stats = d['stats']
 
         # Set the timestamps from the file so that the nodes can get out of Initial Block Download
-        self.nodes[0].setmocktime(mocktime)
-        self.nodes[1].setmocktime(mocktime)
+        for node in self.nodes:
+            node.setmocktime(mocktime)
 
         for b in blocks:
             self.nodes[0].submitblock(b)
@@ -132,6 +141,10 @@ class GetblockstatsTest(BitcoinTestFramework):
             stats_no_txindex = self.nodes[1].getblockstats(hash_or_height=blockhash, stats=list(expected_stats_noindex[i].keys()))
             assert_equal(stats_no_txindex, expected_stats_noindex[i])
 
+            # The node with the statistics index serves them all without -txindex
+            wait_until(lambda: self.stats_index_has(blockhash))
+            assert_equal(self.nodes[2].getblockstats(hash_or_height=blockhash), self.expected_stats[i])
+
         # Make sure each stat can be queried on its own
         for stat in expected_keys:
             for i in range(self.max_stat_pos+1):
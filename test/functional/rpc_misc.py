@@ -34,6 +34,12 @@ class RpcMiscTest(BitcoinTestFramework):
         assert_greater_than(memory['chunks_free'], 0)
         assert_equal(memory['used'] + memory['free'], memory['total'])
 
+        state = node.getmemoryinfo()['state']
+        caches = ['nodecache', 'codecache', 'storagecache', 'accounts', 'receipts', 'dgp']
+        for name in caches:
+            assert_greater_than_or_equal(state[name], 0)
+        assert_equal(sum(state[name] for name in caches), state['total'])
+
         self.log.info("test mallocinfo")
         try:
             mallocinfo = node.getmemoryinfo(mode="mallocinfo")
@@ -34,6 +34,7 @@ class NetTest(BitcoinTestFramework):
         self._test_getnetworkinginfo()
         self._test_getaddednodeinfo()
         self._test_getpeerinfo()
+        self._test_getnetmsgstats()
         self._test_getnodeaddresses()
 
     def _test_connection_count(self):
@@ -105,6 +106,22 @@ class NetTest(BitcoinTestFramework):
         assert_equal(peer_info[0][0]['minfeefilter'], Decimal("0.00000500"))
         assert_equal(peer_info[1][0]['minfeefilter'], Decimal("0.00001000"))
 
+    def _test_getnetmsgstats(self):
+        peer_info = self.nodes[0].getpeerinfo()
+        stats = self.nodes[0].getnetmsgstats()
+        # the handshake of each peer is processed once
+        for peer in peer_info:
+            assert_equal(peer['processing_per_msg']['version']['count'], 1)
+            assert_equal(peer['processing_per_msg']['verack']['count'], 1)
+        assert_greater_than_or_equal(stats['messages']['version']['count'], len(peer_info))
+        for msg, peer_stats in peer_info[0]['processing_per_msg'].items():
+            assert_greater_than_or_equal(stats['messages'][msg]['count'], peer_stats['count'])
+            assert_greater_than_or_equal(stats['messages'][msg]['bytes'], peer_stats['bytes'])
+            assert_greater_than_or_equal(peer_stats['total_ms'], peer_stats['cs_main_ms'])
+        for msg in stats['messages'].values():
+            assert_equal(len(msg['histogram']), len(stats['buckets_ms']) + 1)
+            assert_equal(sum(msg['histogram']), msg['count'])
+
     def _test_getnodeaddresses(self):
         self.nodes[0].add_p2p_connection(P2PInterface())
 
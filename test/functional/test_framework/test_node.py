@@ -301,6 +301,18 @@ class TestNode():
     def wait_until_stopped(self, timeout=BITCOIND_PROC_WAIT_TIMEOUT):
         wait_until(self.is_node_stopped, timeout=timeout)
 
+    def kill_process(self):
+        """Kill the node without a clean shutdown, as a crash would."""
+        self.process.kill()
+        self.process.wait(timeout=BITCOIND_PROC_WAIT_TIMEOUT)
+        self.running = False
+        self.process = None
+        self.rpc_connected = False
+        self.rpc = None
+        self.stdout.close()
+        self.stderr.close()
+        del self.p2ps[:]
+
     @contextlib.contextmanager
     def assert_debug_log(self, expected_msgs):
         debug_log = os.path.join(self.datadir, 'regtest', 'debug.log')
@@ -204,6 +204,18 @@ BASE_SCRIPTS = [
     'qtum_waitforlogs.py',
     'qtum_block_header.py',
     'qtum_callcontract.py',
+    'qtum_callcontractbatch.py',
+    'qtum_contractstate_snapshot.py',
+    'qtum_contractprofile.py',
+    'qtum_prefetchblocks.py',
+    'qtum_validationstats.py',
+    'qtum_validationtimes.py',
+    'qtum_mempoolpreexec.py',
+    'qtum_txpreverify.py',
+    'qtum_blockserve.py',
+    'qtum_backgroundcheck.py',
+    'qtum_lockstats.py',
+    'qtum_txindex_compact.py',
     'qtum_spend_op_call.py',
     'qtum_condensing_txs.py',
     'qtum_createcontract.py',
@@ -212,6 +224,38 @@ BASE_SCRIPTS = [
     'qtum_create_eth_op_code.py',
     'qtum_gas_limit_overflow.py',
     'qtum_call_empty_contract.py',
+    'qtum_storageproof.py',
+    'qtum_statediff.py',
+    'qtum_replay_receipts.py',
+    'qtum_prunestate.py',
+    'qtum_parcontract.py',
+    'qtum_blockcommit.py',
+    'qtum_zmq.py',
+    'qtum_contract_scriptcheck.py',
+    'qtum_indexbuild.py',
+    'qtum_loadblock.py',
+    'qtum_pos_reconnect.py',
+    'qtum_deep_disconnect.py',
+    'qtum_staker_wakeup.py',
+    'qtum_multiwallet_staking.py',
+    'qtum_staking_stats.py',
+    'qtum_gbt_update.py',
+    'qtum_mempool_persist.py',
+    'qtum_contractaddressindex.py',
+    'qtum_rest.py',
+    'qtum_rpc_fairness.py',
+    'qtum_p2p_socket_events.py',
+    'qtum_p2p_inflight_limit.py',
+    'qtum_inv_relay_order.py',
+    'qtum_shared_block_cache.py',
+    'qtum_blockindex_snapshot.py',
+    'qtum_wallet_parallel_load.py',
+    'qtum_startup_profile.py',
+    'qtum_loadgen.py',
+    'qtum_blockchange_waiters.py',
+    'qtum_concurrent_connects.py',
+    'qtum_callcontract_view.py',
+    'qtum_memorystate.py',
     'qtum_dgp_block_size_sync.py',
     'qtum_pos_conflicting_txs.py',
     'qtum_globals_state_changer.py',
@@ -241,6 +285,7 @@ BASE_SCRIPTS = [
     'qtum_op_sender.py',
     'qtum_evm_revert.py',
     'qtum_evm_create2.py',
+    'qtum_evm_vm.py',
     'qtum_evm_staticcall.py',
     'qtum_evm_constantinople_precompiles.py',
     'qtum_evm_constantinople_opcodes.py',
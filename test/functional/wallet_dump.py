@@ -117,9 +117,8 @@ class WalletDumpTest(BitcoinTestFramework):
         # Test scripts dump by adding a 1-of-1 multisig address
         multisig_addr = self.nodes[0].addmultisigaddress(1, [addrs[1]["address"]])["address"]
 
-        # Refill the keypool. getnewaddress() refills the keypool *before* taking a key from
-        # the keypool, so the final call to getnewaddress leaves the keypool with one key below
-        # its capacity
+        # Refill the keypool. getnewaddress() leaves the refill to the background top-up,
+        # which may not have caught up with the last calls yet
         self.nodes[0].keypoolrefill()
 
         # dump unencrypted wallet
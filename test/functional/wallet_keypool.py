@@ -7,7 +7,7 @@
 import time
 
 from test_framework.test_framework import BitcoinTestFramework
-from test_framework.util import assert_equal, assert_raises_rpc_error
+from test_framework.util import assert_equal, assert_raises_rpc_error, wait_until
 
 class KeyPoolTest(BitcoinTestFramework):
     def set_test_params(self):
@@ -82,5 +82,16 @@ class KeyPoolTest(BitcoinTestFramework):
         assert_equal(wi['keypoolsize_hd_internal'], 100)
         assert_equal(wi['keypoolsize'], 100)
 
+        # The keypool is filled up to -keypool in the background once the wallet is unlocked
+        self.restart_node(0, ['-keypool=150'])
+        nodes[0].walletpassphrase('test', 100)
+        wait_until(lambda: nodes[0].getwalletinfo()['keypoolsize'] == 150 and nodes[0].getwalletinfo()['keypoolsize_hd_internal'] == 150)
+
+        # and the keys handed out are replaced
+        for _ in range(10):
+            nodes[0].getnewaddress()
+            nodes[0].getrawchangeaddress()
+        wait_until(lambda: nodes[0].getwalletinfo()['keypoolsize'] == 150 and nodes[0].getwalletinfo()['keypoolsize_hd_internal'] == 150)
+
 if __name__ == '__main__':
     KeyPoolTest().main()